@@ -0,0 +1,65 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/macro.h>
+
+#include "builtin-modules.h"
+
+/* builtin-modules-list.h is generated from modules/module-defs.h.m4
+ * and has one PA_BUILTIN_MODULE(name, prefix) line for every module
+ * that is linked into the daemon. The symbols a module does not define
+ * are weak and end up as NULL. */
+
+#define PA_BUILTIN_MODULE(name, prefix)                                         \
+    int prefix##_LTX_pa__init(pa_module *m);                                    \
+    void prefix##_LTX_pa__done(pa_module *m) __attribute__ ((weak));            \
+    int prefix##_LTX_pa__get_n_used(pa_module *m) __attribute__ ((weak));       \
+    const char* prefix##_LTX_pa__get_author(void) __attribute__ ((weak));       \
+    const char* prefix##_LTX_pa__get_description(void) __attribute__ ((weak));  \
+    const char* prefix##_LTX_pa__get_usage(void) __attribute__ ((weak));        \
+    const char* prefix##_LTX_pa__get_version(void) __attribute__ ((weak));      \
+    const char* prefix##_LTX_pa__get_deprecated(void) __attribute__ ((weak));   \
+    pa_bool_t prefix##_LTX_pa__load_once(void) __attribute__ ((weak));
+
+#include "builtin-modules-list.h"
+
+#undef PA_BUILTIN_MODULE
+
+#define PA_BUILTIN_MODULE(name, prefix)         \
+    {                                           \
+        name,                                   \
+        prefix##_LTX_pa__init,                  \
+        prefix##_LTX_pa__done,                  \
+        prefix##_LTX_pa__get_n_used,            \
+        prefix##_LTX_pa__get_author,            \
+        prefix##_LTX_pa__get_description,       \
+        prefix##_LTX_pa__get_usage,             \
+        prefix##_LTX_pa__get_version,           \
+        prefix##_LTX_pa__get_deprecated,        \
+        prefix##_LTX_pa__load_once              \
+    },
+
+const pa_module_builtin pa_builtin_modules[] = {
+#include "builtin-modules-list.h"
+    { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL }
+};
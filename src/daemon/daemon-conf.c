@@ -73,9 +73,12 @@ static const pa_daemon_conf default_conf = {
     .flat_volumes = TRUE,
     .exit_idle_time = 20,
     .scache_idle_time = 20,
+    .shared_sample_player = FALSE,
     .auto_log_target = 1,
     .script_commands = NULL,
     .dl_search_path = NULL,
+    .cpu_affinity = NULL,
+    .io_cpu_affinity = NULL,
     .load_default_script_file = TRUE,
     .default_script_file = NULL,
     .log_target = PA_LOG_SYSLOG,
@@ -86,6 +89,7 @@ static const pa_daemon_conf default_conf = {
     .resample_method = PA_RESAMPLER_AUTO,
     .disable_remixing = FALSE,
     .disable_lfe_remixing = TRUE,
+    .float32_mixing = FALSE,
     .config_file = NULL,
     .use_pid_file = TRUE,
     .system_instance = FALSE,
@@ -95,15 +99,23 @@ static const pa_daemon_conf default_conf = {
     .no_cpu_limit = TRUE,
     .disable_shm = FALSE,
     .lock_memory = FALSE,
+    .huge_pages = FALSE,
     .deferred_volume = TRUE,
     .default_n_fragments = 4,
     .default_fragment_size_msec = 25,
     .deferred_volume_safety_margin_usec = 8000,
     .deferred_volume_extra_delay_usec = 0,
+    .sink_input_history_msec = -1,
+    .volume_ramp_msec = 0,
+    .subscription_coalesce_msec = 0,
     .default_sample_spec = { .format = PA_SAMPLE_S16NE, .rate = 44100, .channels = 2 },
     .alternate_sample_rate = 48000,
     .default_channel_map = { .channels = 2, .map = { PA_CHANNEL_POSITION_LEFT, PA_CHANNEL_POSITION_RIGHT } },
-    .shm_size = 0
+    .shm_size = 0,
+    .shm_slot_size = 0,
+    .shm_small_slot_size = 0,
+    .memory_budget = 0,
+    .client_memory_budget = 0
 #ifdef HAVE_SYS_RESOURCE_H
    ,.rlimit_fsize = { .value = 0, .is_set = FALSE },
     .rlimit_data = { .value = 0, .is_set = FALSE },
@@ -172,6 +184,8 @@ void pa_daemon_conf_free(pa_daemon_conf *c) {
     pa_xfree(c->script_commands);
     pa_xfree(c->dl_search_path);
     pa_xfree(c->default_script_file);
+    pa_xfree(c->cpu_affinity);
+    pa_xfree(c->io_cpu_affinity);
     pa_xfree(c->config_file);
     pa_xfree(c);
 }
@@ -472,6 +486,24 @@ static int parse_fragment_size_msec(const char *filename, unsigned line, const c
     return 0;
 }
 
+static int parse_sink_input_history_msec(const char *filename, unsigned line, const char *section, const char *lvalue, const char *rvalue, void *data, void *userdata) {
+    pa_daemon_conf *c = data;
+    int32_t n;
+
+    pa_assert(filename);
+    pa_assert(lvalue);
+    pa_assert(rvalue);
+    pa_assert(data);
+
+    if (pa_atoi(rvalue, &n) < 0 || n < -1) {
+        pa_log(_("[%s:%u] Invalid sink input history length '%s'."), filename, line, rvalue);
+        return -1;
+    }
+
+    c->sink_input_history_msec = n;
+    return 0;
+}
+
 static int parse_nice_level(const char *filename, unsigned line, const char *section, const char *lvalue, const char *rvalue, void *data, void *userdata) {
     pa_daemon_conf *c = data;
     int32_t level;
@@ -515,6 +547,29 @@ static int parse_rtprio(const char *filename, unsigned line, const char *section
     return 0;
 }
 
+static int parse_cpu_affinity(const char *filename, unsigned line, const char *section, const char *lvalue, const char *rvalue, void *data, void *userdata) {
+    char **cpus = data;
+
+    pa_assert(filename);
+    pa_assert(lvalue);
+    pa_assert(rvalue);
+    pa_assert(data);
+
+    pa_xfree(*cpus);
+    *cpus = NULL;
+
+    if (!*rvalue)
+        return 0;
+
+    if (!pa_cpu_list_valid(rvalue)) {
+        pa_log(_("[%s:%u] Invalid CPU list '%s'."), filename, line, rvalue);
+        return -1;
+    }
+
+    *cpus = pa_xstrdup(rvalue);
+    return 0;
+}
+
 #ifdef HAVE_DBUS
 static int parse_server_type(const char *filename, unsigned line, const char *section, const char *lvalue, const char *rvalue, void *data, void *userdata) {
     pa_daemon_conf *c = data;
@@ -556,11 +611,16 @@ int pa_daemon_conf_load(pa_daemon_conf *c, const char *filename) {
         { "disable-shm",                pa_config_parse_bool,     &c->disable_shm, NULL },
         { "enable-shm",                 pa_config_parse_not_bool, &c->disable_shm, NULL },
         { "flat-volumes",               pa_config_parse_bool,     &c->flat_volumes, NULL },
+        { "subscription-coalesce-msec", pa_config_parse_unsigned, &c->subscription_coalesce_msec, NULL },
         { "lock-memory",                pa_config_parse_bool,     &c->lock_memory, NULL },
+        { "enable-huge-pages",          pa_config_parse_bool,     &c->huge_pages, NULL },
         { "enable-deferred-volume",     pa_config_parse_bool,     &c->deferred_volume, NULL },
         { "exit-idle-time",             pa_config_parse_int,      &c->exit_idle_time, NULL },
         { "scache-idle-time",           pa_config_parse_int,      &c->scache_idle_time, NULL },
+        { "shared-sample-player",       pa_config_parse_bool,     &c->shared_sample_player, NULL },
         { "realtime-priority",          parse_rtprio,             c, NULL },
+        { "cpu-affinity",               parse_cpu_affinity,       &c->cpu_affinity, NULL },
+        { "io-thread-cpu-affinity",     parse_cpu_affinity,       &c->io_cpu_affinity, NULL },
         { "dl-search-path",             pa_config_parse_string,   &c->dl_search_path, NULL },
         { "default-script-file",        pa_config_parse_string,   &c->default_script_file, NULL },
         { "log-target",                 parse_log_target,         c, NULL },
@@ -578,13 +638,20 @@ int pa_daemon_conf_load(pa_daemon_conf *c, const char *filename) {
                                         pa_config_parse_unsigned, &c->deferred_volume_safety_margin_usec, NULL },
         { "deferred-volume-extra-delay-usec",
                                         pa_config_parse_int,      &c->deferred_volume_extra_delay_usec, NULL },
+        { "sink-input-history-msec",    parse_sink_input_history_msec, c, NULL },
+        { "volume-ramp-msec",           pa_config_parse_unsigned, &c->volume_ramp_msec, NULL },
         { "nice-level",                 parse_nice_level,         c, NULL },
         { "disable-remixing",           pa_config_parse_bool,     &c->disable_remixing, NULL },
         { "enable-remixing",            pa_config_parse_not_bool, &c->disable_remixing, NULL },
         { "disable-lfe-remixing",       pa_config_parse_bool,     &c->disable_lfe_remixing, NULL },
         { "enable-lfe-remixing",        pa_config_parse_not_bool, &c->disable_lfe_remixing, NULL },
+        { "enable-float32-mixing",      pa_config_parse_bool,     &c->float32_mixing, NULL },
         { "load-default-script-file",   pa_config_parse_bool,     &c->load_default_script_file, NULL },
         { "shm-size-bytes",             pa_config_parse_size,     &c->shm_size, NULL },
+        { "shm-slot-size-bytes",        pa_config_parse_size,     &c->shm_slot_size, NULL },
+        { "shm-small-slot-size-bytes",  pa_config_parse_size,     &c->shm_small_slot_size, NULL },
+        { "memory-budget-bytes",        pa_config_parse_size,     &c->memory_budget, NULL },
+        { "client-memory-budget-bytes", pa_config_parse_size,     &c->client_memory_budget, NULL },
         { "log-meta",                   pa_config_parse_bool,     &c->log_meta, NULL },
         { "log-time",                   pa_config_parse_bool,     &c->log_time, NULL },
         { "log-backtrace",              pa_config_parse_unsigned, &c->log_backtrace, NULL },
@@ -750,6 +817,8 @@ char *pa_daemon_conf_dump(pa_daemon_conf *c) {
     pa_strbuf_printf(s, "nice-level = %i\n", c->nice_level);
     pa_strbuf_printf(s, "realtime-scheduling = %s\n", pa_yes_no(c->realtime_scheduling));
     pa_strbuf_printf(s, "realtime-priority = %i\n", c->realtime_priority);
+    pa_strbuf_printf(s, "cpu-affinity = %s\n", pa_strempty(c->cpu_affinity));
+    pa_strbuf_printf(s, "io-thread-cpu-affinity = %s\n", pa_strempty(c->io_cpu_affinity));
     pa_strbuf_printf(s, "allow-module-loading = %s\n", pa_yes_no(!c->disallow_module_loading));
     pa_strbuf_printf(s, "allow-exit = %s\n", pa_yes_no(!c->disallow_exit));
     pa_strbuf_printf(s, "use-pid-file = %s\n", pa_yes_no(c->use_pid_file));
@@ -760,9 +829,12 @@ char *pa_daemon_conf_dump(pa_daemon_conf *c) {
     pa_strbuf_printf(s, "cpu-limit = %s\n", pa_yes_no(!c->no_cpu_limit));
     pa_strbuf_printf(s, "enable-shm = %s\n", pa_yes_no(!c->disable_shm));
     pa_strbuf_printf(s, "flat-volumes = %s\n", pa_yes_no(c->flat_volumes));
+    pa_strbuf_printf(s, "subscription-coalesce-msec = %u\n", c->subscription_coalesce_msec);
     pa_strbuf_printf(s, "lock-memory = %s\n", pa_yes_no(c->lock_memory));
+    pa_strbuf_printf(s, "enable-huge-pages = %s\n", pa_yes_no(c->huge_pages));
     pa_strbuf_printf(s, "exit-idle-time = %i\n", c->exit_idle_time);
     pa_strbuf_printf(s, "scache-idle-time = %i\n", c->scache_idle_time);
+    pa_strbuf_printf(s, "shared-sample-player = %s\n", pa_yes_no(c->shared_sample_player));
     pa_strbuf_printf(s, "dl-search-path = %s\n", pa_strempty(c->dl_search_path));
     pa_strbuf_printf(s, "default-script-file = %s\n", pa_strempty(pa_daemon_conf_get_default_script_file(c)));
     pa_strbuf_printf(s, "load-default-script-file = %s\n", pa_yes_no(c->load_default_script_file));
@@ -771,6 +843,7 @@ char *pa_daemon_conf_dump(pa_daemon_conf *c) {
     pa_strbuf_printf(s, "resample-method = %s\n", pa_resample_method_to_string(c->resample_method));
     pa_strbuf_printf(s, "enable-remixing = %s\n", pa_yes_no(!c->disable_remixing));
     pa_strbuf_printf(s, "enable-lfe-remixing = %s\n", pa_yes_no(!c->disable_lfe_remixing));
+    pa_strbuf_printf(s, "enable-float32-mixing = %s\n", pa_yes_no(c->float32_mixing));
     pa_strbuf_printf(s, "default-sample-format = %s\n", pa_sample_format_to_string(c->default_sample_spec.format));
     pa_strbuf_printf(s, "default-sample-rate = %u\n", c->default_sample_spec.rate);
     pa_strbuf_printf(s, "alternate-sample-rate = %u\n", c->alternate_sample_rate);
@@ -781,7 +854,13 @@ char *pa_daemon_conf_dump(pa_daemon_conf *c) {
     pa_strbuf_printf(s, "enable-deferred-volume = %s\n", pa_yes_no(c->deferred_volume));
     pa_strbuf_printf(s, "deferred-volume-safety-margin-usec = %u\n", c->deferred_volume_safety_margin_usec);
     pa_strbuf_printf(s, "deferred-volume-extra-delay-usec = %d\n", c->deferred_volume_extra_delay_usec);
+    pa_strbuf_printf(s, "sink-input-history-msec = %i\n", c->sink_input_history_msec);
+    pa_strbuf_printf(s, "volume-ramp-msec = %u\n", c->volume_ramp_msec);
     pa_strbuf_printf(s, "shm-size-bytes = %lu\n", (unsigned long) c->shm_size);
+    pa_strbuf_printf(s, "shm-slot-size-bytes = %lu\n", (unsigned long) c->shm_slot_size);
+    pa_strbuf_printf(s, "shm-small-slot-size-bytes = %lu\n", (unsigned long) c->shm_small_slot_size);
+    pa_strbuf_printf(s, "memory-budget-bytes = %lu\n", (unsigned long) c->memory_budget);
+    pa_strbuf_printf(s, "client-memory-budget-bytes = %lu\n", (unsigned long) c->client_memory_budget);
     pa_strbuf_printf(s, "log-meta = %s\n", pa_yes_no(c->log_meta));
     pa_strbuf_printf(s, "log-time = %s\n", pa_yes_no(c->log_time));
     pa_strbuf_printf(s, "log-backtrace = %u\n", c->log_backtrace);
@@ -70,13 +70,16 @@ typedef struct pa_daemon_conf {
         disable_shm,
         disable_remixing,
         disable_lfe_remixing,
+        float32_mixing,
         load_default_script_file,
         disallow_exit,
         log_meta,
         log_time,
         flat_volumes,
         lock_memory,
-        deferred_volume;
+        huge_pages,
+        deferred_volume,
+        shared_sample_player;
     pa_server_type_t local_server_type;
     int exit_idle_time,
         scache_idle_time,
@@ -85,6 +88,7 @@ typedef struct pa_daemon_conf {
         nice_level,
         resample_method;
     char *script_commands, *dl_search_path, *default_script_file;
+    char *cpu_affinity, *io_cpu_affinity;
     pa_log_target_t log_target;
     pa_log_level_t log_level;
     unsigned log_backtrace;
@@ -130,10 +134,14 @@ typedef struct pa_daemon_conf {
     unsigned default_n_fragments, default_fragment_size_msec;
     unsigned deferred_volume_safety_margin_usec;
     int deferred_volume_extra_delay_usec;
+    int sink_input_history_msec;
+    unsigned volume_ramp_msec;
+    unsigned subscription_coalesce_msec;
     pa_sample_spec default_sample_spec;
     uint32_t alternate_sample_rate;
     pa_channel_map default_channel_map;
-    size_t shm_size;
+    size_t shm_size, shm_slot_size, shm_small_slot_size;
+    size_t memory_budget, client_memory_budget;
 } pa_daemon_conf;
 
 /* Allocate a new structure and fill it with sane defaults */
@@ -31,6 +31,7 @@
 #include <stdio.h>
 #include <signal.h>
 #include <stddef.h>
+#include <fcntl.h>
 #include <ltdl.h>
 #include <limits.h>
 #include <unistd.h>
@@ -58,6 +59,10 @@
 #include <dbus/dbus.h>
 #endif
 
+#ifdef HAVE_SYSTEMD
+#include <systemd/sd-daemon.h>
+#endif
+
 #include <pulse/client-conf.h>
 #ifdef HAVE_X11
 #include <pulse/client-conf-x11.h>
@@ -70,6 +75,7 @@
 #include <pulsecore/i18n.h>
 #include <pulsecore/lock-autospawn.h>
 #include <pulsecore/socket.h>
+#include <pulsecore/socket-server.h>
 #include <pulsecore/core-error.h>
 #include <pulsecore/core-rtclock.h>
 #include <pulsecore/core-scache.h>
@@ -92,6 +98,7 @@
 #include <pulsecore/cpu-arm.h>
 #include <pulsecore/cpu-x86.h>
 #include <pulsecore/cpu-orc.h>
+#include <pulsecore/trace.h>
 
 #include "cmdline.h"
 #include "cpulimit.h"
@@ -101,6 +108,10 @@
 #include "ltdl-bind-now.h"
 #include "server-lookup.h"
 
+#ifdef HAVE_BUILTIN_MODULES
+#include "builtin-modules.h"
+#endif
+
 #ifdef HAVE_LIBWRAP
 /* Only one instance of these variables */
 int allow_severity = LOG_INFO;
@@ -156,6 +167,7 @@ static void signal_callback(pa_mainloop_api*m, pa_signal_event *e, int sig, void
             char *c = pa_full_status_string(userdata);
             pa_log_notice("%s", c);
             pa_xfree(c);
+            pa_trace_dump();
             return;
         }
 #endif
@@ -392,6 +404,76 @@ fail:
 }
 #endif
 
+/* Closes everything we might have inherited, except passed_fd and the
+ * sockets the service manager handed over for socket activation, which
+ * the protocol modules pick up later */
+static void close_all_but_passed(int passed_fd) {
+#ifdef HAVE_SYSTEMD
+    int n, i, *except;
+
+    if ((n = sd_listen_fds(0)) > 0) {
+        except = pa_xnew(int, n + 2);
+
+        for (i = 0; i < n; i++)
+            except[i] = SD_LISTEN_FDS_START + i;
+
+        except[n] = passed_fd;
+        except[n + 1] = -1;
+
+        pa_close_allv(except);
+        pa_xfree(except);
+        return;
+    }
+#endif
+
+    pa_close_all(passed_fd, -1);
+}
+
+#ifdef HAVE_SYSTEMD
+#define MAX_HANDOVER_FDS 16
+
+/* Executes ourselves again, passing the listening sockets in fds the
+ * same way a service manager does for socket activation. Only returns
+ * on failure. */
+static void restart_with_sockets(int argc, char *argv[], int *fds, unsigned n) {
+    char **nargv;
+    char t[32];
+    unsigned i;
+    int j;
+
+    /* Move them out of the way first, so that none of them is closed
+     * by the dup2() below before it has been moved itself */
+    for (i = 0; i < n; i++)
+        if ((fds[i] = fcntl(fds[i], F_DUPFD_CLOEXEC, SD_LISTEN_FDS_START + (int) n)) < 0) {
+            pa_log(_("fcntl(F_DUPFD_CLOEXEC) failed: %s"), pa_cstrerror(errno));
+            return;
+        }
+
+    for (i = 0; i < n; i++)
+        if (dup2(fds[i], SD_LISTEN_FDS_START + (int) i) < 0) {
+            pa_log(_("dup2() failed: %s"), pa_cstrerror(errno));
+            return;
+        }
+
+    pa_snprintf(t, sizeof(t), "%u", n);
+    pa_set_env("LISTEN_FDS", t);
+    pa_snprintf(t, sizeof(t), "%lu", (unsigned long) getpid());
+    pa_set_env("LISTEN_PID", t);
+
+    /* We are in the background already if we are supposed to be */
+    nargv = pa_xnew(char*, argc + 2);
+    for (j = 0; j < argc; j++)
+        nargv[j] = argv[j];
+    nargv[argc] = (char*) "--daemonize=no";
+    nargv[argc + 1] = NULL;
+
+    execv(PA_BINARY, nargv);
+
+    pa_log(_("Failed to restart daemon: %s"), pa_cstrerror(errno));
+    pa_xfree(nargv);
+}
+#endif
+
 int main(int argc, char *argv[]) {
     pa_core *c = NULL;
     pa_strbuf *buf = NULL;
@@ -414,6 +496,11 @@ int main(int argc, char *argv[]) {
 #endif
     int autospawn_fd = -1;
     pa_bool_t autospawn_locked = FALSE;
+#ifdef HAVE_SYSTEMD
+    int handover_fds[MAX_HANDOVER_FDS];
+    unsigned n_handover_fds = 0;
+    pa_bool_t restart = FALSE;
+#endif
 #ifdef HAVE_DBUS
     pa_dbusobj_server_lookup *server_lookup = NULL; /* /org/pulseaudio/server_lookup */
     pa_dbus_connection *lookup_service_bus = NULL; /* Always the user bus. */
@@ -476,7 +563,7 @@ int main(int argc, char *argv[]) {
 
     pa_reset_personality();
     pa_drop_root();
-    pa_close_all(passed_fd, -1);
+    close_all_but_passed(passed_fd);
     pa_reset_sigs(-1);
     pa_unblock_sigs(-1);
     pa_reset_priority();
@@ -538,6 +625,12 @@ int main(int argc, char *argv[]) {
     if (conf->dl_search_path)
         lt_dlsetsearchpath(conf->dl_search_path);
 
+#ifdef HAVE_BUILTIN_MODULES
+    /* Loading these needs neither a search through the module
+     * directory nor symbol lookups */
+    pa_module_set_builtin(pa_builtin_modules);
+#endif
+
 #ifdef OS_IS_WIN32
     {
         WSADATA data;
@@ -892,6 +985,10 @@ int main(int argc, char *argv[]) {
 
     pa_raise_priority(conf->nice_level);
 
+    /* Everything we start from here on inherits this */
+    if (conf->cpu_affinity && pa_set_thread_affinity(conf->cpu_affinity) < 0)
+        pa_log_warn(_("Failed to pin to CPUs %s: %s"), conf->cpu_affinity, pa_cstrerror(errno));
+
     if (conf->system_instance)
         if (change_user() < 0)
             goto finish;
@@ -1005,13 +1102,20 @@ int main(int argc, char *argv[]) {
 
     pa_memtrap_install();
 
+    /* After daemonizing, the thread would not survive the fork() */
+    pa_log_start_async();
+    pa_trace_init();
+
     pa_assert_se(mainloop = pa_mainloop_new());
 
-    if (!(c = pa_core_new(pa_mainloop_get_api(mainloop), !conf->disable_shm, conf->shm_size))) {
+    if (!(c = pa_core_new(pa_mainloop_get_api(mainloop), !conf->disable_shm, conf->shm_size, conf->shm_slot_size, conf->shm_small_slot_size))) {
         pa_log(_("pa_core_new() failed."));
         goto finish;
     }
 
+    if (conf->huge_pages)
+        pa_mempool_enable_huge_pages(c->mempool);
+
     c->default_sample_spec = conf->default_sample_spec;
     c->alternate_sample_rate = conf->alternate_sample_rate;
     c->default_channel_map = conf->default_channel_map;
@@ -1019,17 +1123,30 @@ int main(int argc, char *argv[]) {
     c->default_fragment_size_msec = conf->default_fragment_size_msec;
     c->deferred_volume_safety_margin_usec = conf->deferred_volume_safety_margin_usec;
     c->deferred_volume_extra_delay_usec = conf->deferred_volume_extra_delay_usec;
+    c->sink_input_history_msec = conf->sink_input_history_msec;
+    pa_mem_account_set_budget(c->mem_account, conf->memory_budget);
+    c->client_memory_budget = conf->client_memory_budget;
+    c->volume_ramp_msec = conf->volume_ramp_msec;
     c->exit_idle_time = conf->exit_idle_time;
     c->scache_idle_time = conf->scache_idle_time;
     c->resample_method = conf->resample_method;
     c->realtime_priority = conf->realtime_priority;
+    c->io_cpu_affinity = pa_xstrdup(conf->io_cpu_affinity);
     c->realtime_scheduling = !!conf->realtime_scheduling;
     c->disable_remixing = !!conf->disable_remixing;
     c->disable_lfe_remixing = !!conf->disable_lfe_remixing;
+    c->float32_mixing = !!conf->float32_mixing;
     c->deferred_volume = !!conf->deferred_volume;
+    c->shared_sample_player = !!conf->shared_sample_player;
     c->running_as_daemon = !!conf->daemonize;
     c->disallow_exit = conf->disallow_exit;
+#ifdef HAVE_SYSTEMD
+    /* The new daemon picks up the sockets like activated ones. A system
+     * instance couldn't set itself up again without root. */
+    c->disallow_restart = conf->system_instance;
+#endif
     c->flat_volumes = conf->flat_volumes;
+    c->subscription_coalesce_usec = (pa_usec_t) conf->subscription_coalesce_msec * PA_USEC_PER_MSEC;
 #ifdef HAVE_DBUS
     c->server_type = conf->local_server_type;
 #endif
@@ -1137,6 +1254,13 @@ int main(int argc, char *argv[]) {
 
     pa_log_info(_("Daemon shutdown initiated."));
 
+#ifdef HAVE_SYSTEMD
+    /* Clients connecting from now on wait in the backlog of the
+     * sockets until the new daemon accepts them */
+    if ((restart = c->restart_requested))
+        n_handover_fds = pa_socket_server_keep_unix(handover_fds, MAX_HANDOVER_FDS);
+#endif
+
 finish:
 #ifdef HAVE_DBUS
     if (server_bus)
@@ -1174,6 +1298,9 @@ finish:
 
     pa_signal_done();
 
+    pa_trace_done();
+    pa_log_stop_async();
+
 #ifdef HAVE_FORK
     /* If we have daemon_pipe[1] still open, this means we've failed after
      * the first fork, but before the second. Therefore just write to it. */
@@ -1209,5 +1336,12 @@ finish:
     dbus_shutdown();
 #endif
 
+#ifdef HAVE_SYSTEMD
+    if (restart) {
+        pa_log_info(_("Restarting daemon."));
+        restart_with_sockets(argc, argv, handover_fds, n_handover_fds);
+    }
+#endif
+
     return retval;
 }
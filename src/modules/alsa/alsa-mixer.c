@@ -33,6 +33,7 @@
 #endif
 
 #include <pulse/mainloop-api.h>
+#include <pulse/rtclock.h>
 #include <pulse/sample.h>
 #include <pulse/timeval.h>
 #include <pulse/util.h>
@@ -884,6 +885,23 @@ static int element_get_nearest_alsa_dB(snd_mixer_elem_t *me, snd_mixer_selem_cha
     return r;
 }
 
+/* Reads what the mixer library last saw of the hardware, this doesn't
+ * talk to the driver */
+static int element_get_raw_volume(pa_alsa_element *e, snd_mixer_elem_t *me, snd_mixer_selem_channel_id_t c, long *value) {
+
+    if (e->direction == PA_ALSA_DIRECTION_OUTPUT) {
+        if (!snd_mixer_selem_has_playback_channel(me, c))
+            return -1;
+
+        return snd_mixer_selem_get_playback_volume(me, c, value);
+    }
+
+    if (!snd_mixer_selem_has_capture_channel(me, c))
+        return -1;
+
+    return snd_mixer_selem_get_capture_volume(me, c, value);
+}
+
 static int element_set_volume(pa_alsa_element *e, snd_mixer_t *m, const pa_channel_map *cm, pa_cvolume *v, pa_bool_t deferred_volume, pa_bool_t write_to_hw) {
 
     snd_mixer_selem_id_t *sid;
@@ -909,8 +927,9 @@ static int element_set_volume(pa_alsa_element *e, snd_mixer_t *m, const pa_chann
 
     for (c = 0; c <= SND_MIXER_SCHN_LAST; c++) {
         int r;
-        pa_volume_t f = PA_VOLUME_MUTED;
+        pa_volume_t f = PA_VOLUME_MUTED, request;
         pa_bool_t found = FALSE;
+        long raw;
 
         for (k = 0; k < cm->channels; k++)
             if (e->masks[c][e->n_channels-1] & PA_CHANNEL_POSITION_MASK(cm->map[k])) {
@@ -926,7 +945,15 @@ static int element_set_volume(pa_alsa_element *e, snd_mixer_t *m, const pa_chann
             f = pa_cvolume_max(v);
         }
 
-        if (e->has_dB) {
+        request = f;
+
+        if (write_to_hw && e->cached[c] && e->cached_request[c] == f &&
+            element_get_raw_volume(e, me, c, &raw) >= 0 && raw == e->cached_raw[c]) {
+
+            /* Nothing changed since we set this the last time */
+            f = e->cached_result[c];
+
+        } else if (e->has_dB) {
             long value = to_alsa_dB(f);
             int rounding;
 
@@ -1028,6 +1055,12 @@ static int element_set_volume(pa_alsa_element *e, snd_mixer_t *m, const pa_chann
             f = from_alsa_volume(value, e->min_volume, e->max_volume);
         }
 
+        if (write_to_hw) {
+            e->cached[c] = element_get_raw_volume(e, me, c, &e->cached_raw[c]) >= 0;
+            e->cached_request[c] = request;
+            e->cached_result[c] = f;
+        }
+
         for (k = 0; k < cm->channels; k++)
             if (e->masks[c][e->n_channels-1] & PA_CHANNEL_POSITION_MASK(cm->map[k]))
                 if (rv.values[k] < f)
@@ -1085,6 +1118,34 @@ int pa_alsa_path_set_volume(pa_alsa_path *p, snd_mixer_t *m, const pa_channel_ma
     return 0;
 }
 
+/* Whether all channels of the switch already are at b */
+static pa_bool_t element_switch_is(pa_alsa_element *e, snd_mixer_elem_t *me, pa_bool_t b) {
+    snd_mixer_selem_channel_id_t c;
+
+    for (c = 0; c <= SND_MIXER_SCHN_LAST; c++) {
+        int value;
+
+        if (e->direction == PA_ALSA_DIRECTION_OUTPUT) {
+            if (!snd_mixer_selem_has_playback_channel(me, c))
+                continue;
+
+            if (snd_mixer_selem_get_playback_switch(me, c, &value) < 0)
+                return FALSE;
+        } else {
+            if (!snd_mixer_selem_has_capture_channel(me, c))
+                continue;
+
+            if (snd_mixer_selem_get_capture_switch(me, c, &value) < 0)
+                return FALSE;
+        }
+
+        if (!value != !b)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
 static int element_set_switch(pa_alsa_element *e, snd_mixer_t *m, pa_bool_t b) {
     snd_mixer_elem_t *me;
     snd_mixer_selem_id_t *sid;
@@ -1099,6 +1160,9 @@ static int element_set_switch(pa_alsa_element *e, snd_mixer_t *m, pa_bool_t b) {
         return -1;
     }
 
+    if (element_switch_is(e, me, b))
+        return 0;
+
     if (e->direction == PA_ALSA_DIRECTION_OUTPUT)
         r = snd_mixer_selem_set_playback_switch_all(me, b);
     else
@@ -3822,7 +3886,7 @@ fail:
 }
 
 static void mapping_paths_probe(pa_alsa_mapping *m, pa_alsa_profile *profile,
-                                pa_alsa_direction_t direction) {
+                                pa_alsa_direction_t direction, int alsa_card_index) {
 
     pa_alsa_path *p;
     void *state;
@@ -3846,9 +3910,13 @@ static void mapping_paths_probe(pa_alsa_mapping *m, pa_alsa_profile *profile,
     if (!ps)
         return; /* No paths */
 
-    pa_assert(pcm_handle);
-
-    mixer_handle = pa_alsa_open_mixer_for_pcm(pcm_handle, NULL, &hctl_handle);
+    /* Without an open PCM we go for the mixer of the whole card */
+    if (pcm_handle)
+        mixer_handle = pa_alsa_open_mixer_for_pcm(pcm_handle, NULL, &hctl_handle);
+    else {
+        pa_assert(alsa_card_index >= 0);
+        mixer_handle = pa_alsa_open_mixer(alsa_card_index, NULL, &hctl_handle);
+    }
     if (!mixer_handle || !hctl_handle) {
          /* Cannot open mixer, remove all entries */
         while (pa_hashmap_steal_first(ps->paths));
@@ -4343,7 +4411,9 @@ static snd_pcm_t* mapping_open_pcm(pa_alsa_mapping *m,
     try_buffer_size = default_n_fragments * try_period_size;
 
     return pa_alsa_open_by_template(
-                              m->device_strings, dev_id, NULL, &try_ss,
+                              m->device_strings,
+                              mode == SND_PCM_STREAM_PLAYBACK ? &m->output_device_index : &m->input_device_index,
+                              dev_id, NULL, &try_ss,
                               &try_map, mode, &try_period_size,
                               &try_buffer_size, 0, NULL, NULL, TRUE);
 }
@@ -4365,6 +4435,29 @@ static void paths_drop_unsupported(pa_hashmap* h) {
     }
 }
 
+static void profile_set_drop_unsupported(pa_alsa_profile_set *ps) {
+    void *state;
+    pa_alsa_profile *p;
+    pa_alsa_mapping *m;
+
+    PA_HASHMAP_FOREACH(p, ps->profiles, state)
+        if (!p->supported) {
+            pa_hashmap_remove(ps->profiles, p->name);
+            profile_free(p);
+        }
+
+    PA_HASHMAP_FOREACH(m, ps->mappings, state)
+        if (m->supported <= 0) {
+            pa_hashmap_remove(ps->mappings, m->name);
+            mapping_free(m);
+        }
+
+    paths_drop_unsupported(ps->input_paths);
+    paths_drop_unsupported(ps->output_paths);
+
+    ps->probed = TRUE;
+}
+
 void pa_alsa_profile_set_probe(
         pa_alsa_profile_set *ps,
         const char *dev_id,
@@ -4375,6 +4468,7 @@ void pa_alsa_profile_set_probe(
     void *state;
     pa_alsa_profile *p, *last = NULL;
     pa_alsa_mapping *m;
+    pa_usec_t begin;
 
     pa_assert(ps);
     pa_assert(dev_id);
@@ -4383,6 +4477,8 @@ void pa_alsa_profile_set_probe(
     if (ps->probed)
         return;
 
+    begin = pa_rtclock_now();
+
     PA_HASHMAP_FOREACH(p, ps->profiles, state) {
         uint32_t idx;
 
@@ -4437,33 +4533,70 @@ void pa_alsa_profile_set_probe(
         if (p->output_mappings)
             PA_IDXSET_FOREACH(m, p->output_mappings, idx)
                 if (m->output_pcm)
-                    mapping_paths_probe(m, p, PA_ALSA_DIRECTION_OUTPUT);
+                    mapping_paths_probe(m, p, PA_ALSA_DIRECTION_OUTPUT, -1);
 
         if (p->input_mappings)
             PA_IDXSET_FOREACH(m, p->input_mappings, idx)
                 if (m->input_pcm)
-                    mapping_paths_probe(m, p, PA_ALSA_DIRECTION_INPUT);
+                    mapping_paths_probe(m, p, PA_ALSA_DIRECTION_INPUT, -1);
     }
 
     /* Clean up */
     profile_finalize_probing(last, NULL);
 
-    PA_HASHMAP_FOREACH(p, ps->profiles, state)
-        if (!p->supported) {
-            pa_hashmap_remove(ps->profiles, p->name);
-            profile_free(p);
-        }
+    profile_set_drop_unsupported(ps);
 
-    PA_HASHMAP_FOREACH(m, ps->mappings, state)
-        if (m->supported <= 0) {
-            pa_hashmap_remove(ps->mappings, m->name);
-            mapping_free(m);
-        }
+    pa_log_debug("Probed profiles of %s in %0.1f ms.", dev_id, (double) (pa_rtclock_now() - begin) / PA_USEC_PER_MSEC);
+}
 
-    paths_drop_unsupported(ps->input_paths);
-    paths_drop_unsupported(ps->output_paths);
+int pa_alsa_profile_set_probe_cached(pa_alsa_profile_set *ps, int alsa_card_index, const char *supported) {
+    void *state;
+    pa_alsa_profile *p;
+    pa_alsa_mapping *m;
+    const char *sp = NULL;
+    char *n;
 
-    ps->probed = TRUE;
+    pa_assert(ps);
+    pa_assert(alsa_card_index >= 0);
+    pa_assert(supported);
+
+    if (ps->probed)
+        return 0;
+
+    /* The profile set file may have changed since */
+    while ((n = pa_split_spaces(supported, &sp))) {
+        p = pa_hashmap_get(ps->profiles, n);
+        pa_xfree(n);
+
+        if (!p)
+            return -1;
+    }
+
+    PA_HASHMAP_FOREACH(p, ps->profiles, state) {
+        uint32_t idx;
+
+        if (!p->supported && !pa_str_in_list_spaces(p->name, supported))
+            continue;
+
+        pa_log_debug("Profile %s supported.", p->name);
+        p->supported = TRUE;
+
+        if (p->output_mappings)
+            PA_IDXSET_FOREACH(m, p->output_mappings, idx) {
+                m->supported++;
+                mapping_paths_probe(m, p, PA_ALSA_DIRECTION_OUTPUT, alsa_card_index);
+            }
+
+        if (p->input_mappings)
+            PA_IDXSET_FOREACH(m, p->input_mappings, idx) {
+                m->supported++;
+                mapping_paths_probe(m, p, PA_ALSA_DIRECTION_INPUT, alsa_card_index);
+            }
+    }
+
+    profile_set_drop_unsupported(ps);
+
+    return 0;
 }
 
 void pa_alsa_profile_set_dump(pa_alsa_profile_set *ps) {
@@ -153,6 +153,15 @@ struct pa_alsa_element {
     PA_LLIST_HEAD(pa_alsa_option, options);
 
     pa_alsa_decibel_fix *db_fix;
+
+    /* What each channel was last asked to be set to, what it ended up
+     * as and the hardware value that was written for it. As long as
+     * the hardware still has that value, setting the same volume again
+     * doesn't need to touch it. */
+    pa_bool_t cached[SND_MIXER_SCHN_LAST + 1];
+    pa_volume_t cached_request[SND_MIXER_SCHN_LAST + 1];
+    pa_volume_t cached_result[SND_MIXER_SCHN_LAST + 1];
+    long cached_raw[SND_MIXER_SCHN_LAST + 1];
 };
 
 struct pa_alsa_jack {
@@ -249,6 +258,10 @@ struct pa_alsa_mapping {
 
     char **device_strings;
 
+    /* The entry of device_strings that could be opened last, for
+     * each direction */
+    unsigned input_device_index, output_device_index;
+
     char **input_path_names;
     char **output_path_names;
     char **input_element; /* list of fallbacks */
@@ -316,6 +329,10 @@ void pa_alsa_decibel_fix_dump(pa_alsa_decibel_fix *db_fix);
 
 pa_alsa_profile_set* pa_alsa_profile_set_new(const char *fname, const pa_channel_map *bonus);
 void pa_alsa_profile_set_probe(pa_alsa_profile_set *ps, const char *dev_id, const pa_sample_spec *ss, unsigned default_n_fragments, unsigned default_fragment_size_msec);
+/* Like pa_alsa_profile_set_probe(), but takes the space separated names
+ * of the supported profiles from an earlier probe instead of opening
+ * the PCMs. Fails without touching ps if a name is unknown. */
+int pa_alsa_profile_set_probe_cached(pa_alsa_profile_set *ps, int alsa_card_index, const char *supported);
 void pa_alsa_profile_set_free(pa_alsa_profile_set *s);
 void pa_alsa_profile_set_dump(pa_alsa_profile_set *s);
 
@@ -0,0 +1,421 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-error.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/database.h>
+#include <pulsecore/llist.h>
+#include <pulsecore/log.h>
+#include <pulsecore/shared.h>
+#include <pulsecore/strbuf.h>
+#include <pulsecore/thread.h>
+
+#include <modules/reserve-wrap.h>
+
+#ifdef HAVE_UDEV
+#include <modules/udev-util.h>
+#endif
+
+#include "alsa-util.h"
+#include "alsa-probe.h"
+
+/* Bump this whenever the probing changes in ways that could make
+ * results cached by older versions wrong */
+#define PROBE_CACHE_VERSION 1
+
+/* Results of a pa_alsa_prober, shared under the name of the card */
+struct probed {
+    char *key;
+    pa_bool_t ignore_dB;
+    pa_alsa_profile_set *profile_set;
+};
+
+struct job {
+    char *device_id;
+    char *shared_name;
+    struct probed *probed;
+    pa_reserve_wrapper *reserve;
+
+    pa_sample_spec ss;
+    unsigned n_fragments, fragment_size_msec;
+
+    pa_thread *thread;
+
+    PA_LLIST_FIELDS(struct job);
+};
+
+struct pa_alsa_prober {
+    pa_core *core;
+    pa_database *database;
+
+    PA_LLIST_HEAD(struct job, jobs);
+};
+
+/* Everything the probe results depend on: which card this is and what
+ * its driver exposes, with which profile set and defaults it is
+ * probed. Returns NULL if the card can't be told apart from others. */
+static char *cache_key(pa_core *c, int alsa_card_index, const char *fname) {
+    char *id = NULL, *driver, *ctl, *key;
+    const char *components;
+    pa_proplist *p;
+    char ss[PA_SAMPLE_SPEC_SNPRINT_MAX];
+
+#ifdef HAVE_UDEV
+    id = pa_udev_get_property(alsa_card_index, "ID_ID");
+#endif
+
+    if (!id) {
+        char *lcn;
+
+        /* Includes the bus address, at least for USB and PCI cards */
+        if (snd_card_get_longname(alsa_card_index, &lcn) < 0)
+            return NULL;
+
+        id = pa_xstrdup(lcn);
+        free(lcn);
+    }
+
+    driver = pa_alsa_get_driver_name(alsa_card_index);
+
+    p = pa_proplist_new();
+    ctl = pa_sprintf_malloc("hw:%i", alsa_card_index);
+    pa_alsa_init_proplist_ctl(p, ctl);
+    components = pa_proplist_gets(p, "alsa.components");
+
+    key = pa_sprintf_malloc("%u|%s|%s|%s|%s|%s|%u|%u",
+                            PROBE_CACHE_VERSION,
+                            id,
+                            pa_strnull(driver),
+                            pa_strnull(components),
+                            fname ? fname : "default",
+                            pa_sample_spec_snprint(ss, sizeof(ss), &c->default_sample_spec),
+                            c->default_n_fragments,
+                            c->default_fragment_size_msec);
+
+    pa_proplist_free(p);
+    pa_xfree(ctl);
+    pa_xfree(driver);
+    pa_xfree(id);
+
+    return key;
+}
+
+static pa_database *cache_open(void) {
+    pa_database *db;
+    char *fname;
+
+    if (!(fname = pa_state_path("alsa-probe-cache", TRUE)))
+        return NULL;
+
+    if (!(db = pa_database_open(fname, TRUE)))
+        pa_log_warn("Failed to open probe cache '%s': %s", fname, pa_cstrerror(errno));
+
+    pa_xfree(fname);
+    return db;
+}
+
+/* Returns the space separated names of the supported profiles */
+static char *cache_get(pa_database *db, const char *key) {
+    pa_datum k, data;
+    char *supported = NULL;
+
+    k.data = (void*) key;
+    k.size = strlen(key);
+
+    if (!pa_database_get(db, &k, &data))
+        return NULL;
+
+    if (data.size > 0 && ((const char*) data.data)[data.size - 1] == 0)
+        supported = pa_xstrdup(data.data);
+
+    pa_datum_free(&data);
+    return supported;
+}
+
+static void cache_put(pa_database *db, const char *key, pa_alsa_profile_set *ps) {
+    pa_alsa_profile *ap;
+    void *state;
+    pa_strbuf *buf;
+    char *supported;
+    pa_datum k, data;
+
+    buf = pa_strbuf_new();
+    PA_HASHMAP_FOREACH(ap, ps->profiles, state)
+        pa_strbuf_printf(buf, "%s%s", pa_strbuf_isempty(buf) ? "" : " ", ap->name);
+    supported = pa_strbuf_tostring_free(buf);
+
+    /* A card that doesn't work at all might just not be ready yet */
+    if (*supported) {
+        k.data = (void*) key;
+        k.size = strlen(key);
+        data.data = supported;
+        data.size = strlen(supported) + 1;
+
+        if (pa_database_set(db, &k, &data, TRUE) >= 0)
+            pa_database_sync(db);
+    }
+
+    pa_xfree(supported);
+}
+
+static void probed_free(struct probed *pr) {
+    pa_assert(pr);
+
+    if (pr->profile_set)
+        pa_alsa_profile_set_free(pr->profile_set);
+
+    pa_xfree(pr->key);
+    pa_xfree(pr);
+}
+
+static char *shared_name(const char *device_id) {
+    return pa_sprintf_malloc("alsa-probed-profile-set-%s", device_id);
+}
+
+pa_alsa_profile_set* pa_alsa_probe_profile_set(
+        pa_core *c,
+        const char *device_id,
+        int alsa_card_index,
+        const char *fname,
+        pa_bool_t ignore_dB,
+        pa_bool_t reprobe) {
+
+    pa_alsa_profile_set *ps = NULL;
+    pa_database *db = NULL;
+    struct probed *pr;
+    char *key, *name;
+
+    pa_assert(c);
+    pa_assert(device_id);
+    pa_assert(alsa_card_index >= 0);
+
+    key = cache_key(c, alsa_card_index, fname);
+
+    name = shared_name(device_id);
+    if ((pr = pa_shared_get(c, name))) {
+        pa_shared_remove(c, name);
+
+        if (!reprobe && key && pa_streq(pr->key, key) && pr->ignore_dB == ignore_dB) {
+            pa_log_info("Using results of the early probe for card %s.", device_id);
+            ps = pr->profile_set;
+            pr->profile_set = NULL;
+        }
+
+        probed_free(pr);
+    }
+    pa_xfree(name);
+
+    if (!ps) {
+        if (!(ps = pa_alsa_profile_set_new(fname, &c->default_channel_map))) {
+            pa_xfree(key);
+            return NULL;
+        }
+
+        ps->ignore_dB = ignore_dB;
+    }
+
+    if (key)
+        db = cache_open();
+
+    if (db && !ps->probed && !reprobe) {
+        char *supported;
+
+        if ((supported = cache_get(db, key))) {
+            if (pa_alsa_profile_set_probe_cached(ps, alsa_card_index, supported) >= 0) {
+                pa_log_info("Using cached probe results for card %s.", device_id);
+                pa_database_close(db);
+                db = NULL;
+            } else
+                pa_log_info("Discarding invalid cached probe results for card %s.", device_id);
+
+            pa_xfree(supported);
+        }
+    }
+
+    pa_alsa_profile_set_probe(ps, device_id, &c->default_sample_spec, c->default_n_fragments, c->default_fragment_size_msec);
+
+    if (db) {
+        cache_put(db, key, ps);
+        pa_database_close(db);
+    }
+
+    pa_xfree(key);
+
+    return ps;
+}
+
+pa_alsa_prober* pa_alsa_prober_new(pa_core *c) {
+    pa_alsa_prober *p;
+
+    pa_assert(c);
+
+    p = pa_xnew0(pa_alsa_prober, 1);
+    p->core = c;
+    p->database = cache_open();
+    PA_LLIST_HEAD_INIT(struct job, p->jobs);
+
+    return p;
+}
+
+static void probe_thread(void *userdata) {
+    struct job *j = userdata;
+
+    pa_alsa_profile_set_probe(j->probed->profile_set, j->device_id, &j->ss, j->n_fragments, j->fragment_size_msec);
+}
+
+void pa_alsa_prober_add(pa_alsa_prober *p, const char *device_id, pa_bool_t ignore_dB) {
+    struct job *j;
+    char *fn = NULL, *key, *supported;
+    int alsa_card_index;
+
+    pa_assert(p);
+    pa_assert(device_id);
+
+    if ((alsa_card_index = snd_card_get_index(device_id)) < 0)
+        return;
+
+#ifdef HAVE_UDEV
+    fn = pa_udev_get_property(alsa_card_index, "PULSE_PROFILE_SET");
+#endif
+
+    /* Without a key the results couldn't be matched to the card later */
+    if (!(key = cache_key(p->core, alsa_card_index, fn))) {
+        pa_xfree(fn);
+        return;
+    }
+
+    /* Loading from the cache is quick enough */
+    if (p->database && (supported = cache_get(p->database, key))) {
+        pa_xfree(supported);
+        pa_xfree(key);
+        pa_xfree(fn);
+        return;
+    }
+
+    j = pa_xnew0(struct job, 1);
+    j->device_id = pa_xstrdup(device_id);
+    j->shared_name = shared_name(device_id);
+    j->probed = pa_xnew0(struct probed, 1);
+    j->probed->key = key;
+    j->probed->ignore_dB = ignore_dB;
+    j->ss = p->core->default_sample_spec;
+    j->n_fragments = p->core->default_n_fragments;
+    j->fragment_size_msec = p->core->default_fragment_size_msec;
+    PA_LLIST_INIT(struct job, j);
+
+    /* Hold the device reservation like module-alsa-card would */
+    if (!pa_in_system_mode()) {
+        char *rname;
+
+        if ((rname = pa_alsa_get_reserve_name(device_id))) {
+            j->reserve = pa_reserve_wrapper_get(p->core, rname);
+            pa_xfree(rname);
+
+            if (!j->reserve)
+                goto fail;
+        }
+    }
+
+    if (!(j->probed->profile_set = pa_alsa_profile_set_new(fn, &p->core->default_channel_map)))
+        goto fail;
+
+    j->probed->profile_set->ignore_dB = ignore_dB;
+
+    if (!(j->thread = pa_thread_new("alsa-probe", probe_thread, j))) {
+        pa_log_warn("Failed to create probe thread for card %s.", device_id);
+        goto fail;
+    }
+
+    pa_log_debug("Probing card %s in the background.", device_id);
+
+    PA_LLIST_PREPEND(struct job, p->jobs, j);
+    pa_xfree(fn);
+    return;
+
+fail:
+    if (j->reserve)
+        pa_reserve_wrapper_unref(j->reserve);
+
+    probed_free(j->probed);
+    pa_xfree(j->shared_name);
+    pa_xfree(j->device_id);
+    pa_xfree(j);
+    pa_xfree(fn);
+}
+
+void pa_alsa_prober_wait(pa_alsa_prober *p) {
+    struct job *j;
+
+    pa_assert(p);
+
+    PA_LLIST_FOREACH(j, p->jobs) {
+        if (!j->thread)
+            continue;
+
+        pa_thread_free(j->thread);
+        j->thread = NULL;
+
+        if (pa_shared_set(p->core, j->shared_name, j->probed) < 0) {
+            probed_free(j->probed);
+            j->probed = NULL;
+        }
+    }
+
+    /* Now the cards may open the cache themselves */
+    if (p->database) {
+        pa_database_close(p->database);
+        p->database = NULL;
+    }
+}
+
+void pa_alsa_prober_free(pa_alsa_prober *p) {
+    struct job *j;
+
+    pa_assert(p);
+
+    pa_alsa_prober_wait(p);
+
+    while ((j = p->jobs)) {
+        PA_LLIST_REMOVE(struct job, p->jobs, j);
+
+        if (j->probed && pa_shared_get(p->core, j->shared_name) == j->probed) {
+            pa_shared_remove(p->core, j->shared_name);
+            probed_free(j->probed);
+        }
+
+        if (j->reserve)
+            pa_reserve_wrapper_unref(j->reserve);
+
+        pa_xfree(j->shared_name);
+        pa_xfree(j->device_id);
+        pa_xfree(j);
+    }
+
+    pa_xfree(p);
+}
@@ -0,0 +1,56 @@
+#ifndef fooalsaprobehfoo
+#define fooalsaprobehfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulsecore/core.h>
+
+#include "alsa-mixer.h"
+
+/* Returns the probed profile set of a card. The results are taken from
+ * a pa_alsa_prober that ran for the card, or else from the probe cache
+ * in the state directory, unless reprobe is set. Fresh results are
+ * added to the cache. */
+pa_alsa_profile_set* pa_alsa_probe_profile_set(
+        pa_core *c,
+        const char *device_id,
+        int alsa_card_index,
+        const char *fname,
+        pa_bool_t ignore_dB,
+        pa_bool_t reprobe);
+
+/* Probes the profile sets of several cards in parallel, each in its own
+ * thread, before the cards are loaded one after another. Cards whose
+ * results are cached are skipped. */
+typedef struct pa_alsa_prober pa_alsa_prober;
+
+pa_alsa_prober* pa_alsa_prober_new(pa_core *c);
+
+/* Starts probing a card with the profile set that udev asks for */
+void pa_alsa_prober_add(pa_alsa_prober *p, const char *device_id, pa_bool_t ignore_dB);
+
+/* Waits for all cards and leaves the results for
+ * pa_alsa_probe_profile_set() to pick up */
+void pa_alsa_prober_wait(pa_alsa_prober *p);
+
+/* Drops the results nobody picked up */
+void pa_alsa_prober_free(pa_alsa_prober *p);
+
+#endif
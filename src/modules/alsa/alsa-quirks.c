@@ -0,0 +1,239 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <asoundlib.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/conf-parser.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "alsa-util.h"
+#include "alsa-quirks.h"
+
+#define QUIRKS_FILE_USER "alsa-quirks.conf"
+#define QUIRKS_FILE_LOCAL PA_DEFAULT_CONFIG_DIR PA_PATH_SEP QUIRKS_FILE_USER
+
+struct parse_state {
+    const char *driver;
+    const char *card_id;
+
+    /* The entries for the driver only and the ones for the card */
+    pa_proplist *driver_quirks;
+    pa_proplist *card_quirks;
+};
+
+/* Returns the proplist the values of section go to, or NULL if the
+ * section is about some other card */
+static int section_get(struct parse_state *s, const char *filename, unsigned line, const char *section, pa_proplist **p) {
+    const char *driver, *id;
+    size_t l;
+
+    *p = NULL;
+
+    if (!section || !pa_startswith(section, "Card ")) {
+        pa_log("[%s:%u] Quirks have to be in a [Card ...] section.", filename, line);
+        return -1;
+    }
+
+    driver = section + 5;
+    l = strcspn(driver, " ");
+
+    if (l == 0) {
+        pa_log("[%s:%u] Section '%s' lacks the driver name.", filename, line, section);
+        return -1;
+    }
+
+    if (!s->driver || strlen(s->driver) != l || strncmp(driver, s->driver, l) != 0)
+        return 0;
+
+    id = driver + l + strspn(driver + l, " ");
+
+    if (!*id)
+        *p = s->driver_quirks;
+    else if (s->card_id && pa_streq(id, s->card_id))
+        *p = s->card_quirks;
+
+    return 0;
+}
+
+static int parse_bool(const char *filename, unsigned line, const char *section, const char *lvalue, const char *rvalue, void *data, void *userdata) {
+    pa_proplist *p;
+    int b;
+
+    pa_assert(filename);
+    pa_assert(lvalue);
+    pa_assert(rvalue);
+    pa_assert(data);
+
+    if (section_get(userdata, filename, line, section, &p) < 0)
+        return -1;
+
+    if ((b = pa_parse_boolean(rvalue)) < 0) {
+        pa_log("[%s:%u] Failed to parse boolean value: %s", filename, line, rvalue);
+        return -1;
+    }
+
+    if (p)
+        pa_proplist_sets(p, data, pa_yes_no(b));
+
+    return 0;
+}
+
+static int parse_unsigned(const char *filename, unsigned line, const char *section, const char *lvalue, const char *rvalue, void *data, void *userdata) {
+    pa_proplist *p;
+    uint32_t u;
+
+    pa_assert(filename);
+    pa_assert(lvalue);
+    pa_assert(rvalue);
+    pa_assert(data);
+
+    if (section_get(userdata, filename, line, section, &p) < 0)
+        return -1;
+
+    if (pa_atou(rvalue, &u) < 0 || u == 0) {
+        pa_log("[%s:%u] Failed to parse numeric value: %s", filename, line, rvalue);
+        return -1;
+    }
+
+    if (p)
+        pa_proplist_setf(p, data, "%u", u);
+
+    return 0;
+}
+
+pa_proplist* pa_alsa_quirks_parse(const char *fn, const char *driver, const char *card_id) {
+    struct parse_state s;
+
+    /* The data is the module argument the entry is passed as */
+    pa_config_item items[] = {
+        { "tsched",                  parse_bool,     (void*) "tsched",                  NULL },
+        { "tsched-buffer-size",      parse_unsigned, (void*) "tsched_buffer_size",      NULL },
+        { "tsched-buffer-watermark", parse_unsigned, (void*) "tsched_buffer_watermark", NULL },
+        { "fixed-latency-range",     parse_bool,     (void*) "fixed_latency_range",     NULL },
+        { "fragments",               parse_unsigned, (void*) "fragments",               NULL },
+        { "fragment-size",           parse_unsigned, (void*) "fragment_size",           NULL },
+        { NULL, NULL, NULL, NULL }
+    };
+
+    pa_assert(fn);
+
+    s.driver = driver;
+    s.card_id = card_id;
+    s.driver_quirks = pa_proplist_new();
+    s.card_quirks = pa_proplist_new();
+
+    if (pa_config_parse(fn, NULL, items, &s) < 0) {
+        pa_proplist_free(s.driver_quirks);
+        pa_proplist_free(s.card_quirks);
+        return NULL;
+    }
+
+    pa_proplist_update(s.driver_quirks, PA_UPDATE_REPLACE, s.card_quirks);
+    pa_proplist_free(s.card_quirks);
+
+    return s.driver_quirks;
+}
+
+static char *get_card_id(int alsa_card_index) {
+    snd_ctl_t *ctl;
+    snd_ctl_card_info_t *info;
+    char *name, *id = NULL;
+    int err;
+
+    snd_ctl_card_info_alloca(&info);
+
+    name = pa_sprintf_malloc("hw:%i", alsa_card_index);
+
+    if ((err = snd_ctl_open(&ctl, name, 0)) < 0) {
+        pa_log_warn("Error opening low-level control device '%s': %s", name, snd_strerror(err));
+        pa_xfree(name);
+        return NULL;
+    }
+
+    if ((err = snd_ctl_card_info(ctl, info)) >= 0)
+        id = pa_xstrdup(snd_ctl_card_info_get_id(info));
+    else
+        pa_log_warn("Control device %s card info: %s", name, snd_strerror(err));
+
+    snd_ctl_close(ctl);
+    pa_xfree(name);
+
+    return id;
+}
+
+pa_proplist* pa_alsa_quirks_get(int alsa_card_index) {
+    pa_proplist *quirks, *p;
+    char *driver, *card_id, *fn;
+    FILE *f;
+
+    pa_assert(alsa_card_index >= 0);
+
+    if (!(driver = pa_alsa_get_driver_name(alsa_card_index)))
+        return NULL;
+
+    card_id = get_card_id(alsa_card_index);
+    quirks = pa_proplist_new();
+
+    fn = pa_run_from_build_tree() ? pa_xstrdup(PA_BUILDDIR "/modules/alsa/mixer/quirks.conf") : pa_xstrdup(PA_ALSA_QUIRKS_FILE);
+
+    if ((p = pa_alsa_quirks_parse(fn, driver, card_id))) {
+        pa_proplist_update(quirks, PA_UPDATE_REPLACE, p);
+        pa_proplist_free(p);
+    }
+
+    pa_xfree(fn);
+
+    if ((f = pa_open_config_file(QUIRKS_FILE_LOCAL, QUIRKS_FILE_USER, NULL, &fn))) {
+        fclose(f);
+
+        if ((p = pa_alsa_quirks_parse(fn, driver, card_id))) {
+            pa_proplist_update(quirks, PA_UPDATE_REPLACE, p);
+            pa_proplist_free(p);
+        }
+
+        pa_xfree(fn);
+    }
+
+    if (pa_proplist_isempty(quirks)) {
+        pa_proplist_free(quirks);
+        quirks = NULL;
+    } else {
+        char *t;
+
+        t = pa_proplist_to_string_sep(quirks, " ");
+        pa_log_info("Using timing quirks for driver %s, card %s: %s",
+                    driver, pa_strnull(card_id), t);
+        pa_xfree(t);
+    }
+
+    pa_xfree(driver);
+    pa_xfree(card_id);
+
+    return quirks;
+}
@@ -0,0 +1,50 @@
+#ifndef fooalsaquirkshfoo
+#define fooalsaquirkshfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulse/proplist.h>
+
+/* The timing quirk database lists the scheduling parameters that are
+ * known to work for cards whose drivers misreport their pointer
+ * position or only do batch transfers. Entries are keyed by the
+ * kernel driver and optionally the ALSA card id:
+ *
+ *   [Card snd_usb_audio]
+ *   tsched = no
+ *
+ *   [Card snd_hda_intel Generic]
+ *   tsched-buffer-watermark = 35280
+ *
+ * The shipped database is read first, the one in the configuration
+ * directory second, so that the latter can override it. Within a file,
+ * entries with a card id take precedence over the ones for the driver
+ * only. */
+
+/* Parses a database into a proplist that maps the module arguments of
+ * module-alsa-card to the values the database has for the card. Returns
+ * NULL if the database is broken. */
+pa_proplist* pa_alsa_quirks_parse(const char *fn, const char *driver, const char *card_id);
+
+/* Looks up the quirks of a card in the shipped and the local database,
+ * in the same format. Returns NULL if there are none. */
+pa_proplist* pa_alsa_quirks_get(int alsa_card_index);
+
+#endif
@@ -54,11 +54,13 @@
 #include <pulsecore/thread-mq.h>
 #include <pulsecore/rtpoll.h>
 #include <pulsecore/time-smoother.h>
+#include <pulsecore/trace.h>
 
 #include <modules/reserve-wrap.h>
 
 #include "alsa-util.h"
 #include "alsa-sink.h"
+#include "alsa-watermark.h"
 
 /* #define DEBUG_TIMING */
 
@@ -90,6 +92,10 @@
 #define DEFAULT_REWIND_SAFEGUARD_BYTES (256U) /* 1.33ms @48kHz, we'll never rewind less than this */
 #define DEFAULT_REWIND_SAFEGUARD_USEC (1330) /* 1.33ms, depending on channels/rate/sample we may rewind more than 256 above */
 
+enum {
+    SINK_MESSAGE_UPDATE_PROPLIST = PA_SINK_MESSAGE_MAX
+};
+
 struct userdata {
     pa_core *core;
     pa_module *module;
@@ -108,6 +114,11 @@ struct userdata {
     pa_alsa_path_set *mixer_path_set;
     pa_alsa_path *mixer_path;
 
+    /* Mixer events are only looked at once per main loop (or IO
+     * thread) iteration, no matter how many elements changed */
+    pa_defer_event *mixer_update_event;
+    pa_bool_t mixer_changed;
+
     pa_cvolume hardware_volume;
 
     unsigned int *rates;
@@ -125,17 +136,23 @@ struct userdata {
         watermark_dec_step,
         watermark_inc_threshold,
         watermark_dec_threshold,
+        watermark_posted,
         rewind_safeguard;
 
     pa_usec_t watermark_dec_not_before;
     pa_usec_t min_latency_ref;
 
+    pa_alsa_watermark_ctl watermark_ctl;
+
     pa_memchunk memchunk;
 
     char *device_name;  /* name of the PCM device */
     char *control_device; /* name of the control device */
 
-    pa_bool_t use_mmap:1, use_tsched:1, deferred_volume:1, fixed_latency_range:1;
+    pa_bool_t use_mmap:1, use_tsched:1, deferred_volume:1, fixed_latency_range:1, use_audio_tstamp:1;
+
+    int32_t rtprio;
+    char *cpu_affinity;
 
     pa_bool_t first, after_rewind;
 
@@ -144,6 +161,7 @@ struct userdata {
     pa_smoother *smoother;
     uint64_t write_count;
     uint64_t since_start;
+    uint64_t start_count;
     pa_usec_t smoother_interval;
     pa_usec_t last_smoother_update;
 
@@ -310,6 +328,8 @@ static void fix_tsched_watermark(struct userdata *u) {
 
     if (u->tsched_watermark < u->min_wakeup)
         u->tsched_watermark = u->min_wakeup;
+
+    pa_atomic_store(&u->sink->thread_info.stats.watermark_usec, (int) pa_bytes_to_usec(u->tsched_watermark, &u->sink->sample_spec));
 }
 
 static void increase_watermark(struct userdata *u) {
@@ -319,6 +339,8 @@ static void increase_watermark(struct userdata *u) {
     pa_assert(u);
     pa_assert(u->use_tsched);
 
+    pa_alsa_watermark_ctl_dropout(&u->watermark_ctl, pa_rtpoll_now(u->rtpoll));
+
     /* First, just try to increase the watermark */
     old_watermark = u->tsched_watermark;
     u->tsched_watermark = PA_MIN(u->tsched_watermark * 2, u->tsched_watermark + u->watermark_inc_step);
@@ -357,7 +379,7 @@ static void decrease_watermark(struct userdata *u) {
     pa_assert(u);
     pa_assert(u->use_tsched);
 
-    now = pa_rtclock_now();
+    now = pa_rtpoll_now(u->rtpoll);
 
     if (u->watermark_dec_not_before <= 0)
         goto restart;
@@ -384,7 +406,38 @@ restart:
     u->watermark_dec_not_before = now + TSCHED_WATERMARK_VERIFY_AFTER_USEC;
 }
 
-static void hw_sleep_time(struct userdata *u, pa_usec_t *sleep_usec, pa_usec_t*process_usec) {
+static void adapt_watermark(struct userdata *u) {
+    pa_usec_t target;
+    size_t old_watermark;
+
+    pa_assert(u);
+    pa_assert(u->use_tsched);
+
+    if (pa_alsa_watermark_ctl_update(&u->watermark_ctl, pa_rtpoll_now(u->rtpoll),
+                                     pa_bytes_to_usec(u->tsched_watermark, &u->sink->sample_spec), &target)) {
+
+        old_watermark = u->tsched_watermark;
+        u->tsched_watermark = pa_usec_to_bytes_round_up(target, &u->sink->sample_spec);
+        fix_tsched_watermark(u);
+
+        if (old_watermark != u->tsched_watermark)
+            pa_log_info("Adapting wakeup watermark to %0.2f ms for %0.2f ms wakeup lateness",
+                        (double) pa_bytes_to_usec(u->tsched_watermark, &u->sink->sample_spec) / PA_USEC_PER_MSEC,
+                        (double) u->watermark_ctl.lateness_usec / PA_USEC_PER_MSEC);
+    }
+
+    /* The proplist belongs to the main thread, so let it do the update */
+    if (u->watermark_posted != u->tsched_watermark) {
+        pa_proplist *pl = pa_proplist_new();
+
+        pa_alsa_watermark_ctl_fill_proplist(&u->watermark_ctl, pa_bytes_to_usec(u->tsched_watermark, &u->sink->sample_spec), pl);
+        pa_asyncmsgq_post(u->thread_mq.outq, PA_MSGOBJECT(u->sink), SINK_MESSAGE_UPDATE_PROPLIST, pl, 0, NULL, (pa_free_cb_t) pa_proplist_free);
+
+        u->watermark_posted = u->tsched_watermark;
+    }
+}
+
+static void hw_sleep_time(struct userdata *u, pa_bool_t full_buffer, pa_usec_t *sleep_usec, pa_usec_t*process_usec) {
     pa_usec_t usec, wm;
 
     pa_assert(sleep_usec);
@@ -393,7 +446,7 @@ static void hw_sleep_time(struct userdata *u, pa_usec_t *sleep_usec, pa_usec_t*p
     pa_assert(u);
     pa_assert(u->use_tsched);
 
-    usec = pa_sink_get_requested_latency_within_thread(u->sink);
+    usec = full_buffer ? (pa_usec_t) -1 : pa_sink_get_requested_latency_within_thread(u->sink);
 
     if (usec == (pa_usec_t) -1)
         usec = pa_bytes_to_usec(u->hwbuf_size, &u->sink->sample_spec);
@@ -436,6 +489,7 @@ static int try_recover(struct userdata *u, const char *call, int err) {
 
     u->first = TRUE;
     u->since_start = 0;
+    u->start_count = u->write_count;
     return 0;
 }
 
@@ -460,9 +514,12 @@ static size_t check_left_to_play(struct userdata *u, size_t n_bytes, pa_bool_t o
         PA_DEBUG_TRAP;
 #endif
 
-        if (!u->first && !u->after_rewind)
+        if (!u->first && !u->after_rewind) {
+            pa_atomic_inc(&u->sink->thread_info.stats.underruns);
+
             if (pa_log_ratelimit(PA_LOG_INFO))
                 pa_log_info("Underrun!");
+        }
     }
 
 #ifdef DEBUG_TIMING
@@ -492,22 +549,61 @@ static size_t check_left_to_play(struct userdata *u, size_t n_bytes, pa_bool_t o
 
         if (reset_not_before)
             u->watermark_dec_not_before = 0;
+
+        adapt_watermark(u);
     }
 
     return left_to_play;
 }
 
+/* Called from IO context */
+static pa_bool_t monitor_in_use(struct userdata *u) {
+    pa_source *monitor = u->sink->monitor_source;
+
+    return monitor &&
+        PA_SOURCE_IS_LINKED(monitor->thread_info.state) &&
+        pa_hashmap_size(monitor->thread_info.outputs) > 0;
+}
+
+/* Called from IO context */
+static pa_bool_t is_deep_idle(struct userdata *u) {
+
+    /* While idle nothing but silence is played, whatever latency the
+     * corked streams asked for. So the whole buffer is filled and
+     * slept through, and what starts playing next rewinds all of it,
+     * which the device has to support. A monitor source would hand
+     * that silence out early, and couldn't take it back. */
+    return
+        u->use_tsched &&
+        u->sink->thread_info.state == PA_SINK_IDLE &&
+        u->sink->thread_info.max_rewind >= u->hwbuf_size &&
+        !monitor_in_use(u);
+}
+
 static int mmap_write(struct userdata *u, pa_usec_t *sleep_usec, pa_bool_t polled, pa_bool_t on_timeout) {
-    pa_bool_t work_done = FALSE;
+    pa_bool_t work_done = FALSE, batch, deep_idle;
     pa_usec_t max_sleep_usec = 0, process_usec = 0;
-    size_t left_to_play;
+    size_t left_to_play, block_size_max, hwbuf_unused;
     unsigned j = 0;
 
     pa_assert(u);
     pa_sink_assert_ref(u->sink);
 
+    deep_idle = is_deep_idle(u);
+    hwbuf_unused = deep_idle ? 0 : u->hwbuf_unused;
+
     if (u->use_tsched)
-        hw_sleep_time(u, &max_sleep_usec, &process_usec);
+        hw_sleep_time(u, deep_idle, &max_sleep_usec, &process_usec);
+
+    /* The only one who can keep a reference to the memblocks we render
+     * into is the monitor source. If it is not recorded from there is
+     * no need to keep them small enough to be copied into a pool slot,
+     * and every contiguous part of the mmap area can be filled with a
+     * single mmap_begin()/render/mmap_commit() round, instead of one
+     * per slot. With tsched and a large buffer that are only two
+     * rounds per wakeup at most, one on each side of the ring wrap. */
+    batch = !monitor_in_use(u);
+    block_size_max = pa_mempool_block_size_max(u->core->mempool);
 
     for (;;) {
         snd_pcm_sframes_t n;
@@ -551,7 +647,7 @@ static int mmap_write(struct userdata *u, pa_usec_t *sleep_usec, pa_bool_t polle
                 break;
             }
 
-        if (PA_UNLIKELY(n_bytes <= u->hwbuf_unused)) {
+        if (PA_UNLIKELY(n_bytes <= hwbuf_unused)) {
 
             if (polled)
                 PA_ONCE_BEGIN {
@@ -578,7 +674,7 @@ static int mmap_write(struct userdata *u, pa_usec_t *sleep_usec, pa_bool_t polle
             break;
         }
 
-        n_bytes -= u->hwbuf_unused;
+        n_bytes -= hwbuf_unused;
         polled = FALSE;
 
 #ifdef DEBUG_TIMING
@@ -608,8 +704,8 @@ static int mmap_write(struct userdata *u, pa_usec_t *sleep_usec, pa_bool_t polle
             }
 
             /* Make sure that if these memblocks need to be copied they will fit into one slot */
-            if (frames > pa_mempool_block_size_max(u->core->mempool)/u->frame_size)
-                frames = pa_mempool_block_size_max(u->core->mempool)/u->frame_size;
+            if (!batch && frames > block_size_max/u->frame_size)
+                frames = block_size_max/u->frame_size;
 
             if (!after_avail && frames == 0)
                 break;
@@ -676,16 +772,19 @@ static int mmap_write(struct userdata *u, pa_usec_t *sleep_usec, pa_bool_t polle
 }
 
 static int unix_write(struct userdata *u, pa_usec_t *sleep_usec, pa_bool_t polled, pa_bool_t on_timeout) {
-    pa_bool_t work_done = FALSE;
+    pa_bool_t work_done = FALSE, deep_idle;
     pa_usec_t max_sleep_usec = 0, process_usec = 0;
-    size_t left_to_play;
+    size_t left_to_play, hwbuf_unused;
     unsigned j = 0;
 
     pa_assert(u);
     pa_sink_assert_ref(u->sink);
 
+    deep_idle = is_deep_idle(u);
+    hwbuf_unused = deep_idle ? 0 : u->hwbuf_unused;
+
     if (u->use_tsched)
-        hw_sleep_time(u, &max_sleep_usec, &process_usec);
+        hw_sleep_time(u, deep_idle, &max_sleep_usec, &process_usec);
 
     for (;;) {
         snd_pcm_sframes_t n;
@@ -717,7 +816,7 @@ static int unix_write(struct userdata *u, pa_usec_t *sleep_usec, pa_bool_t polle
                 pa_bytes_to_usec(left_to_play, &u->sink->sample_spec) > process_usec+max_sleep_usec/2)
                 break;
 
-        if (PA_UNLIKELY(n_bytes <= u->hwbuf_unused)) {
+        if (PA_UNLIKELY(n_bytes <= hwbuf_unused)) {
 
             if (polled)
                 PA_ONCE_BEGIN {
@@ -740,7 +839,7 @@ static int unix_write(struct userdata *u, pa_usec_t *sleep_usec, pa_bool_t polle
             break;
         }
 
-        n_bytes -= u->hwbuf_unused;
+        n_bytes -= hwbuf_unused;
         polled = FALSE;
 
         for (;;) {
@@ -820,7 +919,7 @@ static void update_smoother(struct userdata *u) {
     snd_pcm_sframes_t delay = 0;
     int64_t position;
     int err;
-    pa_usec_t now1 = 0, now2;
+    pa_usec_t now1 = 0, now2, audio_usec;
     snd_pcm_status_t *status;
 
     snd_pcm_status_alloca(&status);
@@ -830,18 +929,12 @@ static void update_smoother(struct userdata *u) {
 
     /* Let's update the time smoother */
 
-    if (PA_UNLIKELY((err = pa_alsa_safe_delay(u->pcm_handle, &delay, u->hwbuf_size, &u->sink->sample_spec, FALSE)) < 0)) {
+    if (PA_UNLIKELY((err = pa_alsa_safe_delay(u->pcm_handle, status, &delay, u->hwbuf_size, &u->sink->sample_spec, FALSE)) < 0)) {
         pa_log_warn("Failed to query DSP status data: %s", pa_alsa_strerror(err));
         return;
     }
 
-    if (PA_UNLIKELY((err = snd_pcm_status(u->pcm_handle, status)) < 0))
-        pa_log_warn("Failed to get timestamp: %s", pa_alsa_strerror(err));
-    else {
-        snd_htimestamp_t htstamp = { 0, 0 };
-        snd_pcm_status_get_htstamp(status, &htstamp);
-        now1 = pa_timespec_load(&htstamp);
-    }
+    now1 = pa_alsa_status_get_htstamp(status);
 
     /* Hmm, if the timestamp is 0, then it wasn't set and we take the current time */
     if (now1 <= 0)
@@ -854,6 +947,20 @@ static void update_smoother(struct userdata *u) {
 
     position = (int64_t) u->write_count - ((int64_t) delay * (int64_t) u->frame_size);
 
+    /* The delay only moves when the driver updates the hardware
+     * pointer, which may be once per period. If the device has a
+     * wall clock, the time it has been playing since the last start
+     * tells the position much more precisely. Don't trust it if it
+     * disagrees with the delay by more than that granularity. */
+    if (u->use_audio_tstamp && (audio_usec = pa_alsa_status_get_audio_htstamp(status)) > 0) {
+        int64_t p;
+
+        p = (int64_t) u->start_count + (int64_t) pa_usec_to_bytes(audio_usec, &u->sink->sample_spec);
+
+        if (p <= position + (int64_t) u->fragment_size && p + (int64_t) u->fragment_size >= position)
+            position = p;
+    }
+
     if (PA_UNLIKELY(position < 0))
         position = 0;
 
@@ -969,7 +1076,7 @@ static int update_sw_params(struct userdata *u) {
     if (u->use_tsched) {
         pa_usec_t sleep_usec, process_usec;
 
-        hw_sleep_time(u, &sleep_usec, &process_usec);
+        hw_sleep_time(u, FALSE, &sleep_usec, &process_usec);
         avail_min += pa_usec_to_bytes(sleep_usec, &u->sink->sample_spec) / u->frame_size;
     }
 
@@ -1098,6 +1205,8 @@ static int unsuspend(struct userdata *u) {
 
     u->first = TRUE;
     u->since_start = 0;
+    u->start_count = 0;
+    u->use_audio_tstamp = pa_alsa_pcm_has_audio_wallclock(u->pcm_handle);
 
     /* reset the watermark to the value defined when sink was created */
     if (u->use_tsched)
@@ -1165,6 +1274,13 @@ static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offse
                             return r;
                     }
 
+                    /* Like on a latency change, drop back to the fill
+                     * level the streams asked for right away */
+                    if (PA_PTR_TO_UINT(data) == PA_SINK_RUNNING && is_deep_idle(u)) {
+                        pa_log_debug("Requesting rewind due to leaving deep idle.");
+                        pa_sink_request_rewind(u->sink, (size_t) -1);
+                    }
+
                     break;
                 }
 
@@ -1175,6 +1291,10 @@ static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offse
             }
 
             break;
+
+        case SINK_MESSAGE_UPDATE_PROPLIST:
+            pa_sink_update_proplist(u->sink, PA_UPDATE_REPLACE, data);
+            return 0;
     }
 
     return pa_sink_process_msg(o, code, data, offset, chunk);
@@ -1216,14 +1336,26 @@ static int ctl_mixer_callback(snd_mixer_elem_t *elem, unsigned int mask) {
         return 0;
     }
 
-    if (mask & SND_CTL_EVENT_MASK_VALUE) {
-        pa_sink_get_volume(u->sink, TRUE);
-        pa_sink_get_mute(u->sink, TRUE);
-    }
+    if (mask & SND_CTL_EVENT_MASK_VALUE)
+        u->core->mainloop->defer_enable(u->mixer_update_event, 1);
 
     return 0;
 }
 
+static void mixer_update_cb(pa_mainloop_api *a, pa_defer_event *e, void *userdata) {
+    struct userdata *u = userdata;
+
+    pa_assert(u);
+
+    a->defer_enable(e, 0);
+
+    if (!PA_SINK_IS_LINKED(u->sink->state))
+        return;
+
+    pa_sink_get_volume(u->sink, TRUE);
+    pa_sink_get_mute(u->sink, TRUE);
+}
+
 static int io_mixer_callback(snd_mixer_elem_t *elem, unsigned int mask) {
     struct userdata *u = snd_mixer_elem_get_callback_private(elem);
 
@@ -1238,8 +1370,9 @@ static int io_mixer_callback(snd_mixer_elem_t *elem, unsigned int mask) {
         return 0;
     }
 
+    /* Picked up by thread_func() once the mixer events are handled */
     if (mask & SND_CTL_EVENT_MASK_VALUE)
-        pa_sink_update_volume_and_mute(u->sink);
+        u->mixer_changed = TRUE;
 
     return 0;
 }
@@ -1668,8 +1801,7 @@ static void thread_func(void *userdata) {
 
     pa_log_debug("Thread starting up");
 
-    if (u->core->realtime_scheduling)
-        pa_make_realtime(u->core->realtime_priority);
+    pa_core_setup_io_thread(u->core, u->rtprio, u->cpu_affinity);
 
     pa_thread_mq_install(&u->thread_mq);
 
@@ -1691,9 +1823,13 @@ static void thread_func(void *userdata) {
                 if (process_rewind(u) < 0)
                         goto fail;
 
-            if (u->use_mmap)
+            if (u->use_mmap) {
+                uint64_t write_count = u->write_count;
+
+                pa_trace(PA_TRACE_MMAP_WRITE_BEGIN, u->sink->index, !!(revents & POLLOUT));
                 work_done = mmap_write(u, &sleep_usec, revents & POLLOUT, on_timeout);
-            else
+                pa_trace(PA_TRACE_MMAP_WRITE_END, u->sink->index, u->write_count - write_count);
+            } else
                 work_done = unix_write(u, &sleep_usec, revents & POLLOUT, on_timeout);
 
             if (work_done < 0)
@@ -1707,7 +1843,7 @@ static void thread_func(void *userdata) {
                     pa_log_info("Starting playback.");
                     snd_pcm_start(u->pcm_handle);
 
-                    pa_smoother_resume(u->smoother, pa_rtclock_now(), TRUE);
+                    pa_smoother_resume(u->smoother, pa_rtpoll_now_refresh(u->rtpoll), TRUE);
 
                     u->first = FALSE;
                 }
@@ -1715,6 +1851,8 @@ static void thread_func(void *userdata) {
                 update_smoother(u);
             }
 
+            pa_sink_publish_latency_within_thread(u->sink);
+
             if (u->use_tsched) {
                 pa_usec_t cusec;
 
@@ -1741,7 +1879,7 @@ static void thread_func(void *userdata) {
 
                 /* Convert from the sound card time domain to the
                  * system time domain */
-                cusec = pa_smoother_translate(u->smoother, pa_rtclock_now(), sleep_usec);
+                cusec = pa_smoother_translate(u->smoother, pa_rtpoll_now(u->rtpoll), sleep_usec);
 
 #ifdef DEBUG_TIMING
                 pa_log_debug("Waking up in %0.2fms (system clock).", (double) cusec / PA_USEC_PER_MSEC);
@@ -1778,6 +1916,11 @@ static void thread_func(void *userdata) {
         if (u->sink->flags & PA_SINK_DEFERRED_VOLUME)
             pa_sink_volume_change_apply(u->sink, NULL);
 
+        if (u->mixer_changed) {
+            u->mixer_changed = FALSE;
+            pa_sink_update_volume_and_mute(u->sink);
+        }
+
         if (ret == 0)
             goto finish;
 
@@ -1800,6 +1943,7 @@ static void thread_func(void *userdata) {
 
                 u->first = TRUE;
                 u->since_start = 0;
+                u->start_count = u->write_count;
                 revents = 0;
             } else if (revents && u->use_tsched && pa_log_ratelimit(PA_LOG_DEBUG))
                 pa_log_debug("Wakeup from ALSA!");
@@ -1955,6 +2099,9 @@ static int setup_mixer(struct userdata *u, pa_bool_t ignore_dB) {
             u->mixer_fdl = pa_alsa_fdlist_new();
             mixer_callback = ctl_mixer_callback;
 
+            u->mixer_update_event = u->core->mainloop->defer_new(u->core->mainloop, mixer_update_cb, u);
+            u->core->mainloop->defer_enable(u->mixer_update_event, 0);
+
             if (pa_alsa_fdlist_set_handle(u->mixer_fdl, u->mixer_handle, NULL, u->core->mainloop) < 0) {
                 pa_log("Failed to initialize file descriptor monitoring");
                 return -1;
@@ -2065,8 +2212,16 @@ pa_sink *pa_alsa_sink_new(pa_module *m, pa_modargs *ma, const char*driver, pa_ca
     u->deferred_volume = deferred_volume;
     u->fixed_latency_range = fixed_latency_range;
     u->first = TRUE;
+
+    u->rtprio = -1;
+    if (pa_modargs_get_io_thread_args(ma, &u->rtprio, &u->cpu_affinity) < 0) {
+        pa_log("Failed to parse realtime_priority or cpu_affinity argument.");
+        goto fail;
+    }
+
     u->rewind_safeguard = rewind_safeguard;
     u->rtpoll = pa_rtpoll_new();
+    pa_alsa_watermark_ctl_init(&u->watermark_ctl, pa_rtpoll_get_lateness(u->rtpoll), TSCHED_MIN_WAKEUP_USEC);
     pa_thread_mq_init(&u->thread_mq, m->core->mainloop, u->rtpoll);
 
     u->smoother = pa_smoother_new(
@@ -2076,7 +2231,8 @@ pa_sink *pa_alsa_sink_new(pa_module *m, pa_modargs *ma, const char*driver, pa_ca
             TRUE,
             5,
             pa_rtclock_now(),
-            TRUE);
+            TRUE,
+            FALSE);
     u->smoother_interval = SMOOTHER_MIN_INTERVAL;
 
     dev_id = pa_modargs_get_value(
@@ -2167,6 +2323,9 @@ pa_sink *pa_alsa_sink_new(pa_module *m, pa_modargs *ma, const char*driver, pa_ca
             pa_log_info("Disabling latency range changes on underrun");
     }
 
+    if ((u->use_audio_tstamp = pa_alsa_pcm_has_audio_wallclock(u->pcm_handle)))
+        pa_log_info("Using the audio wall clock of the device for timing.");
+
     if (is_iec958(u) || is_hdmi(u))
         set_formats = TRUE;
 
@@ -2361,6 +2520,9 @@ static void userdata_free(struct userdata *u) {
     if (u->sink)
         pa_sink_unlink(u->sink);
 
+    if (u->mixer_update_event)
+        u->core->mainloop->defer_free(u->mixer_update_event);
+
     if (u->thread) {
         pa_asyncmsgq_send(u->thread_mq.inq, NULL, PA_MESSAGE_SHUTDOWN, NULL, 0, NULL);
         pa_thread_free(u->thread);
@@ -2409,6 +2571,7 @@ static void userdata_free(struct userdata *u) {
     reserve_done(u);
     monitor_done(u);
 
+    pa_xfree(u->cpu_affinity);
     pa_xfree(u->device_name);
     pa_xfree(u->control_device);
     pa_xfree(u->paths_dir);
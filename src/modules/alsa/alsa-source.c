@@ -26,6 +26,7 @@
 
 #include <signal.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <asoundlib.h>
 
@@ -54,6 +55,7 @@
 
 #include "alsa-util.h"
 #include "alsa-source.h"
+#include "alsa-watermark.h"
 
 /* #define DEBUG_TIMING */
 
@@ -80,6 +82,10 @@
 
 #define VOLUME_ACCURACY (PA_VOLUME_NORM/100)
 
+enum {
+    SOURCE_MESSAGE_UPDATE_PROPLIST = PA_SOURCE_MESSAGE_MAX
+};
+
 struct userdata {
     pa_core *core;
     pa_module *module;
@@ -98,6 +104,11 @@ struct userdata {
     pa_alsa_path_set *mixer_path_set;
     pa_alsa_path *mixer_path;
 
+    /* Mixer events are only looked at once per main loop (or IO
+     * thread) iteration, no matter how many elements changed */
+    pa_defer_event *mixer_update_event;
+    pa_bool_t mixer_changed;
+
     pa_cvolume hardware_volume;
 
     unsigned int *rates;
@@ -114,15 +125,29 @@ struct userdata {
         watermark_inc_step,
         watermark_dec_step,
         watermark_inc_threshold,
-        watermark_dec_threshold;
+        watermark_dec_threshold,
+        watermark_posted;
 
     pa_usec_t watermark_dec_not_before;
     pa_usec_t min_latency_ref;
 
+    pa_alsa_watermark_ctl watermark_ctl;
+
+    /* While the streams keep references to what we post, the mmap area
+     * is copied to slices of this block, instead of wrapping it and
+     * having pa_memblock_unref_fixed() copy it to a new block for every
+     * period */
+    pa_memblock *capture_ring;
+    size_t capture_ring_index;
+    pa_bool_t capture_copy;
+
     char *device_name;  /* name of the PCM device */
     char *control_device; /* name of the control device */
 
-    pa_bool_t use_mmap:1, use_tsched:1, deferred_volume:1, fixed_latency_range:1;
+    pa_bool_t use_mmap:1, use_tsched:1, deferred_volume:1, fixed_latency_range:1, use_audio_tstamp:1;
+
+    int32_t rtprio;
+    char *cpu_affinity;
 
     pa_bool_t first;
 
@@ -130,6 +155,7 @@ struct userdata {
 
     pa_smoother *smoother;
     uint64_t read_count;
+    uint64_t start_count;
     pa_usec_t smoother_interval;
     pa_usec_t last_smoother_update;
 
@@ -285,6 +311,8 @@ static void fix_tsched_watermark(struct userdata *u) {
 
     if (u->tsched_watermark < u->min_wakeup)
         u->tsched_watermark = u->min_wakeup;
+
+    pa_atomic_store(&u->source->thread_info.stats.watermark_usec, (int) pa_bytes_to_usec(u->tsched_watermark, &u->source->sample_spec));
 }
 
 static void increase_watermark(struct userdata *u) {
@@ -294,6 +322,8 @@ static void increase_watermark(struct userdata *u) {
     pa_assert(u);
     pa_assert(u->use_tsched);
 
+    pa_alsa_watermark_ctl_dropout(&u->watermark_ctl, pa_rtpoll_now(u->rtpoll));
+
     /* First, just try to increase the watermark */
     old_watermark = u->tsched_watermark;
     u->tsched_watermark = PA_MIN(u->tsched_watermark * 2, u->tsched_watermark + u->watermark_inc_step);
@@ -332,7 +362,7 @@ static void decrease_watermark(struct userdata *u) {
     pa_assert(u);
     pa_assert(u->use_tsched);
 
-    now = pa_rtclock_now();
+    now = pa_rtpoll_now(u->rtpoll);
 
     if (u->watermark_dec_not_before <= 0)
         goto restart;
@@ -359,6 +389,36 @@ restart:
     u->watermark_dec_not_before = now + TSCHED_WATERMARK_VERIFY_AFTER_USEC;
 }
 
+static void adapt_watermark(struct userdata *u) {
+    pa_usec_t target;
+    size_t old_watermark;
+
+    pa_assert(u);
+    pa_assert(u->use_tsched);
+
+    if (pa_alsa_watermark_ctl_update(&u->watermark_ctl, pa_rtpoll_now(u->rtpoll),
+                                     pa_bytes_to_usec(u->tsched_watermark, &u->source->sample_spec), &target)) {
+
+        old_watermark = u->tsched_watermark;
+        u->tsched_watermark = pa_usec_to_bytes_round_up(target, &u->source->sample_spec);
+        fix_tsched_watermark(u);
+
+        if (old_watermark != u->tsched_watermark)
+            pa_log_info("Adapting wakeup watermark to %0.2f ms for %0.2f ms wakeup lateness",
+                        (double) pa_bytes_to_usec(u->tsched_watermark, &u->source->sample_spec) / PA_USEC_PER_MSEC,
+                        (double) u->watermark_ctl.lateness_usec / PA_USEC_PER_MSEC);
+    }
+
+    if (u->watermark_posted != u->tsched_watermark) {
+        pa_proplist *pl = pa_proplist_new();
+
+        pa_alsa_watermark_ctl_fill_proplist(&u->watermark_ctl, pa_bytes_to_usec(u->tsched_watermark, &u->source->sample_spec), pl);
+        pa_asyncmsgq_post(u->thread_mq.outq, PA_MSGOBJECT(u->source), SOURCE_MESSAGE_UPDATE_PROPLIST, pl, 0, NULL, (pa_free_cb_t) pa_proplist_free);
+
+        u->watermark_posted = u->tsched_watermark;
+    }
+}
+
 static void hw_sleep_time(struct userdata *u, pa_usec_t *sleep_usec, pa_usec_t*process_usec) {
     pa_usec_t wm, usec;
 
@@ -410,6 +470,7 @@ static int try_recover(struct userdata *u, const char *call, int err) {
     }
 
     u->first = TRUE;
+    u->start_count = u->read_count;
     return 0;
 }
 
@@ -435,6 +496,8 @@ static size_t check_left_to_record(struct userdata *u, size_t n_bytes, pa_bool_t
         PA_DEBUG_TRAP;
 #endif
 
+        pa_atomic_inc(&u->source->thread_info.stats.overruns);
+
         if (pa_log_ratelimit(PA_LOG_INFO))
             pa_log_info("Overrun!");
     }
@@ -461,11 +524,65 @@ static size_t check_left_to_record(struct userdata *u, size_t n_bytes, pa_bool_t
 
         if (reset_not_before)
             u->watermark_dec_not_before = 0;
+
+        adapt_watermark(u);
     }
 
     return left_to_record;
 }
 
+/* Called from IO context */
+static void post_mmap_area(struct userdata *u, void *p, size_t length) {
+    pa_memchunk chunk;
+    void *d;
+
+    if (!u->capture_copy) {
+        chunk.memblock = pa_memblock_new_fixed(u->core->mempool, p, length, TRUE);
+        chunk.length = length;
+        chunk.index = 0;
+
+        pa_source_post(u->source, &chunk);
+
+        /* Somebody kept it, so it is going to be copied right away */
+        if (!pa_memblock_ref_is_one(chunk.memblock))
+            u->capture_copy = TRUE;
+
+        pa_memblock_unref_fixed(chunk.memblock);
+        return;
+    }
+
+    if (u->capture_ring && u->capture_ring_index + length > pa_memblock_get_length(u->capture_ring)) {
+        pa_memblock_unref(u->capture_ring);
+        u->capture_ring = NULL;
+    }
+
+    if (!u->capture_ring) {
+        u->capture_ring = pa_memblock_new(u->core->mempool, (size_t) -1);
+        u->capture_ring_index = 0;
+    }
+
+    /* Nobody is handed the part of the block behind the index, so it
+     * can still be written while earlier slices are referenced */
+    d = pa_memblock_acquire(u->capture_ring);
+    memcpy((uint8_t*) d + u->capture_ring_index, p, length);
+    pa_memblock_release(u->capture_ring);
+
+    chunk.memblock = u->capture_ring;
+    chunk.index = u->capture_ring_index;
+    chunk.length = length;
+
+    pa_source_post(u->source, &chunk);
+
+    u->capture_ring_index += length;
+
+    /* Nobody holds on to any of it anymore, so we can go back to
+     * posting the mmap area itself */
+    if (pa_memblock_ref_is_one(u->capture_ring)) {
+        u->capture_ring_index = 0;
+        u->capture_copy = FALSE;
+    }
+}
+
 static int mmap_read(struct userdata *u, pa_usec_t *sleep_usec, pa_bool_t polled, pa_bool_t on_timeout) {
     pa_bool_t work_done = FALSE;
     pa_usec_t max_sleep_usec = 0, process_usec = 0;
@@ -544,7 +661,6 @@ static int mmap_read(struct userdata *u, pa_usec_t *sleep_usec, pa_bool_t polled
 #endif
 
         for (;;) {
-            pa_memchunk chunk;
             void *p;
             int err;
             const snd_pcm_channel_area_t *areas;
@@ -585,12 +701,7 @@ static int mmap_read(struct userdata *u, pa_usec_t *sleep_usec, pa_bool_t polled
 
             p = (uint8_t*) areas[0].addr + (offset * u->frame_size);
 
-            chunk.memblock = pa_memblock_new_fixed(u->core->mempool, p, frames * u->frame_size, TRUE);
-            chunk.length = pa_memblock_get_length(chunk.memblock);
-            chunk.index = 0;
-
-            pa_source_post(u->source, &chunk);
-            pa_memblock_unref_fixed(chunk.memblock);
+            post_mmap_area(u, p, frames * u->frame_size);
 
             if (PA_UNLIKELY((sframes = snd_pcm_mmap_commit(u->pcm_handle, offset, frames)) < 0)) {
 
@@ -762,7 +873,7 @@ static void update_smoother(struct userdata *u) {
     snd_pcm_sframes_t delay = 0;
     uint64_t position;
     int err;
-    pa_usec_t now1 = 0, now2;
+    pa_usec_t now1 = 0, now2, audio_usec;
     snd_pcm_status_t *status;
 
     snd_pcm_status_alloca(&status);
@@ -772,18 +883,12 @@ static void update_smoother(struct userdata *u) {
 
     /* Let's update the time smoother */
 
-    if (PA_UNLIKELY((err = pa_alsa_safe_delay(u->pcm_handle, &delay, u->hwbuf_size, &u->source->sample_spec, TRUE)) < 0)) {
+    if (PA_UNLIKELY((err = pa_alsa_safe_delay(u->pcm_handle, status, &delay, u->hwbuf_size, &u->source->sample_spec, TRUE)) < 0)) {
         pa_log_warn("Failed to get delay: %s", pa_alsa_strerror(err));
         return;
     }
 
-    if (PA_UNLIKELY((err = snd_pcm_status(u->pcm_handle, status)) < 0))
-        pa_log_warn("Failed to get timestamp: %s", pa_alsa_strerror(err));
-    else {
-        snd_htimestamp_t htstamp = { 0, 0 };
-        snd_pcm_status_get_htstamp(status, &htstamp);
-        now1 = pa_timespec_load(&htstamp);
-    }
+    now1 = pa_alsa_status_get_htstamp(status);
 
     /* Hmm, if the timestamp is 0, then it wasn't set and we take the current time */
     if (now1 <= 0)
@@ -795,6 +900,19 @@ static void update_smoother(struct userdata *u) {
             return;
 
     position = u->read_count + ((uint64_t) delay * (uint64_t) u->frame_size);
+
+    /* Like in alsa-sink: the time the device has been recording since
+     * the last start is more precise than the delay, as long as they
+     * roughly agree */
+    if (u->use_audio_tstamp && (audio_usec = pa_alsa_status_get_audio_htstamp(status)) > 0) {
+        uint64_t p;
+
+        p = u->start_count + pa_usec_to_bytes(audio_usec, &u->source->sample_spec);
+
+        if (p <= position + u->fragment_size && p + u->fragment_size >= position)
+            position = p;
+    }
+
     now2 = pa_bytes_to_usec(position, &u->source->sample_spec);
 
     pa_smoother_put(u->smoother, now1, now2);
@@ -1004,6 +1122,8 @@ static int unsuspend(struct userdata *u) {
     u->last_smoother_update = 0;
 
     u->first = TRUE;
+    u->start_count = 0;
+    u->use_audio_tstamp = pa_alsa_pcm_has_audio_wallclock(u->pcm_handle);
 
     /* reset the watermark to the value defined when source was created */
     if (u->use_tsched)
@@ -1078,6 +1198,10 @@ static int source_process_msg(pa_msgobject *o, int code, void *data, int64_t off
             }
 
             break;
+
+        case SOURCE_MESSAGE_UPDATE_PROPLIST:
+            pa_source_update_proplist(u->source, PA_UPDATE_REPLACE, data);
+            return 0;
     }
 
     return pa_source_process_msg(o, code, data, offset, chunk);
@@ -1119,14 +1243,26 @@ static int ctl_mixer_callback(snd_mixer_elem_t *elem, unsigned int mask) {
         return 0;
     }
 
-    if (mask & SND_CTL_EVENT_MASK_VALUE) {
-        pa_source_get_volume(u->source, TRUE);
-        pa_source_get_mute(u->source, TRUE);
-    }
+    if (mask & SND_CTL_EVENT_MASK_VALUE)
+        u->core->mainloop->defer_enable(u->mixer_update_event, 1);
 
     return 0;
 }
 
+static void mixer_update_cb(pa_mainloop_api *a, pa_defer_event *e, void *userdata) {
+    struct userdata *u = userdata;
+
+    pa_assert(u);
+
+    a->defer_enable(e, 0);
+
+    if (!PA_SOURCE_IS_LINKED(u->source->state))
+        return;
+
+    pa_source_get_volume(u->source, TRUE);
+    pa_source_get_mute(u->source, TRUE);
+}
+
 static int io_mixer_callback(snd_mixer_elem_t *elem, unsigned int mask) {
     struct userdata *u = snd_mixer_elem_get_callback_private(elem);
 
@@ -1141,8 +1277,9 @@ static int io_mixer_callback(snd_mixer_elem_t *elem, unsigned int mask) {
         return 0;
     }
 
+    /* Picked up by thread_func() once the mixer events are handled */
     if (mask & SND_CTL_EVENT_MASK_VALUE)
-        pa_source_update_volume_and_mute(u->source);
+        u->mixer_changed = TRUE;
 
     return 0;
 }
@@ -1434,8 +1571,7 @@ static void thread_func(void *userdata) {
 
     pa_log_debug("Thread starting up");
 
-    if (u->core->realtime_scheduling)
-        pa_make_realtime(u->core->realtime_priority);
+    pa_core_setup_io_thread(u->core, u->rtprio, u->cpu_affinity);
 
     pa_thread_mq_install(&u->thread_mq);
 
@@ -1457,7 +1593,7 @@ static void thread_func(void *userdata) {
                 pa_log_info("Starting capture.");
                 snd_pcm_start(u->pcm_handle);
 
-                pa_smoother_resume(u->smoother, pa_rtclock_now(), TRUE);
+                pa_smoother_resume(u->smoother, pa_rtpoll_now_refresh(u->rtpoll), TRUE);
 
                 u->first = FALSE;
             }
@@ -1475,6 +1611,8 @@ static void thread_func(void *userdata) {
             if (work_done)
                 update_smoother(u);
 
+            pa_source_publish_latency_within_thread(u->source);
+
             if (u->use_tsched) {
                 pa_usec_t cusec;
 
@@ -1485,7 +1623,7 @@ static void thread_func(void *userdata) {
 
                 /* Convert from the sound card time domain to the
                  * system time domain */
-                cusec = pa_smoother_translate(u->smoother, pa_rtclock_now(), sleep_usec);
+                cusec = pa_smoother_translate(u->smoother, pa_rtpoll_now(u->rtpoll), sleep_usec);
 
 /*                 pa_log_debug("Waking up in %0.2fms (system clock).", (double) cusec / PA_USEC_PER_MSEC); */
 
@@ -1517,6 +1655,11 @@ static void thread_func(void *userdata) {
         if (u->source->flags & PA_SOURCE_DEFERRED_VOLUME)
             pa_source_volume_change_apply(u->source, NULL);
 
+        if (u->mixer_changed) {
+            u->mixer_changed = FALSE;
+            pa_source_update_volume_and_mute(u->source);
+        }
+
         if (ret == 0)
             goto finish;
 
@@ -1538,6 +1681,7 @@ static void thread_func(void *userdata) {
                     goto fail;
 
                 u->first = TRUE;
+                u->start_count = u->read_count;
                 revents = 0;
             } else if (revents && u->use_tsched && pa_log_ratelimit(PA_LOG_DEBUG))
                 pa_log_debug("Wakeup from ALSA!");
@@ -1692,6 +1836,9 @@ static int setup_mixer(struct userdata *u, pa_bool_t ignore_dB) {
             u->mixer_fdl = pa_alsa_fdlist_new();
             mixer_callback = ctl_mixer_callback;
 
+            u->mixer_update_event = u->core->mainloop->defer_new(u->core->mainloop, mixer_update_cb, u);
+            u->core->mainloop->defer_enable(u->mixer_update_event, 0);
+
             if (pa_alsa_fdlist_set_handle(u->mixer_fdl, u->mixer_handle, NULL, u->core->mainloop) < 0) {
                 pa_log("Failed to initialize file descriptor monitoring");
                 return -1;
@@ -1796,7 +1943,15 @@ pa_source *pa_alsa_source_new(pa_module *m, pa_modargs *ma, const char*driver, p
     u->deferred_volume = deferred_volume;
     u->fixed_latency_range = fixed_latency_range;
     u->first = TRUE;
+
+    u->rtprio = -1;
+    if (pa_modargs_get_io_thread_args(ma, &u->rtprio, &u->cpu_affinity) < 0) {
+        pa_log("Failed to parse realtime_priority or cpu_affinity argument.");
+        goto fail;
+    }
+
     u->rtpoll = pa_rtpoll_new();
+    pa_alsa_watermark_ctl_init(&u->watermark_ctl, pa_rtpoll_get_lateness(u->rtpoll), TSCHED_MIN_WAKEUP_USEC);
     pa_thread_mq_init(&u->thread_mq, m->core->mainloop, u->rtpoll);
 
     u->smoother = pa_smoother_new(
@@ -1806,7 +1961,8 @@ pa_source *pa_alsa_source_new(pa_module *m, pa_modargs *ma, const char*driver, p
             TRUE,
             5,
             pa_rtclock_now(),
-            TRUE);
+            TRUE,
+            FALSE);
     u->smoother_interval = SMOOTHER_MIN_INTERVAL;
 
     dev_id = pa_modargs_get_value(
@@ -1896,6 +2052,9 @@ pa_source *pa_alsa_source_new(pa_module *m, pa_modargs *ma, const char*driver, p
             pa_log_info("Disabling latency range changes on overrun");
     }
 
+    if ((u->use_audio_tstamp = pa_alsa_pcm_has_audio_wallclock(u->pcm_handle)))
+        pa_log_info("Using the audio wall clock of the device for timing.");
+
     u->rates = pa_alsa_get_supported_rates(u->pcm_handle);
     if (!u->rates) {
         pa_log_error("Failed to find any supported sample rates.");
@@ -2064,6 +2223,9 @@ static void userdata_free(struct userdata *u) {
     if (u->source)
         pa_source_unlink(u->source);
 
+    if (u->mixer_update_event)
+        u->core->mainloop->defer_free(u->mixer_update_event);
+
     if (u->thread) {
         pa_asyncmsgq_send(u->thread_mq.inq, NULL, PA_MESSAGE_SHUTDOWN, NULL, 0, NULL);
         pa_thread_free(u->thread);
@@ -2074,6 +2236,9 @@ static void userdata_free(struct userdata *u) {
     if (u->source)
         pa_source_unref(u->source);
 
+    if (u->capture_ring)
+        pa_memblock_unref(u->capture_ring);
+
     if (u->mixer_pd)
         pa_alsa_mixer_pdata_free(u->mixer_pd);
 
@@ -2106,6 +2271,7 @@ static void userdata_free(struct userdata *u) {
     reserve_done(u);
     monitor_done(u);
 
+    pa_xfree(u->cpu_affinity);
     pa_xfree(u->device_name);
     pa_xfree(u->control_device);
     pa_xfree(u->paths_dir);
@@ -621,6 +621,7 @@ snd_pcm_t *pa_alsa_open_by_device_id_mapping(
 
     pcm_handle = pa_alsa_open_by_template(
             m->device_strings,
+            mode == SND_PCM_STREAM_PLAYBACK ? &m->output_device_index : &m->input_device_index,
             dev_id,
             dev,
             &try_ss,
@@ -735,8 +736,47 @@ fail:
     return NULL;
 }
 
+static snd_pcm_t *open_by_template_entry(
+        char **template,
+        unsigned i,
+        const char *dev_id,
+        char **dev,
+        pa_sample_spec *ss,
+        pa_channel_map* map,
+        int mode,
+        snd_pcm_uframes_t *period_size,
+        snd_pcm_uframes_t *buffer_size,
+        snd_pcm_uframes_t tsched_size,
+        pa_bool_t *use_mmap,
+        pa_bool_t *use_tsched,
+        pa_bool_t require_exact_channel_number) {
+
+    snd_pcm_t *pcm_handle;
+    char *d;
+
+    d = pa_replace(template[i], "%f", dev_id);
+
+    pcm_handle = pa_alsa_open_by_device_string(
+            d,
+            dev,
+            ss,
+            map,
+            mode,
+            period_size,
+            buffer_size,
+            tsched_size,
+            use_mmap,
+            use_tsched,
+            require_exact_channel_number);
+
+    pa_xfree(d);
+
+    return pcm_handle;
+}
+
 snd_pcm_t *pa_alsa_open_by_template(
         char **template,
+        unsigned *preferred,
         const char *dev_id,
         char **dev,
         pa_sample_spec *ss,
@@ -750,30 +790,30 @@ snd_pcm_t *pa_alsa_open_by_template(
         pa_bool_t require_exact_channel_number) {
 
     snd_pcm_t *pcm_handle;
-    char **i;
+    unsigned i, n;
 
-    for (i = template; *i; i++) {
-        char *d;
+    for (n = 0; template[n]; n++)
+        ;
 
-        d = pa_replace(*i, "%f", dev_id);
+    /* Every entry that fails costs a full open, so go for the one that
+     * worked last time first */
+    if (preferred && *preferred < n)
+        if ((pcm_handle = open_by_template_entry(template, *preferred, dev_id, dev, ss, map, mode, period_size, buffer_size,
+                                                 tsched_size, use_mmap, use_tsched, require_exact_channel_number)))
+            return pcm_handle;
 
-        pcm_handle = pa_alsa_open_by_device_string(
-                d,
-                dev,
-                ss,
-                map,
-                mode,
-                period_size,
-                buffer_size,
-                tsched_size,
-                use_mmap,
-                use_tsched,
-                require_exact_channel_number);
+    for (i = 0; i < n; i++) {
+
+        if (preferred && i == *preferred)
+            continue;
 
-        pa_xfree(d);
+        if ((pcm_handle = open_by_template_entry(template, i, dev_id, dev, ss, map, mode, period_size, buffer_size,
+                                                 tsched_size, use_mmap, use_tsched, require_exact_channel_number))) {
+            if (preferred)
+                *preferred = i;
 
-        if (pcm_handle)
             return pcm_handle;
+        }
     }
 
     return NULL;
@@ -1149,13 +1189,14 @@ snd_pcm_sframes_t pa_alsa_safe_avail(snd_pcm_t *pcm, size_t hwbuf_size, const pa
     return n;
 }
 
-int pa_alsa_safe_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delay, size_t hwbuf_size, const pa_sample_spec *ss, pa_bool_t capture) {
+int pa_alsa_safe_delay(snd_pcm_t *pcm, snd_pcm_status_t *status, snd_pcm_sframes_t *delay, size_t hwbuf_size, const pa_sample_spec *ss, pa_bool_t capture) {
     ssize_t k;
     size_t abs_k;
     int r;
     snd_pcm_sframes_t avail = 0;
 
     pa_assert(pcm);
+    pa_assert(status);
     pa_assert(delay);
     pa_assert(hwbuf_size > 0);
     pa_assert(ss);
@@ -1164,9 +1205,14 @@ int pa_alsa_safe_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delay, size_t hwbuf_si
      * what is going on. We're going to get both the avail and delay values so
      * that we can compare and check them for capture */
 
-    if ((r = snd_pcm_avail_delay(pcm, &avail, delay)) < 0)
+    /* The delay is taken from the status, so that it was measured at
+     * the same moment as the timestamps in there */
+    if ((r = snd_pcm_status(pcm, status)) < 0)
         return r;
 
+    avail = (snd_pcm_sframes_t) snd_pcm_status_get_avail(status);
+    *delay = snd_pcm_status_get_delay(status);
+
     k = (ssize_t) *delay * (ssize_t) pa_frame_size(ss);
 
     abs_k = k >= 0 ? (size_t) k : (size_t) -k;
@@ -1234,6 +1280,49 @@ int pa_alsa_safe_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delay, size_t hwbuf_si
     return 0;
 }
 
+pa_usec_t pa_alsa_status_get_htstamp(snd_pcm_status_t *status) {
+    snd_htimestamp_t htstamp = { 0, 0 };
+
+    pa_assert(status);
+
+    snd_pcm_status_get_htstamp(status, &htstamp);
+    return pa_timespec_load(&htstamp);
+}
+
+pa_usec_t pa_alsa_status_get_audio_htstamp(snd_pcm_status_t *status) {
+#if (SND_LIB_VERSION >= ((1<<16)|(0<<8)|27)) /* API additions in 1.0.27 */
+    snd_htimestamp_t htstamp = { 0, 0 };
+
+    pa_assert(status);
+
+    snd_pcm_status_get_audio_htstamp(status, &htstamp);
+    return pa_timespec_load(&htstamp);
+#else
+    pa_assert(status);
+
+    return 0;
+#endif
+}
+
+pa_bool_t pa_alsa_pcm_has_audio_wallclock(snd_pcm_t *pcm) {
+#if (SND_LIB_VERSION >= ((1<<16)|(0<<8)|27)) /* API additions in 1.0.27 */
+    snd_pcm_hw_params_t *hwparams;
+
+    pa_assert(pcm);
+
+    snd_pcm_hw_params_alloca(&hwparams);
+
+    if (snd_pcm_hw_params_current(pcm, hwparams) < 0)
+        return FALSE;
+
+    return !!snd_pcm_hw_params_supports_audio_wallclock_ts(hwparams);
+#else
+    pa_assert(pcm);
+
+    return FALSE;
+#endif
+}
+
 int pa_alsa_safe_mmap_begin(snd_pcm_t *pcm, const snd_pcm_channel_area_t **areas, snd_pcm_uframes_t *offset, snd_pcm_uframes_t *frames, size_t hwbuf_size, const pa_sample_spec *ss) {
     int r;
     snd_pcm_uframes_t before;
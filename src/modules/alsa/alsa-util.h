@@ -93,9 +93,12 @@ snd_pcm_t *pa_alsa_open_by_device_string(
         pa_bool_t *use_tsched,            /* modified at return */
         pa_bool_t require_exact_channel_number);
 
-/* Opens the explicit ALSA device with a fallback list */
+/* Opens the explicit ALSA device with a fallback list. If preferred
+ * is not NULL, the entry it indexes is tried first, and it is set to
+ * the one that could be opened. */
 snd_pcm_t *pa_alsa_open_by_template(
         char **template,
+        unsigned *preferred,              /* modified at return */
         const char *dev_id,
         char **dev,                       /* modified at return */
         pa_sample_spec *ss,               /* modified at return */
@@ -125,9 +128,17 @@ int pa_alsa_recover_from_poll(snd_pcm_t *pcm, int revents);
 pa_rtpoll_item* pa_alsa_build_pollfd(snd_pcm_t *pcm, pa_rtpoll *rtpoll);
 
 snd_pcm_sframes_t pa_alsa_safe_avail(snd_pcm_t *pcm, size_t hwbuf_size, const pa_sample_spec *ss);
-int pa_alsa_safe_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delay, size_t hwbuf_size, const pa_sample_spec *ss, pa_bool_t capture);
+int pa_alsa_safe_delay(snd_pcm_t *pcm, snd_pcm_status_t *status, snd_pcm_sframes_t *delay, size_t hwbuf_size, const pa_sample_spec *ss, pa_bool_t capture);
 int pa_alsa_safe_mmap_begin(snd_pcm_t *pcm, const snd_pcm_channel_area_t **areas, snd_pcm_uframes_t *offset, snd_pcm_uframes_t *frames, size_t hwbuf_size, const pa_sample_spec *ss);
 
+/* The system time a status was taken at, 0 if the driver didn't set it */
+pa_usec_t pa_alsa_status_get_htstamp(snd_pcm_status_t *status);
+
+/* How long the device has been running since it was started, as
+ * measured by its own clock, 0 if not known */
+pa_usec_t pa_alsa_status_get_audio_htstamp(snd_pcm_status_t *status);
+pa_bool_t pa_alsa_pcm_has_audio_wallclock(snd_pcm_t *pcm);
+
 char *pa_alsa_get_driver_name(int card);
 char *pa_alsa_get_driver_name_by_pcm(snd_pcm_t *pcm);
 
@@ -0,0 +1,138 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/timeval.h>
+
+#include <pulsecore/macro.h>
+
+#include "alsa-watermark.h"
+
+#define UPDATE_INTERVAL_USEC (1*PA_USEC_PER_SEC)  /* 1s    -- How often the histogram is sampled */
+#define WEIGHT_DECAY 0.95                          /*       -- Per update, i.e. samples count for about 20s */
+#define MIN_SAMPLES 50.0                           /*       -- Don't trust the model before this many wakeups */
+#define PERCENTILE 0.999                           /*       -- How many wakeups the watermark has to cover */
+
+#define HEADROOM_MIN 1.25                          /*       -- The watermark is the lateness times this at least */
+#define HEADROOM_MAX 4.0
+#define HEADROOM_INC 1.5                           /*       -- On dropouts multiply the headroom by this */
+#define HEADROOM_DECAY 0.99                        /*       -- Per update without dropouts */
+
+#define HOLD_USEC (20*PA_USEC_PER_SEC)             /* 20s   -- Don't lower the watermark this long after a dropout */
+
+void pa_alsa_watermark_ctl_init(pa_alsa_watermark_ctl *w, pa_histogram *lateness, pa_usec_t margin) {
+    pa_assert(w);
+    pa_assert(lateness);
+
+    pa_zero(*w);
+    w->lateness = lateness;
+    w->margin = margin;
+    w->headroom = HEADROOM_MIN;
+
+    /* Only count what happens from now on */
+    pa_histogram_get(lateness, w->seen);
+}
+
+void pa_alsa_watermark_ctl_dropout(pa_alsa_watermark_ctl *w, pa_usec_t now) {
+    pa_assert(w);
+
+    w->headroom = PA_MIN(w->headroom * HEADROOM_INC, HEADROOM_MAX);
+    w->hold_until = now + HOLD_USEC;
+}
+
+/* Linearly interpolates within the bucket the percentile falls into */
+static pa_usec_t get_percentile(pa_alsa_watermark_ctl *w, double total) {
+    double want = total * PERCENTILE, sum = 0;
+    unsigned k;
+
+    for (k = 0; k < PA_HISTOGRAM_BUCKETS; k++) {
+        double lo, hi;
+
+        if (w->weight[k] <= 0 || sum + w->weight[k] < want) {
+            sum += w->weight[k];
+            continue;
+        }
+
+        /* Bucket k holds [2^k, 2^(k+1)), except for the first and the
+         * open-ended last one */
+        lo = k > 0 ? (double) (1ULL << k) : 0;
+        hi = (double) (1ULL << (k + 1));
+
+        return (pa_usec_t) (lo + (hi - lo) * (want - sum) / w->weight[k]);
+    }
+
+    return (pa_usec_t) (1ULL << PA_HISTOGRAM_BUCKETS);
+}
+
+pa_bool_t pa_alsa_watermark_ctl_update(pa_alsa_watermark_ctl *w, pa_usec_t now, pa_usec_t current, pa_usec_t *target) {
+    uint32_t counts[PA_HISTOGRAM_BUCKETS];
+    double total = 0;
+    pa_usec_t t;
+    unsigned k;
+
+    pa_assert(w);
+    pa_assert(target);
+
+    if (now < w->next_update)
+        return FALSE;
+
+    w->next_update = now + UPDATE_INTERVAL_USEC;
+
+    pa_histogram_get(w->lateness, counts);
+
+    for (k = 0; k < PA_HISTOGRAM_BUCKETS; k++) {
+        /* If the counts went down somebody reset the histogram */
+        uint32_t delta = counts[k] >= w->seen[k] ? counts[k] - w->seen[k] : counts[k];
+
+        w->weight[k] = w->weight[k] * WEIGHT_DECAY + delta;
+        w->seen[k] = counts[k];
+        total += w->weight[k];
+    }
+
+    w->headroom = PA_MAX(w->headroom * HEADROOM_DECAY, HEADROOM_MIN);
+
+    if (total < MIN_SAMPLES)
+        return FALSE;
+
+    w->lateness_usec = get_percentile(w, total);
+    t = (pa_usec_t) ((double) w->lateness_usec * w->headroom) + w->margin;
+
+    /* Ignore changes of less than 1/8th to keep the watermark from
+     * wobbling, and don't lower it right after a dropout */
+    if (t < current) {
+        if (now < w->hold_until || current - t < current / 8)
+            return FALSE;
+    } else if (t - current < current / 8)
+        return FALSE;
+
+    *target = t;
+    return TRUE;
+}
+
+void pa_alsa_watermark_ctl_fill_proplist(pa_alsa_watermark_ctl *w, pa_usec_t watermark, pa_proplist *p) {
+    pa_assert(w);
+    pa_assert(p);
+
+    pa_proplist_setf(p, "alsa.tsched.watermark_usec", "%llu", (unsigned long long) watermark);
+    pa_proplist_setf(p, "alsa.tsched.wakeup_lateness_usec", "%llu", (unsigned long long) w->lateness_usec);
+    pa_proplist_setf(p, "alsa.tsched.headroom", "%0.2f", w->headroom);
+}
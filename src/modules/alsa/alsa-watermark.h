@@ -0,0 +1,68 @@
+#ifndef fooalsawatermarkhfoo
+#define fooalsawatermarkhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulse/proplist.h>
+#include <pulse/sample.h>
+
+#include <pulsecore/histogram.h>
+#include <pulsecore/macro.h>
+
+/* Picks the tsched watermark from the wakeup lateness the IO thread
+ * has seen recently: the watermark has to cover a high percentile of
+ * how late we are woken up, plus a fixed margin for the processing
+ * itself. The lateness comes from the histogram of the rtpoll, which
+ * is sampled once a second into exponentially decaying bucket weights,
+ * so that the model follows changes in system load. Dropouts the model
+ * did not predict inflate a headroom factor that is slowly forgiven
+ * again.
+ *
+ * Everything here is called from the IO thread only. */
+
+typedef struct pa_alsa_watermark_ctl {
+    pa_histogram *lateness;
+    uint32_t seen[PA_HISTOGRAM_BUCKETS];
+    double weight[PA_HISTOGRAM_BUCKETS];
+
+    double headroom;
+    pa_usec_t margin;
+
+    pa_usec_t next_update;
+    pa_usec_t hold_until;
+
+    /* The learned lateness percentile, 0 while still learning */
+    pa_usec_t lateness_usec;
+} pa_alsa_watermark_ctl;
+
+void pa_alsa_watermark_ctl_init(pa_alsa_watermark_ctl *w, pa_histogram *lateness, pa_usec_t margin);
+
+/* Tell the controller about an underrun or overrun; this also keeps
+ * it from lowering the watermark for a while */
+void pa_alsa_watermark_ctl_dropout(pa_alsa_watermark_ctl *w, pa_usec_t now);
+
+/* Call this on every iteration. Returns TRUE and the new watermark in
+ * *target if the current one should be changed. */
+pa_bool_t pa_alsa_watermark_ctl_update(pa_alsa_watermark_ctl *w, pa_usec_t now, pa_usec_t current, pa_usec_t *target);
+
+/* Describes the state of the controller for monitoring */
+void pa_alsa_watermark_ctl_fill_proplist(pa_alsa_watermark_ctl *w, pa_usec_t watermark, pa_proplist *p);
+
+#endif
@@ -29,6 +29,7 @@
 #include <pulsecore/i18n.h>
 #include <pulsecore/modargs.h>
 #include <pulsecore/queue.h>
+#include <pulsecore/strbuf.h>
 
 #include <modules/reserve-wrap.h>
 
@@ -37,6 +38,8 @@
 #endif
 
 #include "alsa-util.h"
+#include "alsa-probe.h"
+#include "alsa-quirks.h"
 #include "alsa-sink.h"
 #include "alsa-source.h"
 #include "module-alsa-card-symdef.h"
@@ -69,6 +72,9 @@ PA_MODULE_USAGE(
         "deferred_volume=<Synchronize software and hardware volume changes to avoid momentary jumps?> "
         "profile_set=<profile set configuration file> "
         "paths_dir=<directory containing the path configuration files> "
+        "realtime_priority=<priority of the IO threads, 0 for no realtime scheduling> "
+        "cpu_affinity=<CPUs to run the IO threads on, e.g. 0-1,4> "
+        "reprobe=<probe the profiles even if the results of an earlier probe are cached?> "
 );
 
 static const char* const valid_modargs[] = {
@@ -95,6 +101,9 @@ static const char* const valid_modargs[] = {
     "deferred_volume",
     "profile_set",
     "paths_dir",
+    "realtime_priority",
+    "cpu_affinity",
+    "reprobe",
     NULL
 };
 
@@ -408,10 +417,49 @@ static void set_card_name(pa_card_new_data *data, pa_modargs *ma, const char *de
     pa_xfree(t);
 }
 
+/* Adds the arguments the quirk database has for the card to the ones
+ * the module was loaded with. Explicit arguments always win. */
+static int add_quirks(struct userdata *u) {
+    pa_proplist *quirks;
+    pa_strbuf *buf;
+    const char *key;
+    void *state = NULL;
+    char *args;
+    pa_modargs *ma;
+
+    if (!(quirks = pa_alsa_quirks_get(u->alsa_card_index)))
+        return 0;
+
+    buf = pa_strbuf_new();
+
+    if (u->module->argument)
+        pa_strbuf_puts(buf, u->module->argument);
+
+    while ((key = pa_proplist_iterate(quirks, &state)))
+        if (!pa_modargs_get_value(u->modargs, key, NULL))
+            pa_strbuf_printf(buf, " %s=%s", key, pa_proplist_gets(quirks, key));
+
+    pa_proplist_free(quirks);
+    args = pa_strbuf_tostring_free(buf);
+
+    if (!(ma = pa_modargs_new(args, valid_modargs))) {
+        pa_log("Failed to apply the timing quirks: %s", args);
+        pa_xfree(args);
+        return -1;
+    }
+
+    pa_xfree(args);
+
+    pa_modargs_free(u->modargs);
+    u->modargs = ma;
+
+    return 0;
+}
+
 int pa__init(pa_module *m) {
     pa_card_new_data data;
     pa_modargs *ma;
-    pa_bool_t ignore_dB = FALSE;
+    pa_bool_t ignore_dB = FALSE, reprobe = FALSE;
     struct userdata *u;
     pa_reserve_wrapper *reserve = NULL;
     const char *description;
@@ -433,6 +481,11 @@ int pa__init(pa_module *m) {
         goto fail;
     }
 
+    if (pa_modargs_get_value_boolean(ma, "reprobe", &reprobe) < 0) {
+        pa_log("Failed to parse reprobe argument.");
+        goto fail;
+    }
+
     m->userdata = u = pa_xnew0(struct userdata, 1);
     u->core = m->core;
     u->module = m;
@@ -444,6 +497,11 @@ int pa__init(pa_module *m) {
         goto fail;
     }
 
+    if (add_quirks(u) < 0)
+        goto fail;
+
+    ma = u->modargs;
+
     if (!pa_in_system_mode()) {
         char *rname;
 
@@ -465,15 +523,12 @@ int pa__init(pa_module *m) {
         fn = pa_xstrdup(pa_modargs_get_value(ma, "profile_set", NULL));
     }
 
-    u->profile_set = pa_alsa_profile_set_new(fn, &u->core->default_channel_map);
+    u->profile_set = pa_alsa_probe_profile_set(m->core, u->device_id, u->alsa_card_index, fn, ignore_dB, reprobe);
     pa_xfree(fn);
 
-    u->profile_set->ignore_dB = ignore_dB;
-
     if (!u->profile_set)
         goto fail;
 
-    pa_alsa_profile_set_probe(u->profile_set, u->device_id, &m->core->default_sample_spec, m->core->default_n_fragments, m->core->default_fragment_size_msec);
     pa_alsa_profile_set_dump(u->profile_set);
 
     pa_card_new_data_init(&data);
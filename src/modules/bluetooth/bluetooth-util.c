@@ -1102,6 +1102,7 @@ static DBusMessage *endpoint_set_configuration(DBusConnection *conn, DBusMessage
     uint8_t *config = NULL;
     int size = 0;
     pa_bool_t nrec = FALSE;
+    uint8_t codec = 0;
     enum profile p;
     DBusMessageIter args, props;
     DBusMessage *r;
@@ -1143,6 +1144,10 @@ static DBusMessage *endpoint_set_configuration(DBusConnection *conn, DBusMessage
                 goto fail;
             dbus_message_iter_get_basic(&value, &tmp_boolean);
             nrec = tmp_boolean;
+        } else if (strcasecmp(key, "Codec") == 0) {
+            if (var != DBUS_TYPE_BYTE)
+                goto fail;
+            dbus_message_iter_get_basic(&value, &codec);
         } else if (strcasecmp(key, "Configuration") == 0) {
             DBusMessageIter array;
             if (var != DBUS_TYPE_ARRAY)
@@ -1168,6 +1173,7 @@ static DBusMessage *endpoint_set_configuration(DBusConnection *conn, DBusMessage
         p = PROFILE_A2DP_SOURCE;
 
     t = transport_new(y, path, p, config, size);
+    t->codec = codec;
     if (nrec)
         t->nrec = nrec;
     pa_hashmap_put(d->transports, t->path, t);
@@ -26,6 +26,7 @@
 
 #include <string.h>
 #include <errno.h>
+#include <sys/ioctl.h>
 #include <linux/sockios.h>
 #include <arpa/inet.h>
 
@@ -49,6 +50,7 @@
 #include <pulsecore/time-smoother.h>
 #include <pulsecore/namereg.h>
 #include <pulsecore/dbus-shared.h>
+#include <pulsecore/dsp-worker.h>
 
 #include "module-bluetooth-device-symdef.h"
 #include "ipc.h"
@@ -59,8 +61,35 @@
 
 #define BITPOOL_DEC_LIMIT 32
 #define BITPOOL_DEC_STEP 5
+#define BITPOOL_INC_STEP 2
+
+/* Limits of the send queue in A2DP packets, above which the bitpool is
+ * lowered and below which it may be raised again */
+#define BITPOOL_OUTQ_HIGH 4
+#define BITPOOL_OUTQ_LOW 1
+
+/* The time to wait after a bitpool change before lowering it again,
+ * and for how long the send queue needs to stay short before raising it */
+#define BITPOOL_DEC_INTERVAL (500*PA_USEC_PER_MSEC)
+#define BITPOOL_INC_INTERVAL (2*PA_USEC_PER_SEC)
 #define HSP_MAX_GAIN 15
 
+/* The frame count in the RTP payload header has four bits */
+#define A2DP_FRAMES_MAX 15U
+
+/* With a2dp_frames= the send buffer is shrunk to hold this many
+ * packets, so that little audio can queue up in the kernel */
+#define A2DP_LOW_LATENCY_SNDBUF_PACKETS (2*BITPOOL_OUTQ_HIGH)
+
+/* The most SCO packets sco_batch= may ask for */
+#define SCO_BATCH_MAX 16U
+
+/* An mSBC frame goes over the air after a 2 byte H2 header, followed
+ * by a byte of padding. It carries 7.5ms of 16 kHz mono audio. */
+#define MSBC_FRAME_SIZE 57
+#define MSBC_PACKET_SIZE 60
+#define MSBC_PCM_SIZE 240
+
 PA_MODULE_AUTHOR("Joao Paulo Rechi Vita");
 PA_MODULE_DESCRIPTION("Bluetooth audio sink and source");
 PA_MODULE_VERSION(PACKAGE_VERSION);
@@ -80,7 +109,12 @@ PA_MODULE_USAGE(
         "path=<device object path> "
         "auto_connect=<automatically connect?> "
         "sco_sink=<SCO over PCM sink name> "
-        "sco_source=<SCO over PCM source name>");
+        "sco_source=<SCO over PCM source name> "
+        "realtime_priority=<priority of the IO thread, 0 for no realtime scheduling> "
+        "cpu_affinity=<CPUs to run the IO thread on, e.g. 0-1,4> "
+        "encoder_thread=<encode A2DP audio in a separate thread, adding one packet of latency?> "
+        "sco_batch=<HSP/HFP packets to read and write per wakeup, 1 to wake up for each> "
+        "a2dp_frames=<SBC frames per A2DP packet for lower latency, 0 to fill the link MTU>");
 
 /* TODO: not close fd when entering suspend mode in a2dp */
 
@@ -100,6 +134,11 @@ static const char* const valid_modargs[] = {
     "auto_connect",
     "sco_sink",
     "sco_source",
+    "realtime_priority",
+    "cpu_affinity",
+    "encoder_thread",
+    "sco_batch",
+    "a2dp_frames",
     NULL
 };
 
@@ -115,6 +154,12 @@ struct a2dp_info {
     uint16_t seq_num;                    /* Cumulative packet sequence */
     uint8_t min_bitpool;
     uint8_t max_bitpool;
+
+    int sndbuf;                          /* Size of the socket send buffer, 0 if unknown */
+    size_t packet_truesize;              /* What one packet takes up in the send buffer, 0 until measured */
+    unsigned packets_queued;             /* Packets written since the send buffer was last seen empty */
+    pa_usec_t bitpool_changed_at;        /* When the bitpool was last changed */
+    pa_usec_t outq_low_since;            /* Since when the send queue has been short, 0 if it isn't */
 };
 
 struct hsp_info {
@@ -126,6 +171,16 @@ struct hsp_info {
     pa_hook_slot *sink_state_changed_slot;
     pa_hook_slot *source_state_changed_slot;
     pa_hook_slot *nrec_changed_slot;
+
+    /* Wideband speech, if the transport was configured for mSBC */
+    pa_bool_t msbc;
+    pa_bool_t msbc_initialized;
+    sbc_t msbc_enc, msbc_dec;
+    uint8_t msbc_seq;                       /* Sequence number of the next H2 header */
+    uint8_t msbc_out[MSBC_PACKET_SIZE];     /* Encoded frame, written up to msbc_out_index */
+    size_t msbc_out_index;
+    uint8_t msbc_in[MSBC_PACKET_SIZE];      /* Frame being received */
+    size_t msbc_in_length;
 };
 
 struct bluetooth_msg {
@@ -161,12 +216,37 @@ struct userdata {
     pa_thread *thread;
     bluetooth_msg *msg;
 
+    int32_t rtprio;
+    char *cpu_affinity;
+
     uint64_t read_index, write_index;
     pa_usec_t started_at;
     pa_smoother *read_smoother;
 
     pa_memchunk write_memchunk;
 
+    /* With encoder_thread=yes the SBC encoding for A2DP playback is
+     * done in the encoder thread. encoded holds a packet that has been
+     * collected from there, but not yet written to the socket. */
+    pa_bool_t encoder_thread;
+    pa_dsp_worker *encoder;
+    pa_memchunk encoded;
+    size_t encoded_pcm_length;
+    uint64_t encoder_packets, encoder_waits;
+
+    /* With sco_batch > 1 HSP/HFP audio is read and written that many
+     * packets at a time. The IO thread then doesn't wake up on POLLIN,
+     * but on a timer that follows the receive timestamps, for when
+     * the next batch should have come in. */
+    uint32_t sco_batch;
+    pa_usec_t sco_last_rx, sco_next_wakeup;
+    size_t sco_packet_size;
+
+    /* With a2dp_frames > 0 no more than that many SBC frames are put
+     * into each A2DP packet, instead of as many as fit into the MTU.
+     * Smaller packets cost more airtime, but less latency. */
+    uint32_t a2dp_frames;
+
     pa_sample_spec sample_spec, requested_sample_spec;
 
     int stream_fd;
@@ -203,7 +283,74 @@ enum {
 
 #define USE_SCO_OVER_PCM(u) (u->profile == PROFILE_HSP && (u->hsp.sco_sink && u->hsp.sco_source))
 
+#define SCO_BATCHED(u) ((u->profile == PROFILE_HSP || u->profile == PROFILE_HFGW) && u->sco_batch > 1)
+
+/* The second byte of the H2 header, by sequence number */
+static const uint8_t msbc_h2[4] = { 0x08, 0x38, 0xc8, 0xf8 };
+
+/* How many bytes of audio l bytes on the SCO link carry */
+static size_t sco_pcm_size(struct userdata *u, size_t l) {
+    return u->hsp.msbc ? l / MSBC_PACKET_SIZE * MSBC_PCM_SIZE : l;
+}
+
 static int init_profile(struct userdata *u);
+static int a2dp_encoder_sync(struct userdata *u);
+static void a2dp_encoder_drop(struct userdata *u);
+static size_t a2dp_encoder_get_pending(struct userdata *u);
+static size_t a2dp_socket_get_pending(struct userdata *u);
+
+/* The number of SBC frames we put into each packet we send */
+static size_t a2dp_frames_per_packet(struct userdata *u) {
+    size_t n;
+
+    n = (u->write_link_mtu - sizeof(struct rtp_header) - sizeof(struct rtp_payload)) / u->a2dp.frame_length;
+
+    if (u->a2dp_frames > 0 && u->a2dp_frames < n)
+        n = u->a2dp_frames;
+
+    return n;
+}
+
+/* The size of each packet we send, with headers */
+static size_t a2dp_packet_size(struct userdata *u) {
+    return sizeof(struct rtp_header) + sizeof(struct rtp_payload) + a2dp_frames_per_packet(u) * u->a2dp.frame_length;
+}
+
+/* Run from IO thread. How much of the send buffer is in use, fails if
+ * that isn't known. */
+static int a2dp_get_outq(struct userdata *u, size_t *queued) {
+    int outq;
+
+    if (u->a2dp.sndbuf <= 0 || u->stream_fd < 0 || ioctl(u->stream_fd, SIOCOUTQ, &outq) < 0)
+        return -1;
+
+    /* Bluetooth sockets report the free space in the send buffer
+     * here, not the number of bytes queued as TCP does */
+    *queued = outq < u->a2dp.sndbuf ? (size_t) (u->a2dp.sndbuf - outq) : 0;
+    return 0;
+}
+
+/* Run from IO thread. How many packets are still in the send buffer,
+ * fails if that isn't known. The kernel accounts the buffers of each
+ * packet including their overhead, so the use is divided by what the
+ * first packet written into the empty buffer took up, and the result
+ * is never more than what was written since then. */
+static int a2dp_get_queued_packets(struct userdata *u, unsigned *n) {
+    size_t queued, per_packet;
+
+    if (a2dp_get_outq(u, &queued) < 0)
+        return -1;
+
+    if (queued <= 0) {
+        u->a2dp.packets_queued = 0;
+        *n = 0;
+        return 0;
+    }
+
+    per_packet = u->a2dp.packet_truesize > 0 ? u->a2dp.packet_truesize : a2dp_packet_size(u);
+    *n = (unsigned) PA_MIN(queued / per_packet, (size_t) u->a2dp.packets_queued);
+    return 0;
+}
 
 /* from IO thread */
 static void a2dp_set_bitpool(struct userdata *u, uint8_t bitpool)
@@ -214,6 +361,10 @@ static void a2dp_set_bitpool(struct userdata *u, uint8_t bitpool)
 
     a2dp = &u->a2dp;
 
+    /* The encoder thread must not be using the codec while we change it */
+    if (u->encoder)
+        a2dp_encoder_sync(u);
+
     if (a2dp->sbc.bitpool == bitpool)
         return;
 
@@ -223,19 +374,21 @@ static void a2dp_set_bitpool(struct userdata *u, uint8_t bitpool)
         bitpool = a2dp->min_bitpool;
 
     a2dp->sbc.bitpool = bitpool;
+    a2dp->bitpool_changed_at = pa_rtclock_now();
 
     a2dp->codesize = sbc_get_codesize(&a2dp->sbc);
     a2dp->frame_length = sbc_get_frame_length(&a2dp->sbc);
 
+    /* Packets of the new size have to be measured again */
+    a2dp->packet_truesize = 0;
+
     pa_log_debug("Bitpool has changed to %u", a2dp->sbc.bitpool);
 
     u->read_block_size =
         (u->read_link_mtu - sizeof(struct rtp_header) - sizeof(struct rtp_payload))
         / a2dp->frame_length * a2dp->codesize;
 
-    u->write_block_size =
-        (u->write_link_mtu - sizeof(struct rtp_header) - sizeof(struct rtp_payload))
-        / a2dp->frame_length * a2dp->codesize;
+    u->write_block_size = a2dp_frames_per_packet(u) * a2dp->codesize;
 
     pa_sink_set_max_request_within_thread(u->sink, u->write_block_size);
     pa_sink_set_fixed_latency_within_thread(u->sink,
@@ -253,27 +406,30 @@ static void bt_transport_config_mtu(struct userdata *u) {
             (u->read_link_mtu - sizeof(struct rtp_header) - sizeof(struct rtp_payload))
             / u->a2dp.frame_length * u->a2dp.codesize;
 
-        u->write_block_size =
-            (u->write_link_mtu - sizeof(struct rtp_header) - sizeof(struct rtp_payload))
-            / u->a2dp.frame_length * u->a2dp.codesize;
+        u->write_block_size = a2dp_frames_per_packet(u) * u->a2dp.codesize;
     }
 
     if (USE_SCO_OVER_PCM(u))
         return;
 
     if (u->sink) {
-        pa_sink_set_max_request_within_thread(u->sink, u->write_block_size);
+        size_t n = SCO_BATCHED(u) ? u->sco_batch : 1;
+
+        pa_sink_set_max_request_within_thread(u->sink, sco_pcm_size(u, n * u->write_block_size));
         pa_sink_set_fixed_latency_within_thread(u->sink,
                                                 (u->profile == PROFILE_A2DP ?
                                                  FIXED_LATENCY_PLAYBACK_A2DP : FIXED_LATENCY_PLAYBACK_HSP) +
-                                                pa_bytes_to_usec(u->write_block_size, &u->sample_spec));
+                                                pa_bytes_to_usec(sco_pcm_size(u, n * u->write_block_size), &u->sample_spec));
     }
 
-    if (u->source)
+    if (u->source) {
+        size_t n = SCO_BATCHED(u) ? u->sco_batch : 1;
+
         pa_source_set_fixed_latency_within_thread(u->source,
                                                   (u->profile == PROFILE_A2DP_SOURCE ?
                                                    FIXED_LATENCY_RECORD_A2DP : FIXED_LATENCY_RECORD_HSP) +
-                                                  pa_bytes_to_usec(u->read_block_size, &u->sample_spec));
+                                                  pa_bytes_to_usec(sco_pcm_size(u, n * u->read_block_size), &u->sample_spec));
+    }
 }
 
 /* from IO thread, except in SCO over PCM */
@@ -293,9 +449,32 @@ static void setup_stream(struct userdata *u) {
 
     pa_log_debug("Stream properly set up, we're ready to roll!");
 
-    if (u->profile == PROFILE_A2DP)
+    if (u->profile == PROFILE_A2DP) {
+        socklen_t len = sizeof(u->a2dp.sndbuf);
+
+        /* Anything still in the encoder was meant for the old stream */
+        if (u->encoder)
+            a2dp_encoder_drop(u);
+
         a2dp_set_bitpool(u, u->a2dp.max_bitpool);
 
+        if (u->a2dp_frames > 0) {
+            int sndbuf = (int) (A2DP_LOW_LATENCY_SNDBUF_PACKETS * a2dp_packet_size(u));
+
+            if (setsockopt(u->stream_fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)) < 0)
+                pa_log_warn("Failed to shrink send buffer: %s", pa_cstrerror(errno));
+        }
+
+        if (getsockopt(u->stream_fd, SOL_SOCKET, SO_SNDBUF, &u->a2dp.sndbuf, &len) < 0) {
+            pa_log_warn("Failed to get send buffer size, not adapting the bitpool: %s", pa_cstrerror(errno));
+            u->a2dp.sndbuf = 0;
+        }
+
+        u->a2dp.outq_low_since = 0;
+        u->a2dp.packet_truesize = 0;
+        u->a2dp.packets_queued = 0;
+    }
+
     u->rtpoll_item = pa_rtpoll_item_new(u->rtpoll, PA_RTPOLL_NEVER, 1);
     pollfd = pa_rtpoll_item_get_pollfd(u->rtpoll_item, NULL);
     pollfd->fd = u->stream_fd;
@@ -303,6 +482,11 @@ static void setup_stream(struct userdata *u) {
 
     u->read_index = u->write_index = 0;
     u->started_at = 0;
+    u->sco_last_rx = u->sco_next_wakeup = 0;
+    u->sco_packet_size = u->read_block_size;
+    u->hsp.msbc_seq = 0;
+    u->hsp.msbc_out_index = MSBC_PACKET_SIZE;
+    u->hsp.msbc_in_length = 0;
 
     if (u->source)
         u->read_smoother = pa_smoother_new(
@@ -312,7 +496,8 @@ static void setup_stream(struct userdata *u) {
                 TRUE,
                 10,
                 pa_rtclock_now(),
-                TRUE);
+                TRUE,
+                FALSE);
 }
 
 static bool bt_transport_is_acquired(struct userdata *u) {
@@ -454,14 +639,14 @@ static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offse
                 pa_usec_t wi, ri;
 
                 ri = pa_smoother_get(u->read_smoother, pa_rtclock_now());
-                wi = pa_bytes_to_usec(u->write_index + u->write_block_size, &u->sample_spec);
+                wi = pa_bytes_to_usec(u->write_index + u->write_block_size + a2dp_encoder_get_pending(u) + a2dp_socket_get_pending(u), &u->sample_spec);
 
                 *((pa_usec_t*) data) = wi > ri ? wi - ri : 0;
             } else {
                 pa_usec_t ri, wi;
 
                 ri = pa_rtclock_now() - u->started_at;
-                wi = pa_bytes_to_usec(u->write_index, &u->sample_spec);
+                wi = pa_bytes_to_usec(u->write_index + a2dp_encoder_get_pending(u) + a2dp_socket_get_pending(u), &u->sample_spec);
 
                 *((pa_usec_t*) data) = wi > ri ? wi - ri : 0;
             }
@@ -566,29 +751,91 @@ static int device_process_msg(pa_msgobject *obj, int code, void *data, int64_t o
 }
 
 /* Run from IO thread */
-static int hsp_process_render(struct userdata *u) {
+static void msbc_encode_frame(struct userdata *u) {
+    struct hsp_info *hsp = &u->hsp;
+    pa_memchunk pcm;
+    const void *p;
+    ssize_t encoded, written = 0;
+
+    pa_sink_render_full(u->sink, MSBC_PCM_SIZE, &pcm);
+
+    p = (const uint8_t*) pa_memblock_acquire(pcm.memblock) + pcm.index;
+    encoded = sbc_encode(&hsp->msbc_enc, p, pcm.length, hsp->msbc_out + 2, MSBC_FRAME_SIZE, &written);
+    pa_memblock_release(pcm.memblock);
+    pa_memblock_unref(pcm.memblock);
+
+    if (encoded != MSBC_PCM_SIZE || written != MSBC_FRAME_SIZE) {
+        /* The other side conceals frames that don't decode */
+        pa_log_error("SBC encoding error (%li)", (long) encoded);
+        memset(hsp->msbc_out + 2, 0, MSBC_FRAME_SIZE);
+    }
+
+    hsp->msbc_out[0] = 0x01;
+    hsp->msbc_out[1] = msbc_h2[hsp->msbc_seq++ % PA_ELEMENTSOF(msbc_h2)];
+    hsp->msbc_out[MSBC_PACKET_SIZE - 1] = 0;
+    hsp->msbc_out_index = 0;
+
+    u->write_index += MSBC_PCM_SIZE;
+}
+
+/* Run from IO thread. Fills chunk with length bytes of the mSBC stream,
+ * encoding as many frames as that takes. Frames may well be split
+ * between packets. */
+static void msbc_render(struct userdata *u, size_t length, pa_memchunk *chunk) {
+    struct hsp_info *hsp = &u->hsp;
+    uint8_t *d;
+
+    chunk->memblock = pa_memblock_new(u->core->mempool, length);
+    chunk->index = chunk->length = 0;
+
+    d = pa_memblock_acquire(chunk->memblock);
+
+    while (chunk->length < length) {
+        size_t k;
+
+        if (hsp->msbc_out_index >= MSBC_PACKET_SIZE)
+            msbc_encode_frame(u);
+
+        k = PA_MIN(MSBC_PACKET_SIZE - hsp->msbc_out_index, length - chunk->length);
+        memcpy(d + chunk->length, hsp->msbc_out + hsp->msbc_out_index, k);
+        hsp->msbc_out_index += k;
+        chunk->length += k;
+    }
+
+    pa_memblock_release(chunk->memblock);
+}
+
+/* Run from IO thread. Writes up to n packets, returns how many were
+ * written. */
+static int hsp_process_render(struct userdata *u, unsigned n) {
     int ret = 0;
 
     pa_assert(u);
     pa_assert(u->profile == PROFILE_HSP || u->profile == PROFILE_HFGW);
     pa_assert(u->sink);
+    pa_assert(n > 0);
 
-    /* First, render some data */
-    if (!u->write_memchunk.memblock)
-        pa_sink_render_full(u->sink, u->write_block_size, &u->write_memchunk);
-
-    pa_assert(u->write_memchunk.length == u->write_block_size);
-
-    for (;;) {
+    while ((unsigned) ret < n) {
         ssize_t l;
         const void *p;
 
+        /* First, render some data, all that is to be written in one
+         * go, in whole packets */
+        if (!u->write_memchunk.memblock) {
+            if (u->hsp.msbc)
+                msbc_render(u, (n - (unsigned) ret) * u->write_block_size, &u->write_memchunk);
+            else
+                pa_sink_render_full(u->sink, (n - (unsigned) ret) * u->write_block_size, &u->write_memchunk);
+        }
+
+        pa_assert(u->write_memchunk.length % u->write_block_size == 0);
+
         /* Now write that data to the socket. The socket is of type
          * SEQPACKET, and we generated the data of the MTU size, so this
          * should just work. */
 
         p = (const uint8_t*) pa_memblock_acquire(u->write_memchunk.memblock) + u->write_memchunk.index;
-        l = pa_write(u->stream_fd, p, u->write_memchunk.length, &u->stream_write_type);
+        l = pa_write(u->stream_fd, p, u->write_block_size, &u->stream_write_type);
         pa_memblock_release(u->write_memchunk.memblock);
 
         pa_assert(l != 0);
@@ -608,49 +855,133 @@ static int hsp_process_render(struct userdata *u) {
             break;
         }
 
-        pa_assert((size_t) l <= u->write_memchunk.length);
+        pa_assert((size_t) l <= u->write_block_size);
 
-        if ((size_t) l != u->write_memchunk.length) {
+        if ((size_t) l != u->write_block_size) {
             pa_log_error("Wrote memory block to socket only partially! %llu written, wanted to write %llu.",
                         (unsigned long long) l,
-                        (unsigned long long) u->write_memchunk.length);
+                        (unsigned long long) u->write_block_size);
             ret = -1;
             break;
         }
 
-        u->write_index += (uint64_t) u->write_memchunk.length;
-        pa_memblock_unref(u->write_memchunk.memblock);
-        pa_memchunk_reset(&u->write_memchunk);
+        /* With mSBC the index counts audio, as it is encoded */
+        if (!u->hsp.msbc)
+            u->write_index += (uint64_t) l;
 
-        ret = 1;
-        break;
+        u->write_memchunk.index += (size_t) l;
+        u->write_memchunk.length -= (size_t) l;
+
+        if (u->write_memchunk.length == 0) {
+            pa_memblock_unref(u->write_memchunk.memblock);
+            pa_memchunk_reset(&u->write_memchunk);
+        }
+
+        ret++;
     }
 
     return ret;
 }
 
-/* Run from IO thread */
+static pa_bool_t msbc_header_valid(const uint8_t *f, size_t length) {
+    if (f[0] != 0x01)
+        return FALSE;
+
+    if (length >= 2 && !memchr(msbc_h2, f[1], sizeof(msbc_h2)))
+        return FALSE;
+
+    if (length >= 3 && f[2] != 0xad)
+        return FALSE;
+
+    return TRUE;
+}
+
+/* Run from IO thread. Decodes the mSBC frames that the stream data in
+ * chunk completes into pcm. pcm is left empty if there are none. */
+static void msbc_decode(struct userdata *u, const pa_memchunk *chunk, pa_memchunk *pcm) {
+    struct hsp_info *hsp = &u->hsp;
+    const uint8_t *p, *e;
+    uint8_t *d = NULL;
+    size_t n;
+
+    pa_memchunk_reset(pcm);
+
+    /* At most this many frames can be completed */
+    if ((n = (hsp->msbc_in_length + chunk->length) / MSBC_PACKET_SIZE) > 0) {
+        pcm->memblock = pa_memblock_new(u->core->mempool, n * MSBC_PCM_SIZE);
+        d = pa_memblock_acquire(pcm->memblock);
+    }
+
+    p = (const uint8_t*) pa_memblock_acquire(chunk->memblock) + chunk->index;
+    e = p + chunk->length;
+
+    while (p < e) {
+        size_t k, written = 0;
+
+        /* Look for the H2 header and the syncword first, resyncing
+         * byte by byte after anything got lost */
+        if (hsp->msbc_in_length < 3) {
+            hsp->msbc_in[hsp->msbc_in_length++] = *(p++);
+
+            while (hsp->msbc_in_length > 0 && !msbc_header_valid(hsp->msbc_in, hsp->msbc_in_length))
+                memmove(hsp->msbc_in, hsp->msbc_in + 1, --hsp->msbc_in_length);
+
+            continue;
+        }
+
+        k = PA_MIN((size_t) (e - p), MSBC_PACKET_SIZE - hsp->msbc_in_length);
+        memcpy(hsp->msbc_in + hsp->msbc_in_length, p, k);
+        hsp->msbc_in_length += k;
+        p += k;
+
+        if (hsp->msbc_in_length < MSBC_PACKET_SIZE)
+            continue;
+
+        pa_assert(d);
+        pa_assert(pcm->length < n * MSBC_PCM_SIZE);
+
+        if (sbc_decode(&hsp->msbc_dec, hsp->msbc_in + 2, MSBC_FRAME_SIZE,
+                       d + pcm->length, MSBC_PCM_SIZE, &written) <= 0 || written != MSBC_PCM_SIZE) {
+            /* Keep the timing, a broken frame becomes silence */
+            pa_log_debug("Dropping broken mSBC frame");
+            memset(d + pcm->length, 0, MSBC_PCM_SIZE);
+        }
+
+        pcm->length += MSBC_PCM_SIZE;
+        hsp->msbc_in_length = 0;
+    }
+
+    pa_memblock_release(chunk->memblock);
+
+    if (d)
+        pa_memblock_release(pcm->memblock);
+}
+
+/* Run from IO thread. Reads one packet, or with sco_batch > 1 all that
+ * are queued up, up to SCO_BATCH_MAX. Returns the number of bytes
+ * read. */
 static int hsp_process_push(struct userdata *u) {
     int ret = 0;
     pa_memchunk memchunk;
+    pa_bool_t found_tstamp = FALSE;
+    pa_usec_t tstamp = 0;
 
     pa_assert(u);
     pa_assert(u->profile == PROFILE_HSP || u->profile == PROFILE_HFGW);
     pa_assert(u->source);
     pa_assert(u->read_smoother);
 
-    memchunk.memblock = pa_memblock_new(u->core->mempool, u->read_block_size);
+    memchunk.memblock = pa_memblock_new(u->core->mempool, u->read_block_size * (SCO_BATCHED(u) ? SCO_BATCH_MAX : 1));
     memchunk.index = memchunk.length = 0;
 
-    for (;;) {
+    /* Every packet needs room for a whole MTU, or it would be cut off */
+    while (memchunk.length + u->read_block_size <= pa_memblock_get_length(memchunk.memblock)) {
         ssize_t l;
         void *p;
         struct msghdr m;
         struct cmsghdr *cm;
         uint8_t aux[1024];
         struct iovec iov;
-        pa_bool_t found_tstamp = FALSE;
-        pa_usec_t tstamp;
 
         memset(&m, 0, sizeof(m));
         memset(&aux, 0, sizeof(aux));
@@ -662,8 +993,8 @@ static int hsp_process_push(struct userdata *u) {
         m.msg_controllen = sizeof(aux);
 
         p = pa_memblock_acquire(memchunk.memblock);
-        iov.iov_base = p;
-        iov.iov_len = pa_memblock_get_length(memchunk.memblock);
+        iov.iov_base = (uint8_t*) p + memchunk.length;
+        iov.iov_len = pa_memblock_get_length(memchunk.memblock) - memchunk.length;
         l = recvmsg(u->stream_fd, &m, 0);
         pa_memblock_release(memchunk.memblock);
 
@@ -682,11 +1013,12 @@ static int hsp_process_push(struct userdata *u) {
             break;
         }
 
-        pa_assert((size_t) l <= pa_memblock_get_length(memchunk.memblock));
+        pa_assert((size_t) l <= iov.iov_len);
 
-        memchunk.length = (size_t) l;
-        u->read_index += (uint64_t) l;
+        memchunk.length += (size_t) l;
+        u->sco_packet_size = (size_t) l;
 
+        found_tstamp = FALSE;
         for (cm = CMSG_FIRSTHDR(&m); cm; cm = CMSG_NXTHDR(&m, cm))
             if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SO_TIMESTAMP) {
                 struct timeval *tv = (struct timeval*) CMSG_DATA(cm);
@@ -696,21 +1028,42 @@ static int hsp_process_push(struct userdata *u) {
                 break;
             }
 
+        ret += (int) l;
+
+        if (!SCO_BATCHED(u))
+            break;
+    }
+
+    if (ret > 0) {
         if (!found_tstamp) {
             pa_log_warn("Couldn't find SO_TIMESTAMP data in auxiliary recvmsg() data!");
             tstamp = pa_rtclock_now();
         }
 
-        pa_smoother_put(u->read_smoother, tstamp, pa_bytes_to_usec(u->read_index, &u->sample_spec));
-        pa_smoother_resume(u->read_smoother, tstamp, TRUE);
+        u->sco_last_rx = tstamp;
 
-        pa_source_post(u->source, &memchunk);
+        if (u->hsp.msbc) {
+            pa_memchunk pcm;
 
-        ret = l;
-        break;
+            msbc_decode(u, &memchunk, &pcm);
+            pa_memblock_unref(memchunk.memblock);
+            memchunk = pcm;
+        }
+
+        if (memchunk.length > 0) {
+            u->read_index += (uint64_t) memchunk.length;
+
+            /* The timestamp is the one of the last packet, which ends
+             * at the read index */
+            pa_smoother_put(u->read_smoother, tstamp, pa_bytes_to_usec(u->read_index, &u->sample_spec));
+            pa_smoother_resume(u->read_smoother, tstamp, TRUE);
+
+            pa_source_post(u->source, &memchunk);
+        }
     }
 
-    pa_memblock_unref(memchunk.memblock);
+    if (memchunk.memblock)
+        pa_memblock_unref(memchunk.memblock);
 
     return ret;
 }
@@ -729,43 +1082,35 @@ static void a2dp_prepare_buffer(struct userdata *u) {
     u->a2dp.buffer = pa_xmalloc(u->a2dp.buffer_size);
 }
 
-/* Run from IO thread */
-static int a2dp_process_render(struct userdata *u) {
+/* Run from IO thread, or from the encoder thread while the IO thread
+ * leaves the encoder alone. Encodes all of pcm into SBC frames after
+ * the RTP headers at the beginning of packet, fills in the payload
+ * header and returns the size of the packet. The RTP header is left to
+ * a2dp_write_packet(). */
+static ssize_t a2dp_encode(struct userdata *u, const pa_memchunk *pcm, void *packet, size_t size) {
     struct a2dp_info *a2dp;
-    struct rtp_header *header;
     struct rtp_payload *payload;
-    size_t nbytes;
     void *d;
     const void *p;
     size_t to_write, to_encode;
     unsigned frame_count;
-    int ret = 0;
 
     pa_assert(u);
-    pa_assert(u->profile == PROFILE_A2DP);
-    pa_assert(u->sink);
-
-    /* First, render some data */
-    if (!u->write_memchunk.memblock)
-        pa_sink_render_full(u->sink, u->write_block_size, &u->write_memchunk);
-
-    pa_assert(u->write_memchunk.length == u->write_block_size);
-
-    a2dp_prepare_buffer(u);
+    pa_assert(pcm);
+    pa_assert(packet);
 
     a2dp = &u->a2dp;
-    header = a2dp->buffer;
-    payload = (struct rtp_payload*) ((uint8_t*) a2dp->buffer + sizeof(*header));
+    payload = (struct rtp_payload*) ((uint8_t*) packet + sizeof(struct rtp_header));
 
     frame_count = 0;
 
     /* Try to create a packet of the full MTU */
 
-    p = (const uint8_t*) pa_memblock_acquire(u->write_memchunk.memblock) + u->write_memchunk.index;
-    to_encode = u->write_memchunk.length;
+    p = (const uint8_t*) pa_memblock_acquire(pcm->memblock) + pcm->index;
+    to_encode = pcm->length;
 
-    d = (uint8_t*) a2dp->buffer + sizeof(*header) + sizeof(*payload);
-    to_write = a2dp->buffer_size - sizeof(*header) - sizeof(*payload);
+    d = (uint8_t*) packet + sizeof(struct rtp_header) + sizeof(*payload);
+    to_write = size - sizeof(struct rtp_header) - sizeof(*payload);
 
     while (PA_LIKELY(to_encode > 0 && to_write > 0)) {
         ssize_t written;
@@ -778,7 +1123,7 @@ static int a2dp_process_render(struct userdata *u) {
 
         if (PA_UNLIKELY(encoded <= 0)) {
             pa_log_error("SBC encoding error (%li)", (long) encoded);
-            pa_memblock_release(u->write_memchunk.memblock);
+            pa_memblock_release(pcm->memblock);
             return -1;
         }
 
@@ -800,29 +1145,54 @@ static int a2dp_process_render(struct userdata *u) {
         frame_count++;
     }
 
-    pa_memblock_release(u->write_memchunk.memblock);
+    pa_memblock_release(pcm->memblock);
 
     pa_assert(to_encode == 0);
 
+    memset(payload, 0, sizeof(*payload));
+    payload->frame_count = frame_count;
+
+    return (uint8_t*) d - (uint8_t*) packet;
+}
+
+/* Run from IO thread. Returns 1 if the packet was written, 0 if the
+ * socket was not writable. */
+static int a2dp_write_packet(struct userdata *u, void *packet, size_t nbytes) {
+    struct a2dp_info *a2dp;
+    struct rtp_header *header;
+    size_t queued;
+    pa_bool_t measure = FALSE;
+    int ret = 0;
+
+    pa_assert(u);
+    pa_assert(packet);
+
+    a2dp = &u->a2dp;
+    header = packet;
+
     PA_ONCE_BEGIN {
         pa_log_debug("Using SBC encoder implementation: %s", pa_strnull(sbc_get_implementation_info(&a2dp->sbc)));
     } PA_ONCE_END;
 
     /* write it to the fifo */
-    memset(a2dp->buffer, 0, sizeof(*header) + sizeof(*payload));
+    memset(header, 0, sizeof(*header));
     header->v = 2;
     header->pt = 1;
     header->sequence_number = htons(a2dp->seq_num++);
     header->timestamp = htonl(u->write_index / pa_frame_size(&u->sample_spec));
     header->ssrc = htonl(1);
-    payload->frame_count = frame_count;
 
-    nbytes = (uint8_t*) d - (uint8_t*) a2dp->buffer;
+    /* Written into an empty send buffer, the packet shows what one
+     * takes up there */
+    if (a2dp_get_outq(u, &queued) >= 0 && queued <= 0) {
+        a2dp->packets_queued = 0;
+        measure = a2dp->packet_truesize <= 0;
+    }
 
     for (;;) {
         ssize_t l;
 
-        l = pa_write(u->stream_fd, a2dp->buffer, nbytes, &u->stream_write_type);
+        l = pa_write(u->stream_fd, packet, nbytes, &u->stream_write_type);
 
         pa_assert(l != 0);
 
@@ -851,15 +1221,177 @@ static int a2dp_process_render(struct userdata *u) {
             break;
         }
 
+        ret = 1;
+        a2dp->packets_queued++;
+
+        if (measure && a2dp_get_outq(u, &queued) >= 0 && queued > 0)
+            a2dp->packet_truesize = queued;
+
+        break;
+    }
+
+    return ret;
+}
+
+/* Run from IO thread */
+static int a2dp_process_render(struct userdata *u) {
+    ssize_t nbytes;
+    int ret;
+
+    pa_assert(u);
+    pa_assert(u->profile == PROFILE_A2DP);
+    pa_assert(u->sink);
+
+    /* First, render some data */
+    if (!u->write_memchunk.memblock)
+        pa_sink_render_full(u->sink, u->write_block_size, &u->write_memchunk);
+
+    pa_assert(u->write_memchunk.length == u->write_block_size);
+
+    a2dp_prepare_buffer(u);
+
+    if ((nbytes = a2dp_encode(u, &u->write_memchunk, u->a2dp.buffer, u->a2dp.buffer_size)) < 0)
+        return -1;
+
+    if ((ret = a2dp_write_packet(u, u->a2dp.buffer, (size_t) nbytes)) > 0) {
         u->write_index += (uint64_t) u->write_memchunk.length;
         pa_memblock_unref(u->write_memchunk.memblock);
         pa_memchunk_reset(&u->write_memchunk);
+    }
 
-        ret = 1;
+    return ret;
+}
 
-        break;
+/* Run from the encoder thread */
+static void a2dp_encoder_cb(void *userdata, const pa_memchunk *in, pa_memchunk *out) {
+    struct userdata *u = userdata;
+    ssize_t n;
+    size_t size;
+
+    pa_assert(u);
+    pa_assert(in->length % u->a2dp.codesize == 0);
+
+    size = sizeof(struct rtp_header) + sizeof(struct rtp_payload) + in->length / u->a2dp.codesize * u->a2dp.frame_length;
+
+    out->memblock = pa_memblock_new(u->core->mempool, size);
+    out->index = 0;
+
+    n = a2dp_encode(u, in, pa_memblock_acquire(out->memblock), size);
+    pa_memblock_release(out->memblock);
+
+    /* An empty packet tells the IO thread that encoding failed */
+    out->length = n < 0 ? 0 : (size_t) n;
+}
+
+/* Run from IO thread. Waits for the packet in the encoder thread, so
+ * that the encoder settings may be changed afterwards. */
+static int a2dp_encoder_sync(struct userdata *u) {
+    size_t length;
+
+    pa_assert(u);
+    pa_assert(u->encoder);
+
+    if ((length = pa_dsp_worker_get_length(u->encoder)) <= 0)
+        return 0;
+
+    /* There is never more than one packet on its way to the socket */
+    pa_assert(!u->encoded.memblock);
+
+    if (!pa_dsp_worker_is_done(u->encoder))
+        u->encoder_waits++;
+
+    pa_assert_se(pa_dsp_worker_collect(u->encoder, &u->encoded) >= 0);
+    u->encoded_pcm_length = length;
+    u->encoder_packets++;
+
+    if (u->encoded.length <= 0) {
+        pa_memblock_unref(u->encoded.memblock);
+        pa_memchunk_reset(&u->encoded);
+        return -1;
     }
 
+    return 0;
+}
+
+/* Run from IO thread */
+static void a2dp_encoder_drop(struct userdata *u) {
+    pa_assert(u);
+    pa_assert(u->encoder);
+
+    a2dp_encoder_sync(u);
+
+    if (u->encoded.memblock) {
+        pa_memblock_unref(u->encoded.memblock);
+        pa_memchunk_reset(&u->encoded);
+    }
+}
+
+/* Run from IO thread. The PCM data that was rendered, but not yet
+ * written to the socket. */
+static size_t a2dp_encoder_get_pending(struct userdata *u) {
+    pa_assert(u);
+
+    if (!u->encoder)
+        return 0;
+
+    return pa_dsp_worker_get_length(u->encoder) + (u->encoded.memblock ? u->encoded_pcm_length : 0);
+}
+
+/* Run from IO thread. The PCM data that was written to the socket, but
+ * is still queued up there. */
+static size_t a2dp_socket_get_pending(struct userdata *u) {
+    unsigned n;
+
+    pa_assert(u);
+
+    if (u->profile != PROFILE_A2DP || a2dp_get_queued_packets(u, &n) < 0)
+        return 0;
+
+    return n * u->write_block_size;
+}
+
+/* Run from IO thread. Like a2dp_process_render(), but the next block is
+ * rendered and handed to the encoder thread as soon as a packet was
+ * written, so that it is ready when the socket becomes writable
+ * again. */
+static int a2dp_process_render_threaded(struct userdata *u) {
+    pa_memchunk pcm;
+    void *p;
+    int ret;
+
+    pa_assert(u);
+    pa_assert(u->profile == PROFILE_A2DP);
+    pa_assert(u->sink);
+    pa_assert(u->encoder);
+
+    if (!u->encoded.memblock) {
+
+        /* Nothing was encoded ahead, as for the first packet */
+        if (pa_dsp_worker_get_length(u->encoder) <= 0) {
+            pa_sink_render_full(u->sink, u->write_block_size, &pcm);
+            pa_dsp_worker_submit(u->encoder, &pcm);
+            pa_memblock_unref(pcm.memblock);
+        }
+
+        if (a2dp_encoder_sync(u) < 0)
+            return -1;
+    }
+
+    p = (uint8_t*) pa_memblock_acquire(u->encoded.memblock) + u->encoded.index;
+    ret = a2dp_write_packet(u, p, u->encoded.length);
+    pa_memblock_release(u->encoded.memblock);
+
+    if (ret <= 0)
+        return ret;
+
+    u->write_index += (uint64_t) u->encoded_pcm_length;
+    pa_memblock_unref(u->encoded.memblock);
+    pa_memchunk_reset(&u->encoded);
+
+    pa_sink_render_full(u->sink, u->write_block_size, &pcm);
+    pa_dsp_worker_submit(u->encoder, &pcm);
+    pa_memblock_unref(pcm.memblock);
+
     return ret;
 }
 
@@ -998,6 +1530,66 @@ static void a2dp_reduce_bitpool(struct userdata *u)
     a2dp_set_bitpool(u, bitpool);
 }
 
+static void a2dp_raise_bitpool(struct userdata *u)
+{
+    struct a2dp_info *a2dp;
+
+    pa_assert(u);
+
+    a2dp = &u->a2dp;
+
+    if (a2dp->sbc.bitpool >= a2dp->max_bitpool)
+        return;
+
+    a2dp_set_bitpool(u, (uint8_t) PA_MIN(a2dp->sbc.bitpool + BITPOOL_INC_STEP, a2dp->max_bitpool));
+}
+
+/* Run from IO thread, after each attempt to write a packet. If packets
+ * pile up in the socket the link cannot keep up with the bitrate, so
+ * the bitpool is lowered. Once the queue has stayed short for a while
+ * it is raised step by step, up to the negotiated maximum. */
+static void a2dp_update_bitpool(struct userdata *u, pa_bool_t blocked) {
+    struct a2dp_info *a2dp;
+    pa_usec_t now;
+
+    pa_assert(u);
+
+    a2dp = &u->a2dp;
+
+    if (!blocked) {
+        unsigned n;
+
+        if (a2dp_get_queued_packets(u, &n) < 0)
+            return;
+
+        if (n <= BITPOOL_OUTQ_HIGH) {
+            now = pa_rtclock_now();
+
+            if (n > BITPOOL_OUTQ_LOW)
+                a2dp->outq_low_since = 0;
+            else if (a2dp->outq_low_since <= 0)
+                a2dp->outq_low_since = now;
+            else if (now >= a2dp->outq_low_since + BITPOOL_INC_INTERVAL &&
+                     now >= a2dp->bitpool_changed_at + BITPOOL_INC_INTERVAL &&
+                     a2dp->sbc.bitpool < a2dp->max_bitpool) {
+                pa_log_debug("Send queue has been short for a while, raising bitpool");
+                a2dp_raise_bitpool(u);
+                a2dp->outq_low_since = now;
+            }
+
+            return;
+        }
+    }
+
+    a2dp->outq_low_since = 0;
+
+    if (pa_rtclock_now() >= a2dp->bitpool_changed_at + BITPOOL_DEC_INTERVAL &&
+        a2dp->sbc.bitpool > BITPOOL_DEC_LIMIT) {
+        pa_log_debug("Send queue is backed up, lowering bitpool");
+        a2dp_reduce_bitpool(u);
+    }
+}
+
 static void thread_func(void *userdata) {
     struct userdata *u = userdata;
     unsigned do_write = 0;
@@ -1009,8 +1601,7 @@ static void thread_func(void *userdata) {
 
     pa_log_debug("IO Thread starting up");
 
-    if (u->core->realtime_scheduling)
-        pa_make_realtime(u->core->realtime_priority);
+    pa_core_setup_io_thread(u->core, u->rtprio, u->cpu_affinity);
 
     pa_thread_mq_install(&u->thread_mq);
 
@@ -1032,7 +1623,7 @@ static void thread_func(void *userdata) {
             if (u->write_index == 0 && u->read_index <= 0)
                 do_write = 2;
 
-            if (pollfd && (pollfd->revents & POLLIN)) {
+            if (pollfd && (SCO_BATCHED(u) ? pa_rtclock_now() >= u->sco_next_wakeup : !!(pollfd->revents & POLLIN))) {
                 int n_read;
 
                 if (u->profile == PROFILE_HSP || u->profile == PROFILE_HFGW)
@@ -1047,6 +1638,27 @@ static void thread_func(void *userdata) {
                 pending_read_bytes += n_read;
                 do_write += pending_read_bytes / u->write_block_size;
                 pending_read_bytes = pending_read_bytes % u->write_block_size;
+
+                if (SCO_BATCHED(u)) {
+                    pa_usec_t now, interval;
+
+                    /* The next batch is complete sco_batch packets after
+                     * the last one we got, give it half a packet to
+                     * arrive. Until packets flow, look once per packet. */
+                    now = pa_rtclock_now();
+                    interval = pa_bytes_to_usec(sco_pcm_size(u, u->sco_packet_size), &u->sample_spec);
+
+                    if (n_read > 0)
+                        u->sco_next_wakeup = u->sco_last_rx + u->sco_batch * interval + interval / 2;
+
+                    if (n_read <= 0 || u->sco_next_wakeup <= now)
+                        u->sco_next_wakeup = now + interval;
+                }
+            }
+
+            if (pollfd && SCO_BATCHED(u)) {
+                pa_rtpoll_set_timer_absolute(u->rtpoll, u->sco_next_wakeup);
+                disable_timer = FALSE;
             }
         }
 
@@ -1096,7 +1708,7 @@ static void thread_func(void *userdata) {
                             }
                         }
 
-                        do_write = 1;
+                        do_write = SCO_BATCHED(u) ? u->sco_batch : 1;
                         pending_read_bytes = 0;
                     }
                 }
@@ -1107,17 +1719,23 @@ static void thread_func(void *userdata) {
                     if (u->write_index <= 0)
                         u->started_at = pa_rtclock_now();
 
-                    if (u->profile == PROFILE_A2DP) {
+                    if (u->encoder) {
+                        if ((n_written = a2dp_process_render_threaded(u)) < 0)
+                            goto fail;
+                    } else if (u->profile == PROFILE_A2DP) {
                         if ((n_written = a2dp_process_render(u)) < 0)
                             goto fail;
                     } else {
-                        if ((n_written = hsp_process_render(u)) < 0)
+                        if ((n_written = hsp_process_render(u, PA_MIN(do_write, SCO_BATCHED(u) ? SCO_BATCH_MAX : 1))) < 0)
                             goto fail;
                     }
 
                     if (n_written == 0)
                         pa_log("Broken kernel: we got EAGAIN on write() after POLLOUT!");
 
+                    if (u->profile == PROFILE_A2DP)
+                        a2dp_update_bitpool(u, n_written == 0);
+
                     do_write -= n_written;
                     writable = FALSE;
                 }
@@ -1149,7 +1767,7 @@ static void thread_func(void *userdata) {
         /* Hmm, nothing to do. Let's sleep */
         if (pollfd)
             pollfd->events = (short) (((u->sink && PA_SINK_IS_LINKED(u->sink->thread_info.state) && !writable) ? POLLOUT : 0) |
-                                      (u->source && PA_SOURCE_IS_LINKED(u->source->thread_info.state) ? POLLIN : 0));
+                                      (u->source && PA_SOURCE_IS_LINKED(u->source->thread_info.state) && !SCO_BATCHED(u) ? POLLIN : 0));
 
         if ((ret = pa_rtpoll_run(u->rtpoll, TRUE)) < 0) {
             pa_log_debug("pa_rtpoll_run failed with: %d", ret);
@@ -1180,6 +1798,11 @@ fail:
     pa_asyncmsgq_wait_for(u->thread_mq.inq, PA_MESSAGE_SHUTDOWN);
 
 finish:
+    if (u->encoder)
+        pa_log_debug("Encoder thread encoded %llu packets, %llu of them were not ready in time",
+                     (unsigned long long) u->encoder_packets,
+                     (unsigned long long) u->encoder_waits);
+
     pa_log_debug("IO thread shutting down");
 }
 
@@ -1878,13 +2501,40 @@ static void bt_transport_config_a2dp(struct userdata *u) {
                 a2dp->sbc.allocation, a2dp->sbc.subbands, a2dp->sbc.blocks, a2dp->sbc.bitpool);
 }
 
+static void bt_transport_config_msbc(struct userdata *u) {
+    struct hsp_info *hsp = &u->hsp;
+
+    if (hsp->msbc_initialized) {
+        sbc_reinit(&hsp->msbc_enc, SBC_MSBC);
+        sbc_reinit(&hsp->msbc_dec, SBC_MSBC);
+    } else {
+        sbc_init(&hsp->msbc_enc, SBC_MSBC);
+        sbc_init(&hsp->msbc_dec, SBC_MSBC);
+    }
+    hsp->msbc_initialized = TRUE;
+
+    pa_log_info("Using mSBC for wideband speech");
+}
+
 static void bt_transport_config(struct userdata *u) {
     if (u->profile == PROFILE_HSP || u->profile == PROFILE_HFGW) {
+        const pa_bluetooth_transport *t;
+
+        t = pa_bluetooth_discovery_get_transport(u->discovery, u->transport);
+        pa_assert(t);
+
+        u->hsp.msbc = t->codec == HFP_AUDIO_CODEC_MSBC;
+
         u->sample_spec.format = PA_SAMPLE_S16LE;
         u->sample_spec.channels = 1;
-        u->sample_spec.rate = 8000;
-    } else
+        u->sample_spec.rate = u->hsp.msbc ? 16000 : 8000;
+
+        if (u->hsp.msbc)
+            bt_transport_config_msbc(u);
+    } else {
+        u->hsp.msbc = FALSE;
         bt_transport_config_a2dp(u);
+    }
 }
 
 /* Run from main thread */
@@ -1959,6 +2609,18 @@ static void stop_thread(struct userdata *u) {
         u->thread = NULL;
     }
 
+    if (u->encoder) {
+        pa_dsp_worker_free(u->encoder);
+        u->encoder = NULL;
+    }
+
+    if (u->encoded.memblock) {
+        pa_memblock_unref(u->encoded.memblock);
+        pa_memchunk_reset(&u->encoded);
+    }
+
+    u->encoder_packets = u->encoder_waits = 0;
+
     if (u->rtpoll_item) {
         pa_rtpoll_item_free(u->rtpoll_item);
         u->rtpoll_item = NULL;
@@ -2049,6 +2711,12 @@ static int start_thread(struct userdata *u) {
         return 0;
     }
 
+    if (u->profile == PROFILE_A2DP && u->encoder_thread &&
+        !(u->encoder = pa_dsp_worker_new(u->core, "bluetooth-encoder", u->rtprio, u->cpu_affinity, a2dp_encoder_cb, u))) {
+        stop_thread(u);
+        return -1;
+    }
+
     if (!(u->thread = pa_thread_new("bluetooth", thread_func, u))) {
         pa_log_error("Failed to create IO thread");
         stop_thread(u);
@@ -2507,6 +3175,31 @@ int pa__init(pa_module* m) {
         goto fail;
     }
 
+    u->rtprio = -1;
+    if (pa_modargs_get_io_thread_args(ma, &u->rtprio, &u->cpu_affinity) < 0) {
+        pa_log("Failed to parse realtime_priority= or cpu_affinity= argument");
+        goto fail;
+    }
+
+    if (pa_modargs_get_value_boolean(ma, "encoder_thread", &u->encoder_thread) < 0) {
+        pa_log("Failed to parse encoder_thread= argument");
+        goto fail;
+    }
+
+    u->sco_batch = 1;
+    if (pa_modargs_get_value_u32(ma, "sco_batch", &u->sco_batch) < 0 ||
+        u->sco_batch < 1 || u->sco_batch > SCO_BATCH_MAX) {
+        pa_log("Failed to parse sco_batch= argument, expected a number between 1 and %u", SCO_BATCH_MAX);
+        goto fail;
+    }
+
+    u->a2dp_frames = 0;
+    if (pa_modargs_get_value_u32(ma, "a2dp_frames", &u->a2dp_frames) < 0 ||
+        u->a2dp_frames > A2DP_FRAMES_MAX) {
+        pa_log("Failed to parse a2dp_frames= argument, expected a number between 0 and %u", A2DP_FRAMES_MAX);
+        goto fail;
+    }
+
     channels = u->sample_spec.channels;
     if (pa_modargs_get_value_u32(ma, "channels", &channels) < 0 ||
         channels <= 0 || channels > PA_CHANNELS_MAX) {
@@ -2652,12 +3345,15 @@ void pa__done(pa_module *m) {
         pa_xfree(u->a2dp.buffer);
 
     sbc_finish(&u->a2dp.sbc);
+    sbc_finish(&u->hsp.msbc_enc);
+    sbc_finish(&u->hsp.msbc_dec);
 
     if (u->modargs)
         pa_modargs_free(u->modargs);
 
     pa_xfree(u->address);
     pa_xfree(u->path);
+    pa_xfree(u->cpu_affinity);
 
     if (u->transport) {
         bt_transport_release(u);
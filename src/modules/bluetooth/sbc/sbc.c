@@ -51,6 +51,12 @@
 
 #define SBC_SYNCWORD	0x9C
 
+/* mSBC (HFP wideband speech) frames have a syncword of their own, and
+ * the header bytes after it are reserved. The parameters are fixed. */
+#define MSBC_SYNCWORD	0xAD
+#define MSBC_BLOCKS	15
+#define MSBC_BITPOOL	26
+
 /* This structure contains an unpacked SBC frame.
    Yes, there is probably quite some unused space herein */
 struct sbc_frame {
@@ -90,12 +96,6 @@ struct sbc_frame {
 	int16_t SBC_ALIGNED pcm_sample[2][16*8];
 };
 
-struct sbc_decoder_state {
-	int subbands;
-	int32_t V[2][170];
-	int offset[2][16];
-};
-
 /*
  * Calculates the CRC-8 of the first len bits in data
  */
@@ -374,7 +374,7 @@ static void sbc_calculate_bits(const struct sbc_frame *frame, int (*bits)[8])
  *  -4   Bitpool value out of bounds
  */
 static int sbc_unpack_frame(const uint8_t *data, struct sbc_frame *frame,
-								size_t len)
+							size_t len, int msbc)
 {
 	unsigned int consumed;
 	/* Will copy the parts of the header that are relevant to crc
@@ -388,49 +388,66 @@ static int sbc_unpack_frame(const uint8_t *data, struct sbc_frame *frame,
 				   counters */
 	int bits[2][8];		/* bits distribution */
 	uint32_t levels[2][8];	/* levels derived from that */
+	uint64_t reciprocal[2][8];	/* rounded up 2^shift / levels */
+	int frac_bits[2][8];	/* fractional bits of the reciprocals */
 
 	if (len < 4)
 		return -1;
 
-	if (data[0] != SBC_SYNCWORD)
-		return -2;
-
-	frame->frequency = (data[1] >> 6) & 0x03;
-
-	frame->block_mode = (data[1] >> 4) & 0x03;
-	switch (frame->block_mode) {
-	case SBC_BLK_4:
-		frame->blocks = 4;
-		break;
-	case SBC_BLK_8:
-		frame->blocks = 8;
-		break;
-	case SBC_BLK_12:
-		frame->blocks = 12;
-		break;
-	case SBC_BLK_16:
-		frame->blocks = 16;
-		break;
-	}
+	if (msbc) {
+		if (data[0] != MSBC_SYNCWORD || data[1] != 0 || data[2] != 0)
+			return -2;
 
-	frame->mode = (data[1] >> 2) & 0x03;
-	switch (frame->mode) {
-	case MONO:
+		frame->frequency = SBC_FREQ_16000;
+		frame->block_mode = SBC_BLK_16;
+		frame->blocks = MSBC_BLOCKS;
+		frame->mode = MONO;
 		frame->channels = 1;
-		break;
-	case DUAL_CHANNEL:	/* fall-through */
-	case STEREO:
-	case JOINT_STEREO:
-		frame->channels = 2;
-		break;
-	}
+		frame->allocation = LOUDNESS;
+		frame->subband_mode = SBC_SB_8;
+		frame->subbands = 8;
+		frame->bitpool = MSBC_BITPOOL;
+	} else {
+		if (data[0] != SBC_SYNCWORD)
+			return -2;
+
+		frame->frequency = (data[1] >> 6) & 0x03;
+
+		frame->block_mode = (data[1] >> 4) & 0x03;
+		switch (frame->block_mode) {
+		case SBC_BLK_4:
+			frame->blocks = 4;
+			break;
+		case SBC_BLK_8:
+			frame->blocks = 8;
+			break;
+		case SBC_BLK_12:
+			frame->blocks = 12;
+			break;
+		case SBC_BLK_16:
+			frame->blocks = 16;
+			break;
+		}
 
-	frame->allocation = (data[1] >> 1) & 0x01;
+		frame->mode = (data[1] >> 2) & 0x03;
+		switch (frame->mode) {
+		case MONO:
+			frame->channels = 1;
+			break;
+		case DUAL_CHANNEL:	/* fall-through */
+		case STEREO:
+		case JOINT_STEREO:
+			frame->channels = 2;
+			break;
+		}
 
-	frame->subband_mode = (data[1] & 0x01);
-	frame->subbands = frame->subband_mode ? 8 : 4;
+		frame->allocation = (data[1] >> 1) & 0x01;
 
-	frame->bitpool = data[2];
+		frame->subband_mode = (data[1] & 0x01);
+		frame->subbands = frame->subband_mode ? 8 : 4;
+
+		frame->bitpool = data[2];
+	}
 
 	if ((frame->mode == MONO || frame->mode == DUAL_CHANNEL) &&
 			frame->bitpool > 16 * frame->subbands)
@@ -485,15 +502,37 @@ static int sbc_unpack_frame(const uint8_t *data, struct sbc_frame *frame,
 
 	sbc_calculate_bits(frame, bits);
 
+	/*
+	 * Each sample is ((2 * audio_sample + 1) << shift) / levels, with
+	 * levels = 2^bits - 1. Instead of dividing each of them this is
+	 * multiplied with a reciprocal that is rounded up and has
+	 * 2 * bits + 1 fractional bits: with x = 2 * audio_sample + 1 the
+	 * error stays below x / 2^(2 * bits + 1) < 1 / levels, which is less
+	 * than the distance of the exact quotient to the next integer, so
+	 * the results are exact.
+	 */
 	for (ch = 0; ch < frame->channels; ch++) {
-		for (sb = 0; sb < frame->subbands; sb++)
+		for (sb = 0; sb < frame->subbands; sb++) {
+			uint32_t shift = frame->scale_factor[ch][sb] +
+					1 + SBCDEC_FIXED_EXTRA_BITS;
+
 			levels[ch][sb] = (1 << bits[ch][sb]) - 1;
+
+			if (levels[ch][sb] == 0)
+				continue;
+
+			frac_bits[ch][sb] = 2 * bits[ch][sb] + 1;
+			reciprocal[ch][sb] = (((uint64_t) 1 <<
+					(shift + frac_bits[ch][sb])) +
+					levels[ch][sb] - 1) / levels[ch][sb];
+		}
 	}
 
 	for (blk = 0; blk < frame->blocks; blk++) {
 		for (ch = 0; ch < frame->channels; ch++) {
 			for (sb = 0; sb < frame->subbands; sb++) {
 				uint32_t shift;
+				int n = bits[ch][sb];
 
 				if (levels[ch][sb] == 0) {
 					frame->sb_sample[blk][ch][sb] = 0;
@@ -503,20 +542,24 @@ static int sbc_unpack_frame(const uint8_t *data, struct sbc_frame *frame,
 				shift = frame->scale_factor[ch][sb] +
 						1 + SBCDEC_FIXED_EXTRA_BITS;
 
-				audio_sample = 0;
-				for (bit = 0; bit < bits[ch][sb]; bit++) {
-					if (consumed > len * 8)
-						return -1;
+				/* The last bit may be the one right after
+				 * the data, as it always was */
+				if (consumed + n - 1 > len * 8)
+					return -1;
 
-					if ((data[consumed >> 3] >> (7 - (consumed & 0x7))) & 0x01)
-						audio_sample |= 1 << (bits[ch][sb] - bit - 1);
+				/* At most 16 bits, from up to 3 bytes */
+				audio_sample = 0;
+				for (bit = consumed & ~0x7; bit < (int) (consumed + n); bit += 8)
+					audio_sample = (audio_sample << 8) | data[bit >> 3];
 
-					consumed++;
-				}
+				audio_sample >>= (8 - ((consumed + n) & 0x7)) & 0x7;
+				audio_sample &= (1 << n) - 1;
+				consumed += n;
 
 				frame->sb_sample[blk][ch][sb] = (int32_t)
-					(((((uint64_t) audio_sample << 1) | 1) << shift) /
-					levels[ch][sb]) - (1 << shift);
+					(((((uint64_t) audio_sample << 1) | 1) *
+					reciprocal[ch][sb]) >> frac_bits[ch][sb]) -
+					(1 << shift);
 			}
 		}
 	}
@@ -553,104 +596,8 @@ static void sbc_decoder_init(struct sbc_decoder_state *state,
 	for (ch = 0; ch < 2; ch++)
 		for (i = 0; i < frame->subbands * 2; i++)
 			state->offset[ch][i] = (10 * i + 10);
-}
-
-static SBC_ALWAYS_INLINE int16_t sbc_clip16(int32_t s)
-{
-	if (s > 0x7FFF)
-		return 0x7FFF;
-	else if (s < -0x8000)
-		return -0x8000;
-	else
-		return s;
-}
 
-static inline void sbc_synthesize_four(struct sbc_decoder_state *state,
-				struct sbc_frame *frame, int ch, int blk)
-{
-	int i, k, idx;
-	int32_t *v = state->V[ch];
-	int *offset = state->offset[ch];
-
-	for (i = 0; i < 8; i++) {
-		/* Shifting */
-		offset[i]--;
-		if (offset[i] < 0) {
-			offset[i] = 79;
-			memcpy(v + 80, v, 9 * sizeof(*v));
-		}
-
-		/* Distribute the new matrix value to the shifted position */
-		v[offset[i]] = SCALE4_STAGED1(
-			MULA(synmatrix4[i][0], frame->sb_sample[blk][ch][0],
-			MULA(synmatrix4[i][1], frame->sb_sample[blk][ch][1],
-			MULA(synmatrix4[i][2], frame->sb_sample[blk][ch][2],
-			MUL (synmatrix4[i][3], frame->sb_sample[blk][ch][3])))));
-	}
-
-	/* Compute the samples */
-	for (idx = 0, i = 0; i < 4; i++, idx += 5) {
-		k = (i + 4) & 0xf;
-
-		/* Store in output, Q0 */
-		frame->pcm_sample[ch][blk * 4 + i] = sbc_clip16(SCALE4_STAGED1(
-			MULA(v[offset[i] + 0], sbc_proto_4_40m0[idx + 0],
-			MULA(v[offset[k] + 1], sbc_proto_4_40m1[idx + 0],
-			MULA(v[offset[i] + 2], sbc_proto_4_40m0[idx + 1],
-			MULA(v[offset[k] + 3], sbc_proto_4_40m1[idx + 1],
-			MULA(v[offset[i] + 4], sbc_proto_4_40m0[idx + 2],
-			MULA(v[offset[k] + 5], sbc_proto_4_40m1[idx + 2],
-			MULA(v[offset[i] + 6], sbc_proto_4_40m0[idx + 3],
-			MULA(v[offset[k] + 7], sbc_proto_4_40m1[idx + 3],
-			MULA(v[offset[i] + 8], sbc_proto_4_40m0[idx + 4],
-			MUL( v[offset[k] + 9], sbc_proto_4_40m1[idx + 4]))))))))))));
-	}
-}
-
-static inline void sbc_synthesize_eight(struct sbc_decoder_state *state,
-				struct sbc_frame *frame, int ch, int blk)
-{
-	int i, j, k, idx;
-	int *offset = state->offset[ch];
-
-	for (i = 0; i < 16; i++) {
-		/* Shifting */
-		offset[i]--;
-		if (offset[i] < 0) {
-			offset[i] = 159;
-			for (j = 0; j < 9; j++)
-				state->V[ch][j + 160] = state->V[ch][j];
-		}
-
-		/* Distribute the new matrix value to the shifted position */
-		state->V[ch][offset[i]] = SCALE8_STAGED1(
-			MULA(synmatrix8[i][0], frame->sb_sample[blk][ch][0],
-			MULA(synmatrix8[i][1], frame->sb_sample[blk][ch][1],
-			MULA(synmatrix8[i][2], frame->sb_sample[blk][ch][2],
-			MULA(synmatrix8[i][3], frame->sb_sample[blk][ch][3],
-			MULA(synmatrix8[i][4], frame->sb_sample[blk][ch][4],
-			MULA(synmatrix8[i][5], frame->sb_sample[blk][ch][5],
-			MULA(synmatrix8[i][6], frame->sb_sample[blk][ch][6],
-			MUL( synmatrix8[i][7], frame->sb_sample[blk][ch][7])))))))));
-	}
-
-	/* Compute the samples */
-	for (idx = 0, i = 0; i < 8; i++, idx += 5) {
-		k = (i + 8) & 0xf;
-
-		/* Store in output, Q0 */
-		frame->pcm_sample[ch][blk * 8 + i] = sbc_clip16(SCALE8_STAGED1(
-			MULA(state->V[ch][offset[i] + 0], sbc_proto_8_80m0[idx + 0],
-			MULA(state->V[ch][offset[k] + 1], sbc_proto_8_80m1[idx + 0],
-			MULA(state->V[ch][offset[i] + 2], sbc_proto_8_80m0[idx + 1],
-			MULA(state->V[ch][offset[k] + 3], sbc_proto_8_80m1[idx + 1],
-			MULA(state->V[ch][offset[i] + 4], sbc_proto_8_80m0[idx + 2],
-			MULA(state->V[ch][offset[k] + 5], sbc_proto_8_80m1[idx + 2],
-			MULA(state->V[ch][offset[i] + 6], sbc_proto_8_80m0[idx + 3],
-			MULA(state->V[ch][offset[k] + 7], sbc_proto_8_80m1[idx + 3],
-			MULA(state->V[ch][offset[i] + 8], sbc_proto_8_80m0[idx + 4],
-			MUL( state->V[ch][offset[k] + 9], sbc_proto_8_80m1[idx + 4]))))))))))));
-	}
+	sbc_init_decoder_primitives(state);
 }
 
 static int sbc_synthesize_audio(struct sbc_decoder_state *state,
@@ -662,14 +609,18 @@ static int sbc_synthesize_audio(struct sbc_decoder_state *state,
 	case 4:
 		for (ch = 0; ch < frame->channels; ch++) {
 			for (blk = 0; blk < frame->blocks; blk++)
-				sbc_synthesize_four(state, frame, ch, blk);
+				state->sbc_synthesize_4s(state,
+					frame->sb_sample[blk][ch],
+					&frame->pcm_sample[ch][blk * 4], ch);
 		}
 		return frame->blocks * 4;
 
 	case 8:
 		for (ch = 0; ch < frame->channels; ch++) {
 			for (blk = 0; blk < frame->blocks; blk++)
-				sbc_synthesize_eight(state, frame, ch, blk);
+				state->sbc_synthesize_8s(state,
+					frame->sb_sample[blk][ch],
+					&frame->pcm_sample[ch][blk * 8], ch);
 		}
 		return frame->blocks * 8;
 
@@ -701,6 +652,22 @@ static int sbc_analyze_audio(struct sbc_encoder_state *state,
 		return frame->blocks * 4;
 
 	case 8:
+		if (frame->blocks % 4) {
+			/* Like with the 15 blocks of mSBC. These can't be
+			 * done 4 at a time, but block by block. */
+			for (ch = 0; ch < frame->channels; ch++) {
+				for (blk = 0; blk < frame->blocks; blk++) {
+					int pos = state->position +
+						(frame->blocks - 1 - blk) * 8;
+					state->sbc_analyze_1b_8s(
+						&state->X[ch][pos],
+						frame->sb_sample_f[blk][ch],
+						pos & 8);
+				}
+			}
+			return frame->blocks * 8;
+		}
+
 		for (ch = 0; ch < frame->channels; ch++) {
 			x = &state->X[ch][state->position - 32 +
 							frame->blocks * 8];
@@ -766,7 +733,7 @@ static int sbc_analyze_audio(struct sbc_encoder_state *state,
 static SBC_ALWAYS_INLINE ssize_t sbc_pack_frame_internal(uint8_t *data,
 					struct sbc_frame *frame, size_t len,
 					int frame_subbands, int frame_channels,
-					int joint)
+					int joint, int msbc)
 {
 	/* Bitstream writer starts from the fourth byte */
 	uint8_t *data_ptr = data + 4;
@@ -816,6 +783,12 @@ static SBC_ALWAYS_INLINE ssize_t sbc_pack_frame_internal(uint8_t *data,
 			frame->bitpool > frame_subbands << 5)
 		return -5;
 
+	if (msbc) {
+		data[0] = MSBC_SYNCWORD;
+		data[1] = 0;
+		data[2] = 0;
+	}
+
 	/* Can't fill in crc yet */
 
 	crc_header[0] = data[1];
@@ -881,22 +854,22 @@ static SBC_ALWAYS_INLINE ssize_t sbc_pack_frame_internal(uint8_t *data,
 }
 
 static ssize_t sbc_pack_frame(uint8_t *data, struct sbc_frame *frame, size_t len,
-								int joint)
+						int joint, int msbc)
 {
 	if (frame->subbands == 4) {
 		if (frame->channels == 1)
 			return sbc_pack_frame_internal(
-				data, frame, len, 4, 1, joint);
+				data, frame, len, 4, 1, joint, msbc);
 		else
 			return sbc_pack_frame_internal(
-				data, frame, len, 4, 2, joint);
+				data, frame, len, 4, 2, joint, msbc);
 	} else {
 		if (frame->channels == 1)
 			return sbc_pack_frame_internal(
-				data, frame, len, 8, 1, joint);
+				data, frame, len, 8, 1, joint, msbc);
 		else
 			return sbc_pack_frame_internal(
-				data, frame, len, 8, 2, joint);
+				data, frame, len, 8, 2, joint, msbc);
 	}
 }
 
@@ -909,6 +882,14 @@ static void sbc_encoder_init(struct sbc_encoder_state *state,
 	sbc_init_primitives(state);
 }
 
+static int sbc_blocks(sbc_t *sbc)
+{
+	if (sbc->flags & SBC_MSBC)
+		return MSBC_BLOCKS;
+
+	return 4 + (sbc->blocks * 4);
+}
+
 struct sbc_priv {
 	int init;
 	struct SBC_ALIGNED sbc_frame frame;
@@ -918,11 +899,25 @@ struct sbc_priv {
 
 static void sbc_set_defaults(sbc_t *sbc, unsigned long flags)
 {
-	sbc->frequency = SBC_FREQ_44100;
-	sbc->mode = SBC_MODE_STEREO;
-	sbc->subbands = SBC_SB_8;
-	sbc->blocks = SBC_BLK_16;
-	sbc->bitpool = 32;
+	sbc->flags = flags;
+
+	if (flags & SBC_MSBC) {
+		/* None of these may be changed for mSBC, and blocks is
+		 * not used, there are always MSBC_BLOCKS */
+		sbc->frequency = SBC_FREQ_16000;
+		sbc->mode = SBC_MODE_MONO;
+		sbc->subbands = SBC_SB_8;
+		sbc->blocks = SBC_BLK_16;
+		sbc->allocation = SBC_AM_LOUDNESS;
+		sbc->bitpool = MSBC_BITPOOL;
+	} else {
+		sbc->frequency = SBC_FREQ_44100;
+		sbc->mode = SBC_MODE_STEREO;
+		sbc->subbands = SBC_SB_8;
+		sbc->blocks = SBC_BLK_16;
+		sbc->bitpool = 32;
+	}
+
 #if __BYTE_ORDER == __LITTLE_ENDIAN
 	sbc->endian = SBC_LE;
 #elif __BYTE_ORDER == __BIG_ENDIAN
@@ -970,7 +965,8 @@ ssize_t sbc_decode(sbc_t *sbc, const void *input, size_t input_len,
 
 	priv = sbc->priv;
 
-	framelen = sbc_unpack_frame(input, &priv->frame, input_len);
+	framelen = sbc_unpack_frame(input, &priv->frame, input_len,
+						sbc->flags & SBC_MSBC);
 
 	if (!priv->init) {
 		sbc_decoder_init(&priv->dec_state, &priv->frame);
@@ -1053,7 +1049,7 @@ ssize_t sbc_encode(sbc_t *sbc, const void *input, size_t input_len,
 		priv->frame.subband_mode = sbc->subbands;
 		priv->frame.subbands = sbc->subbands ? 8 : 4;
 		priv->frame.block_mode = sbc->blocks;
-		priv->frame.blocks = 4 + (sbc->blocks * 4);
+		priv->frame.blocks = sbc_blocks(sbc);
 		priv->frame.bitpool = sbc->bitpool;
 		priv->frame.codesize = sbc_get_codesize(sbc);
 		priv->frame.length = sbc_get_frame_length(sbc);
@@ -1074,7 +1070,14 @@ ssize_t sbc_encode(sbc_t *sbc, const void *input, size_t input_len,
 		return -ENOSPC;
 
 	/* Select the needed input data processing function and call it */
-	if (priv->frame.subbands == 8) {
+	if (sbc->flags & SBC_MSBC) {
+		if (sbc->endian == SBC_BE)
+			sbc_enc_process_input =
+				priv->enc_state.sbc_enc_process_input_8s_msbc_be;
+		else
+			sbc_enc_process_input =
+				priv->enc_state.sbc_enc_process_input_8s_msbc_le;
+	} else if (priv->frame.subbands == 8) {
 		if (sbc->endian == SBC_BE)
 			sbc_enc_process_input =
 				priv->enc_state.sbc_enc_process_input_8s_be;
@@ -1101,13 +1104,15 @@ ssize_t sbc_encode(sbc_t *sbc, const void *input, size_t input_len,
 		int j = priv->enc_state.sbc_calc_scalefactors_j(
 			priv->frame.sb_sample_f, priv->frame.scale_factor,
 			priv->frame.blocks, priv->frame.subbands);
-		framelen = sbc_pack_frame(output, &priv->frame, output_len, j);
+		framelen = sbc_pack_frame(output, &priv->frame, output_len, j,
+						sbc->flags & SBC_MSBC);
 	} else {
 		priv->enc_state.sbc_calc_scalefactors(
 			priv->frame.sb_sample_f, priv->frame.scale_factor,
 			priv->frame.blocks, priv->frame.channels,
 			priv->frame.subbands);
-		framelen = sbc_pack_frame(output, &priv->frame, output_len, 0);
+		framelen = sbc_pack_frame(output, &priv->frame, output_len, 0,
+						sbc->flags & SBC_MSBC);
 	}
 
 	if (written)
@@ -1137,7 +1142,7 @@ size_t sbc_get_frame_length(sbc_t *sbc)
 		return priv->frame.length;
 
 	subbands = sbc->subbands ? 8 : 4;
-	blocks = 4 + (sbc->blocks * 4);
+	blocks = sbc_blocks(sbc);
 	channels = sbc->mode == SBC_MODE_MONO ? 1 : 2;
 	joint = sbc->mode == SBC_MODE_JOINT_STEREO ? 1 : 0;
 	bitpool = sbc->bitpool;
@@ -1161,7 +1166,7 @@ unsigned sbc_get_frame_duration(sbc_t *sbc)
 	priv = sbc->priv;
 	if (!priv->init) {
 		subbands = sbc->subbands ? 8 : 4;
-		blocks = 4 + (sbc->blocks * 4);
+		blocks = sbc_blocks(sbc);
 	} else {
 		subbands = priv->frame.subbands;
 		blocks = priv->frame.blocks;
@@ -1198,7 +1203,7 @@ size_t sbc_get_codesize(sbc_t *sbc)
 	priv = sbc->priv;
 	if (!priv->init) {
 		subbands = sbc->subbands ? 8 : 4;
-		blocks = 4 + (sbc->blocks * 4);
+		blocks = sbc_blocks(sbc);
 		channels = sbc->mode == SBC_MODE_MONO ? 1 : 2;
 	} else {
 		subbands = priv->frame.subbands;
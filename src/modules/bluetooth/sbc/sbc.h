@@ -60,6 +60,9 @@ extern "C" {
 #define SBC_SB_4		0x00
 #define SBC_SB_8		0x01
 
+/* Flags for sbc_init() */
+#define SBC_MSBC		0x01	/* mSBC, as used by HFP for wideband speech */
+
 /* Data endianess */
 #define SBC_LE			0x00
 #define SBC_BE			0x01
@@ -33,6 +33,7 @@
 
 #include "sbc_primitives.h"
 #include "sbc_primitives_mmx.h"
+#include "sbc_primitives_sse.h"
 #include "sbc_primitives_iwmmxt.h"
 #include "sbc_primitives_neon.h"
 #include "sbc_primitives_armv6.h"
@@ -209,6 +210,12 @@ static inline void sbc_analyze_4b_8s_simd(int16_t *x,
 	sbc_analyze_eight_simd(x + 0, out, analysis_consts_fixed8_simd_even);
 }
 
+static void sbc_analyze_1b_8s_simd(int16_t *x, int32_t *out, int odd)
+{
+	sbc_analyze_eight_simd(x, out, odd ? analysis_consts_fixed8_simd_odd :
+					analysis_consts_fixed8_simd_even);
+}
+
 static inline int16_t unaligned16_be(const uint8_t *ptr)
 {
 	return (int16_t) ((ptr[0] << 8) | ptr[1]);
@@ -404,6 +411,106 @@ static int sbc_enc_process_input_8s_be(int position,
 			position, pcm, X, nsamples, 1, 1);
 }
 
+/*
+ * The same as sbc_encoder_process_input_s8_internal() for mono, except
+ * that nsamples may be an odd number of blocks. The first block of a
+ * pair is then stored with one frame and the second one with the next,
+ * which position being 8 off a multiple of 16 tells.
+ */
+static SBC_ALWAYS_INLINE int sbc_encoder_process_input_s8_msbc_internal(
+	int position,
+	const uint8_t *pcm, int16_t X[2][SBC_X_BUFFER_SIZE],
+	int nsamples, int big_endian)
+{
+	int16_t *x;
+
+	/* handle X buffer wraparound, keeping a half stored pair where
+	 * it is in relation to the pairs */
+	if (position < nsamples) {
+		int half = position & 8;
+
+		memcpy(&X[0][SBC_X_BUFFER_SIZE - 72 - 2 * half],
+			&X[0][position - half], (72 + half) * sizeof(int16_t));
+		position = SBC_X_BUFFER_SIZE - 72 - half;
+	}
+
+	#define PCM(i) (big_endian ? \
+		unaligned16_be(pcm + (i) * 2) : unaligned16_le(pcm + (i) * 2))
+
+	/* the second block of a pair begun by the previous frame */
+	if (position & 8) {
+		position -= 8;
+		nsamples -= 8;
+		x = &X[0][position];
+		x[0]  = PCM(7);
+		x[2]  = PCM(6);
+		x[3]  = PCM(0);
+		x[4]  = PCM(5);
+		x[5]  = PCM(1);
+		x[6]  = PCM(4);
+		x[7]  = PCM(2);
+		x[8]  = PCM(3);
+		pcm += 16;
+	}
+
+	/* copy/permutate whole pairs */
+	while (nsamples >= 16) {
+		position -= 16;
+		x = &X[0][position];
+		x[0]  = PCM(15);
+		x[1]  = PCM(7);
+		x[2]  = PCM(14);
+		x[3]  = PCM(8);
+		x[4]  = PCM(13);
+		x[5]  = PCM(9);
+		x[6]  = PCM(12);
+		x[7]  = PCM(10);
+		x[8]  = PCM(11);
+		x[9]  = PCM(3);
+		x[10] = PCM(6);
+		x[11] = PCM(0);
+		x[12] = PCM(5);
+		x[13] = PCM(1);
+		x[14] = PCM(4);
+		x[15] = PCM(2);
+		pcm += 32;
+		nsamples -= 16;
+	}
+
+	/* and the first block of a pair, which the next frame finishes */
+	if (nsamples == 8) {
+		position -= 8;
+		x = &X[0][position];
+		x[-7] = PCM(7);
+		x[1]  = PCM(3);
+		x[2]  = PCM(6);
+		x[3]  = PCM(0);
+		x[4]  = PCM(5);
+		x[5]  = PCM(1);
+		x[6]  = PCM(4);
+		x[7]  = PCM(2);
+	}
+	#undef PCM
+
+	return position;
+}
+
+static int sbc_enc_process_input_8s_msbc_le(int position,
+		const uint8_t *pcm, int16_t X[2][SBC_X_BUFFER_SIZE],
+		int nsamples, int nchannels)
+{
+	return sbc_encoder_process_input_s8_msbc_internal(
+		position, pcm, X, nsamples, 0);
+}
+
+static int sbc_enc_process_input_8s_msbc_be(int position,
+		const uint8_t *pcm, int16_t X[2][SBC_X_BUFFER_SIZE],
+		int nsamples, int nchannels)
+{
+	return sbc_encoder_process_input_s8_msbc_internal(
+		position, pcm, X, nsamples, 1);
+}
+
 /* Supplementary function to count the number of leading zeros */
 
 static inline int sbc_clz(uint32_t x)
@@ -516,6 +623,94 @@ static int sbc_calc_scalefactors_j(
 	return joint;
 }
 
+static void sbc_synthesize_4s(struct sbc_decoder_state *state,
+				const int32_t *sb_sample, int16_t *pcm, int ch)
+{
+	int i, k, idx;
+	int32_t *v = state->V[ch];
+	int *offset = state->offset[ch];
+
+	for (i = 0; i < 8; i++) {
+		/* Shifting */
+		offset[i]--;
+		if (offset[i] < 0) {
+			offset[i] = 79;
+			memcpy(v + 80, v, 9 * sizeof(*v));
+		}
+
+		/* Distribute the new matrix value to the shifted position */
+		v[offset[i]] = SCALE4_STAGED1(
+			MULA(synmatrix4[i][0], sb_sample[0],
+			MULA(synmatrix4[i][1], sb_sample[1],
+			MULA(synmatrix4[i][2], sb_sample[2],
+			MUL (synmatrix4[i][3], sb_sample[3])))));
+	}
+
+	/* Compute the samples */
+	for (idx = 0, i = 0; i < 4; i++, idx += 5) {
+		k = (i + 4) & 0xf;
+
+		/* Store in output, Q0 */
+		pcm[i] = sbc_clip16(SCALE4_STAGED1(
+			MULA(v[offset[i] + 0], sbc_proto_4_40m0[idx + 0],
+			MULA(v[offset[k] + 1], sbc_proto_4_40m1[idx + 0],
+			MULA(v[offset[i] + 2], sbc_proto_4_40m0[idx + 1],
+			MULA(v[offset[k] + 3], sbc_proto_4_40m1[idx + 1],
+			MULA(v[offset[i] + 4], sbc_proto_4_40m0[idx + 2],
+			MULA(v[offset[k] + 5], sbc_proto_4_40m1[idx + 2],
+			MULA(v[offset[i] + 6], sbc_proto_4_40m0[idx + 3],
+			MULA(v[offset[k] + 7], sbc_proto_4_40m1[idx + 3],
+			MULA(v[offset[i] + 8], sbc_proto_4_40m0[idx + 4],
+			MUL( v[offset[k] + 9], sbc_proto_4_40m1[idx + 4]))))))))))));
+	}
+}
+
+static void sbc_synthesize_8s(struct sbc_decoder_state *state,
+				const int32_t *sb_sample, int16_t *pcm, int ch)
+{
+	int i, j, k, idx;
+	int *offset = state->offset[ch];
+
+	for (i = 0; i < 16; i++) {
+		/* Shifting */
+		offset[i]--;
+		if (offset[i] < 0) {
+			offset[i] = 159;
+			for (j = 0; j < 9; j++)
+				state->V[ch][j + 160] = state->V[ch][j];
+		}
+
+		/* Distribute the new matrix value to the shifted position */
+		state->V[ch][offset[i]] = SCALE8_STAGED1(
+			MULA(synmatrix8[i][0], sb_sample[0],
+			MULA(synmatrix8[i][1], sb_sample[1],
+			MULA(synmatrix8[i][2], sb_sample[2],
+			MULA(synmatrix8[i][3], sb_sample[3],
+			MULA(synmatrix8[i][4], sb_sample[4],
+			MULA(synmatrix8[i][5], sb_sample[5],
+			MULA(synmatrix8[i][6], sb_sample[6],
+			MUL( synmatrix8[i][7], sb_sample[7])))))))));
+	}
+
+	/* Compute the samples */
+	for (idx = 0, i = 0; i < 8; i++, idx += 5) {
+		k = (i + 8) & 0xf;
+
+		/* Store in output, Q0 */
+		pcm[i] = sbc_clip16(SCALE8_STAGED1(
+			MULA(state->V[ch][offset[i] + 0], sbc_proto_8_80m0[idx + 0],
+			MULA(state->V[ch][offset[k] + 1], sbc_proto_8_80m1[idx + 0],
+			MULA(state->V[ch][offset[i] + 2], sbc_proto_8_80m0[idx + 1],
+			MULA(state->V[ch][offset[k] + 3], sbc_proto_8_80m1[idx + 1],
+			MULA(state->V[ch][offset[i] + 4], sbc_proto_8_80m0[idx + 2],
+			MULA(state->V[ch][offset[k] + 5], sbc_proto_8_80m1[idx + 2],
+			MULA(state->V[ch][offset[i] + 6], sbc_proto_8_80m0[idx + 3],
+			MULA(state->V[ch][offset[k] + 7], sbc_proto_8_80m1[idx + 3],
+			MULA(state->V[ch][offset[i] + 8], sbc_proto_8_80m0[idx + 4],
+			MUL( state->V[ch][offset[k] + 9], sbc_proto_8_80m1[idx + 4]))))))))))));
+	}
+}
+
 /*
  * Detect CPU features and setup function pointers
  */
@@ -524,12 +719,15 @@ void sbc_init_primitives(struct sbc_encoder_state *state)
 	/* Default implementation for analyze functions */
 	state->sbc_analyze_4b_4s = sbc_analyze_4b_4s_simd;
 	state->sbc_analyze_4b_8s = sbc_analyze_4b_8s_simd;
+	state->sbc_analyze_1b_8s = sbc_analyze_1b_8s_simd;
 
 	/* Default implementation for input reordering / deinterleaving */
 	state->sbc_enc_process_input_4s_le = sbc_enc_process_input_4s_le;
 	state->sbc_enc_process_input_4s_be = sbc_enc_process_input_4s_be;
 	state->sbc_enc_process_input_8s_le = sbc_enc_process_input_8s_le;
 	state->sbc_enc_process_input_8s_be = sbc_enc_process_input_8s_be;
+	state->sbc_enc_process_input_8s_msbc_le = sbc_enc_process_input_8s_msbc_le;
+	state->sbc_enc_process_input_8s_msbc_be = sbc_enc_process_input_8s_msbc_be;
 
 	/* Default implementation for scale factors calculation */
 	state->sbc_calc_scalefactors = sbc_calc_scalefactors;
@@ -540,6 +738,9 @@ void sbc_init_primitives(struct sbc_encoder_state *state)
 #ifdef SBC_BUILD_WITH_MMX_SUPPORT
 	sbc_init_primitives_mmx(state);
 #endif
+#ifdef SBC_BUILD_WITH_SSE_SUPPORT
+	sbc_init_primitives_sse(state);
+#endif
 
 	/* ARM optimizations */
 #ifdef SBC_BUILD_WITH_ARMV6_SUPPORT
@@ -552,3 +753,19 @@ void sbc_init_primitives(struct sbc_encoder_state *state)
 	sbc_init_primitives_neon(state);
 #endif
 }
+
+void sbc_init_decoder_primitives_generic(struct sbc_decoder_state *state)
+{
+	state->sbc_synthesize_4s = sbc_synthesize_4s;
+	state->sbc_synthesize_8s = sbc_synthesize_8s;
+	state->implementation_info = "Generic C";
+}
+
+void sbc_init_decoder_primitives(struct sbc_decoder_state *state)
+{
+	sbc_init_decoder_primitives_generic(state);
+
+#ifdef SBC_BUILD_WITH_SSE_SUPPORT
+	sbc_init_decoder_primitives_sse(state);
+#endif
+}
@@ -29,6 +29,9 @@
 
 #define SCALE_OUT_BITS 15
 #define SBC_X_BUFFER_SIZE 328
+/* The synthesis filter uses 169 elements, the SIMD code reads up to
+ * three past the last one */
+#define SBC_V_BUFFER_SIZE 172
 
 #ifdef __GNUC__
 #define SBC_ALWAYS_INLINE inline __attribute__((always_inline))
@@ -36,6 +39,16 @@
 #define SBC_ALWAYS_INLINE inline
 #endif
 
+static SBC_ALWAYS_INLINE int16_t sbc_clip16(int32_t s)
+{
+	if (s > 0x7FFF)
+		return 0x7FFF;
+	else if (s < -0x8000)
+		return -0x8000;
+	else
+		return s;
+}
+
 struct sbc_encoder_state {
 	int position;
 	int16_t SBC_ALIGNED X[2][SBC_X_BUFFER_SIZE];
@@ -45,6 +58,9 @@ struct sbc_encoder_state {
 	/* Polyphase analysis filter for 8 subbands configuration,
 	 * it handles 4 blocks at once */
 	void (*sbc_analyze_4b_8s)(int16_t *x, int32_t *out, int out_stride);
+	/* The same for a single block, for frames with a block count that
+	 * is not a multiple of 4. odd tells which block of a pair it is. */
+	void (*sbc_analyze_1b_8s)(int16_t *x, int32_t *out, int odd);
 	/* Process input data (deinterleave, endian conversion, reordering),
 	 * depending on the number of subbands and input data byte order */
 	int (*sbc_enc_process_input_4s_le)(int position,
@@ -59,6 +75,14 @@ struct sbc_encoder_state {
 	int (*sbc_enc_process_input_8s_be)(int position,
 			const uint8_t *pcm, int16_t X[2][SBC_X_BUFFER_SIZE],
 			int nsamples, int nchannels);
+	/* Process mono input for mSBC, where a frame may end between the
+	 * two blocks of a pair */
+	int (*sbc_enc_process_input_8s_msbc_le)(int position,
+			const uint8_t *pcm, int16_t X[2][SBC_X_BUFFER_SIZE],
+			int nsamples, int nchannels);
+	int (*sbc_enc_process_input_8s_msbc_be)(int position,
+			const uint8_t *pcm, int16_t X[2][SBC_X_BUFFER_SIZE],
+			int nsamples, int nchannels);
 	/* Scale factors calculation */
 	void (*sbc_calc_scalefactors)(int32_t sb_sample_f[16][2][8],
 			uint32_t scale_factor[2][8],
@@ -70,6 +94,18 @@ struct sbc_encoder_state {
 	const char *implementation_info;
 };
 
+struct sbc_decoder_state {
+	int subbands;
+	int32_t SBC_ALIGNED V[2][SBC_V_BUFFER_SIZE];
+	int offset[2][16];
+	/* Synthesis filter for one block of one channel, 4 and 8 subbands */
+	void (*sbc_synthesize_4s)(struct sbc_decoder_state *state,
+			const int32_t *sb_sample, int16_t *pcm, int ch);
+	void (*sbc_synthesize_8s)(struct sbc_decoder_state *state,
+			const int32_t *sb_sample, int16_t *pcm, int ch);
+	const char *implementation_info;
+};
+
 /*
  * Initialize pointers to the functions which are the basic "building bricks"
  * of SBC codec. Best implementation is selected based on target CPU
@@ -77,4 +113,10 @@ struct sbc_encoder_state {
  */
 void sbc_init_primitives(struct sbc_encoder_state *encoder_state);
 
+/* The same for the decoder */
+void sbc_init_decoder_primitives(struct sbc_decoder_state *decoder_state);
+
+/* Only the C implementation, to check the others against */
+void sbc_init_decoder_primitives_generic(struct sbc_decoder_state *decoder_state);
+
 #endif
@@ -0,0 +1,493 @@
+/*
+ *
+ *  Bluetooth low-complexity, subband codec (SBC) library
+ *
+ *  Copyright (C) 2008-2010  Nokia Corporation
+ *  Copyright (C) 2004-2010  Marcel Holtmann <marcel@holtmann.org>
+ *  Copyright (C) 2004-2005  Henryk Ploetz <henryk@ploetzli.ch>
+ *  Copyright (C) 2005-2006  Brad Midgley <bmidgley@xmission.com>
+ *
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include "sbc.h"
+#include "sbc_math.h"
+#include "sbc_tables.h"
+
+#include "sbc_primitives_sse.h"
+
+/*
+ * SSE2 optimizations
+ *
+ * Same algorithm as the MMX code, but one 128-bit pmaddwd covers what
+ * takes two MMX instructions, so the analysis filters need half as many
+ * multiplications and the scale factors are found for four subbands per
+ * pass. The results are bit exact with the C and MMX implementations.
+ */
+
+#ifdef SBC_BUILD_WITH_SSE_SUPPORT
+
+/* The compiler only knows about the XMM registers (and only allocates
+ * them itself) when it generates SSE code */
+#ifdef __SSE__
+#define XMM_CLOBBERS(...) , __VA_ARGS__
+#else
+#define XMM_CLOBBERS(...)
+#endif
+
+static inline void sbc_analyze_four_sse(const int16_t *in, int32_t *out,
+					const FIXED_T *consts)
+{
+	static const SBC_ALIGNED int32_t round_c[4] = {
+		1 << (SBC_PROTO_FIXED4_SCALE - 1),
+		1 << (SBC_PROTO_FIXED4_SCALE - 1),
+		1 << (SBC_PROTO_FIXED4_SCALE - 1),
+		1 << (SBC_PROTO_FIXED4_SCALE - 1),
+	};
+	__asm__ volatile (
+		"movdqu      (%0), %%xmm0\n"
+		"movdqu    16(%0), %%xmm1\n"
+		"pmaddwd     (%1), %%xmm0\n"
+		"pmaddwd   16(%1), %%xmm1\n"
+		"paddd       (%2), %%xmm0\n"
+		"paddd      %%xmm1, %%xmm0\n"
+		"\n"
+		"movdqu    32(%0), %%xmm2\n"
+		"movdqu    48(%0), %%xmm3\n"
+		"pmaddwd   32(%1), %%xmm2\n"
+		"pmaddwd   48(%1), %%xmm3\n"
+		"paddd      %%xmm2, %%xmm0\n"
+		"paddd      %%xmm3, %%xmm0\n"
+		"\n"
+		"movdqu    64(%0), %%xmm2\n"
+		"pmaddwd   64(%1), %%xmm2\n"
+		"paddd      %%xmm2, %%xmm0\n"
+		"\n"
+		"psrad         %4, %%xmm0\n"
+		"packssdw   %%xmm0, %%xmm0\n"
+		"\n"
+		"pshufd  $0x00, %%xmm0, %%xmm1\n"
+		"pshufd  $0x55, %%xmm0, %%xmm2\n"
+		"pmaddwd   80(%1), %%xmm1\n"
+		"pmaddwd   96(%1), %%xmm2\n"
+		"paddd      %%xmm2, %%xmm1\n"
+		"\n"
+		"movdqu     %%xmm1, (%3)\n"
+		:
+		: "r" (in), "r" (consts), "r" (&round_c), "r" (out),
+			"i" (SBC_PROTO_FIXED4_SCALE)
+		: "cc", "memory"
+		  XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3"));
+}
+
+static inline void sbc_analyze_eight_sse(const int16_t *in, int32_t *out,
+							const FIXED_T *consts)
+{
+	static const SBC_ALIGNED int32_t round_c[4] = {
+		1 << (SBC_PROTO_FIXED8_SCALE - 1),
+		1 << (SBC_PROTO_FIXED8_SCALE - 1),
+		1 << (SBC_PROTO_FIXED8_SCALE - 1),
+		1 << (SBC_PROTO_FIXED8_SCALE - 1),
+	};
+	__asm__ volatile (
+		"movdqu      (%0), %%xmm0\n"
+		"movdqu    16(%0), %%xmm1\n"
+		"pmaddwd     (%1), %%xmm0\n"
+		"pmaddwd   16(%1), %%xmm1\n"
+		"paddd       (%2), %%xmm0\n"
+		"paddd       (%2), %%xmm1\n"
+		"\n"
+		"movdqu    32(%0), %%xmm2\n"
+		"movdqu    48(%0), %%xmm3\n"
+		"pmaddwd   32(%1), %%xmm2\n"
+		"pmaddwd   48(%1), %%xmm3\n"
+		"paddd      %%xmm2, %%xmm0\n"
+		"paddd      %%xmm3, %%xmm1\n"
+		"\n"
+		"movdqu    64(%0), %%xmm2\n"
+		"movdqu    80(%0), %%xmm3\n"
+		"pmaddwd   64(%1), %%xmm2\n"
+		"pmaddwd   80(%1), %%xmm3\n"
+		"paddd      %%xmm2, %%xmm0\n"
+		"paddd      %%xmm3, %%xmm1\n"
+		"\n"
+		"movdqu    96(%0), %%xmm2\n"
+		"movdqu   112(%0), %%xmm3\n"
+		"pmaddwd   96(%1), %%xmm2\n"
+		"pmaddwd  112(%1), %%xmm3\n"
+		"paddd      %%xmm2, %%xmm0\n"
+		"paddd      %%xmm3, %%xmm1\n"
+		"\n"
+		"movdqu   128(%0), %%xmm2\n"
+		"movdqu   144(%0), %%xmm3\n"
+		"pmaddwd  128(%1), %%xmm2\n"
+		"pmaddwd  144(%1), %%xmm3\n"
+		"paddd      %%xmm2, %%xmm0\n"
+		"paddd      %%xmm3, %%xmm1\n"
+		"\n"
+		"psrad         %4, %%xmm0\n"
+		"psrad         %4, %%xmm1\n"
+		"packssdw   %%xmm1, %%xmm0\n"
+		"\n"
+		"pshufd  $0x00, %%xmm0, %%xmm4\n"
+		"pshufd  $0x55, %%xmm0, %%xmm5\n"
+		"pshufd  $0xaa, %%xmm0, %%xmm6\n"
+		"pshufd  $0xff, %%xmm0, %%xmm7\n"
+		"\n"
+		"movdqa     %%xmm4, %%xmm1\n"
+		"pmaddwd  160(%1), %%xmm4\n"
+		"pmaddwd  176(%1), %%xmm1\n"
+		"\n"
+		"movdqa     %%xmm5, %%xmm2\n"
+		"pmaddwd  192(%1), %%xmm5\n"
+		"pmaddwd  208(%1), %%xmm2\n"
+		"paddd      %%xmm5, %%xmm4\n"
+		"paddd      %%xmm2, %%xmm1\n"
+		"\n"
+		"movdqa     %%xmm6, %%xmm2\n"
+		"pmaddwd  224(%1), %%xmm6\n"
+		"pmaddwd  240(%1), %%xmm2\n"
+		"paddd      %%xmm6, %%xmm4\n"
+		"paddd      %%xmm2, %%xmm1\n"
+		"\n"
+		"movdqa     %%xmm7, %%xmm2\n"
+		"pmaddwd  256(%1), %%xmm7\n"
+		"pmaddwd  272(%1), %%xmm2\n"
+		"paddd      %%xmm7, %%xmm4\n"
+		"paddd      %%xmm2, %%xmm1\n"
+		"\n"
+		"movdqu     %%xmm4, (%3)\n"
+		"movdqu     %%xmm1, 16(%3)\n"
+		:
+		: "r" (in), "r" (consts), "r" (&round_c), "r" (out),
+			"i" (SBC_PROTO_FIXED8_SCALE)
+		: "cc", "memory"
+		  XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3",
+				"xmm4", "xmm5", "xmm6", "xmm7"));
+}
+
+static inline void sbc_analyze_4b_4s_sse(int16_t *x, int32_t *out,
+						int out_stride)
+{
+	/* Analyze blocks */
+	sbc_analyze_four_sse(x + 12, out, analysis_consts_fixed4_simd_odd);
+	out += out_stride;
+	sbc_analyze_four_sse(x + 8, out, analysis_consts_fixed4_simd_even);
+	out += out_stride;
+	sbc_analyze_four_sse(x + 4, out, analysis_consts_fixed4_simd_odd);
+	out += out_stride;
+	sbc_analyze_four_sse(x + 0, out, analysis_consts_fixed4_simd_even);
+}
+
+static inline void sbc_analyze_4b_8s_sse(int16_t *x, int32_t *out,
+						int out_stride)
+{
+	/* Analyze blocks */
+	sbc_analyze_eight_sse(x + 24, out, analysis_consts_fixed8_simd_odd);
+	out += out_stride;
+	sbc_analyze_eight_sse(x + 16, out, analysis_consts_fixed8_simd_even);
+	out += out_stride;
+	sbc_analyze_eight_sse(x + 8, out, analysis_consts_fixed8_simd_odd);
+	out += out_stride;
+	sbc_analyze_eight_sse(x + 0, out, analysis_consts_fixed8_simd_even);
+}
+
+static void sbc_calc_scalefactors_sse(
+	int32_t sb_sample_f[16][2][8],
+	uint32_t scale_factor[2][8],
+	int blocks, int channels, int subbands)
+{
+	static const SBC_ALIGNED int32_t consts[4] = {
+		1 << SCALE_OUT_BITS,
+		1 << SCALE_OUT_BITS,
+		1 << SCALE_OUT_BITS,
+		1 << SCALE_OUT_BITS,
+	};
+	int ch, sb;
+	intptr_t blk;
+	for (ch = 0; ch < channels; ch++) {
+		for (sb = 0; sb < subbands; sb += 4) {
+			blk = (blocks - 1) * (((char *) &sb_sample_f[1][0][0] -
+				(char *) &sb_sample_f[0][0][0]));
+			__asm__ volatile (
+				"movdqa       (%4), %%xmm0\n"
+			"1:\n"
+				"movdqu   (%1, %0), %%xmm1\n"
+				"movdqa      %%xmm1, %%xmm3\n"
+				"pxor        %%xmm2, %%xmm2\n"
+				"pcmpgtd     %%xmm2, %%xmm1\n"
+				"paddd       %%xmm3, %%xmm1\n"
+				"pcmpgtd     %%xmm1, %%xmm2\n"
+				"pxor        %%xmm2, %%xmm1\n"
+
+				"por         %%xmm1, %%xmm0\n"
+
+				"sub            %2, %0\n"
+				"jns            1b\n"
+
+				"movd        %%xmm0, %k0\n"
+				"bsrl          %k0, %k0\n"
+				"subl           %5, %k0\n"
+				"movl          %k0, (%3)\n"
+
+				"psrldq         $4, %%xmm0\n"
+				"movd        %%xmm0, %k0\n"
+				"bsrl          %k0, %k0\n"
+				"subl           %5, %k0\n"
+				"movl          %k0, 4(%3)\n"
+
+				"psrldq         $4, %%xmm0\n"
+				"movd        %%xmm0, %k0\n"
+				"bsrl          %k0, %k0\n"
+				"subl           %5, %k0\n"
+				"movl          %k0, 8(%3)\n"
+
+				"psrldq         $4, %%xmm0\n"
+				"movd        %%xmm0, %k0\n"
+				"bsrl          %k0, %k0\n"
+				"subl           %5, %k0\n"
+				"movl          %k0, 12(%3)\n"
+			: "+r" (blk)
+			: "r" (&sb_sample_f[0][ch][sb]),
+				"i" ((char *) &sb_sample_f[1][0][0] -
+					(char *) &sb_sample_f[0][0][0]),
+				"r" (&scale_factor[ch][sb]),
+				"r" (&consts),
+				"i" (SCALE_OUT_BITS)
+			: "cc", "memory"
+		  XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3"));
+		}
+	}
+}
+
+/*
+ * Synthesis filter of the decoder. pmuludq multiplies the elements 0 and 2
+ * of two vectors, the tables in sbc_tables.h are laid out for this. The
+ * low halves of the products are accumulated, which gives the same result
+ * as the 32-bit multiplications of the C code.
+ */
+
+/* Matrixing of 4 subband samples with one row of synmatrix4_simd */
+static inline int32_t sbc_synth_dot4_sse(const int32_t *in,
+					const int32_t *consts)
+{
+	int32_t out;
+
+	__asm__ volatile (
+		"movdqu      (%1), %%xmm0\n"
+		"movdqa   %%xmm0, %%xmm1\n"
+		"psrlq       $32, %%xmm1\n"
+		"pmuludq     (%2), %%xmm0\n"
+		"pmuludq   16(%2), %%xmm1\n"
+		"paddd    %%xmm1, %%xmm0\n"
+		"pshufd   $0x02, %%xmm0, %%xmm1\n"
+		"paddd    %%xmm1, %%xmm0\n"
+		"movd     %%xmm0, %0\n"
+		: "=r" (out)
+		: "r" (in), "r" (consts)
+		: "memory"
+		  XMM_CLOBBERS("xmm0", "xmm1"));
+
+	return out;
+}
+
+/* Matrixing of 8 subband samples with one row of synmatrix8_simd */
+static inline int32_t sbc_synth_dot8_sse(const int32_t *in,
+					const int32_t *consts)
+{
+	int32_t out;
+
+	__asm__ volatile (
+		"movdqu      (%1), %%xmm0\n"
+		"movdqu    16(%1), %%xmm1\n"
+		"movdqa   %%xmm0, %%xmm2\n"
+		"movdqa   %%xmm1, %%xmm3\n"
+		"psrlq       $32, %%xmm2\n"
+		"psrlq       $32, %%xmm3\n"
+		"pmuludq     (%2), %%xmm0\n"
+		"pmuludq   16(%2), %%xmm1\n"
+		"pmuludq   32(%2), %%xmm2\n"
+		"pmuludq   48(%2), %%xmm3\n"
+		"paddd    %%xmm1, %%xmm0\n"
+		"paddd    %%xmm3, %%xmm2\n"
+		"paddd    %%xmm2, %%xmm0\n"
+		"pshufd   $0x02, %%xmm0, %%xmm1\n"
+		"paddd    %%xmm1, %%xmm0\n"
+		"movd     %%xmm0, %0\n"
+		: "=r" (out)
+		: "r" (in), "r" (consts)
+		: "memory"
+		  XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3"));
+
+	return out;
+}
+
+/* Windowing of one output sample, the even elements of the row at v0 and
+ * the odd ones of the row at v1 + 1 with one row of sbc_proto_*_simd. Three
+ * elements past each row are read but multiplied with 0. */
+static inline int32_t sbc_synth_window_sse(const int32_t *v0,
+					const int32_t *v1, const int32_t *consts)
+{
+	int32_t out;
+
+	__asm__ volatile (
+		"movdqu      (%1), %%xmm0\n"
+		"movdqu    16(%1), %%xmm1\n"
+		"movdqu    32(%1), %%xmm2\n"
+		"movdqu      (%2), %%xmm3\n"
+		"movdqu    16(%2), %%xmm4\n"
+		"movdqu    32(%2), %%xmm5\n"
+		"pmuludq     (%3), %%xmm0\n"
+		"pmuludq   16(%3), %%xmm1\n"
+		"pmuludq   32(%3), %%xmm2\n"
+		"pmuludq   48(%3), %%xmm3\n"
+		"pmuludq   64(%3), %%xmm4\n"
+		"pmuludq   80(%3), %%xmm5\n"
+		"paddd    %%xmm1, %%xmm0\n"
+		"paddd    %%xmm3, %%xmm2\n"
+		"paddd    %%xmm5, %%xmm4\n"
+		"paddd    %%xmm2, %%xmm0\n"
+		"paddd    %%xmm4, %%xmm0\n"
+		"pshufd   $0x02, %%xmm0, %%xmm1\n"
+		"paddd    %%xmm1, %%xmm0\n"
+		"movd     %%xmm0, %0\n"
+		: "=r" (out)
+		: "r" (v0), "r" (v1), "r" (consts)
+		: "memory"
+		  XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3",
+				"xmm4", "xmm5"));
+
+	return out;
+}
+
+static void sbc_synthesize_4s_sse(struct sbc_decoder_state *state,
+				const int32_t *sb_sample, int16_t *pcm, int ch)
+{
+	int i, k;
+	int32_t *v = state->V[ch];
+	int *offset = state->offset[ch];
+
+	for (i = 0; i < 8; i++) {
+		/* Shifting */
+		offset[i]--;
+		if (offset[i] < 0) {
+			offset[i] = 79;
+			memcpy(v + 80, v, 9 * sizeof(*v));
+		}
+
+		/* Distribute the new matrix value to the shifted position */
+		v[offset[i]] = SCALE4_STAGED1(
+			sbc_synth_dot4_sse(sb_sample, synmatrix4_simd[i]));
+	}
+
+	/* Compute the samples */
+	for (i = 0; i < 4; i++) {
+		k = (i + 4) & 0xf;
+
+		pcm[i] = sbc_clip16(SCALE4_STAGED1(
+			sbc_synth_window_sse(v + offset[i], v + offset[k] + 1,
+						sbc_proto_4_40_simd[i])));
+	}
+}
+
+static void sbc_synthesize_8s_sse(struct sbc_decoder_state *state,
+				const int32_t *sb_sample, int16_t *pcm, int ch)
+{
+	int i, j, k;
+	int32_t *v = state->V[ch];
+	int *offset = state->offset[ch];
+
+	for (i = 0; i < 16; i++) {
+		/* Shifting */
+		offset[i]--;
+		if (offset[i] < 0) {
+			offset[i] = 159;
+			for (j = 0; j < 9; j++)
+				v[j + 160] = v[j];
+		}
+
+		/* Distribute the new matrix value to the shifted position */
+		v[offset[i]] = SCALE8_STAGED1(
+			sbc_synth_dot8_sse(sb_sample, synmatrix8_simd[i]));
+	}
+
+	/* Compute the samples */
+	for (i = 0; i < 8; i++) {
+		k = (i + 8) & 0xf;
+
+		pcm[i] = sbc_clip16(SCALE8_STAGED1(
+			sbc_synth_window_sse(v + offset[i], v + offset[k] + 1,
+						sbc_proto_8_80_simd[i])));
+	}
+}
+
+static int check_sse_support(void)
+{
+#ifdef __amd64__
+	return 1; /* We assume that all 64-bit processors have SSE2 support */
+#else
+	int cpuid_feature_information;
+	__asm__ volatile (
+		/* According to Intel manual, CPUID instruction is supported
+		 * if the value of ID bit (bit 21) in EFLAGS can be modified */
+		"pushf\n"
+		"movl     (%%esp),   %0\n"
+		"xorl     $0x200000, (%%esp)\n" /* try to modify ID bit */
+		"popf\n"
+		"pushf\n"
+		"xorl     (%%esp),   %0\n"      /* check if ID bit changed */
+		"jz       1f\n"
+		"push     %%eax\n"
+		"push     %%ebx\n"
+		"push     %%ecx\n"
+		"mov      $1,        %%eax\n"
+		"cpuid\n"
+		"pop      %%ecx\n"
+		"pop      %%ebx\n"
+		"pop      %%eax\n"
+		"1:\n"
+		"popf\n"
+		: "=d" (cpuid_feature_information)
+		:
+		: "cc");
+    return cpuid_feature_information & (1 << 26);
+#endif
+}
+
+void sbc_init_primitives_sse(struct sbc_encoder_state *state)
+{
+	if (check_sse_support()) {
+		state->sbc_analyze_4b_4s = sbc_analyze_4b_4s_sse;
+		state->sbc_analyze_4b_8s = sbc_analyze_4b_8s_sse;
+		state->sbc_calc_scalefactors = sbc_calc_scalefactors_sse;
+		state->implementation_info = "SSE2";
+	}
+}
+
+void sbc_init_decoder_primitives_sse(struct sbc_decoder_state *state)
+{
+	if (check_sse_support()) {
+		state->sbc_synthesize_4s = sbc_synthesize_4s_sse;
+		state->sbc_synthesize_8s = sbc_synthesize_8s_sse;
+		state->implementation_info = "SSE2";
+	}
+}
+
+#endif
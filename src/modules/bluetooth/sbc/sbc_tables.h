@@ -660,3 +660,252 @@ static const FIXED_T SBC_ALIGNED analysis_consts_fixed8_simd_odd[80 + 64] = {
 #undef C6
 #undef C7
 };
+
+/*
+ * Synthesis tables laid out for the SIMD code, which multiplies the 32-bit
+ * elements 0 and 2 of a vector with the elements 0 and 2 of another one
+ * (pmuludq). The low halves of the products are the same as with the signed
+ * multiplications of the C code, so the results are bit exact.
+ *
+ * For each row of the matrixing the even columns come first, then the odd
+ * ones, matching the subband samples as they are and shifted down by one
+ * element. For each output sample the five windowing coefficients for the
+ * even elements of its V row come first, then the five for the odd elements
+ * of the other row, both spaced out to match elements 0, 2, 4, ... of the
+ * rows. Unused elements are 0.
+ */
+static const int32_t SBC_ALIGNED synmatrix4_simd[8][8] = {
+	{
+		SN4(0x05a82798), 0, SN4(0xfa57d868), 0,
+		SN4(0xfa57d868), 0, SN4(0x05a82798), 0
+	},
+	{
+		SN4(0x030fbc54), 0, SN4(0x07641af0), 0,
+		SN4(0xf89be510), 0, SN4(0xfcf043ac), 0
+	},
+	{
+		SN4(0x00000000), 0, SN4(0x00000000), 0,
+		SN4(0x00000000), 0, SN4(0x00000000), 0
+	},
+	{
+		SN4(0xfcf043ac), 0, SN4(0xf89be510), 0,
+		SN4(0x07641af0), 0, SN4(0x030fbc54), 0
+	},
+	{
+		SN4(0xfa57d868), 0, SN4(0x05a82798), 0,
+		SN4(0x05a82798), 0, SN4(0xfa57d868), 0
+	},
+	{
+		SN4(0xf89be510), 0, SN4(0x030fbc54), 0,
+		SN4(0xfcf043ac), 0, SN4(0x07641af0), 0
+	},
+	{
+		SN4(0xf8000000), 0, SN4(0xf8000000), 0,
+		SN4(0xf8000000), 0, SN4(0xf8000000), 0
+	},
+	{
+		SN4(0xf89be510), 0, SN4(0x030fbc54), 0,
+		SN4(0xfcf043ac), 0, SN4(0x07641af0), 0
+	}
+};
+
+static const int32_t SBC_ALIGNED synmatrix8_simd[16][16] = {
+	{
+		SN8(0x05a82798), 0, SN8(0xfa57d868), 0,
+		SN8(0x05a82798), 0, SN8(0xfa57d868), 0,
+		SN8(0xfa57d868), 0, SN8(0x05a82798), 0,
+		SN8(0xfa57d868), 0, SN8(0x05a82798), 0
+	},
+	{
+		SN8(0x0471ced0), 0, SN8(0x018f8b84), 0,
+		SN8(0xf9592678), 0, SN8(0x07d8a5f0), 0,
+		SN8(0xf8275a10), 0, SN8(0x06a6d988), 0,
+		SN8(0xfe70747c), 0, SN8(0xfb8e3130), 0
+	},
+	{
+		SN8(0x030fbc54), 0, SN8(0x07641af0), 0,
+		SN8(0xfcf043ac), 0, SN8(0xf89be510), 0,
+		SN8(0xf89be510), 0, SN8(0xfcf043ac), 0,
+		SN8(0x07641af0), 0, SN8(0x030fbc54), 0
+	},
+	{
+		SN8(0x018f8b84), 0, SN8(0x06a6d988), 0,
+		SN8(0x07d8a5f0), 0, SN8(0x0471ced0), 0,
+		SN8(0xfb8e3130), 0, SN8(0xf8275a10), 0,
+		SN8(0xf9592678), 0, SN8(0xfe70747c), 0
+	},
+	{
+		SN8(0x00000000), 0, SN8(0x00000000), 0,
+		SN8(0x00000000), 0, SN8(0x00000000), 0,
+		SN8(0x00000000), 0, SN8(0x00000000), 0,
+		SN8(0x00000000), 0, SN8(0x00000000), 0
+	},
+	{
+		SN8(0xfe70747c), 0, SN8(0xf9592678), 0,
+		SN8(0xf8275a10), 0, SN8(0xfb8e3130), 0,
+		SN8(0x0471ced0), 0, SN8(0x07d8a5f0), 0,
+		SN8(0x06a6d988), 0, SN8(0x018f8b84), 0
+	},
+	{
+		SN8(0xfcf043ac), 0, SN8(0xf89be510), 0,
+		SN8(0x030fbc54), 0, SN8(0x07641af0), 0,
+		SN8(0x07641af0), 0, SN8(0x030fbc54), 0,
+		SN8(0xf89be510), 0, SN8(0xfcf043ac), 0
+	},
+	{
+		SN8(0xfb8e3130), 0, SN8(0xfe70747c), 0,
+		SN8(0x06a6d988), 0, SN8(0xf8275a10), 0,
+		SN8(0x07d8a5f0), 0, SN8(0xf9592678), 0,
+		SN8(0x018f8b84), 0, SN8(0x0471ced0), 0
+	},
+	{
+		SN8(0xfa57d868), 0, SN8(0x05a82798), 0,
+		SN8(0xfa57d868), 0, SN8(0x05a82798), 0,
+		SN8(0x05a82798), 0, SN8(0xfa57d868), 0,
+		SN8(0x05a82798), 0, SN8(0xfa57d868), 0
+	},
+	{
+		SN8(0xf9592678), 0, SN8(0x07d8a5f0), 0,
+		SN8(0xfb8e3130), 0, SN8(0xfe70747c), 0,
+		SN8(0x018f8b84), 0, SN8(0x0471ced0), 0,
+		SN8(0xf8275a10), 0, SN8(0x06a6d988), 0
+	},
+	{
+		SN8(0xf89be510), 0, SN8(0x030fbc54), 0,
+		SN8(0x07641af0), 0, SN8(0xfcf043ac), 0,
+		SN8(0xfcf043ac), 0, SN8(0x07641af0), 0,
+		SN8(0x030fbc54), 0, SN8(0xf89be510), 0
+	},
+	{
+		SN8(0xf8275a10), 0, SN8(0xfb8e3130), 0,
+		SN8(0x018f8b84), 0, SN8(0x06a6d988), 0,
+		SN8(0xf9592678), 0, SN8(0xfe70747c), 0,
+		SN8(0x0471ced0), 0, SN8(0x07d8a5f0), 0
+	},
+	{
+		SN8(0xf8000000), 0, SN8(0xf8000000), 0,
+		SN8(0xf8000000), 0, SN8(0xf8000000), 0,
+		SN8(0xf8000000), 0, SN8(0xf8000000), 0,
+		SN8(0xf8000000), 0, SN8(0xf8000000), 0
+	},
+	{
+		SN8(0xf8275a10), 0, SN8(0xfb8e3130), 0,
+		SN8(0x018f8b84), 0, SN8(0x06a6d988), 0,
+		SN8(0xf9592678), 0, SN8(0xfe70747c), 0,
+		SN8(0x0471ced0), 0, SN8(0x07d8a5f0), 0
+	},
+	{
+		SN8(0xf89be510), 0, SN8(0x030fbc54), 0,
+		SN8(0x07641af0), 0, SN8(0xfcf043ac), 0,
+		SN8(0xfcf043ac), 0, SN8(0x07641af0), 0,
+		SN8(0x030fbc54), 0, SN8(0xf89be510), 0
+	},
+	{
+		SN8(0xf9592678), 0, SN8(0x07d8a5f0), 0,
+		SN8(0xfb8e3130), 0, SN8(0xfe70747c), 0,
+		SN8(0x018f8b84), 0, SN8(0x0471ced0), 0,
+		SN8(0xf8275a10), 0, SN8(0x06a6d988), 0
+	}
+};
+
+static const int32_t SBC_ALIGNED sbc_proto_4_40_simd[4][24] = {
+	{
+		SS4(0x00000000), 0, SS4(0xffa6982f), 0,
+		SS4(0xfba93848), 0, SS4(0x0456c7b8), 0,
+		SS4(0x005967d1), 0, 0, 0,
+		SS4(0xffe090ce), 0, SS4(0xff2c0475), 0,
+		SS4(0xf694f800), 0, SS4(0xff2c0475), 0,
+		SS4(0xffe090ce), 0, 0, 0
+	},
+	{
+		SS4(0xfffb9ac7), 0, SS4(0xff589157), 0,
+		SS4(0xf9c2a8d8), 0, SS4(0x027c1434), 0,
+		SS4(0x0019118b), 0, 0, 0,
+		SS4(0xffe01dc7), 0, SS4(0xffcdc351), 0,
+		SS4(0xf6fb4370), 0, SS4(0xfef84470), 0,
+		SS4(0xffe99b00), 0, 0, 0
+	},
+	{
+		SS4(0xfff3c74c), 0, SS4(0xff137330), 0,
+		SS4(0xf81b8d70), 0, SS4(0x00ec1b8b), 0,
+		SS4(0xfff0b71a), 0, 0, 0,
+		SS4(0xfff0b71a), 0, SS4(0x00ec1b8b), 0,
+		SS4(0xf81b8d70), 0, SS4(0xff137330), 0,
+		SS4(0xfff3c74c), 0, 0, 0
+	},
+	{
+		SS4(0xffe99b00), 0, SS4(0xfef84470), 0,
+		SS4(0xf6fb4370), 0, SS4(0xffcdc351), 0,
+		SS4(0xffe01dc7), 0, 0, 0,
+		SS4(0x0019118b), 0, SS4(0x027c1434), 0,
+		SS4(0xf9c2a8d8), 0, SS4(0xff589157), 0,
+		SS4(0xfffb9ac7), 0, 0, 0
+	}
+};
+
+static const int32_t SBC_ALIGNED sbc_proto_8_80_simd[8][24] = {
+	{
+		SS8(0x00000000), 0, SS8(0xfe8d1970), 0,
+		SS8(0xee979f00), 0, SS8(0x11686100), 0,
+		SS8(0x0172e690), 0, 0, 0,
+		SS8(0xff7c272c), 0, SS8(0xfcb02620), 0,
+		SS8(0xda612700), 0, SS8(0xfcb02620), 0,
+		SS8(0xff7c272c), 0, 0, 0
+	},
+	{
+		SS8(0xfff5bd1a), 0, SS8(0xfdf1c8d4), 0,
+		SS8(0xeac182c0), 0, SS8(0x0d9daee0), 0,
+		SS8(0x00e530da), 0, 0, 0,
+		SS8(0xff762170), 0, SS8(0xfdbb828c), 0,
+		SS8(0xdac7bb40), 0, SS8(0xfc1417b8), 0,
+		SS8(0xff8b1a31), 0, 0, 0
+	},
+	{
+		SS8(0xffe9811d), 0, SS8(0xfd52986c), 0,
+		SS8(0xe7054ca0), 0, SS8(0x0a00d410), 0,
+		SS8(0x006c1de4), 0, 0, 0,
+		SS8(0xff7d4914), 0, SS8(0xff405e01), 0,
+		SS8(0xdbf79400), 0, SS8(0xfbd8f358), 0,
+		SS8(0xff9f3e17), 0, 0, 0
+	},
+	{
+		SS8(0xffdba705), 0, SS8(0xfcbc98e8), 0,
+		SS8(0xe3889d20), 0, SS8(0x06af2308), 0,
+		SS8(0x000bb7db), 0, 0, 0,
+		SS8(0xff960e94), 0, SS8(0x0142291c), 0,
+		SS8(0xdde26200), 0, SS8(0xfbedadc0), 0,
+		SS8(0xffb54b3b), 0, 0, 0
+	},
+	{
+		SS8(0xffca00ed), 0, SS8(0xfc3fbb68), 0,
+		SS8(0xe071bc00), 0, SS8(0x03bf7948), 0,
+		SS8(0xffc4e05c), 0, 0, 0,
+		SS8(0xffc4e05c), 0, SS8(0x03bf7948), 0,
+		SS8(0xe071bc00), 0, SS8(0xfc3fbb68), 0,
+		SS8(0xffca00ed), 0, 0, 0
+	},
+	{
+		SS8(0xffb54b3b), 0, SS8(0xfbedadc0), 0,
+		SS8(0xdde26200), 0, SS8(0x0142291c), 0,
+		SS8(0xff960e94), 0, 0, 0,
+		SS8(0x000bb7db), 0, SS8(0x06af2308), 0,
+		SS8(0xe3889d20), 0, SS8(0xfcbc98e8), 0,
+		SS8(0xffdba705), 0, 0, 0
+	},
+	{
+		SS8(0xff9f3e17), 0, SS8(0xfbd8f358), 0,
+		SS8(0xdbf79400), 0, SS8(0xff405e01), 0,
+		SS8(0xff7d4914), 0, 0, 0,
+		SS8(0x006c1de4), 0, SS8(0x0a00d410), 0,
+		SS8(0xe7054ca0), 0, SS8(0xfd52986c), 0,
+		SS8(0xffe9811d), 0, 0, 0
+	},
+	{
+		SS8(0xff8b1a31), 0, SS8(0xfc1417b8), 0,
+		SS8(0xdac7bb40), 0, SS8(0xfdbb828c), 0,
+		SS8(0xff762170), 0, 0, 0,
+		SS8(0x00e530da), 0, SS8(0x0d9daee0), 0,
+		SS8(0xeac182c0), 0, SS8(0xfdf1c8d4), 0,
+		SS8(0xfff5bd1a), 0, 0, 0
+	}
+};
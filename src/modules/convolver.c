@@ -0,0 +1,226 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/sample-util.h>
+
+#include "convolver.h"
+
+struct pa_convolver {
+    size_t block_size, n_partitions, n_bins;
+    unsigned n_inputs, n_outputs;
+
+    /* 2 * block_size per input and output, the previous and the
+     * current block */
+    float *input, *output;
+
+    /* One spectrum of all inputs per partition, the newest at fdl_pos */
+    fftwf_complex **fdl;
+    size_t fdl_pos;
+
+    fftwf_complex *spectrum;
+    fftwf_plan forward_plan, inverse_plan;
+    pa_cmac_func_t cmac;
+
+    /* Scratch space for pa_convolver_partition() */
+    float *design_block;
+    fftwf_complex *design_partition;
+    fftwf_plan design_plan;
+};
+
+static void* alloc(size_t n, size_t s) {
+    void *p;
+
+    pa_assert_se(p = fftwf_malloc(n * s));
+    memset(p, 0, n * s);
+
+    return p;
+}
+
+pa_convolver* pa_convolver_new(size_t block_size, size_t n_partitions, unsigned n_inputs, unsigned n_outputs) {
+    pa_convolver *c;
+    int n = (int) (2 * block_size);
+    size_t i;
+
+    pa_assert(block_size > 0);
+    pa_assert(n_partitions > 0);
+    pa_assert(n_inputs > 0);
+    pa_assert(n_outputs > 0);
+
+    c = pa_xnew0(pa_convolver, 1);
+    c->block_size = block_size;
+    c->n_partitions = n_partitions;
+    c->n_bins = block_size + 1;
+    c->n_inputs = n_inputs;
+    c->n_outputs = n_outputs;
+
+    c->input = alloc(2 * block_size * n_inputs, sizeof(float));
+    c->output = alloc(2 * block_size * n_outputs, sizeof(float));
+    c->spectrum = alloc(c->n_bins * n_outputs, sizeof(fftwf_complex));
+    c->fdl = pa_xnew0(fftwf_complex *, n_partitions);
+    for (i = 0; i < n_partitions; i++)
+        c->fdl[i] = alloc(c->n_bins * n_inputs, sizeof(fftwf_complex));
+
+    c->forward_plan = fftwf_plan_many_dft_r2c(1, &n, (int) n_inputs,
+                                              c->input, NULL, 1, n,
+                                              c->fdl[0], NULL, 1, (int) c->n_bins, FFTW_ESTIMATE);
+    c->inverse_plan = fftwf_plan_many_dft_c2r(1, &n, (int) n_outputs,
+                                              c->spectrum, NULL, 1, (int) c->n_bins,
+                                              c->output, NULL, 1, n, FFTW_ESTIMATE);
+    c->cmac = pa_get_cmac_func();
+
+    c->design_block = alloc(2 * block_size, sizeof(float));
+    c->design_partition = alloc(c->n_bins, sizeof(fftwf_complex));
+    c->design_plan = fftwf_plan_dft_r2c_1d(n, c->design_block, c->design_partition, FFTW_ESTIMATE);
+
+    return c;
+}
+
+void pa_convolver_free(pa_convolver *c) {
+    size_t i;
+
+    pa_assert(c);
+
+    fftwf_destroy_plan(c->design_plan);
+    fftwf_destroy_plan(c->inverse_plan);
+    fftwf_destroy_plan(c->forward_plan);
+
+    fftwf_free(c->design_partition);
+    fftwf_free(c->design_block);
+    for (i = 0; i < c->n_partitions; i++)
+        fftwf_free(c->fdl[i]);
+    pa_xfree(c->fdl);
+    fftwf_free(c->spectrum);
+    fftwf_free(c->output);
+    fftwf_free(c->input);
+    pa_xfree(c);
+}
+
+size_t pa_convolver_get_block_size(pa_convolver *c) {
+    pa_assert(c);
+
+    return c->block_size;
+}
+
+fftwf_complex* pa_convolver_new_filter(pa_convolver *c) {
+    pa_assert(c);
+
+    return alloc(c->n_partitions * c->n_bins, sizeof(fftwf_complex));
+}
+
+void pa_convolver_partition(pa_convolver *c, const float *h, size_t length, size_t stride, fftwf_complex *H) {
+    /* The gain of the inverse transform goes into the filter */
+    const float scale = 1.0f / (2 * c->block_size);
+    size_t p, i;
+
+    pa_assert(c);
+    pa_assert(h);
+    pa_assert(H);
+    pa_assert(length <= c->n_partitions * c->block_size);
+
+    for (p = 0; p < c->n_partitions; p++) {
+        size_t offset = p * c->block_size;
+
+        memset(c->design_block, 0, 2 * c->block_size * sizeof(float));
+        for (i = 0; offset + i < length && i < c->block_size; i++)
+            c->design_block[i] = h[(offset + i) * stride] * scale;
+
+        fftwf_execute(c->design_plan);
+        memcpy(H + p * c->n_bins, c->design_partition, c->n_bins * sizeof(fftwf_complex));
+    }
+}
+
+float* pa_convolver_get_input(pa_convolver *c, unsigned input) {
+    pa_assert(c);
+    pa_assert(input < c->n_inputs);
+
+    return c->input + input * 2 * c->block_size + c->block_size;
+}
+
+void pa_convolver_transform(pa_convolver *c) {
+    pa_assert(c);
+
+    fftwf_execute_dft_r2c(c->forward_plan, c->input, c->fdl[c->fdl_pos]);
+    memset(c->spectrum, 0, c->n_bins * c->n_outputs * sizeof(fftwf_complex));
+}
+
+void pa_convolver_accumulate(pa_convolver *c, unsigned output, unsigned input, const fftwf_complex *H) {
+    fftwf_complex *Y;
+    size_t p;
+
+    pa_assert(c);
+    pa_assert(output < c->n_outputs);
+    pa_assert(input < c->n_inputs);
+    pa_assert(H);
+
+    Y = c->spectrum + output * c->n_bins;
+
+    for (p = 0; p < c->n_partitions; p++) {
+        const fftwf_complex *X = c->fdl[(c->fdl_pos + c->n_partitions - p) % c->n_partitions] + input * c->n_bins;
+
+        c->cmac((float *) Y, (const float *) X, (const float *) (H + p * c->n_bins), (unsigned) c->n_bins);
+    }
+}
+
+void pa_convolver_finish(pa_convolver *c) {
+    unsigned i;
+
+    pa_assert(c);
+
+    fftwf_execute(c->inverse_plan);
+
+    /* The current block becomes the previous one, which the next
+     * transform overlaps with */
+    for (i = 0; i < c->n_inputs; i++) {
+        float *in = c->input + i * 2 * c->block_size;
+
+        memcpy(in, in + c->block_size, c->block_size * sizeof(float));
+    }
+
+    c->fdl_pos = (c->fdl_pos + 1) % c->n_partitions;
+}
+
+const float* pa_convolver_get_output(pa_convolver *c, unsigned output) {
+    pa_assert(c);
+    pa_assert(output < c->n_outputs);
+
+    /* Only the second half is free of circular aliasing */
+    return c->output + output * 2 * c->block_size + c->block_size;
+}
+
+void pa_convolver_reset(pa_convolver *c) {
+    size_t i;
+
+    pa_assert(c);
+
+    memset(c->input, 0, 2 * c->block_size * c->n_inputs * sizeof(float));
+    memset(c->output, 0, 2 * c->block_size * c->n_outputs * sizeof(float));
+    for (i = 0; i < c->n_partitions; i++)
+        memset(c->fdl[i], 0, c->n_bins * c->n_inputs * sizeof(fftwf_complex));
+    c->fdl_pos = 0;
+}
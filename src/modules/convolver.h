@@ -0,0 +1,63 @@
+#ifndef fooconvolverhfoo
+#define fooconvolverhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <fftw3.h>
+
+/* Uniformly partitioned overlap-save convolution. Each block of
+ * block_size samples per input is transformed once and kept in a
+ * frequency domain delay line, from which any number of outputs sum up
+ * the inputs filtered with partitioned impulse responses of up to
+ * n_partitions * block_size taps. The latency is one block, independent
+ * of the length of the filters. */
+
+typedef struct pa_convolver pa_convolver;
+
+pa_convolver* pa_convolver_new(size_t block_size, size_t n_partitions, unsigned n_inputs, unsigned n_outputs);
+void pa_convolver_free(pa_convolver *c);
+
+size_t pa_convolver_get_block_size(pa_convolver *c);
+
+/* A zeroed partitioned filter, to be freed with fftwf_free() */
+fftwf_complex* pa_convolver_new_filter(pa_convolver *c);
+
+/* Cuts the first length taps of an impulse response, read with the given
+ * stride, into partitions and stores their spectra in H. Uses scratch
+ * space of its own, so it may run while another thread filters, but not
+ * concurrently with itself. */
+void pa_convolver_partition(pa_convolver *c, const float *h, size_t length, size_t stride, fftwf_complex *H);
+
+/* The block_size samples of the next block of an input are written here */
+float* pa_convolver_get_input(pa_convolver *c, unsigned input);
+
+/* Filtering a block is done by pa_convolver_transform(), any number of
+ * pa_convolver_accumulate() calls and pa_convolver_finish(), after which
+ * the block_size samples of each output can be read from
+ * pa_convolver_get_output() until the next block is transformed. */
+void pa_convolver_transform(pa_convolver *c);
+void pa_convolver_accumulate(pa_convolver *c, unsigned output, unsigned input, const fftwf_complex *H);
+void pa_convolver_finish(pa_convolver *c);
+const float* pa_convolver_get_output(pa_convolver *c, unsigned output);
+
+/* Forgets all past input, e.g. after a rewind */
+void pa_convolver_reset(pa_convolver *c);
+
+#endif
@@ -42,6 +42,7 @@
 #include "iface-client.h"
 #include "iface-device.h"
 #include "iface-memstats.h"
+#include "iface-stats.h"
 #include "iface-module.h"
 #include "iface-sample.h"
 #include "iface-stream.h"
@@ -90,6 +91,7 @@ static void handle_load_module(DBusConnection *conn, DBusMessage *msg, void *use
 static void handle_exit(DBusConnection *conn, DBusMessage *msg, void *userdata);
 static void handle_listen_for_signal(DBusConnection *conn, DBusMessage *msg, void *userdata);
 static void handle_stop_listening_for_signal(DBusConnection *conn, DBusMessage *msg, void *userdata);
+static void handle_get_snapshot(DBusConnection *conn, DBusMessage *msg, void *userdata);
 
 struct pa_dbusiface_core {
     pa_core *core;
@@ -119,6 +121,7 @@ struct pa_dbusiface_core {
     pa_hook_slot *extension_unregistered_slot;
 
     pa_dbusiface_memstats *memstats;
+    pa_dbusiface_stats *stats;
 };
 
 enum property_handler_index {
@@ -182,6 +185,7 @@ enum method_handler_index {
     METHOD_HANDLER_EXIT,
     METHOD_HANDLER_LISTEN_FOR_SIGNAL,
     METHOD_HANDLER_STOP_LISTENING_FOR_SIGNAL,
+    METHOD_HANDLER_GET_SNAPSHOT,
     METHOD_HANDLER_MAX
 };
 
@@ -200,6 +204,7 @@ static pa_dbus_arg_info upload_sample_args[] = { { "name",           "s",      "
 static pa_dbus_arg_info load_module_args[] = { { "name", "s", "in" }, { "arguments", "a{ss}", "in" }, { "module", "o", "out" } };
 static pa_dbus_arg_info listen_for_signal_args[] = { { "signal", "s", "in" }, { "objects", "ao", "in" } };
 static pa_dbus_arg_info stop_listening_for_signal_args[] = { { "signal", "s", "in" } };
+static pa_dbus_arg_info get_snapshot_args[] = { { "objects", "a{oa{sa{sv}}}", "out" } };
 
 static pa_dbus_method_handler method_handlers[METHOD_HANDLER_MAX] = {
     [METHOD_HANDLER_GET_CARD_BY_NAME] = {
@@ -246,7 +251,12 @@ static pa_dbus_method_handler method_handlers[METHOD_HANDLER_MAX] = {
         .method_name = "StopListeningForSignal",
         .arguments = stop_listening_for_signal_args,
         .n_arguments = sizeof(stop_listening_for_signal_args) / sizeof(pa_dbus_arg_info),
-        .receive_cb = handle_stop_listening_for_signal }
+        .receive_cb = handle_stop_listening_for_signal },
+    [METHOD_HANDLER_GET_SNAPSHOT] = {
+        .method_name = "GetSnapshot",
+        .arguments = get_snapshot_args,
+        .n_arguments = sizeof(get_snapshot_args) / sizeof(pa_dbus_arg_info),
+        .receive_cb = handle_get_snapshot }
 };
 
 enum signal_index {
@@ -1570,6 +1580,71 @@ static void handle_stop_listening_for_signal(DBusConnection *conn, DBusMessage *
     pa_dbus_send_empty_reply(conn, msg);
 }
 
+static void open_snapshot_entry(DBusMessageIter *iter, const char *path, DBusMessageIter *entry_iter, DBusMessageIter *interfaces_iter) {
+    pa_assert_se(dbus_message_iter_open_container(iter, DBUS_TYPE_DICT_ENTRY, NULL, entry_iter));
+    pa_assert_se(dbus_message_iter_append_basic(entry_iter, DBUS_TYPE_OBJECT_PATH, &path));
+    pa_assert_se(dbus_message_iter_open_container(entry_iter, DBUS_TYPE_ARRAY, "{sa{sv}}", interfaces_iter));
+}
+
+static void close_snapshot_entry(DBusMessageIter *iter, DBusMessageIter *entry_iter, DBusMessageIter *interfaces_iter) {
+    pa_assert_se(dbus_message_iter_close_container(entry_iter, interfaces_iter));
+    pa_assert_se(dbus_message_iter_close_container(iter, entry_iter));
+}
+
+/* Returns the properties of all devices and streams in one reply, in the
+ * form of org.freedesktop.DBus.ObjectManager.GetManagedObjects, so that
+ * clients don't need a GetAll round trip for every object. */
+static void handle_get_snapshot(DBusConnection *conn, DBusMessage *msg, void *userdata) {
+    pa_dbusiface_core *c = userdata;
+    DBusMessage *reply = NULL;
+    DBusMessageIter msg_iter;
+    DBusMessageIter dict_iter;
+    DBusMessageIter entry_iter;
+    DBusMessageIter interfaces_iter;
+    pa_dbusiface_device *device;
+    pa_dbusiface_stream *stream;
+    void *state;
+
+    pa_assert(conn);
+    pa_assert(msg);
+    pa_assert(c);
+
+    pa_assert_se((reply = dbus_message_new_method_return(msg)));
+
+    dbus_message_iter_init_append(reply, &msg_iter);
+    pa_assert_se(dbus_message_iter_open_container(&msg_iter, DBUS_TYPE_ARRAY, "{oa{sa{sv}}}", &dict_iter));
+
+    PA_HASHMAP_FOREACH(device, c->sinks_by_index, state) {
+        open_snapshot_entry(&dict_iter, pa_dbusiface_device_get_path(device), &entry_iter, &interfaces_iter);
+        pa_dbusiface_device_append_properties(device, &interfaces_iter);
+        close_snapshot_entry(&dict_iter, &entry_iter, &interfaces_iter);
+    }
+
+    PA_HASHMAP_FOREACH(device, c->sources_by_index, state) {
+        open_snapshot_entry(&dict_iter, pa_dbusiface_device_get_path(device), &entry_iter, &interfaces_iter);
+        pa_dbusiface_device_append_properties(device, &interfaces_iter);
+        close_snapshot_entry(&dict_iter, &entry_iter, &interfaces_iter);
+    }
+
+    PA_HASHMAP_FOREACH(stream, c->playback_streams, state) {
+        open_snapshot_entry(&dict_iter, pa_dbusiface_stream_get_path(stream), &entry_iter, &interfaces_iter);
+        pa_dbusiface_stream_append_properties(stream, &interfaces_iter);
+        close_snapshot_entry(&dict_iter, &entry_iter, &interfaces_iter);
+    }
+
+    PA_HASHMAP_FOREACH(stream, c->record_streams, state) {
+        open_snapshot_entry(&dict_iter, pa_dbusiface_stream_get_path(stream), &entry_iter, &interfaces_iter);
+        pa_dbusiface_stream_append_properties(stream, &interfaces_iter);
+        close_snapshot_entry(&dict_iter, &entry_iter, &interfaces_iter);
+    }
+
+    pa_assert_se(dbus_message_iter_close_container(&msg_iter, &dict_iter));
+
+    pa_assert_se(dbus_connection_send(conn, reply, NULL));
+
+    dbus_message_unref(reply);
+}
+
 static void subscription_cb(pa_core *core, pa_subscription_event_type_t t, uint32_t idx, void *userdata) {
     pa_dbusiface_core *c = userdata;
     pa_dbusiface_card *card_iface = NULL;
@@ -2048,6 +2123,7 @@ pa_dbusiface_core *pa_dbusiface_core_new(pa_core *core) {
                                                                    extension_unregistered_cb,
                                                                    c);
     c->memstats = pa_dbusiface_memstats_new(c, core);
+    c->stats = pa_dbusiface_stats_new(c, core);
 
     if (c->fallback_sink)
         pa_sink_ref(c->fallback_sink);
@@ -2162,6 +2238,7 @@ void pa_dbusiface_core_free(pa_dbusiface_core *c) {
     pa_hook_slot_free(c->extension_registered_slot);
     pa_hook_slot_free(c->extension_unregistered_slot);
     pa_dbusiface_memstats_free(c->memstats);
+    pa_dbusiface_stats_free(c->stats);
 
     if (c->fallback_sink)
         pa_sink_unref(c->fallback_sink);
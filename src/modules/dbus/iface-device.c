@@ -779,11 +779,7 @@ static void handle_get_property_list(DBusConnection *conn, DBusMessage *msg, voi
     pa_dbus_send_proplist_variant_reply(conn, msg, d->proplist);
 }
 
-static void handle_get_all(DBusConnection *conn, DBusMessage *msg, void *userdata) {
-    pa_dbusiface_device *d = userdata;
-    DBusMessage *reply = NULL;
-    DBusMessageIter msg_iter;
-    DBusMessageIter dict_iter;
+static void append_properties(pa_dbusiface_device *d, DBusMessageIter *dict_iter) {
     dbus_uint32_t idx = 0;
     const char *name = NULL;
     const char *driver = NULL;
@@ -813,8 +809,6 @@ static void handle_get_all(DBusConnection *conn, DBusMessage *msg, void *userdat
     const char *active_port = NULL;
     unsigned i = 0;
 
-    pa_assert(conn);
-    pa_assert(msg);
     pa_assert(d);
 
     if (d->type == PA_DEVICE_TYPE_SINK) {
@@ -872,52 +866,63 @@ static void handle_get_all(DBusConnection *conn, DBusMessage *msg, void *userdat
     if (d->active_port)
         active_port = pa_dbusiface_device_port_get_path(pa_hashmap_get(d->ports, d->active_port->name));
 
-    pa_assert_se((reply = dbus_message_new_method_return(msg)));
-
-    dbus_message_iter_init_append(reply, &msg_iter);
-    pa_assert_se(dbus_message_iter_open_container(&msg_iter, DBUS_TYPE_ARRAY, "{sv}", &dict_iter));
-
-    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_INDEX].property_name, DBUS_TYPE_UINT32, &idx);
-    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_NAME].property_name, DBUS_TYPE_STRING, &name);
-    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_DRIVER].property_name, DBUS_TYPE_STRING, &driver);
+    pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_INDEX].property_name, DBUS_TYPE_UINT32, &idx);
+    pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_NAME].property_name, DBUS_TYPE_STRING, &name);
+    pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_DRIVER].property_name, DBUS_TYPE_STRING, &driver);
 
     if (owner_module)
-        pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_OWNER_MODULE].property_name, DBUS_TYPE_OBJECT_PATH, &owner_module_path);
+        pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_OWNER_MODULE].property_name, DBUS_TYPE_OBJECT_PATH, &owner_module_path);
 
     if (card)
-        pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_CARD].property_name, DBUS_TYPE_OBJECT_PATH, &card_path);
-
-    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_SAMPLE_FORMAT].property_name, DBUS_TYPE_UINT32, &sample_format);
-    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_SAMPLE_RATE].property_name, DBUS_TYPE_UINT32, &sample_rate);
-    pa_dbus_append_basic_array_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_CHANNELS].property_name, DBUS_TYPE_UINT32, channels, channel_map->channels);
-    pa_dbus_append_basic_array_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_VOLUME].property_name, DBUS_TYPE_UINT32, volume, d->volume.channels);
-    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_HAS_FLAT_VOLUME].property_name, DBUS_TYPE_BOOLEAN, &has_flat_volume);
-    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_HAS_CONVERTIBLE_TO_DECIBEL_VOLUME].property_name, DBUS_TYPE_BOOLEAN, &has_convertible_to_decibel_volume);
-    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_BASE_VOLUME].property_name, DBUS_TYPE_UINT32, &base_volume);
-    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_VOLUME_STEPS].property_name, DBUS_TYPE_UINT32, &volume_steps);
-    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_MUTE].property_name, DBUS_TYPE_BOOLEAN, &d->mute);
-    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_HAS_HARDWARE_VOLUME].property_name, DBUS_TYPE_BOOLEAN, &has_hardware_volume);
-    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_HAS_HARDWARE_MUTE].property_name, DBUS_TYPE_BOOLEAN, &has_hardware_mute);
-    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_CONFIGURED_LATENCY].property_name, DBUS_TYPE_UINT64, &configured_latency);
-    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_HAS_DYNAMIC_LATENCY].property_name, DBUS_TYPE_BOOLEAN, &has_dynamic_latency);
-    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_LATENCY].property_name, DBUS_TYPE_UINT64, &latency);
-    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_IS_HARDWARE_DEVICE].property_name, DBUS_TYPE_BOOLEAN, &is_hardware_device);
-    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_IS_NETWORK_DEVICE].property_name, DBUS_TYPE_BOOLEAN, &is_network_device);
-    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_STATE].property_name, DBUS_TYPE_UINT32, &state);
-    pa_dbus_append_basic_array_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_PORTS].property_name, DBUS_TYPE_OBJECT_PATH, ports, n_ports);
+        pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_CARD].property_name, DBUS_TYPE_OBJECT_PATH, &card_path);
+
+    pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_SAMPLE_FORMAT].property_name, DBUS_TYPE_UINT32, &sample_format);
+    pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_SAMPLE_RATE].property_name, DBUS_TYPE_UINT32, &sample_rate);
+    pa_dbus_append_basic_array_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_CHANNELS].property_name, DBUS_TYPE_UINT32, channels, channel_map->channels);
+    pa_dbus_append_basic_array_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_VOLUME].property_name, DBUS_TYPE_UINT32, volume, d->volume.channels);
+    pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_HAS_FLAT_VOLUME].property_name, DBUS_TYPE_BOOLEAN, &has_flat_volume);
+    pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_HAS_CONVERTIBLE_TO_DECIBEL_VOLUME].property_name, DBUS_TYPE_BOOLEAN, &has_convertible_to_decibel_volume);
+    pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_BASE_VOLUME].property_name, DBUS_TYPE_UINT32, &base_volume);
+    pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_VOLUME_STEPS].property_name, DBUS_TYPE_UINT32, &volume_steps);
+    pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_MUTE].property_name, DBUS_TYPE_BOOLEAN, &d->mute);
+    pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_HAS_HARDWARE_VOLUME].property_name, DBUS_TYPE_BOOLEAN, &has_hardware_volume);
+    pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_HAS_HARDWARE_MUTE].property_name, DBUS_TYPE_BOOLEAN, &has_hardware_mute);
+    pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_CONFIGURED_LATENCY].property_name, DBUS_TYPE_UINT64, &configured_latency);
+    pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_HAS_DYNAMIC_LATENCY].property_name, DBUS_TYPE_BOOLEAN, &has_dynamic_latency);
+    pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_LATENCY].property_name, DBUS_TYPE_UINT64, &latency);
+    pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_IS_HARDWARE_DEVICE].property_name, DBUS_TYPE_BOOLEAN, &is_hardware_device);
+    pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_IS_NETWORK_DEVICE].property_name, DBUS_TYPE_BOOLEAN, &is_network_device);
+    pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_STATE].property_name, DBUS_TYPE_UINT32, &state);
+    pa_dbus_append_basic_array_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_PORTS].property_name, DBUS_TYPE_OBJECT_PATH, ports, n_ports);
 
     if (active_port)
-        pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_ACTIVE_PORT].property_name, DBUS_TYPE_OBJECT_PATH, &active_port);
+        pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_ACTIVE_PORT].property_name, DBUS_TYPE_OBJECT_PATH, &active_port);
+
+    pa_dbus_append_proplist_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_PROPERTY_LIST].property_name, d->proplist);
+
+    pa_xfree(ports);
+}
 
-    pa_dbus_append_proplist_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_PROPERTY_LIST].property_name, d->proplist);
+static void handle_get_all(DBusConnection *conn, DBusMessage *msg, void *userdata) {
+    pa_dbusiface_device *d = userdata;
+    DBusMessage *reply = NULL;
+    DBusMessageIter msg_iter;
+    DBusMessageIter dict_iter;
 
+    pa_assert(conn);
+    pa_assert(msg);
+    pa_assert(d);
+
+    pa_assert_se((reply = dbus_message_new_method_return(msg)));
+
+    dbus_message_iter_init_append(reply, &msg_iter);
+    pa_assert_se(dbus_message_iter_open_container(&msg_iter, DBUS_TYPE_ARRAY, "{sv}", &dict_iter));
+    append_properties(d, &dict_iter);
     pa_assert_se(dbus_message_iter_close_container(&msg_iter, &dict_iter));
 
     pa_assert_se(dbus_connection_send(conn, reply, NULL));
 
     dbus_message_unref(reply);
-
-    pa_xfree(ports);
 }
 
 static void handle_suspend(DBusConnection *conn, DBusMessage *msg, void *userdata) {
@@ -982,27 +987,32 @@ static void handle_sink_get_monitor_source(DBusConnection *conn, DBusMessage *ms
     pa_dbus_send_basic_variant_reply(conn, msg, DBUS_TYPE_OBJECT_PATH, &monitor_source);
 }
 
+static void append_sink_properties(pa_dbusiface_device *d, DBusMessageIter *dict_iter) {
+    const char *monitor_source = NULL;
+
+    pa_assert(d);
+    pa_assert(d->type == PA_DEVICE_TYPE_SINK);
+
+    monitor_source = pa_dbusiface_core_get_source_path(d->core, d->sink->monitor_source);
+
+    pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[SINK_PROPERTY_HANDLER_MONITOR_SOURCE].property_name, DBUS_TYPE_OBJECT_PATH, &monitor_source);
+}
+
 static void handle_sink_get_all(DBusConnection *conn, DBusMessage *msg, void *userdata) {
     pa_dbusiface_device *d = userdata;
     DBusMessage *reply = NULL;
     DBusMessageIter msg_iter;
     DBusMessageIter dict_iter;
-    const char *monitor_source = NULL;
 
     pa_assert(conn);
     pa_assert(msg);
     pa_assert(d);
-    pa_assert(d->type == PA_DEVICE_TYPE_SINK);
-
-    monitor_source = pa_dbusiface_core_get_source_path(d->core, d->sink->monitor_source);
 
     pa_assert_se((reply = dbus_message_new_method_return(msg)));
 
     dbus_message_iter_init_append(reply, &msg_iter);
     pa_assert_se(dbus_message_iter_open_container(&msg_iter, DBUS_TYPE_ARRAY, "{sv}", &dict_iter));
-
-    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[SINK_PROPERTY_HANDLER_MONITOR_SOURCE].property_name, DBUS_TYPE_OBJECT_PATH, &monitor_source);
-
+    append_sink_properties(d, &dict_iter);
     pa_assert_se(dbus_message_iter_close_container(&msg_iter, &dict_iter));
 
     pa_assert_se(dbus_connection_send(conn, reply, NULL));
@@ -1029,29 +1039,34 @@ static void handle_source_get_monitor_of_sink(DBusConnection *conn, DBusMessage
     pa_dbus_send_basic_variant_reply(conn, msg, DBUS_TYPE_OBJECT_PATH, &monitor_of_sink);
 }
 
+static void append_source_properties(pa_dbusiface_device *d, DBusMessageIter *dict_iter) {
+    const char *monitor_of_sink = NULL;
+
+    pa_assert(d);
+    pa_assert(d->type == PA_DEVICE_TYPE_SOURCE);
+
+    if (d->source->monitor_of)
+        monitor_of_sink = pa_dbusiface_core_get_sink_path(d->core, d->source->monitor_of);
+
+    if (monitor_of_sink)
+        pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[SOURCE_PROPERTY_HANDLER_MONITOR_OF_SINK].property_name, DBUS_TYPE_OBJECT_PATH, &monitor_of_sink);
+}
+
 static void handle_source_get_all(DBusConnection *conn, DBusMessage *msg, void *userdata) {
     pa_dbusiface_device *d = userdata;
     DBusMessage *reply = NULL;
     DBusMessageIter msg_iter;
     DBusMessageIter dict_iter;
-    const char *monitor_of_sink = NULL;
 
     pa_assert(conn);
     pa_assert(msg);
     pa_assert(d);
-    pa_assert(d->type == PA_DEVICE_TYPE_SOURCE);
-
-    if (d->source->monitor_of)
-        monitor_of_sink = pa_dbusiface_core_get_sink_path(d->core, d->source->monitor_of);
 
     pa_assert_se((reply = dbus_message_new_method_return(msg)));
 
     dbus_message_iter_init_append(reply, &msg_iter);
     pa_assert_se(dbus_message_iter_open_container(&msg_iter, DBUS_TYPE_ARRAY, "{sv}", &dict_iter));
-
-    if (monitor_of_sink)
-        pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[SOURCE_PROPERTY_HANDLER_MONITOR_OF_SINK].property_name, DBUS_TYPE_OBJECT_PATH, &monitor_of_sink);
-
+    append_source_properties(d, &dict_iter);
     pa_assert_se(dbus_message_iter_close_container(&msg_iter, &dict_iter));
 
     pa_assert_se(dbus_connection_send(conn, reply, NULL));
@@ -1104,7 +1119,7 @@ static void subscription_cb(pa_core *c, pa_subscription_event_type_t t, uint32_t
                                               DBUS_TYPE_ARRAY, DBUS_TYPE_UINT32, &volume_ptr, d->volume.channels,
                                               DBUS_TYPE_INVALID));
 
-        pa_dbus_protocol_send_signal(d->dbus_protocol, signal_msg);
+        pa_dbus_protocol_send_coalesced_signal(d->dbus_protocol, signal_msg);
         dbus_message_unref(signal_msg);
         signal_msg = NULL;
     }
@@ -1119,7 +1134,7 @@ static void subscription_cb(pa_core *c, pa_subscription_event_type_t t, uint32_t
 							  signals[SIGNAL_MUTE_UPDATED].name));
         pa_assert_se(dbus_message_append_args(signal_msg, DBUS_TYPE_BOOLEAN, &d->mute, DBUS_TYPE_INVALID));
 
-        pa_dbus_protocol_send_signal(d->dbus_protocol, signal_msg);
+        pa_dbus_protocol_send_coalesced_signal(d->dbus_protocol, signal_msg);
         dbus_message_unref(signal_msg);
         signal_msg = NULL;
     }
@@ -1145,7 +1160,7 @@ static void subscription_cb(pa_core *c, pa_subscription_event_type_t t, uint32_t
 							  signals[SIGNAL_STATE_UPDATED].name));
         pa_assert_se(dbus_message_append_args(signal_msg, DBUS_TYPE_UINT32, &state, DBUS_TYPE_INVALID));
 
-        pa_dbus_protocol_send_signal(d->dbus_protocol, signal_msg);
+        pa_dbus_protocol_send_coalesced_signal(d->dbus_protocol, signal_msg);
         dbus_message_unref(signal_msg);
         signal_msg = NULL;
     }
@@ -1181,7 +1196,7 @@ static void subscription_cb(pa_core *c, pa_subscription_event_type_t t, uint32_t
         dbus_message_iter_init_append(signal_msg, &msg_iter);
         pa_dbus_append_proplist(&msg_iter, d->proplist);
 
-        pa_dbus_protocol_send_signal(d->dbus_protocol, signal_msg);
+        pa_dbus_protocol_send_coalesced_signal(d->dbus_protocol, signal_msg);
         dbus_message_unref(signal_msg);
         signal_msg = NULL;
     }
@@ -1299,6 +1314,31 @@ const char *pa_dbusiface_device_get_path(pa_dbusiface_device *d) {
     return d->path;
 }
 
+static void append_interface(pa_dbusiface_device *d, DBusMessageIter *iter, const char *interface,
+                             void (*append_cb)(pa_dbusiface_device *d, DBusMessageIter *dict_iter)) {
+    DBusMessageIter entry_iter;
+    DBusMessageIter dict_iter;
+
+    pa_assert_se(dbus_message_iter_open_container(iter, DBUS_TYPE_DICT_ENTRY, NULL, &entry_iter));
+    pa_assert_se(dbus_message_iter_append_basic(&entry_iter, DBUS_TYPE_STRING, &interface));
+    pa_assert_se(dbus_message_iter_open_container(&entry_iter, DBUS_TYPE_ARRAY, "{sv}", &dict_iter));
+    append_cb(d, &dict_iter);
+    pa_assert_se(dbus_message_iter_close_container(&entry_iter, &dict_iter));
+    pa_assert_se(dbus_message_iter_close_container(iter, &entry_iter));
+}
+
+void pa_dbusiface_device_append_properties(pa_dbusiface_device *d, DBusMessageIter *iter) {
+    pa_assert(d);
+    pa_assert(iter);
+
+    append_interface(d, iter, PA_DBUSIFACE_DEVICE_INTERFACE, append_properties);
+
+    if (d->type == PA_DEVICE_TYPE_SINK)
+        append_interface(d, iter, PA_DBUSIFACE_SINK_INTERFACE, append_sink_properties);
+    else
+        append_interface(d, iter, PA_DBUSIFACE_SOURCE_INTERFACE, append_source_properties);
+}
+
 pa_sink *pa_dbusiface_device_get_sink(pa_dbusiface_device *d) {
     pa_assert(d);
     pa_assert(d->type == PA_DEVICE_TYPE_SINK);
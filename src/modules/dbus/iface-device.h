@@ -47,6 +47,11 @@ void pa_dbusiface_device_free(pa_dbusiface_device *d);
 
 const char *pa_dbusiface_device_get_path(pa_dbusiface_device *d);
 
+/* Appends the properties of all interfaces of the device to iter, which
+ * must be an open "a{sa{sv}}" container, like for the Properties.GetAll
+ * replies of the interfaces one by one. */
+void pa_dbusiface_device_append_properties(pa_dbusiface_device *d, DBusMessageIter *iter);
+
 pa_sink *pa_dbusiface_device_get_sink(pa_dbusiface_device *d);
 pa_source *pa_dbusiface_device_get_source(pa_dbusiface_device *d);
 
@@ -0,0 +1,200 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <dbus/dbus.h>
+
+#include <pulsecore/core-stats.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/dbus-util.h>
+#include <pulsecore/protocol-dbus.h>
+
+#include "iface-stats.h"
+
+#define OBJECT_NAME "stats"
+
+#define STATS_SIGNATURE "(ouuuuuusttuuuu)"
+
+static void handle_get_stats(DBusConnection *conn, DBusMessage *msg, void *userdata);
+static void handle_reset(DBusConnection *conn, DBusMessage *msg, void *userdata);
+
+struct pa_dbusiface_stats {
+    pa_core *core;
+    pa_dbusiface_core *dbus_core;
+    char *path;
+    pa_dbus_protocol *dbus_protocol;
+};
+
+enum method_handler_index {
+    METHOD_HANDLER_GET_STATS,
+    METHOD_HANDLER_RESET,
+    METHOD_HANDLER_MAX
+};
+
+static pa_dbus_arg_info get_stats_args[] = { { "stats", "a" STATS_SIGNATURE, "out" } };
+
+static pa_dbus_method_handler method_handlers[METHOD_HANDLER_MAX] = {
+    [METHOD_HANDLER_GET_STATS] = {
+        .method_name = "GetStats",
+        .arguments = get_stats_args,
+        .n_arguments = sizeof(get_stats_args) / sizeof(pa_dbus_arg_info),
+        .receive_cb = handle_get_stats },
+    [METHOD_HANDLER_RESET] = {
+        .method_name = "Reset",
+        .arguments = NULL,
+        .n_arguments = 0,
+        .receive_cb = handle_reset }
+};
+
+static pa_dbus_interface_info stats_interface_info = {
+    .name = PA_DBUSIFACE_STATS_INTERFACE,
+    .method_handlers = method_handlers,
+    .n_method_handlers = METHOD_HANDLER_MAX,
+    .property_handlers = NULL,
+    .n_property_handlers = 0,
+    .get_all_properties_cb = NULL,
+    .signals = NULL,
+    .n_signals = 0
+};
+
+struct append_data {
+    pa_dbusiface_stats *stats;
+    DBusMessageIter *array_iter;
+};
+
+static const char *get_object_path(pa_dbusiface_stats *s, const pa_core_stats_info *i) {
+    switch (i->object) {
+        case PA_CORE_STATS_SINK:
+            return pa_dbusiface_core_get_sink_path(s->dbus_core, pa_idxset_get_by_index(s->core->sinks, i->index));
+        case PA_CORE_STATS_SOURCE:
+            return pa_dbusiface_core_get_source_path(s->dbus_core, pa_idxset_get_by_index(s->core->sources, i->index));
+        case PA_CORE_STATS_SINK_INPUT:
+            return pa_dbusiface_core_get_playback_stream_path(s->dbus_core, pa_idxset_get_by_index(s->core->sink_inputs, i->index));
+        case PA_CORE_STATS_SOURCE_OUTPUT:
+            return pa_dbusiface_core_get_record_stream_path(s->dbus_core, pa_idxset_get_by_index(s->core->source_outputs, i->index));
+    }
+
+    pa_assert_not_reached();
+}
+
+static void append_stats(const pa_core_stats_info *i, void *userdata) {
+    struct append_data *d = userdata;
+    DBusMessageIter struct_iter;
+    const char *path, *method;
+    dbus_uint64_t buffer_usec, watermark_usec;
+
+    path = get_object_path(d->stats, i);
+    method = i->resample_method ? i->resample_method : "";
+    buffer_usec = i->buffer_usec;
+    watermark_usec = i->watermark_usec;
+
+    pa_assert_se(dbus_message_iter_open_container(d->array_iter, DBUS_TYPE_STRUCT, NULL, &struct_iter));
+    pa_assert_se(dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_OBJECT_PATH, &path));
+    pa_assert_se(dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32, &i->busy_usec));
+    pa_assert_se(dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32, &i->resample_usec));
+    pa_assert_se(dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32, &i->rewinds));
+    pa_assert_se(dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32, &i->rewind_bytes));
+    pa_assert_se(dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32, &i->underruns));
+    pa_assert_se(dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32, &i->overruns));
+    pa_assert_se(dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &method));
+    pa_assert_se(dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &buffer_usec));
+    pa_assert_se(dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &watermark_usec));
+    pa_assert_se(dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32, &i->rerender_bytes));
+    pa_assert_se(dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32, &i->history_bytes));
+    pa_assert_se(dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32, &i->resample_degradation));
+    pa_assert_se(dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32, &i->cpu_usec));
+    pa_assert_se(dbus_message_iter_close_container(d->array_iter, &struct_iter));
+}
+
+static void handle_get_stats(DBusConnection *conn, DBusMessage *msg, void *userdata) {
+    pa_dbusiface_stats *s = userdata;
+    DBusMessage *reply = NULL;
+    DBusMessageIter msg_iter;
+    DBusMessageIter array_iter;
+    struct append_data d;
+
+    pa_assert(conn);
+    pa_assert(msg);
+    pa_assert(s);
+
+    pa_assert_se((reply = dbus_message_new_method_return(msg)));
+
+    dbus_message_iter_init_append(reply, &msg_iter);
+    pa_assert_se(dbus_message_iter_open_container(&msg_iter, DBUS_TYPE_ARRAY, STATS_SIGNATURE, &array_iter));
+
+    d.stats = s;
+    d.array_iter = &array_iter;
+    pa_core_stats_foreach(s->core, append_stats, &d);
+
+    pa_assert_se(dbus_message_iter_close_container(&msg_iter, &array_iter));
+
+    pa_assert_se(dbus_connection_send(conn, reply, NULL));
+
+    dbus_message_unref(reply);
+}
+
+static void handle_reset(DBusConnection *conn, DBusMessage *msg, void *userdata) {
+    pa_dbusiface_stats *s = userdata;
+
+    pa_assert(conn);
+    pa_assert(msg);
+    pa_assert(s);
+
+    pa_core_stats_reset(s->core);
+
+    pa_dbus_send_empty_reply(conn, msg);
+}
+
+pa_dbusiface_stats *pa_dbusiface_stats_new(pa_dbusiface_core *dbus_core, pa_core *core) {
+    pa_dbusiface_stats *s;
+
+    pa_assert(dbus_core);
+    pa_assert(core);
+
+    s = pa_xnew(pa_dbusiface_stats, 1);
+    s->core = core;
+    s->dbus_core = dbus_core;
+    s->path = pa_sprintf_malloc("%s/%s", PA_DBUS_CORE_OBJECT_PATH, OBJECT_NAME);
+    s->dbus_protocol = pa_dbus_protocol_get(core);
+
+    pa_assert_se(pa_dbus_protocol_add_interface(s->dbus_protocol, s->path, &stats_interface_info, s) >= 0);
+
+    return s;
+}
+
+void pa_dbusiface_stats_free(pa_dbusiface_stats *s) {
+    pa_assert(s);
+
+    pa_assert_se(pa_dbus_protocol_remove_interface(s->dbus_protocol, s->path, stats_interface_info.name) >= 0);
+
+    pa_xfree(s->path);
+
+    pa_dbus_protocol_unref(s->dbus_protocol);
+
+    pa_xfree(s);
+}
+
+const char *pa_dbusiface_stats_get_path(pa_dbusiface_stats *s) {
+    pa_assert(s);
+
+    return s->path;
+}
@@ -0,0 +1,48 @@
+#ifndef foodbusifacestatshfoo
+#define foodbusifacestatshfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+/* This object implements the D-Bus interface org.PulseAudio.Core1.Stats.
+ *
+ * It has two methods: GetStats returns an array of (object, busy_usec,
+ * resample_usec, rewinds, rewind_bytes, underruns, overruns,
+ * resample_method, buffer_usec, watermark_usec, rerender_bytes,
+ * history_bytes, resample_degradation, cpu_usec) structs, one for
+ * every sink, source, playback and record stream, with the same
+ * meaning as in pa_ext_stats_info. Reset starts counting from zero
+ * again.
+ */
+
+#include <pulsecore/core.h>
+#include <pulsecore/protocol-dbus.h>
+
+#include "iface-core.h"
+
+#define PA_DBUSIFACE_STATS_INTERFACE PA_DBUS_CORE_INTERFACE ".Stats"
+
+typedef struct pa_dbusiface_stats pa_dbusiface_stats;
+
+pa_dbusiface_stats *pa_dbusiface_stats_new(pa_dbusiface_core *dbus_core, pa_core *core);
+void pa_dbusiface_stats_free(pa_dbusiface_stats *s);
+
+const char *pa_dbusiface_stats_get_path(pa_dbusiface_stats *s);
+
+#endif
@@ -507,11 +507,7 @@ static void handle_get_property_list(DBusConnection *conn, DBusMessage *msg, voi
     pa_dbus_send_proplist_variant_reply(conn, msg, s->proplist);
 }
 
-static void handle_get_all(DBusConnection *conn, DBusMessage *msg, void *userdata) {
-    pa_dbusiface_stream *s = userdata;
-    DBusMessage *reply = NULL;
-    DBusMessageIter msg_iter;
-    DBusMessageIter dict_iter;
+static void append_properties(pa_dbusiface_stream *s, DBusMessageIter *dict_iter) {
     dbus_uint32_t idx = 0;
     const char *driver = NULL;
     pa_module *owner_module = NULL;
@@ -528,8 +524,6 @@ static void handle_get_all(DBusConnection *conn, DBusMessage *msg, void *userdat
     const char *resample_method = NULL;
     unsigned i = 0;
 
-    pa_assert(conn);
-    pa_assert(msg);
     pa_assert(s);
 
     if (s->has_volume) {
@@ -567,39 +561,52 @@ static void handle_get_all(DBusConnection *conn, DBusMessage *msg, void *userdat
     if (!resample_method)
         resample_method = "";
 
-    pa_assert_se((reply = dbus_message_new_method_return(msg)));
-
-    dbus_message_iter_init_append(reply, &msg_iter);
-    pa_assert_se(dbus_message_iter_open_container(&msg_iter, DBUS_TYPE_ARRAY, "{sv}", &dict_iter));
-
-    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_INDEX].property_name, DBUS_TYPE_UINT32, &idx);
+    pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_INDEX].property_name, DBUS_TYPE_UINT32, &idx);
 
     if (driver)
-        pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_DRIVER].property_name, DBUS_TYPE_STRING, &driver);
+        pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_DRIVER].property_name, DBUS_TYPE_STRING, &driver);
 
     if (owner_module)
-        pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_OWNER_MODULE].property_name, DBUS_TYPE_OBJECT_PATH, &owner_module_path);
+        pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_OWNER_MODULE].property_name, DBUS_TYPE_OBJECT_PATH, &owner_module_path);
 
     if (client)
-        pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_CLIENT].property_name, DBUS_TYPE_OBJECT_PATH, &client_path);
+        pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_CLIENT].property_name, DBUS_TYPE_OBJECT_PATH, &client_path);
 
-    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_DEVICE].property_name, DBUS_TYPE_OBJECT_PATH, &device);
-    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_SAMPLE_FORMAT].property_name, DBUS_TYPE_UINT32, &sample_format);
-    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_SAMPLE_RATE].property_name, DBUS_TYPE_UINT32, &s->sample_rate);
-    pa_dbus_append_basic_array_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_CHANNELS].property_name, DBUS_TYPE_UINT32, channels, channel_map->channels);
+    pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_DEVICE].property_name, DBUS_TYPE_OBJECT_PATH, &device);
+    pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_SAMPLE_FORMAT].property_name, DBUS_TYPE_UINT32, &sample_format);
+    pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_SAMPLE_RATE].property_name, DBUS_TYPE_UINT32, &s->sample_rate);
+    pa_dbus_append_basic_array_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_CHANNELS].property_name, DBUS_TYPE_UINT32, channels, channel_map->channels);
 
     if (s->has_volume) {
-        pa_dbus_append_basic_array_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_VOLUME].property_name, DBUS_TYPE_UINT32, volume, s->volume.channels);
-        pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_MUTE].property_name, DBUS_TYPE_BOOLEAN, &s->mute);
+        pa_dbus_append_basic_array_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_VOLUME].property_name, DBUS_TYPE_UINT32, volume, s->volume.channels);
+        pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_MUTE].property_name, DBUS_TYPE_BOOLEAN, &s->mute);
     }
 
-    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_BUFFER_LATENCY].property_name, DBUS_TYPE_UINT64, &buffer_latency);
-    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_DEVICE_LATENCY].property_name, DBUS_TYPE_UINT64, &device_latency);
-    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_RESAMPLE_METHOD].property_name, DBUS_TYPE_STRING, &resample_method);
-    pa_dbus_append_proplist_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_PROPERTY_LIST].property_name, s->proplist);
+    pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_BUFFER_LATENCY].property_name, DBUS_TYPE_UINT64, &buffer_latency);
+    pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_DEVICE_LATENCY].property_name, DBUS_TYPE_UINT64, &device_latency);
+    pa_dbus_append_basic_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_RESAMPLE_METHOD].property_name, DBUS_TYPE_STRING, &resample_method);
+    pa_dbus_append_proplist_variant_dict_entry(dict_iter, property_handlers[PROPERTY_HANDLER_PROPERTY_LIST].property_name, s->proplist);
+}
+
+static void handle_get_all(DBusConnection *conn, DBusMessage *msg, void *userdata) {
+    pa_dbusiface_stream *s = userdata;
+    DBusMessage *reply = NULL;
+    DBusMessageIter msg_iter;
+    DBusMessageIter dict_iter;
+
+    pa_assert(conn);
+    pa_assert(msg);
+    pa_assert(s);
+
+    pa_assert_se((reply = dbus_message_new_method_return(msg)));
 
+    dbus_message_iter_init_append(reply, &msg_iter);
+    pa_assert_se(dbus_message_iter_open_container(&msg_iter, DBUS_TYPE_ARRAY, "{sv}", &dict_iter));
+    append_properties(s, &dict_iter);
     pa_assert_se(dbus_message_iter_close_container(&msg_iter, &dict_iter));
+
     pa_assert_se(dbus_connection_send(conn, reply, NULL));
+
     dbus_message_unref(reply);
 }
 
@@ -759,7 +766,7 @@ static void subscription_cb(pa_core *c, pa_subscription_event_type_t t, uint32_t
                                                       DBUS_TYPE_ARRAY, DBUS_TYPE_UINT32, &volume_ptr, s->volume.channels,
                                                       DBUS_TYPE_INVALID));
 
-                pa_dbus_protocol_send_signal(s->dbus_protocol, signal_msg);
+                pa_dbus_protocol_send_coalesced_signal(s->dbus_protocol, signal_msg);
                 dbus_message_unref(signal_msg);
                 signal_msg = NULL;
             }
@@ -775,7 +782,7 @@ static void subscription_cb(pa_core *c, pa_subscription_event_type_t t, uint32_t
 							      signals[SIGNAL_MUTE_UPDATED].name));
             pa_assert_se(dbus_message_append_args(signal_msg, DBUS_TYPE_BOOLEAN, &s->mute, DBUS_TYPE_INVALID));
 
-            pa_dbus_protocol_send_signal(s->dbus_protocol, signal_msg);
+            pa_dbus_protocol_send_coalesced_signal(s->dbus_protocol, signal_msg);
             dbus_message_unref(signal_msg);
             signal_msg = NULL;
         }
@@ -794,7 +801,7 @@ static void subscription_cb(pa_core *c, pa_subscription_event_type_t t, uint32_t
         dbus_message_iter_init_append(signal_msg, &msg_iter);
         pa_dbus_append_proplist(&msg_iter, s->proplist);
 
-        pa_dbus_protocol_send_signal(s->dbus_protocol, signal_msg);
+        pa_dbus_protocol_send_coalesced_signal(s->dbus_protocol, signal_msg);
         dbus_message_unref(signal_msg);
         signal_msg = NULL;
     }
@@ -931,3 +938,19 @@ const char *pa_dbusiface_stream_get_path(pa_dbusiface_stream *s) {
 
     return s->path;
 }
+
+void pa_dbusiface_stream_append_properties(pa_dbusiface_stream *s, DBusMessageIter *iter) {
+    DBusMessageIter entry_iter;
+    DBusMessageIter dict_iter;
+    const char *interface = PA_DBUSIFACE_STREAM_INTERFACE;
+
+    pa_assert(s);
+    pa_assert(iter);
+
+    pa_assert_se(dbus_message_iter_open_container(iter, DBUS_TYPE_DICT_ENTRY, NULL, &entry_iter));
+    pa_assert_se(dbus_message_iter_append_basic(&entry_iter, DBUS_TYPE_STRING, &interface));
+    pa_assert_se(dbus_message_iter_open_container(&entry_iter, DBUS_TYPE_ARRAY, "{sv}", &dict_iter));
+    append_properties(s, &dict_iter);
+    pa_assert_se(dbus_message_iter_close_container(&entry_iter, &dict_iter));
+    pa_assert_se(dbus_message_iter_close_container(iter, &entry_iter));
+}
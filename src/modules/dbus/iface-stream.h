@@ -44,4 +44,8 @@ void pa_dbusiface_stream_free(pa_dbusiface_stream *s);
 
 const char *pa_dbusiface_stream_get_path(pa_dbusiface_stream *s);
 
+/* Appends the Stream interface properties to iter, which must be an open
+ * "a{sa{sv}}" container. */
+void pa_dbusiface_stream_append_properties(pa_dbusiface_stream *s, DBusMessageIter *iter);
+
 #endif
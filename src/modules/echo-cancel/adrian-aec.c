@@ -30,6 +30,10 @@
 #include <xmmintrin.h>
 #endif
 
+#if defined (__arm__) && defined (__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 /* Vector Dot Product */
 static REAL dotp(REAL a[], REAL b[])
 {
@@ -67,6 +71,73 @@ static REAL dotp_sse(REAL a[], REAL b[])
 #endif
 }
 
+static REAL dotp_neon(REAL a[], REAL b[])
+{
+#if defined (__arm__) && defined (__ARM_NEON__)
+  int j;
+  float32x4_t acc0 = vdupq_n_f32(0.0f), acc1 = vdupq_n_f32(0.0f);
+  float32x2_t sum;
+
+  for (j = 0; j < NLMS_LEN; j += 8) {
+    acc0 = vmlaq_f32(acc0, vld1q_f32(a + j), vld1q_f32(b + j));
+    acc1 = vmlaq_f32(acc1, vld1q_f32(a + j + 4), vld1q_f32(b + j + 4));
+  }
+  acc0 = vaddq_f32(acc0, acc1);
+  sum = vadd_f32(vget_low_f32(acc0), vget_high_f32(acc0));
+  sum = vpadd_f32(sum, sum);
+
+  return vget_lane_f32(sum, 0);
+#else
+  return dotp(a, b);
+#endif
+}
+
+/* Tap weight update w += mikro_ef * xf (filter learning) */
+static void update_w(REAL w[], REAL xf[], REAL mikro_ef)
+{
+#ifdef DISABLE_ORC
+  int i;
+
+  for (i = 0; i < NLMS_LEN; i += 2) {
+    // optimize: partial loop unrolling
+    w[i] += mikro_ef * xf[i];
+    w[i + 1] += mikro_ef * xf[i + 1];
+  }
+#else
+  update_tap_weights(w, xf, mikro_ef, NLMS_LEN);
+#endif
+}
+
+static void update_w_sse(REAL w[], REAL xf[], REAL mikro_ef)
+{
+#ifdef __SSE__
+  /* w is aligned, xf moves along the delay line */
+  int j;
+  __m128 m = _mm_set1_ps(mikro_ef);
+
+  for (j = 0; j < NLMS_LEN; j += 8) {
+    _mm_store_ps(w + j, _mm_add_ps(_mm_load_ps(w + j), _mm_mul_ps(m, _mm_loadu_ps(xf + j))));
+    _mm_store_ps(w + j + 4, _mm_add_ps(_mm_load_ps(w + j + 4), _mm_mul_ps(m, _mm_loadu_ps(xf + j + 4))));
+  }
+#else
+  update_w(w, xf, mikro_ef);
+#endif
+}
+
+static void update_w_neon(REAL w[], REAL xf[], REAL mikro_ef)
+{
+#if defined (__arm__) && defined (__ARM_NEON__)
+  int j;
+
+  for (j = 0; j < NLMS_LEN; j += 8) {
+    vst1q_f32(w + j, vmlaq_n_f32(vld1q_f32(w + j), vld1q_f32(xf + j), mikro_ef));
+    vst1q_f32(w + j + 4, vmlaq_n_f32(vld1q_f32(w + j + 4), vld1q_f32(xf + j + 4), mikro_ef));
+  }
+#else
+  update_w(w, xf, mikro_ef);
+#endif
+}
+
 
 AEC* AEC_init(int RATE, int have_vector)
 {
@@ -95,12 +166,19 @@ AEC* AEC_init(int RATE, int have_vector)
 
   if (have_vector) {
       /* Get a 16-byte aligned location */
-      a->w = (REAL *) (((uintptr_t) a->w_arr) + (((uintptr_t) a->w_arr) % 16));
+      a->w = (REAL *) ((((uintptr_t) a->w_arr) + 15) & ~(uintptr_t) 15);
+#if defined (__arm__) && defined (__ARM_NEON__)
+      a->dotp = dotp_neon;
+      a->update_w = update_w_neon;
+#else
       a->dotp = dotp_sse;
+      a->update_w = update_w_sse;
+#endif
   } else {
       /* We don't care about alignment, just use the array as-is */
       a->w = a->w_arr;
       a->dotp = dotp;
+      a->update_w = update_w;
   }
 
   return a;
@@ -163,7 +241,7 @@ static void AEC_leaky(AEC *a)
     } else if (1 == a->hangover) {
       --(a->hangover);
       // My Leaky NLMS is to erase vector w when hangover expires
-      memset(a->w, 0, sizeof(a->w));
+      memset(a->w, 0, NLMS_LEN * sizeof(REAL));
     }
   }
 }
@@ -199,17 +277,8 @@ static REAL AEC_nlms_pw(AEC *a, REAL d, REAL x_, float stepsize)
     // calculate variable step size
     REAL mikro_ef = stepsize * ef / a->dotp_xf_xf;
 
-#ifdef DISABLE_ORC
     // update tap weights (filter learning)
-    int i;
-    for (i = 0; i < NLMS_LEN; i += 2) {
-      // optimize: partial loop unrolling
-      a->w[i] += mikro_ef * a->xf[i + a->j];
-      a->w[i + 1] += mikro_ef * a->xf[i + a->j + 1];
-    }
-#else
-    update_tap_weights(a->w, &a->xf[a->j], mikro_ef, NLMS_LEN);
-#endif
+    a->update_w(a->w, &a->xf[a->j], mikro_ef);
   }
 
   if (--(a->j) < 0) {
@@ -230,6 +299,23 @@ static REAL AEC_nlms_pw(AEC *a, REAL d, REAL x_, float stepsize)
 }
 
 
+// Everything after the microphone filters for one sample
+static REAL AEC_cancel(AEC *a, REAL d, REAL x)
+{
+  // Spk Highpass Filter - to remove DC
+  x = IIR_HP_highpass(a->acSpk, x);
+
+  // Double Talk Detector
+  a->stepsize = AEC_dtd(a, d, x);
+
+  // Leaky (ageing of vector w)
+  AEC_leaky(a);
+
+  // Acoustic Echo Cancellation
+  return AEC_nlms_pw(a, d, x, a->stepsize);
+}
+
+
 int AEC_doAEC(AEC *a, int d_, int x_)
 {
   REAL d = (REAL) d_;
@@ -244,17 +330,7 @@ int AEC_doAEC(AEC *a, int d_, int x_)
   // Amplify, for e.g. Soundcards with -6dB max. volume
   d *= a->gain;
 
-  // Spk Highpass Filter - to remove DC
-  x = IIR_HP_highpass(a->acSpk, x);
-
-  // Double Talk Detector
-  a->stepsize = AEC_dtd(a, d, x);
-
-  // Leaky (ageing of vector w)
-  AEC_leaky(a);
-
-  // Acoustic Echo Cancellation
-  d = AEC_nlms_pw(a, d, x, a->stepsize);
+  d = AEC_cancel(a, d, x);
 
 #if 0
   if (fdwdisplay >= 0) {
@@ -277,3 +353,28 @@ int AEC_doAEC(AEC *a, int d_, int x_)
 
   return (int) d;
 }
+
+
+void AEC_doAEC_block(AEC *a, const int16_t *d_, const int16_t *x_, int16_t *e, int n)
+{
+  REAL d[FIR_BLOCK_LEN];
+
+  while (n > 0) {
+    int l = PA_MIN(n, FIR_BLOCK_LEN), i;
+
+    // The microphone filters don't depend on the loudspeaker signal, so
+    // run them over the whole block first
+    for (i = 0; i < l; i++)
+      d[i] = IIR_HP_highpass(a->acMic, (REAL) d_[i]);
+
+    FIR_HP_300Hz_highpass_block(a->cutoff, d, l);
+
+    for (i = 0; i < l; i++)
+      e[i] = (int16_t) (int) AEC_cancel(a, d[i] * a->gain, (REAL) x_[i]);
+
+    d_ += l;
+    x_ += l;
+    e += l;
+    n -= l;
+  }
+}
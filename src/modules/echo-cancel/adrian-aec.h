@@ -17,6 +17,8 @@
 #include <config.h>
 #endif
 
+#include <stdint.h>
+
 #include <pulse/gccmacro.h>
 #include <pulse/xmalloc.h>
 
@@ -177,6 +179,21 @@ struct FIR_HP_300Hz {
   REAL z[36];
 };
 
+static const REAL FIR_HP_300Hz_a[36] = {
+  // Kaiser Window FIR Filter, Filter type: High pass
+  // Passband: 150.0 - 4000.0 Hz, Order: 34
+  // Transition band: 34.0 Hz, Stopband attenuation: 10.0 dB
+  -0.016165324, -0.017454365, -0.01871232, -0.019931411,
+  -0.021104068, -0.022222936, -0.02328091, -0.024271343,
+  -0.025187887, -0.02602462, -0.026776174, -0.027437767,
+  -0.028004972, -0.028474221, -0.028842418, -0.029107114,
+  -0.02926664, 0.8524841, -0.02926664, -0.029107114,
+  -0.028842418, -0.028474221, -0.028004972, -0.027437767,
+  -0.026776174, -0.02602462, -0.025187887, -0.024271343,
+  -0.02328091, -0.022222936, -0.021104068, -0.019931411,
+  -0.01871232, -0.017454365, -0.016165324, 0.0
+};
+
 static  FIR_HP_300Hz* FIR_HP_300Hz_init(void) {
     FIR_HP_300Hz *ret = pa_xnew(FIR_HP_300Hz, 1);
     memset(ret, 0, sizeof(FIR_HP_300Hz));
@@ -186,30 +203,51 @@ static  FIR_HP_300Hz* FIR_HP_300Hz_init(void) {
 static  REAL FIR_HP_300Hz_highpass(FIR_HP_300Hz *f, REAL in) {
     REAL sum0 = 0.0, sum1 = 0.0;
     int j;
-    const REAL a[36] = {
-      // Kaiser Window FIR Filter, Filter type: High pass
-      // Passband: 150.0 - 4000.0 Hz, Order: 34
-      // Transition band: 34.0 Hz, Stopband attenuation: 10.0 dB
-      -0.016165324, -0.017454365, -0.01871232, -0.019931411,
-      -0.021104068, -0.022222936, -0.02328091, -0.024271343,
-      -0.025187887, -0.02602462, -0.026776174, -0.027437767,
-      -0.028004972, -0.028474221, -0.028842418, -0.029107114,
-      -0.02926664, 0.8524841, -0.02926664, -0.029107114,
-      -0.028842418, -0.028474221, -0.028004972, -0.027437767,
-      -0.026776174, -0.02602462, -0.025187887, -0.024271343,
-      -0.02328091, -0.022222936, -0.021104068, -0.019931411,
-      -0.01871232, -0.017454365, -0.016165324, 0.0
-    };
     memmove(f->z + 1, f->z, 35 * sizeof(REAL));
     f->z[0] = in;
 
     for (j = 0; j < 36; j += 2) {
       // optimize: partial loop unrolling
-      sum0 += a[j] * f->z[j];
-      sum1 += a[j + 1] * f->z[j + 1];
+      sum0 += FIR_HP_300Hz_a[j] * f->z[j];
+      sum1 += FIR_HP_300Hz_a[j + 1] * f->z[j + 1];
     }
     return sum0 + sum1;
   }
+
+// longest block filtered in one go by FIR_HP_300Hz_highpass_block()
+#define FIR_BLOCK_LEN 256
+
+/* Filters n <= FIR_BLOCK_LEN samples in place. Gives the same results as
+ * FIR_HP_300Hz_highpass() on each sample, without moving the delay line
+ * for every one of them. */
+static  void FIR_HP_300Hz_highpass_block(FIR_HP_300Hz *f, REAL *inout, int n) {
+    // the last 34 inputs, oldest first, followed by the new ones
+    REAL buf[34 + FIR_BLOCK_LEN];
+    int i, j;
+
+    pa_assert(n <= FIR_BLOCK_LEN);
+
+    for (j = 0; j < 34; j++)
+      buf[j] = f->z[33 - j];
+    memcpy(buf + 34, inout, n * sizeof(REAL));
+
+    for (i = 0; i < n; i++) {
+      const REAL *z = buf + 34 + i;
+      REAL sum0 = 0.0, sum1 = 0.0;
+
+      // z[-j] is what FIR_HP_300Hz_highpass() has in f->z[j], the last
+      // tap has a zero coefficient
+      for (j = 0; j < 34; j += 2) {
+        sum0 += FIR_HP_300Hz_a[j] * z[-j];
+        sum1 += FIR_HP_300Hz_a[j + 1] * z[-j - 1];
+      }
+      sum0 += FIR_HP_300Hz_a[34] * z[-34];
+      inout[i] = sum0 + sum1;
+    }
+
+    for (j = 0; j < 35; j++)
+      f->z[j] = buf[33 + n - j];
+  }
 #endif
 
 typedef struct IIR1 IIR1;
@@ -328,6 +366,7 @@ struct AEC {
 
   // vfuncs that are picked based on processor features available
   REAL (*dotp) (REAL[], REAL[]);
+  void (*update_w) (REAL w[], REAL xf[], REAL mikro_ef);
 };
 
 /* Double-Talk Detector
@@ -360,6 +399,14 @@ static  REAL AEC_nlms_pw(AEC *a, REAL d, REAL x_, float stepsize);
  */
   int AEC_doAEC(AEC *a, int d_, int x_);
 
+/* Acoustic Echo Cancellation and Suppression of n samples, the same as
+ * calling AEC_doAEC() on each of them
+ * in   d:  microphone signal with echo
+ * in   x:  loudspeaker signal
+ * out  e:  echo cancelled microphone signal
+ */
+  void AEC_doAEC_block(AEC *a, const int16_t *d, const int16_t *x, int16_t *e, int n);
+
 PA_GCC_UNUSED static  float AEC_getambient(AEC *a) {
     return a->dfast;
   }
@@ -37,6 +37,7 @@
 
 /* should be between 10-20 ms */
 #define DEFAULT_FRAME_SIZE_MS 20
+#define MAX_RATE 32000
 
 static const char* const valid_modargs[] = {
     "frame_size_ms",
@@ -48,6 +49,11 @@ static void pa_adrian_ec_fixate_spec(pa_sample_spec *source_ss, pa_channel_map *
 {
     source_ss->format = PA_SAMPLE_S16NE;
     source_ss->channels = 1;
+
+    /* The filter length is fixed in samples, so higher rates would
+     * shorten the echo tail that can be cancelled */
+    if (source_ss->rate > MAX_RATE)
+        source_ss->rate = MAX_RATE;
     pa_channel_map_init_mono(source_map);
 
     *sink_ss = *source_ss;
@@ -76,6 +82,9 @@ pa_bool_t pa_adrian_ec_init(pa_core *c, pa_echo_canceller *ec,
 
     pa_adrian_ec_fixate_spec(source_ss, source_map, sink_ss, sink_map);
 
+    /* A single filter, several sinks have to be mixed */
+    ec->params.n_references = 1;
+
     rate = source_ss->rate;
     framelen = (rate * frame_size_ms) / 1000;
 
@@ -83,9 +92,10 @@ pa_bool_t pa_adrian_ec_init(pa_core *c, pa_echo_canceller *ec,
 
     pa_log_debug ("Using framelen %d, blocksize %u, channels %d, rate %d", framelen, ec->params.priv.adrian.blocksize, source_ss->channels, source_ss->rate);
 
-    /* For now we only support SSE */
     if (c->cpu_info.cpu_type == PA_CPU_X86 && (c->cpu_info.flags.x86 & PA_CPU_X86_SSE))
         have_vector = 1;
+    else if (c->cpu_info.cpu_type == PA_CPU_ARM && (c->cpu_info.flags.arm & PA_CPU_ARM_NEON))
+        have_vector = 1;
 
     ec->params.priv.adrian.aec = AEC_init(rate, have_vector);
     if (!ec->params.priv.adrian.aec)
@@ -101,14 +111,9 @@ fail:
 }
 
 void pa_adrian_ec_run(pa_echo_canceller *ec, const uint8_t *rec, const uint8_t *play, uint8_t *out) {
-    unsigned int i;
-
-    for (i = 0; i < ec->params.priv.adrian.blocksize; i += 2) {
-        /* We know it's S16NE mono data */
-        int r = *(int16_t *)(rec + i);
-        int p = *(int16_t *)(play + i);
-        *(int16_t *)(out + i) = (int16_t) AEC_doAEC(ec->params.priv.adrian.aec, r, p);
-    }
+    /* We know it's S16NE mono data */
+    AEC_doAEC_block(ec->params.priv.adrian.aec, (const int16_t *) rec, (const int16_t *) play, (int16_t *) out,
+                    ec->params.priv.adrian.blocksize / 2);
 }
 
 void pa_adrian_ec_done(pa_echo_canceller *ec) {
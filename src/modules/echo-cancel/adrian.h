@@ -29,3 +29,4 @@ typedef struct AEC AEC;
 
 AEC* AEC_init(int RATE, int have_vector);
 int AEC_doAEC(AEC *a, int d_, int x_);
+void AEC_doAEC_block(AEC *a, const int16_t *d, const int16_t *x, int16_t *e, int n);
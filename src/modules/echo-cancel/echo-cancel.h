@@ -74,6 +74,13 @@ struct pa_echo_canceller_params {
     /* Set this if canceller can do drift compensation. Also see set_drift()
      * below */
     pa_bool_t drift_compensation;
+
+    /* Number of sinks the echo is cancelled of, set before init() is
+     * called. A canceller that keeps this takes their blocks stacked frame
+     * by frame in the play buffer of run(), so that it holds n_references
+     * times the channels of one. Setting it to 1 gets them mixed down into
+     * a single block instead. */
+    uint32_t n_references;
 };
 
 typedef struct pa_echo_canceller pa_echo_canceller;
@@ -51,6 +51,8 @@
 #include <pulsecore/log.h>
 #include <pulsecore/rtpoll.h>
 #include <pulsecore/sample-util.h>
+#include <pulsecore/semaphore.h>
+#include <pulsecore/thread.h>
 #include <pulsecore/ltdl-helper.h>
 
 #include "module-echo-cancel-symdef.h"
@@ -65,7 +67,7 @@ PA_MODULE_USAGE(
           "source_master=<name of source to filter> "
           "sink_name=<name for the sink> "
           "sink_properties=<properties for the sink> "
-          "sink_master=<name of sink to filter> "
+          "sink_master=<name of sink to filter, or a comma separated list of them> "
           "adjust_time=<how often to readjust rates in s> "
           "adjust_threshold=<how much drift to readjust after in ms> "
           "format=<sample format> "
@@ -77,6 +79,9 @@ PA_MODULE_USAGE(
           "save_aec=<save AEC data in /tmp> "
           "autoloaded=<set if this module is being loaded automatically> "
           "use_volume_sharing=<yes or no> "
+          "ec_thread=<run the canceller in a separate thread?> "
+          "realtime_priority=<priority of the canceller thread, 0 for no realtime scheduling> "
+          "cpu_affinity=<CPUs to run the canceller thread on> "
         ));
 
 /* NOTE: Make sure the enum and ec_table are maintained in the correct order */
@@ -138,9 +143,12 @@ static const pa_echo_canceller ec_table[] = {
 
 #define MEMBLOCKQ_MAXLENGTH (16*1024*1024)
 
-/* Can only be used in main context */
-#define IS_ACTIVE(u) ((pa_source_get_state((u)->source) == PA_SOURCE_RUNNING) && \
-                      (pa_sink_get_state((u)->sink) == PA_SINK_RUNNING))
+/* How many blocks may be waiting for or in the canceller thread */
+#define EC_QUEUE_MAX 4
+
+/* How many sinks we can cancel the echo of at once */
+#define MAX_REFERENCES 8
+
 
 /* This module creates a new (virtual) source and sink.
  *
@@ -169,10 +177,43 @@ static const pa_echo_canceller ec_table[] = {
  *    be before capture and the difference should not be bigger than one frame
  *    size. We would ideally like to resample the sink_input but most driver
  *    don't give enough accuracy to be able to do that right now.
+ *
+ * With ec_thread=yes the blocks matched up in the source IO thread are handed
+ * to a separate thread for the run() call, through a ring of EC_QUEUE_MAX
+ * jobs. The canceled blocks come back through our asyncmsgq and are posted
+ * in order from the source IO thread, so a slow block delays the source
+ * instead of making the master source overrun. If the ring is full the
+ * remaining capture data stays in the memblockq until the next push.
+ *
+ * sink_master can name several sinks, each of which gets its own virtual
+ * sink. They are the playback references, and each is aligned against the
+ * capture separately. Dropping capture samples is left to the first one,
+ * the others only drop their own samples. Their blocks are stacked into
+ * one play buffer for cancellers that handle several references, and mixed
+ * down to one for the others.
  */
 
 struct userdata;
 
+/* One playback reference, with the virtual sink on top of its sink
+ * master */
+struct reference {
+    struct userdata *userdata;
+
+    pa_sink *sink;
+    pa_bool_t sink_auto_desc;
+    pa_sink_input *sink_input;
+    pa_memblockq *sink_memblockq;
+    int64_t send_counter;          /* updated in sink IO thread */
+    int64_t recv_counter;
+    size_t sink_skip;
+
+    /* Bytes left over from previous iteration */
+    size_t sink_rem;
+
+    pa_rtpoll_item *rtpoll_item_write;
+};
+
 struct pa_echo_canceller_msg {
     pa_msgobject parent;
     struct userdata *userdata;
@@ -193,6 +234,38 @@ struct snapshot {
     int64_t recv_counter;
     size_t rlen;
     size_t plen;
+
+    /* canceller run time since the last snapshot, only set for the first
+     * reference */
+    pa_usec_t run_time_sum;
+    pa_usec_t run_time_max;
+    unsigned n_runs;
+    unsigned n_queued;
+};
+
+struct ec_job {
+    pa_memchunk rec, play, out;
+
+    /* capture volume as of this block, for the canceller's gain control */
+    pa_cvolume volume;
+    pa_bool_t volume_changed;
+
+    pa_usec_t run_time;
+};
+
+struct ec_worker {
+    pa_thread *thread;
+    int rtprio;
+    char *cpus;
+
+    /* one post for each job, and one for quit */
+    pa_semaphore *sem;
+    pa_bool_t quit;
+
+    struct ec_job jobs[EC_QUEUE_MAX];
+    unsigned write_idx, n_queued; /* source I/O thread */
+    unsigned read_idx;            /* canceller thread */
+    struct ec_job *current;       /* canceller thread */
 };
 
 struct userdata {
@@ -210,7 +283,7 @@ struct userdata {
 
     /* to wakeup the source I/O thread */
     pa_asyncmsgq *asyncmsgq;
-    pa_rtpoll_item *rtpoll_item_read, *rtpoll_item_write;
+    pa_rtpoll_item *rtpoll_item_read;
 
     pa_source *source;
     pa_bool_t source_auto_desc;
@@ -218,18 +291,12 @@ struct userdata {
     pa_memblockq *source_memblockq; /* echo canceler needs fixed sized chunks */
     size_t source_skip;
 
-    pa_sink *sink;
-    pa_bool_t sink_auto_desc;
-    pa_sink_input *sink_input;
-    pa_memblockq *sink_memblockq;
-    int64_t send_counter;          /* updated in sink IO thread */
-    int64_t recv_counter;
-    size_t sink_skip;
-
     /* Bytes left over from previous iteration */
-    size_t sink_rem;
     size_t source_rem;
 
+    struct reference *refs;
+    unsigned n_refs;
+
     pa_atomic_t request_resync;
 
     pa_time_event *time_event;
@@ -243,12 +310,20 @@ struct userdata {
 
     pa_bool_t use_volume_sharing;
 
+    struct ec_worker *ec_worker;
+
+    /* canceller run time, summed up in the source I/O thread */
+    pa_usec_t run_time_sum;
+    pa_usec_t run_time_max;
+    unsigned n_runs;
+
     struct {
         pa_cvolume current_volume;
     } thread_info;
 };
 
-static void source_output_snapshot_within_thread(struct userdata *u, struct snapshot *snapshot);
+static void source_output_snapshot_within_thread(struct userdata *u, struct snapshot *snapshots);
+static void post_capture_volume(struct userdata *u, pa_cvolume *v);
 
 static const char* const valid_modargs[] = {
     "source_name",
@@ -268,6 +343,9 @@ static const char* const valid_modargs[] = {
     "save_aec",
     "autoloaded",
     "use_volume_sharing",
+    "ec_thread",
+    "realtime_priority",
+    "cpu_affinity",
     NULL
 };
 
@@ -275,7 +353,8 @@ enum {
     SOURCE_OUTPUT_MESSAGE_POST = PA_SOURCE_OUTPUT_MESSAGE_MAX,
     SOURCE_OUTPUT_MESSAGE_REWIND,
     SOURCE_OUTPUT_MESSAGE_LATENCY_SNAPSHOT,
-    SOURCE_OUTPUT_MESSAGE_APPLY_DIFF_TIME
+    SOURCE_OUTPUT_MESSAGE_APPLY_DIFF_TIME,
+    SOURCE_OUTPUT_MESSAGE_CANCELED
 };
 
 enum {
@@ -320,63 +399,99 @@ static int64_t calc_diff(struct userdata *u, struct snapshot *snapshot) {
     return diff_time;
 }
 
+/* Called from main context */
+static pa_bool_t is_active(struct userdata *u) {
+    unsigned k;
+
+    if (pa_source_get_state(u->source) != PA_SOURCE_RUNNING)
+        return FALSE;
+
+    for (k = 0; k < u->n_refs; k++)
+        if (pa_sink_get_state(u->refs[k].sink) == PA_SINK_RUNNING)
+            return TRUE;
+
+    return FALSE;
+}
+
 /* Called from main context */
 static void time_callback(pa_mainloop_api *a, pa_time_event *e, const struct timeval *t, void *userdata) {
     struct userdata *u = userdata;
     uint32_t old_rate, base_rate, new_rate;
     int64_t diff_time;
     /*size_t fs*/
-    struct snapshot latency_snapshot;
+    struct snapshot latency_snapshots[MAX_REFERENCES];
+    unsigned k;
 
     pa_assert(u);
     pa_assert(a);
     pa_assert(u->time_event == e);
     pa_assert_ctl_context();
 
-    if (!IS_ACTIVE(u))
+    if (!is_active(u))
         return;
 
     /* update our snapshots */
-    pa_asyncmsgq_send(u->source_output->source->asyncmsgq, PA_MSGOBJECT(u->source_output), SOURCE_OUTPUT_MESSAGE_LATENCY_SNAPSHOT, &latency_snapshot, 0, NULL);
-    pa_asyncmsgq_send(u->sink_input->sink->asyncmsgq, PA_MSGOBJECT(u->sink_input), SINK_INPUT_MESSAGE_LATENCY_SNAPSHOT, &latency_snapshot, 0, NULL);
+    pa_asyncmsgq_send(u->source_output->source->asyncmsgq, PA_MSGOBJECT(u->source_output), SOURCE_OUTPUT_MESSAGE_LATENCY_SNAPSHOT, latency_snapshots, 0, NULL);
+    for (k = 0; k < u->n_refs; k++)
+        pa_asyncmsgq_send(u->refs[k].sink_input->sink->asyncmsgq, PA_MSGOBJECT(u->refs[k].sink_input), SINK_INPUT_MESSAGE_LATENCY_SNAPSHOT, &latency_snapshots[k], 0, NULL);
 
-    /* calculate drift between capture and playback */
-    diff_time = calc_diff(u, &latency_snapshot);
+    /* see how much of the time a block lasts the canceller needs */
+    if (latency_snapshots[0].n_runs > 0) {
+        pa_usec_t budget, run_time;
 
-    /*fs = pa_frame_size(&u->source_output->sample_spec);*/
-    old_rate = u->sink_input->sample_spec.rate;
-    base_rate = u->source_output->sample_spec.rate;
+        budget = pa_bytes_to_usec(u->blocksize, &u->source->sample_spec);
+        run_time = latency_snapshots[0].run_time_sum / latency_snapshots[0].n_runs;
 
-    if (diff_time < 0) {
-        /* recording before playback, we need to adjust quickly. The echo
-         * canceler does not work in this case. */
-        pa_asyncmsgq_post(u->asyncmsgq, PA_MSGOBJECT(u->source_output), SOURCE_OUTPUT_MESSAGE_APPLY_DIFF_TIME,
-            NULL, diff_time, NULL, NULL);
-        /*new_rate = base_rate - ((pa_usec_to_bytes(-diff_time, &u->source_output->sample_spec) / fs) * PA_USEC_PER_SEC) / u->adjust_time;*/
-        new_rate = base_rate;
-    }
-    else {
-        if (diff_time > u->adjust_threshold) {
-            /* diff too big, quickly adjust */
+        pa_log_debug("Run %llu (max %llu) of %llu usec per block, %u queued", (unsigned long long) run_time,
+            (unsigned long long) latency_snapshots[0].run_time_max, (unsigned long long) budget,
+            latency_snapshots[0].n_queued);
+
+        if (run_time > budget)
+            pa_log_warn("Echo canceller takes %llu usec for a block of %llu usec, it cannot keep up",
+                (unsigned long long) run_time, (unsigned long long) budget);
+    }
+
+    for (k = 0; k < u->n_refs; k++) {
+        struct reference *r = &u->refs[k];
+
+        /* calculate drift between capture and playback */
+        diff_time = calc_diff(u, &latency_snapshots[k]);
+
+        /*fs = pa_frame_size(&u->source_output->sample_spec);*/
+        old_rate = r->sink_input->sample_spec.rate;
+        base_rate = u->source_output->sample_spec.rate;
+
+        if (diff_time < 0) {
+            /* recording before playback, we need to adjust quickly. The echo
+             * canceler does not work in this case. */
             pa_asyncmsgq_post(u->asyncmsgq, PA_MSGOBJECT(u->source_output), SOURCE_OUTPUT_MESSAGE_APPLY_DIFF_TIME,
-                NULL, diff_time, NULL, NULL);
+                r, diff_time, NULL, NULL);
+            /*new_rate = base_rate - ((pa_usec_to_bytes(-diff_time, &u->source_output->sample_spec) / fs) * PA_USEC_PER_SEC) / u->adjust_time;*/
+            new_rate = base_rate;
         }
+        else {
+            if (diff_time > u->adjust_threshold) {
+                /* diff too big, quickly adjust */
+                pa_asyncmsgq_post(u->asyncmsgq, PA_MSGOBJECT(u->source_output), SOURCE_OUTPUT_MESSAGE_APPLY_DIFF_TIME,
+                    r, diff_time, NULL, NULL);
+            }
 
-        /* recording behind playback, we need to slowly adjust the rate to match */
-        /*new_rate = base_rate + ((pa_usec_to_bytes(diff_time, &u->source_output->sample_spec) / fs) * PA_USEC_PER_SEC) / u->adjust_time;*/
+            /* recording behind playback, we need to slowly adjust the rate to match */
+            /*new_rate = base_rate + ((pa_usec_to_bytes(diff_time, &u->source_output->sample_spec) / fs) * PA_USEC_PER_SEC) / u->adjust_time;*/
 
-        /* assume equal samplerates for now */
-        new_rate = base_rate;
-    }
+            /* assume equal samplerates for now */
+            new_rate = base_rate;
+        }
 
-    /* make sure we don't make too big adjustments because that sounds horrible */
-    if (new_rate > base_rate * 1.1 || new_rate < base_rate * 0.9)
-        new_rate = base_rate;
+        /* make sure we don't make too big adjustments because that sounds horrible */
+        if (new_rate > base_rate * 1.1 || new_rate < base_rate * 0.9)
+            new_rate = base_rate;
 
-    if (new_rate != old_rate) {
-        pa_log_info("Old rate %lu Hz, new rate %lu Hz", (unsigned long) old_rate, (unsigned long) new_rate);
+        if (new_rate != old_rate) {
+            pa_log_info("Old rate %lu Hz, new rate %lu Hz", (unsigned long) old_rate, (unsigned long) new_rate);
 
-        pa_sink_input_set_rate(u->sink_input, new_rate);
+            pa_sink_input_set_rate(r->sink_input, new_rate);
+        }
     }
 
     pa_core_rttime_restart(u->core, u->time_event, pa_rtclock_now() + u->adjust_time);
@@ -406,7 +521,9 @@ static int source_process_msg_cb(pa_msgobject *o, int code, void *data, int64_t
                 /* Add the latency internal to our source output on top */
                 pa_bytes_to_usec(pa_memblockq_get_length(u->source_output->thread_info.delay_memblockq), &u->source_output->source->sample_spec) +
                 /* and the buffering we do on the source */
-                pa_bytes_to_usec(u->blocksize, &u->source_output->source->sample_spec);
+                pa_bytes_to_usec(u->blocksize, &u->source_output->source->sample_spec) +
+                /* and the blocks still in the canceller thread */
+                (u->ec_worker ? pa_bytes_to_usec(u->ec_worker->n_queued * u->blocksize, &u->source_output->source->sample_spec) : 0);
 
             return 0;
 
@@ -420,7 +537,7 @@ static int source_process_msg_cb(pa_msgobject *o, int code, void *data, int64_t
 
 /* Called from sink I/O thread context */
 static int sink_process_msg_cb(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
-    struct userdata *u = PA_SINK(o)->userdata;
+    struct reference *r = PA_SINK(o)->userdata;
 
     switch (code) {
 
@@ -429,8 +546,8 @@ static int sink_process_msg_cb(pa_msgobject *o, int code, void *data, int64_t of
             /* The sink is _put() before the sink input is, so let's
              * make sure we don't access it in that time. Also, the
              * sink input is first shut down, the sink second. */
-            if (!PA_SINK_IS_LINKED(u->sink->thread_info.state) ||
-                !PA_SINK_INPUT_IS_LINKED(u->sink_input->thread_info.state)) {
+            if (!PA_SINK_IS_LINKED(r->sink->thread_info.state) ||
+                !PA_SINK_INPUT_IS_LINKED(r->sink_input->thread_info.state)) {
                 *((pa_usec_t*) data) = 0;
                 return 0;
             }
@@ -438,10 +555,10 @@ static int sink_process_msg_cb(pa_msgobject *o, int code, void *data, int64_t of
             *((pa_usec_t*) data) =
 
                 /* Get the latency of the master sink */
-                pa_sink_get_latency_within_thread(u->sink_input->sink) +
+                pa_sink_get_latency_within_thread(r->sink_input->sink) +
 
                 /* Add the latency internal to our sink input on top */
-                pa_bytes_to_usec(pa_memblockq_get_length(u->sink_input->thread_info.render_memblockq), &u->sink_input->sink->sample_spec);
+                pa_bytes_to_usec(pa_memblockq_get_length(r->sink_input->thread_info.render_memblockq), &r->sink_input->sink->sample_spec);
 
             return 0;
     }
@@ -463,7 +580,7 @@ static int source_set_state_cb(pa_source *s, pa_source_state_t state) {
 
     if (state == PA_SOURCE_RUNNING) {
         /* restart timer when both sink and source are active */
-        if (IS_ACTIVE(u) && u->adjust_time)
+        if (is_active(u) && u->adjust_time)
             pa_core_rttime_restart(u->core, u->time_event, pa_rtclock_now() + u->adjust_time);
 
         pa_atomic_store(&u->request_resync, 1);
@@ -477,24 +594,26 @@ static int source_set_state_cb(pa_source *s, pa_source_state_t state) {
 
 /* Called from main context */
 static int sink_set_state_cb(pa_sink *s, pa_sink_state_t state) {
+    struct reference *r;
     struct userdata *u;
 
     pa_sink_assert_ref(s);
-    pa_assert_se(u = s->userdata);
+    pa_assert_se(r = s->userdata);
+    u = r->userdata;
 
     if (!PA_SINK_IS_LINKED(state) ||
-        !PA_SINK_INPUT_IS_LINKED(pa_sink_input_get_state(u->sink_input)))
+        !PA_SINK_INPUT_IS_LINKED(pa_sink_input_get_state(r->sink_input)))
         return 0;
 
     if (state == PA_SINK_RUNNING) {
         /* restart timer when both sink and source are active */
-        if (IS_ACTIVE(u) && u->adjust_time)
+        if (is_active(u) && u->adjust_time)
             pa_core_rttime_restart(u->core, u->time_event, pa_rtclock_now() + u->adjust_time);
 
         pa_atomic_store(&u->request_resync, 1);
-        pa_sink_input_cork(u->sink_input, FALSE);
+        pa_sink_input_cork(r->sink_input, FALSE);
     } else if (state == PA_SINK_SUSPENDED) {
-        pa_sink_input_cork(u->sink_input, TRUE);
+        pa_sink_input_cork(r->sink_input, TRUE);
     }
 
     return 0;
@@ -521,38 +640,38 @@ static void source_update_requested_latency_cb(pa_source *s) {
 
 /* Called from sink I/O thread context */
 static void sink_update_requested_latency_cb(pa_sink *s) {
-    struct userdata *u;
+    struct reference *r;
 
     pa_sink_assert_ref(s);
-    pa_assert_se(u = s->userdata);
+    pa_assert_se(r = s->userdata);
 
-    if (!PA_SINK_IS_LINKED(u->sink->thread_info.state) ||
-        !PA_SINK_INPUT_IS_LINKED(u->sink_input->thread_info.state))
+    if (!PA_SINK_IS_LINKED(r->sink->thread_info.state) ||
+        !PA_SINK_INPUT_IS_LINKED(r->sink_input->thread_info.state))
         return;
 
     pa_log_debug("Sink update requested latency");
 
     /* Just hand this one over to the master sink */
     pa_sink_input_set_requested_latency_within_thread(
-            u->sink_input,
+            r->sink_input,
             pa_sink_get_requested_latency_within_thread(s));
 }
 
 /* Called from sink I/O thread context */
 static void sink_request_rewind_cb(pa_sink *s) {
-    struct userdata *u;
+    struct reference *r;
 
     pa_sink_assert_ref(s);
-    pa_assert_se(u = s->userdata);
+    pa_assert_se(r = s->userdata);
 
-    if (!PA_SINK_IS_LINKED(u->sink->thread_info.state) ||
-        !PA_SINK_INPUT_IS_LINKED(u->sink_input->thread_info.state))
+    if (!PA_SINK_IS_LINKED(r->sink->thread_info.state) ||
+        !PA_SINK_INPUT_IS_LINKED(r->sink_input->thread_info.state))
         return;
 
     pa_log_debug("Sink request rewind %lld", (long long) s->thread_info.rewind_nbytes);
 
     /* Just hand this one over to the master sink */
-    pa_sink_input_request_rewind(u->sink_input,
+    pa_sink_input_request_rewind(r->sink_input,
                                  s->thread_info.rewind_nbytes, TRUE, FALSE, FALSE);
 }
 
@@ -572,16 +691,16 @@ static void source_set_volume_cb(pa_source *s) {
 
 /* Called from main context */
 static void sink_set_volume_cb(pa_sink *s) {
-    struct userdata *u;
+    struct reference *r;
 
     pa_sink_assert_ref(s);
-    pa_assert_se(u = s->userdata);
+    pa_assert_se(r = s->userdata);
 
     if (!PA_SINK_IS_LINKED(pa_sink_get_state(s)) ||
-        !PA_SINK_INPUT_IS_LINKED(pa_sink_input_get_state(u->sink_input)))
+        !PA_SINK_INPUT_IS_LINKED(pa_sink_input_get_state(r->sink_input)))
         return;
 
-    pa_sink_input_set_volume(u->sink_input, &s->real_volume, s->save_volume, TRUE);
+    pa_sink_input_set_volume(r->sink_input, &s->real_volume, s->save_volume, TRUE);
 }
 
 /* Called from main context. */
@@ -622,16 +741,16 @@ static void source_set_mute_cb(pa_source *s) {
 
 /* Called from main context */
 static void sink_set_mute_cb(pa_sink *s) {
-    struct userdata *u;
+    struct reference *r;
 
     pa_sink_assert_ref(s);
-    pa_assert_se(u = s->userdata);
+    pa_assert_se(r = s->userdata);
 
     if (!PA_SINK_IS_LINKED(pa_sink_get_state(s)) ||
-        !PA_SINK_INPUT_IS_LINKED(pa_sink_input_get_state(u->sink_input)))
+        !PA_SINK_INPUT_IS_LINKED(pa_sink_input_get_state(r->sink_input)))
         return;
 
-    pa_sink_input_set_mute(u->sink_input, s->muted, s->save_muted);
+    pa_sink_input_set_mute(r->sink_input, s->muted, s->save_muted);
 }
 
 /* Called from main context */
@@ -649,7 +768,7 @@ static void source_get_mute_cb(pa_source *s) {
 }
 
 /* Called from source I/O thread context. */
-static void apply_diff_time(struct userdata *u, int64_t diff_time) {
+static void apply_diff_time(struct userdata *u, struct reference *r, int64_t diff_time) {
     int64_t diff;
 
     if (diff_time < 0) {
@@ -662,17 +781,25 @@ static void apply_diff_time(struct userdata *u, int64_t diff_time) {
 
             pa_log("Playback after capture (%lld), drop sink %lld", (long long) diff_time, (long long) diff);
 
-            u->sink_skip = diff;
-            u->source_skip = 0;
+            r->sink_skip = diff;
+            if (r == u->refs)
+                u->source_skip = 0;
         }
     } else if (diff_time > 0) {
         diff = pa_usec_to_bytes(diff_time, &u->source_output->sample_spec);
 
         if (diff > 0) {
+            /* The capture can only be held back for one of the references,
+             * the others have to live with it */
+            if (r != u->refs) {
+                pa_log("Playback of %s too far ahead (%lld)", r->sink->name, (long long) diff_time);
+                return;
+            }
+
             pa_log("Playback too far ahead (%lld), drop source %lld", (long long) diff_time, (long long) diff);
 
             u->source_skip = diff;
-            u->sink_skip = 0;
+            r->sink_skip = 0;
         }
     }
 }
@@ -680,19 +807,25 @@ static void apply_diff_time(struct userdata *u, int64_t diff_time) {
 /* Called from source I/O thread context. */
 static void do_resync(struct userdata *u) {
     int64_t diff_time;
-    struct snapshot latency_snapshot;
+    struct snapshot latency_snapshots[MAX_REFERENCES];
+    unsigned k;
 
     pa_log("Doing resync");
 
-    /* update our snapshot */
-    source_output_snapshot_within_thread(u, &latency_snapshot);
-    pa_asyncmsgq_send(u->sink_input->sink->asyncmsgq, PA_MSGOBJECT(u->sink_input), SINK_INPUT_MESSAGE_LATENCY_SNAPSHOT, &latency_snapshot, 0, NULL);
+    /* update our snapshots */
+    source_output_snapshot_within_thread(u, latency_snapshots);
+
+    for (k = 0; k < u->n_refs; k++) {
+        struct reference *r = &u->refs[k];
+
+        pa_asyncmsgq_send(r->sink_input->sink->asyncmsgq, PA_MSGOBJECT(r->sink_input), SINK_INPUT_MESSAGE_LATENCY_SNAPSHOT, &latency_snapshots[k], 0, NULL);
 
-    /* calculate drift between capture and playback */
-    diff_time = calc_diff(u, &latency_snapshot);
+        /* calculate drift between capture and playback */
+        diff_time = calc_diff(u, &latency_snapshots[k]);
 
-    /* and adjust for the drift */
-    apply_diff_time(u, diff_time);
+        /* and adjust for the drift */
+        apply_diff_time(u, r, diff_time);
+    }
 }
 
 /* 1. Calculate drift at this point, pass to canceller
@@ -709,9 +842,10 @@ static void do_push_drift_comp(struct userdata *u) {
     uint8_t *rdata, *pdata, *cdata;
     float drift;
     int unused PA_GCC_UNUSED;
+    struct reference *r = &u->refs[0];
 
     rlen = pa_memblockq_get_length(u->source_memblockq);
-    plen = pa_memblockq_get_length(u->sink_memblockq);
+    plen = pa_memblockq_get_length(r->sink_memblockq);
 
     /* Estimate snapshot drift as follows:
      *   pd: amount of data consumed since last time
@@ -723,8 +857,8 @@ static void do_push_drift_comp(struct userdata *u) {
      * samples left from the last iteration (to avoid double counting
      * those remainder samples.
      */
-    drift = ((float)(plen - u->sink_rem) - (rlen - u->source_rem)) / ((float)(rlen - u->source_rem));
-    u->sink_rem = plen % u->blocksize;
+    drift = ((float)(plen - r->sink_rem) - (rlen - u->source_rem)) / ((float)(rlen - u->source_rem));
+    r->sink_rem = plen % u->blocksize;
     u->source_rem = rlen % u->blocksize;
 
     /* Now let the canceller work its drift compensation magic */
@@ -737,7 +871,7 @@ static void do_push_drift_comp(struct userdata *u) {
 
     /* Send in the playback samples first */
     while (plen >= u->blocksize) {
-        pa_memblockq_peek_fixed_size(u->sink_memblockq, u->blocksize, &pchunk);
+        pa_memblockq_peek_fixed_size(r->sink_memblockq, u->blocksize, &pchunk);
         pdata = pa_memblock_acquire(pchunk.memblock);
         pdata += pchunk.index;
 
@@ -751,7 +885,7 @@ static void do_push_drift_comp(struct userdata *u) {
         }
 
         pa_memblock_release(pchunk.memblock);
-        pa_memblockq_drop(u->sink_memblockq, u->blocksize);
+        pa_memblockq_drop(r->sink_memblockq, u->blocksize);
         pa_memblock_unref(pchunk.memblock);
 
         plen -= u->blocksize;
@@ -793,47 +927,289 @@ static void do_push_drift_comp(struct userdata *u) {
     }
 }
 
+/* Called from source I/O thread context. */
+static void account_run_time(struct userdata *u, pa_usec_t run_time) {
+    u->run_time_sum += run_time;
+    u->run_time_max = PA_MAX(u->run_time_max, run_time);
+    u->n_runs++;
+}
+
+/* Called from the canceller thread. */
+static void ec_job_run(struct userdata *u, struct ec_job *job) {
+    uint8_t *rdata, *pdata, *cdata;
+    pa_usec_t start;
+
+    if (!job->play.memblock) {
+        /* Nothing to cancel against, but the block needs to stay in order */
+        job->out = job->rec;
+        pa_memblock_ref(job->out.memblock);
+        job->run_time = 0;
+        return;
+    }
+
+    rdata = pa_memblock_acquire(job->rec.memblock);
+    rdata += job->rec.index;
+    pdata = pa_memblock_acquire(job->play.memblock);
+    pdata += job->play.index;
+
+    job->out.index = 0;
+    job->out.length = u->blocksize;
+    job->out.memblock = pa_memblock_new(u->core->mempool, job->out.length);
+    cdata = pa_memblock_acquire(job->out.memblock);
+
+    start = pa_rtclock_now();
+    u->ec->run(u->ec, rdata, pdata, cdata);
+    job->run_time = pa_rtclock_now() - start;
+
+    pa_memblock_release(job->out.memblock);
+    pa_memblock_release(job->play.memblock);
+    pa_memblock_release(job->rec.memblock);
+}
+
+static void ec_worker_thread_func(void *userdata) {
+    struct userdata *u = userdata;
+    struct ec_worker *w = u->ec_worker;
+
+    pa_core_setup_io_thread(u->core, w->rtprio, w->cpus);
+
+    for (;;) {
+        struct ec_job *job;
+        pa_memchunk out;
+
+        pa_semaphore_wait(w->sem);
+
+        if (w->quit)
+            break;
+
+        job = w->current = &w->jobs[w->read_idx];
+        w->read_idx = (w->read_idx + 1) % EC_QUEUE_MAX;
+
+        ec_job_run(u, job);
+
+        pa_memblock_unref(job->rec.memblock);
+        pa_memchunk_reset(&job->rec);
+
+        if (job->play.memblock) {
+            pa_memblock_unref(job->play.memblock);
+            pa_memchunk_reset(&job->play);
+        }
+
+        /* The source I/O thread may reuse the job as soon as it got the
+         * message, so don't touch it after posting */
+        out = job->out;
+        pa_memchunk_reset(&job->out);
+        w->current = NULL;
+
+        pa_asyncmsgq_post(u->asyncmsgq, PA_MSGOBJECT(u->source_output), SOURCE_OUTPUT_MESSAGE_CANCELED, job, 0, &out, NULL);
+        pa_memblock_unref(out.memblock);
+    }
+}
+
+/* Called from main context. */
+static int ec_worker_start(struct userdata *u, int rtprio, const char *cpus) {
+    struct ec_worker *w;
+
+    w = u->ec_worker = pa_xnew0(struct ec_worker, 1);
+    w->rtprio = rtprio;
+    w->cpus = pa_xstrdup(cpus);
+    w->sem = pa_semaphore_new(0);
+
+    if (!(w->thread = pa_thread_new("echo-cancel", ec_worker_thread_func, u))) {
+        pa_log("Failed to create canceller thread.");
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Called from main context. */
+static void ec_worker_free(struct ec_worker *w) {
+    unsigned i;
+
+    pa_assert(w);
+
+    if (w->thread) {
+        w->quit = TRUE;
+        pa_semaphore_post(w->sem);
+        pa_thread_free(w->thread);
+    }
+
+    /* Jobs left over when we quit */
+    for (i = 0; i < EC_QUEUE_MAX; i++) {
+        if (w->jobs[i].rec.memblock)
+            pa_memblock_unref(w->jobs[i].rec.memblock);
+        if (w->jobs[i].play.memblock)
+            pa_memblock_unref(w->jobs[i].play.memblock);
+    }
+
+    pa_semaphore_free(w->sem);
+    pa_xfree(w->cpus);
+    pa_xfree(w);
+}
+
+/* Takes over the references of rchunk and pchunk, which may be NULL.
+ *
+ * Called from source I/O thread context. */
+static void ec_worker_submit(struct userdata *u, const pa_memchunk *rchunk, const pa_memchunk *pchunk) {
+    struct ec_worker *w = u->ec_worker;
+    struct ec_job *job;
+
+    pa_assert(w->n_queued < EC_QUEUE_MAX);
+
+    job = &w->jobs[w->write_idx];
+    w->write_idx = (w->write_idx + 1) % EC_QUEUE_MAX;
+    w->n_queued++;
+
+    job->rec = *rchunk;
+    if (pchunk)
+        job->play = *pchunk;
+    else
+        pa_memchunk_reset(&job->play);
+
+    job->volume = u->thread_info.current_volume;
+    job->volume_changed = FALSE;
+
+    pa_semaphore_post(w->sem);
+}
+
+/* Called from source I/O thread context. */
+static void ec_worker_drain(struct userdata *u) {
+    while (u->ec_worker->n_queued > 0)
+        pa_asyncmsgq_wait_for(u->asyncmsgq, SOURCE_OUTPUT_MESSAGE_CANCELED);
+}
+
+/* Takes the next block of playback data off the references. A single
+ * reference is passed on as is. With several of them, the blocks are
+ * stacked frame by frame if the canceller can take them that way and mixed
+ * otherwise, with silence for the references that have run short. Returns
+ * FALSE if there is no playback data at all.
+ *
+ * Called from source I/O thread context. */
+static pa_bool_t take_play_block(struct userdata *u, pa_memchunk *pchunk) {
+    const pa_sample_spec *ss = &u->refs[0].sink->sample_spec;
+    pa_mix_info info[MAX_REFERENCES];
+    unsigned k, n = 0;
+    uint8_t *pdata;
+
+    if (u->n_refs == 1) {
+        struct reference *r = &u->refs[0];
+
+        if (pa_memblockq_get_length(r->sink_memblockq) < u->blocksize)
+            return FALSE;
+
+        pa_memblockq_peek_fixed_size(r->sink_memblockq, u->blocksize, pchunk);
+        pa_memblockq_drop(r->sink_memblockq, u->blocksize);
+        return TRUE;
+    }
+
+    for (k = 0; k < u->n_refs; k++) {
+        struct reference *r = &u->refs[k];
+
+        if (pa_memblockq_get_length(r->sink_memblockq) < u->blocksize)
+            continue;
+
+        pa_memblockq_peek_fixed_size(r->sink_memblockq, u->blocksize, &info[n].chunk);
+        pa_memblockq_drop(r->sink_memblockq, u->blocksize);
+        pa_cvolume_reset(&info[n].volume, ss->channels);
+        info[n].userdata = PA_UINT_TO_PTR(k);
+        n++;
+    }
+
+    if (n == 0)
+        return FALSE;
+
+    pchunk->index = 0;
+    pchunk->length = u->ec->params.n_references > 1 ? u->blocksize * u->n_refs : u->blocksize;
+    pchunk->memblock = pa_memblock_new(u->source->core->mempool, pchunk->length);
+    pdata = pa_memblock_acquire(pchunk->memblock);
+
+    if (u->ec->params.n_references > 1) {
+        size_t fs = pa_frame_size(ss), n_frames = u->blocksize / fs, f;
+
+        if (n < u->n_refs)
+            pa_silence_memory(pdata, pchunk->length, ss);
+
+        for (k = 0; k < n; k++) {
+            const uint8_t *src = (uint8_t*) pa_memblock_acquire(info[k].chunk.memblock) + info[k].chunk.index;
+            uint8_t *dst = pdata + PA_PTR_TO_UINT(info[k].userdata) * fs;
+
+            for (f = 0; f < n_frames; f++, src += fs, dst += fs * u->n_refs)
+                memcpy(dst, src, fs);
+
+            pa_memblock_release(info[k].chunk.memblock);
+        }
+    } else
+        pa_mix(info, n, pdata, u->blocksize, ss, NULL, FALSE);
+
+    pa_memblock_release(pchunk->memblock);
+
+    for (k = 0; k < n; k++)
+        pa_memblock_unref(info[k].chunk.memblock);
+
+    return TRUE;
+}
+
 /* This one's simpler than the drift compensation case -- we just iterate over
  * the capture buffer, and pass the canceller blocksize bytes of playback and
  * capture data.
  *
  * Called from source I/O thread context. */
 static void do_push(struct userdata *u) {
-    size_t rlen, plen;
+    size_t rlen;
     pa_memchunk rchunk, pchunk, cchunk;
     uint8_t *rdata, *pdata, *cdata;
+    pa_usec_t start;
     int unused PA_GCC_UNUSED;
 
     rlen = pa_memblockq_get_length(u->source_memblockq);
-    plen = pa_memblockq_get_length(u->sink_memblockq);
 
     while (rlen >= u->blocksize) {
+
+        if (u->ec_worker && u->ec_worker->n_queued >= EC_QUEUE_MAX) {
+            /* the canceller thread is behind, keep the rest for later */
+            if (pa_log_ratelimit(PA_LOG_DEBUG))
+                pa_log_debug("Canceller queue full, %lu bytes waiting", (unsigned long) rlen);
+            break;
+        }
+
         /* take fixed block from recorded samples */
         pa_memblockq_peek_fixed_size(u->source_memblockq, u->blocksize, &rchunk);
 
-        if (plen >= u->blocksize) {
-            /* take fixed block from played samples */
-            pa_memblockq_peek_fixed_size(u->sink_memblockq, u->blocksize, &pchunk);
-
+        /* and the matching played samples */
+        if (take_play_block(u, &pchunk)) {
             rdata = pa_memblock_acquire(rchunk.memblock);
             rdata += rchunk.index;
             pdata = pa_memblock_acquire(pchunk.memblock);
             pdata += pchunk.index;
 
-            cchunk.index = 0;
-            cchunk.length = u->blocksize;
-            cchunk.memblock = pa_memblock_new(u->source->core->mempool, cchunk.length);
-            cdata = pa_memblock_acquire(cchunk.memblock);
-
             if (u->save_aec) {
                 if (u->captured_file)
                     unused = fwrite(rdata, 1, u->blocksize, u->captured_file);
                 if (u->played_file)
-                    unused = fwrite(pdata, 1, u->blocksize, u->played_file);
+                    unused = fwrite(pdata, 1, pchunk.length, u->played_file);
+            }
+
+            if (u->ec_worker) {
+                pa_memblock_release(pchunk.memblock);
+                pa_memblock_release(rchunk.memblock);
+
+                /* the canceled block is posted when it comes back */
+                ec_worker_submit(u, &rchunk, &pchunk);
+
+                pa_memblockq_drop(u->source_memblockq, u->blocksize);
+                rlen -= u->blocksize;
+                continue;
             }
 
+            cchunk.index = 0;
+            cchunk.length = u->blocksize;
+            cchunk.memblock = pa_memblock_new(u->source->core->mempool, cchunk.length);
+            cdata = pa_memblock_acquire(cchunk.memblock);
+
             /* perform echo cancellation */
+            start = pa_rtclock_now();
             u->ec->run(u->ec, rdata, pdata, cdata);
+            account_run_time(u, pa_rtclock_now() - start);
 
             if (u->save_aec) {
                 if (u->canceled_file)
@@ -844,8 +1220,6 @@ static void do_push(struct userdata *u) {
             pa_memblock_release(pchunk.memblock);
             pa_memblock_release(rchunk.memblock);
 
-            /* drop consumed sink samples */
-            pa_memblockq_drop(u->sink_memblockq, u->blocksize);
             pa_memblock_unref(pchunk.memblock);
 
             pa_memblock_unref(rchunk.memblock);
@@ -853,7 +1227,13 @@ static void do_push(struct userdata *u) {
              * source */
             rchunk = cchunk;
 
-            plen -= u->blocksize;
+        } else if (u->ec_worker) {
+            /* this one needs to wait for the blocks before it */
+            ec_worker_submit(u, &rchunk, NULL);
+
+            pa_memblockq_drop(u->source_memblockq, u->blocksize);
+            rlen -= u->blocksize;
+            continue;
         }
 
         /* forward the (echo-canceled) data to the virtual source */
@@ -865,11 +1245,23 @@ static void do_push(struct userdata *u) {
     }
 }
 
+/* Called from source I/O thread context. */
+static pa_bool_t any_sink_running_within_thread(struct userdata *u) {
+    unsigned k;
+
+    for (k = 0; k < u->n_refs; k++)
+        if (u->refs[k].sink->thread_info.state == PA_SINK_RUNNING)
+            return TRUE;
+
+    return FALSE;
+}
+
 /* Called from source I/O thread context. */
 static void source_output_push_cb(pa_source_output *o, const pa_memchunk *chunk) {
     struct userdata *u;
     size_t rlen, plen, to_skip;
     pa_memchunk rchunk;
+    unsigned k;
 
     pa_source_output_assert_ref(o);
     pa_source_output_assert_io_context(o);
@@ -881,7 +1273,10 @@ static void source_output_push_cb(pa_source_output *o, const pa_memchunk *chunk)
     }
 
     if (PA_UNLIKELY(u->source->thread_info.state != PA_SOURCE_RUNNING ||
-                    u->sink->thread_info.state != PA_SINK_RUNNING)) {
+                    !any_sink_running_within_thread(u))) {
+        if (u->ec_worker)
+            ec_worker_drain(u);
+
         pa_source_post(u->source, chunk);
         return;
     }
@@ -893,7 +1288,6 @@ static void source_output_push_cb(pa_source_output *o, const pa_memchunk *chunk)
     pa_memblockq_push_align(u->source_memblockq, chunk);
 
     rlen = pa_memblockq_get_length(u->source_memblockq);
-    plen = pa_memblockq_get_length(u->sink_memblockq);
 
     /* Let's not do anything else till we have enough data to process */
     if (rlen < u->blocksize)
@@ -915,6 +1309,10 @@ static void source_output_push_cb(pa_source_output *o, const pa_memchunk *chunk)
         to_skip -= to_skip % u->blocksize;
 
         if (to_skip) {
+            /* the skipped samples go out after the ones still being canceled */
+            if (u->ec_worker)
+                ec_worker_drain(u);
+
             pa_memblockq_peek_fixed_size(u->source_memblockq, to_skip, &rchunk);
             pa_source_post(u->source, &rchunk);
 
@@ -926,20 +1324,26 @@ static void source_output_push_cb(pa_source_output *o, const pa_memchunk *chunk)
         }
 
         if (rlen && u->source_skip % u->blocksize) {
-            u->sink_skip += u->blocksize - (u->source_skip % u->blocksize);
+            for (k = 0; k < u->n_refs; k++)
+                u->refs[k].sink_skip += u->blocksize - (u->source_skip % u->blocksize);
             u->source_skip -= (u->source_skip % u->blocksize);
         }
     }
 
     /* And for the sink, these samples have been played back already, so we can
      * just drop them and get on with it. */
-    if (PA_UNLIKELY(u->sink_skip)) {
-        to_skip = plen >= u->sink_skip ? u->sink_skip : plen;
+    for (k = 0; k < u->n_refs; k++) {
+        struct reference *r = &u->refs[k];
+
+        if (PA_LIKELY(!r->sink_skip))
+            continue;
+
+        plen = pa_memblockq_get_length(r->sink_memblockq);
+        to_skip = plen >= r->sink_skip ? r->sink_skip : plen;
 
-        pa_memblockq_drop(u->sink_memblockq, to_skip);
+        pa_memblockq_drop(r->sink_memblockq, to_skip);
 
-        plen -= to_skip;
-        u->sink_skip -= to_skip;
+        r->sink_skip -= to_skip;
     }
 
     /* process and push out samples */
@@ -951,16 +1355,18 @@ static void source_output_push_cb(pa_source_output *o, const pa_memchunk *chunk)
 
 /* Called from sink I/O thread context. */
 static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk) {
+    struct reference *r;
     struct userdata *u;
 
     pa_sink_input_assert_ref(i);
     pa_assert(chunk);
-    pa_assert_se(u = i->userdata);
+    pa_assert_se(r = i->userdata);
+    u = r->userdata;
 
-    if (u->sink->thread_info.rewind_requested)
-        pa_sink_process_rewind(u->sink, 0);
+    if (r->sink->thread_info.rewind_requested)
+        pa_sink_process_rewind(r->sink, 0);
 
-    pa_sink_render_full(u->sink, nbytes, chunk);
+    pa_sink_render_full(r->sink, nbytes, chunk);
 
     if (i->thread_info.underrun_for > 0) {
         pa_log_debug("Handling end of underrun.");
@@ -970,8 +1376,8 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
     /* let source thread handle the chunk. pass the sample count as well so that
      * the source IO thread can update the right variables. */
     pa_asyncmsgq_post(u->asyncmsgq, PA_MSGOBJECT(u->source_output), SOURCE_OUTPUT_MESSAGE_POST,
-        NULL, 0, chunk, NULL);
-    u->send_counter += chunk->length;
+        r, 0, chunk, NULL);
+    r->send_counter += chunk->length;
 
     return 0;
 }
@@ -979,6 +1385,7 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
 /* Called from source I/O thread context. */
 static void source_output_process_rewind_cb(pa_source_output *o, size_t nbytes) {
     struct userdata *u;
+    unsigned k;
 
     pa_source_output_assert_ref(o);
     pa_source_output_assert_io_context(o);
@@ -987,7 +1394,8 @@ static void source_output_process_rewind_cb(pa_source_output *o, size_t nbytes)
     pa_source_process_rewind(u->source, nbytes);
 
     /* go back on read side, we need to use older sink data for this */
-    pa_memblockq_rewind(u->sink_memblockq, nbytes);
+    for (k = 0; k < u->n_refs; k++)
+        pa_memblockq_rewind(u->refs[k].sink_memblockq, nbytes);
 
     /* manipulate write index */
     pa_memblockq_seek(u->source_memblockq, -nbytes, PA_SEEK_RELATIVE, TRUE);
@@ -998,23 +1406,27 @@ static void source_output_process_rewind_cb(pa_source_output *o, size_t nbytes)
 
 /* Called from sink I/O thread context. */
 static void sink_input_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
+    struct reference *r;
     struct userdata *u;
 
     pa_sink_input_assert_ref(i);
-    pa_assert_se(u = i->userdata);
+    pa_assert_se(r = i->userdata);
+    u = r->userdata;
 
     pa_log_debug("Sink process rewind %lld", (long long) nbytes);
 
-    pa_sink_process_rewind(u->sink, nbytes);
+    pa_sink_process_rewind(r->sink, nbytes);
 
-    pa_asyncmsgq_post(u->asyncmsgq, PA_MSGOBJECT(u->source_output), SOURCE_OUTPUT_MESSAGE_REWIND, NULL, (int64_t) nbytes, NULL, NULL);
-    u->send_counter -= nbytes;
+    pa_asyncmsgq_post(u->asyncmsgq, PA_MSGOBJECT(u->source_output), SOURCE_OUTPUT_MESSAGE_REWIND, r, (int64_t) nbytes, NULL, NULL);
+    r->send_counter -= nbytes;
 }
 
-/* Called from source I/O thread context. */
-static void source_output_snapshot_within_thread(struct userdata *u, struct snapshot *snapshot) {
+/* Called from source I/O thread context. Fills in one snapshot per
+ * reference. */
+static void source_output_snapshot_within_thread(struct userdata *u, struct snapshot *snapshots) {
     size_t delay, rlen, plen;
     pa_usec_t now, latency;
+    unsigned k;
 
     now = pa_rtclock_now();
     latency = pa_source_get_latency_within_thread(u->source_output->source);
@@ -1022,14 +1434,20 @@ static void source_output_snapshot_within_thread(struct userdata *u, struct snap
 
     delay = (u->source_output->thread_info.resampler ? pa_resampler_request(u->source_output->thread_info.resampler, delay) : delay);
     rlen = pa_memblockq_get_length(u->source_memblockq);
-    plen = pa_memblockq_get_length(u->sink_memblockq);
 
-    snapshot->source_now = now;
-    snapshot->source_latency = latency;
-    snapshot->source_delay = delay;
-    snapshot->recv_counter = u->recv_counter;
-    snapshot->rlen = rlen + u->sink_skip;
-    snapshot->plen = plen + u->source_skip;
+    for (k = 0; k < u->n_refs; k++) {
+        struct reference *r = &u->refs[k];
+        struct snapshot *snapshot = &snapshots[k];
+
+        plen = pa_memblockq_get_length(r->sink_memblockq);
+
+        snapshot->source_now = now;
+        snapshot->source_latency = latency;
+        snapshot->source_delay = delay;
+        snapshot->recv_counter = r->recv_counter;
+        snapshot->rlen = rlen + r->sink_skip;
+        snapshot->plen = plen + u->source_skip;
+    }
 }
 
 /* Called from source I/O thread context. */
@@ -1038,45 +1456,86 @@ static int source_output_process_msg_cb(pa_msgobject *obj, int code, void *data,
 
     switch (code) {
 
-        case SOURCE_OUTPUT_MESSAGE_POST:
+        case SOURCE_OUTPUT_MESSAGE_POST: {
+            struct reference *r = (struct reference *) data;
 
             pa_source_output_assert_io_context(u->source_output);
 
             if (u->source_output->source->thread_info.state == PA_SOURCE_RUNNING)
-                pa_memblockq_push_align(u->sink_memblockq, chunk);
+                pa_memblockq_push_align(r->sink_memblockq, chunk);
             else
-                pa_memblockq_flush_write(u->sink_memblockq, TRUE);
+                pa_memblockq_flush_write(r->sink_memblockq, TRUE);
 
-            u->recv_counter += (int64_t) chunk->length;
+            r->recv_counter += (int64_t) chunk->length;
 
             return 0;
+        }
+
+        case SOURCE_OUTPUT_MESSAGE_REWIND: {
+            struct reference *r = (struct reference *) data;
 
-        case SOURCE_OUTPUT_MESSAGE_REWIND:
             pa_source_output_assert_io_context(u->source_output);
 
             /* manipulate write index, never go past what we have */
             if (PA_SOURCE_IS_OPENED(u->source_output->source->thread_info.state))
-                pa_memblockq_seek(u->sink_memblockq, -offset, PA_SEEK_RELATIVE, TRUE);
+                pa_memblockq_seek(r->sink_memblockq, -offset, PA_SEEK_RELATIVE, TRUE);
             else
-                pa_memblockq_flush_write(u->sink_memblockq, TRUE);
+                pa_memblockq_flush_write(r->sink_memblockq, TRUE);
 
             pa_log_debug("Sink rewind (%lld)", (long long) offset);
 
-            u->recv_counter -= offset;
+            r->recv_counter -= offset;
 
             return 0;
+        }
 
         case SOURCE_OUTPUT_MESSAGE_LATENCY_SNAPSHOT: {
             struct snapshot *snapshot = (struct snapshot *) data;
 
             source_output_snapshot_within_thread(u, snapshot);
+
+            snapshot->run_time_sum = u->run_time_sum;
+            snapshot->run_time_max = u->run_time_max;
+            snapshot->n_runs = u->n_runs;
+            snapshot->n_queued = u->ec_worker ? u->ec_worker->n_queued : 0;
+
+            u->run_time_sum = u->run_time_max = 0;
+            u->n_runs = 0;
             return 0;
         }
 
         case SOURCE_OUTPUT_MESSAGE_APPLY_DIFF_TIME:
-            apply_diff_time(u, offset);
+            apply_diff_time(u, (struct reference *) data, offset);
             return 0;
 
+        case SOURCE_OUTPUT_MESSAGE_CANCELED: {
+            struct ec_job *job = (struct ec_job *) data;
+            int unused PA_GCC_UNUSED;
+
+            pa_source_output_assert_io_context(u->source_output);
+            pa_assert(u->ec_worker->n_queued > 0);
+
+            /* Blocks that went through without playback data took no time */
+            if (job->run_time > 0) {
+                account_run_time(u, job->run_time);
+
+                if (u->save_aec && u->canceled_file) {
+                    unused = fwrite((uint8_t*) pa_memblock_acquire(chunk->memblock) + chunk->index, 1, chunk->length, u->canceled_file);
+                    pa_memblock_release(chunk->memblock);
+                }
+            }
+
+            if (job->volume_changed)
+                post_capture_volume(u, &job->volume);
+
+            u->ec_worker->n_queued--;
+
+            if (PA_SOURCE_IS_OPENED(u->source->thread_info.state))
+                pa_source_post(u->source, chunk);
+
+            return 0;
+        }
+
     }
 
     return pa_source_output_process_msg(obj, code, data, offset, chunk);
@@ -1084,7 +1543,7 @@ static int source_output_process_msg_cb(pa_msgobject *obj, int code, void *data,
 
 /* Called from sink I/O thread context. */
 static int sink_input_process_msg_cb(pa_msgobject *obj, int code, void *data, int64_t offset, pa_memchunk *chunk) {
-    struct userdata *u = PA_SINK_INPUT(obj)->userdata;
+    struct reference *r = PA_SINK_INPUT(obj)->userdata;
 
     switch (code) {
 
@@ -1093,18 +1552,18 @@ static int sink_input_process_msg_cb(pa_msgobject *obj, int code, void *data, in
             pa_usec_t now, latency;
             struct snapshot *snapshot = (struct snapshot *) data;
 
-            pa_sink_input_assert_io_context(u->sink_input);
+            pa_sink_input_assert_io_context(r->sink_input);
 
             now = pa_rtclock_now();
-            latency = pa_sink_get_latency_within_thread(u->sink_input->sink);
-            delay = pa_memblockq_get_length(u->sink_input->thread_info.render_memblockq);
+            latency = pa_sink_get_latency_within_thread(r->sink_input->sink);
+            delay = pa_memblockq_get_length(r->sink_input->thread_info.render_memblockq);
 
-            delay = (u->sink_input->thread_info.resampler ? pa_resampler_request(u->sink_input->thread_info.resampler, delay) : delay);
+            delay = (r->sink_input->thread_info.resampler ? pa_resampler_request(r->sink_input->thread_info.resampler, delay) : delay);
 
             snapshot->sink_now = now;
             snapshot->sink_latency = latency;
             snapshot->sink_delay = delay;
-            snapshot->send_counter = u->send_counter;
+            snapshot->send_counter = r->send_counter;
             return 0;
         }
     }
@@ -1114,15 +1573,15 @@ static int sink_input_process_msg_cb(pa_msgobject *obj, int code, void *data, in
 
 /* Called from sink I/O thread context. */
 static void sink_input_update_max_rewind_cb(pa_sink_input *i, size_t nbytes) {
-    struct userdata *u;
+    struct reference *r;
 
     pa_sink_input_assert_ref(i);
-    pa_assert_se(u = i->userdata);
+    pa_assert_se(r = i->userdata);
 
     pa_log_debug("Sink input update max rewind %lld", (long long) nbytes);
 
-    pa_memblockq_set_maxrewind(u->sink_memblockq, nbytes);
-    pa_sink_set_max_rewind_within_thread(u->sink, nbytes);
+    pa_memblockq_set_maxrewind(r->sink_memblockq, nbytes);
+    pa_sink_set_max_rewind_within_thread(r->sink, nbytes);
 }
 
 /* Called from source I/O thread context. */
@@ -1139,23 +1598,23 @@ static void source_output_update_max_rewind_cb(pa_source_output *o, size_t nbyte
 
 /* Called from sink I/O thread context. */
 static void sink_input_update_max_request_cb(pa_sink_input *i, size_t nbytes) {
-    struct userdata *u;
+    struct reference *r;
 
     pa_sink_input_assert_ref(i);
-    pa_assert_se(u = i->userdata);
+    pa_assert_se(r = i->userdata);
 
     pa_log_debug("Sink input update max request %lld", (long long) nbytes);
 
-    pa_sink_set_max_request_within_thread(u->sink, nbytes);
+    pa_sink_set_max_request_within_thread(r->sink, nbytes);
 }
 
 /* Called from sink I/O thread context. */
 static void sink_input_update_sink_requested_latency_cb(pa_sink_input *i) {
-    struct userdata *u;
+    struct reference *r;
     pa_usec_t latency;
 
     pa_sink_input_assert_ref(i);
-    pa_assert_se(u = i->userdata);
+    pa_assert_se(r = i->userdata);
 
     latency = pa_sink_get_requested_latency_within_thread(i->sink);
 
@@ -1177,16 +1636,16 @@ static void source_output_update_source_requested_latency_cb(pa_source_output *o
 
 /* Called from sink I/O thread context. */
 static void sink_input_update_sink_latency_range_cb(pa_sink_input *i) {
-    struct userdata *u;
+    struct reference *r;
 
     pa_sink_input_assert_ref(i);
-    pa_assert_se(u = i->userdata);
+    pa_assert_se(r = i->userdata);
 
     pa_log_debug("Sink input update latency range %lld %lld",
         (long long) i->sink->thread_info.min_latency,
         (long long) i->sink->thread_info.max_latency);
 
-    pa_sink_set_latency_range_within_thread(u->sink, i->sink->thread_info.min_latency, i->sink->thread_info.max_latency);
+    pa_sink_set_latency_range_within_thread(r->sink, i->sink->thread_info.min_latency, i->sink->thread_info.max_latency);
 }
 
 /* Called from source I/O thread context. */
@@ -1205,15 +1664,15 @@ static void source_output_update_source_latency_range_cb(pa_source_output *o) {
 
 /* Called from sink I/O thread context. */
 static void sink_input_update_sink_fixed_latency_cb(pa_sink_input *i) {
-    struct userdata *u;
+    struct reference *r;
 
     pa_sink_input_assert_ref(i);
-    pa_assert_se(u = i->userdata);
+    pa_assert_se(r = i->userdata);
 
     pa_log_debug("Sink input update fixed latency %lld",
         (long long) i->sink->thread_info.fixed_latency);
 
-    pa_sink_set_fixed_latency_within_thread(u->sink, i->sink->thread_info.fixed_latency);
+    pa_sink_set_fixed_latency_within_thread(r->sink, i->sink->thread_info.fixed_latency);
 }
 
 /* Called from source I/O thread context. */
@@ -1254,32 +1713,34 @@ static void source_output_attach_cb(pa_source_output *o) {
 
 /* Called from sink I/O thread context. */
 static void sink_input_attach_cb(pa_sink_input *i) {
+    struct reference *r;
     struct userdata *u;
 
     pa_sink_input_assert_ref(i);
-    pa_assert_se(u = i->userdata);
+    pa_assert_se(r = i->userdata);
+    u = r->userdata;
 
-    pa_sink_set_rtpoll(u->sink, i->sink->thread_info.rtpoll);
-    pa_sink_set_latency_range_within_thread(u->sink, i->sink->thread_info.min_latency, i->sink->thread_info.max_latency);
+    pa_sink_set_rtpoll(r->sink, i->sink->thread_info.rtpoll);
+    pa_sink_set_latency_range_within_thread(r->sink, i->sink->thread_info.min_latency, i->sink->thread_info.max_latency);
 
     /* (8.1) IF YOU NEED A FIXED BLOCK SIZE ADD THE LATENCY FOR ONE
      * BLOCK MINUS ONE SAMPLE HERE. SEE (7) */
-    pa_sink_set_fixed_latency_within_thread(u->sink, i->sink->thread_info.fixed_latency);
+    pa_sink_set_fixed_latency_within_thread(r->sink, i->sink->thread_info.fixed_latency);
 
     /* (8.2) IF YOU NEED A FIXED BLOCK SIZE ROUND
      * pa_sink_input_get_max_request(i) UP TO MULTIPLES OF IT
      * HERE. SEE (6) */
-    pa_sink_set_max_request_within_thread(u->sink, pa_sink_input_get_max_request(i));
-    pa_sink_set_max_rewind_within_thread(u->sink, pa_sink_input_get_max_rewind(i));
+    pa_sink_set_max_request_within_thread(r->sink, pa_sink_input_get_max_request(i));
+    pa_sink_set_max_rewind_within_thread(r->sink, pa_sink_input_get_max_rewind(i));
 
     pa_log_debug("Sink input %d attach", i->index);
 
-    u->rtpoll_item_write = pa_rtpoll_item_new_asyncmsgq_write(
+    r->rtpoll_item_write = pa_rtpoll_item_new_asyncmsgq_write(
             i->sink->thread_info.rtpoll,
             PA_RTPOLL_LATE,
             u->asyncmsgq);
 
-    pa_sink_attach_within_thread(u->sink);
+    pa_sink_attach_within_thread(r->sink);
 }
 
 
@@ -1304,20 +1765,20 @@ static void source_output_detach_cb(pa_source_output *o) {
 
 /* Called from sink I/O thread context. */
 static void sink_input_detach_cb(pa_sink_input *i) {
-    struct userdata *u;
+    struct reference *r;
 
     pa_sink_input_assert_ref(i);
-    pa_assert_se(u = i->userdata);
+    pa_assert_se(r = i->userdata);
 
-    pa_sink_detach_within_thread(u->sink);
+    pa_sink_detach_within_thread(r->sink);
 
-    pa_sink_set_rtpoll(u->sink, NULL);
+    pa_sink_set_rtpoll(r->sink, NULL);
 
     pa_log_debug("Sink input %d detach", i->index);
 
-    if (u->rtpoll_item_write) {
-        pa_rtpoll_item_free(u->rtpoll_item_write);
-        u->rtpoll_item_write = NULL;
+    if (r->rtpoll_item_write) {
+        pa_rtpoll_item_free(r->rtpoll_item_write);
+        r->rtpoll_item_write = NULL;
     }
 }
 
@@ -1334,10 +1795,10 @@ static void source_output_state_change_cb(pa_source_output *o, pa_source_output_
 
 /* Called from sink I/O thread context. */
 static void sink_input_state_change_cb(pa_sink_input *i, pa_sink_input_state_t state) {
-    struct userdata *u;
+    struct reference *r;
 
     pa_sink_input_assert_ref(i);
-    pa_assert_se(u = i->userdata);
+    pa_assert_se(r = i->userdata);
 
     pa_log_debug("Sink input %d state %d", i->index, state);
 
@@ -1379,24 +1840,26 @@ static void source_output_kill_cb(pa_source_output *o) {
 
 /* Called from main context */
 static void sink_input_kill_cb(pa_sink_input *i) {
+    struct reference *r;
     struct userdata *u;
 
     pa_sink_input_assert_ref(i);
-    pa_assert_se(u = i->userdata);
+    pa_assert_se(r = i->userdata);
+    u = r->userdata;
 
     u->dead = TRUE;
 
     /* The order here matters! We first kill the sink input, followed
      * by the sink. That means the sink callbacks must be protected
      * against an unconnected sink input! */
-    pa_sink_input_unlink(u->sink_input);
-    pa_sink_unlink(u->sink);
+    pa_sink_input_unlink(r->sink_input);
+    pa_sink_unlink(r->sink);
 
-    pa_sink_input_unref(u->sink_input);
-    u->sink_input = NULL;
+    pa_sink_input_unref(r->sink_input);
+    r->sink_input = NULL;
 
-    pa_sink_unref(u->sink);
-    u->sink = NULL;
+    pa_sink_unref(r->sink);
+    r->sink = NULL;
 
     pa_log_debug("Sink input kill %d", i->index);
 
@@ -1406,6 +1869,7 @@ static void sink_input_kill_cb(pa_sink_input *i) {
 /* Called from main context. */
 static pa_bool_t source_output_may_move_to_cb(pa_source_output *o, pa_source *dest) {
     struct userdata *u;
+    unsigned k;
 
     pa_source_output_assert_ref(o);
     pa_assert_ctl_context();
@@ -1414,20 +1878,35 @@ static pa_bool_t source_output_may_move_to_cb(pa_source_output *o, pa_source *de
     if (u->dead || u->autoloaded)
         return FALSE;
 
-    return (u->source != dest) && (u->sink != dest->monitor_of);
+    if (u->source == dest)
+        return FALSE;
+
+    for (k = 0; k < u->n_refs; k++)
+        if (u->refs[k].sink == dest->monitor_of)
+            return FALSE;
+
+    return TRUE;
 }
 
 /* Called from main context */
 static pa_bool_t sink_input_may_move_to_cb(pa_sink_input *i, pa_sink *dest) {
+    struct reference *r;
     struct userdata *u;
+    unsigned k;
 
     pa_sink_input_assert_ref(i);
-    pa_assert_se(u = i->userdata);
+    pa_assert_se(r = i->userdata);
+    u = r->userdata;
 
     if (u->dead || u->autoloaded)
         return FALSE;
 
-    return u->sink != dest;
+    /* None of our own sinks can be the master of another one */
+    for (k = 0; k < u->n_refs; k++)
+        if (u->refs[k].sink == dest)
+            return FALSE;
+
+    return TRUE;
 }
 
 /* Called from main context. */
@@ -1449,10 +1928,10 @@ static void source_output_moving_cb(pa_source_output *o, pa_source *dest) {
         pa_proplist *pl;
 
         pl = pa_proplist_new();
-        y = pa_proplist_gets(u->sink_input->sink->proplist, PA_PROP_DEVICE_DESCRIPTION);
+        y = pa_proplist_gets(u->refs[0].sink_input->sink->proplist, PA_PROP_DEVICE_DESCRIPTION);
         z = pa_proplist_gets(dest->proplist, PA_PROP_DEVICE_DESCRIPTION);
         pa_proplist_setf(pl, PA_PROP_DEVICE_DESCRIPTION, "%s (echo cancelled with %s)", z ? z : dest->name,
-                y ? y : u->sink_input->sink->name);
+                y ? y : u->refs[0].sink_input->sink->name);
 
         pa_source_update_proplist(u->source, PA_UPDATE_REPLACE, pl);
         pa_proplist_free(pl);
@@ -1461,18 +1940,20 @@ static void source_output_moving_cb(pa_source_output *o, pa_source *dest) {
 
 /* Called from main context */
 static void sink_input_moving_cb(pa_sink_input *i, pa_sink *dest) {
+    struct reference *r;
     struct userdata *u;
 
     pa_sink_input_assert_ref(i);
-    pa_assert_se(u = i->userdata);
+    pa_assert_se(r = i->userdata);
+    u = r->userdata;
 
     if (dest) {
-        pa_sink_set_asyncmsgq(u->sink, dest->asyncmsgq);
-        pa_sink_update_flags(u->sink, PA_SINK_LATENCY|PA_SINK_DYNAMIC_LATENCY, dest->flags);
+        pa_sink_set_asyncmsgq(r->sink, dest->asyncmsgq);
+        pa_sink_update_flags(r->sink, PA_SINK_LATENCY|PA_SINK_DYNAMIC_LATENCY, dest->flags);
     } else
-        pa_sink_set_asyncmsgq(u->sink, NULL);
+        pa_sink_set_asyncmsgq(r->sink, NULL);
 
-    if (u->sink_auto_desc && dest) {
+    if (r->sink_auto_desc && dest) {
         const char *y, *z;
         pa_proplist *pl;
 
@@ -1482,29 +1963,29 @@ static void sink_input_moving_cb(pa_sink_input *i, pa_sink *dest) {
         pa_proplist_setf(pl, PA_PROP_DEVICE_DESCRIPTION, "%s (echo cancelled with %s)", z ? z : dest->name,
                          y ? y : u->source_output->source->name);
 
-        pa_sink_update_proplist(u->sink, PA_UPDATE_REPLACE, pl);
+        pa_sink_update_proplist(r->sink, PA_UPDATE_REPLACE, pl);
         pa_proplist_free(pl);
     }
 }
 
 /* Called from main context */
 static void sink_input_volume_changed_cb(pa_sink_input *i) {
-    struct userdata *u;
+    struct reference *r;
 
     pa_sink_input_assert_ref(i);
-    pa_assert_se(u = i->userdata);
+    pa_assert_se(r = i->userdata);
 
-    pa_sink_volume_changed(u->sink, &i->volume);
+    pa_sink_volume_changed(r->sink, &i->volume);
 }
 
 /* Called from main context */
 static void sink_input_mute_changed_cb(pa_sink_input *i) {
-    struct userdata *u;
+    struct reference *r;
 
     pa_sink_input_assert_ref(i);
-    pa_assert_se(u = i->userdata);
+    pa_assert_se(r = i->userdata);
 
-    pa_sink_mute_changed(u->sink, i->muted);
+    pa_sink_mute_changed(r->sink, i->muted);
 }
 
 /* Called from main context */
@@ -1537,19 +2018,35 @@ static int canceller_process_msg_cb(pa_msgobject *o, int code, void *userdata, i
     return 0;
 }
 
-/* Called by the canceller, so source I/O thread context. */
+/* Called from source I/O thread context. */
+static void post_capture_volume(struct userdata *u, pa_cvolume *v) {
+    if (!pa_cvolume_equal(&u->thread_info.current_volume, v))
+        pa_asyncmsgq_post_data(pa_thread_mq_get()->outq, PA_MSGOBJECT(u->ec->msg), ECHO_CANCELLER_MESSAGE_SET_VOLUME, v, sizeof(*v), 0, NULL,
+                NULL);
+}
+
+/* Called by the canceller, so source I/O thread context, or the canceller
+ * thread with ec_thread=yes. */
 void pa_echo_canceller_get_capture_volume(pa_echo_canceller *ec, pa_cvolume *v) {
-    *v = ec->msg->userdata->thread_info.current_volume;
+    struct userdata *u = ec->msg->userdata;
+
+    if (u->ec_worker)
+        *v = u->ec_worker->current->volume;
+    else
+        *v = u->thread_info.current_volume;
 }
 
-/* Called by the canceller, so source I/O thread context. */
+/* Called by the canceller, so source I/O thread context, or the canceller
+ * thread with ec_thread=yes. In the latter case the new volume travels back
+ * with the block. */
 void pa_echo_canceller_set_capture_volume(pa_echo_canceller *ec, pa_cvolume *v) {
-    if (!pa_cvolume_equal(&ec->msg->userdata->thread_info.current_volume, v)) {
-        pa_cvolume *vol = pa_xnewdup(pa_cvolume, v, 1);
+    struct userdata *u = ec->msg->userdata;
 
-        pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(ec->msg), ECHO_CANCELLER_MESSAGE_SET_VOLUME, vol, 0, NULL,
-                pa_xfree);
-    }
+    if (u->ec_worker) {
+        u->ec_worker->current->volume = *v;
+        u->ec_worker->current->volume_changed = TRUE;
+    } else
+        post_capture_volume(u, v);
 }
 
 static pa_echo_canceller_method_t get_ec_method_from_string(const char *method) {
@@ -1604,6 +2101,124 @@ fail:
     return -1;
 }
 
+/* Creates the sink and the sink input of one playback reference. The first
+ * one gets the sink_name= and sink_properties= arguments.
+ *
+ * Called from main context. */
+static int init_reference(struct userdata *u, struct reference *r, pa_modargs *ma, pa_sink *sink_master, pa_source *source_master,
+                          pa_sample_spec *sink_ss, pa_channel_map *sink_map) {
+    pa_module *m = u->module;
+    pa_bool_t primary = r == u->refs;
+    pa_sink_input_new_data sink_input_data;
+    pa_sink_new_data sink_data;
+    pa_memchunk silence;
+
+    r->userdata = u;
+
+    /* Create sink */
+    pa_sink_new_data_init(&sink_data);
+    sink_data.driver = __FILE__;
+    sink_data.module = m;
+    if (!primary || !(sink_data.name = pa_xstrdup(pa_modargs_get_value(ma, "sink_name", NULL))))
+        sink_data.name = pa_sprintf_malloc("%s.echo-cancel", sink_master->name);
+    pa_sink_new_data_set_sample_spec(&sink_data, sink_ss);
+    pa_sink_new_data_set_channel_map(&sink_data, sink_map);
+    pa_proplist_sets(sink_data.proplist, PA_PROP_DEVICE_MASTER_DEVICE, sink_master->name);
+    pa_proplist_sets(sink_data.proplist, PA_PROP_DEVICE_CLASS, "filter");
+    if (!u->autoloaded)
+        pa_proplist_sets(sink_data.proplist, PA_PROP_DEVICE_INTENDED_ROLES, "phone");
+
+    if (primary && pa_modargs_get_proplist(ma, "sink_properties", sink_data.proplist, PA_UPDATE_REPLACE) < 0) {
+        pa_log("Invalid properties");
+        pa_sink_new_data_done(&sink_data);
+        return -1;
+    }
+
+    if ((r->sink_auto_desc = !pa_proplist_contains(sink_data.proplist, PA_PROP_DEVICE_DESCRIPTION))) {
+        const char *y, *z;
+
+        y = pa_proplist_gets(source_master->proplist, PA_PROP_DEVICE_DESCRIPTION);
+        z = pa_proplist_gets(sink_master->proplist, PA_PROP_DEVICE_DESCRIPTION);
+        pa_proplist_setf(sink_data.proplist, PA_PROP_DEVICE_DESCRIPTION, "%s (echo cancelled with %s)",
+                z ? z : sink_master->name, y ? y : source_master->name);
+    }
+
+    r->sink = pa_sink_new(m->core, &sink_data, (sink_master->flags & (PA_SINK_LATENCY | PA_SINK_DYNAMIC_LATENCY))
+                                               | (u->use_volume_sharing ? PA_SINK_SHARE_VOLUME_WITH_MASTER : 0));
+    pa_sink_new_data_done(&sink_data);
+
+    if (!r->sink) {
+        pa_log("Failed to create sink.");
+        return -1;
+    }
+
+    r->sink->parent.process_msg = sink_process_msg_cb;
+    r->sink->set_state = sink_set_state_cb;
+    r->sink->update_requested_latency = sink_update_requested_latency_cb;
+    r->sink->request_rewind = sink_request_rewind_cb;
+    pa_sink_set_set_mute_callback(r->sink, sink_set_mute_cb);
+    if (!u->use_volume_sharing) {
+        pa_sink_set_set_volume_callback(r->sink, sink_set_volume_cb);
+        pa_sink_enable_decibel_volume(r->sink, TRUE);
+    }
+    r->sink->userdata = r;
+
+    pa_sink_set_asyncmsgq(r->sink, sink_master->asyncmsgq);
+
+    /* Create sink input */
+    pa_sink_input_new_data_init(&sink_input_data);
+    sink_input_data.driver = __FILE__;
+    sink_input_data.module = m;
+    pa_sink_input_new_data_set_sink(&sink_input_data, sink_master, FALSE);
+    sink_input_data.origin_sink = r->sink;
+    pa_proplist_sets(sink_input_data.proplist, PA_PROP_MEDIA_NAME, "Echo-Cancel Sink Stream");
+    pa_proplist_sets(sink_input_data.proplist, PA_PROP_MEDIA_ROLE, "filter");
+    pa_sink_input_new_data_set_sample_spec(&sink_input_data, sink_ss);
+    pa_sink_input_new_data_set_channel_map(&sink_input_data, sink_map);
+    sink_input_data.flags = PA_SINK_INPUT_VARIABLE_RATE;
+
+    pa_sink_input_new(&r->sink_input, m->core, &sink_input_data);
+    pa_sink_input_new_data_done(&sink_input_data);
+
+    if (!r->sink_input) {
+        pa_log("Failed to create sink input.");
+        return -1;
+    }
+
+    r->sink_input->parent.process_msg = sink_input_process_msg_cb;
+    r->sink_input->pop = sink_input_pop_cb;
+    r->sink_input->process_rewind = sink_input_process_rewind_cb;
+    r->sink_input->update_max_rewind = sink_input_update_max_rewind_cb;
+    r->sink_input->update_max_request = sink_input_update_max_request_cb;
+    r->sink_input->update_sink_requested_latency = sink_input_update_sink_requested_latency_cb;
+    r->sink_input->update_sink_latency_range = sink_input_update_sink_latency_range_cb;
+    r->sink_input->update_sink_fixed_latency = sink_input_update_sink_fixed_latency_cb;
+    r->sink_input->kill = sink_input_kill_cb;
+    r->sink_input->attach = sink_input_attach_cb;
+    r->sink_input->detach = sink_input_detach_cb;
+    r->sink_input->state_change = sink_input_state_change_cb;
+    r->sink_input->may_move_to = sink_input_may_move_to_cb;
+    r->sink_input->moving = sink_input_moving_cb;
+    if (!u->use_volume_sharing)
+        r->sink_input->volume_changed = sink_input_volume_changed_cb;
+    r->sink_input->mute_changed = sink_input_mute_changed_cb;
+    r->sink_input->userdata = r;
+
+    r->sink->input_to_master = r->sink_input;
+
+    pa_sink_input_get_silence(r->sink_input, &silence);
+    r->sink_memblockq = pa_memblockq_new("module-echo-cancel sink_memblockq", 0, MEMBLOCKQ_MAXLENGTH, 0,
+        sink_ss, 1, 1, 0, &silence);
+    pa_memblock_unref(silence.memblock);
+
+    if (!r->sink_memblockq) {
+        pa_log("Failed to create memblockq.");
+        return -1;
+    }
+
+    return 0;
+}
+
 /* Called from main context. */
 int pa__init(pa_module*m) {
     struct userdata *u;
@@ -1611,13 +2226,17 @@ int pa__init(pa_module*m) {
     pa_channel_map source_map, sink_map;
     pa_modargs *ma;
     pa_source *source_master=NULL;
-    pa_sink *sink_master=NULL;
+    pa_sink *sink_master=NULL, **sink_masters = NULL;
+    const char *sink_master_names, *state = NULL;
+    char *name;
+    unsigned n_sink_masters = 0, k, j;
     pa_source_output_new_data source_output_data;
-    pa_sink_input_new_data sink_input_data;
     pa_source_new_data source_data;
-    pa_sink_new_data sink_data;
     pa_memchunk silence;
     uint32_t temp;
+    pa_bool_t ec_thread = FALSE;
+    int32_t rtprio = -1;
+    char *cpu_affinity = NULL;
 
     pa_assert(m);
 
@@ -1632,19 +2251,52 @@ int pa__init(pa_module*m) {
     }
     pa_assert(source_master);
 
-    if (!(sink_master = pa_namereg_get(m->core, pa_modargs_get_value(ma, "sink_master", NULL), PA_NAMEREG_SINK))) {
-        pa_log("Master sink not found");
-        goto fail;
-    }
-    pa_assert(sink_master);
+    /* Without sink_master= this gives us the default sink */
+    if ((sink_master_names = pa_modargs_get_value(ma, "sink_master", NULL)))
+        while ((name = pa_split(sink_master_names, ",", &state))) {
+            n_sink_masters++;
+            pa_xfree(name);
+        }
 
-    if (source_master->monitor_of == sink_master) {
-        pa_log("Can't cancel echo between a sink and its monitor");
+    if (n_sink_masters > MAX_REFERENCES) {
+        pa_log("Too many master sinks, at most %u are supported", MAX_REFERENCES);
         goto fail;
     }
 
+    sink_masters = pa_xnew0(pa_sink*, PA_MAX(n_sink_masters, 1U));
+
+    k = 0;
+    state = NULL;
+    do {
+        name = sink_master_names ? pa_split(sink_master_names, ",", &state) : NULL;
+
+        if (!(sink_master = pa_namereg_get(m->core, name, PA_NAMEREG_SINK))) {
+            pa_log("Master sink %s not found", pa_strnull(name));
+            pa_xfree(name);
+            goto fail;
+        }
+        pa_xfree(name);
+
+        if (source_master->monitor_of == sink_master) {
+            pa_log("Can't cancel echo between a sink and its monitor");
+            goto fail;
+        }
+
+        for (j = 0; j < k; j++)
+            if (sink_masters[j] == sink_master) {
+                pa_log("Sink %s given more than once", sink_master->name);
+                goto fail;
+            }
+
+        sink_masters[k++] = sink_master;
+    } while (k < n_sink_masters);
+
+    sink_master = sink_masters[0];
+
+    /* Unless asked otherwise we run at the rate of the hardware, so that
+     * neither capture nor the reference has to be resampled if the
+     * canceller can handle it. Otherwise its init() picks a rate. */
     source_ss = source_master->sample_spec;
-    source_ss.rate = DEFAULT_RATE;
     source_ss.channels = DEFAULT_CHANNELS;
     pa_channel_map_init_auto(&source_map, source_ss.channels, PA_CHANNEL_MAP_DEFAULT);
 
@@ -1661,6 +2313,9 @@ int pa__init(pa_module*m) {
     m->userdata = u;
     u->dead = FALSE;
 
+    u->n_refs = k;
+    u->refs = pa_xnew0(struct reference, u->n_refs);
+
     u->use_volume_sharing = TRUE;
     if (pa_modargs_get_value_boolean(ma, "use_volume_sharing", &u->use_volume_sharing) < 0) {
         pa_log("use_volume_sharing= expects a boolean argument");
@@ -1701,12 +2356,24 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    if (pa_modargs_get_value_boolean(ma, "ec_thread", &ec_thread) < 0) {
+        pa_log("ec_thread= expects a boolean argument");
+        goto fail;
+    }
+
+    if (pa_modargs_get_io_thread_args(ma, &rtprio, &cpu_affinity) < 0) {
+        pa_log("Failed to parse realtime_priority= or cpu_affinity= argument");
+        goto fail;
+    }
+
     if (init_common(ma, u, &source_ss, &source_map) < 0)
         goto fail;
 
     u->asyncmsgq = pa_asyncmsgq_new(0);
     u->need_realign = TRUE;
 
+    u->ec->params.n_references = u->n_refs;
+
     if (u->ec->init) {
         if (!u->ec->init(u->core, u->ec, &source_ss, &source_map, &sink_ss, &sink_map, &u->blocksize, pa_modargs_get_value(ma, "aec_args", NULL))) {
             pa_log("Failed to init AEC engine");
@@ -1717,6 +2384,27 @@ int pa__init(pa_module*m) {
     if (u->ec->params.drift_compensation)
         pa_assert(u->ec->set_drift);
 
+    pa_assert(u->ec->params.n_references == 1 || u->ec->params.n_references == u->n_refs);
+
+    if (u->n_refs > 1) {
+        if (u->ec->params.drift_compensation) {
+            pa_log("Drift compensation only works with a single sink");
+            goto fail;
+        }
+
+        pa_log_info("Cancelling echo of %u sinks, %s", u->n_refs,
+                    u->ec->params.n_references > 1 ? "stacked" : "mixed");
+    }
+
+    if (ec_thread) {
+        /* play() and record() are driven separately by the drift
+         * compensation, only run() is moved to the thread */
+        if (u->ec->params.drift_compensation)
+            pa_log_warn("The canceller thread is not used with drift compensation");
+        else if (ec_worker_start(u, rtprio, cpu_affinity) < 0)
+            goto fail;
+    }
+
     /* Create source */
     pa_source_new_data_init(&source_data);
     source_data.driver = __FILE__;
@@ -1768,56 +2456,6 @@ int pa__init(pa_module*m) {
 
     pa_source_set_asyncmsgq(u->source, source_master->asyncmsgq);
 
-    /* Create sink */
-    pa_sink_new_data_init(&sink_data);
-    sink_data.driver = __FILE__;
-    sink_data.module = m;
-    if (!(sink_data.name = pa_xstrdup(pa_modargs_get_value(ma, "sink_name", NULL))))
-        sink_data.name = pa_sprintf_malloc("%s.echo-cancel", sink_master->name);
-    pa_sink_new_data_set_sample_spec(&sink_data, &sink_ss);
-    pa_sink_new_data_set_channel_map(&sink_data, &sink_map);
-    pa_proplist_sets(sink_data.proplist, PA_PROP_DEVICE_MASTER_DEVICE, sink_master->name);
-    pa_proplist_sets(sink_data.proplist, PA_PROP_DEVICE_CLASS, "filter");
-    if (!u->autoloaded)
-        pa_proplist_sets(sink_data.proplist, PA_PROP_DEVICE_INTENDED_ROLES, "phone");
-
-    if (pa_modargs_get_proplist(ma, "sink_properties", sink_data.proplist, PA_UPDATE_REPLACE) < 0) {
-        pa_log("Invalid properties");
-        pa_sink_new_data_done(&sink_data);
-        goto fail;
-    }
-
-    if ((u->sink_auto_desc = !pa_proplist_contains(sink_data.proplist, PA_PROP_DEVICE_DESCRIPTION))) {
-        const char *y, *z;
-
-        y = pa_proplist_gets(source_master->proplist, PA_PROP_DEVICE_DESCRIPTION);
-        z = pa_proplist_gets(sink_master->proplist, PA_PROP_DEVICE_DESCRIPTION);
-        pa_proplist_setf(sink_data.proplist, PA_PROP_DEVICE_DESCRIPTION, "%s (echo cancelled with %s)",
-                z ? z : sink_master->name, y ? y : source_master->name);
-    }
-
-    u->sink = pa_sink_new(m->core, &sink_data, (sink_master->flags & (PA_SINK_LATENCY | PA_SINK_DYNAMIC_LATENCY))
-                                               | (u->use_volume_sharing ? PA_SINK_SHARE_VOLUME_WITH_MASTER : 0));
-    pa_sink_new_data_done(&sink_data);
-
-    if (!u->sink) {
-        pa_log("Failed to create sink.");
-        goto fail;
-    }
-
-    u->sink->parent.process_msg = sink_process_msg_cb;
-    u->sink->set_state = sink_set_state_cb;
-    u->sink->update_requested_latency = sink_update_requested_latency_cb;
-    u->sink->request_rewind = sink_request_rewind_cb;
-    pa_sink_set_set_mute_callback(u->sink, sink_set_mute_cb);
-    if (!u->use_volume_sharing) {
-        pa_sink_set_set_volume_callback(u->sink, sink_set_volume_cb);
-        pa_sink_enable_decibel_volume(u->sink, TRUE);
-    }
-    u->sink->userdata = u;
-
-    pa_sink_set_asyncmsgq(u->sink, sink_master->asyncmsgq);
-
     /* Create source output */
     pa_source_output_new_data_init(&source_output_data);
     source_output_data.driver = __FILE__;
@@ -1855,55 +2493,17 @@ int pa__init(pa_module*m) {
 
     u->source->output_from_master = u->source_output;
 
-    /* Create sink input */
-    pa_sink_input_new_data_init(&sink_input_data);
-    sink_input_data.driver = __FILE__;
-    sink_input_data.module = m;
-    pa_sink_input_new_data_set_sink(&sink_input_data, sink_master, FALSE);
-    sink_input_data.origin_sink = u->sink;
-    pa_proplist_sets(sink_input_data.proplist, PA_PROP_MEDIA_NAME, "Echo-Cancel Sink Stream");
-    pa_proplist_sets(sink_input_data.proplist, PA_PROP_MEDIA_ROLE, "filter");
-    pa_sink_input_new_data_set_sample_spec(&sink_input_data, &sink_ss);
-    pa_sink_input_new_data_set_channel_map(&sink_input_data, &sink_map);
-    sink_input_data.flags = PA_SINK_INPUT_VARIABLE_RATE;
-
-    pa_sink_input_new(&u->sink_input, m->core, &sink_input_data);
-    pa_sink_input_new_data_done(&sink_input_data);
-
-    if (!u->sink_input)
-        goto fail;
-
-    u->sink_input->parent.process_msg = sink_input_process_msg_cb;
-    u->sink_input->pop = sink_input_pop_cb;
-    u->sink_input->process_rewind = sink_input_process_rewind_cb;
-    u->sink_input->update_max_rewind = sink_input_update_max_rewind_cb;
-    u->sink_input->update_max_request = sink_input_update_max_request_cb;
-    u->sink_input->update_sink_requested_latency = sink_input_update_sink_requested_latency_cb;
-    u->sink_input->update_sink_latency_range = sink_input_update_sink_latency_range_cb;
-    u->sink_input->update_sink_fixed_latency = sink_input_update_sink_fixed_latency_cb;
-    u->sink_input->kill = sink_input_kill_cb;
-    u->sink_input->attach = sink_input_attach_cb;
-    u->sink_input->detach = sink_input_detach_cb;
-    u->sink_input->state_change = sink_input_state_change_cb;
-    u->sink_input->may_move_to = sink_input_may_move_to_cb;
-    u->sink_input->moving = sink_input_moving_cb;
-    if (!u->use_volume_sharing)
-        u->sink_input->volume_changed = sink_input_volume_changed_cb;
-    u->sink_input->mute_changed = sink_input_mute_changed_cb;
-    u->sink_input->userdata = u;
-
-    u->sink->input_to_master = u->sink_input;
-
-    pa_sink_input_get_silence(u->sink_input, &silence);
+    for (k = 0; k < u->n_refs; k++)
+        if (init_reference(u, &u->refs[k], ma, sink_masters[k], source_master, &sink_ss, &sink_map) < 0)
+            goto fail;
 
+    pa_sink_input_get_silence(u->refs[0].sink_input, &silence);
     u->source_memblockq = pa_memblockq_new("module-echo-cancel source_memblockq", 0, MEMBLOCKQ_MAXLENGTH, 0,
         &source_ss, 1, 1, 0, &silence);
-    u->sink_memblockq = pa_memblockq_new("module-echo-cancel sink_memblockq", 0, MEMBLOCKQ_MAXLENGTH, 0,
-        &sink_ss, 1, 1, 0, &silence);
 
     pa_memblock_unref(silence.memblock);
 
-    if (!u->source_memblockq || !u->sink_memblockq) {
+    if (!u->source_memblockq) {
         pa_log("Failed to create memblockq.");
         goto fail;
     }
@@ -1941,12 +2541,16 @@ int pa__init(pa_module*m) {
 
     u->thread_info.current_volume = u->source->reference_volume;
 
-    pa_sink_put(u->sink);
+    for (k = 0; k < u->n_refs; k++)
+        pa_sink_put(u->refs[k].sink);
     pa_source_put(u->source);
 
-    pa_sink_input_put(u->sink_input);
+    for (k = 0; k < u->n_refs; k++)
+        pa_sink_input_put(u->refs[k].sink_input);
     pa_source_output_put(u->source_output);
     pa_modargs_free(ma);
+    pa_xfree(sink_masters);
+    pa_xfree(cpu_affinity);
 
     return 0;
 
@@ -1954,6 +2558,9 @@ fail:
     if (ma)
         pa_modargs_free(ma);
 
+    pa_xfree(sink_masters);
+    pa_xfree(cpu_affinity);
+
     pa__done(m);
 
     return -1;
@@ -1962,16 +2569,23 @@ fail:
 /* Called from main context. */
 int pa__get_n_used(pa_module *m) {
     struct userdata *u;
+    unsigned k;
+    int n;
 
     pa_assert(m);
     pa_assert_se(u = m->userdata);
 
-    return pa_sink_linked_by(u->sink) + pa_source_linked_by(u->source);
+    n = pa_source_linked_by(u->source);
+    for (k = 0; k < u->n_refs; k++)
+        n += pa_sink_linked_by(u->refs[k].sink);
+
+    return n;
 }
 
 /* Called from main context. */
 void pa__done(pa_module*m) {
     struct userdata *u;
+    unsigned k;
 
     pa_assert(m);
 
@@ -1988,28 +2602,41 @@ void pa__done(pa_module*m) {
 
     if (u->source_output)
         pa_source_output_unlink(u->source_output);
-    if (u->sink_input)
-        pa_sink_input_unlink(u->sink_input);
+    for (k = 0; k < u->n_refs; k++)
+        if (u->refs[k].sink_input)
+            pa_sink_input_unlink(u->refs[k].sink_input);
 
     if (u->source)
         pa_source_unlink(u->source);
-    if (u->sink)
-        pa_sink_unlink(u->sink);
+    for (k = 0; k < u->n_refs; k++)
+        if (u->refs[k].sink)
+            pa_sink_unlink(u->refs[k].sink);
+
+    /* Nothing is submitted to the canceller thread any more */
+    if (u->ec_worker)
+        ec_worker_free(u->ec_worker);
 
     if (u->source_output)
         pa_source_output_unref(u->source_output);
-    if (u->sink_input)
-        pa_sink_input_unref(u->sink_input);
 
     if (u->source)
         pa_source_unref(u->source);
-    if (u->sink)
-        pa_sink_unref(u->sink);
+
+    for (k = 0; k < u->n_refs; k++) {
+        struct reference *r = &u->refs[k];
+
+        if (r->sink_input)
+            pa_sink_input_unref(r->sink_input);
+        if (r->sink)
+            pa_sink_unref(r->sink);
+        if (r->sink_memblockq)
+            pa_memblockq_free(r->sink_memblockq);
+    }
+
+    pa_xfree(u->refs);
 
     if (u->source_memblockq)
         pa_memblockq_free(u->source_memblockq);
-    if (u->sink_memblockq)
-        pa_memblockq_free(u->sink_memblockq);
 
     if (u->ec) {
         if (u->ec->done)
@@ -2089,6 +2716,9 @@ int main(int argc, char* argv[]) {
     if (init_common(ma, &u, &source_ss, &source_map) < 0)
         goto fail;
 
+    /* There is only the one recording of the playback */
+    u.ec->params.n_references = 1;
+
     if (!u.ec->init(u.core, u.ec, &source_ss, &source_map, &sink_ss, &sink_map, &u.blocksize,
                      (argc > 4) ? argv[5] : NULL )) {
         pa_log("Failed to init AEC engine");
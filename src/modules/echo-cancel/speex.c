@@ -183,9 +183,12 @@ pa_bool_t pa_speex_ec_init(pa_core *c, pa_echo_canceller *ec,
 
     *blocksize = framelen * pa_frame_size (source_ss);
 
-    pa_log_debug ("Using framelen %d, blocksize %u, channels %d, rate %d", framelen, *blocksize, source_ss->channels, source_ss->rate);
+    pa_log_debug ("Using framelen %d, blocksize %u, channels %d, rate %d, references %u", framelen, *blocksize, source_ss->channels, source_ss->rate,
+                  ec->params.n_references);
 
-    ec->params.priv.speex.state = speex_echo_state_init_mc (framelen, (rate * filter_size_ms) / 1000, source_ss->channels, source_ss->channels);
+    /* Every reference is a set of speakers of its own */
+    ec->params.priv.speex.state = speex_echo_state_init_mc (framelen, (rate * filter_size_ms) / 1000, source_ss->channels,
+                                                            source_ss->channels * ec->params.n_references);
 
     if (!ec->params.priv.speex.state)
         goto fail;
@@ -61,6 +61,20 @@ static const char* const valid_modargs[] = {
     NULL
 };
 
+/* The rates the audio processing engine accepts, it splits everything
+ * above 16 kHz into bands internally */
+static const uint32_t valid_rates[] = { 32000, 16000, 8000 };
+
+static uint32_t fixate_rate(uint32_t rate) {
+    unsigned i;
+
+    for (i = 0; i < PA_ELEMENTSOF(valid_rates); i++)
+        if (rate >= valid_rates[i])
+            return valid_rates[i];
+
+    return valid_rates[PA_ELEMENTSOF(valid_rates) - 1];
+}
+
 static int routing_mode_from_string(const char *rmode) {
     if (pa_streq(rmode, "quiet-earpiece-or-headset"))
         return webrtc::EchoControlMobile::kQuietEarpieceOrHeadset;
@@ -159,11 +173,16 @@ pa_bool_t pa_webrtc_ec_init(pa_core *c, pa_echo_canceller *ec,
     apm = webrtc::AudioProcessing::Create(0);
 
     source_ss->format = PA_SAMPLE_S16NE;
+    source_ss->rate = fixate_rate(source_ss->rate);
     *sink_ss = *source_ss;
     /* FIXME: the implementation actually allows a different number of
      * source/sink channels. Do we want to support that? */
     *sink_map = *source_map;
 
+    /* The reverse stream is tied to the sink channel map, so several sinks
+     * are mixed into it */
+    ec->params.n_references = 1;
+
     apm->set_sample_rate_hz(source_ss->rate);
 
     apm->set_num_channels(source_ss->channels, source_ss->channels);
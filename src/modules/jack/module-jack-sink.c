@@ -42,6 +42,8 @@
 #include <pulsecore/thread-mq.h>
 #include <pulsecore/rtpoll.h>
 #include <pulsecore/sample-util.h>
+#include <pulsecore/atomic.h>
+#include <pulsecore/fdsem.h>
 
 #include "module-jack-sink-symdef.h"
 
@@ -56,6 +58,12 @@
  * should hopefully not be that expensive if RT scheduling is
  * enabled. A better fix would only be possible with additional event
  * source support in JACK.
+ *
+ * With render_ahead= the JACK thread doesn't wait for our thread at
+ * all. Instead our thread keeps that many JACK periods rendered into
+ * a ring buffer, from which the process callback only copies, so that
+ * a late wakeup of our thread costs an underrun of PA streams instead
+ * of stalling the whole JACK graph. The price is the added latency.
  */
 
 PA_MODULE_AUTHOR("Lennart Poettering");
@@ -69,10 +77,14 @@ PA_MODULE_USAGE(
         "client_name=<jack client name> "
         "channels=<number of channels> "
         "channel_map=<channel map> "
-        "connect=<connect ports?>");
+        "connect=<connect ports?> "
+        "render_ahead=<JACK periods to render in advance, 0 to render on request>");
 
 #define DEFAULT_SINK_NAME "jack_out"
 
+/* The ring is sized for JACK periods up to this, in frames */
+#define RING_PERIOD_MAX 8192
+
 struct userdata {
     pa_core *core;
     pa_module *module;
@@ -95,6 +107,21 @@ struct userdata {
     jack_nframes_t frames_in_buffer;
     jack_nframes_t saved_frame_time;
     pa_bool_t saved_frame_time_valid;
+
+    /* Only used with render_ahead. The ring holds interleaved frames,
+     * written by our thread and read by the JACK thread, the indices
+     * count frames and wrap around. */
+    unsigned render_ahead;
+    jack_nframes_t period;
+    float *ring;
+    unsigned ring_frames;
+    pa_atomic_t ring_read, ring_write;
+    pa_atomic_t ring_active;
+    pa_atomic_t ring_frame_time, ring_nframes;
+    pa_atomic_t underruns;
+    unsigned underruns_reported;
+    pa_fdsem *fdsem;
+    pa_rtpoll_item *fdsem_item;
 };
 
 static const char* const valid_modargs[] = {
@@ -105,6 +132,7 @@ static const char* const valid_modargs[] = {
     "channels",
     "channel_map",
     "connect",
+    "render_ahead",
     NULL
 };
 
@@ -131,6 +159,11 @@ static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offse
                 pa_assert(offset > 0);
                 nbytes = (size_t) offset * pa_frame_size(&u->sink->sample_spec);
 
+                /* A message handled before this one in the same batch
+                 * may have asked for a rewind */
+                if (u->sink->thread_info.rewind_requested)
+                    pa_sink_process_rewind(u->sink, 0);
+
                 pa_sink_render_full(u->sink, nbytes, &chunk);
 
                 p = (uint8_t*) pa_memblock_acquire(chunk.memblock) + chunk.index;
@@ -159,6 +192,7 @@ static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offse
             return 0;
 
         case SINK_MESSAGE_BUFFER_SIZE:
+            u->period = (jack_nframes_t) offset;
             pa_sink_set_max_request_within_thread(u->sink, (size_t) offset * pa_frame_size(&u->sink->sample_spec));
             return 0;
 
@@ -171,10 +205,19 @@ static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offse
             jack_latency_range_t r;
             size_t n;
 
+            if (u->ring) {
+                u->frames_in_buffer = (jack_nframes_t) pa_atomic_load(&u->ring_nframes);
+                u->saved_frame_time = (jack_nframes_t) pa_atomic_load(&u->ring_frame_time);
+                u->saved_frame_time_valid = u->frames_in_buffer > 0;
+            }
+
             /* This is the "worst-case" latency */
             jack_port_get_latency_range(u->port[0], JackPlaybackLatency, &r);
             l = r.max + u->frames_in_buffer;
 
+            if (u->ring)
+                l += (unsigned) pa_atomic_load(&u->ring_write) - (unsigned) pa_atomic_load(&u->ring_read);
+
             if (u->saved_frame_time_valid) {
                 /* Adjust the worst case latency by the time that
                  * passed since we last handed data to JACK */
@@ -214,6 +257,91 @@ static int jack_process(jack_nframes_t nframes, void *arg) {
     return 0;
 }
 
+/* JACK Callback: Like jack_process(), but only takes what our thread
+ * rendered in advance. Never waits, wakes our thread up to refill. */
+static int jack_process_ring(jack_nframes_t nframes, void *arg) {
+    struct userdata *u = arg;
+    void *dst[PA_CHANNELS_MAX];
+    unsigned c, r, n, k;
+
+    pa_assert(u);
+
+    for (c = 0; c < u->channels; c++)
+        pa_assert_se(u->buffer[c] = jack_port_get_buffer(u->port[c], nframes));
+
+    r = (unsigned) pa_atomic_load(&u->ring_read);
+    n = PA_MIN(nframes, (unsigned) pa_atomic_load(&u->ring_write) - r);
+
+    /* At most two pieces, around the end of the ring */
+    for (k = 0; k < n;) {
+        unsigned i = (r + k) & (u->ring_frames - 1), l = PA_MIN(n - k, u->ring_frames - i);
+
+        for (c = 0; c < u->channels; c++)
+            dst[c] = (float*) u->buffer[c] + k;
+
+        pa_deinterleave(u->ring + i * u->channels, dst, u->channels, sizeof(float), l);
+        k += l;
+    }
+
+    pa_atomic_store(&u->ring_read, (int) (r + n));
+
+    if (n < nframes) {
+        for (c = 0; c < u->channels; c++)
+            memset((float*) u->buffer[c] + n, 0, (nframes - n) * sizeof(float));
+
+        /* Running dry while our thread isn't rendering is no underrun */
+        if (pa_atomic_load(&u->ring_active))
+            pa_atomic_inc(&u->underruns);
+    }
+
+    pa_atomic_store(&u->ring_frame_time, (int) jack_frame_time(u->client));
+    pa_atomic_store(&u->ring_nframes, (int) nframes);
+
+    pa_fdsem_post(u->fdsem);
+    return 0;
+}
+
+/* Renders until render_ahead periods are queued in the ring */
+static void ring_fill(struct userdata *u) {
+    size_t fs = pa_frame_size(&u->sink->sample_spec);
+    unsigned w, target;
+
+    w = (unsigned) pa_atomic_load(&u->ring_write);
+    target = PA_MIN(u->render_ahead * u->period, u->ring_frames);
+
+    for (;;) {
+        pa_memchunk chunk;
+        unsigned fill, n, k;
+        uint8_t *p;
+
+        fill = w - (unsigned) pa_atomic_load(&u->ring_read);
+        if (fill >= target)
+            break;
+
+        n = PA_MIN(u->period, target - fill);
+
+        if (u->sink->thread_info.rewind_requested)
+            pa_sink_process_rewind(u->sink, 0);
+
+        pa_sink_render_full(u->sink, n * fs, &chunk);
+
+        p = (uint8_t*) pa_memblock_acquire(chunk.memblock) + chunk.index;
+
+        for (k = 0; k < n;) {
+            unsigned i = (w + k) & (u->ring_frames - 1), l = PA_MIN(n - k, u->ring_frames - i);
+
+            memcpy(u->ring + i * u->channels, p + k * fs, l * fs);
+            k += l;
+        }
+
+        pa_memblock_release(chunk.memblock);
+        pa_memblock_unref(chunk.memblock);
+
+        w += n;
+        pa_atomic_store(&u->ring_write, (int) w);
+    }
+}
+
 static void thread_func(void *userdata) {
     struct userdata *u = userdata;
 
@@ -221,15 +349,30 @@ static void thread_func(void *userdata) {
 
     pa_log_debug("Thread starting up");
 
-    if (u->core->realtime_scheduling)
-        pa_make_realtime(u->core->realtime_priority);
+    pa_core_setup_io_thread(u->core, -1, NULL);
 
     pa_thread_mq_install(&u->thread_mq);
 
     for (;;) {
         int ret;
 
-        if (PA_SINK_IS_OPENED(u->sink->thread_info.state))
+        if (u->ring) {
+            unsigned underruns;
+
+            if (PA_SINK_IS_OPENED(u->sink->thread_info.state)) {
+                ring_fill(u);
+                pa_atomic_store(&u->ring_active, 1);
+            } else
+                pa_atomic_store(&u->ring_active, 0);
+
+            underruns = (unsigned) pa_atomic_load(&u->underruns);
+            if (underruns != u->underruns_reported) {
+                if (pa_log_ratelimit(PA_LOG_INFO))
+                    pa_log_info("JACK found the ring buffer short, %u underruns so far.", underruns);
+                u->underruns_reported = underruns;
+            }
+
+        } else if (PA_SINK_IS_OPENED(u->sink->thread_info.state))
             if (u->sink->thread_info.rewind_requested)
                 pa_sink_process_rewind(u->sink, 0);
 
@@ -293,7 +436,7 @@ int pa__init(pa_module*m) {
     pa_modargs *ma = NULL;
     jack_status_t status;
     const char *server_name, *client_name;
-    uint32_t channels = 0;
+    uint32_t channels = 0, render_ahead = 0;
     pa_bool_t do_connect = TRUE;
     unsigned i;
     const char **ports = NULL, **p;
@@ -315,6 +458,11 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    if (pa_modargs_get_value_u32(ma, "render_ahead", &render_ahead) < 0 || render_ahead > 16) {
+        pa_log("Failed to parse render_ahead= argument.");
+        goto fail;
+    }
+
     server_name = pa_modargs_get_value(ma, "server_name", NULL);
     client_name = pa_modargs_get_value(ma, "client_name", "PulseAudio JACK Sink");
 
@@ -415,7 +563,21 @@ int pa__init(pa_module*m) {
     pa_sink_set_rtpoll(u->sink, u->rtpoll);
     pa_sink_set_max_request(u->sink, jack_get_buffer_size(u->client) * pa_frame_size(&u->sink->sample_spec));
 
-    jack_set_process_callback(u->client, jack_process, u);
+    u->period = jack_get_buffer_size(u->client);
+
+    if (render_ahead > 0) {
+        u->render_ahead = render_ahead;
+        u->ring_frames = (unsigned) pa_make_power_of_two(render_ahead * PA_MAX(u->period, (jack_nframes_t) RING_PERIOD_MAX));
+        u->ring = pa_xnew0(float, u->ring_frames * u->channels);
+
+        /* The ring is refilled whenever the JACK thread took from it */
+        pa_assert_se(u->fdsem = pa_fdsem_new());
+        u->fdsem_item = pa_rtpoll_item_new_fdsem(u->rtpoll, PA_RTPOLL_EARLY-1, u->fdsem);
+
+        pa_log_info("Rendering %u JACK periods ahead.", render_ahead);
+    }
+
+    jack_set_process_callback(u->client, u->ring ? jack_process_ring : jack_process, u);
     jack_on_shutdown(u->client, jack_shutdown, u);
     jack_set_thread_init_callback(u->client, jack_init, u);
     jack_set_buffer_size_callback(u->client, jack_buffer_size, u);
@@ -448,7 +610,7 @@ int pa__init(pa_module*m) {
     }
 
     jack_port_get_latency_range(u->port[0], JackPlaybackLatency, &r);
-    n = r.max * pa_frame_size(&u->sink->sample_spec);
+    n = (r.max + u->render_ahead * u->period) * pa_frame_size(&u->sink->sample_spec);
     pa_sink_set_fixed_latency(u->sink, pa_bytes_to_usec(n, &u->sink->sample_spec));
     pa_sink_put(u->sink);
 
@@ -506,6 +668,17 @@ void pa__done(pa_module*m) {
     if (u->rtpoll_item)
         pa_rtpoll_item_free(u->rtpoll_item);
 
+    if (u->fdsem_item)
+        pa_rtpoll_item_free(u->fdsem_item);
+
+    if (u->fdsem)
+        pa_fdsem_free(u->fdsem);
+
+    if (u->ring) {
+        pa_log_info("JACK found the ring buffer short %u times.", (unsigned) pa_atomic_load(&u->underruns));
+        pa_xfree(u->ring);
+    }
+
     if (u->jack_msgq)
         pa_asyncmsgq_unref(u->jack_msgq);
 
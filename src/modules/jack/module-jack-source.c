@@ -190,8 +190,7 @@ static void thread_func(void *userdata) {
 
     pa_log_debug("Thread starting up");
 
-    if (u->core->realtime_scheduling)
-        pa_make_realtime(u->core->realtime_priority);
+    pa_core_setup_io_thread(u->core, -1, NULL);
 
     pa_thread_mq_install(&u->thread_mq);
 
@@ -28,6 +28,8 @@
 #include <config.h>
 #endif
 
+#include <string.h>
+
 #include <pulse/xmalloc.h>
 
 #include <pulsecore/sink.h>
@@ -43,6 +45,8 @@
 #include <pulsecore/strbuf.h>
 #include <pulsecore/thread.h>
 #include <pulsecore/thread-mq.h>
+#include <pulsecore/atomic.h>
+#include <pulsecore/fdsem.h>
 
 #include <CoreAudio/CoreAudio.h>
 #include <CoreAudio/CoreAudioTypes.h>
@@ -51,17 +55,30 @@
 #include "module-coreaudio-device-symdef.h"
 
 #define DEFAULT_FRAMES_PER_IOPROC 512
+#define DEFAULT_RENDER_AHEAD 2
+
+/* The rings are sized for IOProc periods up to this, in frames */
+#define RING_PERIOD_MAX 4096
+
+/* With render_ahead= the HAL IO thread doesn't wait for our thread at
+ * all. Our thread keeps that many IOProc periods rendered into a ring
+ * for each sink, from which the IOProc only copies, and the IOProc
+ * queues what it captured for our thread in a ring for each source.
+ * Contention on our side then costs an underrun of PA streams instead
+ * of a HAL overload. The price is the added latency. */
 
 PA_MODULE_AUTHOR("Daniel Mack");
 PA_MODULE_DESCRIPTION("CoreAudio device");
 PA_MODULE_VERSION(PACKAGE_VERSION);
 PA_MODULE_LOAD_ONCE(FALSE);
 PA_MODULE_USAGE("object_id=<the CoreAudio device id> "
-                "ioproc_frames=<audio frames per IOProc call> ");
+                "ioproc_frames=<audio frames per IOProc call> "
+                "render_ahead=<IOProc periods to render in advance, 0 to render on request> ");
 
 static const char* const valid_modargs[] = {
     "object_id",
     "ioproc_frames",
+    "render_ahead",
     NULL
 };
 
@@ -91,6 +108,16 @@ struct userdata {
     const AudioBufferList *render_input_data;
     AudioBufferList       *render_output_data;
 
+    /* Only used with render_ahead. The period is the number of frames
+     * of the last IOProc call. */
+    unsigned render_ahead;
+    unsigned ring_frames;
+    pa_atomic_t period;
+    pa_atomic_t underruns, overruns;
+    unsigned underruns_reported, overruns_reported;
+    pa_fdsem *fdsem;
+    pa_rtpoll_item *fdsem_item;
+
     AudioStreamBasicDescription stream_description;
 
     PA_LLIST_HEAD(coreaudio_sink, sinks);
@@ -108,6 +135,12 @@ struct coreaudio_sink {
     pa_channel_map map;
     pa_sample_spec ss;
 
+    /* Interleaved frames written by our thread and read by the HAL IO
+     * thread, the indices count frames and wrap around */
+    uint8_t *ring;
+    pa_atomic_t ring_read, ring_write;
+    pa_atomic_t ring_active;
+
     PA_LLIST_FIELDS(coreaudio_sink);
 };
 
@@ -122,6 +155,11 @@ struct coreaudio_source {
     pa_channel_map map;
     pa_sample_spec ss;
 
+    /* Like for sinks, but written by the HAL IO thread */
+    uint8_t *ring;
+    pa_atomic_t ring_read, ring_write;
+    pa_atomic_t ring_active;
+
     PA_LLIST_FIELDS(coreaudio_source);
 };
 
@@ -152,6 +190,103 @@ static OSStatus io_render_proc (AudioDeviceID          device,
     return 0;
 }
 
+/* Copies n frames from or to a ring starting at index i, in at most
+ * two pieces around the end of the ring */
+static void ring_copy_out(struct userdata *u, const uint8_t *ring, size_t fs, unsigned i, uint8_t *dst, unsigned n) {
+    unsigned k, l;
+
+    for (k = 0; k < n; k += l) {
+        unsigned j = (i + k) & (u->ring_frames - 1);
+
+        l = PA_MIN(n - k, u->ring_frames - j);
+        memcpy(dst + k * fs, ring + j * fs, l * fs);
+    }
+}
+
+static void ring_copy_in(struct userdata *u, uint8_t *ring, size_t fs, unsigned i, const uint8_t *src, unsigned n) {
+    unsigned k, l;
+
+    for (k = 0; k < n; k += l) {
+        unsigned j = (i + k) & (u->ring_frames - 1);
+
+        l = PA_MIN(n - k, u->ring_frames - j);
+        memcpy(ring + j * fs, src + k * fs, l * fs);
+    }
+}
+
+static void ring_play(struct userdata *u, coreaudio_sink *sink, AudioBuffer *buf) {
+    size_t fs = pa_frame_size(&sink->ss);
+    unsigned nframes = buf->mDataByteSize / fs, r, n;
+
+    pa_atomic_store(&u->period, (int) nframes);
+
+    r = (unsigned) pa_atomic_load(&sink->ring_read);
+    n = PA_MIN(nframes, (unsigned) pa_atomic_load(&sink->ring_write) - r);
+
+    ring_copy_out(u, sink->ring, fs, r, buf->mData, n);
+    pa_atomic_store(&sink->ring_read, (int) (r + n));
+
+    if (n < nframes) {
+        memset((uint8_t*) buf->mData + n * fs, 0, (nframes - n) * fs);
+
+        /* Running dry while our thread isn't rendering is no underrun */
+        if (pa_atomic_load(&sink->ring_active))
+            pa_atomic_inc(&u->underruns);
+    }
+}
+
+static void ring_capture(struct userdata *u, coreaudio_source *source, const AudioBuffer *buf) {
+    size_t fs = pa_frame_size(&source->ss);
+    unsigned nframes = buf->mDataByteSize / fs, w;
+
+    pa_atomic_store(&u->period, (int) nframes);
+
+    if (!pa_atomic_load(&source->ring_active))
+        return;
+
+    w = (unsigned) pa_atomic_load(&source->ring_write);
+
+    /* Whole periods are dropped, so that the ring stays in sync */
+    if (u->ring_frames - (w - (unsigned) pa_atomic_load(&source->ring_read)) < nframes) {
+        pa_atomic_inc(&u->overruns);
+        return;
+    }
+
+    ring_copy_in(u, source->ring, fs, w, buf->mData, nframes);
+    pa_atomic_store(&source->ring_write, (int) (w + nframes));
+}
+
+/* Like io_render_proc(), but only copies from and to the rings. Never
+ * waits, wakes our thread up to refill and drain them. */
+static OSStatus io_render_proc_ring (AudioDeviceID          device,
+                                     const AudioTimeStamp  *now,
+                                     const AudioBufferList *inputData,
+                                     const AudioTimeStamp  *inputTime,
+                                     AudioBufferList       *outputData,
+                                     const AudioTimeStamp  *outputTime,
+                                     void                  *clientData)
+{
+    struct userdata *u = clientData;
+    coreaudio_sink *sink;
+    coreaudio_source *source;
+    UInt32 i;
+
+    pa_assert(u);
+    pa_assert(device == u->object_id);
+
+    if (u->sinks)
+        for (sink = u->sinks, i = 0; sink && i < outputData->mNumberBuffers; sink = sink->next, i++)
+            ring_play(u, sink, outputData->mBuffers + i);
+
+    if (u->sources)
+        for (source = u->sources, i = 0; source && i < inputData->mNumberBuffers; source = source->next, i++)
+            ring_capture(u, source, inputData->mBuffers + i);
+
+    pa_fdsem_post(u->fdsem);
+
+    return 0;
+}
+
 static OSStatus ca_stream_format_changed(AudioObjectID objectID,
                                          UInt32 numberAddresses,
                                          const AudioObjectPropertyAddress addresses[],
@@ -293,6 +428,13 @@ static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offse
 
         case PA_SINK_MESSAGE_GET_LATENCY: {
             *((pa_usec_t *) data) = get_latency_us(PA_OBJECT(o));
+
+            if (sink->ring) {
+                unsigned n = (unsigned) pa_atomic_load(&sink->ring_write) - (unsigned) pa_atomic_load(&sink->ring_read);
+
+                *((pa_usec_t *) data) += pa_bytes_to_usec(n * pa_frame_size(&sink->ss), &sink->ss);
+            }
+
             return 0;
         }
     }
@@ -331,6 +473,13 @@ static int source_process_msg(pa_msgobject *o, int code, void *data, int64_t off
 
         case PA_SOURCE_MESSAGE_GET_LATENCY: {
             *((pa_usec_t *) data) = get_latency_us(PA_OBJECT(o));
+
+            if (source->ring) {
+                unsigned n = (unsigned) pa_atomic_load(&source->ring_write) - (unsigned) pa_atomic_load(&source->ring_read);
+
+                *((pa_usec_t *) data) += pa_bytes_to_usec(n * pa_frame_size(&source->ss), &source->ss);
+            }
+
             return 0;
         }
     }
@@ -643,6 +792,98 @@ static int ca_device_create_streams(pa_module *m, bool direction_in) {
     return 0;
 }
 
+/* Renders until render_ahead periods are queued in the ring */
+static void ring_fill(struct userdata *u, coreaudio_sink *sink) {
+    size_t fs = pa_frame_size(&sink->ss);
+    unsigned w, period, target;
+
+    w = (unsigned) pa_atomic_load(&sink->ring_write);
+    period = PA_MAX((unsigned) pa_atomic_load(&u->period), 1U);
+    target = PA_MIN(u->render_ahead * period, u->ring_frames);
+
+    for (;;) {
+        pa_memchunk chunk;
+        unsigned fill, n;
+
+        fill = w - (unsigned) pa_atomic_load(&sink->ring_read);
+        if (fill >= target)
+            break;
+
+        n = PA_MIN(period, target - fill);
+
+        if (sink->pa_sink->thread_info.rewind_requested)
+            pa_sink_process_rewind(sink->pa_sink, 0);
+
+        pa_sink_render_full(sink->pa_sink, n * fs, &chunk);
+
+        ring_copy_in(u, sink->ring, fs, w, (uint8_t*) pa_memblock_acquire(chunk.memblock) + chunk.index, n);
+        pa_memblock_release(chunk.memblock);
+        pa_memblock_unref(chunk.memblock);
+
+        w += n;
+        pa_atomic_store(&sink->ring_write, (int) w);
+    }
+}
+
+/* Posts everything the HAL IO thread queued in the ring */
+static void ring_drain(struct userdata *u, coreaudio_source *source) {
+    size_t fs = pa_frame_size(&source->ss);
+    pa_memchunk chunk;
+    unsigned r, n;
+
+    r = (unsigned) pa_atomic_load(&source->ring_read);
+    n = (unsigned) pa_atomic_load(&source->ring_write) - r;
+
+    if (n == 0)
+        return;
+
+    chunk.memblock = pa_memblock_new(u->module->core->mempool, n * fs);
+    chunk.index = 0;
+    chunk.length = n * fs;
+
+    ring_copy_out(u, source->ring, fs, r, pa_memblock_acquire(chunk.memblock), n);
+    pa_memblock_release(chunk.memblock);
+
+    pa_atomic_store(&source->ring_read, (int) (r + n));
+
+    pa_source_post(source->pa_source, &chunk);
+    pa_memblock_unref(chunk.memblock);
+}
+
+static void ring_process(struct userdata *u) {
+    coreaudio_sink *sink;
+    coreaudio_source *source;
+    unsigned underruns, overruns;
+
+    for (sink = u->sinks; sink; sink = sink->next)
+        if (PA_SINK_IS_OPENED(sink->pa_sink->thread_info.state)) {
+            ring_fill(u, sink);
+            pa_atomic_store(&sink->ring_active, 1);
+        } else
+            pa_atomic_store(&sink->ring_active, 0);
+
+    for (source = u->sources; source; source = source->next) {
+        /* What was captured before is dropped in that case */
+        pa_atomic_store(&source->ring_active, PA_SOURCE_IS_OPENED(source->pa_source->thread_info.state));
+
+        if (pa_atomic_load(&source->ring_active))
+            ring_drain(u, source);
+        else
+            pa_atomic_store(&source->ring_read, pa_atomic_load(&source->ring_write));
+    }
+
+    underruns = (unsigned) pa_atomic_load(&u->underruns);
+    overruns = (unsigned) pa_atomic_load(&u->overruns);
+
+    if (underruns != u->underruns_reported || overruns != u->overruns_reported) {
+        if (pa_log_ratelimit(PA_LOG_INFO))
+            pa_log_info("The IOProc found the ring buffers short, %u underruns and %u overruns so far.", underruns, overruns);
+
+        u->underruns_reported = underruns;
+        u->overruns_reported = overruns;
+    }
+}
+
 static void thread_func(void *userdata) {
     struct userdata *u = userdata;
 
@@ -652,14 +893,16 @@ static void thread_func(void *userdata) {
 
     pa_log_debug("Thread starting up");
 
-    if (u->module->core->realtime_scheduling)
-        pa_make_realtime(u->module->core->realtime_priority);
+    pa_core_setup_io_thread(u->module->core, -1, NULL);
 
     pa_thread_mq_install(&u->thread_mq);
 
     for (;;) {
         int ret;
 
+        if (u->render_ahead > 0)
+            ring_process(u);
+
         ret = pa_rtpoll_run(u->rtpoll, TRUE);
 
         if (ret < 0)
@@ -682,6 +925,7 @@ finish:
 int pa__init(pa_module *m) {
     OSStatus err;
     UInt32 size, frames;
+    uint32_t render_ahead = DEFAULT_RENDER_AHEAD;
     struct userdata *u = NULL;
     pa_modargs *ma = NULL;
     char tmp[64];
@@ -706,6 +950,11 @@ int pa__init(pa_module *m) {
         goto fail;
     }
 
+    if (pa_modargs_get_value_u32(ma, "render_ahead", &render_ahead) < 0 || render_ahead > 16) {
+        pa_log("Failed to parse render_ahead argument.");
+        goto fail;
+    }
+
     property_address.mScope = kAudioObjectPropertyScopeGlobal;
     property_address.mElement = kAudioObjectPropertyElementMaster;
 
@@ -756,6 +1005,36 @@ int pa__init(pa_module *m) {
     /* create sources */
     ca_device_create_streams(m, TRUE);
 
+    /* set number of frames in IOProc */
+    frames = DEFAULT_FRAMES_PER_IOPROC;
+    pa_modargs_get_value_u32(ma, "ioproc_frames", (unsigned int *) &frames);
+
+    property_address.mSelector = kAudioDevicePropertyBufferFrameSize;
+    AudioObjectSetPropertyData(u->object_id, &property_address, 0, NULL, sizeof(frames), &frames);
+    pa_log_debug("%u frames per IOProc\n", (unsigned int) frames);
+
+    if (render_ahead > 0) {
+        /* The device may not take the size we asked for */
+        size = sizeof(frames);
+        AudioObjectGetPropertyData(u->object_id, &property_address, 0, NULL, &size, &frames);
+
+        u->render_ahead = render_ahead;
+        u->ring_frames = pa_make_power_of_two((render_ahead + 2) * PA_MAX((unsigned) frames, (unsigned) RING_PERIOD_MAX));
+        pa_atomic_store(&u->period, (int) frames);
+
+        for (ca_sink = u->sinks; ca_sink; ca_sink = ca_sink->next)
+            ca_sink->ring = pa_xmalloc0(u->ring_frames * pa_frame_size(&ca_sink->ss));
+
+        for (ca_source = u->sources; ca_source; ca_source = ca_source->next)
+            ca_source->ring = pa_xmalloc0(u->ring_frames * pa_frame_size(&ca_source->ss));
+
+        /* The rings are refilled and drained whenever the IOProc ran */
+        pa_assert_se(u->fdsem = pa_fdsem_new());
+        u->fdsem_item = pa_rtpoll_item_new_fdsem(u->rtpoll, PA_RTPOLL_EARLY-1, u->fdsem);
+
+        pa_log_info("Rendering %u IOProc periods ahead.", render_ahead);
+    }
+
     /* create the message thread */
     if (!(u->thread = pa_thread_new(u->device_name, thread_func, u))) {
         pa_log("Failed to create thread.");
@@ -769,16 +1048,8 @@ int pa__init(pa_module *m) {
 
     AudioObjectAddPropertyListener(u->object_id, &property_address, ca_stream_format_changed, u);
 
-    /* set number of frames in IOProc */
-    frames = DEFAULT_FRAMES_PER_IOPROC;
-    pa_modargs_get_value_u32(ma, "ioproc_frames", (unsigned int *) &frames);
-
-    property_address.mSelector = kAudioDevicePropertyBufferFrameSize;
-    AudioObjectSetPropertyData(u->object_id, &property_address, 0, NULL, sizeof(frames), &frames);
-    pa_log_debug("%u frames per IOProc\n", (unsigned int) frames);
-
     /* create one ioproc for both directions */
-    err = AudioDeviceCreateIOProcID(u->object_id, io_render_proc, u, &u->proc_id);
+    err = AudioDeviceCreateIOProcID(u->object_id, u->render_ahead > 0 ? io_render_proc_ring : io_render_proc, u, &u->proc_id);
     if (err) {
         pa_log("AudioDeviceCreateIOProcID() failed (err = %08x\n).", (int) err);
         goto fail;
@@ -825,6 +1096,12 @@ void pa__done(pa_module *m) {
         if (ca_source->pa_source)
             pa_source_unlink(ca_source->pa_source);
 
+    /* The IOProc must be gone before the rings and our thread */
+    if (u->proc_id) {
+        AudioDeviceStop(u->object_id, u->proc_id);
+        AudioDeviceDestroyIOProcID(u->object_id, u->proc_id);
+    }
+
     if (u->thread) {
         pa_asyncmsgq_send(u->thread_mq.inq, NULL, PA_MESSAGE_SHUTDOWN, NULL, 0, NULL);
         pa_thread_free(u->thread);
@@ -840,6 +1117,7 @@ void pa__done(pa_module *m) {
             pa_sink_unref(ca_sink->pa_sink);
 
         pa_xfree(ca_sink->name);
+        pa_xfree(ca_sink->ring);
         pa_xfree(ca_sink);
         ca_sink = next;
     }
@@ -852,21 +1130,27 @@ void pa__done(pa_module *m) {
             pa_source_unref(ca_source->pa_source);
 
         pa_xfree(ca_source->name);
+        pa_xfree(ca_source->ring);
         pa_xfree(ca_source);
         ca_source = next;
     }
 
-    if (u->proc_id) {
-        AudioDeviceStop(u->object_id, u->proc_id);
-        AudioDeviceDestroyIOProcID(u->object_id, u->proc_id);
-    }
-
     property_address.mSelector = kAudioDevicePropertyStreamFormat;
     property_address.mScope = kAudioObjectPropertyScopeGlobal;
     property_address.mElement = kAudioObjectPropertyElementMaster;
 
     AudioObjectRemovePropertyListener(kAudioObjectSystemObject, &property_address, ca_stream_format_changed, u);
 
+    if (u->fdsem_item)
+        pa_rtpoll_item_free(u->fdsem_item);
+
+    if (u->fdsem)
+        pa_fdsem_free(u->fdsem);
+
+    if (u->render_ahead > 0)
+        pa_log_info("The IOProc found the ring buffers short %u times and full %u times.",
+                    (unsigned) pa_atomic_load(&u->underruns), (unsigned) pa_atomic_load(&u->overruns));
+
     pa_xfree(u->device_name);
     pa_xfree(u->vendor_name);
     pa_rtpoll_free(u->rtpoll);
@@ -43,7 +43,7 @@
 #include <pulsecore/core-subscribe.h>
 #include <pulsecore/card.h>
 #include <pulsecore/namereg.h>
-#include <pulsecore/database.h>
+#include <pulsecore/restore-store.h>
 #include <pulsecore/tagstruct.h>
 
 #include "module-card-restore-symdef.h"
@@ -53,8 +53,6 @@ PA_MODULE_DESCRIPTION("Automatically restore profile of cards");
 PA_MODULE_VERSION(PACKAGE_VERSION);
 PA_MODULE_LOAD_ONCE(TRUE);
 
-#define SAVE_INTERVAL (10 * PA_USEC_PER_SEC)
-
 static const char* const valid_modargs[] = {
     NULL
 };
@@ -64,8 +62,7 @@ struct userdata {
     pa_module *module;
     pa_subscription *subscription;
     pa_hook_slot *card_new_hook_slot;
-    pa_time_event *save_time_event;
-    pa_database *database;
+    pa_restore_db *database;
 };
 
 #define ENTRY_VERSION 1
@@ -75,26 +72,8 @@ struct entry {
     char *profile;
 };
 
-static void save_time_callback(pa_mainloop_api*a, pa_time_event* e, const struct timeval *t, void *userdata) {
-    struct userdata *u = userdata;
-
-    pa_assert(a);
-    pa_assert(e);
-    pa_assert(u);
-
-    pa_assert(e == u->save_time_event);
-    u->core->mainloop->time_free(u->save_time_event);
-    u->save_time_event = NULL;
-
-    pa_database_sync(u->database);
-    pa_log_info("Synced.");
-}
-
 static void trigger_save(struct userdata *u) {
-    if (u->save_time_event)
-        return;
-
-    u->save_time_event = pa_core_rttime_new(u->core, pa_rtclock_now() + SAVE_INTERVAL, save_time_callback, u);
+    pa_restore_db_save(u->database);
 }
 
 static struct entry* entry_new(void) {
@@ -128,7 +107,7 @@ static pa_bool_t entry_write(struct userdata *u, const char *name, const struct
 
     data.data = (void*)pa_tagstruct_data(t, &data.size);
 
-    r = (pa_database_set(u->database, &key, &data, TRUE) == 0);
+    r = (pa_restore_db_set(u->database, &key, &data, TRUE) == 0);
 
     pa_tagstruct_free(t);
 
@@ -186,7 +165,7 @@ static struct entry* entry_read(struct userdata *u, const char *name) {
 
     pa_zero(data);
 
-    if (!pa_database_get(u->database, &key, &data))
+    if (!pa_restore_db_get(u->database, &key, &data))
         goto fail;
 
     t = pa_tagstruct_new(data.data, data.size);
@@ -297,7 +276,6 @@ static pa_hook_result_t card_new_hook_callback(pa_core *c, pa_card_new_data *new
 int pa__init(pa_module*m) {
     pa_modargs *ma = NULL;
     struct userdata *u;
-    char *fname;
     pa_card *card;
     uint32_t idx;
 
@@ -316,17 +294,8 @@ int pa__init(pa_module*m) {
 
     u->card_new_hook_slot = pa_hook_connect(&m->core->hooks[PA_CORE_HOOK_CARD_NEW], PA_HOOK_EARLY, (pa_hook_cb_t) card_new_hook_callback, u);
 
-    if (!(fname = pa_state_path("card-database", TRUE)))
-        goto fail;
-
-    if (!(u->database = pa_database_open(fname, TRUE))) {
-        pa_log("Failed to open volume database '%s': %s", fname, pa_cstrerror(errno));
-        pa_xfree(fname);
+    if (!(u->database = pa_restore_db_open(m->core, "card-database")))
         goto fail;
-    }
-
-    pa_log_info("Successfully opened database file '%s'.", fname);
-    pa_xfree(fname);
 
     for (card = pa_idxset_first(m->core->cards, &idx); card; card = pa_idxset_next(m->core->cards, &idx))
         subscribe_callback(m->core, PA_SUBSCRIPTION_EVENT_CARD|PA_SUBSCRIPTION_EVENT_NEW, card->index, u);
@@ -357,11 +326,8 @@ void pa__done(pa_module*m) {
     if (u->card_new_hook_slot)
         pa_hook_slot_free(u->card_new_hook_slot);
 
-    if (u->save_time_event)
-        u->core->mainloop->time_free(u->save_time_event);
-
     if (u->database)
-        pa_database_close(u->database);
+        pa_restore_db_close(u->database);
 
     pa_xfree(u);
 }
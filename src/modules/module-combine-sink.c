@@ -44,8 +44,10 @@
 #include <pulsecore/thread.h>
 #include <pulsecore/thread-mq.h>
 #include <pulsecore/rtpoll.h>
+#include <pulsecore/rate-control.h>
 #include <pulsecore/time-smoother.h>
 #include <pulsecore/strlist.h>
+#include <pulsecore/resampler.h>
 
 #include "module-combine-sink-symdef.h"
 
@@ -68,7 +70,7 @@ PA_MODULE_USAGE(
 
 #define MEMBLOCKQ_MAXLENGTH (1024*1024*16)
 
-#define DEFAULT_ADJUST_TIME_USEC (10*PA_USEC_PER_SEC)
+#define DEFAULT_ADJUST_TIME_USEC (1*PA_USEC_PER_SEC)
 
 #define BLOCK_USEC (PA_USEC_PER_MSEC * 200)
 
@@ -85,6 +87,33 @@ static const char* const valid_modargs[] = {
     NULL
 };
 
+/* Outputs that are driven by the same clock and take the same sample
+ * spec and channel map differ only in their latency, so they are fed
+ * from one resampler that runs in our thread, instead of having each
+ * of their sink inputs resample the same data. */
+struct group {
+    struct userdata *userdata;
+
+    pa_sink *clock;
+    pa_sample_spec sample_spec;
+    pa_channel_map channel_map;
+
+    unsigned n_outputs;
+
+    /* The input rate of the resampler, and the rates suggested by the
+     * individual outputs in adjust_rates() */
+    uint32_t rate;
+    uint64_t rate_sum;
+    unsigned n_rates;
+
+    pa_resampler *resampler; /* used from IO thread context */
+
+    struct {
+        uint64_t serial;
+        pa_memchunk chunk;
+    } thread_info;
+};
+
 struct output {
     struct userdata *userdata;
 
@@ -92,6 +121,8 @@ struct output {
     pa_sink_input *sink_input;
     pa_bool_t ignore_state_change;
 
+    struct group *group;
+
     pa_asyncmsgq *inq,    /* Message queue from the sink thread to this sink input */
                  *outq;   /* Message queue from this sink input to the sink thread */
     pa_rtpoll_item *inq_rtpoll_item_read, *inq_rtpoll_item_write;
@@ -102,6 +133,8 @@ struct output {
     /* For communication of the stream latencies to the main thread */
     pa_usec_t total_latency;
 
+    pa_rate_controller *rate_controller;
+
     /* For communication of the stream parameters to the sink thread */
     pa_atomic_t max_request;
     pa_atomic_t requested_latency;
@@ -133,6 +166,7 @@ struct userdata {
     pa_usec_t block_usec;
 
     pa_idxset* outputs; /* managed in main context */
+    pa_idxset* groups; /* managed in main context */
 
     struct {
         PA_LLIST_HEAD(struct output, active_outputs); /* managed in IO thread context */
@@ -141,6 +175,7 @@ struct userdata {
         pa_bool_t in_null_mode;
         pa_smoother *smoother;
         uint64_t counter;
+        uint64_t render_serial;
     } thread_info;
 };
 
@@ -150,7 +185,8 @@ enum {
     SINK_MESSAGE_NEED,
     SINK_MESSAGE_UPDATE_LATENCY,
     SINK_MESSAGE_UPDATE_MAX_REQUEST,
-    SINK_MESSAGE_UPDATE_REQUESTED_LATENCY
+    SINK_MESSAGE_UPDATE_REQUESTED_LATENCY,
+    SINK_MESSAGE_SET_GROUP_RATE
 };
 
 enum {
@@ -164,10 +200,12 @@ static int output_create_sink_input(struct output *o);
 
 static void adjust_rates(struct userdata *u) {
     struct output *o;
+    struct group *g;
     pa_usec_t max_sink_latency = 0, min_total_latency = (pa_usec_t) -1, target_latency, avg_total_latency = 0;
     uint32_t base_rate;
     uint32_t idx;
     unsigned n = 0;
+    pa_usec_t now;
 
     pa_assert(u);
     pa_sink_assert_ref(u->sink);
@@ -214,30 +252,44 @@ static void adjust_rates(struct userdata *u) {
 
     base_rate = u->sink->sample_spec.rate;
 
+    now = pa_rtclock_now();
+
     PA_IDXSET_FOREACH(o, u->outputs, idx) {
-        uint32_t new_rate = base_rate;
-        uint32_t current_rate = o->sink_input->sample_spec.rate;
+        uint32_t new_rate;
 
         if (!o->sink_input || !PA_SINK_IS_OPENED(pa_sink_get_state(o->sink)))
             continue;
 
-        if (o->total_latency != target_latency)
-            new_rate += (uint32_t) (((double) o->total_latency - (double) target_latency) / (double) u->adjust_time * (double) new_rate);
+        /* Outputs that are behind the others in playing back speed up,
+         * the others slow down, in steps small enough to be inaudible */
+        new_rate = pa_rate_controller_update(o->rate_controller, now, (int64_t) o->total_latency - (int64_t) target_latency);
 
-        if (new_rate < (uint32_t) (base_rate*0.8) || new_rate > (uint32_t) (base_rate*1.25)) {
-            pa_log_warn("[%s] sample rates too different, not adjusting (%u vs. %u).", o->sink_input->sink->name, base_rate, new_rate);
-            new_rate = base_rate;
-        } else {
-            if (base_rate < new_rate + 20 && new_rate < base_rate + 20)
-              new_rate = base_rate;
-            /* Do the adjustment in small steps; 2‰ can be considered inaudible */
-            if (new_rate < (uint32_t) (current_rate*0.998) || new_rate > (uint32_t) (current_rate*1.002)) {
-                pa_log_info("[%s] new rate of %u Hz not within 2‰ of %u Hz, forcing smaller adjustment", o->sink_input->sink->name, new_rate, current_rate);
-                new_rate = PA_CLAMP(new_rate, (uint32_t) (current_rate*0.998), (uint32_t) (current_rate*1.002));
-            }
-            pa_log_info("[%s] new rate is %u Hz; ratio is %0.3f; latency is %0.2f msec.", o->sink_input->sink->name, new_rate, (double) new_rate / base_rate, (double) o->total_latency / PA_USEC_PER_MSEC);
-        }
-        pa_sink_input_set_rate(o->sink_input, new_rate);
+        pa_log_info("[%s] new rate is %u Hz; ratio is %0.3f; latency is %0.2f msec.", o->sink_input->sink->name, new_rate, (double) new_rate / base_rate, (double) o->total_latency / PA_USEC_PER_MSEC);
+
+        if (o->group) {
+            o->group->rate_sum += new_rate;
+            o->group->n_rates++;
+        } else
+            pa_sink_input_set_rate(o->sink_input, new_rate);
+    }
+
+    /* The outputs of a group share a clock, so they should all ask for
+     * about the same rate anyway */
+    PA_IDXSET_FOREACH(g, u->groups, idx) {
+        uint32_t new_rate;
+
+        if (g->n_rates <= 0)
+            continue;
+
+        new_rate = (uint32_t) (g->rate_sum / g->n_rates);
+        g->rate_sum = 0;
+        g->n_rates = 0;
+
+        if (new_rate == g->rate)
+            continue;
+
+        g->rate = new_rate;
+        pa_asyncmsgq_send(u->sink->asyncmsgq, PA_MSGOBJECT(u->sink), SINK_MESSAGE_SET_GROUP_RATE, g, (int64_t) new_rate, NULL);
     }
 
     pa_asyncmsgq_send(u->sink->asyncmsgq, PA_MSGOBJECT(u->sink), SINK_MESSAGE_UPDATE_LATENCY, NULL, (int64_t) avg_total_latency, NULL);
@@ -296,8 +348,7 @@ static void thread_func(void *userdata) {
 
     pa_log_debug("Thread starting up");
 
-    if (u->core->realtime_scheduling)
-        pa_make_realtime(u->core->realtime_priority+1);
+    pa_core_setup_io_thread(u->core, u->core->realtime_priority+1, NULL);
 
     pa_thread_mq_install(&u->thread_mq);
 
@@ -347,6 +398,28 @@ finish:
     pa_log_debug("Thread shutting down");
 }
 
+/* Called from I/O thread context. Returns the data to pass to the
+ * output, which is what we rendered, unless the output belongs to a
+ * group. The first output of a group does the resampling for all of
+ * them. */
+static const pa_memchunk *output_convert(struct userdata *u, struct output *o, const pa_memchunk *chunk) {
+    struct group *g;
+
+    if (!(g = o->group))
+        return chunk;
+
+    if (g->thread_info.serial != u->thread_info.render_serial) {
+        g->thread_info.serial = u->thread_info.render_serial;
+
+        if (g->thread_info.chunk.memblock)
+            pa_memblock_unref(g->thread_info.chunk.memblock);
+
+        pa_resampler_run(g->resampler, chunk, &g->thread_info.chunk);
+    }
+
+    return &g->thread_info.chunk;
+}
+
 /* Called from I/O thread context */
 static void render_memblock(struct userdata *u, struct output *o, size_t length) {
     pa_assert(u);
@@ -365,6 +438,11 @@ static void render_memblock(struct userdata *u, struct output *o, size_t length)
     while (pa_asyncmsgq_process_one(o->inq) > 0)
         ;
 
+    /* A message handled before this request in the same batch may have
+     * asked for a rewind */
+    if (u->sink->thread_info.rewind_requested)
+        pa_sink_process_rewind(u->sink, 0);
+
     /* Ok, now let's prepare some data if we really have to */
     while (!pa_memblockq_is_readable(o->memblockq)) {
         struct output *j;
@@ -374,17 +452,25 @@ static void render_memblock(struct userdata *u, struct output *o, size_t length)
         pa_sink_render(u->sink, length, &chunk);
 
         u->thread_info.counter += chunk.length;
+        u->thread_info.render_serial++;
 
         /* OK, let's send this data to the other threads */
         PA_LLIST_FOREACH(j, u->thread_info.active_outputs) {
-            if (j == o)
+            const pa_memchunk *c = output_convert(u, j, &chunk);
+
+            if (j == o || !c->memblock)
                 continue;
 
-            pa_asyncmsgq_post(j->inq, PA_MSGOBJECT(j->sink_input), SINK_INPUT_MESSAGE_POST, NULL, 0, &chunk, NULL);
+            pa_asyncmsgq_post(j->inq, PA_MSGOBJECT(j->sink_input), SINK_INPUT_MESSAGE_POST, NULL, 0, c, NULL);
         }
 
         /* And place it directly into the requesting output's queue */
-        pa_memblockq_push_align(o->memblockq, &chunk);
+        if (o->group) {
+            if (o->group->thread_info.chunk.memblock)
+                pa_memblockq_push_align(o->memblockq, &o->group->thread_info.chunk);
+        } else
+            pa_memblockq_push_align(o->memblockq, &chunk);
+
         pa_memblock_unref(chunk.memblock);
     }
 }
@@ -405,6 +491,10 @@ static void request_memblock(struct output *o, size_t length) {
     if (pa_memblockq_is_readable(o->memblockq))
         return;
 
+    /* The data of a group is in the sample spec of its sinks */
+    if (o->group)
+        length = pa_usec_to_bytes(pa_bytes_to_usec(length, &o->group->sample_spec), &o->userdata->sink->sample_spec);
+
     /* OK, we need to prepare new data, but only if the sink is actually running */
     if (pa_atomic_load(&o->userdata->thread_info.running))
         pa_asyncmsgq_send(o->outq, PA_MSGOBJECT(o->userdata->sink), SINK_MESSAGE_NEED, o, (int64_t) length, NULL);
@@ -657,6 +747,9 @@ static void update_max_request(struct userdata *u) {
     PA_LLIST_FOREACH(o, u->thread_info.active_outputs) {
         size_t mr = (size_t) pa_atomic_load(&o->max_request);
 
+        if (o->group)
+            mr = pa_usec_to_bytes(pa_bytes_to_usec(mr, &o->group->sample_spec), &u->sink->sample_spec);
+
         if (mr > max_request)
             max_request = mr;
     }
@@ -801,6 +894,10 @@ static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offse
         case SINK_MESSAGE_UPDATE_REQUESTED_LATENCY:
             update_fixed_latency(u);
             break;
+
+        case SINK_MESSAGE_SET_GROUP_RATE:
+            pa_resampler_set_input_rate(((struct group*) data)->resampler, (uint32_t) offset);
+            return 0;
 }
 
     return pa_sink_process_msg(o, code, data, offset, chunk);
@@ -841,31 +938,144 @@ static void update_description(struct userdata *u) {
     pa_xfree(t);
 }
 
+/* Called from main context. Follows filter sinks down to the sink
+ * whose clock they run on. */
+static pa_sink *get_clock_sink(pa_sink *s) {
+
+    while (s->input_to_master && s->input_to_master->sink)
+        s = s->input_to_master->sink;
+
+    return s;
+}
+
+/* Called from main context */
+static pa_bool_t output_can_share(struct output *o, struct output *p) {
+
+    return
+        get_clock_sink(o->sink) == get_clock_sink(p->sink) &&
+        pa_sample_spec_equal(&o->sink->sample_spec, &p->sink->sample_spec) &&
+        pa_channel_map_equal(&o->sink->channel_map, &p->sink->channel_map);
+}
+
+/* Called from main context. Returns NULL if no other output could
+ * share the resampling with o. */
+static struct group *group_get(struct userdata *u, struct output *o) {
+    struct group *g;
+    struct output *p;
+    uint32_t idx;
+
+    PA_IDXSET_FOREACH(g, u->groups, idx)
+        if (g->clock == get_clock_sink(o->sink) &&
+            pa_sample_spec_equal(&g->sample_spec, &o->sink->sample_spec) &&
+            pa_channel_map_equal(&g->channel_map, &o->sink->channel_map))
+            goto found;
+
+    PA_IDXSET_FOREACH(p, u->outputs, idx)
+        if (p != o && output_can_share(o, p))
+            break;
+
+    if (!p)
+        return NULL;
+
+    g = pa_xnew0(struct group, 1);
+    g->userdata = u;
+    g->clock = get_clock_sink(o->sink);
+    g->sample_spec = o->sink->sample_spec;
+    g->channel_map = o->sink->channel_map;
+    g->rate = u->sink->sample_spec.rate;
+
+    if (!(g->resampler = pa_resampler_new(u->core->mempool, u->core->resampler_cache,
+                                         &u->sink->sample_spec, &u->sink->channel_map,
+                                         &g->sample_spec, &g->channel_map,
+                                         u->resample_method, PA_RESAMPLER_VARIABLE_RATE))) {
+        pa_xfree(g);
+        return NULL;
+    }
+
+    pa_assert_se(pa_idxset_put(u->groups, g, NULL) == 0);
+
+    pa_log_debug("Sharing the resampler for outputs on the clock of %s.", g->clock->name);
+
+found:
+    g->n_outputs++;
+    return g;
+}
+
+/* Called from main context, once the IO thread is done with o */
+static void group_unref(struct group *g) {
+    pa_assert(g);
+    pa_assert(g->n_outputs > 0);
+
+    if (--g->n_outputs > 0)
+        return;
+
+    pa_assert_se(pa_idxset_remove_by_data(g->userdata->groups, g, NULL));
+
+    if (g->thread_info.chunk.memblock)
+        pa_memblock_unref(g->thread_info.chunk.memblock);
+
+    pa_resampler_free(g->resampler);
+    pa_xfree(g);
+}
+
 static int output_create_sink_input(struct output *o) {
     pa_sink_input_new_data data;
+    pa_memchunk silence;
 
     pa_assert(o);
 
     if (o->sink_input)
         return 0;
 
+    o->group = group_get(o->userdata, o);
+
     pa_sink_input_new_data_init(&data);
     pa_sink_input_new_data_set_sink(&data, o->sink, FALSE);
     data.driver = __FILE__;
     pa_proplist_setf(data.proplist, PA_PROP_MEDIA_NAME, "Simultaneous output on %s", pa_strnull(pa_proplist_gets(o->sink->proplist, PA_PROP_DEVICE_DESCRIPTION)));
     pa_proplist_sets(data.proplist, PA_PROP_MEDIA_ROLE, "filter");
-    pa_sink_input_new_data_set_sample_spec(&data, &o->userdata->sink->sample_spec);
-    pa_sink_input_new_data_set_channel_map(&data, &o->userdata->sink->channel_map);
     data.module = o->userdata->module;
     data.resample_method = o->userdata->resample_method;
-    data.flags = PA_SINK_INPUT_VARIABLE_RATE|PA_SINK_INPUT_DONT_MOVE|PA_SINK_INPUT_NO_CREATE_ON_SUSPEND;
+    data.flags = PA_SINK_INPUT_DONT_MOVE|PA_SINK_INPUT_NO_CREATE_ON_SUSPEND;
+
+    /* The data of a group arrives already resampled */
+    if (o->group) {
+        pa_sink_input_new_data_set_sample_spec(&data, &o->group->sample_spec);
+        pa_sink_input_new_data_set_channel_map(&data, &o->group->channel_map);
+    } else {
+        pa_sink_input_new_data_set_sample_spec(&data, &o->userdata->sink->sample_spec);
+        pa_sink_input_new_data_set_channel_map(&data, &o->userdata->sink->channel_map);
+        data.flags |= PA_SINK_INPUT_VARIABLE_RATE;
+    }
 
     pa_sink_input_new(&o->sink_input, o->userdata->core, &data);
 
     pa_sink_input_new_data_done(&data);
 
-    if (!o->sink_input)
+    if (!o->sink_input) {
+        if (o->group) {
+            group_unref(o->group);
+            o->group = NULL;
+        }
+
         return -1;
+    }
+
+    if (o->memblockq)
+        pa_memblockq_free(o->memblockq);
+
+    pa_sink_input_get_silence(o->sink_input, &silence);
+    o->memblockq = pa_memblockq_new(
+            "module-combine-sink output memblockq",
+            0,
+            MEMBLOCKQ_MAXLENGTH,
+            MEMBLOCKQ_MAXLENGTH,
+            &o->sink_input->sample_spec,
+            1,
+            0,
+            0,
+            &silence);
+    pa_memblock_unref(silence.memblock);
 
     o->sink_input->parent.process_msg = sink_input_process_msg;
     o->sink_input->pop = sink_input_pop_cb;
@@ -880,6 +1090,9 @@ static int output_create_sink_input(struct output *o) {
 
     pa_sink_input_set_requested_latency(o->sink_input, BLOCK_USEC);
 
+    /* A new stream starts off at the nominal rate */
+    pa_rate_controller_reset(o->rate_controller, o->userdata->sink->sample_spec.rate);
+
     return 0;
 }
 
@@ -896,16 +1109,9 @@ static struct output *output_new(struct userdata *u, pa_sink *sink) {
     o->inq = pa_asyncmsgq_new(0);
     o->outq = pa_asyncmsgq_new(0);
     o->sink = sink;
-    o->memblockq = pa_memblockq_new(
-            "module-combine-sink output memblockq",
-            0,
-            MEMBLOCKQ_MAXLENGTH,
-            MEMBLOCKQ_MAXLENGTH,
-            &u->sink->sample_spec,
-            1,
-            0,
-            0,
-            &u->sink->silence);
+
+    /* Settle over ten adjustments, so that latency jitter averages out */
+    o->rate_controller = pa_rate_controller_new(u->sink->sample_spec.rate, 10 * PA_MAX(u->adjust_time, DEFAULT_ADJUST_TIME_USEC));
 
     pa_assert_se(pa_idxset_put(u->outputs, o, NULL) == 0);
     update_description(u);
@@ -941,6 +1147,8 @@ static void output_free(struct output *o) {
     if (o->memblockq)
         pa_memblockq_free(o->memblockq);
 
+    pa_rate_controller_free(o->rate_controller);
+
     pa_xfree(o);
 }
 
@@ -996,6 +1204,11 @@ static void output_disable(struct output *o) {
     pa_sink_input_unref(o->sink_input);
     o->sink_input = NULL;
 
+    if (o->group) {
+        group_unref(o->group);
+        o->group = NULL;
+    }
+
     /* Finally, drop all queued data */
     pa_memblockq_flush_write(o->memblockq, TRUE);
     pa_asyncmsgq_flush(o->inq, FALSE);
@@ -1159,6 +1372,7 @@ int pa__init(pa_module*m) {
     pa_thread_mq_init(&u->thread_mq, m->core->mainloop, u->rtpoll);
     u->resample_method = resample_method;
     u->outputs = pa_idxset_new(NULL, NULL);
+    u->groups = pa_idxset_new(NULL, NULL);
     u->thread_info.smoother = pa_smoother_new(
             PA_USEC_PER_SEC,
             PA_USEC_PER_SEC*2,
@@ -1166,7 +1380,8 @@ int pa__init(pa_module*m) {
             TRUE,
             10,
             pa_rtclock_now(),
-            TRUE);
+            TRUE,
+            FALSE);
 
     adjust_time_sec = DEFAULT_ADJUST_TIME_USEC / PA_USEC_PER_SEC;
     if (pa_modargs_get_value_u32(ma, "adjust_time", &adjust_time_sec) < 0) {
@@ -1389,6 +1604,12 @@ void pa__done(pa_module*m) {
         pa_idxset_free(u->outputs, NULL, NULL);
     }
 
+    /* The groups went away with their last output */
+    if (u->groups) {
+        pa_assert(pa_idxset_isempty(u->groups));
+        pa_idxset_free(u->groups, NULL, NULL);
+    }
+
     if (u->sink)
         pa_sink_unlink(u->sink);
 
@@ -0,0 +1,365 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/hashmap.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/modargs.h>
+#include <pulsecore/module.h>
+#include <pulsecore/rtpoll.h>
+#include <pulsecore/sink.h>
+#include <pulsecore/sink-input.h>
+#include <pulsecore/source.h>
+
+#include "module-cpu-guard-symdef.h"
+
+PA_MODULE_AUTHOR("PulseAudio developers");
+PA_MODULE_DESCRIPTION("Watch the CPU time of the IO threads and cork streams when one is overloaded");
+PA_MODULE_VERSION(PACKAGE_VERSION);
+PA_MODULE_LOAD_ONCE(TRUE);
+PA_MODULE_USAGE(
+        "warn=<percentage of a CPU an IO thread may use before a warning is logged> "
+        "shed=<percentage at which streams of the thread are corked> "
+        "shed_roles=<comma separated media roles of the streams that may be corked, the first one first> "
+        "interval_msec=<how often to check>");
+
+#define DEFAULT_WARN 60
+#define DEFAULT_SHED 85
+#define DEFAULT_SHED_ROLES "event,animation,game,music,video"
+#define DEFAULT_INTERVAL_MSEC 1000
+
+static const char* const valid_modargs[] = {
+    "warn",
+    "shed",
+    "shed_roles",
+    "interval_msec",
+    NULL
+};
+
+/* An IO thread, found through the device that owns it */
+struct thread {
+    pa_rtpoll *rtpoll;
+    uint32_t cpu_usec;
+    pa_bool_t warned;
+};
+
+struct userdata {
+    pa_core *core;
+    pa_module *module;
+
+    uint32_t warn, shed;
+    char **shed_roles;
+    unsigned n_shed_roles;
+    pa_usec_t interval;
+
+    pa_time_event *time_event;
+    pa_usec_t last_time;
+
+    /* The index of the owning device -> struct thread, for sinks and
+     * sources separately */
+    pa_hashmap *sink_threads;
+    pa_hashmap *source_threads;
+
+    /* pa_sink_input -> the pa_rtpoll of the thread it was corked for */
+    pa_hashmap *corked;
+
+    pa_hook_slot *sink_input_unlink_slot;
+};
+
+/* Lower is corked first, -1 is never */
+static int shed_priority(struct userdata *u, pa_sink_input *i) {
+    const char *role;
+    unsigned k;
+
+    if (!(role = pa_proplist_gets(i->proplist, PA_PROP_MEDIA_ROLE)))
+        return -1;
+
+    for (k = 0; k < u->n_shed_roles; k++)
+        if (pa_streq(role, u->shed_roles[k]))
+            return (int) k;
+
+    return -1;
+}
+
+static void cork_one(struct userdata *u, pa_rtpoll *rtpoll, const char *owner) {
+    pa_sink_input *i, *best = NULL;
+    int best_priority = -1;
+    uint32_t idx;
+
+    PA_IDXSET_FOREACH(i, u->core->sink_inputs, idx) {
+        int priority;
+
+        if (!PA_SINK_INPUT_IS_LINKED(i->state) ||
+            !i->sink || i->sink->thread_info.rtpoll != rtpoll ||
+            pa_sink_input_get_state(i) == PA_SINK_INPUT_CORKED ||
+            pa_hashmap_get(u->corked, i))
+            continue;
+
+        if ((priority = shed_priority(u, i)) < 0)
+            continue;
+
+        if (!best || priority < best_priority) {
+            best = i;
+            best_priority = priority;
+        }
+    }
+
+    if (!best)
+        return;
+
+    pa_log_warn("IO thread of %s is overloaded, corking sink input %u (%s).",
+                owner, best->index, pa_strnull(pa_proplist_gets(best->proplist, PA_PROP_MEDIA_ROLE)));
+
+    pa_assert_se(pa_hashmap_put(u->corked, best, rtpoll) >= 0);
+    pa_sink_input_cork_internal(best, TRUE);
+    pa_sink_input_send_event(best, PA_STREAM_EVENT_REQUEST_CORK, NULL);
+}
+
+/* Uncorks the stream that was corked last of all for the thread */
+static void uncork_one(struct userdata *u, pa_rtpoll *rtpoll, const char *owner) {
+    pa_sink_input *last = NULL;
+    const void *i;
+    pa_rtpoll *p;
+    void *state = NULL;
+
+    while ((p = pa_hashmap_iterate(u->corked, &state, &i)))
+        if (p == rtpoll)
+            last = (pa_sink_input*) i;
+
+    if (!last)
+        return;
+
+    pa_log_info("IO thread of %s has recovered, uncorking sink input %u.", owner, last->index);
+
+    pa_hashmap_remove(u->corked, last);
+    pa_sink_input_cork_internal(last, FALSE);
+    pa_sink_input_send_event(last, PA_STREAM_EVENT_REQUEST_UNCORK, NULL);
+}
+
+static void check_thread(struct userdata *u, pa_hashmap *old, pa_hashmap *new, uint32_t idx, pa_rtpoll *rtpoll, const char *owner, pa_bool_t may_shed, pa_usec_t elapsed) {
+    struct thread *t;
+    uint32_t cpu, load;
+
+    cpu = pa_rtpoll_get_cpu_usec(rtpoll);
+
+    if (!(t = pa_hashmap_remove(old, PA_UINT32_TO_PTR(idx))) || t->rtpoll != rtpoll) {
+        pa_xfree(t);
+
+        t = pa_xnew0(struct thread, 1);
+        t->rtpoll = rtpoll;
+        t->cpu_usec = cpu;
+        pa_assert_se(pa_hashmap_put(new, PA_UINT32_TO_PTR(idx), t) >= 0);
+        return;
+    }
+
+    pa_assert_se(pa_hashmap_put(new, PA_UINT32_TO_PTR(idx), t) >= 0);
+
+    load = elapsed > 0 ? (uint32_t) ((pa_usec_t) (cpu - t->cpu_usec) * 100 / elapsed) : 0;
+    t->cpu_usec = cpu;
+
+    if (load >= u->warn) {
+        if (!t->warned)
+            pa_log_warn("IO thread of %s uses %u%% of a CPU.", owner, load);
+
+        t->warned = TRUE;
+
+        if (may_shed && load >= u->shed)
+            cork_one(u, rtpoll, owner);
+
+    } else {
+        if (t->warned)
+            pa_log_info("IO thread of %s is down to %u%% of a CPU.", owner, load);
+
+        t->warned = FALSE;
+        uncork_one(u, rtpoll, owner);
+    }
+}
+
+static void free_thread(void *p, void *userdata) {
+    pa_xfree(p);
+}
+
+static void check(struct userdata *u) {
+    pa_hashmap *sink_threads, *source_threads;
+    pa_sink *sink;
+    pa_source *source;
+    uint32_t idx;
+    pa_usec_t now, elapsed;
+
+    now = pa_rtclock_now();
+    elapsed = now - u->last_time;
+    u->last_time = now;
+
+    sink_threads = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+
+    /* Filter sinks run in the thread of their master */
+    PA_IDXSET_FOREACH(sink, u->core->sinks, idx)
+        if (PA_SINK_IS_LINKED(sink->state) && !sink->input_to_master && sink->thread_info.rtpoll)
+            check_thread(u, u->sink_threads, sink_threads, sink->index, sink->thread_info.rtpoll, sink->name, TRUE, elapsed);
+
+    pa_hashmap_free(u->sink_threads, free_thread, NULL);
+    u->sink_threads = sink_threads;
+
+    source_threads = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+
+    /* Recording streams aren't corked, as they'd lose data */
+    PA_IDXSET_FOREACH(source, u->core->sources, idx)
+        if (PA_SOURCE_IS_LINKED(source->state) && !source->monitor_of && !source->output_from_master && source->thread_info.rtpoll)
+            check_thread(u, u->source_threads, source_threads, source->index, source->thread_info.rtpoll, source->name, FALSE, elapsed);
+
+    pa_hashmap_free(u->source_threads, free_thread, NULL);
+    u->source_threads = source_threads;
+}
+
+static void time_cb(pa_mainloop_api *a, pa_time_event *e, const struct timeval *t, void *userdata) {
+    struct userdata *u = userdata;
+
+    pa_assert(u);
+    pa_assert(e == u->time_event);
+
+    check(u);
+
+    pa_core_rttime_restart(u->core, e, pa_rtclock_now() + u->interval);
+}
+
+static pa_hook_result_t sink_input_unlink_cb(pa_core *c, pa_sink_input *i, struct userdata *u) {
+    pa_assert(u);
+
+    pa_hashmap_remove(u->corked, i);
+
+    return PA_HOOK_OK;
+}
+
+int pa__init(pa_module*m) {
+    pa_modargs *ma = NULL;
+    struct userdata *u;
+    uint32_t warn = DEFAULT_WARN, shed = DEFAULT_SHED, interval_msec = DEFAULT_INTERVAL_MSEC;
+    const char *roles, *split_state = NULL;
+    char *n;
+
+    pa_assert(m);
+
+    if (!(ma = pa_modargs_new(m->argument, valid_modargs))) {
+        pa_log("Failed to parse module arguments");
+        goto fail;
+    }
+
+    if (pa_modargs_get_value_u32(ma, "warn", &warn) < 0 ||
+        pa_modargs_get_value_u32(ma, "shed", &shed) < 0 ||
+        warn <= 0 || shed < warn) {
+        pa_log("Invalid warn or shed load, they have to be percentages with warn <= shed.");
+        goto fail;
+    }
+
+    if (pa_modargs_get_value_u32(ma, "interval_msec", &interval_msec) < 0 || interval_msec < 10) {
+        pa_log("Invalid interval, it has to be at least 10 ms.");
+        goto fail;
+    }
+
+    m->userdata = u = pa_xnew0(struct userdata, 1);
+    u->core = m->core;
+    u->module = m;
+    u->warn = warn;
+    u->shed = shed;
+    u->interval = (pa_usec_t) interval_msec * PA_USEC_PER_MSEC;
+
+    roles = pa_modargs_get_value(ma, "shed_roles", DEFAULT_SHED_ROLES);
+
+    while ((n = pa_split(roles, ",", &split_state))) {
+        if (n[0] == 0) {
+            pa_xfree(n);
+            continue;
+        }
+
+        u->shed_roles = pa_xrenew(char*, u->shed_roles, u->n_shed_roles + 1);
+        u->shed_roles[u->n_shed_roles++] = n;
+    }
+
+    pa_modargs_free(ma);
+    ma = NULL;
+
+    u->sink_threads = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+    u->source_threads = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+    u->corked = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+
+    u->sink_input_unlink_slot = pa_hook_connect(&m->core->hooks[PA_CORE_HOOK_SINK_INPUT_UNLINK], PA_HOOK_LATE, (pa_hook_cb_t) sink_input_unlink_cb, u);
+
+    u->last_time = pa_rtclock_now();
+    check(u);
+    u->time_event = pa_core_rttime_new(u->core, u->last_time + u->interval, time_cb, u);
+
+    return 0;
+
+fail:
+    if (ma)
+        pa_modargs_free(ma);
+
+    pa__done(m);
+
+    return -1;
+}
+
+void pa__done(pa_module*m) {
+    struct userdata* u;
+    pa_sink_input *i;
+    unsigned k;
+
+    pa_assert(m);
+
+    if (!(u = m->userdata))
+        return;
+
+    if (u->time_event)
+        u->core->mainloop->time_free(u->time_event);
+
+    if (u->sink_input_unlink_slot)
+        pa_hook_slot_free(u->sink_input_unlink_slot);
+
+    if (u->corked) {
+        while ((i = pa_hashmap_first(u->corked))) {
+            pa_hashmap_remove(u->corked, i);
+            pa_sink_input_cork_internal(i, FALSE);
+            pa_sink_input_send_event(i, PA_STREAM_EVENT_REQUEST_UNCORK, NULL);
+        }
+
+        pa_hashmap_free(u->corked, NULL, NULL);
+    }
+
+    if (u->sink_threads)
+        pa_hashmap_free(u->sink_threads, free_thread, NULL);
+
+    if (u->source_threads)
+        pa_hashmap_free(u->source_threads, free_thread, NULL);
+
+    for (k = 0; k < u->n_shed_roles; k++)
+        pa_xfree(u->shed_roles[k]);
+
+    pa_xfree(u->shed_roles);
+    pa_xfree(u);
+}
@@ -4,6 +4,11 @@ define(`c_symbol', patsubst(module_name, `[^0-9a-zA-Z]', `_'))dnl
 define(`c_macro', patsubst(module_name, `[^0-9a-zA-Z]', `'))dnl
 define(`incmacro', `foo'c_macro`symdeffoo')dnl
 define(`gen_symbol', `#define $1 'module_name`_LTX_$1')dnl
+define(`module_file', patsubst(patsubst(fname, `-symdef.h$'), `^.*/'))dnl
+dnl With -Dbuiltin_entry only the entry for daemon/builtin-modules.h is written
+ifdef(`builtin_entry', `dnl
+PA_BUILTIN_MODULE("'module_file`", 'module_name`)
+divert(-1)')dnl
 #ifndef incmacro
 #define incmacro
 
@@ -48,7 +48,7 @@
 #include <pulsecore/protocol-native.h>
 #include <pulsecore/pstream.h>
 #include <pulsecore/pstream-util.h>
-#include <pulsecore/database.h>
+#include <pulsecore/restore-store.h>
 #include <pulsecore/tagstruct.h>
 
 #include "module-device-manager-symdef.h"
@@ -62,7 +62,6 @@ PA_MODULE_USAGE(
     "on_hotplug=<When new device becomes available, recheck streams?> "
     "on_rescue=<When device becomes unavailable, recheck streams?>");
 
-#define SAVE_INTERVAL (10 * PA_USEC_PER_SEC)
 #define DUMP_DATABASE
 
 static const char* const valid_modargs[] = {
@@ -114,8 +113,7 @@ struct userdata {
         *sink_unlink_hook_slot,
         *source_unlink_hook_slot,
         *connection_unlink_hook_slot;
-    pa_time_event *save_time_event;
-    pa_database *database;
+    pa_restore_db *database;
 
     pa_native_protocol *protocol;
     pa_idxset *subscribed;
@@ -126,6 +124,10 @@ struct userdata {
 
     role_indexes_t preferred_sinks;
     role_indexes_t preferred_sources;
+
+    /* The priorities of the devices above, 0 where there is none */
+    role_indexes_t preferred_sink_priorities;
+    role_indexes_t preferred_source_priorities;
 };
 
 #define ENTRY_VERSION 1
@@ -156,36 +158,13 @@ static void dump_database(struct userdata *);
 #endif
 static void notify_subscribers(struct userdata *);
 
-
-static void save_time_callback(pa_mainloop_api*a, pa_time_event* e, const struct timeval *t, void *userdata) {
-    struct userdata *u = userdata;
-
-    pa_assert(a);
-    pa_assert(e);
-    pa_assert(u);
-
-    pa_assert(e == u->save_time_event);
-    u->core->mainloop->time_free(u->save_time_event);
-    u->save_time_event = NULL;
-
-    pa_database_sync(u->database);
-    pa_log_info("Synced.");
-
-#ifdef DUMP_DATABASE
-    dump_database(u);
-#endif
-}
-
 static void trigger_save(struct userdata *u) {
 
     pa_assert(u);
 
     notify_subscribers(u);
 
-    if (u->save_time_event)
-        return;
-
-    u->save_time_event = pa_core_rttime_new(u->core, pa_rtclock_now() + SAVE_INTERVAL, save_time_callback, u);
+    pa_restore_db_save(u->database);
 }
 
 static struct entry* entry_new(void) {
@@ -224,7 +203,7 @@ static pa_bool_t entry_write(struct userdata *u, const char *name, const struct
 
     data.data = (void*)pa_tagstruct_data(t, &data.size);
 
-    r = (pa_database_set(u->database, &key, &data, TRUE) == 0);
+    r = (pa_restore_db_set(u->database, &key, &data, TRUE) == 0);
 
     pa_tagstruct_free(t);
 
@@ -291,7 +270,7 @@ static struct entry* entry_read(struct userdata *u, const char *name) {
 
     pa_zero(data);
 
-    if (!pa_database_get(u->database, &key, &data))
+    if (!pa_restore_db_get(u->database, &key, &data))
         goto fail;
 
     t = pa_tagstruct_new(data.data, data.size);
@@ -372,7 +351,7 @@ static void dump_database(struct userdata *u) {
 
     pa_assert(u);
 
-    done = !pa_database_first(u->database, &key, NULL);
+    done = !pa_restore_db_first(u->database, &key, NULL);
 
     pa_log_debug("Dumping database");
     while (!done) {
@@ -380,7 +359,7 @@ static void dump_database(struct userdata *u) {
         struct entry *e;
         pa_datum next_key;
 
-        done = !pa_database_next(u->database, &key, &next_key, NULL);
+        done = !pa_restore_db_next(u->database, &key, &next_key, NULL);
 
         name = pa_xstrndup(key.data, key.size);
 
@@ -495,13 +474,13 @@ static inline struct entry *load_or_initialize_entry(struct userdata *u, struct
         pa_bool_t done;
 
         pa_zero(max_priority);
-        done = !pa_database_first(u->database, &key, NULL);
+        done = !pa_restore_db_first(u->database, &key, NULL);
 
         /* Find all existing devices with the same prefix so we calculate the current max priority for each role */
         while (!done) {
             pa_datum next_key;
 
-            done = !pa_database_next(u->database, &key, &next_key, NULL);
+            done = !pa_restore_db_next(u->database, &key, &next_key, NULL);
 
             if (key.size > strlen(prefix) && strncmp(key.data, prefix, strlen(prefix)) == 0) {
                 char *name2;
@@ -543,8 +522,36 @@ static uint32_t get_role_index(const char* role) {
     return PA_INVALID_INDEX;
 }
 
+/* Returns the index of the device called device_name if it is there,
+ * PA_INVALID_INDEX otherwise */
+static uint32_t get_device_index(struct userdata *u, const char *device_name, pa_bool_t sink_mode, void *ignore_device) {
+    if (sink_mode) {
+        pa_sink *sink;
+
+        if ((sink = pa_namereg_get(u->core, device_name, PA_NAMEREG_SINK)) && (void*) sink != ignore_device)
+            return sink->index;
+    } else {
+        pa_source *source;
+
+        if ((source = pa_namereg_get(u->core, device_name, PA_NAMEREG_SOURCE)) && (void*) source != ignore_device)
+            return source->index;
+    }
+
+    return PA_INVALID_INDEX;
+}
+
+/* Makes the device at idx with the priorities of e the preferred one
+ * for the roles where it beats the current one */
+static void offer_device(role_indexes_t *indexes, role_indexes_t *priorities, uint32_t idx, const struct entry *e) {
+    for (uint32_t i = 0; i < NUM_ROLES; ++i)
+        if (!(*priorities)[i] || e->priority[i] < (*priorities)[i]) {
+            (*priorities)[i] = e->priority[i];
+            (*indexes)[i] = idx;
+        }
+}
+
 static void update_highest_priority_device_indexes(struct userdata *u, const char *prefix, void *ignore_device) {
-    role_indexes_t *indexes, highest_priority_available;
+    role_indexes_t *indexes, *priorities;
     pa_datum key;
     pa_bool_t done, sink_mode;
 
@@ -553,73 +560,42 @@ static void update_highest_priority_device_indexes(struct userdata *u, const cha
 
     sink_mode = (strcmp(prefix, "sink:") == 0);
 
-    if (sink_mode)
+    if (sink_mode) {
         indexes = &u->preferred_sinks;
-    else
+        priorities = &u->preferred_sink_priorities;
+    } else {
         indexes = &u->preferred_sources;
+        priorities = &u->preferred_source_priorities;
+    }
 
     for (uint32_t i = 0; i < NUM_ROLES; ++i) {
         (*indexes)[i] = PA_INVALID_INDEX;
     }
-    pa_zero(highest_priority_available);
+    pa_zero(*priorities);
 
-    done = !pa_database_first(u->database, &key, NULL);
+    done = !pa_restore_db_first(u->database, &key, NULL);
 
     /* Find all existing devices with the same prefix so we find the highest priority device for each role */
     while (!done) {
         pa_datum next_key;
 
-        done = !pa_database_next(u->database, &key, &next_key, NULL);
+        done = !pa_restore_db_next(u->database, &key, &next_key, NULL);
 
         if (key.size > strlen(prefix) && strncmp(key.data, prefix, strlen(prefix)) == 0) {
             char *name, *device_name;
-            struct entry *e;
+            uint32_t idx;
 
             name = pa_xstrndup(key.data, key.size);
             pa_assert_se(device_name = get_name(name, prefix));
 
-            if ((e = entry_read(u, name))) {
-                for (uint32_t i = 0; i < NUM_ROLES; ++i) {
-                    if (!highest_priority_available[i] || e->priority[i] < highest_priority_available[i]) {
-                        /* We've found a device with a higher priority than that we've currently got,
-                           so see if it is currently available or not and update our list */
-                        uint32_t idx;
-                        pa_bool_t found = FALSE;
-
-                        if (sink_mode) {
-                            pa_sink *sink;
-
-                            PA_IDXSET_FOREACH(sink, u->core->sinks, idx) {
-                                if ((pa_sink*) ignore_device == sink)
-                                    continue;
-                                if (strcmp(sink->name, device_name) == 0) {
-                                    found = TRUE;
-                                    idx = sink->index; /* Is this needed? */
-                                    break;
-                                }
-                            }
-                        } else {
-                            pa_source *source;
-
-                            PA_IDXSET_FOREACH(source, u->core->sources, idx) {
-                                if ((pa_source*) ignore_device == source)
-                                    continue;
-                                if (strcmp(source->name, device_name) == 0) {
-                                    found = TRUE;
-                                    idx = source->index; /* Is this needed? */
-                                    break;
-                                }
-                            }
-                        }
-                        if (found) {
-                            highest_priority_available[i] = e->priority[i];
-                            (*indexes)[i] = idx;
-                        }
+            /* Only devices that are there are of interest */
+            if ((idx = get_device_index(u, device_name, sink_mode, ignore_device)) != PA_INVALID_INDEX) {
+                struct entry *e;
 
-                    }
+                if ((e = entry_read(u, name))) {
+                    offer_device(indexes, priorities, idx, e);
+                    entry_free(e);
                 }
-
-                entry_free(e);
             }
 
             pa_xfree(name);
@@ -631,9 +607,48 @@ static void update_highest_priority_device_indexes(struct userdata *u, const cha
     }
 }
 
+/* Updates the preferred devices for a device that just appeared,
+ * without going through the whole database */
+static void add_highest_priority_device(struct userdata *u, const char *prefix, const char *device_name, uint32_t idx) {
+    struct entry *e;
+    char *name;
 
-static void route_sink_input(struct userdata *u, pa_sink_input *si) {
+    pa_assert(u);
+    pa_assert(prefix);
+    pa_assert(device_name);
+
+    name = pa_sprintf_malloc("%s%s", prefix, device_name);
+
+    if ((e = entry_read(u, name))) {
+        if (strcmp(prefix, "sink:") == 0)
+            offer_device(&u->preferred_sinks, &u->preferred_sink_priorities, idx, e);
+        else
+            offer_device(&u->preferred_sources, &u->preferred_source_priorities, idx, e);
+
+        entry_free(e);
+    }
+
+    pa_xfree(name);
+}
+
+static pa_bool_t is_preferred_device(const role_indexes_t indexes, uint32_t idx) {
+    for (uint32_t i = 0; i < NUM_ROLES; ++i)
+        if (indexes[i] == idx)
+            return TRUE;
+
+    return FALSE;
+}
+
+static uint32_t get_stream_role_index(pa_proplist *p) {
     const char *role;
+
+    if (!(role = pa_proplist_gets(p, PA_PROP_MEDIA_ROLE)))
+        return get_role_index("none");
+
+    return get_role_index(role);
+}
+
+static void route_sink_input(struct userdata *u, pa_sink_input *si) {
     uint32_t role_index, device_index;
     pa_sink *sink;
 
@@ -653,12 +668,7 @@ static void route_sink_input(struct userdata *u, pa_sink_input *si) {
     if (!PA_SINK_INPUT_IS_LINKED(pa_sink_input_get_state(si)))
         return;
 
-    if (!(role = pa_proplist_gets(si->proplist, PA_PROP_MEDIA_ROLE)))
-        role_index = get_role_index("none");
-    else
-        role_index = get_role_index(role);
-
-    if (PA_INVALID_INDEX == role_index)
+    if (PA_INVALID_INDEX == (role_index = get_stream_role_index(si->proplist)))
         return;
 
     device_index = u->preferred_sinks[role_index];
@@ -672,26 +682,41 @@ static void route_sink_input(struct userdata *u, pa_sink_input *si) {
         pa_sink_input_move_to(si, sink, FALSE);
 }
 
-static pa_hook_result_t route_sink_inputs(struct userdata *u, pa_sink *ignore_sink) {
+/* Routes the streams of the roles whose preferred sink is no longer
+ * the one in previous. Those of the other roles are where they belong
+ * already. */
+static void reroute_sink_inputs(struct userdata *u, const role_indexes_t previous) {
     pa_sink_input *si;
-    uint32_t idx;
+    uint32_t idx, role_index;
+
+    if (memcmp(previous, u->preferred_sinks, sizeof(role_indexes_t)) == 0)
+        return;
+
+    PA_IDXSET_FOREACH(si, u->core->sink_inputs, idx) {
+        if ((role_index = get_stream_role_index(si->proplist)) == PA_INVALID_INDEX ||
+            previous[role_index] == u->preferred_sinks[role_index])
+            continue;
+
+        route_sink_input(u, si);
+    }
+}
+
+static pa_hook_result_t route_sink_inputs(struct userdata *u, pa_sink *ignore_sink) {
+    role_indexes_t previous;
 
     pa_assert(u);
 
     if (!u->do_routing)
         return PA_HOOK_OK;
 
+    memcpy(previous, u->preferred_sinks, sizeof(previous));
     update_highest_priority_device_indexes(u, "sink:", ignore_sink);
-
-    PA_IDXSET_FOREACH(si, u->core->sink_inputs, idx) {
-        route_sink_input(u, si);
-    }
+    reroute_sink_inputs(u, previous);
 
     return PA_HOOK_OK;
 }
 
 static void route_source_output(struct userdata *u, pa_source_output *so) {
-    const char *role;
     uint32_t role_index, device_index;
     pa_source *source;
 
@@ -714,12 +739,7 @@ static void route_source_output(struct userdata *u, pa_source_output *so) {
     if (!PA_SOURCE_OUTPUT_IS_LINKED(pa_source_output_get_state(so)))
         return;
 
-    if (!(role = pa_proplist_gets(so->proplist, PA_PROP_MEDIA_ROLE)))
-        role_index = get_role_index("none");
-    else
-        role_index = get_role_index(role);
-
-    if (PA_INVALID_INDEX == role_index)
+    if (PA_INVALID_INDEX == (role_index = get_stream_role_index(so->proplist)))
         return;
 
     device_index = u->preferred_sources[role_index];
@@ -733,20 +753,33 @@ static void route_source_output(struct userdata *u, pa_source_output *so) {
         pa_source_output_move_to(so, source, FALSE);
 }
 
-static pa_hook_result_t route_source_outputs(struct userdata *u, pa_source* ignore_source) {
+static void reroute_source_outputs(struct userdata *u, const role_indexes_t previous) {
     pa_source_output *so;
-    uint32_t idx;
+    uint32_t idx, role_index;
+
+    if (memcmp(previous, u->preferred_sources, sizeof(role_indexes_t)) == 0)
+        return;
+
+    PA_IDXSET_FOREACH(so, u->core->source_outputs, idx) {
+        if ((role_index = get_stream_role_index(so->proplist)) == PA_INVALID_INDEX ||
+            previous[role_index] == u->preferred_sources[role_index])
+            continue;
+
+        route_source_output(u, so);
+    }
+}
+
+static pa_hook_result_t route_source_outputs(struct userdata *u, pa_source* ignore_source) {
+    role_indexes_t previous;
 
     pa_assert(u);
 
     if (!u->do_routing)
         return PA_HOOK_OK;
 
+    memcpy(previous, u->preferred_sources, sizeof(previous));
     update_highest_priority_device_indexes(u, "source:", ignore_source);
-
-    PA_IDXSET_FOREACH(so, u->core->source_outputs, idx) {
-        route_source_output(u, so);
-    }
+    reroute_source_outputs(u, previous);
 
     return PA_HOOK_OK;
 }
@@ -1004,26 +1037,47 @@ static pa_hook_result_t source_output_new_hook_callback(pa_core *c, pa_source_ou
 }
 
 
-static pa_hook_result_t sink_put_hook_callback(pa_core *c, PA_GCC_UNUSED pa_sink *sink, struct userdata *u) {
+static pa_hook_result_t sink_put_hook_callback(pa_core *c, pa_sink *sink, struct userdata *u) {
+    role_indexes_t previous;
+
     pa_assert(c);
+    pa_assert(sink);
     pa_assert(u);
     pa_assert(u->core == c);
     pa_assert(u->on_hotplug);
 
     notify_subscribers(u);
 
-    return route_sink_inputs(u, NULL);
+    if (!u->do_routing)
+        return PA_HOOK_OK;
+
+    /* A new sink can only take over roles, check just that one */
+    memcpy(previous, u->preferred_sinks, sizeof(previous));
+    add_highest_priority_device(u, "sink:", sink->name, sink->index);
+    reroute_sink_inputs(u, previous);
+
+    return PA_HOOK_OK;
 }
 
-static pa_hook_result_t source_put_hook_callback(pa_core *c, PA_GCC_UNUSED pa_source *source, struct userdata *u) {
+static pa_hook_result_t source_put_hook_callback(pa_core *c, pa_source *source, struct userdata *u) {
+    role_indexes_t previous;
+
     pa_assert(c);
+    pa_assert(source);
     pa_assert(u);
     pa_assert(u->core == c);
     pa_assert(u->on_hotplug);
 
     notify_subscribers(u);
 
-    return route_source_outputs(u, NULL);
+    if (!u->do_routing)
+        return PA_HOOK_OK;
+
+    memcpy(previous, u->preferred_sources, sizeof(previous));
+    add_highest_priority_device(u, "source:", source->name, source->index);
+    reroute_source_outputs(u, previous);
+
+    return PA_HOOK_OK;
 }
 
 static pa_hook_result_t sink_unlink_hook_callback(pa_core *c, pa_sink *sink, struct userdata *u) {
@@ -1039,6 +1093,10 @@ static pa_hook_result_t sink_unlink_hook_callback(pa_core *c, pa_sink *sink, str
 
     notify_subscribers(u);
 
+    /* Nothing changes unless the sink was preferred for some role */
+    if (!is_preferred_device(u->preferred_sinks, sink->index))
+        return PA_HOOK_OK;
+
     return route_sink_inputs(u, sink);
 }
 
@@ -1055,6 +1113,9 @@ static pa_hook_result_t source_unlink_hook_callback(pa_core *c, pa_source *sourc
 
     notify_subscribers(u);
 
+    if (!is_preferred_device(u->preferred_sources, source->index))
+        return PA_HOOK_OK;
+
     return route_source_outputs(u, source);
 }
 
@@ -1139,14 +1200,14 @@ static int extension_cb(pa_native_protocol *p, pa_module *m, pa_native_connectio
       if (!pa_tagstruct_eof(t))
         goto fail;
 
-      done = !pa_database_first(u->database, &key, NULL);
+      done = !pa_restore_db_first(u->database, &key, NULL);
 
       while (!done) {
         pa_datum next_key;
         struct entry *e;
         char *name;
 
-        done = !pa_database_next(u->database, &key, &next_key, NULL);
+        done = !pa_restore_db_next(u->database, &key, &next_key, NULL);
 
         name = pa_xstrndup(key.data, key.size);
         pa_datum_free(&key);
@@ -1244,7 +1305,7 @@ static int extension_cb(pa_native_protocol *p, pa_module *m, pa_native_connectio
         key.size = strlen(name);
 
         /** @todo: Reindex the priorities */
-        pa_database_unset(u->database, &key);
+        pa_restore_db_unset(u->database, &key);
       }
 
       trigger_save(u);
@@ -1356,12 +1417,12 @@ static int extension_cb(pa_native_protocol *p, pa_module *m, pa_native_connectio
            not specified in the device list (and thus will be
            tacked on at the end) */
         offset = idx;
-        done = !pa_database_first(u->database, &key, NULL);
+        done = !pa_restore_db_first(u->database, &key, NULL);
 
         while (!done && idx < 256) {
             pa_datum next_key;
 
-            done = !pa_database_next(u->database, &key, &next_key, NULL);
+            done = !pa_restore_db_next(u->database, &key, &next_key, NULL);
 
             device = pa_xnew(struct device_t, 1);
             device->device = pa_xstrndup(key.data, key.size);
@@ -1505,7 +1566,6 @@ struct prioritised_indexes {
 int pa__init(pa_module*m) {
     pa_modargs *ma = NULL;
     struct userdata *u;
-    char *fname;
     pa_sink *sink;
     pa_source *source;
     uint32_t idx;
@@ -1562,18 +1622,9 @@ int pa__init(pa_module*m) {
         u->source_unlink_hook_slot = pa_hook_connect(&m->core->hooks[PA_CORE_HOOK_SOURCE_UNLINK], PA_HOOK_LATE+5, (pa_hook_cb_t) source_unlink_hook_callback, u);
     }
 
-    if (!(fname = pa_state_path("device-manager", TRUE)))
+    if (!(u->database = pa_restore_db_open(m->core, "device-manager")))
         goto fail;
 
-    if (!(u->database = pa_database_open(fname, TRUE))) {
-        pa_log("Failed to open volume database '%s': %s", fname, pa_cstrerror(errno));
-        pa_xfree(fname);
-        goto fail;
-    }
-
-    pa_log_info("Successfully opened database file '%s'.", fname);
-    pa_xfree(fname);
-
     /* Attempt to inject the devices into the list in priority order */
     total_devices = PA_MAX(pa_idxset_size(m->core->sinks), pa_idxset_size(m->core->sources));
     if (total_devices > 0 && total_devices < 128) {
@@ -1687,11 +1738,8 @@ void pa__done(pa_module*m) {
     if (u->connection_unlink_hook_slot)
         pa_hook_slot_free(u->connection_unlink_hook_slot);
 
-    if (u->save_time_event)
-        u->core->mainloop->time_free(u->save_time_event);
-
     if (u->database)
-        pa_database_close(u->database);
+        pa_restore_db_close(u->database);
 
     if (u->protocol) {
         pa_native_protocol_remove_ext(u->protocol, m);
@@ -51,7 +51,7 @@
 #include <pulsecore/protocol-native.h>
 #include <pulsecore/pstream.h>
 #include <pulsecore/pstream-util.h>
-#include <pulsecore/database.h>
+#include <pulsecore/restore-store.h>
 #include <pulsecore/tagstruct.h>
 
 #include "module-device-restore-symdef.h"
@@ -66,8 +66,6 @@ PA_MODULE_USAGE(
         "restore_muted=<Save/restore muted states?> "
         "restore_formats=<Save/restore saved formats?>");
 
-#define SAVE_INTERVAL (10 * PA_USEC_PER_SEC)
-
 static const char* const valid_modargs[] = {
     "restore_volume",
     "restore_muted",
@@ -89,8 +87,7 @@ struct userdata {
         *source_fixate_hook_slot,
         *source_port_hook_slot,
         *connection_unlink_hook_slot;
-    pa_time_event *save_time_event;
-    pa_database *database;
+    pa_restore_db *database;
 
     pa_native_protocol *protocol;
     pa_idxset *subscribed;
@@ -131,21 +128,6 @@ struct perportentry {
     pa_idxset *formats;
 };
 
-static void save_time_callback(pa_mainloop_api*a, pa_time_event* e, const struct timeval *t, void *userdata) {
-    struct userdata *u = userdata;
-
-    pa_assert(a);
-    pa_assert(e);
-    pa_assert(u);
-
-    pa_assert(e == u->save_time_event);
-    u->core->mainloop->time_free(u->save_time_event);
-    u->save_time_event = NULL;
-
-    pa_database_sync(u->database);
-    pa_log_info("Synced.");
-}
-
 static void trigger_save(struct userdata *u, pa_device_type_t type, uint32_t sink_idx) {
     pa_native_connection *c;
     uint32_t idx;
@@ -167,10 +149,7 @@ static void trigger_save(struct userdata *u, pa_device_type_t type, uint32_t sin
         }
     }
 
-    if (u->save_time_event)
-        return;
-
-    u->save_time_event = pa_core_rttime_new(u->core, pa_rtclock_now() + SAVE_INTERVAL, save_time_callback, u);
+    pa_restore_db_save(u->database);
 }
 
 
@@ -214,7 +193,7 @@ static pa_bool_t entry_write(struct userdata *u, const char *name, const struct
 
     data.data = (void*)pa_tagstruct_data(t, &data.size);
 
-    r = (pa_database_set(u->database, &key, &data, TRUE) == 0);
+    r = (pa_restore_db_set(u->database, &key, &data, TRUE) == 0);
 
     pa_tagstruct_free(t);
 
@@ -235,7 +214,7 @@ static struct entry* entry_read(struct userdata *u, const char *name) {
 
     pa_zero(data);
 
-    if (!pa_database_get(u->database, &key, &data))
+    if (!pa_restore_db_get(u->database, &key, &data))
         goto fail;
 
     t = pa_tagstruct_new(data.data, data.size);
@@ -391,7 +370,7 @@ static pa_bool_t perportentry_write(struct userdata *u, const char *basekeyname,
 
     data.data = (void*)pa_tagstruct_data(t, &data.size);
 
-    r = (pa_database_set(u->database, &key, &data, TRUE) == 0);
+    r = (pa_restore_db_set(u->database, &key, &data, TRUE) == 0);
 
     pa_tagstruct_free(t);
     pa_xfree(name);
@@ -416,7 +395,7 @@ static struct perportentry* perportentry_read(struct userdata *u, const char *ba
 
     pa_zero(data);
 
-    if (!pa_database_get(u->database, &key, &data))
+    if (!pa_restore_db_get(u->database, &key, &data))
         goto fail;
 
     t = pa_tagstruct_new(data.data, data.size);
@@ -1206,7 +1185,6 @@ static pa_hook_result_t connection_unlink_hook_cb(pa_native_protocol *p, pa_nati
 int pa__init(pa_module*m) {
     pa_modargs *ma = NULL;
     struct userdata *u;
-    char *fname;
     pa_sink *sink;
     pa_source *source;
     uint32_t idx;
@@ -1263,17 +1241,8 @@ int pa__init(pa_module*m) {
     if (restore_formats)
         u->sink_put_hook_slot = pa_hook_connect(&m->core->hooks[PA_CORE_HOOK_SINK_PUT], PA_HOOK_EARLY, (pa_hook_cb_t) sink_put_hook_callback, u);
 
-    if (!(fname = pa_state_path("device-volumes", TRUE)))
-        goto fail;
-
-    if (!(u->database = pa_database_open(fname, TRUE))) {
-        pa_log("Failed to open volume database '%s': %s", fname, pa_cstrerror(errno));
-        pa_xfree(fname);
+    if (!(u->database = pa_restore_db_open(m->core, "device-volumes")))
         goto fail;
-    }
-
-    pa_log_info("Successfully opened database file '%s'.", fname);
-    pa_xfree(fname);
 
     for (sink = pa_idxset_first(m->core->sinks, &idx); sink; sink = pa_idxset_next(m->core->sinks, &idx))
         subscribe_callback(m->core, PA_SUBSCRIPTION_EVENT_SINK|PA_SUBSCRIPTION_EVENT_NEW, sink->index, u);
@@ -1322,11 +1291,8 @@ void pa__done(pa_module*m) {
     if (u->connection_unlink_hook_slot)
         pa_hook_slot_free(u->connection_unlink_hook_slot);
 
-    if (u->save_time_event)
-        u->core->mainloop->time_free(u->save_time_event);
-
     if (u->database)
-        pa_database_close(u->database);
+        pa_restore_db_close(u->database);
 
     if (u->protocol) {
         pa_native_protocol_remove_ext(u->protocol, m);
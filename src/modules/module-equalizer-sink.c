@@ -37,12 +37,6 @@
 #include <string.h>
 #include <stdint.h>
 
-//#undef __SSE2__
-#ifdef __SSE2__
-#include <xmmintrin.h>
-#include <emmintrin.h>
-#endif
-
 #include <fftw3.h>
 
 #include <pulse/xmalloc.h>
@@ -66,6 +60,7 @@
 #include <pulsecore/protocol-dbus.h>
 #include <pulsecore/dbus-util.h>
 
+#include "convolver.h"
 #include "module-equalizer-sink-symdef.h"
 
 PA_MODULE_AUTHOR("Jason Newton");
@@ -82,16 +77,21 @@ PA_MODULE_USAGE(
           "channel_map=<channel map> "
           "autoloaded=<set if this module is being loaded automatically> "
           "use_volume_sharing=<yes or no> "
+          "low_latency=<yes or no> "
          ));
 
 #define MEMBLOCKQ_MAXLENGTH (16*1024*1024)
 #define DEFAULT_AUTOLOADED FALSE
+#define DEFAULT_LOW_LATENCY FALSE
+/* Upper bound for the partition size in low latency mode */
+#define LOW_LATENCY_MSEC 5
 
 struct userdata {
     pa_module *module;
     pa_sink *sink;
     pa_sink_input *sink_input;
     pa_bool_t autoloaded;
+    pa_bool_t low_latency;
 
     size_t channels;
     size_t fft_size;//length (res) of fft
@@ -111,9 +111,19 @@ struct userdata {
     float *W;//windowing function (time domain)
     float *work_buffer, **input, **overlap_accum;
     fftwf_complex *output_window;
-    fftwf_plan forward_plan, inverse_plan;
+    fftwf_plan forward_plan, inverse_plan;//batched over all channels
+    pa_cmul_real_func_t cmul_real;
     //size_t samplings;
 
+    //uniformly partitioned convolution for low latency mode, R is the partition size
+    size_t n_partitions;
+    pa_convolver *convolver;
+    fftwf_complex ***Ps;//thread updatable copies of the partitioned minimum phase filters
+    //scratch space for designing the filters, main thread only
+    float *design_signal;
+    fftwf_complex *design_spectrum;
+    fftwf_plan design_forward_plan, design_inverse_plan;
+
     float **Xs;
     float ***Hs;//thread updatable copies of the freq response filters (magnitude based)
     pa_aupdate **a_H;
@@ -141,6 +151,7 @@ static const char* const valid_modargs[] = {
     "channel_map",
     "autoloaded",
     "use_volume_sharing",
+    "low_latency",
     NULL
 };
 
@@ -239,6 +250,60 @@ static void alloc_input_buffers(struct userdata *u, size_t min_buffer_length){
     u->input_buffer_max = min_buffer_length;
 }
 
+/* Turns the magnitude response of a channel into a minimum phase impulse
+ * response, which unlike the linear phase one doesn't need to look
+ * ahead, and stores it in the frequency domain cut into partitions of R
+ * samples. Called from main context. */
+static void partition_filter(struct userdata *u, size_t channel, unsigned a_i){
+    const size_t n = u->fft_size, n_bins = FILTER_SIZE(u), length = u->n_partitions * u->R;
+    const float *H = u->Hs[channel][a_i];
+    fftwf_complex *S = u->design_spectrum;
+    float *h = u->design_signal;
+    float scale;
+
+    pa_assert(length <= n / 2);
+
+    //real cepstrum of the magnitude response
+    for(size_t i = 0; i < n_bins; ++i){
+        S[i][0] = logf(PA_MAX(H[i] * n, 1e-6f));
+        S[i][1] = 0;
+    }
+    fftwf_execute(u->design_inverse_plan);
+
+    //fold it onto the positive quefrencies
+    h[0] /= n;
+    for(size_t i = 1; i < n / 2; ++i)
+        h[i] *= 2.0f / n;
+    h[n / 2] /= n;
+    memset(h + n / 2 + 1, 0, (n / 2 - 1) * sizeof(float));
+
+    //back to a minimum phase spectrum, folding in the preamp and the gain
+    //of the inverse transform
+    fftwf_execute(u->design_forward_plan);
+    scale = u->Xs[channel][a_i] / n;
+    for(size_t i = 0; i < n_bins; ++i){
+        float m = expf(S[i][0]) * scale, phi = S[i][1];
+        S[i][0] = m * cosf(phi);
+        S[i][1] = m * sinf(phi);
+    }
+    fftwf_execute(u->design_inverse_plan);
+
+    //fade out over the last partition, where the response gets truncated
+    for(size_t i = 0; i < u->R; ++i)
+        h[length - u->R + i] *= .5f * (1 + cosf(M_PI * (i + 1) / u->R));
+
+    pa_convolver_partition(u->convolver, h, length, 1, u->Ps[channel][a_i]);
+}
+
+/* Every writer of Hs and Xs must finish with this instead of
+ * pa_aupdate_write_end() */
+static void filter_write_end(struct userdata *u, size_t channel, unsigned a_i){
+    if(u->low_latency)
+        partition_filter(u, channel, a_i);
+
+    pa_aupdate_write_end(u->a_H[channel]);
+}
+
 /* Called from I/O thread context */
 static int sink_process_msg_cb(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
     struct userdata *u = PA_SINK(o)->userdata;
@@ -350,158 +415,54 @@ static void sink_set_mute_cb(pa_sink *s) {
     pa_sink_input_set_mute(u->sink_input, s->muted, s->save_muted);
 }
 
-#if 1
-//reference implementation
-static void dsp_logic(
-    float * restrict dst,//used as a temp array too, needs to be fft_length!
-    float * restrict src,/*input data w/ overlap at start,
-                               *automatically cycled in routine
-                               */
-    float * restrict overlap,
-    const float X,//multiplier
-    const float * restrict H,//The freq. magnitude scalers filter
-    const float * restrict W,//The windowing function
-    fftwf_complex * restrict output_window,//The transformed windowed src
-    struct userdata *u){
-
-    //use a linear-phase sliding STFT and overlap-add method (for each channel)
-    //window the data
-    for(size_t j = 0; j < u->window_size; ++j){
-        dst[j] = X * W[j] * src[j];
-    }
-    //zero pad the remaining fft window
-    memset(dst + u->window_size, 0, (u->fft_size - u->window_size) * sizeof(float));
-    //Processing is done here!
-    //do fft
-    fftwf_execute_dft_r2c(u->forward_plan, dst, output_window);
-    //perform filtering
-    for(size_t j = 0; j < FILTER_SIZE(u); ++j){
-        u->output_window[j][0] *= H[j];
-        u->output_window[j][1] *= H[j];
-    }
-    //inverse fft
-    fftwf_execute_dft_c2r(u->inverse_plan, output_window, dst);
-    ////debug: tests overlapping add
-    ////and negates ALL PREVIOUS processing
-    ////yields a perfect reconstruction if COLA is held
-    //for(size_t j = 0; j < u->window_size; ++j){
-    //    u->work_buffer[j] = u->W[j] * u->input[c][j];
-    //}
-
-    //overlap add and preserve overlap component from this window (linear phase)
-    for(size_t j = 0; j < u->overlap_size; ++j){
-        u->work_buffer[j] += overlap[j];
-        overlap[j] = dst[u->R + j];
-    }
-    ////debug: tests if basic buffering works
-    ////shouldn't modify the signal AT ALL (beyond roundoff)
-    //for(size_t j = 0; j < u->window_size;++j){
-    //    u->work_buffer[j] = u->input[c][j];
-    //}
-
-    //preserve the needed input for the next window's overlap
-    memmove(src, src + u->R,
-        (u->samples_gathered - u->R) * sizeof(float)
-    );
-}
-#else
-typedef float v4sf __attribute__ ((__aligned__(v_size * sizeof(float))));
-typedef union float_vector {
-    float f[v_size];
-    v4sf v;
-    __m128 m;
-} float_vector_t;
-
-//regardless of sse enabled, the loops in here assume
-//16 byte aligned addresses and memory allocations divisible by v_size
-static void dsp_logic(
-    float * restrict dst,//used as a temp array too, needs to be fft_length!
-    float * restrict src,/*input data w/ overlap at start,
-                               *automatically cycled in routine
-                               */
-    float * restrict overlap,//The size of the overlap
-    const float X,//multiplier
-    const float * restrict H,//The freq. magnitude scalers filter
-    const float * restrict W,//The windowing function
-    fftwf_complex * restrict output_window,//The transformed windowed src
-    struct userdata *u){//Collection of constants
-    const size_t overlap_size = PA_ROUND_UP(u->overlap_size, v_size);
-    float_vector_t x;
-    x.f[0] = x.f[1] = x.f[2] = x.f[3] = X;
-
-    //assert(u->samples_gathered >= u->R);
-    //use a linear-phase sliding STFT and overlap-add method
-    for(size_t j = 0; j < u->window_size; j += v_size){
-        //dst[j] = W[j] * src[j];
-        float_vector_t *d = (float_vector_t*) (dst + j);
-        float_vector_t *w = (float_vector_t*) (W + j);
-        float_vector_t *s = (float_vector_t*) (src + j);
-//#if __SSE2__
-        d->m = _mm_mul_ps(x.m, _mm_mul_ps(w->m, s->m));
-//        d->v = x->v * w->v * s->v;
-//#endif
-    }
-    //zero pad the remaining fft window
-    memset(dst + u->window_size, 0, (u->fft_size - u->window_size) * sizeof(float));
-
-    //Processing is done here!
-    //do fft
-    fftwf_execute_dft_r2c(u->forward_plan, dst, output_window);
-    //perform filtering - purely magnitude based
-    for(size_t j = 0; j < FILTER_SIZE; j += v_size / 2){
-        //output_window[j][0]*=H[j];
-        //output_window[j][1]*=H[j];
-        float_vector_t *d = (float_vector_t*)( ((float *) output_window) + 2 * j);
-        float_vector_t h;
-        h.f[0] = h.f[1] = H[j];
-        h.f[2] = h.f[3] = H[j + 1];
-//#if __SSE2__
-        d->m = _mm_mul_ps(d->m, h.m);
-//#else
-//        d->v = d->v * h.v;
-//#endif
-    }
-
-    //inverse fft
-    fftwf_execute_dft_c2r(u->inverse_plan, output_window, dst);
-
-    ////debug: tests overlapping add
-    ////and negates ALL PREVIOUS processing
-    ////yields a perfect reconstruction if COLA is held
-    //for(size_t j = 0; j < u->window_size; ++j){
-    //    dst[j] = W[j] * src[j];
-    //}
-
-    //overlap add and preserve overlap component from this window (linear phase)
-    for(size_t j = 0; j < overlap_size; j += v_size){
-        //dst[j]+=overlap[j];
-        //overlap[j]+=dst[j+R];
-        float_vector_t *d = (float_vector_t*)(dst + j);
-        float_vector_t *o = (float_vector_t*)(overlap + j);
-//#if __SSE2__
-        d->m = _mm_add_ps(d->m, o->m);
-        o->m = ((float_vector_t*)(dst + u->R + j))->m;
-//#else
-//        d->v = d->v + o->v;
-//        o->v = ((float_vector_t*)(dst + u->R + j))->v;
-//#endif
-    }
-    //memcpy(overlap, dst+u->R, u->overlap_size * sizeof(float)); //overlap preserve (debug)
-    //zero out the bit beyond the real overlap so we don't add garbage next iteration
-    memset(overlap + u->overlap_size, 0, overlap_size - u->overlap_size);
-
-    ////debug: tests if basic buffering works
-    ////shouldn't modify the signal AT ALL (beyond roundoff)
-    //for(size_t j = 0; j < u->window_size; ++j){
-    //    dst[j] = src[j];
-    //}
-
-    //preserve the needed input for the next window's overlap
-    memmove(src, src + u->R,
-        (u->samples_gathered - u->R) * sizeof(float)
-    );
+/* Filters one window of all channels with a linear-phase sliding STFT
+ * and overlap-add, the transforms being batched over the channels. The
+ * R new samples of each channel end up at the start of its part of
+ * work_buffer. */
+static void dsp_logic(struct userdata *u){
+    const size_t n_bins = FILTER_SIZE(u);
+    unsigned a_i[PA_CHANNELS_MAX];
+
+    for(size_t c = 0; c < u->channels; ++c){
+        float *dst = u->work_buffer + c * u->fft_size;
+        const float *src = u->input[c];
+        float X;
+
+        a_i[c] = pa_aupdate_read_begin(u->a_H[c]);
+        X = u->Xs[c][a_i[c]];
+
+        //window the data
+        for(size_t j = 0; j < u->window_size; ++j)
+            dst[j] = X * u->W[j] * src[j];
+        //zero pad the remaining fft window
+        memset(dst + u->window_size, 0, (u->fft_size - u->window_size) * sizeof(float));
+    }
+
+    fftwf_execute(u->forward_plan);
+
+    //perform filtering, purely magnitude based
+    for(size_t c = 0; c < u->channels; ++c){
+        u->cmul_real((float *) (u->output_window + c * n_bins), u->Hs[c][a_i[c]], n_bins);
+        pa_aupdate_read_end(u->a_H[c]);
+    }
+
+    fftwf_execute(u->inverse_plan);
+
+    for(size_t c = 0; c < u->channels; ++c){
+        float *dst = u->work_buffer + c * u->fft_size, *overlap = u->overlap_accum[c];
+
+        //overlap add and preserve overlap component from this window
+        for(size_t j = 0; j < u->overlap_size; ++j){
+            dst[j] += overlap[j];
+            overlap[j] = dst[u->R + j];
+        }
+
+        //preserve the needed input for the next window's overlap
+        memmove(u->input[c], u->input[c] + u->R,
+            (u->samples_gathered - u->R) * sizeof(float)
+        );
+    }
 }
-#endif
 
 static void flatten_to_memblockq(struct userdata *u){
     size_t mbs = pa_mempool_block_size_max(u->sink->core->mempool);
@@ -524,8 +485,6 @@ static void flatten_to_memblockq(struct userdata *u){
 
 static void process_samples(struct userdata *u){
     size_t fs = pa_frame_size(&(u->sink->sample_spec));
-    unsigned a_i;
-    float *H, X;
     size_t iterations, offset;
     pa_assert(u->samples_gathered >= u->window_size);
     iterations = (u->samples_gathered - u->overlap_size) / u->R;
@@ -539,30 +498,18 @@ static void process_samples(struct userdata *u){
 
     for(size_t iter = 0; iter < iterations; ++iter){
         offset = iter * u->R * fs;
+        dsp_logic(u);
         for(size_t c = 0;c < u->channels; c++) {
-            a_i = pa_aupdate_read_begin(u->a_H[c]);
-            X = u->Xs[c][a_i];
-            H = u->Hs[c][a_i];
-            dsp_logic(
-                u->work_buffer,
-                u->input[c],
-                u->overlap_accum[c],
-                X,
-                H,
-                u->W,
-                u->output_window,
-                u
-            );
-            pa_aupdate_read_end(u->a_H[c]);
+            float *dst = u->work_buffer + c * u->fft_size;
             if(u->first_iteration){
                 /* The windowing function will make the audio ramped in, as a cheap fix we can
                  * undo the windowing (for non-zero window values)
                  */
                 for(size_t i = 0; i < u->overlap_size; ++i){
-                    u->work_buffer[i] = u->W[i] <= FLT_EPSILON ? u->work_buffer[i] : u->work_buffer[i] / u->W[i];
+                    dst[i] = u->W[i] <= FLT_EPSILON ? dst[i] : dst[i] / u->W[i];
                 }
             }
-            pa_sample_clamp(PA_SAMPLE_FLOAT32NE, (uint8_t *) (((float *)u->output_buffer) + c) + offset, fs, u->work_buffer, sizeof(float), u->R);
+            pa_sample_clamp(PA_SAMPLE_FLOAT32NE, (uint8_t *) (((float *)u->output_buffer) + c) + offset, fs, dst, sizeof(float), u->R);
         }
         if(u->first_iteration){
             u->first_iteration = FALSE;
@@ -589,6 +536,74 @@ static void input_buffer(struct userdata *u, pa_memchunk *in){
     pa_memblock_release(in->memblock);
 }
 
+/* Filters the block of R samples per channel gathered in the convolver
+ * and writes it interleaved to dst */
+static void convolve_block(struct userdata *u, float *dst){
+    const size_t fs = pa_frame_size(&u->sink->sample_spec);
+    unsigned a_i;
+
+    pa_convolver_transform(u->convolver);
+
+    for(size_t c = 0; c < u->channels; ++c){
+        a_i = pa_aupdate_read_begin(u->a_H[c]);
+        pa_convolver_accumulate(u->convolver, c, c, u->Ps[c][a_i]);
+        pa_aupdate_read_end(u->a_H[c]);
+    }
+
+    pa_convolver_finish(u->convolver);
+
+    for(size_t c = 0; c < u->channels; ++c)
+        pa_sample_clamp(PA_SAMPLE_FLOAT32NE, (uint8_t *) (dst + c), fs, pa_convolver_get_output(u->convolver, c), sizeof(float), u->R);
+}
+
+/* The low latency counterpart of gathering the input and calling
+ * process_samples() */
+static void convolve_samples(struct userdata *u, size_t target_samples){
+    size_t fs = pa_frame_size(&(u->sink->sample_spec));
+    size_t mbs = pa_mempool_block_size_max(u->sink->core->mempool);
+    pa_memchunk tchunk;
+
+    pa_assert(target_samples % u->R == 0);
+
+    if(target_samples * fs > u->output_buffer_max_length){
+        u->output_buffer_max_length = target_samples * fs;
+        pa_xfree(u->output_buffer);
+        u->output_buffer = pa_xmalloc(u->output_buffer_max_length);
+    }
+    u->output_buffer_length = 0;
+
+    while(u->output_buffer_length < target_samples * fs){
+        size_t samples;
+        float *src;
+
+        while (pa_memblockq_peek(u->input_q, &tchunk) < 0) {
+            size_t input_remaining = target_samples - u->output_buffer_length / fs - u->samples_gathered;
+            pa_sink_render_full(u->sink, PA_MIN(input_remaining * fs, mbs), &tchunk);
+            pa_memblockq_push(u->input_q, &tchunk);
+            pa_memblock_unref(tchunk.memblock);
+        }
+        pa_assert(tchunk.memblock);
+
+        tchunk.length = PA_MIN((u->R - u->samples_gathered) * fs, tchunk.length);
+        pa_memblockq_drop(u->input_q, tchunk.length);
+
+        samples = tchunk.length / fs;
+        src = (float*) ((uint8_t*) pa_memblock_acquire(tchunk.memblock) + tchunk.index);
+        for(size_t c = 0; c < u->channels; c++)
+            pa_sample_clamp(PA_SAMPLE_FLOAT32NE, pa_convolver_get_input(u->convolver, c) + u->samples_gathered, sizeof(float), src + c, fs, samples);
+        pa_memblock_release(tchunk.memblock);
+        pa_memblock_unref(tchunk.memblock);
+
+        u->samples_gathered += samples;
+        if(u->samples_gathered == u->R){
+            convolve_block(u, (float *) (u->output_buffer + u->output_buffer_length));
+            u->output_buffer_length += u->R * fs;
+            u->samples_gathered = 0;
+        }
+    }
+    flatten_to_memblockq(u);
+}
+
 /* Called from I/O thread context */
 static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk) {
     struct userdata *u;
@@ -612,6 +627,12 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
         //pa_log_debug("qsize is %ld", pa_memblockq_get_length(u->output_q));
         goto END;
     }
+    if(u->low_latency){
+        chunk->memblock = NULL;
+        pa_sink_process_rewind(u->sink, 0);
+        convolve_samples(u, PA_ROUND_UP(nbytes / fs, u->R));
+        goto END;
+    }
     //nbytes = PA_MIN(nbytes, pa_mempool_block_size_max(u->sink->core->mempool));
     target_samples = PA_ROUND_UP(nbytes / fs, u->R);
     ////pa_log_debug("vanilla mbs = %ld",mbs);
@@ -820,7 +841,8 @@ static void sink_input_attach_cb(pa_sink_input *i) {
     fs = pa_frame_size(&u->sink_input->sample_spec);
     /* set buffer size to max request, no overlap copy */
     max_request = PA_ROUND_UP(pa_sink_input_get_max_request(u->sink_input) / fs, u->R);
-    max_request = PA_MAX(max_request, u->window_size);
+    if (!u->low_latency)
+        max_request = PA_MAX(max_request, u->window_size);
 
     pa_sink_set_max_request_within_thread(u->sink, max_request * fs);
     pa_sink_set_max_rewind_within_thread(u->sink, pa_sink_input_get_max_rewind(i));
@@ -991,7 +1013,7 @@ static const char* load_profile(struct userdata *u, size_t channel, char *name){
             u->Xs[channel][a_i] = profile[0];
             memcpy(u->Hs[channel][a_i], profile + 1, FILTER_SIZE(u) * sizeof(float));
             fix_filter(u->Hs[channel][a_i], u->fft_size);
-            pa_aupdate_write_end(u->a_H[channel]);
+            filter_write_end(u, channel, a_i);
             pa_xfree(u->base_profiles[channel]);
             u->base_profiles[channel] = pa_xstrdup(name);
         }else{
@@ -1031,7 +1053,7 @@ static void load_state(struct userdata *u){
                 H = state + c * CHANNEL_PROFILE_SIZE(u) + 1;
                 u->Xs[c][a_i] = state[c * CHANNEL_PROFILE_SIZE(u)];
                 memcpy(u->Hs[c][a_i], H, FILTER_SIZE(u) * sizeof(float));
-                pa_aupdate_write_end(u->a_H[c]);
+                filter_write_end(u, c, a_i);
             }
             unpack(((char *)value.data) + FILTER_STATE_SIZE(u) * sizeof(float), value.size - FILTER_STATE_SIZE(u) * sizeof(float), &names, &n_profs);
             n_profs = PA_MIN(n_profs, u->channels);
@@ -1121,6 +1143,12 @@ int pa__init(pa_module*m) {
     u->module = m;
     m->userdata = u;
 
+    u->low_latency = DEFAULT_LOW_LATENCY;
+    if (pa_modargs_get_value_boolean(ma, "low_latency", &u->low_latency) < 0) {
+        pa_log("low_latency= expects a boolean argument");
+        goto fail;
+    }
+
     u->channels = ss.channels;
     u->fft_size = pow(2, ceil(log(ss.rate) / log(2)));//probably unstable near corner cases of powers of 2
     pa_log_debug("fft size: %zd", u->fft_size);
@@ -1130,6 +1158,15 @@ int pa__init(pa_module*m) {
     u->R = (u->window_size + 1) / 2;
     u->overlap_size = u->window_size - u->R;
     u->samples_gathered = 0;
+    if (u->low_latency) {
+        /* The partition size is where the latency comes from, the
+         * filter itself is about as long as the window */
+        u->R = 1;
+        while (u->R * 2 <= ss.rate * LOW_LATENCY_MSEC / 1000)
+            u->R *= 2;
+        u->n_partitions = PA_MIN(PA_ROUND_UP(u->window_size, u->R), u->fft_size / 2) / u->R;
+        pa_log_debug("partition size: %zd, partitions: %zd", u->R, u->n_partitions);
+    }
     u->input_buffer_max = 0;
 
     u->a_H = pa_xnew0(pa_aupdate *, u->channels);
@@ -1144,7 +1181,7 @@ int pa__init(pa_module*m) {
     }
 
     u->W = alloc(u->window_size, sizeof(float));
-    u->work_buffer = alloc(u->fft_size, sizeof(float));
+    u->work_buffer = alloc(u->fft_size * u->channels, sizeof(float));
     u->input = pa_xnew0(float *, u->channels);
     u->overlap_accum = pa_xnew0(float *, u->channels);
     for (c = 0; c < u->channels; ++c) {
@@ -1152,9 +1189,33 @@ int pa__init(pa_module*m) {
         u->input[c] = NULL;
         u->overlap_accum[c] = alloc(u->overlap_size, sizeof(float));
     }
-    u->output_window = alloc(FILTER_SIZE(u), sizeof(fftwf_complex));
-    u->forward_plan = fftwf_plan_dft_r2c_1d(u->fft_size, u->work_buffer, u->output_window, FFTW_ESTIMATE);
-    u->inverse_plan = fftwf_plan_dft_c2r_1d(u->fft_size, u->output_window, u->work_buffer, FFTW_ESTIMATE);
+    u->output_window = alloc(FILTER_SIZE(u) * u->channels, sizeof(fftwf_complex));
+    {
+        int n = (int) u->fft_size;
+
+        u->forward_plan = fftwf_plan_many_dft_r2c(1, &n, (int) u->channels,
+                                                  u->work_buffer, NULL, 1, n,
+                                                  u->output_window, NULL, 1, (int) FILTER_SIZE(u), FFTW_ESTIMATE);
+        u->inverse_plan = fftwf_plan_many_dft_c2r(1, &n, (int) u->channels,
+                                                  u->output_window, NULL, 1, (int) FILTER_SIZE(u),
+                                                  u->work_buffer, NULL, 1, n, FFTW_ESTIMATE);
+    }
+    u->cmul_real = pa_get_cmul_real_func();
+
+    if (u->low_latency) {
+        u->convolver = pa_convolver_new(u->R, u->n_partitions, u->channels, u->channels);
+        u->Ps = pa_xnew0(fftwf_complex **, u->channels);
+        for (c = 0; c < u->channels; ++c) {
+            u->Ps[c] = pa_xnew0(fftwf_complex *, 2);
+            for (i = 0; i < 2; ++i)
+                u->Ps[c][i] = pa_convolver_new_filter(u->convolver);
+        }
+
+        u->design_signal = alloc(u->fft_size, sizeof(float));
+        u->design_spectrum = alloc(FILTER_SIZE(u), sizeof(fftwf_complex));
+        u->design_forward_plan = fftwf_plan_dft_r2c_1d(u->fft_size, u->design_signal, u->design_spectrum, FFTW_ESTIMATE);
+        u->design_inverse_plan = fftwf_plan_dft_c2r_1d(u->fft_size, u->design_spectrum, u->design_signal, FFTW_ESTIMATE);
+    }
 
     hanning_window(u->W, u->window_size);
     u->first_iteration = TRUE;
@@ -1267,7 +1328,7 @@ int pa__init(pa_module*m) {
             H[i] = 1.0 / sqrtf(2.0f);
 
         fix_filter(H, u->fft_size);
-        pa_aupdate_write_end(u->a_H[c]);
+        filter_write_end(u, c, a_i);
     }
 
     /* load old parameters */
@@ -1356,6 +1417,24 @@ void pa__done(pa_module*m) {
     pa_xfree(u->Xs);
     pa_xfree(u->Hs);
 
+    if (u->low_latency) {
+        if (u->design_inverse_plan)
+            fftwf_destroy_plan(u->design_inverse_plan);
+        if (u->design_forward_plan)
+            fftwf_destroy_plan(u->design_forward_plan);
+        pa_xfree(u->design_spectrum);
+        pa_xfree(u->design_signal);
+        for (c = 0; u->Ps && c < u->channels; ++c) {
+            for (size_t i = 0; u->Ps[c] && i < 2; ++i)
+                if (u->Ps[c][i])
+                    fftwf_free(u->Ps[c][i]);
+            pa_xfree(u->Ps[c]);
+        }
+        pa_xfree(u->Ps);
+        if (u->convolver)
+            pa_convolver_free(u->convolver);
+    }
+
     pa_xfree(u);
 }
 
@@ -1845,10 +1924,10 @@ void equalizer_handle_seed_filter(DBusConnection *conn, DBusMessage *msg, void *
             float *H_p = u->Hs[c][b_i];
             u->Xs[c][b_i] = preamp;
             memcpy(H_p, H, FILTER_SIZE(u) * sizeof(float));
-            pa_aupdate_write_end(u->a_H[c]);
+            filter_write_end(u, c, b_i);
         }
     }
-    pa_aupdate_write_end(u->a_H[r_channel]);
+    filter_write_end(u, r_channel, a_i);
     pa_xfree(ys);
 
 
@@ -1996,10 +2075,10 @@ static void set_filter(struct userdata *u, size_t channel, double *H_, double pr
             unsigned b_i = pa_aupdate_write_begin(u->a_H[c]);
             u->Xs[c][b_i] = u->Xs[r_channel][a_i];
             memcpy(u->Hs[c][b_i], u->Hs[r_channel][a_i], FILTER_SIZE(u) * sizeof(float));
-            pa_aupdate_write_end(u->a_H[c]);
+            filter_write_end(u, c, b_i);
         }
     }
-    pa_aupdate_write_end(u->a_H[r_channel]);
+    filter_write_end(u, r_channel, a_i);
 }
 
 void equalizer_handle_set_filter(DBusConnection *conn, DBusMessage *msg, void *_u){
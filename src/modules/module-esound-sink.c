@@ -560,6 +560,7 @@ int pa__init(pa_module*m) {
             TRUE,
             10,
             0,
+            FALSE,
             FALSE);
     pa_memchunk_reset(&u->memchunk);
     u->offset = 0;
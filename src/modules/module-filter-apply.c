@@ -33,7 +33,9 @@
 #include <pulsecore/macro.h>
 #include <pulsecore/hashmap.h>
 #include <pulsecore/hook-list.h>
+#include <pulsecore/idxset.h>
 #include <pulsecore/sink-input.h>
+#include <pulsecore/source-output.h>
 #include <pulsecore/modargs.h>
 #include <pulsecore/proplist-util.h>
 
@@ -64,9 +66,25 @@ struct filter {
     pa_source *source_master;
 };
 
+/* Streams that are routed together, see find_paired_master() */
+struct group {
+    char *name;
+    pa_idxset *sink_inputs;
+    pa_idxset *source_outputs;
+};
+
+/* What we last saw of the filter related properties of a stream. If a
+ * proplist change leaves these alone, there is nothing to do for it. */
+struct stream {
+    char *want;
+    struct group *group;
+};
+
 struct userdata {
     pa_core *core;
     pa_hashmap *filters;
+    pa_hashmap *streams; /* pa_object* -> struct stream */
+    pa_hashmap *groups; /* Group name -> struct group */
     pa_hook_slot
         *sink_input_put_slot,
         *sink_input_move_finish_slot,
@@ -165,71 +183,121 @@ static char* get_group(pa_object *o, pa_bool_t is_sink_input) {
     return pa_proplist_get_stream_group(pl, pa_proplist_gets(pl, PA_PROP_FILTER_APPLY), NULL);
 }
 
+static void group_remove_stream(struct userdata *u, struct group *g, pa_object *o, pa_bool_t is_sink_input) {
+    pa_assert_se(pa_idxset_remove_by_data(is_sink_input ? g->sink_inputs : g->source_outputs, o, NULL));
+
+    if (pa_idxset_isempty(g->sink_inputs) && pa_idxset_isempty(g->source_outputs)) {
+        pa_hashmap_remove(u->groups, g->name);
+        pa_idxset_free(g->sink_inputs, NULL, NULL);
+        pa_idxset_free(g->source_outputs, NULL, NULL);
+        pa_xfree(g->name);
+        pa_xfree(g);
+    }
+}
+
+static struct group *group_add_stream(struct userdata *u, char *name, pa_object *o, pa_bool_t is_sink_input) {
+    struct group *g;
+
+    if ((g = pa_hashmap_get(u->groups, name)))
+        pa_xfree(name);
+    else {
+        g = pa_xnew(struct group, 1);
+        g->name = name;
+        g->sink_inputs = pa_idxset_new(NULL, NULL);
+        g->source_outputs = pa_idxset_new(NULL, NULL);
+        pa_hashmap_put(u->groups, g->name, g);
+    }
+
+    pa_idxset_put(is_sink_input ? g->sink_inputs : g->source_outputs, o, NULL);
+
+    return g;
+}
+
+/* Brings our view of the stream up to date. Returns TRUE if the stream is
+ * new to us, or wants another filter or belongs to another group now. */
+static pa_bool_t update_stream(struct userdata *u, pa_object *o, pa_bool_t is_sink_input) {
+    struct stream *s;
+    const char *want;
+    char *group;
+
+    want = should_filter(o, is_sink_input);
+    group = get_group(o, is_sink_input);
+
+    if (!(s = pa_hashmap_get(u->streams, o))) {
+        s = pa_xnew0(struct stream, 1);
+        pa_hashmap_put(u->streams, o, s);
+    } else if ((s->want ? (want && pa_streq(s->want, want)) : !want) && pa_streq(s->group->name, group)) {
+        pa_xfree(group);
+        return FALSE;
+    } else {
+        group_remove_stream(u, s->group, o, is_sink_input);
+        pa_xfree(s->want);
+    }
+
+    s->want = pa_xstrdup(want);
+    s->group = group_add_stream(u, group, o, is_sink_input);
+
+    return TRUE;
+}
+
+static void remove_stream(struct userdata *u, pa_object *o, pa_bool_t is_sink_input) {
+    struct stream *s;
+
+    if (!(s = pa_hashmap_remove(u->streams, o)))
+        return;
+
+    group_remove_stream(u, s->group, o, is_sink_input);
+    pa_xfree(s->want);
+    pa_xfree(s);
+}
+
 /* For filters that apply on a source-output/sink-input pair, this finds the
  * master sink if we know the master source, or vice versa. It does this by
  * looking up streams that belong to the same stream group as the original
  * object. The idea is that streams from the sam group are always routed
  * together. */
 static pa_bool_t find_paired_master(struct userdata *u, struct filter *filter, pa_object *o, pa_bool_t is_sink_input) {
-    char *group;
-
-    if ((group = get_group(o, is_sink_input))) {
-        uint32_t idx;
-        char *g;
-        char *module_name = pa_sprintf_malloc("module-%s", filter->name);
-
-        if (is_sink_input) {
-            pa_source_output *so;
+    struct stream *s;
+    uint32_t idx;
+    char *module_name;
 
-            PA_IDXSET_FOREACH(so, u->core->source_outputs, idx) {
-                g = get_group(PA_OBJECT(so), FALSE);
+    pa_assert_se(s = pa_hashmap_get(u->streams, o));
 
-                if (pa_streq(g, group)) {
-                    if (pa_streq(module_name, so->source->module->name)) {
-                        /* Make sure we're not routing to another instance of
-                         * the same filter. */
-                        filter->source_master = so->source->output_from_master->source;
-                    } else {
-                        filter->source_master = so->source;
-                    }
+    module_name = pa_sprintf_malloc("module-%s", filter->name);
 
-                    pa_xfree(g);
-                    break;
-                }
+    if (is_sink_input) {
+        pa_source_output *so;
 
-                pa_xfree (g);
-            }
-        } else {
-            pa_sink_input *si;
-
-            PA_IDXSET_FOREACH(si, u->core->sink_inputs, idx) {
-                g = get_group(PA_OBJECT(si), TRUE);
-
-                if (pa_streq(g, group)) {
-                    if (pa_streq(module_name, si->sink->module->name)) {
-                        /* Make sure we're not routing to another instance of
-                         * the same filter. */
-                        filter->sink_master = si->sink->input_to_master->sink;
-                    } else {
-                        filter->sink_master = si->sink;
-                    }
-
-                    pa_xfree(g);
-                    break;
-                }
-
-                pa_xfree(g);
+        PA_IDXSET_FOREACH(so, s->group->source_outputs, idx) {
+            if (pa_streq(module_name, so->source->module->name)) {
+                /* Make sure we're not routing to another instance of
+                 * the same filter. */
+                filter->source_master = so->source->output_from_master->source;
+            } else {
+                filter->source_master = so->source;
             }
+
+            break;
         }
+    } else {
+        pa_sink_input *si;
 
-        pa_xfree(group);
-        pa_xfree(module_name);
+        PA_IDXSET_FOREACH(si, s->group->sink_inputs, idx) {
+            if (pa_streq(module_name, si->sink->module->name)) {
+                /* Make sure we're not routing to another instance of
+                 * the same filter. */
+                filter->sink_master = si->sink->input_to_master->sink;
+            } else {
+                filter->sink_master = si->sink;
+            }
 
-        if (!filter->sink_master || !filter->source_master)
-            return FALSE;
+            break;
+        }
     }
 
-    return TRUE;
+    pa_xfree(module_name);
+
+    return filter->sink_master && filter->source_master;
 }
 
 static pa_bool_t nothing_attached(struct filter *f) {
@@ -327,35 +395,20 @@ static void move_object_for_filter(pa_object *o, struct filter* filter, pa_bool_
 static void move_objects_for_filter(struct userdata *u, pa_object *o, struct filter* filter, pa_bool_t restore,
         pa_bool_t is_sink_input) {
 
-    if (!should_group_filter(filter))
+    struct stream *s;
+
+    if (!should_group_filter(filter) || !(s = pa_hashmap_get(u->streams, o)))
         move_object_for_filter(o, filter, restore, is_sink_input);
     else {
         pa_source_output *so;
         pa_sink_input *si;
-        char *g, *group;
         uint32_t idx;
 
-        group = get_group(o, is_sink_input);
-
-        PA_IDXSET_FOREACH(so, u->core->source_outputs, idx) {
-            g = get_group(PA_OBJECT(so), FALSE);
-
-            if (pa_streq(g, group))
-                move_object_for_filter(PA_OBJECT(so), filter, restore, FALSE);
-
-            pa_xfree(g);
-        }
-
-        PA_IDXSET_FOREACH(si, u->core->sink_inputs, idx) {
-            g = get_group(PA_OBJECT(si), TRUE);
+        PA_IDXSET_FOREACH(so, s->group->source_outputs, idx)
+            move_object_for_filter(PA_OBJECT(so), filter, restore, FALSE);
 
-            if (pa_streq(g, group))
-                move_object_for_filter(PA_OBJECT(si), filter, restore, TRUE);
-
-            pa_xfree(g);
-        }
-
-        pa_xfree(group);
+        PA_IDXSET_FOREACH(si, s->group->sink_inputs, idx)
+            move_object_for_filter(PA_OBJECT(si), filter, restore, TRUE);
     }
 }
 
@@ -453,6 +506,8 @@ static pa_hook_result_t process(struct userdata *u, pa_object *o, pa_bool_t is_s
 
         if (should_group_filter(fltr) && !find_paired_master(u, fltr, o, is_sink_input)) {
             pa_log_debug("Want group filtering but don't have enough streams.");
+            filter_free(fltr);
+            pa_xfree(module_name);
             return PA_HOOK_OK;
         }
 
@@ -496,7 +551,12 @@ static pa_hook_result_t process(struct userdata *u, pa_object *o, pa_bool_t is_s
         struct filter *filter = NULL;
 
         /* We do not want to filter... but are we already filtered?
-         * This can happen if an input's proplist changes */
+         * This can happen if an input's proplist changes. Only the
+         * devices of filters have a master, so skip the search for
+         * streams on anything else. */
+        if ((is_sink_input && !sink->input_to_master) || (!is_sink_input && !source->output_from_master))
+            return PA_HOOK_OK;
+
         PA_HASHMAP_FOREACH(filter, u->filters, state) {
             if ((is_sink_input && sink == filter->sink) || (!is_sink_input && source == filter->source)) {
                 move_objects_for_filter(u, o, filter, TRUE, is_sink_input);
@@ -516,6 +576,8 @@ static pa_hook_result_t sink_input_put_cb(pa_core *core, pa_sink_input *i, struc
     pa_core_assert_ref(core);
     pa_sink_input_assert_ref(i);
 
+    update_stream(u, PA_OBJECT(i), TRUE);
+
     return process(u, PA_OBJECT(i), TRUE);
 }
 
@@ -526,6 +588,8 @@ static pa_hook_result_t sink_input_move_finish_cb(pa_core *core, pa_sink_input *
     if (pa_proplist_gets(i->proplist, PA_PROP_FILTER_APPLY_MOVING))
         return PA_HOOK_OK;
 
+    update_stream(u, PA_OBJECT(i), TRUE);
+
     return process(u, PA_OBJECT(i), TRUE);
 }
 
@@ -533,6 +597,11 @@ static pa_hook_result_t sink_input_proplist_cb(pa_core *core, pa_sink_input *i,
     pa_core_assert_ref(core);
     pa_sink_input_assert_ref(i);
 
+    /* Most changes are about things we don't care about, like the
+     * media name */
+    if (!update_stream(u, PA_OBJECT(i), TRUE))
+        return PA_HOOK_OK;
+
     return process(u, PA_OBJECT(i), TRUE);
 }
 
@@ -542,6 +611,8 @@ static pa_hook_result_t sink_input_unlink_cb(pa_core *core, pa_sink_input *i, st
 
     pa_assert(u);
 
+    remove_stream(u, PA_OBJECT(i), TRUE);
+
     if (pa_hashmap_size(u->filters) > 0)
         trigger_housekeeping(u);
 
@@ -588,6 +659,8 @@ static pa_hook_result_t source_output_put_cb(pa_core *core, pa_source_output *o,
     pa_core_assert_ref(core);
     pa_source_output_assert_ref(o);
 
+    update_stream(u, PA_OBJECT(o), FALSE);
+
     return process(u, PA_OBJECT(o), FALSE);
 }
 
@@ -598,6 +671,8 @@ static pa_hook_result_t source_output_move_finish_cb(pa_core *core, pa_source_ou
     if (pa_proplist_gets(o->proplist, PA_PROP_FILTER_APPLY_MOVING))
         return PA_HOOK_OK;
 
+    update_stream(u, PA_OBJECT(o), FALSE);
+
     return process(u, PA_OBJECT(o), FALSE);
 }
 
@@ -605,6 +680,11 @@ static pa_hook_result_t source_output_proplist_cb(pa_core *core, pa_source_outpu
     pa_core_assert_ref(core);
     pa_source_output_assert_ref(o);
 
+    /* Most changes are about things we don't care about, like the
+     * media name */
+    if (!update_stream(u, PA_OBJECT(o), FALSE))
+        return PA_HOOK_OK;
+
     return process(u, PA_OBJECT(o), FALSE);
 }
 
@@ -614,6 +694,8 @@ static pa_hook_result_t source_output_unlink_cb(pa_core *core, pa_source_output
 
     pa_assert(u);
 
+    remove_stream(u, PA_OBJECT(o), FALSE);
+
     if (pa_hashmap_size(u->filters) > 0)
         trigger_housekeeping(u);
 
@@ -659,6 +741,9 @@ static pa_hook_result_t source_unlink_cb(pa_core *core, pa_source *source, struc
 int pa__init(pa_module *m) {
     pa_modargs *ma = NULL;
     struct userdata *u;
+    pa_sink_input *i;
+    pa_source_output *o;
+    uint32_t idx;
 
     pa_assert(m);
 
@@ -678,6 +763,16 @@ int pa__init(pa_module *m) {
     }
 
     u->filters = pa_hashmap_new(filter_hash, filter_compare);
+    u->streams = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+    u->groups = pa_hashmap_new(pa_idxset_string_hash_func, pa_idxset_string_compare_func);
+
+    PA_IDXSET_FOREACH(i, m->core->sink_inputs, idx)
+        if (PA_SINK_INPUT_IS_LINKED(i->state))
+            update_stream(u, PA_OBJECT(i), TRUE);
+
+    PA_IDXSET_FOREACH(o, m->core->source_outputs, idx)
+        if (PA_SOURCE_OUTPUT_IS_LINKED(o->state))
+            update_stream(u, PA_OBJECT(o), FALSE);
 
     u->sink_input_put_slot = pa_hook_connect(&m->core->hooks[PA_CORE_HOOK_SINK_INPUT_PUT], PA_HOOK_LATE, (pa_hook_cb_t) sink_input_put_cb, u);
     u->sink_input_move_finish_slot = pa_hook_connect(&m->core->hooks[PA_CORE_HOOK_SINK_INPUT_MOVE_FINISH], PA_HOOK_LATE, (pa_hook_cb_t) sink_input_move_finish_cb, u);
@@ -746,5 +841,23 @@ void pa__done(pa_module *m) {
         pa_hashmap_free(u->filters, NULL, NULL);
     }
 
+    if (u->streams) {
+        pa_sink_input *i;
+        pa_source_output *o;
+        uint32_t idx;
+
+        PA_IDXSET_FOREACH(i, u->core->sink_inputs, idx)
+            remove_stream(u, PA_OBJECT(i), TRUE);
+
+        PA_IDXSET_FOREACH(o, u->core->source_outputs, idx)
+            remove_stream(u, PA_OBJECT(o), FALSE);
+
+        pa_assert(pa_hashmap_isempty(u->streams));
+        pa_assert(pa_hashmap_isempty(u->groups));
+
+        pa_hashmap_free(u->streams, NULL, NULL);
+        pa_hashmap_free(u->groups, NULL, NULL);
+    }
+
     pa_xfree(u);
 }
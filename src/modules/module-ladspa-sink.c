@@ -40,6 +40,7 @@
 #include <pulsecore/rtpoll.h>
 #include <pulsecore/sample-util.h>
 #include <pulsecore/ltdl-helper.h>
+#include <pulsecore/dsp-worker.h>
 
 #include "module-ladspa-sink-symdef.h"
 #include "ladspa.h"
@@ -60,10 +61,22 @@ PA_MODULE_USAGE(
       "label=<ladspa plugin label> "
       "control=<comma separated list of input control values> "
       "input_ladspaport_map=<comma separated list of input LADSPA port names> "
-      "output_ladspaport_map=<comma separated list of output LADSPA port names> "));
+      "output_ladspaport_map=<comma separated list of output LADSPA port names> "
+      "block_frames=<number of frames the plugin processes at once> "
+      "dsp_thread=<run the plugin in a separate thread, adding one block of latency?> "
+      "plugin_threads=<number of threads to spread the plugin instances over> "
+      "silence_tail=<msec the plugin keeps sounding after its input went silent, -1 for forever> "
+      "realtime_priority=<priority of the DSP thread> "
+      "cpu_affinity=<CPUs to run the DSP threads on> "));
 
 #define MEMBLOCKQ_MAXLENGTH (16*1024*1024)
 
+#define DEFAULT_BLOCK_FRAMES 512
+#define MIN_BLOCK_FRAMES 32
+
+/* Long enough for the usual reverbs and delays to fade out */
+#define DEFAULT_SILENCE_TAIL_MSEC 2000
+
 /* PLEASE NOTICE: The PortAudio ports and the LADSPA ports are two different concepts.
 They are not related and where possible the names of the LADSPA port variables contains "ladspa" to avoid confusion */
 
@@ -76,16 +89,47 @@ struct userdata {
     const LADSPA_Descriptor *descriptor;
     LADSPA_Handle handle[PA_CHANNELS_MAX];
     unsigned long max_ladspaport_count, input_count, output_count, channels;
-    LADSPA_Data **input, **output;
     size_t block_size;
     LADSPA_Data *control;
 
+    /* The plugin always runs on run_size bytes at once. That is
+     * block_frames= worth, unless less latency is requested. */
+    size_t run_size, run_size_max;
+
+    /* A mono plugin that can work in place is pointed right at the block it
+     * writes to, saving a copy */
+    pa_bool_t in_place;
+    unsigned long in_place_input_ladspaport, in_place_output_ladspaport;
+
+    pa_deinterleave_float_func_t deinterleave;
+    pa_interleave_float_func_t interleave;
+
     /* This is a dummy buffer. Every port must be connected, but we don't care
     about control out ports. We connect them all to this single buffer. */
     LADSPA_Data control_out;
 
     pa_memblockq *memblockq;
 
+    /* pending holds the rest of a processed block that was not passed on
+     * yet. With dsp_thread=yes the plugin runs in the worker, one block
+     * behind the data we render from our sink. */
+    pa_dsp_worker *dsp_worker;
+    pa_memchunk pending;
+
+    /* With plugin_threads= the plugin instances are spread over n_shares
+     * threads, instance h running in share h % n_shares. The instances
+     * of a share run one after the other and use the same buffers. The
+     * job fields describe the block being processed. */
+    pa_dsp_pool *dsp_pool;
+    unsigned n_shares;
+    LADSPA_Data **input[PA_CHANNELS_MAX], **output[PA_CHANNELS_MAX];
+    float *job_src, *job_dst;
+    unsigned job_n;
+
+    /* Once the plugin was fed silence for tail_frames, it isn't run
+     * on silence anymore. (uint64_t) -1 if it never stops sounding. */
+    uint64_t tail_frames, silent_frames;
+
     pa_bool_t auto_desc;
 };
 
@@ -102,9 +146,39 @@ static const char* const valid_modargs[] = {
     "control",
     "input_ladspaport_map",
     "output_ladspaport_map",
+    "block_frames",
+    "dsp_thread",
+    "plugin_threads",
+    "silence_tail",
+    "realtime_priority",
+    "cpu_affinity",
     NULL
 };
 
+/* Called from I/O thread context. Returns how much was rendered and taken
+ * off the queue, but not passed on yet. */
+static size_t get_pipeline_length(struct userdata *u) {
+
+    return (u->pending.memblock ? u->pending.length : 0) +
+        (u->dsp_worker ? pa_dsp_worker_get_length(u->dsp_worker) : 0);
+}
+
+/* Called from I/O thread context. A whole run is rendered ahead of what
+ * is passed on, so with little latency runs are cut down to half of
+ * it. */
+static void update_run_size(struct userdata *u) {
+    pa_usec_t latency;
+    size_t length;
+
+    u->run_size = u->run_size_max;
+
+    if ((latency = pa_sink_get_requested_latency_within_thread(u->sink)) == (pa_usec_t) -1)
+        return;
+
+    length = pa_frame_align(pa_usec_to_bytes(latency / 2, &u->sink->sample_spec), &u->sink->sample_spec);
+    u->run_size = PA_CLAMP(length, PA_MIN(MIN_BLOCK_FRAMES * pa_frame_size(&u->sink->sample_spec), u->run_size_max), u->run_size_max);
+}
+
 /* Called from I/O thread context */
 static int sink_process_msg_cb(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
     struct userdata *u = PA_SINK(o)->userdata;
@@ -128,7 +202,10 @@ static int sink_process_msg_cb(pa_msgobject *o, int code, void *data, int64_t of
             pa_sink_get_latency_within_thread(u->sink_input->sink) +
 
             /* Add the latency internal to our sink input on top */
-            pa_bytes_to_usec(pa_memblockq_get_length(u->sink_input->thread_info.render_memblockq), &u->sink_input->sink->sample_spec);
+            pa_bytes_to_usec(pa_memblockq_get_length(u->sink_input->thread_info.render_memblockq), &u->sink_input->sink->sample_spec) +
+
+            /* And what was processed ahead */
+            pa_bytes_to_usec(get_pipeline_length(u), &u->sink->sample_spec);
 
         return 0;
     }
@@ -165,7 +242,8 @@ static void sink_request_rewind_cb(pa_sink *s) {
     /* Just hand this one over to the master sink */
     pa_sink_input_request_rewind(u->sink_input,
                                  s->thread_info.rewind_nbytes +
-                                 pa_memblockq_get_length(u->memblockq), TRUE, FALSE, FALSE);
+                                 pa_memblockq_get_length(u->memblockq) +
+                                 get_pipeline_length(u), TRUE, FALSE, FALSE);
 }
 
 /* Called from I/O thread context */
@@ -183,6 +261,8 @@ static void sink_update_requested_latency_cb(pa_sink *s) {
     pa_sink_input_set_requested_latency_within_thread(
         u->sink_input,
         pa_sink_get_requested_latency_within_thread(s));
+
+    update_run_size(u);
 }
 
 /* Called from main context */
@@ -213,12 +293,83 @@ static void sink_set_mute_cb(pa_sink *s) {
     pa_sink_input_set_mute(u->sink_input, s->muted, s->save_muted);
 }
 
+/* Called from I/O thread context */
+static void render_block(struct userdata *u, pa_memchunk *chunk) {
+    size_t length;
+
+    /* The plugin gets a whole run, no matter how little is asked of us */
+    while ((length = pa_memblockq_get_length(u->memblockq)) < u->run_size) {
+        pa_memchunk nchunk;
+
+        pa_sink_render(u->sink, u->run_size - length, &nchunk);
+        pa_memblockq_push(u->memblockq, &nchunk);
+        pa_memblock_unref(nchunk.memblock);
+    }
+
+    pa_memblockq_peek_fixed_size(u->memblockq, u->run_size, chunk);
+    pa_memblockq_drop(u->memblockq, u->run_size);
+}
+
+/* Called from I/O thread context, or from a DSP thread */
+static void process_share(void *userdata, unsigned share) {
+    struct userdata *u = userdata;
+    unsigned h;
+
+    for (h = share; h < (u->channels / u->max_ladspaport_count); h += u->n_shares) {
+        u->deinterleave(u->input[share], (unsigned) u->input_count, u->job_src + h*u->max_ladspaport_count, (unsigned) u->channels, u->job_n);
+        u->descriptor->run(u->handle[h], u->job_n);
+        u->interleave(u->job_dst + h*u->max_ladspaport_count, (unsigned) u->channels, u->output[share], (unsigned) u->output_count, u->job_n);
+    }
+}
+
+/* Called from I/O thread context, or from the DSP thread */
+static void process_block(void *userdata, const pa_memchunk *in, pa_memchunk *out) {
+    struct userdata *u = userdata;
+    float *src, *dst;
+    unsigned n;
+
+    n = (unsigned) (in->length / pa_frame_size(&u->sink->sample_spec));
+
+    if (!pa_memblock_is_silence(in->memblock))
+        u->silent_frames = 0;
+    else if (u->silent_frames >= u->tail_frames) {
+        pa_silence_memchunk_get_full(&u->module->core->silence_cache, u->module->core->mempool, out, &u->sink->sample_spec, in->length);
+        return;
+    } else
+        u->silent_frames += n;
+
+    out->index = 0;
+    out->length = in->length;
+    out->memblock = pa_memblock_new(u->module->core->mempool, out->length);
+
+    src = (float*) ((uint8_t*) pa_memblock_acquire(in->memblock) + in->index);
+    dst = (float*) pa_memblock_acquire(out->memblock);
+
+    if (u->in_place) {
+        u->deinterleave(&dst, 1, src, 1, n);
+        u->descriptor->connect_port(u->handle[0], u->in_place_input_ladspaport, dst);
+        u->descriptor->connect_port(u->handle[0], u->in_place_output_ladspaport, dst);
+        u->descriptor->run(u->handle[0], n);
+        u->interleave(dst, 1, &dst, 1, n);
+
+    } else {
+        u->job_src = src;
+        u->job_dst = dst;
+        u->job_n = n;
+
+        if (u->dsp_pool)
+            pa_dsp_pool_run(u->dsp_pool);
+        else
+            process_share(u, 0);
+    }
+
+    pa_memblock_release(in->memblock);
+    pa_memblock_release(out->memblock);
+}
+
 /* Called from I/O thread context */
 static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk) {
     struct userdata *u;
-    float *src, *dst;
-    size_t fs;
-    unsigned n, h, c;
     pa_memchunk tchunk;
 
     pa_sink_input_assert_ref(i);
@@ -228,45 +379,59 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
     /* Hmm, process any rewind request that might be queued up */
     pa_sink_process_rewind(u->sink, 0);
 
-    while (pa_memblockq_peek(u->memblockq, &tchunk) < 0) {
-        pa_memchunk nchunk;
+    if (!u->pending.memblock) {
 
-        pa_sink_render(u->sink, nbytes, &nchunk);
-        pa_memblockq_push(u->memblockq, &nchunk);
-        pa_memblock_unref(nchunk.memblock);
-    }
+        if (!u->dsp_worker || pa_dsp_worker_collect(u->dsp_worker, &u->pending) < 0) {
 
-    tchunk.length = PA_MIN(nbytes, tchunk.length);
-    pa_assert(tchunk.length > 0);
+            /* Without a block in flight, e.g. right after a rewind, we
+             * have to process this one ourselves */
+            render_block(u, &tchunk);
+            process_block(u, &tchunk, &u->pending);
+            pa_memblock_unref(tchunk.memblock);
+        }
 
-    fs = pa_frame_size(&i->sample_spec);
-    n = (unsigned) (PA_MIN(tchunk.length, u->block_size) / fs);
+        /* Render the next block while the worker processes this one */
+        if (u->dsp_worker) {
+            render_block(u, &tchunk);
+            pa_dsp_worker_submit(u->dsp_worker, &tchunk);
+            pa_memblock_unref(tchunk.memblock);
+        }
+    }
+
+    *chunk = u->pending;
+    chunk->length = PA_MIN(nbytes, u->pending.length);
+    pa_memblock_ref(chunk->memblock);
 
-    pa_assert(n > 0);
+    u->pending.index += chunk->length;
+    u->pending.length -= chunk->length;
 
-    chunk->index = 0;
-    chunk->length = n*fs;
-    chunk->memblock = pa_memblock_new(i->sink->core->mempool, chunk->length);
+    if (u->pending.length <= 0) {
+        pa_memblock_unref(u->pending.memblock);
+        pa_memchunk_reset(&u->pending);
+    }
 
-    pa_memblockq_drop(u->memblockq, chunk->length);
+    return 0;
+}
 
-    src = (float*) ((uint8_t*) pa_memblock_acquire(tchunk.memblock) + tchunk.index);
-    dst = (float*) pa_memblock_acquire(chunk->memblock);
+/* Called from I/O thread context. Hands the input of whatever was
+ * processed ahead back to the queue, so that it is processed again after
+ * the rewind. */
+static void flush_pipeline(struct userdata *u) {
+    pa_memchunk tchunk;
+    size_t length = 0;
 
-    for (h = 0; h < (u->channels / u->max_ladspaport_count); h++) {
-        for (c = 0; c < u->input_count; c++)
-            pa_sample_clamp(PA_SAMPLE_FLOAT32NE, u->input[c], sizeof(float), src+ h*u->max_ladspaport_count + c, u->channels*sizeof(float), n);
-        u->descriptor->run(u->handle[h], n);
-        for (c = 0; c < u->output_count; c++)
-            pa_sample_clamp(PA_SAMPLE_FLOAT32NE, dst + h*u->max_ladspaport_count + c, u->channels*sizeof(float), u->output[c], sizeof(float), n);
+    if (u->dsp_worker && pa_dsp_worker_collect(u->dsp_worker, &tchunk) >= 0) {
+        length += tchunk.length;
+        pa_memblock_unref(tchunk.memblock);
     }
 
-    pa_memblock_release(tchunk.memblock);
-    pa_memblock_release(chunk->memblock);
-
-    pa_memblock_unref(tchunk.memblock);
+    if (u->pending.memblock) {
+        length += u->pending.length;
+        pa_memblock_unref(u->pending.memblock);
+        pa_memchunk_reset(&u->pending);
+    }
 
-    return 0;
+    pa_memblockq_rewind(u->memblockq, length);
 }
 
 /* Called from I/O thread context */
@@ -277,6 +442,10 @@ static void sink_input_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
     pa_sink_input_assert_ref(i);
     pa_assert_se(u = i->userdata);
 
+    /* If nothing gets rewritten what was processed ahead is still good */
+    if (nbytes > 0 || u->sink->thread_info.rewind_nbytes > 0)
+        flush_pipeline(u);
+
     if (u->sink->thread_info.rewind_nbytes > 0) {
         size_t max_rewrite;
 
@@ -298,6 +467,8 @@ static void sink_input_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
             if (u->descriptor->activate)
                 for (c = 0; c < (u->channels / u->max_ladspaport_count); c++)
                     u->descriptor->activate(u->handle[c]);
+
+            u->silent_frames = 0;
         }
     }
 
@@ -312,7 +483,8 @@ static void sink_input_update_max_rewind_cb(pa_sink_input *i, size_t nbytes) {
     pa_sink_input_assert_ref(i);
     pa_assert_se(u = i->userdata);
 
-    pa_memblockq_set_maxrewind(u->memblockq, nbytes);
+    /* Leave room for handing back what was processed ahead */
+    pa_memblockq_set_maxrewind(u->memblockq, nbytes + (u->dsp_worker ? 2 : 1) * u->run_size_max);
     pa_sink_set_max_rewind_within_thread(u->sink, nbytes);
 }
 
@@ -372,6 +544,8 @@ static void sink_input_attach_cb(pa_sink_input *i) {
     pa_sink_set_max_rewind_within_thread(u->sink, pa_sink_input_get_max_rewind(i));
 
     pa_sink_attach_within_thread(u->sink);
+
+    update_run_size(u);
 }
 
 /* Called from main context */
@@ -485,6 +659,12 @@ int pa__init(pa_module*m) {
     const LADSPA_Descriptor *d;
     unsigned long p, h, j, n_control, c;
     pa_bool_t *use_default = NULL;
+    pa_bool_t dsp_thread = FALSE;
+    uint32_t plugin_threads = 1;
+    uint32_t block_frames = DEFAULT_BLOCK_FRAMES;
+    int32_t silence_tail = DEFAULT_SILENCE_TAIL_MSEC;
+    int32_t rtprio = -1;
+    char *cpu_affinity = NULL;
 
     pa_assert(m);
 
@@ -526,14 +706,37 @@ int pa__init(pa_module*m) {
 
     cdata = pa_modargs_get_value(ma, "control", NULL);
 
+    if (pa_modargs_get_value_u32(ma, "block_frames", &block_frames) < 0 || block_frames < 1) {
+        pa_log("block_frames= expects a positive number of frames");
+        goto fail;
+    }
+
+    if (pa_modargs_get_value_boolean(ma, "dsp_thread", &dsp_thread) < 0) {
+        pa_log("dsp_thread= expects a boolean argument");
+        goto fail;
+    }
+
+    if (pa_modargs_get_value_u32(ma, "plugin_threads", &plugin_threads) < 0 || plugin_threads < 1 || plugin_threads > PA_CHANNELS_MAX) {
+        pa_log("plugin_threads= expects a number between 1 and %u", PA_CHANNELS_MAX);
+        goto fail;
+    }
+
+    if (pa_modargs_get_value_s32(ma, "silence_tail", &silence_tail) < 0 || silence_tail < -1) {
+        pa_log("silence_tail= expects a number of milliseconds or -1");
+        goto fail;
+    }
+
+    if (pa_modargs_get_io_thread_args(ma, &rtprio, &cpu_affinity) < 0) {
+        pa_log("Failed to parse realtime_priority= or cpu_affinity= argument");
+        goto fail;
+    }
+
     u = pa_xnew0(struct userdata, 1);
     u->module = m;
     m->userdata = u;
     u->memblockq = pa_memblockq_new("module-ladspa-sink memblockq", 0, MEMBLOCKQ_MAXLENGTH, 0, &ss, 1, 1, 0, NULL);
     u->max_ladspaport_count = 1; /*to avoid division by zero etc. in pa__done when failing before this value has been set*/
     u->channels = 0;
-    u->input = NULL;
-    u->output = NULL;
 
     if (!(e = getenv("LADSPA_PATH")))
         e = LADSPA_PATH;
@@ -612,7 +815,10 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
-    pa_log_debug("Will run %lu plugin instances", u->channels / u->max_ladspaport_count);
+    /* More threads than instances would idle */
+    u->n_shares = (unsigned) PA_MIN((unsigned long) plugin_threads, u->channels / u->max_ladspaport_count);
+
+    pa_log_debug("Will run %lu plugin instances in %u thread(s)", u->channels / u->max_ladspaport_count, u->n_shares);
 
     /* Parse data for input ladspa port map */
     if (input_ladspaport_map) {
@@ -670,32 +876,51 @@ int pa__init(pa_module*m) {
 
 
     u->block_size = pa_frame_align(pa_mempool_block_size_max(m->core->mempool), &ss);
+    u->run_size = u->run_size_max = PA_MIN(block_frames * pa_frame_size(&ss), u->block_size);
 
-    /* Create buffers */
-    if (LADSPA_IS_INPLACE_BROKEN(d->Properties)) {
-        u->input = (LADSPA_Data**) pa_xnew(LADSPA_Data*, (unsigned) u->input_count);
-        for (c = 0; c < u->input_count; c++)
-            u->input[c] = (LADSPA_Data*) pa_xnew(uint8_t, (unsigned) u->block_size);
-        u->output = (LADSPA_Data**) pa_xnew(LADSPA_Data*, (unsigned) u->output_count);
-        for (c = 0; c < u->output_count; c++)
-            u->output[c] = (LADSPA_Data*) pa_xnew(uint8_t, (unsigned) u->block_size);
-    } else {
-        u->input = (LADSPA_Data**) pa_xnew(LADSPA_Data*, (unsigned) u->max_ladspaport_count);
-        for (c = 0; c < u->max_ladspaport_count; c++)
-            u->input[c] = (LADSPA_Data*) pa_xnew(uint8_t, (unsigned) u->block_size);
-        u->output = u->input;
+    u->deinterleave = pa_get_deinterleave_float_func();
+    u->interleave = pa_get_interleave_float_func();
+
+    u->tail_frames = silence_tail < 0 ? (uint64_t) -1 : (uint64_t) silence_tail * ss.rate / 1000;
+
+    if (!LADSPA_IS_INPLACE_BROKEN(d->Properties) && u->channels == 1 && u->input_count == 1 && u->output_count == 1) {
+        u->in_place = TRUE;
+        u->in_place_input_ladspaport = input_ladspaport[0];
+        u->in_place_output_ladspaport = output_ladspaport[0];
+    }
+
+    pa_log_debug("Running the plugin on %lu frames at most%s", (unsigned long) (u->run_size_max / pa_frame_size(&ss)),
+                 u->in_place ? ", in place" : "");
+
+    /* Create buffers, one set for every share */
+    for (j = 0; j < u->n_shares; j++) {
+        if (LADSPA_IS_INPLACE_BROKEN(d->Properties)) {
+            u->input[j] = (LADSPA_Data**) pa_xnew(LADSPA_Data*, (unsigned) u->input_count);
+            for (c = 0; c < u->input_count; c++)
+                u->input[j][c] = (LADSPA_Data*) pa_xnew(uint8_t, (unsigned) u->block_size);
+            u->output[j] = (LADSPA_Data**) pa_xnew(LADSPA_Data*, (unsigned) u->output_count);
+            for (c = 0; c < u->output_count; c++)
+                u->output[j][c] = (LADSPA_Data*) pa_xnew(uint8_t, (unsigned) u->block_size);
+        } else {
+            u->input[j] = (LADSPA_Data**) pa_xnew(LADSPA_Data*, (unsigned) u->max_ladspaport_count);
+            for (c = 0; c < u->max_ladspaport_count; c++)
+                u->input[j][c] = (LADSPA_Data*) pa_xnew(uint8_t, (unsigned) u->block_size);
+            u->output[j] = u->input[j];
+        }
     }
     /* Initialize plugin instances */
     for (h = 0; h < (u->channels / u->max_ladspaport_count); h++) {
+        j = h % u->n_shares;
+
         if (!(u->handle[h] = d->instantiate(d, ss.rate))) {
             pa_log("Failed to instantiate plugin %s with label %s", plugin, d->Label);
             goto fail;
         }
 
         for (c = 0; c < u->input_count; c++)
-            d->connect_port(u->handle[h], input_ladspaport[c], u->input[c]);
+            d->connect_port(u->handle[h], input_ladspaport[c], u->input[j][c]);
         for (c = 0; c < u->output_count; c++)
-            d->connect_port(u->handle[h], output_ladspaport[c], u->output[c]);
+            d->connect_port(u->handle[h], output_ladspaport[c], u->output[j][c]);
     }
 
     if (!cdata && n_control > 0) {
@@ -902,6 +1127,14 @@ int pa__init(pa_module*m) {
 
     pa_sink_set_asyncmsgq(u->sink, master->asyncmsgq);
 
+    if (dsp_thread &&
+        !(u->dsp_worker = pa_dsp_worker_new(m->core, "ladspa-dsp", rtprio, cpu_affinity, process_block, u)))
+        goto fail;
+
+    if (u->n_shares > 1 &&
+        !(u->dsp_pool = pa_dsp_pool_new(m->core, "ladspa-share", rtprio, cpu_affinity, u->n_shares, process_share, u)))
+        goto fail;
+
     /* Create sink input */
     pa_sink_input_new_data_init(&sink_input_data);
     sink_input_data.driver = __FILE__;
@@ -942,6 +1175,7 @@ int pa__init(pa_module*m) {
 
     pa_modargs_free(ma);
     pa_xfree(use_default);
+    pa_xfree(cpu_affinity);
 
     return 0;
 
@@ -950,6 +1184,7 @@ fail:
         pa_modargs_free(ma);
 
     pa_xfree(use_default);
+    pa_xfree(cpu_affinity);
 
     pa__done(m);
 
@@ -967,7 +1202,7 @@ int pa__get_n_used(pa_module *m) {
 
 void pa__done(pa_module*m) {
     struct userdata *u;
-    unsigned c;
+    unsigned c, j;
 
     pa_assert(m);
 
@@ -989,6 +1224,16 @@ void pa__done(pa_module*m) {
     if (u->sink)
         pa_sink_unref(u->sink);
 
+    /* The plugin may still be running in the worker */
+    if (u->dsp_worker)
+        pa_dsp_worker_free(u->dsp_worker);
+
+    if (u->dsp_pool)
+        pa_dsp_pool_free(u->dsp_pool);
+
+    if (u->pending.memblock)
+        pa_memblock_unref(u->pending.memblock);
+
     for (c = 0; c < (u->channels / u->max_ladspaport_count); c++) {
         if (u->handle[c]) {
             if (u->descriptor->deactivate)
@@ -997,22 +1242,24 @@ void pa__done(pa_module*m) {
         }
     }
 
-    if (u->output == u->input) {
-        if (u->input != NULL) {
-            for (c = 0; c < u->max_ladspaport_count; c++)
-                pa_xfree(u->input[c]);
-            pa_xfree(u->input);
-        }
-    } else {
-        if (u->input != NULL) {
-            for (c = 0; c < u->input_count; c++)
-                pa_xfree(u->input[c]);
-            pa_xfree(u->input);
-        }
-        if (u->output != NULL) {
-            for (c = 0; c < u->output_count; c++)
-                pa_xfree(u->output[c]);
-            pa_xfree(u->output);
+    for (j = 0; j < u->n_shares; j++) {
+        if (u->output[j] == u->input[j]) {
+            if (u->input[j] != NULL) {
+                for (c = 0; c < u->max_ladspaport_count; c++)
+                    pa_xfree(u->input[j][c]);
+                pa_xfree(u->input[j]);
+            }
+        } else {
+            if (u->input[j] != NULL) {
+                for (c = 0; c < u->input_count; c++)
+                    pa_xfree(u->input[j][c]);
+                pa_xfree(u->input[j]);
+            }
+            if (u->output[j] != NULL) {
+                for (c = 0; c < u->output_count; c++)
+                    pa_xfree(u->output[j][c]);
+                pa_xfree(u->output[j]);
+            }
         }
     }
 
@@ -0,0 +1,246 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/module.h>
+#include <pulsecore/modargs.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/histogram.h>
+#include <pulsecore/sink.h>
+#include <pulsecore/sink-input.h>
+#include <pulsecore/source.h>
+#include <pulsecore/protocol-native.h>
+#include <pulsecore/pstream.h>
+#include <pulsecore/pstream-util.h>
+#include <pulsecore/tagstruct.h>
+
+#include "module-latency-histograms-symdef.h"
+
+PA_MODULE_AUTHOR("PulseAudio developers");
+PA_MODULE_DESCRIPTION("Export the IO thread latency histograms of devices and streams");
+PA_MODULE_VERSION(PACKAGE_VERSION);
+PA_MODULE_LOAD_ONCE(TRUE);
+
+static const char* const valid_modargs[] = {
+    NULL
+};
+
+struct userdata {
+    pa_native_protocol *protocol;
+};
+
+#define EXT_VERSION 1
+
+/* Protocol extension commands */
+enum {
+    SUBCOMMAND_TEST,
+    SUBCOMMAND_READ,
+    SUBCOMMAND_RESET
+};
+
+/* Keep in sync with pa_ext_latency_histograms_object_t */
+enum {
+    OBJECT_SINK,
+    OBJECT_SOURCE,
+    OBJECT_SINK_INPUT
+};
+
+static void put_histogram(pa_tagstruct *reply, uint32_t object, uint32_t idx, const char *measure, pa_histogram *h) {
+    uint32_t counts[PA_HISTOGRAM_BUCKETS];
+    unsigned k;
+
+    pa_histogram_get(h, counts);
+
+    pa_tagstruct_putu32(reply, object);
+    pa_tagstruct_putu32(reply, idx);
+    pa_tagstruct_puts(reply, measure);
+    pa_tagstruct_putu32(reply, PA_HISTOGRAM_BUCKETS);
+
+    for (k = 0; k < PA_HISTOGRAM_BUCKETS; k++)
+        pa_tagstruct_putu32(reply, counts[k]);
+}
+
+/* The histograms are only written to from the IO threads, and the
+ * rtpoll objects are set up and freed from the main thread while the
+ * device is not linked, so everything can be read from here without
+ * talking to the IO threads. */
+static void read_histograms(pa_core *c, pa_tagstruct *reply) {
+    pa_sink *sink;
+    pa_source *source;
+    pa_sink_input *i;
+    uint32_t idx;
+
+    PA_IDXSET_FOREACH(sink, c->sinks, idx) {
+        if (!PA_SINK_IS_LINKED(sink->state))
+            continue;
+
+        put_histogram(reply, OBJECT_SINK, sink->index, "render", &sink->thread_info.render_time);
+
+        if (sink->thread_info.rtpoll)
+            put_histogram(reply, OBJECT_SINK, sink->index, "wakeup", pa_rtpoll_get_lateness(sink->thread_info.rtpoll));
+    }
+
+    PA_IDXSET_FOREACH(source, c->sources, idx) {
+        if (!PA_SOURCE_IS_LINKED(source->state))
+            continue;
+
+        put_histogram(reply, OBJECT_SOURCE, source->index, "post", &source->thread_info.post_time);
+
+        /* A monitor source shares the thread of its sink */
+        if (source->thread_info.rtpoll && !source->monitor_of)
+            put_histogram(reply, OBJECT_SOURCE, source->index, "wakeup", pa_rtpoll_get_lateness(source->thread_info.rtpoll));
+    }
+
+    PA_IDXSET_FOREACH(i, c->sink_inputs, idx) {
+        if (!PA_SINK_INPUT_IS_LINKED(i->state))
+            continue;
+
+        put_histogram(reply, OBJECT_SINK_INPUT, i->index, "pop", &i->thread_info.pop_time);
+    }
+}
+
+static void reset_histograms(pa_core *c) {
+    pa_sink *sink;
+    pa_source *source;
+    pa_sink_input *i;
+    uint32_t idx;
+
+    PA_IDXSET_FOREACH(sink, c->sinks, idx) {
+        if (!PA_SINK_IS_LINKED(sink->state))
+            continue;
+
+        pa_histogram_reset(&sink->thread_info.render_time);
+
+        if (sink->thread_info.rtpoll)
+            pa_histogram_reset(pa_rtpoll_get_lateness(sink->thread_info.rtpoll));
+    }
+
+    PA_IDXSET_FOREACH(source, c->sources, idx) {
+        if (!PA_SOURCE_IS_LINKED(source->state))
+            continue;
+
+        pa_histogram_reset(&source->thread_info.post_time);
+
+        if (source->thread_info.rtpoll)
+            pa_histogram_reset(pa_rtpoll_get_lateness(source->thread_info.rtpoll));
+    }
+
+    PA_IDXSET_FOREACH(i, c->sink_inputs, idx)
+        if (PA_SINK_INPUT_IS_LINKED(i->state))
+            pa_histogram_reset(&i->thread_info.pop_time);
+}
+
+static int extension_cb(pa_native_protocol *p, pa_module *m, pa_native_connection *c, uint32_t tag, pa_tagstruct *t) {
+    uint32_t command;
+    pa_tagstruct *reply = NULL;
+
+    pa_assert(p);
+    pa_assert(m);
+    pa_assert(c);
+    pa_assert(t);
+
+    if (pa_tagstruct_getu32(t, &command) < 0)
+        goto fail;
+
+    reply = pa_tagstruct_new(NULL, 0);
+    pa_tagstruct_putu32(reply, PA_COMMAND_REPLY);
+    pa_tagstruct_putu32(reply, tag);
+
+    switch (command) {
+        case SUBCOMMAND_TEST: {
+            if (!pa_tagstruct_eof(t))
+                goto fail;
+
+            pa_tagstruct_putu32(reply, EXT_VERSION);
+            break;
+        }
+
+        case SUBCOMMAND_READ: {
+            if (!pa_tagstruct_eof(t))
+                goto fail;
+
+            read_histograms(m->core, reply);
+            break;
+        }
+
+        case SUBCOMMAND_RESET: {
+            if (!pa_tagstruct_eof(t))
+                goto fail;
+
+            reset_histograms(m->core);
+            break;
+        }
+
+        default:
+            goto fail;
+    }
+
+    pa_pstream_send_tagstruct(pa_native_connection_get_pstream(c), reply);
+    return 0;
+
+fail:
+
+    if (reply)
+        pa_tagstruct_free(reply);
+
+    return -1;
+}
+
+int pa__init(pa_module*m) {
+    pa_modargs *ma = NULL;
+    struct userdata *u;
+
+    pa_assert(m);
+
+    if (!(ma = pa_modargs_new(m->argument, valid_modargs))) {
+        pa_log("Failed to parse module arguments");
+        return -1;
+    }
+
+    pa_modargs_free(ma);
+
+    m->userdata = u = pa_xnew0(struct userdata, 1);
+
+    u->protocol = pa_native_protocol_get(m->core);
+    pa_native_protocol_install_ext(u->protocol, m, extension_cb);
+
+    return 0;
+}
+
+void pa__done(pa_module*m) {
+    struct userdata* u;
+
+    pa_assert(m);
+
+    if (!(u = m->userdata))
+        return;
+
+    if (u->protocol) {
+        pa_native_protocol_remove_ext(u->protocol, m);
+        pa_native_protocol_unref(u->protocol);
+    }
+
+    pa_xfree(u);
+}
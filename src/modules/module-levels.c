@@ -0,0 +1,369 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/rtclock.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/module.h>
+#include <pulsecore/modargs.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/hashmap.h>
+#include <pulsecore/level-meter.h>
+#include <pulsecore/sink.h>
+#include <pulsecore/sink-input.h>
+#include <pulsecore/source.h>
+#include <pulsecore/protocol-native.h>
+#include <pulsecore/pstream.h>
+#include <pulsecore/pstream-util.h>
+#include <pulsecore/tagstruct.h>
+
+#include "module-levels-symdef.h"
+
+PA_MODULE_AUTHOR("PulseAudio developers");
+PA_MODULE_DESCRIPTION("Send the peak and RMS levels of devices and streams to clients");
+PA_MODULE_VERSION(PACKAGE_VERSION);
+PA_MODULE_LOAD_ONCE(TRUE);
+
+static const char* const valid_modargs[] = {
+    NULL
+};
+
+/* The intervals a client may ask for */
+#define MIN_INTERVAL (10*PA_USEC_PER_MSEC)
+#define MAX_INTERVAL (10*PA_USEC_PER_SEC)
+
+struct userdata {
+    pa_core *core;
+    pa_module *module;
+    pa_native_protocol *protocol;
+    pa_hook_slot *connection_unlink_hook_slot;
+
+    /* pa_native_connection -> requested interval in usec */
+    pa_hashmap *subscribed;
+
+    pa_time_event *time_event;
+    pa_usec_t interval;
+};
+
+#define EXT_VERSION 1
+
+/* Protocol extension commands */
+enum {
+    SUBCOMMAND_TEST,
+    SUBCOMMAND_SUBSCRIBE,
+    SUBCOMMAND_EVENT
+};
+
+/* Keep in sync with pa_ext_levels_object_t */
+enum {
+    OBJECT_SINK,
+    OBJECT_SOURCE,
+    OBJECT_SINK_INPUT
+};
+
+struct level {
+    uint32_t object;
+    uint32_t index;
+    uint32_t peak;
+    uint32_t rms;
+};
+
+static void take_level(struct level *l, uint32_t object, uint32_t idx, pa_level_meter *m) {
+    float peak, rms;
+
+    pa_level_meter_read(m, &peak, &rms);
+
+    l->object = object;
+    l->index = idx;
+    l->peak = (uint32_t) (peak * PA_LEVEL_METER_ONE + 0.5f);
+    l->rms = (uint32_t) (rms * PA_LEVEL_METER_ONE + 0.5f);
+}
+
+/* Turns the meters of all objects on or off, and returns how many are
+ * on. Encoded data has no level, so passthrough devices and streams
+ * are left out. */
+static unsigned enable_meters(struct userdata *u, pa_bool_t enabled) {
+    pa_sink *sink;
+    pa_source *source;
+    pa_sink_input *i;
+    uint32_t idx;
+    unsigned n = 0;
+
+    PA_IDXSET_FOREACH(sink, u->core->sinks, idx) {
+        pa_bool_t b = enabled && PA_SINK_IS_LINKED(sink->state) && !pa_sink_is_passthrough(sink);
+
+        pa_level_meter_set_enabled(&sink->thread_info.level, b);
+        n += b;
+    }
+
+    PA_IDXSET_FOREACH(source, u->core->sources, idx) {
+        pa_bool_t b = enabled && PA_SOURCE_IS_LINKED(source->state) && !pa_source_is_passthrough(source);
+
+        pa_level_meter_set_enabled(&source->thread_info.level, b);
+        n += b;
+    }
+
+    PA_IDXSET_FOREACH(i, u->core->sink_inputs, idx) {
+        pa_bool_t b = enabled && PA_SINK_INPUT_IS_LINKED(i->state) && !pa_sink_input_is_passthrough(i);
+
+        pa_level_meter_set_enabled(&i->thread_info.level, b);
+        n += b;
+    }
+
+    return n;
+}
+
+/* Reads the meters enabled by enable_meters() into levels[max] */
+static unsigned read_levels(struct userdata *u, struct level *levels, unsigned max) {
+    pa_sink *sink;
+    pa_source *source;
+    pa_sink_input *i;
+    uint32_t idx;
+    unsigned n = 0;
+
+    PA_IDXSET_FOREACH(sink, u->core->sinks, idx)
+        if (n < max && pa_level_meter_is_enabled(&sink->thread_info.level))
+            take_level(&levels[n++], OBJECT_SINK, sink->index, &sink->thread_info.level);
+
+    PA_IDXSET_FOREACH(source, u->core->sources, idx)
+        if (n < max && pa_level_meter_is_enabled(&source->thread_info.level))
+            take_level(&levels[n++], OBJECT_SOURCE, source->index, &source->thread_info.level);
+
+    PA_IDXSET_FOREACH(i, u->core->sink_inputs, idx)
+        if (n < max && pa_level_meter_is_enabled(&i->thread_info.level))
+            take_level(&levels[n++], OBJECT_SINK_INPUT, i->index, &i->thread_info.level);
+
+    return n;
+}
+
+static void send_levels(struct userdata *u, const struct level *levels, unsigned n) {
+    const void *c;
+    void *state = NULL;
+
+    while (pa_hashmap_iterate(u->subscribed, &state, &c)) {
+        pa_tagstruct *t;
+        unsigned k;
+
+        t = pa_tagstruct_new(NULL, 0);
+        pa_tagstruct_putu32(t, PA_COMMAND_EXTENSION);
+        pa_tagstruct_putu32(t, 0);
+        pa_tagstruct_putu32(t, u->module->index);
+        pa_tagstruct_puts(t, u->module->name);
+        pa_tagstruct_putu32(t, SUBCOMMAND_EVENT);
+        pa_tagstruct_putu32(t, n);
+
+        for (k = 0; k < n; k++) {
+            pa_tagstruct_putu32(t, levels[k].object);
+            pa_tagstruct_putu32(t, levels[k].index);
+            pa_tagstruct_putu32(t, levels[k].peak);
+            pa_tagstruct_putu32(t, levels[k].rms);
+        }
+
+        pa_pstream_send_tagstruct(pa_native_connection_get_pstream((pa_native_connection*) c), t);
+    }
+}
+
+static void time_cb(pa_mainloop_api *a, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    struct userdata *u = userdata;
+    struct level *levels;
+    unsigned n;
+
+    pa_assert(u);
+    pa_assert(e == u->time_event);
+
+    /* Read before enabling the meters of new objects, which haven't
+     * measured anything yet */
+    n = pa_idxset_size(u->core->sinks) + pa_idxset_size(u->core->sources) + pa_idxset_size(u->core->sink_inputs);
+    levels = pa_xnew(struct level, PA_MAX(n, 1U));
+    n = read_levels(u, levels, n);
+
+    send_levels(u, levels, n);
+    pa_xfree(levels);
+
+    enable_meters(u, TRUE);
+
+    pa_core_rttime_restart(u->core, e, pa_rtclock_now() + u->interval);
+}
+
+/* Follows the shortest interval any client asked for, and stops
+ * measuring when nobody is subscribed anymore */
+static void update_interval(struct userdata *u) {
+    void *state, *p;
+    pa_usec_t interval = 0;
+
+    PA_HASHMAP_FOREACH(p, u->subscribed, state) {
+        pa_usec_t i = (pa_usec_t) PA_PTR_TO_UINT(p);
+
+        if (interval <= 0 || i < interval)
+            interval = i;
+    }
+
+    if (interval == u->interval)
+        return;
+
+    u->interval = interval;
+
+    if (interval <= 0) {
+        u->core->mainloop->time_free(u->time_event);
+        u->time_event = NULL;
+
+        enable_meters(u, FALSE);
+        pa_log_debug("Stopped measuring levels.");
+        return;
+    }
+
+    if (!u->time_event) {
+        enable_meters(u, TRUE);
+        u->time_event = pa_core_rttime_new(u->core, pa_rtclock_now() + interval, time_cb, u);
+    } else
+        pa_core_rttime_restart(u->core, u->time_event, pa_rtclock_now() + interval);
+
+    pa_log_debug("Sending levels every %llu ms.", (unsigned long long) (interval / PA_USEC_PER_MSEC));
+}
+
+static int extension_cb(pa_native_protocol *p, pa_module *m, pa_native_connection *c, uint32_t tag, pa_tagstruct *t) {
+    struct userdata *u;
+    uint32_t command;
+    pa_tagstruct *reply = NULL;
+
+    pa_assert(p);
+    pa_assert(m);
+    pa_assert(c);
+    pa_assert(t);
+
+    u = m->userdata;
+
+    if (pa_tagstruct_getu32(t, &command) < 0)
+        goto fail;
+
+    reply = pa_tagstruct_new(NULL, 0);
+    pa_tagstruct_putu32(reply, PA_COMMAND_REPLY);
+    pa_tagstruct_putu32(reply, tag);
+
+    switch (command) {
+        case SUBCOMMAND_TEST: {
+            if (!pa_tagstruct_eof(t))
+                goto fail;
+
+            pa_tagstruct_putu32(reply, EXT_VERSION);
+            break;
+        }
+
+        case SUBCOMMAND_SUBSCRIBE: {
+            pa_usec_t interval;
+
+            if (pa_tagstruct_get_usec(t, &interval) < 0 ||
+                !pa_tagstruct_eof(t))
+                goto fail;
+
+            if (interval > 0 && (interval < MIN_INTERVAL || interval > MAX_INTERVAL))
+                goto fail;
+
+            pa_hashmap_remove(u->subscribed, c);
+
+            if (interval > 0)
+                pa_assert_se(pa_hashmap_put(u->subscribed, c, PA_UINT_TO_PTR((unsigned) interval)) >= 0);
+
+            update_interval(u);
+            break;
+        }
+
+        default:
+            goto fail;
+    }
+
+    pa_pstream_send_tagstruct(pa_native_connection_get_pstream(c), reply);
+    return 0;
+
+fail:
+
+    if (reply)
+        pa_tagstruct_free(reply);
+
+    return -1;
+}
+
+static pa_hook_result_t connection_unlink_hook_cb(pa_native_protocol *p, pa_native_connection *c, struct userdata *u) {
+    pa_assert(p);
+    pa_assert(c);
+    pa_assert(u);
+
+    if (pa_hashmap_remove(u->subscribed, c))
+        update_interval(u);
+
+    return PA_HOOK_OK;
+}
+
+int pa__init(pa_module*m) {
+    pa_modargs *ma = NULL;
+    struct userdata *u;
+
+    pa_assert(m);
+
+    if (!(ma = pa_modargs_new(m->argument, valid_modargs))) {
+        pa_log("Failed to parse module arguments");
+        return -1;
+    }
+
+    pa_modargs_free(ma);
+
+    m->userdata = u = pa_xnew0(struct userdata, 1);
+    u->core = m->core;
+    u->module = m;
+    u->subscribed = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+
+    u->protocol = pa_native_protocol_get(m->core);
+    pa_native_protocol_install_ext(u->protocol, m, extension_cb);
+
+    u->connection_unlink_hook_slot = pa_hook_connect(&pa_native_protocol_hooks(u->protocol)[PA_NATIVE_HOOK_CONNECTION_UNLINK], PA_HOOK_NORMAL, (pa_hook_cb_t) connection_unlink_hook_cb, u);
+
+    return 0;
+}
+
+void pa__done(pa_module*m) {
+    struct userdata* u;
+
+    pa_assert(m);
+
+    if (!(u = m->userdata))
+        return;
+
+    if (u->time_event) {
+        u->core->mainloop->time_free(u->time_event);
+        enable_meters(u, FALSE);
+    }
+
+    if (u->connection_unlink_hook_slot)
+        pa_hook_slot_free(u->connection_unlink_hook_slot);
+
+    if (u->protocol) {
+        pa_native_protocol_remove_ext(u->protocol, m);
+        pa_native_protocol_unref(u->protocol);
+    }
+
+    if (u->subscribed)
+        pa_hashmap_free(u->subscribed, NULL, NULL);
+
+    pa_xfree(u);
+}
@@ -34,6 +34,7 @@
 #include <pulsecore/namereg.h>
 #include <pulsecore/log.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/rate-control.h>
 
 #include <pulse/rtclock.h>
 #include <pulse/timeval.h>
@@ -63,7 +64,7 @@ PA_MODULE_USAGE(
 
 #define MEMBLOCKQ_MAXLENGTH (1024*1024*16)
 
-#define DEFAULT_ADJUST_TIME_USEC (10*PA_USEC_PER_SEC)
+#define DEFAULT_ADJUST_TIME_USEC (1*PA_USEC_PER_SEC)
 
 struct userdata {
     pa_core *core;
@@ -79,6 +80,7 @@ struct userdata {
 
     pa_time_event *time_event;
     pa_usec_t adjust_time;
+    pa_rate_controller *rate_controller;
 
     int64_t recv_counter;
     int64_t send_counter;
@@ -165,9 +167,10 @@ static void teardown(struct userdata *u) {
 
 /* Called from main context */
 static void adjust_rates(struct userdata *u) {
-    size_t buffer, fs;
-    uint32_t old_rate, base_rate, new_rate;
+    size_t buffer;
+    uint32_t base_rate, new_rate;
     pa_usec_t buffer_latency;
+    int64_t error;
 
     pa_assert(u);
     pa_assert_ctl_context();
@@ -196,27 +199,17 @@ static void adjust_rates(struct userdata *u) {
                 u->latency_snapshot.max_request*2,
                 u->latency_snapshot.min_memblockq_length);
 
-    fs = pa_frame_size(&u->sink_input->sample_spec);
-    old_rate = u->sink_input->sample_spec.rate;
     base_rate = u->source_output->sample_spec.rate;
+    error = (int64_t) pa_bytes_to_usec(u->latency_snapshot.min_memblockq_length, &u->source_output->sample_spec) -
+        (int64_t) pa_bytes_to_usec(u->latency_snapshot.max_request*2, &u->source_output->sample_spec);
 
-    if (u->latency_snapshot.min_memblockq_length < u->latency_snapshot.max_request*2)
-        new_rate = base_rate - (((u->latency_snapshot.max_request*2 - u->latency_snapshot.min_memblockq_length) / fs) *PA_USEC_PER_SEC)/u->adjust_time;
-    else
-        new_rate = base_rate + (((u->latency_snapshot.min_memblockq_length - u->latency_snapshot.max_request*2) / fs) *PA_USEC_PER_SEC)/u->adjust_time;
+    /* The controller only changes the rate in inaudible steps, and never
+     * by more than a few percent */
+    new_rate = pa_rate_controller_update(u->rate_controller, pa_rtclock_now(), error);
 
-    if (new_rate < (uint32_t) (base_rate*0.8) || new_rate > (uint32_t) (base_rate*1.25)) {
-        pa_log_warn("Sample rates too different, not adjusting (%u vs. %u).", base_rate, new_rate);
-        new_rate = base_rate;
-    } else {
-        if (base_rate < new_rate + 20 && new_rate < base_rate + 20)
-          new_rate = base_rate;
-        /* Do the adjustment in small steps; 2‰ can be considered inaudible */
-        if (new_rate < (uint32_t) (old_rate*0.998) || new_rate > (uint32_t) (old_rate*1.002)) {
-            pa_log_info("New rate of %u Hz not within 2‰ of %u Hz, forcing smaller adjustment", new_rate, old_rate);
-            new_rate = PA_CLAMP(new_rate, (uint32_t) (old_rate*0.998), (uint32_t) (old_rate*1.002));
-        }
-    }
+    if (new_rate != base_rate)
+        pa_log_debug("Buffer is %0.2f ms off, %0.1f‰ rate deviation", (double) error / PA_USEC_PER_MSEC,
+                     ((double) new_rate / base_rate - 1.0) * 1000.0);
 
     pa_sink_input_set_rate(u->sink_input, new_rate);
     pa_log_debug("[%s] Updated sampling rate to %lu Hz.", u->sink_input->sink->name, (unsigned long) new_rate);
@@ -241,6 +234,8 @@ static void enable_adjust_timer(struct userdata *u, bool enable) {
         if (u->time_event || u->adjust_time <= 0)
             return;
 
+        /* Whatever was learned before no longer applies */
+        pa_rate_controller_reset(u->rate_controller, u->source_output->sample_spec.rate);
         u->time_event = pa_core_rttime_new(u->module->core, pa_rtclock_now() + u->adjust_time, time_callback, u);
     } else {
         if (!u->time_event)
@@ -410,6 +405,9 @@ static void source_output_moving_cb(pa_source_output *o, pa_source *dest) {
 
     pa_sink_input_update_proplist(u->sink_input, PA_UPDATE_REPLACE, p);
     pa_proplist_free(p);
+
+    /* The clocks are different ones now */
+    pa_rate_controller_reset(u->rate_controller, u->source_output->sample_spec.rate);
 }
 
 /* Called from main thread */
@@ -664,6 +662,9 @@ static void sink_input_moving_cb(pa_sink_input *i, pa_sink *dest) {
 
     pa_source_output_update_proplist(u->source_output, PA_UPDATE_REPLACE, p);
     pa_proplist_free(p);
+
+    /* The clocks are different ones now */
+    pa_rate_controller_reset(u->rate_controller, u->source_output->sample_spec.rate);
 }
 
 /* Called from main thread */
@@ -798,6 +799,10 @@ int pa__init(pa_module *m) {
     else
         u->adjust_time = DEFAULT_ADJUST_TIME_USEC;
 
+    /* Settle over ten adjustments, so that noise in the latency
+     * measurements averages out */
+    u->rate_controller = pa_rate_controller_new(ss.rate, 10 * PA_MAX(u->adjust_time, DEFAULT_ADJUST_TIME_USEC));
+
     pa_sink_input_new_data_init(&sink_input_data);
     sink_input_data.driver = __FILE__;
     sink_input_data.module = m;
@@ -990,5 +995,8 @@ void pa__done(pa_module*m) {
     if (u->asyncmsgq)
         pa_asyncmsgq_unref(u->asyncmsgq);
 
+    if (u->rate_controller)
+        pa_rate_controller_free(u->rate_controller);
+
     pa_xfree(u);
 }
@@ -42,6 +42,7 @@
 #include <pulsecore/thread.h>
 #include <pulsecore/thread-mq.h>
 #include <pulsecore/rtpoll.h>
+#include <pulsecore/shared-thread.h>
 
 #include "module-null-sink-symdef.h"
 
@@ -55,7 +56,8 @@ PA_MODULE_USAGE(
         "format=<sample format> "
         "rate=<sample rate> "
         "channels=<number of channels> "
-        "channel_map=<channel map>");
+        "channel_map=<channel map> "
+        "shared_thread=<share an IO thread with other devices?>");
 
 #define DEFAULT_SINK_NAME "null"
 #define BLOCK_USEC (PA_USEC_PER_SEC * 2)
@@ -69,6 +71,8 @@ struct userdata {
     pa_thread_mq thread_mq;
     pa_rtpoll *rtpoll;
 
+    pa_shared_thread_client *shared_thread;
+
     pa_usec_t block_usec;
     pa_usec_t timestamp;
 };
@@ -80,6 +84,7 @@ static const char* const valid_modargs[] = {
     "rate",
     "channels",
     "channel_map",
+    "shared_thread",
     NULL
 };
 
@@ -178,15 +183,15 @@ static void process_render(struct userdata *u, pa_usec_t now) {
 
     /* Fill the buffer up the latency size */
     while (u->timestamp < now + u->block_usec) {
-        pa_memchunk chunk;
+        size_t n;
 
-        pa_sink_render(u->sink, u->sink->thread_info.max_request, &chunk);
-        pa_memblock_unref(chunk.memblock);
+        /* Nothing is mixed unless the monitor source is listened to */
+        n = pa_sink_skip(u->sink, u->sink->thread_info.max_request);
 
-/*         pa_log_debug("Ate %lu bytes.", (unsigned long) chunk.length); */
-        u->timestamp += pa_bytes_to_usec(chunk.length, &u->sink->sample_spec);
+/*         pa_log_debug("Ate %lu bytes.", (unsigned long) n); */
+        u->timestamp += pa_bytes_to_usec(n, &u->sink->sample_spec);
 
-        ate += chunk.length;
+        ate += n;
 
         if (ate >= u->sink->thread_info.max_request)
             break;
@@ -195,6 +200,34 @@ static void process_render(struct userdata *u, pa_usec_t now) {
 /*     pa_log_debug("Ate in sum %lu bytes (of %lu)", (unsigned long) ate, (unsigned long) nbytes); */
 }
 
+/* Render some data and drop it immediately */
+static void process(struct userdata *u, pa_usec_t now) {
+
+    if (u->sink->thread_info.rewind_requested) {
+        if (u->sink->thread_info.rewind_nbytes > 0)
+            process_rewind(u, now);
+        else
+            pa_sink_process_rewind(u->sink, 0);
+    }
+
+    if (u->timestamp <= now)
+        process_render(u, now);
+}
+
+/* Called from IO context */
+static pa_usec_t shared_thread_cb(pa_shared_thread_client *c, pa_usec_t now, void *userdata) {
+    struct userdata *u = userdata;
+
+    pa_assert(u);
+
+    if (!PA_SINK_IS_OPENED(u->sink->thread_info.state))
+        return 0;
+
+    process(u, now);
+
+    return u->timestamp;
+}
+
 static void thread_func(void *userdata) {
     struct userdata *u = userdata;
 
@@ -209,22 +242,8 @@ static void thread_func(void *userdata) {
     for (;;) {
         int ret;
 
-        /* Render some data and drop it immediately */
         if (PA_SINK_IS_OPENED(u->sink->thread_info.state)) {
-            pa_usec_t now;
-
-            now = pa_rtclock_now();
-
-            if (u->sink->thread_info.rewind_requested) {
-                if (u->sink->thread_info.rewind_nbytes > 0)
-                    process_rewind(u, now);
-                else
-                    pa_sink_process_rewind(u->sink, 0);
-            }
-
-            if (u->timestamp <= now)
-                process_render(u, now);
-
+            process(u, pa_rtpoll_now(u->rtpoll));
             pa_rtpoll_set_timer_absolute(u->rtpoll, u->timestamp);
         } else
             pa_rtpoll_set_timer_disabled(u->rtpoll);
@@ -254,6 +273,7 @@ int pa__init(pa_module*m) {
     pa_modargs *ma = NULL;
     pa_sink_new_data data;
     size_t nbytes;
+    pa_bool_t shared_thread = FALSE;
 
     pa_assert(m);
 
@@ -269,11 +289,19 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    if (pa_modargs_get_value_boolean(ma, "shared_thread", &shared_thread) < 0) {
+        pa_log("shared_thread= expects a boolean argument.");
+        goto fail;
+    }
+
     m->userdata = u = pa_xnew0(struct userdata, 1);
     u->core = m->core;
     u->module = m;
-    u->rtpoll = pa_rtpoll_new();
-    pa_thread_mq_init(&u->thread_mq, m->core->mainloop, u->rtpoll);
+
+    if (!shared_thread) {
+        u->rtpoll = pa_rtpoll_new();
+        pa_thread_mq_init(&u->thread_mq, m->core->mainloop, u->rtpoll);
+    }
 
     pa_sink_new_data_init(&data);
     data.driver = __FILE__;
@@ -302,17 +330,30 @@ int pa__init(pa_module*m) {
     u->sink->update_requested_latency = sink_update_requested_latency_cb;
     u->sink->userdata = u;
 
-    pa_sink_set_asyncmsgq(u->sink, u->thread_mq.inq);
-    pa_sink_set_rtpoll(u->sink, u->rtpoll);
-
     u->block_usec = BLOCK_USEC;
     nbytes = pa_usec_to_bytes(u->block_usec, &u->sink->sample_spec);
     pa_sink_set_max_rewind(u->sink, nbytes);
     pa_sink_set_max_request(u->sink, nbytes);
 
-    if (!(u->thread = pa_thread_new("null-sink", thread_func, u))) {
-        pa_log("Failed to create thread.");
-        goto fail;
+    if (shared_thread) {
+        u->timestamp = pa_rtclock_now();
+
+        if (!(u->shared_thread = pa_shared_thread_attach(m->core, m, shared_thread_cb, u))) {
+            pa_log("Failed to get a shared thread.");
+            goto fail;
+        }
+
+        pa_sink_set_asyncmsgq(u->sink, pa_shared_thread_get_asyncmsgq(u->shared_thread));
+        pa_sink_set_rtpoll(u->sink, pa_shared_thread_get_rtpoll(u->shared_thread));
+
+    } else {
+        pa_sink_set_asyncmsgq(u->sink, u->thread_mq.inq);
+        pa_sink_set_rtpoll(u->sink, u->rtpoll);
+
+        if (!(u->thread = pa_thread_new("null-sink", thread_func, u))) {
+            pa_log("Failed to create thread.");
+            goto fail;
+        }
     }
 
     pa_sink_set_latency_range(u->sink, 0, BLOCK_USEC);
@@ -352,6 +393,9 @@ void pa__done(pa_module*m) {
     if (u->sink)
         pa_sink_unlink(u->sink);
 
+    if (u->shared_thread)
+        pa_shared_thread_detach(u->shared_thread);
+
     if (u->thread) {
         pa_asyncmsgq_send(u->thread_mq.inq, NULL, PA_MESSAGE_SHUTDOWN, NULL, 0, NULL);
         pa_thread_free(u->thread);
@@ -142,7 +142,7 @@ static void thread_func(void *userdata) {
             pa_usec_t now;
             pa_memchunk chunk;
 
-            now = pa_rtclock_now();
+            now = pa_rtpoll_now(u->rtpoll);
 
             if ((chunk.length = pa_usec_to_bytes(now - u->timestamp, &u->source->sample_spec)) > 0) {
 
@@ -30,6 +30,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 
 #ifdef HAVE_SYS_FILIO_H
 #include <sys/filio.h>
@@ -47,6 +48,7 @@
 #include <pulsecore/thread-mq.h>
 #include <pulsecore/rtpoll.h>
 #include <pulsecore/poll.h>
+#include <pulsecore/memblockq.h>
 
 #include "module-pipe-sink-symdef.h"
 
@@ -61,11 +63,20 @@ PA_MODULE_USAGE(
         "format=<sample format> "
         "rate=<sample rate> "
         "channels=<number of channels> "
-        "channel_map=<channel map>");
+        "channel_map=<channel map> "
+        "use_vmsplice=<map the data into the FIFO instead of copying it?>");
 
 #define DEFAULT_FILE_NAME "fifo_output"
 #define DEFAULT_SINK_NAME "fifo_output"
 
+/* vmsplice() only hands the pages to the pipe, so the blocks have to be
+ * kept until the reader consumed them, which FIONREAD tells */
+#if defined(SPLICE_F_NONBLOCK) && defined(FIONREAD)
+#define USE_VMSPLICE
+#endif
+
+#define MEMBLOCKQ_MAXLENGTH (16*1024*1024)
+
 struct userdata {
     pa_core *core;
     pa_module *module;
@@ -83,6 +94,10 @@ struct userdata {
     pa_rtpoll_item *rtpoll_item;
 
     int write_type;
+
+    /* What was spliced into the FIFO and not read yet, NULL unless
+     * use_vmsplice is on */
+    pa_memblockq *spliced;
 };
 
 static const char* const valid_modargs[] = {
@@ -93,6 +108,7 @@ static const char* const valid_modargs[] = {
     "rate",
     "channels",
     "channel_map",
+    "use_vmsplice",
     NULL
 };
 
@@ -121,9 +137,51 @@ static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offse
     return pa_sink_process_msg(o, code, data, offset, chunk);
 }
 
+#ifdef USE_VMSPLICE
+/* The data still in the FIFO is the newest that went in, so everything
+ * spliced before that has been read */
+static void release_spliced(struct userdata *u) {
+    size_t queued;
+    int l;
+
+    if ((queued = pa_memblockq_get_length(u->spliced)) <= 0)
+        return;
+
+    if (ioctl(u->fd, FIONREAD, &l) < 0 || l < 0)
+        return;
+
+    if ((size_t) l < queued)
+        pa_memblockq_drop(u->spliced, queued - (size_t) l);
+}
+
+static ssize_t splice_chunk(struct userdata *u) {
+    struct iovec iov;
+    ssize_t l;
+
+    iov.iov_base = (uint8_t*) pa_memblock_acquire(u->memchunk.memblock) + u->memchunk.index;
+    iov.iov_len = u->memchunk.length;
+    l = vmsplice(u->fd, &iov, 1, SPLICE_F_NONBLOCK);
+    pa_memblock_release(u->memchunk.memblock);
+
+    if (l > 0) {
+        pa_memchunk c = u->memchunk;
+
+        c.length = (size_t) l;
+        pa_assert_se(pa_memblockq_push(u->spliced, &c) >= 0);
+    }
+
+    return l;
+}
+#endif
+
 static int process_render(struct userdata *u) {
     pa_assert(u);
 
+#ifdef USE_VMSPLICE
+    if (u->spliced)
+        release_spliced(u);
+#endif
+
     if (u->memchunk.length <= 0)
         pa_sink_render(u->sink, pa_pipe_buf(u->fd), &u->memchunk);
 
@@ -133,9 +191,16 @@ static int process_render(struct userdata *u) {
         ssize_t l;
         void *p;
 
-        p = pa_memblock_acquire(u->memchunk.memblock);
-        l = pa_write(u->fd, (uint8_t*) p + u->memchunk.index, u->memchunk.length, &u->write_type);
-        pa_memblock_release(u->memchunk.memblock);
+#ifdef USE_VMSPLICE
+        if (u->spliced && pa_memblock_is_stable(u->memchunk.memblock))
+            l = splice_chunk(u);
+        else
+#endif
+        {
+            p = pa_memblock_acquire(u->memchunk.memblock);
+            l = pa_write(u->fd, (uint8_t*) p + u->memchunk.index, u->memchunk.length, &u->write_type);
+            pa_memblock_release(u->memchunk.memblock);
+        }
 
         pa_assert(l != 0);
 
@@ -229,6 +294,7 @@ int pa__init(pa_module*m) {
     pa_modargs *ma;
     struct pollfd *pollfd;
     pa_sink_new_data data;
+    pa_bool_t use_vmsplice = FALSE;
 
     pa_assert(m);
 
@@ -244,6 +310,11 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    if (pa_modargs_get_value_boolean(ma, "use_vmsplice", &use_vmsplice) < 0) {
+        pa_log("Failed to parse use_vmsplice= argument.");
+        goto fail;
+    }
+
     u = pa_xnew0(struct userdata, 1);
     u->core = m->core;
     u->module = m;
@@ -273,6 +344,22 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    if (use_vmsplice) {
+#ifdef USE_VMSPLICE
+        pa_sample_spec bytes;
+
+        /* The FIFO is read in bytes, not frames */
+        pa_sample_spec_init(&bytes);
+        bytes.format = PA_SAMPLE_U8;
+        bytes.rate = ss.rate;
+        bytes.channels = 1;
+
+        u->spliced = pa_memblockq_new("module-pipe-sink spliced", 0, MEMBLOCKQ_MAXLENGTH, 0, &bytes, 0, 1, 0, NULL);
+#else
+        pa_log_warn("vmsplice() is not supported here, copying data into the FIFO.");
+#endif
+    }
+
     pa_sink_new_data_init(&data);
     data.driver = __FILE__;
     data.module = m;
@@ -376,5 +463,8 @@ void pa__done(pa_module*m) {
     if (u->fd >= 0)
         pa_assert_se(pa_close(u->fd) == 0);
 
+    if (u->spliced)
+        pa_memblockq_free(u->spliced);
+
     pa_xfree(u);
 }
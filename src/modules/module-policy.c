@@ -55,6 +55,16 @@ struct userdata {
     pa_module* module_combined;
     pa_module* module_mono_combined;
     pa_native_protocol *protocol;
+
+    /* What policy_select_proper_sink() returned, by policy and mono
+     * setting. An entry only holds while the default sink it was made
+     * for is still the default; sinks coming and going clear them all. */
+    struct {
+        pa_bool_t valid;
+        pa_sink *default_sink;
+        pa_sink *sink;
+    } route_cache[3][2];
+    pa_hook_slot *sink_put_cache_slot;
 };
 
 enum {
@@ -109,20 +119,16 @@ static pa_bool_t policy_is_bluez (pa_sink* sink)
 static pa_sink* policy_get_sink_by_name (pa_core *c, const char* sink_name)
 {
     pa_sink *s = NULL;
-    uint32_t idx;
 
     if (c == NULL || sink_name == NULL) {
                 pa_log_warn ("input param is null");
                 return NULL;
     }
 
-        PA_IDXSET_FOREACH(s, c->sinks, idx) {
-                if (pa_streq (s->name, sink_name)) {
-                        pa_log_debug ("[POLICY][%s] return [%p] for [%s]\n",  __func__, s, sink_name);
-                        return s;
-                }
-        }
-        return NULL;
+        if ((s = pa_namereg_get(c, sink_name, PA_NAMEREG_SINK)))
+                pa_log_debug ("[POLICY][%s] return [%p] for [%s]\n",  __func__, s, sink_name);
+
+        return s;
 }
 
 /* Get bt sink if available */
@@ -189,6 +195,48 @@ static pa_sink* policy_select_proper_sink (pa_core *c, const char* policy, int i
         return sink;
 }
 
+static unsigned policy_cache_index (const char* policy)
+{
+        if (pa_streq(policy, POLICY_ALL))
+                return 2;
+        else if (pa_streq(policy, POLICY_PHONE))
+                return 1;
+
+        /* Anything else is treated as auto */
+        return 0;
+}
+
+/* Like policy_select_proper_sink(), for the current mono setting, but
+ * remembers the answer */
+static pa_sink* policy_select_cached_sink (struct userdata *u, const char* policy)
+{
+        pa_sink *def;
+        unsigned i, j;
+
+        pa_assert(u);
+        pa_assert(policy);
+
+        i = policy_cache_index(policy);
+        j = u->is_mono ? 1 : 0;
+        def = pa_namereg_get_default_sink(u->core);
+
+        if (u->route_cache[i][j].valid && u->route_cache[i][j].default_sink == def)
+                return u->route_cache[i][j].sink;
+
+        u->route_cache[i][j].sink = policy_select_proper_sink(u->core, policy, u->is_mono);
+        u->route_cache[i][j].default_sink = def;
+        u->route_cache[i][j].valid = TRUE;
+
+        return u->route_cache[i][j].sink;
+}
+
+static void policy_invalidate_cache (struct userdata *u)
+{
+        pa_assert(u);
+
+        memset(u->route_cache, 0, sizeof(u->route_cache));
+}
+
 static pa_bool_t policy_is_filter (pa_sink_input* si)
 {
         const char* role = NULL;
@@ -291,7 +339,7 @@ static int extension_cb(pa_native_protocol *p, pa_module *m, pa_native_connectio
                         pa_log_debug("[POLICY] Policy of sink input [%d] = %s", si->index, policy);
 
                         /* Select sink to move and move to it */
-                        sink_to_move = policy_select_proper_sink (u->core, policy, u->is_mono);
+                        sink_to_move = policy_select_cached_sink (u, policy);
                         if (sink_to_move) {
                                 pa_log_debug("[POLICY][%s] Moving sink-input[%d] from [%s] to [%s]", __func__, si->index, si->sink->name, sink_to_move->name);
                                 pa_sink_input_move_to(si, sink_to_move, FALSE);
@@ -352,7 +400,7 @@ static pa_hook_result_t sink_input_new_hook_callback(pa_core *c, pa_sink_input_n
 
     /* Set proper sink to sink-input */
         new_data->save_sink = FALSE;
-        new_data->sink = policy_select_proper_sink (c, policy, u->is_mono);
+        new_data->sink = policy_select_cached_sink (u, policy);
         pa_log_debug("[POLICY][%s] set sink of sink-input to [%s]", __func__, (new_data->sink)? new_data->sink->name : "null");
 
     return PA_HOOK_OK;
@@ -426,7 +474,7 @@ static pa_hook_result_t sink_put_hook_callback(pa_core *c, pa_sink *sink, struct
                         policy = POLICY_AUTO;
                 }
 
-                sink_to_move = policy_select_proper_sink (c, policy, u->is_mono);
+                sink_to_move = policy_select_cached_sink (u, policy);
                 if (sink_to_move) {
                         pa_log_debug("[POLICY][%s] Moving sink-input[%d] from [%s] to [%s]", __func__, si->index, si->sink->name, sink_to_move->name);
                         pa_sink_input_move_to(si, sink_to_move, FALSE);
@@ -473,7 +521,7 @@ static void subscribe_cb(pa_core *c, pa_subscription_event_type_t t, uint32_t id
                                 policy = POLICY_AUTO;
                         }
 
-                        sink_to_move = policy_select_proper_sink (c, policy, u->is_mono);
+                        sink_to_move = policy_select_cached_sink (u, policy);
                         if (sink_to_move) {
                                 /* Move sink-input to new DEFAULT sink */
                                 pa_log_debug("[POLICY][%s] Moving sink-input[%d] from [%s] to [%s]", __func__, si->index, si->sink->name, sink_to_move->name);
@@ -483,6 +531,16 @@ static void subscribe_cb(pa_core *c, pa_subscription_event_type_t t, uint32_t id
     }
 }
 
+static pa_hook_result_t sink_put_cache_callback(pa_core *c, pa_sink *sink, struct userdata *u) {
+    pa_assert(c);
+    pa_assert(sink);
+    pa_assert(u);
+
+    policy_invalidate_cache(u);
+
+    return PA_HOOK_OK;
+}
+
 static pa_hook_result_t sink_unlink_hook_callback(pa_core *c, pa_sink *sink, void* userdata) {
     struct userdata *u = userdata;
     uint32_t idx;
@@ -493,6 +551,8 @@ static pa_hook_result_t sink_unlink_hook_callback(pa_core *c, pa_sink *sink, voi
     pa_assert(sink);
     pa_assert(u);
 
+    policy_invalidate_cache(u);
+
      /* There's no point in doing anything if the core is shut down anyway */
     if (c->state == PA_CORE_SHUTDOWN)
         return PA_HOOK_OK;
@@ -564,6 +624,9 @@ static pa_hook_result_t sink_unlink_post_hook_callback(pa_core *c, pa_sink *sink
 
     pa_log_debug("[POLICY][%s] SINK unlinked POST ================================ sink [%s][%d]", __func__, sink->name, sink->index);
 
+    /* The sink may have been picked again while it was going away */
+    policy_invalidate_cache(u);
+
      /* There's no point in doing anything if the core is shut down anyway */
     if (c->state == PA_CORE_SHUTDOWN)
         return PA_HOOK_OK;
@@ -650,6 +713,10 @@ int pa__init(pa_module *m)
                         pa_hook_connect(&m->core->hooks[PA_CORE_HOOK_SINK_PUT], PA_HOOK_LATE+10, (pa_hook_cb_t) sink_put_hook_callback, u);
         }
 
+        /* Before anybody else can route streams to the new sink */
+        u->sink_put_cache_slot =
+                pa_hook_connect(&m->core->hooks[PA_CORE_HOOK_SINK_PUT], PA_HOOK_EARLY, (pa_hook_cb_t) sink_put_cache_callback, u);
+
         /* sink unlink comes before sink-input unlink */
         u->sink_unlink_slot = pa_hook_connect(&m->core->hooks[PA_CORE_HOOK_SINK_UNLINK], PA_HOOK_EARLY, (pa_hook_cb_t) sink_unlink_hook_callback, u);
         u->sink_unlink_post_slot = pa_hook_connect(&m->core->hooks[PA_CORE_HOOK_SINK_UNLINK_POST], PA_HOOK_EARLY, (pa_hook_cb_t) sink_unlink_post_hook_callback, u);
@@ -695,6 +762,8 @@ void pa__done(pa_module *m)
         pa_hook_slot_free(u->sink_input_new_hook_slot);
     if (u->sink_put_hook_slot)
         pa_hook_slot_free(u->sink_put_hook_slot);
+    if (u->sink_put_cache_slot)
+        pa_hook_slot_free(u->sink_put_cache_slot);
     if (u->subscription)
         pa_subscription_free(u->subscription);
     if (u->protocol) {
@@ -46,6 +46,13 @@
 #include <pulsecore/creds.h>
 #include <pulsecore/arpa-inet.h>
 
+/* The esound socket doesn't live in our runtime directory, so nothing
+ * would be there to activate us on it */
+#if defined(USE_UNIX_SOCKETS) && defined(HAVE_SYSTEMD) && !defined(USE_PROTOCOL_ESOUND)
+#include <systemd/sd-daemon.h>
+#define USE_SOCKET_ACTIVATION
+#endif
+
 #ifdef USE_TCP_SOCKETS
 #define SOCKET_DESCRIPTION "(TCP sockets)"
 #define SOCKET_USAGE "port=<TCP port number> listen=<address to listen on>"
@@ -111,7 +118,7 @@
 #  define TCPWRAP_SERVICE "pulseaudio-native"
 #  define IPV4_PORT PA_NATIVE_DEFAULT_PORT
 #  define UNIX_SOCKET PA_NATIVE_DEFAULT_UNIX_SOCKET
-#  define MODULE_ARGUMENTS_COMMON "cookie", "auth-cookie", "auth-cookie-enabled", "auth-anonymous",
+#  define MODULE_ARGUMENTS_COMMON "cookie", "auth-cookie", "auth-cookie-enabled", "auth-anonymous", "io-threads",
 
 #  ifdef USE_TCP_SOCKETS
 #    include "module-native-protocol-tcp-symdef.h"
@@ -134,6 +141,7 @@
   PA_MODULE_USAGE("auth-anonymous=<don't check for cookies?> "
                   "auth-cookie=<path to cookie file> "
                   "auth-cookie-enabled=<enable cookie authentication?> "
+                  "io-threads=<number of threads for client IO> "
                   AUTH_USAGE
                   SOCKET_USAGE);
 #elif defined(USE_PROTOCOL_ESOUND)
@@ -233,6 +241,28 @@ static void socket_server_on_connection_cb(pa_socket_server*s, pa_iochannel *io,
 #endif
 }
 
+#ifdef USE_SOCKET_ACTIVATION
+/* Looks for a socket listening on path among those the service manager
+ * passed us. Clients may have connected to it before we were even
+ * started, they are served once the main loop runs. */
+static pa_socket_server* get_activated_socket(pa_module *m, const char *path) {
+    int n, fd;
+
+    if ((n = sd_listen_fds(0)) < 0) {
+        pa_log_warn("Failed to get activated sockets: %s", pa_cstrerror(-n));
+        return NULL;
+    }
+
+    for (fd = SD_LISTEN_FDS_START; fd < SD_LISTEN_FDS_START + n; fd++)
+        if (sd_is_socket_unix(fd, SOCK_STREAM, 1, path, 0) > 0) {
+            pa_log_info("Using activated UNIX socket '%s'.", path);
+            return pa_socket_server_new_unix_activated(m->core->mainloop, fd, path);
+        }
+
+    return NULL;
+}
+#endif
+
 int pa__init(pa_module*m) {
     pa_modargs *ma = NULL;
     struct userdata *u = NULL;
@@ -349,14 +379,20 @@ int pa__init(pa_module*m) {
     }
 #  endif
 
-    if ((r = pa_unix_socket_remove_stale(u->socket_path)) < 0) {
-        pa_log("Failed to remove stale UNIX socket '%s': %s", u->socket_path, pa_cstrerror(errno));
-        goto fail;
-    } else if (r > 0)
-        pa_log_info("Removed stale UNIX socket '%s'.", u->socket_path);
+#  ifdef USE_SOCKET_ACTIVATION
+    u->socket_server_unix = get_activated_socket(m, u->socket_path);
+#  endif
 
-    if (!(u->socket_server_unix = pa_socket_server_new_unix(m->core->mainloop, u->socket_path)))
-        goto fail;
+    if (!u->socket_server_unix) {
+        if ((r = pa_unix_socket_remove_stale(u->socket_path)) < 0) {
+            pa_log("Failed to remove stale UNIX socket '%s': %s", u->socket_path, pa_cstrerror(errno));
+            goto fail;
+        } else if (r > 0)
+            pa_log_info("Removed stale UNIX socket '%s'.", u->socket_path);
+
+        if (!(u->socket_server_unix = pa_socket_server_new_unix(m->core->mainloop, u->socket_path)))
+            goto fail;
+    }
 
     pa_socket_server_set_callback(u->socket_server_unix, socket_server_on_connection_cb, u);
 
@@ -23,6 +23,8 @@
 #include <config.h>
 #endif
 
+#include <string.h>
+
 #include <pulse/xmalloc.h>
 
 #include <pulsecore/namereg.h>
@@ -48,7 +50,8 @@ PA_MODULE_USAGE(
         "rate=<sample rate> "
         "channels=<number of channels> "
         "channel_map=<channel map> "
-        "remix=<remix channels?>");
+        "remix=<remix channels?> "
+        "transparent=<remap in the streams if only the order of the channels changes?>");
 
 struct userdata {
     pa_module *module;
@@ -69,6 +72,7 @@ static const char* const valid_modargs[] = {
     "channels",
     "channel_map",
     "remix",
+    "transparent",
     NULL
 };
 
@@ -320,6 +324,41 @@ static void sink_input_moving_cb(pa_sink_input *i, pa_sink *dest) {
     }
 }
 
+/* If the master channel map only reorders the channels of the master,
+ * the sink can store them in the master's order right away, under the
+ * positions they have on the sink. The resamplers of the streams then
+ * remap into that order directly, and the sink input needs no remapping
+ * of its own. Returns FALSE if the maps are not a permutation. */
+static pa_bool_t make_transparent(pa_channel_map *sink_map, pa_channel_map *stream_map, const pa_channel_map *master_map) {
+    pa_channel_map reordered;
+    pa_bool_t used[PA_CHANNELS_MAX];
+    unsigned i, j;
+
+    if (stream_map->channels != master_map->channels)
+        return FALSE;
+
+    memset(used, 0, sizeof(used));
+    reordered.channels = master_map->channels;
+
+    for (j = 0; j < master_map->channels; j++) {
+
+        for (i = 0; i < stream_map->channels; i++)
+            if (!used[i] && stream_map->map[i] == master_map->map[j])
+                break;
+
+        if (i >= stream_map->channels)
+            return FALSE;
+
+        used[i] = TRUE;
+        reordered.map[j] = sink_map->map[i];
+    }
+
+    *sink_map = reordered;
+    *stream_map = *master_map;
+
+    return TRUE;
+}
+
 int pa__init(pa_module*m) {
     struct userdata *u;
     pa_sample_spec ss;
@@ -328,7 +367,7 @@ int pa__init(pa_module*m) {
     pa_sink *master;
     pa_sink_input_new_data sink_input_data;
     pa_sink_new_data sink_data;
-    pa_bool_t remix = TRUE;
+    pa_bool_t remix = TRUE, transparent = TRUE;
 
     pa_assert(m);
 
@@ -368,6 +407,18 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    if (pa_modargs_get_value_boolean(ma, "transparent", &transparent) < 0) {
+        pa_log("Invalid boolean transparent parameter");
+        goto fail;
+    }
+
+    if (transparent && make_transparent(&sink_map, &stream_map, &master->channel_map)) {
+        if (pa_sample_spec_equal(&ss, &master->sample_spec))
+            pa_log_debug("Remapping in the streams, the sink input passes through.");
+        else
+            pa_log_debug("Remapping in the streams, the sink input only resamples.");
+    }
+
     u = pa_xnew0(struct userdata, 1);
     u->module = m;
     m->userdata = u;
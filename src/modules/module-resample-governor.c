@@ -0,0 +1,300 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/hashmap.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/modargs.h>
+#include <pulsecore/module.h>
+#include <pulsecore/resampler.h>
+#include <pulsecore/sink.h>
+#include <pulsecore/sink-input.h>
+
+#include "module-resample-governor-symdef.h"
+
+PA_MODULE_AUTHOR("PulseAudio developers");
+PA_MODULE_DESCRIPTION("Switch streams to cheaper resamplers while their sink is busy");
+PA_MODULE_VERSION(PACKAGE_VERSION);
+PA_MODULE_LOAD_ONCE(TRUE);
+PA_MODULE_USAGE(
+        "high=<percentage of the time a sink may be busy before its streams are degraded> "
+        "low=<percentage below which they are restored again> "
+        "interval_msec=<how often to check>");
+
+#define DEFAULT_HIGH 75
+#define DEFAULT_LOW 40
+#define DEFAULT_INTERVAL_MSEC 1000
+
+static const char* const valid_modargs[] = {
+    "high",
+    "low",
+    "interval_msec",
+    NULL
+};
+
+/* The counters of an object at the last check */
+struct entry {
+    uint32_t usec;
+
+    /* Of sink inputs, the resampling time since the last check */
+    uint32_t delta;
+    pa_bool_t tried;
+};
+
+struct userdata {
+    pa_core *core;
+    pa_module *module;
+
+    uint32_t high, low;
+    pa_usec_t interval;
+
+    pa_time_event *time_event;
+    pa_usec_t last_time;
+
+    /* index -> struct entry */
+    pa_hashmap *sinks;
+    pa_hashmap *sink_inputs;
+};
+
+/* Moves the stream that spent the most time resampling one step
+ * towards a cheaper resampler */
+static void degrade_one(struct userdata *u, pa_sink *s) {
+
+    for (;;) {
+        pa_sink_input *i, *best = NULL;
+        struct entry *e, *best_entry = NULL;
+        uint32_t idx;
+        unsigned n;
+
+        PA_IDXSET_FOREACH(i, s->inputs, idx) {
+            if (!(e = pa_hashmap_get(u->sink_inputs, PA_UINT32_TO_PTR(i->index))) || e->tried || e->delta <= 0)
+                continue;
+
+            if (!best_entry || e->delta > best_entry->delta) {
+                best = i;
+                best_entry = e;
+            }
+        }
+
+        if (!best)
+            return;
+
+        best_entry->tried = TRUE;
+        n = best->resample_degradation;
+
+        if (pa_sink_input_set_resample_degradation(best, n + 1) > n) {
+            pa_log_info("Sink %s is busy, resampling sink input %u with '%s' now.",
+                        s->name, best->index, pa_resample_method_to_string(pa_sink_input_get_resample_method(best)));
+            return;
+        }
+    }
+}
+
+/* Goes back one step with the stream that was degraded the most */
+static void restore_one(struct userdata *u, pa_sink *s) {
+    pa_sink_input *i, *best = NULL;
+    uint32_t idx;
+
+    PA_IDXSET_FOREACH(i, s->inputs, idx)
+        if (PA_SINK_INPUT_IS_LINKED(i->state) &&
+            i->resample_degradation > 0 &&
+            (!best || i->resample_degradation > best->resample_degradation))
+            best = i;
+
+    if (!best)
+        return;
+
+    pa_sink_input_set_resample_degradation(best, best->resample_degradation - 1);
+    pa_log_info("Sink %s is idle enough, resampling sink input %u with '%s' again.",
+                s->name, best->index, pa_resample_method_to_string(pa_sink_input_get_resample_method(best)));
+}
+
+/* Takes the counters of the objects that are still there over into a
+ * new map, so that the ones that are gone drop out */
+static struct entry *update_entry(pa_hashmap *old, pa_hashmap *new, uint32_t idx, uint32_t usec, pa_bool_t *known) {
+    struct entry *e;
+
+    if ((e = pa_hashmap_remove(old, PA_UINT32_TO_PTR(idx)))) {
+        e->delta = usec - e->usec;
+        *known = TRUE;
+    } else {
+        e = pa_xnew0(struct entry, 1);
+        *known = FALSE;
+    }
+
+    e->usec = usec;
+    e->tried = FALSE;
+    pa_assert_se(pa_hashmap_put(new, PA_UINT32_TO_PTR(idx), e) >= 0);
+
+    return e;
+}
+
+static void free_entry(void *p, void *userdata) {
+    pa_xfree(p);
+}
+
+static void check(struct userdata *u) {
+    pa_hashmap *sinks, *sink_inputs;
+    pa_sink_input *i;
+    pa_sink *s;
+    uint32_t idx;
+    pa_usec_t now, elapsed;
+    pa_bool_t known;
+
+    now = pa_rtclock_now();
+    elapsed = now - u->last_time;
+    u->last_time = now;
+
+    sink_inputs = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+
+    PA_IDXSET_FOREACH(i, u->core->sink_inputs, idx) {
+        struct entry *e;
+
+        if (!PA_SINK_INPUT_IS_LINKED(i->state))
+            continue;
+
+        e = update_entry(u->sink_inputs, sink_inputs, i->index, (uint32_t) pa_atomic_load(&i->thread_info.stats.resample_usec), &known);
+
+        if (!known)
+            e->delta = 0;
+    }
+
+    pa_hashmap_free(u->sink_inputs, free_entry, NULL);
+    u->sink_inputs = sink_inputs;
+
+    sinks = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+
+    PA_IDXSET_FOREACH(s, u->core->sinks, idx) {
+        struct entry *e;
+        uint32_t load;
+
+        if (!PA_SINK_IS_LINKED(s->state))
+            continue;
+
+        e = update_entry(u->sinks, sinks, s->index, (uint32_t) pa_atomic_load(&s->thread_info.stats.busy_usec), &known);
+
+        if (!known || elapsed <= 0)
+            continue;
+
+        load = (uint32_t) ((pa_usec_t) e->delta * 100 / elapsed);
+
+        if (load >= u->high)
+            degrade_one(u, s);
+        else if (load <= u->low)
+            restore_one(u, s);
+    }
+
+    pa_hashmap_free(u->sinks, free_entry, NULL);
+    u->sinks = sinks;
+}
+
+static void time_cb(pa_mainloop_api *a, pa_time_event *e, const struct timeval *t, void *userdata) {
+    struct userdata *u = userdata;
+
+    pa_assert(u);
+    pa_assert(e == u->time_event);
+
+    check(u);
+
+    pa_core_rttime_restart(u->core, e, pa_rtclock_now() + u->interval);
+}
+
+int pa__init(pa_module*m) {
+    pa_modargs *ma = NULL;
+    struct userdata *u;
+    uint32_t high = DEFAULT_HIGH, low = DEFAULT_LOW, interval_msec = DEFAULT_INTERVAL_MSEC;
+
+    pa_assert(m);
+
+    if (!(ma = pa_modargs_new(m->argument, valid_modargs))) {
+        pa_log("Failed to parse module arguments");
+        goto fail;
+    }
+
+    if (pa_modargs_get_value_u32(ma, "high", &high) < 0 ||
+        pa_modargs_get_value_u32(ma, "low", &low) < 0 ||
+        high <= 0 || high > 100 || low >= high) {
+        pa_log("Invalid high or low load, they have to be percentages with low < high.");
+        goto fail;
+    }
+
+    if (pa_modargs_get_value_u32(ma, "interval_msec", &interval_msec) < 0 || interval_msec < 10) {
+        pa_log("Invalid interval, it has to be at least 10 ms.");
+        goto fail;
+    }
+
+    pa_modargs_free(ma);
+
+    m->userdata = u = pa_xnew0(struct userdata, 1);
+    u->core = m->core;
+    u->module = m;
+    u->high = high;
+    u->low = low;
+    u->interval = (pa_usec_t) interval_msec * PA_USEC_PER_MSEC;
+    u->sinks = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+    u->sink_inputs = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+
+    u->last_time = pa_rtclock_now();
+    check(u);
+    u->time_event = pa_core_rttime_new(u->core, u->last_time + u->interval, time_cb, u);
+
+    return 0;
+
+fail:
+    if (ma)
+        pa_modargs_free(ma);
+
+    return -1;
+}
+
+void pa__done(pa_module*m) {
+    struct userdata* u;
+    pa_sink_input *i;
+    uint32_t idx;
+
+    pa_assert(m);
+
+    if (!(u = m->userdata))
+        return;
+
+    if (u->time_event)
+        u->core->mainloop->time_free(u->time_event);
+
+    PA_IDXSET_FOREACH(i, u->core->sink_inputs, idx)
+        if (PA_SINK_INPUT_IS_LINKED(i->state) && i->resample_degradation > 0)
+            pa_sink_input_set_resample_degradation(i, 0);
+
+    if (u->sinks)
+        pa_hashmap_free(u->sinks, free_entry, NULL);
+
+    if (u->sink_inputs)
+        pa_hashmap_free(u->sink_inputs, free_entry, NULL);
+
+    pa_xfree(u);
+}
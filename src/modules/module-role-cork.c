@@ -203,6 +203,7 @@ static pa_hook_result_t sink_input_move_finish_cb(pa_core *core, pa_sink_input *
 }
 
 int pa__init(pa_module *m) {
+    static const pa_hook_filter role_filter = { NULL, PA_PROP_MEDIA_ROLE };
     pa_modargs *ma = NULL;
     struct userdata *u;
     const char *roles;
@@ -261,10 +262,12 @@ int pa__init(pa_module *m) {
     }
     u->global = global;
 
-    u->sink_input_put_slot = pa_hook_connect(&m->core->hooks[PA_CORE_HOOK_SINK_INPUT_PUT], PA_HOOK_LATE, (pa_hook_cb_t) sink_input_put_cb, u);
+    /* Streams without a role never cork others. They still have to be
+     * forgotten when they go away, since they may have been corked. */
+    u->sink_input_put_slot = pa_hook_connect_filtered(&m->core->hooks[PA_CORE_HOOK_SINK_INPUT_PUT], PA_HOOK_LATE, &role_filter, (pa_hook_cb_t) sink_input_put_cb, u);
     u->sink_input_unlink_slot = pa_hook_connect(&m->core->hooks[PA_CORE_HOOK_SINK_INPUT_UNLINK], PA_HOOK_LATE, (pa_hook_cb_t) sink_input_unlink_cb, u);
     u->sink_input_move_start_slot = pa_hook_connect(&m->core->hooks[PA_CORE_HOOK_SINK_INPUT_MOVE_START], PA_HOOK_LATE, (pa_hook_cb_t) sink_input_move_start_cb, u);
-    u->sink_input_move_finish_slot = pa_hook_connect(&m->core->hooks[PA_CORE_HOOK_SINK_INPUT_MOVE_FINISH], PA_HOOK_LATE, (pa_hook_cb_t) sink_input_move_finish_cb, u);
+    u->sink_input_move_finish_slot = pa_hook_connect_filtered(&m->core->hooks[PA_CORE_HOOK_SINK_INPUT_MOVE_FINISH], PA_HOOK_LATE, &role_filter, (pa_hook_cb_t) sink_input_move_finish_cb, u);
 
     pa_modargs_free(ma);
 
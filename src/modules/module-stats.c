@@ -0,0 +1,225 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/module.h>
+#include <pulsecore/client.h>
+#include <pulsecore/modargs.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/mem-account.h>
+#include <pulsecore/core-stats.h>
+#include <pulsecore/protocol-native.h>
+#include <pulsecore/pstream.h>
+#include <pulsecore/pstream-util.h>
+#include <pulsecore/tagstruct.h>
+
+#include "module-stats-symdef.h"
+
+PA_MODULE_AUTHOR("PulseAudio developers");
+PA_MODULE_DESCRIPTION("Export the IO thread statistics of devices and streams");
+PA_MODULE_VERSION(PACKAGE_VERSION);
+PA_MODULE_LOAD_ONCE(TRUE);
+
+static const char* const valid_modargs[] = {
+    NULL
+};
+
+struct userdata {
+    pa_native_protocol *protocol;
+};
+
+#define EXT_VERSION 2
+
+/* Protocol extension commands */
+enum {
+    SUBCOMMAND_TEST,
+    SUBCOMMAND_READ,
+    SUBCOMMAND_RESET,
+    SUBCOMMAND_READ_MEMORY
+};
+
+/* Matches pa_ext_stats_memory_object_t */
+enum {
+    MEMORY_TOTAL,
+    MEMORY_SAMPLE_CACHE,
+    MEMORY_CLIENT
+};
+
+/* pa_ext_stats_object_t has the same values as pa_core_stats_object_t */
+static void put_stats(const pa_core_stats_info *i, void *userdata) {
+    pa_tagstruct *reply = userdata;
+
+    pa_tagstruct_putu32(reply, (uint32_t) i->object);
+    pa_tagstruct_putu32(reply, i->index);
+    pa_tagstruct_puts(reply, i->name);
+    pa_tagstruct_putu32(reply, i->busy_usec);
+    pa_tagstruct_putu32(reply, i->resample_usec);
+    pa_tagstruct_putu32(reply, i->rewinds);
+    pa_tagstruct_putu32(reply, i->rewind_bytes);
+    pa_tagstruct_putu32(reply, i->underruns);
+    pa_tagstruct_putu32(reply, i->overruns);
+    pa_tagstruct_puts(reply, i->resample_method);
+    pa_tagstruct_put_usec(reply, i->buffer_usec);
+    pa_tagstruct_put_usec(reply, i->watermark_usec);
+    pa_tagstruct_putu32(reply, i->rerender_bytes);
+    pa_tagstruct_putu32(reply, i->history_bytes);
+    pa_tagstruct_putu32(reply, i->resample_degradation);
+    pa_tagstruct_putu32(reply, i->cpu_usec);
+}
+
+static void put_memory(pa_tagstruct *reply, uint32_t object, uint32_t idx, const char *name, pa_mem_account *a) {
+    pa_tagstruct_putu32(reply, object);
+    pa_tagstruct_putu32(reply, idx);
+    pa_tagstruct_puts(reply, name);
+    pa_tagstruct_putu64(reply, pa_mem_account_get_used(a));
+    pa_tagstruct_putu64(reply, pa_mem_account_get_peak(a));
+    pa_tagstruct_putu64(reply, pa_mem_account_get_budget(a));
+}
+
+static void put_memory_all(pa_core *core, pa_tagstruct *reply) {
+    pa_client *client;
+    uint32_t idx;
+
+    put_memory(reply, MEMORY_TOTAL, PA_INVALID_INDEX, NULL, core->mem_account);
+    put_memory(reply, MEMORY_SAMPLE_CACHE, PA_INVALID_INDEX, NULL, core->scache_mem_account);
+
+    PA_IDXSET_FOREACH(client, core->clients, idx)
+        put_memory(reply, MEMORY_CLIENT, client->index,
+                   pa_proplist_gets(client->proplist, PA_PROP_APPLICATION_NAME),
+                   client->mem_account);
+}
+
+static void reset_memory_peaks(pa_core *core) {
+    pa_client *client;
+    uint32_t idx;
+
+    pa_mem_account_reset_peak(core->mem_account);
+    pa_mem_account_reset_peak(core->scache_mem_account);
+
+    PA_IDXSET_FOREACH(client, core->clients, idx)
+        pa_mem_account_reset_peak(client->mem_account);
+}
+
+static int extension_cb(pa_native_protocol *p, pa_module *m, pa_native_connection *c, uint32_t tag, pa_tagstruct *t) {
+    uint32_t command;
+    pa_tagstruct *reply = NULL;
+
+    pa_assert(p);
+    pa_assert(m);
+    pa_assert(c);
+    pa_assert(t);
+
+    if (pa_tagstruct_getu32(t, &command) < 0)
+        goto fail;
+
+    reply = pa_tagstruct_new(NULL, 0);
+    pa_tagstruct_putu32(reply, PA_COMMAND_REPLY);
+    pa_tagstruct_putu32(reply, tag);
+
+    switch (command) {
+        case SUBCOMMAND_TEST: {
+            if (!pa_tagstruct_eof(t))
+                goto fail;
+
+            pa_tagstruct_putu32(reply, EXT_VERSION);
+            break;
+        }
+
+        case SUBCOMMAND_READ: {
+            if (!pa_tagstruct_eof(t))
+                goto fail;
+
+            pa_core_stats_foreach(m->core, put_stats, reply);
+            break;
+        }
+
+        case SUBCOMMAND_RESET: {
+            if (!pa_tagstruct_eof(t))
+                goto fail;
+
+            pa_core_stats_reset(m->core);
+            reset_memory_peaks(m->core);
+            break;
+        }
+
+        case SUBCOMMAND_READ_MEMORY: {
+            if (!pa_tagstruct_eof(t))
+                goto fail;
+
+            put_memory_all(m->core, reply);
+            break;
+        }
+
+        default:
+            goto fail;
+    }
+
+    pa_pstream_send_tagstruct(pa_native_connection_get_pstream(c), reply);
+    return 0;
+
+fail:
+
+    if (reply)
+        pa_tagstruct_free(reply);
+
+    return -1;
+}
+
+int pa__init(pa_module*m) {
+    pa_modargs *ma = NULL;
+    struct userdata *u;
+
+    pa_assert(m);
+
+    if (!(ma = pa_modargs_new(m->argument, valid_modargs))) {
+        pa_log("Failed to parse module arguments");
+        return -1;
+    }
+
+    pa_modargs_free(ma);
+
+    m->userdata = u = pa_xnew0(struct userdata, 1);
+
+    u->protocol = pa_native_protocol_get(m->core);
+    pa_native_protocol_install_ext(u->protocol, m, extension_cb);
+
+    return 0;
+}
+
+void pa__done(pa_module*m) {
+    struct userdata* u;
+
+    pa_assert(m);
+
+    if (!(u = m->userdata))
+        return;
+
+    if (u->protocol) {
+        pa_native_protocol_remove_ext(u->protocol, m);
+        pa_native_protocol_unref(u->protocol);
+    }
+
+    pa_xfree(u);
+}
@@ -49,7 +49,7 @@
 #include <pulsecore/protocol-native.h>
 #include <pulsecore/pstream.h>
 #include <pulsecore/pstream-util.h>
-#include <pulsecore/database.h>
+#include <pulsecore/restore-store.h>
 #include <pulsecore/tagstruct.h>
 #include <pulsecore/proplist-util.h>
 
@@ -72,7 +72,6 @@ PA_MODULE_USAGE(
         "on_rescue=<When device becomes unavailable, recheck streams?> "
         "fallback_table=<filename>");
 
-#define SAVE_INTERVAL (10 * PA_USEC_PER_SEC)
 #define IDENTIFICATION_PROPERTY "module-stream-restore.id"
 
 #define DEFAULT_FALLBACK_FILE PA_DEFAULT_CONFIG_DIR"/stream-restore.table"
@@ -104,8 +103,8 @@ struct userdata {
         *sink_unlink_hook_slot,
         *source_unlink_hook_slot,
         *connection_unlink_hook_slot;
-    pa_time_event *save_time_event;
-    pa_database* database;
+    pa_restore_db *database;
+    pa_hashmap *entry_cache; /* name -> struct cached_entry */
 
     pa_bool_t restore_device:1;
     pa_bool_t restore_volume:1;
@@ -135,21 +134,58 @@ struct entry {
     char* card;
 };
 
+/* Entries are written in this layout, followed by the device and the
+ * card names if they are set, each NUL terminated. Older versions
+ * wrote tagstructs, which always start with PA_TAG_U8. */
+#define PACKED_ENTRY_TAG 0xA5
+
+enum {
+    PACKED_VOLUME_VALID = 1 << 0,
+    PACKED_MUTED_VALID = 1 << 1,
+    PACKED_MUTED = 1 << 2,
+    PACKED_DEVICE_VALID = 1 << 3,
+    PACKED_CARD_VALID = 1 << 4,
+    PACKED_HAVE_DEVICE = 1 << 5,
+    PACKED_HAVE_CARD = 1 << 6
+};
+
+struct packed_entry {
+    uint8_t tag;
+    uint8_t version;
+    uint8_t flags;
+    uint8_t map_channels;
+    uint8_t volume_channels;
+    uint8_t map[PA_CHANNELS_MAX];
+    uint32_t volume[PA_CHANNELS_MAX];
+} PA_GCC_PACKED;
+
+/* What entry_read() returned before, kept until the entry is written or
+ * removed */
+struct cached_entry {
+    char *name;
+    struct entry *entry;
+};
+
 enum {
     SUBCOMMAND_TEST,
     SUBCOMMAND_READ,
     SUBCOMMAND_WRITE,
     SUBCOMMAND_DELETE,
     SUBCOMMAND_SUBSCRIBE,
-    SUBCOMMAND_EVENT
+    SUBCOMMAND_EVENT,
+    SUBCOMMAND_READ_PAGE
 };
 
+/* How many entries SUBCOMMAND_READ_PAGE sends at most in one reply */
+#define READ_PAGE_MAX 1024
+
 
 static struct entry* entry_new(void);
 static void entry_free(struct entry *e);
 static struct entry *entry_read(struct userdata *u, const char *name);
 static pa_bool_t entry_write(struct userdata *u, const char *name, const struct entry *e, pa_bool_t replace);
 static struct entry* entry_copy(const struct entry *e);
+static int entry_remove(struct userdata *u, const char *name);
 static void entry_apply(struct userdata *u, const char *name, struct entry *e);
 static void trigger_save(struct userdata *u);
 
@@ -935,16 +971,12 @@ static void handle_entry_get_all(DBusConnection *conn, DBusMessage *msg, void *u
 
 static void handle_entry_remove(DBusConnection *conn, DBusMessage *msg, void *userdata) {
     struct dbus_entry *de = userdata;
-    pa_datum key;
 
     pa_assert(conn);
     pa_assert(msg);
     pa_assert(de);
 
-    key.data = de->entry_name;
-    key.size = strlen(de->entry_name);
-
-    pa_assert_se(pa_database_unset(de->userdata->database, &key) == 0);
+    pa_assert_se(entry_remove(de->userdata, de->entry_name) == 0);
 
     send_entry_removed_signal(de);
     trigger_save(de->userdata);
@@ -957,21 +989,6 @@ static void handle_entry_remove(DBusConnection *conn, DBusMessage *msg, void *us
 
 #endif /* HAVE_DBUS */
 
-static void save_time_callback(pa_mainloop_api*a, pa_time_event* e, const struct timeval *t, void *userdata) {
-    struct userdata *u = userdata;
-
-    pa_assert(a);
-    pa_assert(e);
-    pa_assert(u);
-
-    pa_assert(e == u->save_time_event);
-    u->core->mainloop->time_free(u->save_time_event);
-    u->save_time_event = NULL;
-
-    pa_database_sync(u->database);
-    pa_log_info("Synced.");
-}
-
 static struct entry* entry_new(void) {
     struct entry *r = pa_xnew0(struct entry, 1);
     r->version = ENTRY_VERSION;
@@ -986,8 +1003,84 @@ static void entry_free(struct entry* e) {
     pa_xfree(e);
 }
 
+static void cached_entry_free(struct cached_entry *c) {
+    entry_free(c->entry);
+    pa_xfree(c->name);
+    pa_xfree(c);
+}
+
+static void entry_cache_put(struct userdata *u, const char *name, const struct entry *e) {
+    struct cached_entry *c;
+
+    if ((c = pa_hashmap_get(u->entry_cache, name))) {
+        entry_free(c->entry);
+        c->entry = entry_copy(e);
+        return;
+    }
+
+    c = pa_xnew(struct cached_entry, 1);
+    c->name = pa_xstrdup(name);
+    c->entry = entry_copy(e);
+    pa_assert_se(pa_hashmap_put(u->entry_cache, c->name, c) >= 0);
+}
+
+static void entry_cache_forget(struct userdata *u, const char *name) {
+    struct cached_entry *c;
+
+    if ((c = pa_hashmap_remove(u->entry_cache, name)))
+        cached_entry_free(c);
+}
+
+static void entry_cache_clear(struct userdata *u) {
+    struct cached_entry *c;
+
+    while ((c = pa_hashmap_steal_first(u->entry_cache)))
+        cached_entry_free(c);
+}
+
+static void entry_pack(const struct entry *e, pa_datum *data) {
+    struct packed_entry *pe;
+    size_t device_len, card_len;
+    unsigned i;
+    uint8_t *p;
+
+    device_len = e->device ? strlen(e->device) + 1 : 0;
+    card_len = e->card ? strlen(e->card) + 1 : 0;
+
+    data->size = sizeof(struct packed_entry) + device_len + card_len;
+    data->data = pa_xmalloc0(data->size);
+
+    pe = data->data;
+    pe->tag = PACKED_ENTRY_TAG;
+    pe->version = e->version;
+    pe->flags =
+        (e->volume_valid ? PACKED_VOLUME_VALID : 0) |
+        (e->muted_valid ? PACKED_MUTED_VALID : 0) |
+        (e->muted ? PACKED_MUTED : 0) |
+        (e->device_valid ? PACKED_DEVICE_VALID : 0) |
+        (e->card_valid ? PACKED_CARD_VALID : 0) |
+        (e->device ? PACKED_HAVE_DEVICE : 0) |
+        (e->card ? PACKED_HAVE_CARD : 0);
+
+    pe->map_channels = PA_MIN(e->channel_map.channels, PA_CHANNELS_MAX);
+    for (i = 0; i < pe->map_channels; i++)
+        pe->map[i] = (uint8_t) e->channel_map.map[i];
+
+    pe->volume_channels = PA_MIN(e->volume.channels, PA_CHANNELS_MAX);
+    for (i = 0; i < pe->volume_channels; i++)
+        pe->volume[i] = e->volume.values[i];
+
+    p = (uint8_t*) data->data + sizeof(struct packed_entry);
+    if (e->device) {
+        memcpy(p, e->device, device_len);
+        p += device_len;
+    }
+
+    if (e->card)
+        memcpy(p, e->card, card_len);
+}
+
 static pa_bool_t entry_write(struct userdata *u, const char *name, const struct entry *e, pa_bool_t replace) {
-    pa_tagstruct *t;
     pa_datum key, data;
     pa_bool_t r;
 
@@ -995,30 +1088,33 @@ static pa_bool_t entry_write(struct userdata *u, const char *name, const struct
     pa_assert(name);
     pa_assert(e);
 
-    t = pa_tagstruct_new(NULL, 0);
-    pa_tagstruct_putu8(t, e->version);
-    pa_tagstruct_put_boolean(t, e->volume_valid);
-    pa_tagstruct_put_channel_map(t, &e->channel_map);
-    pa_tagstruct_put_cvolume(t, &e->volume);
-    pa_tagstruct_put_boolean(t, e->muted_valid);
-    pa_tagstruct_put_boolean(t, e->muted);
-    pa_tagstruct_put_boolean(t, e->device_valid);
-    pa_tagstruct_puts(t, e->device);
-    pa_tagstruct_put_boolean(t, e->card_valid);
-    pa_tagstruct_puts(t, e->card);
-
     key.data = (char *) name;
     key.size = strlen(name);
 
-    data.data = (void*)pa_tagstruct_data(t, &data.size);
+    entry_pack(e, &data);
 
-    r = (pa_database_set(u->database, &key, &data, replace) == 0);
+    if ((r = (pa_restore_db_set(u->database, &key, &data, replace) == 0)))
+        entry_cache_put(u, name, e);
 
-    pa_tagstruct_free(t);
+    pa_datum_free(&data);
 
     return r;
 }
 
+static int entry_remove(struct userdata *u, const char *name) {
+    pa_datum key;
+
+    pa_assert(u);
+    pa_assert(name);
+
+    key.data = (char *) name;
+    key.size = strlen(name);
+
+    entry_cache_forget(u, name);
+
+    return pa_restore_db_unset(u->database, &key);
+}
+
 #ifdef ENABLE_LEGACY_DATABASE_ENTRY_FORMAT
 
 #define LEGACY_ENTRY_VERSION 3
@@ -1046,7 +1142,7 @@ static struct entry *legacy_entry_read(struct userdata *u, const char *name) {
 
     pa_zero(data);
 
-    if (!pa_database_get(u->database, &key, &data))
+    if (!pa_restore_db_get(u->database, &key, &data))
         goto fail;
 
     if (data.size != sizeof(struct legacy_entry)) {
@@ -1110,25 +1206,69 @@ fail:
 }
 #endif
 
-static struct entry *entry_read(struct userdata *u, const char *name) {
-    pa_datum key, data;
-    struct entry *e = NULL;
-    pa_tagstruct *t = NULL;
-    const char *device, *card;
+static pa_bool_t entry_unpack(struct entry *e, const pa_datum *data) {
+    struct packed_entry pe;
+    const char *p, *end;
+    unsigned i;
 
-    pa_assert(u);
-    pa_assert(name);
+    if (data->size < sizeof(pe))
+        return FALSE;
 
-    key.data = (char*) name;
-    key.size = strlen(name);
+    memcpy(&pe, data->data, sizeof(pe));
 
-    pa_zero(data);
+    if (pe.tag != PACKED_ENTRY_TAG ||
+        pe.version > ENTRY_VERSION ||
+        pe.map_channels > PA_CHANNELS_MAX ||
+        pe.volume_channels > PA_CHANNELS_MAX)
+        return FALSE;
 
-    if (!pa_database_get(u->database, &key, &data))
-        goto fail;
+    e->version = pe.version;
+    e->volume_valid = !!(pe.flags & PACKED_VOLUME_VALID);
+    e->muted_valid = !!(pe.flags & PACKED_MUTED_VALID);
+    e->muted = !!(pe.flags & PACKED_MUTED);
+    e->device_valid = !!(pe.flags & PACKED_DEVICE_VALID);
+    e->card_valid = !!(pe.flags & PACKED_CARD_VALID);
 
-    t = pa_tagstruct_new(data.data, data.size);
-    e = entry_new();
+    e->channel_map.channels = pe.map_channels;
+    for (i = 0; i < pe.map_channels; i++)
+        e->channel_map.map[i] = (pa_channel_position_t) pe.map[i];
+
+    e->volume.channels = pe.volume_channels;
+    for (i = 0; i < pe.volume_channels; i++)
+        e->volume.values[i] = pe.volume[i];
+
+    p = (const char*) data->data + sizeof(pe);
+    end = (const char*) data->data + data->size;
+
+    if (pe.flags & PACKED_HAVE_DEVICE) {
+        const char *nul;
+
+        if (!(nul = memchr(p, 0, (size_t) (end - p))))
+            return FALSE;
+
+        e->device = pa_xstrdup(p);
+        p = nul + 1;
+    }
+
+    if (pe.flags & PACKED_HAVE_CARD) {
+        const char *nul;
+
+        if (!(nul = memchr(p, 0, (size_t) (end - p))))
+            return FALSE;
+
+        e->card = pa_xstrdup(p);
+        p = nul + 1;
+    }
+
+    return p == end;
+}
+
+static pa_bool_t entry_untag(struct entry *e, const pa_datum *data) {
+    pa_tagstruct *t;
+    const char *device, *card;
+    pa_bool_t r = FALSE;
+
+    t = pa_tagstruct_new(data->data, data->size);
 
     if (pa_tagstruct_getu8(t, &e->version) < 0 ||
         e->version > ENTRY_VERSION ||
@@ -1142,13 +1282,47 @@ static struct entry *entry_read(struct userdata *u, const char *name) {
         pa_tagstruct_get_boolean(t, &e->card_valid) < 0 ||
         pa_tagstruct_gets(t, &card) < 0) {
 
-        goto fail;
+        goto finish;
     }
 
     e->device = pa_xstrdup(device);
     e->card = pa_xstrdup(card);
 
-    if (!pa_tagstruct_eof(t))
+    r = pa_tagstruct_eof(t);
+
+finish:
+    pa_tagstruct_free(t);
+    return r;
+}
+
+static struct entry *entry_read(struct userdata *u, const char *name) {
+    pa_datum key, data;
+    struct entry *e = NULL;
+    struct cached_entry *c;
+    pa_bool_t ok;
+
+    pa_assert(u);
+    pa_assert(name);
+
+    if ((c = pa_hashmap_get(u->entry_cache, name)))
+        return entry_copy(c->entry);
+
+    key.data = (char*) name;
+    key.size = strlen(name);
+
+    pa_zero(data);
+
+    if (!pa_restore_db_get(u->database, &key, &data))
+        goto fail;
+
+    e = entry_new();
+
+    if (data.size > 0 && ((const uint8_t*) data.data)[0] == PACKED_ENTRY_TAG)
+        ok = entry_unpack(e, &data);
+    else
+        ok = entry_untag(e, &data);
+
+    if (!ok)
         goto fail;
 
     if (e->device_valid && !pa_namereg_is_valid_name(e->device)) {
@@ -1171,16 +1345,15 @@ static struct entry *entry_read(struct userdata *u, const char *name) {
         goto fail;
     }
 
-    pa_tagstruct_free(t);
     pa_datum_free(&data);
 
+    entry_cache_put(u, name, e);
+
     return e;
 
 fail:
     if (e)
         entry_free(e);
-    if (t)
-        pa_tagstruct_free(t);
 
     pa_datum_free(&data);
     return NULL;
@@ -1214,10 +1387,7 @@ static void trigger_save(struct userdata *u) {
         pa_pstream_send_tagstruct(pa_native_connection_get_pstream(c), t);
     }
 
-    if (u->save_time_event)
-        return;
-
-    u->save_time_event = pa_core_rttime_new(u->core, pa_rtclock_now() + SAVE_INTERVAL, save_time_callback, u);
+    pa_restore_db_save(u->database);
 }
 
 static pa_bool_t entries_equal(const struct entry *a, const struct entry *b) {
@@ -1832,7 +2002,6 @@ static int fill_db(struct userdata *u, const char *filename) {
         *d = 0;
         if (pa_atod(v, &db) >= 0) {
             if (db <= 0.0) {
-                pa_datum key, data;
                 struct entry e;
 
                 pa_zero(e);
@@ -1841,13 +2010,7 @@ static int fill_db(struct userdata *u, const char *filename) {
                 pa_cvolume_set(&e.volume, 1, pa_sw_volume_from_dB(db));
                 pa_channel_map_init_mono(&e.channel_map);
 
-                key.data = (void *) ln;
-                key.size = strlen(ln);
-
-                data.data = (void *) &e;
-                data.size = sizeof(e);
-
-                if (pa_database_set(u->database, &key, &data, FALSE) == 0)
+                if (entry_write(u, ln, &e, FALSE))
                     pa_log_debug("Setting %s to %0.2f dB.", ln, db);
             } else
                 pa_log_warn("[%s:%u] Positive dB values are not allowed, not setting entry %s.", fn, n, ln);
@@ -1978,14 +2141,14 @@ PA_GCC_UNUSED static void stream_restore_dump_database(struct userdata *u) {
     pa_datum key;
     pa_bool_t done;
 
-    done = !pa_database_first(u->database, &key, NULL);
+    done = !pa_restore_db_first(u->database, &key, NULL);
 
     while (!done) {
         pa_datum next_key;
         struct entry *e;
         char *name;
 
-        done = !pa_database_next(u->database, &key, &next_key, NULL);
+        done = !pa_restore_db_next(u->database, &key, &next_key, NULL);
 
         name = pa_xstrndup(key.data, key.size);
         pa_datum_free(&key);
@@ -2007,7 +2170,96 @@ PA_GCC_UNUSED static void stream_restore_dump_database(struct userdata *u) {
 }
 #endif
 
-#define EXT_VERSION 1
+#define EXT_VERSION 2
+
+static void put_entry(pa_tagstruct *reply, const char *name, struct entry *e) {
+    pa_cvolume r;
+    pa_channel_map cm;
+
+    pa_tagstruct_puts(reply, name);
+    pa_tagstruct_put_channel_map(reply, e->volume_valid ? &e->channel_map : pa_channel_map_init(&cm));
+    pa_tagstruct_put_cvolume(reply, e->volume_valid ? &e->volume : pa_cvolume_init(&r));
+    pa_tagstruct_puts(reply, e->device_valid ? e->device : NULL);
+    pa_tagstruct_put_boolean(reply, e->muted_valid ? e->muted : FALSE);
+}
+
+/* Sends the next up to max entries after the one called cursor, or
+ * from the beginning if that is NULL, that start with prefix. The
+ * reply starts with the name of the last entry sent if there are more
+ * to come, NULL otherwise. Fails with -PA_ERR_NOENTITY if the entry the
+ * cursor names has been removed. */
+static int read_page(struct userdata *u, pa_tagstruct *reply, const char *prefix, const char *cursor, uint32_t max) {
+    pa_datum key;
+    pa_bool_t done;
+    size_t prefix_length;
+    char **names;
+    uint32_t n = 0, i;
+    pa_bool_t more = FALSE;
+
+    if (cursor) {
+        pa_datum c;
+
+        c.data = (char*) cursor;
+        c.size = strlen(cursor);
+
+        if (!pa_restore_db_next(u->database, &c, &key, NULL)) {
+            pa_datum data;
+
+            if (!pa_restore_db_get(u->database, &c, &data))
+                return -PA_ERR_NOENTITY;
+
+            pa_datum_free(&data);
+            done = TRUE;
+        } else
+            done = FALSE;
+    } else
+        done = !pa_restore_db_first(u->database, &key, NULL);
+
+    prefix_length = prefix ? strlen(prefix) : 0;
+    names = pa_xnew(char*, max);
+
+    /* The keys alone are cheap to look at. Collect the names first, so
+     * that we know whether there are more when writing the cursor. */
+    while (!done) {
+        pa_datum next_key;
+
+        done = !pa_restore_db_next(u->database, &key, &next_key, NULL);
+
+        if (key.size >= prefix_length && (prefix_length == 0 || memcmp(key.data, prefix, prefix_length) == 0)) {
+            if (n >= max) {
+                more = TRUE;
+                pa_datum_free(&key);
+
+                if (!done)
+                    pa_datum_free(&next_key);
+
+                break;
+            }
+
+            names[n++] = pa_xstrndup(key.data, key.size);
+        }
+
+        pa_datum_free(&key);
+        key = next_key;
+    }
+
+    pa_tagstruct_puts(reply, more ? names[n-1] : NULL);
+
+    for (i = 0; i < n; i++) {
+        struct entry *e;
+
+        if ((e = entry_read(u, names[i]))) {
+            put_entry(reply, names[i], e);
+            entry_free(e);
+        }
+
+        pa_xfree(names[i]);
+    }
+
+    pa_xfree(names);
+
+    return 0;
+}
 
 static int extension_cb(pa_native_protocol *p, pa_module *m, pa_native_connection *c, uint32_t tag, pa_tagstruct *t) {
     struct userdata *u;
@@ -2044,28 +2296,20 @@ static int extension_cb(pa_native_protocol *p, pa_module *m, pa_native_connectio
             if (!pa_tagstruct_eof(t))
                 goto fail;
 
-            done = !pa_database_first(u->database, &key, NULL);
+            done = !pa_restore_db_first(u->database, &key, NULL);
 
             while (!done) {
                 pa_datum next_key;
                 struct entry *e;
                 char *name;
 
-                done = !pa_database_next(u->database, &key, &next_key, NULL);
+                done = !pa_restore_db_next(u->database, &key, &next_key, NULL);
 
                 name = pa_xstrndup(key.data, key.size);
                 pa_datum_free(&key);
 
                 if ((e = entry_read(u, name))) {
-                    pa_cvolume r;
-                    pa_channel_map cm;
-
-                    pa_tagstruct_puts(reply, name);
-                    pa_tagstruct_put_channel_map(reply, e->volume_valid ? &e->channel_map : pa_channel_map_init(&cm));
-                    pa_tagstruct_put_cvolume(reply, e->volume_valid ? &e->volume : pa_cvolume_init(&r));
-                    pa_tagstruct_puts(reply, e->device_valid ? e->device : NULL);
-                    pa_tagstruct_put_boolean(reply, e->muted_valid ? e->muted : FALSE);
-
+                    put_entry(reply, name, e);
                     entry_free(e);
                 }
 
@@ -2077,6 +2321,31 @@ static int extension_cb(pa_native_protocol *p, pa_module *m, pa_native_connectio
             break;
         }
 
+        case SUBCOMMAND_READ_PAGE: {
+            const char *prefix, *cursor;
+            uint32_t max;
+            int r;
+
+            if (pa_tagstruct_gets(t, &prefix) < 0 ||
+                pa_tagstruct_gets(t, &cursor) < 0 ||
+                pa_tagstruct_getu32(t, &max) < 0 ||
+                !pa_tagstruct_eof(t))
+                goto fail;
+
+            if (max <= 0 || max > READ_PAGE_MAX)
+                max = READ_PAGE_MAX;
+
+            if ((r = read_page(u, reply, prefix, cursor, max)) < 0) {
+                /* Not a protocol violation, the entry may just have
+                 * gone away since the last page */
+                pa_tagstruct_free(reply);
+                pa_pstream_send_error(pa_native_connection_get_pstream(c), tag, (uint32_t) -r);
+                return 0;
+            }
+
+            break;
+        }
+
         case SUBCOMMAND_WRITE: {
             uint32_t mode;
             pa_bool_t apply_immediately = FALSE;
@@ -2100,7 +2369,8 @@ static int extension_cb(pa_native_protocol *p, pa_module *m, pa_native_connectio
                     dbus_entry_free(pa_hashmap_remove(u->dbus_entries, de->entry_name));
                 }
 #endif
-                pa_database_clear(u->database);
+                pa_restore_db_clear(u->database);
+                entry_cache_clear(u);
             }
 
             while (!pa_tagstruct_eof(t)) {
@@ -2198,7 +2468,6 @@ static int extension_cb(pa_native_protocol *p, pa_module *m, pa_native_connectio
 
             while (!pa_tagstruct_eof(t)) {
                 const char *name;
-                pa_datum key;
 #ifdef HAVE_DBUS
                 struct dbus_entry *de;
 #endif
@@ -2213,10 +2482,7 @@ static int extension_cb(pa_native_protocol *p, pa_module *m, pa_native_connectio
                 }
 #endif
 
-                key.data = (char*) name;
-                key.size = strlen(name);
-
-                pa_database_unset(u->database, &key);
+                entry_remove(u, name);
             }
 
             trigger_save(u);
@@ -2291,7 +2557,7 @@ static void clean_up_db(struct userdata *u) {
     PA_LLIST_HEAD_INIT(struct clean_up_item, to_be_converted);
 #endif
 
-    done = !pa_database_first(u->database, &key, NULL);
+    done = !pa_restore_db_first(u->database, &key, NULL);
     while (!done) {
         pa_datum next_key;
         char *entry_name = NULL;
@@ -2324,18 +2590,15 @@ static void clean_up_db(struct userdata *u) {
             entry_free(e);
         }
 
-        done = !pa_database_next(u->database, &key, &next_key, NULL);
+        done = !pa_restore_db_next(u->database, &key, &next_key, NULL);
         pa_datum_free(&key);
         key = next_key;
     }
 
     PA_LLIST_FOREACH_SAFE(item, next, to_be_removed) {
-        key.data = item->entry_name;
-        key.size = strlen(item->entry_name);
-
         pa_log_debug("Removing an invalid entry: %s", item->entry_name);
 
-        pa_assert_se(pa_database_unset(u->database, &key) >= 0);
+        pa_assert_se(entry_remove(u, item->entry_name) >= 0);
         trigger_save(u);
 
         PA_LLIST_REMOVE(struct clean_up_item, to_be_removed, item);
@@ -2361,7 +2624,6 @@ static void clean_up_db(struct userdata *u) {
 int pa__init(pa_module*m) {
     pa_modargs *ma = NULL;
     struct userdata *u;
-    char *fname;
     pa_sink_input *si;
     pa_source_output *so;
     uint32_t idx;
@@ -2430,17 +2692,10 @@ int pa__init(pa_module*m) {
         u->source_output_fixate_hook_slot = pa_hook_connect(&m->core->hooks[PA_CORE_HOOK_SOURCE_OUTPUT_FIXATE], PA_HOOK_EARLY, (pa_hook_cb_t) source_output_fixate_hook_callback, u);
     }
 
-    if (!(fname = pa_state_path("stream-volumes", TRUE)))
+    if (!(u->database = pa_restore_db_open(m->core, "stream-volumes")))
         goto fail;
 
-    if (!(u->database = pa_database_open(fname, TRUE))) {
-        pa_log("Failed to open volume database '%s': %s", fname, pa_cstrerror(errno));
-        pa_xfree(fname);
-        goto fail;
-    }
-
-    pa_log_info("Successfully opened database file '%s'.", fname);
-    pa_xfree(fname);
+    u->entry_cache = pa_hashmap_new(pa_idxset_string_hash_func, pa_idxset_string_compare_func);
 
     clean_up_db(u);
 
@@ -2455,7 +2710,7 @@ int pa__init(pa_module*m) {
     pa_assert_se(pa_dbus_protocol_register_extension(u->dbus_protocol, INTERFACE_STREAM_RESTORE) >= 0);
 
     /* Create the initial dbus entries. */
-    done = !pa_database_first(u->database, &key, NULL);
+    done = !pa_restore_db_first(u->database, &key, NULL);
     while (!done) {
         pa_datum next_key;
         char *name;
@@ -2466,7 +2721,7 @@ int pa__init(pa_module*m) {
         pa_assert_se(pa_hashmap_put(u->dbus_entries, de->entry_name, de) == 0);
         pa_xfree(name);
 
-        done = !pa_database_next(u->database, &key, &next_key, NULL);
+        done = !pa_restore_db_next(u->database, &key, &next_key, NULL);
         pa_datum_free(&key);
         key = next_key;
     }
@@ -2546,11 +2801,13 @@ void pa__done(pa_module*m) {
     if (u->connection_unlink_hook_slot)
         pa_hook_slot_free(u->connection_unlink_hook_slot);
 
-    if (u->save_time_event)
-        u->core->mainloop->time_free(u->save_time_event);
-
     if (u->database)
-        pa_database_close(u->database);
+        pa_restore_db_close(u->database);
+
+    if (u->entry_cache) {
+        entry_cache_clear(u);
+        pa_hashmap_free(u->entry_cache, NULL, NULL);
+    }
 
     if (u->protocol) {
         pa_native_protocol_remove_ext(u->protocol, m);
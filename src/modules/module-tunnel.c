@@ -45,16 +45,18 @@
 #include <pulsecore/pdispatch.h>
 #include <pulsecore/pstream.h>
 #include <pulsecore/pstream-util.h>
-#include <pulsecore/socket-client.h>
 #include <pulsecore/time-smoother.h>
 #include <pulsecore/thread.h>
 #include <pulsecore/thread-mq.h>
 #include <pulsecore/core-rtclock.h>
-#include <pulsecore/core-error.h>
-#include <pulsecore/proplist-util.h>
-#include <pulsecore/auth-cookie.h>
 #include <pulsecore/mcalign.h>
 
+#ifdef HAVE_OPUS
+#include <pulsecore/opus-util.h>
+#endif
+
+#include "tunnel-connection.h"
+
 #ifdef TUNNEL_SINK
 #include "module-tunnel-sink-symdef.h"
 #else
@@ -72,7 +74,13 @@ PA_MODULE_USAGE(
         "format=<sample format> "
         "channels=<number of channels> "
         "rate=<sample rate> "
-        "channel_map=<channel map>");
+        "channel_map=<channel map> "
+        "compression=<none or opus> "
+        "bitrate=<bits per second for compressed streams> "
+        "on_demand=<connect only while the sink is used?> "
+        "idle_time=<seconds to stay connected after use> "
+        "realtime_priority=<priority of the IO thread, 0 for no realtime scheduling> "
+        "cpu_affinity=<CPUs to run the IO thread on, e.g. 0-1,4>");
 #else
 PA_MODULE_DESCRIPTION("Tunnel module for sources");
 PA_MODULE_USAGE(
@@ -84,7 +92,11 @@ PA_MODULE_USAGE(
         "format=<sample format> "
         "channels=<number of channels> "
         "rate=<sample rate> "
-        "channel_map=<channel map>");
+        "channel_map=<channel map> "
+        "on_demand=<connect only while the source is used?> "
+        "idle_time=<seconds to stay connected after use> "
+        "realtime_priority=<priority of the IO thread, 0 for no realtime scheduling> "
+        "cpu_affinity=<CPUs to run the IO thread on, e.g. 0-1,4>");
 #endif
 
 PA_MODULE_AUTHOR("Lennart Poettering");
@@ -101,18 +113,28 @@ static const char* const valid_modargs[] = {
     "sink_name",
     "sink_properties",
     "sink",
+    "compression",
+    "bitrate",
 #else
     "source_name",
     "source_properties",
     "source",
 #endif
     "channel_map",
+    "on_demand",
+    "idle_time",
+    "realtime_priority",
+    "cpu_affinity",
     NULL,
 };
 
 #define DEFAULT_TIMEOUT 5
 
-#define LATENCY_INTERVAL (10*PA_USEC_PER_SEC)
+#define DEFAULT_IDLE_TIME 30
+
+/* How long to wait before an on demand tunnel that is in use tries
+ * again after losing its connection */
+#define RECONNECT_USEC (5*PA_USEC_PER_SEC)
 
 #define MIN_NETWORK_LATENCY_USEC (8*PA_USEC_PER_MSEC)
 
@@ -122,7 +144,8 @@ enum {
     SINK_MESSAGE_REQUEST = PA_SINK_MESSAGE_MAX,
     SINK_MESSAGE_REMOTE_SUSPEND,
     SINK_MESSAGE_UPDATE_LATENCY,
-    SINK_MESSAGE_POST
+    SINK_MESSAGE_POST,
+    SINK_MESSAGE_DISCONNECTED
 };
 
 #define DEFAULT_TLENGTH_MSEC 150
@@ -133,7 +156,8 @@ enum {
 enum {
     SOURCE_MESSAGE_POST = PA_SOURCE_MESSAGE_MAX,
     SOURCE_MESSAGE_REMOTE_SUSPEND,
-    SOURCE_MESSAGE_UPDATE_LATENCY
+    SOURCE_MESSAGE_UPDATE_LATENCY,
+    SOURCE_MESSAGE_DISCONNECTED
 };
 
 #define DEFAULT_FRAGSIZE_MSEC 25
@@ -141,23 +165,20 @@ enum {
 #endif
 
 #ifdef TUNNEL_SINK
-static void command_request(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_started(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 #endif
-static void command_subscribe_event(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_stream_killed(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_overflow_or_underflow(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_suspended(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_moved(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
-static void command_stream_or_client_event(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
+static void command_stream_event(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_stream_buffer_attr_changed(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 
+/* The stream commands the connection passes on to us */
 static const pa_pdispatch_cb_t command_table[PA_COMMAND_MAX] = {
 #ifdef TUNNEL_SINK
-    [PA_COMMAND_REQUEST] = command_request,
     [PA_COMMAND_STARTED] = command_started,
 #endif
-    [PA_COMMAND_SUBSCRIBE_EVENT] = command_subscribe_event,
     [PA_COMMAND_OVERFLOW] = command_overflow_or_underflow,
     [PA_COMMAND_UNDERFLOW] = command_overflow_or_underflow,
     [PA_COMMAND_PLAYBACK_STREAM_KILLED] = command_stream_killed,
@@ -166,9 +187,8 @@ static const pa_pdispatch_cb_t command_table[PA_COMMAND_MAX] = {
     [PA_COMMAND_RECORD_STREAM_SUSPENDED] = command_suspended,
     [PA_COMMAND_PLAYBACK_STREAM_MOVED] = command_moved,
     [PA_COMMAND_RECORD_STREAM_MOVED] = command_moved,
-    [PA_COMMAND_PLAYBACK_STREAM_EVENT] = command_stream_or_client_event,
-    [PA_COMMAND_RECORD_STREAM_EVENT] = command_stream_or_client_event,
-    [PA_COMMAND_CLIENT_EVENT] = command_stream_or_client_event,
+    [PA_COMMAND_PLAYBACK_STREAM_EVENT] = command_stream_event,
+    [PA_COMMAND_RECORD_STREAM_EVENT] = command_stream_event,
     [PA_COMMAND_PLAYBACK_BUFFER_ATTR_CHANGED] = command_stream_buffer_attr_changed,
     [PA_COMMAND_RECORD_BUFFER_ATTR_CHANGED] = command_stream_buffer_attr_changed
 };
@@ -181,25 +201,33 @@ struct userdata {
     pa_rtpoll *rtpoll;
     pa_thread *thread;
 
-    pa_socket_client *client;
-    pa_pstream *pstream;
-    pa_pdispatch *pdispatch;
+    int32_t rtprio;
+    char *cpu_affinity;
+
+    /* NULL while an on demand tunnel is not connected */
+    pa_tunnel_link *link;
+
+    pa_bool_t on_demand;
+    pa_usec_t idle_usec;
+    pa_time_event *idle_event;
 
     char *server_name;
+    char *cookie;
 #ifdef TUNNEL_SINK
     char *sink_name;
     pa_sink *sink;
     size_t requested_bytes;
+#ifdef HAVE_OPUS
+    /* Only kept if the server agreed to decode Opus */
+    pa_opus_encoder *encoder;
+#endif
 #else
     char *source_name;
     pa_source *source;
     pa_mcalign *mcalign;
 #endif
 
-    pa_auth_cookie *auth_cookie;
-
     uint32_t version;
-    uint32_t ctag;
     uint32_t device_index;
     uint32_t channel;
 
@@ -207,14 +235,13 @@ struct userdata {
 
     pa_bool_t remote_corked:1;
     pa_bool_t remote_suspended:1;
+    pa_bool_t latency_requested:1;
 
     pa_usec_t transport_usec; /* maintained in the main thread */
     pa_usec_t thread_transport_usec; /* maintained in the IO thread */
 
     uint32_t ignore_latency_before;
 
-    pa_time_event *time_event;
-
     pa_smoother *smoother;
 
     char *device_description;
@@ -232,10 +259,11 @@ struct userdata {
 };
 
 static void request_latency(struct userdata *u);
+static void tunnel_use(struct userdata *u, pa_bool_t used);
 
 /* Called from main context */
-static void command_stream_or_client_event(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
-    pa_log_debug("Got stream or client event.");
+static void command_stream_event(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_log_debug("Got stream event.");
 }
 
 /* Called from main context */
@@ -245,7 +273,6 @@ static void command_stream_killed(pa_pdispatch *pd,  uint32_t command,  uint32_t
     pa_assert(pd);
     pa_assert(t);
     pa_assert(u);
-    pa_assert(u->pdispatch == pd);
 
     pa_log_warn("Stream killed");
     pa_module_unload_request(u->module, TRUE);
@@ -258,7 +285,6 @@ static void command_overflow_or_underflow(pa_pdispatch *pd,  uint32_t command,
     pa_assert(pd);
     pa_assert(t);
     pa_assert(u);
-    pa_assert(u->pdispatch == pd);
 
     pa_log_info("Server signalled buffer overrun/underrun.");
     request_latency(u);
@@ -267,16 +293,13 @@ static void command_overflow_or_underflow(pa_pdispatch *pd,  uint32_t command,
 /* Called from main context */
 static void command_suspended(pa_pdispatch *pd,  uint32_t command,  uint32_t tag, pa_tagstruct *t, void *userdata) {
     struct userdata *u = userdata;
-    uint32_t channel;
     pa_bool_t suspended;
 
     pa_assert(pd);
     pa_assert(t);
     pa_assert(u);
-    pa_assert(u->pdispatch == pd);
 
-    if (pa_tagstruct_getu32(t, &channel) < 0 ||
-        pa_tagstruct_get_boolean(t, &suspended) < 0 ||
+    if (pa_tagstruct_get_boolean(t, &suspended) < 0 ||
         !pa_tagstruct_eof(t)) {
 
         pa_log("Invalid packet.");
@@ -298,17 +321,15 @@ static void command_suspended(pa_pdispatch *pd,  uint32_t command,  uint32_t tag
 /* Called from main context */
 static void command_moved(pa_pdispatch *pd,  uint32_t command,  uint32_t tag, pa_tagstruct *t, void *userdata) {
     struct userdata *u = userdata;
-    uint32_t channel, di;
+    uint32_t di;
     const char *dn;
     pa_bool_t suspended;
 
     pa_assert(pd);
     pa_assert(t);
     pa_assert(u);
-    pa_assert(u->pdispatch == pd);
 
-    if (pa_tagstruct_getu32(t, &channel) < 0 ||
-        pa_tagstruct_getu32(t, &di) < 0 ||
+    if (pa_tagstruct_getu32(t, &di) < 0 ||
         pa_tagstruct_gets(t, &dn) < 0 ||
         pa_tagstruct_get_boolean(t, &suspended) < 0) {
 
@@ -330,16 +351,14 @@ static void command_moved(pa_pdispatch *pd,  uint32_t command,  uint32_t tag, pa
 
 static void command_stream_buffer_attr_changed(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     struct userdata *u = userdata;
-    uint32_t channel, maxlength, tlength = 0, fragsize, prebuf, minreq;
+    uint32_t maxlength, tlength = 0, fragsize, prebuf, minreq;
     pa_usec_t usec;
 
     pa_assert(pd);
     pa_assert(t);
     pa_assert(u);
-    pa_assert(u->pdispatch == pd);
 
-    if (pa_tagstruct_getu32(t, &channel) < 0 ||
-        pa_tagstruct_getu32(t, &maxlength) < 0) {
+    if (pa_tagstruct_getu32(t, &maxlength) < 0) {
 
         pa_log_error("Invalid packet.");
         pa_module_unload_request(u->module, TRUE);
@@ -382,7 +401,6 @@ static void command_started(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa
     pa_assert(pd);
     pa_assert(t);
     pa_assert(u);
-    pa_assert(u->pdispatch == pd);
 
     pa_log_debug("Server reports playback started.");
     request_latency(u);
@@ -427,9 +445,10 @@ static void stream_cork_within_thread(struct userdata *u, pa_bool_t cork) {
 /* Called from main context */
 static void stream_cork(struct userdata *u, pa_bool_t cork) {
     pa_tagstruct *t;
+    pa_pstream *p;
     pa_assert(u);
 
-    if (!u->pstream)
+    if (!(p = pa_tunnel_link_get_pstream(u->link)) || u->channel == PA_INVALID_INDEX)
         return;
 
     t = pa_tagstruct_new(NULL, 0);
@@ -438,10 +457,10 @@ static void stream_cork(struct userdata *u, pa_bool_t cork) {
 #else
     pa_tagstruct_putu32(t, PA_COMMAND_CORK_RECORD_STREAM);
 #endif
-    pa_tagstruct_putu32(t, u->ctag++);
+    pa_tagstruct_putu32(t, pa_tunnel_link_new_tag(u->link));
     pa_tagstruct_putu32(t, u->channel);
     pa_tagstruct_put_boolean(t, !!cork);
-    pa_pstream_send_tagstruct(u->pstream, t);
+    pa_pstream_send_tagstruct(p, t);
 
     request_latency(u);
 }
@@ -467,7 +486,26 @@ static void send_data(struct userdata *u) {
         pa_memchunk memchunk;
 
         pa_sink_render(u->sink, u->requested_bytes, &memchunk);
-        pa_asyncmsgq_post(u->thread_mq.outq, PA_MSGOBJECT(u->sink), SINK_MESSAGE_POST, NULL, 0, &memchunk, NULL);
+
+#ifdef HAVE_OPUS
+        if (u->encoder) {
+            pa_memchunk encoded;
+            size_t pending;
+
+            /* The offset tells how much PCM data went into the packets */
+            pending = pa_opus_encoder_get_pending(u->encoder);
+
+            if (pa_opus_encoder_encode(u->encoder, &memchunk, &encoded) < 0)
+                pa_log_debug("Dropping %lu bytes that failed to encode.", (unsigned long) memchunk.length);
+            else if (encoded.memblock) {
+                pending += memchunk.length - pa_opus_encoder_get_pending(u->encoder);
+                pa_asyncmsgq_post(u->thread_mq.outq, PA_MSGOBJECT(u->sink), SINK_MESSAGE_POST, NULL, (int64_t) pending, &encoded, NULL);
+                pa_memblock_unref(encoded.memblock);
+            }
+        } else
+#endif
+            pa_asyncmsgq_post(u->thread_mq.outq, PA_MSGOBJECT(u->sink), SINK_MESSAGE_POST, NULL, (int64_t) memchunk.length, &memchunk, NULL);
+
         pa_memblock_unref(memchunk.memblock);
 
         u->requested_bytes -= memchunk.length;
@@ -524,6 +562,19 @@ static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offse
             return 0;
 
 
+        case SINK_MESSAGE_DISCONNECTED:
+
+            /* The next stream starts counting from scratch */
+            u->requested_bytes = 0;
+            u->counter = 0;
+            u->thread_transport_usec = 0;
+            u->remote_suspended = FALSE;
+
+            pa_smoother_reset(u->smoother, pa_rtclock_now(), TRUE);
+            check_smoother_status(u, FALSE);
+            return 0;
+
+
         case SINK_MESSAGE_UPDATE_LATENCY: {
             pa_usec_t y;
 
@@ -542,18 +593,23 @@ static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offse
             return 0;
         }
 
-        case SINK_MESSAGE_POST:
+        case SINK_MESSAGE_POST: {
+            pa_pstream *p;
 
             /* OK, This might be a bit confusing. This message is
              * delivered to us from the main context -- NOT from the
              * IO thread context where the rest of the messages are
              * dispatched. Yeah, ugly, but I am a lazy bastard. */
 
-            pa_pstream_send_memblock(u->pstream, u->channel, 0, PA_SEEK_RELATIVE, chunk);
+            /* Data rendered before the connection died is dropped */
+            if ((p = pa_tunnel_link_get_pstream(u->link)))
+                pa_pstream_send_memblock(p, u->channel, 0, PA_SEEK_RELATIVE, chunk);
 
-            u->counter_delta += (int64_t) chunk->length;
+            /* For compressed data the offset carries the PCM length */
+            u->counter_delta += offset;
 
             return 0;
+        }
     }
 
     return pa_sink_process_msg(o, code, data, offset, chunk);
@@ -584,6 +640,9 @@ static int sink_set_state(pa_sink *s, pa_sink_state_t state) {
             ;
     }
 
+    if (u->on_demand && (PA_SINK_IS_OPENED(state) || state == PA_SINK_SUSPENDED))
+        tunnel_use(u, state == PA_SINK_RUNNING);
+
     return 0;
 }
 
@@ -637,6 +696,18 @@ static int source_process_msg(pa_msgobject *o, int code, void *data, int64_t off
             stream_suspend_within_thread(u, !!PA_PTR_TO_UINT(data));
             return 0;
 
+        case SOURCE_MESSAGE_DISCONNECTED:
+
+            /* The next stream starts counting from scratch */
+            pa_mcalign_flush(u->mcalign);
+            u->counter = 0;
+            u->thread_transport_usec = 0;
+            u->remote_suspended = FALSE;
+
+            pa_smoother_reset(u->smoother, pa_rtclock_now(), TRUE);
+            check_smoother_status(u, FALSE);
+            return 0;
+
         case SOURCE_MESSAGE_UPDATE_LATENCY: {
             pa_usec_t y;
 
@@ -680,6 +751,9 @@ static int source_set_state(pa_source *s, pa_source_state_t state) {
             ;
     }
 
+    if (u->on_demand && (PA_SOURCE_IS_OPENED(state) || state == PA_SOURCE_SUSPENDED))
+        tunnel_use(u, state == PA_SOURCE_RUNNING);
+
     return 0;
 }
 
@@ -692,6 +766,8 @@ static void thread_func(void *userdata) {
 
     pa_log_debug("Thread starting up");
 
+    pa_core_setup_io_thread(u->core, u->rtprio, u->cpu_affinity);
+
     pa_thread_mq_install(&u->thread_mq);
 
     for (;;) {
@@ -722,32 +798,13 @@ finish:
 
 #ifdef TUNNEL_SINK
 /* Called from main context */
-static void command_request(pa_pdispatch *pd, uint32_t command,  uint32_t tag, pa_tagstruct *t, void *userdata) {
+static void link_request(pa_tunnel_link *l, uint32_t bytes, void *userdata) {
     struct userdata *u = userdata;
-    uint32_t bytes, channel;
 
-    pa_assert(pd);
-    pa_assert(command == PA_COMMAND_REQUEST);
-    pa_assert(t);
+    pa_assert(l);
     pa_assert(u);
-    pa_assert(u->pdispatch == pd);
-
-    if (pa_tagstruct_getu32(t, &channel) < 0 ||
-        pa_tagstruct_getu32(t, &bytes) < 0) {
-        pa_log("Invalid protocol reply");
-        goto fail;
-    }
-
-    if (channel != u->channel) {
-        pa_log("Received data for invalid channel");
-        goto fail;
-    }
 
     pa_asyncmsgq_post(u->sink->asyncmsgq, PA_MSGOBJECT(u->sink), SINK_MESSAGE_REQUEST, NULL, bytes, NULL, NULL);
-    return;
-
-fail:
-    pa_module_unload_request(u->module, TRUE);
 }
 
 #endif
@@ -805,18 +862,12 @@ static void stream_get_latency_callback(pa_pdispatch *pd, uint32_t command, uint
         return;
     }
 
+    u->latency_requested = FALSE;
+
     pa_gettimeofday(&now);
 
-    /* Calculate transport usec */
-    if (pa_timeval_cmp(&local, &remote) < 0 && pa_timeval_cmp(&remote, &now)) {
-        /* local and remote seem to have synchronized clocks */
-#ifdef TUNNEL_SINK
-        u->transport_usec = pa_timeval_diff(&remote, &local);
-#else
-        u->transport_usec = pa_timeval_diff(&now, &remote);
-#endif
-    } else
-        u->transport_usec = pa_timeval_diff(&now, &local)/2;
+    /* Calculate transport usec, i.e. the age of the measurement */
+    u->transport_usec = pa_tunnel_link_update_clock(u->link, &local, &remote, &now);
 
     /* First, take the device's delay */
 #ifdef TUNNEL_SINK
@@ -864,39 +915,43 @@ fail:
 /* Called from main context */
 static void request_latency(struct userdata *u) {
     pa_tagstruct *t;
+    pa_pstream *p;
     struct timeval now;
     uint32_t tag;
     pa_assert(u);
 
+    if (!(p = pa_tunnel_link_get_pstream(u->link)))
+        return;
+
     t = pa_tagstruct_new(NULL, 0);
 #ifdef TUNNEL_SINK
     pa_tagstruct_putu32(t, PA_COMMAND_GET_PLAYBACK_LATENCY);
 #else
     pa_tagstruct_putu32(t, PA_COMMAND_GET_RECORD_LATENCY);
 #endif
-    pa_tagstruct_putu32(t, tag = u->ctag++);
+    pa_tagstruct_putu32(t, tag = pa_tunnel_link_new_tag(u->link));
     pa_tagstruct_putu32(t, u->channel);
 
     pa_tagstruct_put_timeval(t, pa_gettimeofday(&now));
 
-    pa_pstream_send_tagstruct(u->pstream, t);
-    pa_pdispatch_register_reply(u->pdispatch, tag, DEFAULT_TIMEOUT, stream_get_latency_callback, u, NULL);
+    pa_pstream_send_tagstruct(p, t);
+    pa_pdispatch_register_reply(pa_tunnel_link_get_pdispatch(u->link), tag, DEFAULT_TIMEOUT, stream_get_latency_callback, u, NULL);
 
     u->ignore_latency_before = tag;
     u->counter_delta = 0;
+    u->latency_requested = TRUE;
 }
 
-/* Called from main context */
-static void timeout_callback(pa_mainloop_api *m, pa_time_event *e, const struct timeval *t, void *userdata) {
+/* Called from main context, from the timer of the connection */
+static void link_latency(pa_tunnel_link *l, void *userdata) {
     struct userdata *u = userdata;
 
-    pa_assert(m);
-    pa_assert(e);
+    pa_assert(l);
     pa_assert(u);
 
-    request_latency(u);
-
-    pa_core_rttime_restart(u->core, e, pa_rtclock_now() + LATENCY_INTERVAL);
+    /* On slow links, don't let a new request void the pending one */
+    if (!u->latency_requested && u->channel != PA_INVALID_INDEX)
+        request_latency(u);
 }
 
 /* Called from main context */
@@ -904,12 +959,16 @@ static void update_description(struct userdata *u) {
     char *d;
     char un[128], hn[128];
     pa_tagstruct *t;
+    pa_pstream *p;
 
     pa_assert(u);
 
     if (!u->server_fqdn || !u->user_name || !u->device_description)
         return;
 
+    if (!(p = pa_tunnel_link_get_pstream(u->link)))
+        return;
+
     d = pa_sprintf_malloc("%s on %s@%s", u->device_description, u->user_name, u->server_fqdn);
 
 #ifdef TUNNEL_SINK
@@ -936,52 +995,21 @@ static void update_description(struct userdata *u) {
 #else
     pa_tagstruct_putu32(t, PA_COMMAND_SET_RECORD_STREAM_NAME);
 #endif
-    pa_tagstruct_putu32(t, u->ctag++);
+    pa_tagstruct_putu32(t, pa_tunnel_link_new_tag(u->link));
     pa_tagstruct_putu32(t, u->channel);
     pa_tagstruct_puts(t, d);
-    pa_pstream_send_tagstruct(u->pstream, t);
+    pa_pstream_send_tagstruct(p, t);
 
     pa_xfree(d);
 }
 
 /* Called from main context */
-static void server_info_cb(pa_pdispatch *pd, uint32_t command,  uint32_t tag, pa_tagstruct *t, void *userdata) {
+static void link_server_info(pa_tunnel_link *l, const char *user_name, const char *host_name, void *userdata) {
     struct userdata *u = userdata;
-    pa_sample_spec ss;
-    pa_channel_map cm;
-    const char *server_name, *server_version, *user_name, *host_name, *default_sink_name, *default_source_name;
-    uint32_t cookie;
 
-    pa_assert(pd);
+    pa_assert(l);
     pa_assert(u);
 
-    if (command != PA_COMMAND_REPLY) {
-        if (command == PA_COMMAND_ERROR)
-            pa_log("Failed to get info.");
-        else
-            pa_log("Protocol error.");
-        goto fail;
-    }
-
-    if (pa_tagstruct_gets(t, &server_name) < 0 ||
-        pa_tagstruct_gets(t, &server_version) < 0 ||
-        pa_tagstruct_gets(t, &user_name) < 0 ||
-        pa_tagstruct_gets(t, &host_name) < 0 ||
-        pa_tagstruct_get_sample_spec(t, &ss) < 0 ||
-        pa_tagstruct_gets(t, &default_sink_name) < 0 ||
-        pa_tagstruct_gets(t, &default_source_name) < 0 ||
-        pa_tagstruct_getu32(t, &cookie) < 0 ||
-        (u->version >= 15 && pa_tagstruct_get_channel_map(t, &cm) < 0)) {
-
-        pa_log("Parse failure");
-        goto fail;
-    }
-
-    if (!pa_tagstruct_eof(t)) {
-        pa_log("Packet too long");
-        goto fail;
-    }
-
     pa_xfree(u->server_fqdn);
     u->server_fqdn = pa_xstrdup(host_name);
 
@@ -989,11 +1017,6 @@ static void server_info_cb(pa_pdispatch *pd, uint32_t command,  uint32_t tag, pa
     u->user_name = pa_xstrdup(user_name);
 
     update_description(u);
-
-    return;
-
-fail:
-    pa_module_unload_request(u->module, TRUE);
 }
 
 static int read_ports(struct userdata *u, pa_tagstruct *t)
@@ -1367,93 +1390,70 @@ fail:
 /* Called from main context */
 static void request_info(struct userdata *u) {
     pa_tagstruct *t;
+    pa_pstream *p;
+    pa_pdispatch *pd;
     uint32_t tag;
     pa_assert(u);
 
-    t = pa_tagstruct_new(NULL, 0);
-    pa_tagstruct_putu32(t, PA_COMMAND_GET_SERVER_INFO);
-    pa_tagstruct_putu32(t, tag = u->ctag++);
-    pa_pstream_send_tagstruct(u->pstream, t);
-    pa_pdispatch_register_reply(u->pdispatch, tag, DEFAULT_TIMEOUT, server_info_cb, u, NULL);
+    if (!(p = pa_tunnel_link_get_pstream(u->link)))
+        return;
+
+    pd = pa_tunnel_link_get_pdispatch(u->link);
 
 #ifdef TUNNEL_SINK
     t = pa_tagstruct_new(NULL, 0);
     pa_tagstruct_putu32(t, PA_COMMAND_GET_SINK_INPUT_INFO);
-    pa_tagstruct_putu32(t, tag = u->ctag++);
+    pa_tagstruct_putu32(t, tag = pa_tunnel_link_new_tag(u->link));
     pa_tagstruct_putu32(t, u->device_index);
-    pa_pstream_send_tagstruct(u->pstream, t);
-    pa_pdispatch_register_reply(u->pdispatch, tag, DEFAULT_TIMEOUT, sink_input_info_cb, u, NULL);
+    pa_pstream_send_tagstruct(p, t);
+    pa_pdispatch_register_reply(pd, tag, DEFAULT_TIMEOUT, sink_input_info_cb, u, NULL);
 
     if (u->sink_name) {
         t = pa_tagstruct_new(NULL, 0);
         pa_tagstruct_putu32(t, PA_COMMAND_GET_SINK_INFO);
-        pa_tagstruct_putu32(t, tag = u->ctag++);
+        pa_tagstruct_putu32(t, tag = pa_tunnel_link_new_tag(u->link));
         pa_tagstruct_putu32(t, PA_INVALID_INDEX);
         pa_tagstruct_puts(t, u->sink_name);
-        pa_pstream_send_tagstruct(u->pstream, t);
-        pa_pdispatch_register_reply(u->pdispatch, tag, DEFAULT_TIMEOUT, sink_info_cb, u, NULL);
+        pa_pstream_send_tagstruct(p, t);
+        pa_pdispatch_register_reply(pd, tag, DEFAULT_TIMEOUT, sink_info_cb, u, NULL);
     }
 #else
     if (u->source_name) {
         t = pa_tagstruct_new(NULL, 0);
         pa_tagstruct_putu32(t, PA_COMMAND_GET_SOURCE_INFO);
-        pa_tagstruct_putu32(t, tag = u->ctag++);
+        pa_tagstruct_putu32(t, tag = pa_tunnel_link_new_tag(u->link));
         pa_tagstruct_putu32(t, PA_INVALID_INDEX);
         pa_tagstruct_puts(t, u->source_name);
-        pa_pstream_send_tagstruct(u->pstream, t);
-        pa_pdispatch_register_reply(u->pdispatch, tag, DEFAULT_TIMEOUT, source_info_cb, u, NULL);
+        pa_pstream_send_tagstruct(p, t);
+        pa_pdispatch_register_reply(pd, tag, DEFAULT_TIMEOUT, source_info_cb, u, NULL);
     }
 #endif
 }
 
-/* Called from main context */
-static void command_subscribe_event(pa_pdispatch *pd,  uint32_t command,  uint32_t tag, pa_tagstruct *t, void *userdata) {
+/* Called from main context. The subscription is shared by all tunnels
+ * to the server, so the events of the other streams show up here
+ * too. */
+static void link_subscribe_event(pa_tunnel_link *l, pa_subscription_event_type_t e, uint32_t idx, void *userdata) {
     struct userdata *u = userdata;
-    pa_subscription_event_type_t e;
-    uint32_t idx;
 
-    pa_assert(pd);
-    pa_assert(t);
+    pa_assert(l);
     pa_assert(u);
-    pa_assert(command == PA_COMMAND_SUBSCRIBE_EVENT);
 
-    if (pa_tagstruct_getu32(t, &e) < 0 ||
-        pa_tagstruct_getu32(t, &idx) < 0) {
-        pa_log("Invalid protocol reply");
-        pa_module_unload_request(u->module, TRUE);
+    if (u->channel == PA_INVALID_INDEX)
         return;
-    }
 
-    if (e != (PA_SUBSCRIPTION_EVENT_SERVER|PA_SUBSCRIPTION_EVENT_CHANGE) &&
 #ifdef TUNNEL_SINK
-        e != (PA_SUBSCRIPTION_EVENT_SINK_INPUT|PA_SUBSCRIPTION_EVENT_CHANGE) &&
-        e != (PA_SUBSCRIPTION_EVENT_SINK|PA_SUBSCRIPTION_EVENT_CHANGE)
-#else
-        e != (PA_SUBSCRIPTION_EVENT_SOURCE|PA_SUBSCRIPTION_EVENT_CHANGE)
-#endif
-        )
+    if (e == (PA_SUBSCRIPTION_EVENT_SINK_INPUT|PA_SUBSCRIPTION_EVENT_CHANGE)) {
+        if (idx != u->device_index)
+            return;
+    } else if (e != (PA_SUBSCRIPTION_EVENT_SINK|PA_SUBSCRIPTION_EVENT_CHANGE))
         return;
-
-    request_info(u);
-}
-
-/* Called from main context */
-static void start_subscribe(struct userdata *u) {
-    pa_tagstruct *t;
-    pa_assert(u);
-
-    t = pa_tagstruct_new(NULL, 0);
-    pa_tagstruct_putu32(t, PA_COMMAND_SUBSCRIBE);
-    pa_tagstruct_putu32(t, u->ctag++);
-    pa_tagstruct_putu32(t, PA_SUBSCRIPTION_MASK_SERVER|
-#ifdef TUNNEL_SINK
-                        PA_SUBSCRIPTION_MASK_SINK_INPUT|PA_SUBSCRIPTION_MASK_SINK
 #else
-                        PA_SUBSCRIPTION_MASK_SOURCE
+    if (e != (PA_SUBSCRIPTION_EVENT_SOURCE|PA_SUBSCRIPTION_EVENT_CHANGE))
+        return;
 #endif
-                        );
 
-    pa_pstream_send_tagstruct(u->pstream, t);
+    request_info(u);
 }
 
 /* Called from main context */
@@ -1465,7 +1465,6 @@ static void create_stream_callback(pa_pdispatch *pd, uint32_t command,  uint32_t
 
     pa_assert(pd);
     pa_assert(u);
-    pa_assert(u->pdispatch == pd);
 
     if (command != PA_COMMAND_REPLY) {
         if (command == PA_COMMAND_ERROR)
@@ -1483,6 +1482,8 @@ static void create_stream_callback(pa_pdispatch *pd, uint32_t command,  uint32_t
         )
         goto parse_error;
 
+    pa_tunnel_link_set_channel(u->link, u->channel);
+
     if (u->version >= 9) {
 #ifdef TUNNEL_SINK
         if (pa_tagstruct_getu32(t, &u->maxlength) < 0 ||
@@ -1541,18 +1542,27 @@ static void create_stream_callback(pa_pdispatch *pd, uint32_t command,  uint32_t
             goto parse_error;
         }
 
+#if defined(TUNNEL_SINK) && defined(HAVE_OPUS)
+        /* The IO thread doesn't render anything before the first
+         * request, so the encoder can still be dropped here */
+        if (u->encoder) {
+            if (format->encoding == PA_ENCODING_OPUS)
+                pa_log_info("Sending Opus compressed data.");
+            else {
+                pa_log_info("Server can't decode Opus, sending uncompressed data.");
+                pa_opus_encoder_free(u->encoder);
+                u->encoder = NULL;
+            }
+        }
+#endif
+
         pa_format_info_free(format);
     }
 
     if (!pa_tagstruct_eof(t))
         goto parse_error;
 
-    start_subscribe(u);
     request_info(u);
-
-    pa_assert(!u->time_event);
-    u->time_event = pa_core_rttime_new(u->core, pa_rtclock_now() + LATENCY_INTERVAL, timeout_callback, u);
-
     request_latency(u);
 
     pa_log_debug("Stream created.");
@@ -1571,43 +1581,19 @@ fail:
 
 }
 
-/* Called from main context */
-static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+/* Called from main context, once the shared connection is
+ * authenticated */
+static void link_ready(pa_tunnel_link *l, void *userdata) {
     struct userdata *u = userdata;
     pa_tagstruct *reply;
     char name[256], un[128], hn[128];
     pa_cvolume volume;
+    uint32_t tag;
 
-    pa_assert(pd);
+    pa_assert(l);
     pa_assert(u);
-    pa_assert(u->pdispatch == pd);
 
-    if (command != PA_COMMAND_REPLY ||
-        pa_tagstruct_getu32(t, &u->version) < 0 ||
-        !pa_tagstruct_eof(t)) {
-
-        if (command == PA_COMMAND_ERROR)
-            pa_log("Failed to authenticate");
-        else
-            pa_log("Protocol error.");
-
-        goto fail;
-    }
-
-    /* Minimum supported protocol version */
-    if (u->version < 8) {
-        pa_log("Incompatible protocol version");
-        goto fail;
-    }
-
-    /* Starting with protocol version 13 the MSB of the version tag
-    reflects if shm is enabled for this connection or not. We don't
-    support SHM here at all, so we just ignore this. */
-
-    if (u->version >= 13)
-        u->version &= 0x7FFFFFFFU;
-
-    pa_log_debug("Protocol version: remote %u, local %u", u->version, PA_PROTOCOL_VERSION);
+    u->version = pa_tunnel_link_get_version(l);
 
 #ifdef TUNNEL_SINK
     pa_proplist_setf(u->sink->proplist, "tunnel.remote_version", "%u", u->version);
@@ -1627,24 +1613,6 @@ static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t
                 pa_get_host_name(hn, sizeof(hn)));
 #endif
 
-    reply = pa_tagstruct_new(NULL, 0);
-    pa_tagstruct_putu32(reply, PA_COMMAND_SET_CLIENT_NAME);
-    pa_tagstruct_putu32(reply, u->ctag++);
-
-    if (u->version >= 13) {
-        pa_proplist *pl;
-        pl = pa_proplist_new();
-        pa_proplist_sets(pl, PA_PROP_APPLICATION_ID, "org.PulseAudio.PulseAudio");
-        pa_proplist_sets(pl, PA_PROP_APPLICATION_VERSION, PACKAGE_VERSION);
-        pa_init_proplist(pl);
-        pa_tagstruct_put_proplist(reply, pl);
-        pa_proplist_free(pl);
-    } else
-        pa_tagstruct_puts(reply, "PulseAudio");
-
-    pa_pstream_send_tagstruct(u->pstream, reply);
-    /* We ignore the server's reply here */
-
     reply = pa_tagstruct_new(NULL, 0);
 
     if (u->version < 13)
@@ -1661,7 +1629,7 @@ static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t
 
 #ifdef TUNNEL_SINK
     pa_tagstruct_putu32(reply, PA_COMMAND_CREATE_PLAYBACK_STREAM);
-    pa_tagstruct_putu32(reply, tag = u->ctag++);
+    pa_tagstruct_putu32(reply, tag = pa_tunnel_link_new_tag(l));
 
     if (u->version < 13)
         pa_tagstruct_puts(reply, name);
@@ -1676,11 +1644,18 @@ static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t
     pa_tagstruct_putu32(reply, u->prebuf);
     pa_tagstruct_putu32(reply, u->minreq);
     pa_tagstruct_putu32(reply, 0);
-    pa_cvolume_reset(&volume, u->sink->sample_spec.channels);
+
+    /* A stream of an on demand tunnel continues where the last one
+     * was left */
+    if (u->on_demand)
+        volume = u->sink->real_volume;
+    else
+        pa_cvolume_reset(&volume, u->sink->sample_spec.channels);
+
     pa_tagstruct_put_cvolume(reply, &volume);
 #else
     pa_tagstruct_putu32(reply, PA_COMMAND_CREATE_RECORD_STREAM);
-    pa_tagstruct_putu32(reply, tag = u->ctag++);
+    pa_tagstruct_putu32(reply, tag = pa_tunnel_link_new_tag(l));
 
     if (u->version < 13)
         pa_tagstruct_puts(reply, name);
@@ -1707,7 +1682,11 @@ static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t
     if (u->version >= 13) {
         pa_proplist *pl;
 
-        pa_tagstruct_put_boolean(reply, FALSE); /* start muted/peak detect*/
+#ifdef TUNNEL_SINK
+        pa_tagstruct_put_boolean(reply, u->on_demand && u->sink->muted); /* start muted */
+#else
+        pa_tagstruct_put_boolean(reply, FALSE); /* peak detect */
+#endif
         pa_tagstruct_put_boolean(reply, TRUE); /* adjust_latency */
 
         pl = pa_proplist_new();
@@ -1723,14 +1702,14 @@ static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t
 
     if (u->version >= 14) {
 #ifdef TUNNEL_SINK
-        pa_tagstruct_put_boolean(reply, FALSE); /* volume_set */
+        pa_tagstruct_put_boolean(reply, u->on_demand); /* volume_set */
 #endif
         pa_tagstruct_put_boolean(reply, TRUE); /* early rquests */
     }
 
     if (u->version >= 15) {
 #ifdef TUNNEL_SINK
-        pa_tagstruct_put_boolean(reply, FALSE); /* muted_set */
+        pa_tagstruct_put_boolean(reply, u->on_demand); /* muted_set */
 #endif
         pa_tagstruct_put_boolean(reply, FALSE); /* don't inhibit auto suspend */
         pa_tagstruct_put_boolean(reply, FALSE); /* fail on suspend */
@@ -1745,6 +1724,28 @@ static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t
 #endif
 
 #ifdef TUNNEL_SINK
+#ifdef HAVE_OPUS
+    if (u->encoder && u->version < 28) {
+        pa_log_info("Server is too old for compressed streams, sending uncompressed data.");
+        pa_opus_encoder_free(u->encoder);
+        u->encoder = NULL;
+    }
+
+    if (u->encoder) {
+        pa_format_info *f;
+
+        /* Offer Opus first and plain PCM as fallback */
+        pa_tagstruct_putu8(reply, 2);
+
+        f = pa_opus_format_from_sample_spec(&u->sink->sample_spec, &u->sink->channel_map);
+        pa_tagstruct_put_format_info(reply, f);
+        pa_format_info_free(f);
+
+        f = pa_format_info_from_sample_spec(&u->sink->sample_spec, &u->sink->channel_map);
+        pa_tagstruct_put_format_info(reply, f);
+        pa_format_info_free(f);
+    } else
+#endif
     if (u->version >= 21) {
         /* We're not using the extended API, so n_formats = 0 and that's that */
         pa_tagstruct_putu8(reply, 0);
@@ -1763,118 +1764,132 @@ static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t
     }
 #endif
 
-    pa_pstream_send_tagstruct(u->pstream, reply);
-    pa_pdispatch_register_reply(u->pdispatch, tag, DEFAULT_TIMEOUT, create_stream_callback, u, NULL);
+    pa_pstream_send_tagstruct(pa_tunnel_link_get_pstream(l), reply);
+    pa_pdispatch_register_reply(pa_tunnel_link_get_pdispatch(l), tag, DEFAULT_TIMEOUT, create_stream_callback, u, NULL);
 
     pa_log_debug("Connection authenticated, creating stream ...");
-
-    return;
-
-fail:
-    pa_module_unload_request(u->module, TRUE);
-}
-
-/* Called from main context */
-static void pstream_die_callback(pa_pstream *p, void *userdata) {
-    struct userdata *u = userdata;
-
-    pa_assert(p);
-    pa_assert(u);
-
-    pa_log_warn("Stream died.");
-    pa_module_unload_request(u->module, TRUE);
 }
 
 /* Called from main context */
-static void pstream_packet_callback(pa_pstream *p, pa_packet *packet, const pa_creds *creds, void *userdata) {
+static void link_died(pa_tunnel_link *l, void *userdata) {
     struct userdata *u = userdata;
 
-    pa_assert(p);
-    pa_assert(packet);
+    pa_assert(l);
     pa_assert(u);
 
-    if (pa_pdispatch_run(u->pdispatch, packet, creds, u) < 0) {
-        pa_log("Invalid packet");
+    if (!u->on_demand) {
         pa_module_unload_request(u->module, TRUE);
         return;
     }
+
+    /* The link can't be freed from within the callback, the idle
+     * timer drops it and connects again if the device is in use */
+    pa_core_rttime_restart(u->core, u->idle_event, pa_rtclock_now() + RECONNECT_USEC);
 }
 
 #ifndef TUNNEL_SINK
 /* Called from main context */
-static void pstream_memblock_callback(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata) {
+static void link_memblock(pa_tunnel_link *l, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata) {
     struct userdata *u = userdata;
 
-    pa_assert(p);
+    pa_assert(l);
     pa_assert(chunk);
     pa_assert(u);
 
-    if (channel != u->channel) {
-        pa_log("Received memory block on bad channel.");
-        pa_module_unload_request(u->module, TRUE);
-        return;
-    }
-
     pa_asyncmsgq_send(u->source->asyncmsgq, PA_MSGOBJECT(u->source), SOURCE_MESSAGE_POST, PA_UINT_TO_PTR(seek), offset, chunk);
 
     u->counter_delta += (int64_t) chunk->length;
 }
 #endif
 
-/* Called from main context */
-static void on_connection(pa_socket_client *sc, pa_iochannel *io, void *userdata) {
-    struct userdata *u = userdata;
-    pa_tagstruct *t;
-    uint32_t tag;
+static const pa_tunnel_link_callbacks link_callbacks = {
+    .ready = link_ready,
+    .died = link_died,
+#ifdef TUNNEL_SINK
+    .request = link_request,
+#else
+    .memblock = link_memblock,
+#endif
+    .subscribe_event = link_subscribe_event,
+    .server_info = link_server_info,
+    .latency = link_latency,
+    .command_table = command_table
+};
 
-    pa_assert(sc);
+/* Called from main context */
+static void tunnel_connect(struct userdata *u) {
     pa_assert(u);
-    pa_assert(u->client == sc);
-
-    pa_socket_client_unref(u->client);
-    u->client = NULL;
 
-    if (!io) {
-        pa_log("Connection failed: %s", pa_cstrerror(errno));
-        pa_module_unload_request(u->module, TRUE);
+    if (u->link)
         return;
-    }
 
-    u->pstream = pa_pstream_new(u->core->mainloop, io, u->core->mempool);
-    u->pdispatch = pa_pdispatch_new(u->core->mainloop, TRUE, command_table, PA_COMMAND_MAX);
+    pa_log_debug("Connecting tunnel to %s.", u->server_name);
 
-    pa_pstream_set_die_callback(u->pstream, pstream_die_callback, u);
-    pa_pstream_set_receive_packet_callback(u->pstream, pstream_packet_callback, u);
-#ifndef TUNNEL_SINK
-    pa_pstream_set_receive_memblock_callback(u->pstream, pstream_memblock_callback, u);
+    /* Shares the connection with the other tunnels to the server */
+#ifdef TUNNEL_SINK
+    u->link = pa_tunnel_link_new(u->core, u->server_name, u->cookie, FALSE, &link_callbacks, u);
+#else
+    u->link = pa_tunnel_link_new(u->core, u->server_name, u->cookie, TRUE, &link_callbacks, u);
 #endif
+}
 
-    t = pa_tagstruct_new(NULL, 0);
-    pa_tagstruct_putu32(t, PA_COMMAND_AUTH);
-    pa_tagstruct_putu32(t, tag = u->ctag++);
-    pa_tagstruct_putu32(t, PA_PROTOCOL_VERSION);
+/* Called from main context */
+static void tunnel_disconnect(struct userdata *u) {
+    pa_assert(u);
 
-    pa_tagstruct_put_arbitrary(t, pa_auth_cookie_read(u->auth_cookie, PA_NATIVE_COOKIE_LENGTH), PA_NATIVE_COOKIE_LENGTH);
+    if (!u->link)
+        return;
 
-#ifdef HAVE_CREDS
-{
-    pa_creds ucred;
+    pa_log_debug("Disconnecting tunnel from %s.", u->server_name);
 
-    if (pa_iochannel_creds_supported(io))
-        pa_iochannel_creds_enable(io);
+    pa_tunnel_link_free(u->link);
+    u->link = NULL;
 
-    ucred.uid = getuid();
-    ucred.gid = getgid();
+    u->channel = u->device_index = PA_INVALID_INDEX;
+    u->latency_requested = FALSE;
+    u->counter_delta = 0;
+    u->transport_usec = 0;
 
-    pa_pstream_send_tagstruct_with_creds(u->pstream, t, &ucred);
+#ifdef TUNNEL_SINK
+    pa_asyncmsgq_send(u->sink->asyncmsgq, PA_MSGOBJECT(u->sink), SINK_MESSAGE_DISCONNECTED, NULL, 0, NULL);
+#else
+    pa_asyncmsgq_send(u->source->asyncmsgq, PA_MSGOBJECT(u->source), SOURCE_MESSAGE_DISCONNECTED, NULL, 0, NULL);
+#endif
 }
+
+/* Called from main context */
+static void idle_cb(pa_mainloop_api *m, pa_time_event *e, const struct timeval *t, void *userdata) {
+    struct userdata *u = userdata;
+
+    pa_assert(m);
+    pa_assert(e);
+    pa_assert(u);
+
+    m->time_restart(e, NULL);
+
+    tunnel_disconnect(u);
+
+    /* Only after the connection died */
+#ifdef TUNNEL_SINK
+    if (pa_sink_get_state(u->sink) == PA_SINK_RUNNING)
 #else
-    pa_pstream_send_tagstruct(u->pstream, t);
+    if (pa_source_get_state(u->source) == PA_SOURCE_RUNNING)
 #endif
+        tunnel_connect(u);
+}
 
-    pa_pdispatch_register_reply(u->pdispatch, tag, DEFAULT_TIMEOUT, setup_complete_callback, u, NULL);
+/* Called from main context. On demand tunnels connect when the first
+ * stream shows up and disconnect when they have been without one for
+ * a while. */
+static void tunnel_use(struct userdata *u, pa_bool_t used) {
+    pa_assert(u);
+    pa_assert(u->on_demand);
 
-    pa_log_debug("Connection established, authenticating ...");
+    if (used) {
+        u->core->mainloop->time_restart(u->idle_event, NULL);
+        tunnel_connect(u);
+    } else if (u->link)
+        pa_core_rttime_restart(u->core, u->idle_event, pa_rtclock_now() + u->idle_usec);
 }
 
 #ifdef TUNNEL_SINK
@@ -1883,23 +1898,28 @@ static void on_connection(pa_socket_client *sc, pa_iochannel *io, void *userdata
 static void sink_set_volume(pa_sink *sink) {
     struct userdata *u;
     pa_tagstruct *t;
+    pa_pstream *p;
 
     pa_assert(sink);
     u = sink->userdata;
     pa_assert(u);
 
+    if (!(p = pa_tunnel_link_get_pstream(u->link)))
+        return;
+
     t = pa_tagstruct_new(NULL, 0);
     pa_tagstruct_putu32(t, PA_COMMAND_SET_SINK_INPUT_VOLUME);
-    pa_tagstruct_putu32(t, u->ctag++);
+    pa_tagstruct_putu32(t, pa_tunnel_link_new_tag(u->link));
     pa_tagstruct_putu32(t, u->device_index);
     pa_tagstruct_put_cvolume(t, &sink->real_volume);
-    pa_pstream_send_tagstruct(u->pstream, t);
+    pa_pstream_send_tagstruct(p, t);
 }
 
 /* Called from main context */
 static void sink_set_mute(pa_sink *sink) {
     struct userdata *u;
     pa_tagstruct *t;
+    pa_pstream *p;
 
     pa_assert(sink);
     u = sink->userdata;
@@ -1908,12 +1928,15 @@ static void sink_set_mute(pa_sink *sink) {
     if (u->version < 11)
         return;
 
+    if (!(p = pa_tunnel_link_get_pstream(u->link)))
+        return;
+
     t = pa_tagstruct_new(NULL, 0);
     pa_tagstruct_putu32(t, PA_COMMAND_SET_SINK_INPUT_MUTE);
-    pa_tagstruct_putu32(t, u->ctag++);
+    pa_tagstruct_putu32(t, pa_tunnel_link_new_tag(u->link));
     pa_tagstruct_putu32(t, u->device_index);
     pa_tagstruct_put_boolean(t, !!sink->muted);
-    pa_pstream_send_tagstruct(u->pstream, t);
+    pa_pstream_send_tagstruct(p, t);
 }
 
 #endif
@@ -1924,7 +1947,9 @@ int pa__init(pa_module*m) {
     pa_sample_spec ss;
     pa_channel_map map;
     char *dn = NULL;
+    uint32_t idle_time;
 #ifdef TUNNEL_SINK
+    const char *compression;
     pa_sink_new_data data;
 #else
     pa_source_new_data data;
@@ -1940,9 +1965,7 @@ int pa__init(pa_module*m) {
     m->userdata = u = pa_xnew0(struct userdata, 1);
     u->core = m->core;
     u->module = m;
-    u->client = NULL;
-    u->pdispatch = NULL;
-    u->pstream = NULL;
+    u->link = NULL;
     u->server_name = NULL;
 #ifdef TUNNEL_SINK
     u->sink_name = pa_xstrdup(pa_modargs_get_value(ma, "sink", NULL));;
@@ -1959,21 +1982,26 @@ int pa__init(pa_module*m) {
             TRUE,
             10,
             pa_rtclock_now(),
+            FALSE,
             FALSE);
-    u->ctag = 1;
     u->device_index = u->channel = PA_INVALID_INDEX;
-    u->time_event = NULL;
     u->ignore_latency_before = 0;
     u->transport_usec = u->thread_transport_usec = 0;
     u->remote_suspended = u->remote_corked = FALSE;
+    u->latency_requested = FALSE;
     u->counter = u->counter_delta = 0;
 
+    /* The tunnel thread mostly shovels data off the network, so unlike
+     * the local devices it is only made realtime when asked to */
+    u->rtprio = 0;
+    if (pa_modargs_get_io_thread_args(ma, &u->rtprio, &u->cpu_affinity) < 0) {
+        pa_log("Failed to parse realtime_priority or cpu_affinity argument.");
+        goto fail;
+    }
+
     u->rtpoll = pa_rtpoll_new();
     pa_thread_mq_init(&u->thread_mq, m->core->mainloop, u->rtpoll);
 
-    if (!(u->auth_cookie = pa_auth_cookie_get(u->core, pa_modargs_get_value(ma, "cookie", PA_NATIVE_COOKIE_FILE), PA_NATIVE_COOKIE_LENGTH)))
-        goto fail;
-
     if (!(u->server_name = pa_xstrdup(pa_modargs_get_value(ma, "server", NULL)))) {
         pa_log("No server specified.");
         goto fail;
@@ -1986,12 +2014,57 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
-    if (!(u->client = pa_socket_client_new_string(m->core->mainloop, TRUE, u->server_name, PA_NATIVE_DEFAULT_PORT))) {
-        pa_log("Failed to connect to server '%s'", u->server_name);
+#ifdef TUNNEL_SINK
+    compression = pa_modargs_get_value(ma, "compression", "none");
+
+    if (pa_streq(compression, "opus")) {
+#ifdef HAVE_OPUS
+        uint32_t bitrate = 0;
+
+        if (pa_modargs_get_value_u32(ma, "bitrate", &bitrate) < 0) {
+            pa_log("Invalid bitrate");
+            goto fail;
+        }
+
+        if (!pa_opus_sample_spec_valid(&ss))
+            pa_log_warn("Opus only supports s16ne and float32ne with one or two channels at 8, 12, 16, 24 or 48 kHz, not compressing.");
+        else if (!(u->encoder = pa_opus_encoder_new(m->core->mempool, &ss, bitrate)))
+            goto fail;
+#else
+        pa_log("Opus support not available.");
+        goto fail;
+#endif
+    } else if (!pa_streq(compression, "none")) {
+        pa_log("Invalid compression %s", compression);
+        goto fail;
+    }
+#endif
+
+    u->cookie = pa_xstrdup(pa_modargs_get_value(ma, "cookie", PA_NATIVE_COOKIE_FILE));
+
+    u->on_demand = FALSE;
+    if (pa_modargs_get_value_boolean(ma, "on_demand", &u->on_demand) < 0) {
+        pa_log("Failed to parse on_demand argument.");
+        goto fail;
+    }
+
+    idle_time = DEFAULT_IDLE_TIME;
+    if (pa_modargs_get_value_u32(ma, "idle_time", &idle_time) < 0) {
+        pa_log("Failed to parse idle_time argument.");
         goto fail;
     }
 
-    pa_socket_client_set_callback(u->client, on_connection, u);
+    u->idle_usec = (pa_usec_t) idle_time * PA_USEC_PER_SEC;
+
+    /* On demand tunnels connect once the device is used */
+    if (u->on_demand)
+        u->idle_event = pa_core_rttime_new(m->core, PA_USEC_INVALID, idle_cb, u);
+    else {
+        tunnel_connect(u);
+
+        if (!u->link)
+            goto fail;
+    }
 
 #ifdef TUNNEL_SINK
 
@@ -2082,8 +2155,6 @@ int pa__init(pa_module*m) {
 
     pa_xfree(dn);
 
-    u->time_event = NULL;
-
     u->maxlength = (uint32_t) -1;
 #ifdef TUNNEL_SINK
     u->tlength = u->minreq = u->prebuf = (uint32_t) -1;
@@ -2151,29 +2222,21 @@ void pa__done(pa_module*m) {
     if (u->rtpoll)
         pa_rtpoll_free(u->rtpoll);
 
-    if (u->pstream) {
-        pa_pstream_unlink(u->pstream);
-        pa_pstream_unref(u->pstream);
-    }
+    if (u->idle_event)
+        u->core->mainloop->time_free(u->idle_event);
 
-    if (u->pdispatch)
-        pa_pdispatch_unref(u->pdispatch);
-
-    if (u->client)
-        pa_socket_client_unref(u->client);
-
-    if (u->auth_cookie)
-        pa_auth_cookie_unref(u->auth_cookie);
+    if (u->link)
+        pa_tunnel_link_free(u->link);
 
     if (u->smoother)
         pa_smoother_free(u->smoother);
 
-    if (u->time_event)
-        u->core->mainloop->time_free(u->time_event);
-
 #ifndef TUNNEL_SINK
     if (u->mcalign)
         pa_mcalign_free(u->mcalign);
+#elif defined(HAVE_OPUS)
+    if (u->encoder)
+        pa_opus_encoder_free(u->encoder);
 #endif
 
 #ifdef TUNNEL_SINK
@@ -2182,6 +2245,8 @@ void pa__done(pa_module*m) {
     pa_xfree(u->source_name);
 #endif
     pa_xfree(u->server_name);
+    pa_xfree(u->cookie);
+    pa_xfree(u->cpu_affinity);
 
     pa_xfree(u->device_description);
     pa_xfree(u->server_fqdn);
@@ -36,6 +36,11 @@
 #include <pulsecore/core-util.h>
 #include <pulsecore/namereg.h>
 #include <pulsecore/ratelimit.h>
+#include <pulsecore/strbuf.h>
+
+#ifdef HAVE_ALSA
+#include <modules/alsa/alsa-probe.h>
+#endif
 
 #include "module-udev-detect-symdef.h"
 
@@ -73,6 +78,11 @@ struct userdata {
 
     int inotify_fd;
     pa_io_event *inotify_io;
+
+#ifdef HAVE_ALSA
+    /* Only set while enumerating the cards at startup */
+    pa_alsa_prober *prober;
+#endif
 };
 
 static const char* const valid_modargs[] = {
@@ -83,6 +93,21 @@ static const char* const valid_modargs[] = {
     NULL
 };
 
+/* Numeric module-alsa-card arguments that can be set for a card in the
+ * udev database, e.g. ENV{PULSE_TSCHED_BUFFER_WATERMARK}="3528". The
+ * sizes are in bytes of the default sample spec, like the arguments
+ * themselves. */
+static const struct {
+    const char *property;
+    const char *argument;
+} udev_arguments[] = {
+    { "PULSE_TSCHED_BUFFER_SIZE",      "tsched_buffer_size" },
+    { "PULSE_TSCHED_BUFFER_WATERMARK", "tsched_buffer_watermark" },
+    { "PULSE_FRAGMENTS",               "fragments" },
+    { "PULSE_FRAGMENT_SIZE",           "fragment_size" },
+    { "PULSE_REALTIME_PRIORITY",       "realtime_priority" },
+};
+
 static int setup_inotify(struct userdata *u);
 
 static void device_free(struct device *d) {
@@ -308,6 +333,16 @@ static void verify_access(struct userdata *u, struct device *d) {
 
             if (!busy) {
 
+#ifdef HAVE_ALSA
+                /* Probing takes long, so at startup all cards are
+                 * probed at once before loading any of them */
+                if (u->prober) {
+                    pa_alsa_prober_add(u->prober, path_get_card_id(d->path), u->ignore_dB);
+                    d->need_verify = TRUE;
+                    return;
+                }
+#endif
+
                 /* So, why do we rate limit here? It's certainly ugly,
                  * but there seems to be no other way. Problem is
                  * this: if we are unable to configure/probe an audio
@@ -359,7 +394,11 @@ static void card_changed(struct userdata *u, struct udev_device *dev) {
     struct device *d;
     const char *path;
     const char *t;
-    char *n;
+    char *n, *extra;
+    pa_strbuf *args;
+    pa_bool_t use_tsched;
+    unsigned i;
+    int b;
 
     pa_assert(u);
     pa_assert(dev);
@@ -385,23 +424,58 @@ static void card_changed(struct userdata *u, struct udev_device *dev) {
                 t = path_get_card_id(path);
 
     n = pa_namereg_make_valid_name(t);
+
+    use_tsched = u->use_tsched;
+
+    if ((t = udev_device_get_property_value(dev, "PULSE_TSCHED"))) {
+        if ((b = pa_parse_boolean(t)) >= 0)
+            use_tsched = !!b;
+        else
+            pa_log_warn("Ignoring invalid PULSE_TSCHED=%s of %s.", t, path);
+    }
+
+    args = pa_strbuf_new();
+
+    /* Passed only when they differ from what module-alsa-card would do
+     * anyway, so that its quirk database can still pick them */
+    if (!use_tsched || udev_device_get_property_value(dev, "PULSE_TSCHED"))
+        pa_strbuf_printf(args, " tsched=%s", pa_yes_no(use_tsched));
+
+    if (u->fixed_latency_range)
+        pa_strbuf_puts(args, " fixed_latency_range=yes");
+
+    for (i = 0; i < PA_ELEMENTSOF(udev_arguments); i++) {
+        uint32_t value;
+
+        if (!(t = udev_device_get_property_value(dev, udev_arguments[i].property)))
+            continue;
+
+        /* Taken over verbatim, so must not contain anything else */
+        if (pa_atou(t, &value) < 0) {
+            pa_log_warn("Ignoring invalid %s=%s of %s.", udev_arguments[i].property, t, path);
+            continue;
+        }
+
+        pa_strbuf_printf(args, " %s=%u", udev_arguments[i].argument, value);
+    }
+
+    extra = pa_strbuf_tostring_free(args);
+
     d->card_name = pa_sprintf_malloc("alsa_card.%s", n);
     d->args = pa_sprintf_malloc("device_id=\"%s\" "
                                 "name=\"%s\" "
                                 "card_name=\"%s\" "
                                 "namereg_fail=false "
-                                "tsched=%s "
-                                "fixed_latency_range=%s "
                                 "ignore_dB=%s "
                                 "deferred_volume=%s "
-                                "card_properties=\"module-udev-detect.discovered=1\"",
+                                "card_properties=\"module-udev-detect.discovered=1\"%s",
                                 path_get_card_id(path),
                                 n,
                                 d->card_name,
-                                pa_yes_no(u->use_tsched),
-                                pa_yes_no(u->fixed_latency_range),
                                 pa_yes_no(u->ignore_dB),
-                                pa_yes_no(u->deferred_volume));
+                                pa_yes_no(u->deferred_volume),
+                                extra);
+    pa_xfree(extra);
     pa_xfree(n);
 
     pa_hashmap_put(u->devices, d->path, d);
@@ -756,12 +830,35 @@ int pa__init(pa_module *m) {
         goto fail;
     }
 
+#ifdef HAVE_ALSA
+    u->prober = pa_alsa_prober_new(u->core);
+#endif
+
     first = udev_enumerate_get_list_entry(enumerate);
     udev_list_entry_foreach(item, first)
         process_path(u, udev_list_entry_get_name(item));
 
     udev_enumerate_unref(enumerate);
 
+#ifdef HAVE_ALSA
+    {
+        pa_alsa_prober *prober = u->prober;
+        struct device *d;
+        void *state;
+
+        u->prober = NULL;
+        pa_alsa_prober_wait(prober);
+
+        PA_HASHMAP_FOREACH(d, u->devices, state)
+            if (d->need_verify) {
+                d->need_verify = FALSE;
+                verify_access(u, d);
+            }
+
+        pa_alsa_prober_free(prober);
+    }
+#endif
+
     pa_log_info("Found %u cards.", pa_hashmap_size(u->devices));
 
     pa_modargs_free(ma);
@@ -789,6 +886,11 @@ void pa__done(pa_module *m) {
     if (!(u = m->userdata))
         return;
 
+#ifdef HAVE_ALSA
+    if (u->prober)
+        pa_alsa_prober_free(u->prober);
+#endif
+
     if (u->udev_io)
         m->core->mainloop->io_free(u->udev_io);
 
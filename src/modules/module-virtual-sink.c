@@ -37,6 +37,7 @@
 #include <pulsecore/rtpoll.h>
 #include <pulsecore/sample-util.h>
 #include <pulsecore/ltdl-helper.h>
+#include <pulsecore/block-filter.h>
 
 #include "module-virtual-sink-symdef.h"
 
@@ -56,7 +57,10 @@ PA_MODULE_USAGE(
           "force_flat_volume=<yes or no> "
         ));
 
-#define MEMBLOCKQ_MAXLENGTH (16*1024*1024)
+/* (1) IF YOU NEED A FIXED BLOCK SIZE PUT IT HERE. NOTE THAT FILTERS
+ * WHICH CAN DEAL WITH DYNAMIC BLOCK SIZES ARE HIGHLY PREFERRED, EVERY
+ * FRAME MORE ADDS TO THE LATENCY. */
+#define BLOCK_FRAMES 1
 
 struct userdata {
     pa_module *module;
@@ -67,7 +71,7 @@ struct userdata {
     pa_sink *sink;
     pa_sink_input *sink_input;
 
-    pa_memblockq *memblockq;
+    pa_block_filter *filter;
 
     pa_bool_t auto_desc;
     unsigned channels;
@@ -109,7 +113,10 @@ static int sink_process_msg_cb(pa_msgobject *o, int code, void *data, int64_t of
                 pa_sink_get_latency_within_thread(u->sink_input->sink) +
 
                 /* Add the latency internal to our sink input on top */
-                pa_bytes_to_usec(pa_memblockq_get_length(u->sink_input->thread_info.render_memblockq), &u->sink_input->sink->sample_spec);
+                pa_bytes_to_usec(pa_memblockq_get_length(u->sink_input->thread_info.render_memblockq), &u->sink_input->sink->sample_spec) +
+
+                /* And the input waiting for a block to fill up */
+                pa_bytes_to_usec(pa_block_filter_get_length(u->filter), &u->sink->sample_spec);
 
             return 0;
     }
@@ -146,7 +153,7 @@ static void sink_request_rewind_cb(pa_sink *s) {
     /* Just hand this one over to the master sink */
     pa_sink_input_request_rewind(u->sink_input,
                                  s->thread_info.rewind_nbytes +
-                                 pa_memblockq_get_length(u->memblockq), TRUE, FALSE, FALSE);
+                                 pa_block_filter_get_length(u->filter), TRUE, FALSE, FALSE);
 }
 
 /* Called from I/O thread context */
@@ -194,13 +201,29 @@ static void sink_set_mute_cb(pa_sink *s) {
     pa_sink_input_set_mute(u->sink_input, s->muted, s->save_muted);
 }
 
+/* Called from I/O thread context */
+static void filter_cb(void *userdata, float *const in[], float *const out[], unsigned n) {
+    struct userdata *u = userdata;
+    unsigned c;
+
+    /* (2) PUT YOUR CODE HERE TO DO SOMETHING WITH THE DATA. EACH
+     * CHANNEL COMES IN ITS OWN BUFFER, ALIGNED FOR SIMD, AND n IS A
+     * MULTIPLE OF BLOCK_FRAMES */
+
+    /* As an example, copy input to output */
+    for (c = 0; c < u->channels; c++)
+        memcpy(out[c], in[c], n * sizeof(float));
+}
+
+/* Called from I/O thread context */
+static void reset_cb(void *userdata) {
+
+    /* (3) PUT YOUR CODE HERE TO RESET YOUR FILTER */
+}
+
 /* Called from I/O thread context */
 static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk) {
     struct userdata *u;
-    float *src, *dst;
-    size_t fs;
-    unsigned n, c;
-    pa_memchunk tchunk;
     pa_usec_t current_latency PA_GCC_UNUSED;
 
     pa_sink_input_assert_ref(i);
@@ -210,51 +233,7 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
     /* Hmm, process any rewind request that might be queued up */
     pa_sink_process_rewind(u->sink, 0);
 
-    /* (1) IF YOU NEED A FIXED BLOCK SIZE USE
-     * pa_memblockq_peek_fixed_size() HERE INSTEAD. NOTE THAT FILTERS
-     * WHICH CAN DEAL WITH DYNAMIC BLOCK SIZES ARE HIGHLY
-     * PREFERRED. */
-    while (pa_memblockq_peek(u->memblockq, &tchunk) < 0) {
-        pa_memchunk nchunk;
-
-        pa_sink_render(u->sink, nbytes, &nchunk);
-        pa_memblockq_push(u->memblockq, &nchunk);
-        pa_memblock_unref(nchunk.memblock);
-    }
-
-    /* (2) IF YOU NEED A FIXED BLOCK SIZE, THIS NEXT LINE IS NOT
-     * NECESSARY */
-    tchunk.length = PA_MIN(nbytes, tchunk.length);
-    pa_assert(tchunk.length > 0);
-
-    fs = pa_frame_size(&i->sample_spec);
-    n = (unsigned) (tchunk.length / fs);
-
-    pa_assert(n > 0);
-
-    chunk->index = 0;
-    chunk->length = n*fs;
-    chunk->memblock = pa_memblock_new(i->sink->core->mempool, chunk->length);
-
-    pa_memblockq_drop(u->memblockq, chunk->length);
-
-    src = (float*) ((uint8_t*) pa_memblock_acquire(tchunk.memblock) + tchunk.index);
-    dst = (float*) pa_memblock_acquire(chunk->memblock);
-
-    /* (3) PUT YOUR CODE HERE TO DO SOMETHING WITH THE DATA */
-
-    /* As an example, copy input to output */
-    for (c = 0; c < u->channels; c++) {
-        pa_sample_clamp(PA_SAMPLE_FLOAT32NE,
-                        dst+c, u->channels * sizeof(float),
-                        src+c, u->channels * sizeof(float),
-                        n);
-    }
-
-    pa_memblock_release(tchunk.memblock);
-    pa_memblock_release(chunk->memblock);
-
-    pa_memblock_unref(tchunk.memblock);
+    pa_block_filter_render(u->filter, u->sink, nbytes, chunk);
 
     /* (4) IF YOU NEED THE LATENCY FOR SOMETHING ACQUIRE IT LIKE THIS: */
     current_latency =
@@ -270,27 +249,11 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
 /* Called from I/O thread context */
 static void sink_input_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
     struct userdata *u;
-    size_t amount = 0;
 
     pa_sink_input_assert_ref(i);
     pa_assert_se(u = i->userdata);
 
-    if (u->sink->thread_info.rewind_nbytes > 0) {
-        size_t max_rewrite;
-
-        max_rewrite = nbytes + pa_memblockq_get_length(u->memblockq);
-        amount = PA_MIN(u->sink->thread_info.rewind_nbytes, max_rewrite);
-        u->sink->thread_info.rewind_nbytes = 0;
-
-        if (amount > 0) {
-            pa_memblockq_seek(u->memblockq, - (int64_t) amount, PA_SEEK_RELATIVE, TRUE);
-
-            /* (5) PUT YOUR CODE HERE TO RESET YOUR FILTER  */
-        }
-    }
-
-    pa_sink_process_rewind(u->sink, amount);
-    pa_memblockq_rewind(u->memblockq, nbytes);
+    pa_block_filter_process_rewind(u->filter, u->sink, nbytes);
 }
 
 /* Called from I/O thread context */
@@ -300,8 +263,7 @@ static void sink_input_update_max_rewind_cb(pa_sink_input *i, size_t nbytes) {
     pa_sink_input_assert_ref(i);
     pa_assert_se(u = i->userdata);
 
-    pa_memblockq_set_maxrewind(u->memblockq, nbytes);
-    pa_sink_set_max_rewind_within_thread(u->sink, nbytes);
+    pa_block_filter_update_max_rewind(u->filter, u->sink, nbytes);
 }
 
 /* Called from I/O thread context */
@@ -311,10 +273,7 @@ static void sink_input_update_max_request_cb(pa_sink_input *i, size_t nbytes) {
     pa_sink_input_assert_ref(i);
     pa_assert_se(u = i->userdata);
 
-    /* (6) IF YOU NEED A FIXED BLOCK SIZE ROUND nbytes UP TO MULTIPLES
-     * OF IT HERE. THE PA_ROUND_UP MACRO IS USEFUL FOR THAT. */
-
-    pa_sink_set_max_request_within_thread(u->sink, nbytes);
+    pa_sink_set_max_request_within_thread(u->sink, pa_block_filter_get_max_request(u->filter, nbytes));
 }
 
 /* Called from I/O thread context */
@@ -334,11 +293,7 @@ static void sink_input_update_sink_fixed_latency_cb(pa_sink_input *i) {
     pa_sink_input_assert_ref(i);
     pa_assert_se(u = i->userdata);
 
-    /* (7) IF YOU NEED A FIXED BLOCK SIZE ADD THE LATENCY FOR ONE
-     * BLOCK MINUS ONE SAMPLE HERE. pa_usec_to_bytes_round_up() IS
-     * USEFUL FOR THAT. */
-
-    pa_sink_set_fixed_latency_within_thread(u->sink, i->sink->thread_info.fixed_latency);
+    pa_sink_set_fixed_latency_within_thread(u->sink, i->sink->thread_info.fixed_latency + pa_block_filter_get_latency(u->filter));
 }
 
 /* Called from I/O thread context */
@@ -363,14 +318,8 @@ static void sink_input_attach_cb(pa_sink_input *i) {
     pa_sink_set_rtpoll(u->sink, i->sink->thread_info.rtpoll);
     pa_sink_set_latency_range_within_thread(u->sink, i->sink->thread_info.min_latency, i->sink->thread_info.max_latency);
 
-    /* (8.1) IF YOU NEED A FIXED BLOCK SIZE ADD THE LATENCY FOR ONE
-     * BLOCK MINUS ONE SAMPLE HERE. SEE (7) */
-    pa_sink_set_fixed_latency_within_thread(u->sink, i->sink->thread_info.fixed_latency);
-
-    /* (8.2) IF YOU NEED A FIXED BLOCK SIZE ROUND
-     * pa_sink_input_get_max_request(i) UP TO MULTIPLES OF IT
-     * HERE. SEE (6) */
-    pa_sink_set_max_request_within_thread(u->sink, pa_sink_input_get_max_request(i));
+    pa_sink_set_fixed_latency_within_thread(u->sink, i->sink->thread_info.fixed_latency + pa_block_filter_get_latency(u->filter));
+    pa_sink_set_max_request_within_thread(u->sink, pa_block_filter_get_max_request(u->filter, pa_sink_input_get_max_request(i)));
     pa_sink_set_max_rewind_within_thread(u->sink, pa_sink_input_get_max_rewind(i));
 
     pa_sink_attach_within_thread(u->sink);
@@ -481,7 +430,6 @@ int pa__init(pa_module*m) {
     pa_sink_new_data sink_data;
     pa_bool_t use_volume_sharing = TRUE;
     pa_bool_t force_flat_volume = FALSE;
-    pa_memchunk silence;
 
     pa_assert(m);
 
@@ -505,6 +453,11 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    if (ss.format != PA_SAMPLE_FLOAT32NE) {
+        pa_log("The filter only works on native endian float samples");
+        goto fail;
+    }
+
     if (pa_modargs_get_value_boolean(ma, "use_volume_sharing", &use_volume_sharing) < 0) {
         pa_log("use_volume_sharing= expects a boolean argument");
         goto fail;
@@ -610,11 +563,13 @@ int pa__init(pa_module*m) {
 
     u->sink->input_to_master = u->sink_input;
 
-    pa_sink_input_get_silence(u->sink_input, &silence);
-    u->memblockq = pa_memblockq_new("module-virtual-sink memblockq", 0, MEMBLOCKQ_MAXLENGTH, 0, &ss, 1, 1, 0, &silence);
-    pa_memblock_unref(silence.memblock);
+    u->filter = pa_block_filter_new(m->core, "module-virtual-sink filter", &ss, &ss, BLOCK_FRAMES, filter_cb, reset_cb, u);
+
+    /* The example filter keeps no history, so silence in is silence
+     * out right away. A real filter sets how long it rings instead. */
+    pa_block_filter_set_tail(u->filter, 0);
 
-    /* (9) INITIALIZE ANYTHING ELSE YOU NEED HERE */
+    /* (5) INITIALIZE ANYTHING ELSE YOU NEED HERE */
 
     pa_sink_put(u->sink);
     pa_sink_input_put(u->sink_input);
@@ -664,8 +619,8 @@ void pa__done(pa_module*m) {
     if (u->sink)
         pa_sink_unref(u->sink);
 
-    if (u->memblockq)
-        pa_memblockq_free(u->memblockq);
+    if (u->filter)
+        pa_block_filter_free(u->filter);
 
     pa_xfree(u);
 }
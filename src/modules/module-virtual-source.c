@@ -39,6 +39,7 @@
 #include <pulsecore/rtpoll.h>
 #include <pulsecore/sample-util.h>
 #include <pulsecore/ltdl-helper.h>
+#include <pulsecore/block-filter.h>
 
 #include "module-virtual-source-symdef.h"
 
@@ -62,6 +63,10 @@ PA_MODULE_USAGE(
 #define MEMBLOCKQ_MAXLENGTH (16*1024*1024)
 #define BLOCK_USEC 1000 /* FIXME */
 
+/* IF YOU NEED A FIXED BLOCK SIZE PUT IT HERE. FILTERS WHICH CAN DEAL
+ * WITH DYNAMIC BLOCK SIZES ARE HIGHLY PREFERRED. */
+#define BLOCK_FRAMES 1
+
 struct userdata {
     pa_module *module;
 
@@ -71,7 +76,7 @@ struct userdata {
     pa_source *source;
     pa_source_output *source_output;
 
-    pa_memblockq *memblockq;
+    pa_block_filter *filter;
 
     pa_bool_t auto_desc;
     unsigned channels;
@@ -188,7 +193,10 @@ static int source_process_msg_cb(pa_msgobject *o, int code, void *data, int64_t
 
                 /* Add the latency internal to our source output on top */
                 /* FIXME, no idea what I am doing here */
-                pa_bytes_to_usec(pa_memblockq_get_length(u->source_output->thread_info.delay_memblockq), &u->source_output->source->sample_spec);
+                pa_bytes_to_usec(pa_memblockq_get_length(u->source_output->thread_info.delay_memblockq), &u->source_output->source->sample_spec) +
+
+                /* And the input waiting for a block to fill up */
+                pa_bytes_to_usec(pa_block_filter_get_length(u->filter), &u->source->sample_spec);
 
             return 0;
     }
@@ -257,19 +265,21 @@ static void source_set_mute_cb(pa_source *s) {
 }
 
 /* Called from input thread context */
-static void source_output_push_cb(pa_source_output *o, const pa_memchunk *chunk) {
-    struct userdata *u;
+static void filter_cb(void *userdata, float *const in[], float *const out[], unsigned n) {
+    struct userdata *u = userdata;
+    unsigned c;
 
-    pa_source_output_assert_ref(o);
-    pa_source_output_assert_io_context(o);
-    pa_assert_se(u = o->userdata);
+    /* PUT YOUR CODE HERE TO DO SOMETHING WITH THE SOURCE DATA. EACH
+     * CHANNEL COMES IN ITS OWN BUFFER, ALIGNED FOR SIMD, AND n IS A
+     * MULTIPLE OF BLOCK_FRAMES */
 
-    if (!PA_SOURCE_OUTPUT_IS_LINKED(pa_source_output_get_state(u->source_output))) {
-        pa_log("push when no link?");
-        return;
-    }
+    /* As an example, copy input to output */
+    for (c = 0; c < u->channels; c++)
+        memcpy(out[c], in[c], n * sizeof(float));
+}
 
-    /* PUT YOUR CODE HERE TO DO SOMETHING WITH THE SOURCE DATA */
+/* Called from input thread context */
+static void post_chunk(struct userdata *u, pa_source_output *o, const pa_memchunk *chunk) {
 
     /* if uplink sink exists, pull data from there; simplify by using
        same length as chunk provided by source */
@@ -347,8 +357,28 @@ static void source_output_push_cb(pa_source_output *o, const pa_memchunk *chunk)
         /* forward the data to the virtual source */
         pa_source_post(u->source, chunk);
     }
+}
 
+/* Called from input thread context */
+static void source_output_push_cb(pa_source_output *o, const pa_memchunk *chunk) {
+    struct userdata *u;
+    pa_memchunk fchunk;
 
+    pa_source_output_assert_ref(o);
+    pa_source_output_assert_io_context(o);
+    pa_assert_se(u = o->userdata);
+
+    if (!PA_SOURCE_OUTPUT_IS_LINKED(pa_source_output_get_state(u->source_output))) {
+        pa_log("push when no link?");
+        return;
+    }
+
+    pa_block_filter_push(u->filter, chunk);
+
+    while (pa_block_filter_pull(u->filter, &fchunk) >= 0) {
+        post_chunk(u, o, &fchunk);
+        pa_memblock_unref(fchunk.memblock);
+    }
 }
 
 /* Called from input thread context */
@@ -384,7 +414,7 @@ static void source_output_attach_cb(pa_source_output *o) {
 
     pa_source_set_rtpoll(u->source, o->source->thread_info.rtpoll);
     pa_source_set_latency_range_within_thread(u->source, o->source->thread_info.min_latency, o->source->thread_info.max_latency);
-    pa_source_set_fixed_latency_within_thread(u->source, o->source->thread_info.fixed_latency);
+    pa_source_set_fixed_latency_within_thread(u->source, o->source->thread_info.fixed_latency + pa_block_filter_get_latency(u->filter));
     pa_source_set_max_rewind_within_thread(u->source, pa_source_output_get_max_rewind(o));
 
     pa_source_attach_within_thread(u->source);
@@ -526,6 +556,11 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    if (ss.format != PA_SAMPLE_FLOAT32NE) {
+        pa_log("The filter only works on native endian float samples");
+        goto fail;
+    }
+
     if (pa_modargs_get_value_boolean(ma, "use_volume_sharing", &use_volume_sharing) < 0) {
         pa_log("use_volume_sharing= expects a boolean argument");
         goto fail;
@@ -548,11 +583,9 @@ int pa__init(pa_module*m) {
     }
     u->module = m;
     m->userdata = u;
-    u->memblockq = pa_memblockq_new("module-virtual-source memblockq", 0, MEMBLOCKQ_MAXLENGTH, 0, &ss, 1, 1, 0, NULL);
-    if (!u->memblockq) {
-        pa_log("Failed to create source memblockq.");
-        goto fail;
-    }
+    u->filter = pa_block_filter_new(m->core, "module-virtual-source filter", &ss, &ss, BLOCK_FRAMES, filter_cb, NULL, u);
+    /* The example filter has no memory, see pa_block_filter_set_tail() */
+    pa_block_filter_set_tail(u->filter, 0);
     u->channels = ss.channels;
 
     /* Create source */
@@ -743,8 +776,8 @@ void pa__done(pa_module*m) {
     if (u->sink)
         pa_sink_unref(u->sink);
 
-    if (u->memblockq)
-        pa_memblockq_free(u->memblockq);
+    if (u->filter)
+        pa_block_filter_free(u->filter);
 
     if (u->sink_memblockq)
         pa_memblockq_free(u->sink_memblockq);
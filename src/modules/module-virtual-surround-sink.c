@@ -40,9 +40,14 @@
 #include <pulsecore/ltdl-helper.h>
 #include <pulsecore/sound-file.h>
 #include <pulsecore/resampler.h>
+#include <pulsecore/dsp-worker.h>
 
 #include <math.h>
 
+#ifdef HAVE_FFTW
+#include "convolver.h"
+#endif
+
 #include "module-virtual-surround-sink-symdef.h"
 
 PA_MODULE_AUTHOR("Niels Ole Salscheider");
@@ -60,10 +65,18 @@ PA_MODULE_USAGE(
           "use_volume_sharing=<yes or no> "
           "force_flat_volume=<yes or no> "
           "hrir=/path/to/left_hrir.wav "
+          "dsp_thread=<filter in a separate thread, adding one block of latency?> "
+          "realtime_priority=<priority of the DSP thread> "
+          "cpu_affinity=<CPUs to run the DSP thread on> "
         ));
 
 #define MEMBLOCKQ_MAXLENGTH (16*1024*1024)
 
+/* HRIRs longer than this are convolved via FFT, in blocks of at most
+ * CONVOLVER_BLOCK_MSEC */
+#define CONVOLVER_MIN_HRIR_SAMPLES 64
+#define CONVOLVER_BLOCK_MSEC 5
+
 struct userdata {
     pa_module *module;
 
@@ -89,6 +102,24 @@ struct userdata {
 
     float *input_buffer;
     int input_buffer_offset;
+
+#ifdef HAVE_FFTW
+    /* For long HRIRs, one partitioned filter per HRIR channel and the
+     * interleaved result of the last block, which is played while the
+     * next block is gathered */
+    pa_convolver *convolver;
+    fftwf_complex **hrir_filters;
+    float *convolver_output;
+    size_t convolver_pos;
+#endif
+
+    /* Filtering one block behind the rendering, see dsp_thread= */
+    pa_dsp_worker *dsp_worker;
+    pa_memchunk pending;
+
+    /* After tail_frames of silent input everything the filter keeps
+     * is zero, so silence can be passed on without folding it */
+    uint64_t tail_frames, silent_frames;
 };
 
 static const char* const valid_modargs[] = {
@@ -102,9 +133,37 @@ static const char* const valid_modargs[] = {
     "use_volume_sharing",
     "force_flat_volume",
     "hrir",
+    "dsp_thread",
+    "realtime_priority",
+    "cpu_affinity",
     NULL
 };
 
+/* Called from I/O thread context. Returns the length in the sample
+ * spec of our sink. */
+static size_t get_convolver_delay(struct userdata *u) {
+
+#ifdef HAVE_FFTW
+    if (u->convolver)
+        return pa_convolver_get_block_size(u->convolver) * u->sink_fs;
+#endif
+
+    return 0;
+}
+
+/* Called from I/O thread context. Returns the length in the sample
+ * spec of our sink. */
+static size_t get_pipeline_length(struct userdata *u) {
+
+    if (!u->dsp_worker)
+        return 0;
+
+    if (u->pending.memblock)
+        return u->pending.length / u->fs * u->sink_fs;
+
+    return pa_dsp_worker_get_length(u->dsp_worker);
+}
+
 /* Called from I/O thread context */
 static int sink_process_msg_cb(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
     struct userdata *u = PA_SINK(o)->userdata;
@@ -128,7 +187,13 @@ static int sink_process_msg_cb(pa_msgobject *o, int code, void *data, int64_t of
                 pa_sink_get_latency_within_thread(u->sink_input->sink) +
 
                 /* Add the latency internal to our sink input on top */
-                pa_bytes_to_usec(pa_memblockq_get_length(u->sink_input->thread_info.render_memblockq), &u->sink_input->sink->sample_spec);
+                pa_bytes_to_usec(pa_memblockq_get_length(u->sink_input->thread_info.render_memblockq), &u->sink_input->sink->sample_spec) +
+
+                /* And the block in the DSP thread */
+                pa_bytes_to_usec(get_pipeline_length(u), &u->sink->sample_spec) +
+
+                /* And the one the convolver holds back */
+                pa_bytes_to_usec(get_convolver_delay(u), &u->sink->sample_spec);
 
             return 0;
     }
@@ -165,7 +230,8 @@ static void sink_request_rewind_cb(pa_sink *s) {
     /* Just hand this one over to the master sink */
     pa_sink_input_request_rewind(u->sink_input,
                                  s->thread_info.rewind_nbytes +
-                                 pa_memblockq_get_length(u->memblockq), TRUE, FALSE, FALSE);
+                                 pa_memblockq_get_length(u->memblockq) +
+                                 get_pipeline_length(u), TRUE, FALSE, FALSE);
 }
 
 /* Called from I/O thread context */
@@ -214,24 +280,9 @@ static void sink_set_mute_cb(pa_sink *s) {
 }
 
 /* Called from I/O thread context */
-static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk) {
-    struct userdata *u;
-    float *src, *dst;
-    unsigned n;
-    pa_memchunk tchunk;
-
-    unsigned j, k, l;
-    float sum_right, sum_left;
-    float current_sample;
-
-    pa_sink_input_assert_ref(i);
-    pa_assert(chunk);
-    pa_assert_se(u = i->userdata);
-
-    /* Hmm, process any rewind request that might be queued up */
-    pa_sink_process_rewind(u->sink, 0);
+static void render_block(struct userdata *u, size_t nbytes, pa_memchunk *chunk) {
 
-    while (pa_memblockq_peek(u->memblockq, &tchunk) < 0) {
+    while (pa_memblockq_peek(u->memblockq, chunk) < 0) {
         pa_memchunk nchunk;
 
         pa_sink_render(u->sink, nbytes * u->sink_fs / u->fs, &nchunk);
@@ -239,21 +290,102 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
         pa_memblock_unref(nchunk.memblock);
     }
 
-    tchunk.length = PA_MIN(nbytes * u->sink_fs / u->fs, tchunk.length);
-    pa_assert(tchunk.length > 0);
+    chunk->length = PA_MIN(nbytes * u->sink_fs / u->fs, chunk->length);
+    chunk->length = chunk->length / u->sink_fs * u->sink_fs;
+    pa_assert(chunk->length > 0);
+
+    pa_memblockq_drop(u->memblockq, chunk->length);
+}
+
+#ifdef HAVE_FFTW
+/* Called from I/O thread context, or from the DSP thread. Delays the
+ * output by one block of the convolver. */
+static void convolve(struct userdata *u, const float *src, float *dst, unsigned n) {
+    const size_t block_size = pa_convolver_get_block_size(u->convolver);
+    unsigned k;
+
+    while (n > 0) {
+        size_t l = PA_MIN(n, block_size - u->convolver_pos);
+
+        for (k = 0; k < u->channels; k++)
+            pa_sample_clamp(PA_SAMPLE_FLOAT32NE, pa_convolver_get_input(u->convolver, k) + u->convolver_pos, sizeof(float),
+                            src + k, u->sink_fs, l);
+        memcpy(dst, u->convolver_output + 2 * u->convolver_pos, l * u->fs);
+
+        src += l * u->channels;
+        dst += l * 2;
+        n -= l;
+        u->convolver_pos += l;
+
+        if (u->convolver_pos < block_size)
+            break;
+
+        pa_convolver_transform(u->convolver);
+        for (k = 0; k < u->channels; k++) {
+            pa_convolver_accumulate(u->convolver, 0, k, u->hrir_filters[u->mapping_left[k]]);
+            pa_convolver_accumulate(u->convolver, 1, k, u->hrir_filters[u->mapping_right[k]]);
+        }
+        pa_convolver_finish(u->convolver);
+
+        for (k = 0; k < 2; k++)
+            pa_sample_clamp(PA_SAMPLE_FLOAT32NE, u->convolver_output + k, 2 * sizeof(float),
+                            pa_convolver_get_output(u->convolver, k), sizeof(float), block_size);
+        u->convolver_pos = 0;
+    }
+}
+#endif
 
-    n = (unsigned) (tchunk.length / u->sink_fs);
+/* Called from I/O thread context */
+static void reset_filter(struct userdata *u) {
+
+#ifdef HAVE_FFTW
+    if (u->convolver) {
+        pa_convolver_reset(u->convolver);
+        memset(u->convolver_output, 0, pa_convolver_get_block_size(u->convolver) * u->fs);
+        u->convolver_pos = 0;
+        u->silent_frames = 0;
+        return;
+    }
+#endif
 
-    pa_assert(n > 0);
+    memset(u->input_buffer, 0, u->hrir_samples * u->sink_fs);
+    u->input_buffer_offset = 0;
+    u->silent_frames = 0;
+}
 
-    chunk->index = 0;
-    chunk->length = n * u->fs;
-    chunk->memblock = pa_memblock_new(i->sink->core->mempool, chunk->length);
+/* Called from I/O thread context, or from the DSP thread */
+static void process_block(void *userdata, const pa_memchunk *in, pa_memchunk *out) {
+    struct userdata *u = userdata;
+    float *src, *dst;
+    unsigned n;
 
-    pa_memblockq_drop(u->memblockq, n * u->sink_fs);
+    unsigned j, k, l;
+    float sum_right, sum_left;
+    float current_sample;
 
-    src = (float*) ((uint8_t*) pa_memblock_acquire(tchunk.memblock) + tchunk.index);
-    dst = (float*) pa_memblock_acquire(chunk->memblock);
+    n = (unsigned) (in->length / u->sink_fs);
+
+    if (!pa_memblock_is_silence(in->memblock))
+        u->silent_frames = 0;
+    else if (u->silent_frames >= u->tail_frames) {
+        pa_silence_memchunk_get_full(&u->module->core->silence_cache, u->module->core->mempool, out, &u->sink_input->sample_spec, n * u->fs);
+        return;
+    } else
+        u->silent_frames += n;
+
+    out->index = 0;
+    out->length = n * u->fs;
+    out->memblock = pa_memblock_new(u->module->core->mempool, out->length);
+
+    src = (float*) ((uint8_t*) pa_memblock_acquire(in->memblock) + in->index);
+    dst = (float*) pa_memblock_acquire(out->memblock);
+
+#ifdef HAVE_FFTW
+    if (u->convolver) {
+        convolve(u, src, dst, n);
+        n = 0;
+    }
+#endif
 
     for (l = 0; l < n; l++) {
         memcpy(((char*) u->input_buffer) + u->input_buffer_offset * u->sink_fs, ((char *) src) + l * u->sink_fs, u->sink_fs);
@@ -279,14 +411,57 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
             u->input_buffer_offset += u->hrir_samples;
     }
 
-    pa_memblock_release(tchunk.memblock);
-    pa_memblock_release(chunk->memblock);
+    pa_memblock_release(in->memblock);
+    pa_memblock_release(out->memblock);
+}
+
+/* Called from I/O thread context */
+static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk) {
+    struct userdata *u;
+    pa_memchunk tchunk;
+
+    pa_sink_input_assert_ref(i);
+    pa_assert(chunk);
+    pa_assert_se(u = i->userdata);
+
+    /* Hmm, process any rewind request that might be queued up */
+    pa_sink_process_rewind(u->sink, 0);
+
+    if (u->dsp_worker && u->pending.memblock) {
+        *chunk = u->pending;
+        pa_memchunk_reset(&u->pending);
+
+    } else if (!u->dsp_worker || pa_dsp_worker_collect(u->dsp_worker, chunk) < 0) {
+        render_block(u, nbytes, &tchunk);
+        process_block(u, &tchunk, chunk);
+        pa_memblock_unref(tchunk.memblock);
+    }
 
-    pa_memblock_unref(tchunk.memblock);
+    if (u->dsp_worker) {
+        render_block(u, nbytes, &tchunk);
+        pa_dsp_worker_submit(u->dsp_worker, &tchunk);
+        pa_memblock_unref(tchunk.memblock);
+    }
 
     return 0;
 }
 
+/* Called from I/O thread context */
+static void flush_pipeline(struct userdata *u, pa_bool_t rewrite) {
+
+    if (!u->pending.memblock && pa_dsp_worker_collect(u->dsp_worker, &u->pending) < 0)
+        return;
+
+    if (!rewrite)
+        return;
+
+    /* The input of the block goes back into the queue to be filtered
+     * again once the rewind is done */
+    pa_memblockq_rewind(u->memblockq, u->pending.length / u->fs * u->sink_fs);
+    pa_memblock_unref(u->pending.memblock);
+    pa_memchunk_reset(&u->pending);
+}
+
 /* Called from I/O thread context */
 static void sink_input_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
     struct userdata *u;
@@ -295,6 +470,9 @@ static void sink_input_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
     pa_sink_input_assert_ref(i);
     pa_assert_se(u = i->userdata);
 
+    if (u->dsp_worker)
+        flush_pipeline(u, nbytes > 0 || u->sink->thread_info.rewind_nbytes > 0);
+
     if (u->sink->thread_info.rewind_nbytes > 0) {
         size_t max_rewrite;
 
@@ -306,8 +484,7 @@ static void sink_input_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
             pa_memblockq_seek(u->memblockq, - (int64_t) amount, PA_SEEK_RELATIVE, TRUE);
 
             /* Reset the input buffer */
-            memset(u->input_buffer, 0, u->hrir_samples * u->sink_fs);
-            u->input_buffer_offset = 0;
+            reset_filter(u);
         }
     }
 
@@ -322,7 +499,10 @@ static void sink_input_update_max_rewind_cb(pa_sink_input *i, size_t nbytes) {
     pa_sink_input_assert_ref(i);
     pa_assert_se(u = i->userdata);
 
-    pa_memblockq_set_maxrewind(u->memblockq, nbytes * u->sink_fs / u->fs);
+    /* Leave room for handing the block in flight back, it is at most
+     * as long as pa_sink_render() returns */
+    pa_memblockq_set_maxrewind(u->memblockq, nbytes * u->sink_fs / u->fs +
+                               (u->dsp_worker ? pa_mempool_block_size_max(u->module->core->mempool) : 0));
     pa_sink_set_max_rewind_within_thread(u->sink, nbytes * u->sink_fs / u->fs);
 }
 
@@ -534,6 +714,9 @@ int pa__init(pa_module*m) {
     pa_sink_new_data sink_data;
     pa_bool_t use_volume_sharing = TRUE;
     pa_bool_t force_flat_volume = FALSE;
+    pa_bool_t dsp_thread = FALSE;
+    int32_t rtprio = -1;
+    char *cpu_affinity = NULL;
     pa_memchunk silence;
 
     const char *hrir_file;
@@ -613,6 +796,16 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    if (pa_modargs_get_value_boolean(ma, "dsp_thread", &dsp_thread) < 0) {
+        pa_log("dsp_thread= expects a boolean argument");
+        goto fail;
+    }
+
+    if (pa_modargs_get_io_thread_args(ma, &rtprio, &cpu_affinity) < 0) {
+        pa_log("Failed to parse realtime_priority= or cpu_affinity= argument");
+        goto fail;
+    }
+
     /* sample spec / map of sink input */
     pa_channel_map_init_stereo(&sink_input_map);
     sink_input_ss.channels = 2;
@@ -712,7 +905,7 @@ int pa__init(pa_module*m) {
     pa_memblock_unref(silence.memblock);
 
     /* resample hrir */
-    resampler = pa_resampler_new(u->sink->core->mempool, &hrir_temp_ss, &hrir_map, &hrir_ss, &hrir_map,
+    resampler = pa_resampler_new(u->sink->core->mempool, u->sink->core->resampler_cache, &hrir_temp_ss, &hrir_map, &hrir_ss, &hrir_map,
                                  PA_RESAMPLER_SRC_SINC_BEST_QUALITY, PA_RESAMPLER_NO_REMAP);
     pa_resampler_run(resampler, &hrir_temp_chunk, &hrir_temp_chunk);
     pa_resampler_free(resampler);
@@ -781,11 +974,43 @@ int pa__init(pa_module*m) {
 
     u->input_buffer = pa_xmalloc0(u->hrir_samples * u->sink_fs);
     u->input_buffer_offset = 0;
+    u->tail_frames = u->hrir_samples;
+
+#ifdef HAVE_FFTW
+    /* The direct convolution costs hrir_samples multiplications per
+     * sample, the FFT one only grows with the number of partitions */
+    if (u->hrir_samples > CONVOLVER_MIN_HRIR_SAMPLES) {
+        size_t block_size = 1, n_partitions;
+
+        while (block_size < u->hrir_samples && block_size * 2 <= ss.rate * CONVOLVER_BLOCK_MSEC / 1000)
+            block_size *= 2;
+        n_partitions = (u->hrir_samples + block_size - 1) / block_size;
+
+        pa_log_debug("Convolving %u HRIR samples via FFT in %zu partitions of %zu samples",
+                     u->hrir_samples, n_partitions, block_size);
+
+        u->convolver = pa_convolver_new(block_size, n_partitions, u->channels, 2);
+        u->hrir_filters = pa_xnew0(fftwf_complex *, u->hrir_channels);
+        for (i = 0; i < u->hrir_channels; i++) {
+            u->hrir_filters[i] = pa_convolver_new_filter(u->convolver);
+            pa_convolver_partition(u->convolver, u->hrir_data + i, u->hrir_samples, u->hrir_channels, u->hrir_filters[i]);
+        }
+        u->convolver_output = pa_xnew0(float, 2 * block_size);
+
+        /* A gathered block and the one being played back */
+        u->tail_frames += 2 * block_size;
+    }
+#endif
+
+    if (dsp_thread &&
+        !(u->dsp_worker = pa_dsp_worker_new(m->core, "surround-dsp", rtprio, cpu_affinity, process_block, u)))
+        goto fail;
 
     pa_sink_put(u->sink);
     pa_sink_input_put(u->sink_input);
 
     pa_modargs_free(ma);
+    pa_xfree(cpu_affinity);
     return 0;
 
 fail:
@@ -795,6 +1020,8 @@ fail:
     if (ma)
         pa_modargs_free(ma);
 
+    pa_xfree(cpu_affinity);
+
     pa__done(m);
 
     return -1;
@@ -811,6 +1038,9 @@ int pa__get_n_used(pa_module *m) {
 
 void pa__done(pa_module*m) {
     struct userdata *u;
+#ifdef HAVE_FFTW
+    unsigned i;
+#endif
 
     pa_assert(m);
 
@@ -832,6 +1062,12 @@ void pa__done(pa_module*m) {
     if (u->sink)
         pa_sink_unref(u->sink);
 
+    if (u->dsp_worker)
+        pa_dsp_worker_free(u->dsp_worker);
+
+    if (u->pending.memblock)
+        pa_memblock_unref(u->pending.memblock);
+
     if (u->memblockq)
         pa_memblockq_free(u->memblockq);
 
@@ -841,6 +1077,20 @@ void pa__done(pa_module*m) {
     if (u->input_buffer)
         pa_xfree(u->input_buffer);
 
+#ifdef HAVE_FFTW
+    if (u->hrir_filters) {
+        for (i = 0; i < u->hrir_channels; i++)
+            if (u->hrir_filters[i])
+                fftwf_free(u->hrir_filters[i]);
+        pa_xfree(u->hrir_filters);
+    }
+
+    if (u->convolver)
+        pa_convolver_free(u->convolver);
+
+    pa_xfree(u->convolver_output);
+#endif
+
     if (u->mapping_left)
         pa_xfree(u->mapping_left);
     if (u->mapping_right)
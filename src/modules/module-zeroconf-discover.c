@@ -50,11 +50,19 @@ PA_MODULE_AUTHOR("Lennart Poettering");
 PA_MODULE_DESCRIPTION("mDNS/DNS-SD Service Discovery");
 PA_MODULE_VERSION(PACKAGE_VERSION);
 PA_MODULE_LOAD_ONCE(TRUE);
+PA_MODULE_USAGE(
+        "on_demand=<connect the tunnels only while they are used?> "
+        "idle_time=<seconds to keep unused tunnels connected>");
 
 #define SERVICE_TYPE_SINK "_pulse-sink._tcp"
 #define SERVICE_TYPE_SOURCE "_non-monitor._sub._pulse-source._tcp"
 
+/* Seconds an unused tunnel stays connected */
+#define DEFAULT_IDLE_TIME 30
+
 static const char* const valid_modargs[] = {
+    "on_demand",
+    "idle_time",
     NULL
 };
 
@@ -72,6 +80,11 @@ struct userdata {
     AvahiClient *client;
     AvahiServiceBrowser *source_browser, *sink_browser;
 
+    /* Connecting to everything that is announced doesn't scale, so by
+     * default the tunnels are only placeholders until they are used */
+    pa_bool_t on_demand;
+    uint32_t idle_time;
+
     pa_hashmap *tunnels;
 };
 
@@ -218,14 +231,18 @@ static void resolver_cb(
                                  "channels=%u "
                                  "rate=%u "
                                  "%s_name=%s "
-                                 "channel_map=%s",
+                                 "channel_map=%s "
+                                 "on_demand=%s "
+                                 "idle_time=%u",
                                  avahi_address_snprint(at, sizeof(at), a), port,
                                  t, device,
                                  pa_sample_format_to_string(ss.format),
                                  ss.channels,
                                  ss.rate,
                                  t, dname,
-                                 pa_channel_map_snprint(cmt, sizeof(cmt), &cm));
+                                 pa_channel_map_snprint(cmt, sizeof(cmt), &cm),
+                                 pa_yes_no(u->on_demand),
+                                 u->idle_time);
 
         pa_log_debug("Loading %s with arguments '%s'", module_name, args);
 
@@ -378,11 +395,23 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
-    m->userdata = u = pa_xnew(struct userdata, 1);
+    m->userdata = u = pa_xnew0(struct userdata, 1);
     u->core = m->core;
     u->module = m;
     u->sink_browser = u->source_browser = NULL;
 
+    u->on_demand = TRUE;
+    if (pa_modargs_get_value_boolean(ma, "on_demand", &u->on_demand) < 0) {
+        pa_log("Failed to parse on_demand argument.");
+        goto fail;
+    }
+
+    u->idle_time = DEFAULT_IDLE_TIME;
+    if (pa_modargs_get_value_u32(ma, "idle_time", &u->idle_time) < 0) {
+        pa_log("Failed to parse idle_time argument.");
+        goto fail;
+    }
+
     u->tunnels = pa_hashmap_new(tunnel_hash, tunnel_compare);
 
     u->avahi_poll = pa_avahi_poll_new(m->core->mainloop);
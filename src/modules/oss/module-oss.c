@@ -50,6 +50,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 
+#include <pulse/rtclock.h>
 #include <pulse/xmalloc.h>
 #include <pulse/util.h>
 
@@ -66,6 +67,7 @@
 #include <pulsecore/thread-mq.h>
 #include <pulsecore/rtpoll.h>
 #include <pulsecore/poll.h>
+#include <pulsecore/time-smoother.h>
 
 #if defined(__NetBSD__) && !defined(SNDCTL_DSP_GETODELAY)
 #include <sys/audioio.h>
@@ -93,13 +95,34 @@ PA_MODULE_USAGE(
         "channel_map=<channel map> "
         "fragments=<number of fragments> "
         "fragment_size=<fragment size> "
-        "mmap=<enable memory mapping?>");
+        "mmap=<enable memory mapping?> "
+        "tsched=<enable system timer based scheduling mode?> "
+        "tsched_buffer_size=<buffer size when using timer based scheduling> "
+        "tsched_buffer_watermark=<lower fill watermark>");
 #ifdef __linux__
 PA_MODULE_DEPRECATED("Please use module-alsa-card instead of module-oss!");
 #endif
 
 #define DEFAULT_DEVICE "/dev/dsp"
 
+#define DEFAULT_TSCHED_BUFFER_USEC (2*PA_USEC_PER_SEC)             /* 2s    -- Overall buffer size */
+#define DEFAULT_TSCHED_WATERMARK_USEC (20*PA_USEC_PER_MSEC)        /* 20ms  -- Fill up when only this much is left in the buffer */
+#define TSCHED_FRAGMENT_USEC (10*PA_USEC_PER_MSEC)                 /* 10ms  -- Fragment size, which is how often the driver updates the delay */
+
+#define TSCHED_WATERMARK_INC_STEP_USEC (10*PA_USEC_PER_MSEC)       /* 10ms  -- On underrun, increase watermark by this */
+#define TSCHED_WATERMARK_DEC_STEP_USEC (5*PA_USEC_PER_MSEC)        /* 5ms   -- When everything's great, decrease watermark by this */
+#define TSCHED_WATERMARK_VERIFY_AFTER_USEC (20*PA_USEC_PER_SEC)    /* 20s   -- How long after a drop out recheck if things are good now */
+#define TSCHED_WATERMARK_DEC_THRESHOLD_USEC (100*PA_USEC_PER_MSEC) /* 100ms -- If the buffer level didn't drop below this threshold in the verification time, decrease the watermark */
+
+#define TSCHED_MIN_SLEEP_USEC (10*PA_USEC_PER_MSEC)                /* 10ms  -- Sleep at least 10ms on each iteration */
+#define TSCHED_MIN_WAKEUP_USEC (4*PA_USEC_PER_MSEC)                /* 4ms   -- Wakeup at least this long before the buffer runs empty*/
+
+#define SMOOTHER_WINDOW_USEC  (10*PA_USEC_PER_SEC)                 /* 10s   -- smoother windows size */
+#define SMOOTHER_ADJUST_USEC  (1*PA_USEC_PER_SEC)                  /* 1s    -- smoother adjust time */
+
+#define SMOOTHER_MIN_INTERVAL (2*PA_USEC_PER_MSEC)                 /* 2ms   -- min smoother update interval */
+#define SMOOTHER_MAX_INTERVAL (200*PA_USEC_PER_MSEC)               /* 200ms -- max smoother update interval */
+
 struct userdata {
     pa_core *core;
     pa_module *module;
@@ -137,6 +160,20 @@ struct userdata {
     int in_mmap_saved_nfrags, out_mmap_saved_nfrags;
 
     pa_rtpoll_item *rtpoll_item;
+
+    /* Timer based scheduling of the playback, the position comes from
+     * SNDCTL_DSP_GETODELAY */
+    pa_bool_t use_tsched;
+    pa_bool_t first;
+    size_t hwbuf_unused;
+    size_t tsched_watermark, min_sleep, min_wakeup;
+    size_t watermark_inc_step, watermark_dec_step, watermark_dec_threshold;
+    pa_usec_t watermark_dec_not_before;
+    uint64_t write_count;
+
+    pa_smoother *smoother;
+    pa_usec_t smoother_interval;
+    pa_usec_t last_smoother_update;
 };
 
 static const char* const valid_modargs[] = {
@@ -154,6 +191,9 @@ static const char* const valid_modargs[] = {
     "channels",
     "channel_map",
     "mmap",
+    "tsched",
+    "tsched_buffer_size",
+    "tsched_buffer_watermark",
     NULL
 };
 
@@ -400,6 +440,370 @@ static pa_usec_t mmap_source_get_latency(struct userdata *u) {
     return pa_bytes_to_usec(n, &u->source->sample_spec);
 }
 
+static void fix_min_sleep_wakeup(struct userdata *u) {
+    size_t max_use, max_use_2;
+
+    pa_assert(u);
+    pa_assert(u->use_tsched);
+
+    max_use = u->out_hwbuf_size - u->hwbuf_unused;
+    max_use_2 = pa_frame_align(max_use/2, &u->sink->sample_spec);
+
+    u->min_sleep = pa_usec_to_bytes(TSCHED_MIN_SLEEP_USEC, &u->sink->sample_spec);
+    u->min_sleep = PA_CLAMP(u->min_sleep, u->frame_size, max_use_2);
+
+    u->min_wakeup = pa_usec_to_bytes(TSCHED_MIN_WAKEUP_USEC, &u->sink->sample_spec);
+    u->min_wakeup = PA_CLAMP(u->min_wakeup, u->frame_size, max_use_2);
+}
+
+static void fix_tsched_watermark(struct userdata *u) {
+    size_t max_use;
+
+    pa_assert(u);
+    pa_assert(u->use_tsched);
+
+    max_use = u->out_hwbuf_size - u->hwbuf_unused;
+
+    if (u->tsched_watermark > max_use - u->min_sleep)
+        u->tsched_watermark = max_use - u->min_sleep;
+
+    if (u->tsched_watermark < u->min_wakeup)
+        u->tsched_watermark = u->min_wakeup;
+}
+
+static void increase_watermark(struct userdata *u) {
+    size_t old_watermark;
+    pa_usec_t old_min_latency, new_min_latency;
+
+    pa_assert(u);
+    pa_assert(u->use_tsched);
+
+    /* First, just try to increase the watermark */
+    old_watermark = u->tsched_watermark;
+    u->tsched_watermark = PA_MIN(u->tsched_watermark * 2, u->tsched_watermark + u->watermark_inc_step);
+    fix_tsched_watermark(u);
+
+    if (old_watermark != u->tsched_watermark) {
+        pa_log_info("Increasing wakeup watermark to %0.2f ms",
+                    (double) pa_bytes_to_usec(u->tsched_watermark, &u->sink->sample_spec) / PA_USEC_PER_MSEC);
+        return;
+    }
+
+    /* Hmm, we cannot increase the watermark any further, hence let's
+       raise the latency */
+    old_min_latency = u->sink->thread_info.min_latency;
+    new_min_latency = PA_MIN(old_min_latency * 2, old_min_latency + TSCHED_WATERMARK_INC_STEP_USEC);
+    new_min_latency = PA_MIN(new_min_latency, u->sink->thread_info.max_latency);
+
+    if (old_min_latency != new_min_latency) {
+        pa_log_info("Increasing minimal latency to %0.2f ms",
+                    (double) new_min_latency / PA_USEC_PER_MSEC);
+
+        pa_sink_set_latency_range_within_thread(u->sink, new_min_latency, u->sink->thread_info.max_latency);
+    }
+}
+
+static void decrease_watermark(struct userdata *u) {
+    size_t old_watermark;
+    pa_usec_t now;
+
+    pa_assert(u);
+    pa_assert(u->use_tsched);
+
+    now = pa_rtpoll_now(u->rtpoll);
+
+    if (u->watermark_dec_not_before <= 0)
+        goto restart;
+
+    if (u->watermark_dec_not_before > now)
+        return;
+
+    old_watermark = u->tsched_watermark;
+
+    if (u->tsched_watermark < u->watermark_dec_step)
+        u->tsched_watermark = u->tsched_watermark / 2;
+    else
+        u->tsched_watermark = PA_MAX(u->tsched_watermark / 2, u->tsched_watermark - u->watermark_dec_step);
+
+    fix_tsched_watermark(u);
+
+    if (old_watermark != u->tsched_watermark)
+        pa_log_info("Decreasing wakeup watermark to %0.2f ms",
+                    (double) pa_bytes_to_usec(u->tsched_watermark, &u->sink->sample_spec) / PA_USEC_PER_MSEC);
+
+    /* We don't change the latency range*/
+
+restart:
+    u->watermark_dec_not_before = now + TSCHED_WATERMARK_VERIFY_AFTER_USEC;
+}
+
+static void hw_sleep_time(struct userdata *u, pa_usec_t *sleep_usec, pa_usec_t *process_usec) {
+    pa_usec_t usec, wm;
+
+    pa_assert(u);
+    pa_assert(u->use_tsched);
+    pa_assert(sleep_usec);
+    pa_assert(process_usec);
+
+    usec = pa_sink_get_requested_latency_within_thread(u->sink);
+
+    if (usec == (pa_usec_t) -1)
+        usec = pa_bytes_to_usec(u->out_hwbuf_size, &u->sink->sample_spec);
+
+    wm = pa_bytes_to_usec(u->tsched_watermark, &u->sink->sample_spec);
+
+    if (wm > usec)
+        wm = usec/2;
+
+    *sleep_usec = usec - wm;
+    *process_usec = wm;
+}
+
+/* Called from IO context */
+static void check_left_to_play(struct userdata *u, size_t left_to_play, pa_bool_t on_timeout) {
+    pa_bool_t reset_not_before = TRUE;
+
+    pa_assert(u);
+    pa_assert(u->use_tsched);
+
+    /* OSS doesn't tell us about underruns, but the queue only runs
+     * empty if we didn't refill it in time */
+    if (!u->first) {
+        if (left_to_play <= 0) {
+            pa_atomic_inc(&u->sink->thread_info.stats.underruns);
+
+            if (pa_log_ratelimit(PA_LOG_INFO))
+                pa_log_info("Underrun!");
+
+            increase_watermark(u);
+
+            /* The device stopped, so does the position until we
+             * have written something again */
+            pa_smoother_pause(u->smoother, pa_rtclock_now());
+            u->first = TRUE;
+
+        } else if (left_to_play > u->watermark_dec_threshold) {
+            reset_not_before = FALSE;
+
+            /* We decrease the watermark only if have actually been
+             * woken up by a timeout. If something else woke us up
+             * it's too easy to fulfill the deadlines... */
+            if (on_timeout)
+                decrease_watermark(u);
+        }
+    }
+
+    if (reset_not_before)
+        u->watermark_dec_not_before = 0;
+}
+
+/* Called from IO context */
+static int get_odelay(struct userdata *u, size_t *delay) {
+    int arg;
+
+    pa_assert(u);
+    pa_assert(delay);
+
+    if (ioctl(u->fd, SNDCTL_DSP_GETODELAY, &arg) < 0) {
+        pa_log("SNDCTL_DSP_GETODELAY: %s", pa_cstrerror(errno));
+        return -1;
+    }
+
+    *delay = arg > 0 ? (size_t) arg : 0;
+    return 0;
+}
+
+/* Called from IO context. Fills the buffer up to the requested latency
+ * and returns in sleep_usec when the watermark will be reached, in
+ * sound card time. */
+static int tsched_write(struct userdata *u, pa_usec_t *sleep_usec, pa_bool_t on_timeout) {
+    pa_usec_t max_sleep_usec, process_usec;
+    size_t left_to_play = 0;
+    pa_bool_t work_done = FALSE;
+    unsigned j = 0;
+
+    pa_assert(u);
+    pa_assert(u->use_tsched);
+
+    hw_sleep_time(u, &max_sleep_usec, &process_usec);
+
+    for (;;) {
+        size_t n_bytes, max_use;
+
+        if (get_odelay(u, &left_to_play) < 0)
+            return -1;
+
+        check_left_to_play(u, left_to_play, on_timeout);
+        on_timeout = FALSE;
+
+        /* We won't fill up the playback buffer before at least half
+         * the sleep time is over because otherwise we might ask for
+         * more data from the clients then they expect. We need to
+         * guarantee that clients only have to keep around a single
+         * hw buffer length. */
+        if (!u->first &&
+            pa_bytes_to_usec(left_to_play, &u->sink->sample_spec) > process_usec+max_sleep_usec/2)
+            break;
+
+        max_use = u->out_hwbuf_size - u->hwbuf_unused;
+
+        if (left_to_play + u->memchunk.length >= max_use)
+            break;
+
+        if (++j > 10)
+            break;
+
+        n_bytes = pa_frame_align(max_use - left_to_play - u->memchunk.length, &u->sink->sample_spec);
+
+        if (n_bytes <= 0)
+            break;
+
+        while (n_bytes > 0) {
+            void *p;
+            ssize_t t;
+
+            if (u->memchunk.length <= 0)
+                pa_sink_render(u->sink, n_bytes, &u->memchunk);
+
+            pa_assert(u->memchunk.length > 0);
+
+            p = pa_memblock_acquire(u->memchunk.memblock);
+            t = pa_write(u->fd, (uint8_t*) p + u->memchunk.index, PA_MIN(u->memchunk.length, n_bytes), NULL);
+            pa_memblock_release(u->memchunk.memblock);
+
+            if (t < 0) {
+
+                if (errno == EINTR)
+                    continue;
+
+                /* The device buffer is smaller than it claimed */
+                if (errno == EAGAIN)
+                    goto finish;
+
+                pa_log("Failed to write data to DSP: %s", pa_cstrerror(errno));
+                return -1;
+            }
+
+            pa_assert(t > 0);
+
+            u->memchunk.index += (size_t) t;
+            u->memchunk.length -= (size_t) t;
+
+            if (u->memchunk.length <= 0) {
+                pa_memblock_unref(u->memchunk.memblock);
+                pa_memchunk_reset(&u->memchunk);
+            }
+
+            u->write_count += (uint64_t) t;
+            n_bytes -= PA_MIN(n_bytes, (size_t) t);
+            work_done = TRUE;
+        }
+
+        if (u->first) {
+            pa_smoother_resume(u->smoother, pa_rtclock_now(), TRUE);
+            u->first = FALSE;
+        }
+    }
+
+finish:
+    *sleep_usec = pa_bytes_to_usec(left_to_play, &u->sink->sample_spec);
+    process_usec = pa_bytes_to_usec(u->tsched_watermark, &u->sink->sample_spec);
+
+    if (*sleep_usec > process_usec)
+        *sleep_usec -= process_usec;
+    else
+        *sleep_usec = 0;
+
+    return work_done ? 1 : 0;
+}
+
+/* Called from IO context */
+static void update_smoother(struct userdata *u) {
+    size_t delay;
+    int64_t position;
+    pa_usec_t now;
+
+    pa_assert(u);
+
+    now = pa_rtclock_now();
+
+    /* check if the time since the last update is bigger than the interval */
+    if (u->last_smoother_update > 0)
+        if (u->last_smoother_update + u->smoother_interval > now)
+            return;
+
+    if (get_odelay(u, &delay) < 0)
+        return;
+
+    position = (int64_t) u->write_count - (int64_t) delay;
+
+    if (PA_UNLIKELY(position < 0))
+        position = 0;
+
+    pa_smoother_put(u->smoother, now, pa_bytes_to_usec((uint64_t) position, &u->sink->sample_spec));
+
+    u->last_smoother_update = now;
+    /* exponentially increase the update interval up to the MAX limit */
+    u->smoother_interval = PA_MIN(u->smoother_interval * 2, SMOOTHER_MAX_INTERVAL);
+}
+
+static pa_usec_t tsched_sink_get_latency(struct userdata *u) {
+    int64_t delay;
+    pa_usec_t r;
+
+    pa_assert(u);
+
+    delay = (int64_t) pa_bytes_to_usec(u->write_count, &u->sink->sample_spec) - (int64_t) pa_smoother_get(u->smoother, pa_rtclock_now());
+    r = delay >= 0 ? (pa_usec_t) delay : 0;
+
+    if (u->memchunk.memblock)
+        r += pa_bytes_to_usec(u->memchunk.length, &u->sink->sample_spec);
+
+    return r;
+}
+
+/* Called from IO context */
+static void update_hwbuf_unused(struct userdata *u) {
+    pa_usec_t latency;
+
+    pa_assert(u);
+    pa_assert(u->use_tsched);
+
+    /* Use the full buffer if no one asked us for anything specific */
+    u->hwbuf_unused = 0;
+
+    if ((latency = pa_sink_get_requested_latency_within_thread(u->sink)) != (pa_usec_t) -1) {
+        size_t b;
+
+        pa_log_debug("Latency set to %0.2fms", (double) latency / PA_USEC_PER_MSEC);
+
+        b = pa_usec_to_bytes(latency, &u->sink->sample_spec);
+
+        /* We need at least one sample in our buffer */
+        if (PA_UNLIKELY(b < u->frame_size))
+            b = u->frame_size;
+
+        u->hwbuf_unused = PA_LIKELY(b < u->out_hwbuf_size) ? (u->out_hwbuf_size - b) : 0;
+    }
+
+    fix_min_sleep_wakeup(u);
+    fix_tsched_watermark(u);
+
+    pa_sink_set_max_request_within_thread(u->sink, u->out_hwbuf_size - u->hwbuf_unused);
+}
+
+/* Called from IO context. Data that has been written can't be taken
+ * back, so a lower latency takes effect only once the buffer has
+ * drained to it. */
+static void sink_update_requested_latency_cb(pa_sink *s) {
+    struct userdata *u = s->userdata;
+
+    pa_assert(u);
+    pa_assert(u->use_tsched);
+
+    update_hwbuf_unused(u);
+}
+
 static pa_usec_t io_sink_get_latency(struct userdata *u) {
     pa_usec_t r = 0;
 
@@ -648,7 +1052,9 @@ static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offse
             pa_usec_t r = 0;
 
             if (u->fd >= 0) {
-                if (u->use_mmap)
+                if (u->use_tsched)
+                    r = tsched_sink_get_latency(u);
+                else if (u->use_mmap)
                     r = mmap_sink_get_latency(u);
                 else
                     r = io_sink_get_latency(u);
@@ -673,6 +1079,9 @@ static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offse
 
                     do_trigger = TRUE;
 
+                    if (u->use_tsched)
+                        pa_smoother_pause(u->smoother, pa_rtclock_now());
+
                     u->sink_suspended = TRUE;
                     break;
 
@@ -697,6 +1106,14 @@ static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offse
                         u->out_mmap_current = 0;
                         u->out_mmap_saved_nfrags = 0;
 
+                        if (u->use_tsched) {
+                            u->write_count = 0;
+                            u->first = TRUE;
+                            u->smoother_interval = SMOOTHER_MIN_INTERVAL;
+                            u->last_smoother_update = 0;
+                            pa_smoother_reset(u->smoother, pa_rtclock_now(), TRUE);
+                        }
+
                         u->sink_suspended = FALSE;
                     }
 
@@ -881,13 +1298,13 @@ static void thread_func(void *userdata) {
 
     pa_log_debug("Thread starting up");
 
-    if (u->core->realtime_scheduling)
-        pa_make_realtime(u->core->realtime_priority);
+    pa_core_setup_io_thread(u->core, -1, NULL);
 
     pa_thread_mq_install(&u->thread_mq);
 
     for (;;) {
         int ret;
+        pa_usec_t rtpoll_sleep = 0;
 
 /*        pa_log("loop");    */
 
@@ -897,7 +1314,24 @@ static void thread_func(void *userdata) {
 
         /* Render some data and write it to the dsp */
 
-        if (u->sink && PA_SINK_IS_OPENED(u->sink->thread_info.state) && ((revents & POLLOUT) || u->use_mmap || u->use_getospace)) {
+        if (u->sink && PA_SINK_IS_OPENED(u->sink->thread_info.state) && u->use_tsched) {
+            pa_usec_t sleep_usec = 0, cusec;
+
+            if ((ret = tsched_write(u, &sleep_usec, pa_rtpoll_timer_elapsed(u->rtpoll))) < 0)
+                goto fail;
+
+            if (ret > 0)
+                update_smoother(u);
+
+            pa_sink_publish_latency_within_thread(u->sink);
+
+            /* Convert from the sound card time domain to the system
+             * time domain. We don't trust the conversion, so we wake
+             * up whatever comes first */
+            cusec = pa_smoother_translate(u->smoother, pa_rtpoll_now(u->rtpoll), sleep_usec);
+            rtpoll_sleep = PA_MIN(sleep_usec, cusec);
+
+        } else if (u->sink && PA_SINK_IS_OPENED(u->sink->thread_info.state) && ((revents & POLLOUT) || u->use_mmap || u->use_getospace)) {
 
             if (u->use_mmap) {
 
@@ -1117,9 +1551,14 @@ static void thread_func(void *userdata) {
             pollfd = pa_rtpoll_item_get_pollfd(u->rtpoll_item, NULL);
             pollfd->events = (short)
                 (((u->source && PA_SOURCE_IS_OPENED(u->source->thread_info.state)) ? POLLIN : 0) |
-                 ((u->sink && PA_SINK_IS_OPENED(u->sink->thread_info.state)) ? POLLOUT : 0));
+                 ((u->sink && PA_SINK_IS_OPENED(u->sink->thread_info.state) && !u->use_tsched) ? POLLOUT : 0));
         }
 
+        if (u->sink && PA_SINK_IS_OPENED(u->sink->thread_info.state) && u->use_tsched)
+            pa_rtpoll_set_timer_relative(u->rtpoll, rtpoll_sleep);
+        else
+            pa_rtpoll_set_timer_disabled(u->rtpoll);
+
         /* Hmm, nothing to do. Let's sleep */
         if ((ret = pa_rtpoll_run(u->rtpoll, TRUE)) < 0)
             goto fail;
@@ -1160,7 +1599,8 @@ int pa__init(pa_module*m) {
     int fd = -1;
     int nfrags, orig_frag_size, frag_size;
     int mode, caps;
-    pa_bool_t record = TRUE, playback = TRUE, use_mmap = TRUE;
+    pa_bool_t record = TRUE, playback = TRUE, use_mmap = TRUE, use_tsched = TRUE;
+    uint32_t tsched_size, tsched_watermark;
     pa_sample_spec ss;
     pa_channel_map map;
     pa_modargs *ma = NULL;
@@ -1211,9 +1651,56 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    tsched_size = (uint32_t) pa_usec_to_bytes(DEFAULT_TSCHED_BUFFER_USEC, &ss);
+    tsched_watermark = (uint32_t) pa_usec_to_bytes(DEFAULT_TSCHED_WATERMARK_USEC, &ss);
+
+    if (pa_modargs_get_value_u32(ma, "tsched_buffer_size", &tsched_size) < 0 ||
+        pa_modargs_get_value_u32(ma, "tsched_buffer_watermark", &tsched_watermark) < 0) {
+        pa_log("Failed to parse buffer metrics");
+        goto fail;
+    }
+
+    if (pa_modargs_get_value_boolean(ma, "tsched", &use_tsched) < 0) {
+        pa_log("Failed to parse tsched argument.");
+        goto fail;
+    }
+
     if ((fd = pa_oss_open(dev = pa_modargs_get_value(ma, "device", DEFAULT_DEVICE), &mode, &caps)) < 0)
         goto fail;
 
+    if (use_tsched && mode == O_RDONLY)
+        use_tsched = FALSE;
+
+#ifdef SNDCTL_DSP_GETODELAY
+    if (use_tsched) {
+        int delay;
+
+        /* The position is all we need to know for timer based
+         * scheduling */
+        if (ioctl(fd, SNDCTL_DSP_GETODELAY, &delay) < 0) {
+            pa_log_info("Device doesn't support SNDCTL_DSP_GETODELAY, disabling timer-based scheduling: %s", pa_cstrerror(errno));
+            use_tsched = FALSE;
+        }
+    }
+#else
+    if (use_tsched) {
+        pa_log_info("System doesn't support SNDCTL_DSP_GETODELAY, disabling timer-based scheduling.");
+        use_tsched = FALSE;
+    }
+#endif
+
+    if (use_tsched) {
+        /* A large buffer of small fragments, so that the delay is
+         * updated often */
+        frag_size = (int) pa_usec_to_bytes(TSCHED_FRAGMENT_USEC, &ss);
+        nfrags = (int) PA_CLAMP(tsched_size / (uint32_t) frag_size, 2U, 0x7fffU);
+
+        if (use_mmap) {
+            pa_log_info("Timer-based scheduling writes to the device, disabling memory mapping.");
+            use_mmap = FALSE;
+        }
+    }
+
     if (use_mmap && (!(caps & DSP_CAP_MMAP) || !(caps & DSP_CAP_TRIGGER))) {
         pa_log_info("OSS device not mmap capable, falling back to UNIX read/write mode.");
         use_mmap = FALSE;
@@ -1261,6 +1748,9 @@ int pa__init(pa_module*m) {
     u->out_fragment_size = u->in_fragment_size = (uint32_t) (u->frag_size = frag_size);
     u->orig_frag_size = orig_frag_size;
     u->use_mmap = use_mmap;
+    u->use_tsched = use_tsched;
+    u->first = TRUE;
+    u->smoother_interval = SMOOTHER_MIN_INTERVAL;
     u->rtpoll = pa_rtpoll_new();
     pa_thread_mq_init(&u->thread_mq, m->core->mainloop, u->rtpoll);
     u->rtpoll_item = NULL;
@@ -1390,7 +1880,7 @@ int pa__init(pa_module*m) {
             goto fail;
         }
 
-        u->sink = pa_sink_new(m->core, &sink_new_data, PA_SINK_HARDWARE|PA_SINK_LATENCY);
+        u->sink = pa_sink_new(m->core, &sink_new_data, PA_SINK_HARDWARE|PA_SINK_LATENCY|(use_tsched ? PA_SINK_DYNAMIC_LATENCY : 0));
         pa_sink_new_data_done(&sink_new_data);
         pa_xfree(name_buf);
 
@@ -1404,9 +1894,36 @@ int pa__init(pa_module*m) {
 
         pa_sink_set_asyncmsgq(u->sink, u->thread_mq.inq);
         pa_sink_set_rtpoll(u->sink, u->rtpoll);
-        pa_sink_set_fixed_latency(u->sink, pa_bytes_to_usec(u->out_hwbuf_size, &u->sink->sample_spec));
         u->sink->refresh_volume = TRUE;
 
+        if (use_tsched) {
+            u->sink->update_requested_latency = sink_update_requested_latency_cb;
+
+            u->smoother = pa_smoother_new(
+                    SMOOTHER_ADJUST_USEC,
+                    SMOOTHER_WINDOW_USEC,
+                    TRUE,
+                    TRUE,
+                    5,
+                    pa_rtclock_now(),
+                    TRUE,
+                    FALSE);
+
+            u->tsched_watermark = pa_frame_align(tsched_watermark, &ss);
+            u->watermark_inc_step = pa_usec_to_bytes(TSCHED_WATERMARK_INC_STEP_USEC, &ss);
+            u->watermark_dec_step = pa_usec_to_bytes(TSCHED_WATERMARK_DEC_STEP_USEC, &ss);
+            u->watermark_dec_threshold = pa_usec_to_bytes_round_up(TSCHED_WATERMARK_DEC_THRESHOLD_USEC, &ss);
+
+            fix_min_sleep_wakeup(u);
+            fix_tsched_watermark(u);
+
+            pa_sink_set_latency_range(u->sink, 0, pa_bytes_to_usec(u->out_hwbuf_size, &ss));
+
+            pa_log_info("Time scheduling watermark is %0.2fms",
+                        (double) pa_bytes_to_usec(u->tsched_watermark, &ss) / PA_USEC_PER_MSEC);
+        } else
+            pa_sink_set_fixed_latency(u->sink, pa_bytes_to_usec(u->out_hwbuf_size, &u->sink->sample_spec));
+
         pa_sink_set_max_request(u->sink, u->out_hwbuf_size);
 
         if (use_mmap)
@@ -1527,6 +2044,9 @@ void pa__done(pa_module*m) {
     if (u->memchunk.memblock)
         pa_memblock_unref(u->memchunk.memblock);
 
+    if (u->smoother)
+        pa_smoother_free(u->smoother);
+
     if (u->rtpoll_item)
         pa_rtpoll_item_free(u->rtpoll_item);
 
@@ -0,0 +1,442 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/endianmacros.h>
+#include <pulsecore/macro.h>
+
+#include "alac.h"
+
+/* Element tags */
+#define ID_CPE 1
+#define ID_END 7
+
+/* The difference channel of a pair needs one bit more than the input */
+#define CHAN_BITS 17
+
+/* Decoder parameters, see the fmtp line of the RAOP client */
+#define RICE_HISTORY_MULT 40
+#define RICE_INITIAL_HISTORY 10
+#define RICE_LIMIT 14U
+
+#define RICE_ESCAPE_PREFIX 9
+#define RUN_BITS 16
+
+#define MIX_BITS 2
+#define DEN_SHIFT 9
+#define PB_FACTOR 4
+#define MAX_ORDER 8
+
+/* Below this the predictor parameters cost more than they save */
+#define MIN_COMPRESS_FRAMES 64
+
+/* The zero run length written at the end of a frame has 16 bits */
+#define MAX_COMPRESS_FRAMES 0xFFFF
+
+struct pa_alac_encoder {
+    /* Both channels and the residual of one */
+    int32_t *buf;
+    unsigned n_allocated;
+};
+
+/* Writes bits MSB first. Up to 32 bits are collected in acc before
+ * they are stored as a whole word. */
+typedef struct bit_writer {
+    uint8_t *p;
+    uint64_t acc;
+    unsigned n_bits;
+} bit_writer;
+
+static inline void bit_writer_put(bit_writer *w, uint32_t data, unsigned data_bit_len) {
+    uint32_t word;
+
+    pa_assert(data_bit_len <= 32);
+
+    w->acc = (w->acc << data_bit_len) | data;
+    w->n_bits += data_bit_len;
+
+    if (w->n_bits < 32)
+        return;
+
+    w->n_bits -= 32;
+    word = PA_UINT32_TO_BE((uint32_t) (w->acc >> w->n_bits));
+    memcpy(w->p, &word, sizeof(word));
+    w->p += sizeof(word);
+}
+
+/* Writes out what is left, padded with zero bits to a full byte */
+static void bit_writer_flush(bit_writer *w) {
+
+    for (; w->n_bits >= 8; w->n_bits -= 8)
+        *(w->p++) = (uint8_t) (w->acc >> (w->n_bits - 8));
+
+    if (w->n_bits > 0) {
+        *(w->p++) = (uint8_t) (w->acc << (8 - w->n_bits));
+        w->n_bits = 0;
+    }
+}
+
+static void write_header(bit_writer *w, unsigned n_frames, pa_bool_t verbatim) {
+    bit_writer_put(w, ID_CPE, 3); /* channel=1, stereo */
+    bit_writer_put(w, 0, 4); /* instance */
+    bit_writer_put(w, 0, 12); /* unused */
+    bit_writer_put(w, 1, 1); /* hassize */
+    bit_writer_put(w, 0, 2); /* no bytes shifted out */
+    bit_writer_put(w, verbatim, 1); /* is-not-compressed */
+
+    /* size of data, integer, big endian */
+    bit_writer_put(w, n_frames, 32);
+}
+
+static size_t verbatim_size(unsigned n_frames) {
+    return (55 + 32 * (size_t) n_frames + 7) / 8;
+}
+
+size_t pa_alac_frame_size_max(unsigned n_frames) {
+    /* Compressing is given up on once the verbatim size is reached, the
+     * last sample may then have taken two more words */
+    return verbatim_size(n_frames) + 16;
+}
+
+size_t pa_alac_encode_verbatim(const uint8_t *src, unsigned n_frames, uint8_t *dst) {
+    bit_writer w;
+    const uint8_t *end;
+
+    pa_assert(src);
+    pa_assert(dst);
+
+    w.p = dst;
+    w.acc = 0;
+    w.n_bits = 0;
+
+    write_header(&w, n_frames, TRUE);
+
+    for (end = src + 4 * (size_t) n_frames; src < end; src += 4) {
+        uint32_t v;
+
+        /* Little endian stereo to big endian: as a little endian word
+         * the channels just need to trade places */
+        memcpy(&v, src, sizeof(v));
+        v = PA_UINT32_FROM_LE(v);
+        bit_writer_put(&w, (v << 16) | (v >> 16), 32);
+    }
+
+    bit_writer_flush(&w);
+
+    return (size_t) (w.p - dst);
+}
+
+pa_alac_encoder* pa_alac_encoder_new(void) {
+    return pa_xnew0(pa_alac_encoder, 1);
+}
+
+void pa_alac_encoder_free(pa_alac_encoder *e) {
+    pa_assert(e);
+
+    pa_xfree(e->buf);
+    pa_xfree(e);
+}
+
+static inline int32_t sign_extend(uint32_t v) {
+    return (int32_t) (v << (32 - CHAN_BITS)) >> (32 - CHAN_BITS);
+}
+
+static inline int32_t sign_of(int32_t v) {
+    return (v > 0) - (v < 0);
+}
+
+/* Count of leading zero bits, as the decoder uses it */
+static inline unsigned lead(uint32_t v) {
+    return v ? 31 - pa_ulog2(v) : 32;
+}
+
+static unsigned abs_diff_sum(int32_t a, int32_t b) {
+    return (unsigned) (a > b ? a - b : b - a);
+}
+
+/* Picks between independent channels and mid/side by comparing how
+ * much the channels change from one sample to the next */
+static int32_t choose_mix(const int32_t *l, const int32_t *r, unsigned n) {
+    uint64_t lr = 0, ms = 0;
+    unsigned i;
+
+    for (i = 1; i < n; i++) {
+        lr += abs_diff_sum(l[i], l[i-1]) + abs_diff_sum(r[i], r[i-1]);
+        ms += abs_diff_sum((l[i] + r[i]) >> 1, (l[i-1] + r[i-1]) >> 1) +
+            abs_diff_sum(l[i] - r[i], l[i-1] - r[i-1]);
+    }
+
+    return ms < lr ? 2 : 0;
+}
+
+static void mix(int32_t *u, int32_t *v, unsigned n, int32_t mix_res) {
+    unsigned i;
+
+    if (mix_res == 0)
+        return;
+
+    for (i = 0; i < n; i++) {
+        int32_t l = u[i], r = v[i];
+
+        u[i] = (mix_res * l + ((1 << MIX_BITS) - mix_res) * r) >> MIX_BITS;
+        v[i] = l - r;
+    }
+}
+
+/* The initial coefficients of the predictor, by Levinson-Durbin on the
+ * autocorrelation of the frame. The decoder adapts them as it goes, so
+ * they only have to be roughly right. */
+static unsigned compute_coefs(const int32_t *x, unsigned n, int16_t coefs[MAX_ORDER]) {
+    double r[MAX_ORDER + 1], a[MAX_ORDER], t[MAX_ORDER], err;
+    unsigned i, j, order;
+
+    for (j = 0; j <= MAX_ORDER; j++) {
+        r[j] = 0;
+        for (i = j; i < n; i++)
+            r[j] += (double) x[i] * x[i - j];
+    }
+
+    if (r[0] <= 0)
+        return 0;
+
+    err = r[0];
+    for (order = 0; order < MAX_ORDER; order++) {
+        double k = r[order + 1];
+
+        for (j = 0; j < order; j++)
+            k -= a[j] * r[order - j];
+        k /= err;
+
+        if (k <= -1 || k >= 1)
+            break;
+
+        for (j = 0; j < order; j++)
+            t[j] = a[j] - k * a[order - 1 - j];
+        for (j = 0; j < order; j++)
+            a[j] = t[j];
+        a[order] = k;
+
+        err *= 1 - k * k;
+    }
+
+    for (j = 0; j < order; j++)
+        coefs[j] = (int16_t) PA_CLAMP(lrint(a[j] * (1 << DEN_SHIFT)), -0x8000, 0x7FFF);
+
+    return order;
+}
+
+/* The inverse of what the decoder does, down to how it adapts the
+ * coefficients and where its arithmetic wraps */
+static void predict(const int32_t *x, unsigned n, const int16_t *initial_coefs, unsigned order, int32_t *res) {
+    int16_t c[MAX_ORDER];
+    unsigned i;
+
+    res[0] = x[0];
+
+    if (order == 0) {
+        memcpy(res + 1, x + 1, (n - 1) * sizeof(int32_t));
+        return;
+    }
+
+    memcpy(c, initial_coefs, order * sizeof(int16_t));
+
+    for (i = 1; i <= order; i++)
+        res[i] = sign_extend((uint32_t) (x[i] - x[i - 1]));
+
+    for (i = order + 1; i < n; i++) {
+        const int32_t *prev = x + i - 1;
+        int32_t top = x[i - order - 1], del, k;
+        uint32_t sum = 1U << (DEN_SHIFT - 1);
+
+        for (k = 0; k < (int32_t) order; k++)
+            sum += (uint32_t) ((int64_t) c[k] * (prev[-k] - top));
+
+        res[i] = del = sign_extend((uint32_t) x[i] - (uint32_t) top - (uint32_t) ((int32_t) sum >> DEN_SHIFT));
+
+        if (del > 0) {
+            for (k = (int32_t) order - 1; k >= 0; k--) {
+                int32_t dd = top - prev[-k], sgn = sign_of(dd);
+
+                c[k] = (int16_t) (c[k] - sgn);
+                del -= ((int32_t) order - k) * ((sgn * dd) >> DEN_SHIFT);
+                if (del <= 0)
+                    break;
+            }
+        } else if (del < 0) {
+            for (k = (int32_t) order - 1; k >= 0; k--) {
+                int32_t dd = top - prev[-k], sgn = sign_of(dd);
+
+                c[k] = (int16_t) (c[k] + sgn);
+                del -= ((int32_t) order - k) * ((-sgn * dd) >> DEN_SHIFT);
+                if (del >= 0)
+                    break;
+            }
+        }
+    }
+}
+
+static void put_rice(bit_writer *w, uint32_t x, unsigned k, unsigned escape_bits) {
+    uint32_t m = (1U << k) - 1, q = x / m, r = x % m;
+
+    if (q >= RICE_ESCAPE_PREFIX) {
+        bit_writer_put(w, (1U << RICE_ESCAPE_PREFIX) - 1, RICE_ESCAPE_PREFIX);
+        bit_writer_put(w, x, escape_bits);
+        return;
+    }
+
+    /* q ones and a zero */
+    bit_writer_put(w, (1U << (q + 1)) - 2, q + 1);
+
+    if (k == 1)
+        return;
+
+    if (r > 0)
+        bit_writer_put(w, r + 1, k);
+    else
+        bit_writer_put(w, 0, k - 1);
+}
+
+/* Adaptive rice coding of the residual, with runs of zeros coded as
+ * their length while the history is low. Returns FALSE as soon as the
+ * output reaches limit. */
+static pa_bool_t rice_encode(bit_writer *w, const int32_t *res, unsigned n, const uint8_t *limit) {
+    uint32_t history = RICE_INITIAL_HISTORY, sign_modifier = 0;
+    unsigned i = 0;
+
+    while (i < n) {
+        uint32_t x, k;
+
+        if (w->p >= limit)
+            return FALSE;
+
+        x = res[i] < 0 ? (uint32_t) (-2 * res[i] - 1) : (uint32_t) (2 * res[i]);
+        i++;
+
+        k = PA_MIN(pa_ulog2((history >> 9) + 3), RICE_LIMIT);
+        put_rice(w, x - sign_modifier, k, CHAN_BITS);
+
+        if (x - sign_modifier > 0xFFFF)
+            history = 0xFFFF;
+        else
+            history = RICE_HISTORY_MULT * x + history - ((RICE_HISTORY_MULT * history) >> 9);
+
+        sign_modifier = 0;
+
+        if (history < 128 && i < n) {
+            unsigned run = 0;
+
+            k = lead(history) - 24 + ((history + 16) >> 6);
+
+            while (i < n && res[i] == 0) {
+                run++;
+                i++;
+            }
+
+            put_rice(w, run, k, RUN_BITS);
+
+            sign_modifier = run < 0xFFFF;
+            history = 0;
+        }
+    }
+
+    return TRUE;
+}
+
+size_t pa_alac_encode(pa_alac_encoder *e, const uint8_t *src, unsigned n_frames, uint8_t *dst) {
+    int32_t *x[2], *res;
+    int16_t coefs[2][MAX_ORDER];
+    unsigned order[2], i, c;
+    int32_t mix_res;
+    const uint8_t *limit;
+    bit_writer w;
+
+    pa_assert(e);
+    pa_assert(src);
+    pa_assert(dst);
+
+    if (n_frames < MIN_COMPRESS_FRAMES || n_frames > MAX_COMPRESS_FRAMES)
+        return pa_alac_encode_verbatim(src, n_frames, dst);
+
+    if (e->n_allocated < n_frames) {
+        pa_xfree(e->buf);
+        e->buf = pa_xnew(int32_t, 3 * n_frames);
+        e->n_allocated = n_frames;
+    }
+
+    x[0] = e->buf;
+    x[1] = e->buf + n_frames;
+    res = e->buf + 2 * n_frames;
+
+    for (i = 0; i < n_frames; i++) {
+        int16_t s[2];
+
+        memcpy(s, src + 4 * i, sizeof(s));
+        x[0][i] = (int16_t) PA_INT16_FROM_LE(s[0]);
+        x[1][i] = (int16_t) PA_INT16_FROM_LE(s[1]);
+    }
+
+    mix_res = choose_mix(x[0], x[1], n_frames);
+    mix(x[0], x[1], n_frames, mix_res);
+
+    w.p = dst;
+    w.acc = 0;
+    w.n_bits = 0;
+
+    write_header(&w, n_frames, FALSE);
+    bit_writer_put(&w, MIX_BITS, 8);
+    bit_writer_put(&w, (uint32_t) mix_res, 8);
+
+    for (c = 0; c < 2; c++) {
+        order[c] = compute_coefs(x[c], n_frames, coefs[c]);
+
+        bit_writer_put(&w, 0, 4); /* mode */
+        bit_writer_put(&w, DEN_SHIFT, 4);
+        bit_writer_put(&w, PB_FACTOR, 3);
+        bit_writer_put(&w, order[c], 5);
+
+        for (i = 0; i < order[c]; i++)
+            bit_writer_put(&w, (uint16_t) coefs[c][i], 16);
+    }
+
+    limit = dst + verbatim_size(n_frames);
+
+    for (c = 0; c < 2; c++) {
+        predict(x[c], n_frames, coefs[c], order[c], res);
+
+        if (!rice_encode(&w, res, n_frames, limit))
+            return pa_alac_encode_verbatim(src, n_frames, dst);
+    }
+
+    bit_writer_put(&w, ID_END, 3);
+    bit_writer_flush(&w);
+
+    if (w.p >= limit)
+        return pa_alac_encode_verbatim(src, n_frames, dst);
+
+    return (size_t) (w.p - dst);
+}
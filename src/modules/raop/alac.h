@@ -0,0 +1,48 @@
+#ifndef fooalachfoo
+#define fooalachfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <inttypes.h>
+#include <stddef.h>
+
+/* Writes ALAC frames of interleaved 16 bit little endian stereo, for
+ * a decoder configured as announced by the RAOP client: 16 bits, a
+ * rice history multiplier of 40, an initial history of 10 and a rice
+ * limit of 14. */
+
+typedef struct pa_alac_encoder pa_alac_encoder;
+
+pa_alac_encoder* pa_alac_encoder_new(void);
+void pa_alac_encoder_free(pa_alac_encoder *e);
+
+/* The space pa_alac_encode() may need at dst for n_frames */
+size_t pa_alac_frame_size_max(unsigned n_frames);
+
+/* Writes n_frames as one uncompressed frame and returns its size */
+size_t pa_alac_encode_verbatim(const uint8_t *src, unsigned n_frames, uint8_t *dst);
+
+/* Like pa_alac_encode_verbatim(), but compresses with an adaptive
+ * linear predictor and rice codes. Falls back to an uncompressed frame
+ * where that isn't smaller. The time taken grows linearly with
+ * n_frames. */
+size_t pa_alac_encode(pa_alac_encoder *e, const uint8_t *src, unsigned n_frames, uint8_t *dst);
+
+#endif
@@ -68,6 +68,7 @@ PA_MODULE_USAGE(
         "sink_name=<name for the sink> "
         "sink_properties=<properties for the sink> "
         "server=<address>  "
+        "compression=<compress the stream with ALAC?> "
         "format=<sample format> "
         "rate=<sample rate> "
         "channels=<number of channels>");
@@ -115,6 +116,7 @@ static const char* const valid_modargs[] = {
     "sink_name",
     "sink_properties",
     "server",
+    "compression",
     "format",
     "rate",
     "channels",
@@ -310,8 +312,8 @@ static void thread_func(void *userdata) {
     struct userdata *u = userdata;
     int write_type = 0;
     pa_memchunk silence;
-    uint32_t silence_overhead = 0;
-    double silence_ratio = 0;
+    int32_t silence_overhead = 0;
+    double silence_ratio = 1.0;
 
     pa_assert(u);
 
@@ -352,8 +354,8 @@ static void thread_func(void *userdata) {
                     pa_memblock_release(silence_tmp.memblock);
                     pa_raop_client_encode_sample(u->raop, &silence_tmp, &silence);
                     pa_assert(0 == silence_tmp.length);
-                    silence_overhead = silence_tmp.length - 4096;
-                    silence_ratio = silence_tmp.length / 4096;
+                    silence_overhead = (int32_t) silence.length - 4096;
+                    silence_ratio = (double) silence.length / 4096;
                     pa_memblock_unref(silence_tmp.memblock);
                 }
 
@@ -381,8 +383,11 @@ static void thread_func(void *userdata) {
                             rl = u->raw_memchunk.length;
                             u->encoding_overhead += u->next_encoding_overhead;
                             pa_raop_client_encode_sample(u->raop, &u->raw_memchunk, &u->encoded_memchunk);
-                            u->next_encoding_overhead = (u->encoded_memchunk.length - (rl - u->raw_memchunk.length));
-                            u->encoding_ratio = u->encoded_memchunk.length / (rl - u->raw_memchunk.length);
+                            rl -= u->raw_memchunk.length;
+
+                            /* With compression the encoded data is shorter than the raw data */
+                            u->next_encoding_overhead = (int32_t) u->encoded_memchunk.length - (int32_t) rl;
+                            u->encoding_ratio = (double) u->encoded_memchunk.length / (double) rl;
                         } else {
                             /* We render some silence into our memchunk */
                             memcpy(&u->encoded_memchunk, &silence, sizeof(pa_memchunk));
@@ -509,6 +514,7 @@ int pa__init(pa_module*m) {
     pa_sample_spec ss;
     pa_modargs *ma = NULL;
     const char *server;
+    pa_bool_t compression = FALSE;
     pa_sink_new_data data;
 
     pa_assert(m);
@@ -524,6 +530,11 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    if (pa_modargs_get_value_boolean(ma, "compression", &compression) < 0) {
+        pa_log("compression= expects a boolean argument");
+        goto fail;
+    }
+
     if ((/*ss.format != PA_SAMPLE_U8 &&*/ ss.format != PA_SAMPLE_S16NE) ||
         (ss.channels > 2)) {
         pa_log("sample type support is limited to mono/stereo and U8 or S16NE sample data");
@@ -542,6 +553,7 @@ int pa__init(pa_module*m) {
             TRUE,
             10,
             0,
+            FALSE,
             FALSE);
     pa_memchunk_reset(&u->raw_memchunk);
     pa_memchunk_reset(&u->encoded_memchunk);
@@ -608,6 +620,7 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    pa_raop_client_set_compression(u->raop, compression);
     pa_raop_client_set_callback(u->raop, on_connection, u);
     pa_raop_client_set_closed_callback(u->raop, on_close, u);
 
@@ -36,7 +36,7 @@
 /* TODO: Replace OpenSSL with NSS */
 #include <openssl/err.h>
 #include <openssl/rand.h>
-#include <openssl/aes.h>
+#include <openssl/evp.h>
 #include <openssl/rsa.h>
 #include <openssl/engine.h>
 
@@ -44,6 +44,7 @@
 
 #include <pulsecore/core-error.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/endianmacros.h>
 #include <pulsecore/iochannel.h>
 #include <pulsecore/socket-util.h>
 #include <pulsecore/log.h>
@@ -55,6 +56,7 @@
 #include "raop_client.h"
 #include "rtsp_client.h"
 #include "base64.h"
+#include "alac.h"
 
 #define AES_CHUNKSIZE 16
 
@@ -82,11 +84,13 @@ struct pa_raop_client {
     uint8_t jack_status;
 
     /* Encryption Related bits */
-    AES_KEY aes;
+    EVP_CIPHER_CTX *aes;
     uint8_t aes_iv[AES_CHUNKSIZE]; /* initialization vector for aes-cbc */
-    uint8_t aes_nv[AES_CHUNKSIZE]; /* next vector for aes-cbc */
     uint8_t aes_key[AES_CHUNKSIZE]; /* key for aes-cbc */
 
+    /* NULL while frames are sent uncompressed */
+    pa_alac_encoder *alac;
+
     pa_socket_client *sc;
     int fd;
 
@@ -99,58 +103,6 @@ struct pa_raop_client {
     void* closed_userdata;
 };
 
-/**
- * Function to write bits into a buffer.
- * @param buffer Handle to the buffer. It will be incremented if new data requires it.
- * @param bit_pos A pointer to a position buffer to keep track the current write location (0 for MSB, 7 for LSB)
- * @param size A pointer to the byte size currently written. This allows the calling function to do simple buffer overflow checks
- * @param data The data to write
- * @param data_bit_len The number of bits from data to write
- */
-static inline void bit_writer(uint8_t **buffer, uint8_t *bit_pos, int *size, uint8_t data, uint8_t data_bit_len) {
-    int bits_left, bit_overflow;
-    uint8_t bit_data;
-
-    if (!data_bit_len)
-        return;
-
-    /* If bit pos is zero, we will definately use at least one bit from the current byte so size increments. */
-    if (!*bit_pos)
-        *size += 1;
-
-    /* Calc the number of bits left in the current byte of buffer */
-    bits_left = 7 - *bit_pos  + 1;
-    /* Calc the overflow of bits in relation to how much space we have left... */
-    bit_overflow = bits_left - data_bit_len;
-    if (bit_overflow >= 0) {
-        /* We can fit the new data in our current byte */
-        /* As we write from MSB->LSB we need to left shift by the overflow amount */
-        bit_data = data << bit_overflow;
-        if (*bit_pos)
-            **buffer |= bit_data;
-        else
-            **buffer = bit_data;
-        /* If our data fits exactly into the current byte, we need to increment our pointer */
-        if (0 == bit_overflow) {
-            /* Do not increment size as it will be incremented on next call as bit_pos is zero */
-            *buffer += 1;
-            *bit_pos = 0;
-        } else {
-            *bit_pos += data_bit_len;
-        }
-    } else {
-        /* bit_overflow is negative, there for we will need a new byte from our buffer */
-        /* Firstly fill up what's left in the current byte */
-        bit_data = data >> -bit_overflow;
-        **buffer |= bit_data;
-        /* Increment our buffer pointer and size counter*/
-        *buffer += 1;
-        *size += 1;
-        **buffer = data << (8 + bit_overflow);
-        *bit_pos = -bit_overflow;
-    }
-}
-
 static int rsa_encrypt(uint8_t *text, int len, uint8_t *res) {
     const char n[] =
         "59dE8qLieItsH1WgjrcFRKj6eUWqi+bGLOX1HL3U3GhC/j0Qg90u3sG/1CUtwC"
@@ -176,23 +128,22 @@ static int rsa_encrypt(uint8_t *text, int len, uint8_t *res) {
     return size;
 }
 
+/* Every frame is encrypted on its own, starting from aes_iv. A
+ * trailing part shorter than a block is left as it is. */
 static int aes_encrypt(pa_raop_client* c, uint8_t *data, int size) {
-    uint8_t *buf;
-    int i=0, j;
+    int n, l;
 
     pa_assert(c);
 
-    memcpy(c->aes_nv, c->aes_iv, AES_CHUNKSIZE);
-    while (i+AES_CHUNKSIZE <= size) {
-        buf = data + i;
-        for (j=0; j<AES_CHUNKSIZE; ++j)
-            buf[j] ^= c->aes_nv[j];
+    n = size - size % AES_CHUNKSIZE;
+    if (n <= 0)
+        return 0;
 
-        AES_encrypt(buf, buf, &c->aes);
-        memcpy(c->aes_nv, buf, AES_CHUNKSIZE);
-        i += AES_CHUNKSIZE;
-    }
-    return i;
+    pa_assert_se(EVP_EncryptInit_ex(c->aes, NULL, NULL, NULL, c->aes_iv));
+    pa_assert_se(EVP_EncryptUpdate(c->aes, data, &l, data, n));
+    pa_assert(l == n);
+
+    return n;
 }
 
 static inline void rtrimchar(char *str, char rc) {
@@ -400,6 +351,10 @@ void pa_raop_client_free(pa_raop_client* c) {
         pa_rtsp_client_free(c->rtsp);
     if (c->sid)
         pa_xfree(c->sid);
+    if (c->aes)
+        EVP_CIPHER_CTX_free(c->aes);
+    if (c->alac)
+        pa_alac_encoder_free(c->alac);
     pa_xfree(c->host);
     pa_xfree(c);
 }
@@ -425,8 +380,12 @@ int pa_raop_connect(pa_raop_client* c) {
     /* Initialise the AES encryption system */
     pa_random(c->aes_iv, sizeof(c->aes_iv));
     pa_random(c->aes_key, sizeof(c->aes_key));
-    memcpy(c->aes_nv, c->aes_iv, sizeof(c->aes_nv));
-    AES_set_encrypt_key(c->aes_key, 128, &c->aes);
+
+    /* The EVP interface picks AES-NI and the like where available */
+    if (!c->aes)
+        pa_assert_se(c->aes = EVP_CIPHER_CTX_new());
+    pa_assert_se(EVP_EncryptInit_ex(c->aes, EVP_aes_128_cbc(), NULL, c->aes_key, c->aes_iv));
+    EVP_CIPHER_CTX_set_padding(c->aes, 0);
 
     /* Generate random instance id */
     pa_random(&rand_data, sizeof(rand_data));
@@ -472,10 +431,9 @@ int pa_raop_client_set_volume(pa_raop_client* c, pa_volume_t volume) {
 int pa_raop_client_encode_sample(pa_raop_client* c, pa_memchunk* raw, pa_memchunk* encoded) {
     uint16_t len;
     size_t bufmax;
-    uint8_t *bp, bpos;
-    uint8_t *ibp, *maxibp;
-    int size;
-    uint8_t *b, *p;
+    uint8_t *p;
+    size_t size;
+    uint8_t *b;
     uint32_t bsize;
     size_t length;
     static uint8_t header[] = {
@@ -497,43 +455,23 @@ int pa_raop_client_encode_sample(pa_raop_client* c, pa_memchunk* raw, pa_memchun
     bsize = (int)(raw->length / 4);
     length = bsize * 4;
 
-    /* Leave 16 bytes extra to allow for the ALAC header which is about 55 bits */
-    bufmax = length + header_size + 16;
+    bufmax = header_size + pa_alac_frame_size_max(bsize);
     pa_memchunk_reset(encoded);
     encoded->memblock = pa_memblock_new(c->core->mempool, bufmax);
     b = pa_memblock_acquire(encoded->memblock);
     memcpy(b, header, header_size);
 
     /* Now write the actual samples */
-    bp = b + header_size;
-    size = bpos = 0;
-    bit_writer(&bp,&bpos,&size,1,3); /* channel=1, stereo */
-    bit_writer(&bp,&bpos,&size,0,4); /* unknown */
-    bit_writer(&bp,&bpos,&size,0,8); /* unknown */
-    bit_writer(&bp,&bpos,&size,0,4); /* unknown */
-    bit_writer(&bp,&bpos,&size,1,1); /* hassize */
-    bit_writer(&bp,&bpos,&size,0,2); /* unused */
-    bit_writer(&bp,&bpos,&size,1,1); /* is-not-compressed */
-
-    /* size of data, integer, big endian */
-    bit_writer(&bp,&bpos,&size,(bsize>>24)&0xff,8);
-    bit_writer(&bp,&bpos,&size,(bsize>>16)&0xff,8);
-    bit_writer(&bp,&bpos,&size,(bsize>>8)&0xff,8);
-    bit_writer(&bp,&bpos,&size,(bsize)&0xff,8);
-
-    ibp = p = pa_memblock_acquire(raw->memblock);
-    maxibp = p + raw->length - 4;
-    while (ibp <= maxibp) {
-        /* Byte swap stereo data */
-        bit_writer(&bp,&bpos,&size,*(ibp+1),8);
-        bit_writer(&bp,&bpos,&size,*(ibp+0),8);
-        bit_writer(&bp,&bpos,&size,*(ibp+3),8);
-        bit_writer(&bp,&bpos,&size,*(ibp+2),8);
-        ibp += 4;
-        raw->index += 4;
-        raw->length -= 4;
-    }
+    p = pa_memblock_acquire(raw->memblock);
+    if (c->alac)
+        size = pa_alac_encode(c->alac, p + raw->index, bsize, b + header_size);
+    else
+        size = pa_alac_encode_verbatim(p + raw->index, bsize, b + header_size);
     pa_memblock_release(raw->memblock);
+    raw->index += length;
+    raw->length -= length;
+
+    pa_assert(header_size + size <= bufmax);
     encoded->length = header_size + size;
 
     /* store the length (endian swapped: make this better) */
@@ -550,6 +488,17 @@ int pa_raop_client_encode_sample(pa_raop_client* c, pa_memchunk* raw, pa_memchun
     return 0;
 }
 
+void pa_raop_client_set_compression(pa_raop_client* c, pa_bool_t compress) {
+    pa_assert(c);
+
+    if (compress && !c->alac)
+        c->alac = pa_alac_encoder_new();
+    else if (!compress && c->alac) {
+        pa_alac_encoder_free(c->alac);
+        c->alac = NULL;
+    }
+}
+
 
 void pa_raop_client_set_callback(pa_raop_client* c, pa_raop_client_cb_t callback, void *userdata) {
     pa_assert(c);
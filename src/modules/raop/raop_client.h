@@ -35,6 +35,9 @@ int pa_raop_flush(pa_raop_client* c);
 int pa_raop_client_set_volume(pa_raop_client* c, pa_volume_t volume);
 int pa_raop_client_encode_sample(pa_raop_client* c, pa_memchunk* raw, pa_memchunk* encoded);
 
+/* Whether pa_raop_client_encode_sample() compresses, off by default */
+void pa_raop_client_set_compression(pa_raop_client* c, pa_bool_t compress);
+
 typedef void (*pa_raop_client_cb_t)(int fd, void *userdata);
 void pa_raop_client_set_callback(pa_raop_client* c, pa_raop_client_cb_t callback, void *userdata);
 
@@ -48,6 +48,7 @@
 #include <pulsecore/modargs.h>
 #include <pulsecore/namereg.h>
 #include <pulsecore/sample-util.h>
+#include <pulsecore/sconv.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/socket-util.h>
 #include <pulsecore/atomic.h>
@@ -55,6 +56,10 @@
 #include <pulsecore/poll.h>
 #include <pulsecore/arpa-inet.h>
 
+#ifdef HAVE_OPUS
+#include <pulsecore/opus-util.h>
+#endif
+
 #include "module-rtp-recv-symdef.h"
 
 #include "rtp.h"
@@ -76,7 +81,20 @@ PA_MODULE_USAGE(
 #define MAX_SESSIONS 16
 #define DEATH_TIMEOUT 20
 #define RATE_UPDATE_INTERVAL (5*PA_USEC_PER_SEC)
-#define LATENCY_USEC (500*PA_USEC_PER_MSEC)
+#define INITIAL_LATENCY_USEC (100*PA_USEC_PER_MSEC)
+#define MAX_LATENCY_USEC (500*PA_USEC_PER_MSEC)
+
+/* The jitter buffer is kept this many times the interarrival jitter
+ * deeper than a single packet. */
+#define JITTER_FACTOR 4
+
+/* Lost packets are concealed by repeating the last PLC_HISTORY_USEC
+ * played, crossfading over PLC_FADE_USEC at each seam. After the first
+ * repetition the volume goes down until there is silence at
+ * PLC_MAX_USEC into the hole. */
+#define PLC_HISTORY_USEC (20*PA_USEC_PER_MSEC)
+#define PLC_FADE_USEC (2*PA_USEC_PER_MSEC)
+#define PLC_MAX_USEC (60*PA_USEC_PER_MSEC)
 
 static const char* const valid_modargs[] = {
     "sink",
@@ -94,11 +112,23 @@ struct session {
     pa_bool_t first_packet;
     uint32_t ssrc;
     uint32_t offset;
+    uint16_t sequence;
+    unsigned n_late;
+    pa_usec_t packet_usec;
+
+    /* Relative transit time of the last packet and the interarrival
+     * jitter of RFC 3550, both in timestamp units. */
+    uint32_t transit;
+    double jitter;
 
     struct pa_sdp_info sdp_info;
 
     pa_rtp_context rtp_context;
 
+#ifdef HAVE_OPUS
+    pa_opus_decoder *decoder;
+#endif
+
     pa_rtpoll_item *rtpoll_item;
 
     pa_atomic_t timestamp;
@@ -110,6 +140,14 @@ struct session {
     pa_usec_t last_latency;
     double estimated_rate;
     double avg_estimated_rate;
+
+    /* Packet loss concealment, the history is kept in S16NE */
+    pa_convert_func_t to_s16ne, from_s16ne;
+    int16_t *plc_history;
+    size_t plc_history_frames;
+    size_t plc_fade_frames;
+    size_t plc_max_frames;
+    size_t plc_position;
 };
 
 struct userdata {
@@ -146,6 +184,118 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *data, int64_t
     return pa_sink_input_process_msg(o, code, data, offset, chunk);
 }
 
+/* Called from I/O thread context */
+static int plc_sample(struct session *s, size_t p, unsigned c) {
+    unsigned channels = s->sink_input->sample_spec.channels;
+    size_t period, k;
+    double v;
+
+    if (p >= s->plc_max_frames)
+        return 0;
+
+    /* The history is repeated without its last PLC_FADE_USEC, which at
+     * each wrap-around are faded into the start, since they are what
+     * originally followed the end of the repeated stretch. */
+    period = s->plc_history_frames - s->plc_fade_frames;
+    k = p % period;
+    v = s->plc_history[k * channels + c];
+
+    if (k < s->plc_fade_frames) {
+        double from, w;
+
+        /* At the very start of the hole fade over from the last frame
+         * played instead */
+        if (p < period)
+            from = s->plc_history[(s->plc_history_frames - 1) * channels + c];
+        else
+            from = s->plc_history[(period + k) * channels + c];
+
+        w = (double) k / (double) s->plc_fade_frames;
+        v = w * v + (1.0 - w) * from;
+    }
+
+    if (p >= period)
+        v *= (double) (s->plc_max_frames - p) / (double) (s->plc_max_frames - period);
+
+    return (int) lrint(v);
+}
+
+/* Called from I/O thread context */
+static void plc_remember(struct session *s, const pa_memchunk *chunk) {
+    unsigned channels = s->sink_input->sample_spec.channels;
+    size_t n, h = s->plc_history_frames;
+    const uint8_t *d;
+
+    n = chunk->length / pa_frame_size(&s->sink_input->sample_spec);
+    d = (const uint8_t*) pa_memblock_acquire(chunk->memblock) + chunk->index;
+
+    if (n >= h)
+        s->to_s16ne((unsigned) (h * channels), d + (n - h) * pa_frame_size(&s->sink_input->sample_spec), s->plc_history);
+    else {
+        memmove(s->plc_history, s->plc_history + n * channels, (h - n) * channels * sizeof(int16_t));
+        s->to_s16ne((unsigned) (n * channels), d, s->plc_history + (h - n) * channels);
+    }
+
+    pa_memblock_release(chunk->memblock);
+}
+
+/* Called from I/O thread context */
+static void plc_conceal(struct session *s, pa_memchunk *chunk) {
+    unsigned channels = s->sink_input->sample_spec.channels, c;
+    size_t n, k;
+    int16_t *buf;
+    void *d;
+
+    n = chunk->length / pa_frame_size(&s->sink_input->sample_spec);
+    buf = pa_xnew(int16_t, n * channels);
+
+    for (k = 0; k < n; k++)
+        for (c = 0; c < channels; c++)
+            buf[k * channels + c] = (int16_t) plc_sample(s, s->plc_position + k, c);
+
+    s->plc_position += n;
+
+    chunk->memblock = pa_memblock_new(s->userdata->module->core->mempool, chunk->length);
+    chunk->index = 0;
+
+    d = pa_memblock_acquire(chunk->memblock);
+    s->from_s16ne((unsigned) (n * channels), buf, d);
+    pa_memblock_release(chunk->memblock);
+
+    pa_xfree(buf);
+}
+
+/* Called from I/O thread context, fades from the concealment over to
+ * the data following the hole */
+static void plc_resume(struct session *s, pa_memchunk *chunk) {
+    unsigned channels = s->sink_input->sample_spec.channels, c;
+    size_t n, k;
+    int16_t *buf;
+    uint8_t *d;
+
+    n = PA_MIN(chunk->length / pa_frame_size(&s->sink_input->sample_spec), s->plc_fade_frames);
+    buf = pa_xnew(int16_t, n * channels);
+
+    pa_memchunk_make_writable(chunk, 0);
+    d = (uint8_t*) pa_memblock_acquire(chunk->memblock) + chunk->index;
+    s->to_s16ne((unsigned) (n * channels), d, buf);
+
+    for (k = 0; k < n; k++) {
+        double w = (double) (k + 1) / (double) (s->plc_fade_frames + 1);
+
+        for (c = 0; c < channels; c++) {
+            int16_t *v = buf + k * channels + c;
+            *v = (int16_t) lrint(w * *v + (1.0 - w) * plc_sample(s, s->plc_position + k, c));
+        }
+    }
+
+    s->from_s16ne((unsigned) (n * channels), buf, d);
+    pa_memblock_release(chunk->memblock);
+
+    pa_xfree(buf);
+    s->plc_position = 0;
+}
+
 /* Called from I/O thread context */
 static int sink_input_pop_cb(pa_sink_input *i, size_t length, pa_memchunk *chunk) {
     struct session *s;
@@ -155,6 +305,20 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t length, pa_memchunk *chunk
     if (pa_memblockq_peek(s->memblockq, chunk) < 0)
         return -1;
 
+    if (!chunk->memblock) {
+        /* A hole left by a lost or late packet */
+        length = pa_frame_align(length, &i->sample_spec);
+        if (length > 0 && chunk->length > length)
+            chunk->length = length;
+
+        plc_conceal(s, chunk);
+    } else {
+        if (s->plc_position > 0)
+            plc_resume(s, chunk);
+
+        plc_remember(s, chunk);
+    }
+
     pa_memblockq_drop(s->memblockq, chunk->length);
 
     return 0;
@@ -168,6 +332,7 @@ static void sink_input_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
     pa_assert_se(s = i->userdata);
 
     pa_memblockq_rewind(s->memblockq, nbytes);
+    s->plc_position = 0;
 }
 
 /* Called from I/O thread context */
@@ -202,50 +367,100 @@ static void sink_input_suspend_within_thread(pa_sink_input* i, pa_bool_t b) {
 }
 
 /* Called from I/O thread context */
-static int rtpoll_work_cb(pa_rtpoll_item *i) {
-    pa_memchunk chunk;
-    int64_t k, j, delta;
-    struct timeval now = { 0, 0 };
-    struct session *s;
-    struct pollfd *p;
+static uint32_t get_transit(struct session *s, const struct timeval *now) {
+    uint32_t arrival;
 
-    pa_assert_se(s = pa_rtpoll_item_get_userdata(i));
+    /* The arrival time in timestamp units, the offset doesn't matter */
+    arrival = (uint32_t) (pa_timeval_load(now) * s->sdp_info.sample_spec.rate / PA_USEC_PER_SEC);
 
-    p = pa_rtpoll_item_get_pollfd(i, NULL);
+    return arrival - s->rtp_context.timestamp;
+}
 
-    if (p->revents & (POLLERR|POLLNVAL|POLLHUP|POLLOUT)) {
-        pa_log("poll() signalled bad revents.");
-        return -1;
-    }
+/* Called from I/O thread context */
+static void update_jitter(struct session *s, const struct timeval *now) {
+    uint32_t transit;
+    int32_t d;
 
-    if ((p->revents & POLLIN) == 0)
-        return 0;
+    /* RFC 3550, A.8 */
+    transit = get_transit(s, now);
+    d = (int32_t) (transit - s->transit);
+    s->transit = transit;
 
-    p->revents = 0;
+    s->jitter += (fabs((double) d) - s->jitter) / 16.0;
+}
 
-    if (pa_rtp_recv(&s->rtp_context, &chunk, s->userdata->module->core->mempool, &now) < 0)
-        return 0;
+/* Called from I/O thread context */
+static void update_intended_latency(struct session *s) {
+    pa_usec_t jitter, latency;
+
+    jitter = (pa_usec_t) (s->jitter * (double) PA_USEC_PER_SEC / (double) s->sdp_info.sample_spec.rate);
+
+    latency = s->packet_usec + JITTER_FACTOR * jitter;
+    latency = PA_MIN(latency, MAX_LATENCY_USEC);
+    latency = PA_MAX(latency, s->sink_latency*2);
+
+    pa_log_debug("Interarrival jitter is %0.2f ms, %u late packets, keeping %0.2f ms buffered",
+                 (double) jitter / PA_USEC_PER_MSEC, s->n_late, (double) latency / PA_USEC_PER_MSEC);
+
+    s->intended_latency = latency;
+    pa_memblockq_set_prebuf(s->memblockq, pa_usec_to_bytes(s->intended_latency - s->sink_latency, &s->sink_input->sample_spec));
+}
+
+/* Called from I/O thread context */
+static pa_bool_t session_receive(struct session *s, pa_memchunk *chunk, struct timeval *now) {
+    int64_t k, j, delta;
+    size_t fs;
 
     if (s->sdp_info.payload != s->rtp_context.payload ||
         !PA_SINK_IS_OPENED(s->sink_input->sink->thread_info.state)) {
-        pa_memblock_unref(chunk.memblock);
-        return 0;
+        pa_memblock_unref(chunk->memblock);
+        return FALSE;
     }
 
+    if (now->tv_sec == 0) {
+        PA_ONCE_BEGIN {
+            pa_log_warn("Using artificial time instead of timestamp");
+        } PA_ONCE_END;
+        pa_rtclock_get(now);
+    } else
+        pa_rtclock_from_wallclock(now);
+
     if (!s->first_packet) {
         s->first_packet = TRUE;
 
         s->ssrc = s->rtp_context.ssrc;
         s->offset = s->rtp_context.timestamp;
+        s->sequence = s->rtp_context.sequence;
+        s->transit = get_transit(s, now);
 
         if (s->ssrc == s->userdata->module->core->cookie)
             pa_log_warn("Detected RTP packet loop!");
     } else {
         if (s->ssrc != s->rtp_context.ssrc) {
-            pa_memblock_unref(chunk.memblock);
-            return 0;
+            pa_memblock_unref(chunk->memblock);
+            return FALSE;
         }
+
+        update_jitter(s, now);
+    }
+
+#ifdef HAVE_OPUS
+    if (s->decoder) {
+        pa_memchunk pcm;
+        int r;
+
+        r = pa_opus_decoder_decode_packet(s->decoder, chunk, &pcm);
+        pa_memblock_unref(chunk->memblock);
+
+        if (r < 0)
+            return FALSE;
+
+        *chunk = pcm;
     }
+#endif
+
+    /* Timestamps count frames of the decoded data */
+    fs = pa_frame_size(&s->sdp_info.sample_spec);
 
     /* Check whether there was a timestamp overflow */
     k = (int64_t) s->rtp_context.timestamp - (int64_t) s->offset;
@@ -256,27 +471,80 @@ static int rtpoll_work_cb(pa_rtpoll_item *i) {
     else
         delta = j;
 
-    pa_memblockq_seek(s->memblockq, delta * (int64_t) s->rtp_context.frame_size, PA_SEEK_RELATIVE, TRUE);
+    if ((int16_t) (s->rtp_context.sequence - s->sequence) < 0) {
+        int64_t write_index;
 
-    if (now.tv_sec == 0) {
-        PA_ONCE_BEGIN {
-            pa_log_warn("Using artificial time instead of timestamp");
-        } PA_ONCE_END;
-        pa_rtclock_get(&now);
-    } else
-        pa_rtclock_from_wallclock(&now);
+        /* This packet was overtaken by later ones. Put it into the hole
+         * it left, unless that has been played already. */
+        write_index = pa_memblockq_get_write_index(s->memblockq);
+        pa_memblockq_seek(s->memblockq, delta * (int64_t) fs, PA_SEEK_RELATIVE, TRUE);
+
+        if (pa_memblockq_get_write_index(s->memblockq) + (int64_t) chunk->length <= pa_memblockq_get_read_index(s->memblockq))
+            s->n_late++;
+        else
+            pa_memblockq_push(s->memblockq, chunk);
+
+        pa_memblockq_seek(s->memblockq, write_index, PA_SEEK_ABSOLUTE, TRUE);
+        pa_memblock_unref(chunk->memblock);
+
+    } else {
+        pa_memblockq_seek(s->memblockq, delta * (int64_t) fs, PA_SEEK_RELATIVE, TRUE);
+
+        if (pa_memblockq_push(s->memblockq, chunk) < 0) {
+            pa_log_warn("Queue overrun");
+            pa_memblockq_seek(s->memblockq, (int64_t) chunk->length, PA_SEEK_RELATIVE, TRUE);
+        }
+
+/*         pa_log("blocks in q: %u", pa_memblockq_get_nblocks(s->memblockq)); */
+
+        pa_memblock_unref(chunk->memblock);
+
+        /* The next timestamp and sequence number we expect */
+        s->offset = s->rtp_context.timestamp + (uint32_t) (chunk->length / fs);
+        s->sequence = (uint16_t) (s->rtp_context.sequence + 1);
+        s->packet_usec = pa_bytes_to_usec(chunk->length, &s->sdp_info.sample_spec);
+    }
+
+    return TRUE;
+}
+
+/* Called from I/O thread context */
+static int rtpoll_work_cb(pa_rtpoll_item *i) {
+    pa_memchunk chunk;
+    struct timeval now = { 0, 0 };
+    struct session *s;
+    struct pollfd *p;
+    pa_bool_t received = FALSE;
+
+    pa_assert_se(s = pa_rtpoll_item_get_userdata(i));
+
+    p = pa_rtpoll_item_get_pollfd(i, NULL);
 
-    if (pa_memblockq_push(s->memblockq, &chunk) < 0) {
-        pa_log_warn("Queue overrun");
-        pa_memblockq_seek(s->memblockq, (int64_t) chunk.length, PA_SEEK_RELATIVE, TRUE);
+    if (p->revents & (POLLERR|POLLNVAL|POLLHUP|POLLOUT)) {
+        pa_log("poll() signalled bad revents.");
+        return -1;
     }
 
-/*     pa_log("blocks in q: %u", pa_memblockq_get_nblocks(s->memblockq)); */
+    if ((p->revents & POLLIN) == 0)
+        return 0;
+
+    p->revents = 0;
+
+    /* A single wakeup might bring us a batch of packets */
+    do {
+        struct timeval tstamp;
 
-    pa_memblock_unref(chunk.memblock);
+        if (pa_rtp_recv(&s->rtp_context, &chunk, s->userdata->module->core->mempool, &tstamp) < 0)
+            continue;
 
-    /* The next timestamp we expect */
-    s->offset = s->rtp_context.timestamp + (uint32_t) (chunk.length / s->rtp_context.frame_size);
+        if (session_receive(s, &chunk, &tstamp)) {
+            now = tstamp;
+            received = TRUE;
+        }
+    } while (pa_rtp_recv_pending(&s->rtp_context));
+
+    if (!received)
+        return 0;
 
     pa_atomic_store(&s->timestamp, (int) now.tv_sec);
 
@@ -287,6 +555,8 @@ static int rtpoll_work_cb(pa_rtpoll_item *i) {
         uint32_t new_rate;
         double estimated_rate, alpha = 0.02;
 
+        update_intended_latency(s);
+
         pa_log_debug("Updating sample rate");
 
         wi = pa_bytes_to_usec((uint64_t) pa_memblockq_get_write_index(s->memblockq), &s->sink_input->sample_spec);
@@ -482,7 +752,6 @@ static struct session *session_new(struct userdata *u, const pa_sdp_info *sdp_in
     struct session *s = NULL;
     pa_sink *sink;
     int fd = -1;
-    pa_memchunk silence;
     pa_sink_input_new_data data;
     struct timeval now;
 
@@ -501,18 +770,30 @@ static struct session *session_new(struct userdata *u, const pa_sdp_info *sdp_in
 
     pa_rtclock_get(&now);
 
+#ifndef HAVE_OPUS
+    if (sdp_info->encoding == PA_ENCODING_OPUS) {
+        pa_log("Opus support not available.");
+        goto fail;
+    }
+#endif
+
     s = pa_xnew0(struct session, 1);
     s->userdata = u;
     s->first_packet = FALSE;
     s->sdp_info = *sdp_info;
     s->rtpoll_item = NULL;
-    s->intended_latency = LATENCY_USEC;
+    s->intended_latency = INITIAL_LATENCY_USEC;
     s->last_rate_update = pa_timeval_load(&now);
-    s->last_latency = LATENCY_USEC;
+    s->last_latency = INITIAL_LATENCY_USEC;
     s->estimated_rate = (double) sink->sample_spec.rate;
     s->avg_estimated_rate = (double) sink->sample_spec.rate;
     pa_atomic_store(&s->timestamp, (int) now.tv_sec);
 
+#ifdef HAVE_OPUS
+    if (sdp_info->encoding == PA_ENCODING_OPUS && !(s->decoder = pa_opus_decoder_new(u->module->core->mempool, &sdp_info->sample_spec)))
+        goto fail;
+#endif
+
     if ((fd = mcast_socket((const struct sockaddr*) &sdp_info->sa, sdp_info->salen)) < 0)
         goto fail;
 
@@ -553,8 +834,6 @@ static struct session *session_new(struct userdata *u, const pa_sdp_info *sdp_in
     s->sink_input->detach = sink_input_detach;
     s->sink_input->suspend_within_thread = sink_input_suspend_within_thread;
 
-    pa_sink_input_get_silence(s->sink_input, &silence);
-
     s->sink_latency = pa_sink_input_set_requested_latency(s->sink_input, s->intended_latency/2);
 
     if (s->intended_latency < s->sink_latency*2)
@@ -569,11 +848,18 @@ static struct session *session_new(struct userdata *u, const pa_sdp_info *sdp_in
             pa_usec_to_bytes(s->intended_latency - s->sink_latency, &s->sink_input->sample_spec),
             0,
             0,
-            &silence);
+            NULL);
 
-    pa_memblock_unref(silence.memblock);
+    /* Holes in the queue are filled in by the pop callback */
+    s->to_s16ne = pa_get_convert_to_s16ne_function(s->sink_input->sample_spec.format);
+    s->from_s16ne = pa_get_convert_from_s16ne_function(s->sink_input->sample_spec.format);
+    s->plc_history_frames = pa_usec_to_bytes(PLC_HISTORY_USEC, &s->sink_input->sample_spec) / pa_frame_size(&s->sink_input->sample_spec);
+    s->plc_fade_frames = pa_usec_to_bytes(PLC_FADE_USEC, &s->sink_input->sample_spec) / pa_frame_size(&s->sink_input->sample_spec);
+    s->plc_max_frames = pa_usec_to_bytes(PLC_MAX_USEC, &s->sink_input->sample_spec) / pa_frame_size(&s->sink_input->sample_spec);
+    s->plc_history = pa_xnew0(int16_t, s->plc_history_frames * s->sink_input->sample_spec.channels);
 
-    pa_rtp_context_init_recv(&s->rtp_context, fd, pa_frame_size(&s->sdp_info.sample_spec));
+    /* Compressed packets may be of any size */
+    pa_rtp_context_init_recv(&s->rtp_context, fd, s->sdp_info.encoding == PA_ENCODING_PCM ? pa_frame_size(&s->sdp_info.sample_spec) : 1);
 
     pa_hashmap_put(s->userdata->by_origin, s->sdp_info.origin, s);
     u->n_sessions++;
@@ -586,6 +872,11 @@ static struct session *session_new(struct userdata *u, const pa_sdp_info *sdp_in
     return s;
 
 fail:
+#ifdef HAVE_OPUS
+    if (s && s->decoder)
+        pa_opus_decoder_free(s->decoder);
+#endif
+
     pa_xfree(s);
 
     if (fd >= 0)
@@ -608,9 +899,15 @@ static void session_free(struct session *s) {
     pa_hashmap_remove(s->userdata->by_origin, s->sdp_info.origin);
 
     pa_memblockq_free(s->memblockq);
+    pa_xfree(s->plc_history);
     pa_sdp_info_destroy(&s->sdp_info);
     pa_rtp_context_destroy(&s->rtp_context);
 
+#ifdef HAVE_OPUS
+    if (s->decoder)
+        pa_opus_decoder_free(s->decoder);
+#endif
+
     pa_xfree(s);
 }
 
@@ -24,6 +24,7 @@
 #endif
 
 #include <stdio.h>
+#include <string.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <errno.h>
@@ -48,6 +49,10 @@
 #include <pulsecore/socket-util.h>
 #include <pulsecore/arpa-inet.h>
 
+#ifdef HAVE_OPUS
+#include <pulsecore/opus-util.h>
+#endif
+
 #include "module-rtp-send-symdef.h"
 
 #include "rtp.h"
@@ -63,11 +68,13 @@ PA_MODULE_USAGE(
         "format=<sample format> "
         "channels=<number of channels> "
         "rate=<sample rate> "
-        "destination=<destination IP address> "
+        "destination=<comma separated list of destination IP addresses> "
         "port=<port number> "
         "mtu=<maximum transfer unit> "
         "loop=<loopback to local host?> "
-        "ttl=<ttl value>"
+        "ttl=<ttl value> "
+        "compression=<none or opus> "
+        "bitrate=<bits per second for compressed streams>"
 );
 
 #define DEFAULT_PORT 46000
@@ -88,6 +95,8 @@ static const char* const valid_modargs[] = {
     "mtu" ,
     "loop",
     "ttl",
+    "compression",
+    "bitrate",
     NULL
 };
 
@@ -98,9 +107,14 @@ struct userdata {
     pa_memblockq *memblockq;
 
     pa_rtp_context rtp_context;
-    pa_sap_context sap_context;
+    pa_sap_context sap_context[PA_RTP_DESTINATIONS_MAX];
+    unsigned n_destinations;
     size_t mtu;
 
+#ifdef HAVE_OPUS
+    pa_opus_encoder *encoder;
+#endif
+
     pa_time_event *sap_event;
 };
 
@@ -113,6 +127,11 @@ static int source_output_process_msg(pa_msgobject *o, int code, void *data, int6
         case PA_SOURCE_OUTPUT_MESSAGE_GET_LATENCY:
             *((pa_usec_t*) data) = pa_bytes_to_usec(pa_memblockq_get_length(u->memblockq), &u->source_output->sample_spec);
 
+#ifdef HAVE_OPUS
+            if (u->encoder)
+                *((pa_usec_t*) data) += pa_bytes_to_usec(pa_opus_encoder_get_pending(u->encoder), &u->source_output->sample_spec);
+#endif
+
             /* Fall through, the default handler will add in the extra
              * latency added by the resampler */
             break;
@@ -121,12 +140,50 @@ static int source_output_process_msg(pa_msgobject *o, int code, void *data, int6
     return pa_source_output_process_msg(o, code, data, offset, chunk);
 }
 
+#ifdef HAVE_OPUS
+/* Called from I/O thread context */
+static void send_encoded(struct userdata *u, const pa_memchunk *chunk) {
+    pa_memchunk out, packet;
+    uint32_t samples;
+    size_t i;
+
+    if (pa_opus_encoder_encode(u->encoder, chunk, &out) < 0 || !out.memblock)
+        return;
+
+    samples = (uint32_t) (pa_opus_encoder_get_frame_size(u->encoder) / pa_frame_size(&u->source_output->sample_spec));
+
+    /* Each frame goes into a packet of its own, without the 16 bit
+     * length it is prefixed with */
+    packet.memblock = out.memblock;
+
+    for (i = 0; i < out.length; i += 2 + packet.length) {
+        const uint8_t *d;
+
+        d = (const uint8_t*) pa_memblock_acquire(out.memblock) + out.index + i;
+        packet.length = ((size_t) d[0] << 8) | (size_t) d[1];
+        pa_memblock_release(out.memblock);
+
+        packet.index = out.index + i + 2;
+        pa_rtp_send_packet(&u->rtp_context, &packet, samples);
+    }
+
+    pa_memblock_unref(out.memblock);
+}
+#endif
+
 /* Called from I/O thread context */
 static void source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
     struct userdata *u;
     pa_source_output_assert_ref(o);
     pa_assert_se(u = o->userdata);
 
+#ifdef HAVE_OPUS
+    if (u->encoder) {
+        send_encoded(u, chunk);
+        return;
+    }
+#endif
+
     if (pa_memblockq_push(u->memblockq, chunk) < 0) {
         pa_log_warn("Failed to push chunk into memblockq.");
         return;
@@ -150,43 +207,82 @@ static void source_output_kill(pa_source_output* o) {
 
 static void sap_event_cb(pa_mainloop_api *m, pa_time_event *t, const struct timeval *tv, void *userdata) {
     struct userdata *u = userdata;
+    unsigned i;
 
     pa_assert(m);
     pa_assert(t);
     pa_assert(u);
 
-    pa_sap_send(&u->sap_context, 0);
+    for (i = 0; i < u->n_destinations; i++)
+        pa_sap_send(&u->sap_context[i], 0);
 
     pa_core_rttime_restart(u->module->core, t, pa_rtclock_now() + SAP_INTERVAL);
 }
 
+/* Fills in the addresses of the stream and of its announcements */
+static int parse_destination(const char *dest, uint32_t port, struct sockaddr_storage *sa, struct sockaddr_storage *sap_sa, socklen_t *salen) {
+    struct sockaddr_in *sa4 = (struct sockaddr_in*) sa;
+#ifdef HAVE_IPV6
+    struct sockaddr_in6 *sa6 = (struct sockaddr_in6*) sa;
+#endif
+
+    memset(sa, 0, sizeof(*sa));
+
+    if (inet_pton(AF_INET, dest, &sa4->sin_addr) > 0) {
+        sa4->sin_family = AF_INET;
+        sa4->sin_port = htons((uint16_t) port);
+        *salen = sizeof(*sa4);
+        *sap_sa = *sa;
+        ((struct sockaddr_in*) sap_sa)->sin_port = htons(SAP_PORT);
+#ifdef HAVE_IPV6
+    } else if (inet_pton(AF_INET6, dest, &sa6->sin6_addr) > 0) {
+        sa6->sin6_family = AF_INET6;
+        sa6->sin6_port = htons((uint16_t) port);
+        *salen = sizeof(*sa6);
+        *sap_sa = *sa;
+        ((struct sockaddr_in6*) sap_sa)->sin6_port = htons(SAP_PORT);
+#endif
+    } else
+        return -1;
+
+    return sa->ss_family;
+}
+
 int pa__init(pa_module*m) {
     struct userdata *u;
     pa_modargs *ma = NULL;
-    const char *dest;
+    const char *dests, *state;
+    char *dest;
     uint32_t port = DEFAULT_PORT, mtu;
     uint32_t ttl = DEFAULT_TTL;
-    sa_family_t af;
-    int fd = -1, sap_fd = -1;
+    int af = AF_UNSPEC;
+    int fd = -1, sap_fd[PA_RTP_DESTINATIONS_MAX];
     pa_source *s;
     pa_sample_spec ss;
     pa_channel_map cm;
-    struct sockaddr_in sa4, sap_sa4;
-#ifdef HAVE_IPV6
-    struct sockaddr_in6 sa6, sap_sa6;
-#endif
-    struct sockaddr_storage sa_dst;
+    struct sockaddr_storage sa[PA_RTP_DESTINATIONS_MAX], sap_sa[PA_RTP_DESTINATIONS_MAX], sa_dst;
+    socklen_t salen[PA_RTP_DESTINATIONS_MAX];
+    unsigned i, n_dests = 0;
     pa_source_output *o = NULL;
     uint8_t payload;
-    char *p;
+    char *p[PA_RTP_DESTINATIONS_MAX];
     int r, j;
     socklen_t k;
     char hn[128], *n;
     pa_bool_t loop = FALSE;
     pa_source_output_new_data data;
+    const char *compression;
+    pa_encoding_t encoding = PA_ENCODING_PCM;
+#ifdef HAVE_OPUS
+    uint32_t bitrate = 0;
+    pa_opus_encoder *encoder = NULL;
+#endif
 
     pa_assert(m);
 
+    for (i = 0; i < PA_RTP_DESTINATIONS_MAX; i++)
+        sap_fd[i] = -1;
+
     if (!(ma = pa_modargs_new(m->argument, valid_modargs))) {
         pa_log("Failed to parse module arguments");
         goto fail;
@@ -210,7 +306,30 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
-    if (!pa_rtp_sample_spec_valid(&ss)) {
+    compression = pa_modargs_get_value(ma, "compression", "none");
+
+    if (pa_streq(compression, "opus")) {
+#ifdef HAVE_OPUS
+        if (pa_modargs_get_value_u32(ma, "bitrate", &bitrate) < 0) {
+            pa_log("Invalid bitrate");
+            goto fail;
+        }
+
+        /* The RTP clock of Opus always runs at 48 kHz */
+        encoding = PA_ENCODING_OPUS;
+        ss.format = PA_SAMPLE_S16NE;
+        ss.rate = 48000;
+        ss.channels = PA_MIN(ss.channels, 2);
+#else
+        pa_log("Opus support not available.");
+        goto fail;
+#endif
+    } else if (!pa_streq(compression, "none")) {
+        pa_log("Invalid compression %s", compression);
+        goto fail;
+    }
+
+    if (encoding == PA_ENCODING_PCM && !pa_rtp_sample_spec_valid(&ss)) {
         pa_log("Specified sample type not compatible with RTP");
         goto fail;
     }
@@ -218,7 +337,8 @@ int pa__init(pa_module*m) {
     if (ss.channels != cm.channels)
         pa_channel_map_init_auto(&cm, ss.channels, PA_CHANNEL_MAP_AIFF);
 
-    payload = pa_rtp_payload_from_sample_spec(&ss);
+    /* Opus always gets a dynamic payload type */
+    payload = encoding == PA_ENCODING_PCM ? pa_rtp_payload_from_sample_spec(&ss) : 127;
 
     mtu = (uint32_t) pa_frame_align(DEFAULT_MTU, &ss);
 
@@ -241,58 +361,56 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
-    dest = pa_modargs_get_value(ma, "destination", DEFAULT_DESTINATION);
+    /* All destinations get the very same packets from one socket, hence
+     * they have to share the address family, port and TTL */
+    dests = pa_modargs_get_value(ma, "destination", DEFAULT_DESTINATION);
+    state = NULL;
 
-    if (inet_pton(AF_INET, dest, &sa4.sin_addr) > 0) {
-        sa4.sin_family = af = AF_INET;
-        sa4.sin_port = htons((uint16_t) port);
-        sap_sa4 = sa4;
-        sap_sa4.sin_port = htons(SAP_PORT);
-#ifdef HAVE_IPV6
-    } else if (inet_pton(AF_INET6, dest, &sa6.sin6_addr) > 0) {
-        sa6.sin6_family = af = AF_INET6;
-        sa6.sin6_port = htons((uint16_t) port);
-        sap_sa6 = sa6;
-        sap_sa6.sin6_port = htons(SAP_PORT);
-#endif
-    } else {
-        pa_log("Invalid destination '%s'", dest);
-        goto fail;
-    }
+    while ((dest = pa_split(dests, ",", &state))) {
+        int daf;
 
-    if ((fd = pa_socket_cloexec(af, SOCK_DGRAM, 0)) < 0) {
-        pa_log("socket() failed: %s", pa_cstrerror(errno));
-        goto fail;
+        if (n_dests >= PA_RTP_DESTINATIONS_MAX) {
+            pa_log("Too many destinations, at most %u are supported.", PA_RTP_DESTINATIONS_MAX);
+            pa_xfree(dest);
+            goto fail;
+        }
+
+        if ((daf = parse_destination(dest, port, &sa[n_dests], &sap_sa[n_dests], &salen[n_dests])) < 0) {
+            pa_log("Invalid destination '%s'", dest);
+            pa_xfree(dest);
+            goto fail;
+        }
+
+        pa_xfree(dest);
+
+        if (n_dests > 0 && daf != af) {
+            pa_log("All destinations need to be of the same address family.");
+            goto fail;
+        }
+
+        af = daf;
+        n_dests++;
     }
 
-    if (af == AF_INET && connect(fd, (struct sockaddr*) &sa4, sizeof(sa4)) < 0) {
-        pa_log("connect() failed: %s", pa_cstrerror(errno));
+    if (n_dests <= 0) {
+        pa_log("No destination specified.");
         goto fail;
-#ifdef HAVE_IPV6
-    } else if (af == AF_INET6 && connect(fd, (struct sockaddr*) &sa6, sizeof(sa6)) < 0) {
-        pa_log("connect() failed: %s", pa_cstrerror(errno));
-        goto fail;
-#endif
     }
 
-    if ((sap_fd = pa_socket_cloexec(af, SOCK_DGRAM, 0)) < 0) {
+    if ((fd = pa_socket_cloexec(af, SOCK_DGRAM, 0)) < 0) {
         pa_log("socket() failed: %s", pa_cstrerror(errno));
         goto fail;
     }
 
-    if (af == AF_INET && connect(sap_fd, (struct sockaddr*) &sap_sa4, sizeof(sap_sa4)) < 0) {
-        pa_log("connect() failed: %s", pa_cstrerror(errno));
-        goto fail;
-#ifdef HAVE_IPV6
-    } else if (af == AF_INET6 && connect(sap_fd, (struct sockaddr*) &sap_sa6, sizeof(sap_sa6)) < 0) {
+    /* With a single destination the socket stays connected, otherwise
+     * every packet is addressed explicitly */
+    if (n_dests == 1 && connect(fd, (struct sockaddr*) &sa[0], salen[0]) < 0) {
         pa_log("connect() failed: %s", pa_cstrerror(errno));
         goto fail;
-#endif
     }
 
     j = !!loop;
-    if (setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &j, sizeof(j)) < 0 ||
-        setsockopt(sap_fd, IPPROTO_IP, IP_MULTICAST_LOOP, &j, sizeof(j)) < 0) {
+    if (setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &j, sizeof(j)) < 0) {
         pa_log("IP_MULTICAST_LOOP failed: %s", pa_cstrerror(errno));
         goto fail;
     }
@@ -304,20 +422,47 @@ int pa__init(pa_module*m) {
             pa_log("IP_MULTICAST_TTL failed: %s", pa_cstrerror(errno));
             goto fail;
         }
+    }
 
-        if (setsockopt(sap_fd, IPPROTO_IP, IP_MULTICAST_TTL, &_ttl, sizeof(_ttl)) < 0) {
-            pa_log("IP_MULTICAST_TTL (sap) failed: %s", pa_cstrerror(errno));
+    /* Each destination is announced on its own */
+    for (i = 0; i < n_dests; i++) {
+        if ((sap_fd[i] = pa_socket_cloexec(af, SOCK_DGRAM, 0)) < 0) {
+            pa_log("socket() failed: %s", pa_cstrerror(errno));
             goto fail;
         }
+
+        if (connect(sap_fd[i], (struct sockaddr*) &sap_sa[i], salen[i]) < 0) {
+            pa_log("connect() failed: %s", pa_cstrerror(errno));
+            goto fail;
+        }
+
+        if (setsockopt(sap_fd[i], IPPROTO_IP, IP_MULTICAST_LOOP, &j, sizeof(j)) < 0) {
+            pa_log("IP_MULTICAST_LOOP failed: %s", pa_cstrerror(errno));
+            goto fail;
+        }
+
+        if (ttl != DEFAULT_TTL) {
+            int _ttl = (int) ttl;
+
+            if (setsockopt(sap_fd[i], IPPROTO_IP, IP_MULTICAST_TTL, &_ttl, sizeof(_ttl)) < 0) {
+                pa_log("IP_MULTICAST_TTL (sap) failed: %s", pa_cstrerror(errno));
+                goto fail;
+            }
+        }
     }
 
     /* If the socket queue is full, let's drop packets */
     pa_make_fd_nonblock(fd);
     pa_make_udp_socket_low_delay(fd);
 
+#ifdef HAVE_OPUS
+    if (encoding == PA_ENCODING_OPUS && !(encoder = pa_opus_encoder_new(m->core->mempool, &ss, bitrate)))
+        goto fail;
+#endif
+
     pa_source_output_new_data_init(&data);
     pa_proplist_sets(data.proplist, PA_PROP_MEDIA_NAME, "RTP Monitor Stream");
-    pa_proplist_sets(data.proplist, "rtp.destination", dest);
+    pa_proplist_sets(data.proplist, "rtp.destination", dests);
     pa_proplist_setf(data.proplist, "rtp.mtu", "%lu", (unsigned long) mtu);
     pa_proplist_setf(data.proplist, "rtp.port", "%lu", (unsigned long) port);
     pa_proplist_setf(data.proplist, "rtp.ttl", "%lu", (unsigned long) ttl);
@@ -340,12 +485,21 @@ int pa__init(pa_module*m) {
     o->push = source_output_push;
     o->kill = source_output_kill;
 
+#ifdef HAVE_OPUS
+    /* A packet always carries a single frame */
+    if (encoder)
+        mtu = (uint32_t) pa_opus_encoder_get_frame_size(encoder);
+#endif
+
     pa_log_info("Configured source latency of %llu ms.",
                 (unsigned long long) pa_source_output_set_requested_latency(o, pa_bytes_to_usec(mtu, &o->sample_spec)) / PA_USEC_PER_MSEC);
 
     m->userdata = o->userdata = u = pa_xnew(struct userdata, 1);
     u->module = m;
     u->source_output = o;
+#ifdef HAVE_OPUS
+    u->encoder = encoder;
+#endif
 
     u->memblockq = pa_memblockq_new(
             "module-rtp-send memblockq",
@@ -360,34 +514,47 @@ int pa__init(pa_module*m) {
 
     u->mtu = mtu;
 
-    k = sizeof(sa_dst);
-    pa_assert_se((r = getsockname(fd, (struct sockaddr*) &sa_dst, &k)) >= 0);
-
     n = pa_sprintf_malloc("PulseAudio RTP Stream on %s", pa_get_fqdn(hn, sizeof(hn)));
 
-    if (af == AF_INET) {
-        p = pa_sdp_build(af,
-                     (void*) &((struct sockaddr_in*) &sa_dst)->sin_addr,
-                     (void*) &sa4.sin_addr,
-                     n, (uint16_t) port, payload, &ss);
+    /* The announcement socket is connected to the same host as the
+     * stream, so it knows the source address the stream is sent from */
+    for (i = 0; i < n_dests; i++) {
+        k = sizeof(sa_dst);
+        pa_assert_se((r = getsockname(sap_fd[i], (struct sockaddr*) &sa_dst, &k)) >= 0);
+
+        if (af == AF_INET) {
+            p[i] = pa_sdp_build(af,
+                                (void*) &((struct sockaddr_in*) &sa_dst)->sin_addr,
+                                (void*) &((struct sockaddr_in*) &sa[i])->sin_addr,
+                                n, (uint16_t) port, payload, encoding, &ss);
 #ifdef HAVE_IPV6
-    } else {
-        p = pa_sdp_build(af,
-                     (void*) &((struct sockaddr_in6*) &sa_dst)->sin6_addr,
-                     (void*) &sa6.sin6_addr,
-                     n, (uint16_t) port, payload, &ss);
+        } else {
+            p[i] = pa_sdp_build(af,
+                                (void*) &((struct sockaddr_in6*) &sa_dst)->sin6_addr,
+                                (void*) &((struct sockaddr_in6*) &sa[i])->sin6_addr,
+                                n, (uint16_t) port, payload, encoding, &ss);
 #endif
+        }
     }
 
     pa_xfree(n);
 
     pa_rtp_context_init_send(&u->rtp_context, fd, m->core->cookie, payload, pa_frame_size(&ss));
-    pa_sap_context_init_send(&u->sap_context, sap_fd, p);
 
-    pa_log_info("RTP stream initialized with mtu %u on %s:%u ttl=%u, SSRC=0x%08x, payload=%u, initial sequence #%u", mtu, dest, port, ttl, u->rtp_context.ssrc, payload, u->rtp_context.sequence);
-    pa_log_info("SDP-Data:\n%s\nEOF", p);
+    if (n_dests > 1)
+        for (i = 0; i < n_dests; i++)
+            pa_assert_se(pa_rtp_context_add_destination(&u->rtp_context, (struct sockaddr*) &sa[i], salen[i]) >= 0);
+
+    u->n_destinations = n_dests;
+
+    pa_log_info("RTP stream initialized with mtu %u on %s:%u ttl=%u, SSRC=0x%08x, payload=%u, initial sequence #%u", mtu, dests, port, ttl, u->rtp_context.ssrc, payload, u->rtp_context.sequence);
+
+    for (i = 0; i < n_dests; i++) {
+        pa_sap_context_init_send(&u->sap_context[i], sap_fd[i], p[i]);
+        pa_log_info("SDP-Data:\n%s\nEOF", p[i]);
 
-    pa_sap_send(&u->sap_context, 0);
+        pa_sap_send(&u->sap_context[i], 0);
+    }
 
     u->sap_event = pa_core_rttime_new(m->core, pa_rtclock_now() + SAP_INTERVAL, sap_event_cb, u);
 
@@ -404,8 +571,14 @@ fail:
     if (fd >= 0)
         pa_close(fd);
 
-    if (sap_fd >= 0)
-        pa_close(sap_fd);
+    for (i = 0; i < PA_RTP_DESTINATIONS_MAX; i++)
+        if (sap_fd[i] >= 0)
+            pa_close(sap_fd[i]);
+
+#ifdef HAVE_OPUS
+    if (encoder)
+        pa_opus_encoder_free(encoder);
+#endif
 
     if (o) {
         pa_source_output_unlink(o);
@@ -417,6 +590,7 @@ fail:
 
 void pa__done(pa_module*m) {
     struct userdata *u;
+    unsigned i;
     pa_assert(m);
 
     if (!(u = m->userdata))
@@ -432,11 +606,18 @@ void pa__done(pa_module*m) {
 
     pa_rtp_context_destroy(&u->rtp_context);
 
-    pa_sap_send(&u->sap_context, 1);
-    pa_sap_context_destroy(&u->sap_context);
+    for (i = 0; i < u->n_destinations; i++) {
+        pa_sap_send(&u->sap_context[i], 1);
+        pa_sap_context_destroy(&u->sap_context[i]);
+    }
 
     if (u->memblockq)
         pa_memblockq_free(u->memblockq);
 
+#ifdef HAVE_OPUS
+    if (u->encoder)
+        pa_opus_encoder_free(u->encoder);
+#endif
+
     pa_xfree(u);
 }
@@ -58,94 +58,234 @@ pa_rtp_context* pa_rtp_context_init_send(pa_rtp_context *c, int fd, uint32_t ssr
 
     pa_memchunk_reset(&c->memchunk);
 
+    c->n_destinations = 0;
+
+    c->received_block = NULL;
+    c->n_received = c->next_received = 0;
+
     return c;
 }
 
+int pa_rtp_context_add_destination(pa_rtp_context *c, const struct sockaddr *sa, socklen_t salen) {
+    pa_assert(c);
+    pa_assert(sa);
+    pa_assert(salen > 0 && salen <= sizeof(struct sockaddr_storage));
+
+    if (c->n_destinations >= PA_RTP_DESTINATIONS_MAX)
+        return -1;
+
+    memcpy(&c->destinations[c->n_destinations], sa, salen);
+    c->destination_lengths[c->n_destinations] = salen;
+    c->n_destinations++;
+
+    return 0;
+}
+
 #define MAX_IOVECS 16
 
-int pa_rtp_send(pa_rtp_context *c, size_t size, pa_memblockq *q) {
-    struct iovec iov[MAX_IOVECS];
-    pa_memblock* mb[MAX_IOVECS];
-    int iov_idx = 1;
-    size_t n = 0;
+/* Large enough for the SCM_TIMESTAMP of a single packet */
+#define AUX_SIZE 128
 
-    pa_assert(c);
-    pa_assert(size > 0);
-    pa_assert(q);
+/* Fills n_iov vectors starting at iov straight from the memblocks in
+ * the queue, up to size bytes. The memblocks are acquired and added to
+ * mb, so that they stay around until the packet has been sent. Returns
+ * the number of bytes taken from the queue. */
+static size_t build_packet(pa_rtp_context *c, size_t size, pa_memblockq *q, struct iovec *iov, unsigned *n_iov, pa_memblock **mb, unsigned *n_mb) {
+    size_t n = 0;
 
-    if (pa_memblockq_get_length(q) < size)
-        return 0;
+    *n_iov = 0;
 
-    for (;;) {
-        int r;
+    while (n < size && *n_iov < MAX_IOVECS - 1) {
         pa_memchunk chunk;
+        size_t k;
 
         pa_memchunk_reset(&chunk);
 
-        if ((r = pa_memblockq_peek(q, &chunk)) >= 0) {
+        if (pa_memblockq_peek(q, &chunk) < 0)
+            break;
 
-            size_t k = n + chunk.length > size ? size - n : chunk.length;
+        pa_assert(chunk.memblock);
 
-            pa_assert(chunk.memblock);
+        k = PA_MIN(chunk.length, size - n);
 
-            iov[iov_idx].iov_base = ((uint8_t*) pa_memblock_acquire(chunk.memblock) + chunk.index);
-            iov[iov_idx].iov_len = k;
-            mb[iov_idx] = chunk.memblock;
-            iov_idx ++;
+        iov[*n_iov].iov_base = ((uint8_t*) pa_memblock_acquire(chunk.memblock) + chunk.index);
+        iov[*n_iov].iov_len = k;
+        (*n_iov)++;
 
-            n += k;
-            pa_memblockq_drop(q, k);
-        }
+        mb[(*n_mb)++] = chunk.memblock;
 
-        pa_assert(n % c->frame_size == 0);
+        n += k;
+        pa_memblockq_drop(q, k);
+    }
+
+    pa_assert(n % c->frame_size == 0);
+
+    return n;
+}
+
+/* Sends a batch of packets to a single destination, returns the
+ * number of packets that made it into the socket queue */
+static int send_batch(pa_rtp_context *c, struct msghdr *m, unsigned n) {
+#ifdef HAVE_SENDMMSG
+    struct mmsghdr mm[PA_RTP_BATCH_MAX];
+    unsigned i;
+    int r;
+
+    for (i = 0; i < n; i++) {
+        mm[i].msg_hdr = m[i];
+        mm[i].msg_len = 0;
+    }
+
+    for (i = 0; i < n; i += (unsigned) r)
+        if ((r = sendmmsg(c->fd, mm + i, n - i, MSG_DONTWAIT)) <= 0)
+            return i > 0 ? (int) i : -1;
+
+    return (int) n;
+#else
+    unsigned i;
+
+    for (i = 0; i < n; i++)
+        if (sendmsg(c->fd, &m[i], MSG_DONTWAIT) < 0)
+            return i > 0 ? (int) i : -1;
 
-        if (r < 0 || n >= size || iov_idx >= MAX_IOVECS) {
-            uint32_t header[3];
-            struct msghdr m;
-            ssize_t k;
-            int i;
+    return (int) n;
+#endif
+}
 
-            if (n > 0) {
-                header[0] = htonl(((uint32_t) 2 << 30) | ((uint32_t) c->payload << 16) | ((uint32_t) c->sequence));
-                header[1] = htonl(c->timestamp);
-                header[2] = htonl(c->ssrc);
+/* Sends a batch of packets to all destinations. Only the addresses of
+ * the messages are changed in between, the packets themselves are
+ * shared. Returns negative if no packet made it to some destination. */
+static int send_packets(pa_rtp_context *c, struct msghdr *m, unsigned n) {
+    unsigned i, j;
+    int ret = 0;
 
-                iov[0].iov_base = (void*)header;
-                iov[0].iov_len = sizeof(header);
+    pa_assert(n <= PA_RTP_BATCH_MAX);
 
-                m.msg_name = NULL;
-                m.msg_namelen = 0;
-                m.msg_iov = iov;
-                m.msg_iovlen = (size_t) iov_idx;
-                m.msg_control = NULL;
-                m.msg_controllen = 0;
-                m.msg_flags = 0;
+    if (c->n_destinations <= 0)
+        return send_batch(c, m, n);
 
-                k = sendmsg(c->fd, &m, MSG_DONTWAIT);
+    for (i = 0; i < c->n_destinations; i++) {
+        for (j = 0; j < n; j++) {
+            m[j].msg_name = &c->destinations[i];
+            m[j].msg_namelen = c->destination_lengths[i];
+        }
 
-                for (i = 1; i < iov_idx; i++) {
-                    pa_memblock_release(mb[i]);
-                    pa_memblock_unref(mb[i]);
-                }
+        if (send_batch(c, m, n) < 0)
+            ret = -1;
+    }
 
-                c->sequence++;
-            } else
-                k = 0;
+    return ret;
+}
 
-            c->timestamp += (unsigned) (n/c->frame_size);
+int pa_rtp_send(pa_rtp_context *c, size_t size, pa_memblockq *q) {
+    struct iovec iov[PA_RTP_BATCH_MAX][MAX_IOVECS];
+    uint32_t header[PA_RTP_BATCH_MAX][3];
+    struct msghdr m[PA_RTP_BATCH_MAX];
+    pa_memblock* mb[PA_RTP_BATCH_MAX * (MAX_IOVECS - 1)];
+    unsigned n_packets = 0, n_mb = 0, i;
+    int ret = 0;
 
-            if (k < 0) {
+    pa_assert(c);
+    pa_assert(size > 0);
+    pa_assert(q);
+
+    while (pa_memblockq_get_length(q) >= size) {
+        unsigned n_iov;
+        size_t n;
+        pa_bool_t last;
+
+        /* The header goes first, the payload follows right from the
+         * memblocks */
+        n = build_packet(c, size, q, iov[n_packets] + 1, &n_iov, mb, &n_mb);
+        last = n <= 0 || pa_memblockq_get_length(q) < size;
+
+        if (n > 0) {
+            header[n_packets][0] = htonl(((uint32_t) 2 << 30) | ((uint32_t) c->payload << 16) | ((uint32_t) c->sequence));
+            header[n_packets][1] = htonl(c->timestamp);
+            header[n_packets][2] = htonl(c->ssrc);
+
+            iov[n_packets][0].iov_base = (void*) header[n_packets];
+            iov[n_packets][0].iov_len = sizeof(header[n_packets]);
+
+            m[n_packets].msg_name = NULL;
+            m[n_packets].msg_namelen = 0;
+            m[n_packets].msg_iov = iov[n_packets];
+            m[n_packets].msg_iovlen = (size_t) n_iov + 1;
+            m[n_packets].msg_control = NULL;
+            m[n_packets].msg_controllen = 0;
+            m[n_packets].msg_flags = 0;
+
+            n_packets++;
+            c->sequence++;
+        }
+
+        c->timestamp += (unsigned) (n/c->frame_size);
+
+        if (n_packets >= PA_RTP_BATCH_MAX || (last && n_packets > 0)) {
+
+            if (send_packets(c, m, n_packets) < 0) {
                 if (errno != EAGAIN && errno != EINTR) /* If the queue is full, just ignore it */
                     pa_log("sendmsg() failed: %s", pa_cstrerror(errno));
-                return -1;
+                ret = -1;
             }
 
-            if (r < 0 || pa_memblockq_get_length(q) < size)
-                break;
+            for (i = 0; i < n_mb; i++) {
+                pa_memblock_release(mb[i]);
+                pa_memblock_unref(mb[i]);
+            }
 
-            n = 0;
-            iov_idx = 1;
+            n_packets = n_mb = 0;
+
+            if (ret < 0)
+                break;
         }
+
+        if (last)
+            break;
+    }
+
+    pa_assert(n_packets == 0 && n_mb == 0);
+
+    return ret;
+}
+
+int pa_rtp_send_packet(pa_rtp_context *c, const pa_memchunk *chunk, uint32_t samples) {
+    struct iovec iov[2];
+    uint32_t header[3];
+    struct msghdr m;
+    int k;
+
+    pa_assert(c);
+    pa_assert(chunk);
+    pa_assert(chunk->memblock);
+
+    header[0] = htonl(((uint32_t) 2 << 30) | ((uint32_t) c->payload << 16) | ((uint32_t) c->sequence));
+    header[1] = htonl(c->timestamp);
+    header[2] = htonl(c->ssrc);
+
+    iov[0].iov_base = (void*) header;
+    iov[0].iov_len = sizeof(header);
+    iov[1].iov_base = (uint8_t*) pa_memblock_acquire(chunk->memblock) + chunk->index;
+    iov[1].iov_len = chunk->length;
+
+    m.msg_name = NULL;
+    m.msg_namelen = 0;
+    m.msg_iov = iov;
+    m.msg_iovlen = 2;
+    m.msg_control = NULL;
+    m.msg_controllen = 0;
+    m.msg_flags = 0;
+
+    k = send_packets(c, &m, 1);
+    pa_memblock_release(chunk->memblock);
+
+    c->sequence++;
+    c->timestamp += samples;
+
+    if (k < 0) {
+        if (errno != EAGAIN && errno != EINTR) /* If the queue is full, just ignore it */
+            pa_log("sendmsg() failed: %s", pa_cstrerror(errno));
+        return -1;
     }
 
     return 0;
@@ -158,33 +298,48 @@ pa_rtp_context* pa_rtp_context_init_recv(pa_rtp_context *c, int fd, size_t frame
     c->frame_size = frame_size;
 
     pa_memchunk_reset(&c->memchunk);
+
+    c->received_block = NULL;
+    c->n_received = c->next_received = 0;
+
     return c;
 }
 
-int pa_rtp_recv(pa_rtp_context *c, pa_memchunk *chunk, pa_mempool *pool, struct timeval *tstamp) {
-    int size;
-    struct msghdr m;
+static void find_tstamp(struct msghdr *m, struct timeval *tstamp) {
     struct cmsghdr *cm;
-    struct iovec iov;
-    uint32_t header;
-    unsigned cc;
-    ssize_t r;
-    uint8_t aux[1024];
-    pa_bool_t found_tstamp = FALSE;
 
-    pa_assert(c);
-    pa_assert(chunk);
+    for (cm = CMSG_FIRSTHDR(m); cm; cm = CMSG_NXTHDR(m, cm))
+        if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMP) {
+            memcpy(tstamp, CMSG_DATA(cm), sizeof(struct timeval));
+            return;
+        }
 
-    pa_memchunk_reset(chunk);
+    pa_log_warn("Couldn't find SCM_TIMESTAMP data in auxiliary recvmsg() data!");
+    memset(tstamp, 0, sizeof(*tstamp));
+}
+
+/* Receives as many packets as are queued, up to PA_RTP_BATCH_MAX, into
+ * consecutive slots of the receive memblock */
+static int receive_packets(pa_rtp_context *c, pa_mempool *pool) {
+    struct msghdr m[PA_RTP_BATCH_MAX];
+    struct iovec iov[PA_RTP_BATCH_MAX];
+    uint8_t aux[PA_RTP_BATCH_MAX][AUX_SIZE];
+    size_t lengths[PA_RTP_BATCH_MAX];
+    unsigned n, i;
+    uint8_t *d;
+    int size, r;
 
     if (ioctl(c->fd, FIONREAD, &size) < 0) {
         pa_log_warn("FIONREAD failed: %s", pa_cstrerror(errno));
-        goto fail;
+        return -1;
     }
 
     if (size <= 0)
         return 0;
 
+    /* FIONREAD only tells us about the first packet. Later ones are
+     * expected to be of the same size at most, as the sender fills all
+     * but the last of a burst up to the MTU. */
     if (c->memchunk.length < (unsigned) size) {
         size_t l;
 
@@ -200,38 +355,132 @@ int pa_rtp_recv(pa_rtp_context *c, pa_memchunk *chunk, pa_mempool *pool, struct
 
     pa_assert(c->memchunk.length >= (size_t) size);
 
-    chunk->memblock = pa_memblock_ref(c->memchunk.memblock);
-    chunk->index = c->memchunk.index;
+    n = (unsigned) PA_MIN(c->memchunk.length / (size_t) size, PA_RTP_BATCH_MAX);
+    d = (uint8_t*) pa_memblock_acquire(c->memchunk.memblock) + c->memchunk.index;
 
-    iov.iov_base = (uint8_t*) pa_memblock_acquire(chunk->memblock) + chunk->index;
-    iov.iov_len = (size_t) size;
+    for (i = 0; i < n; i++) {
+        iov[i].iov_base = d + i * (size_t) size;
+        iov[i].iov_len = (size_t) size;
 
-    m.msg_name = NULL;
-    m.msg_namelen = 0;
-    m.msg_iov = &iov;
-    m.msg_iovlen = 1;
-    m.msg_control = aux;
-    m.msg_controllen = sizeof(aux);
-    m.msg_flags = 0;
+        m[i].msg_name = NULL;
+        m[i].msg_namelen = 0;
+        m[i].msg_iov = &iov[i];
+        m[i].msg_iovlen = 1;
+        m[i].msg_control = aux[i];
+        m[i].msg_controllen = sizeof(aux[i]);
+        m[i].msg_flags = 0;
+    }
 
-    r = recvmsg(c->fd, &m, 0);
-    pa_memblock_release(chunk->memblock);
+#ifdef HAVE_RECVMMSG
+    {
+        struct mmsghdr mm[PA_RTP_BATCH_MAX];
 
-    if (r != size) {
+        for (i = 0; i < n; i++) {
+            mm[i].msg_hdr = m[i];
+            mm[i].msg_len = 0;
+        }
+
+        if ((r = recvmmsg(c->fd, mm, n, MSG_DONTWAIT, NULL)) > 0)
+            for (i = 0; i < (unsigned) r; i++) {
+                m[i] = mm[i].msg_hdr;
+                lengths[i] = mm[i].msg_len;
+            }
+    }
+#else
+    {
+        ssize_t l;
+
+        if ((l = recvmsg(c->fd, &m[0], 0)) >= 0) {
+            lengths[0] = (size_t) l;
+            r = 1;
+        } else
+            r = -1;
+    }
+#endif
+
+    pa_memblock_release(c->memchunk.memblock);
+
+    if (r <= 0) {
         if (r < 0 && errno != EAGAIN && errno != EINTR)
-            pa_log_warn("recvmsg() failed: %s", r < 0 ? pa_cstrerror(errno) : "size mismatch");
+            pa_log_warn("recvmsg() failed: %s", pa_cstrerror(errno));
+
+        return -1;
+    }
+
+    pa_assert(!c->received_block);
+    c->received_block = pa_memblock_ref(c->memchunk.memblock);
+    c->n_received = (unsigned) r;
+    c->next_received = 0;
+
+    for (i = 0; i < c->n_received; i++) {
+        c->received[i].index = c->memchunk.index + i * (size_t) size;
+
+        /* A packet bigger than the slot of the first one got cut off */
+        if (m[i].msg_flags & MSG_TRUNC) {
+            pa_log_warn("RTP packet too large.");
+            c->received[i].length = 0;
+        } else
+            c->received[i].length = lengths[i];
+
+        find_tstamp(&m[i], &c->received[i].tstamp);
+    }
+
+    c->memchunk.index += c->n_received * (size_t) size;
+    c->memchunk.length -= c->n_received * (size_t) size;
+
+    if (c->memchunk.length <= 0) {
+        pa_memblock_unref(c->memchunk.memblock);
+        pa_memchunk_reset(&c->memchunk);
+    }
 
-        goto fail;
+    return 0;
+}
+
+pa_bool_t pa_rtp_recv_pending(pa_rtp_context *c) {
+    pa_assert(c);
+
+    return c->next_received < c->n_received;
+}
+
+int pa_rtp_recv(pa_rtp_context *c, pa_memchunk *chunk, pa_mempool *pool, struct timeval *tstamp) {
+    uint32_t header;
+    unsigned cc;
+    size_t size;
+    const uint8_t *d;
+
+    pa_assert(c);
+    pa_assert(chunk);
+
+    pa_memchunk_reset(chunk);
+
+    if (!pa_rtp_recv_pending(c)) {
+        if (c->received_block) {
+            pa_memblock_unref(c->received_block);
+            c->received_block = NULL;
+        }
+
+        if (receive_packets(c, pool) < 0)
+            return -1;
+
+        if (!pa_rtp_recv_pending(c))
+            return -1;
     }
 
+    size = c->received[c->next_received].length;
+    chunk->index = c->received[c->next_received].index;
+    *tstamp = c->received[c->next_received].tstamp;
+    c->next_received++;
+
     if (size < 12) {
         pa_log_warn("RTP packet too short.");
-        goto fail;
+        return -1;
     }
 
-    memcpy(&header, iov.iov_base, sizeof(uint32_t));
-    memcpy(&c->timestamp, (uint8_t*) iov.iov_base + 4, sizeof(uint32_t));
-    memcpy(&c->ssrc, (uint8_t*) iov.iov_base + 8, sizeof(uint32_t));
+    d = (const uint8_t*) pa_memblock_acquire(c->received_block) + chunk->index;
+    memcpy(&header, d, sizeof(uint32_t));
+    memcpy(&c->timestamp, d + 4, sizeof(uint32_t));
+    memcpy(&c->ssrc, d + 8, sizeof(uint32_t));
+    pa_memblock_release(c->received_block);
 
     header = ntohl(header);
     c->timestamp = ntohl(c->timestamp);
@@ -239,63 +488,39 @@ int pa_rtp_recv(pa_rtp_context *c, pa_memchunk *chunk, pa_mempool *pool, struct
 
     if ((header >> 30) != 2) {
         pa_log_warn("Unsupported RTP version.");
-        goto fail;
+        return -1;
     }
 
     if ((header >> 29) & 1) {
         pa_log_warn("RTP padding not supported.");
-        goto fail;
+        return -1;
     }
 
     if ((header >> 28) & 1) {
         pa_log_warn("RTP header extensions not supported.");
-        goto fail;
+        return -1;
     }
 
     cc = (header >> 24) & 0xF;
     c->payload = (uint8_t) ((header >> 16) & 127U);
     c->sequence = (uint16_t) (header & 0xFFFFU);
 
-    if (12 + cc*4 > (unsigned) size) {
+    if (12 + cc*4 > size) {
         pa_log_warn("RTP packet too short. (CSRC)");
-        goto fail;
+        return -1;
     }
 
     chunk->index += 12 + cc*4;
-    chunk->length = (size_t) size - 12 + cc*4;
+    chunk->length = size - (12 + cc*4);
 
     if (chunk->length % c->frame_size != 0) {
         pa_log_warn("Bad RTP packet size.");
-        goto fail;
+        return -1;
     }
 
-    c->memchunk.index = chunk->index + chunk->length;
-    c->memchunk.length = pa_memblock_get_length(c->memchunk.memblock) - c->memchunk.index;
-
-    if (c->memchunk.length <= 0) {
-        pa_memblock_unref(c->memchunk.memblock);
-        pa_memchunk_reset(&c->memchunk);
-    }
-
-    for (cm = CMSG_FIRSTHDR(&m); cm; cm = CMSG_NXTHDR(&m, cm))
-        if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMP) {
-            memcpy(tstamp, CMSG_DATA(cm), sizeof(struct timeval));
-            found_tstamp = TRUE;
-            break;
-        }
-
-    if (!found_tstamp) {
-        pa_log_warn("Couldn't find SCM_TIMESTAMP data in auxiliary recvmsg() data!");
-        memset(tstamp, 0, sizeof(tstamp));
-    }
+    chunk->memblock = pa_memblock_ref(c->received_block);
 
     return 0;
-
-fail:
-    if (chunk->memblock)
-        pa_memblock_unref(chunk->memblock);
-
-    return -1;
 }
 
 uint8_t pa_rtp_payload_from_sample_spec(const pa_sample_spec *ss) {
@@ -368,7 +593,8 @@ int pa_rtp_sample_spec_valid(const pa_sample_spec *ss) {
         ss->format == PA_SAMPLE_U8 ||
         ss->format == PA_SAMPLE_ALAW ||
         ss->format == PA_SAMPLE_ULAW ||
-        ss->format == PA_SAMPLE_S16BE;
+        ss->format == PA_SAMPLE_S16BE ||
+        ss->format == PA_SAMPLE_S24BE;
 }
 
 void pa_rtp_context_destroy(pa_rtp_context *c) {
@@ -378,12 +604,17 @@ void pa_rtp_context_destroy(pa_rtp_context *c) {
 
     if (c->memchunk.memblock)
         pa_memblock_unref(c->memchunk.memblock);
+
+    if (c->received_block)
+        pa_memblock_unref(c->received_block);
 }
 
 const char* pa_rtp_format_to_string(pa_sample_format_t f) {
     switch (f) {
         case PA_SAMPLE_S16BE:
             return "L16";
+        case PA_SAMPLE_S24BE:
+            return "L24";
         case PA_SAMPLE_U8:
             return "L8";
         case PA_SAMPLE_ALAW:
@@ -400,6 +631,8 @@ pa_sample_format_t pa_rtp_string_to_format(const char *s) {
 
     if (!(strcmp(s, "L16")))
         return PA_SAMPLE_S16BE;
+    else if (!strcmp(s, "L24"))
+        return PA_SAMPLE_S24BE;
     else if (!strcmp(s, "L8"))
         return PA_SAMPLE_U8;
     else if (!strcmp(s, "PCMA"))
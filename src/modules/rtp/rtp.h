@@ -25,9 +25,17 @@
 #include <inttypes.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/time.h>
 #include <pulsecore/memblockq.h>
 #include <pulsecore/memchunk.h>
 
+/* Up to this many packets are sent or received with a single system
+ * call where sendmmsg()/recvmmsg() are available */
+#define PA_RTP_BATCH_MAX 16U
+
+/* A sending context can feed this many destinations from one socket */
+#define PA_RTP_DESTINATIONS_MAX 8
+
 typedef struct pa_rtp_context {
     int fd;
     uint16_t sequence;
@@ -37,16 +45,42 @@ typedef struct pa_rtp_context {
     size_t frame_size;
 
     pa_memchunk memchunk;
+
+    /* If empty, packets go to the peer of the connected socket */
+    struct sockaddr_storage destinations[PA_RTP_DESTINATIONS_MAX];
+    socklen_t destination_lengths[PA_RTP_DESTINATIONS_MAX];
+    unsigned n_destinations;
+
+    /* Packets received in one go that have not been handed out yet */
+    struct {
+        size_t index;
+        size_t length;
+        struct timeval tstamp;
+    } received[PA_RTP_BATCH_MAX];
+    unsigned n_received, next_received;
+    pa_memblock *received_block;
 } pa_rtp_context;
 
 pa_rtp_context* pa_rtp_context_init_send(pa_rtp_context *c, int fd, uint32_t ssrc, uint8_t payload, size_t frame_size);
 
+/* Sends every packet to sa too, on an unconnected socket. The header
+ * and payload of a packet are only built once for all destinations. */
+int pa_rtp_context_add_destination(pa_rtp_context *c, const struct sockaddr *sa, socklen_t salen);
+
 /* If the memblockq doesn't have a silence memchunk set, then the caller must
  * guarantee that the current read index doesn't point to a hole. */
 int pa_rtp_send(pa_rtp_context *c, size_t size, pa_memblockq *q);
 
+/* Sends the chunk as a single packet, for payloads that can't be split
+ * at arbitrary frames. The timestamp is advanced by samples. */
+int pa_rtp_send_packet(pa_rtp_context *c, const pa_memchunk *chunk, uint32_t samples);
+
 pa_rtp_context* pa_rtp_context_init_recv(pa_rtp_context *c, int fd, size_t frame_size);
+
+/* Returns one packet at a time. Check pa_rtp_recv_pending() afterwards,
+ * further packets might have been received along with it. */
 int pa_rtp_recv(pa_rtp_context *c, pa_memchunk *chunk, pa_mempool *pool, struct timeval *tstamp);
+pa_bool_t pa_rtp_recv_pending(pa_rtp_context *c);
 
 void pa_rtp_context_destroy(pa_rtp_context *c);
 
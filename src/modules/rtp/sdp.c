@@ -41,9 +41,14 @@
 #include "sdp.h"
 #include "rtp.h"
 
-char *pa_sdp_build(int af, const void *src, const void *dst, const char *name, uint16_t port, uint8_t payload, const pa_sample_spec *ss) {
+/* RFC 7587: Opus always uses a 48 kHz clock and is announced as
+ * stereo. Whether the sender actually encodes two channels is told in
+ * the format parameters. */
+#define OPUS_RATE 48000
+
+char *pa_sdp_build(int af, const void *src, const void *dst, const char *name, uint16_t port, uint8_t payload, pa_encoding_t encoding, const pa_sample_spec *ss) {
     uint32_t ntp;
-    char buf_src[64], buf_dst[64], un[64];
+    char buf_src[64], buf_dst[64], un[64], rtpmap[128];
     const char *u, *f;
 
     pa_assert(src);
@@ -55,7 +60,20 @@ char *pa_sdp_build(int af, const void *src, const void *dst, const char *name, u
     pa_assert(af == AF_INET);
 #endif
 
-    pa_assert_se(f = pa_rtp_format_to_string(ss->format));
+    if (encoding == PA_ENCODING_OPUS)
+        pa_snprintf(rtpmap, sizeof(rtpmap),
+                    "a=rtpmap:%i opus/%u/2\n"
+                    "a=fmtp:%i sprop-stereo=%i\n",
+                    payload, OPUS_RATE,
+                    payload, ss->channels > 1);
+    else {
+        pa_assert(encoding == PA_ENCODING_PCM);
+        pa_assert_se(f = pa_rtp_format_to_string(ss->format));
+
+        pa_snprintf(rtpmap, sizeof(rtpmap),
+                    "a=rtpmap:%i %s/%u/%u\n",
+                    payload, f, ss->rate, ss->channels);
+    }
 
     if (!(u = pa_get_user_name(un, sizeof(un))))
         u = "-";
@@ -73,24 +91,45 @@ char *pa_sdp_build(int af, const void *src, const void *dst, const char *name, u
             "t=%lu 0\n"
             "a=recvonly\n"
             "m=audio %u RTP/AVP %i\n"
-            "a=rtpmap:%i %s/%u/%u\n"
+            "%s"
             "a=type:broadcast\n",
             u, (unsigned long) ntp, af == AF_INET ? "IP4" : "IP6", buf_src,
             name,
             af == AF_INET ? "IP4" : "IP6", buf_dst,
             (unsigned long) ntp,
             port, payload,
-            payload, f, ss->rate, ss->channels);
+            rtpmap);
 }
 
-static pa_sample_spec *parse_sdp_sample_spec(pa_sample_spec *ss, char *c) {
+static pa_sample_spec *parse_sdp_sample_spec(pa_sample_spec *ss, pa_encoding_t *encoding, char *c) {
     unsigned rate, channels;
     pa_assert(ss);
+    pa_assert(encoding);
     pa_assert(c);
 
+    *encoding = PA_ENCODING_PCM;
+
+    if (pa_startswith(c, "opus/")) {
+
+        /* Always decode to what the rtpmap announces, the decoder
+         * takes care of mono streams */
+        if (sscanf(c + 5, "%u", &rate) != 1 || rate != OPUS_RATE)
+            return NULL;
+
+        *encoding = PA_ENCODING_OPUS;
+        ss->format = PA_SAMPLE_S16NE;
+        ss->rate = OPUS_RATE;
+        ss->channels = 2;
+
+        return ss;
+    }
+
     if (pa_startswith(c, "L16/")) {
         ss->format = PA_SAMPLE_S16BE;
         c += 4;
+    } else if (pa_startswith(c, "L24/")) {
+        ss->format = PA_SAMPLE_S24BE;
+        c += 4;
     } else if (pa_startswith(c, "L8/")) {
         ss->format = PA_SAMPLE_U8;
         c += 3;
@@ -106,7 +145,7 @@ static pa_sample_spec *parse_sdp_sample_spec(pa_sample_spec *ss, char *c) {
     if (sscanf(c, "%u/%u", &rate, &channels) == 2) {
         ss->rate = (uint32_t) rate;
         ss->channels = (uint8_t) channels;
-    } else if (sscanf(c, "%u", &rate) == 2) {
+    } else if (sscanf(c, "%u", &rate) == 1) {
         ss->rate = (uint32_t) rate;
         ss->channels = 1;
     } else
@@ -128,6 +167,7 @@ pa_sdp_info *pa_sdp_parse(const char *t, pa_sdp_info *i, int is_goodbye) {
     i->origin = i->session_name = NULL;
     i->salen = 0;
     i->payload = 255;
+    i->encoding = PA_ENCODING_PCM;
 
     if (!pa_startswith(t, PA_SDP_HEADER)) {
         pa_log("Failed to parse SDP data: invalid header.");
@@ -226,7 +266,7 @@ pa_sdp_info *pa_sdp_parse(const char *t, pa_sdp_info *i, int is_goodbye) {
 
                         c[strcspn(c, "\n")] = 0;
 
-                        if (parse_sdp_sample_spec(&i->sample_spec, c))
+                        if (parse_sdp_sample_spec(&i->sample_spec, &i->encoding, c))
                             ss_valid = TRUE;
                     }
                 }
@@ -0,0 +1,801 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <unistd.h>
+#include <errno.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/version.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/auth-cookie.h>
+#include <pulsecore/core-error.h>
+#include <pulsecore/core-rtclock.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/llist.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/native-common.h>
+#include <pulsecore/proplist-util.h>
+#include <pulsecore/pstream-util.h>
+#include <pulsecore/shared.h>
+#include <pulsecore/socket-client.h>
+
+#include "tunnel-connection.h"
+
+#define DEFAULT_TIMEOUT 5
+
+#define LATENCY_INTERVAL (1*PA_USEC_PER_SEC)
+
+/* The clock offset to the server is taken from the sample with the
+ * lowest round trip time among the last CLOCK_FILTER_SIZE, like NTP
+ * does. In between, it is extrapolated with the measured skew. */
+#define CLOCK_FILTER_SIZE 8
+#define CLOCK_SKEW_INTERVAL (30*PA_USEC_PER_SEC)
+#define CLOCK_SKEW_MAX 0.0005
+
+typedef struct connection {
+    pa_core *core;
+
+    /* The name in pa_shared, NULL once the connection died */
+    char *key;
+    char *server_name;
+
+    pa_auth_cookie *auth_cookie;
+    pa_socket_client *client;
+    pa_pstream *pstream;
+    pa_pdispatch *pdispatch;
+
+    uint32_t version;
+    uint32_t ctag;
+
+    pa_bool_t authenticated:1;
+    pa_bool_t dead:1;
+
+    char *user_name;
+    char *host_name;
+
+    /* Tells new links that the connection is ready */
+    pa_defer_event *announce_event;
+    pa_time_event *time_event;
+
+    struct {
+        pa_usec_t at;
+        pa_usec_t rtt;
+        int64_t offset;
+    } clock_samples[CLOCK_FILTER_SIZE];
+    unsigned n_clock_samples, clock_sample_idx;
+
+    /* Remote minus local wall clock time at clock_offset_at */
+    int64_t clock_offset;
+    pa_usec_t clock_offset_at;
+    double clock_skew;
+
+    int64_t clock_skew_ref_offset;
+    pa_usec_t clock_skew_ref_at;
+
+    PA_LLIST_HEAD(pa_tunnel_link, links);
+} connection;
+
+struct pa_tunnel_link {
+    connection *connection;
+
+    pa_bool_t record:1;
+    pa_bool_t announced:1;
+    uint32_t channel;
+
+    const pa_tunnel_link_callbacks *callbacks;
+    void *userdata;
+
+    PA_LLIST_FIELDS(pa_tunnel_link);
+};
+
+static void command_request(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
+static void command_stream(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
+static void command_subscribe_event(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
+static void command_client_event(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
+
+static const pa_pdispatch_cb_t command_table[PA_COMMAND_MAX] = {
+    [PA_COMMAND_REQUEST] = command_request,
+    [PA_COMMAND_REQUEST_MULTI] = command_request,
+    [PA_COMMAND_STARTED] = command_stream,
+    [PA_COMMAND_OVERFLOW] = command_stream,
+    [PA_COMMAND_UNDERFLOW] = command_stream,
+    [PA_COMMAND_PLAYBACK_STREAM_KILLED] = command_stream,
+    [PA_COMMAND_RECORD_STREAM_KILLED] = command_stream,
+    [PA_COMMAND_PLAYBACK_STREAM_SUSPENDED] = command_stream,
+    [PA_COMMAND_RECORD_STREAM_SUSPENDED] = command_stream,
+    [PA_COMMAND_PLAYBACK_STREAM_MOVED] = command_stream,
+    [PA_COMMAND_RECORD_STREAM_MOVED] = command_stream,
+    [PA_COMMAND_PLAYBACK_STREAM_EVENT] = command_stream,
+    [PA_COMMAND_RECORD_STREAM_EVENT] = command_stream,
+    [PA_COMMAND_PLAYBACK_BUFFER_ATTR_CHANGED] = command_stream,
+    [PA_COMMAND_RECORD_BUFFER_ATTR_CHANGED] = command_stream,
+    [PA_COMMAND_SUBSCRIBE_EVENT] = command_subscribe_event,
+    [PA_COMMAND_CLIENT_EVENT] = command_client_event
+};
+
+static void connection_free(connection *c) {
+    pa_assert(c);
+    pa_assert(!c->links);
+
+    if (c->key) {
+        pa_assert_se(pa_shared_remove(c->core, c->key) >= 0);
+        pa_xfree(c->key);
+    }
+
+    if (c->pstream) {
+        pa_pstream_unlink(c->pstream);
+        pa_pstream_unref(c->pstream);
+    }
+
+    if (c->pdispatch)
+        pa_pdispatch_unref(c->pdispatch);
+
+    if (c->client)
+        pa_socket_client_unref(c->client);
+
+    if (c->auth_cookie)
+        pa_auth_cookie_unref(c->auth_cookie);
+
+    if (c->announce_event)
+        c->core->mainloop->defer_free(c->announce_event);
+
+    if (c->time_event)
+        c->core->mainloop->time_free(c->time_event);
+
+    pa_xfree(c->server_name);
+    pa_xfree(c->user_name);
+    pa_xfree(c->host_name);
+    pa_xfree(c);
+}
+
+/* The links are freed by their owners, which are told here to go
+ * away */
+static void connection_fail(connection *c) {
+    pa_tunnel_link *l, *n;
+
+    pa_assert(c);
+
+    if (c->dead)
+        return;
+
+    c->dead = TRUE;
+    c->authenticated = FALSE;
+
+    /* Tunnels set up from now on get a new connection */
+    if (c->key) {
+        pa_assert_se(pa_shared_remove(c->core, c->key) >= 0);
+        pa_xfree(c->key);
+        c->key = NULL;
+    }
+
+    if (c->time_event) {
+        c->core->mainloop->time_free(c->time_event);
+        c->time_event = NULL;
+    }
+
+    c->core->mainloop->defer_enable(c->announce_event, 0);
+
+    for (l = c->links; l; l = n) {
+        n = l->next;
+        l->callbacks->died(l, l->userdata);
+    }
+}
+
+static pa_tunnel_link* find_link(connection *c, pa_bool_t record, uint32_t channel) {
+    pa_tunnel_link *l;
+
+    for (l = c->links; l; l = l->next)
+        if (l->record == record && l->channel == channel)
+            return l;
+
+    return NULL;
+}
+
+static int64_t timeval_diff_signed(const struct timeval *a, const struct timeval *b) {
+
+    if (pa_timeval_cmp(a, b) >= 0)
+        return (int64_t) pa_timeval_diff(a, b);
+
+    return -(int64_t) pa_timeval_diff(a, b);
+}
+
+static pa_usec_t update_clock(connection *c, const struct timeval *local, const struct timeval *remote, const struct timeval *now) {
+    pa_usec_t rtt, at;
+    int64_t offset, transport;
+    unsigned i, best;
+
+    pa_assert(c);
+
+    rtt = pa_timeval_cmp(now, local) > 0 ? pa_timeval_diff(now, local) : 0;
+    at = pa_timeval_load(now);
+
+    /* Assuming symmetric paths for this single sample */
+    c->clock_samples[c->clock_sample_idx].at = at;
+    c->clock_samples[c->clock_sample_idx].rtt = rtt;
+    c->clock_samples[c->clock_sample_idx].offset = timeval_diff_signed(remote, local) - (int64_t) (rtt / 2);
+    c->clock_sample_idx = (c->clock_sample_idx + 1) % CLOCK_FILTER_SIZE;
+
+    if (c->n_clock_samples < CLOCK_FILTER_SIZE)
+        c->n_clock_samples++;
+
+    /* The sample that was least delayed by queueing is the most
+     * accurate one */
+    best = 0;
+    for (i = 1; i < c->n_clock_samples; i++)
+        if (c->clock_samples[i].rtt < c->clock_samples[best].rtt)
+            best = i;
+
+    if (c->clock_samples[best].at != c->clock_offset_at) {
+        c->clock_offset = c->clock_samples[best].offset;
+        c->clock_offset_at = c->clock_samples[best].at;
+
+        if (c->clock_skew_ref_at <= 0) {
+            c->clock_skew_ref_offset = c->clock_offset;
+            c->clock_skew_ref_at = c->clock_offset_at;
+
+        } else if (c->clock_offset_at >= c->clock_skew_ref_at + CLOCK_SKEW_INTERVAL) {
+            double skew;
+
+            skew = (double) (c->clock_offset - c->clock_skew_ref_offset) / (double) (c->clock_offset_at - c->clock_skew_ref_at);
+            skew = PA_CLAMP(skew, -CLOCK_SKEW_MAX, CLOCK_SKEW_MAX);
+            c->clock_skew += (skew - c->clock_skew) / 4;
+
+            c->clock_skew_ref_offset = c->clock_offset;
+            c->clock_skew_ref_at = c->clock_offset_at;
+
+            pa_log_debug("Clock offset to %s %0.2f ms, skew %0.1f ppm, round trip %0.2f ms",
+                         c->server_name,
+                         (double) c->clock_offset / PA_USEC_PER_MSEC, c->clock_skew * 1000000,
+                         (double) rtt / PA_USEC_PER_MSEC);
+        }
+    }
+
+    /* With the offset known, the way back doesn't need to be guessed
+     * from the round trip time */
+    offset = c->clock_offset + (int64_t) (c->clock_skew * (double) (at - c->clock_offset_at));
+    transport = timeval_diff_signed(now, remote) + offset;
+
+    return (pa_usec_t) PA_CLAMP(transport, 0, (int64_t) rtt);
+}
+
+static void command_request(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    connection *c = userdata;
+    uint32_t bytes, channel;
+    pa_tunnel_link *l;
+
+    pa_assert(pd);
+    pa_assert(command == PA_COMMAND_REQUEST || command == PA_COMMAND_REQUEST_MULTI);
+    pa_assert(t);
+    pa_assert(c);
+
+    /* A PA_COMMAND_REQUEST_MULTI covers the streams of all links */
+    do {
+        if (pa_tagstruct_getu32(t, &channel) < 0 ||
+            pa_tagstruct_getu32(t, &bytes) < 0) {
+            pa_log("Invalid protocol reply");
+            connection_fail(c);
+            return;
+        }
+
+        /* The stream may just have been deleted */
+        if (!(l = find_link(c, FALSE, channel))) {
+            pa_log_debug("Received request for unknown channel %u.", channel);
+            continue;
+        }
+
+        l->callbacks->request(l, bytes, l->userdata);
+
+    } while (command == PA_COMMAND_REQUEST_MULTI && !pa_tagstruct_eof(t));
+}
+
+static void command_stream(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    connection *c = userdata;
+    uint32_t channel;
+    pa_bool_t record;
+    pa_tunnel_link *l;
+
+    pa_assert(pd);
+    pa_assert(t);
+    pa_assert(c);
+
+    if (pa_tagstruct_getu32(t, &channel) < 0) {
+        pa_log("Invalid packet.");
+        connection_fail(c);
+        return;
+    }
+
+    /* Playback and record streams are counted separately */
+    record =
+        command == PA_COMMAND_RECORD_STREAM_KILLED ||
+        command == PA_COMMAND_RECORD_STREAM_SUSPENDED ||
+        command == PA_COMMAND_RECORD_STREAM_MOVED ||
+        command == PA_COMMAND_RECORD_STREAM_EVENT ||
+        command == PA_COMMAND_RECORD_BUFFER_ATTR_CHANGED;
+
+    if (!(l = find_link(c, record, channel))) {
+        pa_log_debug("Received command for unknown channel %u.", channel);
+        return;
+    }
+
+    if (l->callbacks->command_table[command])
+        l->callbacks->command_table[command](pd, command, tag, t, l->userdata);
+}
+
+static void command_client_event(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_log_debug("Got client event.");
+}
+
+static void server_info_cb(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    connection *c = userdata;
+    pa_sample_spec ss;
+    pa_channel_map cm;
+    const char *server_name, *server_version, *user_name, *host_name, *default_sink_name, *default_source_name;
+    uint32_t cookie;
+    pa_tunnel_link *l;
+
+    pa_assert(pd);
+    pa_assert(c);
+
+    if (command != PA_COMMAND_REPLY) {
+        if (command == PA_COMMAND_ERROR)
+            pa_log("Failed to get info.");
+        else
+            pa_log("Protocol error.");
+        goto fail;
+    }
+
+    if (pa_tagstruct_gets(t, &server_name) < 0 ||
+        pa_tagstruct_gets(t, &server_version) < 0 ||
+        pa_tagstruct_gets(t, &user_name) < 0 ||
+        pa_tagstruct_gets(t, &host_name) < 0 ||
+        pa_tagstruct_get_sample_spec(t, &ss) < 0 ||
+        pa_tagstruct_gets(t, &default_sink_name) < 0 ||
+        pa_tagstruct_gets(t, &default_source_name) < 0 ||
+        pa_tagstruct_getu32(t, &cookie) < 0 ||
+        (c->version >= 15 && pa_tagstruct_get_channel_map(t, &cm) < 0)) {
+
+        pa_log("Parse failure");
+        goto fail;
+    }
+
+    if (!pa_tagstruct_eof(t)) {
+        pa_log("Packet too long");
+        goto fail;
+    }
+
+    pa_xfree(c->user_name);
+    c->user_name = pa_xstrdup(user_name);
+
+    pa_xfree(c->host_name);
+    c->host_name = pa_xstrdup(host_name);
+
+    for (l = c->links; l; l = l->next)
+        if (l->announced)
+            l->callbacks->server_info(l, c->user_name, c->host_name, l->userdata);
+
+    return;
+
+fail:
+    connection_fail(c);
+}
+
+static void request_server_info(connection *c) {
+    pa_tagstruct *t;
+    uint32_t tag;
+
+    pa_assert(c);
+
+    t = pa_tagstruct_new(NULL, 0);
+    pa_tagstruct_putu32(t, PA_COMMAND_GET_SERVER_INFO);
+    pa_tagstruct_putu32(t, tag = c->ctag++);
+    pa_pstream_send_tagstruct(c->pstream, t);
+    pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, server_info_cb, c, NULL);
+}
+
+static void command_subscribe_event(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    connection *c = userdata;
+    pa_subscription_event_type_t e;
+    uint32_t idx;
+    pa_tunnel_link *l;
+
+    pa_assert(pd);
+    pa_assert(t);
+    pa_assert(c);
+    pa_assert(command == PA_COMMAND_SUBSCRIBE_EVENT);
+
+    if (pa_tagstruct_getu32(t, &e) < 0 ||
+        pa_tagstruct_getu32(t, &idx) < 0) {
+        pa_log("Invalid protocol reply");
+        connection_fail(c);
+        return;
+    }
+
+    if (e == (PA_SUBSCRIPTION_EVENT_SERVER|PA_SUBSCRIPTION_EVENT_CHANGE)) {
+        request_server_info(c);
+        return;
+    }
+
+    for (l = c->links; l; l = l->next)
+        if (l->announced)
+            l->callbacks->subscribe_event(l, e, idx, l->userdata);
+}
+
+static void timeout_callback(pa_mainloop_api *m, pa_time_event *e, const struct timeval *t, void *userdata) {
+    connection *c = userdata;
+    pa_tunnel_link *l;
+
+    pa_assert(m);
+    pa_assert(e);
+    pa_assert(c);
+
+    /* All streams are asked at once, so their replies travel together */
+    for (l = c->links; l; l = l->next)
+        if (l->announced)
+            l->callbacks->latency(l, l->userdata);
+
+    pa_core_rttime_restart(c->core, e, pa_rtclock_now() + LATENCY_INTERVAL);
+}
+
+static void announce_cb(pa_mainloop_api *m, pa_defer_event *e, void *userdata) {
+    connection *c = userdata;
+    pa_tunnel_link *l;
+
+    pa_assert(m);
+    pa_assert(e);
+    pa_assert(c);
+
+    m->defer_enable(e, 0);
+
+    for (l = c->links; l; l = l->next) {
+        if (l->announced)
+            continue;
+
+        l->announced = TRUE;
+        l->callbacks->ready(l, l->userdata);
+
+        if (c->host_name)
+            l->callbacks->server_info(l, c->user_name, c->host_name, l->userdata);
+    }
+}
+
+static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    connection *c = userdata;
+    pa_tagstruct *reply;
+
+    pa_assert(pd);
+    pa_assert(c);
+    pa_assert(c->pdispatch == pd);
+
+    if (command != PA_COMMAND_REPLY ||
+        pa_tagstruct_getu32(t, &c->version) < 0 ||
+        !pa_tagstruct_eof(t)) {
+
+        if (command == PA_COMMAND_ERROR)
+            pa_log("Failed to authenticate");
+        else
+            pa_log("Protocol error.");
+
+        goto fail;
+    }
+
+    /* Minimum supported protocol version */
+    if (c->version < 8) {
+        pa_log("Incompatible protocol version");
+        goto fail;
+    }
+
+    /* Starting with protocol version 13 the MSB of the version tag
+    reflects if shm is enabled for this connection or not. We don't
+    support SHM here at all, so we just ignore this. */
+
+    if (c->version >= 13)
+        c->version &= 0x7FFFFFFFU;
+
+    pa_log_debug("Protocol version: remote %u, local %u", c->version, PA_PROTOCOL_VERSION);
+
+    reply = pa_tagstruct_new(NULL, 0);
+    pa_tagstruct_putu32(reply, PA_COMMAND_SET_CLIENT_NAME);
+    pa_tagstruct_putu32(reply, c->ctag++);
+
+    if (c->version >= 13) {
+        pa_proplist *pl;
+        pl = pa_proplist_new();
+        pa_proplist_sets(pl, PA_PROP_APPLICATION_ID, "org.PulseAudio.PulseAudio");
+        pa_proplist_sets(pl, PA_PROP_APPLICATION_VERSION, PACKAGE_VERSION);
+        pa_init_proplist(pl);
+        pa_tagstruct_put_proplist(reply, pl);
+        pa_proplist_free(pl);
+    } else
+        pa_tagstruct_puts(reply, "PulseAudio");
+
+    pa_pstream_send_tagstruct(c->pstream, reply);
+    /* We ignore the server's reply here */
+
+    /* One subscription for whatever any of the links cares about */
+    reply = pa_tagstruct_new(NULL, 0);
+    pa_tagstruct_putu32(reply, PA_COMMAND_SUBSCRIBE);
+    pa_tagstruct_putu32(reply, c->ctag++);
+    pa_tagstruct_putu32(reply, PA_SUBSCRIPTION_MASK_SERVER|PA_SUBSCRIPTION_MASK_SINK_INPUT|PA_SUBSCRIPTION_MASK_SINK|PA_SUBSCRIPTION_MASK_SOURCE);
+    pa_pstream_send_tagstruct(c->pstream, reply);
+
+    request_server_info(c);
+
+    pa_assert(!c->time_event);
+    c->time_event = pa_core_rttime_new(c->core, pa_rtclock_now() + LATENCY_INTERVAL, timeout_callback, c);
+
+    c->authenticated = TRUE;
+    c->core->mainloop->defer_enable(c->announce_event, 1);
+
+    pa_log_debug("Connection to %s authenticated.", c->server_name);
+
+    return;
+
+fail:
+    connection_fail(c);
+}
+
+static void pstream_die_callback(pa_pstream *p, void *userdata) {
+    connection *c = userdata;
+
+    pa_assert(p);
+    pa_assert(c);
+
+    pa_log_warn("Connection to %s died.", c->server_name);
+    connection_fail(c);
+}
+
+static void pstream_packet_callback(pa_pstream *p, pa_packet *packet, const pa_creds *creds, void *userdata) {
+    connection *c = userdata;
+
+    pa_assert(p);
+    pa_assert(packet);
+    pa_assert(c);
+
+    if (c->dead)
+        return;
+
+    if (pa_pdispatch_run(c->pdispatch, packet, creds, c) < 0) {
+        pa_log("Invalid packet");
+        connection_fail(c);
+    }
+}
+
+static void pstream_memblock_callback(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata) {
+    connection *c = userdata;
+    pa_tunnel_link *l;
+
+    pa_assert(p);
+    pa_assert(chunk);
+    pa_assert(c);
+
+    if (c->dead)
+        return;
+
+    if (!(l = find_link(c, TRUE, channel))) {
+        pa_log_debug("Received memory block on unknown channel %u.", channel);
+        return;
+    }
+
+    l->callbacks->memblock(l, offset, seek, chunk, l->userdata);
+}
+
+static void on_connection(pa_socket_client *sc, pa_iochannel *io, void *userdata) {
+    connection *c = userdata;
+    pa_tagstruct *t;
+    uint32_t tag;
+
+    pa_assert(sc);
+    pa_assert(c);
+    pa_assert(c->client == sc);
+
+    pa_socket_client_unref(c->client);
+    c->client = NULL;
+
+    if (!io) {
+        pa_log("Connection to %s failed: %s", c->server_name, pa_cstrerror(errno));
+        connection_fail(c);
+        return;
+    }
+
+    c->pstream = pa_pstream_new(c->core->mainloop, io, c->core->mempool);
+    c->pdispatch = pa_pdispatch_new(c->core->mainloop, TRUE, command_table, PA_COMMAND_MAX);
+
+    pa_pstream_set_die_callback(c->pstream, pstream_die_callback, c);
+    pa_pstream_set_receive_packet_callback(c->pstream, pstream_packet_callback, c);
+    pa_pstream_set_receive_memblock_callback(c->pstream, pstream_memblock_callback, c);
+
+    t = pa_tagstruct_new(NULL, 0);
+    pa_tagstruct_putu32(t, PA_COMMAND_AUTH);
+    pa_tagstruct_putu32(t, tag = c->ctag++);
+    pa_tagstruct_putu32(t, PA_PROTOCOL_VERSION);
+
+    pa_tagstruct_put_arbitrary(t, pa_auth_cookie_read(c->auth_cookie, PA_NATIVE_COOKIE_LENGTH), PA_NATIVE_COOKIE_LENGTH);
+
+#ifdef HAVE_CREDS
+{
+    pa_creds ucred;
+
+    if (pa_iochannel_creds_supported(io))
+        pa_iochannel_creds_enable(io);
+
+    ucred.uid = getuid();
+    ucred.gid = getgid();
+
+    pa_pstream_send_tagstruct_with_creds(c->pstream, t, &ucred);
+}
+#else
+    pa_pstream_send_tagstruct(c->pstream, t);
+#endif
+
+    pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, setup_complete_callback, c, NULL);
+
+    pa_log_debug("Connection to %s established, authenticating ...", c->server_name);
+}
+
+static connection* connection_get(pa_core *core, const char *server, const char *cookie) {
+    connection *c;
+    char *key;
+
+    key = pa_sprintf_malloc("tunnel-connection:%s:%s", server, cookie);
+
+    if ((c = pa_shared_get(core, key))) {
+        pa_xfree(key);
+        return c;
+    }
+
+    c = pa_xnew0(connection, 1);
+    c->core = core;
+    c->server_name = pa_xstrdup(server);
+    c->ctag = 1;
+    PA_LLIST_HEAD_INIT(pa_tunnel_link, c->links);
+
+    c->announce_event = core->mainloop->defer_new(core->mainloop, announce_cb, c);
+    core->mainloop->defer_enable(c->announce_event, 0);
+
+    if (!(c->auth_cookie = pa_auth_cookie_get(core, cookie, PA_NATIVE_COOKIE_LENGTH)))
+        goto fail;
+
+    if (!(c->client = pa_socket_client_new_string(core->mainloop, TRUE, server, PA_NATIVE_DEFAULT_PORT))) {
+        pa_log("Failed to connect to server '%s'", server);
+        goto fail;
+    }
+
+    pa_socket_client_set_callback(c->client, on_connection, c);
+
+    c->key = key;
+    pa_assert_se(pa_shared_set(core, c->key, c) >= 0);
+
+    return c;
+
+fail:
+    pa_xfree(key);
+    connection_free(c);
+    return NULL;
+}
+
+pa_tunnel_link* pa_tunnel_link_new(pa_core *core, const char *server, const char *cookie, pa_bool_t record, const pa_tunnel_link_callbacks *cb, void *userdata) {
+    connection *c;
+    pa_tunnel_link *l;
+
+    pa_assert(core);
+    pa_assert(server);
+    pa_assert(cookie);
+    pa_assert(cb);
+    pa_assert(cb->ready);
+    pa_assert(cb->died);
+    pa_assert(record ? !!cb->memblock : !!cb->request);
+    pa_assert(cb->subscribe_event);
+    pa_assert(cb->server_info);
+    pa_assert(cb->latency);
+    pa_assert(cb->command_table);
+
+    if (!(c = connection_get(core, server, cookie)))
+        return NULL;
+
+    l = pa_xnew0(pa_tunnel_link, 1);
+    l->connection = c;
+    l->record = record;
+    l->channel = PA_INVALID_INDEX;
+    l->callbacks = cb;
+    l->userdata = userdata;
+
+    PA_LLIST_PREPEND(pa_tunnel_link, c->links, l);
+
+    if (c->authenticated)
+        c->core->mainloop->defer_enable(c->announce_event, 1);
+
+    return l;
+}
+
+void pa_tunnel_link_free(pa_tunnel_link *l) {
+    connection *c;
+
+    pa_assert(l);
+
+    c = l->connection;
+
+    if (c->pdispatch)
+        pa_pdispatch_unregister_reply(c->pdispatch, l->userdata);
+
+    /* The others keep using the connection, so the stream has to be
+     * removed explicitly */
+    if (l->channel != PA_INVALID_INDEX && c->authenticated && c->links->next) {
+        pa_tagstruct *t;
+
+        t = pa_tagstruct_new(NULL, 0);
+        pa_tagstruct_putu32(t, l->record ? PA_COMMAND_DELETE_RECORD_STREAM : PA_COMMAND_DELETE_PLAYBACK_STREAM);
+        pa_tagstruct_putu32(t, c->ctag++);
+        pa_tagstruct_putu32(t, l->channel);
+        pa_pstream_send_tagstruct(c->pstream, t);
+    }
+
+    PA_LLIST_REMOVE(pa_tunnel_link, c->links, l);
+    pa_xfree(l);
+
+    if (!c->links)
+        connection_free(c);
+}
+
+void pa_tunnel_link_set_channel(pa_tunnel_link *l, uint32_t channel) {
+    pa_assert(l);
+    pa_assert(l->channel == PA_INVALID_INDEX);
+    pa_assert(!find_link(l->connection, l->record, channel));
+
+    l->channel = channel;
+}
+
+pa_pstream* pa_tunnel_link_get_pstream(pa_tunnel_link *l) {
+    pa_assert(l);
+
+    return l->connection->authenticated ? l->connection->pstream : NULL;
+}
+
+pa_pdispatch* pa_tunnel_link_get_pdispatch(pa_tunnel_link *l) {
+    pa_assert(l);
+
+    return l->connection->pdispatch;
+}
+
+uint32_t pa_tunnel_link_get_version(pa_tunnel_link *l) {
+    pa_assert(l);
+
+    return l->connection->version;
+}
+
+uint32_t pa_tunnel_link_new_tag(pa_tunnel_link *l) {
+    pa_assert(l);
+
+    return l->connection->ctag++;
+}
+
+pa_usec_t pa_tunnel_link_update_clock(pa_tunnel_link *l, const struct timeval *local, const struct timeval *remote, const struct timeval *now) {
+    pa_assert(l);
+    pa_assert(local);
+    pa_assert(remote);
+    pa_assert(now);
+
+    return update_clock(l->connection, local, remote, now);
+}
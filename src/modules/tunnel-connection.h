@@ -0,0 +1,99 @@
+#ifndef footunnelconnectionfoo
+#define footunnelconnectionfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <sys/time.h>
+
+#include <pulse/def.h>
+
+#include <pulsecore/core.h>
+#include <pulsecore/memchunk.h>
+#include <pulsecore/pdispatch.h>
+#include <pulsecore/pstream.h>
+#include <pulsecore/tagstruct.h>
+
+/* All tunnels to the same server with the same cookie share one
+ * native connection. Each of them is a link on that connection that
+ * carries a single stream. The connection authenticates once,
+ * subscribes once, asks for the server info once and drives the
+ * latency updates of all links from a single timer. */
+
+typedef struct pa_tunnel_link pa_tunnel_link;
+
+typedef struct pa_tunnel_link_callbacks {
+    /* The connection is authenticated, the stream can be created */
+    void (*ready)(pa_tunnel_link *l, void *userdata);
+
+    /* The connection failed or went away, the link is useless now */
+    void (*died)(pa_tunnel_link *l, void *userdata);
+
+    /* The server asks for more data, playback streams only */
+    void (*request)(pa_tunnel_link *l, uint32_t bytes, void *userdata);
+
+    /* Data from the server, record streams only */
+    void (*memblock)(pa_tunnel_link *l, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata);
+
+    /* Any subscription event of the server. Server changes are
+     * handled by the connection which then calls server_info. */
+    void (*subscribe_event)(pa_tunnel_link *l, pa_subscription_event_type_t e, uint32_t idx, void *userdata);
+
+    /* The server names its user and host */
+    void (*server_info)(pa_tunnel_link *l, const char *user_name, const char *host_name, void *userdata);
+
+    /* Time for the next latency update */
+    void (*latency)(pa_tunnel_link *l, void *userdata);
+
+    /* Commands addressed to our stream, with PA_COMMAND_MAX entries
+     * like the table of a pa_pdispatch. The tagstruct is passed on
+     * with the channel index already read. */
+    const pa_pdispatch_cb_t *command_table;
+} pa_tunnel_link_callbacks;
+
+/* Joins the connection to server, creating it if necessary. The
+ * callbacks are only called from the main loop, never from within
+ * this function. */
+pa_tunnel_link* pa_tunnel_link_new(pa_core *c, const char *server, const char *cookie, pa_bool_t record, const pa_tunnel_link_callbacks *cb, void *userdata);
+
+/* Deletes the stream of the link on the server, if there is one. The
+ * connection is closed with its last link. */
+void pa_tunnel_link_free(pa_tunnel_link *l);
+
+/* From the reply to the stream creation on */
+void pa_tunnel_link_set_channel(pa_tunnel_link *l, uint32_t channel);
+
+/* NULL while the connection isn't authenticated or after it died */
+pa_pstream* pa_tunnel_link_get_pstream(pa_tunnel_link *l);
+
+/* Replies must be registered with the userdata of the link, they are
+ * unregistered when it is freed */
+pa_pdispatch* pa_tunnel_link_get_pdispatch(pa_tunnel_link *l);
+
+uint32_t pa_tunnel_link_get_version(pa_tunnel_link *l);
+
+/* Tags are counted per connection */
+uint32_t pa_tunnel_link_new_tag(pa_tunnel_link *l);
+
+/* Feeds the timestamps of a latency reply into the clock filter of
+ * the connection and returns how long ago the server took its
+ * measurement */
+pa_usec_t pa_tunnel_link_update_clock(pa_tunnel_link *l, const struct timeval *local, const struct timeval *remote, const struct timeval *now);
+
+#endif
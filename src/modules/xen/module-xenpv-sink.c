@@ -25,6 +25,7 @@
 #endif
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <sys/stat.h>
 #include <stdio.h>
 #include <errno.h>
@@ -67,13 +68,18 @@ PA_MODULE_USAGE(
         "format=<sample format> "
         "rate=<sample rate>"
         "channels=<number of channels> "
-        "channel_map=<channel map>");
+        "channel_map=<channel map> "
+        "ring_page_order=<log2 of the ring size in pages, if the backend supports it>");
 
 #define DEFAULT_SINK_NAME "xenpv_output"
 #define DEFAULT_FILE_NAME "xenpv_output"
 
 #define STATE_UNDEFINED 9999
 
+#define RING_PAGE_SIZE 4096
+#define DEFAULT_RING_PAGE_ORDER 2
+#define MAX_RING_PAGE_ORDER 4
+
 int device_id = -1;
 enum xenbus_state {
 	XenbusStateUnknown      = 0,
@@ -121,12 +127,29 @@ pa_channel_map map;
 /* just to test non- frame-aligned size */
 #define BUFSIZE 2047
 
+/* Backends that publish max-ring-page-order get a ring of one or more
+ * pages, with the data following the whole header. Older ones get a
+ * single page, with the data following usable_buffer_space and only
+ * BUFSIZE bytes of it. */
 struct ring {
     uint32_t cons_indx, prod_indx;
     uint32_t usable_buffer_space; /* kept here for convenience */
-    uint8_t buffer[BUFSIZE];
+    /* Only used with feature-event-idx: set by the backend to the
+     * prod_indx it wants to be notified at, so that it is notified once
+     * per batch it consumes instead of once per write */
+    uint32_t cons_event;
 } *ioring;
 
+#define RING_LEGACY_HEADER_SIZE (offsetof(struct ring, cons_event))
+
+/* The shared memory is written by the other domain too */
+#define ring_mb() __sync_synchronize()
+
+static uint8_t *ring_data;
+static size_t ring_size;
+static pa_bool_t ring_legacy = TRUE;
+static pa_bool_t ring_event_idx = FALSE;
+
 static const char* const valid_modargs[] = {
     "sink_name",
     "sink_properties",
@@ -135,6 +158,7 @@ static const char* const valid_modargs[] = {
     "rate",
     "channels",
     "channel_map",
+    "ring_page_order",
     NULL
 };
 
@@ -143,17 +167,18 @@ xc_interface* xch;
 xc_evtchn* xce;
 evtchn_port_or_error_t xen_evtchn_port;
 static struct xs_handle *xsh;
-struct ioctl_gntalloc_alloc_gref gref;
+struct ioctl_gntalloc_alloc_gref *gref;
 
 static int register_backend_state_watch(void);
 static int wait_for_backend_state_change(void);
-static int alloc_gref(struct ioctl_gntalloc_alloc_gref *gref, void **addr);
+static int alloc_gref(struct ioctl_gntalloc_alloc_gref *gref, size_t size, void **addr);
 static int ring_write(struct ring *r, void *src, int length);
 static int publish_spec(pa_sample_spec *ss);
 static int read_backend_default_spec(pa_sample_spec *ss);
 static int publish_param(const char *paramname, const char *value);
 static int publish_param_int(const char *paramname, const int value);
 static char* read_param(const char *paramname);
+static int read_param_int(const char *paramname, int def);
 
 static int set_state(int state) {
     static int current_state = 0;
@@ -240,8 +265,11 @@ int (*state_callbacks[9])(void) = {
 
 static void xen_cleanup() {
     char keybuf[64];
-    /*XXX hardcoded*/
-    munmap((void*)gref.index, 4096);
+    if (ioring)
+        munmap(ioring, ring_size);
+    ioring = NULL;
+    pa_xfree(gref);
+    gref = NULL;
 
     set_state(XenbusStateClosing);
     /* send one last event to unblock the backend */
@@ -275,6 +303,17 @@ static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offse
     return pa_sink_process_msg(o, code, data, offset, chunk);
 }
 
+/* Whether the backend asked to be notified at a point between old and
+ * the current prod_indx. Both indices wrap around at the ring size. */
+static pa_bool_t ring_need_event(struct ring *r, uint32_t old) {
+    uint32_t s = r->usable_buffer_space, event;
+
+    ring_mb();
+    event = r->cons_event % s;
+
+    return (event + s - old - 1) % s < (r->prod_indx + s - old) % s;
+}
+
 static int process_render(struct userdata *u) {
     pa_assert(u);
 
@@ -285,10 +324,13 @@ static int process_render(struct userdata *u) {
 
     pa_assert(u->memchunk.length > 0);
 
-    xc_evtchn_notify(xce, xen_evtchn_port);
+    if (!ring_event_idx)
+        xc_evtchn_notify(xce, xen_evtchn_port);
+
     for (;;) {
         ssize_t l;
         void *p;
+        uint32_t old = ioring->prod_indx;
 
         p = pa_memblock_acquire(u->memchunk.memblock);
 	    /* xen: write data to ring buffer & notify backend */
@@ -298,6 +340,9 @@ static int process_render(struct userdata *u) {
 
         pa_assert(l != 0);
 
+        if (l > 0 && ring_event_idx && ring_need_event(ioring, old))
+            xc_evtchn_notify(xce, xen_evtchn_port);
+
         if (l < 0) {
             if (errno == EINTR)
                 continue;
@@ -389,6 +434,9 @@ int pa__init(pa_module*m) {
     int backend_state;
     int ret;
     char strbuf[100];
+    uint32_t page_order = DEFAULT_RING_PAGE_ORDER;
+    int backend_page_order;
+    unsigned i;
 
     pa_assert(m);
 
@@ -406,6 +454,11 @@ int pa__init(pa_module*m) {
         return 1;
     }
 
+    if (pa_modargs_get_value_u32(ma, "ring_page_order", &page_order) < 0 || page_order > MAX_RING_PAGE_ORDER) {
+        pa_log("Failed to parse ring_page_order= argument.");
+        goto fail;
+    }
+
     /* Xen Basic init */
     xsh = xs_domain_open();
     if (xsh==NULL) {
@@ -432,18 +485,53 @@ int pa__init(pa_module*m) {
         pa_log("xc_evtchn_bind_unbound_port failed");
     }
 
+    device_id = 0; /* hardcoded for now */
+
+    /* Backends publish their features when they set up the device,
+     * without them we stick to what every backend understands */
+    if ((backend_page_order = read_param_int("max-ring-page-order", -1)) >= 0) {
+        ring_legacy = FALSE;
+        page_order = PA_MIN(page_order, (uint32_t) backend_page_order);
+        ring_event_idx = read_param_int("feature-event-idx", 0) > 0;
+    } else
+        page_order = 0;
+
+    ring_size = (size_t) RING_PAGE_SIZE << page_order;
+
     /* get grant reference & map locally */
-    if (alloc_gref(&gref, (void**)&ioring)) {
+    gref = pa_xmalloc0(sizeof(*gref) + ((1U << page_order) - 1) * sizeof(gref->gref_ids[0]));
+    gref->count = 1U << page_order;
+    if (alloc_gref(gref, ring_size, (void**)&ioring)) {
        pa_log("alloc_gref failed");
+       goto fail;
     };
-    device_id = 0; /* hardcoded for now */
+
+    /* Until the backend says otherwise, it is woken up by the first
+     * write. Set before the backend can map the ring. */
+    ioring->cons_event = 1;
 
     if (register_backend_state_watch()) {
         pa_log("Xen sink: register xenstore watch failed");
     };
 
     publish_param_int("event-channel", xen_evtchn_port);
-    publish_param_int("ring-ref", gref.gref_ids[0]);
+
+    if (ring_legacy)
+        publish_param_int("ring-ref", gref->gref_ids[0]);
+    else {
+        publish_param_int("ring-page-order", (int) page_order);
+
+        for (i = 0; i < gref->count; i++) {
+            char key[16];
+
+            pa_snprintf(key, sizeof(key), "ring-ref%u", i);
+            publish_param_int(key, gref->gref_ids[i]);
+        }
+
+        publish_param_int("feature-event-idx", ring_event_idx);
+
+        pa_log_debug("Xen audio sink: Ring of %u pages, %s batched notifications", gref->count, ring_event_idx ? "with" : "without");
+    }
 
     /* let's ask for something absurd and deal with rejection */
     ss.rate = 192000;
@@ -484,7 +572,16 @@ int pa__init(pa_module*m) {
 
     /* init ring buffer */
     ioring->prod_indx = ioring->cons_indx = 0;
-    ioring->usable_buffer_space = BUFSIZE - BUFSIZE % pa_frame_size(&ss);
+
+    if (ring_legacy) {
+        ring_data = (uint8_t*) ioring + RING_LEGACY_HEADER_SIZE;
+        ioring->usable_buffer_space = BUFSIZE - BUFSIZE % pa_frame_size(&ss);
+    } else {
+        size_t n = ring_size - sizeof(struct ring);
+
+        ring_data = (uint8_t*) (ioring + 1);
+        ioring->usable_buffer_space = (uint32_t) (n - n % pa_frame_size(&ss));
+    }
 
     pa_sink_new_data_init(&data);
     data.driver = __FILE__;
@@ -585,7 +682,7 @@ void pa__done(pa_module*m) {
 }
 
 
-static int alloc_gref(struct ioctl_gntalloc_alloc_gref *gref_, void **addr) {
+static int alloc_gref(struct ioctl_gntalloc_alloc_gref *gref_, size_t size, void **addr) {
     int alloc_fd, dev_fd, rv;
 
     alloc_fd = open("/dev/xen/gntalloc", O_RDWR);
@@ -603,7 +700,6 @@ static int alloc_gref(struct ioctl_gntalloc_alloc_gref *gref_, void **addr) {
     /* use dom0 */
     gref_->domid = 0;
     gref_->flags = GNTALLOC_FLAG_WRITABLE;
-    gref_->count = 1;
 
     rv = ioctl(alloc_fd, IOCTL_GNTALLOC_ALLOC_GREF, gref_);
     if (rv) {
@@ -612,11 +708,11 @@ static int alloc_gref(struct ioctl_gntalloc_alloc_gref *gref_, void **addr) {
     }
 
     /*addr=NULL(default),length, prot,             flags,    fd,         offset*/
-    *addr = mmap(0, 4096, PROT_READ|PROT_WRITE, MAP_SHARED, alloc_fd, gref_->index);
+    *addr = mmap(0, size, PROT_READ|PROT_WRITE, MAP_SHARED, alloc_fd, gref_->index);
     if (*addr == MAP_FAILED) {
         *addr = 0;
         pa_log_debug("Xen audio sink: mmap'ing shared page failed\n");
-        return rv;
+        return -1;
     }
 
     pa_log_debug("Xen audio sink: Got grant #%d. Mapped locally at %Ld=%p\n",
@@ -667,9 +763,12 @@ static int ring_write(struct ring *r, void *src, int length) {
         fl = PA_MIN(l, first_chunk_size);
         sl = PA_MIN(l-fl, second_chunk_size);
 
-        memcpy(r->buffer+r->prod_indx, src, fl);
+        memcpy(ring_data+r->prod_indx, src, fl);
         if (sl)
-            memcpy(r->buffer, ((char*)src)+fl, sl);
+            memcpy(ring_data, ((char*)src)+fl, sl);
+
+        /* the data has to be there before the backend sees the index */
+        ring_mb();
         r->prod_indx = (r->prod_indx+fl+sl) % r->usable_buffer_space;
 
         return sl+fl;
@@ -703,6 +802,20 @@ static char* read_param(const char *paramname) {
 }
 
 
+static int read_param_int(const char *paramname, int def) {
+    char *out;
+    int32_t v;
+
+    if (!(out = read_param(paramname)))
+        return def;
+
+    if (pa_atoi(out, &v) < 0)
+        v = def;
+
+    free(out);
+    return v;
+}
+
 static int publish_spec(pa_sample_spec *sample_spec) {
     /* Publish spec and set state to XenbusStateInitWait*/
     int ret;
@@ -62,8 +62,12 @@ static const pa_client_conf default_conf = {
     .cookie_file = NULL,
     .cookie_valid = FALSE,
     .shm_size = 0,
+    .shm_slot_size = 0,
+    .shm_small_slot_size = 0,
     .auto_connect_localhost = FALSE,
-    .auto_connect_display = FALSE
+    .auto_connect_display = FALSE,
+    .parallel_connect = FALSE,
+    .parallel_connect_delay_msec = 250
 };
 
 pa_client_conf *pa_client_conf_new(void) {
@@ -106,8 +110,12 @@ int pa_client_conf_load(pa_client_conf *c, const char *filename) {
         { "disable-shm",            pa_config_parse_bool,     &c->disable_shm, NULL },
         { "enable-shm",             pa_config_parse_not_bool, &c->disable_shm, NULL },
         { "shm-size-bytes",         pa_config_parse_size,     &c->shm_size, NULL },
+        { "shm-slot-size-bytes",    pa_config_parse_size,     &c->shm_slot_size, NULL },
+        { "shm-small-slot-size-bytes", pa_config_parse_size,  &c->shm_small_slot_size, NULL },
         { "auto-connect-localhost", pa_config_parse_bool,     &c->auto_connect_localhost, NULL },
         { "auto-connect-display",   pa_config_parse_bool,     &c->auto_connect_display, NULL },
+        { "parallel-connect",       pa_config_parse_bool,     &c->parallel_connect, NULL },
+        { "parallel-connect-delay-msec", pa_config_parse_unsigned, &c->parallel_connect_delay_msec, NULL },
         { NULL,                     NULL,                     NULL, NULL },
     };
 
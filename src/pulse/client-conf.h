@@ -29,10 +29,11 @@
 
 typedef struct pa_client_conf {
     char *daemon_binary, *extra_arguments, *default_sink, *default_source, *default_server, *default_dbus_server, *cookie_file;
-    pa_bool_t autospawn, disable_shm, auto_connect_localhost, auto_connect_display;
+    pa_bool_t autospawn, disable_shm, auto_connect_localhost, auto_connect_display, parallel_connect;
+    unsigned parallel_connect_delay_msec;
     uint8_t cookie[PA_NATIVE_COOKIE_LENGTH];
     pa_bool_t cookie_valid; /* non-zero, when cookie is valid */
-    size_t shm_size;
+    size_t shm_size, shm_slot_size, shm_small_slot_size;
 } pa_client_conf;
 
 /* Create a new configuration data object and reset it to defaults */
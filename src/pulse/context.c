@@ -45,6 +45,7 @@
 #include <pulse/xmalloc.h>
 #include <pulse/util.h>
 #include <pulse/mainloop.h>
+#include <pulse/rtclock.h>
 #include <pulse/timeval.h>
 #include <pulse/fork-detect.h>
 #include <pulse/client-conf.h>
@@ -75,6 +76,7 @@ void pa_command_extension(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_t
 
 static const pa_pdispatch_cb_t command_table[PA_COMMAND_MAX] = {
     [PA_COMMAND_REQUEST] = pa_command_request,
+    [PA_COMMAND_REQUEST_MULTI] = pa_command_request,
     [PA_COMMAND_OVERFLOW] = pa_command_overflow_or_underflow,
     [PA_COMMAND_UNDERFLOW] = pa_command_overflow_or_underflow,
     [PA_COMMAND_PLAYBACK_STREAM_KILLED] = pa_command_stream_killed,
@@ -84,6 +86,7 @@ static const pa_pdispatch_cb_t command_table[PA_COMMAND_MAX] = {
     [PA_COMMAND_PLAYBACK_STREAM_SUSPENDED] = pa_command_stream_suspended,
     [PA_COMMAND_RECORD_STREAM_SUSPENDED] = pa_command_stream_suspended,
     [PA_COMMAND_STARTED] = pa_command_stream_started,
+    [PA_COMMAND_PLAYBACK_TIMING] = pa_command_playback_timing,
     [PA_COMMAND_SUBSCRIBE_EVENT] = pa_command_subscribe_event,
     [PA_COMMAND_EXTENSION] = pa_command_extension,
     [PA_COMMAND_PLAYBACK_STREAM_EVENT] = pa_command_stream_event,
@@ -93,6 +96,7 @@ static const pa_pdispatch_cb_t command_table[PA_COMMAND_MAX] = {
     [PA_COMMAND_RECORD_BUFFER_ATTR_CHANGED] = pa_command_stream_buffer_attr
 };
 static void context_free(pa_context *c);
+static void attempts_free(pa_context *c);
 
 #ifdef HAVE_DBUS
 static DBusHandlerResult filter_cb(DBusConnection *bus, DBusMessage *message, void *userdata);
@@ -111,6 +115,9 @@ static void reset_callbacks(pa_context *c) {
     c->subscribe_callback = NULL;
     c->subscribe_userdata = NULL;
 
+    pa_zero(c->snapshot_callbacks);
+    c->snapshot_userdata = NULL;
+
     c->event_callback = NULL;
     c->event_userdata = NULL;
 
@@ -125,6 +132,11 @@ static void reset_callbacks(pa_context *c) {
 
     c->ext_node_manager.callback = NULL;
     c->ext_node_manager.userdata = NULL;
+    c->ext_node_manager.node_callback = NULL;
+    c->ext_node_manager.node_userdata = NULL;
+
+    c->ext_levels.callback = NULL;
+    c->ext_levels.userdata = NULL;
 }
 
 pa_context *pa_context_new_with_proplist(pa_mainloop_api *mainloop, const char *name, pa_proplist *p) {
@@ -153,6 +165,7 @@ pa_context *pa_context_new_with_proplist(pa_mainloop_api *mainloop, const char *
     c->record_streams = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
     c->client_index = PA_INVALID_INDEX;
     c->use_rtclock = pa_mainloop_is_our_api(mainloop);
+    c->info_fields = PA_INFO_FIELDS_ALL;
 
     PA_LLIST_HEAD_INIT(pa_stream, c->streams);
     PA_LLIST_HEAD_INIT(pa_operation, c->operations);
@@ -175,10 +188,12 @@ pa_context *pa_context_new_with_proplist(pa_mainloop_api *mainloop, const char *
 #endif
     pa_client_conf_env(c->conf);
 
-    if (!(c->mempool = pa_mempool_new(!c->conf->disable_shm, c->conf->shm_size))) {
+    if (!(c->mempool = pa_mempool_new_full(!c->conf->disable_shm, FALSE, c->conf->shm_size,
+                                           c->conf->shm_slot_size, c->conf->shm_small_slot_size))) {
 
         if (!c->conf->disable_shm)
-            c->mempool = pa_mempool_new(FALSE, c->conf->shm_size);
+            c->mempool = pa_mempool_new_full(FALSE, FALSE, c->conf->shm_size,
+                                             c->conf->shm_slot_size, c->conf->shm_small_slot_size);
 
         if (!c->mempool) {
             context_free(c);
@@ -221,6 +236,8 @@ static void context_unlink(pa_context *c) {
         c->client = NULL;
     }
 
+    attempts_free(c);
+
     reset_callbacks(c);
 }
 
@@ -367,6 +384,12 @@ static void pstream_memblock_callback(pa_pstream *p, uint32_t channel, int64_t o
             if ((l = pa_memblockq_get_length(s->record_memblockq)) > 0)
                 s->read_callback(s, l, s->read_userdata);
         }
+
+    } else if ((s = pa_hashmap_get(c->playback_streams, PA_UINT32_TO_PTR(channel))) && s->ring) {
+
+        /* The read index of a ring buffer stream */
+        if (!chunk->memblock || pa_stream_ring_attach(s->ring, chunk) < 0)
+            pa_context_fail(c, PA_ERR_PROTOCOL);
     }
 
     pa_context_unref(c);
@@ -428,7 +451,7 @@ static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t
     switch(c->state) {
         case PA_CONTEXT_AUTHORIZING: {
             pa_tagstruct *reply;
-            pa_bool_t shm_on_remote = FALSE;
+            pa_bool_t shm_on_remote = FALSE, memfd_on_remote = FALSE;
 
             if (pa_tagstruct_getu32(t, &c->version) < 0 ||
                 !pa_tagstruct_eof(t)) {
@@ -450,6 +473,14 @@ static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t
                 c->version &= 0x7FFFFFFFU;
             }
 
+            /* Starting with protocol version 27 the second bit tells
+               whether memfd segments may be passed. */
+            memfd_on_remote = !!(c->version & 0x40000000U);
+            c->version &= 0x3FFFFFFFU;
+
+            if (c->version < 27)
+                memfd_on_remote = FALSE;
+
             pa_log_debug("Protocol version: remote %u, local %u", c->version, PA_PROTOCOL_VERSION);
 
             /* Enable shared memory support if possible */
@@ -473,6 +504,34 @@ static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t
             pa_log_debug("Negotiated SHM: %s", pa_yes_no(c->do_shm));
             pa_pstream_enable_shm(c->pstream, c->do_shm);
 
+            /* Starting with protocol version 34 releases and revokes
+             * of SHM blocks may be sent in batches */
+            pa_pstream_enable_batching(c->pstream, c->do_shm && c->version >= 34);
+
+            /* Starting with protocol version 35 up to
+             * PA_MEMIMPORT_BLOCKS_MAX SHM blocks may be passed at a
+             * time */
+            pa_pstream_enable_large_exports(c->pstream, c->do_shm && c->version >= 35);
+
+#if defined(HAVE_CREDS) && defined(HAVE_MEMFD_CREATE)
+            if (c->do_shm && memfd_on_remote) {
+                pa_mempool *pool;
+
+                pa_log_debug("Negotiated memfd: yes");
+                pa_pstream_enable_memfd(c->pstream, TRUE);
+
+                /* Nothing has been allocated from our pool yet, so
+                 * we can still move over to an anonymous one. */
+                if (!pa_mempool_is_memfd(c->mempool) && (pool = pa_mempool_new_full(TRUE, TRUE, c->conf->shm_size,
+                                                                                           c->conf->shm_slot_size,
+                                                                                           c->conf->shm_small_slot_size))) {
+                    pa_pstream_set_mempool(c->pstream, pool);
+                    pa_mempool_free(c->mempool);
+                    c->mempool = pool;
+                }
+            }
+#endif
+
             reply = pa_tagstruct_command(c, PA_COMMAND_SET_CLIENT_NAME, &tag);
 
             if (c->version >= 13) {
@@ -524,6 +583,9 @@ static void setup_context(pa_context *c, pa_iochannel *io) {
     pa_pstream_set_receive_packet_callback(c->pstream, pstream_packet_callback, c);
     pa_pstream_set_receive_memblock_callback(c->pstream, pstream_memblock_callback, c);
 
+    /* Over the network audio should not wait behind large requests */
+    pa_pstream_enable_audio_priority(c->pstream, !c->is_local);
+
     pa_assert(!c->pdispatch);
     c->pdispatch = pa_pdispatch_new(c->mainloop, c->use_rtclock, command_table, PA_COMMAND_MAX);
 
@@ -539,8 +601,13 @@ static void setup_context(pa_context *c, pa_iochannel *io) {
     pa_log_debug("SHM possible: %s", pa_yes_no(c->do_shm));
 
     /* Starting with protocol version 13 we use the MSB of the version
-     * tag for informing the other side if we could do SHM or not */
+     * tag for informing the other side if we could do SHM or not,
+     * starting with 27 the next bit says whether we can receive memfds */
+#if defined(HAVE_CREDS) && defined(HAVE_MEMFD_CREATE)
+    pa_tagstruct_putu32(t, PA_PROTOCOL_VERSION | (c->do_shm ? 0xC0000000U : 0));
+#else
     pa_tagstruct_putu32(t, PA_PROTOCOL_VERSION | (c->do_shm ? 0x80000000U : 0));
+#endif
     pa_tagstruct_put_arbitrary(t, c->conf->cookie, sizeof(c->conf->cookie));
 
 #ifdef HAVE_CREDS
@@ -761,6 +828,181 @@ fail:
 #endif /* OS_IS_WIN32 */
 
 static void on_connection(pa_socket_client *client, pa_iochannel*io, void *userdata);
+static int try_next_connection(pa_context *c);
+
+/* With parallel-connect, one of these exists for each server of the
+ * list that hasn't failed yet. Attempts which haven't been started
+ * have a start_event and no client. */
+struct pa_context_attempt {
+    pa_context *context;
+    char *server;
+    pa_socket_client *client;
+    pa_time_event *start_event;
+    PA_LLIST_FIELDS(struct pa_context_attempt);
+};
+
+static void attempt_free(struct pa_context_attempt *a) {
+    pa_assert(a);
+
+    PA_LLIST_REMOVE(struct pa_context_attempt, a->context->attempts, a);
+
+    if (a->start_event)
+        a->context->mainloop->time_free(a->start_event);
+
+    if (a->client)
+        pa_socket_client_unref(a->client);
+
+    pa_xfree(a->server);
+    pa_xfree(a);
+}
+
+static void attempts_free(pa_context *c) {
+    pa_assert(c);
+
+    while (c->attempts)
+        attempt_free(c->attempts);
+}
+
+static void on_attempt_connection(pa_socket_client *client, pa_iochannel*io, void *userdata);
+
+static int attempt_start(struct pa_context_attempt *a) {
+    pa_context *c;
+
+    pa_assert(a);
+    pa_assert(!a->client);
+
+    c = a->context;
+
+    if (a->start_event) {
+        c->mainloop->time_free(a->start_event);
+        a->start_event = NULL;
+    }
+
+    pa_log_debug("Trying to connect to %s...", a->server);
+
+    if (!(a->client = pa_socket_client_new_string(c->mainloop, c->use_rtclock, a->server, PA_NATIVE_DEFAULT_PORT)))
+        return -1;
+
+    pa_socket_client_set_callback(a->client, on_attempt_connection, a);
+    return 0;
+}
+
+/* Starts the first attempt still waiting for its turn. Returns -1 if
+ * there is nothing left that could still connect. */
+static int start_next_attempt(pa_context *c) {
+    struct pa_context_attempt *a, *n;
+
+    pa_assert(c);
+
+    for (a = c->attempts; a; a = n) {
+        n = a->next;
+
+        if (a->client)
+            continue;
+
+        if (attempt_start(a) >= 0)
+            return 0;
+
+        attempt_free(a);
+    }
+
+    return c->attempts ? 0 : -1;
+}
+
+static void attempt_start_cb(pa_mainloop_api *m, pa_time_event *e, const struct timeval *t, void *userdata) {
+    struct pa_context_attempt *a = userdata;
+    pa_context *c;
+
+    pa_assert(a);
+    pa_assert(a->start_event == e);
+
+    c = a->context;
+    pa_context_ref(c);
+
+    if (attempt_start(a) < 0) {
+        attempt_free(a);
+
+        if (start_next_attempt(c) < 0)
+            try_next_connection(c);
+    }
+
+    pa_context_unref(c);
+}
+
+static void on_attempt_connection(pa_socket_client *client, pa_iochannel*io, void *userdata) {
+    struct pa_context_attempt *a = userdata;
+    pa_context *c;
+
+    pa_assert(client);
+    pa_assert(a);
+    pa_assert(a->client == client);
+
+    c = a->context;
+    pa_assert(c->state == PA_CONTEXT_CONNECTING);
+
+    pa_context_ref(c);
+
+    if (!io) {
+        pa_log_debug("Connection to %s failed.", a->server);
+
+        /* Don't let the next one wait for its delay to expire */
+        attempt_free(a);
+
+        if (start_next_attempt(c) < 0)
+            try_next_connection(c);
+
+        goto finish;
+    }
+
+    pa_log_debug("Connected to %s first.", a->server);
+
+    pa_xfree(c->server);
+    c->server = pa_xstrdup(a->server);
+    c->is_local = !!pa_socket_client_is_local(client);
+
+    /* The others lost */
+    attempts_free(c);
+
+    setup_context(c, io);
+
+finish:
+    pa_context_unref(c);
+}
+
+/* Moves all of the server list into attempts, and starts them each
+ * parallel_connect_delay_msec after the previous one */
+static int try_parallel_connections(pa_context *c) {
+    struct pa_context_attempt *tail = NULL;
+    pa_usec_t now, delay;
+    unsigned i = 0;
+    char *u;
+
+    pa_assert(c);
+    pa_assert(!c->attempts);
+
+    now = pa_rtclock_now();
+    delay = (pa_usec_t) c->conf->parallel_connect_delay_msec * PA_USEC_PER_MSEC;
+
+    while (c->server_list) {
+        struct pa_context_attempt *a;
+
+        c->server_list = pa_strlist_pop(c->server_list, &u);
+
+        a = pa_xnew0(struct pa_context_attempt, 1);
+        a->context = c;
+        a->server = u;
+
+        /* The first one is started below, right away */
+        if (i > 0)
+            a->start_event = pa_context_rttime_new(c, now + delay * i, attempt_start_cb, a);
+
+        PA_LLIST_INSERT_AFTER(struct pa_context_attempt, c->attempts, tail, a);
+        tail = a;
+        i++;
+    }
+
+    return start_next_attempt(c);
+}
 
 #ifdef HAVE_DBUS
 static void track_pulseaudio_on_dbus(pa_context *c, DBusBusType type, pa_dbus_wrap_connection **conn) {
@@ -813,6 +1055,14 @@ static int try_next_connection(pa_context *c) {
         pa_xfree(u);
         u = NULL;
 
+        if (c->conf->parallel_connect && c->server_list) {
+            if (try_parallel_connections(c) >= 0)
+                break;
+
+            /* All of them failed right away */
+            continue;
+        }
+
         c->server_list = pa_strlist_pop(c->server_list, &u);
 
         if (!u) {
@@ -927,7 +1177,7 @@ static DBusHandlerResult filter_cb(DBusConnection *bus, DBusMessage *message, vo
         /* The system wide instance via PF_LOCAL */
         c->server_list = pa_strlist_prepend(c->server_list, PA_SYSTEM_RUNTIME_PATH PA_PATH_SEP PA_NATIVE_DEFAULT_UNIX_SOCKET);
 
-    if (!c->client)
+    if (!c->client && !c->attempts)
         try_next_connection(c);
 
 finish:
@@ -1087,7 +1337,7 @@ int pa_context_is_pending(pa_context *c) {
 
     return (c->pstream && pa_pstream_is_pending(c->pstream)) ||
         (c->pdispatch && pa_pdispatch_is_pending(c->pdispatch)) ||
-        c->client;
+        c->client || c->attempts;
 }
 
 static void set_dispatch_callbacks(pa_operation *o);
@@ -1434,8 +1684,10 @@ void pa_command_extension(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_t
         pa_ext_device_restore_command(c, tag, t);
     else if (pa_streq(name, "module-stream-restore"))
         pa_ext_stream_restore_command(c, tag, t);
-    else if (pa_streq(name, "module-node-manager"))
+    else if (pa_streq(name, "module-node-manager") || pa_streq(name, "module-murphy-ivi"))
         pa_ext_node_manager_command(c, tag, t);
+    else if (pa_streq(name, "module-levels"))
+        pa_ext_levels_command(c, tag, t);
     else
         pa_log(_("Received message for unknown extension '%s'"), name);
 
@@ -1512,6 +1764,66 @@ void pa_context_rttime_restart(pa_context *c, pa_time_event *e, pa_usec_t usec)
     }
 }
 
+pa_pool_block* pa_context_alloc_pool_block(pa_context *c, size_t *nbytes) {
+    pa_pool_block *b;
+    size_t m;
+
+    pa_assert(c);
+    pa_assert(PA_REFCNT_VALUE(c) >= 1);
+
+    PA_CHECK_VALIDITY_RETURN_NULL(c, !pa_detect_fork(), PA_ERR_FORKED);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, nbytes && *nbytes != 0, PA_ERR_INVALID);
+
+    m = pa_mempool_block_size_max(c->mempool);
+    if (*nbytes > m)
+        *nbytes = m;
+
+    b = pa_xnew(pa_pool_block, 1);
+    PA_REFCNT_INIT(b);
+    b->pool = c->mempool;
+    b->memblock = pa_memblock_new(c->mempool, *nbytes);
+    b->data = pa_memblock_acquire(b->memblock);
+
+    *nbytes = pa_memblock_get_length(b->memblock);
+
+    return b;
+}
+
+pa_pool_block* pa_pool_block_ref(pa_pool_block *b) {
+    pa_assert(b);
+    pa_assert(PA_REFCNT_VALUE(b) >= 1);
+
+    PA_REFCNT_INC(b);
+    return b;
+}
+
+void pa_pool_block_unref(pa_pool_block *b) {
+    pa_assert(b);
+    pa_assert(PA_REFCNT_VALUE(b) >= 1);
+
+    if (PA_REFCNT_DEC(b) > 0)
+        return;
+
+    /* Writes to streams hold references of their own on the memblock */
+    pa_memblock_release(b->memblock);
+    pa_memblock_unref(b->memblock);
+    pa_xfree(b);
+}
+
+void* pa_pool_block_get_data(pa_pool_block *b) {
+    pa_assert(b);
+    pa_assert(PA_REFCNT_VALUE(b) >= 1);
+
+    return b->data;
+}
+
+size_t pa_pool_block_get_length(pa_pool_block *b) {
+    pa_assert(b);
+    pa_assert(PA_REFCNT_VALUE(b) >= 1);
+
+    return pa_memblock_get_length(b->memblock);
+}
+
 size_t pa_context_get_tile_size(pa_context *c, const pa_sample_spec *ss) {
     size_t fs, mbs;
 
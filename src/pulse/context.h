@@ -280,6 +280,39 @@ void pa_context_rttime_restart(pa_context *c, pa_time_event *e, pa_usec_t usec);
  * pa_stream_get_sample_spec(ss)); \since 0.9.20 */
 size_t pa_context_get_tile_size(pa_context *c, const pa_sample_spec *ss);
 
+/** A reference counted block of memory from the memory pool of a
+ * context. If the context uses shared memory with the server, audio
+ * data placed in such a block and written with
+ * pa_stream_write_pool_block() reaches the server without being copied
+ * at all. \since 3.0 */
+typedef struct pa_pool_block pa_pool_block;
+
+/** Allocate a block from the memory pool of the context. If *nbytes
+ * is (size_t) -1 the size is chosen automatically. It is never larger
+ * than the tile size, see pa_context_get_tile_size(). On return
+ * *nbytes is set to the actual size of the block. Unlike
+ * pa_stream_begin_write() this may be called any number of times in a
+ * row, to keep several blocks around at once. This function, as well
+ * as all the pa_pool_block functions, may be called from any thread
+ * without locking the main loop, so that a decoder thread can fill
+ * blocks while the main loop writes others. All blocks need to be
+ * unreferenced before the context is freed. Returns NULL on
+ * failure. \since 3.0 */
+pa_pool_block* pa_context_alloc_pool_block(pa_context *c, size_t *nbytes);
+
+/** Increase the reference counter of the block by one. \since 3.0 */
+pa_pool_block* pa_pool_block_ref(pa_pool_block *b);
+
+/** Decrease the reference counter of the block by one. \since 3.0 */
+void pa_pool_block_unref(pa_pool_block *b);
+
+/** Return a pointer to the memory of the block, which stays valid for
+ * as long as a reference to the block is held. \since 3.0 */
+void* pa_pool_block_get_data(pa_pool_block *b);
+
+/** Return the size of the block in bytes. \since 3.0 */
+size_t pa_pool_block_get_length(pa_pool_block *b);
+
 PA_C_DECL_END
 
 #endif
@@ -319,10 +319,16 @@ typedef enum pa_stream_flags {
      * The data will be left as is and not reformatted, resampled.
      * \since 1.0 */
 
-    PA_STREAM_START_RAMP_MUTED = 0x100000U
+    PA_STREAM_START_RAMP_MUTED = 0x100000U,
     /**< Used to tag content that the stream will be started ramp volume
      * muted so that you can nicely fade it in */
 
+    PA_STREAM_RING_BUFFER = 0x200000U
+    /**< Write to this playback stream through a ring buffer in shared
+     * memory that the server reads from directly, with
+     * pa_stream_ring_buffer_write(). Only available for local
+     * connections that use shared memory. \since 3.0 */
+
 } pa_stream_flags_t;
 
 /** \cond fulldocs */
@@ -352,6 +358,7 @@ typedef enum pa_stream_flags {
 #define PA_STREAM_RELATIVE_VOLUME PA_STREAM_RELATIVE_VOLUME
 #define PA_STREAM_PASSTHROUGH PA_STREAM_PASSTHROUGH
 #define PA_STREAM_START_RAMP_MUTED PA_STREAM_START_RAMP_MUTED
+#define PA_STREAM_RING_BUFFER PA_STREAM_RING_BUFFER
 
 /** \endcond */
 
@@ -603,6 +610,41 @@ typedef enum pa_subscription_event_type {
 #define PA_SUBSCRIPTION_EVENT_TYPE_MASK PA_SUBSCRIPTION_EVENT_TYPE_MASK
 /** \endcond */
 
+/** The parts of the introspection replies that are expensive to
+ * collect or large, as used by pa_context_set_info_fields(). All
+ * other fields are always filled in. \since 3.0 */
+typedef enum pa_info_fields {
+    PA_INFO_FIELDS_PROPLIST = 0x0001U,
+    /**< The property lists of all objects. Otherwise they are empty. */
+
+    PA_INFO_FIELDS_PORTS = 0x0002U,
+    /**< All ports of sinks, sources and cards. Otherwise sinks and
+     * sources only list their active port and cards list none. */
+
+    PA_INFO_FIELDS_PROFILES = 0x0004U,
+    /**< All profiles of cards. Otherwise only the active one is listed. */
+
+    PA_INFO_FIELDS_FORMATS = 0x0008U,
+    /**< The formats of sinks and sources. Otherwise none are listed. */
+
+    PA_INFO_FIELDS_LATENCY = 0x0010U,
+    /**< The current latencies of sinks, sources, sink inputs and
+     * source outputs, which the server may have to query from the IO
+     * threads. Otherwise they are 0. */
+
+    PA_INFO_FIELDS_ALL = 0x001FU
+    /**< Everything */
+} pa_info_fields_t;
+
+/** \cond fulldocs */
+#define PA_INFO_FIELDS_PROPLIST PA_INFO_FIELDS_PROPLIST
+#define PA_INFO_FIELDS_PORTS PA_INFO_FIELDS_PORTS
+#define PA_INFO_FIELDS_PROFILES PA_INFO_FIELDS_PROFILES
+#define PA_INFO_FIELDS_FORMATS PA_INFO_FIELDS_FORMATS
+#define PA_INFO_FIELDS_LATENCY PA_INFO_FIELDS_LATENCY
+#define PA_INFO_FIELDS_ALL PA_INFO_FIELDS_ALL
+/** \endcond */
+
 /** A structure for all kinds of timing information of a stream. See
  * pa_stream_update_timing_info() and pa_stream_get_timing_info(). The
  * total output latency a sample that is written with
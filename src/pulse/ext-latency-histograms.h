@@ -0,0 +1,91 @@
+#ifndef foopulseextlatencyhistogramshfoo
+#define foopulseextlatencyhistogramshfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulse/cdecl.h>
+#include <pulse/context.h>
+#include <pulse/version.h>
+
+/** \file
+ *
+ * Routines for reading the IO thread latency histograms exported by
+ * module-latency-histograms
+ */
+
+PA_C_DECL_BEGIN
+
+/** The kind of object a histogram belongs to. \since 3.0 */
+typedef enum pa_ext_latency_histograms_object {
+    PA_EXT_LATENCY_HISTOGRAMS_SINK,       /**< A sink */
+    PA_EXT_LATENCY_HISTOGRAMS_SOURCE,     /**< A source */
+    PA_EXT_LATENCY_HISTOGRAMS_SINK_INPUT  /**< A sink input */
+} pa_ext_latency_histograms_object_t;
+
+/** One histogram of durations measured in an IO thread. Bucket 0
+ * counts durations below 2 usec, bucket n those from 2^n usec up to
+ * below 2^(n+1) usec, and the last bucket all longer ones. The measures
+ * are "render" (time spent rendering one buffer of a sink), "post"
+ * (time spent handing one buffer of a source to its streams), "wakeup"
+ * (how late the IO thread of a sink or source woke up for its timer)
+ * and "pop" (time spent getting data from the client part of a sink
+ * input). \since 3.0 */
+typedef struct pa_ext_latency_histograms_info {
+    pa_ext_latency_histograms_object_t object; /**< The kind of object measured */
+    uint32_t index;                            /**< The index of the sink, source or sink input */
+    const char *measure;                       /**< What was measured */
+    uint32_t n_buckets;                        /**< Number of entries in buckets */
+    const uint32_t *buckets;                   /**< How often a duration fell into each bucket */
+} pa_ext_latency_histograms_info;
+
+/** Callback prototype for pa_ext_latency_histograms_test(). \since 3.0 */
+typedef void (*pa_ext_latency_histograms_test_cb_t)(
+        pa_context *c,
+        uint32_t version,
+        void *userdata);
+
+/** Test if this extension module is available in the server. \since 3.0 */
+pa_operation *pa_ext_latency_histograms_test(
+        pa_context *c,
+        pa_ext_latency_histograms_test_cb_t cb,
+        void *userdata);
+
+/** Callback prototype for pa_ext_latency_histograms_read(). \since 3.0 */
+typedef void (*pa_ext_latency_histograms_read_cb_t)(
+        pa_context *c,
+        const pa_ext_latency_histograms_info *info,
+        int eol,
+        void *userdata);
+
+/** Read the histograms of all sinks, sources and sink inputs. \since 3.0 */
+pa_operation *pa_ext_latency_histograms_read(
+        pa_context *c,
+        pa_ext_latency_histograms_read_cb_t cb,
+        void *userdata);
+
+/** Start counting from zero again. \since 3.0 */
+pa_operation *pa_ext_latency_histograms_reset(
+        pa_context *c,
+        pa_context_success_cb_t cb,
+        void *userdata);
+
+PA_C_DECL_END
+
+#endif
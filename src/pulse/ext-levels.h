@@ -0,0 +1,94 @@
+#ifndef foopulseextlevelshfoo
+#define foopulseextlevelshfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulse/cdecl.h>
+#include <pulse/context.h>
+#include <pulse/sample.h>
+#include <pulse/version.h>
+
+/** \file
+ *
+ * Routines for receiving the levels of all devices and streams as
+ * measured by module-levels. This replaces opening one record stream
+ * with PA_STREAM_PEAK_DETECT per object to be metered.
+ */
+
+PA_C_DECL_BEGIN
+
+/** The kind of object a level belongs to. \since 3.0 */
+typedef enum pa_ext_levels_object {
+    PA_EXT_LEVELS_SINK,       /**< A sink */
+    PA_EXT_LEVELS_SOURCE,     /**< A source, including the monitor sources */
+    PA_EXT_LEVELS_SINK_INPUT  /**< A sink input, after its volume */
+} pa_ext_levels_object_t;
+
+/** The level of one object over the last interval, on a linear scale
+ * where 1.0 is full scale. Passthrough devices and streams are left
+ * out. \since 3.0 */
+typedef struct pa_ext_levels_info {
+    pa_ext_levels_object_t object; /**< The kind of object measured */
+    uint32_t index;                /**< The index of the sink, source or sink input */
+    float peak;                    /**< The highest absolute sample value */
+    float rms;                     /**< The root mean square of the samples */
+} pa_ext_levels_info;
+
+/** Callback prototype for pa_ext_levels_test(). \since 3.0 */
+typedef void (*pa_ext_levels_test_cb_t)(
+        pa_context *c,
+        uint32_t version,
+        void *userdata);
+
+/** Test if this extension module is available in the server. \since 3.0 */
+pa_operation *pa_ext_levels_test(
+        pa_context *c,
+        pa_ext_levels_test_cb_t cb,
+        void *userdata);
+
+/** Ask for the levels to be sent every interval usec, or stop them if
+ * interval is 0. The interval must be between 10 ms and 10 s. If
+ * several clients are subscribed all of them get the levels at the
+ * shortest interval asked for. \since 3.0 */
+pa_operation *pa_ext_levels_subscribe(
+        pa_context *c,
+        pa_usec_t interval,
+        pa_context_success_cb_t cb,
+        void *userdata);
+
+/** Callback prototype for pa_ext_levels_set_subscribe_cb(). levels
+ * holds n entries and is only valid during the call. \since 3.0 */
+typedef void (*pa_ext_levels_subscribe_cb_t)(
+        pa_context *c,
+        const pa_ext_levels_info *levels,
+        unsigned n,
+        void *userdata);
+
+/** Set the callback that is called with the levels of all objects
+ * once per interval after pa_ext_levels_subscribe() was
+ * called. \since 3.0 */
+void pa_ext_levels_set_subscribe_cb(
+        pa_context *c,
+        pa_ext_levels_subscribe_cb_t cb,
+        void *userdata);
+
+PA_C_DECL_END
+
+#endif
@@ -41,7 +41,9 @@ enum {
     SUBCOMMAND_CONNECT,
     SUBCOMMAND_DISCONNECT,
     SUBCOMMAND_SUBSCRIBE,
-    SUBCOMMAND_EVENT
+    SUBCOMMAND_EVENT,
+    SUBCOMMAND_SUBSCRIBE_NODES,
+    SUBCOMMAND_NODE_EVENT
 };
 
 static void ext_node_manager_test_cb(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
@@ -309,6 +311,75 @@ pa_operation *pa_ext_node_manager_subscribe(
     return o;
 }
 
+pa_operation *pa_ext_node_manager_subscribe_nodes(
+        pa_context *c,
+        int enable,
+        pa_context_success_cb_t cb,
+        void *userdata) {
+
+    uint32_t tag;
+    pa_operation *o;
+    pa_tagstruct *t;
+
+    pa_assert(c);
+    pa_assert(PA_REFCNT_VALUE(c) >= 1);
+
+    PA_CHECK_VALIDITY_RETURN_NULL(c, !pa_detect_fork(), PA_ERR_FORKED);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->state == PA_CONTEXT_READY, PA_ERR_BADSTATE);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->version >= 14, PA_ERR_NOTSUPPORTED);
+
+    o = pa_operation_new(c, NULL, (pa_operation_cb_t) cb, userdata);
+
+    t = pa_tagstruct_command(c, PA_COMMAND_EXTENSION, &tag);
+    pa_tagstruct_putu32(t, PA_INVALID_INDEX);
+    pa_tagstruct_puts(t, "module-murphy-ivi");
+    pa_tagstruct_putu32(t, SUBCOMMAND_SUBSCRIBE_NODES);
+    pa_tagstruct_put_boolean(t, enable);
+    pa_pstream_send_tagstruct(c->pstream, t);
+    pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, pa_context_simple_ack_callback, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
+
+    return o;
+}
+
+void pa_ext_node_manager_set_node_cb(
+        pa_context *c,
+        pa_ext_node_manager_node_cb_t cb,
+        void *userdata) {
+
+    pa_assert(c);
+    pa_assert(PA_REFCNT_VALUE(c) >= 1);
+
+    if (pa_detect_fork())
+        return;
+
+    c->ext_node_manager.node_callback = cb;
+    c->ext_node_manager.node_userdata = userdata;
+}
+
+static void node_event(pa_context *c, pa_tagstruct *t) {
+    pa_ext_node_manager_info i;
+    uint32_t event;
+
+    memset(&i, 0, sizeof(i));
+    i.props = pa_proplist_new();
+
+    if (pa_tagstruct_getu32(t, &event) < 0 ||
+        event > PA_EXT_NODE_MANAGER_EVENT_REMOVE ||
+        pa_tagstruct_gets(t, &i.name) < 0 ||
+        pa_tagstruct_get_proplist(t, i.props) < 0 ||
+        !pa_tagstruct_eof(t)) {
+
+        pa_context_fail(c, PA_ERR_PROTOCOL);
+        goto finish;
+    }
+
+    if (c->ext_node_manager.node_callback)
+        c->ext_node_manager.node_callback(c, (pa_ext_node_manager_event_t) event, &i, c->ext_node_manager.node_userdata);
+
+finish:
+    pa_proplist_free(i.props);
+}
+
 void pa_ext_node_manager_set_subscribe_cb(
         pa_context *c,
         pa_ext_node_manager_subscribe_cb_t cb,
@@ -331,14 +402,17 @@ void pa_ext_node_manager_command(pa_context *c, uint32_t tag, pa_tagstruct *t) {
     pa_assert(PA_REFCNT_VALUE(c) >= 1);
     pa_assert(t);
 
-    if (pa_tagstruct_getu32(t, &subcommand) < 0 ||
-        !pa_tagstruct_eof(t)) {
-
+    if (pa_tagstruct_getu32(t, &subcommand) < 0) {
         pa_context_fail(c, PA_ERR_PROTOCOL);
         return;
     }
 
-    if (subcommand != SUBCOMMAND_EVENT) {
+    if (subcommand == SUBCOMMAND_NODE_EVENT) {
+        node_event(c, t);
+        return;
+    }
+
+    if (subcommand != SUBCOMMAND_EVENT || !pa_tagstruct_eof(t)) {
         pa_context_fail(c, PA_ERR_PROTOCOL);
         return;
     }
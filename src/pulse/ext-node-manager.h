@@ -88,6 +88,35 @@ void pa_ext_node_manager_set_subscribe_cb(
         pa_ext_node_manager_subscribe_cb_t cb,
         void *userdata);
 
+/* Instead of a bare notification that makes the client read all nodes
+ * again, a node subscription delivers every change of a node as it
+ * happens. Servers that don't support it fail the operation, in which
+ * case pa_ext_node_manager_subscribe() and full reads still work. */
+
+typedef enum pa_ext_node_manager_event {
+    PA_EXT_NODE_MANAGER_EVENT_NEW,
+    PA_EXT_NODE_MANAGER_EVENT_CHANGE,
+    PA_EXT_NODE_MANAGER_EVENT_REMOVE
+} pa_ext_node_manager_event_t;
+
+pa_operation *pa_ext_node_manager_subscribe_nodes(
+        pa_context *c,
+        int enable,
+        pa_context_success_cb_t cb,
+        void *userdata);
+
+/* For PA_EXT_NODE_MANAGER_EVENT_REMOVE, info->props is empty. */
+typedef void (*pa_ext_node_manager_node_cb_t)(
+        pa_context *c,
+        pa_ext_node_manager_event_t event,
+        const pa_ext_node_manager_info *info,
+        void *userdata);
+
+void pa_ext_node_manager_set_node_cb(
+        pa_context *c,
+        pa_ext_node_manager_node_cb_t cb,
+        void *userdata);
+
 PA_C_DECL_END
 
 #endif
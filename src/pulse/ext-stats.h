@@ -0,0 +1,133 @@
+#ifndef foopulseextstatshfoo
+#define foopulseextstatshfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulse/cdecl.h>
+#include <pulse/context.h>
+#include <pulse/version.h>
+
+/** \file
+ *
+ * Routines for reading the IO thread statistics of devices and streams
+ * exported by module-stats
+ */
+
+PA_C_DECL_BEGIN
+
+/** The kind of object statistics belong to. \since 3.0 */
+typedef enum pa_ext_stats_object {
+    PA_EXT_STATS_SINK,          /**< A sink */
+    PA_EXT_STATS_SOURCE,        /**< A source */
+    PA_EXT_STATS_SINK_INPUT,    /**< A sink input */
+    PA_EXT_STATS_SOURCE_OUTPUT  /**< A source output */
+} pa_ext_stats_object_t;
+
+/** What the IO thread spent on a device or stream. The counters start
+ * at zero when the object is created or the statistics are reset, and
+ * wrap around at 2^32, so look at the differences between two reads.
+ * \since 3.0 */
+typedef struct pa_ext_stats_info {
+    pa_ext_stats_object_t object;   /**< The kind of object */
+    uint32_t index;                 /**< The index of the sink, source or stream */
+    const char *name;               /**< The name of the device, or the media name of the stream. May be NULL. */
+    uint32_t busy_usec;             /**< Time spent rendering a sink, posting a source, or in the client part of a stream */
+    uint32_t resample_usec;         /**< Time spent resampling a stream */
+    uint32_t rewinds;               /**< Number of rewinds */
+    uint32_t rewind_bytes;          /**< Bytes rewound, in the sample spec of the device */
+    uint32_t underruns;             /**< Number of times a sink or sink input ran out of data */
+    uint32_t overruns;              /**< Number of times data of a source or source output had to be dropped */
+    const char *resample_method;    /**< The resampler of a stream, or NULL if there is none */
+    pa_usec_t buffer_usec;          /**< What is currently buffered in the device, or by the stream */
+    pa_usec_t watermark_usec;       /**< The wakeup watermark of a timer scheduled device, otherwise 0 */
+    uint32_t rerender_bytes;        /**< The part of rewind_bytes of a sink input that was older than its history and had to be rendered again */
+    uint32_t history_bytes;         /**< How much rendered data a sink input keeps for rewinds, in the sample spec of the sink */
+    uint32_t resample_degradation;  /**< How many steps the resampler of a sink input has been moved towards cheaper methods to save CPU time */
+    uint32_t cpu_usec;              /**< Of devices, the CPU time of the IO thread they run in, which is not reset. Of the streams feeding filter devices, the CPU time the filter used. */
+} pa_ext_stats_info;
+
+/** Callback prototype for pa_ext_stats_test(). \since 3.0 */
+typedef void (*pa_ext_stats_test_cb_t)(
+        pa_context *c,
+        uint32_t version,
+        void *userdata);
+
+/** Test if this extension module is available in the server. \since 3.0 */
+pa_operation *pa_ext_stats_test(
+        pa_context *c,
+        pa_ext_stats_test_cb_t cb,
+        void *userdata);
+
+/** Callback prototype for pa_ext_stats_read(). \since 3.0 */
+typedef void (*pa_ext_stats_read_cb_t)(
+        pa_context *c,
+        const pa_ext_stats_info *info,
+        int eol,
+        void *userdata);
+
+/** Read the statistics of all sinks, sources and streams. \since 3.0 */
+pa_operation *pa_ext_stats_read(
+        pa_context *c,
+        pa_ext_stats_read_cb_t cb,
+        void *userdata);
+
+/** What a memory account belongs to. \since 3.0 */
+typedef enum pa_ext_stats_memory_object {
+    PA_EXT_STATS_MEMORY_TOTAL,          /**< Everything the daemon buffers */
+    PA_EXT_STATS_MEMORY_SAMPLE_CACHE,   /**< The sample cache */
+    PA_EXT_STATS_MEMORY_CLIENT          /**< The streams of a client */
+} pa_ext_stats_memory_object_t;
+
+/** How much memory the audio buffered in the daemon takes up: the
+ * queues of the streams including what they keep for rewinds, and the
+ * sample cache. \since 3.0 */
+typedef struct pa_ext_stats_memory_info {
+    pa_ext_stats_memory_object_t object;  /**< What the memory belongs to */
+    uint32_t index;                       /**< The index of the client, otherwise PA_INVALID_INDEX */
+    const char *name;                     /**< The application name of the client. May be NULL. */
+    uint64_t used;                        /**< Bytes currently used */
+    uint64_t peak;                        /**< The most bytes used since the account was created or the statistics were reset */
+    uint64_t budget;                      /**< The budget in bytes, or 0 if there is none */
+} pa_ext_stats_memory_info;
+
+/** Callback prototype for pa_ext_stats_read_memory(). \since 3.0 */
+typedef void (*pa_ext_stats_read_memory_cb_t)(
+        pa_context *c,
+        const pa_ext_stats_memory_info *info,
+        int eol,
+        void *userdata);
+
+/** Read the memory use of the daemon, the sample cache and every
+ * client. Needs version 2 of the extension. \since 3.0 */
+pa_operation *pa_ext_stats_read_memory(
+        pa_context *c,
+        pa_ext_stats_read_memory_cb_t cb,
+        void *userdata);
+
+/** Start counting from zero again. With version 2 of the extension the
+ * memory peaks are reset as well. \since 3.0 */
+pa_operation *pa_ext_stats_reset(
+        pa_context *c,
+        pa_context_success_cb_t cb,
+        void *userdata);
+
+PA_C_DECL_END
+
+#endif
@@ -39,7 +39,8 @@ enum {
     SUBCOMMAND_WRITE,
     SUBCOMMAND_DELETE,
     SUBCOMMAND_SUBSCRIBE,
-    SUBCOMMAND_EVENT
+    SUBCOMMAND_EVENT,
+    SUBCOMMAND_READ_PAGE
 };
 
 static void ext_stream_restore_test_cb(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
@@ -102,6 +103,23 @@ pa_operation *pa_ext_stream_restore_test(
     return o;
 }
 
+static int read_entry(pa_tagstruct *t, pa_ext_stream_restore_info *i) {
+    pa_bool_t mute = FALSE;
+
+    memset(i, 0, sizeof(*i));
+
+    if (pa_tagstruct_gets(t, &i->name) < 0 ||
+        pa_tagstruct_get_channel_map(t, &i->channel_map) < 0 ||
+        pa_tagstruct_get_cvolume(t, &i->volume) < 0 ||
+        pa_tagstruct_gets(t, &i->device) < 0 ||
+        pa_tagstruct_get_boolean(t, &mute) < 0)
+        return -1;
+
+    i->mute = (int) mute;
+
+    return 0;
+}
+
 static void ext_stream_restore_read_cb(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_operation *o = userdata;
     int eol = 1;
@@ -122,22 +140,12 @@ static void ext_stream_restore_read_cb(pa_pdispatch *pd, uint32_t command, uint3
 
         while (!pa_tagstruct_eof(t)) {
             pa_ext_stream_restore_info i;
-            pa_bool_t mute = FALSE;
-
-            memset(&i, 0, sizeof(i));
-
-            if (pa_tagstruct_gets(t, &i.name) < 0 ||
-                pa_tagstruct_get_channel_map(t, &i.channel_map) < 0 ||
-                pa_tagstruct_get_cvolume(t, &i.volume) < 0 ||
-                pa_tagstruct_gets(t, &i.device) < 0 ||
-                pa_tagstruct_get_boolean(t, &mute) < 0) {
 
+            if (read_entry(t, &i) < 0) {
                 pa_context_fail(o->context, PA_ERR_PROTOCOL);
                 goto finish;
             }
 
-            i.mute = (int) mute;
-
             if (o->callback) {
                 pa_ext_stream_restore_read_cb_t cb = (pa_ext_stream_restore_read_cb_t) o->callback;
                 cb(o->context, &i, 0, o->userdata);
@@ -183,6 +191,89 @@ pa_operation *pa_ext_stream_restore_read(
     return o;
 }
 
+static void ext_stream_restore_read_page_cb(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_operation *o = userdata;
+    const char *cursor = NULL;
+    int eol = 1;
+
+    pa_assert(pd);
+    pa_assert(o);
+    pa_assert(PA_REFCNT_VALUE(o) >= 1);
+
+    if (!o->context)
+        goto finish;
+
+    if (command != PA_COMMAND_REPLY) {
+        if (pa_context_handle_error(o->context, command, t, FALSE) < 0)
+            goto finish;
+
+        eol = -1;
+    } else {
+
+        if (pa_tagstruct_gets(t, &cursor) < 0) {
+            pa_context_fail(o->context, PA_ERR_PROTOCOL);
+            goto finish;
+        }
+
+        while (!pa_tagstruct_eof(t)) {
+            pa_ext_stream_restore_info i;
+
+            if (read_entry(t, &i) < 0) {
+                pa_context_fail(o->context, PA_ERR_PROTOCOL);
+                goto finish;
+            }
+
+            if (o->callback) {
+                pa_ext_stream_restore_read_page_cb_t cb = (pa_ext_stream_restore_read_page_cb_t) o->callback;
+                cb(o->context, &i, 0, NULL, o->userdata);
+            }
+        }
+    }
+
+    if (o->callback) {
+        pa_ext_stream_restore_read_page_cb_t cb = (pa_ext_stream_restore_read_page_cb_t) o->callback;
+        cb(o->context, NULL, eol, cursor, o->userdata);
+    }
+
+finish:
+    pa_operation_done(o);
+    pa_operation_unref(o);
+}
+
+pa_operation *pa_ext_stream_restore_read_page(
+        pa_context *c,
+        const char *prefix,
+        const char *cursor,
+        uint32_t max_entries,
+        pa_ext_stream_restore_read_page_cb_t cb,
+        void *userdata) {
+
+    uint32_t tag;
+    pa_operation *o;
+    pa_tagstruct *t;
+
+    pa_assert(c);
+    pa_assert(PA_REFCNT_VALUE(c) >= 1);
+
+    PA_CHECK_VALIDITY_RETURN_NULL(c, !pa_detect_fork(), PA_ERR_FORKED);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->state == PA_CONTEXT_READY, PA_ERR_BADSTATE);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->version >= 14, PA_ERR_NOTSUPPORTED);
+
+    o = pa_operation_new(c, NULL, (pa_operation_cb_t) cb, userdata);
+
+    t = pa_tagstruct_command(c, PA_COMMAND_EXTENSION, &tag);
+    pa_tagstruct_putu32(t, PA_INVALID_INDEX);
+    pa_tagstruct_puts(t, "module-stream-restore");
+    pa_tagstruct_putu32(t, SUBCOMMAND_READ_PAGE);
+    pa_tagstruct_puts(t, prefix);
+    pa_tagstruct_puts(t, cursor);
+    pa_tagstruct_putu32(t, max_entries);
+    pa_pstream_send_tagstruct(c->pstream, t);
+    pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, ext_stream_restore_read_page_cb, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
+
+    return o;
+}
+
 pa_operation *pa_ext_stream_restore_write(
         pa_context *c,
         pa_update_mode_t mode,
@@ -70,6 +70,35 @@ pa_operation *pa_ext_stream_restore_read(
         pa_ext_stream_restore_read_cb_t cb,
         void *userdata);
 
+/** Callback prototype for pa_ext_stream_restore_read_page(). Called
+ * with eol 0 for each entry of the page, then once with info NULL and
+ * eol 1, or negative on error. In that last call cursor is what to
+ * pass to pa_ext_stream_restore_read_page() for the next page, or NULL
+ * if this was the last one. It is only valid during the callback.
+ * \since 3.0 */
+typedef void (*pa_ext_stream_restore_read_page_cb_t)(
+        pa_context *c,
+        const pa_ext_stream_restore_info *info,
+        int eol,
+        const char *cursor,
+        void *userdata);
+
+/** Read up to max_entries entries from the stream database, whose
+ * names start with prefix, which may be NULL to read all of them. Pass
+ * NULL as cursor for the first page, then the cursor handed to the
+ * callback. The server sends no more than 1024 entries at a time,
+ * which is also the number sent if max_entries is 0. If the entry the
+ * cursor refers to was deleted in the meantime, the operation fails
+ * with PA_ERR_NOENTITY. Requires version 2 of the extension, see
+ * pa_ext_stream_restore_test(). \since 3.0 */
+pa_operation *pa_ext_stream_restore_read_page(
+        pa_context *c,
+        const char *prefix,
+        const char *cursor,
+        uint32_t max_entries,
+        pa_ext_stream_restore_read_page_cb_t cb,
+        void *userdata);
+
 /** Store entries in the stream database. \since 0.9.12 */
 pa_operation *pa_ext_stream_restore_write(
         pa_context *c,
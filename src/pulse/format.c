@@ -47,6 +47,10 @@ static const char* const _encoding_str_table[]= {
     [PA_ENCODING_EAC3_IEC61937] = "eac3-iec61937",
     [PA_ENCODING_MPEG_IEC61937] = "mpeg-iec61937",
     [PA_ENCODING_DTS_IEC61937] = "dts-iec61937",
+    [PA_ENCODING_OPUS] = "opus",
+    [PA_ENCODING_AC3] = "ac3",
+    [PA_ENCODING_EAC3] = "eac3",
+    [PA_ENCODING_DTS] = "dts",
     [PA_ENCODING_ANY] = "any",
 };
 
@@ -225,8 +229,13 @@ static int pa_format_info_to_sample_spec_fake(pa_format_info *f, pa_sample_spec
     pa_assert(f);
     pa_assert(ss);
 
-    /* Note: When we add support for non-IEC61937 encapsulated compressed
-     * formats, this function should return a non-zero values for these. */
+    /* Formats that are not IEC61937 encapsulated have no fixed size-time
+     * conversion */
+    if (f->encoding == PA_ENCODING_OPUS ||
+        f->encoding == PA_ENCODING_AC3 ||
+        f->encoding == PA_ENCODING_EAC3 ||
+        f->encoding == PA_ENCODING_DTS)
+        return -PA_ERR_NOTSUPPORTED;
 
     ss->format = PA_SAMPLE_S16LE;
     ss->channels = 2;
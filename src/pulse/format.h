@@ -55,6 +55,21 @@ typedef enum pa_encoding {
     PA_ENCODING_DTS_IEC61937,
     /**< DTS data encapsulated in IEC 61937 header/padding */
 
+    PA_ENCODING_OPUS,
+    /**< Opus packets, as used for compressed network streams. The format
+     * properties describe the decoded PCM data. \since 3.0 */
+
+    PA_ENCODING_AC3,
+    /**< Raw AC3 frames, which the server encapsulates in IEC 61937 for
+     * a passthrough sink. \since 3.0 */
+
+    PA_ENCODING_EAC3,
+    /**< Raw EAC3 frames, see PA_ENCODING_AC3. \since 3.0 */
+
+    PA_ENCODING_DTS,
+    /**< Raw DTS frames, see PA_ENCODING_AC3. Only the 16 bit big endian
+     * core stream is supported. \since 3.0 */
+
     PA_ENCODING_MAX,
     /**< Valid encoding types must be less than this value */
 
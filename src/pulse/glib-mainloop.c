@@ -53,6 +53,10 @@ struct pa_time_event {
 
     int enabled;
     struct timeval timeval;
+    pa_usec_t time;
+
+    /* Position in time_heap while enabled */
+    unsigned heap_idx;
 
     pa_time_event_cb_t callback;
     void *userdata;
@@ -82,14 +86,91 @@ struct pa_glib_mainloop {
 
     PA_LLIST_HEAD(pa_io_event, io_events);
     PA_LLIST_HEAD(pa_time_event, time_events);
+
+    /* Enabled defer events are kept on a list of their own, so that
+     * the next one to dispatch is always the first */
     PA_LLIST_HEAD(pa_defer_event, defer_events);
+    PA_LLIST_HEAD(pa_defer_event, enabled_defer_events);
 
-    int n_enabled_defer_events, n_enabled_time_events;
-    int io_events_please_scan, time_events_please_scan, defer_events_please_scan;
+    /* The enabled time events, a binary min-heap on their time */
+    pa_time_event **time_heap;
+    unsigned max_time_heap;
 
-    pa_time_event *cached_next_time_event;
+    int n_enabled_defer_events;
+    unsigned n_enabled_time_events;
+    int io_events_please_scan, time_events_please_scan, defer_events_please_scan;
 };
 
+/* Time event heap */
+static void heap_set(pa_glib_mainloop *g, unsigned i, pa_time_event *e) {
+    g->time_heap[i] = e;
+    e->heap_idx = i;
+}
+
+static void heap_sift_up(pa_glib_mainloop *g, unsigned i) {
+    pa_time_event *e = g->time_heap[i];
+
+    while (i > 0) {
+        unsigned parent = (i - 1) / 2;
+
+        if (g->time_heap[parent]->time <= e->time)
+            break;
+
+        heap_set(g, i, g->time_heap[parent]);
+        i = parent;
+    }
+
+    heap_set(g, i, e);
+}
+
+static void heap_sift_down(pa_glib_mainloop *g, unsigned i) {
+    pa_time_event *e = g->time_heap[i];
+    unsigned n = g->n_enabled_time_events;
+
+    for (;;) {
+        unsigned child = 2 * i + 1;
+
+        if (child >= n)
+            break;
+
+        if (child + 1 < n && g->time_heap[child + 1]->time < g->time_heap[child]->time)
+            child++;
+
+        if (e->time <= g->time_heap[child]->time)
+            break;
+
+        heap_set(g, i, g->time_heap[child]);
+        i = child;
+    }
+
+    heap_set(g, i, e);
+}
+
+static void heap_insert(pa_glib_mainloop *g, pa_time_event *e) {
+    if (g->n_enabled_time_events >= g->max_time_heap) {
+        g->max_time_heap = PA_MAX(16U, g->max_time_heap * 2);
+        g->time_heap = pa_xrenew(pa_time_event*, g->time_heap, g->max_time_heap);
+    }
+
+    heap_set(g, g->n_enabled_time_events++, e);
+    heap_sift_up(g, e->heap_idx);
+}
+
+static void heap_remove(pa_glib_mainloop *g, pa_time_event *e) {
+    unsigned i = e->heap_idx;
+
+    g_assert(g->n_enabled_time_events > 0);
+    g_assert(i < g->n_enabled_time_events);
+    g_assert(g->time_heap[i] == e);
+
+    if (i == --g->n_enabled_time_events)
+        return;
+
+    heap_set(g, i, g->time_heap[g->n_enabled_time_events]);
+    heap_sift_up(g, i);
+    heap_sift_down(g, g->time_heap[i]->heap_idx);
+}
+
 static void cleanup_io_events(pa_glib_mainloop *g, int force) {
     pa_io_event *e;
 
@@ -141,10 +222,8 @@ static void cleanup_time_events(pa_glib_mainloop *g, int force) {
                 g->time_events_please_scan--;
             }
 
-            if (!e->dead && e->enabled) {
-                g_assert(g->n_enabled_time_events > 0);
-                g->n_enabled_time_events--;
-            }
+            if (!e->dead && e->enabled)
+                heap_remove(g, e);
 
             if (e->destroy_callback)
                 e->destroy_callback(&g->api, e, e->userdata);
@@ -161,6 +240,13 @@ static void cleanup_time_events(pa_glib_mainloop *g, int force) {
 static void cleanup_defer_events(pa_glib_mainloop *g, int force) {
     pa_defer_event *e;
 
+    /* Dead events are never on the list of enabled ones */
+    if (force)
+        while ((e = g->enabled_defer_events)) {
+            PA_LLIST_REMOVE(pa_defer_event, g->enabled_defer_events, e);
+            PA_LLIST_PREPEND(pa_defer_event, g->defer_events, e);
+        }
+
     e = g->defer_events;
     while (e) {
         pa_defer_event *n = e->next;
@@ -296,14 +382,8 @@ static pa_time_event* glib_time_new(
 
     if ((e->enabled = !!tv)) {
         e->timeval = *tv;
-        g->n_enabled_time_events++;
-
-        if (g->cached_next_time_event) {
-            g_assert(g->cached_next_time_event->enabled);
-
-            if (pa_timeval_cmp(tv, &g->cached_next_time_event->timeval) < 0)
-                g->cached_next_time_event = e;
-        }
+        e->time = pa_timeval_load(tv);
+        heap_insert(g, e);
     }
 
     e->callback = cb;
@@ -319,22 +399,24 @@ static void glib_time_restart(pa_time_event*e, const struct timeval *tv) {
     g_assert(e);
     g_assert(!e->dead);
 
-    if (e->enabled && !tv) {
-        g_assert(e->mainloop->n_enabled_time_events > 0);
-        e->mainloop->n_enabled_time_events--;
-    } else if (!e->enabled && tv)
-        e->mainloop->n_enabled_time_events++;
+    if (!tv) {
+        if (e->enabled)
+            heap_remove(e->mainloop, e);
 
-    if ((e->enabled = !!tv))
-        e->timeval = *tv;
+        e->enabled = 0;
+        return;
+    }
 
-    if (e->mainloop->cached_next_time_event && e->enabled) {
-        g_assert(e->mainloop->cached_next_time_event->enabled);
+    e->timeval = *tv;
+    e->time = pa_timeval_load(tv);
 
-        if (pa_timeval_cmp(tv, &e->mainloop->cached_next_time_event->timeval) < 0)
-            e->mainloop->cached_next_time_event = e;
-    } else if (e->mainloop->cached_next_time_event == e)
-        e->mainloop->cached_next_time_event = NULL;
+    if (e->enabled) {
+        heap_sift_up(e->mainloop, e->heap_idx);
+        heap_sift_down(e->mainloop, e->heap_idx);
+    } else {
+        e->enabled = 1;
+        heap_insert(e->mainloop, e);
+    }
 }
 
 static void glib_time_free(pa_time_event *e) {
@@ -345,10 +427,7 @@ static void glib_time_free(pa_time_event *e) {
     e->mainloop->time_events_please_scan++;
 
     if (e->enabled)
-        e->mainloop->n_enabled_time_events--;
-
-    if (e->mainloop->cached_next_time_event == e)
-        e->mainloop->cached_next_time_event = NULL;
+        heap_remove(e->mainloop, e);
 }
 
 static void glib_time_set_destroy(pa_time_event *e, pa_time_event_destroy_cb_t cb) {
@@ -385,7 +464,7 @@ static pa_defer_event* glib_defer_new(
     e->userdata = userdata;
     e->destroy_callback = NULL;
 
-    PA_LLIST_PREPEND(pa_defer_event, g->defer_events, e);
+    PA_LLIST_PREPEND(pa_defer_event, g->enabled_defer_events, e);
     return e;
 }
 
@@ -396,10 +475,17 @@ static void glib_defer_enable(pa_defer_event *e, int b) {
     if (e->enabled && !b) {
         g_assert(e->mainloop->n_enabled_defer_events > 0);
         e->mainloop->n_enabled_defer_events--;
-    } else if (!e->enabled && b)
+
+        PA_LLIST_REMOVE(pa_defer_event, e->mainloop->enabled_defer_events, e);
+        PA_LLIST_PREPEND(pa_defer_event, e->mainloop->defer_events, e);
+    } else if (!e->enabled && b) {
         e->mainloop->n_enabled_defer_events++;
 
-    e->enabled = b;
+        PA_LLIST_REMOVE(pa_defer_event, e->mainloop->defer_events, e);
+        PA_LLIST_PREPEND(pa_defer_event, e->mainloop->enabled_defer_events, e);
+    }
+
+    e->enabled = !!b;
 }
 
 static void glib_defer_free(pa_defer_event *e) {
@@ -412,6 +498,9 @@ static void glib_defer_free(pa_defer_event *e) {
     if (e->enabled) {
         g_assert(e->mainloop->n_enabled_defer_events > 0);
         e->mainloop->n_enabled_defer_events--;
+
+        PA_LLIST_REMOVE(pa_defer_event, e->mainloop->enabled_defer_events, e);
+        PA_LLIST_PREPEND(pa_defer_event, e->mainloop->defer_events, e);
     }
 }
 
@@ -431,29 +520,11 @@ static void glib_quit(pa_mainloop_api*a, int retval) {
     /* NOOP */
 }
 
-static pa_time_event* find_next_time_event(pa_glib_mainloop *g) {
-    pa_time_event *t, *n = NULL;
-    g_assert(g);
-
-    if (g->cached_next_time_event)
-        return g->cached_next_time_event;
+static pa_usec_t source_now(GSource *source) {
+    GTimeVal now;
 
-    for (t = g->time_events; t; t = t->next) {
-
-        if (t->dead || !t->enabled)
-            continue;
-
-        if (!n || pa_timeval_cmp(&t->timeval, &n->timeval) < 0) {
-            n = t;
-
-            /* Shortcut for tv = { 0, 0 } */
-            if (n->timeval.tv_sec <= 0)
-                break;
-        }
-    }
-
-    g->cached_next_time_event = n;
-    return n;
+    g_source_get_current_time(source, &now);
+    return (pa_usec_t) now.tv_sec * PA_USEC_PER_SEC + (pa_usec_t) now.tv_usec;
 }
 
 static void scan_dead(pa_glib_mainloop *g) {
@@ -481,24 +552,16 @@ static gboolean prepare_func(GSource *source, gint *timeout) {
         *timeout = 0;
         return TRUE;
     } else if (g->n_enabled_time_events) {
-        pa_time_event *t;
-        GTimeVal now;
-        struct timeval tvnow;
-        pa_usec_t usec;
-
-        t = find_next_time_event(g);
-        g_assert(t);
+        pa_usec_t now;
 
-        g_source_get_current_time(source, &now);
-        tvnow.tv_sec = now.tv_sec;
-        tvnow.tv_usec = now.tv_usec;
+        now = source_now(source);
 
-        if (pa_timeval_cmp(&t->timeval, &tvnow) <= 0) {
+        if (g->time_heap[0]->time <= now) {
             *timeout = 0;
             return TRUE;
         }
-        usec = pa_timeval_diff(&t->timeval, &tvnow);
-        *timeout = (gint) (usec / 1000);
+
+        *timeout = (gint) ((g->time_heap[0]->time - now) / 1000);
     } else
         *timeout = -1;
 
@@ -512,21 +575,8 @@ static gboolean check_func(GSource *source) {
 
     if (g->n_enabled_defer_events)
         return TRUE;
-    else if (g->n_enabled_time_events) {
-        pa_time_event *t;
-        GTimeVal now;
-        struct timeval tvnow;
-
-        t = find_next_time_event(g);
-        g_assert(t);
-
-        g_source_get_current_time(source, &now);
-        tvnow.tv_sec = now.tv_sec;
-        tvnow.tv_usec = now.tv_usec;
-
-        if (pa_timeval_cmp(&t->timeval, &tvnow) <= 0)
-            return TRUE;
-    }
+    else if (g->n_enabled_time_events && g->time_heap[0]->time <= source_now(source))
+        return TRUE;
 
     for (e = g->io_events; e; e = e->next)
         if (!e->dead && e->poll_fd.revents != 0)
@@ -542,51 +592,37 @@ static gboolean dispatch_func(GSource *source, GSourceFunc callback, gpointer us
     g_assert(g);
 
     if (g->n_enabled_defer_events) {
-        pa_defer_event *d;
-
-        for (d = g->defer_events; d; d = d->next) {
-            if (d->dead || !d->enabled)
-                continue;
-
-            break;
-        }
+        pa_defer_event *d = g->enabled_defer_events;
 
         g_assert(d);
+        g_assert(d->enabled && !d->dead);
 
         d->callback(&g->api, d, d->userdata);
         return TRUE;
     }
 
-    if (g->n_enabled_time_events) {
-        GTimeVal now;
-        struct timeval tvnow;
-        pa_time_event *t;
-
-        t = find_next_time_event(g);
-        g_assert(t);
-
-        g_source_get_current_time(source, &now);
-        tvnow.tv_sec = now.tv_sec;
-        tvnow.tv_usec = now.tv_usec;
+    if (g->n_enabled_time_events && g->time_heap[0]->time <= source_now(source)) {
+        pa_time_event *t = g->time_heap[0];
 
-        if (pa_timeval_cmp(&t->timeval, &tvnow) <= 0) {
+        /* Disable time event */
+        glib_time_restart(t, NULL);
 
-            /* Disable time event */
-            glib_time_restart(t, NULL);
-
-            t->callback(&g->api, t, &t->timeval, t->userdata);
-            return TRUE;
-        }
+        t->callback(&g->api, t, &t->timeval, t->userdata);
+        return TRUE;
     }
 
+    /* Handle all ready io events in one go rather than one per main
+     * loop iteration. Events freed by a callback are only marked dead
+     * until the next prepare, so walking on is safe. */
     for (e = g->io_events; e; e = e->next)
         if (!e->dead && e->poll_fd.revents != 0) {
-            e->callback(&g->api, e, e->poll_fd.fd, map_flags_from_glib(e->poll_fd.revents), e->userdata);
+            gushort revents = e->poll_fd.revents;
+
             e->poll_fd.revents = 0;
-            return TRUE;
+            e->callback(&g->api, e, e->poll_fd.fd, map_flags_from_glib(revents), e->userdata);
         }
 
-    return FALSE;
+    return TRUE;
 }
 
 static const pa_mainloop_api vtable = {
@@ -631,11 +667,14 @@ pa_glib_mainloop *pa_glib_mainloop_new(GMainContext *c) {
     PA_LLIST_HEAD_INIT(pa_io_event, g->io_events);
     PA_LLIST_HEAD_INIT(pa_time_event, g->time_events);
     PA_LLIST_HEAD_INIT(pa_defer_event, g->defer_events);
+    PA_LLIST_HEAD_INIT(pa_defer_event, g->enabled_defer_events);
 
-    g->n_enabled_defer_events = g->n_enabled_time_events = 0;
-    g->io_events_please_scan = g->time_events_please_scan = g->defer_events_please_scan = 0;
+    g->time_heap = NULL;
+    g->max_time_heap = 0;
 
-    g->cached_next_time_event = NULL;
+    g->n_enabled_defer_events = 0;
+    g->n_enabled_time_events = 0;
+    g->io_events_please_scan = g->time_events_please_scan = g->defer_events_please_scan = 0;
 
     g_source_attach(&g->source, g->context);
     g_source_set_can_recurse(&g->source, FALSE);
@@ -650,6 +689,8 @@ void pa_glib_mainloop_free(pa_glib_mainloop* g) {
     cleanup_defer_events(g, 1);
     cleanup_time_events(g, 1);
 
+    pa_xfree(g->time_heap);
+
     g_main_context_unref(g->context);
     g_source_destroy(&g->source);
     g_source_unref(&g->source);
@@ -28,10 +28,12 @@
 #include <pulse/stream.h>
 #include <pulse/operation.h>
 #include <pulse/subscribe.h>
+#include <pulse/introspect.h>
 #include <pulse/ext-device-manager.h>
 #include <pulse/ext-device-restore.h>
 #include <pulse/ext-stream-restore.h>
 #include <pulse/ext-node-manager.h>
+#include <pulse/ext-levels.h>
 
 #include <pulsecore/socket-client.h>
 #include <pulsecore/pstream.h>
@@ -41,6 +43,7 @@
 #include <pulsecore/strlist.h>
 #include <pulsecore/mcalign.h>
 #include <pulsecore/memblockq.h>
+#include <pulsecore/stream-ring.h>
 #include <pulsecore/hashmap.h>
 #include <pulsecore/refcnt.h>
 #include <pulsecore/time-smoother.h>
@@ -64,6 +67,7 @@ struct pa_context {
     pa_mainloop_api* mainloop;
 
     pa_socket_client *client;
+    PA_LLIST_HEAD(struct pa_context_attempt, attempts);
     pa_pstream *pstream;
     pa_pdispatch *pdispatch;
 
@@ -81,6 +85,9 @@ struct pa_context {
     void *state_userdata;
     pa_context_subscribe_cb_t subscribe_callback;
     void *subscribe_userdata;
+    pa_snapshot_callbacks snapshot_callbacks;
+    void *snapshot_userdata;
+    pa_info_fields_t info_fields;
     pa_context_event_cb_t event_callback;
     void *event_userdata;
 
@@ -119,7 +126,13 @@ struct pa_context {
     struct {
         pa_ext_node_manager_subscribe_cb_t callback;
         void *userdata;
+        pa_ext_node_manager_node_cb_t node_callback;
+        void *node_userdata;
     } ext_node_manager;
+    struct {
+        pa_ext_levels_subscribe_cb_t callback;
+        void *userdata;
+    } ext_levels;
 };
 
 #define PA_MAX_WRITE_INDEX_CORRECTIONS 32
@@ -134,6 +147,18 @@ typedef struct pa_index_correction {
 
 #define PA_MAX_FORMATS (PA_ENCODING_MAX)
 
+struct pa_pool_block {
+    PA_REFCNT_DECLARE;
+
+    /* Only compared against, to make sure the block is written to a
+     * stream of the context it was allocated from */
+    pa_mempool *pool;
+
+    /* Acquired for as long as the block exists */
+    pa_memblock *memblock;
+    void *data;
+};
+
 struct pa_stream {
     PA_REFCNT_DECLARE;
     PA_LLIST_FIELDS(pa_stream);
@@ -160,6 +185,8 @@ struct pa_stream {
     pa_bool_t corked:1;
     pa_bool_t timing_info_valid:1;
     pa_bool_t auto_timing_update_requested:1;
+    /* The server sends timing info by itself, no need to poll */
+    pa_bool_t timing_pushed:1;
 
     uint32_t channel;
     uint32_t syncid;
@@ -175,6 +202,7 @@ struct pa_stream {
     pa_memblock *write_memblock;
     void *write_data;
     int64_t latest_underrun_at_index;
+    pa_stream_ring *ring;
 
     /* recording */
     pa_memchunk peek_memchunk;
@@ -246,10 +274,12 @@ struct pa_operation {
 void pa_command_request(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 void pa_command_stream_killed(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 void pa_command_subscribe_event(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
+int pa_context_read_snapshot_object(pa_context *c, pa_subscription_event_type_t facility, pa_tagstruct *t);
 void pa_command_overflow_or_underflow(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 void pa_command_stream_suspended(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 void pa_command_stream_moved(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 void pa_command_stream_started(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
+void pa_command_playback_timing(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 void pa_command_stream_event(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 void pa_command_client_event(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 void pa_command_stream_buffer_attr(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
@@ -308,6 +338,7 @@ void pa_ext_device_manager_command(pa_context *c, uint32_t tag, pa_tagstruct *t)
 void pa_ext_device_restore_command(pa_context *c, uint32_t tag, pa_tagstruct *t);
 void pa_ext_stream_restore_command(pa_context *c, uint32_t tag, pa_tagstruct *t);
 void pa_ext_node_manager_command(pa_context *c, uint32_t tag, pa_tagstruct *t);
+void pa_ext_levels_command(pa_context *c, uint32_t tag, pa_tagstruct *t);
 
 void pa_format_info_free2(pa_format_info *f, void *userdata);
 
@@ -40,6 +40,7 @@
 static void context_stat_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_operation *o = userdata;
     pa_stat_info i, *p = &i;
+    uint32_t j;
 
     pa_assert(pd);
     pa_assert(o);
@@ -55,14 +56,31 @@ static void context_stat_callback(pa_pdispatch *pd, uint32_t command, uint32_t t
             goto finish;
 
         p = NULL;
-    } else if (pa_tagstruct_getu32(t, &i.memblock_total) < 0 ||
-               pa_tagstruct_getu32(t, &i.memblock_total_size) < 0 ||
-               pa_tagstruct_getu32(t, &i.memblock_allocated) < 0 ||
-               pa_tagstruct_getu32(t, &i.memblock_allocated_size) < 0 ||
-               pa_tagstruct_getu32(t, &i.scache_size) < 0 ||
-               !pa_tagstruct_eof(t)) {
-        pa_context_fail(o->context, PA_ERR_PROTOCOL);
-        goto finish;
+    } else {
+        if (pa_tagstruct_getu32(t, &i.memblock_total) < 0 ||
+            pa_tagstruct_getu32(t, &i.memblock_total_size) < 0 ||
+            pa_tagstruct_getu32(t, &i.memblock_allocated) < 0 ||
+            pa_tagstruct_getu32(t, &i.memblock_allocated_size) < 0 ||
+            pa_tagstruct_getu32(t, &i.scache_size) < 0)
+            goto fail;
+
+        if (o->context->version >= 27) {
+            if (pa_tagstruct_getu32(t, &i.n_flists) < 0)
+                goto fail;
+
+            if (i.n_flists > 0) {
+                i.flists = pa_xnew0(pa_stat_flist_info, i.n_flists);
+
+                for (j = 0; j < i.n_flists; j++)
+                    if (pa_tagstruct_gets(t, &i.flists[j].name) < 0 ||
+                        pa_tagstruct_getu64(t, &i.flists[j].hits) < 0 ||
+                        pa_tagstruct_getu64(t, &i.flists[j].misses) < 0)
+                        goto fail;
+            }
+        }
+
+        if (!pa_tagstruct_eof(t))
+            goto fail;
     }
 
     if (o->callback) {
@@ -70,7 +88,13 @@ static void context_stat_callback(pa_pdispatch *pd, uint32_t command, uint32_t t
         cb(o->context, p, o->userdata);
     }
 
+    goto finish;
+
+fail:
+    pa_context_fail(o->context, PA_ERR_PROTOCOL);
+
 finish:
+    pa_xfree(i.flists);
     pa_operation_done(o);
     pa_operation_unref(o);
 }
@@ -81,6 +105,27 @@ pa_operation* pa_context_stat(pa_context *c, pa_stat_info_cb_t cb, void *userdat
 
 /*** Server Info ***/
 
+static int read_server_info(pa_context *c, pa_tagstruct *t, pa_server_info *i) {
+    pa_zero(*i);
+
+    if (pa_tagstruct_gets(t, &i->server_name) < 0 ||
+        pa_tagstruct_gets(t, &i->server_version) < 0 ||
+        pa_tagstruct_gets(t, &i->user_name) < 0 ||
+        pa_tagstruct_gets(t, &i->host_name) < 0 ||
+        pa_tagstruct_get_sample_spec(t, &i->sample_spec) < 0 ||
+        pa_tagstruct_gets(t, &i->default_sink_name) < 0 ||
+        pa_tagstruct_gets(t, &i->default_source_name) < 0 ||
+        pa_tagstruct_getu32(t, &i->cookie) < 0 ||
+        (c->version >= 15 &&
+         pa_tagstruct_get_channel_map(t, &i->channel_map) < 0))
+        return -1;
+
+    if (c->version < 15)
+        pa_channel_map_init_extend(&i->channel_map, i->sample_spec.channels, PA_CHANNEL_MAP_DEFAULT);
+
+    return 0;
+}
+
 static void context_get_server_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_operation *o = userdata;
     pa_server_info i, *p = &i;
@@ -99,25 +144,13 @@ static void context_get_server_info_callback(pa_pdispatch *pd, uint32_t command,
             goto finish;
 
         p = NULL;
-    } else if (pa_tagstruct_gets(t, &i.server_name) < 0 ||
-               pa_tagstruct_gets(t, &i.server_version) < 0 ||
-               pa_tagstruct_gets(t, &i.user_name) < 0 ||
-               pa_tagstruct_gets(t, &i.host_name) < 0 ||
-               pa_tagstruct_get_sample_spec(t, &i.sample_spec) < 0 ||
-               pa_tagstruct_gets(t, &i.default_sink_name) < 0 ||
-               pa_tagstruct_gets(t, &i.default_source_name) < 0 ||
-               pa_tagstruct_getu32(t, &i.cookie) < 0 ||
-               (o->context->version >= 15 &&
-                pa_tagstruct_get_channel_map(t, &i.channel_map) < 0) ||
+    } else if (read_server_info(o->context, t, &i) < 0 ||
                !pa_tagstruct_eof(t)) {
 
         pa_context_fail(o->context, PA_ERR_PROTOCOL);
         goto finish;
     }
 
-    if (p && o->context->version < 15)
-        pa_channel_map_init_extend(&i.channel_map, i.sample_spec.channels, PA_CHANNEL_MAP_DEFAULT);
-
     if (o->callback) {
         pa_server_info_cb_t cb = (pa_server_info_cb_t) o->callback;
         cb(o->context, p, o->userdata);
@@ -132,164 +165,157 @@ pa_operation* pa_context_get_server_info(pa_context *c, pa_server_info_cb_t cb,
     return pa_context_send_simple_command(c, PA_COMMAND_GET_SERVER_INFO, context_get_server_info_callback, (pa_operation_cb_t) cb, userdata);
 }
 
-/*** Sink Info ***/
+/*** Info fields ***/
 
-static void context_get_sink_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
-    pa_operation *o = userdata;
-    int eol = 1;
-    pa_sink_info i;
-    uint32_t j;
+void pa_context_set_info_fields(pa_context *c, pa_info_fields_t fields) {
+    pa_assert(c);
+    pa_assert(PA_REFCNT_VALUE(c) >= 1);
+    pa_assert((fields & ~PA_INFO_FIELDS_ALL) == 0);
 
-    pa_assert(pd);
-    pa_assert(o);
-    pa_assert(PA_REFCNT_VALUE(o) >= 1);
+    c->info_fields = fields;
+}
 
-    /* For safety in case someone use fail: outside the while loop below */
-    pa_zero(i);
+/* Older servers always send everything */
+static void put_info_fields(pa_context *c, pa_tagstruct *t) {
+    if (c->version >= 38 && c->info_fields != PA_INFO_FIELDS_ALL)
+        pa_tagstruct_putu32(t, c->info_fields);
+}
 
-    if (!o->context)
-        goto finish;
+static pa_operation* send_info_list_command(pa_context *c, uint32_t command, pa_pdispatch_cb_t internal_cb, pa_operation_cb_t cb, void *userdata) {
+    pa_tagstruct *t;
+    pa_operation *o;
+    uint32_t tag;
 
-    if (command != PA_COMMAND_REPLY) {
-        if (pa_context_handle_error(o->context, command, t, FALSE) < 0)
-            goto finish;
+    pa_assert(c);
+    pa_assert(PA_REFCNT_VALUE(c) >= 1);
 
-        eol = -1;
-    } else {
+    PA_CHECK_VALIDITY_RETURN_NULL(c, !pa_detect_fork(), PA_ERR_FORKED);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->state == PA_CONTEXT_READY, PA_ERR_BADSTATE);
 
-        while (!pa_tagstruct_eof(t)) {
-            pa_bool_t mute;
-            uint32_t flags;
-            uint32_t state;
-            const char *ap = NULL;
+    o = pa_operation_new(c, NULL, cb, userdata);
 
-            pa_zero(i);
-            i.proplist = pa_proplist_new();
-            i.base_volume = PA_VOLUME_NORM;
-            i.n_volume_steps = PA_VOLUME_NORM+1;
-            mute = FALSE;
-            state = PA_SINK_INVALID_STATE;
-            i.card = PA_INVALID_INDEX;
+    t = pa_tagstruct_command(c, command, &tag);
+    put_info_fields(c, t);
+    pa_pstream_send_tagstruct(c->pstream, t);
+    pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, internal_cb, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
 
-            if (pa_tagstruct_getu32(t, &i.index) < 0 ||
-                pa_tagstruct_gets(t, &i.name) < 0 ||
-                pa_tagstruct_gets(t, &i.description) < 0 ||
-                pa_tagstruct_get_sample_spec(t, &i.sample_spec) < 0 ||
-                pa_tagstruct_get_channel_map(t, &i.channel_map) < 0 ||
-                pa_tagstruct_getu32(t, &i.owner_module) < 0 ||
-                pa_tagstruct_get_cvolume(t, &i.volume) < 0 ||
-                pa_tagstruct_get_boolean(t, &mute) < 0 ||
-                pa_tagstruct_getu32(t, &i.monitor_source) < 0 ||
-                pa_tagstruct_gets(t, &i.monitor_source_name) < 0 ||
-                pa_tagstruct_get_usec(t, &i.latency) < 0 ||
-                pa_tagstruct_gets(t, &i.driver) < 0 ||
-                pa_tagstruct_getu32(t, &flags) < 0 ||
-                (o->context->version >= 13 &&
-                 (pa_tagstruct_get_proplist(t, i.proplist) < 0 ||
-                  pa_tagstruct_get_usec(t, &i.configured_latency) < 0)) ||
-                (o->context->version >= 15 &&
-                 (pa_tagstruct_get_volume(t, &i.base_volume) < 0 ||
-                  pa_tagstruct_getu32(t, &state) < 0 ||
-                  pa_tagstruct_getu32(t, &i.n_volume_steps) < 0 ||
-                  pa_tagstruct_getu32(t, &i.card) < 0)) ||
-                (o->context->version >= 16 &&
-                 (pa_tagstruct_getu32(t, &i.n_ports)))) {
+    return o;
+}
 
-                goto fail;
-            }
+/*** Sink Info ***/
 
-            if (o->context->version >= 16) {
-                if (i.n_ports > 0) {
-                    i.ports = pa_xnew(pa_sink_port_info*, i.n_ports+1);
-                    i.ports[0] = pa_xnew(pa_sink_port_info, i.n_ports);
+static int read_sink_info(pa_context *c, pa_tagstruct *t, pa_sink_info_cb_t cb, void *userdata) {
+    pa_sink_info i;
+    uint32_t j;
+    pa_bool_t mute;
+    uint32_t flags;
+    uint32_t state;
+    const char *ap = NULL;
+    int r = -1;
 
-                    for (j = 0; j < i.n_ports; j++) {
-                        if (pa_tagstruct_gets(t, &i.ports[0][j].name) < 0 ||
-                            pa_tagstruct_gets(t, &i.ports[0][j].description) < 0 ||
-                            pa_tagstruct_getu32(t, &i.ports[0][j].priority) < 0) {
+    pa_zero(i);
+    i.proplist = pa_proplist_new();
+    i.base_volume = PA_VOLUME_NORM;
+    i.n_volume_steps = PA_VOLUME_NORM+1;
+    mute = FALSE;
+    state = PA_SINK_INVALID_STATE;
+    i.card = PA_INVALID_INDEX;
+
+    if (pa_tagstruct_getu32(t, &i.index) < 0 ||
+        pa_tagstruct_gets(t, &i.name) < 0 ||
+        pa_tagstruct_gets(t, &i.description) < 0 ||
+        pa_tagstruct_get_sample_spec(t, &i.sample_spec) < 0 ||
+        pa_tagstruct_get_channel_map(t, &i.channel_map) < 0 ||
+        pa_tagstruct_getu32(t, &i.owner_module) < 0 ||
+        pa_tagstruct_get_cvolume(t, &i.volume) < 0 ||
+        pa_tagstruct_get_boolean(t, &mute) < 0 ||
+        pa_tagstruct_getu32(t, &i.monitor_source) < 0 ||
+        pa_tagstruct_gets(t, &i.monitor_source_name) < 0 ||
+        pa_tagstruct_get_usec(t, &i.latency) < 0 ||
+        pa_tagstruct_gets(t, &i.driver) < 0 ||
+        pa_tagstruct_getu32(t, &flags) < 0 ||
+        (c->version >= 13 &&
+         (pa_tagstruct_get_proplist(t, i.proplist) < 0 ||
+          pa_tagstruct_get_usec(t, &i.configured_latency) < 0)) ||
+        (c->version >= 15 &&
+         (pa_tagstruct_get_volume(t, &i.base_volume) < 0 ||
+          pa_tagstruct_getu32(t, &state) < 0 ||
+          pa_tagstruct_getu32(t, &i.n_volume_steps) < 0 ||
+          pa_tagstruct_getu32(t, &i.card) < 0)) ||
+        (c->version >= 16 &&
+         (pa_tagstruct_getu32(t, &i.n_ports)))) {
 
-                            goto fail;
-                        }
+        goto finish;
+    }
 
-                        i.ports[0][j].available = PA_PORT_AVAILABLE_UNKNOWN;
-                        if (o->context->version >= 24) {
-                            uint32_t av;
-                            if (pa_tagstruct_getu32(t, &av) < 0 || av > PA_PORT_AVAILABLE_YES)
-                                goto fail;
-                            i.ports[0][j].available = av;
-                        }
+    if (c->version >= 16) {
+        if (i.n_ports > 0) {
+            i.ports = pa_xnew(pa_sink_port_info*, i.n_ports+1);
+            i.ports[0] = pa_xnew(pa_sink_port_info, i.n_ports);
 
-                        i.ports[j] = &i.ports[0][j];
-                    }
+            for (j = 0; j < i.n_ports; j++) {
+                if (pa_tagstruct_gets(t, &i.ports[0][j].name) < 0 ||
+                    pa_tagstruct_gets(t, &i.ports[0][j].description) < 0 ||
+                    pa_tagstruct_getu32(t, &i.ports[0][j].priority) < 0) {
 
-                    i.ports[j] = NULL;
+                    goto finish;
                 }
 
-                if (pa_tagstruct_gets(t, &ap) < 0)
-                    goto fail;
-
-                if (ap) {
-                    for (j = 0; j < i.n_ports; j++)
-                        if (pa_streq(i.ports[j]->name, ap)) {
-                            i.active_port = i.ports[j];
-                            break;
-                        }
+                i.ports[0][j].available = PA_PORT_AVAILABLE_UNKNOWN;
+                if (c->version >= 24) {
+                    uint32_t av;
+                    if (pa_tagstruct_getu32(t, &av) < 0 || av > PA_PORT_AVAILABLE_YES)
+                        goto finish;
+                    i.ports[0][j].available = av;
                 }
-            }
 
-            if (o->context->version >= 21) {
-                uint8_t n_formats;
-                if (pa_tagstruct_getu8(t, &n_formats) < 0 || n_formats < 1)
-                    goto fail;
+                i.ports[j] = &i.ports[0][j];
+            }
 
-                i.formats = pa_xnew0(pa_format_info*, n_formats);
+            i.ports[j] = NULL;
+        }
 
-                for (j = 0; j < n_formats; j++) {
-                    i.n_formats++;
-                    i.formats[j] = pa_format_info_new();
+        if (pa_tagstruct_gets(t, &ap) < 0)
+            goto finish;
 
-                    if (pa_tagstruct_get_format_info(t, i.formats[j]) < 0)
-                        goto fail;
+        if (ap) {
+            for (j = 0; j < i.n_ports; j++)
+                if (pa_streq(i.ports[j]->name, ap)) {
+                    i.active_port = i.ports[j];
+                    break;
                 }
-            }
+        }
+    }
 
-            i.mute = (int) mute;
-            i.flags = (pa_sink_flags_t) flags;
-            i.state = (pa_sink_state_t) state;
+    if (c->version >= 21) {
+        uint8_t n_formats;
 
-            if (o->callback) {
-                pa_sink_info_cb_t cb = (pa_sink_info_cb_t) o->callback;
-                cb(o->context, &i, 0, o->userdata);
-            }
+        /* There are none if we didn't ask for PA_INFO_FIELDS_FORMATS */
+        if (pa_tagstruct_getu8(t, &n_formats) < 0 || (n_formats < 1 && c->version < 38))
+            goto finish;
 
-            if (i.formats) {
-                for (j = 0; j < i.n_formats; j++)
-                    pa_format_info_free(i.formats[j]);
-                pa_xfree(i.formats);
-            }
-            if (i.ports) {
-                pa_xfree(i.ports[0]);
-                pa_xfree(i.ports);
-            }
-            pa_proplist_free(i.proplist);
-        }
-    }
+        if (n_formats > 0)
+            i.formats = pa_xnew0(pa_format_info*, n_formats);
 
-    if (o->callback) {
-        pa_sink_info_cb_t cb = (pa_sink_info_cb_t) o->callback;
-        cb(o->context, NULL, eol, o->userdata);
+        for (j = 0; j < n_formats; j++) {
+            i.n_formats++;
+            i.formats[j] = pa_format_info_new();
+
+            if (pa_tagstruct_get_format_info(t, i.formats[j]) < 0)
+                goto finish;
+        }
     }
 
-finish:
-    pa_operation_done(o);
-    pa_operation_unref(o);
-    return;
+    i.mute = (int) mute;
+    i.flags = (pa_sink_flags_t) flags;
+    i.state = (pa_sink_state_t) state;
 
-fail:
-    pa_assert(i.proplist);
+    if (cb)
+        cb(c, &i, 0, userdata);
 
-    pa_context_fail(o->context, PA_ERR_PROTOCOL);
+    r = 0;
 
+finish:
     if (i.formats) {
         for (j = 0; j < i.n_formats; j++)
             pa_format_info_free(i.formats[j]);
@@ -301,11 +327,46 @@ fail:
     }
     pa_proplist_free(i.proplist);
 
-    goto finish;
+    return r;
+}
+
+static void context_get_sink_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_operation *o = userdata;
+    int eol = 1;
+
+    pa_assert(pd);
+    pa_assert(o);
+    pa_assert(PA_REFCNT_VALUE(o) >= 1);
+
+    if (!o->context)
+        goto finish;
+
+    if (command != PA_COMMAND_REPLY) {
+        if (pa_context_handle_error(o->context, command, t, FALSE) < 0)
+            goto finish;
+
+        eol = -1;
+    } else {
+
+        while (!pa_tagstruct_eof(t))
+            if (read_sink_info(o->context, t, (pa_sink_info_cb_t) o->callback, o->userdata) < 0) {
+                pa_context_fail(o->context, PA_ERR_PROTOCOL);
+                goto finish;
+            }
+    }
+
+    if (o->callback) {
+        pa_sink_info_cb_t cb = (pa_sink_info_cb_t) o->callback;
+        cb(o->context, NULL, eol, o->userdata);
+    }
+
+finish:
+    pa_operation_done(o);
+    pa_operation_unref(o);
 }
 
 pa_operation* pa_context_get_sink_info_list(pa_context *c, pa_sink_info_cb_t cb, void *userdata) {
-    return pa_context_send_simple_command(c, PA_COMMAND_GET_SINK_INFO_LIST, context_get_sink_info_callback, (pa_operation_cb_t) cb, userdata);
+    return send_info_list_command(c, PA_COMMAND_GET_SINK_INFO_LIST, context_get_sink_info_callback, (pa_operation_cb_t) cb, userdata);
 }
 
 pa_operation* pa_context_get_sink_info_by_index(pa_context *c, uint32_t idx, pa_sink_info_cb_t cb, void *userdata) {
@@ -325,6 +386,7 @@ pa_operation* pa_context_get_sink_info_by_index(pa_context *c, uint32_t idx, pa_
     t = pa_tagstruct_command(c, PA_COMMAND_GET_SINK_INFO, &tag);
     pa_tagstruct_putu32(t, idx);
     pa_tagstruct_puts(t, NULL);
+    put_info_fields(c, t);
     pa_pstream_send_tagstruct(c->pstream, t);
     pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, context_get_sink_info_callback, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
 
@@ -349,6 +411,7 @@ pa_operation* pa_context_get_sink_info_by_name(pa_context *c, const char *name,
     t = pa_tagstruct_command(c, PA_COMMAND_GET_SINK_INFO, &tag);
     pa_tagstruct_putu32(t, PA_INVALID_INDEX);
     pa_tagstruct_puts(t, name);
+    put_info_fields(c, t);
     pa_pstream_send_tagstruct(c->pstream, t);
     pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, context_get_sink_info_callback, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
 
@@ -407,162 +470,118 @@ pa_operation* pa_context_set_sink_port_by_name(pa_context *c, const char *name,
 
 /*** Source info ***/
 
-static void context_get_source_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
-    pa_operation *o = userdata;
-    int eol = 1;
+static int read_source_info(pa_context *c, pa_tagstruct *t, pa_source_info_cb_t cb, void *userdata) {
     pa_source_info i;
     uint32_t j;
+    pa_bool_t mute;
+    uint32_t flags;
+    uint32_t state;
+    const char *ap;
+    int r = -1;
 
-    pa_assert(pd);
-    pa_assert(o);
-    pa_assert(PA_REFCNT_VALUE(o) >= 1);
-
-    /* For safety in case someone use fail: outside the while loop below */
     pa_zero(i);
+    i.proplist = pa_proplist_new();
+    i.base_volume = PA_VOLUME_NORM;
+    i.n_volume_steps = PA_VOLUME_NORM+1;
+    mute = FALSE;
+    state = PA_SOURCE_INVALID_STATE;
+    i.card = PA_INVALID_INDEX;
+
+    if (pa_tagstruct_getu32(t, &i.index) < 0 ||
+        pa_tagstruct_gets(t, &i.name) < 0 ||
+        pa_tagstruct_gets(t, &i.description) < 0 ||
+        pa_tagstruct_get_sample_spec(t, &i.sample_spec) < 0 ||
+        pa_tagstruct_get_channel_map(t, &i.channel_map) < 0 ||
+        pa_tagstruct_getu32(t, &i.owner_module) < 0 ||
+        pa_tagstruct_get_cvolume(t, &i.volume) < 0 ||
+        pa_tagstruct_get_boolean(t, &mute) < 0 ||
+        pa_tagstruct_getu32(t, &i.monitor_of_sink) < 0 ||
+        pa_tagstruct_gets(t, &i.monitor_of_sink_name) < 0 ||
+        pa_tagstruct_get_usec(t, &i.latency) < 0 ||
+        pa_tagstruct_gets(t, &i.driver) < 0 ||
+        pa_tagstruct_getu32(t, &flags) < 0 ||
+        (c->version >= 13 &&
+         (pa_tagstruct_get_proplist(t, i.proplist) < 0 ||
+          pa_tagstruct_get_usec(t, &i.configured_latency) < 0)) ||
+        (c->version >= 15 &&
+         (pa_tagstruct_get_volume(t, &i.base_volume) < 0 ||
+          pa_tagstruct_getu32(t, &state) < 0 ||
+          pa_tagstruct_getu32(t, &i.n_volume_steps) < 0 ||
+          pa_tagstruct_getu32(t, &i.card) < 0)) ||
+        (c->version >= 16 &&
+         (pa_tagstruct_getu32(t, &i.n_ports)))) {
 
-    if (!o->context)
         goto finish;
+    }
 
-    if (command != PA_COMMAND_REPLY) {
-        if (pa_context_handle_error(o->context, command, t, FALSE) < 0)
-            goto finish;
+    if (c->version >= 16) {
+        if (i.n_ports > 0) {
+            i.ports = pa_xnew(pa_source_port_info*, i.n_ports+1);
+            i.ports[0] = pa_xnew(pa_source_port_info, i.n_ports);
 
-        eol = -1;
-    } else {
-
-        while (!pa_tagstruct_eof(t)) {
-            pa_bool_t mute;
-            uint32_t flags;
-            uint32_t state;
-            const char *ap;
+            for (j = 0; j < i.n_ports; j++) {
+                if (pa_tagstruct_gets(t, &i.ports[0][j].name) < 0 ||
+                    pa_tagstruct_gets(t, &i.ports[0][j].description) < 0 ||
+                    pa_tagstruct_getu32(t, &i.ports[0][j].priority) < 0) {
 
-            pa_zero(i);
-            i.proplist = pa_proplist_new();
-            i.base_volume = PA_VOLUME_NORM;
-            i.n_volume_steps = PA_VOLUME_NORM+1;
-            mute = FALSE;
-            state = PA_SOURCE_INVALID_STATE;
-            i.card = PA_INVALID_INDEX;
+                    goto finish;
+                }
 
-            if (pa_tagstruct_getu32(t, &i.index) < 0 ||
-                pa_tagstruct_gets(t, &i.name) < 0 ||
-                pa_tagstruct_gets(t, &i.description) < 0 ||
-                pa_tagstruct_get_sample_spec(t, &i.sample_spec) < 0 ||
-                pa_tagstruct_get_channel_map(t, &i.channel_map) < 0 ||
-                pa_tagstruct_getu32(t, &i.owner_module) < 0 ||
-                pa_tagstruct_get_cvolume(t, &i.volume) < 0 ||
-                pa_tagstruct_get_boolean(t, &mute) < 0 ||
-                pa_tagstruct_getu32(t, &i.monitor_of_sink) < 0 ||
-                pa_tagstruct_gets(t, &i.monitor_of_sink_name) < 0 ||
-                pa_tagstruct_get_usec(t, &i.latency) < 0 ||
-                pa_tagstruct_gets(t, &i.driver) < 0 ||
-                pa_tagstruct_getu32(t, &flags) < 0 ||
-                (o->context->version >= 13 &&
-                 (pa_tagstruct_get_proplist(t, i.proplist) < 0 ||
-                  pa_tagstruct_get_usec(t, &i.configured_latency) < 0)) ||
-                (o->context->version >= 15 &&
-                 (pa_tagstruct_get_volume(t, &i.base_volume) < 0 ||
-                  pa_tagstruct_getu32(t, &state) < 0 ||
-                  pa_tagstruct_getu32(t, &i.n_volume_steps) < 0 ||
-                  pa_tagstruct_getu32(t, &i.card) < 0)) ||
-                (o->context->version >= 16 &&
-                 (pa_tagstruct_getu32(t, &i.n_ports)))) {
+                i.ports[0][j].available = PA_PORT_AVAILABLE_UNKNOWN;
+                if (c->version >= 24) {
+                    uint32_t av;
+                    if (pa_tagstruct_getu32(t, &av) < 0 || av > PA_PORT_AVAILABLE_YES)
+                        goto finish;
+                    i.ports[0][j].available = av;
+                }
 
-                goto fail;
+                i.ports[j] = &i.ports[0][j];
             }
 
-            if (o->context->version >= 16) {
-                if (i.n_ports > 0) {
-                    i.ports = pa_xnew(pa_source_port_info*, i.n_ports+1);
-                    i.ports[0] = pa_xnew(pa_source_port_info, i.n_ports);
-
-                    for (j = 0; j < i.n_ports; j++) {
-                        if (pa_tagstruct_gets(t, &i.ports[0][j].name) < 0 ||
-                            pa_tagstruct_gets(t, &i.ports[0][j].description) < 0 ||
-                            pa_tagstruct_getu32(t, &i.ports[0][j].priority) < 0) {
-
-                            goto fail;
-                        }
-
-                        i.ports[0][j].available = PA_PORT_AVAILABLE_UNKNOWN;
-                        if (o->context->version >= 24) {
-                            uint32_t av;
-                            if (pa_tagstruct_getu32(t, &av) < 0 || av > PA_PORT_AVAILABLE_YES)
-                                goto fail;
-                            i.ports[0][j].available = av;
-                        }
-
-                        i.ports[j] = &i.ports[0][j];
-                    }
-
-                    i.ports[j] = NULL;
-                }
+            i.ports[j] = NULL;
+        }
 
-                if (pa_tagstruct_gets(t, &ap) < 0)
-                    goto fail;
+        if (pa_tagstruct_gets(t, &ap) < 0)
+            goto finish;
 
-                if (ap) {
-                    for (j = 0; j < i.n_ports; j++)
-                        if (pa_streq(i.ports[j]->name, ap)) {
-                            i.active_port = i.ports[j];
-                            break;
-                        }
+        if (ap) {
+            for (j = 0; j < i.n_ports; j++)
+                if (pa_streq(i.ports[j]->name, ap)) {
+                    i.active_port = i.ports[j];
+                    break;
                 }
-            }
-
-            if (o->context->version >= 22) {
-                uint8_t n_formats;
-                if (pa_tagstruct_getu8(t, &n_formats) < 0 || n_formats < 1)
-                    goto fail;
-
-                i.formats = pa_xnew0(pa_format_info*, n_formats);
+        }
+    }
 
-                for (j = 0; j < n_formats; j++) {
-                    i.n_formats++;
-                    i.formats[j] = pa_format_info_new();
+    if (c->version >= 22) {
+        uint8_t n_formats;
 
-                    if (pa_tagstruct_get_format_info(t, i.formats[j]) < 0)
-                        goto fail;
-                }
-            }
+        /* There are none if we didn't ask for PA_INFO_FIELDS_FORMATS */
+        if (pa_tagstruct_getu8(t, &n_formats) < 0 || (n_formats < 1 && c->version < 38))
+            goto finish;
 
-            i.mute = (int) mute;
-            i.flags = (pa_source_flags_t) flags;
-            i.state = (pa_source_state_t) state;
+        if (n_formats > 0)
+            i.formats = pa_xnew0(pa_format_info*, n_formats);
 
-            if (o->callback) {
-                pa_source_info_cb_t cb = (pa_source_info_cb_t) o->callback;
-                cb(o->context, &i, 0, o->userdata);
-            }
+        for (j = 0; j < n_formats; j++) {
+            i.n_formats++;
+            i.formats[j] = pa_format_info_new();
 
-            if (i.formats) {
-                for (j = 0; j < i.n_formats; j++)
-                    pa_format_info_free(i.formats[j]);
-                pa_xfree(i.formats);
-            }
-            if (i.ports) {
-                pa_xfree(i.ports[0]);
-                pa_xfree(i.ports);
-            }
-            pa_proplist_free(i.proplist);
+            if (pa_tagstruct_get_format_info(t, i.formats[j]) < 0)
+                goto finish;
         }
     }
 
-    if (o->callback) {
-        pa_source_info_cb_t cb = (pa_source_info_cb_t) o->callback;
-        cb(o->context, NULL, eol, o->userdata);
-    }
+    i.mute = (int) mute;
+    i.flags = (pa_source_flags_t) flags;
+    i.state = (pa_source_state_t) state;
 
-finish:
-    pa_operation_done(o);
-    pa_operation_unref(o);
-    return;
+    if (cb)
+        cb(c, &i, 0, userdata);
 
-fail:
-    pa_assert(i.proplist);
-
-    pa_context_fail(o->context, PA_ERR_PROTOCOL);
+    r = 0;
 
+finish:
     if (i.formats) {
         for (j = 0; j < i.n_formats; j++)
             pa_format_info_free(i.formats[j]);
@@ -574,11 +593,46 @@ fail:
     }
     pa_proplist_free(i.proplist);
 
-    goto finish;
+    return r;
+}
+
+static void context_get_source_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_operation *o = userdata;
+    int eol = 1;
+
+    pa_assert(pd);
+    pa_assert(o);
+    pa_assert(PA_REFCNT_VALUE(o) >= 1);
+
+    if (!o->context)
+        goto finish;
+
+    if (command != PA_COMMAND_REPLY) {
+        if (pa_context_handle_error(o->context, command, t, FALSE) < 0)
+            goto finish;
+
+        eol = -1;
+    } else {
+
+        while (!pa_tagstruct_eof(t))
+            if (read_source_info(o->context, t, (pa_source_info_cb_t) o->callback, o->userdata) < 0) {
+                pa_context_fail(o->context, PA_ERR_PROTOCOL);
+                goto finish;
+            }
+    }
+
+    if (o->callback) {
+        pa_source_info_cb_t cb = (pa_source_info_cb_t) o->callback;
+        cb(o->context, NULL, eol, o->userdata);
+    }
+
+finish:
+    pa_operation_done(o);
+    pa_operation_unref(o);
 }
 
 pa_operation* pa_context_get_source_info_list(pa_context *c, pa_source_info_cb_t cb, void *userdata) {
-    return pa_context_send_simple_command(c, PA_COMMAND_GET_SOURCE_INFO_LIST, context_get_source_info_callback, (pa_operation_cb_t) cb, userdata);
+    return send_info_list_command(c, PA_COMMAND_GET_SOURCE_INFO_LIST, context_get_source_info_callback, (pa_operation_cb_t) cb, userdata);
 }
 
 pa_operation* pa_context_get_source_info_by_index(pa_context *c, uint32_t idx, pa_source_info_cb_t cb, void *userdata) {
@@ -598,6 +652,7 @@ pa_operation* pa_context_get_source_info_by_index(pa_context *c, uint32_t idx, p
     t = pa_tagstruct_command(c, PA_COMMAND_GET_SOURCE_INFO, &tag);
     pa_tagstruct_putu32(t, idx);
     pa_tagstruct_puts(t, NULL);
+    put_info_fields(c, t);
     pa_pstream_send_tagstruct(c->pstream, t);
     pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, context_get_source_info_callback, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
 
@@ -622,6 +677,7 @@ pa_operation* pa_context_get_source_info_by_name(pa_context *c, const char *name
     t = pa_tagstruct_command(c, PA_COMMAND_GET_SOURCE_INFO, &tag);
     pa_tagstruct_putu32(t, PA_INVALID_INDEX);
     pa_tagstruct_puts(t, name);
+    put_info_fields(c, t);
     pa_pstream_send_tagstruct(c->pstream, t);
     pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, context_get_source_info_callback, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
 
@@ -680,6 +736,33 @@ pa_operation* pa_context_set_source_port_by_name(pa_context *c, const char *name
 
 /*** Client info ***/
 
+static int read_client_info(pa_context *c, pa_tagstruct *t, pa_client_info_cb_t cb, void *userdata) {
+    pa_client_info i;
+    int r = -1;
+
+    pa_zero(i);
+    i.proplist = pa_proplist_new();
+
+    if (pa_tagstruct_getu32(t, &i.index) < 0 ||
+        pa_tagstruct_gets(t, &i.name) < 0 ||
+        pa_tagstruct_getu32(t, &i.owner_module) < 0 ||
+        pa_tagstruct_gets(t, &i.driver) < 0 ||
+        (c->version >= 13 && pa_tagstruct_get_proplist(t, i.proplist) < 0)) {
+
+        goto finish;
+    }
+
+    if (cb)
+        cb(c, &i, 0, userdata);
+
+    r = 0;
+
+finish:
+    pa_proplist_free(i.proplist);
+
+    return r;
+}
+
 static void context_get_client_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_operation *o = userdata;
     int eol = 1;
@@ -698,30 +781,11 @@ static void context_get_client_info_callback(pa_pdispatch *pd, uint32_t command,
         eol = -1;
     } else {
 
-        while (!pa_tagstruct_eof(t)) {
-            pa_client_info i;
-
-            pa_zero(i);
-            i.proplist = pa_proplist_new();
-
-            if (pa_tagstruct_getu32(t, &i.index) < 0 ||
-                pa_tagstruct_gets(t, &i.name) < 0 ||
-                pa_tagstruct_getu32(t, &i.owner_module) < 0 ||
-                pa_tagstruct_gets(t, &i.driver) < 0 ||
-                (o->context->version >= 13 && pa_tagstruct_get_proplist(t, i.proplist) < 0)) {
-
+        while (!pa_tagstruct_eof(t))
+            if (read_client_info(o->context, t, (pa_client_info_cb_t) o->callback, o->userdata) < 0) {
                 pa_context_fail(o->context, PA_ERR_PROTOCOL);
-                pa_proplist_free(i.proplist);
                 goto finish;
             }
-
-            if (o->callback) {
-                pa_client_info_cb_t cb = (pa_client_info_cb_t) o->callback;
-                cb(o->context, &i, 0, o->userdata);
-            }
-
-            pa_proplist_free(i.proplist);
-        }
     }
 
     if (o->callback) {
@@ -751,6 +815,7 @@ pa_operation* pa_context_get_client_info(pa_context *c, uint32_t idx, pa_client_
 
     t = pa_tagstruct_command(c, PA_COMMAND_GET_CLIENT_INFO, &tag);
     pa_tagstruct_putu32(t, idx);
+    put_info_fields(c, t);
     pa_pstream_send_tagstruct(c->pstream, t);
     pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, context_get_client_info_callback, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
 
@@ -758,7 +823,7 @@ pa_operation* pa_context_get_client_info(pa_context *c, uint32_t idx, pa_client_
 }
 
 pa_operation* pa_context_get_client_info_list(pa_context *c, pa_client_info_cb_t cb, void *userdata) {
-    return pa_context_send_simple_command(c, PA_COMMAND_GET_CLIENT_INFO_LIST, context_get_client_info_callback, (pa_operation_cb_t) cb, userdata);
+    return send_info_list_command(c, PA_COMMAND_GET_CLIENT_INFO_LIST, context_get_client_info_callback, (pa_operation_cb_t) cb, userdata);
 }
 
 /*** Card info ***/
@@ -838,26 +903,92 @@ static int fill_card_port_info(pa_tagstruct* t, pa_card_info* i)
                 if (pa_tagstruct_gets(t, &profilename) < 0)
                     return -PA_ERR_PROTOCOL;
 
-                for (l = 0; l < i->n_profiles; l++) {
-                    if (pa_streq(i->profiles[l].name, profilename)) {
-                        port->profiles[k] = &i->profiles[l];
-                        break;
-                    }
-                }
+                for (l = 0; l < i->n_profiles; l++) {
+                    if (pa_streq(i->profiles[l].name, profilename)) {
+                        port->profiles[k] = &i->profiles[l];
+                        break;
+                    }
+                }
+
+                if (l >= i->n_profiles)
+                    return -PA_ERR_PROTOCOL;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static int read_card_info(pa_context *c, pa_tagstruct *t, pa_card_info_cb_t cb, void *userdata) {
+    pa_card_info i;
+    uint32_t j;
+    const char*ap;
+    int r = -1;
+
+    pa_zero(i);
+
+    if (pa_tagstruct_getu32(t, &i.index) < 0 ||
+        pa_tagstruct_gets(t, &i.name) < 0 ||
+        pa_tagstruct_getu32(t, &i.owner_module) < 0 ||
+        pa_tagstruct_gets(t, &i.driver) < 0 ||
+        pa_tagstruct_getu32(t, &i.n_profiles) < 0) {
+
+        goto finish;
+    }
+
+    if (i.n_profiles > 0) {
+        i.profiles = pa_xnew0(pa_card_profile_info, i.n_profiles+1);
+
+        for (j = 0; j < i.n_profiles; j++) {
+
+            if (pa_tagstruct_gets(t, &i.profiles[j].name) < 0 ||
+                pa_tagstruct_gets(t, &i.profiles[j].description) < 0 ||
+                pa_tagstruct_getu32(t, &i.profiles[j].n_sinks) < 0 ||
+                pa_tagstruct_getu32(t, &i.profiles[j].n_sources) < 0 ||
+                pa_tagstruct_getu32(t, &i.profiles[j].priority) < 0) {
+
+                goto finish;
+            }
+        }
+
+        /* Terminate with an extra NULL entry, just to make sure */
+        i.profiles[j].name = NULL;
+        i.profiles[j].description = NULL;
+    }
+
+    i.proplist = pa_proplist_new();
+
+    if (pa_tagstruct_gets(t, &ap) < 0 ||
+        pa_tagstruct_get_proplist(t, i.proplist) < 0) {
+
+        goto finish;
+    }
 
-                if (l >= i->n_profiles)
-                    return -PA_ERR_PROTOCOL;
+    if (ap) {
+        for (j = 0; j < i.n_profiles; j++)
+            if (pa_streq(i.profiles[j].name, ap)) {
+                i.active_profile = &i.profiles[j];
+                break;
             }
-        }
     }
 
-    return 0;
+    if (c->version >= 26 && fill_card_port_info(t, &i) < 0)
+        goto finish;
+
+    if (cb)
+        cb(c, &i, 0, userdata);
+
+    r = 0;
+
+finish:
+    card_info_free(&i);
+
+    return r;
 }
 
 static void context_get_card_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_operation *o = userdata;
     int eol = 1;
-    pa_card_info i;
 
     pa_assert(pd);
     pa_assert(o);
@@ -873,78 +1004,11 @@ static void context_get_card_info_callback(pa_pdispatch *pd, uint32_t command, u
         eol = -1;
     } else {
 
-        while (!pa_tagstruct_eof(t)) {
-            uint32_t j;
-            const char*ap;
-
-            pa_zero(i);
-
-            if (pa_tagstruct_getu32(t, &i.index) < 0 ||
-                pa_tagstruct_gets(t, &i.name) < 0 ||
-                pa_tagstruct_getu32(t, &i.owner_module) < 0 ||
-                pa_tagstruct_gets(t, &i.driver) < 0 ||
-                pa_tagstruct_getu32(t, &i.n_profiles) < 0) {
-
-                pa_context_fail(o->context, PA_ERR_PROTOCOL);
-                card_info_free(&i);
-                goto finish;
-            }
-
-            if (i.n_profiles > 0) {
-                i.profiles = pa_xnew0(pa_card_profile_info, i.n_profiles+1);
-
-                for (j = 0; j < i.n_profiles; j++) {
-
-                    if (pa_tagstruct_gets(t, &i.profiles[j].name) < 0 ||
-                        pa_tagstruct_gets(t, &i.profiles[j].description) < 0 ||
-                        pa_tagstruct_getu32(t, &i.profiles[j].n_sinks) < 0 ||
-                        pa_tagstruct_getu32(t, &i.profiles[j].n_sources) < 0 ||
-                        pa_tagstruct_getu32(t, &i.profiles[j].priority) < 0) {
-
-                        pa_context_fail(o->context, PA_ERR_PROTOCOL);
-                        card_info_free(&i);
-                        goto finish;
-                    }
-                }
-
-                /* Terminate with an extra NULL entry, just to make sure */
-                i.profiles[j].name = NULL;
-                i.profiles[j].description = NULL;
-            }
-
-            i.proplist = pa_proplist_new();
-
-            if (pa_tagstruct_gets(t, &ap) < 0 ||
-                pa_tagstruct_get_proplist(t, i.proplist) < 0) {
-
+        while (!pa_tagstruct_eof(t))
+            if (read_card_info(o->context, t, (pa_card_info_cb_t) o->callback, o->userdata) < 0) {
                 pa_context_fail(o->context, PA_ERR_PROTOCOL);
-                card_info_free(&i);
                 goto finish;
             }
-
-            if (ap) {
-                for (j = 0; j < i.n_profiles; j++)
-                    if (pa_streq(i.profiles[j].name, ap)) {
-                        i.active_profile = &i.profiles[j];
-                        break;
-                    }
-            }
-
-            if (o->context->version >= 26) {
-                if (fill_card_port_info(t, &i) < 0) {
-                    pa_context_fail(o->context, PA_ERR_PROTOCOL);
-                    card_info_free(&i);
-                    goto finish;
-                }
-            }
-
-            if (o->callback) {
-                pa_card_info_cb_t cb = (pa_card_info_cb_t) o->callback;
-                cb(o->context, &i, 0, o->userdata);
-            }
-
-            card_info_free(&i);
-        }
     }
 
     if (o->callback) {
@@ -976,6 +1040,7 @@ pa_operation* pa_context_get_card_info_by_index(pa_context *c, uint32_t idx, pa_
     t = pa_tagstruct_command(c, PA_COMMAND_GET_CARD_INFO, &tag);
     pa_tagstruct_putu32(t, idx);
     pa_tagstruct_puts(t, NULL);
+    put_info_fields(c, t);
     pa_pstream_send_tagstruct(c->pstream, t);
     pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, context_get_card_info_callback, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
 
@@ -1001,6 +1066,7 @@ pa_operation* pa_context_get_card_info_by_name(pa_context *c, const char*name, p
     t = pa_tagstruct_command(c, PA_COMMAND_GET_CARD_INFO, &tag);
     pa_tagstruct_putu32(t, PA_INVALID_INDEX);
     pa_tagstruct_puts(t, name);
+    put_info_fields(c, t);
     pa_pstream_send_tagstruct(c->pstream, t);
     pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, context_get_card_info_callback, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
 
@@ -1010,7 +1076,7 @@ pa_operation* pa_context_get_card_info_by_name(pa_context *c, const char*name, p
 pa_operation* pa_context_get_card_info_list(pa_context *c, pa_card_info_cb_t cb, void *userdata) {
     PA_CHECK_VALIDITY_RETURN_NULL(c, c->version >= 15, PA_ERR_NOTSUPPORTED);
 
-    return pa_context_send_simple_command(c, PA_COMMAND_GET_CARD_INFO_LIST, context_get_card_info_callback, (pa_operation_cb_t) cb, userdata);
+    return send_info_list_command(c, PA_COMMAND_GET_CARD_INFO_LIST, context_get_card_info_callback, (pa_operation_cb_t) cb, userdata);
 }
 
 pa_operation* pa_context_set_card_profile_by_index(pa_context *c, uint32_t idx, const char*profile, pa_context_success_cb_t cb, void *userdata) {
@@ -1065,6 +1131,36 @@ pa_operation* pa_context_set_card_profile_by_name(pa_context *c, const char *nam
 
 /*** Module info ***/
 
+static int read_module_info(pa_context *c, pa_tagstruct *t, pa_module_info_cb_t cb, void *userdata) {
+    pa_module_info i;
+    pa_bool_t auto_unload = FALSE;
+    int r = -1;
+
+    pa_zero(i);
+    i.proplist = pa_proplist_new();
+
+    if (pa_tagstruct_getu32(t, &i.index) < 0 ||
+        pa_tagstruct_gets(t, &i.name) < 0 ||
+        pa_tagstruct_gets(t, &i.argument) < 0 ||
+        pa_tagstruct_getu32(t, &i.n_used) < 0 ||
+        (c->version < 15 && pa_tagstruct_get_boolean(t, &auto_unload) < 0) ||
+        (c->version >= 15 && pa_tagstruct_get_proplist(t, i.proplist) < 0)) {
+        goto finish;
+    }
+
+    i.auto_unload = (int) auto_unload;
+
+    if (cb)
+        cb(c, &i, 0, userdata);
+
+    r = 0;
+
+finish:
+    pa_proplist_free(i.proplist);
+
+    return r;
+}
+
 static void context_get_module_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_operation *o = userdata;
     int eol = 1;
@@ -1083,32 +1179,11 @@ static void context_get_module_info_callback(pa_pdispatch *pd, uint32_t command,
         eol = -1;
     } else {
 
-        while (!pa_tagstruct_eof(t)) {
-            pa_module_info i;
-            pa_bool_t auto_unload = FALSE;
-
-            pa_zero(i);
-            i.proplist = pa_proplist_new();
-
-            if (pa_tagstruct_getu32(t, &i.index) < 0 ||
-                pa_tagstruct_gets(t, &i.name) < 0 ||
-                pa_tagstruct_gets(t, &i.argument) < 0 ||
-                pa_tagstruct_getu32(t, &i.n_used) < 0 ||
-                (o->context->version < 15 && pa_tagstruct_get_boolean(t, &auto_unload) < 0) ||
-                (o->context->version >= 15 && pa_tagstruct_get_proplist(t, i.proplist) < 0)) {
+        while (!pa_tagstruct_eof(t))
+            if (read_module_info(o->context, t, (pa_module_info_cb_t) o->callback, o->userdata) < 0) {
                 pa_context_fail(o->context, PA_ERR_PROTOCOL);
                 goto finish;
             }
-
-            i.auto_unload = (int) auto_unload;
-
-            if (o->callback) {
-                pa_module_info_cb_t cb = (pa_module_info_cb_t) o->callback;
-                cb(o->context, &i, 0, o->userdata);
-            }
-
-            pa_proplist_free(i.proplist);
-        }
     }
 
     if (o->callback) {
@@ -1138,6 +1213,7 @@ pa_operation* pa_context_get_module_info(pa_context *c, uint32_t idx, pa_module_
 
     t = pa_tagstruct_command(c, PA_COMMAND_GET_MODULE_INFO, &tag);
     pa_tagstruct_putu32(t, idx);
+    put_info_fields(c, t);
     pa_pstream_send_tagstruct(c->pstream, t);
     pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, context_get_module_info_callback, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
 
@@ -1145,11 +1221,59 @@ pa_operation* pa_context_get_module_info(pa_context *c, uint32_t idx, pa_module_
 }
 
 pa_operation* pa_context_get_module_info_list(pa_context *c, pa_module_info_cb_t cb, void *userdata) {
-    return pa_context_send_simple_command(c, PA_COMMAND_GET_MODULE_INFO_LIST, context_get_module_info_callback, (pa_operation_cb_t) cb, userdata);
+    return send_info_list_command(c, PA_COMMAND_GET_MODULE_INFO_LIST, context_get_module_info_callback, (pa_operation_cb_t) cb, userdata);
 }
 
 /*** Sink input info ***/
 
+static int read_sink_input_info(pa_context *c, pa_tagstruct *t, pa_sink_input_info_cb_t cb, void *userdata) {
+    pa_sink_input_info i;
+    pa_bool_t mute = FALSE, corked = FALSE, has_volume = FALSE, volume_writable = TRUE;
+    int r = -1;
+
+    pa_zero(i);
+    i.proplist = pa_proplist_new();
+    i.format = pa_format_info_new();
+
+    if (pa_tagstruct_getu32(t, &i.index) < 0 ||
+        pa_tagstruct_gets(t, &i.name) < 0 ||
+        pa_tagstruct_getu32(t, &i.owner_module) < 0 ||
+        pa_tagstruct_getu32(t, &i.client) < 0 ||
+        pa_tagstruct_getu32(t, &i.sink) < 0 ||
+        pa_tagstruct_get_sample_spec(t, &i.sample_spec) < 0 ||
+        pa_tagstruct_get_channel_map(t, &i.channel_map) < 0 ||
+        pa_tagstruct_get_cvolume(t, &i.volume) < 0 ||
+        pa_tagstruct_get_usec(t, &i.buffer_usec) < 0 ||
+        pa_tagstruct_get_usec(t, &i.sink_usec) < 0 ||
+        pa_tagstruct_gets(t, &i.resample_method) < 0 ||
+        pa_tagstruct_gets(t, &i.driver) < 0 ||
+        (c->version >= 11 && pa_tagstruct_get_boolean(t, &mute) < 0) ||
+        (c->version >= 13 && pa_tagstruct_get_proplist(t, i.proplist) < 0) ||
+        (c->version >= 19 && pa_tagstruct_get_boolean(t, &corked) < 0) ||
+        (c->version >= 20 && (pa_tagstruct_get_boolean(t, &has_volume) < 0 ||
+                              pa_tagstruct_get_boolean(t, &volume_writable) < 0)) ||
+        (c->version >= 21 && pa_tagstruct_get_format_info(t, i.format) < 0)) {
+
+        goto finish;
+    }
+
+    i.mute = (int) mute;
+    i.corked = (int) corked;
+    i.has_volume = (int) has_volume;
+    i.volume_writable = (int) volume_writable;
+
+    if (cb)
+        cb(c, &i, 0, userdata);
+
+    r = 0;
+
+finish:
+    pa_proplist_free(i.proplist);
+    pa_format_info_free(i.format);
+
+    return r;
+}
+
 static void context_get_sink_input_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_operation *o = userdata;
     int eol = 1;
@@ -1168,52 +1292,11 @@ static void context_get_sink_input_info_callback(pa_pdispatch *pd, uint32_t comm
         eol = -1;
     } else {
 
-        while (!pa_tagstruct_eof(t)) {
-            pa_sink_input_info i;
-            pa_bool_t mute = FALSE, corked = FALSE, has_volume = FALSE, volume_writable = TRUE;
-
-            pa_zero(i);
-            i.proplist = pa_proplist_new();
-            i.format = pa_format_info_new();
-
-            if (pa_tagstruct_getu32(t, &i.index) < 0 ||
-                pa_tagstruct_gets(t, &i.name) < 0 ||
-                pa_tagstruct_getu32(t, &i.owner_module) < 0 ||
-                pa_tagstruct_getu32(t, &i.client) < 0 ||
-                pa_tagstruct_getu32(t, &i.sink) < 0 ||
-                pa_tagstruct_get_sample_spec(t, &i.sample_spec) < 0 ||
-                pa_tagstruct_get_channel_map(t, &i.channel_map) < 0 ||
-                pa_tagstruct_get_cvolume(t, &i.volume) < 0 ||
-                pa_tagstruct_get_usec(t, &i.buffer_usec) < 0 ||
-                pa_tagstruct_get_usec(t, &i.sink_usec) < 0 ||
-                pa_tagstruct_gets(t, &i.resample_method) < 0 ||
-                pa_tagstruct_gets(t, &i.driver) < 0 ||
-                (o->context->version >= 11 && pa_tagstruct_get_boolean(t, &mute) < 0) ||
-                (o->context->version >= 13 && pa_tagstruct_get_proplist(t, i.proplist) < 0) ||
-                (o->context->version >= 19 && pa_tagstruct_get_boolean(t, &corked) < 0) ||
-                (o->context->version >= 20 && (pa_tagstruct_get_boolean(t, &has_volume) < 0 ||
-                                               pa_tagstruct_get_boolean(t, &volume_writable) < 0)) ||
-                (o->context->version >= 21 && pa_tagstruct_get_format_info(t, i.format) < 0)) {
-
+        while (!pa_tagstruct_eof(t))
+            if (read_sink_input_info(o->context, t, (pa_sink_input_info_cb_t) o->callback, o->userdata) < 0) {
                 pa_context_fail(o->context, PA_ERR_PROTOCOL);
-                pa_proplist_free(i.proplist);
-                pa_format_info_free(i.format);
                 goto finish;
             }
-
-            i.mute = (int) mute;
-            i.corked = (int) corked;
-            i.has_volume = (int) has_volume;
-            i.volume_writable = (int) volume_writable;
-
-            if (o->callback) {
-                pa_sink_input_info_cb_t cb = (pa_sink_input_info_cb_t) o->callback;
-                cb(o->context, &i, 0, o->userdata);
-            }
-
-            pa_proplist_free(i.proplist);
-            pa_format_info_free(i.format);
-        }
     }
 
     if (o->callback) {
@@ -1243,6 +1326,7 @@ pa_operation* pa_context_get_sink_input_info(pa_context *c, uint32_t idx, pa_sin
 
     t = pa_tagstruct_command(c, PA_COMMAND_GET_SINK_INPUT_INFO, &tag);
     pa_tagstruct_putu32(t, idx);
+    put_info_fields(c, t);
     pa_pstream_send_tagstruct(c->pstream, t);
     pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, context_get_sink_input_info_callback, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
 
@@ -1250,11 +1334,59 @@ pa_operation* pa_context_get_sink_input_info(pa_context *c, uint32_t idx, pa_sin
 }
 
 pa_operation* pa_context_get_sink_input_info_list(pa_context *c, void (*cb)(pa_context *c, const pa_sink_input_info*i, int is_last, void *userdata), void *userdata) {
-    return pa_context_send_simple_command(c, PA_COMMAND_GET_SINK_INPUT_INFO_LIST, context_get_sink_input_info_callback, (pa_operation_cb_t) cb, userdata);
+    return send_info_list_command(c, PA_COMMAND_GET_SINK_INPUT_INFO_LIST, context_get_sink_input_info_callback, (pa_operation_cb_t) cb, userdata);
 }
 
 /*** Source output info ***/
 
+static int read_source_output_info(pa_context *c, pa_tagstruct *t, pa_source_output_info_cb_t cb, void *userdata) {
+    pa_source_output_info i;
+    pa_bool_t mute = FALSE, corked = FALSE, has_volume = FALSE, volume_writable = TRUE;
+    int r = -1;
+
+    pa_zero(i);
+    i.proplist = pa_proplist_new();
+    i.format = pa_format_info_new();
+
+    if (pa_tagstruct_getu32(t, &i.index) < 0 ||
+        pa_tagstruct_gets(t, &i.name) < 0 ||
+        pa_tagstruct_getu32(t, &i.owner_module) < 0 ||
+        pa_tagstruct_getu32(t, &i.client) < 0 ||
+        pa_tagstruct_getu32(t, &i.source) < 0 ||
+        pa_tagstruct_get_sample_spec(t, &i.sample_spec) < 0 ||
+        pa_tagstruct_get_channel_map(t, &i.channel_map) < 0 ||
+        pa_tagstruct_get_usec(t, &i.buffer_usec) < 0 ||
+        pa_tagstruct_get_usec(t, &i.source_usec) < 0 ||
+        pa_tagstruct_gets(t, &i.resample_method) < 0 ||
+        pa_tagstruct_gets(t, &i.driver) < 0 ||
+        (c->version >= 13 && pa_tagstruct_get_proplist(t, i.proplist) < 0) ||
+        (c->version >= 19 && pa_tagstruct_get_boolean(t, &corked) < 0) ||
+        (c->version >= 22 && (pa_tagstruct_get_cvolume(t, &i.volume) < 0 ||
+                              pa_tagstruct_get_boolean(t, &mute) < 0 ||
+                              pa_tagstruct_get_boolean(t, &has_volume) < 0 ||
+                              pa_tagstruct_get_boolean(t, &volume_writable) < 0 ||
+                              pa_tagstruct_get_format_info(t, i.format) < 0))) {
+
+        goto finish;
+    }
+
+    i.mute = (int) mute;
+    i.corked = (int) corked;
+    i.has_volume = (int) has_volume;
+    i.volume_writable = (int) volume_writable;
+
+    if (cb)
+        cb(c, &i, 0, userdata);
+
+    r = 0;
+
+finish:
+    pa_proplist_free(i.proplist);
+    pa_format_info_free(i.format);
+
+    return r;
+}
+
 static void context_get_source_output_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_operation *o = userdata;
     int eol = 1;
@@ -1273,52 +1405,11 @@ static void context_get_source_output_info_callback(pa_pdispatch *pd, uint32_t c
         eol = -1;
     } else {
 
-        while (!pa_tagstruct_eof(t)) {
-            pa_source_output_info i;
-            pa_bool_t mute = FALSE, corked = FALSE, has_volume = FALSE, volume_writable = TRUE;
-
-            pa_zero(i);
-            i.proplist = pa_proplist_new();
-            i.format = pa_format_info_new();
-
-            if (pa_tagstruct_getu32(t, &i.index) < 0 ||
-                pa_tagstruct_gets(t, &i.name) < 0 ||
-                pa_tagstruct_getu32(t, &i.owner_module) < 0 ||
-                pa_tagstruct_getu32(t, &i.client) < 0 ||
-                pa_tagstruct_getu32(t, &i.source) < 0 ||
-                pa_tagstruct_get_sample_spec(t, &i.sample_spec) < 0 ||
-                pa_tagstruct_get_channel_map(t, &i.channel_map) < 0 ||
-                pa_tagstruct_get_usec(t, &i.buffer_usec) < 0 ||
-                pa_tagstruct_get_usec(t, &i.source_usec) < 0 ||
-                pa_tagstruct_gets(t, &i.resample_method) < 0 ||
-                pa_tagstruct_gets(t, &i.driver) < 0 ||
-                (o->context->version >= 13 && pa_tagstruct_get_proplist(t, i.proplist) < 0) ||
-                (o->context->version >= 19 && pa_tagstruct_get_boolean(t, &corked) < 0) ||
-                (o->context->version >= 22 && (pa_tagstruct_get_cvolume(t, &i.volume) < 0 ||
-                                               pa_tagstruct_get_boolean(t, &mute) < 0 ||
-                                               pa_tagstruct_get_boolean(t, &has_volume) < 0 ||
-                                               pa_tagstruct_get_boolean(t, &volume_writable) < 0 ||
-                                               pa_tagstruct_get_format_info(t, i.format) < 0))) {
-
+        while (!pa_tagstruct_eof(t))
+            if (read_source_output_info(o->context, t, (pa_source_output_info_cb_t) o->callback, o->userdata) < 0) {
                 pa_context_fail(o->context, PA_ERR_PROTOCOL);
-                pa_proplist_free(i.proplist);
-                pa_format_info_free(i.format);
                 goto finish;
             }
-
-            i.mute = (int) mute;
-            i.corked = (int) corked;
-            i.has_volume = (int) has_volume;
-            i.volume_writable = (int) volume_writable;
-
-            if (o->callback) {
-                pa_source_output_info_cb_t cb = (pa_source_output_info_cb_t) o->callback;
-                cb(o->context, &i, 0, o->userdata);
-            }
-
-            pa_proplist_free(i.proplist);
-            pa_format_info_free(i.format);
-        }
     }
 
     if (o->callback) {
@@ -1348,6 +1439,7 @@ pa_operation* pa_context_get_source_output_info(pa_context *c, uint32_t idx, pa_
 
     t = pa_tagstruct_command(c, PA_COMMAND_GET_SOURCE_OUTPUT_INFO, &tag);
     pa_tagstruct_putu32(t, idx);
+    put_info_fields(c, t);
     pa_pstream_send_tagstruct(c->pstream, t);
     pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, context_get_source_output_info_callback, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
 
@@ -1355,7 +1447,190 @@ pa_operation* pa_context_get_source_output_info(pa_context *c, uint32_t idx, pa_
 }
 
 pa_operation* pa_context_get_source_output_info_list(pa_context *c,  pa_source_output_info_cb_t cb, void *userdata) {
-    return pa_context_send_simple_command(c, PA_COMMAND_GET_SOURCE_OUTPUT_INFO_LIST, context_get_source_output_info_callback, (pa_operation_cb_t) cb, userdata);
+    return send_info_list_command(c, PA_COMMAND_GET_SOURCE_OUTPUT_INFO_LIST, context_get_source_output_info_callback, (pa_operation_cb_t) cb, userdata);
+}
+
+/*** Snapshots ***/
+
+/* Reads the info of one object of the facility from t and passes it to
+ * the snapshot callback of the context */
+int pa_context_read_snapshot_object(pa_context *c, pa_subscription_event_type_t facility, pa_tagstruct *t) {
+    const pa_snapshot_callbacks *cbs;
+    void *userdata;
+
+    pa_assert(c);
+    pa_assert(t);
+
+    cbs = &c->snapshot_callbacks;
+    userdata = c->snapshot_userdata;
+
+    switch (facility) {
+        case PA_SUBSCRIPTION_EVENT_SERVER: {
+            pa_server_info i;
+
+            if (read_server_info(c, t, &i) < 0)
+                return -1;
+
+            if (cbs->server)
+                cbs->server(c, &i, userdata);
+
+            return 0;
+        }
+
+        case PA_SUBSCRIPTION_EVENT_SINK:
+            return read_sink_info(c, t, cbs->sink, userdata);
+
+        case PA_SUBSCRIPTION_EVENT_SOURCE:
+            return read_source_info(c, t, cbs->source, userdata);
+
+        case PA_SUBSCRIPTION_EVENT_CARD:
+            return read_card_info(c, t, cbs->card, userdata);
+
+        case PA_SUBSCRIPTION_EVENT_MODULE:
+            return read_module_info(c, t, cbs->module, userdata);
+
+        case PA_SUBSCRIPTION_EVENT_CLIENT:
+            return read_client_info(c, t, cbs->client, userdata);
+
+        case PA_SUBSCRIPTION_EVENT_SINK_INPUT:
+            return read_sink_input_info(c, t, cbs->sink_input, userdata);
+
+        case PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT:
+            return read_source_output_info(c, t, cbs->source_output, userdata);
+
+        default:
+            return -1;
+    }
+}
+
+/* Signals the end of the list of objects of the facility */
+static void snapshot_eol(pa_context *c, pa_subscription_event_type_t facility) {
+    const pa_snapshot_callbacks *cbs = &c->snapshot_callbacks;
+    void *userdata = c->snapshot_userdata;
+
+    switch (facility) {
+        case PA_SUBSCRIPTION_EVENT_SINK:
+            if (cbs->sink)
+                cbs->sink(c, NULL, 1, userdata);
+            break;
+
+        case PA_SUBSCRIPTION_EVENT_SOURCE:
+            if (cbs->source)
+                cbs->source(c, NULL, 1, userdata);
+            break;
+
+        case PA_SUBSCRIPTION_EVENT_CARD:
+            if (cbs->card)
+                cbs->card(c, NULL, 1, userdata);
+            break;
+
+        case PA_SUBSCRIPTION_EVENT_MODULE:
+            if (cbs->module)
+                cbs->module(c, NULL, 1, userdata);
+            break;
+
+        case PA_SUBSCRIPTION_EVENT_CLIENT:
+            if (cbs->client)
+                cbs->client(c, NULL, 1, userdata);
+            break;
+
+        case PA_SUBSCRIPTION_EVENT_SINK_INPUT:
+            if (cbs->sink_input)
+                cbs->sink_input(c, NULL, 1, userdata);
+            break;
+
+        case PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT:
+            if (cbs->source_output)
+                cbs->source_output(c, NULL, 1, userdata);
+            break;
+
+        default:
+            pa_assert_not_reached();
+    }
+}
+
+static void context_get_snapshot_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_operation *o = userdata;
+    int success = 1;
+
+    pa_assert(pd);
+    pa_assert(o);
+    pa_assert(PA_REFCNT_VALUE(o) >= 1);
+
+    if (!o->context)
+        goto finish;
+
+    if (command != PA_COMMAND_REPLY) {
+        if (pa_context_handle_error(o->context, command, t, FALSE) < 0)
+            goto finish;
+
+        success = 0;
+    } else {
+
+        if (pa_context_read_snapshot_object(o->context, PA_SUBSCRIPTION_EVENT_SERVER, t) < 0)
+            goto fail;
+
+        /* The server info is followed by one list per facility */
+        while (!pa_tagstruct_eof(t)) {
+            uint32_t facility, n;
+
+            if (pa_tagstruct_getu32(t, &facility) < 0 ||
+                pa_tagstruct_getu32(t, &n) < 0 ||
+                facility == PA_SUBSCRIPTION_EVENT_SERVER)
+                goto fail;
+
+            for (; n > 0; n--)
+                if (!o->context || pa_context_read_snapshot_object(o->context, facility, t) < 0)
+                    goto fail;
+
+            if (!o->context)
+                goto finish;
+
+            snapshot_eol(o->context, facility);
+        }
+    }
+
+    if (o->callback && o->context) {
+        pa_context_success_cb_t cb = (pa_context_success_cb_t) o->callback;
+        cb(o->context, success, o->userdata);
+    }
+
+finish:
+    pa_operation_done(o);
+    pa_operation_unref(o);
+    return;
+
+fail:
+    if (o->context)
+        pa_context_fail(o->context, PA_ERR_PROTOCOL);
+
+    goto finish;
+}
+
+pa_operation* pa_context_get_snapshot(pa_context *c, const pa_snapshot_callbacks *cbs, int follow, pa_context_success_cb_t cb, void *userdata) {
+    pa_operation *o;
+    pa_tagstruct *t;
+    uint32_t tag;
+
+    pa_assert(c);
+    pa_assert(PA_REFCNT_VALUE(c) >= 1);
+    pa_assert(cbs);
+
+    PA_CHECK_VALIDITY_RETURN_NULL(c, !pa_detect_fork(), PA_ERR_FORKED);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->state == PA_CONTEXT_READY, PA_ERR_BADSTATE);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->version >= 30, PA_ERR_NOTSUPPORTED);
+
+    c->snapshot_callbacks = *cbs;
+    c->snapshot_userdata = userdata;
+
+    o = pa_operation_new(c, NULL, (pa_operation_cb_t) cb, userdata);
+
+    t = pa_tagstruct_command(c, PA_COMMAND_GET_SNAPSHOT, &tag);
+    pa_tagstruct_put_boolean(t, !!follow);
+    pa_pstream_send_tagstruct(c->pstream, t);
+    pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, context_get_snapshot_callback, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
+
+    return o;
 }
 
 /*** Volume manipulation ***/
@@ -1509,6 +1784,61 @@ pa_operation* pa_context_set_sink_input_mute(pa_context *c, uint32_t idx, int mu
     return o;
 }
 
+pa_operation* pa_context_set_volumes(pa_context *c, const pa_volume_change *changes, unsigned n, pa_context_success_cb_t cb, void *userdata) {
+    pa_operation *o;
+    pa_tagstruct *t;
+    uint32_t tag;
+    unsigned i;
+
+    pa_assert(c);
+    pa_assert(PA_REFCNT_VALUE(c) >= 1);
+    pa_assert(changes || n == 0);
+
+    PA_CHECK_VALIDITY_RETURN_NULL(c, !pa_detect_fork(), PA_ERR_FORKED);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->state == PA_CONTEXT_READY, PA_ERR_BADSTATE);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->version >= 36, PA_ERR_NOTSUPPORTED);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, n > 0, PA_ERR_INVALID);
+
+    for (i = 0; i < n; i++) {
+        PA_CHECK_VALIDITY_RETURN_NULL(c,
+                                      changes[i].facility == PA_SUBSCRIPTION_EVENT_SINK ||
+                                      changes[i].facility == PA_SUBSCRIPTION_EVENT_SOURCE ||
+                                      changes[i].facility == PA_SUBSCRIPTION_EVENT_SINK_INPUT ||
+                                      changes[i].facility == PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT, PA_ERR_INVALID);
+        PA_CHECK_VALIDITY_RETURN_NULL(c, changes[i].index != PA_INVALID_INDEX, PA_ERR_INVALID);
+        PA_CHECK_VALIDITY_RETURN_NULL(c, !changes[i].volume || pa_cvolume_valid(changes[i].volume), PA_ERR_INVALID);
+        PA_CHECK_VALIDITY_RETURN_NULL(c, changes[i].mute >= -1 && changes[i].mute <= 1, PA_ERR_INVALID);
+    }
+
+    o = pa_operation_new(c, NULL, (pa_operation_cb_t) cb, userdata);
+
+    t = pa_tagstruct_command(c, PA_COMMAND_SET_VOLUMES, &tag);
+    pa_tagstruct_putu32(t, n);
+
+    for (i = 0; i < n; i++) {
+        pa_cvolume none;
+
+        pa_tagstruct_putu32(t, changes[i].facility);
+        pa_tagstruct_putu32(t, changes[i].index);
+
+        /* A volume without channels leaves it as it is */
+        if (changes[i].volume)
+            pa_tagstruct_put_cvolume(t, changes[i].volume);
+        else {
+            none.channels = 0;
+            pa_tagstruct_put_cvolume(t, &none);
+        }
+
+        pa_tagstruct_put_boolean(t, changes[i].mute >= 0);
+        pa_tagstruct_put_boolean(t, changes[i].mute > 0);
+    }
+
+    pa_pstream_send_tagstruct(c->pstream, t);
+    pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, pa_context_simple_ack_callback, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
+
+    return o;
+}
+
 pa_operation* pa_context_set_source_volume_by_index(pa_context *c, uint32_t idx, const pa_cvolume *volume, pa_context_success_cb_t cb, void *userdata) {
     pa_operation *o;
     pa_tagstruct *t;
@@ -1740,6 +2070,7 @@ pa_operation* pa_context_get_sample_info_by_name(pa_context *c, const char *name
     t = pa_tagstruct_command(c, PA_COMMAND_GET_SAMPLE_INFO, &tag);
     pa_tagstruct_putu32(t, PA_INVALID_INDEX);
     pa_tagstruct_puts(t, name);
+    put_info_fields(c, t);
     pa_pstream_send_tagstruct(c->pstream, t);
     pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, context_get_sample_info_callback, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
 
@@ -1764,6 +2095,7 @@ pa_operation* pa_context_get_sample_info_by_index(pa_context *c, uint32_t idx, p
     t = pa_tagstruct_command(c, PA_COMMAND_GET_SAMPLE_INFO, &tag);
     pa_tagstruct_putu32(t, idx);
     pa_tagstruct_puts(t, NULL);
+    put_info_fields(c, t);
     pa_pstream_send_tagstruct(c->pstream, t);
     pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, context_get_sample_info_callback, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
 
@@ -1771,7 +2103,7 @@ pa_operation* pa_context_get_sample_info_by_index(pa_context *c, uint32_t idx, p
 }
 
 pa_operation* pa_context_get_sample_info_list(pa_context *c, pa_sample_info_cb_t cb, void *userdata) {
-    return pa_context_send_simple_command(c, PA_COMMAND_GET_SAMPLE_INFO_LIST, context_get_sample_info_callback, (pa_operation_cb_t) cb, userdata);
+    return send_info_list_command(c, PA_COMMAND_GET_SAMPLE_INFO_LIST, context_get_sample_info_callback, (pa_operation_cb_t) cb, userdata);
 }
 
 static pa_operation* command_kill(pa_context *c, uint32_t command, uint32_t idx, pa_context_success_cb_t cb, void *userdata) {
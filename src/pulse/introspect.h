@@ -136,6 +136,26 @@
  * either pa_context_get_client_info() or pa_context_get_client_info_list().
  * The information structure is called pa_client_info.
  *
+ * \subsection snapshot_subsec Snapshots
+ *
+ * pa_context_get_snapshot() retrieves the server info and all sinks,
+ * sources, cards, modules, clients, sink inputs and source outputs in a
+ * single round trip, passing them to a set of callbacks collected in
+ * pa_snapshot_callbacks. If follow mode is requested, the server
+ * afterwards attaches the current info of an object to each new and
+ * change subscription event, and the matching callback is called just
+ * before the subscription callback. Together with a subscription this
+ * keeps a local copy of the server state up to date without further
+ * queries.
+ *
+ * \subsection fields_subsec Info Fields
+ *
+ * A client that only looks at a few fields, e.g. the volumes and states,
+ * may tell with pa_context_set_info_fields() which of the large or
+ * expensive parts of the info structures it needs. The server then
+ * leaves the others out of the replies to all query functions above,
+ * see pa_info_fields_t.
+ *
  * \section ctrl_sec Control
  *
  * Some parts of the server are only possible to read, but most can also be
@@ -610,6 +630,15 @@ pa_operation* pa_context_kill_source_output(pa_context *c, uint32_t idx, pa_cont
 
 /** @{ \name Statistics */
 
+/** Statistics of one of the daemon's internal free lists, which
+ * recycle objects like memory blocks and queue entries. The daemon's
+ * threads each keep a small cache in front of these lists. \since 3.0 */
+typedef struct pa_stat_flist_info {
+    const char *name;                  /**< Name of the free list */
+    uint64_t hits;                     /**< Objects taken from a thread's cache */
+    uint64_t misses;                   /**< Times a thread's cache was empty and the shared list had to be used */
+} pa_stat_flist_info;
+
 /** Memory block statistics. Please note that this structure
  * can be extended as part of evolutionary API updates at any time in
  * any new release. */
@@ -619,6 +648,8 @@ typedef struct pa_stat_info {
     uint32_t memblock_allocated;       /**< Allocated memory blocks during the whole lifetime of the daemon. */
     uint32_t memblock_allocated_size;  /**< Total size of all memory blocks allocated during the whole lifetime of the daemon. */
     uint32_t scache_size;              /**< Total size of all sample cache entries. */
+    uint32_t n_flists;                 /**< Number of entries in the free list array \since 3.0 */
+    pa_stat_flist_info *flists;        /**< Array of free list statistics, or NULL \since 3.0 */
 } pa_stat_info;
 
 /** Callback prototype for pa_context_stat() */
@@ -661,6 +692,66 @@ pa_operation* pa_context_get_sample_info_list(pa_context *c, pa_sample_info_cb_t
 
 /** @} */
 
+/** @{ \name Batched Volume Changes */
+
+/** A volume and/or mute change for pa_context_set_volumes(). \since 3.0 */
+typedef struct pa_volume_change {
+    pa_subscription_event_type_t facility; /**< The kind of object: PA_SUBSCRIPTION_EVENT_SINK, PA_SUBSCRIPTION_EVENT_SOURCE, PA_SUBSCRIPTION_EVENT_SINK_INPUT or PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT */
+    uint32_t index;                        /**< Index of the object */
+    const pa_cvolume *volume;              /**< The new volume, or NULL to leave it as it is */
+    int mute;                              /**< 1 to mute, 0 to unmute, -1 to leave it as it is */
+} pa_volume_change;
+
+/** Change the volumes and mute switches of many objects with a single
+ * command. The changes of the devices are applied before those of the
+ * streams. The sink inputs of a sink are then changed at once, with a
+ * single rewind of the sink when one is needed. Nothing is changed if
+ * any of the entries is not valid, the success callback gets the error
+ * then. \since 3.0 */
+pa_operation* pa_context_set_volumes(pa_context *c, const pa_volume_change *changes, unsigned n, pa_context_success_cb_t cb, void *userdata);
+
+/** @} */
+
+/** @{ \name Snapshots */
+
+/** Callbacks for the objects in a snapshot. Each object callback is
+ * called once for every object of its kind, and then once with eol
+ * set. Any of them may be NULL. \since 3.0 */
+typedef struct pa_snapshot_callbacks {
+    pa_server_info_cb_t server;                 /**< Called for the server info */
+    pa_sink_info_cb_t sink;                     /**< Called for each sink */
+    pa_source_info_cb_t source;                 /**< Called for each source */
+    pa_card_info_cb_t card;                     /**< Called for each card */
+    pa_module_info_cb_t module;                 /**< Called for each module */
+    pa_client_info_cb_t client;                 /**< Called for each client */
+    pa_sink_input_info_cb_t sink_input;         /**< Called for each sink input */
+    pa_source_output_info_cb_t source_output;   /**< Called for each source output */
+} pa_snapshot_callbacks;
+
+/** Get a snapshot of all objects of the server in a single reply. The
+ * callbacks are copied and are also used for the follow mode: if
+ * follow is non-zero, subsequent new and change subscription events
+ * carry the info of the object, which is passed to the matching
+ * callback (with eol 0) before the subscription callback is
+ * called. Calling this again replaces the callbacks. The success
+ * callback is called when the complete snapshot has been
+ * processed. userdata is passed to all callbacks. \since 3.0 */
+pa_operation* pa_context_get_snapshot(pa_context *c, const pa_snapshot_callbacks *cbs, int follow, pa_context_success_cb_t cb, void *userdata);
+
+/** @} */
+
+/** @{ \name Info Fields */
+
+/** Select the parts of the info structures the server fills in for
+ * the subsequent queries of sinks, sources, cards, modules, clients,
+ * sink inputs, source outputs and samples of this context, a
+ * combination of pa_info_fields_t. Snapshots always contain
+ * everything, as do the replies of servers that are older than
+ * 3.0. The default is PA_INFO_FIELDS_ALL. \since 3.0 */
+void pa_context_set_info_fields(pa_context *c, pa_info_fields_t fields);
+
+/** @} */
+
 /** \cond fulldocs */
 
 /** @{ \name Autoload Entries */
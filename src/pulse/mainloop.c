@@ -30,6 +30,11 @@
 #include <fcntl.h>
 #include <errno.h>
 
+#ifdef HAVE_SYS_EPOLL_H
+#define USE_EPOLL
+#include <sys/epoll.h>
+#endif
+
 #ifndef HAVE_PIPE
 #include <pulsecore/pipe.h>
 #endif
@@ -41,6 +46,7 @@
 #include <pulsecore/poll.h>
 #include <pulsecore/core-rtclock.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/hashmap.h>
 #include <pulsecore/i18n.h>
 #include <pulsecore/llist.h>
 #include <pulsecore/log.h>
@@ -72,8 +78,12 @@ struct pa_time_event {
 
     pa_bool_t enabled:1;
     pa_bool_t use_rtclock:1;
+    pa_bool_t pending:1;
     pa_usec_t time;
 
+    /* Position in time_heap while enabled */
+    unsigned heap_idx;
+
     pa_time_event_cb_t callback;
     void *userdata;
     pa_time_event_destroy_cb_t destroy_callback;
@@ -106,8 +116,26 @@ struct pa_mainloop {
     struct pollfd *pollfds;
     unsigned max_pollfds, n_pollfds;
 
+#ifdef USE_EPOLL
+    /* If epoll_fd is >= 0 the io events are registered with it and
+     * pollfds only has the epoll fd itself, so that poll_func still
+     * works. Set up when the main loop is created, dropped in favour
+     * of the pollfd array if an fd cannot be added. */
+    int epoll_fd;
+    pa_hashmap *epoll_registered;
+    struct epoll_event *epoll_events;
+    unsigned max_epoll_events, n_epoll_events;
+#endif
+
+    /* The enabled time events, a binary min-heap on their time */
+    pa_time_event **time_heap;
+    unsigned max_time_heap;
+
+    /* Time events that expired in the current dispatch */
+    pa_time_event **expired;
+    unsigned max_expired;
+
     pa_usec_t prepared_timeout;
-    pa_time_event *cached_next_time_event;
 
     pa_mainloop_api api;
 
@@ -147,6 +175,182 @@ static pa_io_event_flags_t map_flags_from_libc(short flags) {
         (flags & POLLHUP ? PA_IO_EVENT_HANGUP : 0);
 }
 
+#ifdef USE_EPOLL
+static void epoll_done(pa_mainloop *m) {
+    pa_assert(m);
+
+    if (m->epoll_fd >= 0)
+        pa_close(m->epoll_fd);
+
+    m->epoll_fd = -1;
+
+    if (m->epoll_registered) {
+        pa_hashmap_free(m->epoll_registered, NULL, NULL);
+        m->epoll_registered = NULL;
+    }
+
+    pa_xfree(m->epoll_events);
+    m->epoll_events = NULL;
+    m->max_epoll_events = m->n_epoll_events = 0;
+
+    m->rebuild_pollfds = TRUE;
+}
+
+static void epoll_init(pa_mainloop *m) {
+    struct epoll_event ev;
+
+    pa_assert(m);
+
+    if ((m->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        pa_log_debug("epoll_create1() failed, using poll(): %s", pa_cstrerror(errno));
+        return;
+    }
+
+    m->epoll_registered = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+
+    /* The wakeup pipe is the only fd without an io event */
+    pa_zero(ev);
+    ev.events = EPOLLIN;
+    ev.data.fd = m->wakeup_pipe[0];
+
+    if (epoll_ctl(m->epoll_fd, EPOLL_CTL_ADD, m->wakeup_pipe[0], &ev) < 0) {
+        pa_log_debug("Failed to add wakeup pipe to epoll set, using poll(): %s", pa_cstrerror(errno));
+        epoll_done(m);
+    }
+}
+
+static int epoll_register(pa_mainloop *m, pa_io_event *e, int op) {
+    struct epoll_event ev;
+
+    /* On Linux the poll() and epoll() event bits are identical */
+    pa_zero(ev);
+    ev.events = (uint32_t) map_flags_to_libc(e->events);
+    ev.data.fd = e->fd;
+
+    return epoll_ctl(m->epoll_fd, op, e->fd, &ev);
+}
+
+static void epoll_fail(pa_mainloop *m, pa_io_event *e) {
+    pa_log_debug("Cannot use epoll() for fd %i, falling back to poll(): %s", e->fd, pa_cstrerror(errno));
+    epoll_done(m);
+}
+
+static void epoll_add_io(pa_mainloop *m, pa_io_event *e) {
+    if (m->epoll_fd < 0)
+        return;
+
+    /* Fails for the same fd twice, or for files epoll cannot watch */
+    if (epoll_register(m, e, EPOLL_CTL_ADD) < 0) {
+        epoll_fail(m, e);
+        return;
+    }
+
+    /* If there is an entry already, its fd was closed before the event
+     * was freed and the number has been reused since. Entries are
+     * looked up by fd rather than by pointer for the same reason: the
+     * kernel keeps such an entry as long as the file stays open
+     * elsewhere, and its events must not reach a freed io event. */
+    pa_hashmap_remove(m->epoll_registered, PA_INT_TO_PTR(e->fd));
+    pa_hashmap_put(m->epoll_registered, PA_INT_TO_PTR(e->fd), e);
+}
+
+static void epoll_update_io(pa_mainloop *m, pa_io_event *e) {
+    if (m->epoll_fd < 0 || pa_hashmap_get(m->epoll_registered, PA_INT_TO_PTR(e->fd)) != e)
+        return;
+
+    if (epoll_register(m, e, EPOLL_CTL_MOD) < 0)
+        epoll_fail(m, e);
+}
+
+static void epoll_remove_io(pa_mainloop *m, pa_io_event *e) {
+    if (m->epoll_fd < 0 || pa_hashmap_get(m->epoll_registered, PA_INT_TO_PTR(e->fd)) != e)
+        return;
+
+    pa_hashmap_remove(m->epoll_registered, PA_INT_TO_PTR(e->fd));
+
+    /* Fails if the fd is closed already, which removed it anyway */
+    epoll_ctl(m->epoll_fd, EPOLL_CTL_DEL, e->fd, NULL);
+}
+#endif
+
+/* Time event heap */
+static void heap_set(pa_mainloop *m, unsigned i, pa_time_event *e) {
+    m->time_heap[i] = e;
+    e->heap_idx = i;
+}
+
+static void heap_sift_up(pa_mainloop *m, unsigned i) {
+    pa_time_event *e = m->time_heap[i];
+
+    while (i > 0) {
+        unsigned parent = (i - 1) / 2;
+
+        if (m->time_heap[parent]->time <= e->time)
+            break;
+
+        heap_set(m, i, m->time_heap[parent]);
+        i = parent;
+    }
+
+    heap_set(m, i, e);
+}
+
+static void heap_sift_down(pa_mainloop *m, unsigned i) {
+    pa_time_event *e = m->time_heap[i];
+    unsigned n = m->n_enabled_time_events;
+
+    for (;;) {
+        unsigned child = 2 * i + 1;
+
+        if (child >= n)
+            break;
+
+        if (child + 1 < n && m->time_heap[child + 1]->time < m->time_heap[child]->time)
+            child++;
+
+        if (e->time <= m->time_heap[child]->time)
+            break;
+
+        heap_set(m, i, m->time_heap[child]);
+        i = child;
+    }
+
+    heap_set(m, i, e);
+}
+
+static void heap_insert(pa_mainloop *m, pa_time_event *e) {
+    if (m->n_enabled_time_events >= m->max_time_heap) {
+        m->max_time_heap = PA_MAX(16U, m->max_time_heap * 2);
+        m->time_heap = pa_xrenew(pa_time_event*, m->time_heap, m->max_time_heap);
+    }
+
+    heap_set(m, m->n_enabled_time_events++, e);
+    heap_sift_up(m, e->heap_idx);
+}
+
+static void heap_remove(pa_mainloop *m, pa_time_event *e) {
+    unsigned i = e->heap_idx;
+
+    pa_assert(m->n_enabled_time_events > 0);
+    pa_assert(i < m->n_enabled_time_events);
+    pa_assert(m->time_heap[i] == e);
+
+    m->n_enabled_time_events--;
+
+    if (i == m->n_enabled_time_events)
+        return;
+
+    heap_set(m, i, m->time_heap[m->n_enabled_time_events]);
+    heap_sift_up(m, i);
+    heap_sift_down(m, m->time_heap[i]->heap_idx);
+}
+
+/* Called after e->time changed */
+static void heap_update(pa_mainloop *m, pa_time_event *e) {
+    heap_sift_up(m, e->heap_idx);
+    heap_sift_down(m, e->heap_idx);
+}
+
 /* IO events */
 static pa_io_event* mainloop_io_new(
         pa_mainloop_api *a,
@@ -197,6 +401,10 @@ static pa_io_event* mainloop_io_new(
     m->rebuild_pollfds = TRUE;
     m->n_io_events ++;
 
+#ifdef USE_EPOLL
+    epoll_add_io(m, e);
+#endif
+
     pa_mainloop_wakeup(m);
 
     return e;
@@ -211,6 +419,11 @@ static void mainloop_io_enable(pa_io_event *e, pa_io_event_flags_t events) {
 
     e->events = events;
 
+#ifdef USE_EPOLL
+    if (e->mainloop->epoll_fd >= 0)
+        epoll_update_io(e->mainloop, e);
+    else
+#endif
     if (e->pollfd)
         e->pollfd->events = map_flags_to_libc(events);
     else
@@ -229,6 +442,10 @@ static void mainloop_io_free(pa_io_event *e) {
     e->mainloop->n_io_events --;
     e->mainloop->rebuild_pollfds = TRUE;
 
+#ifdef USE_EPOLL
+    epoll_remove_io(e->mainloop, e);
+#endif
+
     pa_mainloop_wakeup(e->mainloop);
 }
 
@@ -353,14 +570,7 @@ static pa_time_event* mainloop_time_new(
         e->time = t;
         e->use_rtclock = use_rtclock;
 
-        m->n_enabled_time_events++;
-
-        if (m->cached_next_time_event) {
-            pa_assert(m->cached_next_time_event->enabled);
-
-            if (t < m->cached_next_time_event->time)
-                m->cached_next_time_event = e;
-        }
+        heap_insert(m, e);
     }
 
     e->callback = callback;
@@ -384,26 +594,27 @@ static void mainloop_time_restart(pa_time_event *e, const struct timeval *tv) {
 
     t = make_rt(tv, &use_rtclock);
 
+    /* Not to be dispatched anymore if it expired already */
+    e->pending = FALSE;
+
     valid = (t != PA_USEC_INVALID);
-    if (e->enabled && !valid) {
-        pa_assert(e->mainloop->n_enabled_time_events > 0);
-        e->mainloop->n_enabled_time_events--;
-    } else if (!e->enabled && valid)
-        e->mainloop->n_enabled_time_events++;
 
-    if ((e->enabled = valid)) {
+    if (e->enabled && !valid)
+        heap_remove(e->mainloop, e);
+
+    if (valid) {
         e->time = t;
         e->use_rtclock = use_rtclock;
+
+        if (e->enabled)
+            heap_update(e->mainloop, e);
+        else
+            heap_insert(e->mainloop, e);
+
         pa_mainloop_wakeup(e->mainloop);
     }
 
-    if (e->mainloop->cached_next_time_event && e->enabled) {
-        pa_assert(e->mainloop->cached_next_time_event->enabled);
-
-        if (t < e->mainloop->cached_next_time_event->time)
-            e->mainloop->cached_next_time_event = e;
-    } else if (e->mainloop->cached_next_time_event == e)
-        e->mainloop->cached_next_time_event = NULL;
+    e->enabled = valid;
 }
 
 static void mainloop_time_free(pa_time_event *e) {
@@ -411,17 +622,14 @@ static void mainloop_time_free(pa_time_event *e) {
     pa_assert(!e->dead);
 
     e->dead = TRUE;
+    e->pending = FALSE;
     e->mainloop->time_events_please_scan ++;
 
     if (e->enabled) {
-        pa_assert(e->mainloop->n_enabled_time_events > 0);
-        e->mainloop->n_enabled_time_events--;
+        heap_remove(e->mainloop, e);
         e->enabled = FALSE;
     }
 
-    if (e->mainloop->cached_next_time_event == e)
-        e->mainloop->cached_next_time_event = NULL;
-
     /* no wakeup needed here. Think about it! */
 }
 
@@ -484,6 +692,10 @@ pa_mainloop *pa_mainloop_new(void) {
 
     m->rebuild_pollfds = TRUE;
 
+#ifdef USE_EPOLL
+    epoll_init(m);
+#endif
+
     m->api = vtable;
     m->api.userdata = m;
 
@@ -539,8 +751,7 @@ static void cleanup_time_events(pa_mainloop *m, pa_bool_t force) {
             }
 
             if (!e->dead && e->enabled) {
-                pa_assert(m->n_enabled_time_events > 0);
-                m->n_enabled_time_events--;
+                heap_remove(m, e);
                 e->enabled = FALSE;
             }
 
@@ -595,6 +806,12 @@ void pa_mainloop_free(pa_mainloop *m) {
     cleanup_time_events(m, TRUE);
 
     pa_xfree(m->pollfds);
+    pa_xfree(m->time_heap);
+    pa_xfree(m->expired);
+
+#ifdef USE_EPOLL
+    epoll_done(m);
+#endif
 
     pa_close_pipe(m->wakeup_pipe);
 
@@ -629,6 +846,21 @@ static void rebuild_pollfds(pa_mainloop *m) {
     m->n_pollfds = 0;
     p = m->pollfds;
 
+#ifdef USE_EPOLL
+    if (m->epoll_fd >= 0) {
+        m->pollfds[0].fd = m->epoll_fd;
+        m->pollfds[0].events = POLLIN;
+        m->pollfds[0].revents = 0;
+        m->n_pollfds = 1;
+
+        PA_LLIST_FOREACH(e, m->io_events)
+            e->pollfd = NULL;
+
+        m->rebuild_pollfds = FALSE;
+        return;
+    }
+#endif
+
     if (m->wakeup_pipe[0] >= 0) {
         m->pollfds[0].fd = m->wakeup_pipe[0];
         m->pollfds[0].events = POLLIN;
@@ -683,6 +915,29 @@ static unsigned dispatch_pollfds(pa_mainloop *m) {
     return r;
 }
 
+#ifdef USE_EPOLL
+static unsigned dispatch_epoll(pa_mainloop *m) {
+    unsigned r = 0, k;
+
+    /* A callback may fall back to poll(), which resets n_epoll_events */
+    for (k = 0; k < m->n_epoll_events && !m->quit; k++) {
+        pa_io_event *e;
+
+        /* The wakeup pipe, or freed by an earlier callback */
+        if (!(e = pa_hashmap_get(m->epoll_registered, PA_INT_TO_PTR(m->epoll_events[k].data.fd))) || e->dead)
+            continue;
+
+        pa_assert(e->callback);
+        e->callback(&m->api, e, e->fd, map_flags_from_libc((short) m->epoll_events[k].events), e->userdata);
+        r++;
+    }
+
+    m->n_epoll_events = 0;
+
+    return r;
+}
+#endif
+
 static unsigned dispatch_defer(pa_mainloop *m) {
     pa_defer_event *e;
     unsigned r = 0;
@@ -706,31 +961,6 @@ static unsigned dispatch_defer(pa_mainloop *m) {
     return r;
 }
 
-static pa_time_event* find_next_time_event(pa_mainloop *m) {
-    pa_time_event *t, *n = NULL;
-    pa_assert(m);
-
-    if (m->cached_next_time_event)
-        return m->cached_next_time_event;
-
-    PA_LLIST_FOREACH(t, m->time_events) {
-
-        if (t->dead || !t->enabled)
-            continue;
-
-        if (!n || t->time < n->time) {
-            n = t;
-
-            /* Shortcut for time == 0 */
-            if (n->time == 0)
-                break;
-        }
-    }
-
-    m->cached_next_time_event = n;
-    return n;
-}
-
 static pa_usec_t calc_next_timeout(pa_mainloop *m) {
     pa_time_event *t;
     pa_usec_t clock_now;
@@ -738,7 +968,7 @@ static pa_usec_t calc_next_timeout(pa_mainloop *m) {
     if (m->n_enabled_time_events <= 0)
         return PA_USEC_INVALID;
 
-    pa_assert_se(t = find_next_time_event(m));
+    t = m->time_heap[0];
 
     if (t->time <= 0)
         return 0;
@@ -754,7 +984,7 @@ static pa_usec_t calc_next_timeout(pa_mainloop *m) {
 static unsigned dispatch_timeout(pa_mainloop *m) {
     pa_time_event *e;
     pa_usec_t now;
-    unsigned r = 0;
+    unsigned r = 0, n = 0, k;
     pa_assert(m);
 
     if (m->n_enabled_time_events <= 0)
@@ -762,25 +992,38 @@ static unsigned dispatch_timeout(pa_mainloop *m) {
 
     now = pa_rtclock_now();
 
-    PA_LLIST_FOREACH(e, m->time_events) {
+    /* Take everything that expired off the heap first, so that events
+     * restarted by the callbacks are not dispatched twice */
+    while (m->n_enabled_time_events > 0 && m->time_heap[0]->time <= now) {
+        e = m->time_heap[0];
 
-        if (m->quit)
-            break;
+        /* Disable time event */
+        mainloop_time_restart(e, NULL);
+        e->pending = TRUE;
 
-        if (e->dead || !e->enabled)
-            continue;
+        if (n >= m->max_expired) {
+            m->max_expired = PA_MAX(16U, m->max_expired * 2);
+            m->expired = pa_xrenew(pa_time_event*, m->expired, m->max_expired);
+        }
 
-        if (e->time <= now) {
-            struct timeval tv;
-            pa_assert(e->callback);
+        m->expired[n++] = e;
+    }
 
-            /* Disable time event */
-            mainloop_time_restart(e, NULL);
+    for (k = 0; k < n; k++) {
+        struct timeval tv;
 
-            e->callback(&m->api, e, pa_timeval_rtstore(&tv, e->time, e->use_rtclock), e->userdata);
+        e = m->expired[k];
 
-            r++;
-        }
+        /* Restarted or freed by an earlier callback */
+        if (!e->pending || m->quit)
+            continue;
+
+        e->pending = FALSE;
+
+        pa_assert(e->callback);
+        e->callback(&m->api, e, pa_timeval_rtstore(&tv, e->time, e->use_rtclock), e->userdata);
+
+        r++;
     }
 
     return r;
@@ -855,6 +1098,46 @@ static int usec_to_timeout(pa_usec_t u) {
     return timeout;
 }
 
+#ifdef USE_EPOLL
+static void poll_epoll(pa_mainloop *m) {
+    unsigned n;
+
+    pa_assert(!m->rebuild_pollfds);
+    pa_assert(m->n_pollfds == 1);
+
+    /* All io events and the wakeup pipe may be ready at once */
+    n = m->n_io_events + 1;
+    if (n > m->max_epoll_events) {
+        m->max_epoll_events = PA_MAX(16U, n * 2);
+        m->epoll_events = pa_xrenew(struct epoll_event, m->epoll_events, m->max_epoll_events);
+    }
+
+    m->n_epoll_events = 0;
+
+    /* A custom poll function only ever sees the epoll fd, the events
+     * themselves are collected without waiting afterwards */
+    if (m->poll_func) {
+        m->poll_func_ret = m->poll_func(
+                m->pollfds, m->n_pollfds,
+                usec_to_timeout(m->prepared_timeout),
+                m->poll_func_userdata);
+
+        if (m->poll_func_ret > 0)
+            m->poll_func_ret = epoll_wait(m->epoll_fd, m->epoll_events, (int) m->max_epoll_events, 0);
+    } else
+        m->poll_func_ret = epoll_wait(m->epoll_fd, m->epoll_events, (int) m->max_epoll_events, usec_to_timeout(m->prepared_timeout));
+
+    if (m->poll_func_ret > 0)
+        m->n_epoll_events = (unsigned) m->poll_func_ret;
+    else if (m->poll_func_ret < 0) {
+        if (errno == EINTR)
+            m->poll_func_ret = 0;
+        else
+            pa_log("epoll_wait(): %s", pa_cstrerror(errno));
+    }
+}
+#endif
+
 int pa_mainloop_poll(pa_mainloop *m) {
     pa_assert(m);
     pa_assert(m->state == STATE_PREPARED);
@@ -866,6 +1149,10 @@ int pa_mainloop_poll(pa_mainloop *m) {
 
     if (m->n_enabled_defer_events )
         m->poll_func_ret = 0;
+#ifdef USE_EPOLL
+    else if (m->epoll_fd >= 0)
+        poll_epoll(m);
+#endif
     else {
         pa_assert(!m->rebuild_pollfds);
 
@@ -923,8 +1210,14 @@ int pa_mainloop_dispatch(pa_mainloop *m) {
         if (m->quit)
             goto quit;
 
-        if (m->poll_func_ret > 0)
-            dispatched += dispatch_pollfds(m);
+        if (m->poll_func_ret > 0) {
+#ifdef USE_EPOLL
+            if (m->n_epoll_events > 0)
+                dispatched += dispatch_epoll(m);
+            else
+#endif
+                dispatched += dispatch_pollfds(m);
+        }
     }
 
     if (m->quit)
@@ -23,26 +23,132 @@
 #include <config.h>
 #endif
 
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 
 #include <pulse/xmalloc.h>
 #include <pulse/utf8.h>
 
-#include <pulsecore/hashmap.h>
+#include <pulsecore/idxset.h>
+#include <pulsecore/refcnt.h>
 #include <pulsecore/strbuf.h>
 #include <pulsecore/core-util.h>
 
 #include "proplist.h"
 
+/* A property never changes once it has been created, setting a key
+ * replaces it. That way properties can be shared between any number
+ * of lists. The value follows the struct in the same allocation,
+ * followed by the key unless it is one of the well-known keys. */
 struct property {
-    char *key;
-    void *value;
+    PA_REFCNT_DECLARE;
+    const char *key;
     size_t nbytes;
 };
 
-#define MAKE_HASHMAP(p) ((pa_hashmap*) (p))
-#define MAKE_PROPLIST(p) ((pa_proplist*) (p))
+#define PROPERTY_VALUE(prop) ((uint8_t*) (prop) + PA_ALIGN(sizeof(struct property)))
+
+struct entry {
+    unsigned hash;
+    struct property *prop;
+};
+
+/* Property lists are small, usually a few dozen entries, so they are
+ * kept in an array in insertion order and searched by hash. The array
+ * is shared between copies of a list and only copied when one of them
+ * is modified. */
+struct proplist_data {
+    PA_REFCNT_DECLARE;
+    unsigned n_entries, n_allocated;
+    struct entry entries[];
+};
+
+struct pa_proplist {
+    /* NULL while the list is empty */
+    struct proplist_data *data;
+};
+
+/* Must be sorted, it is searched with bsearch() */
+static const char * const well_known_keys[] = {
+    PA_PROP_APPLICATION_ICON,
+    PA_PROP_APPLICATION_ICON_NAME,
+    PA_PROP_APPLICATION_ID,
+    PA_PROP_APPLICATION_LANGUAGE,
+    PA_PROP_APPLICATION_NAME,
+    PA_PROP_APPLICATION_PROCESS_BINARY,
+    PA_PROP_APPLICATION_PROCESS_HOST,
+    PA_PROP_APPLICATION_PROCESS_ID,
+    PA_PROP_APPLICATION_PROCESS_MACHINE_ID,
+    PA_PROP_APPLICATION_PROCESS_SESSION_ID,
+    PA_PROP_APPLICATION_PROCESS_USER,
+    PA_PROP_APPLICATION_VERSION,
+    PA_PROP_DEVICE_ACCESS_MODE,
+    PA_PROP_DEVICE_API,
+    PA_PROP_DEVICE_BUFFERING_BUFFER_SIZE,
+    PA_PROP_DEVICE_BUFFERING_FRAGMENT_SIZE,
+    PA_PROP_DEVICE_BUS,
+    PA_PROP_DEVICE_BUS_PATH,
+    PA_PROP_DEVICE_CLASS,
+    PA_PROP_DEVICE_DESCRIPTION,
+    PA_PROP_DEVICE_FORM_FACTOR,
+    PA_PROP_DEVICE_ICON,
+    PA_PROP_DEVICE_ICON_NAME,
+    PA_PROP_DEVICE_INTENDED_ROLES,
+    PA_PROP_DEVICE_MASTER_DEVICE,
+    PA_PROP_DEVICE_PRODUCT_ID,
+    PA_PROP_DEVICE_PRODUCT_NAME,
+    PA_PROP_DEVICE_PROFILE_DESCRIPTION,
+    PA_PROP_DEVICE_PROFILE_NAME,
+    PA_PROP_DEVICE_SERIAL,
+    PA_PROP_DEVICE_STRING,
+    PA_PROP_DEVICE_VENDOR_ID,
+    PA_PROP_DEVICE_VENDOR_NAME,
+    PA_PROP_EVENT_DESCRIPTION,
+    PA_PROP_EVENT_ID,
+    PA_PROP_EVENT_MOUSE_BUTTON,
+    PA_PROP_EVENT_MOUSE_HPOS,
+    PA_PROP_EVENT_MOUSE_VPOS,
+    PA_PROP_EVENT_MOUSE_X,
+    PA_PROP_EVENT_MOUSE_Y,
+    PA_PROP_FILTER_APPLY,
+    PA_PROP_FILTER_SUPPRESS,
+    PA_PROP_FILTER_WANT,
+    PA_PROP_FORMAT_CHANNEL_MAP,
+    PA_PROP_FORMAT_CHANNELS,
+    PA_PROP_FORMAT_RATE,
+    PA_PROP_FORMAT_SAMPLE_FORMAT,
+    PA_PROP_MEDIA_ARTIST,
+    PA_PROP_MEDIA_COPYRIGHT,
+    PA_PROP_MEDIA_FILENAME,
+    PA_PROP_MEDIA_ICON,
+    PA_PROP_MEDIA_ICON_NAME,
+    PA_PROP_MEDIA_LANGUAGE,
+    PA_PROP_MEDIA_NAME,
+    PA_PROP_MEDIA_POLICY,
+    PA_PROP_MEDIA_ROLE,
+    PA_PROP_MEDIA_SOFTWARE,
+    PA_PROP_MEDIA_TITLE,
+    PA_PROP_MODULE_AUTHOR,
+    PA_PROP_MODULE_DESCRIPTION,
+    PA_PROP_MODULE_USAGE,
+    PA_PROP_MODULE_VERSION,
+    PA_PROP_WINDOW_DESKTOP,
+    PA_PROP_WINDOW_HEIGHT,
+    PA_PROP_WINDOW_HPOS,
+    PA_PROP_WINDOW_ICON,
+    PA_PROP_WINDOW_ICON_NAME,
+    PA_PROP_WINDOW_ID,
+    PA_PROP_WINDOW_NAME,
+    PA_PROP_WINDOW_VPOS,
+    PA_PROP_WINDOW_WIDTH,
+    PA_PROP_WINDOW_X,
+    PA_PROP_WINDOW_X11_DISPLAY,
+    PA_PROP_WINDOW_X11_MONITOR,
+    PA_PROP_WINDOW_X11_SCREEN,
+    PA_PROP_WINDOW_X11_XID,
+    PA_PROP_WINDOW_Y,
+};
 
 static pa_bool_t property_name_valid(const char *key) {
 
@@ -55,30 +161,176 @@ static pa_bool_t property_name_valid(const char *key) {
     return TRUE;
 }
 
-static void property_free(struct property *prop) {
+static int key_compare(const void *a, const void *b) {
+    return strcmp(a, *(const char * const *) b);
+}
+
+static const char *intern_key(const char *key) {
+    const char * const *k;
+
+    if (!(k = bsearch(key, well_known_keys, PA_ELEMENTSOF(well_known_keys), sizeof(well_known_keys[0]), key_compare)))
+        return NULL;
+
+    return *k;
+}
+
+static struct property *property_new(const char *key, const void *data, size_t nbytes) {
+    struct property *prop;
+    const char *k;
+    size_t l;
+
+    l = (k = intern_key(key)) ? 0 : strlen(key) + 1;
+
+    prop = pa_xmalloc(PA_ALIGN(sizeof(struct property)) + nbytes + 1 + l);
+    PA_REFCNT_INIT(prop);
+    prop->nbytes = nbytes;
+
+    if (nbytes > 0)
+        memcpy(PROPERTY_VALUE(prop), data, nbytes);
+    PROPERTY_VALUE(prop)[nbytes] = 0;
+
+    if (!k) {
+        char *c = (char*) PROPERTY_VALUE(prop) + nbytes + 1;
+
+        memcpy(c, key, l);
+        k = c;
+    }
+
+    prop->key = k;
+
+    return prop;
+}
+
+static struct property *property_ref(struct property *prop) {
+    pa_assert(prop);
+    pa_assert(PA_REFCNT_VALUE(prop) >= 1);
+
+    PA_REFCNT_INC(prop);
+    return prop;
+}
+
+static void property_unref(struct property *prop) {
     pa_assert(prop);
+    pa_assert(PA_REFCNT_VALUE(prop) >= 1);
+
+    if (PA_REFCNT_DEC(prop) <= 0)
+        pa_xfree(prop);
+}
+
+static void data_unref(struct proplist_data *d) {
+    unsigned i;
+
+    pa_assert(d);
+    pa_assert(PA_REFCNT_VALUE(d) >= 1);
+
+    if (PA_REFCNT_DEC(d) > 0)
+        return;
+
+    for (i = 0; i < d->n_entries; i++)
+        property_unref(d->entries[i].prop);
+
+    pa_xfree(d);
+}
+
+static int data_find(const struct proplist_data *d, const char *key, unsigned hash) {
+    unsigned i;
+
+    if (!d)
+        return -1;
+
+    for (i = 0; i < d->n_entries; i++)
+        if (d->entries[i].hash == hash &&
+            (d->entries[i].prop->key == key || pa_streq(d->entries[i].prop->key, key)))
+            return (int) i;
+
+    return -1;
+}
+
+static struct property *property_get(const pa_proplist *p, const char *key) {
+    int i;
+
+    if ((i = data_find(p->data, key, pa_idxset_string_hash_func(key))) < 0)
+        return NULL;
+
+    return p->data->entries[i].prop;
+}
+
+/* Makes sure p has a data array of its own, with room for n_extra
+ * more entries */
+static struct proplist_data *make_writable(pa_proplist *p, unsigned n_extra) {
+    struct proplist_data *d;
+    unsigned i, n_entries, n_allocated;
+
+    n_entries = p->data ? p->data->n_entries : 0;
+
+    if (p->data && PA_REFCNT_VALUE(p->data) == 1) {
+
+        if (n_entries + n_extra <= p->data->n_allocated)
+            return p->data;
+
+        n_allocated = PA_MAX(p->data->n_allocated * 2, n_entries + n_extra);
+        p->data = pa_xrealloc(p->data, sizeof(struct proplist_data) + n_allocated * sizeof(struct entry));
+        p->data->n_allocated = n_allocated;
+
+        return p->data;
+    }
+
+    n_allocated = PA_MAX(8U, n_entries + n_extra);
+    d = pa_xmalloc(sizeof(struct proplist_data) + n_allocated * sizeof(struct entry));
+    PA_REFCNT_INIT(d);
+    d->n_entries = n_entries;
+    d->n_allocated = n_allocated;
+
+    if (p->data) {
+        /* The properties themselves are shared */
+        for (i = 0; i < n_entries; i++) {
+            d->entries[i] = p->data->entries[i];
+            property_ref(d->entries[i].prop);
+        }
+
+        data_unref(p->data);
+    }
+
+    p->data = d;
 
-    pa_xfree(prop->key);
-    pa_xfree(prop->value);
-    pa_xfree(prop);
+    return d;
+}
+
+/* Takes over the reference to prop */
+static void put_property(pa_proplist *p, struct property *prop, unsigned hash) {
+    struct proplist_data *d;
+    int i;
+
+    d = make_writable(p, 1);
+
+    if ((i = data_find(d, prop->key, hash)) >= 0) {
+        property_unref(d->entries[i].prop);
+        d->entries[i].prop = prop;
+        return;
+    }
+
+    d->entries[d->n_entries].hash = hash;
+    d->entries[d->n_entries].prop = prop;
+    d->n_entries++;
+}
+
+static void set_property(pa_proplist *p, const char *key, const void *data, size_t nbytes) {
+    put_property(p, property_new(key, data, nbytes), pa_idxset_string_hash_func(key));
 }
 
 pa_proplist* pa_proplist_new(void) {
-    return MAKE_PROPLIST(pa_hashmap_new(pa_idxset_string_hash_func, pa_idxset_string_compare_func));
+    return pa_xnew0(pa_proplist, 1);
 }
 
 void pa_proplist_free(pa_proplist* p) {
     pa_assert(p);
 
     pa_proplist_clear(p);
-    pa_hashmap_free(MAKE_HASHMAP(p), NULL, NULL);
+    pa_xfree(p);
 }
 
 /** Will accept only valid UTF-8 */
 int pa_proplist_sets(pa_proplist *p, const char *key, const char *value) {
-    struct property *prop;
-    pa_bool_t add = FALSE;
-
     pa_assert(p);
     pa_assert(key);
     pa_assert(value);
@@ -86,26 +338,12 @@ int pa_proplist_sets(pa_proplist *p, const char *key, const char *value) {
     if (!property_name_valid(key) || !pa_utf8_valid(value))
         return -1;
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), key))) {
-        prop = pa_xnew(struct property, 1);
-        prop->key = pa_xstrdup(key);
-        add = TRUE;
-    } else
-        pa_xfree(prop->value);
-
-    prop->value = pa_xstrdup(value);
-    prop->nbytes = strlen(value)+1;
-
-    if (add)
-        pa_hashmap_put(MAKE_HASHMAP(p), prop->key, prop);
-
+    set_property(p, key, value, strlen(value)+1);
     return 0;
 }
 
 /** Will accept only valid UTF-8 */
 static int proplist_setn(pa_proplist *p, const char *key, size_t key_length, const char *value, size_t value_length) {
-    struct property *prop;
-    pa_bool_t add = FALSE;
     char *k, *v;
 
     pa_assert(p);
@@ -121,20 +359,10 @@ static int proplist_setn(pa_proplist *p, const char *key, size_t key_length, con
         return -1;
     }
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), k))) {
-        prop = pa_xnew(struct property, 1);
-        prop->key = k;
-        add = TRUE;
-    } else {
-        pa_xfree(prop->value);
-        pa_xfree(k);
-    }
-
-    prop->value = v;
-    prop->nbytes = strlen(v)+1;
+    set_property(p, k, v, strlen(v)+1);
 
-    if (add)
-        pa_hashmap_put(MAKE_HASHMAP(p), prop->key, prop);
+    pa_xfree(k);
+    pa_xfree(v);
 
     return 0;
 }
@@ -155,8 +383,6 @@ int pa_proplist_setp(pa_proplist *p, const char *pair) {
 }
 
 static int proplist_sethex(pa_proplist *p, const char *key, size_t key_length, const char *value, size_t value_length) {
-    struct property *prop;
-    pa_bool_t add = FALSE;
     char *k, *v;
     uint8_t *d;
     size_t dn;
@@ -184,29 +410,16 @@ static int proplist_sethex(pa_proplist *p, const char *key, size_t key_length, c
 
     pa_xfree(v);
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), k))) {
-        prop = pa_xnew(struct property, 1);
-        prop->key = k;
-        add = TRUE;
-    } else {
-        pa_xfree(prop->value);
-        pa_xfree(k);
-    }
-
-    d[dn] = 0;
-    prop->value = d;
-    prop->nbytes = dn;
+    set_property(p, k, d, dn);
 
-    if (add)
-        pa_hashmap_put(MAKE_HASHMAP(p), prop->key, prop);
+    pa_xfree(k);
+    pa_xfree(d);
 
     return 0;
 }
 
 /** Will accept only valid UTF-8 */
 int pa_proplist_setf(pa_proplist *p, const char *key, const char *format, ...) {
-    struct property *prop;
-    pa_bool_t add = FALSE;
     va_list ap;
     char *v;
 
@@ -224,19 +437,9 @@ int pa_proplist_setf(pa_proplist *p, const char *key, const char *format, ...) {
     if (!pa_utf8_valid(v))
         goto fail;
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), key))) {
-        prop = pa_xnew(struct property, 1);
-        prop->key = pa_xstrdup(key);
-        add = TRUE;
-    } else
-        pa_xfree(prop->value);
-
-    prop->value = v;
-    prop->nbytes = strlen(v)+1;
-
-    if (add)
-        pa_hashmap_put(MAKE_HASHMAP(p), prop->key, prop);
+    set_property(p, key, v, strlen(v)+1);
 
+    pa_xfree(v);
     return 0;
 
 fail:
@@ -245,9 +448,6 @@ fail:
 }
 
 int pa_proplist_set(pa_proplist *p, const char *key, const void *data, size_t nbytes) {
-    struct property *prop;
-    pa_bool_t add = FALSE;
-
     pa_assert(p);
     pa_assert(key);
     pa_assert(data || nbytes == 0);
@@ -255,27 +455,13 @@ int pa_proplist_set(pa_proplist *p, const char *key, const void *data, size_t nb
     if (!property_name_valid(key))
         return -1;
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), key))) {
-        prop = pa_xnew(struct property, 1);
-        prop->key = pa_xstrdup(key);
-        add = TRUE;
-    } else
-        pa_xfree(prop->value);
-
-    prop->value = pa_xmalloc(nbytes+1);
-    if (nbytes > 0)
-        memcpy(prop->value, data, nbytes);
-    ((char*) prop->value)[nbytes] = 0;
-    prop->nbytes = nbytes;
-
-    if (add)
-        pa_hashmap_put(MAKE_HASHMAP(p), prop->key, prop);
-
+    set_property(p, key, data, nbytes);
     return 0;
 }
 
 const char *pa_proplist_gets(pa_proplist *p, const char *key) {
     struct property *prop;
+    const char *v;
 
     pa_assert(p);
     pa_assert(key);
@@ -283,22 +469,24 @@ const char *pa_proplist_gets(pa_proplist *p, const char *key) {
     if (!property_name_valid(key))
         return NULL;
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), key)))
+    if (!(prop = property_get(p, key)))
         return NULL;
 
     if (prop->nbytes <= 0)
         return NULL;
 
-    if (((char*) prop->value)[prop->nbytes-1] != 0)
+    v = (const char*) PROPERTY_VALUE(prop);
+
+    if (v[prop->nbytes-1] != 0)
         return NULL;
 
-    if (strlen((char*) prop->value) != prop->nbytes-1)
+    if (strlen(v) != prop->nbytes-1)
         return NULL;
 
-    if (!pa_utf8_valid((char*) prop->value))
+    if (!pa_utf8_valid(v))
         return NULL;
 
-    return (char*) prop->value;
+    return v;
 }
 
 int pa_proplist_get(pa_proplist *p, const char *key, const void **data, size_t *nbytes) {
@@ -312,39 +500,56 @@ int pa_proplist_get(pa_proplist *p, const char *key, const void **data, size_t *
     if (!property_name_valid(key))
         return -1;
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), key)))
+    if (!(prop = property_get(p, key)))
         return -1;
 
-    *data = prop->value;
+    *data = PROPERTY_VALUE(prop);
     *nbytes = prop->nbytes;
 
     return 0;
 }
 
 void pa_proplist_update(pa_proplist *p, pa_update_mode_t mode, const pa_proplist *other) {
-    struct property *prop;
-    void *state = NULL;
+    struct proplist_data *d;
+    unsigned i;
 
     pa_assert(p);
     pa_assert(mode == PA_UPDATE_SET || mode == PA_UPDATE_MERGE || mode == PA_UPDATE_REPLACE);
     pa_assert(other);
 
-    if (mode == PA_UPDATE_SET)
+    if ((d = other->data) == p->data)
+        return;
+
+    if (!d) {
+        if (mode == PA_UPDATE_SET)
+            pa_proplist_clear(p);
+
+        return;
+    }
+
+    /* If p ends up with exactly what other has, just share the data */
+    if (mode == PA_UPDATE_SET || !p->data || p->data->n_entries == 0) {
+        PA_REFCNT_INC(d);
         pa_proplist_clear(p);
+        p->data = d;
+        return;
+    }
+
+    make_writable(p, d->n_entries);
 
-    /* MAKE_HASHMAP turns the const pointer into a non-const pointer, but
-     * that's ok, because we don't modify the hashmap contents. */
-    while ((prop = pa_hashmap_iterate(MAKE_HASHMAP(other), &state, NULL))) {
+    for (i = 0; i < d->n_entries; i++) {
 
-        if (mode == PA_UPDATE_MERGE && pa_proplist_contains(p, prop->key))
+        if (mode == PA_UPDATE_MERGE && data_find(p->data, d->entries[i].prop->key, d->entries[i].hash) >= 0)
             continue;
 
-        pa_assert_se(pa_proplist_set(p, prop->key, prop->value, prop->nbytes) == 0);
+        put_property(p, property_ref(d->entries[i].prop), d->entries[i].hash);
     }
 }
 
 int pa_proplist_unset(pa_proplist *p, const char *key) {
-    struct property *prop;
+    struct proplist_data *d;
+    unsigned hash;
+    int i;
 
     pa_assert(p);
     pa_assert(key);
@@ -352,10 +557,18 @@ int pa_proplist_unset(pa_proplist *p, const char *key) {
     if (!property_name_valid(key))
         return -1;
 
-    if (!(prop = pa_hashmap_remove(MAKE_HASHMAP(p), key)))
+    hash = pa_idxset_string_hash_func(key);
+
+    if (data_find(p->data, key, hash) < 0)
         return -2;
 
-    property_free(prop);
+    d = make_writable(p, 0);
+    pa_assert_se((i = data_find(d, key, hash)) >= 0);
+
+    property_unref(d->entries[i].prop);
+    memmove(d->entries + i, d->entries + i + 1, (d->n_entries - (unsigned) i - 1) * sizeof(struct entry));
+    d->n_entries--;
+
     return 0;
 }
 
@@ -378,12 +591,29 @@ int pa_proplist_unset_many(pa_proplist *p, const char * const keys[]) {
 }
 
 const char *pa_proplist_iterate(pa_proplist *p, void **state) {
-    struct property *prop;
+    unsigned i;
+
+    pa_assert(p);
+    pa_assert(state);
+
+    if (!p->data)
+        return NULL;
+
+    /* The state counts the entries behind the current one, plus one,
+     * so that deleting the current entry doesn't skip the next one */
+    if (!*state)
+        i = 0;
+    else if (PA_PTR_TO_UINT(*state) - 1 > p->data->n_entries)
+        return NULL;
+    else
+        i = p->data->n_entries - (PA_PTR_TO_UINT(*state) - 1);
 
-    if (!(prop = pa_hashmap_iterate(MAKE_HASHMAP(p), state, NULL)))
+    if (i >= p->data->n_entries)
         return NULL;
 
-    return prop->key;
+    *state = PA_UINT_TO_PTR(p->data->n_entries - i);
+
+    return p->data->entries[i].prop->key;
 }
 
 char *pa_proplist_to_string_sep(pa_proplist *p, const char *sep) {
@@ -632,7 +862,7 @@ pa_proplist *pa_proplist_from_string(const char *s) {
     }
 
 success:
-    return MAKE_PROPLIST(pl);
+    return pl;
 
 fail:
     pa_proplist_free(pl);
@@ -646,18 +876,19 @@ int pa_proplist_contains(pa_proplist *p, const char *key) {
     if (!property_name_valid(key))
         return -1;
 
-    if (!(pa_hashmap_get(MAKE_HASHMAP(p), key)))
+    if (!property_get(p, key))
         return 0;
 
     return 1;
 }
 
 void pa_proplist_clear(pa_proplist *p) {
-    struct property *prop;
     pa_assert(p);
 
-    while ((prop = pa_hashmap_steal_first(MAKE_HASHMAP(p))))
-        property_free(prop);
+    if (p->data) {
+        data_unref(p->data);
+        p->data = NULL;
+    }
 }
 
 pa_proplist* pa_proplist_copy(const pa_proplist *p) {
@@ -665,8 +896,10 @@ pa_proplist* pa_proplist_copy(const pa_proplist *p) {
 
     pa_assert_se(copy = pa_proplist_new());
 
-    if (p)
-        pa_proplist_update(copy, PA_UPDATE_REPLACE, p);
+    if (p && p->data) {
+        PA_REFCNT_INC(p->data);
+        copy->data = p->data;
+    }
 
     return copy;
 }
@@ -674,38 +907,46 @@ pa_proplist* pa_proplist_copy(const pa_proplist *p) {
 unsigned pa_proplist_size(pa_proplist *p) {
     pa_assert(p);
 
-    return pa_hashmap_size(MAKE_HASHMAP(p));
+    return p->data ? p->data->n_entries : 0;
 }
 
 int pa_proplist_isempty(pa_proplist *p) {
     pa_assert(p);
 
-    return pa_hashmap_isempty(MAKE_HASHMAP(p));
+    return pa_proplist_size(p) == 0;
 }
 
 int pa_proplist_equal(pa_proplist *a, pa_proplist *b) {
-    const void *key = NULL;
-    struct property *a_prop = NULL;
-    struct property *b_prop = NULL;
-    void *state = NULL;
+    unsigned i;
 
     pa_assert(a);
     pa_assert(b);
 
-    if (a == b)
+    if (a == b || a->data == b->data)
         return 1;
 
     if (pa_proplist_size(a) != pa_proplist_size(b))
         return 0;
 
-    while ((a_prop = pa_hashmap_iterate(MAKE_HASHMAP(a), &state, &key))) {
-        if (!(b_prop = pa_hashmap_get(MAKE_HASHMAP(b), key)))
+    if (!a->data)
+        return 1;
+
+    for (i = 0; i < a->data->n_entries; i++) {
+        struct property *a_prop = a->data->entries[i].prop, *b_prop;
+        int j;
+
+        if ((j = data_find(b->data, a_prop->key, a->data->entries[i].hash)) < 0)
             return 0;
 
+        b_prop = b->data->entries[j].prop;
+
+        if (a_prop == b_prop)
+            continue;
+
         if (a_prop->nbytes != b_prop->nbytes)
             return 0;
 
-        if (memcmp(a_prop->value, b_prop->value, a_prop->nbytes) != 0)
+        if (memcmp(PROPERTY_VALUE(a_prop), PROPERTY_VALUE(b_prop), a_prop->nbytes) != 0)
             return 0;
     }
 
@@ -25,9 +25,11 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <pulse/utf8.h>
 #include <pulse/fork-detect.h>
+#include <pulse/xmalloc.h>
 
 #include <pulsecore/pstream-util.h>
 #include <pulsecore/macro.h>
@@ -273,3 +275,243 @@ pa_operation* pa_context_remove_sample(pa_context *c, const char *name, pa_conte
 
     return o;
 }
+
+struct upload_sample {
+    char *name;
+    pa_sample_spec sample_spec;
+    pa_channel_map channel_map;
+    pa_proplist *proplist;
+    uint32_t length;
+};
+
+/* The data of all samples is sent on one upload stream. Once that is
+ * ready the data goes out in blocks from the mempool (so on SHM if
+ * that is used) and the finish command tells the server where each
+ * sample lies in it. */
+struct upload_samples {
+    pa_operation *operation;
+    pa_stream *stream;
+
+    struct upload_sample *samples;
+    unsigned n_samples;
+
+    pa_memchunk *chunks;
+    unsigned n_chunks;
+};
+
+static void upload_samples_free(struct upload_samples *u) {
+    unsigned i;
+
+    pa_assert(u);
+
+    if (u->operation) {
+        pa_operation_cancel(u->operation);
+        pa_operation_unref(u->operation);
+    }
+
+    if (u->stream) {
+        pa_stream_set_state_callback(u->stream, NULL, NULL);
+        pa_stream_unref(u->stream);
+    }
+
+    for (i = 0; i < u->n_samples; i++) {
+        pa_xfree(u->samples[i].name);
+
+        if (u->samples[i].proplist)
+            pa_proplist_free(u->samples[i].proplist);
+    }
+
+    for (i = 0; i < u->n_chunks; i++)
+        if (u->chunks[i].memblock)
+            pa_memblock_unref(u->chunks[i].memblock);
+
+    pa_xfree(u->samples);
+    pa_xfree(u->chunks);
+    pa_xfree(u);
+}
+
+static void upload_samples_done(struct upload_samples *u, int success) {
+    pa_operation *o = u->operation;
+
+    if (o->callback && o->context && o->context->state == PA_CONTEXT_READY) {
+        pa_context_success_cb_t cb = (pa_context_success_cb_t) o->callback;
+        cb(o->context, success, o->userdata);
+    }
+
+    pa_operation_done(o);
+}
+
+static void upload_samples_reply_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    struct upload_samples *u = userdata;
+    pa_context *c;
+    int success = 1;
+
+    pa_assert(pd);
+    pa_assert(u);
+
+    c = u->stream->context;
+
+    if (command != PA_COMMAND_REPLY) {
+        if (pa_context_handle_error(c, command, t, FALSE) < 0)
+            goto finish;
+
+        success = 0;
+    } else if (!pa_tagstruct_eof(t)) {
+        pa_context_fail(c, PA_ERR_PROTOCOL);
+        goto finish;
+    }
+
+    /* The server is done with the stream either way */
+    pa_stream_set_state(u->stream, success ? PA_STREAM_TERMINATED : PA_STREAM_FAILED);
+    upload_samples_done(u, success);
+
+finish:
+    upload_samples_free(u);
+}
+
+static void upload_samples_stream_state_callback(pa_stream *s, void *userdata) {
+    struct upload_samples *u = userdata;
+    pa_context *c = s->context;
+    pa_tagstruct *t;
+    uint32_t tag;
+    unsigned i;
+
+    pa_assert(u);
+    pa_assert(u->stream == s);
+
+    switch (pa_stream_get_state(s)) {
+
+        case PA_STREAM_READY:
+            /* From here on the reply owns u */
+            pa_stream_set_state_callback(s, NULL, NULL);
+
+            for (i = 0; i < u->n_chunks; i++) {
+                pa_pstream_send_memblock(c->pstream, s->channel, 0, PA_SEEK_RELATIVE, &u->chunks[i]);
+                pa_memblock_unref(u->chunks[i].memblock);
+                pa_memchunk_reset(&u->chunks[i]);
+            }
+
+            t = pa_tagstruct_command(c, PA_COMMAND_FINISH_UPLOAD_SAMPLES, &tag);
+            pa_tagstruct_putu32(t, s->channel);
+            pa_tagstruct_putu32(t, u->n_samples);
+
+            for (i = 0; i < u->n_samples; i++) {
+                pa_tagstruct_puts(t, u->samples[i].name);
+                pa_tagstruct_put_sample_spec(t, &u->samples[i].sample_spec);
+                pa_tagstruct_put_channel_map(t, &u->samples[i].channel_map);
+                pa_tagstruct_put_proplist(t, u->samples[i].proplist);
+                pa_tagstruct_putu32(t, u->samples[i].length);
+            }
+
+            pa_pstream_send_tagstruct(c->pstream, t);
+            pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, upload_samples_reply_callback, u, (pa_free_cb_t) upload_samples_free);
+            break;
+
+        case PA_STREAM_FAILED:
+        case PA_STREAM_TERMINATED:
+            upload_samples_done(u, 0);
+            upload_samples_free(u);
+            break;
+
+        default:
+            break;
+    }
+}
+
+pa_operation* pa_context_upload_samples(pa_context *c, const pa_sample_upload *samples, unsigned n, pa_context_success_cb_t cb, void *userdata) {
+    static const pa_sample_spec carrier_spec = { .format = PA_SAMPLE_U8, .rate = 8000, .channels = 1 };
+    struct upload_samples *u;
+    pa_operation *o;
+    size_t total = 0, block_size, left;
+    unsigned i;
+
+    pa_assert(c);
+    pa_assert(PA_REFCNT_VALUE(c) >= 1);
+
+    PA_CHECK_VALIDITY_RETURN_NULL(c, !pa_detect_fork(), PA_ERR_FORKED);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->state == PA_CONTEXT_READY, PA_ERR_BADSTATE);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->version >= 33, PA_ERR_NOTSUPPORTED);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, samples && n > 0, PA_ERR_INVALID);
+
+    for (i = 0; i < n; i++) {
+        const pa_sample_upload *e = samples + i;
+
+        PA_CHECK_VALIDITY_RETURN_NULL(c, e->name && *e->name && pa_utf8_valid(e->name), PA_ERR_INVALID);
+        PA_CHECK_VALIDITY_RETURN_NULL(c, e->ss && pa_sample_spec_valid(e->ss), PA_ERR_INVALID);
+        PA_CHECK_VALIDITY_RETURN_NULL(c, !e->map || (pa_channel_map_valid(e->map) && pa_channel_map_compatible(e->map, e->ss)), PA_ERR_INVALID);
+        PA_CHECK_VALIDITY_RETURN_NULL(c, e->data && e->length > 0 && e->length % pa_frame_size(e->ss) == 0, PA_ERR_INVALID);
+
+        total += e->length;
+        PA_CHECK_VALIDITY_RETURN_NULL(c, total >= e->length && total == (size_t) (uint32_t) total, PA_ERR_TOOLARGE);
+    }
+
+    u = pa_xnew0(struct upload_samples, 1);
+    u->samples = pa_xnew0(struct upload_sample, n);
+    u->n_samples = n;
+
+    for (i = 0; i < n; i++) {
+        const pa_sample_upload *e = samples + i;
+
+        u->samples[i].name = pa_xstrdup(e->name);
+        u->samples[i].sample_spec = *e->ss;
+
+        if (e->map)
+            u->samples[i].channel_map = *e->map;
+        else
+            pa_channel_map_init_extend(&u->samples[i].channel_map, e->ss->channels, PA_CHANNEL_MAP_DEFAULT);
+
+        u->samples[i].proplist = e->proplist ? pa_proplist_copy(e->proplist) : pa_proplist_new();
+        u->samples[i].length = (uint32_t) e->length;
+    }
+
+    /* Copy everything into as few blocks as possible right away, so
+     * that the caller may free the data as soon as we return */
+    block_size = pa_mempool_block_size_max(c->mempool);
+    u->chunks = pa_xnew0(pa_memchunk, (total + block_size - 1) / block_size);
+
+    for (i = 0, left = total; i < n; i++) {
+        const uint8_t *src = samples[i].data;
+        size_t l = samples[i].length;
+
+        while (l > 0) {
+            pa_memchunk *chunk;
+            size_t m;
+            void *d;
+
+            if (u->n_chunks == 0 ||
+                u->chunks[u->n_chunks - 1].length >= pa_memblock_get_length(u->chunks[u->n_chunks - 1].memblock))
+                u->chunks[u->n_chunks++].memblock = pa_memblock_new(c->mempool, PA_MIN(block_size, left));
+
+            chunk = &u->chunks[u->n_chunks - 1];
+
+            m = PA_MIN(l, pa_memblock_get_length(chunk->memblock) - chunk->length);
+
+            d = pa_memblock_acquire(chunk->memblock);
+            memcpy((uint8_t*) d + chunk->length, src, m);
+            pa_memblock_release(chunk->memblock);
+
+            chunk->length += m;
+            src += m;
+            l -= m;
+            left -= m;
+        }
+    }
+
+    o = pa_operation_new(c, NULL, (pa_operation_cb_t) cb, userdata);
+    u->operation = pa_operation_ref(o);
+
+    if (!(u->stream = pa_stream_new(c, "sample-upload", &carrier_spec, NULL)) ||
+        pa_stream_connect_upload(u->stream, total) < 0) {
+
+        if (u->stream)
+            pa_stream_set_state(u->stream, PA_STREAM_FAILED);
+
+        upload_samples_free(u);
+        pa_operation_unref(o);
+        return NULL;
+    }
+
+    pa_stream_set_state_callback(u->stream, upload_samples_stream_state_callback, u);
+
+    return o;
+}
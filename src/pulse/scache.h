@@ -49,6 +49,10 @@
  * will receive the same name as the stream. If the upload should be aborted,
  * simply call pa_stream_disconnect().
  *
+ * Many samples are better uploaded at once with
+ * pa_context_upload_samples(), which takes two round trips to the server
+ * no matter how many samples there are, instead of three for each.
+ *
  * \section play_sec Playing samples
  *
  * To play back a sample, simply call pa_context_play_sample():
@@ -86,6 +90,16 @@ PA_C_DECL_BEGIN
  * PA_INVALID_INDEX on failure. \since 0.9.11 */
 typedef void (*pa_context_play_sample_cb_t)(pa_context *c, uint32_t idx, void *userdata);
 
+/** One sample for pa_context_upload_samples(). \since 3.0 */
+typedef struct pa_sample_upload {
+    const char *name;             /**< Name of the sample */
+    const pa_sample_spec *ss;     /**< Sample spec of the data */
+    const pa_channel_map *map;    /**< Channel map of the data, or NULL for the default one */
+    pa_proplist *proplist;        /**< Properties of the sample, or NULL */
+    const void *data;             /**< The data, a whole number of frames */
+    size_t length;                /**< Length of the data in bytes */
+} pa_sample_upload;
+
 /** Make this stream a sample upload stream */
 int pa_stream_connect_upload(pa_stream *s, size_t length);
 
@@ -94,6 +108,14 @@ int pa_stream_connect_upload(pa_stream *s, size_t length);
  * pa_stream_disconnect() */
 int pa_stream_finish_upload(pa_stream *s);
 
+/** Upload n samples to the sample cache in one go. The data of all of
+ * them is sent on a single upload stream, so the total is limited to
+ * what one sample may take on the server. Everything is copied before
+ * this returns. The callback is called once, with success being 0 if
+ * any sample could not be stored. Requires a server with protocol
+ * version 33 or newer. \since 3.0 */
+pa_operation* pa_context_upload_samples(pa_context *c, const pa_sample_upload *samples, unsigned n, pa_context_success_cb_t cb, void *userdata);
+
 /** Remove a sample from the sample cache. Returns an operation object which may be used to cancel the operation while it is running */
 pa_operation* pa_context_remove_sample(pa_context *c, const char *name, pa_context_success_cb_t cb, void *userdata);
 
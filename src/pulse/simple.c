@@ -41,9 +41,11 @@
 
 struct pa_simple {
     pa_threaded_mainloop *mainloop;
+    pa_mainloop *direct_mainloop; /* Instead of mainloop, run from the caller's thread */
     pa_context *context;
     pa_stream *stream;
     pa_stream_direction_t direction;
+    pa_bool_t ring;
 
     const void *read_data;
     size_t read_index, read_length;
@@ -84,6 +86,42 @@ struct pa_simple {
         }                                                               \
     } while(FALSE);
 
+static void simple_lock(pa_simple *p) {
+    if (p->mainloop)
+        pa_threaded_mainloop_lock(p->mainloop);
+}
+
+static void simple_unlock(pa_simple *p) {
+    if (p->mainloop)
+        pa_threaded_mainloop_unlock(p->mainloop);
+}
+
+static void simple_signal(pa_simple *p) {
+    if (p->mainloop)
+        pa_threaded_mainloop_signal(p->mainloop, 0);
+}
+
+/* Waits for the next callback, or in the unthreaded case runs the
+ * main loop until something happened. If that fails the context is
+ * disconnected, so that the callers see it dead instead of spinning. */
+static void simple_wait(pa_simple *p) {
+    if (p->mainloop)
+        pa_threaded_mainloop_wait(p->mainloop);
+    else if (pa_mainloop_iterate(p->direct_mainloop, 1, NULL) < 0)
+        pa_context_disconnect(p->context);
+}
+
+/* Like simple_wait(), but returns after timeout at the latest. Only
+ * for the unthreaded case where there may be nothing to wake us. */
+static void simple_wait_timeout(pa_simple *p, pa_usec_t timeout) {
+    pa_assert(p->direct_mainloop);
+
+    if (pa_mainloop_prepare(p->direct_mainloop, (int) PA_MAX(timeout / PA_USEC_PER_MSEC, 1U)) < 0 ||
+        pa_mainloop_poll(p->direct_mainloop) < 0 ||
+        pa_mainloop_dispatch(p->direct_mainloop) < 0)
+        pa_context_disconnect(p->context);
+}
+
 static void context_state_cb(pa_context *c, void *userdata) {
     pa_simple *p = userdata;
     pa_assert(c);
@@ -93,7 +131,7 @@ static void context_state_cb(pa_context *c, void *userdata) {
         case PA_CONTEXT_READY:
         case PA_CONTEXT_TERMINATED:
         case PA_CONTEXT_FAILED:
-            pa_threaded_mainloop_signal(p->mainloop, 0);
+            simple_signal(p);
             break;
 
         case PA_CONTEXT_UNCONNECTED:
@@ -110,7 +148,7 @@ static void success_context_cb(pa_context *c, int success, void *userdata) {
     pa_assert(p);
 
     p->operation_success = success;
-    pa_threaded_mainloop_signal(p->mainloop, 0);
+    simple_signal(p);
 }
 
 static void stream_state_cb(pa_stream *s, void * userdata) {
@@ -123,7 +161,7 @@ static void stream_state_cb(pa_stream *s, void * userdata) {
         case PA_STREAM_READY:
         case PA_STREAM_FAILED:
         case PA_STREAM_TERMINATED:
-            pa_threaded_mainloop_signal(p->mainloop, 0);
+            simple_signal(p);
             break;
 
         case PA_STREAM_UNCONNECTED:
@@ -136,7 +174,7 @@ static void stream_request_cb(pa_stream *s, size_t length, void *userdata) {
     pa_simple *p = userdata;
     pa_assert(p);
 
-    pa_threaded_mainloop_signal(p->mainloop, 0);
+    simple_signal(p);
 }
 
 static void stream_latency_update_cb(pa_stream *s, void *userdata) {
@@ -144,7 +182,7 @@ static void stream_latency_update_cb(pa_stream *s, void *userdata) {
 
     pa_assert(p);
 
-    pa_threaded_mainloop_signal(p->mainloop, 0);
+    simple_signal(p);
 }
 
 pa_simple* pa_simple_new(
@@ -183,7 +221,7 @@ pa_simple* pa_simple_new(
         goto fail;
     }
 
-    pa_threaded_mainloop_lock(p->mainloop);
+    simple_lock(p);
 
     if (pa_threaded_mainloop_start(p->mainloop) < 0)
         goto unlock_and_fail;
@@ -202,7 +240,7 @@ pa_simple* pa_simple_new(
         }
 
         /* Wait until the context is ready */
-        pa_threaded_mainloop_wait(p->mainloop);
+        simple_wait(p);
     }
 
     if (!(p->stream = pa_stream_new(p->context, stream_name, ss, map))) {
@@ -245,15 +283,15 @@ pa_simple* pa_simple_new(
         }
 
         /* Wait until the stream is ready */
-        pa_threaded_mainloop_wait(p->mainloop);
+        simple_wait(p);
     }
 
-    pa_threaded_mainloop_unlock(p->mainloop);
+    simple_unlock(p);
 
     return p;
 
 unlock_and_fail:
-    pa_threaded_mainloop_unlock(p->mainloop);
+    simple_unlock(p);
 
 fail:
     if (rerror)
@@ -279,6 +317,9 @@ void pa_simple_free(pa_simple *s) {
     if (s->mainloop)
         pa_threaded_mainloop_free(s->mainloop);
 
+    if (s->direct_mainloop)
+        pa_mainloop_free(s->direct_mainloop);
+
     pa_xfree(s);
 }
 
@@ -289,16 +330,43 @@ int pa_simple_write(pa_simple *p, const void*data, size_t length, int *rerror) {
     CHECK_VALIDITY_RETURN_ANY(rerror, data, PA_ERR_INVALID, -1);
     CHECK_VALIDITY_RETURN_ANY(rerror, length > 0, PA_ERR_INVALID, -1);
 
-    pa_threaded_mainloop_lock(p->mainloop);
+    simple_lock(p);
 
     CHECK_DEAD_GOTO(p, rerror, unlock_and_fail);
 
+    if (p->ring) {
+        const pa_buffer_attr *a;
+
+        CHECK_SUCCESS_GOTO(p, rerror, (a = pa_stream_get_buffer_attr(p->stream)), unlock_and_fail);
+
+        while (length > 0) {
+            size_t l;
+
+            l = pa_stream_ring_buffer_write(p->stream, data, length);
+            CHECK_SUCCESS_GOTO(p, rerror, l != (size_t) -1, unlock_and_fail);
+
+            data = (const uint8_t*) data + l;
+            length -= l;
+
+            if (length > 0 && l == 0) {
+                /* The server doesn't tell us when it took something out
+                 * of the ring, so come back when a part of it should
+                 * have been played */
+                simple_wait_timeout(p, pa_bytes_to_usec(PA_MIN(length, a->tlength / 4), &p->stream->sample_spec));
+                CHECK_DEAD_GOTO(p, rerror, unlock_and_fail);
+            }
+        }
+
+        simple_unlock(p);
+        return 0;
+    }
+
     while (length > 0) {
         size_t l;
         int r;
 
         while (!(l = pa_stream_writable_size(p->stream))) {
-            pa_threaded_mainloop_wait(p->mainloop);
+            simple_wait(p);
             CHECK_DEAD_GOTO(p, rerror, unlock_and_fail);
         }
 
@@ -314,11 +382,11 @@ int pa_simple_write(pa_simple *p, const void*data, size_t length, int *rerror) {
         length -= l;
     }
 
-    pa_threaded_mainloop_unlock(p->mainloop);
+    simple_unlock(p);
     return 0;
 
 unlock_and_fail:
-    pa_threaded_mainloop_unlock(p->mainloop);
+    simple_unlock(p);
     return -1;
 }
 
@@ -329,7 +397,7 @@ int pa_simple_read(pa_simple *p, void*data, size_t length, int *rerror) {
     CHECK_VALIDITY_RETURN_ANY(rerror, data, PA_ERR_INVALID, -1);
     CHECK_VALIDITY_RETURN_ANY(rerror, length > 0, PA_ERR_INVALID, -1);
 
-    pa_threaded_mainloop_lock(p->mainloop);
+    simple_lock(p);
 
     CHECK_DEAD_GOTO(p, rerror, unlock_and_fail);
 
@@ -343,7 +411,7 @@ int pa_simple_read(pa_simple *p, void*data, size_t length, int *rerror) {
             CHECK_SUCCESS_GOTO(p, rerror, r == 0, unlock_and_fail);
 
             if (!p->read_data) {
-                pa_threaded_mainloop_wait(p->mainloop);
+                simple_wait(p);
                 CHECK_DEAD_GOTO(p, rerror, unlock_and_fail);
             } else
                 p->read_index = 0;
@@ -370,11 +438,11 @@ int pa_simple_read(pa_simple *p, void*data, size_t length, int *rerror) {
         }
     }
 
-    pa_threaded_mainloop_unlock(p->mainloop);
+    simple_unlock(p);
     return 0;
 
 unlock_and_fail:
-    pa_threaded_mainloop_unlock(p->mainloop);
+    simple_unlock(p);
     return -1;
 }
 
@@ -385,7 +453,7 @@ static void success_cb(pa_stream *s, int success, void *userdata) {
     pa_assert(p);
 
     p->operation_success = success;
-    pa_threaded_mainloop_signal(p->mainloop, 0);
+    simple_signal(p);
 }
 
 int pa_simple_drain(pa_simple *p, int *rerror) {
@@ -395,7 +463,7 @@ int pa_simple_drain(pa_simple *p, int *rerror) {
 
     CHECK_VALIDITY_RETURN_ANY(rerror, p->direction == PA_STREAM_PLAYBACK, PA_ERR_BADSTATE, -1);
 
-    pa_threaded_mainloop_lock(p->mainloop);
+    simple_lock(p);
     CHECK_DEAD_GOTO(p, rerror, unlock_and_fail);
 
     o = pa_stream_drain(p->stream, success_cb, p);
@@ -403,13 +471,13 @@ int pa_simple_drain(pa_simple *p, int *rerror) {
 
     p->operation_success = 0;
     while (pa_operation_get_state(o) == PA_OPERATION_RUNNING) {
-        pa_threaded_mainloop_wait(p->mainloop);
+        simple_wait(p);
         CHECK_DEAD_GOTO(p, rerror, unlock_and_fail);
     }
     CHECK_SUCCESS_GOTO(p, rerror, p->operation_success, unlock_and_fail);
 
     pa_operation_unref(o);
-    pa_threaded_mainloop_unlock(p->mainloop);
+    simple_unlock(p);
 
     return 0;
 
@@ -420,7 +488,7 @@ unlock_and_fail:
         pa_operation_unref(o);
     }
 
-    pa_threaded_mainloop_unlock(p->mainloop);
+    simple_unlock(p);
     return -1;
 }
 
@@ -431,7 +499,7 @@ int pa_simple_flush(pa_simple *p, int *rerror) {
 
     CHECK_VALIDITY_RETURN_ANY(rerror, p->direction == PA_STREAM_PLAYBACK, PA_ERR_BADSTATE, -1);
 
-    pa_threaded_mainloop_lock(p->mainloop);
+    simple_lock(p);
     CHECK_DEAD_GOTO(p, rerror, unlock_and_fail);
 
     o = pa_stream_flush(p->stream, success_cb, p);
@@ -439,13 +507,13 @@ int pa_simple_flush(pa_simple *p, int *rerror) {
 
     p->operation_success = 0;
     while (pa_operation_get_state(o) == PA_OPERATION_RUNNING) {
-        pa_threaded_mainloop_wait(p->mainloop);
+        simple_wait(p);
         CHECK_DEAD_GOTO(p, rerror, unlock_and_fail);
     }
     CHECK_SUCCESS_GOTO(p, rerror, p->operation_success, unlock_and_fail);
 
     pa_operation_unref(o);
-    pa_threaded_mainloop_unlock(p->mainloop);
+    simple_unlock(p);
 
     return 0;
 
@@ -456,7 +524,7 @@ unlock_and_fail:
         pa_operation_unref(o);
     }
 
-    pa_threaded_mainloop_unlock(p->mainloop);
+    simple_unlock(p);
     return -1;
 }
 
@@ -466,7 +534,7 @@ pa_usec_t pa_simple_get_latency(pa_simple *p, int *rerror) {
 
     pa_assert(p);
 
-    pa_threaded_mainloop_lock(p->mainloop);
+    simple_lock(p);
 
     for (;;) {
         CHECK_DEAD_GOTO(p, rerror, unlock_and_fail);
@@ -477,16 +545,16 @@ pa_usec_t pa_simple_get_latency(pa_simple *p, int *rerror) {
         CHECK_SUCCESS_GOTO(p, rerror, pa_context_errno(p->context) == PA_ERR_NODATA, unlock_and_fail);
 
         /* Wait until latency data is available again */
-        pa_threaded_mainloop_wait(p->mainloop);
+        simple_wait(p);
     }
 
-    pa_threaded_mainloop_unlock(p->mainloop);
+    simple_unlock(p);
 
     return negative ? 0 : t;
 
 unlock_and_fail:
 
-    pa_threaded_mainloop_unlock(p->mainloop);
+    simple_unlock(p);
     return (pa_usec_t) -1;
 }
 
@@ -527,7 +595,7 @@ pa_simple* pa_simple_new_proplist(
         goto fail;
     }
 
-    pa_threaded_mainloop_lock(p->mainloop);
+    simple_lock(p);
 
     if (pa_threaded_mainloop_start(p->mainloop) < 0)
         goto unlock_and_fail;
@@ -546,7 +614,7 @@ pa_simple* pa_simple_new_proplist(
         }
 
         /* Wait until the context is ready */
-        pa_threaded_mainloop_wait(p->mainloop);
+        simple_wait(p);
     }
 
     if (!(p->stream = pa_stream_new_with_proplist(p->context, stream_name, ss, map, proplist))) {
@@ -590,15 +658,15 @@ pa_simple* pa_simple_new_proplist(
         }
 
         /* Wait until the stream is ready */
-        pa_threaded_mainloop_wait(p->mainloop);
+        simple_wait(p);
     }
 
-    pa_threaded_mainloop_unlock(p->mainloop);
+    simple_unlock(p);
 
     return p;
 
  unlock_and_fail:
-    pa_threaded_mainloop_unlock(p->mainloop);
+    simple_unlock(p);
 
  fail:
     if (rerror)
@@ -607,6 +675,112 @@ pa_simple* pa_simple_new_proplist(
     return NULL;
 }
 
+pa_simple* pa_simple_new_unthreaded(
+        const char *server,
+        const char *name,
+        pa_stream_direction_t dir,
+        const char *dev,
+        const char *stream_name,
+        const pa_sample_spec *ss,
+        const pa_channel_map *map,
+        const pa_buffer_attr *attr,
+        pa_proplist *proplist,
+        int *rerror) {
+
+    pa_simple *p;
+    pa_stream_flags_t flags = PA_STREAM_INTERPOLATE_TIMING|PA_STREAM_ADJUST_LATENCY|PA_STREAM_AUTO_TIMING_UPDATE;
+    int error = PA_ERR_INTERNAL, r;
+
+    CHECK_VALIDITY_RETURN_ANY(rerror, !server || *server, PA_ERR_INVALID, NULL);
+    CHECK_VALIDITY_RETURN_ANY(rerror, dir == PA_STREAM_PLAYBACK || dir == PA_STREAM_RECORD, PA_ERR_INVALID, NULL);
+    CHECK_VALIDITY_RETURN_ANY(rerror, !dev || *dev, PA_ERR_INVALID, NULL);
+    CHECK_VALIDITY_RETURN_ANY(rerror, ss && pa_sample_spec_valid(ss), PA_ERR_INVALID, NULL);
+    CHECK_VALIDITY_RETURN_ANY(rerror, !map || (pa_channel_map_valid(map) && map->channels == ss->channels), PA_ERR_INVALID, NULL);
+
+    p = pa_xnew0(pa_simple, 1);
+    p->direction = dir;
+
+    if (!(p->direct_mainloop = pa_mainloop_new()))
+        goto fail;
+
+    if (!(p->context = pa_context_new(pa_mainloop_get_api(p->direct_mainloop), name)))
+        goto fail;
+
+    pa_context_set_state_callback(p->context, context_state_cb, p);
+
+    if (pa_context_connect(p->context, server, 0, NULL) < 0) {
+        error = pa_context_errno(p->context);
+        goto fail;
+    }
+
+    for (;;) {
+        pa_context_state_t state;
+
+        state = pa_context_get_state(p->context);
+
+        if (state == PA_CONTEXT_READY)
+            break;
+
+        if (!PA_CONTEXT_IS_GOOD(state)) {
+            error = pa_context_errno(p->context);
+            goto fail;
+        }
+
+        /* Wait until the context is ready */
+        simple_wait(p);
+    }
+
+    if (!(p->stream = pa_stream_new_with_proplist(p->context, stream_name, ss, map, proplist))) {
+        error = pa_context_errno(p->context);
+        goto fail;
+    }
+
+    pa_stream_set_state_callback(p->stream, stream_state_cb, p);
+    pa_stream_set_read_callback(p->stream, stream_request_cb, p);
+    pa_stream_set_write_callback(p->stream, stream_request_cb, p);
+    pa_stream_set_latency_update_callback(p->stream, stream_latency_update_cb, p);
+
+    if (dir == PA_STREAM_PLAYBACK) {
+        /* Write straight into shared memory if we can, so that the
+         * server doesn't have to wait for us to be scheduled */
+        if ((r = pa_stream_connect_playback(p->stream, dev, attr, flags|PA_STREAM_RING_BUFFER, NULL, NULL)) >= 0)
+            p->ring = TRUE;
+        else if (pa_context_errno(p->context) == PA_ERR_NOTSUPPORTED)
+            r = pa_stream_connect_playback(p->stream, dev, attr, flags, NULL, NULL);
+    } else
+        r = pa_stream_connect_record(p->stream, dev, attr, flags);
+
+    if (r < 0) {
+        error = pa_context_errno(p->context);
+        goto fail;
+    }
+
+    for (;;) {
+        pa_stream_state_t state;
+
+        state = pa_stream_get_state(p->stream);
+
+        if (state == PA_STREAM_READY)
+            break;
+
+        if (!PA_STREAM_IS_GOOD(state)) {
+            error = pa_context_errno(p->context);
+            goto fail;
+        }
+
+        /* Wait until the stream is ready */
+        simple_wait(p);
+    }
+
+    return p;
+
+fail:
+    if (rerror)
+        *rerror = error;
+    pa_simple_free(p);
+    return NULL;
+}
+
 int pa_simple_mute(pa_simple *p, int mute, int *rerror) {
     pa_operation *o = NULL;
     uint32_t idx;
@@ -615,7 +789,7 @@ int pa_simple_mute(pa_simple *p, int mute, int *rerror) {
 
     CHECK_VALIDITY_RETURN_ANY(rerror, p->direction == PA_STREAM_PLAYBACK, PA_ERR_BADSTATE, -1);
 
-    pa_threaded_mainloop_lock(p->mainloop);
+    simple_lock(p);
     CHECK_DEAD_GOTO(p, rerror, unlock_and_fail);
 
     CHECK_SUCCESS_GOTO(p, rerror, ((idx = pa_stream_get_index (p->stream)) != PA_INVALID_INDEX), unlock_and_fail);
@@ -626,13 +800,13 @@ int pa_simple_mute(pa_simple *p, int mute, int *rerror) {
 
     p->operation_success = 0;
     while (pa_operation_get_state(o) == PA_OPERATION_RUNNING) {
-        pa_threaded_mainloop_wait(p->mainloop);
+        simple_wait(p);
         CHECK_DEAD_GOTO(p, rerror, unlock_and_fail);
     }
     CHECK_SUCCESS_GOTO(p, rerror, p->operation_success, unlock_and_fail);
 
     pa_operation_unref(o);
-    pa_threaded_mainloop_unlock(p->mainloop);
+    simple_unlock(p);
 
     return 0;
 
@@ -643,7 +817,7 @@ int pa_simple_mute(pa_simple *p, int mute, int *rerror) {
         pa_operation_unref(o);
     }
 
-    pa_threaded_mainloop_unlock(p->mainloop);
+    simple_unlock(p);
     return -1;
 }
 
@@ -651,17 +825,17 @@ int pa_simple_get_stream_index(pa_simple *p, unsigned int *idx, int *rerror) {
     pa_assert(p);
     CHECK_VALIDITY_RETURN_ANY(rerror, idx != NULL, PA_ERR_INVALID, -1);
 
-    pa_threaded_mainloop_lock(p->mainloop);
+    simple_lock(p);
 
     CHECK_DEAD_GOTO(p, rerror, unlock_and_fail);
 
     *idx = pa_stream_get_index(p->stream);
 
-	pa_threaded_mainloop_unlock(p->mainloop);
+	simple_unlock(p);
     return 0;
 
  unlock_and_fail:
-    pa_threaded_mainloop_unlock(p->mainloop);
+    simple_unlock(p);
     return -1;
 }
 
@@ -677,7 +851,7 @@ int pa_simple_set_volume(pa_simple *p, int volume, int *rerror) {
     CHECK_VALIDITY_RETURN_ANY(rerror, volume >= 0, PA_ERR_INVALID, -1);
     CHECK_VALIDITY_RETURN_ANY(rerror, volume <= 65535, PA_ERR_INVALID, -1);
 
-    pa_threaded_mainloop_lock(p->mainloop);
+    simple_lock(p);
     CHECK_DEAD_GOTO(p, rerror, unlock_and_fail);
 
     CHECK_SUCCESS_GOTO(p, rerror, ((idx = pa_stream_get_index (p->stream)) != PA_INVALID_INDEX), unlock_and_fail);
@@ -692,13 +866,13 @@ int pa_simple_set_volume(pa_simple *p, int volume, int *rerror) {
 
     p->operation_success = 0;
     while (pa_operation_get_state(o) == PA_OPERATION_RUNNING) {
-        pa_threaded_mainloop_wait(p->mainloop);
+        simple_wait(p);
         CHECK_DEAD_GOTO(p, rerror, unlock_and_fail);
     }
     CHECK_SUCCESS_GOTO(p, rerror, p->operation_success, unlock_and_fail);
 
     pa_operation_unref(o);
-    pa_threaded_mainloop_unlock(p->mainloop);
+    simple_unlock(p);
 
     return 0;
 
@@ -709,7 +883,7 @@ int pa_simple_set_volume(pa_simple *p, int volume, int *rerror) {
         pa_operation_unref(o);
     }
 
-    pa_threaded_mainloop_unlock(p->mainloop);
+    simple_unlock(p);
     return -1;
 }
 
@@ -718,7 +892,7 @@ int pa_simple_cork(pa_simple *p, int cork, int *rerror) {
 
     pa_assert(p);
 
-    pa_threaded_mainloop_lock(p->mainloop);
+    simple_lock(p);
     CHECK_DEAD_GOTO(p, rerror, unlock_and_fail);
 
     o = pa_stream_cork(p->stream, cork, success_cb, p);
@@ -726,13 +900,13 @@ int pa_simple_cork(pa_simple *p, int cork, int *rerror) {
 
     p->operation_success = 0;
     while (pa_operation_get_state(o) == PA_OPERATION_RUNNING) {
-        pa_threaded_mainloop_wait(p->mainloop);
+        simple_wait(p);
         CHECK_DEAD_GOTO(p, rerror, unlock_and_fail);
     }
     CHECK_SUCCESS_GOTO(p, rerror, p->operation_success, unlock_and_fail);
 
     pa_operation_unref(o);
-    pa_threaded_mainloop_unlock(p->mainloop);
+    simple_unlock(p);
 
     return 0;
 
@@ -743,7 +917,7 @@ unlock_and_fail:
         pa_operation_unref(o);
     }
 
-    pa_threaded_mainloop_unlock(p->mainloop);
+    simple_unlock(p);
     return -1;
 }
 
@@ -751,11 +925,11 @@ int pa_simple_is_corked(pa_simple *p) {
     int is_cork;
     pa_assert(p);
 
-    pa_threaded_mainloop_lock(p->mainloop);
+    simple_lock(p);
 
     is_cork = pa_stream_is_corked(p->stream);
 
-    pa_threaded_mainloop_unlock(p->mainloop);
+    simple_unlock(p);
 
     return is_cork;
 }
@@ -143,6 +143,26 @@ pa_simple* pa_simple_new_proplist(
     int *error                          /**< A pointer where the error code is stored when the routine returns NULL. It is OK to pass NULL here. */
     );
 
+/** Like pa_simple_new_proplist(), but without a thread of its own.
+ * The connection is only serviced from within the calls on it, which
+ * saves the handoff to and from a main loop thread in each blocking
+ * call. Hence all calls on the returned object need to come from the
+ * same thread, and the connection stalls while none is made. Playback
+ * streams write into a ring buffer in shared memory where the server
+ * supports that. \since 3.0 */
+pa_simple* pa_simple_new_unthreaded(
+    const char *server,                 /**< Server name, or NULL for default */
+    const char *name,                   /**< A descriptive name for this client (application name, ...) */
+    pa_stream_direction_t dir,          /**< Open this stream for recording or playback? */
+    const char *dev,                    /**< Sink (resp. source) name, or NULL for default */
+    const char *stream_name,            /**< A descriptive name for this stream (application name, song title, ...) */
+    const pa_sample_spec *ss,           /**< The sample type to use */
+    const pa_channel_map *map,          /**< The channel map to use, or NULL for default */
+    const pa_buffer_attr *attr,         /**< Buffering attributes, or NULL for default */
+    pa_proplist *proplist,              /**< Properties, or NULL for default */
+    int *error                          /**< A pointer where the error code is stored when the routine returns NULL. It is OK to pass NULL here. */
+    );
+
 /** Close and free the connection to the server. The connection object becomes invalid when this is called. */
 void pa_simple_free(pa_simple *s);
 
@@ -298,6 +298,9 @@ static void stream_free(pa_stream *s) {
     if (s->record_memblockq)
         pa_memblockq_free(s->record_memblockq);
 
+    if (s->ring)
+        pa_stream_ring_free(s->ring);
+
     if (s->proplist)
         pa_proplist_free(s->proplist);
 
@@ -374,6 +377,12 @@ void pa_stream_set_state(pa_stream *s, pa_stream_state_t st) {
     pa_stream_unref(s);
 }
 
+/* Without pushed timing info the automatic updates have to be polled
+ * for on a timer */
+static pa_bool_t needs_auto_timing_timer(pa_stream *s) {
+    return (s->flags & PA_STREAM_AUTO_TIMING_UPDATE) && !s->timing_pushed;
+}
+
 static void request_auto_timing_update(pa_stream *s, pa_bool_t force) {
     pa_assert(s);
     pa_assert(PA_REFCNT_VALUE(s) >= 1);
@@ -575,7 +584,7 @@ void pa_command_stream_moved(pa_pdispatch *pd, uint32_t command, uint32_t tag, p
 
     s->suspended = suspended;
 
-    if ((s->flags & PA_STREAM_AUTO_TIMING_UPDATE) && !suspended && !s->auto_timing_update_event) {
+    if (needs_auto_timing_timer(s) && !suspended && !s->auto_timing_update_event) {
         s->auto_timing_interval_usec = AUTO_TIMING_INTERVAL_START_USEC;
         s->auto_timing_update_event = pa_context_rttime_new(s->context, pa_rtclock_now() + s->auto_timing_interval_usec, &auto_timing_update_callback, s);
         request_auto_timing_update(s, TRUE);
@@ -699,7 +708,7 @@ void pa_command_stream_suspended(pa_pdispatch *pd, uint32_t command, uint32_t ta
 
     s->suspended = suspended;
 
-    if ((s->flags & PA_STREAM_AUTO_TIMING_UPDATE) && !suspended && !s->auto_timing_update_event) {
+    if (needs_auto_timing_timer(s) && !suspended && !s->auto_timing_update_event) {
         s->auto_timing_interval_usec = AUTO_TIMING_INTERVAL_START_USEC;
         s->auto_timing_update_event = pa_context_rttime_new(s->context, pa_rtclock_now() + s->auto_timing_interval_usec, &auto_timing_update_callback, s);
         request_auto_timing_update(s, TRUE);
@@ -808,38 +817,59 @@ finish:
         pa_proplist_free(pl);
 }
 
-void pa_command_request(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+static void stream_request(pa_context *c, uint32_t channel, uint32_t bytes) {
     pa_stream *s;
+
+    if (!(s = pa_hashmap_get(c->playback_streams, PA_UINT32_TO_PTR(channel))))
+        return;
+
+    if (s->state != PA_STREAM_READY)
+        return;
+
+    s->requested_bytes += bytes;
+
+    /* pa_log("got request for %lli, now at %lli", (long long) bytes, (long long) s->requested_bytes); */
+
+    if (s->requested_bytes > 0 && s->write_callback)
+        s->write_callback(s, (size_t) s->requested_bytes, s->write_userdata);
+}
+
+void pa_command_request(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_context *c = userdata;
     uint32_t bytes, channel;
 
     pa_assert(pd);
-    pa_assert(command == PA_COMMAND_REQUEST);
+    pa_assert(command == PA_COMMAND_REQUEST || command == PA_COMMAND_REQUEST_MULTI);
     pa_assert(t);
     pa_assert(c);
     pa_assert(PA_REFCNT_VALUE(c) >= 1);
 
     pa_context_ref(c);
 
-    if (pa_tagstruct_getu32(t, &channel) < 0 ||
-        pa_tagstruct_getu32(t, &bytes) < 0 ||
-        !pa_tagstruct_eof(t)) {
+    if (command == PA_COMMAND_REQUEST_MULTI && c->version < 28) {
         pa_context_fail(c, PA_ERR_PROTOCOL);
         goto finish;
     }
 
-    if (!(s = pa_hashmap_get(c->playback_streams, PA_UINT32_TO_PTR(channel))))
-        goto finish;
+    /* A PA_COMMAND_REQUEST_MULTI carries any number of (channel, bytes)
+     * pairs, a PA_COMMAND_REQUEST exactly one */
+    do {
+        if (pa_tagstruct_getu32(t, &channel) < 0 ||
+            pa_tagstruct_getu32(t, &bytes) < 0) {
+            pa_context_fail(c, PA_ERR_PROTOCOL);
+            goto finish;
+        }
 
-    if (s->state != PA_STREAM_READY)
-        goto finish;
+        stream_request(c, channel, bytes);
 
-    s->requested_bytes += bytes;
+        /* The callbacks might have disconnected us */
+        if (c->state != PA_CONTEXT_READY)
+            goto finish;
 
-    /* pa_log("got request for %lli, now at %lli", (long long) bytes, (long long) s->requested_bytes); */
+    } while (command == PA_COMMAND_REQUEST_MULTI && !pa_tagstruct_eof(t));
 
-    if (s->requested_bytes > 0 && s->write_callback)
-        s->write_callback(s, (size_t) s->requested_bytes, s->write_userdata);
+    if (!pa_tagstruct_eof(t))
+        pa_context_fail(c, PA_ERR_PROTOCOL);
 
 finish:
     pa_context_unref(c);
@@ -960,9 +990,11 @@ static void create_stream_complete(pa_stream *s) {
         s->write_callback(s, (size_t) s->requested_bytes, s->write_userdata);
 
     if (s->flags & PA_STREAM_AUTO_TIMING_UPDATE) {
-        s->auto_timing_interval_usec = AUTO_TIMING_INTERVAL_START_USEC;
-        pa_assert(!s->auto_timing_update_event);
-        s->auto_timing_update_event = pa_context_rttime_new(s->context, pa_rtclock_now() + s->auto_timing_interval_usec, &auto_timing_update_callback, s);
+        if (needs_auto_timing_timer(s)) {
+            s->auto_timing_interval_usec = AUTO_TIMING_INTERVAL_START_USEC;
+            pa_assert(!s->auto_timing_update_event);
+            s->auto_timing_update_event = pa_context_rttime_new(s->context, pa_rtclock_now() + s->auto_timing_interval_usec, &auto_timing_update_callback, s);
+        }
 
         request_auto_timing_update(s, TRUE);
     }
@@ -1063,6 +1095,14 @@ void pa_create_stream_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag,
                 goto finish;
             }
         }
+
+        /* The counterpart of what the server does for remote clients */
+        if (!s->context->is_local) {
+            if (s->direction == PA_STREAM_PLAYBACK)
+                pa_pstream_grow_socket_buffers(s->context->pstream, 0, s->buffer_attr.tlength);
+            else if (s->direction == PA_STREAM_RECORD)
+                pa_pstream_grow_socket_buffers(s->context->pstream, 2 * s->buffer_attr.fragsize, 0);
+        }
     }
 
     if (s->context->version >= 12 && s->direction != PA_STREAM_UPLOAD) {
@@ -1152,6 +1192,24 @@ void pa_create_stream_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag,
                 NULL);
     }
 
+    if (s->flags & PA_STREAM_RING_BUFFER) {
+        pa_memchunk chunk;
+
+        pa_assert(!s->ring);
+
+        /* The server takes the first block on the channel as the ring
+         * and sends its read index back the same way */
+        s->ring = pa_stream_ring_new_writer(s->context->mempool,
+                                            pa_stream_ring_capacity(s->context->mempool, s->buffer_attr.tlength),
+                                            s->buffer_attr.tlength);
+
+        pa_stream_ring_get_chunk(s->ring, &chunk);
+        pa_pstream_send_memblock(s->context->pstream, s->channel, 0, PA_SEEK_RELATIVE, &chunk);
+
+        /* Space is polled for, there are no requests */
+        s->requested_bytes = 0;
+    }
+
     s->channel_valid = TRUE;
     pa_hashmap_put((s->direction == PA_STREAM_RECORD) ? s->context->record_streams : s->context->playback_streams, PA_UINT32_TO_PTR(s->channel), s);
 
@@ -1202,7 +1260,8 @@ static int create_stream(
                                               PA_STREAM_START_UNMUTED|
                                               PA_STREAM_FAIL_ON_SUSPEND|
                                               PA_STREAM_RELATIVE_VOLUME|
-                                              PA_STREAM_PASSTHROUGH)), PA_ERR_INVALID);
+                                              PA_STREAM_PASSTHROUGH|
+                                              PA_STREAM_RING_BUFFER)), PA_ERR_INVALID);
 
 
     PA_CHECK_VALIDITY(s->context, s->context->version >= 12 || !(flags & PA_STREAM_VARIABLE_RATE), PA_ERR_NOTSUPPORTED);
@@ -1215,6 +1274,8 @@ static int create_stream(
 
     PA_CHECK_VALIDITY(s->context, direction == PA_STREAM_PLAYBACK || !(flags & (PA_STREAM_START_MUTED)), PA_ERR_INVALID);
     PA_CHECK_VALIDITY(s->context, direction == PA_STREAM_RECORD || !(flags & (PA_STREAM_PEAK_DETECT)), PA_ERR_INVALID);
+    PA_CHECK_VALIDITY(s->context, direction == PA_STREAM_PLAYBACK || !(flags & PA_STREAM_RING_BUFFER), PA_ERR_INVALID);
+    PA_CHECK_VALIDITY(s->context, !(flags & PA_STREAM_RING_BUFFER) || (s->context->version >= 31 && pa_pstream_get_shm(s->context->pstream)), PA_ERR_NOTSUPPORTED);
     PA_CHECK_VALIDITY(s->context, !volume || s->n_formats || (pa_sample_spec_valid(&s->sample_spec) && volume->channels == s->sample_spec.channels), PA_ERR_INVALID);
     PA_CHECK_VALIDITY(s->context, !sync_stream || (direction == PA_STREAM_PLAYBACK && sync_stream->direction == PA_STREAM_PLAYBACK), PA_ERR_INVALID);
     PA_CHECK_VALIDITY(s->context, (flags & (PA_STREAM_ADJUST_LATENCY|PA_STREAM_EARLY_REQUESTS)) != (PA_STREAM_ADJUST_LATENCY|PA_STREAM_EARLY_REQUESTS), PA_ERR_INVALID);
@@ -1246,7 +1307,8 @@ static int create_stream(
                 TRUE,
                 SMOOTHER_MIN_HISTORY,
                 x,
-                TRUE);
+                TRUE,
+                FALSE);
     }
 
     if (!dev)
@@ -1364,6 +1426,15 @@ static int create_stream(
         pa_tagstruct_put_boolean(t, flags & (PA_STREAM_PASSTHROUGH));
     }
 
+    if (s->context->version >= 31 && s->direction == PA_STREAM_PLAYBACK)
+        pa_tagstruct_put_boolean(t, flags & PA_STREAM_RING_BUFFER);
+
+    if (s->context->version >= 32 && s->direction == PA_STREAM_PLAYBACK) {
+        /* Ring buffer streams get no requests to piggyback on */
+        s->timing_pushed = (flags & PA_STREAM_AUTO_TIMING_UPDATE) && !(flags & PA_STREAM_RING_BUFFER);
+        pa_tagstruct_put_boolean(t, s->timing_pushed);
+    }
+
     pa_pstream_send_tagstruct(s->context->pstream, t);
     pa_pdispatch_register_reply(s->context->pdispatch, tag, DEFAULT_TIMEOUT, pa_create_stream_callback, s, NULL);
 
@@ -1410,6 +1481,7 @@ int pa_stream_begin_write(
     PA_CHECK_VALIDITY(s->context, !pa_detect_fork(), PA_ERR_FORKED);
     PA_CHECK_VALIDITY(s->context, s->state == PA_STREAM_READY, PA_ERR_BADSTATE);
     PA_CHECK_VALIDITY(s->context, s->direction == PA_STREAM_PLAYBACK || s->direction == PA_STREAM_UPLOAD, PA_ERR_BADSTATE);
+    PA_CHECK_VALIDITY(s->context, !s->ring, PA_ERR_NOTSUPPORTED);
     PA_CHECK_VALIDITY(s->context, data, PA_ERR_INVALID);
     PA_CHECK_VALIDITY(s->context, nbytes && *nbytes != 0, PA_ERR_INVALID);
 
@@ -1456,6 +1528,48 @@ int pa_stream_cancel_write(
     return 0;
 }
 
+/* Accounts for length bytes the application just wrote */
+static void stream_wrote(pa_stream *s, int64_t offset, pa_seek_mode_t seek, size_t length) {
+    /* This is obviously wrong since we ignore the seeking index . But
+     * that's OK, the server side applies the same error */
+    s->requested_bytes -= (seek == PA_SEEK_RELATIVE ? offset : 0) + (int64_t) length;
+
+    /* pa_log("wrote %lli, now at %lli", (long long) length, (long long) s->requested_bytes); */
+
+    if (s->direction == PA_STREAM_PLAYBACK) {
+
+        /* Update latency request correction */
+        if (s->write_index_corrections[s->current_write_index_correction].valid) {
+
+            if (seek == PA_SEEK_ABSOLUTE) {
+                s->write_index_corrections[s->current_write_index_correction].corrupt = FALSE;
+                s->write_index_corrections[s->current_write_index_correction].absolute = TRUE;
+                s->write_index_corrections[s->current_write_index_correction].value = offset + (int64_t) length;
+            } else if (seek == PA_SEEK_RELATIVE) {
+                if (!s->write_index_corrections[s->current_write_index_correction].corrupt)
+                    s->write_index_corrections[s->current_write_index_correction].value += offset + (int64_t) length;
+            } else
+                s->write_index_corrections[s->current_write_index_correction].corrupt = TRUE;
+        }
+
+        /* Update the write index in the already available latency data */
+        if (s->timing_info_valid) {
+
+            if (seek == PA_SEEK_ABSOLUTE) {
+                s->timing_info.write_index_corrupt = FALSE;
+                s->timing_info.write_index = offset + (int64_t) length;
+            } else if (seek == PA_SEEK_RELATIVE) {
+                if (!s->timing_info.write_index_corrupt)
+                    s->timing_info.write_index += offset + (int64_t) length;
+            } else
+                s->timing_info.write_index_corrupt = TRUE;
+        }
+
+        if (!s->timing_info_valid || s->timing_info.write_index_corrupt)
+            request_auto_timing_update(s, TRUE);
+    }
+}
+
 int pa_stream_write(
         pa_stream *s,
         const void *data,
@@ -1471,6 +1585,7 @@ int pa_stream_write(
     PA_CHECK_VALIDITY(s->context, !pa_detect_fork(), PA_ERR_FORKED);
     PA_CHECK_VALIDITY(s->context, s->state == PA_STREAM_READY, PA_ERR_BADSTATE);
     PA_CHECK_VALIDITY(s->context, s->direction == PA_STREAM_PLAYBACK || s->direction == PA_STREAM_UPLOAD, PA_ERR_BADSTATE);
+    PA_CHECK_VALIDITY(s->context, !s->ring, PA_ERR_NOTSUPPORTED);
     PA_CHECK_VALIDITY(s->context, seek <= PA_SEEK_RELATIVE_END, PA_ERR_INVALID);
     PA_CHECK_VALIDITY(s->context, s->direction == PA_STREAM_PLAYBACK || (seek == PA_SEEK_RELATIVE && offset == 0), PA_ERR_INVALID);
     PA_CHECK_VALIDITY(s->context,
@@ -1539,44 +1654,42 @@ int pa_stream_write(
             free_cb((void*) data);
     }
 
-    /* This is obviously wrong since we ignore the seeking index . But
-     * that's OK, the server side applies the same error */
-    s->requested_bytes -= (seek == PA_SEEK_RELATIVE ? offset : 0) + (int64_t) length;
+    stream_wrote(s, offset, seek, length);
 
-    /* pa_log("wrote %lli, now at %lli", (long long) length, (long long) s->requested_bytes); */
+    return 0;
+}
 
-    if (s->direction == PA_STREAM_PLAYBACK) {
+int pa_stream_write_pool_block(
+        pa_stream *s,
+        pa_pool_block *b,
+        size_t index,
+        size_t length,
+        int64_t offset,
+        pa_seek_mode_t seek) {
 
-        /* Update latency request correction */
-        if (s->write_index_corrections[s->current_write_index_correction].valid) {
+    pa_memchunk chunk;
 
-            if (seek == PA_SEEK_ABSOLUTE) {
-                s->write_index_corrections[s->current_write_index_correction].corrupt = FALSE;
-                s->write_index_corrections[s->current_write_index_correction].absolute = TRUE;
-                s->write_index_corrections[s->current_write_index_correction].value = offset + (int64_t) length;
-            } else if (seek == PA_SEEK_RELATIVE) {
-                if (!s->write_index_corrections[s->current_write_index_correction].corrupt)
-                    s->write_index_corrections[s->current_write_index_correction].value += offset + (int64_t) length;
-            } else
-                s->write_index_corrections[s->current_write_index_correction].corrupt = TRUE;
-        }
+    pa_assert(s);
+    pa_assert(PA_REFCNT_VALUE(s) >= 1);
+    pa_assert(b);
+    pa_assert(PA_REFCNT_VALUE(b) >= 1);
 
-        /* Update the write index in the already available latency data */
-        if (s->timing_info_valid) {
+    PA_CHECK_VALIDITY(s->context, !pa_detect_fork(), PA_ERR_FORKED);
+    PA_CHECK_VALIDITY(s->context, s->state == PA_STREAM_READY, PA_ERR_BADSTATE);
+    PA_CHECK_VALIDITY(s->context, s->direction == PA_STREAM_PLAYBACK || s->direction == PA_STREAM_UPLOAD, PA_ERR_BADSTATE);
+    PA_CHECK_VALIDITY(s->context, !s->ring, PA_ERR_NOTSUPPORTED);
+    PA_CHECK_VALIDITY(s->context, seek <= PA_SEEK_RELATIVE_END, PA_ERR_INVALID);
+    PA_CHECK_VALIDITY(s->context, s->direction == PA_STREAM_PLAYBACK || (seek == PA_SEEK_RELATIVE && offset == 0), PA_ERR_INVALID);
+    PA_CHECK_VALIDITY(s->context, b->pool == s->context->mempool, PA_ERR_INVALID);
+    PA_CHECK_VALIDITY(s->context, length > 0 && index + length >= index && index + length <= pa_memblock_get_length(b->memblock), PA_ERR_INVALID);
 
-            if (seek == PA_SEEK_ABSOLUTE) {
-                s->timing_info.write_index_corrupt = FALSE;
-                s->timing_info.write_index = offset + (int64_t) length;
-            } else if (seek == PA_SEEK_RELATIVE) {
-                if (!s->timing_info.write_index_corrupt)
-                    s->timing_info.write_index += offset + (int64_t) length;
-            } else
-                s->timing_info.write_index_corrupt = TRUE;
-        }
+    chunk.memblock = b->memblock;
+    chunk.index = index;
+    chunk.length = length;
 
-        if (!s->timing_info_valid || s->timing_info.write_index_corrupt)
-            request_auto_timing_update(s, TRUE);
-    }
+    pa_pstream_send_memblock(s->context->pstream, s->channel, offset, seek, &chunk);
+
+    stream_wrote(s, offset, seek, length);
 
     return 0;
 }
@@ -1639,9 +1752,32 @@ size_t pa_stream_writable_size(pa_stream *s) {
     PA_CHECK_VALIDITY_RETURN_ANY(s->context, s->state == PA_STREAM_READY, PA_ERR_BADSTATE, (size_t) -1);
     PA_CHECK_VALIDITY_RETURN_ANY(s->context, s->direction != PA_STREAM_RECORD, PA_ERR_BADSTATE, (size_t) -1);
 
+    if (s->ring)
+        return pa_stream_ring_writable(s->ring);
+
     return s->requested_bytes > 0 ? (size_t) s->requested_bytes : 0;
 }
 
+size_t pa_stream_ring_buffer_writable_size(pa_stream *s) {
+    pa_assert(s);
+    pa_assert(PA_REFCNT_VALUE(s) >= 1);
+
+    /* No state checks here, they would race with the main loop */
+    PA_CHECK_VALIDITY_RETURN_ANY(s->context, s->ring, PA_ERR_BADSTATE, (size_t) -1);
+
+    return pa_stream_ring_writable(s->ring);
+}
+
+size_t pa_stream_ring_buffer_write(pa_stream *s, const void *data, size_t nbytes) {
+    pa_assert(s);
+    pa_assert(PA_REFCNT_VALUE(s) >= 1);
+    pa_assert(data);
+
+    PA_CHECK_VALIDITY_RETURN_ANY(s->context, s->ring, PA_ERR_BADSTATE, (size_t) -1);
+
+    return pa_stream_ring_write(s->ring, data, nbytes);
+}
+
 size_t pa_stream_readable_size(pa_stream *s) {
     pa_assert(s);
     pa_assert(PA_REFCNT_VALUE(s) >= 1);
@@ -1745,6 +1881,42 @@ static pa_usec_t calc_time(pa_stream *s, pa_bool_t ignore_transport) {
     return usec;
 }
 
+/* Feeds fresh timing info into the smoother, unless we're corked */
+static void update_smoother(pa_stream *s) {
+    pa_timing_info *i = &s->timing_info;
+    pa_usec_t u, x;
+
+    if (!s->smoother || s->corked)
+        return;
+
+    u = x = pa_rtclock_now() - i->transport_usec;
+
+    if (s->direction == PA_STREAM_PLAYBACK && s->context->version >= 13) {
+        pa_usec_t su;
+
+        /* If we weren't playing then it will take some time
+         * until the audio will actually come out through the
+         * speakers. Since we follow that timing here, we need
+         * to try to fix this up */
+
+        su = pa_bytes_to_usec((uint64_t) i->since_underrun, &s->sample_spec);
+
+        if (su < i->sink_usec)
+            x += i->sink_usec - su;
+    }
+
+    if (!i->playing)
+        pa_smoother_pause(s->smoother, x);
+
+    /* Update the smoother */
+    if ((s->direction == PA_STREAM_PLAYBACK && !i->read_index_corrupt) ||
+        (s->direction == PA_STREAM_RECORD && !i->write_index_corrupt))
+        pa_smoother_put(s->smoother, u, calc_time(s, TRUE));
+
+    if (i->playing)
+        pa_smoother_resume(s->smoother, x, TRUE);
+}
+
 static void stream_get_timing_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_operation *o = userdata;
     struct timeval local, remote, now;
@@ -1883,37 +2055,7 @@ static void stream_get_timing_info_callback(pa_pdispatch *pd, uint32_t command,
                 i->read_index -= (int64_t) pa_memblockq_get_length(o->stream->record_memblockq);
         }
 
-        /* Update smoother if we're not corked */
-        if (o->stream->smoother && !o->stream->corked) {
-            pa_usec_t u, x;
-
-            u = x = pa_rtclock_now() - i->transport_usec;
-
-            if (o->stream->direction == PA_STREAM_PLAYBACK && o->context->version >= 13) {
-                pa_usec_t su;
-
-                /* If we weren't playing then it will take some time
-                 * until the audio will actually come out through the
-                 * speakers. Since we follow that timing here, we need
-                 * to try to fix this up */
-
-                su = pa_bytes_to_usec((uint64_t) i->since_underrun, &o->stream->sample_spec);
-
-                if (su < i->sink_usec)
-                    x += i->sink_usec - su;
-            }
-
-            if (!i->playing)
-                pa_smoother_pause(o->stream->smoother, x);
-
-            /* Update the smoother */
-            if ((o->stream->direction == PA_STREAM_PLAYBACK && !i->read_index_corrupt) ||
-                (o->stream->direction == PA_STREAM_RECORD && !i->write_index_corrupt))
-                pa_smoother_put(o->stream->smoother, u, calc_time(o->stream, TRUE));
-
-            if (i->playing)
-                pa_smoother_resume(o->stream->smoother, x, TRUE);
-        }
+        update_smoother(o->stream);
     }
 
     o->stream->auto_timing_update_requested = FALSE;
@@ -1932,6 +2074,79 @@ finish:
     pa_operation_unref(o);
 }
 
+void pa_command_playback_timing(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_context *c = userdata;
+    pa_stream *s;
+    pa_timing_info *i;
+    uint32_t channel;
+    pa_usec_t sink_usec;
+    pa_bool_t playing;
+    struct timeval remote;
+    int64_t read_index;
+    uint64_t underrun_for, playing_for;
+
+    pa_assert(pd);
+    pa_assert(command == PA_COMMAND_PLAYBACK_TIMING);
+    pa_assert(t);
+    pa_assert(c);
+    pa_assert(PA_REFCNT_VALUE(c) >= 1);
+
+    pa_context_ref(c);
+
+    if (c->version < 32) {
+        pa_context_fail(c, PA_ERR_PROTOCOL);
+        goto finish;
+    }
+
+    if (pa_tagstruct_getu32(t, &channel) < 0 ||
+        pa_tagstruct_get_usec(t, &sink_usec) < 0 ||
+        pa_tagstruct_get_boolean(t, &playing) < 0 ||
+        pa_tagstruct_get_timeval(t, &remote) < 0 ||
+        pa_tagstruct_gets64(t, &read_index) < 0 ||
+        pa_tagstruct_getu64(t, &underrun_for) < 0 ||
+        pa_tagstruct_getu64(t, &playing_for) < 0 ||
+        !pa_tagstruct_eof(t)) {
+        pa_context_fail(c, PA_ERR_PROTOCOL);
+        goto finish;
+    }
+
+    if (!(s = pa_hashmap_get(c->playback_streams, PA_UINT32_TO_PTR(channel))))
+        goto finish;
+
+    if (s->state != PA_STREAM_READY || !s->timing_pushed)
+        goto finish;
+
+    /* The transport delay is only measured by real queries. And while
+     * one is on its way after a flush or seek, this might still have
+     * been sent before the server got to it. */
+    if (!s->timing_info_valid || s->auto_timing_update_requested)
+        goto finish;
+
+    i = &s->timing_info;
+    i->sink_usec = sink_usec;
+    i->playing = (int) playing;
+    i->since_underrun = (int64_t) (playing ? playing_for : underrun_for);
+    i->read_index = read_index;
+    i->read_index_corrupt = FALSE;
+
+    /* The write index is kept up to date locally by pa_stream_write() */
+
+    if (i->synchronized_clocks)
+        i->timestamp = remote;
+    else {
+        pa_gettimeofday(&i->timestamp);
+        pa_timeval_sub(&i->timestamp, i->transport_usec);
+    }
+
+    update_smoother(s);
+
+    if (s->latency_update_callback)
+        s->latency_update_callback(s, s->latency_update_userdata);
+
+finish:
+    pa_context_unref(c);
+}
+
 pa_operation* pa_stream_update_timing_info(pa_stream *s, pa_stream_success_cb_t cb, void *userdata) {
     uint32_t tag;
     pa_operation *o;
@@ -554,6 +554,43 @@ size_t pa_stream_writable_size(pa_stream *p);
 /** Return the number of bytes that may be read using pa_stream_peek(). */
 size_t pa_stream_readable_size(pa_stream *p);
 
+/** Return the number of bytes that may be written using
+ * pa_stream_ring_buffer_write() to a stream created with
+ * PA_STREAM_RING_BUFFER, or (size_t) -1 on error. Like
+ * pa_stream_ring_buffer_write() this may be called without locking
+ * the main loop. \since 3.0 */
+size_t pa_stream_ring_buffer_writable_size(pa_stream *p);
+
+/** Copy up to nbytes of data into the ring buffer of a stream created
+ * with PA_STREAM_RING_BUFFER, from where the server picks it up when
+ * it needs it, without any round trip through the main loop of either
+ * side. Returns how many bytes were written, which is less than nbytes
+ * when the ring is full, or (size_t) -1 on error. The ring never holds
+ * more than the target length of the stream. Unlike all other
+ * functions this may be called from any thread without locking the
+ * main loop, as long as only one thread writes at a time and the
+ * stream is not freed meanwhile. No write callbacks are issued for
+ * such streams, the application is expected to poll for space, and
+ * pa_stream_write() and pa_stream_begin_write() are not available on
+ * them. \since 3.0 */
+size_t pa_stream_ring_buffer_write(pa_stream *p, const void *data, size_t nbytes);
+
+/** Write nbytes of the block, starting at index within it, to the
+ * stream without copying them. offset and seek work like for
+ * pa_stream_write(). The stream takes a reference of its own, the
+ * block may be unreferenced right afterwards. The written part of the
+ * block must not be modified anymore, since the server may still be
+ * reading it, but other parts of it may be filled and written later
+ * on. The block has to come from the context of the stream, see
+ * pa_context_alloc_pool_block(). \since 3.0 */
+int pa_stream_write_pool_block(
+        pa_stream *p             /**< The stream to use */,
+        pa_pool_block *b         /**< The block to write from */,
+        size_t index             /**< Where the data starts within the block */,
+        size_t nbytes            /**< The length of the data to write in bytes */,
+        int64_t offset           /**< Offset for seeking, must be 0 for upload streams */,
+        pa_seek_mode_t seek      /**< Seek mode, must be PA_SEEK_RELATIVE for upload streams */);
+
 /** Drain a playback stream.  Use this for notification when the
  * playback buffer is empty after playing all the audio in the buffer.
  * Please note that only one drain operation per stream may be issued
@@ -45,8 +45,16 @@ void pa_command_subscribe_event(pa_pdispatch *pd, uint32_t command, uint32_t tag
     pa_context_ref(c);
 
     if (pa_tagstruct_getu32(t, &e) < 0 ||
-        pa_tagstruct_getu32(t, &idx) < 0 ||
-        !pa_tagstruct_eof(t)) {
+        pa_tagstruct_getu32(t, &idx) < 0) {
+        pa_context_fail(c, PA_ERR_PROTOCOL);
+        goto finish;
+    }
+
+    /* In snapshot follow mode the server appends the info of the object */
+    if (!pa_tagstruct_eof(t) &&
+        (c->version < 30 ||
+         pa_context_read_snapshot_object(c, e & PA_SUBSCRIPTION_EVENT_FACILITY_MASK, t) < 0 ||
+         !pa_tagstruct_eof(t))) {
         pa_context_fail(c, PA_ERR_PROTOCOL);
         goto finish;
     }
@@ -78,6 +86,32 @@ pa_operation* pa_context_subscribe(pa_context *c, pa_subscription_mask_t m, pa_c
     return o;
 }
 
+pa_operation* pa_context_subscribe_object(pa_context *c, pa_subscription_mask_t m, pa_subscription_event_type_t facility, uint32_t idx, pa_context_success_cb_t cb, void *userdata) {
+    pa_operation *o;
+    pa_tagstruct *t;
+    uint32_t tag;
+
+    pa_assert(c);
+    pa_assert(PA_REFCNT_VALUE(c) >= 1);
+
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->state == PA_CONTEXT_READY, PA_ERR_BADSTATE);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->version >= 29, PA_ERR_NOTSUPPORTED);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, (facility & ~PA_SUBSCRIPTION_EVENT_FACILITY_MASK) == 0, PA_ERR_INVALID);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, idx != PA_INVALID_INDEX, PA_ERR_INVALID);
+
+    o = pa_operation_new(c, NULL, (pa_operation_cb_t) cb, userdata);
+
+    t = pa_tagstruct_command(c, PA_COMMAND_SUBSCRIBE, &tag);
+    pa_tagstruct_putu32(t, m);
+    pa_tagstruct_putu32(t, 1);
+    pa_tagstruct_putu32(t, facility);
+    pa_tagstruct_putu32(t, idx);
+    pa_pstream_send_tagstruct(c->pstream, t);
+    pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, pa_context_simple_ack_callback, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
+
+    return o;
+}
+
 void pa_context_set_subscribe_callback(pa_context *c, pa_context_subscribe_cb_t cb, void *userdata) {
     pa_assert(c);
     pa_assert(PA_REFCNT_VALUE(c) >= 1);
@@ -78,6 +78,12 @@ typedef void (*pa_context_subscribe_cb_t)(pa_context *c, pa_subscription_event_t
 /** Enable event notification */
 pa_operation* pa_context_subscribe(pa_context *c, pa_subscription_mask_t m, pa_context_success_cb_t cb, void *userdata);
 
+/** Like pa_context_subscribe(), but only events of the given facility
+ * concerning the object idx are delivered, e.g. to follow the volume
+ * of a single sink input. Events of other facilities in the mask are
+ * not affected. \since 3.0 */
+pa_operation* pa_context_subscribe_object(pa_context *c, pa_subscription_mask_t m, pa_subscription_event_type_t facility, uint32_t idx, pa_context_success_cb_t cb, void *userdata);
+
 /** Set the context specific call back function that is called whenever the state of the daemon changes */
 void pa_context_set_subscribe_callback(pa_context *c, pa_context_subscribe_cb_t cb, void *userdata);
 
@@ -201,14 +201,31 @@ pa_volume_t pa_cvolume_min_mask(const pa_cvolume *a, const pa_channel_map *cm, p
     return m;
 }
 
+/* The unchecked versions of pa_sw_volume_multiply() and
+ * pa_sw_volume_divide(), for the channel loops below that validate
+ * their vectors once. Being exported, the public functions can't be
+ * inlined there. */
+static inline pa_volume_t sw_volume_multiply(pa_volume_t a, pa_volume_t b) {
+
+    /* cbrt((a/PA_VOLUME_NORM)^3*(b/PA_VOLUME_NORM)^3)*PA_VOLUME_NORM = a*b/PA_VOLUME_NORM */
+
+    return (pa_volume_t) PA_CLAMP_VOLUME((((uint64_t) a * (uint64_t) b + (uint64_t) PA_VOLUME_NORM / 2ULL) / (uint64_t) PA_VOLUME_NORM));
+}
+
+static inline pa_volume_t sw_volume_divide(pa_volume_t a, pa_volume_t b) {
+
+    if (b <= PA_VOLUME_MUTED)
+        return 0;
+
+    return (pa_volume_t) (((uint64_t) a * (uint64_t) PA_VOLUME_NORM + (uint64_t) b / 2ULL) / (uint64_t) b);
+}
+
 pa_volume_t pa_sw_volume_multiply(pa_volume_t a, pa_volume_t b) {
 
     pa_return_val_if_fail(PA_VOLUME_IS_VALID(a), PA_VOLUME_INVALID);
     pa_return_val_if_fail(PA_VOLUME_IS_VALID(b), PA_VOLUME_INVALID);
 
-    /* cbrt((a/PA_VOLUME_NORM)^3*(b/PA_VOLUME_NORM)^3)*PA_VOLUME_NORM = a*b/PA_VOLUME_NORM */
-
-    return (pa_volume_t) PA_CLAMP_VOLUME((((uint64_t) a * (uint64_t) b + (uint64_t) PA_VOLUME_NORM / 2ULL) / (uint64_t) PA_VOLUME_NORM));
+    return sw_volume_multiply(a, b);
 }
 
 pa_volume_t pa_sw_volume_divide(pa_volume_t a, pa_volume_t b) {
@@ -216,10 +233,7 @@ pa_volume_t pa_sw_volume_divide(pa_volume_t a, pa_volume_t b) {
     pa_return_val_if_fail(PA_VOLUME_IS_VALID(a), PA_VOLUME_INVALID);
     pa_return_val_if_fail(PA_VOLUME_IS_VALID(b), PA_VOLUME_INVALID);
 
-    if (b <= PA_VOLUME_MUTED)
-        return 0;
-
-    return (pa_volume_t) (((uint64_t) a * (uint64_t) PA_VOLUME_NORM + (uint64_t) b / 2ULL) / (uint64_t) b);
+    return sw_volume_divide(a, b);
 }
 
 /* Amplitude, not power */
@@ -408,7 +422,7 @@ pa_cvolume *pa_sw_cvolume_multiply(pa_cvolume *dest, const pa_cvolume *a, const
     pa_return_val_if_fail(pa_cvolume_valid(b), NULL);
 
     for (i = 0; i < a->channels && i < b->channels; i++)
-        dest->values[i] = pa_sw_volume_multiply(a->values[i], b->values[i]);
+        dest->values[i] = sw_volume_multiply(a->values[i], b->values[i]);
 
     dest->channels = (uint8_t) i;
 
@@ -425,7 +439,7 @@ pa_cvolume *pa_sw_cvolume_multiply_scalar(pa_cvolume *dest, const pa_cvolume *a,
     pa_return_val_if_fail(PA_VOLUME_IS_VALID(b), NULL);
 
     for (i = 0; i < a->channels; i++)
-        dest->values[i] = pa_sw_volume_multiply(a->values[i], b);
+        dest->values[i] = sw_volume_multiply(a->values[i], b);
 
     dest->channels = (uint8_t) i;
 
@@ -443,7 +457,7 @@ pa_cvolume *pa_sw_cvolume_divide(pa_cvolume *dest, const pa_cvolume *a, const pa
     pa_return_val_if_fail(pa_cvolume_valid(b), NULL);
 
     for (i = 0; i < a->channels && i < b->channels; i++)
-        dest->values[i] = pa_sw_volume_divide(a->values[i], b->values[i]);
+        dest->values[i] = sw_volume_divide(a->values[i], b->values[i]);
 
     dest->channels = (uint8_t) i;
 
@@ -460,7 +474,7 @@ pa_cvolume *pa_sw_cvolume_divide_scalar(pa_cvolume *dest, const pa_cvolume *a, p
     pa_return_val_if_fail(PA_VOLUME_IS_VALID(b), NULL);
 
     for (i = 0; i < a->channels; i++)
-        dest->values[i] = pa_sw_volume_divide(a->values[i], b);
+        dest->values[i] = sw_volume_divide(a->values[i], b);
 
     dest->channels = (uint8_t) i;
 
@@ -25,6 +25,7 @@
 
 #include <unistd.h>
 #include <errno.h>
+#include <string.h>
 
 #include <pulse/xmalloc.h>
 
@@ -34,11 +35,22 @@
 #include <pulsecore/macro.h>
 #include <pulsecore/mutex.h>
 #include <pulsecore/flist.h>
+#include <pulsecore/atomic.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/trace.h>
 
 #include "asyncmsgq.h"
 
+/* Items for posts are taken from a slab of the queue itself. Since
+ * they are processed in order, they come back in order, too, so the
+ * writers just go round the slab. Only if the reader falls behind by
+ * more than that, items come from the flist. */
+#define SLAB_SIZE 64
+
 PA_STATIC_FLIST_DECLARE(asyncmsgq, 0, pa_xfree);
-PA_STATIC_FLIST_DECLARE(semaphores, 0, (void(*)(void*)) pa_semaphore_free);
+
+/* A thread waits for only one message at a time */
+PA_STATIC_TLS_DECLARE(semaphore, (pa_free_cb_t) pa_semaphore_free);
 
 struct asyncmsgq_item {
     int code;
@@ -49,6 +61,16 @@ struct asyncmsgq_item {
     pa_memchunk memchunk;
     pa_semaphore *semaphore;
     int ret;
+
+    pa_bool_t from_slab;
+    pa_atomic_t busy;
+
+    /* For pa_asyncmsgq_post_data() */
+    union {
+        uint8_t data[PA_ASYNCMSGQ_INLINE_MAX];
+        int64_t _align;
+        void *_align_ptr;
+    } payload;
 };
 
 struct pa_asyncmsgq {
@@ -57,6 +79,9 @@ struct pa_asyncmsgq {
     pa_mutex *mutex; /* only for the writer side */
 
     struct asyncmsgq_item *current;
+
+    struct asyncmsgq_item *slab;
+    unsigned slab_next; /* protected by mutex */
 };
 
 pa_asyncmsgq *pa_asyncmsgq_new(unsigned size) {
@@ -69,9 +94,19 @@ pa_asyncmsgq *pa_asyncmsgq_new(unsigned size) {
     pa_assert_se(a->mutex = pa_mutex_new(FALSE, TRUE));
     a->current = NULL;
 
+    a->slab = pa_xnew0(struct asyncmsgq_item, SLAB_SIZE);
+    a->slab_next = 0;
+
     return a;
 }
 
+static void item_free(struct asyncmsgq_item *i) {
+    if (i->from_slab)
+        pa_atomic_store(&i->busy, 0);
+    else if (pa_flist_push(PA_STATIC_FLIST_GET(asyncmsgq), i) < 0)
+        pa_xfree(i);
+}
+
 static void asyncmsgq_free(pa_asyncmsgq *a) {
     struct asyncmsgq_item *i;
     pa_assert(a);
@@ -89,12 +124,12 @@ static void asyncmsgq_free(pa_asyncmsgq *a) {
         if (i->free_cb)
             i->free_cb(i->userdata);
 
-        if (pa_flist_push(PA_STATIC_FLIST_GET(asyncmsgq), i) < 0)
-            pa_xfree(i);
+        item_free(i);
     }
 
     pa_asyncq_free(a->asyncq, NULL);
     pa_mutex_free(a->mutex);
+    pa_xfree(a->slab);
     pa_xfree(a);
 }
 
@@ -112,13 +147,28 @@ void pa_asyncmsgq_unref(pa_asyncmsgq* q) {
         asyncmsgq_free(q);
 }
 
-void pa_asyncmsgq_post(pa_asyncmsgq *a, pa_msgobject *object, int code, const void *userdata, int64_t offset, const pa_memchunk *chunk, pa_free_cb_t free_cb) {
+/* Called with the mutex held */
+static struct asyncmsgq_item *item_new(pa_asyncmsgq *a) {
     struct asyncmsgq_item *i;
-    pa_assert(PA_REFCNT_VALUE(a) > 0);
 
-    if (!(i = pa_flist_pop(PA_STATIC_FLIST_GET(asyncmsgq))))
-        i = pa_xnew(struct asyncmsgq_item, 1);
+    i = &a->slab[a->slab_next];
 
+    if (pa_atomic_load(&i->busy)) {
+        if (!(i = pa_flist_pop(PA_STATIC_FLIST_GET(asyncmsgq))))
+            i = pa_xnew(struct asyncmsgq_item, 1);
+
+        i->from_slab = FALSE;
+        return i;
+    }
+
+    a->slab_next = (a->slab_next + 1) % SLAB_SIZE;
+
+    pa_atomic_store(&i->busy, 1);
+    i->from_slab = TRUE;
+    return i;
+}
+
+static void post_item(pa_asyncmsgq *a, struct asyncmsgq_item *i, pa_msgobject *object, int code, const void *userdata, int64_t offset, const pa_memchunk *chunk, pa_free_cb_t free_cb) {
     i->code = code;
     i->object = object ? pa_msgobject_ref(object) : NULL;
     i->userdata = (void*) userdata;
@@ -132,9 +182,33 @@ void pa_asyncmsgq_post(pa_asyncmsgq *a, pa_msgobject *object, int code, const vo
         pa_memchunk_reset(&i->memchunk);
     i->semaphore = NULL;
 
+    pa_trace(PA_TRACE_ASYNCMSGQ_SEND, (uint64_t) code, 0);
+
+    pa_asyncq_post(a->asyncq, i);
+}
+
+void pa_asyncmsgq_post(pa_asyncmsgq *a, pa_msgobject *object, int code, const void *userdata, int64_t offset, const pa_memchunk *chunk, pa_free_cb_t free_cb) {
+    pa_assert(PA_REFCNT_VALUE(a) > 0);
+
     /* This mutex makes the queue multiple-writer safe. This lock is only used on the writing side */
     pa_mutex_lock(a->mutex);
-    pa_asyncq_post(a->asyncq, i);
+    post_item(a, item_new(a), object, code, userdata, offset, chunk, free_cb);
+    pa_mutex_unlock(a->mutex);
+}
+
+void pa_asyncmsgq_post_data(pa_asyncmsgq *a, pa_msgobject *object, int code, const void *data, size_t length, int64_t offset, const pa_memchunk *chunk, pa_free_cb_t free_cb) {
+    struct asyncmsgq_item *i;
+
+    pa_assert(PA_REFCNT_VALUE(a) > 0);
+    pa_assert(data);
+    pa_assert(length <= PA_ASYNCMSGQ_INLINE_MAX);
+
+    pa_mutex_lock(a->mutex);
+
+    i = item_new(a);
+    memcpy(i->payload.data, data, length);
+    post_item(a, i, object, code, i->payload.data, offset, chunk, free_cb);
+
     pa_mutex_unlock(a->mutex);
 }
 
@@ -154,10 +228,12 @@ int pa_asyncmsgq_send(pa_asyncmsgq *a, pa_msgobject *object, int code, const voi
     } else
         pa_memchunk_reset(&i.memchunk);
 
-    if (!(i.semaphore = pa_flist_pop(PA_STATIC_FLIST_GET(semaphores))))
-        i.semaphore = pa_semaphore_new(0);
+    if (!(i.semaphore = PA_STATIC_TLS_GET(semaphore))) {
+        pa_assert_se(i.semaphore = pa_semaphore_new(0));
+        PA_STATIC_TLS_SET(semaphore, i.semaphore);
+    }
 
-    pa_assert_se(i.semaphore);
+    pa_trace(PA_TRACE_ASYNCMSGQ_SEND, (uint64_t) code, 1);
 
     /* This mutex makes the queue multiple-writer safe. This lock is only used on the writing side */
     pa_mutex_lock(a->mutex);
@@ -166,9 +242,6 @@ int pa_asyncmsgq_send(pa_asyncmsgq *a, pa_msgobject *object, int code, const voi
 
     pa_semaphore_wait(i.semaphore);
 
-    if (pa_flist_push(PA_STATIC_FLIST_GET(semaphores), i.semaphore) < 0)
-        pa_semaphore_free(i.semaphore);
-
     return i.ret;
 }
 
@@ -226,8 +299,7 @@ void pa_asyncmsgq_done(pa_asyncmsgq *a, int ret) {
         if (a->current->memchunk.memblock)
             pa_memblock_unref(a->current->memchunk.memblock);
 
-        if (pa_flist_push(PA_STATIC_FLIST_GET(asyncmsgq), a->current) < 0)
-            pa_xfree(a->current);
+        item_free(a->current);
     }
 
     a->current = NULL;
@@ -317,11 +389,16 @@ void pa_asyncmsgq_write_after_poll(pa_asyncmsgq *a) {
 }
 
 int pa_asyncmsgq_dispatch(pa_msgobject *object, int code, void *userdata, int64_t offset, pa_memchunk *memchunk) {
+    int ret;
 
-    if (object)
-        return object->process_msg(object, code, userdata, offset, pa_memchunk_isset(memchunk) ? memchunk : NULL);
+    if (!object)
+        return 0;
 
-    return 0;
+    pa_trace(PA_TRACE_ASYNCMSGQ_DISPATCH_BEGIN, (uint64_t) code, 0);
+    ret = object->process_msg(object, code, userdata, offset, pa_memchunk_isset(memchunk) ? memchunk : NULL);
+    pa_trace(PA_TRACE_ASYNCMSGQ_DISPATCH_END, (uint64_t) code, (uint64_t) ret);
+
+    return ret;
 }
 
 void pa_asyncmsgq_flush(pa_asyncmsgq *a, pa_bool_t run) {
@@ -44,7 +44,9 @@
  *
  * There are two functions for submitting messages: _post and
  * _send. The former just enqueues the message asynchronously, the
- * latter waits for completion, synchronously. */
+ * latter waits for completion, synchronously. _post_data is like
+ * _post, but copies a small payload into the message itself, which
+ * the handler gets as userdata. */
 
 enum {
     PA_MESSAGE_SHUTDOWN = -1/* A generic message to inform the handler of this queue to quit */
@@ -52,12 +54,19 @@ enum {
 
 typedef struct pa_asyncmsgq pa_asyncmsgq;
 
+/* The largest payload for pa_asyncmsgq_post_data(), enough for a
+ * pa_cvolume */
+#define PA_ASYNCMSGQ_INLINE_MAX 160
+
 pa_asyncmsgq* pa_asyncmsgq_new(unsigned size);
 pa_asyncmsgq* pa_asyncmsgq_ref(pa_asyncmsgq *q);
 
 void pa_asyncmsgq_unref(pa_asyncmsgq* q);
 
 void pa_asyncmsgq_post(pa_asyncmsgq *q, pa_msgobject *object, int code, const void *userdata, int64_t offset, const pa_memchunk *memchunk, pa_free_cb_t userdata_free_cb);
+/* free_cb, if not NULL, is called with the copy of the payload when
+ * the message is done with */
+void pa_asyncmsgq_post_data(pa_asyncmsgq *q, pa_msgobject *object, int code, const void *data, size_t length, int64_t offset, const pa_memchunk *memchunk, pa_free_cb_t free_cb);
 int pa_asyncmsgq_send(pa_asyncmsgq *q, pa_msgobject *object, int code, const void *userdata, int64_t offset, const pa_memchunk *memchunk);
 
 int pa_asyncmsgq_get(pa_asyncmsgq *q, pa_msgobject **object, int *code, void **userdata, int64_t *offset, pa_memchunk *memchunk, pa_bool_t wait);
@@ -36,6 +36,7 @@
 #include <pulsecore/llist.h>
 #include <pulsecore/flist.h>
 #include <pulsecore/fdsem.h>
+#include <pulsecore/mutex.h>
 
 #include "asyncq.h"
 
@@ -57,6 +58,15 @@ struct localq {
     PA_LLIST_FIELDS(struct localq);
 };
 
+/* A slot of a multiple-reader/multiple-writer queue. seq equals the
+ * position a writer may claim the slot for, and that position plus one
+ * once the data is in. A reader frees the slot again by moving seq on by
+ * the queue size. */
+struct cell {
+    pa_atomic_t seq;
+    pa_atomic_ptr_t data;
+};
+
 struct pa_asyncq {
     unsigned size;
     unsigned read_idx;
@@ -66,17 +76,26 @@ struct pa_asyncq {
     PA_LLIST_HEAD(struct localq, localq);
     struct localq *last_localq;
     pa_bool_t waiting_for_post;
+
+    /* Only for queues with multiple readers/writers. None of the
+     * mutexes are taken on the fast path: the first protects the local
+     * queue, the others are for waiting on a full or empty queue. */
+    pa_bool_t mpmc;
+    pa_atomic_t push_idx, pop_idx;
+    pa_atomic_t n_postponed;
+    pa_mutex *mutex, *push_mutex, *pop_mutex;
 };
 
 PA_STATIC_FLIST_DECLARE(localq, 0, pa_xfree);
 
 #define PA_ASYNCQ_CELLS(x) ((pa_atomic_ptr_t*) ((uint8_t*) (x) + PA_ALIGN(sizeof(struct pa_asyncq))))
+#define PA_ASYNCQ_MPMC_CELLS(x) ((struct cell*) ((uint8_t*) (x) + PA_ALIGN(sizeof(struct pa_asyncq))))
 
 static unsigned reduce(pa_asyncq *l, unsigned value) {
     return value & (unsigned) (l->size - 1);
 }
 
-pa_asyncq *pa_asyncq_new(unsigned size) {
+static pa_asyncq *asyncq_new(unsigned size, pa_bool_t mpmc) {
     pa_asyncq *l;
 
     if (!size)
@@ -84,10 +103,22 @@ pa_asyncq *pa_asyncq_new(unsigned size) {
 
     pa_assert(pa_is_power_of_two(size));
 
-    l = pa_xmalloc0(PA_ALIGN(sizeof(pa_asyncq)) + (sizeof(pa_atomic_ptr_t) * size));
+    l = pa_xmalloc0(PA_ALIGN(sizeof(pa_asyncq)) + ((mpmc ? sizeof(struct cell) : sizeof(pa_atomic_ptr_t)) * size));
 
     l->size = size;
 
+    if ((l->mpmc = mpmc)) {
+        struct cell *cells = PA_ASYNCQ_MPMC_CELLS(l);
+        unsigned i;
+
+        for (i = 0; i < size; i++)
+            pa_atomic_store(&cells[i].seq, (int) i);
+
+        pa_atomic_store(&l->push_idx, 0);
+        pa_atomic_store(&l->pop_idx, 0);
+        pa_atomic_store(&l->n_postponed, 0);
+    }
+
     PA_LLIST_HEAD_INIT(struct localq, l->localq);
     l->last_localq = NULL;
     l->waiting_for_post = FALSE;
@@ -103,9 +134,23 @@ pa_asyncq *pa_asyncq_new(unsigned size) {
         return NULL;
     }
 
+    if (mpmc) {
+        l->mutex = pa_mutex_new(FALSE, FALSE);
+        l->push_mutex = pa_mutex_new(FALSE, FALSE);
+        l->pop_mutex = pa_mutex_new(FALSE, FALSE);
+    }
+
     return l;
 }
 
+pa_asyncq *pa_asyncq_new(unsigned size) {
+    return asyncq_new(size, FALSE);
+}
+
+pa_asyncq *pa_asyncq_new_mpmc(unsigned size) {
+    return asyncq_new(size, TRUE);
+}
+
 void pa_asyncq_free(pa_asyncq *l, pa_free_cb_t free_cb) {
     struct localq *q;
     pa_assert(l);
@@ -127,11 +172,130 @@ void pa_asyncq_free(pa_asyncq *l, pa_free_cb_t free_cb) {
             pa_xfree(q);
     }
 
+    if (l->mpmc) {
+        pa_mutex_free(l->mutex);
+        pa_mutex_free(l->push_mutex);
+        pa_mutex_free(l->pop_mutex);
+    }
+
     pa_fdsem_free(l->read_fdsem);
     pa_fdsem_free(l->write_fdsem);
     pa_xfree(l);
 }
 
+/* Claims the slot at push_idx, retrying when another writer got there
+ * first. Fails only when the queue is full. */
+static int mpmc_try_push(pa_asyncq *l, void *p) {
+    struct cell *cells, *c;
+    unsigned pos;
+
+    cells = PA_ASYNCQ_MPMC_CELLS(l);
+    pos = (unsigned) pa_atomic_load(&l->push_idx);
+
+    for (;;) {
+        int d;
+
+        c = &cells[reduce(l, pos)];
+        d = (int) ((unsigned) pa_atomic_load(&c->seq) - pos);
+
+        if (d == 0) {
+            if (pa_atomic_cmpxchg(&l->push_idx, (int) pos, (int) (pos + 1)))
+                break;
+        } else if (d < 0)
+            return -1;
+
+        _Y;
+        pos = (unsigned) pa_atomic_load(&l->push_idx);
+    }
+
+    /* The store of the data has a barrier behind it, so readers that see
+     * the new seq see the data, too */
+    pa_atomic_ptr_store(&c->data, p);
+    pa_atomic_store(&c->seq, (int) (pos + 1));
+
+    return 0;
+}
+
+static void *mpmc_try_pop(pa_asyncq *l) {
+    struct cell *cells, *c;
+    unsigned pos;
+    void *ret;
+
+    cells = PA_ASYNCQ_MPMC_CELLS(l);
+    pos = (unsigned) pa_atomic_load(&l->pop_idx);
+
+    for (;;) {
+        int d;
+
+        c = &cells[reduce(l, pos)];
+        d = (int) ((unsigned) pa_atomic_load(&c->seq) - (pos + 1));
+
+        if (d == 0) {
+            if (pa_atomic_cmpxchg(&l->pop_idx, (int) pos, (int) (pos + 1)))
+                break;
+        } else if (d < 0)
+            return NULL;
+
+        _Y;
+        pos = (unsigned) pa_atomic_load(&l->pop_idx);
+    }
+
+    ret = pa_atomic_ptr_load(&c->data);
+    pa_atomic_store(&c->seq, (int) (pos + l->size));
+
+    return ret;
+}
+
+static pa_bool_t mpmc_can_pop(pa_asyncq *l) {
+    unsigned pos = (unsigned) pa_atomic_load(&l->pop_idx);
+
+    return (unsigned) pa_atomic_load(&PA_ASYNCQ_MPMC_CELLS(l)[reduce(l, pos)].seq) == pos + 1;
+}
+
+/* The fdsems are made for a single waiter: they only remember one
+ * wakeup, and every waiter would be woken up by it. So threads that have
+ * to wait for space or data do that one at a time. */
+static int mpmc_push(pa_asyncq *l, void *p, pa_bool_t wait_op) {
+
+    if (mpmc_try_push(l, p) < 0) {
+
+        if (!wait_op)
+            return -1;
+
+        pa_mutex_lock(l->push_mutex);
+
+        while (mpmc_try_push(l, p) < 0)
+            pa_fdsem_wait(l->read_fdsem);
+
+        pa_mutex_unlock(l->push_mutex);
+    }
+
+    pa_fdsem_post(l->write_fdsem);
+
+    return 0;
+}
+
+static void *mpmc_pop(pa_asyncq *l, pa_bool_t wait_op) {
+    void *ret;
+
+    if (!(ret = mpmc_try_pop(l))) {
+
+        if (!wait_op)
+            return NULL;
+
+        pa_mutex_lock(l->pop_mutex);
+
+        while (!(ret = mpmc_try_pop(l)))
+            pa_fdsem_wait(l->write_fdsem);
+
+        pa_mutex_unlock(l->pop_mutex);
+    }
+
+    pa_fdsem_post(l->read_fdsem);
+
+    return ret;
+}
+
 static int push(pa_asyncq*l, void *p, pa_bool_t wait_op) {
     unsigned idx;
     pa_atomic_ptr_t *cells;
@@ -139,6 +303,9 @@ static int push(pa_asyncq*l, void *p, pa_bool_t wait_op) {
     pa_assert(l);
     pa_assert(p);
 
+    if (l->mpmc)
+        return mpmc_push(l, p, wait_op);
+
     cells = PA_ASYNCQ_CELLS(l);
 
     _Y;
@@ -178,6 +345,9 @@ static pa_bool_t flush_postq(pa_asyncq *l, pa_bool_t wait_op) {
 
         PA_LLIST_REMOVE(struct localq, l->localq, q);
 
+        if (l->mpmc)
+            pa_atomic_dec(&l->n_postponed);
+
         if (pa_flist_push(PA_STATIC_FLIST_GET(localq), q) < 0)
             pa_xfree(q);
     }
@@ -185,10 +355,30 @@ static pa_bool_t flush_postq(pa_asyncq *l, pa_bool_t wait_op) {
     return TRUE;
 }
 
+/* With multiple writers the local queue is shared and needs the lock,
+ * but it is empty in the common case. Since a writer's own postponed
+ * items are still counted when it pushes the next one, they are always
+ * flushed before that. */
+static pa_bool_t flush_postq_locked(pa_asyncq *l, pa_bool_t wait_op) {
+    pa_bool_t ret;
+
+    if (!l->mpmc)
+        return flush_postq(l, wait_op);
+
+    if (!pa_atomic_load(&l->n_postponed))
+        return TRUE;
+
+    pa_mutex_lock(l->mutex);
+    ret = flush_postq(l, wait_op);
+    pa_mutex_unlock(l->mutex);
+
+    return ret;
+}
+
 int pa_asyncq_push(pa_asyncq*l, void *p, pa_bool_t wait_op) {
     pa_assert(l);
 
-    if (!flush_postq(l, wait_op))
+    if (!flush_postq_locked(l, wait_op))
         return -1;
 
     return push(l, p, wait_op);
@@ -200,10 +390,17 @@ void pa_asyncq_post(pa_asyncq*l, void *p) {
     pa_assert(l);
     pa_assert(p);
 
-    if (flush_postq(l, FALSE))
-        if (pa_asyncq_push(l, p, FALSE) >= 0)
+    if (l->mpmc) {
+        if (!pa_atomic_load(&l->n_postponed) && push(l, p, FALSE) >= 0)
             return;
 
+        pa_mutex_lock(l->mutex);
+    }
+
+    if (flush_postq(l, FALSE))
+        if (push(l, p, FALSE) >= 0)
+            goto finish;
+
     /* OK, we couldn't push anything in the queue. So let's queue it
      * locally and push it later */
 
@@ -219,7 +416,12 @@ void pa_asyncq_post(pa_asyncq*l, void *p) {
     if (!l->last_localq)
         l->last_localq = q;
 
-    return;
+    if (l->mpmc)
+        pa_atomic_inc(&l->n_postponed);
+
+finish:
+    if (l->mpmc)
+        pa_mutex_unlock(l->mutex);
 }
 
 void* pa_asyncq_pop(pa_asyncq*l, pa_bool_t wait_op) {
@@ -229,6 +431,9 @@ void* pa_asyncq_pop(pa_asyncq*l, pa_bool_t wait_op) {
 
     pa_assert(l);
 
+    if (l->mpmc)
+        return mpmc_pop(l, wait_op);
+
     cells = PA_ASYNCQ_CELLS(l);
 
     _Y;
@@ -271,6 +476,16 @@ int pa_asyncq_read_before_poll(pa_asyncq *l) {
 
     pa_assert(l);
 
+    if (l->mpmc) {
+        for (;;) {
+            if (mpmc_can_pop(l))
+                return -1;
+
+            if (pa_fdsem_before_poll(l->write_fdsem) >= 0)
+                return 0;
+        }
+    }
+
     cells = PA_ASYNCQ_CELLS(l);
 
     _Y;
@@ -302,7 +517,7 @@ void pa_asyncq_write_before_poll(pa_asyncq *l) {
 
     for (;;) {
 
-        if (flush_postq(l, FALSE))
+        if (flush_postq_locked(l, FALSE))
             break;
 
         if (pa_fdsem_before_poll(l->read_fdsem) >= 0) {
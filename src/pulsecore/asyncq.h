@@ -38,11 +38,18 @@
  * argument is non-zero, the queue will block on a UNIX FIFO object --
  * that will probably require locking on the kernel side -- which
  * however is probably not problematic, because we do it only on
- * starvation or overload in which case we have to block anyway.  */
+ * starvation or overload in which case we have to block anyway.
+ *
+ * pa_asyncq_new_mpmc() creates a queue that any number of threads may
+ * push to and pop from at the same time, without taking a lock. Only
+ * items that pa_asyncq_post() had to postpone are protected by a mutex.
+ * The poll functions of each side may still be used by only one thread
+ * at a time. */
 
 typedef struct pa_asyncq pa_asyncq;
 
 pa_asyncq* pa_asyncq_new(unsigned size);
+pa_asyncq* pa_asyncq_new_mpmc(unsigned size);
 void pa_asyncq_free(pa_asyncq* q, pa_free_cb_t free_cb);
 
 void* pa_asyncq_pop(pa_asyncq *q, pa_bool_t wait);
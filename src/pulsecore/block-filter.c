@@ -0,0 +1,321 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/memblockq.h>
+#include <pulsecore/sample-util.h>
+
+#include "block-filter.h"
+
+#define MEMBLOCKQ_MAXLENGTH (16*1024*1024)
+
+/* Enough for AVX */
+#define BUFFER_ALIGN 32
+
+struct pa_block_filter {
+    pa_core *core;
+    pa_memblockq *memblockq;
+
+    pa_sample_spec in_ss, out_ss;
+    size_t in_fs, out_fs;
+    unsigned block_frames, max_frames;
+
+    /* The channel buffers, stride frames apart */
+    pa_memblock *buffers;
+    unsigned stride;
+
+    pa_deinterleave_float_func_t deinterleave;
+    pa_interleave_float_func_t interleave;
+
+    pa_block_filter_cb_t cb;
+    pa_block_filter_reset_cb_t reset_cb;
+    void *userdata;
+
+    /* For how many frames the filter has been fed silence */
+    unsigned tail_frames;
+    uint64_t silent_frames;
+};
+
+pa_block_filter* pa_block_filter_new(
+        pa_core *c,
+        const char *name,
+        const pa_sample_spec *in_ss,
+        const pa_sample_spec *out_ss,
+        unsigned block_frames,
+        pa_block_filter_cb_t cb,
+        pa_block_filter_reset_cb_t reset_cb,
+        void *userdata) {
+
+    pa_block_filter *f;
+    pa_memchunk silence;
+    unsigned n_buffers, frames;
+
+    pa_assert(c);
+    pa_assert(name);
+    pa_assert(in_ss);
+    pa_assert(out_ss);
+    pa_assert(in_ss->format == PA_SAMPLE_FLOAT32NE);
+    pa_assert(out_ss->format == PA_SAMPLE_FLOAT32NE);
+    pa_assert(in_ss->rate == out_ss->rate);
+    pa_assert(block_frames > 0);
+    pa_assert(cb);
+
+    f = pa_xnew0(pa_block_filter, 1);
+    f->core = c;
+    f->in_ss = *in_ss;
+    f->out_ss = *out_ss;
+    f->in_fs = pa_frame_size(in_ss);
+    f->out_fs = pa_frame_size(out_ss);
+    f->block_frames = block_frames;
+    f->cb = cb;
+    f->reset_cb = reset_cb;
+    f->userdata = userdata;
+    f->tail_frames = PA_BLOCK_FILTER_TAIL_INFINITE;
+
+    f->deinterleave = pa_get_deinterleave_float_func();
+    f->interleave = pa_get_interleave_float_func();
+
+    /* Filter as many frames at once as the channel buffers of a pool
+     * block can take, but at least one block */
+    n_buffers = in_ss->channels + out_ss->channels;
+    frames = (unsigned) ((pa_mempool_block_size_max(c->mempool) - BUFFER_ALIGN) / (n_buffers * sizeof(float)));
+    frames = PA_ROUND_DOWN(frames, BUFFER_ALIGN / sizeof(float));
+    frames = PA_ROUND_DOWN(frames, block_frames);
+    f->max_frames = PA_MAX(frames, block_frames);
+    f->stride = PA_ROUND_UP(f->max_frames, BUFFER_ALIGN / sizeof(float));
+    f->buffers = pa_memblock_new(c->mempool, n_buffers * f->stride * sizeof(float) + BUFFER_ALIGN);
+
+    pa_silence_memchunk_get(&c->silence_cache, c->mempool, &silence, in_ss, 0);
+    f->memblockq = pa_memblockq_new(name, 0, MEMBLOCKQ_MAXLENGTH, 0, in_ss, 1, 1, 0, &silence);
+    pa_memblock_unref(silence.memblock);
+
+    return f;
+}
+
+void pa_block_filter_free(pa_block_filter *f) {
+    pa_assert(f);
+
+    pa_memblockq_free(f->memblockq);
+    pa_memblock_unref(f->buffers);
+    pa_xfree(f);
+}
+
+void pa_block_filter_set_tail(pa_block_filter *f, unsigned tail_frames) {
+    pa_assert(f);
+
+    f->tail_frames = tail_frames;
+}
+
+static pa_bool_t is_idle(pa_block_filter *f) {
+    return f->tail_frames != PA_BLOCK_FILTER_TAIL_INFINITE && f->silent_frames >= f->tail_frames;
+}
+
+/* Filters up to n frames from the queue, rendering from s when it runs
+ * dry. Rendering stops as soon as there are some whole blocks. */
+static void filter(pa_block_filter *f, pa_sink *s, unsigned n, pa_memchunk *chunk) {
+    float *in[PA_CHANNELS_MAX], *out[PA_CHANNELS_MAX], *d[PA_CHANNELS_MAX];
+    float *buffers, *dst;
+    unsigned filled = 0, c;
+    pa_bool_t silent = TRUE, skipped = FALSE;
+
+    pa_assert(n > 0 && n % f->block_frames == 0 && n <= f->max_frames);
+
+    buffers = (float*) PA_ROUND_UP((size_t) pa_memblock_acquire(f->buffers), BUFFER_ALIGN);
+    for (c = 0; c < f->in_ss.channels; c++)
+        in[c] = buffers + c * f->stride;
+    for (c = 0; c < f->out_ss.channels; c++)
+        out[c] = buffers + (f->in_ss.channels + c) * f->stride;
+
+    while (filled < n) {
+        pa_memchunk tchunk;
+        const float *src;
+        unsigned l;
+
+        if (pa_memblockq_peek(f->memblockq, &tchunk) < 0) {
+            pa_memchunk nchunk;
+
+            if (filled % f->block_frames == 0 && filled > 0)
+                break;
+
+            pa_assert(s);
+
+            pa_sink_render(s, (n - filled) * f->in_fs, &nchunk);
+            pa_memblockq_push(f->memblockq, &nchunk);
+            pa_memblock_unref(nchunk.memblock);
+            continue;
+        }
+
+        l = PA_MIN(n - filled, (unsigned) (tchunk.length / f->in_fs));
+        pa_assert(l > 0);
+
+        if (!pa_memblock_is_silence(tchunk.memblock))
+            silent = FALSE;
+        else if (silent && is_idle(f)) {
+            /* Might not be needed at all */
+            skipped = TRUE;
+            goto next;
+        }
+
+        if (skipped) {
+            for (c = 0; c < f->in_ss.channels; c++)
+                memset(in[c], 0, filled * sizeof(float));
+
+            skipped = FALSE;
+        }
+
+        for (c = 0; c < f->in_ss.channels; c++)
+            d[c] = in[c] + filled;
+
+        src = (const float*) ((uint8_t*) pa_memblock_acquire(tchunk.memblock) + tchunk.index);
+        f->deinterleave(d, f->in_ss.channels, src, f->in_ss.channels, l);
+        pa_memblock_release(tchunk.memblock);
+
+    next:
+        pa_memblock_unref(tchunk.memblock);
+
+        pa_memblockq_drop(f->memblockq, l * f->in_fs);
+        filled += l;
+    }
+
+    if (silent && is_idle(f)) {
+        pa_memblock_release(f->buffers);
+        pa_silence_memchunk_get_full(&f->core->silence_cache, f->core->mempool, chunk, &f->out_ss, filled * f->out_fs);
+        return;
+    }
+
+    f->cb(f->userdata, in, out, filled);
+
+    if (silent)
+        f->silent_frames += filled;
+    else
+        f->silent_frames = 0;
+
+    chunk->index = 0;
+    chunk->length = filled * f->out_fs;
+    chunk->memblock = pa_memblock_new(f->core->mempool, chunk->length);
+
+    dst = pa_memblock_acquire(chunk->memblock);
+    f->interleave(dst, f->out_ss.channels, out, f->out_ss.channels, filled);
+    pa_memblock_release(chunk->memblock);
+
+    pa_memblock_release(f->buffers);
+}
+
+void pa_block_filter_render(pa_block_filter *f, pa_sink *s, size_t nbytes, pa_memchunk *chunk) {
+    unsigned n;
+
+    pa_assert(f);
+    pa_sink_assert_ref(s);
+    pa_assert(chunk);
+
+    n = (unsigned) PA_MAX(nbytes / f->out_fs, 1U);
+    n = PA_ROUND_UP(n, f->block_frames);
+    n = PA_MIN(n, f->max_frames);
+
+    filter(f, s, n, chunk);
+}
+
+void pa_block_filter_process_rewind(pa_block_filter *f, pa_sink *s, size_t nbytes) {
+    size_t amount = 0;
+
+    pa_assert(f);
+    pa_sink_assert_ref(s);
+
+    nbytes = nbytes / f->out_fs * f->in_fs;
+
+    if (s->thread_info.rewind_nbytes > 0) {
+        size_t max_rewrite;
+
+        max_rewrite = nbytes + pa_memblockq_get_length(f->memblockq);
+        amount = PA_MIN(s->thread_info.rewind_nbytes, max_rewrite);
+        s->thread_info.rewind_nbytes = 0;
+
+        if (amount > 0) {
+            pa_memblockq_seek(f->memblockq, - (int64_t) amount, PA_SEEK_RELATIVE, TRUE);
+
+            if (f->reset_cb)
+                f->reset_cb(f->userdata);
+
+            /* What is rewritten is filtered again, whatever it is */
+            f->silent_frames = 0;
+        }
+    }
+
+    pa_sink_process_rewind(s, amount);
+    pa_memblockq_rewind(f->memblockq, nbytes);
+}
+
+void pa_block_filter_update_max_rewind(pa_block_filter *f, pa_sink *s, size_t nbytes) {
+    pa_assert(f);
+    pa_sink_assert_ref(s);
+
+    nbytes = nbytes / f->out_fs * f->in_fs;
+
+    pa_memblockq_set_maxrewind(f->memblockq, nbytes);
+    pa_sink_set_max_rewind_within_thread(s, nbytes);
+}
+
+size_t pa_block_filter_get_max_request(pa_block_filter *f, size_t nbytes) {
+    pa_assert(f);
+
+    return PA_ROUND_UP(nbytes / f->out_fs, f->block_frames) * f->in_fs;
+}
+
+void pa_block_filter_push(pa_block_filter *f, const pa_memchunk *chunk) {
+    pa_assert(f);
+    pa_assert(chunk);
+
+    pa_memblockq_push_align(f->memblockq, chunk);
+}
+
+int pa_block_filter_pull(pa_block_filter *f, pa_memchunk *chunk) {
+    size_t n;
+
+    pa_assert(f);
+    pa_assert(chunk);
+
+    n = pa_memblockq_get_length(f->memblockq) / f->in_fs;
+    if (n < f->block_frames)
+        return -1;
+
+    n = PA_ROUND_DOWN(n, f->block_frames);
+    filter(f, NULL, PA_MIN((unsigned) n, f->max_frames), chunk);
+    return 0;
+}
+
+size_t pa_block_filter_get_length(pa_block_filter *f) {
+    pa_assert(f);
+
+    return pa_memblockq_get_length(f->memblockq);
+}
+
+pa_usec_t pa_block_filter_get_latency(pa_block_filter *f) {
+    pa_assert(f);
+
+    return pa_bytes_to_usec((f->block_frames - 1) * f->in_fs, &f->in_ss);
+}
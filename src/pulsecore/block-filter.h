@@ -0,0 +1,97 @@
+#ifndef foopulsecoreblockfilterhfoo
+#define foopulsecoreblockfilterhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulse/sample.h>
+
+#include <pulsecore/core.h>
+#include <pulsecore/memchunk.h>
+#include <pulsecore/sink.h>
+
+/* The queueing a filter sink or source does around its DSP. The audio
+ * is handed to the filter in multiples of a fixed number of frames,
+ * with each channel in a separate float buffer aligned for SIMD. All
+ * functions except _new() and _free() are to be called from IO thread
+ * context. */
+
+typedef struct pa_block_filter pa_block_filter;
+
+/* Filters n frames, a multiple of the block size, of the input
+ * channels into the output channels. The input buffers may be used as
+ * scratch space. */
+typedef void (*pa_block_filter_cb_t)(void *userdata, float *const in[], float *const out[], unsigned n);
+
+/* Makes the filter forget its history after the input was rewound */
+typedef void (*pa_block_filter_reset_cb_t)(void *userdata);
+
+/* Both sample specs must be FLOAT32NE at the same rate. A block size
+ * of 1 lets the filter take blocks of any size, as they come. */
+pa_block_filter* pa_block_filter_new(
+        pa_core *c,
+        const char *name,
+        const pa_sample_spec *in_ss,
+        const pa_sample_spec *out_ss,
+        unsigned block_frames,
+        pa_block_filter_cb_t cb,
+        pa_block_filter_reset_cb_t reset_cb,
+        void *userdata);
+void pa_block_filter_free(pa_block_filter *f);
+
+#define PA_BLOCK_FILTER_TAIL_INFINITE ((unsigned) -1)
+
+/* How many frames the output of the filter takes to become silent
+ * after its input did. Once the input has been silent for that long,
+ * the callback is skipped and silence is returned, flagged as such,
+ * until the input is no longer silent. Filters that never stop
+ * ringing, which is the default, pass PA_BLOCK_FILTER_TAIL_INFINITE. */
+void pa_block_filter_set_tail(pa_block_filter *f, unsigned tail_frames);
+
+/* For filter sinks, with s being the sink the input comes from and
+ * all lengths in the output sample spec unless noted otherwise */
+
+/* Renders from s as needed and returns the filtered output for at
+ * least nbytes, rounded up to whole blocks */
+void pa_block_filter_render(pa_block_filter *f, pa_sink *s, size_t nbytes, pa_memchunk *chunk);
+
+/* Does everything process_rewind() of the sink input has to do,
+ * including passing the rewind request of s on to it */
+void pa_block_filter_process_rewind(pa_block_filter *f, pa_sink *s, size_t nbytes);
+
+/* Sets the maximum rewinds of the queue and of s */
+void pa_block_filter_update_max_rewind(pa_block_filter *f, pa_sink *s, size_t nbytes);
+
+/* Converts a maximum request to the input sample spec, rounded up to
+ * whole blocks */
+size_t pa_block_filter_get_max_request(pa_block_filter *f, size_t nbytes);
+
+/* For filter sources: queues chunk, then returns the filtered output
+ * of all complete blocks with _pull() until it returns -1 */
+void pa_block_filter_push(pa_block_filter *f, const pa_memchunk *chunk);
+int pa_block_filter_pull(pa_block_filter *f, pa_memchunk *chunk);
+
+/* The queued input in bytes of the input sample spec */
+size_t pa_block_filter_get_length(pa_block_filter *f);
+
+/* The latency of waiting for a block to fill up, one block minus one
+ * frame */
+pa_usec_t pa_block_filter_get_latency(pa_block_filter *f);
+
+#endif
@@ -56,6 +56,7 @@
 #include <pulsecore/core-error.h>
 #include <pulsecore/modinfo.h>
 #include <pulsecore/dynarray.h>
+#include <pulsecore/flist.h>
 
 #include "cli-command.h"
 
@@ -64,6 +65,9 @@ struct command {
     int (*proc) (pa_core *c, pa_tokenizer*t, pa_strbuf *buf, pa_bool_t *fail);
     const char *help;
     unsigned args;
+
+    /* For listings, what pa_cli_list_new() takes */
+    unsigned list;
 };
 
 #define META_INCLUDE ".include"
@@ -72,6 +76,8 @@ struct command {
 #define META_IFEXISTS ".ifexists"
 #define META_ELSE ".else"
 #define META_ENDIF ".endif"
+#define META_DEFER ".defer"
+#define META_NODEFER ".nodefer"
 
 enum {
     IFSTATE_NONE = -1,
@@ -81,6 +87,7 @@ enum {
 
 /* Prototypes for all available commands */
 static int pa_cli_command_exit(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_bool_t *fail);
+static int pa_cli_command_restart(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_bool_t *fail);
 static int pa_cli_command_help(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_bool_t *fail);
 static int pa_cli_command_modules(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_bool_t *fail);
 static int pa_cli_command_clients(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_bool_t *fail);
@@ -137,63 +144,64 @@ static int pa_cli_command_dump_volumes(pa_core *c, pa_tokenizer *t, pa_strbuf *b
 /* A method table for all available commands */
 
 static const struct command commands[] = {
-    { "help",                    pa_cli_command_help,               "Show this help",               1 },
-    { "list-modules",            pa_cli_command_modules,            "List loaded modules",          1 },
-    { "list-cards",              pa_cli_command_cards,              "List cards",                   1 },
-    { "list-sinks",              pa_cli_command_sinks,              "List loaded sinks",            1 },
-    { "list-sources",            pa_cli_command_sources,            "List loaded sources",          1 },
-    { "list-clients",            pa_cli_command_clients,            "List loaded clients",          1 },
-    { "list-sink-inputs",        pa_cli_command_sink_inputs,        "List sink inputs",             1 },
-    { "list-source-outputs",     pa_cli_command_source_outputs,     "List source outputs",          1 },
-    { "stat",                    pa_cli_command_stat,               "Show memory block statistics", 1 },
-    { "info",                    pa_cli_command_info,               "Show comprehensive status",    1 },
-    { "ls",                      pa_cli_command_info,               NULL,                           1 },
-    { "list",                    pa_cli_command_info,               NULL,                           1 },
-    { "load-module",             pa_cli_command_load,               "Load a module (args: name, arguments)", 3},
-    { "unload-module",           pa_cli_command_unload,             "Unload a module (args: index)", 2},
-    { "describe-module",         pa_cli_command_describe,           "Describe a module (arg: name)", 2},
-    { "set-sink-volume",         pa_cli_command_sink_volume,        "Set the volume of a sink (args: index|name, volume)", 3},
-    { "set-source-volume",       pa_cli_command_source_volume,      "Set the volume of a source (args: index|name, volume)", 3},
-    { "set-sink-mute",           pa_cli_command_sink_mute,          "Set the mute switch of a sink (args: index|name, bool)", 3},
-    { "set-source-mute",         pa_cli_command_source_mute,        "Set the mute switch of a source (args: index|name, bool)", 3},
-    { "set-sink-input-volume",   pa_cli_command_sink_input_volume,  "Set the volume of a sink input (args: index, volume)", 3},
-    { "set-source-output-volume",pa_cli_command_source_output_volume,"Set the volume of a source output (args: index, volume)", 3},
-    { "set-sink-input-mute",     pa_cli_command_sink_input_mute,    "Set the mute switch of a sink input (args: index, bool)", 3},
-    { "set-source-output-mute",  pa_cli_command_source_output_mute, "Set the mute switch of a source output (args: index, bool)", 3},
-    { "set-default-sink",        pa_cli_command_sink_default,       "Set the default sink (args: index|name)", 2},
-    { "set-default-source",      pa_cli_command_source_default,     "Set the default source (args: index|name)", 2},
-    { "set-card-profile",        pa_cli_command_card_profile,       "Change the profile of a card (args: index|name, profile-name)", 3},
-    { "set-sink-port",           pa_cli_command_sink_port,          "Change the port of a sink (args: index|name, port-name)", 3},
-    { "set-source-port",         pa_cli_command_source_port,        "Change the port of a source (args: index|name, port-name)", 3},
-    { "suspend-sink",            pa_cli_command_suspend_sink,       "Suspend sink (args: index|name, bool)", 3},
-    { "suspend-source",          pa_cli_command_suspend_source,     "Suspend source (args: index|name, bool)", 3},
-    { "suspend",                 pa_cli_command_suspend,            "Suspend all sinks and all sources (args: bool)", 2},
-    { "move-sink-input",         pa_cli_command_move_sink_input,    "Move sink input to another sink (args: index, sink)", 3},
-    { "move-source-output",      pa_cli_command_move_source_output, "Move source output to another source (args: index, source)", 3},
-    { "update-sink-proplist",    pa_cli_command_update_sink_proplist, "Update the properties of a sink (args: index|name, properties)", 3},
-    { "update-source-proplist",  pa_cli_command_update_source_proplist, "Update the properties of a source (args: index|name, properties)", 3},
-    { "update-sink-input-proplist", pa_cli_command_update_sink_input_proplist, "Update the properties of a sink input (args: index, properties)", 3},
-    { "update-source-output-proplist", pa_cli_command_update_source_output_proplist, "Update the properties of a source output (args: index, properties)", 3},
-    { "list-samples",            pa_cli_command_scache_list,        "List all entries in the sample cache", 1},
-    { "play-sample",             pa_cli_command_scache_play,        "Play a sample from the sample cache (args: name, sink|index)", 3},
-    { "remove-sample",           pa_cli_command_scache_remove,      "Remove a sample from the sample cache (args: name)", 2},
-    { "load-sample",             pa_cli_command_scache_load,        "Load a sound file into the sample cache (args: name, filename)", 3},
-    { "load-sample-lazy",        pa_cli_command_scache_load,        "Lazily load a sound file into the sample cache (args: name, filename)", 3},
-    { "load-sample-dir-lazy",    pa_cli_command_scache_load_dir,    "Lazily load all files in a directory into the sample cache (args: pathname)", 2},
-    { "kill-client",             pa_cli_command_kill_client,        "Kill a client (args: index)", 2},
-    { "kill-sink-input",         pa_cli_command_kill_sink_input,    "Kill a sink input (args: index)", 2},
-    { "kill-source-output",      pa_cli_command_kill_source_output, "Kill a source output (args: index)", 2},
-    { "set-log-level",           pa_cli_command_log_level,          "Change the log level (args: numeric level)", 2},
-    { "set-log-meta",            pa_cli_command_log_meta,           "Show source code location in log messages (args: bool)", 2},
-    { "set-log-time",            pa_cli_command_log_time,           "Show timestamps in log messages (args: bool)", 2},
-    { "set-log-backtrace",       pa_cli_command_log_backtrace,      "Show backtrace in log messages (args: frames)", 2},
-    { "play-file",               pa_cli_command_play_file,          "Play a sound file (args: filename, sink|index)", 3},
-    { "dump",                    pa_cli_command_dump,               "Dump daemon configuration", 1},
-    { "dump-volumes",            pa_cli_command_dump_volumes,       "Debug: Show the state of all volumes", 1 },
-    { "shared",                  pa_cli_command_list_shared_props,  "Debug: Show shared properties", 1},
-    { "exit",                    pa_cli_command_exit,               "Terminate the daemon",         1 },
-    { "vacuum",                  pa_cli_command_vacuum,             NULL, 1},
-    { NULL, NULL, NULL, 0 }
+    { "help",                    pa_cli_command_help,               "Show this help",               1, 0 },
+    { "list-modules",            pa_cli_command_modules,            "List loaded modules",          1, PA_CLI_LIST_MASK(PA_CLI_LIST_MODULES) },
+    { "list-cards",              pa_cli_command_cards,              "List cards",                   1, PA_CLI_LIST_MASK(PA_CLI_LIST_CARDS) },
+    { "list-sinks",              pa_cli_command_sinks,              "List loaded sinks",            1, PA_CLI_LIST_MASK(PA_CLI_LIST_SINKS) },
+    { "list-sources",            pa_cli_command_sources,            "List loaded sources",          1, PA_CLI_LIST_MASK(PA_CLI_LIST_SOURCES) },
+    { "list-clients",            pa_cli_command_clients,            "List loaded clients",          1, PA_CLI_LIST_MASK(PA_CLI_LIST_CLIENTS) },
+    { "list-sink-inputs",        pa_cli_command_sink_inputs,        "List sink inputs (args: [sink=name|index])", 2, PA_CLI_LIST_MASK(PA_CLI_LIST_SINK_INPUTS) },
+    { "list-source-outputs",     pa_cli_command_source_outputs,     "List source outputs (args: [source=name|index])", 2, PA_CLI_LIST_MASK(PA_CLI_LIST_SOURCE_OUTPUTS) },
+    { "stat",                    pa_cli_command_stat,               "Show memory block and hook statistics", 1, 0 },
+    { "info",                    pa_cli_command_info,               "Show comprehensive status",    1, PA_CLI_LIST_ALL },
+    { "ls",                      pa_cli_command_info,               NULL,                           1, PA_CLI_LIST_ALL },
+    { "list",                    pa_cli_command_info,               NULL,                           1, PA_CLI_LIST_ALL },
+    { "load-module",             pa_cli_command_load,               "Load a module (args: name, arguments)", 3, 0 },
+    { "unload-module",           pa_cli_command_unload,             "Unload a module (args: index)", 2, 0 },
+    { "describe-module",         pa_cli_command_describe,           "Describe a module (arg: name)", 2, 0 },
+    { "set-sink-volume",         pa_cli_command_sink_volume,        "Set the volume of a sink (args: index|name, volume)", 3, 0 },
+    { "set-source-volume",       pa_cli_command_source_volume,      "Set the volume of a source (args: index|name, volume)", 3, 0 },
+    { "set-sink-mute",           pa_cli_command_sink_mute,          "Set the mute switch of a sink (args: index|name, bool)", 3, 0 },
+    { "set-source-mute",         pa_cli_command_source_mute,        "Set the mute switch of a source (args: index|name, bool)", 3, 0 },
+    { "set-sink-input-volume",   pa_cli_command_sink_input_volume,  "Set the volume of a sink input (args: index, volume)", 3, 0 },
+    { "set-source-output-volume",pa_cli_command_source_output_volume,"Set the volume of a source output (args: index, volume)", 3, 0 },
+    { "set-sink-input-mute",     pa_cli_command_sink_input_mute,    "Set the mute switch of a sink input (args: index, bool)", 3, 0 },
+    { "set-source-output-mute",  pa_cli_command_source_output_mute, "Set the mute switch of a source output (args: index, bool)", 3, 0 },
+    { "set-default-sink",        pa_cli_command_sink_default,       "Set the default sink (args: index|name)", 2, 0 },
+    { "set-default-source",      pa_cli_command_source_default,     "Set the default source (args: index|name)", 2, 0 },
+    { "set-card-profile",        pa_cli_command_card_profile,       "Change the profile of a card (args: index|name, profile-name)", 3, 0 },
+    { "set-sink-port",           pa_cli_command_sink_port,          "Change the port of a sink (args: index|name, port-name)", 3, 0 },
+    { "set-source-port",         pa_cli_command_source_port,        "Change the port of a source (args: index|name, port-name)", 3, 0 },
+    { "suspend-sink",            pa_cli_command_suspend_sink,       "Suspend sink (args: index|name, bool)", 3, 0 },
+    { "suspend-source",          pa_cli_command_suspend_source,     "Suspend source (args: index|name, bool)", 3, 0 },
+    { "suspend",                 pa_cli_command_suspend,            "Suspend all sinks and all sources (args: bool)", 2, 0 },
+    { "move-sink-input",         pa_cli_command_move_sink_input,    "Move sink input to another sink (args: index, sink)", 3, 0 },
+    { "move-source-output",      pa_cli_command_move_source_output, "Move source output to another source (args: index, source)", 3, 0 },
+    { "update-sink-proplist",    pa_cli_command_update_sink_proplist, "Update the properties of a sink (args: index|name, properties)", 3, 0 },
+    { "update-source-proplist",  pa_cli_command_update_source_proplist, "Update the properties of a source (args: index|name, properties)", 3, 0 },
+    { "update-sink-input-proplist", pa_cli_command_update_sink_input_proplist, "Update the properties of a sink input (args: index, properties)", 3, 0 },
+    { "update-source-output-proplist", pa_cli_command_update_source_output_proplist, "Update the properties of a source output (args: index, properties)", 3, 0 },
+    { "list-samples",            pa_cli_command_scache_list,        "List all entries in the sample cache", 1, PA_CLI_LIST_MASK(PA_CLI_LIST_SAMPLES) },
+    { "play-sample",             pa_cli_command_scache_play,        "Play a sample from the sample cache (args: name, sink|index)", 3, 0 },
+    { "remove-sample",           pa_cli_command_scache_remove,      "Remove a sample from the sample cache (args: name)", 2, 0 },
+    { "load-sample",             pa_cli_command_scache_load,        "Load a sound file into the sample cache (args: name, filename)", 3, 0 },
+    { "load-sample-lazy",        pa_cli_command_scache_load,        "Lazily load a sound file into the sample cache (args: name, filename)", 3, 0 },
+    { "load-sample-dir-lazy",    pa_cli_command_scache_load_dir,    "Lazily load all files in a directory into the sample cache (args: pathname)", 2, 0 },
+    { "kill-client",             pa_cli_command_kill_client,        "Kill a client (args: index)", 2, 0 },
+    { "kill-sink-input",         pa_cli_command_kill_sink_input,    "Kill a sink input (args: index)", 2, 0 },
+    { "kill-source-output",      pa_cli_command_kill_source_output, "Kill a source output (args: index)", 2, 0 },
+    { "set-log-level",           pa_cli_command_log_level,          "Change the log level (args: numeric level)", 2, 0 },
+    { "set-log-meta",            pa_cli_command_log_meta,           "Show source code location in log messages (args: bool)", 2, 0 },
+    { "set-log-time",            pa_cli_command_log_time,           "Show timestamps in log messages (args: bool)", 2, 0 },
+    { "set-log-backtrace",       pa_cli_command_log_backtrace,      "Show backtrace in log messages (args: frames)", 2, 0 },
+    { "play-file",               pa_cli_command_play_file,          "Play a sound file (args: filename, sink|index)", 3, 0 },
+    { "dump",                    pa_cli_command_dump,               "Dump daemon configuration", 1, 0 },
+    { "dump-volumes",            pa_cli_command_dump_volumes,       "Debug: Show the state of all volumes", 1, 0 },
+    { "shared",                  pa_cli_command_list_shared_props,  "Debug: Show shared properties", 1, 0 },
+    { "exit",                    pa_cli_command_exit,               "Terminate the daemon",         1, 0 },
+    { "restart",                 pa_cli_command_restart,            "Restart the daemon",           1, 0 },
+    { "vacuum",                  pa_cli_command_vacuum,             NULL, 1, 0 },
+    { NULL, NULL, NULL, 0, 0 }
 };
 
 static const char whitespace[] = " \t\n\r";
@@ -220,6 +228,18 @@ static int pa_cli_command_exit(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_b
     return 0;
 }
 
+static int pa_cli_command_restart(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_bool_t *fail) {
+    pa_core_assert_ref(c);
+    pa_assert(t);
+    pa_assert(buf);
+    pa_assert(fail);
+
+    if (pa_core_restart(c) < 0)
+        pa_strbuf_puts(buf, "Not allowed to restart daemon.\n");
+
+    return 0;
+}
+
 static int pa_cli_command_help(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_bool_t *fail) {
     const struct command*command;
 
@@ -236,102 +256,115 @@ static int pa_cli_command_help(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_b
     return 0;
 }
 
-static int pa_cli_command_modules(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_bool_t *fail) {
-    char *s;
+/* Sets up the listing of types for a command with the arguments in
+ * t, which may ask for the streams of one device only */
+static int make_list(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, unsigned types, pa_cli_list **list) {
+    const char *a;
+    uint32_t device = PA_INVALID_INDEX;
+
+    if ((a = pa_tokenizer_get(t, 1))) {
+        if (types == PA_CLI_LIST_MASK(PA_CLI_LIST_SINK_INPUTS) && pa_startswith(a, "sink=")) {
+            pa_sink *sink;
+
+            if (!(sink = pa_namereg_get(c, a + 5, PA_NAMEREG_SINK))) {
+                pa_strbuf_puts(buf, "No sink found by this name or index.\n");
+                return -1;
+            }
+
+            device = sink->index;
+        } else if (types == PA_CLI_LIST_MASK(PA_CLI_LIST_SOURCE_OUTPUTS) && pa_startswith(a, "source=")) {
+            pa_source *source;
+
+            if (!(source = pa_namereg_get(c, a + 7, PA_NAMEREG_SOURCE))) {
+                pa_strbuf_puts(buf, "No source found by this name or index.\n");
+                return -1;
+            }
+
+            device = source->index;
+        } else {
+            pa_strbuf_printf(buf, "Invalid argument: %s\n", a);
+            return -1;
+        }
+    }
+
+    *list = pa_cli_list_new(c, types, device);
+    return 0;
+}
+
+static int write_list(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, unsigned types) {
+    pa_cli_list *l;
 
+    if (make_list(c, t, buf, types, &l) < 0)
+        return -1;
+
+    while (pa_cli_list_next(l, buf, (unsigned) -1))
+        ;
+
+    pa_cli_list_free(l);
+    return 0;
+}
+
+static int pa_cli_command_modules(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_bool_t *fail) {
     pa_core_assert_ref(c);
     pa_assert(t);
     pa_assert(buf);
     pa_assert(fail);
 
-    pa_assert_se(s = pa_module_list_to_string(c));
-    pa_strbuf_puts(buf, s);
-    pa_xfree(s);
-    return 0;
+    return write_list(c, t, buf, PA_CLI_LIST_MASK(PA_CLI_LIST_MODULES));
 }
 
 static int pa_cli_command_clients(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_bool_t *fail) {
-    char *s;
-
     pa_core_assert_ref(c);
     pa_assert(t);
     pa_assert(buf);
     pa_assert(fail);
 
-    pa_assert_se(s = pa_client_list_to_string(c));
-    pa_strbuf_puts(buf, s);
-    pa_xfree(s);
-    return 0;
+    return write_list(c, t, buf, PA_CLI_LIST_MASK(PA_CLI_LIST_CLIENTS));
 }
 
 static int pa_cli_command_cards(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_bool_t *fail) {
-    char *s;
-
     pa_core_assert_ref(c);
     pa_assert(t);
     pa_assert(buf);
     pa_assert(fail);
 
-    pa_assert_se(s = pa_card_list_to_string(c));
-    pa_strbuf_puts(buf, s);
-    pa_xfree(s);
-    return 0;
+    return write_list(c, t, buf, PA_CLI_LIST_MASK(PA_CLI_LIST_CARDS));
 }
 
 static int pa_cli_command_sinks(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_bool_t *fail) {
-    char *s;
-
     pa_core_assert_ref(c);
     pa_assert(t);
     pa_assert(buf);
     pa_assert(fail);
 
-    pa_assert_se(s = pa_sink_list_to_string(c));
-    pa_strbuf_puts(buf, s);
-    pa_xfree(s);
-    return 0;
+    return write_list(c, t, buf, PA_CLI_LIST_MASK(PA_CLI_LIST_SINKS));
 }
 
 static int pa_cli_command_sources(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_bool_t *fail) {
-    char *s;
-
     pa_core_assert_ref(c);
     pa_assert(t);
     pa_assert(buf);
     pa_assert(fail);
 
-    pa_assert_se(s = pa_source_list_to_string(c));
-    pa_strbuf_puts(buf, s);
-    pa_xfree(s);
-    return 0;
+    return write_list(c, t, buf, PA_CLI_LIST_MASK(PA_CLI_LIST_SOURCES));
 }
 
 static int pa_cli_command_sink_inputs(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_bool_t *fail) {
-    char *s;
-
     pa_core_assert_ref(c);
     pa_assert(t);
     pa_assert(buf);
     pa_assert(fail);
 
-    pa_assert_se(s = pa_sink_input_list_to_string(c));
-    pa_strbuf_puts(buf, s);
-    pa_xfree(s);
-    return 0;
+    return write_list(c, t, buf, PA_CLI_LIST_MASK(PA_CLI_LIST_SINK_INPUTS));
 }
 
 static int pa_cli_command_source_outputs(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_bool_t *fail) {
-    char *s;
-
     pa_core_assert_ref(c);
     pa_assert(t);
     pa_assert(buf);
     pa_assert(fail);
 
-    pa_assert_se(s = pa_source_output_list_to_string(c));
-    pa_strbuf_puts(buf, s);
-    pa_xfree(s);
-    return 0;
+    return write_list(c, t, buf, PA_CLI_LIST_MASK(PA_CLI_LIST_SOURCE_OUTPUTS));
 }
 
 static int pa_cli_command_stat(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_bool_t *fail) {
@@ -339,7 +372,8 @@ static int pa_cli_command_stat(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_b
     char cm[PA_CHANNEL_MAP_SNPRINT_MAX];
     char bytes[PA_BYTES_SNPRINT_MAX];
     const pa_mempool_stat *mstat;
-    unsigned k;
+    pa_flist_stat *fstat;
+    unsigned k, n;
     pa_sink *def_sink;
     pa_source *def_source;
 
@@ -352,6 +386,57 @@ static int pa_cli_command_stat(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_b
         [PA_MEMBLOCK_IMPORTED] = "IMPORTED",
     };
 
+    static const char* const hook_table[PA_CORE_HOOK_MAX] = {
+        [PA_CORE_HOOK_SINK_NEW] = "sink-new",
+        [PA_CORE_HOOK_SINK_FIXATE] = "sink-fixate",
+        [PA_CORE_HOOK_SINK_PUT] = "sink-put",
+        [PA_CORE_HOOK_SINK_UNLINK] = "sink-unlink",
+        [PA_CORE_HOOK_SINK_UNLINK_POST] = "sink-unlink-post",
+        [PA_CORE_HOOK_SINK_STATE_CHANGED] = "sink-state-changed",
+        [PA_CORE_HOOK_SINK_PROPLIST_CHANGED] = "sink-proplist-changed",
+        [PA_CORE_HOOK_SINK_PORT_CHANGED] = "sink-port-changed",
+        [PA_CORE_HOOK_SOURCE_NEW] = "source-new",
+        [PA_CORE_HOOK_SOURCE_FIXATE] = "source-fixate",
+        [PA_CORE_HOOK_SOURCE_PUT] = "source-put",
+        [PA_CORE_HOOK_SOURCE_UNLINK] = "source-unlink",
+        [PA_CORE_HOOK_SOURCE_UNLINK_POST] = "source-unlink-post",
+        [PA_CORE_HOOK_SOURCE_STATE_CHANGED] = "source-state-changed",
+        [PA_CORE_HOOK_SOURCE_PROPLIST_CHANGED] = "source-proplist-changed",
+        [PA_CORE_HOOK_SOURCE_PORT_CHANGED] = "source-port-changed",
+        [PA_CORE_HOOK_SINK_INPUT_NEW] = "sink-input-new",
+        [PA_CORE_HOOK_SINK_INPUT_FIXATE] = "sink-input-fixate",
+        [PA_CORE_HOOK_SINK_INPUT_PUT] = "sink-input-put",
+        [PA_CORE_HOOK_SINK_INPUT_UNLINK] = "sink-input-unlink",
+        [PA_CORE_HOOK_SINK_INPUT_UNLINK_POST] = "sink-input-unlink-post",
+        [PA_CORE_HOOK_SINK_INPUT_MOVE_START] = "sink-input-move-start",
+        [PA_CORE_HOOK_SINK_INPUT_MOVE_FINISH] = "sink-input-move-finish",
+        [PA_CORE_HOOK_SINK_INPUT_MOVE_FAIL] = "sink-input-move-fail",
+        [PA_CORE_HOOK_SINK_INPUT_STATE_CHANGED] = "sink-input-state-changed",
+        [PA_CORE_HOOK_SINK_INPUT_PROPLIST_CHANGED] = "sink-input-proplist-changed",
+        [PA_CORE_HOOK_SINK_INPUT_SEND_EVENT] = "sink-input-send-event",
+        [PA_CORE_HOOK_SOURCE_OUTPUT_NEW] = "source-output-new",
+        [PA_CORE_HOOK_SOURCE_OUTPUT_FIXATE] = "source-output-fixate",
+        [PA_CORE_HOOK_SOURCE_OUTPUT_PUT] = "source-output-put",
+        [PA_CORE_HOOK_SOURCE_OUTPUT_UNLINK] = "source-output-unlink",
+        [PA_CORE_HOOK_SOURCE_OUTPUT_UNLINK_POST] = "source-output-unlink-post",
+        [PA_CORE_HOOK_SOURCE_OUTPUT_MOVE_START] = "source-output-move-start",
+        [PA_CORE_HOOK_SOURCE_OUTPUT_MOVE_FINISH] = "source-output-move-finish",
+        [PA_CORE_HOOK_SOURCE_OUTPUT_MOVE_FAIL] = "source-output-move-fail",
+        [PA_CORE_HOOK_SOURCE_OUTPUT_STATE_CHANGED] = "source-output-state-changed",
+        [PA_CORE_HOOK_SOURCE_OUTPUT_PROPLIST_CHANGED] = "source-output-proplist-changed",
+        [PA_CORE_HOOK_SOURCE_OUTPUT_SEND_EVENT] = "source-output-send-event",
+        [PA_CORE_HOOK_CLIENT_NEW] = "client-new",
+        [PA_CORE_HOOK_CLIENT_PUT] = "client-put",
+        [PA_CORE_HOOK_CLIENT_UNLINK] = "client-unlink",
+        [PA_CORE_HOOK_CLIENT_PROPLIST_CHANGED] = "client-proplist-changed",
+        [PA_CORE_HOOK_CLIENT_SEND_EVENT] = "client-send-event",
+        [PA_CORE_HOOK_CARD_NEW] = "card-new",
+        [PA_CORE_HOOK_CARD_PUT] = "card-put",
+        [PA_CORE_HOOK_CARD_UNLINK] = "card-unlink",
+        [PA_CORE_HOOK_CARD_PROFILE_CHANGED] = "card-profile-changed",
+        [PA_CORE_HOOK_PORT_AVAILABLE_CHANGED] = "port-available-changed"
+    };
+
     pa_core_assert_ref(c);
     pa_assert(t);
     pa_assert(buf);
@@ -375,6 +460,18 @@ static int pa_cli_command_stat(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_b
                      (unsigned) pa_atomic_load(&mstat->n_exported),
                      pa_bytes_snprint(bytes, sizeof(bytes), (unsigned) pa_atomic_load(&mstat->exported_size)));
 
+    pa_strbuf_printf(buf, "Memory blocks copied since they could not be exported: %u, size: %s.\n",
+                     (unsigned) pa_atomic_load(&mstat->n_export_failed),
+                     pa_bytes_snprint(bytes, sizeof(bytes), (unsigned) pa_atomic_load(&mstat->export_failed_size)));
+
+    pa_strbuf_printf(buf, "Free pool slots still resident: %u, size: %s.\n",
+                     (unsigned) pa_atomic_load(&mstat->n_free_resident),
+                     pa_bytes_snprint(bytes, sizeof(bytes), (unsigned) pa_atomic_load(&mstat->free_resident_size)));
+
+    pa_strbuf_printf(buf, "Free pool slots given back after being idle: %u, size: %s.\n",
+                     (unsigned) pa_atomic_load(&mstat->n_reclaimed),
+                     pa_bytes_snprint(bytes, sizeof(bytes), (unsigned) pa_atomic_load(&mstat->reclaimed_size)));
+
     pa_strbuf_printf(buf, "Total sample cache size: %s.\n",
                      pa_bytes_snprint(bytes, sizeof(bytes), (unsigned) pa_scache_total_size(c)));
 
@@ -398,6 +495,30 @@ static int pa_cli_command_stat(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_b
                          (unsigned) pa_atomic_load(&mstat->n_allocated_by_type[k]),
                          (unsigned) pa_atomic_load(&mstat->n_accumulated_by_type[k]));
 
+    fstat = pa_flist_get_stats(&n);
+    for (k = 0; k < n; k++)
+        pa_strbuf_printf(buf,
+                         "Free list %s: %llu cache hits/%llu misses.\n",
+                         fstat[k].name,
+                         (unsigned long long) fstat[k].hits,
+                         (unsigned long long) fstat[k].misses);
+    pa_xfree(fstat);
+
+    for (k = 0; k < PA_CORE_HOOK_MAX; k++) {
+        const pa_hook_stat *hstat = pa_hook_get_stat(&c->hooks[k]);
+
+        if (hstat->n_fired == 0)
+            continue;
+
+        pa_strbuf_printf(buf,
+                         "Hook %s: fired %llu times, %llu slots called/%llu skipped, %0.1f ms.\n",
+                         hook_table[k],
+                         (unsigned long long) hstat->n_fired,
+                         (unsigned long long) hstat->n_called,
+                         (unsigned long long) hstat->n_skipped,
+                         (double) hstat->time / PA_USEC_PER_MSEC);
+    }
+
     return 0;
 }
 
@@ -408,15 +529,7 @@ static int pa_cli_command_info(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_b
     pa_assert(fail);
 
     pa_cli_command_stat(c, t, buf, fail);
-    pa_cli_command_modules(c, t, buf, fail);
-    pa_cli_command_sinks(c, t, buf, fail);
-    pa_cli_command_sources(c, t, buf, fail);
-    pa_cli_command_clients(c, t, buf, fail);
-    pa_cli_command_cards(c, t, buf, fail);
-    pa_cli_command_sink_inputs(c, t, buf, fail);
-    pa_cli_command_source_outputs(c, t, buf, fail);
-    pa_cli_command_scache_list(c, t, buf, fail);
-    return 0;
+    return write_list(c, t, buf, PA_CLI_LIST_ALL);
 }
 
 static int pa_cli_command_load(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_bool_t *fail) {
@@ -432,6 +545,15 @@ static int pa_cli_command_load(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_b
         return -1;
     }
 
+    /* Whether a deferred module loads can't be known yet */
+    if (c->defer_module_loading) {
+        if (pa_module_load_deferred(c, name, pa_tokenizer_get(t, 2)) < 0) {
+            pa_strbuf_puts(buf, "Module load failed.\n");
+            return -1;
+        }
+        return 0;
+    }
+
     if (!pa_module_load(c, name,  pa_tokenizer_get(t, 2))) {
         pa_strbuf_puts(buf, "Module load failed.\n");
         return -1;
@@ -1132,18 +1254,12 @@ static int pa_cli_command_kill_source_output(pa_core *c, pa_tokenizer *t, pa_str
 }
 
 static int pa_cli_command_scache_list(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_bool_t *fail) {
-    char *s;
-
     pa_core_assert_ref(c);
     pa_assert(t);
     pa_assert(buf);
     pa_assert(fail);
 
-    pa_assert_se(s = pa_scache_list_to_string(c));
-    pa_strbuf_puts(buf, s);
-    pa_xfree(s);
-
-    return 0;
+    return write_list(c, t, buf, PA_CLI_LIST_MASK(PA_CLI_LIST_SAMPLES));
 }
 
 static int pa_cli_command_scache_play(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_bool_t *fail) {
@@ -1816,7 +1932,7 @@ static int pa_cli_command_dump_volumes(pa_core *c, pa_tokenizer *t, pa_strbuf *b
     return 0;
 }
 
-int pa_cli_command_execute_line_stateful(pa_core *c, const char *s, pa_strbuf *buf, pa_bool_t *fail, int *ifstate) {
+static int execute_line(pa_core *c, const char *s, pa_strbuf *buf, pa_bool_t *fail, int *ifstate, pa_bool_t *defer, pa_cli_list **list) {
     const char *cs;
 
     pa_assert(c);
@@ -1851,7 +1967,13 @@ int pa_cli_command_execute_line_stateful(pa_core *c, const char *s, pa_strbuf *b
             *fail = TRUE;
         else if (!strcmp(cs, META_NOFAIL))
             *fail = FALSE;
-        else {
+        else if (!strcmp(cs, META_DEFER) || !strcmp(cs, META_NODEFER)) {
+            if (!defer) {
+                pa_strbuf_printf(buf, "Meta command %s is not valid in this context\n", cs);
+                return -1;
+            }
+            *defer = !strcmp(cs, META_DEFER);
+        } else {
             size_t l;
             l = strcspn(cs, whitespace);
 
@@ -1984,7 +2106,20 @@ int pa_cli_command_execute_line_stateful(pa_core *c, const char *s, pa_strbuf *b
                 int ret;
                 pa_tokenizer *t = pa_tokenizer_new(cs, command->args);
                 pa_assert(t);
-                ret = command->proc(c, t, buf, fail);
+
+                if (list && command->list) {
+                    /* "info" starts with the memory statistics */
+                    if (command->list == PA_CLI_LIST_ALL)
+                        pa_cli_command_stat(c, t, buf, fail);
+
+                    ret = make_list(c, t, buf, command->list, list);
+                } else {
+                    /* Only for the duration of this command, so that the
+                     * state can't outlive the script that set it */
+                    c->defer_module_loading = defer && *defer;
+                    ret = command->proc(c, t, buf, fail);
+                    c->defer_module_loading = FALSE;
+                }
                 pa_tokenizer_free(t);
                 unknown = 0;
 
@@ -2004,13 +2139,25 @@ int pa_cli_command_execute_line_stateful(pa_core *c, const char *s, pa_strbuf *b
     return 0;
 }
 
+int pa_cli_command_execute_line_stateful(pa_core *c, const char *s, pa_strbuf *buf, pa_bool_t *fail, int *ifstate) {
+    return execute_line(c, s, buf, fail, ifstate, NULL, NULL);
+}
+
 int pa_cli_command_execute_line(pa_core *c, const char *s, pa_strbuf *buf, pa_bool_t *fail) {
-    return pa_cli_command_execute_line_stateful(c, s, buf, fail, NULL);
+    return execute_line(c, s, buf, fail, NULL, NULL, NULL);
+}
+
+int pa_cli_command_execute_line_list(pa_core *c, const char *s, pa_strbuf *buf, pa_bool_t *fail, pa_cli_list **list) {
+    pa_assert(list);
+
+    *list = NULL;
+    return execute_line(c, s, buf, fail, NULL, NULL, list);
 }
 
 int pa_cli_command_execute_file_stream(pa_core *c, FILE *f, pa_strbuf *buf, pa_bool_t *fail) {
     char line[2048];
     int ifstate = IFSTATE_NONE;
+    pa_bool_t defer = FALSE;
     int ret = -1;
     pa_bool_t _fail = TRUE;
 
@@ -2024,7 +2171,7 @@ int pa_cli_command_execute_file_stream(pa_core *c, FILE *f, pa_strbuf *buf, pa_b
     while (fgets(line, sizeof(line), f)) {
         pa_strip_nl(line);
 
-        if (pa_cli_command_execute_line_stateful(c, line, buf, fail, &ifstate) < 0 && *fail)
+        if (execute_line(c, line, buf, fail, &ifstate, &defer, NULL) < 0 && *fail)
             goto fail;
     }
 
@@ -2067,6 +2214,7 @@ fail:
 int pa_cli_command_execute(pa_core *c, const char *s, pa_strbuf *buf, pa_bool_t *fail) {
     const char *p;
     int ifstate = IFSTATE_NONE;
+    pa_bool_t defer = FALSE;
     pa_bool_t _fail = TRUE;
 
     pa_assert(c);
@@ -2081,7 +2229,7 @@ int pa_cli_command_execute(pa_core *c, const char *s, pa_strbuf *buf, pa_bool_t
         size_t l = strcspn(p, linebreak);
         char *line = pa_xstrndup(p, l);
 
-        if (pa_cli_command_execute_line_stateful(c, line, buf, fail, &ifstate) < 0 && *fail) {
+        if (execute_line(c, line, buf, fail, &ifstate, &defer, NULL) < 0 && *fail) {
             pa_xfree(line);
             return -1;
         }
@@ -24,6 +24,7 @@
 
 #include <pulsecore/strbuf.h>
 #include <pulsecore/core.h>
+#include <pulsecore/cli-text.h>
 
 /* Execute a single CLI command. Write the results to the string
  * buffer *buf. If *fail is non-zero the function will return -1 when
@@ -31,6 +32,12 @@
  * may be modified by the function call. */
 int pa_cli_command_execute_line(pa_core *c, const char *s, pa_strbuf *buf, pa_bool_t *fail);
 
+/* Like pa_cli_command_execute_line(), but listings are not written to
+ * buf. Instead *list is set, for the caller to write with
+ * pa_cli_list_next() and free. Anything else the command has to say
+ * is in buf. */
+int pa_cli_command_execute_line_list(pa_core *c, const char *s, pa_strbuf *buf, pa_bool_t *fail, pa_cli_list **list);
+
 /* Execute a whole file of CLI commands */
 int pa_cli_command_execute_file(pa_core *c, const char *fn, pa_strbuf *buf, pa_bool_t *fail);
 
@@ -40,66 +40,40 @@
 
 #include "cli-text.h"
 
-char *pa_module_list_to_string(pa_core *c) {
-    pa_strbuf *s;
-    pa_module *m;
-    uint32_t idx = PA_IDXSET_INVALID;
-    pa_assert(c);
-
-    s = pa_strbuf_new();
-
-    pa_strbuf_printf(s, "%u module(s) loaded.\n", pa_idxset_size(c->modules));
-
-    for (m = pa_idxset_first(c->modules, &idx); m; m = pa_idxset_next(c->modules, &idx)) {
-        char *t;
-
-        pa_strbuf_printf(s, "    index: %u\n"
-                         "\tname: <%s>\n"
-                         "\targument: <%s>\n"
-                         "\tused: %i\n"
-                         "\tload once: %s\n",
-                         m->index,
-                         m->name,
-                         pa_strempty(m->argument),
-                         pa_module_get_n_used(m),
-                         pa_yes_no(m->load_once));
-
-        t = pa_proplist_to_string_sep(m->proplist, "\n\t\t");
-        pa_strbuf_printf(s, "\tproperties:\n\t\t%s\n", t);
-        pa_xfree(t);
-    }
-
-    return pa_strbuf_tostring_free(s);
+static void append_module(pa_strbuf *s, pa_core *c, pa_module *m) {
+    char *t;
+
+    pa_strbuf_printf(s, "    index: %u\n"
+                     "\tname: <%s>\n"
+                     "\targument: <%s>\n"
+                     "\tused: %i\n"
+                     "\tload once: %s\n",
+                     m->index,
+                     m->name,
+                     pa_strempty(m->argument),
+                     pa_module_get_n_used(m),
+                     pa_yes_no(m->load_once));
+
+    t = pa_proplist_to_string_sep(m->proplist, "\n\t\t");
+    pa_strbuf_printf(s, "\tproperties:\n\t\t%s\n", t);
+    pa_xfree(t);
 }
 
-char *pa_client_list_to_string(pa_core *c) {
-    pa_strbuf *s;
-    pa_client *client;
-    uint32_t idx = PA_IDXSET_INVALID;
-    pa_assert(c);
-
-    s = pa_strbuf_new();
-
-    pa_strbuf_printf(s, "%u client(s) logged in.\n", pa_idxset_size(c->clients));
-
-    for (client = pa_idxset_first(c->clients, &idx); client; client = pa_idxset_next(c->clients, &idx)) {
-        char *t;
-        pa_strbuf_printf(
-                s,
-                "    index: %u\n"
-                "\tdriver: <%s>\n",
-                client->index,
-                client->driver);
-
-        if (client->module)
-            pa_strbuf_printf(s, "\towner module: %u\n", client->module->index);
+static void append_client(pa_strbuf *s, pa_core *c, pa_client *client) {
+    char *t;
+    pa_strbuf_printf(
+            s,
+            "    index: %u\n"
+            "\tdriver: <%s>\n",
+            client->index,
+            client->driver);
 
-        t = pa_proplist_to_string_sep(client->proplist, "\n\t\t");
-        pa_strbuf_printf(s, "\tproperties:\n\t\t%s\n", t);
-        pa_xfree(t);
-    }
+    if (client->module)
+        pa_strbuf_printf(s, "\towner module: %u\n", client->module->index);
 
-    return pa_strbuf_tostring_free(s);
+    t = pa_proplist_to_string_sep(client->proplist, "\n\t\t");
+    pa_strbuf_printf(s, "\tproperties:\n\t\t%s\n", t);
+    pa_xfree(t);
 }
 
 static const char *port_available_to_string(pa_port_available_t a) {
@@ -133,69 +107,56 @@ static void append_port_list(pa_strbuf *s, pa_hashmap *ports)
     }
 }
 
-char *pa_card_list_to_string(pa_core *c) {
-    pa_strbuf *s;
-    pa_card *card;
-    uint32_t idx = PA_IDXSET_INVALID;
-    pa_assert(c);
-
-    s = pa_strbuf_new();
-
-    pa_strbuf_printf(s, "%u card(s) available.\n", pa_idxset_size(c->cards));
+static void append_card(pa_strbuf *s, pa_core *c, pa_card *card) {
+    char *t;
+    pa_sink *sink;
+    pa_source *source;
+    uint32_t sidx;
 
-    for (card = pa_idxset_first(c->cards, &idx); card; card = pa_idxset_next(c->cards, &idx)) {
-        char *t;
-        pa_sink *sink;
-        pa_source *source;
-        uint32_t sidx;
+    pa_strbuf_printf(
+            s,
+            "    index: %u\n"
+            "\tname: <%s>\n"
+            "\tdriver: <%s>\n",
+            card->index,
+            card->name,
+            card->driver);
 
-        pa_strbuf_printf(
-                s,
-                "    index: %u\n"
-                "\tname: <%s>\n"
-                "\tdriver: <%s>\n",
-                card->index,
-                card->name,
-                card->driver);
-
-        if (card->module)
-            pa_strbuf_printf(s, "\towner module: %u\n", card->module->index);
-
-        t = pa_proplist_to_string_sep(card->proplist, "\n\t\t");
-        pa_strbuf_printf(s, "\tproperties:\n\t\t%s\n", t);
-        pa_xfree(t);
+    if (card->module)
+        pa_strbuf_printf(s, "\towner module: %u\n", card->module->index);
 
-        if (card->profiles) {
-            pa_card_profile *p;
-            void *state;
+    t = pa_proplist_to_string_sep(card->proplist, "\n\t\t");
+    pa_strbuf_printf(s, "\tproperties:\n\t\t%s\n", t);
+    pa_xfree(t);
 
-            pa_strbuf_puts(s, "\tprofiles:\n");
-            PA_HASHMAP_FOREACH(p, card->profiles, state)
-                pa_strbuf_printf(s, "\t\t%s: %s (priority %u)\n", p->name, p->description, p->priority);
-        }
+    if (card->profiles) {
+        pa_card_profile *p;
+        void *state;
 
-        if (card->active_profile)
-            pa_strbuf_printf(
-                    s,
-                    "\tactive profile: <%s>\n",
-                    card->active_profile->name);
+        pa_strbuf_puts(s, "\tprofiles:\n");
+        PA_HASHMAP_FOREACH(p, card->profiles, state)
+            pa_strbuf_printf(s, "\t\t%s: %s (priority %u)\n", p->name, p->description, p->priority);
+    }
 
-        if (!pa_idxset_isempty(card->sinks)) {
-            pa_strbuf_puts(s, "\tsinks:\n");
-            for (sink = pa_idxset_first(card->sinks, &sidx); sink; sink = pa_idxset_next(card->sinks, &sidx))
-                pa_strbuf_printf(s, "\t\t%s/#%u: %s\n", sink->name, sink->index, pa_strna(pa_proplist_gets(sink->proplist, PA_PROP_DEVICE_DESCRIPTION)));
-        }
+    if (card->active_profile)
+        pa_strbuf_printf(
+                s,
+                "\tactive profile: <%s>\n",
+                card->active_profile->name);
 
-        if (!pa_idxset_isempty(card->sources)) {
-            pa_strbuf_puts(s, "\tsources:\n");
-            for (source = pa_idxset_first(card->sources, &sidx); source; source = pa_idxset_next(card->sources, &sidx))
-                pa_strbuf_printf(s, "\t\t%s/#%u: %s\n", source->name, source->index, pa_strna(pa_proplist_gets(source->proplist, PA_PROP_DEVICE_DESCRIPTION)));
-        }
+    if (!pa_idxset_isempty(card->sinks)) {
+        pa_strbuf_puts(s, "\tsinks:\n");
+        for (sink = pa_idxset_first(card->sinks, &sidx); sink; sink = pa_idxset_next(card->sinks, &sidx))
+            pa_strbuf_printf(s, "\t\t%s/#%u: %s\n", sink->name, sink->index, pa_strna(pa_proplist_gets(sink->proplist, PA_PROP_DEVICE_DESCRIPTION)));
+    }
 
-        append_port_list(s, card->ports);
+    if (!pa_idxset_isempty(card->sources)) {
+        pa_strbuf_puts(s, "\tsources:\n");
+        for (source = pa_idxset_first(card->sources, &sidx); source; source = pa_idxset_next(card->sources, &sidx))
+            pa_strbuf_printf(s, "\t\t%s/#%u: %s\n", source->name, source->index, pa_strna(pa_proplist_gets(source->proplist, PA_PROP_DEVICE_DESCRIPTION)));
     }
 
-    return pa_strbuf_tostring_free(s);
+    append_port_list(s, card->ports);
 }
 
 static const char *sink_state_to_string(pa_sink_state_t state) {
@@ -232,494 +193,657 @@ static const char *source_state_to_string(pa_source_state_t state) {
     }
 }
 
-char *pa_sink_list_to_string(pa_core *c) {
-    pa_strbuf *s;
-    pa_sink *sink;
-    uint32_t idx = PA_IDXSET_INVALID;
-    pa_assert(c);
-
-    s = pa_strbuf_new();
+static void append_sink(pa_strbuf *s, pa_core *c, pa_sink *sink) {
+    char ss[PA_SAMPLE_SPEC_SNPRINT_MAX],
+        cv[PA_CVOLUME_SNPRINT_MAX],
+        cvdb[PA_SW_CVOLUME_SNPRINT_DB_MAX],
+        v[PA_VOLUME_SNPRINT_MAX],
+        vdb[PA_SW_VOLUME_SNPRINT_DB_MAX],
+        cm[PA_CHANNEL_MAP_SNPRINT_MAX], *t;
+    const char *cmn;
+
+    cmn = pa_channel_map_to_pretty_name(&sink->channel_map);
+
+
+    pa_strbuf_printf(
+        s,
+        "  %c index: %u\n"
+        "\tname: <%s>\n"
+        "\tdriver: <%s>\n"
+        "\tflags: %s%s%s%s%s%s%s%s\n"
+        "\tstate: %s\n"
+        "\tsuspend cause: %s%s%s%s\n"
+        "\tpriority: %u\n"
+        "\tvolume: %s%s%s\n"
+        "\t        balance %0.2f\n"
+        "\tbase volume: %s%s%s\n"
+        "\tvolume steps: %u\n"
+        "\tmuted: %s\n"
+        "\tcurrent latency: %0.2f ms\n"
+        "\tmax request: %lu KiB\n"
+        "\tmax rewind: %lu KiB\n"
+        "\tmonitor source: %u\n"
+        "\tsample spec: %s\n"
+        "\tchannel map: %s%s%s\n"
+        "\tused by: %u\n"
+        "\tlinked by: %u\n",
+        sink == c->default_sink ? '*' : ' ',
+        sink->index,
+        sink->name,
+        sink->driver,
+        sink->flags & PA_SINK_HARDWARE ? "HARDWARE " : "",
+        sink->flags & PA_SINK_NETWORK ? "NETWORK " : "",
+        sink->flags & PA_SINK_HW_MUTE_CTRL ? "HW_MUTE_CTRL " : "",
+        sink->flags & PA_SINK_HW_VOLUME_CTRL ? "HW_VOLUME_CTRL " : "",
+        sink->flags & PA_SINK_DECIBEL_VOLUME ? "DECIBEL_VOLUME " : "",
+        sink->flags & PA_SINK_LATENCY ? "LATENCY " : "",
+        sink->flags & PA_SINK_FLAT_VOLUME ? "FLAT_VOLUME " : "",
+        sink->flags & PA_SINK_DYNAMIC_LATENCY ? "DYNAMIC_LATENCY" : "",
+        sink_state_to_string(pa_sink_get_state(sink)),
+        sink->suspend_cause & PA_SUSPEND_USER ? "USER " : "",
+        sink->suspend_cause & PA_SUSPEND_APPLICATION ? "APPLICATION " : "",
+        sink->suspend_cause & PA_SUSPEND_IDLE ? "IDLE " : "",
+        sink->suspend_cause & PA_SUSPEND_SESSION ? "SESSION" : "",
+        sink->priority,
+        pa_cvolume_snprint(cv, sizeof(cv), pa_sink_get_volume(sink, FALSE)),
+        sink->flags & PA_SINK_DECIBEL_VOLUME ? "\n\t        " : "",
+        sink->flags & PA_SINK_DECIBEL_VOLUME ? pa_sw_cvolume_snprint_dB(cvdb, sizeof(cvdb), pa_sink_get_volume(sink, FALSE)) : "",
+        pa_cvolume_get_balance(pa_sink_get_volume(sink, FALSE), &sink->channel_map),
+        pa_volume_snprint(v, sizeof(v), sink->base_volume),
+        sink->flags & PA_SINK_DECIBEL_VOLUME ? "\n\t             " : "",
+        sink->flags & PA_SINK_DECIBEL_VOLUME ? pa_sw_volume_snprint_dB(vdb, sizeof(vdb), sink->base_volume) : "",
+        sink->n_volume_steps,
+        pa_yes_no(pa_sink_get_mute(sink, FALSE)),
+        (double) pa_sink_get_latency(sink) / (double) PA_USEC_PER_MSEC,
+        (unsigned long) pa_sink_get_max_request(sink) / 1024,
+        (unsigned long) pa_sink_get_max_rewind(sink) / 1024,
+        sink->monitor_source ? sink->monitor_source->index : PA_INVALID_INDEX,
+        pa_sample_spec_snprint(ss, sizeof(ss), &sink->sample_spec),
+        pa_channel_map_snprint(cm, sizeof(cm), &sink->channel_map),
+        cmn ? "\n\t             " : "",
+        cmn ? cmn : "",
+        pa_sink_used_by(sink),
+        pa_sink_linked_by(sink));
+
+    if (sink->flags & PA_SINK_DYNAMIC_LATENCY) {
+        pa_usec_t min_latency, max_latency;
+        pa_sink_get_latency_range(sink, &min_latency, &max_latency);
 
-    pa_strbuf_printf(s, "%u sink(s) available.\n", pa_idxset_size(c->sinks));
+        pa_strbuf_printf(
+                s,
+                "\tconfigured latency: %0.2f ms; range is %0.2f .. %0.2f ms\n",
+                (double) pa_sink_get_requested_latency(sink) / (double) PA_USEC_PER_MSEC,
+                (double) min_latency / PA_USEC_PER_MSEC,
+                (double) max_latency / PA_USEC_PER_MSEC);
+    } else
+        pa_strbuf_printf(
+                s,
+                "\tfixed latency: %0.2f ms\n",
+                (double) pa_sink_get_fixed_latency(sink) / PA_USEC_PER_MSEC);
 
-    for (sink = pa_idxset_first(c->sinks, &idx); sink; sink = pa_idxset_next(c->sinks, &idx)) {
-        char ss[PA_SAMPLE_SPEC_SNPRINT_MAX],
-            cv[PA_CVOLUME_SNPRINT_MAX],
-            cvdb[PA_SW_CVOLUME_SNPRINT_DB_MAX],
-            v[PA_VOLUME_SNPRINT_MAX],
-            vdb[PA_SW_VOLUME_SNPRINT_DB_MAX],
-            cm[PA_CHANNEL_MAP_SNPRINT_MAX], *t;
-        const char *cmn;
+    if (sink->card)
+        pa_strbuf_printf(s, "\tcard: %u <%s>\n", sink->card->index, sink->card->name);
+    if (sink->module)
+        pa_strbuf_printf(s, "\tmodule: %u\n", sink->module->index);
 
-        cmn = pa_channel_map_to_pretty_name(&sink->channel_map);
+    t = pa_proplist_to_string_sep(sink->proplist, "\n\t\t");
+    pa_strbuf_printf(s, "\tproperties:\n\t\t%s\n", t);
+    pa_xfree(t);
 
+    append_port_list(s, sink->ports);
 
+    if (sink->active_port)
         pa_strbuf_printf(
-            s,
-            "  %c index: %u\n"
-            "\tname: <%s>\n"
-            "\tdriver: <%s>\n"
-            "\tflags: %s%s%s%s%s%s%s%s\n"
-            "\tstate: %s\n"
-            "\tsuspend cause: %s%s%s%s\n"
-            "\tpriority: %u\n"
-            "\tvolume: %s%s%s\n"
-            "\t        balance %0.2f\n"
-            "\tbase volume: %s%s%s\n"
-            "\tvolume steps: %u\n"
-            "\tmuted: %s\n"
-            "\tcurrent latency: %0.2f ms\n"
-            "\tmax request: %lu KiB\n"
-            "\tmax rewind: %lu KiB\n"
-            "\tmonitor source: %u\n"
-            "\tsample spec: %s\n"
-            "\tchannel map: %s%s%s\n"
-            "\tused by: %u\n"
-            "\tlinked by: %u\n",
-            sink == c->default_sink ? '*' : ' ',
-            sink->index,
-            sink->name,
-            sink->driver,
-            sink->flags & PA_SINK_HARDWARE ? "HARDWARE " : "",
-            sink->flags & PA_SINK_NETWORK ? "NETWORK " : "",
-            sink->flags & PA_SINK_HW_MUTE_CTRL ? "HW_MUTE_CTRL " : "",
-            sink->flags & PA_SINK_HW_VOLUME_CTRL ? "HW_VOLUME_CTRL " : "",
-            sink->flags & PA_SINK_DECIBEL_VOLUME ? "DECIBEL_VOLUME " : "",
-            sink->flags & PA_SINK_LATENCY ? "LATENCY " : "",
-            sink->flags & PA_SINK_FLAT_VOLUME ? "FLAT_VOLUME " : "",
-            sink->flags & PA_SINK_DYNAMIC_LATENCY ? "DYNAMIC_LATENCY" : "",
-            sink_state_to_string(pa_sink_get_state(sink)),
-            sink->suspend_cause & PA_SUSPEND_USER ? "USER " : "",
-            sink->suspend_cause & PA_SUSPEND_APPLICATION ? "APPLICATION " : "",
-            sink->suspend_cause & PA_SUSPEND_IDLE ? "IDLE " : "",
-            sink->suspend_cause & PA_SUSPEND_SESSION ? "SESSION" : "",
-            sink->priority,
-            pa_cvolume_snprint(cv, sizeof(cv), pa_sink_get_volume(sink, FALSE)),
-            sink->flags & PA_SINK_DECIBEL_VOLUME ? "\n\t        " : "",
-            sink->flags & PA_SINK_DECIBEL_VOLUME ? pa_sw_cvolume_snprint_dB(cvdb, sizeof(cvdb), pa_sink_get_volume(sink, FALSE)) : "",
-            pa_cvolume_get_balance(pa_sink_get_volume(sink, FALSE), &sink->channel_map),
-            pa_volume_snprint(v, sizeof(v), sink->base_volume),
-            sink->flags & PA_SINK_DECIBEL_VOLUME ? "\n\t             " : "",
-            sink->flags & PA_SINK_DECIBEL_VOLUME ? pa_sw_volume_snprint_dB(vdb, sizeof(vdb), sink->base_volume) : "",
-            sink->n_volume_steps,
-            pa_yes_no(pa_sink_get_mute(sink, FALSE)),
-            (double) pa_sink_get_latency(sink) / (double) PA_USEC_PER_MSEC,
-            (unsigned long) pa_sink_get_max_request(sink) / 1024,
-            (unsigned long) pa_sink_get_max_rewind(sink) / 1024,
-            sink->monitor_source ? sink->monitor_source->index : PA_INVALID_INDEX,
-            pa_sample_spec_snprint(ss, sizeof(ss), &sink->sample_spec),
-            pa_channel_map_snprint(cm, sizeof(cm), &sink->channel_map),
-            cmn ? "\n\t             " : "",
-            cmn ? cmn : "",
-            pa_sink_used_by(sink),
-            pa_sink_linked_by(sink));
-
-        if (sink->flags & PA_SINK_DYNAMIC_LATENCY) {
-            pa_usec_t min_latency, max_latency;
-            pa_sink_get_latency_range(sink, &min_latency, &max_latency);
-
-            pa_strbuf_printf(
-                    s,
-                    "\tconfigured latency: %0.2f ms; range is %0.2f .. %0.2f ms\n",
-                    (double) pa_sink_get_requested_latency(sink) / (double) PA_USEC_PER_MSEC,
-                    (double) min_latency / PA_USEC_PER_MSEC,
-                    (double) max_latency / PA_USEC_PER_MSEC);
-        } else
-            pa_strbuf_printf(
-                    s,
-                    "\tfixed latency: %0.2f ms\n",
-                    (double) pa_sink_get_fixed_latency(sink) / PA_USEC_PER_MSEC);
-
-        if (sink->card)
-            pa_strbuf_printf(s, "\tcard: %u <%s>\n", sink->card->index, sink->card->name);
-        if (sink->module)
-            pa_strbuf_printf(s, "\tmodule: %u\n", sink->module->index);
-
-        t = pa_proplist_to_string_sep(sink->proplist, "\n\t\t");
-        pa_strbuf_printf(s, "\tproperties:\n\t\t%s\n", t);
-        pa_xfree(t);
-
-        append_port_list(s, sink->ports);
-
-        if (sink->active_port)
-            pa_strbuf_printf(
-                    s,
-                    "\tactive port: <%s>\n",
-                    sink->active_port->name);
-    }
-
-    return pa_strbuf_tostring_free(s);
+                s,
+                "\tactive port: <%s>\n",
+                sink->active_port->name);
 }
 
-char *pa_source_list_to_string(pa_core *c) {
-    pa_strbuf *s;
-    pa_source *source;
-    uint32_t idx = PA_IDXSET_INVALID;
-    pa_assert(c);
+static void append_source(pa_strbuf *s, pa_core *c, pa_source *source) {
+    char ss[PA_SAMPLE_SPEC_SNPRINT_MAX],
+        cv[PA_CVOLUME_SNPRINT_MAX],
+        cvdb[PA_SW_CVOLUME_SNPRINT_DB_MAX],
+        v[PA_VOLUME_SNPRINT_MAX],
+        vdb[PA_SW_VOLUME_SNPRINT_DB_MAX],
+        cm[PA_CHANNEL_MAP_SNPRINT_MAX], *t;
+    const char *cmn;
+
+    cmn = pa_channel_map_to_pretty_name(&source->channel_map);
+
+    pa_strbuf_printf(
+        s,
+        "  %c index: %u\n"
+        "\tname: <%s>\n"
+        "\tdriver: <%s>\n"
+        "\tflags: %s%s%s%s%s%s%s\n"
+        "\tstate: %s\n"
+        "\tsuspend cause: %s%s%s%s\n"
+        "\tpriority: %u\n"
+        "\tvolume: %s%s%s\n"
+        "\t        balance %0.2f\n"
+        "\tbase volume: %s%s%s\n"
+        "\tvolume steps: %u\n"
+        "\tmuted: %s\n"
+        "\tcurrent latency: %0.2f ms\n"
+        "\tmax rewind: %lu KiB\n"
+        "\tsample spec: %s\n"
+        "\tchannel map: %s%s%s\n"
+        "\tused by: %u\n"
+        "\tlinked by: %u\n",
+        c->default_source == source ? '*' : ' ',
+        source->index,
+        source->name,
+        source->driver,
+        source->flags & PA_SOURCE_HARDWARE ? "HARDWARE " : "",
+        source->flags & PA_SOURCE_NETWORK ? "NETWORK " : "",
+        source->flags & PA_SOURCE_HW_MUTE_CTRL ? "HW_MUTE_CTRL " : "",
+        source->flags & PA_SOURCE_HW_VOLUME_CTRL ? "HW_VOLUME_CTRL " : "",
+        source->flags & PA_SOURCE_DECIBEL_VOLUME ? "DECIBEL_VOLUME " : "",
+        source->flags & PA_SOURCE_LATENCY ? "LATENCY " : "",
+        source->flags & PA_SOURCE_DYNAMIC_LATENCY ? "DYNAMIC_LATENCY" : "",
+        source_state_to_string(pa_source_get_state(source)),
+        source->suspend_cause & PA_SUSPEND_USER ? "USER " : "",
+        source->suspend_cause & PA_SUSPEND_APPLICATION ? "APPLICATION " : "",
+        source->suspend_cause & PA_SUSPEND_IDLE ? "IDLE " : "",
+        source->suspend_cause & PA_SUSPEND_SESSION ? "SESSION" : "",
+        source->priority,
+        pa_cvolume_snprint(cv, sizeof(cv), pa_source_get_volume(source, FALSE)),
+        source->flags & PA_SOURCE_DECIBEL_VOLUME ? "\n\t        " : "",
+        source->flags & PA_SOURCE_DECIBEL_VOLUME ? pa_sw_cvolume_snprint_dB(cvdb, sizeof(cvdb), pa_source_get_volume(source, FALSE)) : "",
+        pa_cvolume_get_balance(pa_source_get_volume(source, FALSE), &source->channel_map),
+        pa_volume_snprint(v, sizeof(v), source->base_volume),
+        source->flags & PA_SOURCE_DECIBEL_VOLUME ? "\n\t             " : "",
+        source->flags & PA_SOURCE_DECIBEL_VOLUME ? pa_sw_volume_snprint_dB(vdb, sizeof(vdb), source->base_volume) : "",
+        source->n_volume_steps,
+        pa_yes_no(pa_source_get_mute(source, FALSE)),
+        (double) pa_source_get_latency(source) / PA_USEC_PER_MSEC,
+        (unsigned long) pa_source_get_max_rewind(source) / 1024,
+        pa_sample_spec_snprint(ss, sizeof(ss), &source->sample_spec),
+        pa_channel_map_snprint(cm, sizeof(cm), &source->channel_map),
+        cmn ? "\n\t             " : "",
+        cmn ? cmn : "",
+        pa_source_used_by(source),
+        pa_source_linked_by(source));
+
+    if (source->flags & PA_SOURCE_DYNAMIC_LATENCY) {
+        pa_usec_t min_latency, max_latency;
+        pa_source_get_latency_range(source, &min_latency, &max_latency);
 
-    s = pa_strbuf_new();
+        pa_strbuf_printf(
+                s,
+                "\tconfigured latency: %0.2f ms; range is %0.2f .. %0.2f ms\n",
+                (double) pa_source_get_requested_latency(source) / PA_USEC_PER_MSEC,
+                (double) min_latency / PA_USEC_PER_MSEC,
+                (double) max_latency / PA_USEC_PER_MSEC);
+    } else
+        pa_strbuf_printf(
+                s,
+                "\tfixed latency: %0.2f ms\n",
+                (double) pa_source_get_fixed_latency(source) / PA_USEC_PER_MSEC);
 
-    pa_strbuf_printf(s, "%u source(s) available.\n", pa_idxset_size(c->sources));
+    if (source->monitor_of)
+        pa_strbuf_printf(s, "\tmonitor_of: %u\n", source->monitor_of->index);
+    if (source->card)
+        pa_strbuf_printf(s, "\tcard: %u <%s>\n", source->card->index, source->card->name);
+    if (source->module)
+        pa_strbuf_printf(s, "\tmodule: %u\n", source->module->index);
 
-    for (source = pa_idxset_first(c->sources, &idx); source; source = pa_idxset_next(c->sources, &idx)) {
-        char ss[PA_SAMPLE_SPEC_SNPRINT_MAX],
-            cv[PA_CVOLUME_SNPRINT_MAX],
-            cvdb[PA_SW_CVOLUME_SNPRINT_DB_MAX],
-            v[PA_VOLUME_SNPRINT_MAX],
-            vdb[PA_SW_VOLUME_SNPRINT_DB_MAX],
-            cm[PA_CHANNEL_MAP_SNPRINT_MAX], *t;
-        const char *cmn;
+    t = pa_proplist_to_string_sep(source->proplist, "\n\t\t");
+    pa_strbuf_printf(s, "\tproperties:\n\t\t%s\n", t);
+    pa_xfree(t);
 
-        cmn = pa_channel_map_to_pretty_name(&source->channel_map);
+    append_port_list(s, source->ports);
 
+    if (source->active_port)
         pa_strbuf_printf(
-            s,
-            "  %c index: %u\n"
-            "\tname: <%s>\n"
-            "\tdriver: <%s>\n"
-            "\tflags: %s%s%s%s%s%s%s\n"
-            "\tstate: %s\n"
-            "\tsuspend cause: %s%s%s%s\n"
-            "\tpriority: %u\n"
-            "\tvolume: %s%s%s\n"
-            "\t        balance %0.2f\n"
-            "\tbase volume: %s%s%s\n"
-            "\tvolume steps: %u\n"
-            "\tmuted: %s\n"
-            "\tcurrent latency: %0.2f ms\n"
-            "\tmax rewind: %lu KiB\n"
-            "\tsample spec: %s\n"
-            "\tchannel map: %s%s%s\n"
-            "\tused by: %u\n"
-            "\tlinked by: %u\n",
-            c->default_source == source ? '*' : ' ',
-            source->index,
-            source->name,
-            source->driver,
-            source->flags & PA_SOURCE_HARDWARE ? "HARDWARE " : "",
-            source->flags & PA_SOURCE_NETWORK ? "NETWORK " : "",
-            source->flags & PA_SOURCE_HW_MUTE_CTRL ? "HW_MUTE_CTRL " : "",
-            source->flags & PA_SOURCE_HW_VOLUME_CTRL ? "HW_VOLUME_CTRL " : "",
-            source->flags & PA_SOURCE_DECIBEL_VOLUME ? "DECIBEL_VOLUME " : "",
-            source->flags & PA_SOURCE_LATENCY ? "LATENCY " : "",
-            source->flags & PA_SOURCE_DYNAMIC_LATENCY ? "DYNAMIC_LATENCY" : "",
-            source_state_to_string(pa_source_get_state(source)),
-            source->suspend_cause & PA_SUSPEND_USER ? "USER " : "",
-            source->suspend_cause & PA_SUSPEND_APPLICATION ? "APPLICATION " : "",
-            source->suspend_cause & PA_SUSPEND_IDLE ? "IDLE " : "",
-            source->suspend_cause & PA_SUSPEND_SESSION ? "SESSION" : "",
-            source->priority,
-            pa_cvolume_snprint(cv, sizeof(cv), pa_source_get_volume(source, FALSE)),
-            source->flags & PA_SOURCE_DECIBEL_VOLUME ? "\n\t        " : "",
-            source->flags & PA_SOURCE_DECIBEL_VOLUME ? pa_sw_cvolume_snprint_dB(cvdb, sizeof(cvdb), pa_source_get_volume(source, FALSE)) : "",
-            pa_cvolume_get_balance(pa_source_get_volume(source, FALSE), &source->channel_map),
-            pa_volume_snprint(v, sizeof(v), source->base_volume),
-            source->flags & PA_SOURCE_DECIBEL_VOLUME ? "\n\t             " : "",
-            source->flags & PA_SOURCE_DECIBEL_VOLUME ? pa_sw_volume_snprint_dB(vdb, sizeof(vdb), source->base_volume) : "",
-            source->n_volume_steps,
-            pa_yes_no(pa_source_get_mute(source, FALSE)),
-            (double) pa_source_get_latency(source) / PA_USEC_PER_MSEC,
-            (unsigned long) pa_source_get_max_rewind(source) / 1024,
-            pa_sample_spec_snprint(ss, sizeof(ss), &source->sample_spec),
-            pa_channel_map_snprint(cm, sizeof(cm), &source->channel_map),
-            cmn ? "\n\t             " : "",
-            cmn ? cmn : "",
-            pa_source_used_by(source),
-            pa_source_linked_by(source));
-
-        if (source->flags & PA_SOURCE_DYNAMIC_LATENCY) {
-            pa_usec_t min_latency, max_latency;
-            pa_source_get_latency_range(source, &min_latency, &max_latency);
-
-            pa_strbuf_printf(
-                    s,
-                    "\tconfigured latency: %0.2f ms; range is %0.2f .. %0.2f ms\n",
-                    (double) pa_source_get_requested_latency(source) / PA_USEC_PER_MSEC,
-                    (double) min_latency / PA_USEC_PER_MSEC,
-                    (double) max_latency / PA_USEC_PER_MSEC);
-        } else
-            pa_strbuf_printf(
-                    s,
-                    "\tfixed latency: %0.2f ms\n",
-                    (double) pa_source_get_fixed_latency(source) / PA_USEC_PER_MSEC);
-
-        if (source->monitor_of)
-            pa_strbuf_printf(s, "\tmonitor_of: %u\n", source->monitor_of->index);
-        if (source->card)
-            pa_strbuf_printf(s, "\tcard: %u <%s>\n", source->card->index, source->card->name);
-        if (source->module)
-            pa_strbuf_printf(s, "\tmodule: %u\n", source->module->index);
-
-        t = pa_proplist_to_string_sep(source->proplist, "\n\t\t");
-        pa_strbuf_printf(s, "\tproperties:\n\t\t%s\n", t);
-        pa_xfree(t);
-
-        append_port_list(s, source->ports);
-
-        if (source->active_port)
-            pa_strbuf_printf(
-                    s,
-                    "\tactive port: <%s>\n",
-                    source->active_port->name);
-    }
-
-    return pa_strbuf_tostring_free(s);
+                s,
+                "\tactive port: <%s>\n",
+                source->active_port->name);
 }
 
 
-char *pa_source_output_list_to_string(pa_core *c) {
-    pa_strbuf *s;
-    pa_source_output *o;
-    uint32_t idx = PA_IDXSET_INVALID;
+static void append_source_output(pa_strbuf *s, pa_core *c, pa_source_output *o) {
     static const char* const state_table[] = {
         [PA_SOURCE_OUTPUT_INIT] = "INIT",
         [PA_SOURCE_OUTPUT_RUNNING] = "RUNNING",
         [PA_SOURCE_OUTPUT_CORKED] = "CORKED",
         [PA_SOURCE_OUTPUT_UNLINKED] = "UNLINKED"
     };
-    pa_assert(c);
 
-    s = pa_strbuf_new();
+    char ss[PA_SAMPLE_SPEC_SNPRINT_MAX], cvdb[PA_SW_CVOLUME_SNPRINT_DB_MAX], cv[PA_CVOLUME_SNPRINT_MAX], cm[PA_CHANNEL_MAP_SNPRINT_MAX], *t, clt[28];
+    pa_usec_t cl;
+    const char *cmn;
+    pa_cvolume v;
+    char *volume_str = NULL;
+
+    cmn = pa_channel_map_to_pretty_name(&o->channel_map);
+
+    if ((cl = pa_source_output_get_requested_latency(o)) == (pa_usec_t) -1)
+        pa_snprintf(clt, sizeof(clt), "n/a");
+    else
+        pa_snprintf(clt, sizeof(clt), "%0.2f ms", (double) cl / PA_USEC_PER_MSEC);
+
+    pa_assert(o->source);
+
+    if (pa_source_output_is_volume_readable(o)) {
+        pa_source_output_get_volume(o, &v, TRUE);
+        volume_str = pa_sprintf_malloc("%s\n\t        %s\n\t        balance %0.2f",
+                                       pa_cvolume_snprint(cv, sizeof(cv), &v),
+                                       pa_sw_cvolume_snprint_dB(cvdb, sizeof(cvdb), &v),
+                                       pa_cvolume_get_balance(&v, &o->channel_map));
+    } else
+        volume_str = pa_xstrdup("n/a");
+
+
+    pa_strbuf_printf(
+        s,
+        "    index: %u\n"
+        "\tdriver: <%s>\n"
+        "\tflags: %s%s%s%s%s%s%s%s%s%s%s\n"
+        "\tstate: %s\n"
+        "\tsource: %u <%s>\n"
+        "\tvolume: %s\n"
+        "\tmuted: %s\n"
+        "\tcurrent latency: %0.2f ms\n"
+        "\trequested latency: %s\n"
+        "\tsample spec: %s\n"
+        "\tchannel map: %s%s%s\n"
+        "\tresample method: %s\n",
+        o->index,
+        o->driver,
+        o->flags & PA_SOURCE_OUTPUT_VARIABLE_RATE ? "VARIABLE_RATE " : "",
+        o->flags & PA_SOURCE_OUTPUT_DONT_MOVE ? "DONT_MOVE " : "",
+        o->flags & PA_SOURCE_OUTPUT_START_CORKED ? "START_CORKED " : "",
+        o->flags & PA_SOURCE_OUTPUT_NO_REMAP ? "NO_REMAP " : "",
+        o->flags & PA_SOURCE_OUTPUT_NO_REMIX ? "NO_REMIX " : "",
+        o->flags & PA_SOURCE_OUTPUT_FIX_FORMAT ? "FIX_FORMAT " : "",
+        o->flags & PA_SOURCE_OUTPUT_FIX_RATE ? "FIX_RATE " : "",
+        o->flags & PA_SOURCE_OUTPUT_FIX_CHANNELS ? "FIX_CHANNELS " : "",
+        o->flags & PA_SOURCE_OUTPUT_DONT_INHIBIT_AUTO_SUSPEND ? "DONT_INHIBIT_AUTO_SUSPEND " : "",
+        o->flags & PA_SOURCE_OUTPUT_NO_CREATE_ON_SUSPEND ? "NO_CREATE_ON_SUSPEND " : "",
+        o->flags & PA_SOURCE_OUTPUT_KILL_ON_SUSPEND ? "KILL_ON_SUSPEND " : "",
+        state_table[pa_source_output_get_state(o)],
+        o->source->index, o->source->name,
+        volume_str,
+        pa_yes_no(pa_source_output_get_mute(o)),
+        (double) pa_source_output_get_latency(o, NULL) / PA_USEC_PER_MSEC,
+        clt,
+        pa_sample_spec_snprint(ss, sizeof(ss), &o->sample_spec),
+        pa_channel_map_snprint(cm, sizeof(cm), &o->channel_map),
+        cmn ? "\n\t             " : "",
+        cmn ? cmn : "",
+        pa_resample_method_to_string(pa_source_output_get_resample_method(o)));
+
+    pa_xfree(volume_str);
+
+    if (o->module)
+        pa_strbuf_printf(s, "\towner module: %u\n", o->module->index);
+    if (o->client)
+        pa_strbuf_printf(s, "\tclient: %u <%s>\n", o->client->index, pa_strnull(pa_proplist_gets(o->client->proplist, PA_PROP_APPLICATION_NAME)));
+    if (o->direct_on_input)
+        pa_strbuf_printf(s, "\tdirect on input: %u\n", o->direct_on_input->index);
+
+    t = pa_proplist_to_string_sep(o->proplist, "\n\t\t");
+    pa_strbuf_printf(s, "\tproperties:\n\t\t%s\n", t);
+    pa_xfree(t);
+}
 
-    pa_strbuf_printf(s, "%u source outputs(s) available.\n", pa_idxset_size(c->source_outputs));
+static void append_sink_input(pa_strbuf *s, pa_core *c, pa_sink_input *i) {
+    static const char* const state_table[] = {
+        [PA_SINK_INPUT_INIT] = "INIT",
+        [PA_SINK_INPUT_RUNNING] = "RUNNING",
+        [PA_SINK_INPUT_DRAINED] = "DRAINED",
+        [PA_SINK_INPUT_CORKED] = "CORKED",
+        [PA_SINK_INPUT_UNLINKED] = "UNLINKED"
+    };
 
-    for (o = pa_idxset_first(c->source_outputs, &idx); o; o = pa_idxset_next(c->source_outputs, &idx)) {
-        char ss[PA_SAMPLE_SPEC_SNPRINT_MAX], cvdb[PA_SW_CVOLUME_SNPRINT_DB_MAX], cv[PA_CVOLUME_SNPRINT_MAX], cm[PA_CHANNEL_MAP_SNPRINT_MAX], *t, clt[28];
-        pa_usec_t cl;
-        const char *cmn;
-        pa_cvolume v;
-        char *volume_str = NULL;
+    char ss[PA_SAMPLE_SPEC_SNPRINT_MAX], cvdb[PA_SW_CVOLUME_SNPRINT_DB_MAX], cv[PA_CVOLUME_SNPRINT_MAX], cm[PA_CHANNEL_MAP_SNPRINT_MAX], *t, clt[28];
+    pa_usec_t cl;
+    const char *cmn;
+    pa_cvolume v;
+    char *volume_str = NULL;
+
+    cmn = pa_channel_map_to_pretty_name(&i->channel_map);
+
+    if ((cl = pa_sink_input_get_requested_latency(i)) == (pa_usec_t) -1)
+        pa_snprintf(clt, sizeof(clt), "n/a");
+    else
+        pa_snprintf(clt, sizeof(clt), "%0.2f ms", (double) cl / PA_USEC_PER_MSEC);
+
+    pa_assert(i->sink);
+
+    if (pa_sink_input_is_volume_readable(i)) {
+        pa_sink_input_get_volume(i, &v, TRUE);
+        volume_str = pa_sprintf_malloc("%s\n\t        %s\n\t        balance %0.2f",
+                                       pa_cvolume_snprint(cv, sizeof(cv), &v),
+                                       pa_sw_cvolume_snprint_dB(cvdb, sizeof(cvdb), &v),
+                                       pa_cvolume_get_balance(&v, &i->channel_map));
+    } else
+        volume_str = pa_xstrdup("n/a");
+
+    pa_strbuf_printf(
+        s,
+        "    index: %u\n"
+        "\tdriver: <%s>\n"
+        "\tflags: %s%s%s%s%s%s%s%s%s%s%s\n"
+        "\tstate: %s\n"
+        "\tsink: %u <%s>\n"
+        "\tvolume: %s\n"
+        "\tmuted: %s\n"
+        "\tcurrent latency: %0.2f ms\n"
+        "\trequested latency: %s\n"
+        "\tsample spec: %s\n"
+        "\tchannel map: %s%s%s\n"
+        "\tresample method: %s\n",
+        i->index,
+        i->driver,
+        i->flags & PA_SINK_INPUT_VARIABLE_RATE ? "VARIABLE_RATE " : "",
+        i->flags & PA_SINK_INPUT_DONT_MOVE ? "DONT_MOVE " : "",
+        i->flags & PA_SINK_INPUT_START_CORKED ? "START_CORKED " : "",
+        i->flags & PA_SINK_INPUT_NO_REMAP ? "NO_REMAP " : "",
+        i->flags & PA_SINK_INPUT_NO_REMIX ? "NO_REMIX " : "",
+        i->flags & PA_SINK_INPUT_FIX_FORMAT ? "FIX_FORMAT " : "",
+        i->flags & PA_SINK_INPUT_FIX_RATE ? "FIX_RATE " : "",
+        i->flags & PA_SINK_INPUT_FIX_CHANNELS ? "FIX_CHANNELS " : "",
+        i->flags & PA_SINK_INPUT_DONT_INHIBIT_AUTO_SUSPEND ? "DONT_INHIBIT_AUTO_SUSPEND " : "",
+        i->flags & PA_SINK_INPUT_NO_CREATE_ON_SUSPEND ? "NO_CREATE_SUSPEND " : "",
+        i->flags & PA_SINK_INPUT_KILL_ON_SUSPEND ? "KILL_ON_SUSPEND " : "",
+        state_table[pa_sink_input_get_state(i)],
+        i->sink->index, i->sink->name,
+        volume_str,
+        pa_yes_no(pa_sink_input_get_mute(i)),
+        (double) pa_sink_input_get_latency(i, NULL) / PA_USEC_PER_MSEC,
+        clt,
+        pa_sample_spec_snprint(ss, sizeof(ss), &i->sample_spec),
+        pa_channel_map_snprint(cm, sizeof(cm), &i->channel_map),
+        cmn ? "\n\t             " : "",
+        cmn ? cmn : "",
+        pa_resample_method_to_string(pa_sink_input_get_resample_method(i)));
+
+    pa_xfree(volume_str);
+
+    if (i->module)
+        pa_strbuf_printf(s, "\tmodule: %u\n", i->module->index);
+    if (i->client)
+        pa_strbuf_printf(s, "\tclient: %u <%s>\n", i->client->index, pa_strnull(pa_proplist_gets(i->client->proplist, PA_PROP_APPLICATION_NAME)));
+
+    t = pa_proplist_to_string_sep(i->proplist, "\n\t\t");
+    pa_strbuf_printf(s, "\tproperties:\n\t\t%s\n", t);
+    pa_xfree(t);
+}
 
-        cmn = pa_channel_map_to_pretty_name(&o->channel_map);
+static void append_scache_entry(pa_strbuf *s, pa_core *c, pa_scache_entry *e) {
+    double l = 0;
+    char ss[PA_SAMPLE_SPEC_SNPRINT_MAX] = "n/a", cv[PA_CVOLUME_SNPRINT_MAX], cvdb[PA_SW_CVOLUME_SNPRINT_DB_MAX], cm[PA_CHANNEL_MAP_SNPRINT_MAX] = "n/a", *t;
+    const char *cmn;
 
-        if ((cl = pa_source_output_get_requested_latency(o)) == (pa_usec_t) -1)
-            pa_snprintf(clt, sizeof(clt), "n/a");
-        else
-            pa_snprintf(clt, sizeof(clt), "%0.2f ms", (double) cl / PA_USEC_PER_MSEC);
+    cmn = pa_channel_map_to_pretty_name(&e->channel_map);
 
-        pa_assert(o->source);
+    if (e->memchunk.memblock) {
+        pa_sample_spec_snprint(ss, sizeof(ss), &e->sample_spec);
+        pa_channel_map_snprint(cm, sizeof(cm), &e->channel_map);
+        l = (double) e->memchunk.length / (double) pa_bytes_per_second(&e->sample_spec);
+    }
 
-        if (pa_source_output_is_volume_readable(o)) {
-            pa_source_output_get_volume(o, &v, TRUE);
-            volume_str = pa_sprintf_malloc("%s\n\t        %s\n\t        balance %0.2f",
-                                           pa_cvolume_snprint(cv, sizeof(cv), &v),
-                                           pa_sw_cvolume_snprint_dB(cvdb, sizeof(cvdb), &v),
-                                           pa_cvolume_get_balance(&v, &o->channel_map));
-        } else
-            volume_str = pa_xstrdup("n/a");
+    pa_strbuf_printf(
+        s,
+        "    name: <%s>\n"
+        "\tindex: %u\n"
+        "\tsample spec: %s\n"
+        "\tchannel map: %s%s%s\n"
+        "\tlength: %lu\n"
+        "\tduration: %0.1f s\n"
+        "\tvolume: %s\n"
+        "\t        %s\n"
+        "\t        balance %0.2f\n"
+        "\tlazy: %s\n"
+        "\tfilename: <%s>\n",
+        e->name,
+        e->index,
+        ss,
+        cm,
+        cmn ? "\n\t             " : "",
+        cmn ? cmn : "",
+        (long unsigned)(e->memchunk.memblock ? e->memchunk.length : 0),
+        l,
+        e->volume_is_set ? pa_cvolume_snprint(cv, sizeof(cv), &e->volume) : "n/a",
+        e->volume_is_set ? pa_sw_cvolume_snprint_dB(cvdb, sizeof(cvdb), &e->volume) : "n/a",
+        (e->memchunk.memblock && e->volume_is_set) ? pa_cvolume_get_balance(&e->volume, &e->channel_map) : 0.0f,
+        pa_yes_no(e->lazy),
+        e->filename ? e->filename : "n/a");
+
+    t = pa_proplist_to_string_sep(e->proplist, "\n\t\t");
+    pa_strbuf_printf(s, "\tproperties:\n\t\t%s\n", t);
+    pa_xfree(t);
+}
 
+static const char* const list_headers[PA_CLI_LIST_MAX] = {
+    [PA_CLI_LIST_MODULES] = "module(s) loaded.",
+    [PA_CLI_LIST_SINKS] = "sink(s) available.",
+    [PA_CLI_LIST_SOURCES] = "source(s) available.",
+    [PA_CLI_LIST_CLIENTS] = "client(s) logged in.",
+    [PA_CLI_LIST_CARDS] = "card(s) available.",
+    [PA_CLI_LIST_SINK_INPUTS] = "sink input(s) available.",
+    [PA_CLI_LIST_SOURCE_OUTPUTS] = "source outputs(s) available.",
+    [PA_CLI_LIST_SAMPLES] = "cache entrie(s) available."
+};
+
+struct pa_cli_list {
+    pa_core *core;
+    unsigned types;
+    uint32_t device;
+
+    /* Where we are: the list, whether its header has been written and
+     * the index of the last object written */
+    pa_cli_list_type_t type;
+    pa_bool_t started, at_first;
+    uint32_t idx;
+};
+
+static pa_idxset *get_idxset(pa_core *c, pa_cli_list_type_t type) {
+    switch (type) {
+        case PA_CLI_LIST_MODULES:
+            return c->modules;
+        case PA_CLI_LIST_SINKS:
+            return c->sinks;
+        case PA_CLI_LIST_SOURCES:
+            return c->sources;
+        case PA_CLI_LIST_CLIENTS:
+            return c->clients;
+        case PA_CLI_LIST_CARDS:
+            return c->cards;
+        case PA_CLI_LIST_SINK_INPUTS:
+            return c->sink_inputs;
+        case PA_CLI_LIST_SOURCE_OUTPUTS:
+            return c->source_outputs;
+        case PA_CLI_LIST_SAMPLES:
+            /* Created with the first sample */
+            return c->scache;
+        default:
+            pa_assert_not_reached();
+    }
+}
 
-        pa_strbuf_printf(
-            s,
-            "    index: %u\n"
-            "\tdriver: <%s>\n"
-            "\tflags: %s%s%s%s%s%s%s%s%s%s%s\n"
-            "\tstate: %s\n"
-            "\tsource: %u <%s>\n"
-            "\tvolume: %s\n"
-            "\tmuted: %s\n"
-            "\tcurrent latency: %0.2f ms\n"
-            "\trequested latency: %s\n"
-            "\tsample spec: %s\n"
-            "\tchannel map: %s%s%s\n"
-            "\tresample method: %s\n",
-            o->index,
-            o->driver,
-            o->flags & PA_SOURCE_OUTPUT_VARIABLE_RATE ? "VARIABLE_RATE " : "",
-            o->flags & PA_SOURCE_OUTPUT_DONT_MOVE ? "DONT_MOVE " : "",
-            o->flags & PA_SOURCE_OUTPUT_START_CORKED ? "START_CORKED " : "",
-            o->flags & PA_SOURCE_OUTPUT_NO_REMAP ? "NO_REMAP " : "",
-            o->flags & PA_SOURCE_OUTPUT_NO_REMIX ? "NO_REMIX " : "",
-            o->flags & PA_SOURCE_OUTPUT_FIX_FORMAT ? "FIX_FORMAT " : "",
-            o->flags & PA_SOURCE_OUTPUT_FIX_RATE ? "FIX_RATE " : "",
-            o->flags & PA_SOURCE_OUTPUT_FIX_CHANNELS ? "FIX_CHANNELS " : "",
-            o->flags & PA_SOURCE_OUTPUT_DONT_INHIBIT_AUTO_SUSPEND ? "DONT_INHIBIT_AUTO_SUSPEND " : "",
-            o->flags & PA_SOURCE_OUTPUT_NO_CREATE_ON_SUSPEND ? "NO_CREATE_ON_SUSPEND " : "",
-            o->flags & PA_SOURCE_OUTPUT_KILL_ON_SUSPEND ? "KILL_ON_SUSPEND " : "",
-            state_table[pa_source_output_get_state(o)],
-            o->source->index, o->source->name,
-            volume_str,
-            pa_yes_no(pa_source_output_get_mute(o)),
-            (double) pa_source_output_get_latency(o, NULL) / PA_USEC_PER_MSEC,
-            clt,
-            pa_sample_spec_snprint(ss, sizeof(ss), &o->sample_spec),
-            pa_channel_map_snprint(cm, sizeof(cm), &o->channel_map),
-            cmn ? "\n\t             " : "",
-            cmn ? cmn : "",
-            pa_resample_method_to_string(pa_source_output_get_resample_method(o)));
-
-        pa_xfree(volume_str);
-
-        if (o->module)
-            pa_strbuf_printf(s, "\towner module: %u\n", o->module->index);
-        if (o->client)
-            pa_strbuf_printf(s, "\tclient: %u <%s>\n", o->client->index, pa_strnull(pa_proplist_gets(o->client->proplist, PA_PROP_APPLICATION_NAME)));
-        if (o->direct_on_input)
-            pa_strbuf_printf(s, "\tdirect on input: %u\n", o->direct_on_input->index);
-
-        t = pa_proplist_to_string_sep(o->proplist, "\n\t\t");
-        pa_strbuf_printf(s, "\tproperties:\n\t\t%s\n", t);
-        pa_xfree(t);
+static pa_bool_t matches(pa_cli_list *l, void *o) {
+    if (l->device == PA_INVALID_INDEX)
+        return TRUE;
+
+    switch (l->type) {
+        case PA_CLI_LIST_SINK_INPUTS:
+            return ((pa_sink_input*) o)->sink && ((pa_sink_input*) o)->sink->index == l->device;
+        case PA_CLI_LIST_SOURCE_OUTPUTS:
+            return ((pa_source_output*) o)->source && ((pa_source_output*) o)->source->index == l->device;
+        default:
+            return TRUE;
     }
+}
 
-    return pa_strbuf_tostring_free(s);
+static unsigned count_matching(pa_cli_list *l, pa_idxset *set) {
+    void *o;
+    uint32_t idx;
+    unsigned n = 0;
+
+    if (!set)
+        return 0;
+
+    if (l->device == PA_INVALID_INDEX)
+        return pa_idxset_size(set);
+
+    PA_IDXSET_FOREACH(o, set, idx)
+        if (matches(l, o))
+            n++;
+
+    return n;
 }
 
-char *pa_sink_input_list_to_string(pa_core *c) {
-    pa_strbuf *s;
-    pa_sink_input *i;
-    uint32_t idx = PA_IDXSET_INVALID;
-    static const char* const state_table[] = {
-        [PA_SINK_INPUT_INIT] = "INIT",
-        [PA_SINK_INPUT_RUNNING] = "RUNNING",
-        [PA_SINK_INPUT_DRAINED] = "DRAINED",
-        [PA_SINK_INPUT_CORKED] = "CORKED",
-        [PA_SINK_INPUT_UNLINKED] = "UNLINKED"
-    };
+static void append_object(pa_cli_list *l, pa_strbuf *s, void *o) {
+    switch (l->type) {
+        case PA_CLI_LIST_MODULES:
+            append_module(s, l->core, o);
+            break;
+        case PA_CLI_LIST_SINKS:
+            append_sink(s, l->core, o);
+            break;
+        case PA_CLI_LIST_SOURCES:
+            append_source(s, l->core, o);
+            break;
+        case PA_CLI_LIST_CLIENTS:
+            append_client(s, l->core, o);
+            break;
+        case PA_CLI_LIST_CARDS:
+            append_card(s, l->core, o);
+            break;
+        case PA_CLI_LIST_SINK_INPUTS:
+            append_sink_input(s, l->core, o);
+            break;
+        case PA_CLI_LIST_SOURCE_OUTPUTS:
+            append_source_output(s, l->core, o);
+            break;
+        case PA_CLI_LIST_SAMPLES:
+            append_scache_entry(s, l->core, o);
+            break;
+        default:
+            pa_assert_not_reached();
+    }
+}
+
+pa_cli_list* pa_cli_list_new(pa_core *c, unsigned types, uint32_t device) {
+    pa_cli_list *l;
 
     pa_assert(c);
-    s = pa_strbuf_new();
+    pa_assert(types != 0);
 
-    pa_strbuf_printf(s, "%u sink input(s) available.\n", pa_idxset_size(c->sink_inputs));
+    l = pa_xnew0(pa_cli_list, 1);
+    l->core = c;
+    l->types = types;
+    l->device = device;
+    l->type = 0;
+    l->idx = PA_IDXSET_INVALID;
 
-    for (i = pa_idxset_first(c->sink_inputs, &idx); i; i = pa_idxset_next(c->sink_inputs, &idx)) {
-        char ss[PA_SAMPLE_SPEC_SNPRINT_MAX], cvdb[PA_SW_CVOLUME_SNPRINT_DB_MAX], cv[PA_CVOLUME_SNPRINT_MAX], cm[PA_CHANNEL_MAP_SNPRINT_MAX], *t, clt[28];
-        pa_usec_t cl;
-        const char *cmn;
-        pa_cvolume v;
-        char *volume_str = NULL;
+    return l;
+}
 
-        cmn = pa_channel_map_to_pretty_name(&i->channel_map);
+void pa_cli_list_free(pa_cli_list *l) {
+    pa_assert(l);
 
-        if ((cl = pa_sink_input_get_requested_latency(i)) == (pa_usec_t) -1)
-            pa_snprintf(clt, sizeof(clt), "n/a");
-        else
-            pa_snprintf(clt, sizeof(clt), "%0.2f ms", (double) cl / PA_USEC_PER_MSEC);
+    pa_xfree(l);
+}
 
-        pa_assert(i->sink);
+pa_bool_t pa_cli_list_next(pa_cli_list *l, pa_strbuf *s, unsigned n_max) {
+    unsigned n = 0;
 
-        if (pa_sink_input_is_volume_readable(i)) {
-            pa_sink_input_get_volume(i, &v, TRUE);
-            volume_str = pa_sprintf_malloc("%s\n\t        %s\n\t        balance %0.2f",
-                                           pa_cvolume_snprint(cv, sizeof(cv), &v),
-                                           pa_sw_cvolume_snprint_dB(cvdb, sizeof(cvdb), &v),
-                                           pa_cvolume_get_balance(&v, &i->channel_map));
-        } else
-            volume_str = pa_xstrdup("n/a");
+    pa_assert(l);
+    pa_assert(s);
 
-        pa_strbuf_printf(
-            s,
-            "    index: %u\n"
-            "\tdriver: <%s>\n"
-            "\tflags: %s%s%s%s%s%s%s%s%s%s%s\n"
-            "\tstate: %s\n"
-            "\tsink: %u <%s>\n"
-            "\tvolume: %s\n"
-            "\tmuted: %s\n"
-            "\tcurrent latency: %0.2f ms\n"
-            "\trequested latency: %s\n"
-            "\tsample spec: %s\n"
-            "\tchannel map: %s%s%s\n"
-            "\tresample method: %s\n",
-            i->index,
-            i->driver,
-            i->flags & PA_SINK_INPUT_VARIABLE_RATE ? "VARIABLE_RATE " : "",
-            i->flags & PA_SINK_INPUT_DONT_MOVE ? "DONT_MOVE " : "",
-            i->flags & PA_SINK_INPUT_START_CORKED ? "START_CORKED " : "",
-            i->flags & PA_SINK_INPUT_NO_REMAP ? "NO_REMAP " : "",
-            i->flags & PA_SINK_INPUT_NO_REMIX ? "NO_REMIX " : "",
-            i->flags & PA_SINK_INPUT_FIX_FORMAT ? "FIX_FORMAT " : "",
-            i->flags & PA_SINK_INPUT_FIX_RATE ? "FIX_RATE " : "",
-            i->flags & PA_SINK_INPUT_FIX_CHANNELS ? "FIX_CHANNELS " : "",
-            i->flags & PA_SINK_INPUT_DONT_INHIBIT_AUTO_SUSPEND ? "DONT_INHIBIT_AUTO_SUSPEND " : "",
-            i->flags & PA_SINK_INPUT_NO_CREATE_ON_SUSPEND ? "NO_CREATE_SUSPEND " : "",
-            i->flags & PA_SINK_INPUT_KILL_ON_SUSPEND ? "KILL_ON_SUSPEND " : "",
-            state_table[pa_sink_input_get_state(i)],
-            i->sink->index, i->sink->name,
-            volume_str,
-            pa_yes_no(pa_sink_input_get_mute(i)),
-            (double) pa_sink_input_get_latency(i, NULL) / PA_USEC_PER_MSEC,
-            clt,
-            pa_sample_spec_snprint(ss, sizeof(ss), &i->sample_spec),
-            pa_channel_map_snprint(cm, sizeof(cm), &i->channel_map),
-            cmn ? "\n\t             " : "",
-            cmn ? cmn : "",
-            pa_resample_method_to_string(pa_sink_input_get_resample_method(i)));
-
-        pa_xfree(volume_str);
-
-        if (i->module)
-            pa_strbuf_printf(s, "\tmodule: %u\n", i->module->index);
-        if (i->client)
-            pa_strbuf_printf(s, "\tclient: %u <%s>\n", i->client->index, pa_strnull(pa_proplist_gets(i->client->proplist, PA_PROP_APPLICATION_NAME)));
-
-        t = pa_proplist_to_string_sep(i->proplist, "\n\t\t");
-        pa_strbuf_printf(s, "\tproperties:\n\t\t%s\n", t);
-        pa_xfree(t);
+    for (; l->type < PA_CLI_LIST_MAX; l->type++, l->started = FALSE) {
+        pa_idxset *set;
+
+        if (!(l->types & PA_CLI_LIST_MASK(l->type)))
+            continue;
+
+        set = get_idxset(l->core, l->type);
+
+        if (!l->started) {
+            pa_strbuf_printf(s, "%u %s\n", count_matching(l, set), list_headers[l->type]);
+            l->started = l->at_first = TRUE;
+        }
+
+        for (;;) {
+            void *o;
+
+            if (n >= n_max)
+                return TRUE;
+
+            if (!set)
+                break;
+
+            if (l->at_first) {
+                o = pa_idxset_first(set, &l->idx);
+                l->at_first = FALSE;
+            } else
+                o = pa_idxset_next(set, &l->idx);
+
+            if (!o)
+                break;
+
+            if (!matches(l, o))
+                continue;
+
+            append_object(l, s, o);
+            n++;
+        }
     }
 
-    return pa_strbuf_tostring_free(s);
+    return FALSE;
 }
 
-char *pa_scache_list_to_string(pa_core *c) {
+static char *list_to_string(pa_core *c, pa_cli_list_type_t type) {
     pa_strbuf *s;
+    pa_cli_list *l;
+
     pa_assert(c);
 
     s = pa_strbuf_new();
+    l = pa_cli_list_new(c, PA_CLI_LIST_MASK(type), PA_INVALID_INDEX);
+
+    while (pa_cli_list_next(l, s, (unsigned) -1))
+        ;
+
+    pa_cli_list_free(l);
+
+    return pa_strbuf_tostring_free(s);
+}
 
-    pa_strbuf_printf(s, "%u cache entrie(s) available.\n", c->scache ? pa_idxset_size(c->scache) : 0);
+char *pa_module_list_to_string(pa_core *c) {
+    return list_to_string(c, PA_CLI_LIST_MODULES);
+}
 
-    if (c->scache) {
-        pa_scache_entry *e;
-        uint32_t idx = PA_IDXSET_INVALID;
+char *pa_client_list_to_string(pa_core *c) {
+    return list_to_string(c, PA_CLI_LIST_CLIENTS);
+}
 
-        for (e = pa_idxset_first(c->scache, &idx); e; e = pa_idxset_next(c->scache, &idx)) {
-            double l = 0;
-            char ss[PA_SAMPLE_SPEC_SNPRINT_MAX] = "n/a", cv[PA_CVOLUME_SNPRINT_MAX], cvdb[PA_SW_CVOLUME_SNPRINT_DB_MAX], cm[PA_CHANNEL_MAP_SNPRINT_MAX] = "n/a", *t;
-            const char *cmn;
+char *pa_card_list_to_string(pa_core *c) {
+    return list_to_string(c, PA_CLI_LIST_CARDS);
+}
+
+char *pa_sink_list_to_string(pa_core *c) {
+    return list_to_string(c, PA_CLI_LIST_SINKS);
+}
 
-            cmn = pa_channel_map_to_pretty_name(&e->channel_map);
+char *pa_source_list_to_string(pa_core *c) {
+    return list_to_string(c, PA_CLI_LIST_SOURCES);
+}
 
-            if (e->memchunk.memblock) {
-                pa_sample_spec_snprint(ss, sizeof(ss), &e->sample_spec);
-                pa_channel_map_snprint(cm, sizeof(cm), &e->channel_map);
-                l = (double) e->memchunk.length / (double) pa_bytes_per_second(&e->sample_spec);
-            }
+char *pa_source_output_list_to_string(pa_core *c) {
+    return list_to_string(c, PA_CLI_LIST_SOURCE_OUTPUTS);
+}
 
-            pa_strbuf_printf(
-                s,
-                "    name: <%s>\n"
-                "\tindex: %u\n"
-                "\tsample spec: %s\n"
-                "\tchannel map: %s%s%s\n"
-                "\tlength: %lu\n"
-                "\tduration: %0.1f s\n"
-                "\tvolume: %s\n"
-                "\t        %s\n"
-                "\t        balance %0.2f\n"
-                "\tlazy: %s\n"
-                "\tfilename: <%s>\n",
-                e->name,
-                e->index,
-                ss,
-                cm,
-                cmn ? "\n\t             " : "",
-                cmn ? cmn : "",
-                (long unsigned)(e->memchunk.memblock ? e->memchunk.length : 0),
-                l,
-                e->volume_is_set ? pa_cvolume_snprint(cv, sizeof(cv), &e->volume) : "n/a",
-                e->volume_is_set ? pa_sw_cvolume_snprint_dB(cvdb, sizeof(cvdb), &e->volume) : "n/a",
-                (e->memchunk.memblock && e->volume_is_set) ? pa_cvolume_get_balance(&e->volume, &e->channel_map) : 0.0f,
-                pa_yes_no(e->lazy),
-                e->filename ? e->filename : "n/a");
-
-            t = pa_proplist_to_string_sep(e->proplist, "\n\t\t");
-            pa_strbuf_printf(s, "\tproperties:\n\t\t%s\n", t);
-            pa_xfree(t);
-        }
-    }
+char *pa_sink_input_list_to_string(pa_core *c) {
+    return list_to_string(c, PA_CLI_LIST_SINK_INPUTS);
+}
 
-    return pa_strbuf_tostring_free(s);
+char *pa_scache_list_to_string(pa_core *c) {
+    return list_to_string(c, PA_CLI_LIST_SAMPLES);
 }
 
 char *pa_full_status_string(pa_core *c) {
@@ -23,6 +23,7 @@
 ***/
 
 #include <pulsecore/core.h>
+#include <pulsecore/strbuf.h>
 
 /* Some functions to generate pretty formatted listings of
  * entities. The returned strings have to be freed manually. */
@@ -38,4 +39,35 @@ char *pa_scache_list_to_string(pa_core *c);
 
 char *pa_full_status_string(pa_core *c);
 
+/* The same listings, made a few objects at a time so that they can
+ * be sent while they are made */
+
+typedef enum pa_cli_list_type {
+    PA_CLI_LIST_MODULES,
+    PA_CLI_LIST_SINKS,
+    PA_CLI_LIST_SOURCES,
+    PA_CLI_LIST_CLIENTS,
+    PA_CLI_LIST_CARDS,
+    PA_CLI_LIST_SINK_INPUTS,
+    PA_CLI_LIST_SOURCE_OUTPUTS,
+    PA_CLI_LIST_SAMPLES,
+    PA_CLI_LIST_MAX
+} pa_cli_list_type_t;
+
+#define PA_CLI_LIST_MASK(type) (1U << (type))
+#define PA_CLI_LIST_ALL (PA_CLI_LIST_MASK(PA_CLI_LIST_MAX) - 1)
+
+typedef struct pa_cli_list pa_cli_list;
+
+/* Lists the types in the mask types, in the order above. Unless device
+ * is PA_INVALID_INDEX only the sink inputs and source outputs of the
+ * sink or source with that index are listed. */
+pa_cli_list* pa_cli_list_new(pa_core *c, unsigned types, uint32_t device);
+void pa_cli_list_free(pa_cli_list *l);
+
+/* Appends the next n_max objects to s. Returns FALSE once the last one
+ * has been written. Objects that go away meanwhile are skipped, those
+ * that are new show up if they come after the last one written. */
+pa_bool_t pa_cli_list_next(pa_cli_list *l, pa_strbuf *s, unsigned n_max);
+
 #endif
@@ -38,11 +38,15 @@
 #include <pulsecore/cli-command.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/queue.h>
 
 #include "cli.h"
 
 #define PROMPT ">>> "
 
+/* How many objects of a listing are written at a time */
+#define LIST_CHUNK 16
+
 struct pa_cli {
     pa_core *core;
     pa_ioline *line;
@@ -56,9 +60,17 @@ struct pa_cli {
     int defer_kill;
 
     char *last_line;
+
+    /* The listing being written, and the lines that came in meanwhile */
+    pa_cli_list *list;
+    pa_queue *pending_lines;
+
+    /* Reused for the chunks of listings */
+    pa_strbuf *chunk;
 };
 
 static void line_callback(pa_ioline *line, const char *s, void *userdata);
+static void drain_callback(pa_ioline *line, void *userdata);
 static void client_kill(pa_client *c);
 
 pa_cli* pa_cli_new(pa_core *core, pa_iochannel *io, pa_module *m) {
@@ -100,6 +112,10 @@ pa_cli* pa_cli_new(pa_core *core, pa_iochannel *io, pa_module *m) {
 
     c->last_line = NULL;
 
+    c->list = NULL;
+    c->pending_lines = pa_queue_new();
+    c->chunk = pa_strbuf_new();
+
     return c;
 }
 
@@ -110,6 +126,12 @@ void pa_cli_free(pa_cli *c) {
     pa_ioline_unref(c->line);
     pa_client_free(c->client);
     pa_xfree(c->last_line);
+
+    if (c->list)
+        pa_cli_list_free(c->list);
+
+    pa_queue_free(c->pending_lines, pa_xfree);
+    pa_strbuf_free(c->chunk);
     pa_xfree(c);
 }
 
@@ -127,22 +149,13 @@ static void client_kill(pa_client *client) {
         c->eof_callback(c, c->userdata);
 }
 
-static void line_callback(pa_ioline *line, const char *s, void *userdata) {
+/* Returns FALSE if the client was killed, c may be gone then */
+static pa_bool_t process_line(pa_cli *c, const char *s) {
     pa_strbuf *buf;
-    pa_cli *c = userdata;
     char *p;
 
-    pa_assert(line);
     pa_assert(c);
-
-    if (!s) {
-        pa_log_debug("CLI got EOF from user.");
-
-        if (c->eof_callback)
-            c->eof_callback(c, c->userdata);
-
-        return;
-    }
+    pa_assert(!c->list);
 
     /* Magic command, like they had in AT Hayes Modems! Those were the good days! */
     if (pa_streq(s, "/"))
@@ -154,16 +167,95 @@ static void line_callback(pa_ioline *line, const char *s, void *userdata) {
 
     pa_assert_se(buf = pa_strbuf_new());
     c->defer_kill++;
-    pa_cli_command_execute_line(c->core, s, buf, &c->fail);
+    pa_cli_command_execute_line_list(c->core, s, buf, &c->fail, &c->list);
     c->defer_kill--;
-    pa_ioline_puts(line, p = pa_strbuf_tostring_free(buf));
+
+    /* Listings are written in chunks as the output drains, so that
+     * neither a long one blocks the main loop nor does it have to fit
+     * into the buffer of the line */
+    if (c->list && !pa_cli_list_next(c->list, buf, LIST_CHUNK)) {
+        pa_cli_list_free(c->list);
+        c->list = NULL;
+    }
+
+    pa_ioline_puts(c->line, p = pa_strbuf_tostring_free(buf));
     pa_xfree(p);
 
     if (c->kill_requested) {
         if (c->eof_callback)
             c->eof_callback(c, c->userdata);
-    } else
-        pa_ioline_puts(line, PROMPT);
+
+        return FALSE;
+    }
+
+    if (c->list)
+        pa_ioline_set_drain_callback(c->line, drain_callback, c);
+    else
+        pa_ioline_puts(c->line, PROMPT);
+
+    return TRUE;
+}
+
+static void drain_callback(pa_ioline *line, void *userdata) {
+    pa_cli *c = userdata;
+    pa_bool_t more;
+    char *p;
+
+    pa_assert(line);
+    pa_assert(c);
+    pa_assert(c->list);
+
+    pa_strbuf_reset(c->chunk);
+    more = pa_cli_list_next(c->list, c->chunk, LIST_CHUNK);
+    pa_ioline_puts(line, pa_strbuf_peek(c->chunk));
+
+    if (more)
+        return;
+
+    pa_cli_list_free(c->list);
+    c->list = NULL;
+
+    pa_ioline_set_drain_callback(line, NULL, NULL);
+    pa_ioline_puts(line, PROMPT);
+
+    while (!c->list && (p = pa_queue_pop(c->pending_lines))) {
+        pa_bool_t alive = process_line(c, p);
+
+        pa_xfree(p);
+
+        if (!alive)
+            return;
+    }
+}
+
+static void line_callback(pa_ioline *line, const char *s, void *userdata) {
+    pa_cli *c = userdata;
+
+    pa_assert(line);
+    pa_assert(c);
+
+    if (!s) {
+        pa_log_debug("CLI got EOF from user.");
+
+        /* Finish what was asked for first, we are called again
+         * when it has been written */
+        if (c->list) {
+            pa_ioline_defer_close(line);
+            return;
+        }
+
+        if (c->eof_callback)
+            c->eof_callback(c, c->userdata);
+
+        return;
+    }
+
+    if (c->list) {
+        pa_queue_push(c->pending_lines, pa_xstrdup(s));
+        return;
+    }
+
+    process_line(c, s);
 }
 
 void pa_cli_set_eof_callback(pa_cli *c, pa_cli_eof_cb_t cb, void *userdata) {
@@ -71,6 +71,8 @@ pa_client *pa_client_new(pa_core *core, pa_client_new_data *data) {
     c->sink_inputs = pa_idxset_new(NULL, NULL);
     c->source_outputs = pa_idxset_new(NULL, NULL);
 
+    c->mem_account = pa_mem_account_new(core->mem_account, core->client_memory_budget);
+
     c->userdata = NULL;
     c->kill = NULL;
     c->send_event = NULL;
@@ -107,6 +109,8 @@ void pa_client_free(pa_client *c) {
     pa_assert(pa_idxset_isempty(c->source_outputs));
     pa_idxset_free(c->source_outputs, NULL, NULL);
 
+    pa_mem_account_unref(c->mem_account);
+
     pa_proplist_free(c->proplist);
     pa_xfree(c->driver);
     pa_xfree(c);
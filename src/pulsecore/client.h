@@ -45,6 +45,10 @@ struct pa_client {
     pa_idxset *sink_inputs;
     pa_idxset *source_outputs;
 
+    /* The audio queued for or by the client's streams. The queues keep
+     * references, so it may outlive the client. */
+    pa_mem_account *mem_account;
+
     void *userdata;
 
     void (*kill)(pa_client *c);
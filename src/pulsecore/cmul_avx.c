@@ -0,0 +1,95 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "cpu-x86.h"
+
+#include "sample-util.h"
+
+#if defined (PA_HAVE_X86_TARGET_ATTRIBUTE)
+
+#include <immintrin.h>
+
+/* Four complex values per register. The duplicate and permute
+ * instructions only work within 128 bit lanes, which is enough since a
+ * complex value never crosses one. */
+
+static void cmul_real_tail(float *c, const float *h, unsigned n) {
+
+    for (; n > 0; n--, c += 2) {
+        c[0] *= *h;
+        c[1] *= *h++;
+    }
+}
+
+static void cmac_tail(float *acc, const float *a, const float *b, unsigned n) {
+
+    for (; n > 0; n--, acc += 2, a += 2, b += 2) {
+        acc[0] += a[0] * b[0] - a[1] * b[1];
+        acc[1] += a[0] * b[1] + a[1] * b[0];
+    }
+}
+
+PA_X86_TARGET("avx")
+static void pa_cmul_real_avx(float *c, const float *h, unsigned n) {
+
+    for (; n >= 4; n -= 4, c += 8, h += 4) {
+        __m128 g = _mm_loadu_ps(h);
+        __m256 gg = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_unpacklo_ps(g, g)), _mm_unpackhi_ps(g, g), 1);
+
+        _mm256_storeu_ps(c, _mm256_mul_ps(_mm256_loadu_ps(c), gg));
+    }
+
+    cmul_real_tail(c, h, n);
+}
+
+PA_X86_TARGET("avx")
+static void pa_cmac_avx(float *acc, const float *a, const float *b, unsigned n) {
+
+    for (; n >= 4; n -= 4, acc += 8, a += 8, b += 8) {
+        __m256 x = _mm256_loadu_ps(a), y = _mm256_loadu_ps(b);
+        __m256 re = _mm256_moveldup_ps(y), im = _mm256_movehdup_ps(y);
+        __m256 swapped = _mm256_permute_ps(x, _MM_SHUFFLE(2, 3, 0, 1));
+
+        /* addsub subtracts in the real and adds in the imaginary lanes */
+        _mm256_storeu_ps(acc, _mm256_add_ps(_mm256_loadu_ps(acc),
+                                            _mm256_addsub_ps(_mm256_mul_ps(x, re), _mm256_mul_ps(swapped, im))));
+    }
+
+    cmac_tail(acc, a, b, n);
+}
+#endif /* defined (PA_HAVE_X86_TARGET_ATTRIBUTE) */
+
+void pa_cmul_func_init_avx(pa_cpu_x86_flag_t flags) {
+#if defined (PA_HAVE_X86_TARGET_ATTRIBUTE)
+
+    if (flags & PA_CPU_X86_AVX) {
+        pa_log_info("Initialising AVX optimized complex multiplication.");
+
+        pa_set_cmul_real_func(pa_cmul_real_avx);
+        pa_set_cmac_func(pa_cmac_avx);
+    }
+#endif /* defined (PA_HAVE_X86_TARGET_ATTRIBUTE) */
+}
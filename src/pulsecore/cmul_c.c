@@ -0,0 +1,65 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/macro.h>
+
+#include "sample-util.h"
+
+static void pa_cmul_real_c(float *c, const float *h, unsigned n) {
+
+    for (; n > 0; n--, c += 2) {
+        c[0] *= *h;
+        c[1] *= *h++;
+    }
+}
+
+static void pa_cmac_c(float *acc, const float *a, const float *b, unsigned n) {
+
+    for (; n > 0; n--, acc += 2, a += 2, b += 2) {
+        acc[0] += a[0] * b[0] - a[1] * b[1];
+        acc[1] += a[0] * b[1] + a[1] * b[0];
+    }
+}
+
+static pa_cmul_real_func_t cmul_real_func = pa_cmul_real_c;
+static pa_cmac_func_t cmac_func = pa_cmac_c;
+
+pa_cmul_real_func_t pa_get_cmul_real_func(void) {
+    return cmul_real_func;
+}
+
+void pa_set_cmul_real_func(pa_cmul_real_func_t func) {
+    pa_assert(func);
+
+    cmul_real_func = func;
+}
+
+pa_cmac_func_t pa_get_cmac_func(void) {
+    return cmac_func;
+}
+
+void pa_set_cmac_func(pa_cmac_func_t func) {
+    pa_assert(func);
+
+    cmac_func = func;
+}
@@ -0,0 +1,94 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "cpu-arm.h"
+
+#include "sample-util.h"
+
+#if defined (__arm__) && defined (__ARM_NEON__)
+
+#include <arm_neon.h>
+
+/* The structure loads split four complex values into a register of real
+ * and one of imaginary parts, so no shuffling is needed. */
+
+static void cmul_real_tail(float *c, const float *h, unsigned n) {
+
+    for (; n > 0; n--, c += 2) {
+        c[0] *= *h;
+        c[1] *= *h++;
+    }
+}
+
+static void cmac_tail(float *acc, const float *a, const float *b, unsigned n) {
+
+    for (; n > 0; n--, acc += 2, a += 2, b += 2) {
+        acc[0] += a[0] * b[0] - a[1] * b[1];
+        acc[1] += a[0] * b[1] + a[1] * b[0];
+    }
+}
+
+static void pa_cmul_real_neon(float *c, const float *h, unsigned n) {
+
+    for (; n >= 4; n -= 4, c += 8, h += 4) {
+        float32x4x2_t v = vld2q_f32(c);
+        float32x4_t g = vld1q_f32(h);
+
+        v.val[0] = vmulq_f32(v.val[0], g);
+        v.val[1] = vmulq_f32(v.val[1], g);
+        vst2q_f32(c, v);
+    }
+
+    cmul_real_tail(c, h, n);
+}
+
+static void pa_cmac_neon(float *acc, const float *a, const float *b, unsigned n) {
+
+    for (; n >= 4; n -= 4, acc += 8, a += 8, b += 8) {
+        float32x4x2_t s = vld2q_f32(acc), x = vld2q_f32(a), y = vld2q_f32(b);
+
+        s.val[0] = vmlaq_f32(s.val[0], x.val[0], y.val[0]);
+        s.val[0] = vmlsq_f32(s.val[0], x.val[1], y.val[1]);
+        s.val[1] = vmlaq_f32(s.val[1], x.val[0], y.val[1]);
+        s.val[1] = vmlaq_f32(s.val[1], x.val[1], y.val[0]);
+        vst2q_f32(acc, s);
+    }
+
+    cmac_tail(acc, a, b, n);
+}
+#endif /* defined (__arm__) && defined (__ARM_NEON__) */
+
+void pa_cmul_func_init_neon(pa_cpu_arm_flag_t flags) {
+#if defined (__arm__) && defined (__ARM_NEON__)
+
+    if (flags & PA_CPU_ARM_NEON) {
+        pa_log_info("Initialising NEON optimized complex multiplication.");
+
+        pa_set_cmul_real_func(pa_cmul_real_neon);
+        pa_set_cmac_func(pa_cmac_neon);
+    }
+#endif /* defined (__arm__) && defined (__ARM_NEON__) */
+}
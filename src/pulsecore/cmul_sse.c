@@ -0,0 +1,96 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "cpu-x86.h"
+
+#include "sample-util.h"
+
+#if defined (PA_HAVE_X86_TARGET_ATTRIBUTE)
+
+#include <xmmintrin.h>
+
+/* Two complex values per register. Without SSE3 there is no addsub, so
+ * the imaginary products get their sign flipped before being added. */
+
+static void cmul_real_tail(float *c, const float *h, unsigned n) {
+
+    for (; n > 0; n--, c += 2) {
+        c[0] *= *h;
+        c[1] *= *h++;
+    }
+}
+
+static void cmac_tail(float *acc, const float *a, const float *b, unsigned n) {
+
+    for (; n > 0; n--, acc += 2, a += 2, b += 2) {
+        acc[0] += a[0] * b[0] - a[1] * b[1];
+        acc[1] += a[0] * b[1] + a[1] * b[0];
+    }
+}
+
+PA_X86_TARGET("sse")
+static void pa_cmul_real_sse(float *c, const float *h, unsigned n) {
+
+    for (; n >= 4; n -= 4, c += 8, h += 4) {
+        __m128 g = _mm_loadu_ps(h);
+
+        _mm_storeu_ps(c, _mm_mul_ps(_mm_loadu_ps(c), _mm_unpacklo_ps(g, g)));
+        _mm_storeu_ps(c + 4, _mm_mul_ps(_mm_loadu_ps(c + 4), _mm_unpackhi_ps(g, g)));
+    }
+
+    cmul_real_tail(c, h, n);
+}
+
+PA_X86_TARGET("sse")
+static void pa_cmac_sse(float *acc, const float *a, const float *b, unsigned n) {
+    const __m128 sign = _mm_set_ps(1.0f, -1.0f, 1.0f, -1.0f);
+
+    for (; n >= 2; n -= 2, acc += 4, a += 4, b += 4) {
+        __m128 x = _mm_loadu_ps(a), y = _mm_loadu_ps(b);
+        __m128 re = _mm_shuffle_ps(y, y, _MM_SHUFFLE(2, 2, 0, 0));
+        __m128 im = _mm_shuffle_ps(y, y, _MM_SHUFFLE(3, 3, 1, 1));
+        __m128 swapped = _mm_shuffle_ps(x, x, _MM_SHUFFLE(2, 3, 0, 1));
+
+        /* (ar*br - ai*bi, ai*br + ar*bi) */
+        _mm_storeu_ps(acc, _mm_add_ps(_mm_loadu_ps(acc),
+                                      _mm_add_ps(_mm_mul_ps(x, re), _mm_mul_ps(_mm_mul_ps(swapped, im), sign))));
+    }
+
+    cmac_tail(acc, a, b, n);
+}
+#endif /* defined (PA_HAVE_X86_TARGET_ATTRIBUTE) */
+
+void pa_cmul_func_init_sse(pa_cpu_x86_flag_t flags) {
+#if defined (PA_HAVE_X86_TARGET_ATTRIBUTE)
+
+    if (flags & PA_CPU_X86_SSE) {
+        pa_log_info("Initialising SSE optimized complex multiplication.");
+
+        pa_set_cmul_real_func(pa_cmul_real_sse);
+        pa_set_cmac_func(pa_cmac_sse);
+    }
+#endif /* defined (PA_HAVE_X86_TARGET_ATTRIBUTE) */
+}
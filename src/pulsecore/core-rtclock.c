@@ -151,6 +151,18 @@ pa_bool_t pa_rtclock_hrtimer(void) {
     return FALSE;
 }
 
+pa_usec_t pa_rtclock_thread_cpu(void) {
+
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_THREAD_CPUTIME_ID)
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+        return pa_timespec_load(&ts);
+#endif
+
+    return 0;
+}
+
 #define TIMER_SLACK_NS (int) ((500 * PA_NSEC_PER_USEC))
 
 void pa_rtclock_hrtimer_enable(void) {
@@ -35,6 +35,9 @@ pa_usec_t pa_rtclock_age(const struct timeval *tv);
 pa_bool_t pa_rtclock_hrtimer(void);
 void pa_rtclock_hrtimer_enable(void);
 
+/* The CPU time the calling thread has used, or 0 if it can't be told */
+pa_usec_t pa_rtclock_thread_cpu(void);
+
 /* timer with a resolution better than this are considered high-resolution */
 #define PA_HRTIMER_THRESHOLD_USEC 10
 
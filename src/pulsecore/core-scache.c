@@ -49,8 +49,13 @@
 #include <pulse/xmalloc.h>
 #include <pulse/rtclock.h>
 
+#include <pulsecore/asyncmsgq.h>
+#include <pulsecore/llist.h>
+#include <pulsecore/mutex.h>
+#include <pulsecore/thread.h>
 #include <pulsecore/sink-input.h>
 #include <pulsecore/play-memchunk.h>
+#include <pulsecore/sample-player.h>
 #include <pulsecore/core-subscribe.h>
 #include <pulsecore/namereg.h>
 #include <pulsecore/sound-file.h>
@@ -64,6 +69,38 @@
 
 #define UNLOAD_POLL_TIME (60 * PA_USEC_PER_SEC)
 
+/* Decodes lazy entries in the background, so that playing them
+ * doesn't have to. Entries that were played more often go first. */
+struct load_job {
+    uint32_t index;
+    char *filename;
+    unsigned play_count;
+
+    /* Filled in by the loader thread */
+    int result;
+    pa_sample_spec sample_spec;
+    pa_channel_map channel_map;
+    pa_memchunk memchunk;
+    pa_sound_file_mapping *mapping;
+
+    PA_LLIST_FIELDS(struct load_job);
+};
+
+typedef struct pa_scache_loader {
+    pa_core *core;
+    pa_thread *thread;
+
+    /* Jobs go back to the main loop through this */
+    pa_asyncmsgq *done_q;
+    pa_io_event *done_event;
+
+    /* Protects the members below */
+    pa_mutex *mutex;
+    pa_cond *cond;
+    PA_LLIST_HEAD(struct load_job, jobs);
+    pa_bool_t quit;
+} pa_scache_loader;
+
 static void timeout_callback(pa_mainloop_api *m, pa_time_event *e, const struct timeval *t, void *userdata) {
     pa_core *c = userdata;
 
@@ -76,6 +113,222 @@ static void timeout_callback(pa_mainloop_api *m, pa_time_event *e, const struct
     pa_core_rttime_restart(c, e, pa_rtclock_now() + UNLOAD_POLL_TIME);
 }
 
+static void unload_entry(pa_scache_entry *e) {
+    pa_assert(e);
+
+    if (e->memchunk.memblock) {
+        pa_mem_account_add(e->core->scache_mem_account, -(int) e->memchunk.length);
+        pa_memblock_unref(e->memchunk.memblock);
+    }
+
+    /* Only after our own reference is gone, so that the data is copied
+     * out only if a stream still plays it */
+    if (e->mapping)
+        pa_sound_file_mapping_free(e->mapping);
+
+    pa_memchunk_reset(&e->memchunk);
+    e->mapping = NULL;
+}
+
+static void loaded(pa_scache_entry *e, const pa_channel_map *old_channel_map) {
+    pa_mem_account_add(e->core->scache_mem_account, (int) e->memchunk.length);
+
+    pa_subscription_post(e->core, PA_SUBSCRIPTION_EVENT_SAMPLE_CACHE|PA_SUBSCRIPTION_EVENT_CHANGE, e->index);
+
+    if (e->volume_is_set) {
+        if (pa_cvolume_valid(&e->volume))
+            pa_cvolume_remap(&e->volume, old_channel_map, &e->channel_map);
+        else
+            pa_cvolume_reset(&e->volume, e->sample_spec.channels);
+    }
+}
+
+static void free_job(struct load_job *j) {
+    if (j->memchunk.memblock)
+        pa_memblock_unref(j->memchunk.memblock);
+
+    if (j->mapping)
+        pa_sound_file_mapping_free(j->mapping);
+
+    pa_xfree(j->filename);
+    pa_xfree(j);
+}
+
+static void loader_thread(void *userdata) {
+    pa_scache_loader *l = userdata;
+
+    pa_mutex_lock(l->mutex);
+
+    for (;;) {
+        struct load_job *j, *k;
+
+        while (!l->jobs && !l->quit)
+            pa_cond_wait(l->cond, l->mutex);
+
+        if (l->quit)
+            break;
+
+        /* Jobs are prepended, so the oldest of the most played wins */
+        j = l->jobs;
+        PA_LLIST_FOREACH(k, l->jobs)
+            if (k->play_count >= j->play_count)
+                j = k;
+
+        PA_LLIST_REMOVE(struct load_job, l->jobs, j);
+        pa_mutex_unlock(l->mutex);
+
+        j->result = pa_sound_file_load_cached(l->core->mempool, j->filename, &j->sample_spec, &j->channel_map, &j->memchunk, NULL, &j->mapping);
+        pa_asyncmsgq_post(l->done_q, NULL, 0, j, 0, NULL, NULL);
+
+        pa_mutex_lock(l->mutex);
+    }
+
+    pa_mutex_unlock(l->mutex);
+}
+
+static void job_done(pa_core *c, struct load_job *j) {
+    pa_scache_entry *e;
+    pa_channel_map old_channel_map;
+
+    /* The entry might have been removed, replaced or loaded meanwhile */
+    if (j->result < 0 ||
+        !(e = pa_idxset_get_by_index(c->scache, j->index)) ||
+        !e->lazy ||
+        e->memchunk.memblock ||
+        !pa_streq(e->filename, j->filename)) {
+        free_job(j);
+        return;
+    }
+
+    old_channel_map = e->channel_map;
+
+    e->sample_spec = j->sample_spec;
+    e->channel_map = j->channel_map;
+    e->memchunk = j->memchunk;
+    e->mapping = j->mapping;
+    pa_memchunk_reset(&j->memchunk);
+    j->mapping = NULL;
+
+    /* Give it the full idle time before it may be unloaded again */
+    time(&e->last_used_time);
+
+    pa_log_debug("Preloaded sample \"%s\".", e->name);
+
+    loaded(e, &old_channel_map);
+    free_job(j);
+}
+
+static void done_cb(pa_mainloop_api *m, pa_io_event *e, int fd, pa_io_event_flags_t events, void *userdata) {
+    pa_scache_loader *l = userdata;
+    void *data;
+
+    pa_asyncmsgq_read_after_poll(l->done_q);
+
+    for (;;) {
+        while (pa_asyncmsgq_get(l->done_q, NULL, NULL, &data, NULL, NULL, FALSE) >= 0) {
+            pa_asyncmsgq_done(l->done_q, 0);
+            job_done(l->core, data);
+        }
+
+        if (pa_asyncmsgq_read_before_poll(l->done_q) == 0)
+            break;
+    }
+}
+
+static pa_scache_loader* loader_new(pa_core *c) {
+    pa_scache_loader *l;
+
+    l = pa_xnew0(pa_scache_loader, 1);
+    l->core = c;
+    l->mutex = pa_mutex_new(FALSE, FALSE);
+    l->cond = pa_cond_new();
+    PA_LLIST_HEAD_INIT(struct load_job, l->jobs);
+
+    pa_assert_se(l->done_q = pa_asyncmsgq_new(0));
+    pa_assert_se(pa_asyncmsgq_read_before_poll(l->done_q) == 0);
+    l->done_event = c->mainloop->io_new(c->mainloop, pa_asyncmsgq_read_fd(l->done_q), PA_IO_EVENT_INPUT, done_cb, l);
+
+    if (!(l->thread = pa_thread_new("scache-loader", loader_thread, l))) {
+        pa_log_warn("Failed to create sample loader thread, lazy samples will be loaded when played.");
+        c->mainloop->io_free(l->done_event);
+        pa_asyncmsgq_unref(l->done_q);
+        pa_cond_free(l->cond);
+        pa_mutex_free(l->mutex);
+        pa_xfree(l);
+        return NULL;
+    }
+
+    return l;
+}
+
+static void loader_free(pa_scache_loader *l) {
+    struct load_job *j;
+    void *data;
+
+    pa_mutex_lock(l->mutex);
+    l->quit = TRUE;
+    pa_cond_signal(l->cond, 0);
+    pa_mutex_unlock(l->mutex);
+
+    pa_thread_free(l->thread);
+
+    while ((j = l->jobs)) {
+        PA_LLIST_REMOVE(struct load_job, l->jobs, j);
+        free_job(j);
+    }
+
+    while (pa_asyncmsgq_get(l->done_q, NULL, NULL, &data, NULL, NULL, FALSE) >= 0) {
+        pa_asyncmsgq_done(l->done_q, 0);
+        free_job(data);
+    }
+
+    l->core->mainloop->io_free(l->done_event);
+    pa_asyncmsgq_unref(l->done_q);
+    pa_cond_free(l->cond);
+    pa_mutex_free(l->mutex);
+    pa_xfree(l);
+}
+
+static void preload(pa_scache_entry *e) {
+    pa_core *c = e->core;
+    struct load_job *j;
+
+    if (!c->scache_loader && !(c->scache_loader = loader_new(c)))
+        return;
+
+    j = pa_xnew0(struct load_job, 1);
+    j->index = e->index;
+    j->filename = pa_xstrdup(e->filename);
+    j->play_count = e->play_count;
+    PA_LLIST_INIT(struct load_job, j);
+
+    pa_mutex_lock(c->scache_loader->mutex);
+    PA_LLIST_PREPEND(struct load_job, c->scache_loader->jobs, j);
+    pa_cond_signal(c->scache_loader->cond, 0);
+    pa_mutex_unlock(c->scache_loader->mutex);
+}
+
+/* Drops the job of an entry that is about to be loaded synchronously,
+ * if the loader didn't start on it yet */
+static void cancel_preload(pa_scache_entry *e) {
+    pa_scache_loader *l;
+    struct load_job *j;
+
+    if (!(l = e->core->scache_loader))
+        return;
+
+    pa_mutex_lock(l->mutex);
+
+    PA_LLIST_FOREACH(j, l->jobs)
+        if (j->index == e->index) {
+            PA_LLIST_REMOVE(struct load_job, l->jobs, j);
+            free_job(j);
+            break;
+        }
+
+    pa_mutex_unlock(l->mutex);
+}
+
 static void free_entry(pa_scache_entry *e) {
     pa_assert(e);
 
@@ -83,8 +336,7 @@ static void free_entry(pa_scache_entry *e) {
     pa_subscription_post(e->core, PA_SUBSCRIPTION_EVENT_SAMPLE_CACHE|PA_SUBSCRIPTION_EVENT_REMOVE, e->index);
     pa_xfree(e->name);
     pa_xfree(e->filename);
-    if (e->memchunk.memblock)
-        pa_memblock_unref(e->memchunk.memblock);
+    unload_entry(e);
     if (e->proplist)
         pa_proplist_free(e->proplist);
     pa_xfree(e);
@@ -97,8 +349,7 @@ static pa_scache_entry* scache_add_item(pa_core *c, const char *name) {
     pa_assert(name);
 
     if ((e = pa_namereg_get(c, name, PA_NAMEREG_SAMPLE))) {
-        if (e->memchunk.memblock)
-            pa_memblock_unref(e->memchunk.memblock);
+        unload_entry(e);
 
         pa_xfree(e->filename);
         pa_proplist_clear(e->proplist);
@@ -117,6 +368,8 @@ static pa_scache_entry* scache_add_item(pa_core *c, const char *name) {
         e->name = pa_xstrdup(name);
         e->core = c;
         e->proplist = pa_proplist_new();
+        e->mapping = NULL;
+        e->play_count = 0;
 
         pa_idxset_put(c->scache, e, &e->index);
 
@@ -184,6 +437,7 @@ int pa_scache_add_item(
     if (chunk) {
         e->memchunk = *chunk;
         pa_memblock_ref(e->memchunk.memblock);
+        pa_mem_account_add(c->scache_mem_account, (int) e->memchunk.length);
     }
 
     if (p)
@@ -203,8 +457,11 @@ int pa_scache_add_file(pa_core *c, const char *name, const char *filename, uint3
     pa_sample_spec ss;
     pa_channel_map map;
     pa_memchunk chunk;
+    pa_sound_file_mapping *mapping;
+    pa_scache_entry *e;
     int r;
     pa_proplist *p;
+    pa_usec_t begin;
 
 #ifdef OS_IS_WIN32
     char buf[MAX_PATH];
@@ -217,10 +474,12 @@ int pa_scache_add_file(pa_core *c, const char *name, const char *filename, uint3
     pa_assert(name);
     pa_assert(filename);
 
+    begin = pa_rtclock_now();
+
     p = pa_proplist_new();
     pa_proplist_sets(p, PA_PROP_MEDIA_FILENAME, filename);
 
-    if (pa_sound_file_load(c->mempool, filename, &ss, &map, &chunk, p) < 0) {
+    if (pa_sound_file_load_cached(c->mempool, filename, &ss, &map, &chunk, p, &mapping) < 0) {
         pa_proplist_free(p);
         return -1;
     }
@@ -229,6 +488,16 @@ int pa_scache_add_file(pa_core *c, const char *name, const char *filename, uint3
     pa_memblock_unref(chunk.memblock);
     pa_proplist_free(p);
 
+    if (mapping) {
+        if (r >= 0 && (e = pa_namereg_get(c, name, PA_NAMEREG_SAMPLE)))
+            e->mapping = mapping;
+        else
+            pa_sound_file_mapping_free(mapping);
+    }
+
+    if (r >= 0)
+        pa_log_debug("Loaded sample %s in %0.1f ms.", name, (double) (pa_rtclock_now() - begin) / PA_USEC_PER_MSEC);
+
     return r;
 }
 
@@ -254,6 +523,8 @@ int pa_scache_add_file_lazy(pa_core *c, const char *name, const char *filename,
 
     pa_proplist_sets(e->proplist, PA_PROP_MEDIA_FILENAME, filename);
 
+    preload(e);
+
     if (!c->scache_auto_unload_event)
         c->scache_auto_unload_event = pa_core_rttime_new(c, pa_rtclock_now() + UNLOAD_POLL_TIME, timeout_callback, c);
 
@@ -286,6 +557,11 @@ void pa_scache_free_all(pa_core *c) {
 
     pa_assert(c);
 
+    if (c->scache_loader) {
+        loader_free(c->scache_loader);
+        c->scache_loader = NULL;
+    }
+
     while ((e = pa_idxset_steal_first(c->scache, NULL)))
         free_entry(e);
 
@@ -312,20 +588,17 @@ int pa_scache_play_item(pa_core *c, const char *name, pa_sink *sink, pa_volume_t
     pa_proplist_sets(merged, PA_PROP_MEDIA_NAME, name);
     pa_proplist_sets(merged, PA_PROP_EVENT_ID, name);
 
+    e->play_count++;
+
     if (e->lazy && !e->memchunk.memblock) {
         pa_channel_map old_channel_map = e->channel_map;
 
-        if (pa_sound_file_load(c->mempool, e->filename, &e->sample_spec, &e->channel_map, &e->memchunk, merged) < 0)
-            goto fail;
+        cancel_preload(e);
 
-        pa_subscription_post(c, PA_SUBSCRIPTION_EVENT_SAMPLE_CACHE|PA_SUBSCRIPTION_EVENT_CHANGE, e->index);
+        if (pa_sound_file_load_cached(c->mempool, e->filename, &e->sample_spec, &e->channel_map, &e->memchunk, merged, &e->mapping) < 0)
+            goto fail;
 
-        if (e->volume_is_set) {
-            if (pa_cvolume_valid(&e->volume))
-                pa_cvolume_remap(&e->volume, &old_channel_map, &e->channel_map);
-            else
-                pa_cvolume_reset(&e->volume, e->sample_spec.channels);
-        }
+        loaded(e, &old_channel_map);
     }
 
     if (!e->memchunk.memblock)
@@ -350,13 +623,21 @@ int pa_scache_play_item(pa_core *c, const char *name, pa_sink *sink, pa_volume_t
     if (p)
         pa_proplist_update(merged, PA_UPDATE_REPLACE, p);
 
-    if (pa_play_memchunk(sink,
-                         &e->sample_spec, &e->channel_map,
-                         &e->memchunk,
-                         pass_volume ? &r : NULL,
-                         merged,
-                         PA_SINK_INPUT_NO_CREATE_ON_SUSPEND|PA_SINK_INPUT_KILL_ON_SUSPEND, sink_input_idx) < 0)
-        goto fail;
+    /* The shared player has no stream of its own for each sample, fall
+     * back to one if it is busy */
+    if (!c->shared_sample_player ||
+        pa_sample_player_play(sink,
+                              &e->sample_spec, &e->channel_map,
+                              &e->memchunk,
+                              pass_volume ? &r : NULL,
+                              sink_input_idx) < 0)
+        if (pa_play_memchunk(sink,
+                             &e->sample_spec, &e->channel_map,
+                             &e->memchunk,
+                             pass_volume ? &r : NULL,
+                             merged,
+                             PA_SINK_INPUT_NO_CREATE_ON_SUSPEND|PA_SINK_INPUT_KILL_ON_SUSPEND, sink_input_idx) < 0)
+            goto fail;
 
     pa_proplist_free(merged);
 
@@ -443,8 +724,7 @@ void pa_scache_unload_unused(pa_core *c) {
         if (e->last_used_time + c->scache_idle_time > now)
             continue;
 
-        pa_memblock_unref(e->memchunk.memblock);
-        pa_memchunk_reset(&e->memchunk);
+        unload_entry(e);
 
         pa_subscription_post(c, PA_SUBSCRIPTION_EVENT_SAMPLE_CACHE|PA_SUBSCRIPTION_EVENT_CHANGE, e->index);
     }
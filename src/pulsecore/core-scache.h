@@ -26,6 +26,7 @@
 #include <pulsecore/core.h>
 #include <pulsecore/memchunk.h>
 #include <pulsecore/sink.h>
+#include <pulsecore/sound-file-cache.h>
 
 #define PA_SCACHE_ENTRY_SIZE_MAX (1024*1024*16)
 
@@ -40,11 +41,13 @@ typedef struct pa_scache_entry {
     pa_sample_spec sample_spec;
     pa_channel_map channel_map;
     pa_memchunk memchunk;
+    pa_sound_file_mapping *mapping; /* Holds the memblock if set */
 
     char *filename;
 
     pa_bool_t lazy;
     time_t last_used_time;
+    unsigned play_count; /* Kept when the entry is replaced */
 
     pa_proplist *proplist;
 } pa_scache_entry;
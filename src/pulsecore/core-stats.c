@@ -0,0 +1,135 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/proplist.h>
+
+#include <pulsecore/macro.h>
+#include <pulsecore/rtpoll.h>
+#include <pulsecore/sink.h>
+#include <pulsecore/sink-input.h>
+#include <pulsecore/source.h>
+#include <pulsecore/source-output.h>
+
+#include "core-stats.h"
+
+static void fill(pa_core_stats_info *i, pa_core_stats_object_t object, uint32_t idx, const char *name, pa_io_stats *s) {
+    pa_zero(*i);
+
+    i->object = object;
+    i->index = idx;
+    i->name = name;
+
+    i->busy_usec = (uint32_t) pa_atomic_load(&s->busy_usec);
+    i->resample_usec = (uint32_t) pa_atomic_load(&s->resample_usec);
+    i->cpu_usec = (uint32_t) pa_atomic_load(&s->cpu_usec);
+    i->rewinds = (uint32_t) pa_atomic_load(&s->rewinds);
+    i->rewind_bytes = (uint32_t) pa_atomic_load(&s->rewind_bytes);
+    i->rerender_bytes = (uint32_t) pa_atomic_load(&s->rerender_bytes);
+    i->underruns = (uint32_t) pa_atomic_load(&s->underruns);
+    i->overruns = (uint32_t) pa_atomic_load(&s->overruns);
+    i->watermark_usec = (pa_usec_t) pa_atomic_load(&s->watermark_usec);
+    i->history_bytes = (uint32_t) pa_atomic_load(&s->history_bytes);
+}
+
+void pa_core_stats_foreach(pa_core *c, pa_core_stats_cb_t cb, void *userdata) {
+    pa_sink *sink;
+    pa_source *source;
+    pa_sink_input *si;
+    pa_source_output *so;
+    pa_core_stats_info i;
+    uint32_t idx;
+
+    pa_assert(c);
+    pa_assert(cb);
+
+    PA_IDXSET_FOREACH(sink, c->sinks, idx) {
+        if (!PA_SINK_IS_LINKED(sink->state))
+            continue;
+
+        fill(&i, PA_CORE_STATS_SINK, sink->index, sink->name, &sink->thread_info.stats);
+        i.buffer_usec = pa_sink_get_latency(sink);
+
+        if (sink->thread_info.rtpoll)
+            i.cpu_usec = pa_rtpoll_get_cpu_usec(sink->thread_info.rtpoll);
+
+        cb(&i, userdata);
+    }
+
+    PA_IDXSET_FOREACH(source, c->sources, idx) {
+        if (!PA_SOURCE_IS_LINKED(source->state))
+            continue;
+
+        fill(&i, PA_CORE_STATS_SOURCE, source->index, source->name, &source->thread_info.stats);
+        i.buffer_usec = pa_source_get_latency(source);
+
+        if (source->thread_info.rtpoll)
+            i.cpu_usec = pa_rtpoll_get_cpu_usec(source->thread_info.rtpoll);
+
+        cb(&i, userdata);
+    }
+
+    PA_IDXSET_FOREACH(si, c->sink_inputs, idx) {
+        if (!PA_SINK_INPUT_IS_LINKED(si->state))
+            continue;
+
+        fill(&i, PA_CORE_STATS_SINK_INPUT, si->index, pa_proplist_gets(si->proplist, PA_PROP_MEDIA_NAME), &si->thread_info.stats);
+        i.resample_method = pa_resample_method_to_string(pa_sink_input_get_resample_method(si));
+        i.resample_degradation = si->resample_degradation;
+        i.buffer_usec = pa_sink_input_get_latency(si, NULL);
+
+        cb(&i, userdata);
+    }
+
+    PA_IDXSET_FOREACH(so, c->source_outputs, idx) {
+        if (!PA_SOURCE_OUTPUT_IS_LINKED(so->state))
+            continue;
+
+        fill(&i, PA_CORE_STATS_SOURCE_OUTPUT, so->index, pa_proplist_gets(so->proplist, PA_PROP_MEDIA_NAME), &so->thread_info.stats);
+        i.resample_method = pa_resample_method_to_string(pa_source_output_get_resample_method(so));
+        i.buffer_usec = pa_source_output_get_latency(so, NULL);
+
+        cb(&i, userdata);
+    }
+}
+
+void pa_core_stats_reset(pa_core *c) {
+    pa_sink *sink;
+    pa_source *source;
+    pa_sink_input *si;
+    pa_source_output *so;
+    uint32_t idx;
+
+    pa_assert(c);
+
+    PA_IDXSET_FOREACH(sink, c->sinks, idx)
+        pa_io_stats_reset(&sink->thread_info.stats);
+
+    PA_IDXSET_FOREACH(source, c->sources, idx)
+        pa_io_stats_reset(&source->thread_info.stats);
+
+    PA_IDXSET_FOREACH(si, c->sink_inputs, idx)
+        pa_io_stats_reset(&si->thread_info.stats);
+
+    PA_IDXSET_FOREACH(so, c->source_outputs, idx)
+        pa_io_stats_reset(&so->thread_info.stats);
+}
@@ -0,0 +1,77 @@
+#ifndef foopulsecorecorestatshfoo
+#define foopulsecorecorestatshfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulsecore/core.h>
+
+/* The IO thread statistics of all devices and streams, in a form
+ * that the protocols can pass on, see pa_io_stats */
+
+typedef enum pa_core_stats_object {
+    PA_CORE_STATS_SINK,
+    PA_CORE_STATS_SOURCE,
+    PA_CORE_STATS_SINK_INPUT,
+    PA_CORE_STATS_SOURCE_OUTPUT
+} pa_core_stats_object_t;
+
+typedef struct pa_core_stats_info {
+    pa_core_stats_object_t object;
+    uint32_t index;
+    const char *name;
+
+    uint32_t busy_usec;
+    uint32_t resample_usec;
+
+    /* Of devices, the CPU time of the IO thread they run in, which
+     * isn't reset. Of the streams feeding filter devices, the CPU time
+     * of the filter. */
+    uint32_t cpu_usec;
+    uint32_t rewinds;
+    uint32_t rewind_bytes;
+    uint32_t rerender_bytes;
+    uint32_t underruns;
+    uint32_t overruns;
+
+    /* Of streams only, NULL if there's no resampler */
+    const char *resample_method;
+
+    /* Of sink inputs, how many steps their resampler has been moved
+     * towards cheaper methods */
+    uint32_t resample_degradation;
+
+    /* What a device currently has in its hardware buffer, or a stream
+     * in its own */
+    pa_usec_t buffer_usec;
+
+    pa_usec_t watermark_usec;
+    uint32_t history_bytes;
+} pa_core_stats_info;
+
+typedef void (*pa_core_stats_cb_t)(const pa_core_stats_info *i, void *userdata);
+
+/* Calls cb for every linked sink, source, sink input and source
+ * output. Called from main context. */
+void pa_core_stats_foreach(pa_core *c, pa_core_stats_cb_t cb, void *userdata);
+
+/* Starts counting from zero again */
+void pa_core_stats_reset(pa_core *c);
+
+#endif
@@ -25,10 +25,12 @@
 
 #include <stdio.h>
 
+#include <pulse/rtclock.h>
 #include <pulse/xmalloc.h>
 
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/hashmap.h>
 
 #include "core-subscribe.h"
 
@@ -37,7 +39,13 @@
  * register a callback function that is called whenever an event
  * matching a subscription mask happens. The execution of the callback
  * function is postponed to the next main loop iteration, i.e. is not
- * called from within the stack frame the entity was created in. */
+ * called from within the stack frame the entity was created in.
+ *
+ * If core->subscription_coalesce_usec is set, CHANGE events for the
+ * same object are dispatched at most once in that time. A change that
+ * comes in earlier is held back until the time is over, so that a
+ * burst of changes (e.g. from a volume slider) results in few events
+ * carrying the final state. */
 
 struct pa_subscription {
     pa_core *core;
@@ -47,6 +55,10 @@ struct pa_subscription {
     void *userdata;
     pa_subscription_mask_t mask;
 
+    /* For each facility the only object to pass events on for, or
+     * PA_INVALID_INDEX for all of them */
+    uint32_t filter[PA_SUBSCRIPTION_EVENT_FACILITY_MASK + 1];
+
     PA_LLIST_FIELDS(pa_subscription);
 };
 
@@ -59,11 +71,23 @@ struct pa_subscription_event {
     PA_LLIST_FIELDS(pa_subscription_event);
 };
 
+/* When the last event for an object was dispatched, and whether a
+ * change has been held back since */
+struct change {
+    pa_subscription_event_type_t facility;
+    uint32_t index;
+
+    pa_usec_t dispatched;
+    pa_bool_t pending;
+};
+
 static void sched_event(pa_core *c);
+static void queue_event(pa_core *c, pa_subscription_event_type_t t, uint32_t idx);
 
 /* Allocate a new subscription object for the given subscription mask. Use the specified callback function and user data */
 pa_subscription* pa_subscription_new(pa_core *c, pa_subscription_mask_t m, pa_subscription_cb_t callback, void *userdata) {
     pa_subscription *s;
+    unsigned i;
 
     pa_assert(c);
     pa_assert(m);
@@ -76,10 +100,22 @@ pa_subscription* pa_subscription_new(pa_core *c, pa_subscription_mask_t m, pa_su
     s->userdata = userdata;
     s->mask = m;
 
+    for (i = 0; i < PA_ELEMENTSOF(s->filter); i++)
+        s->filter[i] = PA_INVALID_INDEX;
+
     PA_LLIST_PREPEND(pa_subscription, c->subscriptions, s);
     return s;
 }
 
+/* Only pass on events of the facility for the object idx. Passing
+ * PA_INVALID_INDEX removes the filter again. */
+void pa_subscription_set_filter(pa_subscription *s, pa_subscription_event_type_t facility, uint32_t idx) {
+    pa_assert(s);
+    pa_assert((facility & ~PA_SUBSCRIPTION_EVENT_FACILITY_MASK) == 0);
+
+    s->filter[facility] = idx;
+}
+
 /* Free a subscription object, effectively marking it for deletion */
 void pa_subscription_free(pa_subscription*s) {
     pa_assert(s);
@@ -109,6 +145,10 @@ static void free_event(pa_subscription_event *s) {
 }
 
 /* Free all subscription objects */
+static void change_free_cb(void *p, void *userdata) {
+    pa_xfree(p);
+}
+
 void pa_subscription_free_all(pa_core *c) {
     pa_assert(c);
 
@@ -122,6 +162,136 @@ void pa_subscription_free_all(pa_core *c) {
         c->mainloop->defer_free(c->subscription_defer_event);
         c->subscription_defer_event = NULL;
     }
+
+    if (c->subscription_time_event) {
+        c->mainloop->time_free(c->subscription_time_event);
+        c->subscription_time_event = NULL;
+    }
+
+    if (c->subscription_changes) {
+        pa_hashmap_free(c->subscription_changes, change_free_cb, NULL);
+        c->subscription_changes = NULL;
+    }
+}
+
+static unsigned change_hash_func(const void *p) {
+    const struct change *ch = p;
+
+    return ch->index * (PA_SUBSCRIPTION_EVENT_FACILITY_MASK + 1) + (unsigned) ch->facility;
+}
+
+static int change_compare_func(const void *a, const void *b) {
+    const struct change *x = a, *y = b;
+
+    if (x->facility != y->facility)
+        return x->facility < y->facility ? -1 : 1;
+
+    if (x->index != y->index)
+        return x->index < y->index ? -1 : 1;
+
+    return 0;
+}
+
+/* Sends the changes that have been held back long enough and forgets
+ * about objects that have been quiet for a while */
+static void change_time_cb(pa_mainloop_api *m, pa_time_event *e, const struct timeval *t, void *userdata) {
+    pa_core *c = userdata;
+    struct change *ch;
+    void *state;
+    pa_usec_t now, next = 0;
+
+    pa_assert(c);
+    pa_assert(c->subscription_time_event == e);
+
+    now = pa_rtclock_now();
+
+    PA_HASHMAP_FOREACH(ch, c->subscription_changes, state) {
+
+        if (ch->dispatched + c->subscription_coalesce_usec <= now) {
+
+            if (!ch->pending) {
+                pa_hashmap_remove(c->subscription_changes, ch);
+                pa_xfree(ch);
+                continue;
+            }
+
+            ch->pending = FALSE;
+            ch->dispatched = now;
+            queue_event(c, ch->facility | PA_SUBSCRIPTION_EVENT_CHANGE, ch->index);
+        }
+
+        if (next == 0 || ch->dispatched + c->subscription_coalesce_usec < next)
+            next = ch->dispatched + c->subscription_coalesce_usec;
+    }
+
+    if (next > 0)
+        pa_core_rttime_restart(c, e, next);
+    else {
+        c->mainloop->time_free(e);
+        c->subscription_time_event = NULL;
+    }
+}
+
+/* Remembers when an event for an object has been dispatched. The timer
+ * always runs while there are entries, no later than when the oldest
+ * of them expires, which is before any of the later entries does. */
+static void change_dispatched(pa_core *c, pa_subscription_event *e) {
+    struct change key, *ch;
+
+    pa_assert(c);
+    pa_assert(e);
+
+    if (c->subscription_coalesce_usec <= 0)
+        return;
+
+    key.facility = e->type & PA_SUBSCRIPTION_EVENT_FACILITY_MASK;
+    key.index = e->index;
+
+    if ((e->type & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_REMOVE) {
+        if (c->subscription_changes && (ch = pa_hashmap_remove(c->subscription_changes, &key)))
+            pa_xfree(ch);
+
+        return;
+    }
+
+    if (!c->subscription_changes)
+        c->subscription_changes = pa_hashmap_new(change_hash_func, change_compare_func);
+
+    if (!(ch = pa_hashmap_get(c->subscription_changes, &key))) {
+        ch = pa_xnew(struct change, 1);
+        *ch = key;
+        ch->pending = FALSE;
+        pa_hashmap_put(c->subscription_changes, ch, ch);
+    }
+
+    ch->dispatched = pa_rtclock_now();
+
+    if (!c->subscription_time_event)
+        c->subscription_time_event = pa_core_rttime_new(c, ch->dispatched + c->subscription_coalesce_usec, change_time_cb, c);
+}
+
+/* Returns TRUE if a change event should be held back for now */
+static pa_bool_t change_delay(pa_core *c, pa_subscription_event_type_t t, uint32_t idx) {
+    struct change key, *ch;
+
+    pa_assert(c);
+
+    if (c->subscription_coalesce_usec <= 0 || !c->subscription_changes)
+        return FALSE;
+
+    key.facility = t & PA_SUBSCRIPTION_EVENT_FACILITY_MASK;
+    key.index = idx;
+
+    if (!(ch = pa_hashmap_get(c->subscription_changes, &key)))
+        return FALSE;
+
+    if (ch->dispatched + c->subscription_coalesce_usec <= pa_rtclock_now())
+        return FALSE;
+
+    pa_assert(c->subscription_time_event);
+    ch->pending = TRUE;
+
+    return TRUE;
 }
 
 #ifdef DEBUG
@@ -169,11 +339,19 @@ static void defer_cb(pa_mainloop_api *m, pa_defer_event *de, void *userdata) {
         pa_subscription_event *e = c->subscription_event_queue;
 
         for (s = c->subscriptions; s; s = s->next) {
+            uint32_t filter;
 
-            if (!s->dead && pa_subscription_match_flags(s->mask, e->type))
+            if (s->dead || !pa_subscription_match_flags(s->mask, e->type))
+                continue;
+
+            filter = s->filter[e->type & PA_SUBSCRIPTION_EVENT_FACILITY_MASK];
+
+            if (filter == PA_INVALID_INDEX || filter == e->index)
                 s->callback(c, e->type, e->index, s->userdata);
         }
 
+        change_dispatched(c, e);
+
 #ifdef DEBUG
         dump_event("Dispatched", e);
 #endif
@@ -205,7 +383,6 @@ static void sched_event(pa_core *c) {
 
 /* Append a new subscription event to the subscription event queue and schedule a main loop event */
 void pa_subscription_post(pa_core *c, pa_subscription_event_type_t t, uint32_t idx) {
-    pa_subscription_event *e;
     pa_assert(c);
 
     /* No need for queuing subscriptions of no one is listening */
@@ -245,8 +422,17 @@ void pa_subscription_post(pa_core *c, pa_subscription_event_type_t t, uint32_t i
                 return;
             }
         }
+
+        if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_CHANGE && change_delay(c, t, idx))
+            return;
     }
 
+    queue_event(c, t, idx);
+}
+
+static void queue_event(pa_core *c, pa_subscription_event_type_t t, uint32_t idx) {
+    pa_subscription_event *e;
+
     e = pa_xnew(pa_subscription_event, 1);
     e->core = c;
     e->type = t;
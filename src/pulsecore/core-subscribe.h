@@ -32,6 +32,7 @@ typedef void (*pa_subscription_cb_t)(pa_core *c, pa_subscription_event_type_t t,
 
 pa_subscription* pa_subscription_new(pa_core *c, pa_subscription_mask_t m,  pa_subscription_cb_t cb, void *userdata);
 void pa_subscription_free(pa_subscription*s);
+void pa_subscription_set_filter(pa_subscription *s, pa_subscription_event_type_t facility, uint32_t idx);
 void pa_subscription_free_all(pa_core *c);
 
 void pa_subscription_post(pa_core *c, pa_subscription_event_type_t t, uint32_t idx);
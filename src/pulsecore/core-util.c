@@ -761,6 +761,95 @@ int pa_make_realtime(int rtprio) {
     return -1;
 }
 
+#define CPU_LIST_MAX 1024
+
+/* Parses CPU lists like "0-3,8" into a bitmap of CPU_LIST_MAX bits */
+static int parse_cpu_list(const char *cpus, uint8_t *bits) {
+    const char *state = NULL;
+    char *t;
+    unsigned n = 0;
+
+    pa_assert(cpus);
+    pa_assert(bits);
+
+    memset(bits, 0, CPU_LIST_MAX / 8);
+
+    while ((t = pa_split(cpus, ",", &state))) {
+        uint32_t first, last;
+        char *dash;
+
+        if ((dash = strchr(t, '-')))
+            *(dash++) = 0;
+
+        if (pa_atou(t, &first) < 0)
+            goto fail;
+
+        if (!dash)
+            last = first;
+        else if (pa_atou(dash, &last) < 0)
+            goto fail;
+
+        if (first > last || last >= CPU_LIST_MAX)
+            goto fail;
+
+        for (; first <= last; first++, n++)
+            bits[first / 8] |= (uint8_t) (1U << (first % 8));
+
+        pa_xfree(t);
+    }
+
+    return n > 0 ? 0 : -1;
+
+fail:
+    pa_xfree(t);
+    return -1;
+}
+
+pa_bool_t pa_cpu_list_valid(const char *cpus) {
+    uint8_t bits[CPU_LIST_MAX / 8];
+
+    pa_assert(cpus);
+
+    return parse_cpu_list(cpus, bits) >= 0;
+}
+
+/* Pin the current thread to the CPUs listed in cpus. Threads created
+ * later by this thread inherit this. */
+int pa_set_thread_affinity(const char *cpus) {
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+    uint8_t bits[CPU_LIST_MAX / 8];
+    cpu_set_t mask;
+    unsigned k;
+    int r;
+
+    pa_assert(cpus);
+
+    if (parse_cpu_list(cpus, bits) < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    CPU_ZERO(&mask);
+
+    for (k = 0; k < (unsigned) PA_MIN(CPU_LIST_MAX, CPU_SETSIZE); k++)
+        if (bits[k / 8] & (1U << (k % 8)))
+            CPU_SET(k, &mask);
+
+    if ((r = pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask)) != 0) {
+        errno = r;
+        return -1;
+    }
+
+    pa_log_info("Pinned thread to CPUs %s.", cpus);
+    return 0;
+#else
+    pa_assert(cpus);
+
+    errno = ENOTSUP;
+    return -1;
+#endif
+}
+
 #ifdef HAVE_SYS_RESOURCE_H
 static int set_nice(int nice_level) {
 #ifdef HAVE_DBUS
@@ -78,6 +78,8 @@ char *pa_strlcpy(char *b, const char *s, size_t l);
 char *pa_parent_dir(const char *fn);
 
 int pa_make_realtime(int rtprio);
+pa_bool_t pa_cpu_list_valid(const char *cpus);
+int pa_set_thread_affinity(const char *cpus);
 int pa_raise_priority(int nice_level);
 void pa_reset_priority(void);
 
@@ -27,14 +27,19 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <signal.h>
+#include <errno.h>
 
 #include <pulse/rtclock.h>
 #include <pulse/timeval.h>
 #include <pulse/xmalloc.h>
 
 #include <pulsecore/module.h>
+#include <pulsecore/sink-input.h>
+#include <pulsecore/source-output.h>
+#include <pulsecore/client.h>
 #include <pulsecore/core-rtclock.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/core-error.h>
 #include <pulsecore/core-scache.h>
 #include <pulsecore/core-subscribe.h>
 #include <pulsecore/random.h>
@@ -61,9 +66,134 @@ static int core_process_msg(pa_msgobject *o, int code, void *userdata, int64_t o
     }
 }
 
+/* How often idle pool memory is given back while there is more than
+ * RECLAIM_HIGH_WATER of it */
+#define RECLAIM_INTERVAL (10 * PA_USEC_PER_SEC)
+#define RECLAIM_HIGH_WATER (4 * 1024 * 1024)
+
 static void core_free(pa_object *o);
 
-pa_core* pa_core_new(pa_mainloop_api *m, pa_bool_t shared, size_t shm_size) {
+/* Accessors for the hook filters. The object of a stream is the sink
+ * or source it is connected to at the time the hook fires. */
+
+static void* sink_get_object(pa_sink *s) {
+    return s;
+}
+
+static pa_proplist* sink_get_proplist(pa_sink *s) {
+    return s->proplist;
+}
+
+static void* source_get_object(pa_source *s) {
+    return s;
+}
+
+static pa_proplist* source_get_proplist(pa_source *s) {
+    return s->proplist;
+}
+
+static void* sink_input_new_data_get_object(pa_sink_input_new_data *data) {
+    return data->sink;
+}
+
+static pa_proplist* sink_input_new_data_get_proplist(pa_sink_input_new_data *data) {
+    return data->proplist;
+}
+
+static void* sink_input_get_object(pa_sink_input *i) {
+    return i->sink;
+}
+
+static pa_proplist* sink_input_get_proplist(pa_sink_input *i) {
+    return i->proplist;
+}
+
+static void* source_output_new_data_get_object(pa_source_output_new_data *data) {
+    return data->source;
+}
+
+static pa_proplist* source_output_new_data_get_proplist(pa_source_output_new_data *data) {
+    return data->proplist;
+}
+
+static void* source_output_get_object(pa_source_output *o) {
+    return o->source;
+}
+
+static pa_proplist* source_output_get_proplist(pa_source_output *o) {
+    return o->proplist;
+}
+
+static pa_proplist* client_get_proplist(pa_client *c) {
+    return c->proplist;
+}
+
+static void set_hook_accessors(pa_core *c) {
+    static const pa_core_hook_t sink_hooks[] = {
+        PA_CORE_HOOK_SINK_PUT,
+        PA_CORE_HOOK_SINK_UNLINK,
+        PA_CORE_HOOK_SINK_UNLINK_POST,
+        PA_CORE_HOOK_SINK_STATE_CHANGED,
+        PA_CORE_HOOK_SINK_PROPLIST_CHANGED,
+        PA_CORE_HOOK_SINK_PORT_CHANGED
+    };
+    static const pa_core_hook_t source_hooks[] = {
+        PA_CORE_HOOK_SOURCE_PUT,
+        PA_CORE_HOOK_SOURCE_UNLINK,
+        PA_CORE_HOOK_SOURCE_UNLINK_POST,
+        PA_CORE_HOOK_SOURCE_STATE_CHANGED,
+        PA_CORE_HOOK_SOURCE_PROPLIST_CHANGED,
+        PA_CORE_HOOK_SOURCE_PORT_CHANGED
+    };
+    static const pa_core_hook_t sink_input_hooks[] = {
+        PA_CORE_HOOK_SINK_INPUT_PUT,
+        PA_CORE_HOOK_SINK_INPUT_UNLINK,
+        PA_CORE_HOOK_SINK_INPUT_UNLINK_POST,
+        PA_CORE_HOOK_SINK_INPUT_MOVE_START,
+        PA_CORE_HOOK_SINK_INPUT_MOVE_FINISH,
+        PA_CORE_HOOK_SINK_INPUT_MOVE_FAIL,
+        PA_CORE_HOOK_SINK_INPUT_STATE_CHANGED,
+        PA_CORE_HOOK_SINK_INPUT_PROPLIST_CHANGED
+    };
+    static const pa_core_hook_t source_output_hooks[] = {
+        PA_CORE_HOOK_SOURCE_OUTPUT_PUT,
+        PA_CORE_HOOK_SOURCE_OUTPUT_UNLINK,
+        PA_CORE_HOOK_SOURCE_OUTPUT_UNLINK_POST,
+        PA_CORE_HOOK_SOURCE_OUTPUT_MOVE_START,
+        PA_CORE_HOOK_SOURCE_OUTPUT_MOVE_FINISH,
+        PA_CORE_HOOK_SOURCE_OUTPUT_MOVE_FAIL,
+        PA_CORE_HOOK_SOURCE_OUTPUT_STATE_CHANGED,
+        PA_CORE_HOOK_SOURCE_OUTPUT_PROPLIST_CHANGED
+    };
+    static const pa_core_hook_t client_hooks[] = {
+        PA_CORE_HOOK_CLIENT_PUT,
+        PA_CORE_HOOK_CLIENT_UNLINK,
+        PA_CORE_HOOK_CLIENT_PROPLIST_CHANGED
+    };
+    unsigned j;
+
+    for (j = 0; j < PA_ELEMENTSOF(sink_hooks); j++)
+        pa_hook_set_accessors(&c->hooks[sink_hooks[j]], (pa_hook_object_cb_t) sink_get_object, (pa_hook_proplist_cb_t) sink_get_proplist);
+
+    for (j = 0; j < PA_ELEMENTSOF(source_hooks); j++)
+        pa_hook_set_accessors(&c->hooks[source_hooks[j]], (pa_hook_object_cb_t) source_get_object, (pa_hook_proplist_cb_t) source_get_proplist);
+
+    for (j = 0; j < PA_ELEMENTSOF(sink_input_hooks); j++)
+        pa_hook_set_accessors(&c->hooks[sink_input_hooks[j]], (pa_hook_object_cb_t) sink_input_get_object, (pa_hook_proplist_cb_t) sink_input_get_proplist);
+
+    for (j = 0; j < PA_ELEMENTSOF(source_output_hooks); j++)
+        pa_hook_set_accessors(&c->hooks[source_output_hooks[j]], (pa_hook_object_cb_t) source_output_get_object, (pa_hook_proplist_cb_t) source_output_get_proplist);
+
+    for (j = 0; j < PA_ELEMENTSOF(client_hooks); j++)
+        pa_hook_set_accessors(&c->hooks[client_hooks[j]], NULL, (pa_hook_proplist_cb_t) client_get_proplist);
+
+    pa_hook_set_accessors(&c->hooks[PA_CORE_HOOK_SINK_INPUT_NEW], (pa_hook_object_cb_t) sink_input_new_data_get_object, (pa_hook_proplist_cb_t) sink_input_new_data_get_proplist);
+    pa_hook_set_accessors(&c->hooks[PA_CORE_HOOK_SINK_INPUT_FIXATE], (pa_hook_object_cb_t) sink_input_new_data_get_object, (pa_hook_proplist_cb_t) sink_input_new_data_get_proplist);
+    pa_hook_set_accessors(&c->hooks[PA_CORE_HOOK_SOURCE_OUTPUT_NEW], (pa_hook_object_cb_t) source_output_new_data_get_object, (pa_hook_proplist_cb_t) source_output_new_data_get_proplist);
+    pa_hook_set_accessors(&c->hooks[PA_CORE_HOOK_SOURCE_OUTPUT_FIXATE], (pa_hook_object_cb_t) source_output_new_data_get_object, (pa_hook_proplist_cb_t) source_output_new_data_get_proplist);
+}
+
+pa_core* pa_core_new(pa_mainloop_api *m, pa_bool_t shared, size_t shm_size, size_t shm_slot_size, size_t shm_small_slot_size) {
     pa_core* c;
     pa_mempool *pool;
     int j;
@@ -71,14 +201,14 @@ pa_core* pa_core_new(pa_mainloop_api *m, pa_bool_t shared, size_t shm_size) {
     pa_assert(m);
 
     if (shared) {
-        if (!(pool = pa_mempool_new(shared, shm_size))) {
+        if (!(pool = pa_mempool_new_full(shared, FALSE, shm_size, shm_slot_size, shm_small_slot_size))) {
             pa_log_warn("failed to allocate shared memory pool. Falling back to a normal memory pool.");
             shared = FALSE;
         }
     }
 
     if (!shared) {
-        if (!(pool = pa_mempool_new(shared, shm_size))) {
+        if (!(pool = pa_mempool_new_full(shared, FALSE, shm_size, shm_slot_size, shm_small_slot_size))) {
             pa_log("pa_mempool_new() failed.");
             return NULL;
         }
@@ -102,6 +232,7 @@ pa_core* pa_core_new(pa_mainloop_api *m, pa_bool_t shared, size_t shm_size) {
 
     c->namereg = pa_hashmap_new(pa_idxset_string_hash_func, pa_idxset_string_compare_func);
     c->shared = pa_hashmap_new(pa_idxset_string_hash_func, pa_idxset_string_compare_func);
+    c->sample_players = pa_hashmap_new(NULL, NULL);
 
     c->default_source = NULL;
     c->default_sink = NULL;
@@ -115,37 +246,62 @@ pa_core* pa_core_new(pa_mainloop_api *m, pa_bool_t shared, size_t shm_size) {
 
     c->deferred_volume_safety_margin_usec = 8000;
     c->deferred_volume_extra_delay_usec = 0;
+    c->sink_input_history_msec = -1;
+    c->volume_ramp_msec = 0;
+
+    c->mem_account = pa_mem_account_new(NULL, 0);
+    c->scache_mem_account = pa_mem_account_new(c->mem_account, 0);
+    c->client_memory_budget = 0;
 
     c->module_defer_unload_event = NULL;
+    c->module_deferred_loads = NULL;
+    c->module_deferred_load_event = NULL;
     c->scache_auto_unload_event = NULL;
+    c->scache_loader = NULL;
 
     c->subscription_defer_event = NULL;
     PA_LLIST_HEAD_INIT(pa_subscription, c->subscriptions);
     PA_LLIST_HEAD_INIT(pa_subscription_event, c->subscription_event_queue);
     c->subscription_event_last = NULL;
+    c->subscription_changes = NULL;
+    c->subscription_time_event = NULL;
+    c->subscription_coalesce_usec = 0;
 
     c->mempool = pool;
+    c->shm_size = shm_size;
+    c->shm_slot_size = shm_slot_size;
+    c->shm_small_slot_size = shm_small_slot_size;
     pa_silence_cache_init(&c->silence_cache);
+    c->resampler_cache = pa_resampler_cache_new();
 
     c->exit_event = NULL;
+    c->reclaim_event = NULL;
 
     c->exit_idle_time = -1;
     c->scache_idle_time = 20;
 
     c->flat_volumes = TRUE;
     c->disallow_module_loading = FALSE;
+    c->defer_module_loading = FALSE;
     c->disallow_exit = FALSE;
+    c->disallow_restart = TRUE;
+    c->restart_requested = FALSE;
     c->running_as_daemon = FALSE;
     c->realtime_scheduling = FALSE;
     c->realtime_priority = 5;
+    c->io_cpu_affinity = NULL;
     c->disable_remixing = FALSE;
     c->disable_lfe_remixing = FALSE;
+    c->float32_mixing = FALSE;
     c->deferred_volume = TRUE;
+    c->shared_sample_player = FALSE;
     c->resample_method = PA_RESAMPLER_SPEEX_FLOAT_BASE + 3;
 
     for (j = 0; j < PA_CORE_HOOK_MAX; j++)
         pa_hook_init(&c->hooks[j], c);
 
+    set_hook_accessors(c);
+
     pa_random(&c->cookie, sizeof(c->cookie));
 
 #ifdef SIGPIPE
@@ -199,20 +355,31 @@ static void core_free(pa_object *o) {
     pa_assert(pa_hashmap_isempty(c->shared));
     pa_hashmap_free(c->shared, NULL, NULL);
 
+    pa_assert(pa_hashmap_isempty(c->sample_players));
+    pa_hashmap_free(c->sample_players, NULL, NULL);
+
     pa_subscription_free_all(c);
 
     if (c->exit_event)
         c->mainloop->time_free(c->exit_event);
 
+    if (c->reclaim_event)
+        c->mainloop->time_free(c->reclaim_event);
+
     pa_assert(!c->default_source);
     pa_assert(!c->default_sink);
 
+    pa_mem_account_unref(c->scache_mem_account);
+    pa_mem_account_unref(c->mem_account);
+
     pa_silence_cache_done(&c->silence_cache);
+    pa_resampler_cache_free(c->resampler_cache);
     pa_mempool_free(c->mempool);
 
     for (j = 0; j < PA_CORE_HOOK_MAX; j++)
         pa_hook_done(&c->hooks[j]);
 
+    pa_xfree(c->io_cpu_affinity);
     pa_xfree(c);
 }
 
@@ -224,9 +391,35 @@ static void exit_callback(pa_mainloop_api *m, pa_time_event *e, const struct tim
     pa_core_exit(c, TRUE, 0);
 }
 
+static void reclaim_callback(pa_mainloop_api *m, pa_time_event *e, const struct timeval *t, void *userdata) {
+    pa_core *c = userdata;
+    pa_assert(c->reclaim_event == e);
+
+    if (pa_mempool_reclaim(c->mempool, RECLAIM_HIGH_WATER))
+        pa_core_rttime_restart(c, e, pa_rtclock_now() + RECLAIM_INTERVAL);
+    else {
+        m->time_free(e);
+        c->reclaim_event = NULL;
+    }
+}
+
+/* Called whenever memory may have been released in large amounts, the
+ * timer stops by itself when there is little left to give back */
+static void start_reclaim(pa_core *c) {
+    pa_assert(c);
+
+    if (c->reclaim_event)
+        return;
+
+    c->reclaim_event = pa_core_rttime_new(c, pa_rtclock_now() + RECLAIM_INTERVAL, reclaim_callback, c);
+}
+
 void pa_core_check_idle(pa_core *c) {
     pa_assert(c);
 
+    if (c->state == PA_CORE_RUNNING)
+        start_reclaim(c);
+
     if (!c->exit_event &&
         c->exit_idle_time >= 0 &&
         pa_idxset_size(c->clients) == 0) {
@@ -249,9 +442,22 @@ int pa_core_exit(pa_core *c, pa_bool_t force, int retval) {
     return 0;
 }
 
+int pa_core_restart(pa_core *c) {
+    pa_assert(c);
+
+    if (c->disallow_exit || c->disallow_restart)
+        return -1;
+
+    c->restart_requested = TRUE;
+    c->mainloop->quit(c->mainloop, 0);
+    return 0;
+}
+
 void pa_core_maybe_vacuum(pa_core *c) {
     pa_assert(c);
 
+    start_reclaim(c);
+
     if (pa_idxset_isempty(c->sink_inputs) && pa_idxset_isempty(c->source_outputs)) {
         pa_log_debug("Hmm, no streams around, trying to vacuum.");
         pa_mempool_vacuum(c->mempool);
@@ -292,3 +498,20 @@ void pa_core_rttime_restart(pa_core *c, pa_time_event *e, pa_usec_t usec) {
 
     c->mainloop->time_restart(e, pa_timeval_rtstore(&tv, usec, TRUE));
 }
+
+/* Called from IO context */
+void pa_core_setup_io_thread(pa_core *c, int rtprio, const char *cpus) {
+    pa_assert(c);
+
+    if (rtprio < 0)
+        rtprio = c->realtime_priority;
+
+    if (c->realtime_scheduling && rtprio > 0)
+        pa_make_realtime(rtprio);
+
+    if (!cpus)
+        cpus = c->io_cpu_affinity;
+
+    if (cpus && pa_set_thread_affinity(cpus) < 0)
+        pa_log_warn("Failed to pin thread to CPUs %s: %s", cpus, pa_cstrerror(errno));
+}
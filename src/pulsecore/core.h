@@ -42,8 +42,10 @@ typedef enum pa_suspend_cause {
 #include <pulsecore/idxset.h>
 #include <pulsecore/hashmap.h>
 #include <pulsecore/memblock.h>
+#include <pulsecore/mem-account.h>
 #include <pulsecore/resampler.h>
 #include <pulsecore/llist.h>
+#include <pulsecore/queue.h>
 #include <pulsecore/hook-list.h>
 #include <pulsecore/asyncmsgq.h>
 #include <pulsecore/sample-util.h>
@@ -138,6 +140,9 @@ struct pa_core {
     /* Some hashmaps for all sorts of entities */
     pa_hashmap *namereg, *shared;
 
+    /* The shared sample players, by sink index */
+    pa_hashmap *sample_players;
+
     /* The default sink/source */
     pa_source *default_source;
     pa_sink *default_sink;
@@ -149,32 +154,67 @@ struct pa_core {
     unsigned deferred_volume_safety_margin_usec;
     int deferred_volume_extra_delay_usec;
 
+    /* How much rendered audio sink inputs keep for rewinds, or -1 for
+     * as much as their sink can rewind */
+    int sink_input_history_msec;
+
+    /* Soft volume changes of sink inputs are faded in over this
+     * instead of rewinding for them, if > 0 */
+    unsigned volume_ramp_msec;
+
+    /* The audio kept in memblockqs and the sample cache, against the
+     * global budget. Every client has an account below mem_account,
+     * with a budget of client_memory_budget. */
+    pa_mem_account *mem_account, *scache_mem_account;
+    size_t client_memory_budget;
+
     pa_defer_event *module_defer_unload_event;
 
+    /* Modules to load from the main loop once startup is done, see
+     * pa_module_load_deferred() */
+    pa_queue *module_deferred_loads;
+    pa_defer_event *module_deferred_load_event;
+
     pa_defer_event *subscription_defer_event;
     PA_LLIST_HEAD(pa_subscription, subscriptions);
     PA_LLIST_HEAD(pa_subscription_event, subscription_event_queue);
     pa_subscription_event *subscription_event_last;
+    pa_hashmap *subscription_changes;
+    pa_time_event *subscription_time_event;
+    pa_usec_t subscription_coalesce_usec;
 
     pa_mempool *mempool;
     pa_silence_cache silence_cache;
+    pa_resampler_cache *resampler_cache;
+
+    /* Pools created for clients are sized like the core's own */
+    size_t shm_size, shm_slot_size, shm_small_slot_size;
 
     pa_time_event *exit_event;
+    pa_time_event *reclaim_event;
     pa_time_event *scache_auto_unload_event;
+    struct pa_scache_loader *scache_loader;
 
     int exit_idle_time, scache_idle_time;
 
     pa_bool_t flat_volumes:1;
     pa_bool_t disallow_module_loading:1;
+    /* Set by the CLI while it runs a load-module after .defer */
+    pa_bool_t defer_module_loading:1;
     pa_bool_t disallow_exit:1;
+    pa_bool_t disallow_restart:1;
+    pa_bool_t restart_requested:1;
     pa_bool_t running_as_daemon:1;
     pa_bool_t realtime_scheduling:1;
     pa_bool_t disable_remixing:1;
     pa_bool_t disable_lfe_remixing:1;
+    pa_bool_t float32_mixing:1;
     pa_bool_t deferred_volume:1;
+    pa_bool_t shared_sample_player:1;
 
     pa_resample_method_t resample_method;
     int realtime_priority;
+    char *io_cpu_affinity;
 
     pa_server_type_t server_type;
     pa_cpu_info cpu_info;
@@ -191,17 +231,27 @@ enum {
     PA_CORE_MESSAGE_MAX
 };
 
-pa_core* pa_core_new(pa_mainloop_api *m, pa_bool_t shared, size_t shm_size);
+pa_core* pa_core_new(pa_mainloop_api *m, pa_bool_t shared, size_t shm_size, size_t shm_slot_size, size_t shm_small_slot_size);
 
 /* Check whether no one is connected to this core */
 void pa_core_check_idle(pa_core *c);
 
 int pa_core_exit(pa_core *c, pa_bool_t force, int retval);
 
+/* Like pa_core_exit(), but asks the daemon to execute itself again
+ * afterwards, handing over the listening sockets */
+int pa_core_restart(pa_core *c);
+
 void pa_core_maybe_vacuum(pa_core *c);
 
 /* wrapper for c->mainloop->time_*() RT time events */
 pa_time_event* pa_core_rttime_new(pa_core *c, pa_usec_t usec, pa_time_event_cb_t cb, void *userdata);
 void pa_core_rttime_restart(pa_core *c, pa_time_event *e, pa_usec_t usec);
 
+/* To be called by IO threads when they start up. Makes the thread
+ * realtime with the given priority, and pins it to the given CPUs.
+ * Pass rtprio < 0 and cpus = NULL for the defaults of the core, and
+ * rtprio = 0 to not make the thread realtime. */
+void pa_core_setup_io_thread(pa_core *c, int rtprio, const char *cpus);
+
 #endif
@@ -135,6 +135,15 @@ pa_bool_t pa_cpu_init_arm(pa_cpu_arm_flag_t *flags) {
     if (*flags & PA_CPU_ARM_V6)
         pa_volume_func_init_arm(*flags);
 
+    if (*flags & PA_CPU_ARM_NEON) {
+        pa_volume_func_init_neon(*flags);
+        pa_convert_func_init_neon(*flags);
+        pa_mix_func_init_neon(*flags);
+        pa_polyphase_func_init_neon(*flags);
+        pa_peaks_func_init_neon(*flags);
+        pa_cmul_func_init_neon(*flags);
+    }
+
     return TRUE;
 
 #else /* defined (__linux__) */
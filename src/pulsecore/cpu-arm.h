@@ -39,5 +39,11 @@ pa_bool_t pa_cpu_init_arm(pa_cpu_arm_flag_t *flags);
 
 /* some optimized functions */
 void pa_volume_func_init_arm(pa_cpu_arm_flag_t flags);
+void pa_volume_func_init_neon(pa_cpu_arm_flag_t flags);
+void pa_mix_func_init_neon(pa_cpu_arm_flag_t flags);
+void pa_convert_func_init_neon(pa_cpu_arm_flag_t flags);
+void pa_polyphase_func_init_neon(pa_cpu_arm_flag_t flags);
+void pa_peaks_func_init_neon(pa_cpu_arm_flag_t flags);
+void pa_cmul_func_init_neon(pa_cpu_arm_flag_t flags);
 
 #endif /* foocpuarmhfoo */
@@ -31,8 +31,21 @@ void pa_cpu_init_orc(pa_cpu_info cpu_info)
     /* Update these as we test on more architectures */
     pa_cpu_x86_flag_t x86_want_flags = PA_CPU_X86_MMX | PA_CPU_X86_SSE | PA_CPU_X86_SSE2 | PA_CPU_X86_SSE3 | PA_CPU_X86_SSSE3 | PA_CPU_X86_SSE4_1 | PA_CPU_X86_SSE4_2;
 
-    /* Enable Orc svolume optimizations */
-    if ((cpu_info.cpu_type == PA_CPU_X86) && (cpu_info.flags.x86 & x86_want_flags))
+    /* Enable Orc svolume optimizations, unless the AVX2 functions are
+     * available which are faster */
+    pa_bool_t x86 = cpu_info.cpu_type == PA_CPU_X86, arm = cpu_info.cpu_type == PA_CPU_ARM;
+
+    if (x86 && (cpu_info.flags.x86 & x86_want_flags) && !(cpu_info.flags.x86 & PA_CPU_X86_AVX2))
         pa_volume_func_init_orc();
+
+    /* Everywhere else the hand written versions come first, Orc is for
+     * the architectures that don't have any */
+    if (!(x86 && (cpu_info.flags.x86 & PA_CPU_X86_SSE2)) && !(arm && (cpu_info.flags.arm & PA_CPU_ARM_NEON))) {
+        pa_mix_func_init_orc();
+        pa_convert_func_init_orc();
+    }
+
+    if (!(x86 && (cpu_info.flags.x86 & (PA_CPU_X86_MMX | PA_CPU_X86_SSE2))))
+        pa_remap_func_init_orc();
 #endif
 }
@@ -39,9 +39,23 @@ static void get_cpuid(uint32_t op, uint32_t *a, uint32_t *b, uint32_t *c, uint32
         "  pop %%"PA_REG_b"    \n\t"
 
         : "=a" (*a), "=S" (*b), "=c" (*c), "=d" (*d)
-        : "0" (op)
+        : "0" (op), "2" (0)
     );
 }
+
+/* Returns the state components the OS saves on context switches */
+static uint32_t get_xcr0(void) {
+    uint32_t eax, edx;
+
+    __asm__ __volatile__ (
+        "  xgetbv              \n\t"
+
+        : "=a" (eax), "=d" (edx)
+        : "c" (0)
+    );
+
+    return eax;
+}
 #endif
 
 pa_bool_t pa_cpu_init_x86(pa_cpu_x86_flag_t *flags) {
@@ -79,6 +93,17 @@ pa_bool_t pa_cpu_init_x86(pa_cpu_x86_flag_t *flags) {
 
         if (ecx & (1<<20))
           *flags |= PA_CPU_X86_SSE4_2;
+
+        /* AVX needs the OS to save the YMM registers, too */
+        if ((ecx & (1<<27)) && (ecx & (1<<28)) && (get_xcr0() & 0x6) == 0x6)
+          *flags |= PA_CPU_X86_AVX;
+    }
+
+    if (level >= 7 && (*flags & PA_CPU_X86_AVX)) {
+        get_cpuid(0x00000007, &eax, &ebx, &ecx, &edx);
+
+        if (ebx & (1<<5))
+          *flags |= PA_CPU_X86_AVX2;
     }
 
     /* get extended level */
@@ -99,7 +124,7 @@ pa_bool_t pa_cpu_init_x86(pa_cpu_x86_flag_t *flags) {
           *flags |= PA_CPU_X86_3DNOW;
     }
 
-    pa_log_info("CPU flags: %s%s%s%s%s%s%s%s%s%s%s",
+    pa_log_info("CPU flags: %s%s%s%s%s%s%s%s%s%s%s%s%s",
     (*flags & PA_CPU_X86_CMOV) ? "CMOV " : "",
     (*flags & PA_CPU_X86_MMX) ? "MMX " : "",
     (*flags & PA_CPU_X86_SSE) ? "SSE " : "",
@@ -108,6 +133,8 @@ pa_bool_t pa_cpu_init_x86(pa_cpu_x86_flag_t *flags) {
     (*flags & PA_CPU_X86_SSSE3) ? "SSSE3 " : "",
     (*flags & PA_CPU_X86_SSE4_1) ? "SSE4_1 " : "",
     (*flags & PA_CPU_X86_SSE4_2) ? "SSE4_2 " : "",
+    (*flags & PA_CPU_X86_AVX) ? "AVX " : "",
+    (*flags & PA_CPU_X86_AVX2) ? "AVX2 " : "",
     (*flags & PA_CPU_X86_MMXEXT) ? "MMXEXT " : "",
     (*flags & PA_CPU_X86_3DNOW) ? "3DNOW " : "",
     (*flags & PA_CPU_X86_3DNOWEXT) ? "3DNOWEXT " : "");
@@ -122,6 +149,20 @@ pa_bool_t pa_cpu_init_x86(pa_cpu_x86_flag_t *flags) {
         pa_volume_func_init_sse(*flags);
         pa_remap_func_init_sse(*flags);
         pa_convert_func_init_sse(*flags);
+        pa_mix_func_init_sse(*flags);
+        pa_cmul_func_init_sse(*flags);
+        pa_interleave_func_init_sse(*flags);
+    }
+
+    if (*flags & PA_CPU_X86_AVX)
+        pa_cmul_func_init_avx(*flags);
+
+    if (*flags & PA_CPU_X86_AVX2) {
+        pa_volume_func_init_avx(*flags);
+        pa_convert_func_init_avx(*flags);
+        pa_mix_func_init_avx(*flags);
+        pa_polyphase_func_init_avx(*flags);
+        pa_peaks_func_init_avx(*flags);
     }
 
     return TRUE;
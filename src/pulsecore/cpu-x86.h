@@ -37,7 +37,9 @@ typedef enum pa_cpu_x86_flag {
     PA_CPU_X86_SSE4_2    = (1 << 7),
     PA_CPU_X86_3DNOW     = (1 << 8),
     PA_CPU_X86_3DNOWEXT  = (1 << 9),
-    PA_CPU_X86_CMOV      = (1 << 10)
+    PA_CPU_X86_CMOV      = (1 << 10),
+    PA_CPU_X86_AVX       = (1 << 11),
+    PA_CPU_X86_AVX2      = (1 << 12)
 } pa_cpu_x86_flag_t;
 
 pa_bool_t pa_cpu_init_x86 (pa_cpu_x86_flag_t *flags);
@@ -60,13 +62,35 @@ typedef int64_t pa_reg_x86;
 #define PA_REG_S "rsi"
 #endif
 
+/* Newer compilers can emit instructions that are not enabled for the
+ * whole build inside functions tagged with this. Such functions must
+ * only be called after the CPU flags have been checked. */
+#if (defined (__i386__) || defined (__amd64__)) && defined (__GNUC__) && \
+    ((__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define PA_HAVE_X86_TARGET_ATTRIBUTE 1
+#define PA_X86_TARGET(isa) __attribute__ ((target (isa)))
+#endif
+
 /* some optimized functions */
 void pa_volume_func_init_mmx(pa_cpu_x86_flag_t flags);
 void pa_volume_func_init_sse(pa_cpu_x86_flag_t flags);
+void pa_volume_func_init_avx(pa_cpu_x86_flag_t flags);
 
 void pa_remap_func_init_mmx(pa_cpu_x86_flag_t flags);
 void pa_remap_func_init_sse(pa_cpu_x86_flag_t flags);
 
 void pa_convert_func_init_sse (pa_cpu_x86_flag_t flags);
+void pa_convert_func_init_avx(pa_cpu_x86_flag_t flags);
+
+void pa_mix_func_init_sse(pa_cpu_x86_flag_t flags);
+void pa_mix_func_init_avx(pa_cpu_x86_flag_t flags);
+
+void pa_polyphase_func_init_avx(pa_cpu_x86_flag_t flags);
+void pa_peaks_func_init_avx(pa_cpu_x86_flag_t flags);
+
+void pa_cmul_func_init_sse(pa_cpu_x86_flag_t flags);
+void pa_cmul_func_init_avx(pa_cpu_x86_flag_t flags);
+
+void pa_interleave_func_init_sse(pa_cpu_x86_flag_t flags);
 
 #endif /* foocpux86hfoo */
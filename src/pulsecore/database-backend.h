@@ -0,0 +1,53 @@
+#ifndef foopulsecoredatabasebackendhfoo
+#define foopulsecoredatabasebackendhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulsecore/database.h>
+
+/* The interface each of database-gdbm.c, database-tdb.c,
+ * database-simple.c and database-journal.c implements. Only
+ * database.c calls these: it keeps a copy of the contents in memory
+ * and hands the changes to the backend from its writer thread. A
+ * backend handle is only used by one thread at a time. */
+
+typedef struct pa_database_backend pa_database_backend;
+
+/* Frees what _get(), _first() and _next() returned */
+void pa_database_backend_datum_free(pa_datum *d);
+
+pa_database_backend* pa_database_backend_open(const char *fn, pa_bool_t for_write);
+void pa_database_backend_close(pa_database_backend *db);
+
+pa_datum* pa_database_backend_get(pa_database_backend *db, const pa_datum *key, pa_datum* data);
+
+int pa_database_backend_set(pa_database_backend *db, const pa_datum *key, const pa_datum* data, pa_bool_t overwrite);
+int pa_database_backend_unset(pa_database_backend *db, const pa_datum *key);
+
+int pa_database_backend_clear(pa_database_backend *db);
+
+signed pa_database_backend_size(pa_database_backend *db);
+
+pa_datum* pa_database_backend_first(pa_database_backend *db, pa_datum *key, pa_datum *data /* may be NULL */);
+pa_datum* pa_database_backend_next(pa_database_backend *db, const pa_datum *key, pa_datum *next, pa_datum *data /* may be NULL */);
+
+int pa_database_backend_sync(pa_database_backend *db);
+
+#endif
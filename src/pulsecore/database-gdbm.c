@@ -30,7 +30,7 @@
 #include <pulsecore/core-util.h>
 #include <pulsecore/log.h>
 
-#include "database.h"
+#include "database-backend.h"
 
 #define MAKE_GDBM_FILE(x) ((GDBM_FILE) (x))
 
@@ -54,14 +54,14 @@ static inline pa_datum* datum_from_gdbm(pa_datum *to, const datum *from) {
     return to;
 }
 
-void pa_datum_free(pa_datum *d) {
+void pa_database_backend_datum_free(pa_datum *d) {
     pa_assert(d);
 
     free(d->data); /* gdbm uses raw malloc/free hence we should do that here, too */
     pa_zero(d);
 }
 
-pa_database* pa_database_open(const char *fn, pa_bool_t for_write) {
+pa_database_backend* pa_database_backend_open(const char *fn, pa_bool_t for_write) {
     GDBM_FILE f;
     int gdbm_cache_size;
     char *path;
@@ -94,16 +94,16 @@ pa_database* pa_database_open(const char *fn, pa_bool_t for_write) {
     gdbm_cache_size = 10;
     gdbm_setopt(f, GDBM_CACHESIZE, &gdbm_cache_size, sizeof(gdbm_cache_size));
 
-    return (pa_database*) f;
+    return (pa_database_backend*) f;
 }
 
-void pa_database_close(pa_database *db) {
+void pa_database_backend_close(pa_database_backend *db) {
     pa_assert(db);
 
     gdbm_close(MAKE_GDBM_FILE(db));
 }
 
-pa_datum* pa_database_get(pa_database *db, const pa_datum *key, pa_datum* data) {
+pa_datum* pa_database_backend_get(pa_database_backend *db, const pa_datum *key, pa_datum* data) {
     datum gdbm_key, gdbm_data;
 
     pa_assert(db);
@@ -117,7 +117,7 @@ pa_datum* pa_database_get(pa_database *db, const pa_datum *key, pa_datum* data)
         NULL;
 }
 
-int pa_database_set(pa_database *db, const pa_datum *key, const pa_datum* data, pa_bool_t overwrite) {
+int pa_database_backend_set(pa_database_backend *db, const pa_datum *key, const pa_datum* data, pa_bool_t overwrite) {
     datum gdbm_key, gdbm_data;
 
     pa_assert(db);
@@ -130,7 +130,7 @@ int pa_database_set(pa_database *db, const pa_datum *key, const pa_datum* data,
                       overwrite ? GDBM_REPLACE : GDBM_INSERT) != 0 ? -1 : 0;
 }
 
-int pa_database_unset(pa_database *db, const pa_datum *key) {
+int pa_database_backend_unset(pa_database_backend *db, const pa_datum *key) {
     datum gdbm_key;
 
     pa_assert(db);
@@ -139,7 +139,7 @@ int pa_database_unset(pa_database *db, const pa_datum *key) {
     return gdbm_delete(MAKE_GDBM_FILE(db), *datum_to_gdbm(&gdbm_key, key)) != 0 ? -1 : 0;
 }
 
-int pa_database_clear(pa_database *db) {
+int pa_database_backend_clear(pa_database_backend *db) {
     datum gdbm_key;
 
     pa_assert(db);
@@ -160,7 +160,7 @@ int pa_database_clear(pa_database *db) {
     return gdbm_reorganize(MAKE_GDBM_FILE(db)) == 0 ? 0 : -1;
 }
 
-signed pa_database_size(pa_database *db) {
+signed pa_database_backend_size(pa_database_backend *db) {
     datum gdbm_key;
     unsigned n = 0;
 
@@ -183,7 +183,7 @@ signed pa_database_size(pa_database *db) {
     return (signed) n;
 }
 
-pa_datum* pa_database_first(pa_database *db, pa_datum *key, pa_datum *data) {
+pa_datum* pa_database_backend_first(pa_database_backend *db, pa_datum *key, pa_datum *data) {
     datum gdbm_key, gdbm_data;
 
     pa_assert(db);
@@ -210,7 +210,7 @@ pa_datum* pa_database_first(pa_database *db, pa_datum *key, pa_datum *data) {
     return key;
 }
 
-pa_datum* pa_database_next(pa_database *db, const pa_datum *key, pa_datum *next, pa_datum *data) {
+pa_datum* pa_database_backend_next(pa_database_backend *db, const pa_datum *key, pa_datum *next, pa_datum *data) {
     datum gdbm_key, gdbm_data;
 
     pa_assert(db);
@@ -218,7 +218,7 @@ pa_datum* pa_database_next(pa_database *db, const pa_datum *key, pa_datum *next,
     pa_assert(next);
 
     if (!key)
-        return pa_database_first(db, next, data);
+        return pa_database_backend_first(db, next, data);
 
     gdbm_key = gdbm_nextkey(MAKE_GDBM_FILE(db), *datum_to_gdbm(&gdbm_key, key));
 
@@ -241,7 +241,7 @@ pa_datum* pa_database_next(pa_database *db, const pa_datum *key, pa_datum *next,
     return next;
 }
 
-int pa_database_sync(pa_database *db) {
+int pa_database_backend_sync(pa_database_backend *db) {
     pa_assert(db);
 
     gdbm_sync(MAKE_GDBM_FILE(db));
@@ -0,0 +1,726 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#include <pulse/xmalloc.h>
+#include <pulsecore/atomic.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/core-error.h>
+#include <pulsecore/hashmap.h>
+#include <pulsecore/thread.h>
+
+#include "database-backend.h"
+
+/* The file is a log of changes: a magic string followed by records,
+ * which are replayed on load. A sync only appends the records for the
+ * keys that changed since the last one. Once the log has grown to
+ * well beyond what the entries need, a snapshot of them is written to
+ * a new file in a thread, which then replaces the log.
+ *
+ * A record is an op byte, the lengths of key and data and a checksum,
+ * all integers 32 bit little endian, followed by key and data. */
+
+#define MAGIC "PADBJRN1"
+#define MAGIC_SIZE 8
+#define RECORD_HEADER_SIZE 13
+
+/* Don't bother compacting small files */
+#define COMPACT_MIN_SIZE (64*1024)
+
+enum {
+    RECORD_SET = 1,
+    RECORD_UNSET = 2,
+    RECORD_CLEAR = 3
+};
+
+typedef struct buffer {
+    uint8_t *data;
+    size_t length, allocated;
+} buffer;
+
+typedef struct journal_data {
+    char *filename;
+    char *tmp_filename;
+    pa_hashmap *map;
+    pa_bool_t read_only;
+
+    int fd;
+    size_t file_size;
+
+    /* What a freshly compacted file would take */
+    size_t live_size;
+
+    /* The keys changed since the last sync, those without an entry in
+     * map were removed */
+    pa_hashmap *dirty;
+    pa_bool_t cleared;
+
+    pa_thread *compact_thread;
+    pa_atomic_t compact_done;
+    int compact_result;
+    buffer snapshot;
+
+    /* Records synced while the snapshot is written, they have to be
+     * appended to it before it can replace the log */
+    buffer since_snapshot;
+} journal_data;
+
+typedef struct entry {
+    pa_datum key;
+    pa_datum data;
+} entry;
+
+void pa_database_backend_datum_free(pa_datum *d) {
+    pa_assert(d);
+
+    pa_xfree(d->data);
+    d->data = NULL;
+    d->size = 0;
+}
+
+static int compare_func(const void *a, const void *b) {
+    const pa_datum *aa, *bb;
+
+    aa = (const pa_datum*)a;
+    bb = (const pa_datum*)b;
+
+    if (aa->size != bb->size)
+        return aa->size > bb->size ? 1 : -1;
+
+    return memcmp(aa->data, bb->data, aa->size);
+}
+
+/* pa_idxset_string_hash_func modified for our use */
+static unsigned hash_func(const void *p) {
+    const pa_datum *d;
+    unsigned hash = 0;
+    const char *c;
+    unsigned i;
+
+    d = (const pa_datum*)p;
+    c = d->data;
+
+    for (i = 0; i < d->size; i++) {
+        hash = 31 * hash + (unsigned) *c;
+        c++;
+    }
+
+    return hash;
+}
+
+static entry* new_entry(const pa_datum *key, const pa_datum *data) {
+    entry *e;
+
+    pa_assert(key);
+    pa_assert(data);
+
+    e = pa_xnew0(entry, 1);
+    e->key.data = key->size > 0 ? pa_xmemdup(key->data, key->size) : NULL;
+    e->key.size = key->size;
+    e->data.data = data->size > 0 ? pa_xmemdup(data->data, data->size) : NULL;
+    e->data.size = data->size;
+    return e;
+}
+
+static void free_entry(entry *e) {
+    if (e) {
+        pa_xfree(e->key.data);
+        pa_xfree(e->data.data);
+        pa_xfree(e);
+    }
+}
+
+static pa_datum* new_key(const pa_datum *key) {
+    pa_datum *k;
+
+    k = pa_xnew0(pa_datum, 1);
+    k->data = key->size > 0 ? pa_xmemdup(key->data, key->size) : NULL;
+    k->size = key->size;
+    return k;
+}
+
+static void free_key(pa_datum *k) {
+    pa_database_backend_datum_free(k);
+    pa_xfree(k);
+}
+
+static size_t record_size(const entry *e) {
+    return RECORD_HEADER_SIZE + e->key.size + e->data.size;
+}
+
+static void buffer_append(buffer *b, const void *data, size_t length) {
+    if (b->length + length > b->allocated) {
+        b->allocated = PA_MAX(2 * b->allocated, b->length + length);
+        b->data = pa_xrealloc(b->data, b->allocated);
+    }
+
+    memcpy(b->data + b->length, data, length);
+    b->length += length;
+}
+
+static void buffer_done(buffer *b) {
+    pa_xfree(b->data);
+    b->data = NULL;
+    b->length = b->allocated = 0;
+}
+
+static void write_uint(uint8_t *p, uint32_t num) {
+    int i;
+
+    for (i = 0; i < 4; i++)
+        p[i] = (num >> (i*8)) & 0xFF;
+}
+
+static uint32_t read_uint(const uint8_t *p) {
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+/* FNV-1a */
+static uint32_t checksum(uint32_t hash, const uint8_t *p, size_t length) {
+    size_t i;
+
+    for (i = 0; i < length; i++) {
+        hash ^= p[i];
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+/* The checksum covers the op byte, the lengths, key and data */
+static uint32_t record_checksum(const uint8_t *header, const void *key, size_t key_size, const void *data, size_t data_size) {
+    uint32_t hash = 2166136261U;
+
+    hash = checksum(hash, header, 9);
+    hash = checksum(hash, key, key_size);
+    return checksum(hash, data, data_size);
+}
+
+static void append_record(buffer *b, uint8_t op, const pa_datum *key, const pa_datum *data) {
+    uint8_t header[RECORD_HEADER_SIZE];
+    size_t key_size = key ? key->size : 0, data_size = data ? data->size : 0;
+
+    header[0] = op;
+    write_uint(header + 1, (uint32_t) key_size);
+    write_uint(header + 5, (uint32_t) data_size);
+    write_uint(header + 9, record_checksum(header, key ? key->data : NULL, key_size, data ? data->data : NULL, data_size));
+
+    buffer_append(b, header, sizeof(header));
+
+    if (key_size > 0)
+        buffer_append(b, key->data, key_size);
+    if (data_size > 0)
+        buffer_append(b, data->data, data_size);
+}
+
+static void put_entry(journal_data *db, entry *e) {
+    entry *old;
+
+    if ((old = pa_hashmap_remove(db->map, &e->key))) {
+        db->live_size -= record_size(old);
+        free_entry(old);
+    }
+
+    pa_assert_se(pa_hashmap_put(db->map, &e->key, e) >= 0);
+    db->live_size += record_size(e);
+}
+
+static void remove_entry(journal_data *db, const pa_datum *key) {
+    entry *e;
+
+    if ((e = pa_hashmap_remove(db->map, key))) {
+        db->live_size -= record_size(e);
+        free_entry(e);
+    }
+}
+
+static void clear_entries(journal_data *db) {
+    entry *e;
+
+    while ((e = pa_hashmap_steal_first(db->map)))
+        free_entry(e);
+
+    db->live_size = MAGIC_SIZE;
+}
+
+static void mark_dirty(journal_data *db, const pa_datum *key) {
+    pa_datum *k;
+
+    if (pa_hashmap_get(db->dirty, key))
+        return;
+
+    k = new_key(key);
+    pa_assert_se(pa_hashmap_put(db->dirty, k, k) >= 0);
+}
+
+static void clear_dirty(journal_data *db) {
+    pa_datum *k;
+
+    while ((k = pa_hashmap_steal_first(db->dirty)))
+        free_key(k);
+}
+
+/* Replays the records in p, returns how many bytes of it are valid */
+static size_t replay(journal_data *db, const uint8_t *p, size_t length) {
+    size_t offset;
+
+    if (length < MAGIC_SIZE || memcmp(p, MAGIC, MAGIC_SIZE) != 0) {
+        pa_log_warn("%s is not a database journal, ignoring it.", db->filename);
+        return 0;
+    }
+
+    offset = MAGIC_SIZE;
+
+    while (offset < length) {
+        const uint8_t *header = p + offset;
+        pa_datum key, data;
+
+        if (length - offset < RECORD_HEADER_SIZE)
+            break;
+
+        key.size = read_uint(header + 1);
+        data.size = read_uint(header + 5);
+
+        if (key.size > length - offset - RECORD_HEADER_SIZE ||
+            data.size > length - offset - RECORD_HEADER_SIZE - key.size)
+            break;
+
+        key.data = (void*) (header + RECORD_HEADER_SIZE);
+        data.data = (uint8_t*) key.data + key.size;
+
+        if (read_uint(header + 9) != record_checksum(header, key.data, key.size, data.data, data.size))
+            break;
+
+        switch (header[0]) {
+            case RECORD_SET:
+                put_entry(db, new_entry(&key, &data));
+                break;
+
+            case RECORD_UNSET:
+                remove_entry(db, &key);
+                break;
+
+            case RECORD_CLEAR:
+                clear_entries(db);
+                break;
+
+            default:
+                goto finish;
+        }
+
+        offset += RECORD_HEADER_SIZE + key.size + data.size;
+    }
+
+finish:
+    if (offset < length)
+        pa_log_warn("Dropping %lu bytes of garbage at the end of %s, probably from a crash.",
+                    (unsigned long) (length - offset), db->filename);
+
+    return offset;
+}
+
+static int load(journal_data *db) {
+    struct stat st;
+    void *p;
+
+    if (fstat(db->fd, &st) < 0)
+        return -1;
+
+    if (st.st_size == 0)
+        return 0;
+
+    if ((size_t) st.st_size != (uint64_t) st.st_size) {
+        errno = EFBIG;
+        return -1;
+    }
+
+    if ((p = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, db->fd, 0)) == MAP_FAILED)
+        return -1;
+
+    db->file_size = replay(db, p, (size_t) st.st_size);
+    munmap(p, (size_t) st.st_size);
+
+    /* Appending after the garbage would hide the new records */
+    if (!db->read_only && db->file_size < (size_t) st.st_size)
+        if (ftruncate(db->fd, (off_t) db->file_size) < 0)
+            return -1;
+
+    return 0;
+}
+
+pa_database_backend* pa_database_backend_open(const char *fn, pa_bool_t for_write) {
+    journal_data *db;
+    char *path;
+    int saved_errno;
+
+    pa_assert(fn);
+
+    path = pa_sprintf_malloc("%s.journal", fn);
+
+    db = pa_xnew0(journal_data, 1);
+    db->map = pa_hashmap_new(hash_func, compare_func);
+    db->dirty = pa_hashmap_new(hash_func, compare_func);
+    db->filename = path;
+    db->tmp_filename = pa_sprintf_malloc("%s.tmp", path);
+    db->read_only = !for_write;
+    db->live_size = MAGIC_SIZE;
+
+    errno = 0;
+    db->fd = pa_open_cloexec(path, for_write ? O_RDWR|O_CREAT : O_RDONLY, 0666);
+
+    /* A missing file is ok for reading */
+    if (db->fd < 0 && !(errno == ENOENT && !for_write))
+        goto fail;
+
+    if (db->fd >= 0 && load(db) < 0)
+        goto fail;
+
+    return (pa_database_backend*) db;
+
+fail:
+    saved_errno = errno ? errno : EIO;
+    pa_database_backend_close((pa_database_backend*) db);
+    errno = saved_errno;
+
+    return NULL;
+}
+
+/* Called from the compaction thread */
+static void compact_thread(void *userdata) {
+    journal_data *db = userdata;
+    int fd;
+
+    db->compact_result = -1;
+
+    if ((fd = pa_open_cloexec(db->tmp_filename, O_WRONLY|O_CREAT|O_TRUNC, 0666)) < 0) {
+        pa_log_warn("Failed to create %s: %s", db->tmp_filename, pa_cstrerror(errno));
+        goto finish;
+    }
+
+    if (pa_loop_write(fd, db->snapshot.data, db->snapshot.length, NULL) != (ssize_t) db->snapshot.length ||
+        fsync(fd) < 0)
+        pa_log_warn("Failed to write %s: %s", db->tmp_filename, pa_cstrerror(errno));
+    else
+        db->compact_result = 0;
+
+    pa_close(fd);
+
+finish:
+    pa_atomic_store(&db->compact_done, 1);
+}
+
+static void start_compaction(journal_data *db) {
+    entry *e;
+    void *state;
+
+    pa_assert(!db->compact_thread);
+
+    buffer_done(&db->snapshot);
+    buffer_append(&db->snapshot, MAGIC, MAGIC_SIZE);
+
+    PA_HASHMAP_FOREACH(e, db->map, state)
+        append_record(&db->snapshot, RECORD_SET, &e->key, &e->data);
+
+    pa_atomic_store(&db->compact_done, 0);
+
+    if (!(db->compact_thread = pa_thread_new("database-compact", compact_thread, db))) {
+        pa_log_warn("Failed to start compacting %s.", db->filename);
+        buffer_done(&db->snapshot);
+    }
+}
+
+/* Replaces the log with the snapshot once that is written, with the
+ * records synced meanwhile appended. If wait is FALSE and the thread is
+ * still busy, does nothing. */
+static void finish_compaction(journal_data *db, pa_bool_t wait) {
+    int fd;
+
+    if (!db->compact_thread)
+        return;
+
+    if (!wait && !pa_atomic_load(&db->compact_done))
+        return;
+
+    pa_thread_free(db->compact_thread);
+    db->compact_thread = NULL;
+
+    if (db->compact_result < 0)
+        goto fail;
+
+    if ((fd = pa_open_cloexec(db->tmp_filename, O_RDWR|O_APPEND, 0666)) < 0)
+        goto fail;
+
+    if (db->since_snapshot.length > 0 &&
+        pa_loop_write(fd, db->since_snapshot.data, db->since_snapshot.length, NULL) != (ssize_t) db->since_snapshot.length) {
+        pa_close(fd);
+        goto fail;
+    }
+
+    if (rename(db->tmp_filename, db->filename) < 0) {
+        pa_log_warn("error while renaming file. %s", pa_cstrerror(errno));
+        pa_close(fd);
+        goto fail;
+    }
+
+    pa_close(db->fd);
+    db->fd = fd;
+    db->file_size = db->snapshot.length + db->since_snapshot.length;
+
+    pa_log_debug("Compacted %s to %lu bytes.", db->filename, (unsigned long) db->file_size);
+
+    buffer_done(&db->snapshot);
+    buffer_done(&db->since_snapshot);
+    return;
+
+fail:
+    /* The old log still has everything */
+    unlink(db->tmp_filename);
+    buffer_done(&db->snapshot);
+    buffer_done(&db->since_snapshot);
+}
+
+void pa_database_backend_close(pa_database_backend *database) {
+    journal_data *db = (journal_data*)database;
+    pa_assert(db);
+
+    if (db->fd >= 0)
+        pa_database_backend_sync(database);
+
+    finish_compaction(db, TRUE);
+
+    if (db->fd >= 0)
+        pa_close(db->fd);
+
+    clear_dirty(db);
+    pa_hashmap_free(db->dirty, NULL, NULL);
+    clear_entries(db);
+    pa_hashmap_free(db->map, NULL, NULL);
+    pa_xfree(db->filename);
+    pa_xfree(db->tmp_filename);
+    pa_xfree(db);
+}
+
+pa_datum* pa_database_backend_get(pa_database_backend *database, const pa_datum *key, pa_datum* data) {
+    journal_data *db = (journal_data*)database;
+    entry *e;
+
+    pa_assert(db);
+    pa_assert(key);
+    pa_assert(data);
+
+    e = pa_hashmap_get(db->map, key);
+
+    if (!e)
+        return NULL;
+
+    data->data = e->data.size > 0 ? pa_xmemdup(e->data.data, e->data.size) : NULL;
+    data->size = e->data.size;
+
+    return data;
+}
+
+int pa_database_backend_set(pa_database_backend *database, const pa_datum *key, const pa_datum* data, pa_bool_t overwrite) {
+    journal_data *db = (journal_data*)database;
+
+    pa_assert(db);
+    pa_assert(key);
+    pa_assert(data);
+
+    if (db->read_only)
+        return -1;
+
+    if (!overwrite && pa_hashmap_get(db->map, key))
+        return -1;
+
+    put_entry(db, new_entry(key, data));
+    mark_dirty(db, key);
+
+    return 0;
+}
+
+int pa_database_backend_unset(pa_database_backend *database, const pa_datum *key) {
+    journal_data *db = (journal_data*)database;
+
+    pa_assert(db);
+    pa_assert(key);
+
+    if (!pa_hashmap_get(db->map, key))
+        return -1;
+
+    remove_entry(db, key);
+    mark_dirty(db, key);
+
+    return 0;
+}
+
+int pa_database_backend_clear(pa_database_backend *database) {
+    journal_data *db = (journal_data*)database;
+
+    pa_assert(db);
+
+    clear_entries(db);
+    clear_dirty(db);
+    db->cleared = TRUE;
+
+    return 0;
+}
+
+signed pa_database_backend_size(pa_database_backend *database) {
+    journal_data *db = (journal_data*)database;
+    pa_assert(db);
+
+    return (signed) pa_hashmap_size(db->map);
+}
+
+pa_datum* pa_database_backend_first(pa_database_backend *database, pa_datum *key, pa_datum *data) {
+    journal_data *db = (journal_data*)database;
+    entry *e;
+
+    pa_assert(db);
+    pa_assert(key);
+
+    e = pa_hashmap_first(db->map);
+
+    if (!e)
+        return NULL;
+
+    key->data = e->key.size > 0 ? pa_xmemdup(e->key.data, e->key.size) : NULL;
+    key->size = e->key.size;
+
+    if (data) {
+        data->data = e->data.size > 0 ? pa_xmemdup(e->data.data, e->data.size) : NULL;
+        data->size = e->data.size;
+    }
+
+    return key;
+}
+
+pa_datum* pa_database_backend_next(pa_database_backend *database, const pa_datum *key, pa_datum *next, pa_datum *data) {
+    journal_data *db = (journal_data*)database;
+    entry *e;
+    entry *search;
+    void *state;
+    pa_bool_t pick_now;
+
+    pa_assert(db);
+    pa_assert(next);
+
+    if (!key)
+        return pa_database_backend_first(database, next, data);
+
+    search = pa_hashmap_get(db->map, key);
+
+    state = NULL;
+    pick_now = FALSE;
+
+    while ((e = pa_hashmap_iterate(db->map, &state, NULL))) {
+        if (pick_now)
+            break;
+
+        if (search == e)
+            pick_now = TRUE;
+    }
+
+    if (!pick_now || !e)
+        return NULL;
+
+    next->data = e->key.size > 0 ? pa_xmemdup(e->key.data, e->key.size) : NULL;
+    next->size = e->key.size;
+
+    if (data) {
+        data->data = e->data.size > 0 ? pa_xmemdup(e->data.data, e->data.size) : NULL;
+        data->size = e->data.size;
+    }
+
+    return next;
+}
+
+int pa_database_backend_sync(pa_database_backend *database) {
+    journal_data *db = (journal_data*)database;
+    buffer b = { NULL, 0, 0 };
+    pa_datum *k;
+    void *state;
+
+    pa_assert(db);
+
+    if (db->read_only)
+        return 0;
+
+    finish_compaction(db, FALSE);
+
+    if (!db->cleared && pa_hashmap_isempty(db->dirty))
+        return 0;
+
+    if (db->file_size == 0)
+        buffer_append(&b, MAGIC, MAGIC_SIZE);
+
+    if (db->cleared)
+        append_record(&b, RECORD_CLEAR, NULL, NULL);
+
+    PA_HASHMAP_FOREACH(k, db->dirty, state) {
+        entry *e;
+
+        if ((e = pa_hashmap_get(db->map, k)))
+            append_record(&b, RECORD_SET, &e->key, &e->data);
+        else
+            append_record(&b, RECORD_UNSET, k, NULL);
+    }
+
+    errno = 0;
+
+    if (lseek(db->fd, (off_t) db->file_size, SEEK_SET) == (off_t) -1 ||
+        pa_loop_write(db->fd, b.data, b.length, NULL) != (ssize_t) b.length) {
+        pa_log_warn("error while writing to file. %s", pa_cstrerror(errno));
+
+        /* Don't leave half a record behind */
+        if (ftruncate(db->fd, (off_t) db->file_size) < 0)
+            pa_log_warn("error while truncating file. %s", pa_cstrerror(errno));
+
+        buffer_done(&b);
+        return -1;
+    }
+
+    db->file_size += b.length;
+
+    /* The log can't have been empty then, so there is no magic in b */
+    if (db->compact_thread)
+        buffer_append(&db->since_snapshot, b.data, b.length);
+
+    buffer_done(&b);
+    clear_dirty(db);
+    db->cleared = FALSE;
+
+    if (!db->compact_thread && db->file_size > COMPACT_MIN_SIZE && db->file_size > 2 * db->live_size)
+        start_compaction(db);
+
+    return 0;
+}
@@ -35,7 +35,7 @@
 #include <pulsecore/core-error.h>
 #include <pulsecore/hashmap.h>
 
-#include "database.h"
+#include "database-backend.h"
 
 
 typedef struct simple_data {
@@ -50,7 +50,7 @@ typedef struct entry {
     pa_datum data;
 } entry;
 
-void pa_datum_free(pa_datum *d) {
+void pa_database_backend_datum_free(pa_datum *d) {
     pa_assert(d);
 
     pa_xfree(d->data);
@@ -216,7 +216,7 @@ static int fill_data(simple_data *db, FILE *f) {
 
     if (ferror(f)) {
         pa_log_warn("read error. %s", pa_cstrerror(errno));
-        pa_database_clear((pa_database*)db);
+        pa_database_backend_clear((pa_database_backend*)db);
     }
 
     if (field == FIELD_DATA && d)
@@ -225,7 +225,7 @@ static int fill_data(simple_data *db, FILE *f) {
     return pa_hashmap_size(db->map);
 }
 
-pa_database* pa_database_open(const char *fn, pa_bool_t for_write) {
+pa_database_backend* pa_database_backend_open(const char *fn, pa_bool_t for_write) {
     FILE *f;
     char *path;
     simple_data *db;
@@ -241,7 +241,7 @@ pa_database* pa_database_open(const char *fn, pa_bool_t for_write) {
         db = pa_xnew0(simple_data, 1);
         db->map = pa_hashmap_new(hash_func, compare_func);
         db->filename = pa_xstrdup(path);
-        db->tmp_filename = pa_sprintf_malloc(".%s.tmp", db->filename);
+        db->tmp_filename = pa_sprintf_malloc("%s.tmp", db->filename);
         db->read_only = !for_write;
 
         if (f) {
@@ -256,22 +256,22 @@ pa_database* pa_database_open(const char *fn, pa_bool_t for_write) {
 
     pa_xfree(path);
 
-    return (pa_database*) db;
+    return (pa_database_backend*) db;
 }
 
-void pa_database_close(pa_database *database) {
+void pa_database_backend_close(pa_database_backend *database) {
     simple_data *db = (simple_data*)database;
     pa_assert(db);
 
-    pa_database_sync(database);
-    pa_database_clear(database);
+    pa_database_backend_sync(database);
+    pa_database_backend_clear(database);
     pa_xfree(db->filename);
     pa_xfree(db->tmp_filename);
     pa_hashmap_free(db->map, NULL, NULL);
     pa_xfree(db);
 }
 
-pa_datum* pa_database_get(pa_database *database, const pa_datum *key, pa_datum* data) {
+pa_datum* pa_database_backend_get(pa_database_backend *database, const pa_datum *key, pa_datum* data) {
     simple_data *db = (simple_data*)database;
     entry *e;
 
@@ -290,7 +290,7 @@ pa_datum* pa_database_get(pa_database *database, const pa_datum *key, pa_datum*
     return data;
 }
 
-int pa_database_set(pa_database *database, const pa_datum *key, const pa_datum* data, pa_bool_t overwrite) {
+int pa_database_backend_set(pa_database_backend *database, const pa_datum *key, const pa_datum* data, pa_bool_t overwrite) {
     simple_data *db = (simple_data*)database;
     entry *e;
     int ret = 0;
@@ -322,7 +322,7 @@ int pa_database_set(pa_database *database, const pa_datum *key, const pa_datum*
     return ret;
 }
 
-int pa_database_unset(pa_database *database, const pa_datum *key) {
+int pa_database_backend_unset(pa_database_backend *database, const pa_datum *key) {
     simple_data *db = (simple_data*)database;
     entry *e;
 
@@ -338,7 +338,7 @@ int pa_database_unset(pa_database *database, const pa_datum *key) {
     return 0;
 }
 
-int pa_database_clear(pa_database *database) {
+int pa_database_backend_clear(pa_database_backend *database) {
     simple_data *db = (simple_data*)database;
     entry *e;
 
@@ -350,14 +350,14 @@ int pa_database_clear(pa_database *database) {
     return 0;
 }
 
-signed pa_database_size(pa_database *database) {
+signed pa_database_backend_size(pa_database_backend *database) {
     simple_data *db = (simple_data*)database;
     pa_assert(db);
 
     return (signed) pa_hashmap_size(db->map);
 }
 
-pa_datum* pa_database_first(pa_database *database, pa_datum *key, pa_datum *data) {
+pa_datum* pa_database_backend_first(pa_database_backend *database, pa_datum *key, pa_datum *data) {
     simple_data *db = (simple_data*)database;
     entry *e;
 
@@ -380,7 +380,7 @@ pa_datum* pa_database_first(pa_database *database, pa_datum *key, pa_datum *data
     return key;
 }
 
-pa_datum* pa_database_next(pa_database *database, const pa_datum *key, pa_datum *next, pa_datum *data) {
+pa_datum* pa_database_backend_next(pa_database_backend *database, const pa_datum *key, pa_datum *next, pa_datum *data) {
     simple_data *db = (simple_data*)database;
     entry *e;
     entry *search;
@@ -391,7 +391,7 @@ pa_datum* pa_database_next(pa_database *database, const pa_datum *key, pa_datum
     pa_assert(next);
 
     if (!key)
-        return pa_database_first(database, next, data);
+        return pa_database_backend_first(database, next, data);
 
     search = pa_hashmap_get(db->map, key);
 
@@ -465,7 +465,7 @@ static int write_entry(FILE *f, const entry *e) {
     return 0;
 }
 
-int pa_database_sync(pa_database *database) {
+int pa_database_backend_sync(pa_database_backend *database) {
     simple_data *db = (simple_data*)database;
     FILE *f;
     void *state;
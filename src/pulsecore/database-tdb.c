@@ -35,7 +35,7 @@
 #include <pulsecore/core-util.h>
 #include <pulsecore/log.h>
 
-#include "database.h"
+#include "database-backend.h"
 
 #define MAKE_TDB_CONTEXT(x) ((struct tdb_context*) (x))
 
@@ -59,7 +59,7 @@ static inline pa_datum* datum_from_tdb(pa_datum *to, const TDB_DATA *from) {
     return to;
 }
 
-void pa_datum_free(pa_datum *d) {
+void pa_database_backend_datum_free(pa_datum *d) {
     pa_assert(d);
 
     free(d->data); /* tdb uses raw malloc/free hence we should do that here, too */
@@ -99,7 +99,7 @@ finish:
     return c;
 }
 
-pa_database* pa_database_open(const char *fn, pa_bool_t for_write) {
+pa_database_backend* pa_database_backend_open(const char *fn, pa_bool_t for_write) {
     struct tdb_context *c;
     char *path;
 
@@ -117,16 +117,16 @@ pa_database* pa_database_open(const char *fn, pa_bool_t for_write) {
         return NULL;
     }
 
-    return (pa_database*) c;
+    return (pa_database_backend*) c;
 }
 
-void pa_database_close(pa_database *db) {
+void pa_database_backend_close(pa_database_backend *db) {
     pa_assert(db);
 
     tdb_close(MAKE_TDB_CONTEXT(db));
 }
 
-pa_datum* pa_database_get(pa_database *db, const pa_datum *key, pa_datum* data) {
+pa_datum* pa_database_backend_get(pa_database_backend *db, const pa_datum *key, pa_datum* data) {
     TDB_DATA tdb_key, tdb_data;
 
     pa_assert(db);
@@ -140,7 +140,7 @@ pa_datum* pa_database_get(pa_database *db, const pa_datum *key, pa_datum* data)
         NULL;
 }
 
-int pa_database_set(pa_database *db, const pa_datum *key, const pa_datum* data, pa_bool_t overwrite) {
+int pa_database_backend_set(pa_database_backend *db, const pa_datum *key, const pa_datum* data, pa_bool_t overwrite) {
     TDB_DATA tdb_key, tdb_data;
 
     pa_assert(db);
@@ -153,7 +153,7 @@ int pa_database_set(pa_database *db, const pa_datum *key, const pa_datum* data,
                      overwrite ? TDB_REPLACE : TDB_INSERT) != 0 ? -1 : 0;
 }
 
-int pa_database_unset(pa_database *db, const pa_datum *key) {
+int pa_database_backend_unset(pa_database_backend *db, const pa_datum *key) {
     TDB_DATA tdb_key;
 
     pa_assert(db);
@@ -162,13 +162,13 @@ int pa_database_unset(pa_database *db, const pa_datum *key) {
     return tdb_delete(MAKE_TDB_CONTEXT(db), *datum_to_tdb(&tdb_key, key)) != 0 ? -1 : 0;
 }
 
-int pa_database_clear(pa_database *db) {
+int pa_database_backend_clear(pa_database_backend *db) {
     pa_assert(db);
 
     return tdb_wipe_all(MAKE_TDB_CONTEXT(db)) != 0 ? -1 : 0;
 }
 
-signed pa_database_size(pa_database *db) {
+signed pa_database_backend_size(pa_database_backend *db) {
     TDB_DATA tdb_key;
     unsigned n = 0;
 
@@ -191,7 +191,7 @@ signed pa_database_size(pa_database *db) {
     return (signed) n;
 }
 
-pa_datum* pa_database_first(pa_database *db, pa_datum *key, pa_datum *data) {
+pa_datum* pa_database_backend_first(pa_database_backend *db, pa_datum *key, pa_datum *data) {
     TDB_DATA tdb_key, tdb_data;
 
     pa_assert(db);
@@ -218,7 +218,7 @@ pa_datum* pa_database_first(pa_database *db, pa_datum *key, pa_datum *data) {
     return key;
 }
 
-pa_datum* pa_database_next(pa_database *db, const pa_datum *key, pa_datum *next, pa_datum *data) {
+pa_datum* pa_database_backend_next(pa_database_backend *db, const pa_datum *key, pa_datum *next, pa_datum *data) {
     TDB_DATA tdb_key, tdb_data;
 
     pa_assert(db);
@@ -245,7 +245,7 @@ pa_datum* pa_database_next(pa_database *db, const pa_datum *key, pa_datum *next,
     return next;
 }
 
-int pa_database_sync(pa_database *db) {
+int pa_database_backend_sync(pa_database_backend *db) {
     pa_assert(db);
 
     return 0;
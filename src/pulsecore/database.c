@@ -0,0 +1,562 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/hashmap.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/mutex.h>
+#include <pulsecore/thread.h>
+
+#include "database-backend.h"
+
+typedef struct entry {
+    pa_datum key;
+    pa_datum data;
+    pa_bool_t removed; /* Only in batches */
+} entry;
+
+/* The changes of one or more syncs, as they were when they were
+ * synced. Owned by whoever took it from the queue. */
+typedef struct batch {
+    pa_bool_t clear;
+    pa_hashmap *changes;
+} batch;
+
+struct pa_database {
+    char *name;
+    pa_bool_t read_only;
+
+    /* Main thread only */
+    pa_hashmap *map;
+    pa_hashmap *dirty; /* Keys changed since the last sync */
+    pa_bool_t cleared;
+
+    /* Used by the writer thread once it was started, and by whoever
+     * holds the handle before that or after it is gone */
+    pa_database_backend *backend;
+    pa_thread *thread;
+
+    /* Protected by mutex */
+    pa_mutex *mutex;
+    pa_cond *cond;
+    batch *queued;
+    pa_bool_t quit;
+    pa_database_sync_stats stats;
+};
+
+void pa_datum_free(pa_datum *d) {
+    pa_assert(d);
+
+    pa_xfree(d->data);
+    d->data = NULL;
+    d->size = 0;
+}
+
+static int compare_func(const void *a, const void *b) {
+    const pa_datum *aa, *bb;
+
+    aa = (const pa_datum*)a;
+    bb = (const pa_datum*)b;
+
+    if (aa->size != bb->size)
+        return aa->size > bb->size ? 1 : -1;
+
+    return memcmp(aa->data, bb->data, aa->size);
+}
+
+/* pa_idxset_string_hash_func modified for our use */
+static unsigned hash_func(const void *p) {
+    const pa_datum *d;
+    unsigned hash = 0;
+    const char *c;
+    unsigned i;
+
+    d = (const pa_datum*)p;
+    c = d->data;
+
+    for (i = 0; i < d->size; i++) {
+        hash = 31 * hash + (unsigned) *c;
+        c++;
+    }
+
+    return hash;
+}
+
+static void datum_copy(pa_datum *to, const pa_datum *from) {
+    to->data = from->size > 0 ? pa_xmemdup(from->data, from->size) : NULL;
+    to->size = from->size;
+}
+
+static entry* new_entry(const pa_datum *key, const pa_datum *data) {
+    entry *e;
+
+    pa_assert(key);
+
+    e = pa_xnew0(entry, 1);
+    datum_copy(&e->key, key);
+
+    if (data)
+        datum_copy(&e->data, data);
+    else
+        e->removed = TRUE;
+
+    return e;
+}
+
+static void free_entry(entry *e) {
+    pa_assert(e);
+
+    pa_xfree(e->key.data);
+    pa_xfree(e->data.data);
+    pa_xfree(e);
+}
+
+static void free_entry_cb(void *p, void *userdata) {
+    free_entry(p);
+}
+
+static void free_map(pa_hashmap *h) {
+    entry *e;
+
+    while ((e = pa_hashmap_steal_first(h)))
+        free_entry(e);
+}
+
+static void free_batch(batch *b) {
+    pa_assert(b);
+
+    pa_hashmap_free(b->changes, free_entry_cb, NULL);
+    pa_xfree(b);
+}
+
+static void mark_dirty(pa_database *db, const pa_datum *key) {
+    pa_datum *k;
+
+    if (pa_hashmap_get(db->dirty, key))
+        return;
+
+    k = pa_xnew(pa_datum, 1);
+    datum_copy(k, key);
+    pa_hashmap_put(db->dirty, k, k);
+}
+
+static void free_dirty_key(void *p, void *userdata) {
+    pa_datum *k = p;
+
+    pa_datum_free(k);
+    pa_xfree(k);
+}
+
+static int load(pa_database *db) {
+    pa_datum key, data, next;
+
+    if (!pa_database_backend_first(db->backend, &key, &data))
+        return 0;
+
+    for (;;) {
+        entry *e;
+        pa_bool_t more;
+
+        e = new_entry(&key, &data);
+        if (pa_hashmap_put(db->map, &e->key, e) < 0)
+            free_entry(e);
+
+        pa_database_backend_datum_free(&data);
+        more = !!pa_database_backend_next(db->backend, &key, &next, &data);
+        pa_database_backend_datum_free(&key);
+
+        if (!more)
+            break;
+
+        key = next;
+    }
+
+    return 0;
+}
+
+pa_database* pa_database_open(const char *fn, pa_bool_t for_write) {
+    pa_database *db;
+    pa_database_backend *backend;
+    pa_usec_t begin;
+
+    pa_assert(fn);
+
+    begin = pa_rtclock_now();
+
+    if (!(backend = pa_database_backend_open(fn, for_write)))
+        return NULL;
+
+    db = pa_xnew0(pa_database, 1);
+    db->name = pa_xstrdup(fn);
+    db->read_only = !for_write;
+    db->backend = backend;
+    db->map = pa_hashmap_new(hash_func, compare_func);
+    db->dirty = pa_hashmap_new(hash_func, compare_func);
+    db->mutex = pa_mutex_new(FALSE, FALSE);
+    db->cond = pa_cond_new();
+
+    load(db);
+
+    /* There's nothing to write back */
+    if (db->read_only) {
+        pa_database_backend_close(db->backend);
+        db->backend = NULL;
+    }
+
+    pa_log_debug("Opened database %s in %0.1f ms.", fn, (double) (pa_rtclock_now() - begin) / PA_USEC_PER_MSEC);
+
+    return db;
+}
+
+/* Called with the backend owned by the caller */
+static int write_batch(pa_database_backend *backend, batch *b) {
+    entry *e;
+    void *state;
+    int r = 0;
+
+    if (b->clear && pa_database_backend_clear(backend) < 0)
+        r = -1;
+
+    PA_HASHMAP_FOREACH(e, b->changes, state) {
+        if (e->removed) {
+            /* Fails if the entry never made it to the backend */
+            pa_database_backend_unset(backend, &e->key);
+            continue;
+        }
+
+        if (pa_database_backend_set(backend, &e->key, &e->data, TRUE) < 0)
+            r = -1;
+    }
+
+    if (pa_database_backend_sync(backend) < 0)
+        r = -1;
+
+    return r;
+}
+
+/* Called with the mutex held */
+static void account_batch(pa_database *db, int r, pa_usec_t usec) {
+    db->stats.n_syncs++;
+
+    if (r < 0)
+        db->stats.n_failed++;
+
+    db->stats.last_usec = usec;
+    db->stats.max_usec = PA_MAX(db->stats.max_usec, usec);
+    db->stats.total_usec += usec;
+}
+
+static int write_and_account(pa_database *db, batch *b) {
+    pa_usec_t begin, usec;
+    int r;
+
+    begin = pa_rtclock_now();
+    r = write_batch(db->backend, b);
+    usec = pa_rtclock_now() - begin;
+
+    if (r < 0)
+        pa_log_warn("Failed to write changes to database %s.", db->name);
+    else
+        pa_log_debug("Wrote %u changes to database %s in %0.1f ms.",
+                     pa_hashmap_size(b->changes), db->name, (double) usec / PA_USEC_PER_MSEC);
+
+    pa_mutex_lock(db->mutex);
+    account_batch(db, r, usec);
+    pa_mutex_unlock(db->mutex);
+
+    return r;
+}
+
+static void thread_func(void *userdata) {
+    pa_database *db = userdata;
+
+    pa_mutex_lock(db->mutex);
+
+    for (;;) {
+        batch *b;
+
+        while (!db->queued && !db->quit)
+            pa_cond_wait(db->cond, db->mutex);
+
+        if (!(b = db->queued))
+            break;
+
+        db->queued = NULL;
+        pa_mutex_unlock(db->mutex);
+
+        write_and_account(db, b);
+        free_batch(b);
+
+        pa_mutex_lock(db->mutex);
+    }
+
+    pa_mutex_unlock(db->mutex);
+}
+
+/* Folds b into the batch that is still waiting, called with the mutex
+ * held */
+static void merge_batch(batch *into, batch *b) {
+    entry *e;
+
+    if (b->clear) {
+        free_map(into->changes);
+        into->clear = TRUE;
+    }
+
+    while ((e = pa_hashmap_steal_first(b->changes))) {
+        entry *old;
+
+        if ((old = pa_hashmap_remove(into->changes, &e->key)))
+            free_entry(old);
+
+        pa_hashmap_put(into->changes, &e->key, e);
+    }
+
+    free_batch(b);
+}
+
+static batch* take_changes(pa_database *db) {
+    batch *b;
+    pa_datum *k;
+
+    b = pa_xnew0(batch, 1);
+    b->clear = db->cleared;
+    b->changes = pa_hashmap_new(hash_func, compare_func);
+
+    while ((k = pa_hashmap_steal_first(db->dirty))) {
+        entry *e, *c;
+
+        e = pa_hashmap_get(db->map, k);
+        c = new_entry(k, e ? &e->data : NULL);
+        pa_hashmap_put(b->changes, &c->key, c);
+
+        free_dirty_key(k, NULL);
+    }
+
+    db->cleared = FALSE;
+
+    return b;
+}
+
+int pa_database_sync(pa_database *db) {
+    batch *b;
+
+    pa_assert(db);
+
+    if (db->read_only)
+        return 0;
+
+    if (!db->cleared && pa_hashmap_isempty(db->dirty))
+        return 0;
+
+    b = take_changes(db);
+
+    if (!db->thread && !(db->thread = pa_thread_new("database", thread_func, db))) {
+        int r;
+
+        pa_log_warn("Failed to create writer thread, writing database %s synchronously.", db->name);
+        r = write_and_account(db, b);
+        free_batch(b);
+        return r;
+    }
+
+    pa_mutex_lock(db->mutex);
+
+    if (db->queued) {
+        merge_batch(db->queued, b);
+        db->stats.n_merged++;
+    } else
+        db->queued = b;
+
+    pa_cond_signal(db->cond, 0);
+    pa_mutex_unlock(db->mutex);
+
+    return 0;
+}
+
+void pa_database_close(pa_database *db) {
+    pa_assert(db);
+
+    pa_database_sync(db);
+
+    if (db->thread) {
+        pa_mutex_lock(db->mutex);
+        db->quit = TRUE;
+        pa_cond_signal(db->cond, 0);
+        pa_mutex_unlock(db->mutex);
+
+        /* Waits for the last changes to be written */
+        pa_thread_free(db->thread);
+    }
+
+    pa_assert(!db->queued);
+
+    if (db->backend)
+        pa_database_backend_close(db->backend);
+
+    if (db->stats.n_syncs > 0)
+        pa_log_debug("Database %s: %u syncs (%u failed, %u merged), %0.1f ms on average, %0.1f ms at most.",
+                     db->name, db->stats.n_syncs, db->stats.n_failed, db->stats.n_merged,
+                     (double) db->stats.total_usec / db->stats.n_syncs / PA_USEC_PER_MSEC,
+                     (double) db->stats.max_usec / PA_USEC_PER_MSEC);
+
+    pa_hashmap_free(db->map, free_entry_cb, NULL);
+    pa_hashmap_free(db->dirty, free_dirty_key, NULL);
+    pa_cond_free(db->cond);
+    pa_mutex_free(db->mutex);
+    pa_xfree(db->name);
+    pa_xfree(db);
+}
+
+pa_datum* pa_database_get(pa_database *db, const pa_datum *key, pa_datum* data) {
+    entry *e;
+
+    pa_assert(db);
+    pa_assert(key);
+    pa_assert(data);
+
+    if (!(e = pa_hashmap_get(db->map, key)))
+        return NULL;
+
+    datum_copy(data, &e->data);
+
+    return data;
+}
+
+int pa_database_set(pa_database *db, const pa_datum *key, const pa_datum* data, pa_bool_t overwrite) {
+    entry *e, *old;
+
+    pa_assert(db);
+    pa_assert(key);
+    pa_assert(data);
+
+    if (db->read_only)
+        return -1;
+
+    if ((old = pa_hashmap_get(db->map, key))) {
+        if (!overwrite)
+            return -1;
+
+        pa_hashmap_remove(db->map, key);
+        free_entry(old);
+    }
+
+    e = new_entry(key, data);
+    pa_hashmap_put(db->map, &e->key, e);
+    mark_dirty(db, key);
+
+    return 0;
+}
+
+int pa_database_unset(pa_database *db, const pa_datum *key) {
+    entry *e;
+
+    pa_assert(db);
+    pa_assert(key);
+
+    if (db->read_only)
+        return -1;
+
+    if (!(e = pa_hashmap_remove(db->map, key)))
+        return -1;
+
+    free_entry(e);
+    mark_dirty(db, key);
+
+    return 0;
+}
+
+int pa_database_clear(pa_database *db) {
+    pa_assert(db);
+
+    if (db->read_only)
+        return -1;
+
+    free_map(db->map);
+    pa_hashmap_free(db->dirty, free_dirty_key, NULL);
+    db->dirty = pa_hashmap_new(hash_func, compare_func);
+    db->cleared = TRUE;
+
+    return 0;
+}
+
+signed pa_database_size(pa_database *db) {
+    pa_assert(db);
+
+    return (signed) pa_hashmap_size(db->map);
+}
+
+pa_datum* pa_database_first(pa_database *db, pa_datum *key, pa_datum *data) {
+    entry *e;
+
+    pa_assert(db);
+    pa_assert(key);
+
+    if (!(e = pa_hashmap_first(db->map)))
+        return NULL;
+
+    datum_copy(key, &e->key);
+
+    if (data)
+        datum_copy(data, &e->data);
+
+    return key;
+}
+
+pa_datum* pa_database_next(pa_database *db, const pa_datum *key, pa_datum *next, pa_datum *data) {
+    entry *e;
+    void *state = NULL;
+
+    pa_assert(db);
+    pa_assert(next);
+
+    if (!key)
+        return pa_database_first(db, next, data);
+
+    if (!pa_hashmap_iterate_seek(db->map, &state, key) ||
+        !(e = pa_hashmap_iterate(db->map, &state, NULL)))
+        return NULL;
+
+    datum_copy(next, &e->key);
+
+    if (data)
+        datum_copy(data, &e->data);
+
+    return next;
+}
+
+void pa_database_get_sync_stats(pa_database *db, pa_database_sync_stats *stats) {
+    pa_assert(db);
+    pa_assert(stats);
+
+    pa_mutex_lock(db->mutex);
+    *stats = db->stats;
+    pa_mutex_unlock(db->mutex);
+}
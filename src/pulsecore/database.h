@@ -24,12 +24,20 @@
 
 #include <sys/types.h>
 
+#include <pulse/sample.h>
 #include <pulsecore/macro.h>
 
 /* A little abstraction over simple databases, such as gdbm, tdb, and
  * so on. We only make minimal assumptions about the supported
  * backend: it does not need to support locking, it does not have to
- * be arch independent. */
+ * be arch independent.
+ *
+ * The contents are kept in memory while the database is open, so
+ * reading never touches the disk. Changes are handed to the backend
+ * by pa_database_sync(), which snapshots them and returns right away:
+ * a writer thread of the database stores them and waits for the disk,
+ * so that a slow fsync() doesn't stall the main loop. Closing waits
+ * for all changes to be written. */
 
 typedef struct pa_database pa_database;
 
@@ -58,4 +66,16 @@ pa_datum* pa_database_next(pa_database *db, const pa_datum *key, pa_datum *next,
 
 int pa_database_sync(pa_database *db);
 
+typedef struct pa_database_sync_stats {
+    unsigned n_syncs;       /* Snapshots the backend has written */
+    unsigned n_failed;      /* ... of which failed */
+    unsigned n_merged;      /* Snapshots merged into a newer one before
+                             * the writer got to them */
+    pa_usec_t last_usec;    /* How long the backend took, for the last */
+    pa_usec_t max_usec;     /* ... the slowest */
+    pa_usec_t total_usec;   /* ... and all snapshots */
+} pa_database_sync_stats;
+
+void pa_database_get_sync_stats(pa_database *db, pa_database_sync_stats *stats);
+
 #endif
@@ -0,0 +1,303 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/semaphore.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "dsp-worker.h"
+
+struct pa_dsp_worker {
+    pa_core *core;
+    int rtprio;
+    char *cpus;
+
+    pa_dsp_worker_cb_t cb;
+    void *userdata;
+
+    pa_thread *thread;
+
+    /* The semaphores order all accesses to the chunks and quit
+     * between the two threads */
+    pa_semaphore *job, *done;
+    pa_bool_t quit;
+
+    pa_memchunk in, out;
+    pa_bool_t busy;
+    pa_atomic_t finished;
+};
+
+static void thread_func(void *userdata) {
+    pa_dsp_worker *w = userdata;
+
+    pa_assert(w);
+
+    pa_core_setup_io_thread(w->core, w->rtprio, w->cpus);
+
+    for (;;) {
+        pa_semaphore_wait(w->job);
+
+        if (w->quit)
+            break;
+
+        w->cb(w->userdata, &w->in, &w->out);
+        pa_assert(w->out.memblock);
+
+        pa_atomic_store(&w->finished, 1);
+        pa_semaphore_post(w->done);
+    }
+}
+
+pa_dsp_worker *pa_dsp_worker_new(pa_core *c, const char *name, int rtprio, const char *cpus, pa_dsp_worker_cb_t cb, void *userdata) {
+    pa_dsp_worker *w;
+
+    pa_assert(c);
+    pa_assert(name);
+    pa_assert(cb);
+
+    w = pa_xnew0(pa_dsp_worker, 1);
+    w->core = c;
+    w->rtprio = rtprio;
+    w->cpus = pa_xstrdup(cpus);
+    w->cb = cb;
+    w->userdata = userdata;
+    w->job = pa_semaphore_new(0);
+    w->done = pa_semaphore_new(0);
+
+    if (!(w->thread = pa_thread_new(name, thread_func, w))) {
+        pa_log("Failed to create DSP thread.");
+        pa_dsp_worker_free(w);
+        return NULL;
+    }
+
+    return w;
+}
+
+void pa_dsp_worker_free(pa_dsp_worker *w) {
+    pa_memchunk chunk;
+
+    pa_assert(w);
+
+    if (pa_dsp_worker_collect(w, &chunk) >= 0)
+        pa_memblock_unref(chunk.memblock);
+
+    if (w->thread) {
+        w->quit = TRUE;
+        pa_semaphore_post(w->job);
+        pa_thread_free(w->thread);
+    }
+
+    pa_semaphore_free(w->job);
+    pa_semaphore_free(w->done);
+
+    pa_xfree(w->cpus);
+    pa_xfree(w);
+}
+
+void pa_dsp_worker_submit(pa_dsp_worker *w, const pa_memchunk *in) {
+    pa_assert(w);
+    pa_assert(in);
+    pa_assert(in->memblock);
+    pa_assert(in->length > 0);
+    pa_assert(!w->busy);
+
+    w->in = *in;
+    pa_memblock_ref(w->in.memblock);
+    pa_memchunk_reset(&w->out);
+    pa_atomic_store(&w->finished, 0);
+    w->busy = TRUE;
+
+    pa_semaphore_post(w->job);
+}
+
+int pa_dsp_worker_collect(pa_dsp_worker *w, pa_memchunk *out) {
+    pa_assert(w);
+    pa_assert(out);
+
+    if (!w->busy)
+        return -1;
+
+    pa_semaphore_wait(w->done);
+    w->busy = FALSE;
+
+    pa_memblock_unref(w->in.memblock);
+    pa_memchunk_reset(&w->in);
+
+    *out = w->out;
+    pa_memchunk_reset(&w->out);
+
+    return 0;
+}
+
+pa_bool_t pa_dsp_worker_is_done(pa_dsp_worker *w) {
+    pa_assert(w);
+
+    return !w->busy || pa_atomic_load(&w->finished);
+}
+
+size_t pa_dsp_worker_get_length(pa_dsp_worker *w) {
+    pa_assert(w);
+
+    return w->busy ? w->in.length : 0;
+}
+
+struct pool_thread {
+    pa_dsp_pool *pool;
+    unsigned share;
+    pa_thread *thread;
+    pa_semaphore *job;
+};
+
+struct pa_dsp_pool {
+    pa_core *core;
+    int rtprio;
+    char *cpus;
+
+    pa_dsp_pool_cb_t cb;
+    void *userdata;
+
+    /* One for share 1 to n_shares-1 each */
+    struct pool_thread *threads;
+    unsigned n_shares;
+
+    /* Posted once by every thread that finished its share */
+    pa_semaphore *done;
+    pa_bool_t quit;
+};
+
+static void pool_thread_func(void *userdata) {
+    struct pool_thread *t = userdata;
+    pa_dsp_pool *p;
+
+    pa_assert(t);
+    p = t->pool;
+
+    pa_core_setup_io_thread(p->core, p->rtprio, p->cpus);
+
+    for (;;) {
+        pa_semaphore_wait(t->job);
+
+        if (p->quit)
+            break;
+
+        p->cb(p->userdata, t->share);
+        pa_semaphore_post(p->done);
+    }
+}
+
+pa_dsp_pool *pa_dsp_pool_new(pa_core *c, const char *name, int rtprio, const char *cpus, unsigned n_shares, pa_dsp_pool_cb_t cb, void *userdata) {
+    pa_dsp_pool *p;
+    unsigned i;
+
+    pa_assert(c);
+    pa_assert(name);
+    pa_assert(n_shares >= 1);
+    pa_assert(cb);
+
+    p = pa_xnew0(pa_dsp_pool, 1);
+    p->core = c;
+    p->rtprio = rtprio;
+    p->cpus = pa_xstrdup(cpus);
+    p->cb = cb;
+    p->userdata = userdata;
+    p->n_shares = n_shares;
+    p->done = pa_semaphore_new(0);
+
+    if (n_shares > 1)
+        p->threads = pa_xnew0(struct pool_thread, n_shares - 1);
+
+    for (i = 0; i < n_shares - 1; i++) {
+        struct pool_thread *t = &p->threads[i];
+        char *tn;
+
+        t->pool = p;
+        t->share = i + 1;
+        t->job = pa_semaphore_new(0);
+
+        tn = pa_sprintf_malloc("%s-%u", name, t->share);
+        t->thread = pa_thread_new(tn, pool_thread_func, t);
+        pa_xfree(tn);
+
+        if (!t->thread) {
+            pa_log("Failed to create DSP thread.");
+            pa_dsp_pool_free(p);
+            return NULL;
+        }
+    }
+
+    return p;
+}
+
+void pa_dsp_pool_free(pa_dsp_pool *p) {
+    unsigned i;
+
+    pa_assert(p);
+
+    p->quit = TRUE;
+
+    for (i = 0; i < p->n_shares - 1; i++) {
+        struct pool_thread *t = &p->threads[i];
+
+        if (!t->job)
+            break;
+
+        if (t->thread) {
+            pa_semaphore_post(t->job);
+            pa_thread_free(t->thread);
+        }
+
+        pa_semaphore_free(t->job);
+    }
+
+    pa_semaphore_free(p->done);
+
+    pa_xfree(p->threads);
+    pa_xfree(p->cpus);
+    pa_xfree(p);
+}
+
+void pa_dsp_pool_run(pa_dsp_pool *p) {
+    unsigned i;
+
+    pa_assert(p);
+
+    for (i = 0; i < p->n_shares - 1; i++)
+        pa_semaphore_post(p->threads[i].job);
+
+    p->cb(p->userdata, 0);
+
+    for (i = 0; i < p->n_shares - 1; i++)
+        pa_semaphore_wait(p->done);
+}
+
+unsigned pa_dsp_pool_get_n_shares(pa_dsp_pool *p) {
+    pa_assert(p);
+
+    return p->n_shares;
+}
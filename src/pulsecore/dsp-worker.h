@@ -0,0 +1,76 @@
+#ifndef foopulsecoredspworkerhfoo
+#define foopulsecoredspworkerhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulsecore/core.h>
+#include <pulsecore/memchunk.h>
+
+/* A thread that runs the DSP of a filter on one chunk at a time, so
+ * that an IO thread can hand over the next chunk of audio and carry on
+ * with mixing while the previous one is being processed. All functions
+ * are to be called from the one IO thread that owns the worker, except
+ * for _new() and _free(). */
+
+typedef struct pa_dsp_worker pa_dsp_worker;
+
+/* Called from the worker thread. Processes all of in into a newly
+ * allocated out. */
+typedef void (*pa_dsp_worker_cb_t)(void *userdata, const pa_memchunk *in, pa_memchunk *out);
+
+pa_dsp_worker *pa_dsp_worker_new(pa_core *c, const char *name, int rtprio, const char *cpus, pa_dsp_worker_cb_t cb, void *userdata);
+void pa_dsp_worker_free(pa_dsp_worker *w);
+
+/* Starts processing in, which must not be empty. Only one chunk can
+ * be in flight at a time. */
+void pa_dsp_worker_submit(pa_dsp_worker *w, const pa_memchunk *in);
+
+/* Waits for the chunk in flight to be processed and returns the
+ * result. Returns -1 if nothing was submitted. */
+int pa_dsp_worker_collect(pa_dsp_worker *w, pa_memchunk *out);
+
+/* Returns TRUE if _collect() would return without waiting */
+pa_bool_t pa_dsp_worker_is_done(pa_dsp_worker *w);
+
+/* The length of the chunk in flight, 0 if there is none */
+size_t pa_dsp_worker_get_length(pa_dsp_worker *w);
+
+/* A set of threads that each run a share of the DSP of one block, e.g.
+ * one plugin instance per channel. _run() hands out the shares and
+ * waits until all of them are done, so it can be used in the middle of
+ * processing a block. The calling thread runs share 0 itself, so a pool
+ * of n shares has n-1 threads. */
+
+typedef struct pa_dsp_pool pa_dsp_pool;
+
+/* Called from the thread of the share, or from the one that called
+ * _run() for share 0 */
+typedef void (*pa_dsp_pool_cb_t)(void *userdata, unsigned share);
+
+pa_dsp_pool *pa_dsp_pool_new(pa_core *c, const char *name, int rtprio, const char *cpus, unsigned n_shares, pa_dsp_pool_cb_t cb, void *userdata);
+void pa_dsp_pool_free(pa_dsp_pool *p);
+
+/* Runs all shares and returns when they are done. Must not be called
+ * from two threads at once. */
+void pa_dsp_pool_run(pa_dsp_pool *p);
+
+unsigned pa_dsp_pool_get_n_shares(pa_dsp_pool *p);
+
+#endif
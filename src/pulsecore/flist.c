@@ -27,6 +27,8 @@
 #include <config.h>
 #endif
 
+#include <string.h>
+
 #include <pulse/xmalloc.h>
 
 #include <pulsecore/atomic.h>
@@ -34,11 +36,20 @@
 #include <pulsecore/macro.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/llist.h>
+#include <pulsecore/mutex.h>
+#include <pulsecore/thread.h>
 
 #include "flist.h"
 
 #define FLIST_SIZE 128
 
+/* Per-thread caches. When one is empty or full, a batch of entries is
+ * moved from or to the shared list. */
+#define FLIST_CACHE_SIZE 32
+#define FLIST_CACHE_BATCH 16
+#define FLIST_MAX_CACHED 32
+
 /* Atomic table indices contain
    sign bit = if set, indicates empty/NULL value
    tag bits (to avoid the ABA problem)
@@ -53,10 +64,29 @@ struct pa_flist_elem {
 
 typedef struct pa_flist_elem pa_flist_elem;
 
+/* The counters are only written by the owning thread */
+struct flist_cache {
+    unsigned n;
+    uint64_t hits, misses;
+    void *items[FLIST_CACHE_SIZE];
+};
+
+/* The caches of one thread, indexed by pa_flist.cache_idx */
+struct flist_thread {
+    struct flist_cache caches[FLIST_MAX_CACHED];
+    PA_LLIST_FIELDS(struct flist_thread);
+};
+
 struct pa_flist {
     char *name;
     unsigned size;
 
+    /* -1 if there are no per-thread caches */
+    int cache_idx;
+    pa_free_cb_t free_cb;
+    /* Counters of threads that are gone */
+    uint64_t hits, misses;
+
     pa_atomic_t current_tag;
     int index_mask;
     int tag_shift;
@@ -69,6 +99,16 @@ struct pa_flist {
     pa_flist_elem table[];
 };
 
+/* Protects everything about caches that is not about the calling
+ * thread's own. Only taken when threads come and go, and for the
+ * statistics. */
+static pa_static_mutex cache_mutex = PA_STATIC_MUTEX_INIT;
+static pa_flist *cached_flists[FLIST_MAX_CACHED];
+static unsigned n_cached_flists = 0;
+static PA_LLIST_HEAD(struct flist_thread, flist_threads) = NULL;
+
+PA_STATIC_TLS_DECLARE_NO_FREE(flist_thread);
+
 /* Lock free pop from linked list stack */
 static pa_flist_elem *stack_pop(pa_flist *flist, pa_atomic_t *list) {
     pa_flist_elem *popped;
@@ -113,6 +153,7 @@ pa_flist *pa_flist_new_with_name(unsigned size, const char *name) {
 
     l->name = pa_xstrdup(name);
     l->size = size;
+    l->cache_idx = -1;
 
     while (1 << l->tag_shift < (int) size)
         l->tag_shift++;
@@ -131,10 +172,51 @@ pa_flist *pa_flist_new(unsigned size) {
     return pa_flist_new_with_name(size, "unknown");
 }
 
+pa_flist *pa_flist_new_cached(unsigned size, const char *name, pa_free_cb_t free_cb) {
+    pa_flist *l;
+    pa_mutex *m;
+
+    l = pa_flist_new_with_name(size, name);
+    l->free_cb = free_cb;
+
+    m = pa_static_mutex_get(&cache_mutex, FALSE, FALSE);
+    pa_mutex_lock(m);
+
+    if (n_cached_flists < FLIST_MAX_CACHED) {
+        l->cache_idx = (int) n_cached_flists++;
+        cached_flists[l->cache_idx] = l;
+    } else
+        pa_log_debug("Too many cached flists, %s gets no cache.", l->name);
+
+    pa_mutex_unlock(m);
+
+    return l;
+}
+
 void pa_flist_free(pa_flist *l, pa_free_cb_t free_cb) {
     pa_assert(l);
     pa_assert(l->name);
 
+    if (l->cache_idx >= 0) {
+        struct flist_thread *t;
+        pa_mutex *m;
+
+        m = pa_static_mutex_get(&cache_mutex, FALSE, FALSE);
+        pa_mutex_lock(m);
+
+        PA_LLIST_FOREACH(t, flist_threads) {
+            struct flist_cache *c = &t->caches[l->cache_idx];
+
+            for (; c->n > 0; c->n--)
+                if (free_cb)
+                    free_cb(c->items[c->n - 1]);
+        }
+
+        cached_flists[l->cache_idx] = NULL;
+
+        pa_mutex_unlock(m);
+    }
+
     if (free_cb) {
         pa_flist_elem *elem;
         while((elem = stack_pop(l, &l->stored)))
@@ -145,10 +227,8 @@ void pa_flist_free(pa_flist *l, pa_free_cb_t free_cb) {
     pa_xfree(l);
 }
 
-int pa_flist_push(pa_flist *l, void *p) {
+static int shared_push(pa_flist *l, void *p) {
     pa_flist_elem *elem;
-    pa_assert(l);
-    pa_assert(p);
 
     elem = stack_pop(l, &l->empty);
     if (elem == NULL) {
@@ -162,10 +242,9 @@ int pa_flist_push(pa_flist *l, void *p) {
     return 0;
 }
 
-void* pa_flist_pop(pa_flist *l) {
+static void* shared_pop(pa_flist *l) {
     pa_flist_elem *elem;
     void *ptr;
-    pa_assert(l);
 
     elem = stack_pop(l, &l->stored);
     if (elem == NULL)
@@ -177,3 +256,156 @@ void* pa_flist_pop(pa_flist *l) {
 
     return ptr;
 }
+
+/* Moves up to n of the oldest entries of the cache to the shared list */
+static void spill(pa_flist *l, struct flist_cache *c, unsigned n) {
+    unsigned i;
+
+    for (i = 0; i < n && i < c->n; i++)
+        if (shared_push(l, c->items[i]) < 0)
+            break;
+
+    memmove(c->items, c->items + i, (c->n - i) * sizeof(void*));
+    c->n -= i;
+}
+
+static struct flist_cache *get_cache(pa_flist *l) {
+    struct flist_thread *t;
+
+    if (l->cache_idx < 0 || !(t = PA_STATIC_TLS_GET(flist_thread)))
+        return NULL;
+
+    return &t->caches[l->cache_idx];
+}
+
+int pa_flist_push(pa_flist *l, void *p) {
+    struct flist_cache *c;
+
+    pa_assert(l);
+    pa_assert(p);
+
+    if (!(c = get_cache(l)))
+        return shared_push(l, p);
+
+    if (c->n >= FLIST_CACHE_SIZE)
+        spill(l, c, FLIST_CACHE_BATCH);
+
+    /* Fails only if the shared list is full, too */
+    if (c->n >= FLIST_CACHE_SIZE)
+        return -1;
+
+    c->items[c->n++] = p;
+    return 0;
+}
+
+void* pa_flist_pop(pa_flist *l) {
+    struct flist_cache *c;
+    void *p;
+
+    pa_assert(l);
+
+    if (!(c = get_cache(l)))
+        return shared_pop(l);
+
+    if (c->n > 0) {
+        c->hits++;
+        return c->items[--c->n];
+    }
+
+    c->misses++;
+
+    while (c->n < FLIST_CACHE_BATCH && (p = shared_pop(l)))
+        c->items[c->n++] = p;
+
+    return c->n > 0 ? c->items[--c->n] : NULL;
+}
+
+void pa_flist_thread_init(void) {
+    struct flist_thread *t;
+    pa_mutex *m;
+
+    pa_assert(!PA_STATIC_TLS_GET(flist_thread));
+
+    t = pa_xnew0(struct flist_thread, 1);
+
+    m = pa_static_mutex_get(&cache_mutex, FALSE, FALSE);
+    pa_mutex_lock(m);
+    PA_LLIST_PREPEND(struct flist_thread, flist_threads, t);
+    pa_mutex_unlock(m);
+
+    PA_STATIC_TLS_SET(flist_thread, t);
+}
+
+void pa_flist_thread_done(void) {
+    struct flist_thread *t;
+    pa_mutex *m;
+    unsigned i;
+
+    if (!(t = PA_STATIC_TLS_GET(flist_thread)))
+        return;
+
+    PA_STATIC_TLS_SET(flist_thread, NULL);
+
+    m = pa_static_mutex_get(&cache_mutex, FALSE, FALSE);
+    pa_mutex_lock(m);
+
+    for (i = 0; i < n_cached_flists; i++) {
+        struct flist_cache *c = &t->caches[i];
+        pa_flist *l;
+
+        if (!(l = cached_flists[i]))
+            continue;
+
+        spill(l, c, c->n);
+
+        for (; c->n > 0; c->n--)
+            if (l->free_cb)
+                l->free_cb(c->items[c->n - 1]);
+
+        l->hits += c->hits;
+        l->misses += c->misses;
+    }
+
+    PA_LLIST_REMOVE(struct flist_thread, flist_threads, t);
+
+    pa_mutex_unlock(m);
+
+    pa_xfree(t);
+}
+
+pa_flist_stat *pa_flist_get_stats(unsigned *n) {
+    pa_flist_stat *s;
+    pa_mutex *m;
+    unsigned i;
+
+    pa_assert(n);
+
+    m = pa_static_mutex_get(&cache_mutex, FALSE, FALSE);
+    pa_mutex_lock(m);
+
+    s = pa_xnew(pa_flist_stat, PA_MAX(n_cached_flists, 1U));
+    *n = 0;
+
+    for (i = 0; i < n_cached_flists; i++) {
+        struct flist_thread *t;
+        pa_flist *l;
+
+        if (!(l = cached_flists[i]))
+            continue;
+
+        s[*n].name = l->name;
+        s[*n].hits = l->hits;
+        s[*n].misses = l->misses;
+
+        PA_LLIST_FOREACH(t, flist_threads) {
+            s[*n].hits += t->caches[i].hits;
+            s[*n].misses += t->caches[i].misses;
+        }
+
+        (*n)++;
+    }
+
+    pa_mutex_unlock(m);
+
+    return s;
+}
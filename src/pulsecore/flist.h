@@ -36,12 +36,35 @@ pa_flist * pa_flist_new(unsigned size);
 /* Name string is copied and added to flist structure. The original is
  * responsibility of the caller. The name is only used for debug printing. */
 pa_flist * pa_flist_new_with_name(unsigned size, const char *name);
+
+/* Like pa_flist_new_with_name(), but threads created with
+ * pa_thread_new() get a small cache of their own in front of the shared
+ * list, which is refilled from and spilled to it in batches. free_cb is
+ * used for what does not fit back into the shared list when a thread
+ * exits. The list must not be freed while other threads still use it,
+ * so this is meant for the static lists below. */
+pa_flist * pa_flist_new_cached(unsigned size, const char *name, pa_free_cb_t free_cb);
 void pa_flist_free(pa_flist *l, pa_free_cb_t free_cb);
 
 /* Please note that this routine might fail! */
 int pa_flist_push(pa_flist*l, void *p);
 void* pa_flist_pop(pa_flist*l);
 
+/* Set up and tear down the caches of the calling thread */
+void pa_flist_thread_init(void);
+void pa_flist_thread_done(void);
+
+typedef struct pa_flist_stat {
+    const char *name;
+    uint64_t hits;   /* pops served from a thread's cache */
+    uint64_t misses; /* pops that had to go to the shared list */
+} pa_flist_stat;
+
+/* Returns the counters of all lists with caches as an array to be
+ * freed with pa_xfree(). The counters of running threads are read
+ * without synchronization, so they may be slightly behind. */
+pa_flist_stat *pa_flist_get_stats(unsigned *n);
+
 /* Please note that the destructor stuff is not really necessary, we do
  * this just to make valgrind output more useful. */
 
@@ -52,7 +75,7 @@ void* pa_flist_pop(pa_flist*l);
     } name##_flist = { NULL, PA_ONCE_INIT };                            \
     static void name##_flist_init(void) {                               \
         name##_flist.flist =                                            \
-            pa_flist_new_with_name(size, __FILE__ ": " #name);          \
+            pa_flist_new_cached(size, __FILE__ ": " #name, (free_cb));  \
     }                                                                   \
     static inline pa_flist* name##_flist_get(void) {                    \
         pa_run_once(&name##_flist.once, name##_flist_init);             \
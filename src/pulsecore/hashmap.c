@@ -27,143 +27,220 @@
 
 #include <pulse/xmalloc.h>
 #include <pulsecore/idxset.h>
-#include <pulsecore/flist.h>
 #include <pulsecore/macro.h>
 
 #include "hashmap.h"
 
-#define NBUCKETS 127
+/* Entries are stored in an array in insertion order, which makes
+ * iterating trivial. An open addressing table with linear probing
+ * maps hashes to positions in that array. Removed entries leave a
+ * hole in the array and a tombstone in the table until the next
+ * rebuild, which happens when the array is full. The table is kept at
+ * twice the size of the array, so it is never more than half full. */
+
+#define INITIAL_ENTRIES 8
+
+#define INDEX_FREE (-1)
+#define INDEX_DELETED (-2)
 
 struct hashmap_entry {
     const void *key;
     void *value;
-
-    struct hashmap_entry *bucket_next, *bucket_previous;
-    struct hashmap_entry *iterate_next, *iterate_previous;
+    unsigned hash;
+    pa_bool_t dead;
 };
 
 struct pa_hashmap {
     pa_hash_func_t hash_func;
     pa_compare_func_t compare_func;
 
-    struct hashmap_entry *iterate_list_head, *iterate_list_tail;
+    struct hashmap_entry *entries;
+    unsigned n_allocated, n_used;
+
+    /* Index of the oldest entry that might still be alive */
+    unsigned first;
+
+    int *index;
+    unsigned index_mask;
+
     unsigned n_entries;
 };
 
-#define BY_HASH(h) ((struct hashmap_entry**) ((uint8_t*) (h) + PA_ALIGN(sizeof(pa_hashmap))))
+/* Hash functions like the trivial one leave the lowest bits of
+ * aligned pointers all zero. Spread the upper bits over them, since
+ * only the lowest bits select the slot. */
+static inline unsigned mix_hash(unsigned hash) {
+    hash ^= hash >> 16;
+    hash *= 0x45d9f3bU;
+    hash ^= hash >> 16;
+
+    return hash;
+}
 
-PA_STATIC_FLIST_DECLARE(entries, 0, pa_xfree);
+static void index_init(pa_hashmap *h, unsigned n_allocated) {
+    unsigned i;
+
+    h->index_mask = 2 * n_allocated - 1;
+    h->index = pa_xnew(int, h->index_mask + 1);
+
+    for (i = 0; i <= h->index_mask; i++)
+        h->index[i] = INDEX_FREE;
+}
 
 pa_hashmap *pa_hashmap_new(pa_hash_func_t hash_func, pa_compare_func_t compare_func) {
     pa_hashmap *h;
 
-    h = pa_xmalloc0(PA_ALIGN(sizeof(pa_hashmap)) + NBUCKETS*sizeof(struct hashmap_entry*));
+    h = pa_xnew(pa_hashmap, 1);
 
     h->hash_func = hash_func ? hash_func : pa_idxset_trivial_hash_func;
     h->compare_func = compare_func ? compare_func : pa_idxset_trivial_compare_func;
 
+    h->n_allocated = INITIAL_ENTRIES;
+    h->entries = pa_xnew(struct hashmap_entry, h->n_allocated);
+    h->n_used = h->first = 0;
     h->n_entries = 0;
-    h->iterate_list_head = h->iterate_list_tail = NULL;
+
+    index_init(h, h->n_allocated);
 
     return h;
 }
 
-static void remove_entry(pa_hashmap *h, struct hashmap_entry *e) {
-    pa_assert(h);
-    pa_assert(e);
-
-    /* Remove from iteration list */
-    if (e->iterate_next)
-        e->iterate_next->iterate_previous = e->iterate_previous;
-    else
-        h->iterate_list_tail = e->iterate_previous;
-
-    if (e->iterate_previous)
-        e->iterate_previous->iterate_next = e->iterate_next;
-    else
-        h->iterate_list_head = e->iterate_next;
-
-    /* Remove from hash table bucket list */
-    if (e->bucket_next)
-        e->bucket_next->bucket_previous = e->bucket_previous;
-
-    if (e->bucket_previous)
-        e->bucket_previous->bucket_next = e->bucket_next;
-    else {
-        unsigned hash = h->hash_func(e->key) % NBUCKETS;
-        BY_HASH(h)[hash] = e->bucket_next;
+/* Returns the position of the entry in the table, or the free slot
+ * the key would go to */
+static unsigned index_scan(pa_hashmap *h, unsigned hash, const void *key) {
+    unsigned i;
+
+    for (i = hash & h->index_mask;; i = (i + 1) & h->index_mask) {
+        int k = h->index[i];
+
+        if (k == INDEX_FREE)
+            return i;
+
+        if (k >= 0 && h->entries[k].hash == hash && h->compare_func(h->entries[k].key, key) == 0)
+            return i;
     }
+}
 
-    if (pa_flist_push(PA_STATIC_FLIST_GET(entries), e) < 0)
-        pa_xfree(e);
+static struct hashmap_entry *hash_scan(pa_hashmap *h, unsigned hash, const void *key, unsigned *slot) {
+    unsigned i;
 
-    pa_assert(h->n_entries >= 1);
-    h->n_entries--;
+    i = index_scan(h, hash, key);
+
+    if (slot)
+        *slot = i;
+
+    if (h->index[i] < 0)
+        return NULL;
+
+    return h->entries + h->index[i];
 }
 
-void pa_hashmap_free(pa_hashmap*h, pa_free2_cb_t free_cb, void *userdata) {
-    pa_assert(h);
+/* Squeezes out removed entries, grows the array if that doesn't free
+ * enough space, and builds a new table */
+static void rebuild(pa_hashmap *h) {
+    struct hashmap_entry *entries;
+    unsigned i, j, n_allocated;
 
-    while (h->iterate_list_head) {
-        void *data;
-        data = h->iterate_list_head->value;
-        remove_entry(h, h->iterate_list_head);
+    n_allocated = h->n_allocated;
+    if (h->n_entries >= n_allocated / 2)
+        n_allocated *= 2;
 
-        if (free_cb)
-            free_cb(data, userdata);
-    }
+    entries = pa_xnew(struct hashmap_entry, n_allocated);
 
-    pa_xfree(h);
+    for (i = h->first, j = 0; i < h->n_used; i++)
+        if (!h->entries[i].dead)
+            entries[j++] = h->entries[i];
+
+    pa_assert(j == h->n_entries);
+
+    pa_xfree(h->entries);
+    pa_xfree(h->index);
+
+    h->entries = entries;
+    h->n_allocated = n_allocated;
+    h->n_used = j;
+    h->first = 0;
+
+    index_init(h, n_allocated);
+
+    for (i = 0; i < h->n_used; i++) {
+        for (j = h->entries[i].hash & h->index_mask; h->index[j] != INDEX_FREE; j = (j + 1) & h->index_mask)
+            ;
+
+        h->index[j] = (int) i;
+    }
 }
 
-static struct hashmap_entry *hash_scan(pa_hashmap *h, unsigned hash, const void *key) {
+static void remove_entry(pa_hashmap *h, unsigned slot) {
     struct hashmap_entry *e;
+
     pa_assert(h);
-    pa_assert(hash < NBUCKETS);
+    pa_assert(h->index[slot] >= 0);
 
-    for (e = BY_HASH(h)[hash]; e; e = e->bucket_next)
-        if (h->compare_func(e->key, key) == 0)
-            return e;
+    e = h->entries + h->index[slot];
+    e->dead = TRUE;
 
-    return NULL;
+    /* If the next slot is free, no probe sequence runs through this
+     * slot and we don't need a tombstone */
+    h->index[slot] = h->index[(slot + 1) & h->index_mask] == INDEX_FREE ? INDEX_FREE : INDEX_DELETED;
+
+    while (h->first < h->n_used && h->entries[h->first].dead)
+        h->first++;
+
+    pa_assert(h->n_entries >= 1);
+    h->n_entries--;
+}
+
+static void remove_entry_by_ptr(pa_hashmap *h, struct hashmap_entry *e) {
+    unsigned slot;
+
+    pa_assert_se(hash_scan(h, e->hash, e->key, &slot) == e);
+    remove_entry(h, slot);
+}
+
+void pa_hashmap_free(pa_hashmap*h, pa_free2_cb_t free_cb, void *userdata) {
+    unsigned i;
+
+    pa_assert(h);
+
+    if (free_cb)
+        for (i = h->first; i < h->n_used; i++)
+            if (!h->entries[i].dead)
+                free_cb(h->entries[i].value, userdata);
+
+    pa_xfree(h->entries);
+    pa_xfree(h->index);
+    pa_xfree(h);
 }
 
 int pa_hashmap_put(pa_hashmap *h, const void *key, void *value) {
     struct hashmap_entry *e;
-    unsigned hash;
+    unsigned hash, i;
 
     pa_assert(h);
 
-    hash = h->hash_func(key) % NBUCKETS;
+    hash = mix_hash(h->hash_func(key));
 
-    if (hash_scan(h, hash, key))
+    if (hash_scan(h, hash, key, NULL))
         return -1;
 
-    if (!(e = pa_flist_pop(PA_STATIC_FLIST_GET(entries))))
-        e = pa_xnew(struct hashmap_entry, 1);
+    if (h->n_used >= h->n_allocated)
+        rebuild(h);
 
+    e = h->entries + h->n_used;
     e->key = key;
     e->value = value;
+    e->hash = hash;
+    e->dead = FALSE;
 
-    /* Insert into hash table */
-    e->bucket_next = BY_HASH(h)[hash];
-    e->bucket_previous = NULL;
-    if (BY_HASH(h)[hash])
-        BY_HASH(h)[hash]->bucket_previous = e;
-    BY_HASH(h)[hash] = e;
-
-    /* Insert into iteration list */
-    e->iterate_previous = h->iterate_list_tail;
-    e->iterate_next = NULL;
-    if (h->iterate_list_tail) {
-        pa_assert(h->iterate_list_head);
-        h->iterate_list_tail->iterate_next = e;
-    } else {
-        pa_assert(!h->iterate_list_head);
-        h->iterate_list_head = e;
-    }
-    h->iterate_list_tail = e;
+    /* Now that we know the key isn't there, the first tombstone on the
+     * way will do as well as a free slot */
+    for (i = hash & h->index_mask; h->index[i] >= 0; i = (i + 1) & h->index_mask)
+        ;
+
+    h->index[i] = (int) h->n_used;
 
+    h->n_used++;
     h->n_entries++;
     pa_assert(h->n_entries >= 1);
 
@@ -171,14 +248,11 @@ int pa_hashmap_put(pa_hashmap *h, const void *key, void *value) {
 }
 
 void* pa_hashmap_get(pa_hashmap *h, const void *key) {
-    unsigned hash;
     struct hashmap_entry *e;
 
     pa_assert(h);
 
-    hash = h->hash_func(key) % NBUCKETS;
-
-    if (!(e = hash_scan(h, hash, key)))
+    if (!(e = hash_scan(h, mix_hash(h->hash_func(key)), key, NULL)))
         return NULL;
 
     return e->value;
@@ -186,24 +260,26 @@ void* pa_hashmap_get(pa_hashmap *h, const void *key) {
 
 void* pa_hashmap_remove(pa_hashmap *h, const void *key) {
     struct hashmap_entry *e;
-    unsigned hash;
+    unsigned slot;
     void *data;
 
     pa_assert(h);
 
-    hash = h->hash_func(key) % NBUCKETS;
-
-    if (!(e = hash_scan(h, hash, key)))
+    if (!(e = hash_scan(h, mix_hash(h->hash_func(key)), key, &slot)))
         return NULL;
 
     data = e->value;
-    remove_entry(h, e);
+    remove_entry(h, slot);
 
     return data;
 }
 
+/* The iteration state is the position of the next entry to look at
+ * plus one, and (void*) -1 when done. Removing entries never moves
+ * the others around, so the current one may be removed meanwhile. */
+
 void *pa_hashmap_iterate(pa_hashmap *h, void **state, const void **key) {
-    struct hashmap_entry *e;
+    unsigned i;
 
     pa_assert(h);
     pa_assert(state);
@@ -211,20 +287,21 @@ void *pa_hashmap_iterate(pa_hashmap *h, void **state, const void **key) {
     if (*state == (void*) -1)
         goto at_end;
 
-    if (!*state && !h->iterate_list_head)
-        goto at_end;
+    i = *state ? (unsigned) ((uintptr_t) *state - 1) : h->first;
 
-    e = *state ? *state : h->iterate_list_head;
+    for (; i < h->n_used; i++)
+        if (!h->entries[i].dead)
+            break;
 
-    if (e->iterate_next)
-        *state = e->iterate_next;
-    else
-        *state = (void*) -1;
+    if (i >= h->n_used)
+        goto at_end;
+
+    *state = (void*) ((uintptr_t) i + 2);
 
     if (key)
-        *key = e->key;
+        *key = h->entries[i].key;
 
-    return e->value;
+    return h->entries[i].value;
 
 at_end:
     *state = (void *) -1;
@@ -235,29 +312,45 @@ at_end:
     return NULL;
 }
 
-void *pa_hashmap_iterate_backwards(pa_hashmap *h, void **state, const void **key) {
+void *pa_hashmap_iterate_seek(pa_hashmap *h, void **state, const void *key) {
     struct hashmap_entry *e;
 
     pa_assert(h);
     pa_assert(state);
 
+    if (!(e = hash_scan(h, mix_hash(h->hash_func(key)), key, NULL)))
+        return NULL;
+
+    *state = (void*) ((uintptr_t) (e - h->entries) + 2);
+
+    return e->value;
+}
+
+void *pa_hashmap_iterate_backwards(pa_hashmap *h, void **state, const void **key) {
+    unsigned i;
+
+    pa_assert(h);
+    pa_assert(state);
+
     if (*state == (void*) -1)
         goto at_beginning;
 
-    if (!*state && !h->iterate_list_tail)
+    i = *state ? (unsigned) ((uintptr_t) *state - 1) : h->n_used;
+
+    while (i > h->first && h->entries[i - 1].dead)
+        i--;
+
+    if (i <= h->first)
         goto at_beginning;
 
-    e = *state ? *state : h->iterate_list_tail;
+    i--;
 
-    if (e->iterate_previous)
-        *state = e->iterate_previous;
-    else
-        *state = (void*) -1;
+    *state = (void*) ((uintptr_t) i + 1);
 
     if (key)
-        *key = e->key;
+        *key = h->entries[i].key;
 
-    return e->value;
+    return h->entries[i].value;
 
 at_beginning:
     *state = (void *) -1;
@@ -271,19 +364,18 @@ at_beginning:
 void* pa_hashmap_first(pa_hashmap *h) {
     pa_assert(h);
 
-    if (!h->iterate_list_head)
+    if (h->n_entries <= 0)
         return NULL;
 
-    return h->iterate_list_head->value;
+    return h->entries[h->first].value;
 }
 
 void* pa_hashmap_last(pa_hashmap *h) {
-    pa_assert(h);
+    void *state = NULL;
 
-    if (!h->iterate_list_tail)
-        return NULL;
+    pa_assert(h);
 
-    return h->iterate_list_tail->value;
+    return pa_hashmap_iterate_backwards(h, &state, NULL);
 }
 
 void* pa_hashmap_steal_first(pa_hashmap *h) {
@@ -291,11 +383,11 @@ void* pa_hashmap_steal_first(pa_hashmap *h) {
 
     pa_assert(h);
 
-    if (!h->iterate_list_head)
+    if (h->n_entries <= 0)
         return NULL;
 
-    data = h->iterate_list_head->value;
-    remove_entry(h, h->iterate_list_head);
+    data = h->entries[h->first].value;
+    remove_entry_by_ptr(h, h->entries + h->first);
 
     return data;
 }
@@ -60,6 +60,11 @@ pa_bool_t pa_hashmap_isempty(pa_hashmap *h);
    returned. */
 void *pa_hashmap_iterate(pa_hashmap *h, void **state, const void**key);
 
+/* Sets *state so that pa_hashmap_iterate() continues with the entry
+ * after the one of key and returns the value of key. If key isn't in
+ * the hashmap NULL is returned and *state is left alone. */
+void *pa_hashmap_iterate_seek(pa_hashmap *h, void **state, const void *key);
+
 /* Same as pa_hashmap_iterate() but goes backwards */
 void *pa_hashmap_iterate_backwards(pa_hashmap *h, void **state, const void**key);
 
@@ -0,0 +1,63 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/macro.h>
+
+#include "histogram.h"
+
+void pa_histogram_init(pa_histogram *h) {
+    unsigned k;
+
+    pa_assert(h);
+
+    for (k = 0; k < PA_HISTOGRAM_BUCKETS; k++)
+        pa_atomic_store(&h->buckets[k], 0);
+}
+
+void pa_histogram_add(pa_histogram *h, pa_usec_t usec) {
+    unsigned k;
+
+    pa_assert(h);
+
+    if (PA_UNLIKELY(usec >= (1ULL << (PA_HISTOGRAM_BUCKETS - 1))))
+        k = PA_HISTOGRAM_BUCKETS - 1;
+    else
+        k = pa_ulog2((unsigned) usec);
+
+    pa_atomic_inc(&h->buckets[k]);
+}
+
+void pa_histogram_get(pa_histogram *h, uint32_t *counts) {
+    unsigned k;
+
+    pa_assert(h);
+    pa_assert(counts);
+
+    for (k = 0; k < PA_HISTOGRAM_BUCKETS; k++)
+        counts[k] = (uint32_t) pa_atomic_load(&h->buckets[k]);
+}
+
+void pa_histogram_reset(pa_histogram *h) {
+    pa_histogram_init(h);
+}
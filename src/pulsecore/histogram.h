@@ -0,0 +1,52 @@
+#ifndef foopulsecorehistogramhfoo
+#define foopulsecorehistogramhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <inttypes.h>
+
+#include <pulse/sample.h>
+
+#include <pulsecore/atomic.h>
+
+/* A histogram of durations with a fixed set of buckets: bucket 0 counts
+ * everything below 2 us, bucket n everything from 2^n us up to below
+ * 2^(n+1) us, and the last bucket everything longer. The counters are
+ * atomic, so that the IO threads can add to them without taking any
+ * lock while the main thread reads them. */
+
+#define PA_HISTOGRAM_BUCKETS 20
+
+typedef struct pa_histogram {
+    pa_atomic_t buckets[PA_HISTOGRAM_BUCKETS];
+} pa_histogram;
+
+void pa_histogram_init(pa_histogram *h);
+
+void pa_histogram_add(pa_histogram *h, pa_usec_t usec);
+
+/* Copies the counters into counts[PA_HISTOGRAM_BUCKETS]. Counts added
+ * meanwhile may or may not show up. */
+void pa_histogram_get(pa_histogram *h, uint32_t *counts);
+
+/* Counts added while this runs may get lost */
+void pa_histogram_reset(pa_histogram *h);
+
+#endif
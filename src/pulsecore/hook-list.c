@@ -23,6 +23,9 @@
 #include <config.h>
 #endif
 
+#include <string.h>
+
+#include <pulse/rtclock.h>
 #include <pulse/xmalloc.h>
 
 #include <pulsecore/macro.h>
@@ -34,15 +37,26 @@ void pa_hook_init(pa_hook *hook, void *data) {
 
     PA_LLIST_HEAD_INIT(pa_hook_slot, hook->slots);
     hook->n_dead = hook->n_firing = 0;
+    hook->get_object = NULL;
+    hook->get_proplist = NULL;
+    memset(&hook->stat, 0, sizeof(hook->stat));
     hook->data = data;
 }
 
+void pa_hook_set_accessors(pa_hook *hook, pa_hook_object_cb_t get_object, pa_hook_proplist_cb_t get_proplist) {
+    pa_assert(hook);
+
+    hook->get_object = get_object;
+    hook->get_proplist = get_proplist;
+}
+
 static void slot_free(pa_hook *hook, pa_hook_slot *slot) {
     pa_assert(hook);
     pa_assert(slot);
 
     PA_LLIST_REMOVE(pa_hook_slot, hook->slots, slot);
 
+    pa_xfree(slot->filter_key);
     pa_xfree(slot);
 }
 
@@ -56,10 +70,12 @@ void pa_hook_done(pa_hook *hook) {
     pa_hook_init(hook, NULL);
 }
 
-pa_hook_slot* pa_hook_connect(pa_hook *hook, pa_hook_priority_t prio, pa_hook_cb_t cb, void *data) {
+pa_hook_slot* pa_hook_connect_filtered(pa_hook *hook, pa_hook_priority_t prio, const pa_hook_filter *filter, pa_hook_cb_t cb, void *data) {
     pa_hook_slot *slot, *where, *prev;
 
     pa_assert(cb);
+    pa_assert(!filter || !filter->object || hook->get_object);
+    pa_assert(!filter || !filter->proplist_key || hook->get_proplist);
 
     slot = pa_xnew(pa_hook_slot, 1);
     slot->hook = hook;
@@ -67,6 +83,8 @@ pa_hook_slot* pa_hook_connect(pa_hook *hook, pa_hook_priority_t prio, pa_hook_cb
     slot->callback = cb;
     slot->data = data;
     slot->priority = prio;
+    slot->filter_object = filter ? filter->object : NULL;
+    slot->filter_key = filter ? pa_xstrdup(filter->proplist_key) : NULL;
 
     prev = NULL;
     for (where = hook->slots; where; where = where->next) {
@@ -80,6 +98,10 @@ pa_hook_slot* pa_hook_connect(pa_hook *hook, pa_hook_priority_t prio, pa_hook_cb
     return slot;
 }
 
+pa_hook_slot* pa_hook_connect(pa_hook *hook, pa_hook_priority_t prio, pa_hook_cb_t cb, void *data) {
+    return pa_hook_connect_filtered(hook, prio, NULL, cb, data);
+}
+
 void pa_hook_slot_free(pa_hook_slot *slot) {
     pa_assert(slot);
     pa_assert(!slot->dead);
@@ -94,15 +116,53 @@ void pa_hook_slot_free(pa_hook_slot *slot) {
 pa_hook_result_t pa_hook_fire(pa_hook *hook, void *data) {
     pa_hook_slot *slot, *next;
     pa_hook_result_t result = PA_HOOK_OK;
+    pa_proplist *proplist = NULL;
+    void *object = NULL;
+    pa_bool_t have_object = FALSE, have_proplist = FALSE;
+    pa_usec_t start;
 
     pa_assert(hook);
 
+    hook->stat.n_fired++;
+
+    if (!hook->slots)
+        return result;
+
+    start = pa_rtclock_now();
     hook->n_firing ++;
 
     PA_LLIST_FOREACH(slot, hook->slots) {
         if (slot->dead)
             continue;
 
+        /* The accessors are only asked once, and only if a slot
+         * wants to know */
+        if (slot->filter_object) {
+            if (!have_object) {
+                object = hook->get_object(data);
+                have_object = TRUE;
+            }
+
+            if (object != slot->filter_object) {
+                hook->stat.n_skipped++;
+                continue;
+            }
+        }
+
+        if (slot->filter_key) {
+            if (!have_proplist) {
+                proplist = hook->get_proplist(data);
+                have_proplist = TRUE;
+            }
+
+            if (!proplist || pa_proplist_contains(proplist, slot->filter_key) <= 0) {
+                hook->stat.n_skipped++;
+                continue;
+            }
+        }
+
+        hook->stat.n_called++;
+
         if ((result = slot->callback(hook->data, data, slot->data)) != PA_HOOK_OK)
             break;
     }
@@ -121,6 +181,10 @@ pa_hook_result_t pa_hook_fire(pa_hook *hook, void *data) {
 
     pa_assert(hook->n_dead == 0);
 
+    /* Nested firings are part of the outermost one */
+    if (hook->n_firing == 0)
+        hook->stat.time += pa_rtclock_now() - start;
+
     return result;
 }
 
@@ -129,3 +193,9 @@ pa_bool_t pa_hook_is_firing(pa_hook *hook) {
 
     return hook->n_firing > 0;
 }
+
+const pa_hook_stat* pa_hook_get_stat(pa_hook *hook) {
+    pa_assert(hook);
+
+    return &hook->stat;
+}
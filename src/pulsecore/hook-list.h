@@ -22,6 +22,9 @@
   USA.
 ***/
 
+#include <pulse/proplist.h>
+#include <pulse/sample.h>
+
 #include <pulsecore/llist.h>
 
 typedef struct pa_hook_slot pa_hook_slot;
@@ -44,30 +47,65 @@ typedef pa_hook_result_t (*pa_hook_cb_t)(
         void *call_data,
         void *slot_data);
 
+/* Returns the object the call data is about, e.g. the sink a sink
+ * input is connected to, and its property list */
+typedef void* (*pa_hook_object_cb_t)(void *call_data);
+typedef pa_proplist* (*pa_hook_proplist_cb_t)(void *call_data);
+
+/* A slot with a filter is only called for call data that matches all
+ * of its fields. The hook needs the accessors for the fields that are
+ * set, see pa_hook_set_accessors(). */
+typedef struct pa_hook_filter {
+    /* Only call data about this object, NULL for any */
+    const void *object;
+    /* Only call data whose property list has this key, NULL for any */
+    const char *proplist_key;
+} pa_hook_filter;
+
 struct pa_hook_slot {
     pa_bool_t dead;
     pa_hook *hook;
     pa_hook_priority_t priority;
     pa_hook_cb_t callback;
     void *data;
+    const void *filter_object;
+    char *filter_key;
     PA_LLIST_FIELDS(pa_hook_slot);
 };
 
+/* For profiling, kept across the whole lifetime of the hook */
+typedef struct pa_hook_stat {
+    uint64_t n_fired;
+    uint64_t n_called;
+    uint64_t n_skipped;
+    pa_usec_t time;
+} pa_hook_stat;
+
 struct pa_hook {
     PA_LLIST_HEAD(pa_hook_slot, slots);
     int n_firing, n_dead;
 
+    pa_hook_object_cb_t get_object;
+    pa_hook_proplist_cb_t get_proplist;
+
+    pa_hook_stat stat;
+
     void *data;
 };
 
 void pa_hook_init(pa_hook *hook, void *data);
 void pa_hook_done(pa_hook *hook);
 
+void pa_hook_set_accessors(pa_hook *hook, pa_hook_object_cb_t get_object, pa_hook_proplist_cb_t get_proplist);
+
 pa_hook_slot* pa_hook_connect(pa_hook *hook, pa_hook_priority_t prio, pa_hook_cb_t cb, void *data);
+pa_hook_slot* pa_hook_connect_filtered(pa_hook *hook, pa_hook_priority_t prio, const pa_hook_filter *filter, pa_hook_cb_t cb, void *data);
 void pa_hook_slot_free(pa_hook_slot *slot);
 
 pa_hook_result_t pa_hook_fire(pa_hook *hook, void *data);
 
 pa_bool_t pa_hook_is_firing(pa_hook *hook);
 
+const pa_hook_stat* pa_hook_get_stat(pa_hook *hook);
+
 #endif
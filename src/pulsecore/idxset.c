@@ -29,20 +29,27 @@
 #include <string.h>
 
 #include <pulse/xmalloc.h>
-#include <pulsecore/flist.h>
 #include <pulsecore/macro.h>
 
 #include "idxset.h"
 
-#define NBUCKETS 127
+/* Entries are stored in an array ordered by their index, which is
+ * also the order they were added in since indexes are never
+ * reused. Holes left by removed entries are squeezed out when the
+ * array fills up. Two open addressing tables with linear probing, each
+ * twice the size of the array, map data and index to the position in
+ * the array. */
+
+#define INITIAL_ENTRIES 8
+
+#define SLOT_FREE (-1)
+#define SLOT_DELETED (-2)
 
 struct idxset_entry {
     uint32_t idx;
     void *data;
-
-    struct idxset_entry *data_next, *data_previous;
-    struct idxset_entry *index_next, *index_previous;
-    struct idxset_entry *iterate_next, *iterate_previous;
+    unsigned hash;
+    pa_bool_t dead;
 };
 
 struct pa_idxset {
@@ -51,14 +58,17 @@ struct pa_idxset {
 
     uint32_t current_index;
 
-    struct idxset_entry *iterate_list_head, *iterate_list_tail;
-    unsigned n_entries;
-};
+    struct idxset_entry *entries;
+    unsigned n_allocated, n_used;
 
-#define BY_DATA(i) ((struct idxset_entry**) ((uint8_t*) (i) + PA_ALIGN(sizeof(pa_idxset))))
-#define BY_INDEX(i) (BY_DATA(i) + NBUCKETS)
+    /* Position of the oldest entry that might still be alive */
+    unsigned first;
 
-PA_STATIC_FLIST_DECLARE(entries, 0, pa_xfree);
+    int *by_data, *by_index;
+    unsigned mask;
+
+    unsigned n_entries;
+};
 
 unsigned pa_idxset_string_hash_func(const void *p) {
     unsigned hash = 0;
@@ -82,152 +92,236 @@ int pa_idxset_trivial_compare_func(const void *a, const void *b) {
     return a < b ? -1 : (a > b ? 1 : 0);
 }
 
+/* Hash functions like the trivial one leave the lowest bits of
+ * aligned pointers all zero. Spread the upper bits over them, since
+ * only the lowest bits select the slot. */
+static inline unsigned mix_hash(unsigned hash) {
+    hash ^= hash >> 16;
+    hash *= 0x45d9f3bU;
+    hash ^= hash >> 16;
+
+    return hash;
+}
+
+static void tables_init(pa_idxset *s, unsigned n_allocated) {
+    unsigned i;
+
+    s->mask = 2 * n_allocated - 1;
+    s->by_data = pa_xnew(int, s->mask + 1);
+    s->by_index = pa_xnew(int, s->mask + 1);
+
+    for (i = 0; i <= s->mask; i++)
+        s->by_data[i] = s->by_index[i] = SLOT_FREE;
+}
+
 pa_idxset* pa_idxset_new(pa_hash_func_t hash_func, pa_compare_func_t compare_func) {
     pa_idxset *s;
 
-    s = pa_xmalloc0(PA_ALIGN(sizeof(pa_idxset)) + NBUCKETS*2*sizeof(struct idxset_entry*));
+    s = pa_xnew(pa_idxset, 1);
 
     s->hash_func = hash_func ? hash_func : pa_idxset_trivial_hash_func;
     s->compare_func = compare_func ? compare_func : pa_idxset_trivial_compare_func;
 
     s->current_index = 0;
     s->n_entries = 0;
-    s->iterate_list_head = s->iterate_list_tail = NULL;
+
+    s->n_allocated = INITIAL_ENTRIES;
+    s->entries = pa_xnew(struct idxset_entry, s->n_allocated);
+    s->n_used = s->first = 0;
+
+    tables_init(s, s->n_allocated);
 
     return s;
 }
 
-static void remove_entry(pa_idxset *s, struct idxset_entry *e) {
-    pa_assert(s);
-    pa_assert(e);
+/* Both return the table slot of the entry, or the free slot it would
+ * go to */
+static unsigned data_scan(pa_idxset *s, unsigned hash, const void *p) {
+    unsigned i;
 
-    /* Remove from iteration linked list */
-    if (e->iterate_next)
-        e->iterate_next->iterate_previous = e->iterate_previous;
-    else
-        s->iterate_list_tail = e->iterate_previous;
+    for (i = hash & s->mask;; i = (i + 1) & s->mask) {
+        int k = s->by_data[i];
 
-    if (e->iterate_previous)
-        e->iterate_previous->iterate_next = e->iterate_next;
-    else
-        s->iterate_list_head = e->iterate_next;
+        if (k == SLOT_FREE)
+            return i;
 
-    /* Remove from data hash table */
-    if (e->data_next)
-        e->data_next->data_previous = e->data_previous;
+        if (k >= 0 && s->entries[k].hash == hash && s->compare_func(s->entries[k].data, p) == 0)
+            return i;
+    }
+}
 
-    if (e->data_previous)
-        e->data_previous->data_next = e->data_next;
-    else {
-        unsigned hash = s->hash_func(e->data) % NBUCKETS;
-        BY_DATA(s)[hash] = e->data_next;
+static unsigned index_scan(pa_idxset *s, uint32_t idx) {
+    unsigned i;
+
+    for (i = idx & s->mask;; i = (i + 1) & s->mask) {
+        int k = s->by_index[i];
+
+        if (k == SLOT_FREE)
+            return i;
+
+        if (k >= 0 && s->entries[k].idx == idx)
+            return i;
     }
+}
 
-    /* Remove from index hash table */
-    if (e->index_next)
-        e->index_next->index_previous = e->index_previous;
+static struct idxset_entry* get_by_data(pa_idxset *s, const void *p, unsigned *slot) {
+    unsigned i;
 
-    if (e->index_previous)
-        e->index_previous->index_next = e->index_next;
-    else
-        BY_INDEX(s)[e->idx % NBUCKETS] = e->index_next;
+    pa_assert(p);
 
-    if (pa_flist_push(PA_STATIC_FLIST_GET(entries), e) < 0)
-        pa_xfree(e);
+    i = data_scan(s, mix_hash(s->hash_func(p)), p);
 
-    pa_assert(s->n_entries >= 1);
-    s->n_entries--;
+    if (slot)
+        *slot = i;
+
+    return s->by_data[i] >= 0 ? s->entries + s->by_data[i] : NULL;
 }
 
-void pa_idxset_free(pa_idxset *s, pa_free2_cb_t free_cb, void *userdata) {
-    pa_assert(s);
+static struct idxset_entry* get_by_index(pa_idxset *s, uint32_t idx, unsigned *slot) {
+    unsigned i;
 
-    while (s->iterate_list_head) {
-        void *data = s->iterate_list_head->data;
+    i = index_scan(s, idx);
 
-        remove_entry(s, s->iterate_list_head);
+    if (slot)
+        *slot = i;
 
-        if (free_cb)
-            free_cb(data, userdata);
-    }
+    return s->by_index[i] >= 0 ? s->entries + s->by_index[i] : NULL;
+}
 
-    pa_xfree(s);
+static void table_insert(int *table, unsigned mask, unsigned hash, unsigned position) {
+    unsigned i;
+
+    /* The key is known not to be in the table, so the first
+     * tombstone will do as well as a free slot */
+    for (i = hash & mask; table[i] >= 0; i = (i + 1) & mask)
+        ;
+
+    table[i] = (int) position;
 }
 
-static struct idxset_entry* data_scan(pa_idxset *s, unsigned hash, const void *p) {
-    struct idxset_entry *e;
+static void table_remove(int *table, unsigned mask, unsigned slot) {
+
+    /* If the next slot is free, no probe sequence runs through this
+     * slot and we don't need a tombstone */
+    table[slot] = table[(slot + 1) & mask] == SLOT_FREE ? SLOT_FREE : SLOT_DELETED;
+}
+
+/* Squeezes out removed entries, grows the array if that doesn't free
+ * enough space, and builds new tables */
+static void rebuild(pa_idxset *s) {
+    struct idxset_entry *entries;
+    unsigned i, j, n_allocated;
+
+    n_allocated = s->n_allocated;
+    if (s->n_entries >= n_allocated / 2)
+        n_allocated *= 2;
+
+    entries = pa_xnew(struct idxset_entry, n_allocated);
+
+    for (i = s->first, j = 0; i < s->n_used; i++)
+        if (!s->entries[i].dead)
+            entries[j++] = s->entries[i];
+
+    pa_assert(j == s->n_entries);
+
+    pa_xfree(s->entries);
+    pa_xfree(s->by_data);
+    pa_xfree(s->by_index);
+
+    s->entries = entries;
+    s->n_allocated = n_allocated;
+    s->n_used = j;
+    s->first = 0;
+
+    tables_init(s, n_allocated);
+
+    for (i = 0; i < s->n_used; i++) {
+        table_insert(s->by_data, s->mask, s->entries[i].hash, i);
+        table_insert(s->by_index, s->mask, s->entries[i].idx, i);
+    }
+}
+
+static void remove_entry(pa_idxset *s, struct idxset_entry *e, unsigned data_slot) {
+    unsigned index_slot;
+
     pa_assert(s);
-    pa_assert(hash < NBUCKETS);
-    pa_assert(p);
+    pa_assert(e);
 
-    for (e = BY_DATA(s)[hash]; e; e = e->data_next)
-        if (s->compare_func(e->data, p) == 0)
-            return e;
+    pa_assert_se(get_by_index(s, e->idx, &index_slot) == e);
 
-    return NULL;
+    table_remove(s->by_data, s->mask, data_slot);
+    table_remove(s->by_index, s->mask, index_slot);
+
+    e->dead = TRUE;
+
+    while (s->first < s->n_used && s->entries[s->first].dead)
+        s->first++;
+
+    pa_assert(s->n_entries >= 1);
+    s->n_entries--;
 }
 
-static struct idxset_entry* index_scan(pa_idxset *s, unsigned hash, uint32_t idx) {
-    struct idxset_entry *e;
+static void remove_entry_by_ptr(pa_idxset *s, struct idxset_entry *e) {
+    unsigned data_slot;
+
+    pa_assert_se(get_by_data(s, e->data, &data_slot) == e);
+    remove_entry(s, e, data_slot);
+}
+
+/* Position of the first live entry following position i, or n_used */
+static unsigned next_alive(pa_idxset *s, unsigned i) {
+
+    for (; i < s->n_used; i++)
+        if (!s->entries[i].dead)
+            break;
+
+    return i;
+}
+
+void pa_idxset_free(pa_idxset *s, pa_free2_cb_t free_cb, void *userdata) {
+    unsigned i;
+
     pa_assert(s);
-    pa_assert(hash < NBUCKETS);
 
-    for (e = BY_INDEX(s)[hash]; e; e = e->index_next)
-        if (e->idx == idx)
-            return e;
+    if (free_cb)
+        for (i = s->first; i < s->n_used; i++)
+            if (!s->entries[i].dead)
+                free_cb(s->entries[i].data, userdata);
 
-    return NULL;
+    pa_xfree(s->entries);
+    pa_xfree(s->by_data);
+    pa_xfree(s->by_index);
+    pa_xfree(s);
 }
 
 int pa_idxset_put(pa_idxset*s, void *p, uint32_t *idx) {
-    unsigned hash;
     struct idxset_entry *e;
+    unsigned hash;
 
     pa_assert(s);
 
-    hash = s->hash_func(p) % NBUCKETS;
+    hash = mix_hash(s->hash_func(p));
 
-    if ((e = data_scan(s, hash, p))) {
+    if ((e = get_by_data(s, p, NULL))) {
         if (idx)
             *idx = e->idx;
 
         return -1;
     }
 
-    if (!(e = pa_flist_pop(PA_STATIC_FLIST_GET(entries))))
-        e = pa_xnew(struct idxset_entry, 1);
+    if (s->n_used >= s->n_allocated)
+        rebuild(s);
 
+    e = s->entries + s->n_used;
     e->data = p;
     e->idx = s->current_index++;
+    e->hash = hash;
+    e->dead = FALSE;
 
-    /* Insert into data hash table */
-    e->data_next = BY_DATA(s)[hash];
-    e->data_previous = NULL;
-    if (BY_DATA(s)[hash])
-        BY_DATA(s)[hash]->data_previous = e;
-    BY_DATA(s)[hash] = e;
-
-    hash = e->idx % NBUCKETS;
-
-    /* Insert into index hash table */
-    e->index_next = BY_INDEX(s)[hash];
-    e->index_previous = NULL;
-    if (BY_INDEX(s)[hash])
-        BY_INDEX(s)[hash]->index_previous = e;
-    BY_INDEX(s)[hash] = e;
-
-    /* Insert into iteration list */
-    e->iterate_previous = s->iterate_list_tail;
-    e->iterate_next = NULL;
-    if (s->iterate_list_tail) {
-        pa_assert(s->iterate_list_head);
-        s->iterate_list_tail->iterate_next = e;
-    } else {
-        pa_assert(!s->iterate_list_head);
-        s->iterate_list_head = e;
-    }
-    s->iterate_list_tail = e;
+    table_insert(s->by_data, s->mask, hash, s->n_used);
+    table_insert(s->by_index, s->mask, e->idx, s->n_used);
 
+    s->n_used++;
     s->n_entries++;
     pa_assert(s->n_entries >= 1);
 
@@ -238,28 +332,22 @@ int pa_idxset_put(pa_idxset*s, void *p, uint32_t *idx) {
 }
 
 void* pa_idxset_get_by_index(pa_idxset*s, uint32_t idx) {
-    unsigned hash;
     struct idxset_entry *e;
 
     pa_assert(s);
 
-    hash = idx % NBUCKETS;
-
-    if (!(e = index_scan(s, hash, idx)))
+    if (!(e = get_by_index(s, idx, NULL)))
         return NULL;
 
     return e->data;
 }
 
 void* pa_idxset_get_by_data(pa_idxset*s, const void *p, uint32_t *idx) {
-    unsigned hash;
     struct idxset_entry *e;
 
     pa_assert(s);
 
-    hash = s->hash_func(p) % NBUCKETS;
-
-    if (!(e = data_scan(s, hash, p)))
+    if (!(e = get_by_data(s, p, NULL)))
         return NULL;
 
     if (idx)
@@ -270,32 +358,27 @@ void* pa_idxset_get_by_data(pa_idxset*s, const void *p, uint32_t *idx) {
 
 void* pa_idxset_remove_by_index(pa_idxset*s, uint32_t idx) {
     struct idxset_entry *e;
-    unsigned hash;
     void *data;
 
     pa_assert(s);
 
-    hash = idx % NBUCKETS;
-
-    if (!(e = index_scan(s, hash, idx)))
+    if (!(e = get_by_index(s, idx, NULL)))
         return NULL;
 
     data = e->data;
-    remove_entry(s, e);
+    remove_entry_by_ptr(s, e);
 
     return data;
 }
 
 void* pa_idxset_remove_by_data(pa_idxset*s, const void *data, uint32_t *idx) {
     struct idxset_entry *e;
-    unsigned hash;
+    unsigned slot;
     void *r;
 
     pa_assert(s);
 
-    hash = s->hash_func(data) % NBUCKETS;
-
-    if (!(e = data_scan(s, hash, data)))
+    if (!(e = get_by_data(s, data, &slot)))
         return NULL;
 
     r = e->data;
@@ -303,36 +386,38 @@ void* pa_idxset_remove_by_data(pa_idxset*s, const void *data, uint32_t *idx) {
     if (idx)
         *idx = e->idx;
 
-    remove_entry(s, e);
+    remove_entry(s, e, slot);
 
     return r;
 }
 
 void* pa_idxset_rrobin(pa_idxset *s, uint32_t *idx) {
-    unsigned hash;
     struct idxset_entry *e;
+    unsigned i;
 
     pa_assert(s);
     pa_assert(idx);
 
-    hash = *idx % NBUCKETS;
-
-    e = index_scan(s, hash, *idx);
-
-    if (e && e->iterate_next)
-        e = e->iterate_next;
+    if ((e = get_by_index(s, *idx, NULL)))
+        i = next_alive(s, (unsigned) (e - s->entries) + 1);
     else
-        e = s->iterate_list_head;
+        i = s->n_used;
+
+    if (i >= s->n_used)
+        i = next_alive(s, s->first);
 
-    if (!e)
+    if (i >= s->n_used)
         return NULL;
 
-    *idx = e->idx;
-    return e->data;
+    *idx = s->entries[i].idx;
+    return s->entries[i].data;
 }
 
+/* The iteration state is the position of the next entry to look at
+ * plus one, and (void*) -1 when done. Removing entries never moves
+ * the others around, so the current one may be removed meanwhile. */
 void *pa_idxset_iterate(pa_idxset *s, void **state, uint32_t *idx) {
-    struct idxset_entry *e;
+    unsigned i;
 
     pa_assert(s);
     pa_assert(state);
@@ -340,20 +425,17 @@ void *pa_idxset_iterate(pa_idxset *s, void **state, uint32_t *idx) {
     if (*state == (void*) -1)
         goto at_end;
 
-    if ((!*state && !s->iterate_list_head))
-        goto at_end;
+    i = next_alive(s, *state ? (unsigned) ((uintptr_t) *state - 1) : s->first);
 
-    e = *state ? *state : s->iterate_list_head;
+    if (i >= s->n_used)
+        goto at_end;
 
-    if (e->iterate_next)
-        *state = e->iterate_next;
-    else
-        *state = (void*) -1;
+    *state = (void*) ((uintptr_t) i + 2);
 
     if (idx)
-        *idx = e->idx;
+        *idx = s->entries[i].idx;
 
-    return e->data;
+    return s->entries[i].data;
 
 at_end:
     *state = (void *) -1;
@@ -365,19 +447,21 @@ at_end:
 }
 
 void* pa_idxset_steal_first(pa_idxset *s, uint32_t *idx) {
+    struct idxset_entry *e;
     void *data;
 
     pa_assert(s);
 
-    if (!s->iterate_list_head)
+    if (s->n_entries <= 0)
         return NULL;
 
-    data = s->iterate_list_head->data;
+    e = s->entries + s->first;
+    data = e->data;
 
     if (idx)
-        *idx = s->iterate_list_head->idx;
+        *idx = e->idx;
 
-    remove_entry(s, s->iterate_list_head);
+    remove_entry_by_ptr(s, e);
 
     return data;
 }
@@ -385,21 +469,21 @@ void* pa_idxset_steal_first(pa_idxset *s, uint32_t *idx) {
 void* pa_idxset_first(pa_idxset *s, uint32_t *idx) {
     pa_assert(s);
 
-    if (!s->iterate_list_head) {
+    if (s->n_entries <= 0) {
         if (idx)
             *idx = PA_IDXSET_INVALID;
         return NULL;
     }
 
     if (idx)
-        *idx = s->iterate_list_head->idx;
+        *idx = s->entries[s->first].idx;
 
-    return s->iterate_list_head->data;
+    return s->entries[s->first].data;
 }
 
 void *pa_idxset_next(pa_idxset *s, uint32_t *idx) {
     struct idxset_entry *e;
-    unsigned hash;
+    unsigned i;
 
     pa_assert(s);
     pa_assert(idx);
@@ -407,38 +491,37 @@ void *pa_idxset_next(pa_idxset *s, uint32_t *idx) {
     if (*idx == PA_IDXSET_INVALID)
         return NULL;
 
-    hash = *idx % NBUCKETS;
-
-    if ((e = index_scan(s, hash, *idx))) {
-
-        e = e->iterate_next;
-
-        if (e) {
-            *idx = e->idx;
-            return e->data;
-        } else {
-            *idx = PA_IDXSET_INVALID;
-            return NULL;
-        }
-
-    } else {
+    if ((e = get_by_index(s, *idx, NULL)))
+        i = (unsigned) (e - s->entries) + 1;
+    else {
+        unsigned l, r;
 
         /* If the entry passed doesn't exist anymore we try to find
-         * the next following */
+         * the next following. The array is sorted by index, including
+         * the holes, so we can bisect. */
 
-        for ((*idx)++; *idx < s->current_index; (*idx)++) {
+        l = s->first;
+        r = s->n_used;
 
-            hash = *idx % NBUCKETS;
+        while (l < r) {
+            unsigned m = l + (r - l) / 2;
 
-            if ((e = index_scan(s, hash, *idx))) {
-                *idx = e->idx;
-                return e->data;
-            }
+            if (s->entries[m].idx <= *idx)
+                l = m + 1;
+            else
+                r = m;
         }
 
+        i = l;
+    }
+
+    if ((i = next_alive(s, i)) >= s->n_used) {
         *idx = PA_IDXSET_INVALID;
         return NULL;
     }
+
+    *idx = s->entries[i].idx;
+    return s->entries[i].data;
 }
 
 unsigned pa_idxset_size(pa_idxset*s) {
@@ -455,14 +538,15 @@ pa_bool_t pa_idxset_isempty(pa_idxset *s) {
 
 pa_idxset *pa_idxset_copy(pa_idxset *s) {
     pa_idxset *copy;
-    struct idxset_entry *i;
+    unsigned i;
 
     pa_assert(s);
 
     copy = pa_idxset_new(s->hash_func, s->compare_func);
 
-    for (i = s->iterate_list_head; i; i = i->iterate_next)
-        pa_idxset_put(copy, i->data, NULL);
+    for (i = s->first; i < s->n_used; i++)
+        if (!s->entries[i].dead)
+            pa_idxset_put(copy, s->entries[i].data, NULL);
 
     return copy;
 }
@@ -0,0 +1,412 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "iec61937.h"
+
+/* The burst preamble: two sync words, the data type and the length of
+ * the payload */
+#define PREAMBLE_SIZE 8
+#define SYNC_WORD_A 0xF872
+#define SYNC_WORD_B 0x4E1F
+
+#define TYPE_AC3 1
+#define TYPE_DTS_512 11
+#define TYPE_DTS_1024 12
+#define TYPE_DTS_2048 13
+#define TYPE_EAC3 21
+
+/* Enough of a frame to know its length */
+#define FRAME_HEADER_SIZE 8
+
+/* An AC3 burst takes 1536 IEC 958 frames of four bytes. E-AC3 is sent
+ * at four times the rate, so that its bursts are four times as long. */
+#define AC3_BURST_SIZE (1536 * 4)
+#define EAC3_BURST_SIZE (4 * AC3_BURST_SIZE)
+
+/* Bursts are always made of stereo S16LE frames */
+#define FRAME_SIZE 4
+
+struct frame_info {
+    size_t length;
+    uint16_t type;
+    size_t burst_size;
+
+    /* How many frames go into one burst, 0 for frames that only come
+     * along with another one */
+    unsigned weight, per_burst;
+};
+
+struct pa_iec61937_packetizer {
+    pa_mempool *pool;
+    pa_silence_cache *cache;
+    pa_encoding_t encoding;
+
+    /* The start of the next frame, until it has been recognized */
+    uint8_t header[FRAME_HEADER_SIZE];
+    size_t header_length;
+    size_t skipped;
+
+    /* What is still missing of the frame being copied */
+    size_t frame_missing;
+
+    /* The burst being filled, with its preamble in front of length
+     * bytes of payload */
+    pa_memblock *burst;
+    size_t length;
+    struct frame_info info;
+    unsigned frames;
+};
+
+static const pa_sample_spec burst_sample_spec = {
+    .format = PA_SAMPLE_S16LE,
+    .rate = 48000,
+    .channels = 2
+};
+
+/* In kbit/s, for frmsizecod / 2 */
+static const unsigned ac3_bitrates[19] = {
+    32, 40, 48, 56, 64, 80, 96, 112, 128, 160,
+    192, 224, 256, 320, 384, 448, 512, 576, 640
+};
+
+pa_encoding_t pa_iec61937_encoding(pa_encoding_t raw) {
+    switch (raw) {
+        case PA_ENCODING_AC3:
+            return PA_ENCODING_AC3_IEC61937;
+        case PA_ENCODING_EAC3:
+            return PA_ENCODING_EAC3_IEC61937;
+        case PA_ENCODING_DTS:
+            return PA_ENCODING_DTS_IEC61937;
+        default:
+            return PA_ENCODING_INVALID;
+    }
+}
+
+static int parse_ac3(const uint8_t *h, struct frame_info *info) {
+    unsigned fscod, frmsizecod, kbps, words;
+
+    if (h[0] != 0x0B || h[1] != 0x77 || (h[5] >> 3) > 10)
+        return -1;
+
+    fscod = h[4] >> 6;
+    frmsizecod = h[4] & 0x3F;
+
+    if (fscod == 3 || frmsizecod >= 2 * PA_ELEMENTSOF(ac3_bitrates))
+        return -1;
+
+    kbps = ac3_bitrates[frmsizecod / 2];
+
+    /* 16 bit words for 1536 samples at 48, 44.1 and 32 kHz. At 44.1 kHz
+     * the odd codes add a word to make up for the rounding. */
+    if (fscod == 0)
+        words = kbps * 2;
+    else if (fscod == 1)
+        words = kbps * 320 / 147 + (frmsizecod & 1);
+    else
+        words = kbps * 3;
+
+    info->length = words * 2;
+    info->type = TYPE_AC3 | ((h[5] & 7) << 8);
+    info->burst_size = AC3_BURST_SIZE;
+    info->weight = info->per_burst = 1;
+
+    return 0;
+}
+
+static int parse_eac3(const uint8_t *h, struct frame_info *info) {
+    static const unsigned blocks[4] = { 1, 2, 3, 6 };
+    unsigned bsid, fscod, numblkscod;
+
+    bsid = h[5] >> 3;
+
+    if (h[0] != 0x0B || h[1] != 0x77 || bsid <= 10 || bsid > 16)
+        return -1;
+
+    fscod = h[4] >> 6;
+    numblkscod = fscod == 3 ? 3 : (h[4] >> 4) & 3;
+
+    info->length = ((((size_t) h[2] & 7) << 8) | h[3]) * 2 + 2;
+    info->type = TYPE_EAC3;
+    info->burst_size = EAC3_BURST_SIZE;
+
+    /* A burst carries six blocks of 256 samples of each independent
+     * substream. Dependent substreams travel with their independent
+     * one. */
+    info->weight = (h[2] >> 6) == 1 ? 0 : 1;
+    info->per_burst = 6 / blocks[numblkscod];
+
+    return 0;
+}
+
+static int parse_dts(const uint8_t *h, struct frame_info *info) {
+    unsigned samples;
+
+    /* Only the 16 bit big endian core stream */
+    if (h[0] != 0x7F || h[1] != 0xFE || h[2] != 0x80 || h[3] != 0x01)
+        return -1;
+
+    samples = ((((unsigned) h[4] & 1) << 6) | (h[5] >> 2)) * 32 + 32;
+
+    switch (samples) {
+        case 512:
+            info->type = TYPE_DTS_512;
+            break;
+        case 1024:
+            info->type = TYPE_DTS_1024;
+            break;
+        case 2048:
+            info->type = TYPE_DTS_2048;
+            break;
+        default:
+            return -1;
+    }
+
+    info->length = ((((size_t) h[5] & 3) << 12) | ((size_t) h[6] << 4) | (h[7] >> 4)) + 1;
+    info->burst_size = samples * FRAME_SIZE;
+    info->weight = info->per_burst = 1;
+
+    return 0;
+}
+
+static int parse_frame(pa_iec61937_packetizer *p, struct frame_info *info) {
+    int r;
+
+    switch (p->encoding) {
+        case PA_ENCODING_AC3:
+            r = parse_ac3(p->header, info);
+            break;
+        case PA_ENCODING_EAC3:
+            r = parse_eac3(p->header, info);
+            break;
+        case PA_ENCODING_DTS:
+            r = parse_dts(p->header, info);
+            break;
+        default:
+            pa_assert_not_reached();
+    }
+
+    if (r < 0 || info->length < FRAME_HEADER_SIZE)
+        return -1;
+
+    return 0;
+}
+
+pa_iec61937_packetizer* pa_iec61937_packetizer_new(pa_mempool *pool, pa_silence_cache *cache, pa_encoding_t raw) {
+    pa_iec61937_packetizer *p;
+
+    pa_assert(pool);
+    pa_assert(cache);
+    pa_assert(pa_iec61937_encoding(raw) != PA_ENCODING_INVALID);
+
+    p = pa_xnew0(pa_iec61937_packetizer, 1);
+    p->pool = pool;
+    p->cache = cache;
+    p->encoding = raw;
+
+    return p;
+}
+
+void pa_iec61937_packetizer_free(pa_iec61937_packetizer *p) {
+    pa_assert(p);
+
+    if (p->burst)
+        pa_memblock_unref(p->burst);
+
+    pa_xfree(p);
+}
+
+/* Copies the payload into the burst, swapping the bytes of each word */
+static void burst_append(pa_iec61937_packetizer *p, const uint8_t *data, size_t length) {
+    uint8_t *d;
+    size_t i, offset;
+
+    d = pa_memblock_acquire(p->burst);
+    offset = PREAMBLE_SIZE + p->length;
+
+    for (i = 0; i < length; i++)
+        d[(offset + i) ^ 1] = data[i];
+
+    pa_memblock_release(p->burst);
+    p->length += length;
+}
+
+static void put_word(uint8_t *d, uint16_t w) {
+    d[0] = (uint8_t) w;
+    d[1] = (uint8_t) (w >> 8);
+}
+
+static void burst_flush(pa_iec61937_packetizer *p, pa_iec61937_burst_cb_t cb, void *userdata) {
+    pa_memchunk chunk;
+    uint8_t *d;
+    size_t length, padding;
+
+    pa_assert(p->burst);
+
+    length = PA_ROUND_UP(PREAMBLE_SIZE + p->length, FRAME_SIZE);
+    pa_assert(length <= p->info.burst_size);
+
+    d = pa_memblock_acquire(p->burst);
+
+    put_word(d, SYNC_WORD_A);
+    put_word(d + 2, SYNC_WORD_B);
+    put_word(d + 4, p->info.type);
+
+    /* E-AC3 counts bytes, all others bits */
+    put_word(d + 6, (uint16_t) (p->info.type == TYPE_EAC3 ? p->length : PA_ROUND_UP(p->length, 2) * 8));
+
+    /* An odd last byte takes the upper half of its word */
+    if (p->length & 1)
+        d[(PREAMBLE_SIZE + p->length) ^ 1] = 0;
+
+    memset(d + PA_ROUND_UP(PREAMBLE_SIZE + p->length, 2), 0, length - PA_ROUND_UP(PREAMBLE_SIZE + p->length, 2));
+
+    pa_memblock_release(p->burst);
+
+    chunk.memblock = p->burst;
+    chunk.index = 0;
+    chunk.length = length;
+    cb(p, &chunk, userdata);
+
+    pa_memblock_unref(p->burst);
+    p->burst = NULL;
+
+    for (padding = p->info.burst_size - length; padding > 0; padding -= chunk.length) {
+        pa_silence_memchunk_get(p->cache, p->pool, &chunk, &burst_sample_spec, padding);
+        cb(p, &chunk, userdata);
+        pa_memblock_unref(chunk.memblock);
+    }
+}
+
+static void frame_end(pa_iec61937_packetizer *p, pa_iec61937_burst_cb_t cb, void *userdata) {
+    if (p->frames >= p->info.per_burst)
+        burst_flush(p, cb, userdata);
+}
+
+/* The header of the next frame is complete. Returns 1 if it starts a
+ * frame, 0 if it doesn't and negative if the frame can't be sent. */
+static int frame_begin(pa_iec61937_packetizer *p, pa_iec61937_burst_cb_t cb, void *userdata) {
+    struct frame_info info;
+
+    if (parse_frame(p, &info) < 0)
+        return 0;
+
+    if (p->skipped > 0) {
+        pa_log_debug("Skipped %lu bytes before the next frame.", (unsigned long) p->skipped);
+        p->skipped = 0;
+    }
+
+    /* The stream changed its parameters within a burst */
+    if (p->burst && (info.type != p->info.type || info.per_burst != p->info.per_burst ||
+                     PREAMBLE_SIZE + p->length + info.length > p->info.burst_size))
+        burst_flush(p, cb, userdata);
+
+    if (PREAMBLE_SIZE + info.length > info.burst_size) {
+        pa_log_warn("Frame of %lu bytes doesn't fit into a burst.", (unsigned long) info.length);
+        return -1;
+    }
+
+    if (!p->burst) {
+        p->burst = pa_memblock_new(p->pool, info.burst_size);
+        p->length = 0;
+        p->frames = 0;
+        p->info = info;
+    }
+
+    p->frames += info.weight;
+
+    burst_append(p, p->header, FRAME_HEADER_SIZE);
+    p->header_length = 0;
+    p->frame_missing = info.length - FRAME_HEADER_SIZE;
+
+    if (p->frame_missing <= 0)
+        frame_end(p, cb, userdata);
+
+    return 1;
+}
+
+int pa_iec61937_packetizer_push(pa_iec61937_packetizer *p, const pa_memchunk *in, pa_iec61937_burst_cb_t cb, void *userdata) {
+    const uint8_t *data, *d;
+    size_t length;
+    int ret = 0;
+
+    pa_assert(p);
+    pa_assert(in);
+    pa_assert(in->memblock);
+    pa_assert(cb);
+
+    data = pa_memblock_acquire(in->memblock);
+    d = data + in->index;
+    length = in->length;
+
+    while (length > 0) {
+        size_t n;
+
+        if (p->frame_missing > 0) {
+            n = PA_MIN(p->frame_missing, length);
+            burst_append(p, d, n);
+
+            d += n;
+            length -= n;
+
+            if ((p->frame_missing -= n) <= 0)
+                frame_end(p, cb, userdata);
+
+            continue;
+        }
+
+        n = PA_MIN(FRAME_HEADER_SIZE - p->header_length, length);
+        memcpy(p->header + p->header_length, d, n);
+        p->header_length += n;
+
+        d += n;
+        length -= n;
+
+        while (p->header_length >= FRAME_HEADER_SIZE) {
+            int r;
+
+            if ((r = frame_begin(p, cb, userdata)) < 0) {
+                ret = -1;
+                goto finish;
+            }
+
+            if (r > 0)
+                break;
+
+            /* Not a frame, look for one a byte further */
+            memmove(p->header, p->header + 1, --p->header_length);
+            p->skipped++;
+        }
+    }
+
+finish:
+    pa_memblock_release(in->memblock);
+
+    return ret;
+}
@@ -0,0 +1,52 @@
+#ifndef fooiec61937hfoo
+#define fooiec61937hfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulse/format.h>
+
+#include <pulsecore/memblock.h>
+#include <pulsecore/memchunk.h>
+#include <pulsecore/sample-util.h>
+
+/* Wraps raw AC3, E-AC3 and DTS frames into IEC 61937 bursts, as a
+ * passthrough sink plays them. A burst lasts as long as the audio in
+ * it. It is passed on as a block with the burst preamble and the
+ * frames in little endian 16 bit words, followed by references to the
+ * shared silence block for the padding. */
+
+typedef struct pa_iec61937_packetizer pa_iec61937_packetizer;
+
+/* The IEC 61937 encoding for a raw one, PA_ENCODING_INVALID if there
+ * is none */
+pa_encoding_t pa_iec61937_encoding(pa_encoding_t raw);
+
+typedef void (*pa_iec61937_burst_cb_t)(pa_iec61937_packetizer *p, const pa_memchunk *chunk, void *userdata);
+
+pa_iec61937_packetizer* pa_iec61937_packetizer_new(pa_mempool *pool, pa_silence_cache *cache, pa_encoding_t raw);
+void pa_iec61937_packetizer_free(pa_iec61937_packetizer *p);
+
+/* Takes frames in arbitrary pieces and passes each complete burst to
+ * the callback, in several chunks. Anything between the frames is
+ * skipped. Returns a negative value for frames that don't fit into a
+ * burst. */
+int pa_iec61937_packetizer_push(pa_iec61937_packetizer *p, const pa_memchunk *in, pa_iec61937_burst_cb_t cb, void *userdata);
+
+#endif
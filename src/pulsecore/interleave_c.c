@@ -0,0 +1,64 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/macro.h>
+
+#include "sample-util.h"
+
+static void pa_deinterleave_float_c(float *dst[], unsigned n_dst, const float *src, unsigned stride, unsigned n) {
+    unsigned c;
+
+    for (c = 0; c < n_dst; c++)
+        pa_sample_clamp(PA_SAMPLE_FLOAT32NE, dst[c], sizeof(float), src + c, stride * sizeof(float), n);
+}
+
+static void pa_interleave_float_c(float *dst, unsigned stride, float *const src[], unsigned n_src, unsigned n) {
+    unsigned c;
+
+    for (c = 0; c < n_src; c++)
+        pa_sample_clamp(PA_SAMPLE_FLOAT32NE, dst + c, stride * sizeof(float), src[c], sizeof(float), n);
+}
+
+static pa_deinterleave_float_func_t deinterleave_float_func = pa_deinterleave_float_c;
+static pa_interleave_float_func_t interleave_float_func = pa_interleave_float_c;
+
+pa_deinterleave_float_func_t pa_get_deinterleave_float_func(void) {
+    return deinterleave_float_func;
+}
+
+void pa_set_deinterleave_float_func(pa_deinterleave_float_func_t func) {
+    pa_assert(func);
+
+    deinterleave_float_func = func;
+}
+
+pa_interleave_float_func_t pa_get_interleave_float_func(void) {
+    return interleave_float_func;
+}
+
+void pa_set_interleave_float_func(pa_interleave_float_func_t func) {
+    pa_assert(func);
+
+    interleave_float_func = func;
+}
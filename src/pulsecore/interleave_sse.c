@@ -0,0 +1,138 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "cpu-x86.h"
+
+#include "sample-util.h"
+
+#if defined (PA_HAVE_X86_TARGET_ATTRIBUTE)
+
+#include <xmmintrin.h>
+
+/* Only mono and stereo frames, done four at a time, get their own code.
+ * Everything else, and the frames left over, are done one by one. */
+
+static void deinterleave_tail(float *dst[], unsigned n_dst, const float *src, unsigned stride, unsigned n) {
+    unsigned c;
+
+    for (c = 0; c < n_dst; c++)
+        pa_sample_clamp(PA_SAMPLE_FLOAT32NE, dst[c], sizeof(float), src + c, stride * sizeof(float), n);
+}
+
+static void interleave_tail(float *dst, unsigned stride, float *const src[], unsigned n_src, unsigned n) {
+    unsigned c;
+
+    for (c = 0; c < n_src; c++)
+        pa_sample_clamp(PA_SAMPLE_FLOAT32NE, dst + c, stride * sizeof(float), src[c], sizeof(float), n);
+}
+
+PA_X86_TARGET("sse")
+static inline __m128 clamp_sse(__m128 x) {
+    return _mm_max_ps(_mm_min_ps(x, _mm_set1_ps(1.0f)), _mm_set1_ps(-1.0f));
+}
+
+PA_X86_TARGET("sse")
+static void pa_deinterleave_float_sse(float *dst[], unsigned n_dst, const float *src, unsigned stride, unsigned n) {
+    float *d0 = dst[0], *d1 = n_dst > 1 ? dst[1] : NULL;
+    unsigned i = 0;
+
+    if (stride == 1 && n_dst == 1) {
+        for (; i + 4 <= n; i += 4)
+            _mm_storeu_ps(d0 + i, clamp_sse(_mm_loadu_ps(src + i)));
+
+    } else if (stride == 2 && n_dst <= 2) {
+        for (; i + 4 <= n; i += 4) {
+            __m128 a = _mm_loadu_ps(src + 2 * i), b = _mm_loadu_ps(src + 2 * i + 4);
+
+            _mm_storeu_ps(d0 + i, clamp_sse(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))));
+            if (d1)
+                _mm_storeu_ps(d1 + i, clamp_sse(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))));
+        }
+
+    } else {
+        deinterleave_tail(dst, n_dst, src, stride, n);
+        return;
+    }
+
+    if (i < n) {
+        float *tail[2] = { d0 + i, d1 ? d1 + i : NULL };
+
+        deinterleave_tail(tail, n_dst, src + i * stride, stride, n - i);
+    }
+}
+
+PA_X86_TARGET("sse")
+static void pa_interleave_float_sse(float *dst, unsigned stride, float *const src[], unsigned n_src, unsigned n) {
+    const float *s0 = src[0], *s1 = n_src > 1 ? src[1] : NULL;
+    unsigned i = 0;
+
+    if (stride == 1 && n_src == 1) {
+        for (; i + 4 <= n; i += 4)
+            _mm_storeu_ps(dst + i, clamp_sse(_mm_loadu_ps(s0 + i)));
+
+    } else if (stride == 2 && n_src == 2) {
+        for (; i + 4 <= n; i += 4) {
+            __m128 l = clamp_sse(_mm_loadu_ps(s0 + i)), r = clamp_sse(_mm_loadu_ps(s1 + i));
+
+            _mm_storeu_ps(dst + 2 * i, _mm_unpacklo_ps(l, r));
+            _mm_storeu_ps(dst + 2 * i + 4, _mm_unpackhi_ps(l, r));
+        }
+
+    } else if (stride == 2 && n_src == 1) {
+        /* Every other sample belongs to someone else and has to stay */
+        for (; i + 4 <= n; i += 4) {
+            __m128 l = clamp_sse(_mm_loadu_ps(s0 + i));
+            __m128 a = _mm_loadu_ps(dst + 2 * i), b = _mm_loadu_ps(dst + 2 * i + 4);
+
+            _mm_storeu_ps(dst + 2 * i, _mm_unpacklo_ps(l, _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 1, 3, 1))));
+            _mm_storeu_ps(dst + 2 * i + 4, _mm_unpackhi_ps(l, _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 1, 3, 1))));
+        }
+
+    } else {
+        interleave_tail(dst, stride, src, n_src, n);
+        return;
+    }
+
+    if (i < n) {
+        float *tail[2] = { (float*) s0 + i, s1 ? (float*) s1 + i : NULL };
+
+        interleave_tail(dst + i * stride, stride, tail, n_src, n - i);
+    }
+}
+#endif /* defined (PA_HAVE_X86_TARGET_ATTRIBUTE) */
+
+void pa_interleave_func_init_sse(pa_cpu_x86_flag_t flags) {
+#if defined (PA_HAVE_X86_TARGET_ATTRIBUTE)
+
+    if (flags & PA_CPU_X86_SSE) {
+        pa_log_info("Initialising SSE optimized float interleaving.");
+
+        pa_set_deinterleave_float_func(pa_deinterleave_float_sse);
+        pa_set_interleave_float_func(pa_interleave_float_sse);
+    }
+#endif /* defined (PA_HAVE_X86_TARGET_ATTRIBUTE) */
+}
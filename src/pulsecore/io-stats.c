@@ -0,0 +1,54 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/macro.h>
+
+#include "io-stats.h"
+
+void pa_io_stats_init(pa_io_stats *s) {
+    pa_assert(s);
+
+    pa_io_stats_reset(s);
+    pa_atomic_store(&s->watermark_usec, 0);
+    pa_atomic_store(&s->history_bytes, 0);
+}
+
+void pa_io_stats_add_rewind(pa_io_stats *s, size_t nbytes) {
+    pa_assert(s);
+
+    pa_atomic_inc(&s->rewinds);
+    pa_atomic_add(&s->rewind_bytes, (int) nbytes);
+}
+
+void pa_io_stats_reset(pa_io_stats *s) {
+    pa_assert(s);
+
+    pa_atomic_store(&s->busy_usec, 0);
+    pa_atomic_store(&s->resample_usec, 0);
+    pa_atomic_store(&s->cpu_usec, 0);
+    pa_atomic_store(&s->rewinds, 0);
+    pa_atomic_store(&s->rewind_bytes, 0);
+    pa_atomic_store(&s->rerender_bytes, 0);
+    pa_atomic_store(&s->underruns, 0);
+    pa_atomic_store(&s->overruns, 0);
+}
@@ -0,0 +1,71 @@
+#ifndef foopulsecoreiostatshfoo
+#define foopulsecoreiostatshfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#include <pulsecore/atomic.h>
+
+/* What an IO thread spent on a device or stream. Only the IO thread
+ * adds to these, and as they are atomic, the main thread may read them
+ * at any time. The counters wrap around at 2^32, so whoever reads them
+ * should look at the difference between two reads. */
+
+typedef struct pa_io_stats {
+    /* Time spent rendering, posting, or in pop() resp. push() */
+    pa_atomic_t busy_usec;
+
+    /* Time spent resampling */
+    pa_atomic_t resample_usec;
+
+    /* Of the streams that feed filter devices, the CPU time the IO
+     * thread spent in pop() resp. push(), which is what the filter
+     * costs */
+    pa_atomic_t cpu_usec;
+
+    pa_atomic_t rewinds;
+    pa_atomic_t rewind_bytes;
+
+    /* Of sink inputs, the part of rewind_bytes that was rendered again
+     * because it was older than the history kept */
+    pa_atomic_t rerender_bytes;
+
+    pa_atomic_t underruns;
+    pa_atomic_t overruns;
+
+    /* Not a counter, but the current wakeup watermark of a timer
+     * scheduled device, or 0 */
+    pa_atomic_t watermark_usec;
+
+    /* Not a counter either, but how much rendered data a sink input
+     * keeps for rewinds, in the sample spec of the sink */
+    pa_atomic_t history_bytes;
+} pa_io_stats;
+
+void pa_io_stats_init(pa_io_stats *s);
+
+void pa_io_stats_add_rewind(pa_io_stats *s, size_t nbytes);
+
+/* Zeroes the counters, but leaves the watermark and history alone */
+void pa_io_stats_reset(pa_io_stats *s);
+
+#endif
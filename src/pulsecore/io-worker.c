@@ -0,0 +1,377 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/mainloop.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/asyncmsgq.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/msgobject.h>
+#include <pulsecore/thread.h>
+
+#include "io-worker.h"
+
+typedef struct call_dispatcher {
+    pa_msgobject parent;
+    pa_io_worker_pool *pool;
+} call_dispatcher;
+
+PA_DEFINE_PRIVATE_CLASS(call_dispatcher, pa_msgobject);
+
+enum {
+    CALL_DISPATCHER_MESSAGE_CALL
+};
+
+struct call {
+    pa_io_worker_cb_t cb;
+    pa_free_cb_t free_cb;
+    void *userdata;
+};
+
+struct pa_io_worker {
+    pa_io_worker_pool *pool;
+    unsigned n_users;
+
+    pa_thread *thread;
+    pa_mainloop *mainloop;
+
+    /* inq carries calls to the worker, outq calls to the main loop */
+    pa_asyncmsgq *inq, *outq;
+
+    /* These live in the worker's own loop... */
+    pa_io_event *inq_read_event, *outq_write_event;
+
+    /* ...and these in the main loop */
+    pa_io_event *outq_read_event, *inq_write_event;
+};
+
+struct pa_io_worker_pool {
+    pa_mainloop_api *mainloop;
+    call_dispatcher *dispatcher;
+
+    pa_io_worker *workers;
+    unsigned n_workers;
+};
+
+PA_STATIC_TLS_DECLARE_NO_FREE(current_worker);
+
+static int dispatcher_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offset, pa_memchunk *chunk) {
+    struct call *c = userdata;
+
+    pa_assert(code == CALL_DISPATCHER_MESSAGE_CALL);
+    pa_assert(c);
+
+    c->cb(c->userdata);
+    return 0;
+}
+
+static void call_free(void *userdata) {
+    struct call *c = userdata;
+
+    if (c->free_cb)
+        c->free_cb(c->userdata);
+}
+
+static void read_cb(pa_mainloop_api *api, pa_io_event *e, int fd, pa_io_event_flags_t events, void *userdata) {
+    pa_asyncmsgq *q = userdata;
+
+    pa_assert(pa_asyncmsgq_read_fd(q) == fd);
+
+    pa_asyncmsgq_ref(q);
+    pa_asyncmsgq_read_after_poll(q);
+
+    for (;;) {
+        pa_msgobject *object;
+        int code;
+        void *data;
+        int64_t offset;
+        pa_memchunk chunk;
+
+        while (pa_asyncmsgq_get(q, &object, &code, &data, &offset, &chunk, 0) >= 0) {
+            int ret;
+
+            ret = pa_asyncmsgq_dispatch(object, code, data, offset, &chunk);
+            pa_asyncmsgq_done(q, ret);
+        }
+
+        if (pa_asyncmsgq_read_before_poll(q) == 0)
+            break;
+    }
+
+    pa_asyncmsgq_unref(q);
+}
+
+static void write_cb(pa_mainloop_api *api, pa_io_event *e, int fd, pa_io_event_flags_t events, void *userdata) {
+    pa_asyncmsgq *q = userdata;
+
+    pa_assert(pa_asyncmsgq_write_fd(q) == fd);
+
+    /* Flushes what was queued locally because the queue was full */
+    pa_asyncmsgq_write_after_poll(q);
+    pa_asyncmsgq_write_before_poll(q);
+}
+
+static void outq_write_cb(pa_mainloop_api *api, pa_io_event *e, int fd, pa_io_event_flags_t events, void *userdata) {
+    /* Only there to wake up the loop, see thread_func() */
+}
+
+static void quit_cb(void *userdata) {
+    pa_io_worker *w = userdata;
+
+    pa_mainloop_quit(w->mainloop, 0);
+}
+
+static void thread_func(void *userdata) {
+    pa_io_worker *w = userdata;
+
+    PA_STATIC_TLS_SET(current_worker, w);
+
+    /* Like the IO threads of the devices, must not block on logging */
+    pa_log_set_thread_async(TRUE);
+
+    /* A worker posts far more to the main loop than the other way
+     * round. Like the rtpoll item of a thread_mq, arm the outq before
+     * every poll, so that what had to be queued locally because it
+     * was full is always flushed eventually. */
+    for (;;) {
+        int r;
+
+        pa_asyncmsgq_write_before_poll(w->outq);
+        r = pa_mainloop_iterate(w->mainloop, 1, NULL);
+        pa_asyncmsgq_write_after_poll(w->outq);
+
+        if (r == -2)
+            break;
+
+        if (r < 0) {
+            pa_log_error("Main loop of IO worker failed.");
+            break;
+        }
+    }
+}
+
+static int worker_init(pa_io_worker_pool *p, pa_io_worker *w, unsigned i) {
+    pa_mainloop_api *api;
+    char name[16];
+
+    w->pool = p;
+    w->n_users = 0;
+
+    if (!(w->mainloop = pa_mainloop_new()))
+        return -1;
+
+    api = pa_mainloop_get_api(w->mainloop);
+
+    pa_assert_se(w->inq = pa_asyncmsgq_new(0));
+    pa_assert_se(w->outq = pa_asyncmsgq_new(0));
+
+    pa_assert_se(pa_asyncmsgq_read_before_poll(w->inq) == 0);
+    pa_assert_se(w->inq_read_event = api->io_new(api, pa_asyncmsgq_read_fd(w->inq), PA_IO_EVENT_INPUT, read_cb, w->inq));
+    pa_assert_se(w->outq_write_event = api->io_new(api, pa_asyncmsgq_write_fd(w->outq), PA_IO_EVENT_INPUT, outq_write_cb, NULL));
+
+    pa_assert_se(pa_asyncmsgq_read_before_poll(w->outq) == 0);
+    pa_assert_se(w->outq_read_event = p->mainloop->io_new(p->mainloop, pa_asyncmsgq_read_fd(w->outq), PA_IO_EVENT_INPUT, read_cb, w->outq));
+    pa_asyncmsgq_write_before_poll(w->inq);
+    pa_assert_se(w->inq_write_event = p->mainloop->io_new(p->mainloop, pa_asyncmsgq_write_fd(w->inq), PA_IO_EVENT_INPUT, write_cb, w->inq));
+
+    pa_snprintf(name, sizeof(name), "io-worker-%u", i);
+
+    if (!(w->thread = pa_thread_new(name, thread_func, w))) {
+        pa_log_error("Failed to create IO worker thread.");
+        return -1;
+    }
+
+    return 0;
+}
+
+static void worker_done(pa_io_worker *w) {
+    pa_mainloop_api *api;
+
+    if (!w->mainloop)
+        return;
+
+    if (w->thread) {
+        pa_io_worker_call(w, quit_cb, NULL, w);
+        pa_thread_free(w->thread);
+    }
+
+    /* The thread is gone, so its loop can be torn down from here */
+    api = pa_mainloop_get_api(w->mainloop);
+
+    if (w->inq) {
+        pa_asyncmsgq_flush(w->inq, FALSE);
+
+        api->io_free(w->inq_read_event);
+        api->io_free(w->outq_write_event);
+        w->pool->mainloop->io_free(w->outq_read_event);
+        w->pool->mainloop->io_free(w->inq_write_event);
+
+        pa_asyncmsgq_flush(w->outq, FALSE);
+
+        pa_asyncmsgq_unref(w->inq);
+        pa_asyncmsgq_unref(w->outq);
+    }
+
+    pa_mainloop_free(w->mainloop);
+}
+
+pa_io_worker_pool* pa_io_worker_pool_new(pa_mainloop_api *m, unsigned n_workers) {
+    pa_io_worker_pool *p;
+    unsigned i;
+
+    pa_assert(m);
+    pa_assert(n_workers > 0);
+
+    p = pa_xnew0(pa_io_worker_pool, 1);
+    p->mainloop = m;
+
+    p->dispatcher = pa_msgobject_new(call_dispatcher);
+    p->dispatcher->parent.process_msg = dispatcher_process_msg;
+    p->dispatcher->pool = p;
+
+    p->workers = pa_xnew0(pa_io_worker, n_workers);
+
+    for (i = 0; i < n_workers; i++) {
+        p->n_workers++;
+
+        if (worker_init(p, &p->workers[i], i) < 0) {
+            pa_io_worker_pool_free(p);
+            return NULL;
+        }
+    }
+
+    pa_log_debug("Started %u IO worker threads.", n_workers);
+
+    return p;
+}
+
+void pa_io_worker_pool_free(pa_io_worker_pool *p) {
+    unsigned i;
+
+    pa_assert(p);
+
+    for (i = 0; i < p->n_workers; i++) {
+        pa_assert(p->workers[i].n_users == 0);
+        worker_done(&p->workers[i]);
+    }
+
+    pa_xfree(p->workers);
+    pa_msgobject_unref(PA_MSGOBJECT(p->dispatcher));
+    pa_xfree(p);
+}
+
+unsigned pa_io_worker_pool_size(pa_io_worker_pool *p) {
+    pa_assert(p);
+
+    return p->n_workers;
+}
+
+pa_io_worker* pa_io_worker_pool_acquire(pa_io_worker_pool *p) {
+    pa_io_worker *w;
+    unsigned i;
+
+    pa_assert(p);
+
+    w = &p->workers[0];
+
+    for (i = 1; i < p->n_workers; i++)
+        if (p->workers[i].n_users < w->n_users)
+            w = &p->workers[i];
+
+    w->n_users++;
+
+    return w;
+}
+
+void pa_io_worker_release(pa_io_worker *w) {
+    pa_assert(w);
+    pa_assert(w->n_users > 0);
+
+    w->n_users--;
+}
+
+pa_mainloop_api* pa_io_worker_get_api(pa_io_worker *w) {
+    pa_assert(w);
+    pa_assert(pa_io_worker_in_thread(w));
+
+    return pa_mainloop_get_api(w->mainloop);
+}
+
+static void post(pa_io_worker *w, pa_asyncmsgq *q, pa_io_worker_cb_t cb, pa_free_cb_t free_cb, void *userdata) {
+    struct call c;
+
+    pa_assert(w);
+    pa_assert(cb);
+
+    c.cb = cb;
+    c.free_cb = free_cb;
+    c.userdata = userdata;
+
+    /* The message carries a copy of c */
+    pa_asyncmsgq_post_data(q, PA_MSGOBJECT(w->pool->dispatcher), CALL_DISPATCHER_MESSAGE_CALL, &c, sizeof(c), 0, NULL, call_free);
+}
+
+void pa_io_worker_call(pa_io_worker *w, pa_io_worker_cb_t cb, pa_free_cb_t free_cb, void *userdata) {
+    post(w, w->inq, cb, free_cb, userdata);
+}
+
+void pa_io_worker_call_main(pa_io_worker *w, pa_io_worker_cb_t cb, pa_free_cb_t free_cb, void *userdata) {
+    post(w, w->outq, cb, free_cb, userdata);
+}
+
+pa_bool_t pa_io_worker_in_thread(pa_io_worker *w) {
+    pa_assert(w);
+
+    return PA_STATIC_TLS_GET(current_worker) == w;
+}
+
+static pa_mainloop_api* ops_get_api(void *thread) {
+    return pa_io_worker_get_api(thread);
+}
+
+static pa_bool_t ops_in_thread(void *thread) {
+    return pa_io_worker_in_thread(thread);
+}
+
+static void ops_call(void *thread, pa_free_cb_t cb, pa_free_cb_t free_cb, void *userdata) {
+    pa_io_worker_call(thread, cb, free_cb, userdata);
+}
+
+static void ops_call_main(void *thread, pa_free_cb_t cb, pa_free_cb_t free_cb, void *userdata) {
+    pa_io_worker_call_main(thread, cb, free_cb, userdata);
+}
+
+static const pa_pstream_thread_ops pstream_ops = {
+    .get_api = ops_get_api,
+    .in_thread = ops_in_thread,
+    .call = ops_call,
+    .call_main = ops_call_main
+};
+
+pa_pstream* pa_io_worker_pstream_new(pa_io_worker *w, pa_mainloop_api *m, pa_iochannel *io, pa_mempool *pool) {
+    pa_assert(w);
+
+    return pa_pstream_new_threaded(m, io, pool, &pstream_ops, w);
+}
@@ -0,0 +1,65 @@
+#ifndef foopulsecoreioworkerhfoo
+#define foopulsecoreioworkerhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulse/mainloop-api.h>
+#include <pulse/def.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/pstream.h>
+
+/* A pool of threads that each run a main loop of their own, for
+ * socket IO that would otherwise all happen on the main loop of the
+ * daemon. Work is handed between the main loop and a worker as
+ * function calls, which are run in the order they were queued. */
+
+typedef struct pa_io_worker pa_io_worker;
+typedef struct pa_io_worker_pool pa_io_worker_pool;
+
+typedef void (*pa_io_worker_cb_t)(void *userdata);
+
+pa_io_worker_pool* pa_io_worker_pool_new(pa_mainloop_api *m, unsigned n_workers);
+
+/* Everything queued for the main loop is dropped, after calling the
+ * free callbacks */
+void pa_io_worker_pool_free(pa_io_worker_pool *p);
+
+unsigned pa_io_worker_pool_size(pa_io_worker_pool *p);
+
+/* Picks the worker with the fewest users and adds one to it */
+pa_io_worker* pa_io_worker_pool_acquire(pa_io_worker_pool *p);
+void pa_io_worker_release(pa_io_worker *w);
+
+/* May only be used from the worker thread itself */
+pa_mainloop_api* pa_io_worker_get_api(pa_io_worker *w);
+
+/* Queue cb to be run in the worker thread, or in the main loop. These
+ * may be called from any thread. free_cb, if not NULL, is called
+ * with userdata afterwards, or instead if the call is dropped. */
+void pa_io_worker_call(pa_io_worker *w, pa_io_worker_cb_t cb, pa_free_cb_t free_cb, void *userdata);
+void pa_io_worker_call_main(pa_io_worker *w, pa_io_worker_cb_t cb, pa_free_cb_t free_cb, void *userdata);
+
+/* TRUE if called from the thread of w */
+pa_bool_t pa_io_worker_in_thread(pa_io_worker *w);
+
+/* A pstream whose socket is serviced by w, see pa_pstream_new_threaded() */
+pa_pstream* pa_io_worker_pstream_new(pa_io_worker *w, pa_mainloop_api *m, pa_iochannel *io, pa_mempool *pool);
+
+#endif
@@ -231,6 +231,48 @@ ssize_t pa_iochannel_write(pa_iochannel*io, const void*data, size_t l) {
     return r;
 }
 
+ssize_t pa_iochannel_writev(pa_iochannel*io, const struct iovec *iov, unsigned n) {
+    ssize_t r;
+
+    pa_assert(io);
+    pa_assert(iov);
+    pa_assert(n > 0);
+    pa_assert(io->ofd >= 0);
+
+#ifdef HAVE_SYS_UIO_H
+    for (;;) {
+        if (io->ofd_type == 0) {
+            struct msghdr mh;
+
+            pa_zero(mh);
+            mh.msg_iov = (struct iovec*) iov;
+            mh.msg_iovlen = n;
+
+            if ((r = sendmsg(io->ofd, &mh, MSG_NOSIGNAL)) < 0 && errno == ENOTSOCK) {
+                io->ofd_type = 1;
+                continue;
+            }
+        } else
+            r = writev(io->ofd, iov, (int) n);
+
+        if (r < 0 && errno == EINTR)
+            continue;
+
+        break;
+    }
+#else
+    /* No gathering available, just write the first buffer */
+    r = pa_write(io->ofd, iov[0].iov_base, iov[0].iov_len, &io->ofd_type);
+#endif
+
+    if (r >= 0) {
+        io->writable = io->hungup = FALSE;
+        enable_events(io);
+    }
+
+    return r;
+}
+
 ssize_t pa_iochannel_read(pa_iochannel*io, void*data, size_t l) {
     ssize_t r;
 
@@ -250,6 +292,34 @@ ssize_t pa_iochannel_read(pa_iochannel*io, void*data, size_t l) {
     return r;
 }
 
+ssize_t pa_iochannel_readv(pa_iochannel*io, const struct iovec *iov, unsigned n) {
+    ssize_t r;
+
+    pa_assert(io);
+    pa_assert(iov);
+    pa_assert(n > 0);
+    pa_assert(io->ifd >= 0);
+
+#ifdef HAVE_SYS_UIO_H
+    for (;;) {
+        if ((r = readv(io->ifd, iov, (int) n)) < 0 && errno == EINTR)
+            continue;
+
+        break;
+    }
+#else
+    /* No scattering available, just fill the first buffer */
+    r = pa_read(io->ifd, iov[0].iov_base, iov[0].iov_len, &io->ifd_type);
+#endif
+
+    if (r >= 0) {
+        io->readable = io->hungup = FALSE;
+        enable_events(io);
+    }
+
+    return r;
+}
+
 #ifdef HAVE_CREDS
 
 pa_bool_t pa_iochannel_creds_supported(pa_iochannel *io) {
@@ -289,9 +359,21 @@ int pa_iochannel_creds_enable(pa_iochannel *io) {
 }
 
 ssize_t pa_iochannel_write_with_creds(pa_iochannel*io, const void*data, size_t l, const pa_creds *ucred) {
+    struct iovec iov;
+
+    pa_assert(data);
+    pa_assert(l);
+
+    pa_zero(iov);
+    iov.iov_base = (void*) data;
+    iov.iov_len = l;
+
+    return pa_iochannel_writev_with_creds(io, &iov, 1, ucred);
+}
+
+ssize_t pa_iochannel_writev_with_creds(pa_iochannel*io, const struct iovec *iov, unsigned n, const pa_creds *ucred) {
     ssize_t r;
     struct msghdr mh;
-    struct iovec iov;
     union {
         struct cmsghdr hdr;
         uint8_t data[CMSG_SPACE(sizeof(struct ucred))];
@@ -299,14 +381,10 @@ ssize_t pa_iochannel_write_with_creds(pa_iochannel*io, const void*data, size_t l
     struct ucred *u;
 
     pa_assert(io);
-    pa_assert(data);
-    pa_assert(l);
+    pa_assert(iov);
+    pa_assert(n > 0);
     pa_assert(io->ofd >= 0);
 
-    pa_zero(iov);
-    iov.iov_base = (void*) data;
-    iov.iov_len = l;
-
     pa_zero(cmsg);
     cmsg.hdr.cmsg_len = CMSG_LEN(sizeof(struct ucred));
     cmsg.hdr.cmsg_level = SOL_SOCKET;
@@ -324,8 +402,8 @@ ssize_t pa_iochannel_write_with_creds(pa_iochannel*io, const void*data, size_t l
     }
 
     pa_zero(mh);
-    mh.msg_iov = &iov;
-    mh.msg_iovlen = 1;
+    mh.msg_iov = (struct iovec*) iov;
+    mh.msg_iovlen = n;
     mh.msg_control = &cmsg;
     mh.msg_controllen = sizeof(cmsg);
 
@@ -337,13 +415,50 @@ ssize_t pa_iochannel_write_with_creds(pa_iochannel*io, const void*data, size_t l
     return r;
 }
 
-ssize_t pa_iochannel_read_with_creds(pa_iochannel*io, void*data, size_t l, pa_creds *creds, pa_bool_t *creds_valid) {
+ssize_t pa_iochannel_writev_with_fds(pa_iochannel*io, const struct iovec *iov, unsigned n, const int *fds, unsigned n_fds) {
+    ssize_t r;
+    struct msghdr mh;
+    union {
+        struct cmsghdr hdr;
+        uint8_t data[CMSG_SPACE(sizeof(int) * PA_IOCHANNEL_FDS_MAX)];
+    } cmsg;
+
+    pa_assert(io);
+    pa_assert(iov);
+    pa_assert(n > 0);
+    pa_assert(fds);
+    pa_assert(n_fds > 0);
+    pa_assert(n_fds <= PA_IOCHANNEL_FDS_MAX);
+    pa_assert(io->ofd >= 0);
+
+    pa_zero(cmsg);
+    cmsg.hdr.cmsg_len = CMSG_LEN(sizeof(int) * n_fds);
+    cmsg.hdr.cmsg_level = SOL_SOCKET;
+    cmsg.hdr.cmsg_type = SCM_RIGHTS;
+    memcpy(CMSG_DATA(&cmsg.hdr), fds, sizeof(int) * n_fds);
+
+    pa_zero(mh);
+    mh.msg_iov = (struct iovec*) iov;
+    mh.msg_iovlen = n;
+    mh.msg_control = &cmsg;
+    mh.msg_controllen = CMSG_SPACE(sizeof(int) * n_fds);
+
+    if ((r = sendmsg(io->ofd, &mh, MSG_NOSIGNAL)) >= 0) {
+        io->writable = io->hungup = FALSE;
+        enable_events(io);
+    }
+
+    return r;
+}
+
+ssize_t pa_iochannel_read_with_creds(pa_iochannel*io, void*data, size_t l, pa_creds *creds, pa_bool_t *creds_valid, int *fds, unsigned *n_fds) {
     ssize_t r;
     struct msghdr mh;
     struct iovec iov;
+    unsigned n_fds_max = 0;
     union {
         struct cmsghdr hdr;
-        uint8_t data[CMSG_SPACE(sizeof(struct ucred))];
+        uint8_t data[CMSG_SPACE(sizeof(struct ucred)) + CMSG_SPACE(sizeof(int) * PA_IOCHANNEL_FDS_MAX)];
     } cmsg;
 
     pa_assert(io);
@@ -353,6 +468,12 @@ ssize_t pa_iochannel_read_with_creds(pa_iochannel*io, void*data, size_t l, pa_cr
     pa_assert(creds);
     pa_assert(creds_valid);
 
+    if (fds) {
+        pa_assert(n_fds);
+        n_fds_max = *n_fds;
+        *n_fds = 0;
+    }
+
     pa_zero(iov);
     iov.iov_base = data;
     iov.iov_len = l;
@@ -364,7 +485,7 @@ ssize_t pa_iochannel_read_with_creds(pa_iochannel*io, void*data, size_t l, pa_cr
     mh.msg_control = &cmsg;
     mh.msg_controllen = sizeof(cmsg);
 
-    if ((r = recvmsg(io->ifd, &mh, 0)) >= 0) {
+    if ((r = recvmsg(io->ifd, &mh, MSG_CMSG_CLOEXEC)) >= 0) {
         struct cmsghdr *cmh;
 
         *creds_valid = FALSE;
@@ -379,7 +500,20 @@ ssize_t pa_iochannel_read_with_creds(pa_iochannel*io, void*data, size_t l, pa_cr
                 creds->gid = u.gid;
                 creds->uid = u.uid;
                 *creds_valid = TRUE;
-                break;
+
+            } else if (cmh->cmsg_level == SOL_SOCKET && cmh->cmsg_type == SCM_RIGHTS) {
+                unsigned k, n = (unsigned) ((cmh->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+                int fd;
+
+                /* Never leak fds we didn't ask for */
+                for (k = 0; k < n; k++) {
+                    memcpy(&fd, CMSG_DATA(cmh) + k * sizeof(int), sizeof(int));
+
+                    if (fds && *n_fds < n_fds_max)
+                        fds[(*n_fds)++] = fd;
+                    else
+                        pa_close(fd);
+                }
             }
         }
 
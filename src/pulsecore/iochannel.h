@@ -29,6 +29,15 @@
 
 #include <sys/types.h>
 
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#else
+struct iovec {
+    void *iov_base;
+    size_t iov_len;
+};
+#endif
+
 #include <pulse/mainloop-api.h>
 #include <pulsecore/creds.h>
 #include <pulsecore/macro.h>
@@ -51,12 +60,29 @@ void pa_iochannel_free(pa_iochannel*io);
 ssize_t pa_iochannel_write(pa_iochannel*io, const void*data, size_t l);
 ssize_t pa_iochannel_read(pa_iochannel*io, void*data, size_t l);
 
+/* Like pa_iochannel_write(), but gathers the data from n buffers in a
+ * single call. May write less than the sum of all lengths. */
+ssize_t pa_iochannel_writev(pa_iochannel*io, const struct iovec *iov, unsigned n);
+
+/* Like pa_iochannel_read(), but scatters the data over n buffers,
+ * filling them in order */
+ssize_t pa_iochannel_readv(pa_iochannel*io, const struct iovec *iov, unsigned n);
+
 #ifdef HAVE_CREDS
 pa_bool_t pa_iochannel_creds_supported(pa_iochannel *io);
 int pa_iochannel_creds_enable(pa_iochannel *io);
 
 ssize_t pa_iochannel_write_with_creds(pa_iochannel*io, const void*data, size_t l, const pa_creds *ucred);
-ssize_t pa_iochannel_read_with_creds(pa_iochannel*io, void*data, size_t l, pa_creds *ucred, pa_bool_t *creds_valid);
+ssize_t pa_iochannel_writev_with_creds(pa_iochannel*io, const struct iovec *iov, unsigned n, const pa_creds *ucred);
+
+/* Pass file descriptors along with the data, via SCM_RIGHTS */
+#define PA_IOCHANNEL_FDS_MAX 4
+ssize_t pa_iochannel_writev_with_fds(pa_iochannel*io, const struct iovec *iov, unsigned n, const int *fds, unsigned n_fds);
+
+/* If fds is not NULL, up to *n_fds received file descriptors are
+ * stored there and *n_fds is updated; the caller owns them then. Any
+ * fds beyond that are closed. */
+ssize_t pa_iochannel_read_with_creds(pa_iochannel*io, void*data, size_t l, pa_creds *ucred, pa_bool_t *creds_valid, int *fds, unsigned *n_fds);
 #endif
 
 pa_bool_t pa_iochannel_is_readable(pa_iochannel*io);
@@ -63,6 +63,7 @@ struct pa_ioline {
 
     pa_bool_t dead:1;
     pa_bool_t defer_close:1;
+    pa_bool_t read_eof:1;
 };
 
 static void io_callback(pa_iochannel*io, void *userdata);
@@ -95,6 +96,7 @@ pa_ioline* pa_ioline_new(pa_iochannel *io) {
 
     l->dead = FALSE;
     l->defer_close = FALSE;
+    l->read_eof = FALSE;
 
     pa_iochannel_set_callback(io, io_callback, l);
 
@@ -233,10 +235,21 @@ static void failure(pa_ioline *l, pa_bool_t process_leftover) {
             l->callback(l, p, l->userdata);
             pa_xfree(p);
         }
+
+        l->rbuf_index = l->rbuf_valid_length = 0;
     }
 
     if (l->callback) {
         l->callback(l, NULL, l->userdata);
+
+        /* On a clean EOF the client may still have something to say,
+         * in which case we stop reading and only close once it asked
+         * for that and the buffer has been written */
+        if (process_leftover && !l->dead && l->defer_close && !l->read_eof) {
+            l->read_eof = TRUE;
+            return;
+        }
+
         l->callback = NULL;
     }
 
@@ -284,7 +297,7 @@ static int do_read(pa_ioline *l) {
     pa_assert(l);
     pa_assert(PA_REFCNT_VALUE(l) >= 1);
 
-    while (l->io && !l->dead && pa_iochannel_is_readable(l->io)) {
+    while (l->io && !l->dead && !l->read_eof && pa_iochannel_is_readable(l->io)) {
         ssize_t r;
         size_t len;
 
@@ -393,7 +406,7 @@ static void do_work(pa_ioline *l) {
     if (!l->dead)
         do_write(l);
 
-    if (l->defer_close && !l->wbuf_valid_length)
+    if (!l->dead && l->defer_close && !l->wbuf_valid_length)
         failure(l, TRUE);
 
     pa_ioline_unref(l);
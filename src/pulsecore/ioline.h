@@ -52,7 +52,10 @@ void pa_ioline_set_callback(pa_ioline*io, pa_ioline_cb_t callback, void *userdat
 /* Set the callback function that is called when everything has been written */
 void pa_ioline_set_drain_callback(pa_ioline*io, pa_ioline_drain_cb_t callback, void *userdata);
 
-/* Make sure to close the ioline object as soon as the send buffer is emptied */
+/* Make sure to close the ioline object as soon as the send buffer is
+ * emptied. If this is called from the callback on EOF, the object
+ * stays open until then, and the callback is called with NULL once
+ * more right before it is closed. */
 void pa_ioline_defer_close(pa_ioline *io);
 
 /* Returns TRUE when everything was written */
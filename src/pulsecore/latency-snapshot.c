@@ -0,0 +1,98 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/macro.h>
+
+#include "latency-snapshot.h"
+
+void pa_latency_snapshot_init(pa_latency_snapshot *s) {
+    pa_assert(s);
+
+    s->aupdate = pa_aupdate_new();
+    s->data[0].valid = s->data[1].valid = FALSE;
+    s->data[0].latency = s->data[1].latency = 0;
+    s->data[0].timestamp = s->data[1].timestamp = 0;
+}
+
+void pa_latency_snapshot_done(pa_latency_snapshot *s) {
+    pa_assert(s);
+
+    if (s->aupdate) {
+        pa_aupdate_free(s->aupdate);
+        s->aupdate = NULL;
+    }
+}
+
+static void write_data(pa_latency_snapshot *s, pa_bool_t valid, pa_usec_t latency, pa_usec_t now) {
+    unsigned j;
+
+    /* Both copies are rewritten entirely, so the swap may happen
+     * implicitly in _write_end() */
+    j = pa_aupdate_write_begin(s->aupdate);
+    s->data[j].valid = valid;
+    s->data[j].latency = latency;
+    s->data[j].timestamp = now;
+    pa_aupdate_write_end(s->aupdate);
+}
+
+void pa_latency_snapshot_publish(pa_latency_snapshot *s, pa_usec_t latency, pa_usec_t now) {
+    pa_assert(s);
+
+    write_data(s, TRUE, latency, now);
+}
+
+void pa_latency_snapshot_invalidate(pa_latency_snapshot *s) {
+    pa_assert(s);
+
+    write_data(s, FALSE, 0, 0);
+}
+
+pa_bool_t pa_latency_snapshot_get(pa_latency_snapshot *s, pa_usec_t now, pa_bool_t playback, pa_usec_t *latency) {
+    unsigned j;
+    pa_bool_t valid;
+    pa_usec_t usec, timestamp, age;
+
+    pa_assert(s);
+    pa_assert(latency);
+
+    j = pa_aupdate_read_begin(s->aupdate);
+    valid = s->data[j].valid;
+    usec = s->data[j].latency;
+    timestamp = s->data[j].timestamp;
+    pa_aupdate_read_end(s->aupdate);
+
+    if (!valid)
+        return FALSE;
+
+    age = now > timestamp ? now - timestamp : 0;
+
+    if (age > PA_LATENCY_SNAPSHOT_MAX_AGE_USEC)
+        return FALSE;
+
+    if (playback)
+        *latency = usec > age ? usec - age : 0;
+    else
+        *latency = usec + age;
+
+    return TRUE;
+}
@@ -0,0 +1,61 @@
+#ifndef foopulsecorelatencysnapshothfoo
+#define foopulsecorelatencysnapshothfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulse/sample.h>
+#include <pulse/timeval.h>
+
+#include <pulsecore/aupdate.h>
+#include <pulsecore/macro.h>
+
+/* The latency of a device as last seen by its IO thread, together
+ * with the time it was taken. The IO thread publishes a new one
+ * whenever it has written or read data, and the main thread reads it
+ * without having to wait for the IO thread to answer a GET_LATENCY
+ * message. */
+
+/* Snapshots older than this are not extrapolated any further */
+#define PA_LATENCY_SNAPSHOT_MAX_AGE_USEC (2*PA_USEC_PER_SEC)
+
+typedef struct pa_latency_snapshot {
+    pa_aupdate *aupdate;
+
+    struct {
+        pa_bool_t valid;
+        pa_usec_t latency;
+        pa_usec_t timestamp;
+    } data[2];
+} pa_latency_snapshot;
+
+void pa_latency_snapshot_init(pa_latency_snapshot *s);
+void pa_latency_snapshot_done(pa_latency_snapshot *s);
+
+/* Called from the IO thread only */
+void pa_latency_snapshot_publish(pa_latency_snapshot *s, pa_usec_t latency, pa_usec_t now);
+void pa_latency_snapshot_invalidate(pa_latency_snapshot *s);
+
+/* May be called from any thread. Returns FALSE if nothing usable was
+ * published. Otherwise *latency is the published latency, moved
+ * forward to now: for playback it goes down as the device plays,
+ * for capture it goes up as the device records. */
+pa_bool_t pa_latency_snapshot_get(pa_latency_snapshot *s, pa_usec_t now, pa_bool_t playback, pa_usec_t *latency);
+
+#endif
@@ -0,0 +1,194 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/sconv.h>
+
+#include "level-meter.h"
+
+/* Samples converted at once, on the stack */
+#define BUFFER_SAMPLES 512
+
+/* Anything louder is clipped, so that a full interval of blocks can't
+ * overflow the counters */
+#define LEVEL_MAX 16.0f
+
+void pa_level_meter_init(pa_level_meter *m) {
+    pa_assert(m);
+
+    pa_atomic_store(&m->enabled, 0);
+
+    m->block_peak = 0;
+    m->block_sum = 0;
+    m->block_frames = 0;
+
+    pa_atomic_store(&m->peak, 0);
+    pa_atomic_store(&m->power, 0);
+    pa_atomic_store(&m->n_blocks, 0);
+}
+
+void pa_level_meter_set_enabled(pa_level_meter *m, pa_bool_t enabled) {
+    pa_assert(m);
+
+    if (!!pa_atomic_load(&m->enabled) == !!enabled)
+        return;
+
+    /* Start from scratch, the blocks summed up before are stale */
+    pa_atomic_store(&m->peak, 0);
+    pa_atomic_store(&m->power, 0);
+    pa_atomic_store(&m->n_blocks, 0);
+
+    pa_atomic_store(&m->enabled, !!enabled);
+}
+
+static int to_fixed(float v) {
+    if (v >= LEVEL_MAX)
+        v = LEVEL_MAX;
+
+    return (int) (v * PA_LEVEL_METER_ONE + 0.5f);
+}
+
+static void publish_block(pa_level_meter *m, unsigned channels) {
+    int peak, old;
+
+    peak = to_fixed(m->block_peak);
+
+    do {
+        old = pa_atomic_load(&m->peak);
+
+        if (old >= peak)
+            break;
+    } while (!pa_atomic_cmpxchg(&m->peak, old, peak));
+
+    pa_atomic_add(&m->power, to_fixed((float) (m->block_sum / (double) (m->block_frames * channels))));
+    pa_atomic_inc(&m->n_blocks);
+
+    m->block_peak = 0;
+    m->block_sum = 0;
+    m->block_frames = 0;
+}
+
+void pa_level_meter_add(pa_level_meter *m, const pa_memchunk *c, const pa_sample_spec *ss, const pa_cvolume *volume) {
+    float factor[PA_CHANNELS_MAX];
+    float buffer[BUFFER_SAMPLES];
+    pa_convert_func_t convert = NULL;
+    size_t fs, frames, block_length;
+    const uint8_t *d = NULL;
+    pa_bool_t silent;
+    unsigned k;
+
+    pa_assert(m);
+    pa_assert(c);
+    pa_assert(c->memblock);
+    pa_assert(ss);
+
+    if (!pa_level_meter_is_enabled(m))
+        return;
+
+    fs = pa_frame_size(ss);
+    frames = c->length / fs;
+    block_length = PA_MAX(ss->rate / 100, 1U);
+
+    silent =
+        pa_memblock_is_silence(c->memblock) ||
+        (volume && pa_cvolume_is_muted(volume));
+
+    if (!silent) {
+        pa_assert(!volume || volume->channels == ss->channels);
+
+        for (k = 0; k < ss->channels; k++)
+            factor[k] = volume ? (float) pa_sw_volume_to_linear(volume->values[k]) : 1.0f;
+
+        if (ss->format != PA_SAMPLE_FLOAT32NE)
+            pa_assert_se(convert = pa_get_convert_to_float32ne_function(ss->format));
+
+        d = (const uint8_t*) pa_memblock_acquire(c->memblock) + c->index;
+    }
+
+    while (frames > 0) {
+        size_t n;
+
+        n = PA_MIN(frames, block_length - m->block_frames);
+        n = PA_MIN(n, (size_t) (BUFFER_SAMPLES / ss->channels));
+
+        if (!silent) {
+            const float *s;
+            unsigned ch = 0;
+            size_t j;
+
+            if (convert) {
+                convert((unsigned) (n * ss->channels), d, buffer);
+                s = buffer;
+            } else
+                s = (const float*) d;
+
+            for (j = 0; j < n * ss->channels; j++) {
+                float v = fabsf(s[j]) * factor[ch];
+
+                if (v > m->block_peak)
+                    m->block_peak = v;
+
+                m->block_sum += v * v;
+
+                if (++ch >= ss->channels)
+                    ch = 0;
+            }
+
+            d += n * fs;
+        }
+
+        m->block_frames += n;
+        frames -= n;
+
+        if (m->block_frames >= block_length)
+            publish_block(m, ss->channels);
+    }
+
+    if (!silent)
+        pa_memblock_release(c->memblock);
+}
+
+void pa_level_meter_read(pa_level_meter *m, float *peak, float *rms) {
+    int p, power, n;
+
+    pa_assert(m);
+    pa_assert(peak);
+    pa_assert(rms);
+
+    do {
+        p = pa_atomic_load(&m->peak);
+    } while (!pa_atomic_cmpxchg(&m->peak, p, 0));
+
+    /* Only take away what has been read, so that blocks published
+     * meanwhile are left for the next call */
+    n = pa_atomic_load(&m->n_blocks);
+    power = pa_atomic_load(&m->power);
+    pa_atomic_sub(&m->n_blocks, n);
+    pa_atomic_sub(&m->power, power);
+
+    *peak = (float) p / PA_LEVEL_METER_ONE;
+    *rms = n > 0 ? sqrtf((float) power / PA_LEVEL_METER_ONE / (float) n) : 0.0f;
+}
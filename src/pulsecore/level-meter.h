@@ -0,0 +1,69 @@
+#ifndef foopulsecorelevelmeterhfoo
+#define foopulsecorelevelmeterhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulse/sample.h>
+#include <pulse/volume.h>
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/memchunk.h>
+
+/* Peak and RMS level of the audio passing through a sink, source or
+ * sink input. The IO thread sums up blocks of 10 ms and publishes
+ * each finished block in atomic counters, which the main thread reads
+ * and clears without taking any lock. Nothing is measured unless the
+ * meter is enabled. */
+
+/* The fixed point unit the levels are published in */
+#define PA_LEVEL_METER_ONE 0x10000
+
+typedef struct pa_level_meter {
+    pa_atomic_t enabled;
+
+    /* Only touched by the IO thread */
+    float block_peak;
+    double block_sum;
+    size_t block_frames;
+
+    /* Published, in units of PA_LEVEL_METER_ONE */
+    pa_atomic_t peak;
+    pa_atomic_t power;
+    pa_atomic_t n_blocks;
+} pa_level_meter;
+
+void pa_level_meter_init(pa_level_meter *m);
+
+/* Called from the main thread */
+void pa_level_meter_set_enabled(pa_level_meter *m, pa_bool_t enabled);
+
+static inline pa_bool_t pa_level_meter_is_enabled(pa_level_meter *m) {
+    return !!pa_atomic_load(&m->enabled);
+}
+
+/* Called from the IO thread. volume may be NULL for unity gain. */
+void pa_level_meter_add(pa_level_meter *m, const pa_memchunk *c, const pa_sample_spec *ss, const pa_cvolume *volume);
+
+/* Called from the main thread. Returns the linear peak and RMS level
+ * since the last call, and clears them. Blocks finished meanwhile may
+ * be counted in either call. */
+void pa_level_meter_read(pa_level_meter *m, float *peak, float *rms);
+
+#endif
@@ -45,10 +45,12 @@
 #include <pulse/util.h>
 #include <pulse/timeval.h>
 
+#include <pulsecore/atomic.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/once.h>
 #include <pulsecore/ratelimit.h>
+#include <pulsecore/semaphore.h>
 #include <pulsecore/thread.h>
 
 #include "log.h"
@@ -85,6 +87,12 @@
 #define ENV_LOG_BACKTRACE "PULSE_LOG_BACKTRACE"
 #define ENV_LOG_BACKTRACE_SKIP "PULSE_LOG_BACKTRACE_SKIP"
 #define ENV_LOG_NO_RATELIMIT "PULSE_LOG_NO_RATE_LIMIT"
+#define ENV_LOG_SYNC "PULSE_LOG_SYNC"
+
+/* Per thread size of the queue of deferred messages. Must be a power
+ * of two so that the indexes may wrap around. */
+#define ASYNC_SLOTS 128
+#define ASYNC_TEXT_MAX 480
 
 static char *ident = NULL; /* in local charset format */
 static pa_log_target_t target = PA_LOG_STDERR, target_override;
@@ -95,6 +103,39 @@ static pa_log_flags_t flags = 0, flags_override = 0;
 static pa_bool_t no_rate_limit = FALSE;
 static int log_fd = -1;
 
+/* File and function name are copied, the strings of a module are gone
+ * once it is unloaded, which may be before the entry is written */
+struct async_entry {
+    pa_log_level_t level;
+    char file[64];
+    int line;
+    char func[64];
+    pa_usec_t time;
+    char thread_name[32];
+    char text[ASYNC_TEXT_MAX];
+};
+
+/* A single producer, single consumer queue: only the thread owning it
+ * writes entries, only the logging thread reads them. Queues are never
+ * freed, once their thread is gone they may be taken over by a new
+ * one. */
+struct async_queue {
+    struct async_queue *next;
+    pa_atomic_t in_use;
+    pa_atomic_t write_idx, read_idx;
+    pa_atomic_t n_dropped;
+    char thread_name[32];
+    struct async_entry entries[ASYNC_SLOTS];
+};
+
+static pa_atomic_ptr_t async_queues = PA_ATOMIC_PTR_INIT(NULL);
+static pa_atomic_t async_running = PA_ATOMIC_INIT(0);
+static pa_semaphore *async_semaphore = NULL;
+static pa_thread *async_thread = NULL;
+
+static void release_queue(void *userdata);
+PA_STATIC_TLS_DECLARE(async_queue, release_queue);
+
 #ifdef HAVE_SYSLOG_H
 static const int level_to_syslog[] = {
     [PA_LOG_ERROR] = LOG_ERR,
@@ -287,47 +328,32 @@ static void init_defaults(void) {
     } PA_ONCE_END;
 }
 
-void pa_log_levelv_meta(
+/* Writes one message out to the current target. now is when the
+ * message was logged, which is where the time stamp comes from when
+ * PA_LOG_PRINT_TIME is set. */
+static void write_message(
         pa_log_level_t level,
-        const char*file,
+        const char *file,
         int line,
         const char *func,
-        const char *format,
-        va_list ap) {
+        const char *thread_name,
+        pa_usec_t now,
+        char *text,
+        const char *bt) {
 
     char *t, *n;
-    int saved_errno = errno;
-    char *bt = NULL;
     pa_log_target_t _target;
-    pa_log_level_t _maximum_level;
-    unsigned _show_backtrace;
     pa_log_flags_t _flags;
 
-    /* We don't use dynamic memory allocation here to minimize the hit
-     * in RT threads */
-    char text[16*1024], location[128], timestamp[32];
-
-    pa_assert(level < PA_LOG_LEVEL_MAX);
-    pa_assert(format);
-
-    init_defaults();
+    char location[128], timestamp[32];
 
     _target = target_override_set ? target_override : target;
-    _maximum_level = PA_MAX(maximum_level, maximum_level_override);
-    _show_backtrace = PA_MAX(show_backtrace, show_backtrace_override);
     _flags = flags | flags_override;
 
-    if (PA_LIKELY(level > _maximum_level)) {
-        errno = saved_errno;
-        return;
-    }
-
-    pa_vsnprintf(text, sizeof(text), format, ap);
-
     if ((_flags & PA_LOG_PRINT_META) && file && line > 0 && func)
-        pa_snprintf(location, sizeof(location), "[%s][%s:%i %s()] ", pa_thread_get_name(pa_thread_self()), file, line, func);
+        pa_snprintf(location, sizeof(location), "[%s][%s:%i %s()] ", thread_name, file, line, func);
     else if ((_flags & (PA_LOG_PRINT_META|PA_LOG_PRINT_FILE)) && file)
-        pa_snprintf(location, sizeof(location), "[%s] %s: ", pa_thread_get_name(pa_thread_self()), pa_path_get_filename(file));
+        pa_snprintf(location, sizeof(location), "[%s] %s: ", thread_name, pa_path_get_filename(file));
     else
         location[0] = 0;
 
@@ -335,19 +361,21 @@ void pa_log_levelv_meta(
         static pa_usec_t start, last;
         pa_usec_t u, a, r;
 
-        u = pa_rtclock_now();
+        u = now;
 
         PA_ONCE_BEGIN {
             start = u;
             last = u;
         } PA_ONCE_END;
 
-        r = u - last;
-        a = u - start;
+        /* Deferred messages may be written after newer ones */
+        r = u > last ? u - last : 0;
+        a = u > start ? u - start : 0;
 
         /* This is not thread safe, but this is a debugging tool only
          * anyway. */
-        last = u;
+        if (u > last)
+            last = u;
 
         pa_snprintf(timestamp, sizeof(timestamp), "(%4llu.%03llu|%4llu.%03llu) ",
                     (unsigned long long) (a / PA_USEC_PER_SEC),
@@ -358,11 +386,6 @@ void pa_log_levelv_meta(
     } else
         timestamp[0] = 0;
 
-#ifdef HAVE_EXECINFO_H
-    if (_show_backtrace > 0)
-        bt = get_backtrace(_show_backtrace);
-#endif
-
     if (!pa_utf8_valid(text))
         pa_logl(level, "Invalid UTF-8 string following below:");
 
@@ -439,7 +462,6 @@ void pa_log_levelv_meta(
                     pa_snprintf(metadata, sizeof(metadata), "\n%c %s %s", level_to_char[level], timestamp, location);
 
                     if ((write(log_fd, metadata, strlen(metadata)) < 0) || (write(log_fd, t, strlen(t)) < 0)) {
-                        saved_errno = errno;
                         pa_log_set_fd(-1);
                         fprintf(stderr, "%s\n", "Error writing logs to a file descriptor. Redirect log messages to console.");
                         fprintf(stderr, "%s %s\n", metadata, t);
@@ -521,6 +543,205 @@ void pa_log_levelv_meta(
                 break;
         }
     }
+}
+
+static void release_queue(void *userdata) {
+    struct async_queue *q = userdata;
+
+    pa_atomic_store(&q->in_use, 0);
+}
+
+static struct async_queue* claim_queue(void) {
+    struct async_queue *q;
+
+    for (q = pa_atomic_ptr_load(&async_queues); q; q = q->next)
+        if (pa_atomic_cmpxchg(&q->in_use, 0, 1))
+            return q;
+
+    q = pa_xnew0(struct async_queue, 1);
+    pa_atomic_store(&q->in_use, 1);
+
+    do
+        q->next = pa_atomic_ptr_load(&async_queues);
+    while (!pa_atomic_ptr_cmpxchg(&async_queues, q->next, q));
+
+    return q;
+}
+
+void pa_log_set_thread_async(pa_bool_t b) {
+    struct async_queue *q = PA_STATIC_TLS_GET(async_queue);
+
+    if (b) {
+        if (q)
+            return;
+
+        q = claim_queue();
+        pa_strlcpy(q->thread_name, pa_strnull(pa_thread_get_name(pa_thread_self())), sizeof(q->thread_name));
+        PA_STATIC_TLS_SET(async_queue, q);
+
+    } else if (q) {
+        PA_STATIC_TLS_SET(async_queue, NULL);
+        release_queue(q);
+    }
+}
+
+/* Never blocks: if the queue is full the message is only counted */
+static pa_bool_t enqueue_message(
+        pa_log_level_t level,
+        const char *file,
+        int line,
+        const char *func,
+        const char *format,
+        va_list ap) {
+
+    struct async_queue *q;
+    struct async_entry *e;
+    unsigned w;
+
+    if (!pa_atomic_load(&async_running) || !(q = PA_STATIC_TLS_GET(async_queue)))
+        return FALSE;
+
+    w = (unsigned) pa_atomic_load(&q->write_idx);
+
+    if (w - (unsigned) pa_atomic_load(&q->read_idx) >= ASYNC_SLOTS) {
+        pa_atomic_inc(&q->n_dropped);
+        return TRUE;
+    }
+
+    e = &q->entries[w % ASYNC_SLOTS];
+    e->level = level;
+    pa_strlcpy(e->file, file ? pa_path_get_filename(file) : "", sizeof(e->file));
+    e->line = line;
+    pa_strlcpy(e->func, func ? func : "", sizeof(e->func));
+    e->time = pa_rtclock_now();
+    memcpy(e->thread_name, q->thread_name, sizeof(e->thread_name));
+    pa_vsnprintf(e->text, sizeof(e->text), format, ap);
+
+    pa_atomic_store(&q->write_idx, (int) (w + 1));
+    pa_semaphore_post(async_semaphore);
+
+    return TRUE;
+}
+
+static void drain_queues(void) {
+    struct async_queue *q;
+
+    for (q = pa_atomic_ptr_load(&async_queues); q; q = q->next) {
+        unsigned r, w;
+        int n;
+
+        w = (unsigned) pa_atomic_load(&q->write_idx);
+
+        for (r = (unsigned) pa_atomic_load(&q->read_idx); r != w; r++) {
+            struct async_entry *e = &q->entries[r % ASYNC_SLOTS];
+
+            write_message(e->level, e->file[0] ? e->file : NULL, e->line, e->func[0] ? e->func : NULL,
+                          e->thread_name, e->time, e->text, NULL);
+            pa_atomic_store(&q->read_idx, (int) (r + 1));
+        }
+
+        if ((n = pa_atomic_load(&q->n_dropped)) > 0) {
+            char text[128];
+
+            pa_atomic_sub(&q->n_dropped, n);
+            pa_snprintf(text, sizeof(text), "Log queue of thread %s overflowed, dropped %i messages.", q->thread_name, n);
+            write_message(PA_LOG_WARN, NULL, 0, NULL, q->thread_name, pa_rtclock_now(), text, NULL);
+        }
+    }
+}
+
+static void async_thread_func(void *userdata) {
+    for (;;) {
+        /* Read before draining, so that nothing queued before
+         * pa_log_stop_async() is left behind */
+        pa_bool_t quit = !pa_atomic_load(&async_running);
+
+        drain_queues();
+
+        if (quit)
+            break;
+
+        pa_semaphore_wait(async_semaphore);
+    }
+}
+
+void pa_log_start_async(void) {
+    init_defaults();
+
+    if (async_thread || getenv(ENV_LOG_SYNC))
+        return;
+
+    /* Threads may still post to it after pa_log_stop_async(), so it
+     * is kept around */
+    if (!async_semaphore)
+        async_semaphore = pa_semaphore_new(0);
+
+    pa_atomic_store(&async_running, 1);
+
+    if (!(async_thread = pa_thread_new("log", async_thread_func, NULL))) {
+        pa_atomic_store(&async_running, 0);
+        pa_log_warn("Failed to start logging thread, logging synchronously.");
+    }
+}
+
+void pa_log_stop_async(void) {
+    if (!async_thread)
+        return;
+
+    pa_atomic_store(&async_running, 0);
+    pa_semaphore_post(async_semaphore);
+
+    pa_thread_free(async_thread);
+    async_thread = NULL;
+
+    /* Whatever came in after the thread's last look */
+    drain_queues();
+}
+
+void pa_log_levelv_meta(
+        pa_log_level_t level,
+        const char*file,
+        int line,
+        const char *func,
+        const char *format,
+        va_list ap) {
+
+    int saved_errno = errno;
+    char *bt = NULL;
+    pa_log_level_t _maximum_level;
+    unsigned _show_backtrace;
+
+    /* We don't use dynamic memory allocation here to minimize the hit
+     * in RT threads */
+    char text[16*1024];
+
+    pa_assert(level < PA_LOG_LEVEL_MAX);
+    pa_assert(format);
+
+    init_defaults();
+
+    _maximum_level = PA_MAX(maximum_level, maximum_level_override);
+    _show_backtrace = PA_MAX(show_backtrace, show_backtrace_override);
+
+    if (PA_LIKELY(level > _maximum_level)) {
+        errno = saved_errno;
+        return;
+    }
+
+    /* Backtraces have to be taken here and now anyway */
+    if (_show_backtrace == 0 && enqueue_message(level, file, line, func, format, ap)) {
+        errno = saved_errno;
+        return;
+    }
+
+    pa_vsnprintf(text, sizeof(text), format, ap);
+
+#ifdef HAVE_EXECINFO_H
+    if (_show_backtrace > 0)
+        bt = get_backtrace(_show_backtrace);
+#endif
+
+    write_message(level, file, line, func, pa_thread_get_name(pa_thread_self()), pa_rtclock_now(), text, bt);
 
     pa_xfree(bt);
     errno = saved_errno;
@@ -551,6 +772,12 @@ void pa_log_level(pa_log_level_t level, const char *format, ...) {
     va_end(ap);
 }
 
+pa_bool_t pa_log_level_enabled(pa_log_level_t level) {
+    init_defaults();
+
+    return level <= PA_MAX(maximum_level, maximum_level_override);
+}
+
 pa_bool_t pa_log_ratelimit(pa_log_level_t level) {
     /* Not more than 10 messages every 5s */
     static PA_DEFINE_RATELIMIT(ratelimit, 5 * PA_USEC_PER_SEC, 10);
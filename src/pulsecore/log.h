@@ -89,6 +89,22 @@ void pa_log_set_show_backtrace(unsigned nlevels);
 /* Skip the first backtrace frames */
 void pa_log_set_skip_backtrace(unsigned nlevels);
 
+/* Start a logging thread that writes the messages of threads which
+ * opted in with pa_log_set_thread_async(). Logging in those threads
+ * then only copies the message into a queue without blocking. If a
+ * queue is full the message is dropped and the number of dropped
+ * messages is logged later. Has no effect if $PULSE_LOG_SYNC is
+ * set. */
+void pa_log_start_async(void);
+
+/* Write out what is still queued and stop the logging thread */
+void pa_log_stop_async(void);
+
+/* Queue the messages of the calling thread while the logging thread
+ * is running. Messages are cut at a few hundred bytes and those that
+ * need a backtrace are still written synchronously. */
+void pa_log_set_thread_async(pa_bool_t b);
+
 void pa_log_level_meta(
         pa_log_level_t level,
         const char*file,
@@ -146,4 +162,8 @@ LOG_FUNC(error, PA_LOG_ERROR)
 
 pa_bool_t pa_log_ratelimit(pa_log_level_t level);
 
+/* Whether messages of this level are logged at all, for skipping
+ * expensive preparations of messages that would be dropped anyway */
+pa_bool_t pa_log_level_enabled(pa_log_level_t level);
+
 #endif
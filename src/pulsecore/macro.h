@@ -44,6 +44,12 @@
 #define PA_LIKELY(x) (x)
 #define PA_UNLIKELY(x) (x)
 #endif
+
+#ifdef __GNUC__
+#define PA_ALWAYS_INLINE __attribute__ ((always_inline))
+#else
+#define PA_ALWAYS_INLINE
+#endif
 #endif
 
 #if defined(PAGE_SIZE)
@@ -0,0 +1,159 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/refcnt.h>
+#include <pulsecore/macro.h>
+
+#include "mem-account.h"
+
+struct pa_mem_account {
+    PA_REFCNT_DECLARE;
+
+    pa_mem_account *parent;
+    size_t budget;
+
+    pa_atomic_t used, peak;
+};
+
+pa_mem_account *pa_mem_account_new(pa_mem_account *parent, size_t budget) {
+    pa_mem_account *a;
+
+    a = pa_xnew0(pa_mem_account, 1);
+    PA_REFCNT_INIT(a);
+    a->parent = parent ? pa_mem_account_ref(parent) : NULL;
+    a->budget = budget;
+    pa_atomic_store(&a->used, 0);
+    pa_atomic_store(&a->peak, 0);
+
+    return a;
+}
+
+pa_mem_account *pa_mem_account_ref(pa_mem_account *a) {
+    pa_assert(a);
+    pa_assert(PA_REFCNT_VALUE(a) >= 1);
+
+    PA_REFCNT_INC(a);
+    return a;
+}
+
+void pa_mem_account_unref(pa_mem_account *a) {
+    pa_assert(a);
+    pa_assert(PA_REFCNT_VALUE(a) >= 1);
+
+    if (PA_REFCNT_DEC(a) > 0)
+        return;
+
+    /* Whatever holds data on an account keeps a reference to it */
+    pa_assert(pa_atomic_load(&a->used) == 0);
+
+    if (a->parent)
+        pa_mem_account_unref(a->parent);
+
+    pa_xfree(a);
+}
+
+static void update_peak(pa_mem_account *a, int used) {
+    int peak;
+
+    while ((peak = pa_atomic_load(&a->peak)) < used)
+        if (pa_atomic_cmpxchg(&a->peak, peak, used))
+            break;
+}
+
+void pa_mem_account_add(pa_mem_account *a, int delta) {
+    pa_assert(a);
+
+    if (delta == 0)
+        return;
+
+    for (; a; a = a->parent) {
+        int used;
+
+        used = pa_atomic_add(&a->used, delta) + delta;
+        pa_assert(used >= 0);
+
+        if (delta > 0)
+            update_peak(a, used);
+    }
+}
+
+size_t pa_mem_account_get_used(pa_mem_account *a) {
+    pa_assert(a);
+
+    return (size_t) pa_atomic_load(&a->used);
+}
+
+size_t pa_mem_account_get_peak(pa_mem_account *a) {
+    pa_assert(a);
+
+    return (size_t) pa_atomic_load(&a->peak);
+}
+
+size_t pa_mem_account_get_budget(pa_mem_account *a) {
+    pa_assert(a);
+
+    return a->budget;
+}
+
+void pa_mem_account_set_budget(pa_mem_account *a, size_t budget) {
+    pa_assert(a);
+
+    a->budget = budget;
+}
+
+pa_bool_t pa_mem_account_over_budget(pa_mem_account *a) {
+    pa_assert(a);
+
+    for (; a; a = a->parent)
+        if (a->budget > 0 && (size_t) pa_atomic_load(&a->used) > a->budget)
+            return TRUE;
+
+    return FALSE;
+}
+
+size_t pa_mem_account_get_available(pa_mem_account *a) {
+    size_t available = (size_t) -1;
+
+    pa_assert(a);
+
+    for (; a; a = a->parent) {
+        size_t used;
+
+        if (a->budget <= 0)
+            continue;
+
+        used = (size_t) pa_atomic_load(&a->used);
+        available = PA_MIN(available, used < a->budget ? a->budget - used : 0);
+    }
+
+    return available;
+}
+
+void pa_mem_account_reset_peak(pa_mem_account *a) {
+    pa_assert(a);
+
+    pa_atomic_store(&a->peak, pa_atomic_load(&a->used));
+}
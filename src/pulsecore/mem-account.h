@@ -0,0 +1,62 @@
+#ifndef foopulsecorememaccounthfoo
+#define foopulsecorememaccounthfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <sys/types.h>
+#include <inttypes.h>
+
+#include <pulsecore/macro.h>
+
+/* Counts the bytes of audio some part of the daemon keeps around, e.g.
+ * the queues of the streams of one client, and compares that to a
+ * budget. Accounts form a tree: whatever is added to an account is
+ * added to all accounts above it too, so the root account holds the
+ * total. The counters are atomic, memblockqs update them from the IO
+ * threads, and they hold at most 2 GiB. */
+
+typedef struct pa_mem_account pa_mem_account;
+
+/* A budget of 0 means unlimited */
+pa_mem_account *pa_mem_account_new(pa_mem_account *parent, size_t budget);
+pa_mem_account *pa_mem_account_ref(pa_mem_account *a);
+void pa_mem_account_unref(pa_mem_account *a);
+
+/* May be called from any thread */
+void pa_mem_account_add(pa_mem_account *a, int delta);
+
+size_t pa_mem_account_get_used(pa_mem_account *a);
+size_t pa_mem_account_get_peak(pa_mem_account *a);
+size_t pa_mem_account_get_budget(pa_mem_account *a);
+
+/* Called from main context, before anything is accounted below a */
+void pa_mem_account_set_budget(pa_mem_account *a, size_t budget);
+
+/* Returns TRUE if a or any account above it uses more than its budget */
+pa_bool_t pa_mem_account_over_budget(pa_mem_account *a);
+
+/* The smallest amount of budget left in a or above it, (size_t) -1 if
+ * none of them has a budget */
+size_t pa_mem_account_get_available(pa_mem_account *a);
+
+/* Starts the peak from the current usage again */
+void pa_mem_account_reset_peak(pa_mem_account *a);
+
+#endif
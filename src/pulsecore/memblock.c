@@ -30,6 +30,11 @@
 #include <unistd.h>
 #include <signal.h>
 #include <errno.h>
+#include <dirent.h>
+
+#ifdef HAVE_GETCPU
+#include <sched.h>
+#endif
 
 #ifdef HAVE_VALGRIND_MEMCHECK_H
 #include <valgrind/memcheck.h>
@@ -52,17 +57,14 @@
 
 #include "memblock.h"
 
-/* We can allocate 64*1024*1024 bytes at maximum. That's 64MB. Please
- * note that the footprint is usually much smaller, since the data is
- * stored in SHM and our OS does not commit the memory before we use
- * it for the first time. */
+/* By default we can allocate 64*1024*1024 bytes at maximum. That's
+ * 64MB. Please note that the footprint is usually much smaller, since
+ * the data is stored in SHM and our OS does not commit the memory
+ * before we use it for the first time. */
 #define PA_MEMPOOL_SLOTS_MAX 1024
 #define PA_MEMPOOL_SLOT_SIZE (64*1024)
 
-#define PA_MEMEXPORT_SLOTS_MAX 128
-
-#define PA_MEMIMPORT_SLOTS_MAX 160
-#define PA_MEMIMPORT_SEGMENTS_MAX 16
+#define PA_MEMIMPORT_SEGMENTS_MAX 64
 
 struct pa_memblock {
     PA_REFCNT_DECLARE; /* the reference counter */
@@ -97,6 +99,10 @@ struct pa_memimport_segment {
     pa_shm memory;
     pa_memtrap *trap;
     unsigned n_blocks;
+
+    /* memfd segments can't be attached again on demand, so they stay
+     * around until the import goes away */
+    pa_bool_t permanent;
 };
 
 /* A collection of multiple segments */
@@ -115,20 +121,15 @@ struct pa_memimport {
     PA_LLIST_FIELDS(pa_memimport);
 };
 
-struct memexport_slot {
-    PA_LLIST_FIELDS(struct memexport_slot);
-    pa_memblock *block;
-};
-
 struct pa_memexport {
     pa_mutex *mutex;
     pa_mempool *pool;
 
-    struct memexport_slot slots[PA_MEMEXPORT_SLOTS_MAX];
-
-    PA_LLIST_HEAD(struct memexport_slot, free_slots);
-    PA_LLIST_HEAD(struct memexport_slot, used_slots);
-    unsigned n_init;
+    /* The blocks handed out, by block id. Ids are counted up from
+     * next_id, skipping those still in use once it wraps around. */
+    pa_hashmap *blocks;
+    uint32_t next_id;
+    unsigned max_blocks;
 
     /* Called whenever a client from which we imported a memory block
        which we in turn exported to another client dies and we need to
@@ -139,22 +140,52 @@ struct pa_memexport {
     PA_LLIST_FIELDS(pa_memexport);
 };
 
+/* How many NUMA nodes the free slots are kept apart for at most */
+#define NODES_MAX 8
+
+/* Never defined, points to the start of a slot */
+struct mempool_slot;
+
+/* A run of equally sized slots within the pool's memory */
+struct mempool_slots {
+    uint8_t *ptr;
+    size_t block_size;
+    unsigned n_blocks;
+
+    pa_atomic_t n_init;
+
+    /* Lists of free slots that may be reused, one for each NUMA node.
+     * A slot goes back to the list of the node of the thread that used
+     * it first, which is where its memory was placed. */
+    pa_flist *free_slots[NODES_MAX];
+    uint8_t *nodes;
+
+    /* The reclaim tick a free slot was put back at, 0 if its pages are
+     * not resident */
+    unsigned *freed_at;
+};
+
 struct pa_mempool {
+    PA_REFCNT_DECLARE;
+
     pa_semaphore *semaphore;
     pa_mutex *mutex;
 
     pa_shm memory;
-    size_t block_size;
-    unsigned n_blocks;
 
-    pa_atomic_t n_init;
+    /* The number of NUMA nodes, 1 if we don't know */
+    unsigned n_nodes;
+
+    /* Counts the calls of pa_mempool_reclaim(), starting at 1 */
+    pa_atomic_t reclaim_tick;
+
+    /* Small blocks are taken from small_slots if there are any, they
+     * follow the large slots in memory */
+    struct mempool_slots slots, small_slots;
 
     PA_LLIST_HEAD(pa_memimport, imports);
     PA_LLIST_HEAD(pa_memexport, exports);
 
-    /* A list of free slots that may be reused */
-    pa_flist *free_slots;
-
     pa_mempool_stat stat;
 };
 
@@ -233,7 +264,7 @@ static pa_memblock *memblock_new_appended(pa_mempool *p, size_t length) {
 
     b = pa_xmalloc(PA_ALIGN(sizeof(pa_memblock)) + length);
     PA_REFCNT_INIT(b);
-    b->pool = p;
+    b->pool = pa_mempool_ref(p);
     b->type = PA_MEMBLOCK_APPENDED;
     b->read_only = b->is_silence = FALSE;
     pa_atomic_ptr_store(&b->data, (uint8_t*) b + PA_ALIGN(sizeof(pa_memblock)));
@@ -246,19 +277,98 @@ static pa_memblock *memblock_new_appended(pa_mempool *p, size_t length) {
 }
 
 /* No lock necessary */
-static struct mempool_slot* mempool_allocate_slot(pa_mempool *p) {
+static unsigned current_node(pa_mempool *p) {
+#ifdef HAVE_GETCPU
+    unsigned cpu, node;
+
+    if (p->n_nodes > 1 && getcpu(&cpu, &node) == 0 && node < p->n_nodes)
+        return node;
+#endif
+
+    return 0;
+}
+
+static unsigned count_nodes(void) {
+    unsigned n = 1;
+#ifdef HAVE_GETCPU
+    DIR *d;
+    struct dirent *de;
+
+    if (!(d = opendir("/sys/devices/system/node")))
+        return 1;
+
+    while ((de = readdir(d))) {
+        uint32_t i;
+
+        if (pa_startswith(de->d_name, "node") && pa_atou(de->d_name + 4, &i) >= 0 && i < NODES_MAX)
+            n = PA_MAX(n, (unsigned) i + 1);
+    }
+
+    closedir(d);
+#endif
+
+    return n;
+}
+
+/* No lock necessary */
+static unsigned slot_idx(struct mempool_slots *s, struct mempool_slot *slot) {
+    return (unsigned) (((uint8_t*) slot - s->ptr) / s->block_size);
+}
+
+/* No lock necessary, the caller owns the slot */
+static void slot_taken(pa_mempool *p, struct mempool_slots *s, struct mempool_slot *slot) {
+    unsigned idx = slot_idx(s, slot);
+
+    if (s->freed_at[idx] == 0)
+        return;
+
+    s->freed_at[idx] = 0;
+    pa_atomic_dec(&p->stat.n_free_resident);
+    pa_atomic_sub(&p->stat.free_resident_size, (int) s->block_size);
+}
+
+/* No lock necessary, the caller owns the slot */
+static void slot_put_back(pa_mempool *p, struct mempool_slots *s, struct mempool_slot *slot) {
+    s->freed_at[slot_idx(s, slot)] = (unsigned) pa_atomic_load(&p->reclaim_tick);
+    pa_atomic_inc(&p->stat.n_free_resident);
+    pa_atomic_add(&p->stat.free_resident_size, (int) s->block_size);
+}
+
+/* No lock necessary, the caller owns the slot */
+static void slot_punch(pa_mempool *p, struct mempool_slots *s, struct mempool_slot *slot) {
+    pa_shm_punch(&p->memory, (size_t) ((uint8_t*) slot - (uint8_t*) p->memory.ptr), s->block_size);
+    slot_taken(p, s, slot);
+}
+
+/* No lock necessary */
+static struct mempool_slot* mempool_allocate_slot(pa_mempool *p, struct mempool_slots *s) {
     struct mempool_slot *slot;
+    unsigned node, i;
+
     pa_assert(p);
+    pa_assert(s);
 
-    if (!(slot = pa_flist_pop(p->free_slots))) {
+    node = current_node(p);
+
+    if (!(slot = pa_flist_pop(s->free_slots[node]))) {
         int idx;
 
         /* The free list was empty, we have to allocate a new entry */
 
-        if ((unsigned) (idx = pa_atomic_inc(&p->n_init)) >= p->n_blocks)
-            pa_atomic_dec(&p->n_init);
-        else
-            slot = (struct mempool_slot*) ((uint8_t*) p->memory.ptr + (p->block_size * (size_t) idx));
+        if ((unsigned) (idx = pa_atomic_inc(&s->n_init)) >= s->n_blocks)
+            pa_atomic_dec(&s->n_init);
+        else {
+            slot = (struct mempool_slot*) (s->ptr + (s->block_size * (size_t) idx));
+
+            /* We are the first to touch it */
+            s->nodes[idx] = (uint8_t) node;
+        }
+
+        /* Only when there are no new slots left we take one that is
+         * located on another node */
+        for (i = 0; !slot && i < p->n_nodes; i++)
+            if (i != node)
+                slot = pa_flist_pop(s->free_slots[i]);
 
         if (!slot) {
             if (pa_log_ratelimit(PA_LOG_DEBUG))
@@ -268,44 +378,65 @@ static struct mempool_slot* mempool_allocate_slot(pa_mempool *p) {
         }
     }
 
+    slot_taken(p, s, slot);
+
 /* #ifdef HAVE_VALGRIND_MEMCHECK_H */
 /*     if (PA_UNLIKELY(pa_in_valgrind())) { */
-/*         VALGRIND_MALLOCLIKE_BLOCK(slot, p->block_size, 0, 0); */
+/*         VALGRIND_MALLOCLIKE_BLOCK(slot, s->block_size, 0, 0); */
 /*     } */
 /* #endif */
 
     return slot;
 }
 
+/* No lock necessary */
+static struct mempool_slots* mempool_slots_by_ptr(pa_mempool *p, void *ptr) {
+    pa_assert(p);
+
+    pa_assert((uint8_t*) ptr >= (uint8_t*) p->memory.ptr);
+    pa_assert((uint8_t*) ptr < (uint8_t*) p->memory.ptr + p->memory.size);
+
+    if (p->small_slots.n_blocks > 0 && (uint8_t*) ptr >= p->small_slots.ptr)
+        return &p->small_slots;
+
+    return &p->slots;
+}
+
 /* No lock necessary, totally redundant anyway */
 static inline void* mempool_slot_data(struct mempool_slot *slot) {
     return slot;
 }
 
 /* No lock necessary */
-static unsigned mempool_slot_idx(pa_mempool *p, void *ptr) {
-    pa_assert(p);
+static unsigned mempool_slot_idx(struct mempool_slots *s, void *ptr) {
+    pa_assert(s);
 
-    pa_assert((uint8_t*) ptr >= (uint8_t*) p->memory.ptr);
-    pa_assert((uint8_t*) ptr < (uint8_t*) p->memory.ptr + p->memory.size);
+    pa_assert((uint8_t*) ptr >= s->ptr);
+    pa_assert((uint8_t*) ptr < s->ptr + s->n_blocks * s->block_size);
 
-    return (unsigned) ((size_t) ((uint8_t*) ptr - (uint8_t*) p->memory.ptr) / p->block_size);
+    return (unsigned) ((size_t) ((uint8_t*) ptr - s->ptr) / s->block_size);
 }
 
 /* No lock necessary */
-static struct mempool_slot* mempool_slot_by_ptr(pa_mempool *p, void *ptr) {
+static struct mempool_slot* mempool_slot_by_ptr(struct mempool_slots *s, void *ptr) {
     unsigned idx;
 
-    if ((idx = mempool_slot_idx(p, ptr)) == (unsigned) -1)
+    if ((idx = mempool_slot_idx(s, ptr)) == (unsigned) -1)
         return NULL;
 
-    return (struct mempool_slot*) ((uint8_t*) p->memory.ptr + (idx * p->block_size));
+    return (struct mempool_slot*) (s->ptr + (idx * s->block_size));
+}
+
+/* No lock necessary */
+static unsigned slot_node(struct mempool_slots *s, struct mempool_slot *slot) {
+    return s->nodes[slot_idx(s, slot)];
 }
 
 /* No lock necessary */
 pa_memblock *pa_memblock_new_pool(pa_mempool *p, size_t length) {
     pa_memblock *b = NULL;
     struct mempool_slot *slot;
+    struct mempool_slots *s;
     static int mempool_disable = 0;
 
     pa_assert(p);
@@ -323,18 +454,27 @@ pa_memblock *pa_memblock_new_pool(pa_mempool *p, size_t length) {
     if (length == (size_t) -1)
         length = pa_mempool_block_size_max(p);
 
-    if (p->block_size >= PA_ALIGN(sizeof(pa_memblock)) + length) {
+    /* Blocks that fit into a small slot go there first, so that they
+     * don't tie up a large one */
+    s = &p->slots;
+    slot = NULL;
+
+    if (p->small_slots.block_size >= PA_ALIGN(sizeof(pa_memblock)) + length)
+        if ((slot = mempool_allocate_slot(p, &p->small_slots)))
+            s = &p->small_slots;
 
-        if (!(slot = mempool_allocate_slot(p)))
+    if (s->block_size >= PA_ALIGN(sizeof(pa_memblock)) + length) {
+
+        if (!slot && !(slot = mempool_allocate_slot(p, s)))
             return NULL;
 
         b = mempool_slot_data(slot);
         b->type = PA_MEMBLOCK_POOL;
         pa_atomic_ptr_store(&b->data, (uint8_t*) b + PA_ALIGN(sizeof(pa_memblock)));
 
-    } else if (p->block_size >= length) {
+    } else if (s->block_size >= length) {
 
-        if (!(slot = mempool_allocate_slot(p)))
+        if (!(slot = mempool_allocate_slot(p, s)))
             return NULL;
 
         if (!(b = pa_flist_pop(PA_STATIC_FLIST_GET(unused_memblocks))))
@@ -344,13 +484,13 @@ pa_memblock *pa_memblock_new_pool(pa_mempool *p, size_t length) {
         pa_atomic_ptr_store(&b->data, mempool_slot_data(slot));
 
     } else {
-        pa_log_debug("Memory block too large for pool: %lu > %lu", (unsigned long) length, (unsigned long) p->block_size);
+        pa_log_debug("Memory block too large for pool: %lu > %lu", (unsigned long) length, (unsigned long) s->block_size);
         pa_atomic_inc(&p->stat.n_too_large_for_pool);
         return NULL;
     }
 
     PA_REFCNT_INIT(b);
-    b->pool = p;
+    b->pool = pa_mempool_ref(p);
     b->read_only = b->is_silence = FALSE;
     b->length = length;
     pa_atomic_store(&b->n_acquired, 0);
@@ -373,7 +513,7 @@ pa_memblock *pa_memblock_new_fixed(pa_mempool *p, void *d, size_t length, pa_boo
         b = pa_xnew(pa_memblock, 1);
 
     PA_REFCNT_INIT(b);
-    b->pool = p;
+    b->pool = pa_mempool_ref(p);
     b->type = PA_MEMBLOCK_FIXED;
     b->read_only = read_only;
     b->is_silence = FALSE;
@@ -400,7 +540,7 @@ pa_memblock *pa_memblock_new_user(pa_mempool *p, void *d, size_t length, pa_free
         b = pa_xnew(pa_memblock, 1);
 
     PA_REFCNT_INIT(b);
-    b->pool = p;
+    b->pool = pa_mempool_ref(p);
     b->type = PA_MEMBLOCK_USER;
     b->read_only = read_only;
     b->is_silence = FALSE;
@@ -423,6 +563,21 @@ pa_bool_t pa_memblock_is_read_only(pa_memblock *b) {
     return b->read_only && PA_REFCNT_VALUE(b) == 1;
 }
 
+/* No lock necessary */
+pa_bool_t pa_memblock_is_imported(pa_memblock *b) {
+    pa_assert(b);
+    pa_assert(PA_REFCNT_VALUE(b) > 0);
+
+    return b->type == PA_MEMBLOCK_IMPORTED;
+}
+
+pa_bool_t pa_memblock_is_stable(pa_memblock *b) {
+    pa_assert(b);
+    pa_assert(PA_REFCNT_VALUE(b) > 0);
+
+    return b->type != PA_MEMBLOCK_IMPORTED && b->type != PA_MEMBLOCK_FIXED;
+}
+
 /* No lock necessary */
 pa_bool_t pa_memblock_is_silence(pa_memblock *b) {
     pa_assert(b);
@@ -496,8 +651,13 @@ pa_memblock* pa_memblock_ref(pa_memblock*b) {
     return b;
 }
 
+static void mempool_unref(pa_mempool *p);
+
 static void memblock_free(pa_memblock *b) {
+    pa_mempool *pool;
+
     pa_assert(b);
+    pa_assert_se(pool = b->pool);
 
     pa_assert(pa_atomic_load(&b->n_acquired) == 0);
 
@@ -537,7 +697,7 @@ static void memblock_free(pa_memblock *b) {
             pa_assert_se(pa_hashmap_remove(import->blocks, PA_UINT32_TO_PTR(b->per_type.imported.id)));
 
             pa_assert(segment->n_blocks >= 1);
-            if (-- segment->n_blocks <= 0)
+            if (-- segment->n_blocks <= 0 && !segment->permanent)
                 segment_detach(segment);
 
             pa_mutex_unlock(import->mutex);
@@ -552,23 +712,27 @@ static void memblock_free(pa_memblock *b) {
 
         case PA_MEMBLOCK_POOL_EXTERNAL:
         case PA_MEMBLOCK_POOL: {
+            struct mempool_slots *s;
             struct mempool_slot *slot;
             pa_bool_t call_free;
 
-            pa_assert_se(slot = mempool_slot_by_ptr(b->pool, pa_atomic_ptr_load(&b->data)));
+            s = mempool_slots_by_ptr(b->pool, pa_atomic_ptr_load(&b->data));
+            pa_assert_se(slot = mempool_slot_by_ptr(s, pa_atomic_ptr_load(&b->data)));
 
             call_free = b->type == PA_MEMBLOCK_POOL_EXTERNAL;
 
 /* #ifdef HAVE_VALGRIND_MEMCHECK_H */
 /*             if (PA_UNLIKELY(pa_in_valgrind())) { */
-/*                 VALGRIND_FREELIKE_BLOCK(slot, b->pool->block_size); */
+/*                 VALGRIND_FREELIKE_BLOCK(slot, s->block_size); */
 /*             } */
 /* #endif */
 
+            slot_put_back(b->pool, s, slot);
+
             /* The free list dimensions should easily allow all slots
              * to fit in, hence try harder if pushing this slot into
              * the free list fails */
-            while (pa_flist_push(b->pool->free_slots, slot) < 0)
+            while (pa_flist_push(s->free_slots[slot_node(s, slot)], slot) < 0)
                 ;
 
             if (call_free)
@@ -582,6 +746,8 @@ static void memblock_free(pa_memblock *b) {
         default:
             pa_assert_not_reached();
     }
+
+    mempool_unref(pool);
 }
 
 /* No lock necessary */
@@ -619,10 +785,13 @@ static void memblock_make_local(pa_memblock *b) {
 
     pa_atomic_dec(&b->pool->stat.n_allocated_by_type[b->type]);
 
-    if (b->length <= b->pool->block_size) {
-        struct mempool_slot *slot;
+    if (b->length <= b->pool->slots.block_size) {
+        struct mempool_slot *slot = NULL;
+
+        if (b->length <= b->pool->small_slots.block_size)
+            slot = mempool_allocate_slot(b->pool, &b->pool->small_slots);
 
-        if ((slot = mempool_allocate_slot(b->pool))) {
+        if (slot || (slot = mempool_allocate_slot(b->pool, &b->pool->slots))) {
             void *new_data;
             /* We can move it into a local pool, perfect! */
 
@@ -699,45 +868,113 @@ static void memblock_replace_import(pa_memblock *b) {
     memblock_make_local(b);
 
     pa_assert(segment->n_blocks >= 1);
-    if (-- segment->n_blocks <= 0)
+    if (-- segment->n_blocks <= 0 && !segment->permanent)
         segment_detach(segment);
 
     pa_mutex_unlock(import->mutex);
 }
 
-pa_mempool* pa_mempool_new(pa_bool_t shared, size_t size) {
+static void mempool_slots_init(pa_mempool *p, struct mempool_slots *s) {
+    unsigned i;
+
+    if (s->n_blocks <= 0)
+        return;
+
+    s->nodes = pa_xnew0(uint8_t, s->n_blocks);
+    s->freed_at = pa_xnew0(unsigned, s->n_blocks);
+
+    for (i = 0; i < p->n_nodes; i++)
+        s->free_slots[i] = pa_flist_new(s->n_blocks);
+}
+
+static void mempool_slots_done(pa_mempool *p, struct mempool_slots *s) {
+    unsigned i;
+
+    if (s->n_blocks <= 0)
+        return;
+
+    for (i = 0; i < p->n_nodes; i++)
+        pa_flist_free(s->free_slots[i], NULL);
+
+    pa_xfree(s->nodes);
+    pa_xfree(s->freed_at);
+}
+
+pa_mempool* pa_mempool_new_full(pa_bool_t shared, pa_bool_t memfd, size_t size, size_t slot_size, size_t small_slot_size) {
     pa_mempool *p;
-    char t1[PA_BYTES_SNPRINT_MAX], t2[PA_BYTES_SNPRINT_MAX];
+    size_t large_size, small_size;
+    char t1[PA_BYTES_SNPRINT_MAX], t2[PA_BYTES_SNPRINT_MAX], t3[PA_BYTES_SNPRINT_MAX];
 
     p = pa_xnew(pa_mempool, 1);
+    PA_REFCNT_INIT(p);
 
-    p->block_size = PA_PAGE_ALIGN(PA_MEMPOOL_SLOT_SIZE);
-    if (p->block_size < PA_PAGE_SIZE)
-        p->block_size = PA_PAGE_SIZE;
+    p->slots.block_size = PA_PAGE_ALIGN(slot_size > 0 ? slot_size : PA_MEMPOOL_SLOT_SIZE);
+    if (p->slots.block_size < PA_PAGE_SIZE)
+        p->slots.block_size = PA_PAGE_SIZE;
 
     if (size <= 0)
-        p->n_blocks = PA_MEMPOOL_SLOTS_MAX;
-    else {
-        p->n_blocks = (unsigned) (size / p->block_size);
+        size = PA_MEMPOOL_SLOTS_MAX * PA_MEMPOOL_SLOT_SIZE;
+
+    p->slots.n_blocks = (unsigned) (size / p->slots.block_size);
+
+    if (p->slots.n_blocks < 2)
+        p->slots.n_blocks = 2;
+
+    large_size = p->slots.n_blocks * p->slots.block_size;
 
-        if (p->n_blocks < 2)
-            p->n_blocks = 2;
+    /* There are as many small slots as there are large ones. They
+     * only make sense if they are actually smaller and still have
+     * some room left after the block header. */
+    p->small_slots.block_size = 0;
+    p->small_slots.n_blocks = 0;
+
+    if (small_slot_size > 0) {
+        small_slot_size = PA_ALIGN(small_slot_size);
+
+        if (small_slot_size >= p->slots.block_size || small_slot_size <= 2 * PA_ALIGN(sizeof(pa_memblock)))
+            pa_log_warn("Ignoring invalid small slot size %lu.", (unsigned long) small_slot_size);
+        else {
+            p->small_slots.block_size = small_slot_size;
+            p->small_slots.n_blocks = p->slots.n_blocks;
+        }
     }
 
-    if (pa_shm_create_rw(&p->memory, p->n_blocks * p->block_size, shared, 0700) < 0) {
+    small_size = PA_PAGE_ALIGN(p->small_slots.n_blocks * p->small_slots.block_size);
+
+    if (memfd) {
+        if (pa_shm_create_memfd(&p->memory, large_size + small_size) < 0) {
+            pa_xfree(p);
+            return NULL;
+        }
+    } else if (pa_shm_create_rw(&p->memory, large_size + small_size, shared, 0700) < 0) {
         pa_xfree(p);
         return NULL;
     }
 
+    p->slots.ptr = p->memory.ptr;
+    p->small_slots.ptr = (uint8_t*) p->memory.ptr + large_size;
+
+    p->n_nodes = count_nodes();
+
     pa_log_debug("Using %s memory pool with %u slots of size %s each, total size is %s, maximum usable slot size is %lu",
-                 p->memory.shared ? "shared" : "private",
-                 p->n_blocks,
-                 pa_bytes_snprint(t1, sizeof(t1), (unsigned) p->block_size),
-                 pa_bytes_snprint(t2, sizeof(t2), (unsigned) (p->n_blocks * p->block_size)),
+                 p->memory.memfd ? "memfd shared" : (p->memory.shared ? "shared" : "private"),
+                 p->slots.n_blocks,
+                 pa_bytes_snprint(t1, sizeof(t1), (unsigned) p->slots.block_size),
+                 pa_bytes_snprint(t2, sizeof(t2), (unsigned) p->memory.size),
                  (unsigned long) pa_mempool_block_size_max(p));
 
+    if (p->small_slots.n_blocks > 0)
+        pa_log_debug("Memory pool has %u additional small slots of size %s each",
+                     p->small_slots.n_blocks,
+                     pa_bytes_snprint(t3, sizeof(t3), (unsigned) p->small_slots.block_size));
+
+    if (p->n_nodes > 1)
+        pa_log_debug("Keeping the free slots apart for %u NUMA nodes", p->n_nodes);
+
     memset(&p->stat, 0, sizeof(p->stat));
-    pa_atomic_store(&p->n_init, 0);
+    pa_atomic_store(&p->slots.n_init, 0);
+    pa_atomic_store(&p->small_slots.n_init, 0);
+    pa_atomic_store(&p->reclaim_tick, 1);
 
     PA_LLIST_HEAD_INIT(pa_memimport, p->imports);
     PA_LLIST_HEAD_INIT(pa_memexport, p->exports);
@@ -745,12 +982,21 @@ pa_mempool* pa_mempool_new(pa_bool_t shared, size_t size) {
     p->mutex = pa_mutex_new(TRUE, TRUE);
     p->semaphore = pa_semaphore_new(0);
 
-    p->free_slots = pa_flist_new(p->n_blocks);
+    mempool_slots_init(p, &p->slots);
+    mempool_slots_init(p, &p->small_slots);
 
     return p;
 }
 
-void pa_mempool_free(pa_mempool *p) {
+pa_mempool* pa_mempool_new(pa_bool_t shared, size_t size) {
+    return pa_mempool_new_full(shared, FALSE, size, 0, 0);
+}
+
+pa_mempool* pa_mempool_new_memfd(size_t size) {
+    return pa_mempool_new_full(TRUE, TRUE, size, 0, 0);
+}
+
+static void mempool_free(pa_mempool *p) {
     pa_assert(p);
 
     pa_mutex_lock(p->mutex);
@@ -763,8 +1009,6 @@ void pa_mempool_free(pa_mempool *p) {
 
     pa_mutex_unlock(p->mutex);
 
-    pa_flist_free(p->free_slots, NULL);
-
     if (pa_atomic_load(&p->stat.n_allocated) > 0) {
 
         /* Ouch, somebody is retaining a memory block reference! */
@@ -775,16 +1019,16 @@ void pa_mempool_free(pa_mempool *p) {
 
         /* Let's try to find at least one of those leaked memory blocks */
 
-        list = pa_flist_new(p->n_blocks);
+        list = pa_flist_new(p->slots.n_blocks);
 
-        for (i = 0; i < (unsigned) pa_atomic_load(&p->n_init); i++) {
+        for (i = 0; i < (unsigned) pa_atomic_load(&p->slots.n_init); i++) {
             struct mempool_slot *slot;
             pa_memblock *b, *k;
 
-            slot = (struct mempool_slot*) ((uint8_t*) p->memory.ptr + (p->block_size * (size_t) i));
+            slot = (struct mempool_slot*) (p->slots.ptr + (p->slots.block_size * (size_t) i));
             b = mempool_slot_data(slot);
 
-            while ((k = pa_flist_pop(p->free_slots))) {
+            while ((k = pa_flist_pop(p->slots.free_slots[slot_node(&p->slots, slot)]))) {
                 while (pa_flist_push(list, k) < 0)
                     ;
 
@@ -796,7 +1040,7 @@ void pa_mempool_free(pa_mempool *p) {
                 pa_log("REF: Leaked memory block %p", b);
 
             while ((k = pa_flist_pop(list)))
-                while (pa_flist_push(p->free_slots, k) < 0)
+                while (pa_flist_push(p->slots.free_slots[slot_node(&p->slots, slot)], k) < 0)
                     ;
         }
 
@@ -809,6 +1053,9 @@ void pa_mempool_free(pa_mempool *p) {
 /*         PA_DEBUG_TRAP; */
     }
 
+    mempool_slots_done(p, &p->slots);
+    mempool_slots_done(p, &p->small_slots);
+
     pa_shm_free(&p->memory);
 
     pa_mutex_free(p->mutex);
@@ -817,6 +1064,34 @@ void pa_mempool_free(pa_mempool *p) {
     pa_xfree(p);
 }
 
+/* No lock necessary */
+pa_mempool* pa_mempool_ref(pa_mempool *p) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+    PA_REFCNT_INC(p);
+    return p;
+}
+
+/* No lock necessary */
+static void mempool_unref(pa_mempool *p) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+    if (PA_REFCNT_DEC(p) <= 0)
+        mempool_free(p);
+}
+
+void pa_mempool_free(pa_mempool *p) {
+    pa_assert(p);
+
+    if (pa_atomic_load(&p->stat.n_allocated) > 0)
+        pa_log_debug("Memory pool released while %u memory blocks are still in use, freeing it when they are gone.",
+                     pa_atomic_load(&p->stat.n_allocated));
+
+    mempool_unref(p);
+}
+
 /* No lock necessary */
 const pa_mempool_stat* pa_mempool_get_stat(pa_mempool *p) {
     pa_assert(p);
@@ -828,32 +1103,113 @@ const pa_mempool_stat* pa_mempool_get_stat(pa_mempool *p) {
 size_t pa_mempool_block_size_max(pa_mempool *p) {
     pa_assert(p);
 
-    return p->block_size - PA_ALIGN(sizeof(pa_memblock));
+    return p->slots.block_size - PA_ALIGN(sizeof(pa_memblock));
 }
 
 /* No lock necessary */
-void pa_mempool_vacuum(pa_mempool *p) {
+static void mempool_slots_vacuum(pa_mempool *p, struct mempool_slots *s) {
     struct mempool_slot *slot;
     pa_flist *list;
+    unsigned i;
 
     pa_assert(p);
+    pa_assert(s);
 
-    list = pa_flist_new(p->n_blocks);
+    if (s->n_blocks <= 0)
+        return;
+
+    list = pa_flist_new(s->n_blocks);
 
-    while ((slot = pa_flist_pop(p->free_slots)))
-        while (pa_flist_push(list, slot) < 0)
-            ;
+    for (i = 0; i < p->n_nodes; i++) {
 
-    while ((slot = pa_flist_pop(list))) {
-        pa_shm_punch(&p->memory, (size_t) ((uint8_t*) slot - (uint8_t*) p->memory.ptr), p->block_size);
+        while ((slot = pa_flist_pop(s->free_slots[i])))
+            while (pa_flist_push(list, slot) < 0)
+                ;
 
-        while (pa_flist_push(p->free_slots, slot))
-            ;
+        while ((slot = pa_flist_pop(list))) {
+            slot_punch(p, s, slot);
+
+            while (pa_flist_push(s->free_slots[i], slot))
+                ;
+        }
     }
 
     pa_flist_free(list, NULL);
 }
 
+/* No lock necessary */
+static void mempool_slots_reclaim(pa_mempool *p, struct mempool_slots *s, unsigned tick, size_t high_water) {
+    struct mempool_slot *slot;
+    pa_flist *list;
+    unsigned i;
+
+    pa_assert(p);
+    pa_assert(s);
+
+    if (s->n_blocks <= 0)
+        return;
+
+    list = pa_flist_new(s->n_blocks);
+
+    for (i = 0; i < p->n_nodes; i++) {
+
+        if ((size_t) pa_atomic_load(&p->stat.free_resident_size) <= high_water)
+            break;
+
+        while ((slot = pa_flist_pop(s->free_slots[i])))
+            while (pa_flist_push(list, slot) < 0)
+                ;
+
+        while ((slot = pa_flist_pop(list))) {
+            unsigned freed_at = s->freed_at[slot_idx(s, slot)];
+
+            if (freed_at != 0 &&
+                tick - freed_at >= PA_MEMPOOL_RECLAIM_AGE &&
+                (size_t) pa_atomic_load(&p->stat.free_resident_size) > high_water) {
+
+                slot_punch(p, s, slot);
+                pa_atomic_inc(&p->stat.n_reclaimed);
+                pa_atomic_add(&p->stat.reclaimed_size, (int) s->block_size);
+            }
+
+            while (pa_flist_push(s->free_slots[i], slot))
+                ;
+        }
+    }
+
+    pa_flist_free(list, NULL);
+}
+
+/* No lock necessary */
+pa_bool_t pa_mempool_reclaim(pa_mempool *p, size_t high_water) {
+    unsigned tick;
+
+    pa_assert(p);
+
+    tick = (unsigned) pa_atomic_inc(&p->reclaim_tick) + 1;
+
+    /* The large slots go first, they are what makes up for most of
+     * the memory */
+    mempool_slots_reclaim(p, &p->slots, tick, high_water);
+    mempool_slots_reclaim(p, &p->small_slots, tick, high_water);
+
+    return (size_t) pa_atomic_load(&p->stat.free_resident_size) > high_water;
+}
+
+void pa_mempool_enable_huge_pages(pa_mempool *p) {
+    pa_assert(p);
+
+    pa_shm_advise_huge_pages(&p->memory);
+}
+
+/* No lock necessary */
+void pa_mempool_vacuum(pa_mempool *p) {
+    pa_assert(p);
+
+    mempool_slots_vacuum(p, &p->slots);
+    mempool_slots_vacuum(p, &p->small_slots);
+}
+
 /* No lock necessary */
 int pa_mempool_get_shm_id(pa_mempool *p, uint32_t *id) {
     pa_assert(p);
@@ -873,6 +1229,13 @@ pa_bool_t pa_mempool_is_shared(pa_mempool *p) {
     return !!p->memory.shared;
 }
 
+/* No lock necessary */
+pa_bool_t pa_mempool_is_memfd(pa_mempool *p) {
+    pa_assert(p);
+
+    return !!p->memory.memfd;
+}
+
 /* For receiving blocks from other nodes */
 pa_memimport* pa_memimport_new(pa_mempool *p, pa_memimport_release_cb_t cb, void *userdata) {
     pa_memimport *i;
@@ -935,6 +1298,7 @@ static void segment_detach(pa_memimport_segment *seg) {
 void pa_memimport_free(pa_memimport *i) {
     pa_memexport *e;
     pa_memblock *b;
+    pa_memimport_segment *seg;
 
     pa_assert(i);
 
@@ -943,7 +1307,11 @@ void pa_memimport_free(pa_memimport *i) {
     while ((b = pa_hashmap_first(i->blocks)))
         memblock_replace_import(b);
 
-    pa_assert(pa_hashmap_size(i->segments) == 0);
+    while ((seg = pa_hashmap_first(i->segments))) {
+        pa_assert(seg->permanent);
+        pa_assert(seg->n_blocks == 0);
+        segment_detach(seg);
+    }
 
     pa_mutex_unlock(i->mutex);
 
@@ -965,6 +1333,47 @@ void pa_memimport_free(pa_memimport *i) {
     pa_xfree(i);
 }
 
+/* Self-locked */
+int pa_memimport_attach_memfd(pa_memimport *i, uint32_t shm_id, int fd) {
+    pa_memimport_segment *seg;
+    int r = -1;
+
+    pa_assert(i);
+    pa_assert(fd >= 0);
+
+    pa_mutex_lock(i->mutex);
+
+    if (pa_hashmap_get(i->segments, PA_UINT32_TO_PTR(shm_id))) {
+        pa_log_debug("memfd segment %u is already known.", shm_id);
+        pa_close(fd);
+        goto finish;
+    }
+
+    if (pa_hashmap_size(i->segments) >= PA_MEMIMPORT_SEGMENTS_MAX) {
+        pa_close(fd);
+        goto finish;
+    }
+
+    seg = pa_xnew0(pa_memimport_segment, 1);
+
+    if (pa_shm_attach_memfd(&seg->memory, shm_id, fd) < 0) {
+        pa_xfree(seg);
+        goto finish;
+    }
+
+    seg->import = i;
+    seg->permanent = TRUE;
+    seg->trap = pa_memtrap_add(seg->memory.ptr, seg->memory.size);
+
+    pa_hashmap_put(i->segments, PA_UINT32_TO_PTR(seg->memory.id), seg);
+    r = 0;
+
+finish:
+    pa_mutex_unlock(i->mutex);
+
+    return r;
+}
+
 /* Self-locked */
 pa_memblock* pa_memimport_get(pa_memimport *i, uint32_t block_id, uint32_t shm_id, size_t offset, size_t size) {
     pa_memblock *b = NULL;
@@ -979,7 +1388,7 @@ pa_memblock* pa_memimport_get(pa_memimport *i, uint32_t block_id, uint32_t shm_i
         goto finish;
     }
 
-    if (pa_hashmap_size(i->blocks) >= PA_MEMIMPORT_SLOTS_MAX)
+    if (pa_hashmap_size(i->blocks) >= PA_MEMIMPORT_BLOCKS_MAX)
         goto finish;
 
     if (!(seg = pa_hashmap_get(i->segments, PA_UINT32_TO_PTR(shm_id))))
@@ -993,7 +1402,7 @@ pa_memblock* pa_memimport_get(pa_memimport *i, uint32_t block_id, uint32_t shm_i
         b = pa_xnew(pa_memblock, 1);
 
     PA_REFCNT_INIT(b);
-    b->pool = i->pool;
+    b->pool = pa_mempool_ref(i->pool);
     b->type = PA_MEMBLOCK_IMPORTED;
     b->read_only = TRUE;
     b->is_silence = FALSE;
@@ -1049,9 +1458,9 @@ pa_memexport* pa_memexport_new(pa_mempool *p, pa_memexport_revoke_cb_t cb, void
     e = pa_xnew(pa_memexport, 1);
     e->mutex = pa_mutex_new(TRUE, TRUE);
     e->pool = p;
-    PA_LLIST_HEAD_INIT(struct memexport_slot, e->free_slots);
-    PA_LLIST_HEAD_INIT(struct memexport_slot, e->used_slots);
-    e->n_init = 0;
+    e->blocks = pa_hashmap_new(NULL, NULL);
+    e->next_id = 0;
+    e->max_blocks = PA_MEMEXPORT_BLOCKS_DEFAULT;
     e->revoke_cb = cb;
     e->userdata = userdata;
 
@@ -1061,22 +1470,46 @@ pa_memexport* pa_memexport_new(pa_mempool *p, pa_memexport_revoke_cb_t cb, void
     return e;
 }
 
+/* No lock necessary */
+static void memexport_block_done(pa_memexport *e, pa_memblock *b) {
+    pa_assert(pa_atomic_load(&e->pool->stat.n_exported) > 0);
+    pa_assert(pa_atomic_load(&e->pool->stat.exported_size) >= (int) b->length);
+
+    pa_atomic_dec(&e->pool->stat.n_exported);
+    pa_atomic_sub(&e->pool->stat.exported_size, (int) b->length);
+
+    pa_memblock_unref(b);
+}
+
 void pa_memexport_free(pa_memexport *e) {
+    pa_memblock *b;
+
     pa_assert(e);
 
     pa_mutex_lock(e->mutex);
-    while (e->used_slots)
-        pa_memexport_process_release(e, (uint32_t) (e->used_slots - e->slots));
+    while ((b = pa_hashmap_steal_first(e->blocks)))
+        memexport_block_done(e, b);
     pa_mutex_unlock(e->mutex);
 
     pa_mutex_lock(e->pool->mutex);
     PA_LLIST_REMOVE(pa_memexport, e->pool->exports, e);
     pa_mutex_unlock(e->pool->mutex);
 
+    pa_hashmap_free(e->blocks, NULL, NULL);
     pa_mutex_free(e->mutex);
     pa_xfree(e);
 }
 
+/* Self-locked */
+void pa_memexport_set_max_blocks(pa_memexport *e, unsigned n) {
+    pa_assert(e);
+    pa_assert(n > 0);
+
+    pa_mutex_lock(e->mutex);
+    e->max_blocks = n;
+    pa_mutex_unlock(e->mutex);
+}
+
 /* Self-locked */
 int pa_memexport_process_release(pa_memexport *e, uint32_t id) {
     pa_memblock *b;
@@ -1084,61 +1517,68 @@ int pa_memexport_process_release(pa_memexport *e, uint32_t id) {
     pa_assert(e);
 
     pa_mutex_lock(e->mutex);
+    b = pa_hashmap_remove(e->blocks, PA_UINT32_TO_PTR(id));
+    pa_mutex_unlock(e->mutex);
 
-    if (id >= e->n_init)
-        goto fail;
-
-    if (!e->slots[id].block)
-        goto fail;
+    if (!b)
+        return -1;
 
-    b = e->slots[id].block;
-    e->slots[id].block = NULL;
+/*     pa_log("Processing release for %u", id); */
 
-    PA_LLIST_REMOVE(struct memexport_slot, e->used_slots, &e->slots[id]);
-    PA_LLIST_PREPEND(struct memexport_slot, e->free_slots, &e->slots[id]);
+    memexport_block_done(e, b);
 
-    pa_mutex_unlock(e->mutex);
+    return 0;
+}
 
-/*     pa_log("Processing release for %u", id); */
+/* Self-locked */
+int pa_memexport_cancel(pa_memexport *e, uint32_t id) {
+    pa_memblock *b;
 
-    pa_assert(pa_atomic_load(&e->pool->stat.n_exported) > 0);
-    pa_assert(pa_atomic_load(&e->pool->stat.exported_size) >= (int) b->length);
+    pa_assert(e);
 
-    pa_atomic_dec(&e->pool->stat.n_exported);
-    pa_atomic_sub(&e->pool->stat.exported_size, (int) b->length);
+    pa_mutex_lock(e->mutex);
+    b = pa_hashmap_remove(e->blocks, PA_UINT32_TO_PTR(id));
+    pa_mutex_unlock(e->mutex);
 
-    pa_memblock_unref(b);
+    if (!b)
+        return -1;
 
-    return 0;
+    pa_atomic_inc(&e->pool->stat.n_export_failed);
+    pa_atomic_add(&e->pool->stat.export_failed_size, (int) b->length);
 
-fail:
-    pa_mutex_unlock(e->mutex);
+    memexport_block_done(e, b);
 
-    return -1;
+    return 0;
 }
 
 /* Self-locked */
 static void memexport_revoke_blocks(pa_memexport *e, pa_memimport *i) {
-    struct memexport_slot *slot, *next;
+    pa_memblock *b;
+    uint32_t *ids;
+    unsigned n = 0, k;
+    void *state = NULL;
+    const void *key;
+
     pa_assert(e);
     pa_assert(i);
 
     pa_mutex_lock(e->mutex);
 
-    for (slot = e->used_slots; slot; slot = next) {
-        uint32_t idx;
-        next = slot->next;
+    /* Releasing changes the hashmap, so look for the ids first */
+    ids = pa_xnew(uint32_t, pa_hashmap_size(e->blocks) + 1);
 
-        if (slot->block->type != PA_MEMBLOCK_IMPORTED ||
-            slot->block->per_type.imported.segment->import != i)
-            continue;
+    while ((b = pa_hashmap_iterate(e->blocks, &state, &key)))
+        if (b->type == PA_MEMBLOCK_IMPORTED && b->per_type.imported.segment->import == i)
+            ids[n++] = PA_PTR_TO_UINT32(key);
 
-        idx = (uint32_t) (slot - e->slots);
-        e->revoke_cb(e, idx, e->userdata);
-        pa_memexport_process_release(e, idx);
+    for (k = 0; k < n; k++) {
+        e->revoke_cb(e, ids[k], e->userdata);
+        pa_memexport_process_release(e, ids[k]);
     }
 
     pa_mutex_unlock(e->mutex);
+
+    pa_xfree(ids);
 }
 
 /* No lock necessary */
@@ -1148,12 +1588,14 @@ static pa_memblock *memblock_shared_copy(pa_mempool *p, pa_memblock *b) {
     pa_assert(p);
     pa_assert(b);
 
-    if (b->type == PA_MEMBLOCK_IMPORTED ||
-        b->type == PA_MEMBLOCK_POOL ||
-        b->type == PA_MEMBLOCK_POOL_EXTERNAL) {
-        pa_assert(b->pool == p);
+    if (b->pool == p &&
+        (b->type == PA_MEMBLOCK_IMPORTED ||
+         b->type == PA_MEMBLOCK_POOL ||
+         b->type == PA_MEMBLOCK_POOL_EXTERNAL))
         return pa_memblock_ref(b);
-    }
+
+    /* Blocks from other pools are copied, so that the other side only
+     * ever gets to see the segments of the pool we export from */
 
     if (!(n = pa_memblock_new_pool(p, b->length)))
         return NULL;
@@ -1163,9 +1605,9 @@ static pa_memblock *memblock_shared_copy(pa_mempool *p, pa_memblock *b) {
 }
 
 /* Self-locked */
-int pa_memexport_put(pa_memexport *e, pa_memblock *b, uint32_t *block_id, uint32_t *shm_id, size_t *offset, size_t * size) {
+int pa_memexport_put(pa_memexport *e, pa_memblock *b, uint32_t *block_id, uint32_t *shm_id, size_t *offset, size_t * size, int *memfd) {
     pa_shm *memory;
-    struct memexport_slot *slot;
+    size_t length;
     void *data;
 
     pa_assert(e);
@@ -1174,27 +1616,26 @@ int pa_memexport_put(pa_memexport *e, pa_memblock *b, uint32_t *block_id, uint32
     pa_assert(shm_id);
     pa_assert(offset);
     pa_assert(size);
-    pa_assert(b->pool == e->pool);
+    pa_assert(memfd);
+
+    length = b->length;
 
     if (!(b = memblock_shared_copy(e->pool, b)))
-        return -1;
+        goto fail;
 
     pa_mutex_lock(e->mutex);
 
-    if (e->free_slots) {
-        slot = e->free_slots;
-        PA_LLIST_REMOVE(struct memexport_slot, e->free_slots, slot);
-    } else if (e->n_init < PA_MEMEXPORT_SLOTS_MAX)
-        slot = &e->slots[e->n_init++];
-    else {
+    if (pa_hashmap_size(e->blocks) >= e->max_blocks) {
         pa_mutex_unlock(e->mutex);
         pa_memblock_unref(b);
-        return -1;
+        goto fail;
     }
 
-    PA_LLIST_PREPEND(struct memexport_slot, e->used_slots, slot);
-    slot->block = b;
-    *block_id = (uint32_t) (slot - e->slots);
+    while (pa_hashmap_get(e->blocks, PA_UINT32_TO_PTR(e->next_id)))
+        e->next_id++;
+
+    *block_id = e->next_id++;
+    pa_assert_se(pa_hashmap_put(e->blocks, PA_UINT32_TO_PTR(*block_id), b) == 0);
 
     pa_mutex_unlock(e->mutex);
 /*     pa_log("Got block id %u", *block_id); */
@@ -1216,6 +1657,7 @@ int pa_memexport_put(pa_memexport *e, pa_memblock *b, uint32_t *block_id, uint32
     *shm_id = memory->id;
     *offset = (size_t) ((uint8_t*) data - (uint8_t*) memory->ptr);
     *size = b->length;
+    *memfd = memory->memfd ? memory->fd : -1;
 
     pa_memblock_release(b);
 
@@ -1223,4 +1665,10 @@ int pa_memexport_put(pa_memexport *e, pa_memblock *b, uint32_t *block_id, uint32
     pa_atomic_add(&e->pool->stat.exported_size, (int) b->length);
 
     return 0;
+
+fail:
+    pa_atomic_inc(&e->pool->stat.n_export_failed);
+    pa_atomic_add(&e->pool->stat.export_failed_size, (int) length);
+
+    return -1;
 }
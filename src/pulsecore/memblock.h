@@ -52,6 +52,11 @@ typedef struct pa_memimport_segment pa_memimport_segment;
 typedef struct pa_memimport pa_memimport;
 typedef struct pa_memexport pa_memexport;
 
+/* The number of blocks a memexport hands out at a time unless told
+ * otherwise, and the number a memimport takes at most */
+#define PA_MEMEXPORT_BLOCKS_DEFAULT 128
+#define PA_MEMIMPORT_BLOCKS_MAX 4096
+
 typedef void (*pa_memimport_release_cb_t)(pa_memimport *i, uint32_t block_id, void *userdata);
 typedef void (*pa_memexport_revoke_cb_t)(pa_memexport *e, uint32_t block_id, void *userdata);
 
@@ -72,6 +77,18 @@ struct pa_mempool_stat {
     pa_atomic_t n_too_large_for_pool;
     pa_atomic_t n_pool_full;
 
+    /* Blocks that could not be exported, and were hence copied into
+     * the socket instead */
+    pa_atomic_t n_export_failed;
+    pa_atomic_t export_failed_size;
+
+    /* Free slots that still hold their pages, and the slots whose
+     * pages were given back by pa_mempool_reclaim() */
+    pa_atomic_t n_free_resident;
+    pa_atomic_t free_resident_size;
+    pa_atomic_t n_reclaimed;
+    pa_atomic_t reclaimed_size;
+
     pa_atomic_t n_allocated_by_type[PA_MEMBLOCK_TYPE_MAX];
     pa_atomic_t n_accumulated_by_type[PA_MEMBLOCK_TYPE_MAX];
 };
@@ -103,6 +120,15 @@ manually if called from more than one thread at the same time.  */
 void pa_memblock_unref_fixed(pa_memblock*b);
 
 pa_bool_t pa_memblock_is_read_only(pa_memblock *b);
+
+/* TRUE if the memory is shared with the peer that sent the block */
+pa_bool_t pa_memblock_is_imported(pa_memblock *b);
+
+/* TRUE if the memory stays where it is and unchanged for as long as a
+ * reference to the block is held, which imported and fixed memory may
+ * not */
+pa_bool_t pa_memblock_is_stable(pa_memblock *b);
+
 pa_bool_t pa_memblock_is_silence(pa_memblock *b);
 pa_bool_t pa_memblock_ref_is_one(pa_memblock *b);
 void pa_memblock_set_is_silence(pa_memblock *b, pa_bool_t v);
@@ -114,25 +140,66 @@ pa_mempool * pa_memblock_get_pool(pa_memblock *b);
 
 pa_memblock *pa_memblock_will_need(pa_memblock *b);
 
-/* The memory block manager */
+/* The memory block manager. Every memory block keeps a reference to
+ * the pool it was allocated from, pa_mempool_free() only drops the
+ * reference of the creator. */
 pa_mempool* pa_mempool_new(pa_bool_t shared, size_t size);
+pa_mempool* pa_mempool_new_memfd(size_t size);
+
+/* size is the space for the regular slots, 0 for the default of
+ * 64 MiB. slot_size is rounded up to full pages, 0 for the default of
+ * 64 KiB. If small_slot_size is not 0, the same number of smaller
+ * slots is added, and blocks that fit are taken from those first. */
+pa_mempool* pa_mempool_new_full(pa_bool_t shared, pa_bool_t memfd, size_t size, size_t slot_size, size_t small_slot_size);
 void pa_mempool_free(pa_mempool *p);
+pa_mempool* pa_mempool_ref(pa_mempool *p);
 const pa_mempool_stat* pa_mempool_get_stat(pa_mempool *p);
 void pa_mempool_vacuum(pa_mempool *p);
+
+/* How many calls of pa_mempool_reclaim() a free slot has to sit out
+ * before its pages are given back */
+#define PA_MEMPOOL_RECLAIM_AGE 2
+
+/* Meant to be called at regular intervals. Gives back the pages of
+ * free slots that haven't been used for PA_MEMPOOL_RECLAIM_AGE calls,
+ * until no more than high_water bytes of free slots are resident.
+ * Returns TRUE if there is more than that still, so that calling again
+ * later may give back more. */
+pa_bool_t pa_mempool_reclaim(pa_mempool *p, size_t high_water);
 int pa_mempool_get_shm_id(pa_mempool *p, uint32_t *id);
 pa_bool_t pa_mempool_is_shared(pa_mempool *p);
+pa_bool_t pa_mempool_is_memfd(pa_mempool *p);
 size_t pa_mempool_block_size_max(pa_mempool *p);
 
+/* Ask for the memory of the pool to be backed by transparent huge
+ * pages. Only has an effect on the parts not used yet. */
+void pa_mempool_enable_huge_pages(pa_mempool *p);
+
 /* For receiving blocks from other nodes */
 pa_memimport* pa_memimport_new(pa_mempool *p, pa_memimport_release_cb_t cb, void *userdata);
 void pa_memimport_free(pa_memimport *i);
 pa_memblock* pa_memimport_get(pa_memimport *i, uint32_t block_id, uint32_t shm_id, size_t offset, size_t size);
 int pa_memimport_process_revoke(pa_memimport *i, uint32_t block_id);
 
+/* Make a memfd segment we received from the other side known, so that
+ * blocks referencing shm_id can be imported. Takes ownership of fd. */
+int pa_memimport_attach_memfd(pa_memimport *i, uint32_t shm_id, int fd);
+
 /* For sending blocks to other nodes */
 pa_memexport* pa_memexport_new(pa_mempool *p, pa_memexport_revoke_cb_t cb, void *userdata);
 void pa_memexport_free(pa_memexport *e);
-int pa_memexport_put(pa_memexport *e, pa_memblock *b, uint32_t *block_id, uint32_t *shm_id, size_t *offset, size_t *size);
+/* If the block lives in a memfd segment, *memfd is set to its fd, which
+ * the other side needs to receive before it can import the block. It
+ * is -1 otherwise. */
+int pa_memexport_put(pa_memexport *e, pa_memblock *b, uint32_t *block_id, uint32_t *shm_id, size_t *offset, size_t *size, int *memfd);
 int pa_memexport_process_release(pa_memexport *e, uint32_t id);
 
+/* Like pa_memexport_process_release(), for a block that was put but
+ * then not sent after all. Counts as a failed export. */
+int pa_memexport_cancel(pa_memexport *e, uint32_t id);
+
+/* Limits the number of blocks handed out at a time, which must not be
+ * more than the other side can import */
+void pa_memexport_set_max_blocks(pa_memexport *e, unsigned n);
+
 #endif
@@ -33,15 +33,29 @@
 #include <pulsecore/mcalign.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/flist.h>
+#include <pulsecore/trace.h>
 
 #include "memblockq.h"
 
 /* #define MEMBLOCKQ_DEBUG */
 
+/* On top of the list of blocks we keep a skip list so that seeking to
+ * an arbitrary index doesn't have to walk all blocks in between. Every
+ * fourth block inserted takes part in the first lane, every sixteenth
+ * in the second one and so on. */
+#define SKIP_LANES 6
+
+/* If enabled, chunks up to this size are copied into a block of the
+ * queue's own when pushed, so that many small writes end up in a few
+ * list items */
+#define COALESCE_MAX 1024
+
 struct list_item {
     struct list_item *next, *prev;
     int64_t index;
     pa_memchunk chunk;
+    unsigned n_lanes;
+    struct list_item *skip[SKIP_LANES];
 };
 
 PA_STATIC_FLIST_DECLARE(list_items, 0, pa_xfree);
@@ -49,15 +63,28 @@ PA_STATIC_FLIST_DECLARE(list_items, 0, pa_xfree);
 struct pa_memblockq {
     struct list_item *blocks, *blocks_tail;
     struct list_item *current_read, *current_write;
-    unsigned n_blocks;
+    struct list_item *skip[SKIP_LANES];
+    unsigned n_blocks, n_inserted;
     size_t maxlength, tlength, base, prebuf, minreq, maxrewind;
     int64_t read_index, write_index;
     pa_bool_t in_prebuf;
     pa_memchunk silence;
     pa_mcalign *mcalign;
+    /* Only the part of the coalesce block after coalesce_used has never
+     * been in the queue, so that is where small chunks are copied to.
+     * It is given up whenever the queue runs empty. */
+    pa_bool_t coalesce_enabled;
+    pa_memblock *coalesce;
+    size_t coalesce_used;
     int64_t missing, requested;
     char *name;
     pa_sample_spec sample_spec;
+
+    /* The bytes of all list items, and how much of that the account
+     * was told about. The account is brought up to date at the end of
+     * the calls that add or drop blocks. */
+    size_t held, accounted;
+    pa_mem_account *account;
 };
 
 pa_memblockq* pa_memblockq_new(
@@ -80,7 +107,8 @@ pa_memblockq* pa_memblockq_new(
     bq->name = pa_xstrdup(name);
     bq->blocks = bq->blocks_tail = NULL;
     bq->current_read = bq->current_write = NULL;
-    bq->n_blocks = 0;
+    memset(bq->skip, 0, sizeof(bq->skip));
+    bq->n_blocks = bq->n_inserted = 0;
 
     bq->sample_spec = *sample_spec;
     bq->base = pa_frame_size(sample_spec);
@@ -110,6 +138,13 @@ pa_memblockq* pa_memblockq_new(
 
     bq->mcalign = pa_mcalign_new(bq->base);
 
+    bq->coalesce_enabled = FALSE;
+    bq->coalesce = NULL;
+    bq->coalesce_used = 0;
+
+    bq->held = bq->accounted = 0;
+    bq->account = NULL;
+
     return bq;
 }
 
@@ -118,6 +153,9 @@ void pa_memblockq_free(pa_memblockq* bq) {
 
     pa_memblockq_silence(bq);
 
+    if (bq->account)
+        pa_mem_account_unref(bq->account);
+
     if (bq->silence.memblock)
         pa_memblock_unref(bq->silence.memblock);
 
@@ -128,7 +166,89 @@ void pa_memblockq_free(pa_memblockq* bq) {
     pa_xfree(bq);
 }
 
+/* Returns the successor of q in the given lane, a NULL q standing for
+ * the head of the lane */
+static inline struct list_item *skip_next(pa_memblockq *bq, struct list_item *q, unsigned lane) {
+    return q ? q->skip[lane] : bq->skip[lane];
+}
+
+/* Stores the last item starting before idx for every lane */
+static void skip_find(pa_memblockq *bq, int64_t idx, struct list_item *update[SKIP_LANES]) {
+    struct list_item *q = NULL, *n;
+    unsigned lane = SKIP_LANES;
+
+    while (lane-- > 0) {
+        while ((n = skip_next(bq, q, lane)) && n->index < idx)
+            q = n;
+
+        update[lane] = q;
+    }
+}
+
+/* Links an item that has just been added to the list of blocks into
+ * the lanes */
+static void skip_insert(pa_memblockq *bq, struct list_item *q) {
+    struct list_item *update[SKIP_LANES];
+    unsigned i, lane;
+
+    q->n_lanes = 0;
+    for (i = ++bq->n_inserted; (i & 3) == 0 && q->n_lanes < SKIP_LANES; i >>= 2)
+        q->n_lanes++;
+
+    if (PA_LIKELY(q->n_lanes == 0))
+        return;
+
+    skip_find(bq, q->index, update);
+
+    for (lane = 0; lane < q->n_lanes; lane++) {
+        q->skip[lane] = skip_next(bq, update[lane], lane);
+
+        if (update[lane])
+            update[lane]->skip[lane] = q;
+        else
+            bq->skip[lane] = q;
+    }
+}
+
+static void skip_remove(pa_memblockq *bq, struct list_item *q) {
+    struct list_item *update[SKIP_LANES];
+    unsigned lane;
+
+    if (PA_LIKELY(q->n_lanes == 0))
+        return;
+
+    skip_find(bq, q->index, update);
+
+    for (lane = 0; lane < q->n_lanes; lane++) {
+        pa_assert(skip_next(bq, update[lane], lane) == q);
+
+        if (update[lane])
+            update[lane]->skip[lane] = q->skip[lane];
+        else
+            bq->skip[lane] = q->skip[lane];
+    }
+}
+
+/* Returns the last block starting at or before idx, or NULL if there
+ * is none */
+static struct list_item *find_block(pa_memblockq *bq, int64_t idx) {
+    struct list_item *q = NULL, *n;
+    unsigned lane = SKIP_LANES;
+
+    while (lane-- > 0)
+        while ((n = skip_next(bq, q, lane)) && n->index <= idx)
+            q = n;
+
+    /* Only a few blocks are left between two items of the lowest lane */
+    while ((n = q ? q->next : bq->blocks) && n->index <= idx)
+        q = n;
+
+    return q;
+}
+
 static void fix_current_read(pa_memblockq *bq) {
+    struct list_item *q;
+
     pa_assert(bq);
 
     if (PA_UNLIKELY(!bq->blocks)) {
@@ -136,20 +256,25 @@ static void fix_current_read(pa_memblockq *bq) {
         return;
     }
 
-    if (PA_UNLIKELY(!bq->current_read))
-        bq->current_read = bq->blocks;
+    /* Most of the time we are still in the same block or just moved on
+     * to the next one */
+    if (PA_LIKELY((q = bq->current_read) != NULL) && PA_LIKELY(q->index <= bq->read_index)) {
 
-    /* Scan left */
-    while (PA_UNLIKELY(bq->current_read->index > bq->read_index))
+        if (q->index + (int64_t) q->chunk.length <= bq->read_index)
+            q = q->next;
 
-        if (bq->current_read->prev)
-            bq->current_read = bq->current_read->prev;
-        else
-            break;
+        if (!q || q->index + (int64_t) q->chunk.length > bq->read_index) {
+            bq->current_read = q;
+            return;
+        }
+    }
 
-    /* Scan right */
-    while (PA_LIKELY(bq->current_read != NULL) && PA_UNLIKELY(bq->current_read->index + (int64_t) bq->current_read->chunk.length <= bq->read_index))
-        bq->current_read = bq->current_read->next;
+    if (!(q = find_block(bq, bq->read_index)))
+        q = bq->blocks;
+    else if (q->index + (int64_t) q->chunk.length <= bq->read_index)
+        q = q->next;
+
+    bq->current_read = q;
 
     /* At this point current_read will either point at or left of the
        next block to play. It may be NULL in case everything in
@@ -157,6 +282,8 @@ static void fix_current_read(pa_memblockq *bq) {
 }
 
 static void fix_current_write(pa_memblockq *bq) {
+    struct list_item *q;
+
     pa_assert(bq);
 
     if (PA_UNLIKELY(!bq->blocks)) {
@@ -164,20 +291,13 @@ static void fix_current_write(pa_memblockq *bq) {
         return;
     }
 
-    if (PA_UNLIKELY(!bq->current_write))
-        bq->current_write = bq->blocks_tail;
-
-    /* Scan right */
-    while (PA_UNLIKELY(bq->current_write->index + (int64_t) bq->current_write->chunk.length <= bq->write_index))
-
-        if (bq->current_write->next)
-            bq->current_write = bq->current_write->next;
-        else
-            break;
+    /* Usually we are appending to the last block */
+    if (PA_LIKELY((q = bq->current_write) != NULL) &&
+        PA_LIKELY(q->index <= bq->write_index) &&
+        PA_LIKELY(!q->next || q->next->index > bq->write_index))
+        return;
 
-    /* Scan left */
-    while (PA_LIKELY(bq->current_write != NULL) && PA_UNLIKELY(bq->current_write->index > bq->write_index))
-        bq->current_write = bq->current_write->prev;
+    bq->current_write = find_block(bq, bq->write_index);
 
     /* At this point current_write will either point at or right of
        the next block to write data to. It may be NULL in case
@@ -190,6 +310,8 @@ static void drop_block(pa_memblockq *bq, struct list_item *q) {
 
     pa_assert(bq->n_blocks >= 1);
 
+    skip_remove(bq, q);
+
     if (q->prev)
         q->prev->next = q->next;
     else {
@@ -211,11 +333,27 @@ static void drop_block(pa_memblockq *bq, struct list_item *q) {
         bq->current_read = q->next;
 
     pa_memblock_unref(q->chunk.memblock);
+    bq->held -= q->chunk.length;
 
     if (pa_flist_push(PA_STATIC_FLIST_GET(list_items), q) < 0)
         pa_xfree(q);
 
     bq->n_blocks--;
+
+    if (!bq->blocks && bq->coalesce) {
+        pa_memblock_unref(bq->coalesce);
+        bq->coalesce = NULL;
+    }
+}
+
+static void update_account(pa_memblockq *bq) {
+    pa_assert(bq);
+
+    if (!bq->account || bq->held == bq->accounted)
+        return;
+
+    pa_mem_account_add(bq->account, (int) ((int64_t) bq->held - (int64_t) bq->accounted));
+    bq->accounted = bq->held;
 }
 
 static void drop_backlog(pa_memblockq *bq) {
@@ -282,6 +420,36 @@ static void read_index_changed(pa_memblockq *bq, int64_t old_read_index) {
 #endif
 }
 
+/* Replaces chunk by a copy in the coalesce block. Copies that are
+ * pushed one after another end up next to each other there, so that
+ * pa_memblockq_push() merges them into one list item. */
+static void coalesce_chunk(pa_memblockq *bq, pa_memchunk *chunk) {
+    void *src, *dst;
+
+    if (bq->coalesce && bq->coalesce_used + chunk->length > pa_memblock_get_length(bq->coalesce)) {
+        pa_memblock_unref(bq->coalesce);
+        bq->coalesce = NULL;
+    }
+
+    if (!bq->coalesce) {
+        bq->coalesce = pa_memblock_new(pa_memblock_get_pool(chunk->memblock), (size_t) -1);
+        bq->coalesce_used = 0;
+
+        if (chunk->length > pa_memblock_get_length(bq->coalesce))
+            return;
+    }
+
+    src = pa_memblock_acquire(chunk->memblock);
+    dst = pa_memblock_acquire(bq->coalesce);
+    memcpy((uint8_t*) dst + bq->coalesce_used, (uint8_t*) src + chunk->index, chunk->length);
+    pa_memblock_release(bq->coalesce);
+    pa_memblock_release(chunk->memblock);
+
+    chunk->memblock = bq->coalesce;
+    chunk->index = bq->coalesce_used;
+    bq->coalesce_used += chunk->length;
+}
+
 int pa_memblockq_push(pa_memblockq* bq, const pa_memchunk *uchunk) {
     struct list_item *q, *n;
     pa_memchunk chunk;
@@ -362,6 +530,7 @@ int pa_memblockq_push(pa_memblockq* bq, const pa_memchunk *uchunk) {
 
                 /* Drop it from the new entry */
                 p->index = q->index + (int64_t) d;
+                p->chunk.index += d;
                 p->chunk.length -= d;
 
                 /* Add it to the list */
@@ -372,10 +541,13 @@ int pa_memblockq_push(pa_memblockq* bq, const pa_memchunk *uchunk) {
                     bq->blocks_tail = p;
                 q->next = p;
 
+                skip_insert(bq, p);
                 bq->n_blocks++;
+                bq->held += p->chunk.length;
             }
 
             /* Truncate the chunk */
+            bq->held -= q->chunk.length - (size_t) (bq->write_index - q->index);
             if (!(q->chunk.length = (size_t) (bq->write_index - q->index))) {
                 struct list_item *p;
                 p = q;
@@ -398,11 +570,23 @@ int pa_memblockq_push(pa_memblockq* bq, const pa_memchunk *uchunk) {
             q->index += (int64_t) d;
             q->chunk.index += d;
             q->chunk.length -= d;
+            bq->held -= d;
 
             q = q->prev;
         }
     }
 
+    /* Chunks that continue the previous item in the same block merge
+     * with it anyway */
+    if (bq->coalesce_enabled &&
+        chunk.length <= COALESCE_MAX &&
+        !pa_memblock_is_silence(chunk.memblock) &&
+        !(q &&
+          q->chunk.memblock == chunk.memblock &&
+          q->chunk.index + q->chunk.length == chunk.index &&
+          bq->write_index == q->index + (int64_t) q->chunk.length))
+        coalesce_chunk(bq, &chunk);
+
     if (q) {
         pa_assert(bq->write_index >=  q->index + (int64_t)q->chunk.length);
         pa_assert(!q->next || (bq->write_index + (int64_t)chunk.length <= q->next->index));
@@ -414,6 +598,7 @@ int pa_memblockq_push(pa_memblockq* bq, const pa_memchunk *uchunk) {
             bq->write_index == q->index + (int64_t) q->chunk.length) {
 
             q->chunk.length += chunk.length;
+            bq->held += chunk.length;
             bq->write_index += (int64_t) chunk.length;
             goto finish;
         }
@@ -441,11 +626,16 @@ int pa_memblockq_push(pa_memblockq* bq, const pa_memchunk *uchunk) {
     else
         bq->blocks = n;
 
+    skip_insert(bq, n);
     bq->n_blocks++;
+    bq->held += n->chunk.length;
 
 finish:
 
     write_index_changed(bq, old, TRUE);
+    update_account(bq);
+
+    pa_trace(PA_TRACE_MEMBLOCKQ_PUSH, chunk.length, (uint64_t) (bq->write_index - bq->read_index));
     return 0;
 }
 
@@ -648,6 +838,7 @@ void pa_memblockq_drop(pa_memblockq *bq, size_t length) {
 
     drop_backlog(bq);
     read_index_changed(bq, old);
+    update_account(bq);
 }
 
 void pa_memblockq_rewind(pa_memblockq *bq, size_t length) {
@@ -722,6 +913,7 @@ void pa_memblockq_seek(pa_memblockq *bq, int64_t offset, pa_seek_mode_t seek, pa
 
     drop_backlog(bq);
     write_index_changed(bq, old, account);
+    update_account(bq);
 }
 
 void pa_memblockq_flush_write(pa_memblockq *bq, pa_bool_t account) {
@@ -1030,6 +1222,41 @@ void pa_memblockq_silence(pa_memblockq *bq) {
         drop_block(bq, bq->blocks);
 
     pa_assert(bq->n_blocks == 0);
+    pa_assert(bq->held == 0);
+    pa_assert(!bq->coalesce);
+
+    update_account(bq);
+}
+
+void pa_memblockq_set_coalesce(pa_memblockq *bq, pa_bool_t enabled) {
+    pa_assert(bq);
+
+    bq->coalesce_enabled = enabled;
+
+    if (!enabled && bq->coalesce) {
+        pa_memblock_unref(bq->coalesce);
+        bq->coalesce = NULL;
+    }
+}
+
+void pa_memblockq_set_mem_account(pa_memblockq *bq, pa_mem_account *a) {
+    pa_assert(bq);
+
+    if (bq->account) {
+        pa_mem_account_add(bq->account, -(int) bq->accounted);
+        pa_mem_account_unref(bq->account);
+    }
+
+    bq->accounted = 0;
+
+    if ((bq->account = a ? pa_mem_account_ref(a) : NULL))
+        update_account(bq);
+}
+
+size_t pa_memblockq_get_held(pa_memblockq *bq) {
+    pa_assert(bq);
+
+    return bq->held;
 }
 
 unsigned pa_memblockq_get_nblocks(pa_memblockq *bq) {
@@ -27,6 +27,7 @@
 
 #include <pulsecore/memblock.h>
 #include <pulsecore/memchunk.h>
+#include <pulsecore/mem-account.h>
 #include <pulse/def.h>
 
 /* A memblockq is a queue of pa_memchunks (yepp, the name is not
@@ -193,4 +194,18 @@ pa_bool_t pa_memblockq_prebuf_active(pa_memblockq *bq);
 /* Return how many items are currently stored in the queue */
 unsigned pa_memblockq_get_nblocks(pa_memblockq *bq);
 
+/* If enabled, small chunks are copied into a block of the queue's own
+ * when pushed, so that many small writes don't leave one item each in
+ * the queue. The queue then doesn't hold on to the blocks of the
+ * caller, so don't enable this if the caller relies on that. Disabled
+ * by default. */
+void pa_memblockq_set_coalesce(pa_memblockq *bq, pa_bool_t enabled);
+
+/* Accounts for the data in the queue, including what is kept for
+ * rewinds, on a, which may be NULL. The queue keeps a reference. */
+void pa_memblockq_set_mem_account(pa_memblockq *bq, pa_mem_account *a);
+
+/* The bytes of audio the queue keeps, as they are accounted */
+size_t pa_memblockq_get_held(pa_memblockq *bq);
+
 #endif
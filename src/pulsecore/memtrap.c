@@ -48,10 +48,16 @@ struct pa_memtrap {
     void *start;
     size_t size;
     pa_atomic_t bad;
-    pa_memtrap *next[2], *prev[2];
 };
 
-static pa_memtrap *memtraps[2] = { NULL, NULL };
+/* The traps ordered by their start address, so that the signal handler
+ * can look them up by bisection. There are two copies, see aupdate.h */
+struct trap_index {
+    pa_memtrap **traps;
+    unsigned n, n_allocated;
+};
+
+static struct trap_index indexes[2];
 static pa_aupdate *aupdate;
 static pa_static_mutex mutex = PA_STATIC_MUTEX_INIT; /* only required to serialize access to the write side */
 
@@ -61,6 +67,22 @@ static void allocate_aupdate(void) {
     } PA_ONCE_END;
 }
 
+/* Returns the number of traps that start at or before p. Signal safe. */
+static unsigned index_bisect(const struct trap_index *x, const void *p) {
+    unsigned l = 0, r = x->n;
+
+    while (l < r) {
+        unsigned k = l + (r - l) / 2;
+
+        if ((const uint8_t*) x->traps[k]->start <= (const uint8_t*) p)
+            l = k + 1;
+        else
+            r = k;
+    }
+
+    return l;
+}
+
 pa_bool_t pa_memtrap_is_good(pa_memtrap *m) {
     pa_assert(m);
 
@@ -74,18 +96,20 @@ static void sigsafe_error(const char *s) {
 }
 
 static void signal_handler(int sig, siginfo_t* si, void *data) {
-    unsigned j;
+    unsigned j, k;
     pa_memtrap *m;
     void *r;
 
     j = pa_aupdate_read_begin(aupdate);
 
-    for (m = memtraps[j]; m; m = m->next[j])
-        if (si->si_addr >= m->start &&
-            (uint8_t*) si->si_addr < (uint8_t*) m->start + m->size)
-            break;
+    /* The traps don't overlap, so only the last one starting before
+     * the address can contain it */
+    if ((k = index_bisect(&indexes[j], si->si_addr)) <= 0)
+        goto fail;
+
+    m = indexes[j].traps[k-1];
 
-    if (!m)
+    if ((uint8_t*) si->si_addr >= (uint8_t*) m->start + m->size)
         goto fail;
 
     pa_atomic_store(&m->bad, 1);
@@ -110,26 +134,44 @@ fail:
 #endif
 
 static void memtrap_link(pa_memtrap *m, unsigned j) {
-    pa_assert(m);
+    struct trap_index *x = &indexes[j];
+    unsigned k;
 
-    m->prev[j] = NULL;
+    pa_assert(m);
 
-    if ((m->next[j] = memtraps[j]))
-        m->next[j]->prev[j] = m;
+    if (x->n >= x->n_allocated) {
+        x->n_allocated = PA_MAX(16U, x->n_allocated * 2);
+        x->traps = pa_xrenew(pa_memtrap*, x->traps, x->n_allocated);
+    }
 
-    memtraps[j] = m;
+    k = index_bisect(x, m->start);
+    memmove(x->traps + k + 1, x->traps + k, (x->n - k) * sizeof(pa_memtrap*));
+    x->traps[k] = m;
+    x->n++;
 }
 
 static void memtrap_unlink(pa_memtrap *m, unsigned j) {
+    struct trap_index *x = &indexes[j];
+    unsigned k;
+
     pa_assert(m);
 
-    if (m->next[j])
-        m->next[j]->prev[j] = m->prev[j];
+    /* Find m among the traps that start where it does */
+    for (k = index_bisect(x, m->start); k > 0; k--)
+        if (x->traps[k-1] == m)
+            break;
+
+    pa_assert(k > 0);
+    k--;
 
-    if (m->prev[j])
-        m->prev[j]->next[j] = m->next[j];
-    else
-        memtraps[j] = m->next[j];
+    memmove(x->traps + k, x->traps + k + 1, (x->n - k - 1) * sizeof(pa_memtrap*));
+    x->n--;
+
+    if (x->n <= 0) {
+        pa_xfree(x->traps);
+        x->traps = NULL;
+        x->n_allocated = 0;
+    }
 }
 
 pa_memtrap* pa_memtrap_add(const void *start, size_t size) {
@@ -208,14 +250,18 @@ pa_memtrap *pa_memtrap_update(pa_memtrap *m, const void *start, size_t size) {
     if (m->start == start && m->size == size)
         goto unlock;
 
+    /* The position of m in the index depends on its start, hence take
+     * it out of both copies before changing it */
+    memtrap_unlink(m, j);
+    j = pa_aupdate_write_swap(aupdate);
     memtrap_unlink(m, j);
-    pa_aupdate_write_swap(aupdate);
 
     m->start = (void*) start;
     m->size = size;
     pa_atomic_store(&m->bad, 0);
 
-    pa_assert_se(pa_aupdate_write_swap(aupdate) == j);
+    memtrap_link(m, j);
+    j = pa_aupdate_write_swap(aupdate);
     memtrap_link(m, j);
 
 unlock:
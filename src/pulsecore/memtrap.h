@@ -35,7 +35,10 @@
  *
  * Intended usage is to handle memory mapped in which is controlled by
  * other processes that might execute ftruncate() or when mapping inb
- * hardware resources that might get invalidated when unplugged. */
+ * hardware resources that might get invalidated when unplugged.
+ *
+ * pa_memtrap_is_good() only looks at the trap itself. The signal
+ * handler finds the trap of the faulting address by bisection. */
 
 typedef struct pa_memtrap pa_memtrap;
 
@@ -0,0 +1,231 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/endianmacros.h>
+
+#include "cpu-x86.h"
+
+#include "sample-util.h"
+
+#if defined (PA_HAVE_X86_TARGET_ATTRIBUTE)
+
+#include <immintrin.h>
+
+/* These work like the SSE2 mixers, just with registers twice as wide. */
+
+static void mix_s16ne_tail(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned channel, int16_t *d, int16_t *e) {
+
+    for (; d < e; d++) {
+        int32_t sum = 0;
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32_t v, cv = m->linear[channel].i;
+
+            v = *((int16_t*) m->ptr);
+            sum += ((v * (cv & 0xFFFF)) >> 16) + (v * (cv >> 16));
+            m->ptr = (uint8_t*) m->ptr + sizeof(int16_t);
+        }
+
+        *d = (int16_t) PA_CLAMP_UNLIKELY(sum, -0x8000, 0x7FFF);
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void mix_s32ne_tail(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned channel, int32_t *d, int32_t *e) {
+
+    for (; d < e; d++) {
+        int64_t sum = 0;
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+
+            sum += ((int64_t) *((int32_t*) m->ptr) * m->linear[channel].i) >> 16;
+            m->ptr = (uint8_t*) m->ptr + sizeof(int32_t);
+        }
+
+        *d = (int32_t) PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void mix_float32ne_tail(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned channel, float *d, float *e) {
+
+    for (; d < e; d++) {
+        float sum = 0;
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+
+            sum += *((float*) m->ptr) * m->linear[channel].f;
+            m->ptr = (uint8_t*) m->ptr + sizeof(float);
+        }
+
+        *d = sum;
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+/* The AVX2 pack instructions work on each 128 bit lane separately, so
+ * the 64 bit quarters need to be put back in order afterwards. */
+PA_X86_TARGET("avx2")
+static inline void load_volume_s16_avx2(const int32_t *linear, __m256i *hi, __m256i *lo) {
+    __m256i v0, v1;
+
+    v0 = _mm256_loadu_si256((const __m256i*) linear);
+    v1 = _mm256_loadu_si256((const __m256i*) (linear + 8));
+
+    *hi = _mm256_packs_epi32(_mm256_srai_epi32(v0, 16), _mm256_srai_epi32(v1, 16));
+    *lo = _mm256_packs_epi32(_mm256_srai_epi32(_mm256_slli_epi32(v0, 16), 16),
+                             _mm256_srai_epi32(_mm256_slli_epi32(v1, 16), 16));
+
+    *hi = _mm256_permute4x64_epi64(*hi, 0xD8);
+    *lo = _mm256_permute4x64_epi64(*lo, 0xD8);
+}
+
+PA_X86_TARGET("avx2")
+static void pa_mix_s16ne_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    int16_t *d = data, *e = end;
+    unsigned channel = 0, step = 16 % channels;
+
+    for (; e - d >= 16; d += 16) {
+        __m256i sum0 = _mm256_setzero_si256(), sum1 = _mm256_setzero_si256();
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            __m256i s, hi, lo, l, pl, ph;
+
+            load_volume_s16_avx2(&m->linear[channel].i, &hi, &lo);
+            s = _mm256_loadu_si256((const __m256i*) m->ptr);
+
+            l = _mm256_sub_epi16(_mm256_mulhi_epu16(s, lo), _mm256_and_si256(_mm256_srai_epi16(s, 15), lo));
+            pl = _mm256_mullo_epi16(s, hi);
+            ph = _mm256_mulhi_epi16(s, hi);
+
+            /* Samples 0-3 and 8-11 end up in sum0, 4-7 and 12-15 in sum1,
+             * which is just the order the final pack expects. */
+            sum0 = _mm256_add_epi32(sum0, _mm256_add_epi32(_mm256_unpacklo_epi16(pl, ph), _mm256_srai_epi32(_mm256_unpacklo_epi16(l, l), 16)));
+            sum1 = _mm256_add_epi32(sum1, _mm256_add_epi32(_mm256_unpackhi_epi16(pl, ph), _mm256_srai_epi32(_mm256_unpackhi_epi16(l, l), 16)));
+
+            m->ptr = (uint8_t*) m->ptr + 16 * sizeof(int16_t);
+        }
+
+        _mm256_storeu_si256((__m256i*) d, _mm256_packs_epi32(sum0, sum1));
+
+        if ((channel += step) >= channels)
+            channel -= channels;
+    }
+
+    mix_s16ne_tail(streams, nstreams, channels, channel, d, e);
+}
+
+/* Like the SSE2 version this truncates only once after summing up all
+ * streams, so it may be off by up to one per stream. */
+PA_X86_TARGET("avx2")
+static void pa_mix_s32ne_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    int32_t *d = data, *e = end;
+    unsigned channel = 0, step = 8 % channels;
+    const __m256d scale = _mm256_set1_pd(1.0 / 0x10000);
+    const __m256d min = _mm256_set1_pd(-2147483648.0), max = _mm256_set1_pd(2147483647.0);
+
+    for (; e - d >= 8; d += 8) {
+        __m256d sum0 = _mm256_setzero_pd(), sum1 = _mm256_setzero_pd();
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            __m256i s, v;
+
+            s = _mm256_loadu_si256((const __m256i*) m->ptr);
+            v = _mm256_loadu_si256((const __m256i*) &m->linear[channel].i);
+
+            sum0 = _mm256_add_pd(sum0, _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(s)),
+                                                     _mm256_cvtepi32_pd(_mm256_castsi256_si128(v))));
+            sum1 = _mm256_add_pd(sum1, _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(s, 1)),
+                                                     _mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1))));
+
+            m->ptr = (uint8_t*) m->ptr + 8 * sizeof(int32_t);
+        }
+
+        sum0 = _mm256_min_pd(_mm256_max_pd(_mm256_mul_pd(sum0, scale), min), max);
+        sum1 = _mm256_min_pd(_mm256_max_pd(_mm256_mul_pd(sum1, scale), min), max);
+
+        _mm256_storeu_si256((__m256i*) d, _mm256_setr_m128i(_mm256_cvttpd_epi32(sum0), _mm256_cvttpd_epi32(sum1)));
+
+        if ((channel += step) >= channels)
+            channel -= channels;
+    }
+
+    mix_s32ne_tail(streams, nstreams, channels, channel, d, e);
+}
+
+PA_X86_TARGET("avx2")
+static void pa_mix_float32ne_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    float *d = data, *e = end;
+    unsigned channel = 0, step = 8 % channels;
+
+    for (; e - d >= 8; d += 8) {
+        __m256 sum = _mm256_setzero_ps();
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps((const float*) m->ptr), _mm256_loadu_ps(&m->linear[channel].f)));
+            m->ptr = (uint8_t*) m->ptr + 8 * sizeof(float);
+        }
+
+        _mm256_storeu_ps(d, sum);
+
+        if ((channel += step) >= channels)
+            channel -= channels;
+    }
+
+    mix_float32ne_tail(streams, nstreams, channels, channel, d, e);
+}
+#endif /* defined (PA_HAVE_X86_TARGET_ATTRIBUTE) */
+
+void pa_mix_func_init_avx(pa_cpu_x86_flag_t flags) {
+#if defined (PA_HAVE_X86_TARGET_ATTRIBUTE)
+
+    if (flags & PA_CPU_X86_AVX2) {
+        pa_log_info("Initialising AVX2 optimized mixers.");
+
+        pa_set_mix_func(PA_SAMPLE_S16NE, (pa_do_mix_func_t) pa_mix_s16ne_avx2);
+        pa_set_mix_func(PA_SAMPLE_S32NE, (pa_do_mix_func_t) pa_mix_s32ne_avx2);
+        pa_set_mix_func(PA_SAMPLE_FLOAT32NE, (pa_do_mix_func_t) pa_mix_float32ne_avx2);
+    }
+#endif /* defined (PA_HAVE_X86_TARGET_ATTRIBUTE) */
+}
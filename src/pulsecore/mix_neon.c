@@ -0,0 +1,203 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/endianmacros.h>
+
+#include "cpu-arm.h"
+
+#include "sample-util.h"
+
+#if defined (__arm__) && defined (__ARM_NEON__)
+
+#include <arm_neon.h>
+
+/* Four samples are mixed at a time, see mix_sse.c for how the channel
+ * is tracked. NEON has a widening signed 32x32 bit multiply, so unlike
+ * on x86 the integer versions give exactly the same result as the C
+ * mixers. */
+
+static void mix_s16ne_tail(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned channel, int16_t *d, int16_t *e) {
+
+    for (; d < e; d++) {
+        int32_t sum = 0;
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32_t v, cv = m->linear[channel].i;
+
+            v = *((int16_t*) m->ptr);
+            sum += ((v * (cv & 0xFFFF)) >> 16) + (v * (cv >> 16));
+            m->ptr = (uint8_t*) m->ptr + sizeof(int16_t);
+        }
+
+        *d = (int16_t) PA_CLAMP_UNLIKELY(sum, -0x8000, 0x7FFF);
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void mix_s32ne_tail(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned channel, int32_t *d, int32_t *e) {
+
+    for (; d < e; d++) {
+        int64_t sum = 0;
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+
+            sum += ((int64_t) *((int32_t*) m->ptr) * m->linear[channel].i) >> 16;
+            m->ptr = (uint8_t*) m->ptr + sizeof(int32_t);
+        }
+
+        *d = (int32_t) PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void mix_float32ne_tail(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned channel, float *d, float *e) {
+
+    for (; d < e; d++) {
+        float sum = 0;
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+
+            sum += *((float*) m->ptr) * m->linear[channel].f;
+            m->ptr = (uint8_t*) m->ptr + sizeof(float);
+        }
+
+        *d = sum;
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void pa_mix_s16ne_neon(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    int16_t *d = data, *e = end;
+    unsigned channel = 0, step = 4 % channels;
+
+    for (; e - d >= 4; d += 4) {
+        int32x4_t sum = vdupq_n_s32(0);
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32x4_t s, v;
+            int64x2_t p0, p1;
+
+            s = vmovl_s16(vld1_s16((const int16_t*) m->ptr));
+            v = vld1q_s32(&m->linear[channel].i);
+
+            /* The product of a 16 bit sample and a 16.16 factor always
+             * fits into 32 bits after the shift. */
+            p0 = vmull_s32(vget_low_s32(s), vget_low_s32(v));
+            p1 = vmull_s32(vget_high_s32(s), vget_high_s32(v));
+            sum = vaddq_s32(sum, vcombine_s32(vshrn_n_s64(p0, 16), vshrn_n_s64(p1, 16)));
+
+            m->ptr = (uint8_t*) m->ptr + 4 * sizeof(int16_t);
+        }
+
+        vst1_s16(d, vqmovn_s32(sum));
+
+        if ((channel += step) >= channels)
+            channel -= channels;
+    }
+
+    mix_s16ne_tail(streams, nstreams, channels, channel, d, e);
+}
+
+static void pa_mix_s32ne_neon(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    int32_t *d = data, *e = end;
+    unsigned channel = 0, step = 4 % channels;
+
+    for (; e - d >= 4; d += 4) {
+        int64x2_t sum0 = vdupq_n_s64(0), sum1 = vdupq_n_s64(0);
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32x4_t s, v;
+
+            s = vld1q_s32((const int32_t*) m->ptr);
+            v = vld1q_s32(&m->linear[channel].i);
+
+            sum0 = vaddq_s64(sum0, vshrq_n_s64(vmull_s32(vget_low_s32(s), vget_low_s32(v)), 16));
+            sum1 = vaddq_s64(sum1, vshrq_n_s64(vmull_s32(vget_high_s32(s), vget_high_s32(v)), 16));
+
+            m->ptr = (uint8_t*) m->ptr + 4 * sizeof(int32_t);
+        }
+
+        vst1q_s32(d, vcombine_s32(vqmovn_s64(sum0), vqmovn_s64(sum1)));
+
+        if ((channel += step) >= channels)
+            channel -= channels;
+    }
+
+    mix_s32ne_tail(streams, nstreams, channels, channel, d, e);
+}
+
+static void pa_mix_float32ne_neon(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    float *d = data, *e = end;
+    unsigned channel = 0, step = 4 % channels;
+
+    for (; e - d >= 4; d += 4) {
+        float32x4_t sum = vdupq_n_f32(0.0f);
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+
+            sum = vaddq_f32(sum, vmulq_f32(vld1q_f32((const float*) m->ptr), vld1q_f32(&m->linear[channel].f)));
+            m->ptr = (uint8_t*) m->ptr + 4 * sizeof(float);
+        }
+
+        vst1q_f32(d, sum);
+
+        if ((channel += step) >= channels)
+            channel -= channels;
+    }
+
+    mix_float32ne_tail(streams, nstreams, channels, channel, d, e);
+}
+#endif /* defined (__arm__) && defined (__ARM_NEON__) */
+
+void pa_mix_func_init_neon(pa_cpu_arm_flag_t flags) {
+#if defined (__arm__) && defined (__ARM_NEON__)
+
+    if (flags & PA_CPU_ARM_NEON) {
+        pa_log_info("Initialising NEON optimized mixers.");
+
+        pa_set_mix_func(PA_SAMPLE_S16NE, (pa_do_mix_func_t) pa_mix_s16ne_neon);
+        pa_set_mix_func(PA_SAMPLE_S32NE, (pa_do_mix_func_t) pa_mix_s32ne_neon);
+        pa_set_mix_func(PA_SAMPLE_FLOAT32NE, (pa_do_mix_func_t) pa_mix_float32ne_neon);
+    }
+#endif /* defined (__arm__) && defined (__ARM_NEON__) */
+}
@@ -0,0 +1,125 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulsecore/macro.h>
+#include <pulsecore/log.h>
+#include <pulsecore/sample-util.h>
+#include <pulsecore/mix-orc-gen.h>
+
+#include "cpu-orc.h"
+
+/* Samples are mixed in blocks of this many, see mix.orc */
+#define BLOCK_SAMPLES 256
+
+static pa_do_mix_func_t fallback_s16ne, fallback_float32ne;
+
+/* The C mixer leaves out factors that overflowed into the sign bit,
+ * the Orc code would take them as they are */
+static pa_bool_t volumes_fit(pa_mix_info streams[], unsigned nstreams, unsigned channels) {
+    unsigned i, c;
+
+    for (i = 0; i < nstreams; i++)
+        for (c = 0; c < channels; c++)
+            if (streams[i].linear[c].i < 0)
+                return FALSE;
+
+    return TRUE;
+}
+
+static void pa_mix_s16ne_orc(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    int32_t acc[BLOCK_SAMPLES];
+    int16_t *d = data, *e = end;
+
+    if (channels > 2 || !volumes_fit(streams, nstreams, channels)) {
+        fallback_s16ne(streams, nstreams, channels, data, end);
+        return;
+    }
+
+    while ((unsigned) (e - d) >= channels) {
+        unsigned i, n;
+
+        /* Whole frames only, so that each block starts with the first
+         * channel */
+        n = PA_MIN((unsigned) (e - d), BLOCK_SAMPLES) / channels;
+
+        memset(acc, 0, n * channels * sizeof(int32_t));
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+
+            if (channels == 2) {
+                int64_t v = (int64_t) m->linear[1].i << 32 | (uint32_t) m->linear[0].i;
+                pa_mix_s16ne_orc_2ch_add(acc, m->ptr, v, (int) n);
+            } else
+                pa_mix_s16ne_orc_1ch_add(acc, m->ptr, m->linear[0].i, (int) n);
+
+            m->ptr = (uint8_t*) m->ptr + n * channels * sizeof(int16_t);
+        }
+
+        pa_mix_s16ne_orc_pack(d, acc, (int) (n * channels));
+        d += n * channels;
+    }
+}
+
+static void pa_mix_float32ne_orc(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    float *d = data, *e = end;
+    unsigned i, n;
+
+    if (channels > 2) {
+        fallback_float32ne(streams, nstreams, channels, data, end);
+        return;
+    }
+
+    n = (unsigned) (e - d) / channels;
+    memset(d, 0, n * channels * sizeof(float));
+
+    for (i = 0; i < nstreams; i++) {
+        pa_mix_info *m = streams + i;
+
+        if (channels == 2) {
+            union {
+                float f[2];
+                int64_t v;
+            } vols;
+
+            vols.f[0] = m->linear[0].f;
+            vols.f[1] = m->linear[1].f;
+            pa_mix_float32ne_orc_2ch_add(d, m->ptr, vols.v, (int) n);
+        } else
+            pa_mix_float32ne_orc_1ch_add(d, m->ptr, m->linear[0].f, (int) n);
+
+        m->ptr = (uint8_t*) m->ptr + n * channels * sizeof(float);
+    }
+}
+
+void pa_mix_func_init_orc(void) {
+    pa_log_info("Initialising Orc optimized mixers.");
+
+    fallback_s16ne = pa_get_mix_func(PA_SAMPLE_S16NE);
+    fallback_float32ne = pa_get_mix_func(PA_SAMPLE_FLOAT32NE);
+
+    pa_set_mix_func(PA_SAMPLE_S16NE, (pa_do_mix_func_t) pa_mix_s16ne_orc);
+    pa_set_mix_func(PA_SAMPLE_FLOAT32NE, (pa_do_mix_func_t) pa_mix_float32ne_orc);
+}
@@ -0,0 +1,323 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/rtclock.h>
+
+#include <pulsecore/random.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/endianmacros.h>
+
+#include "cpu-x86.h"
+
+#include "sample-util.h"
+
+#if defined (PA_HAVE_X86_TARGET_ATTRIBUTE)
+
+#include <emmintrin.h>
+
+/* The mixers below work on one register's worth of samples at a time and
+ * keep track of the channel the register starts with. The volume factors
+ * for the whole register are loaded from the padded pa_mix_info.linear
+ * table starting at that channel. Whatever is left at the end is mixed
+ * one sample at a time. */
+
+static void mix_s16ne_tail(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned channel, int16_t *d, int16_t *e) {
+
+    for (; d < e; d++) {
+        int32_t sum = 0;
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32_t v, cv = m->linear[channel].i;
+
+            v = *((int16_t*) m->ptr);
+            sum += ((v * (cv & 0xFFFF)) >> 16) + (v * (cv >> 16));
+            m->ptr = (uint8_t*) m->ptr + sizeof(int16_t);
+        }
+
+        *d = (int16_t) PA_CLAMP_UNLIKELY(sum, -0x8000, 0x7FFF);
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void mix_s32ne_tail(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned channel, int32_t *d, int32_t *e) {
+
+    for (; d < e; d++) {
+        int64_t sum = 0;
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+
+            sum += ((int64_t) *((int32_t*) m->ptr) * m->linear[channel].i) >> 16;
+            m->ptr = (uint8_t*) m->ptr + sizeof(int32_t);
+        }
+
+        *d = (int32_t) PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void mix_float32ne_tail(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned channel, float *d, float *e) {
+
+    for (; d < e; d++) {
+        float sum = 0;
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+
+            sum += *((float*) m->ptr) * m->linear[channel].f;
+            m->ptr = (uint8_t*) m->ptr + sizeof(float);
+        }
+
+        *d = sum;
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+/* Splits the 16.16 fixed point factors of 8 consecutive samples into
+ * their integer and fractional parts, stored as 8 16 bit words each. */
+PA_X86_TARGET("sse2")
+static inline void load_volume_s16_sse2(const int32_t *linear, __m128i *hi, __m128i *lo) {
+    __m128i v0, v1;
+
+    v0 = _mm_loadu_si128((const __m128i*) linear);
+    v1 = _mm_loadu_si128((const __m128i*) (linear + 4));
+
+    *hi = _mm_packs_epi32(_mm_srai_epi32(v0, 16), _mm_srai_epi32(v1, 16));
+    /* Sign extend the low word first, so that the saturating pack
+     * keeps all 16 bits */
+    *lo = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(v0, 16), 16),
+                          _mm_srai_epi32(_mm_slli_epi32(v1, 16), 16));
+}
+
+PA_X86_TARGET("sse2")
+static void pa_mix_s16ne_sse2(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    int16_t *d = data, *e = end;
+    unsigned channel = 0, step = 8 % channels;
+
+    for (; e - d >= 8; d += 8) {
+        __m128i sum0 = _mm_setzero_si128(), sum1 = _mm_setzero_si128();
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            __m128i s, hi, lo, l, pl, ph;
+
+            load_volume_s16_sse2(&m->linear[channel].i, &hi, &lo);
+            s = _mm_loadu_si128((const __m128i*) m->ptr);
+
+            /* Same as the C version: (s * lo) >> 16 + s * hi. The
+             * unsigned high multiply needs to be corrected for negative
+             * samples. */
+            l = _mm_sub_epi16(_mm_mulhi_epu16(s, lo), _mm_and_si128(_mm_srai_epi16(s, 15), lo));
+            pl = _mm_mullo_epi16(s, hi);
+            ph = _mm_mulhi_epi16(s, hi);
+
+            sum0 = _mm_add_epi32(sum0, _mm_add_epi32(_mm_unpacklo_epi16(pl, ph), _mm_srai_epi32(_mm_unpacklo_epi16(l, l), 16)));
+            sum1 = _mm_add_epi32(sum1, _mm_add_epi32(_mm_unpackhi_epi16(pl, ph), _mm_srai_epi32(_mm_unpackhi_epi16(l, l), 16)));
+
+            m->ptr = (uint8_t*) m->ptr + 8 * sizeof(int16_t);
+        }
+
+        _mm_storeu_si128((__m128i*) d, _mm_packs_epi32(sum0, sum1));
+
+        if ((channel += step) >= channels)
+            channel -= channels;
+    }
+
+    mix_s16ne_tail(streams, nstreams, channels, channel, d, e);
+}
+
+/* SSE2 has no signed 32x32 bit multiply, so this is done in double
+ * precision, which is exact for all sane volumes. Unlike the C version
+ * the result is truncated once after summing up all streams instead of
+ * once per stream, so it may be off by up to one per stream. */
+PA_X86_TARGET("sse2")
+static void pa_mix_s32ne_sse2(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    int32_t *d = data, *e = end;
+    unsigned channel = 0, step = 4 % channels;
+    const __m128d scale = _mm_set1_pd(1.0 / 0x10000);
+    const __m128d min = _mm_set1_pd(-2147483648.0), max = _mm_set1_pd(2147483647.0);
+
+    for (; e - d >= 4; d += 4) {
+        __m128d sum0 = _mm_setzero_pd(), sum1 = _mm_setzero_pd();
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            __m128i s, v;
+
+            s = _mm_loadu_si128((const __m128i*) m->ptr);
+            v = _mm_loadu_si128((const __m128i*) &m->linear[channel].i);
+
+            sum0 = _mm_add_pd(sum0, _mm_mul_pd(_mm_cvtepi32_pd(s), _mm_cvtepi32_pd(v)));
+            sum1 = _mm_add_pd(sum1, _mm_mul_pd(_mm_cvtepi32_pd(_mm_unpackhi_epi64(s, s)),
+                                               _mm_cvtepi32_pd(_mm_unpackhi_epi64(v, v))));
+
+            m->ptr = (uint8_t*) m->ptr + 4 * sizeof(int32_t);
+        }
+
+        sum0 = _mm_min_pd(_mm_max_pd(_mm_mul_pd(sum0, scale), min), max);
+        sum1 = _mm_min_pd(_mm_max_pd(_mm_mul_pd(sum1, scale), min), max);
+
+        _mm_storeu_si128((__m128i*) d, _mm_unpacklo_epi64(_mm_cvttpd_epi32(sum0), _mm_cvttpd_epi32(sum1)));
+
+        if ((channel += step) >= channels)
+            channel -= channels;
+    }
+
+    mix_s32ne_tail(streams, nstreams, channels, channel, d, e);
+}
+
+PA_X86_TARGET("sse2")
+static void pa_mix_float32ne_sse2(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    float *d = data, *e = end;
+    unsigned channel = 0, step = 4 % channels;
+
+    for (; e - d >= 4; d += 4) {
+        __m128 sum = _mm_setzero_ps();
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps((const float*) m->ptr), _mm_loadu_ps(&m->linear[channel].f)));
+            m->ptr = (uint8_t*) m->ptr + 4 * sizeof(float);
+        }
+
+        _mm_storeu_ps(d, sum);
+
+        if ((channel += step) >= channels)
+            channel -= channels;
+    }
+
+    mix_float32ne_tail(streams, nstreams, channels, channel, d, e);
+}
+
+#undef RUN_TEST
+
+#ifdef RUN_TEST
+#define CHANNELS 3
+#define SAMPLES 1021
+#define STREAMS 4
+#define TIMES 1000
+
+static void run_test_format(pa_sample_format_t f, pa_do_mix_func_t func, const char *name) {
+    pa_sample_spec ss;
+    pa_mix_info m[STREAMS];
+    int16_t src[STREAMS][SAMPLES * 2];
+    int16_t out[SAMPLES * 2], out_ref[SAMPLES * 2];
+    pa_do_mix_func_t ref;
+    pa_usec_t start, stop;
+    unsigned i, j, c;
+    size_t length;
+
+    ref = pa_get_mix_func(f);
+
+    ss.format = f;
+    ss.rate = 44100;
+    ss.channels = CHANNELS;
+    length = pa_frame_align(SAMPLES * pa_sample_size(&ss), &ss);
+
+    pa_random(src, sizeof(src));
+
+    for (i = 0; i < STREAMS; i++) {
+        if (f == PA_SAMPLE_FLOAT32NE)
+            for (j = 0; j < length / sizeof(float); j++)
+                ((float*) src[i])[j] = (float) (rand() - RAND_MAX / 2) / RAND_MAX;
+
+        for (c = 0; c < CHANNELS + PA_MIX_VOLUME_PADDING; c++) {
+            if (f == PA_SAMPLE_FLOAT32NE)
+                m[i].linear[c].f = 0.1f * (i + 1) + 0.05f * (c % CHANNELS);
+            else
+                m[i].linear[c].i = 0x3000 * (i + 1) + 0x800 * (c % CHANNELS);
+        }
+    }
+
+    for (i = 0; i < STREAMS; i++)
+        m[i].ptr = src[i];
+    ref(m, STREAMS, CHANNELS, out_ref, (uint8_t*) out_ref + length);
+
+    for (i = 0; i < STREAMS; i++)
+        m[i].ptr = src[i];
+    func(m, STREAMS, CHANNELS, out, (uint8_t*) out + length);
+
+    if (f == PA_SAMPLE_S32NE) {
+        for (j = 0; j < length / sizeof(int32_t); j++)
+            pa_assert_se(abs(((int32_t*) out)[j] - ((int32_t*) out_ref)[j]) <= STREAMS);
+    } else
+        pa_assert_se(memcmp(out, out_ref, length) == 0);
+
+    start = pa_rtclock_now();
+    for (j = 0; j < TIMES; j++) {
+        for (i = 0; i < STREAMS; i++)
+            m[i].ptr = src[i];
+        func(m, STREAMS, CHANNELS, out, (uint8_t*) out + length);
+    }
+    stop = pa_rtclock_now();
+    pa_log_info("%s: %llu usec.", name, (long long unsigned int) (stop - start));
+
+    start = pa_rtclock_now();
+    for (j = 0; j < TIMES; j++) {
+        for (i = 0; i < STREAMS; i++)
+            m[i].ptr = src[i];
+        ref(m, STREAMS, CHANNELS, out_ref, (uint8_t*) out_ref + length);
+    }
+    stop = pa_rtclock_now();
+    pa_log_info("ref: %llu usec.", (long long unsigned int) (stop - start));
+}
+
+static void run_test(void) {
+    run_test_format(PA_SAMPLE_S16NE, (pa_do_mix_func_t) pa_mix_s16ne_sse2, "SSE2 s16ne");
+    run_test_format(PA_SAMPLE_S32NE, (pa_do_mix_func_t) pa_mix_s32ne_sse2, "SSE2 s32ne");
+    run_test_format(PA_SAMPLE_FLOAT32NE, (pa_do_mix_func_t) pa_mix_float32ne_sse2, "SSE2 float32ne");
+}
+#endif
+#endif /* defined (PA_HAVE_X86_TARGET_ATTRIBUTE) */
+
+void pa_mix_func_init_sse(pa_cpu_x86_flag_t flags) {
+#if defined (PA_HAVE_X86_TARGET_ATTRIBUTE)
+
+#ifdef RUN_TEST
+    run_test();
+#endif
+
+    if (flags & PA_CPU_X86_SSE2) {
+        pa_log_info("Initialising SSE2 optimized mixers.");
+
+        pa_set_mix_func(PA_SAMPLE_S16NE, (pa_do_mix_func_t) pa_mix_s16ne_sse2);
+        pa_set_mix_func(PA_SAMPLE_S32NE, (pa_do_mix_func_t) pa_mix_s32ne_sse2);
+        pa_set_mix_func(PA_SAMPLE_FLOAT32NE, (pa_do_mix_func_t) pa_mix_float32ne_sse2);
+    }
+#endif /* defined (PA_HAVE_X86_TARGET_ATTRIBUTE) */
+}
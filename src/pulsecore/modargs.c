@@ -381,6 +381,29 @@ int pa_modargs_get_alternate_sample_rate(pa_modargs *ma, uint32_t *alternate_rat
     return 0;
 }
 
+int pa_modargs_get_io_thread_args(pa_modargs *ma, int32_t *rtprio, char **cpus) {
+    const char *v;
+
+    pa_assert(ma);
+    pa_assert(rtprio);
+    pa_assert(cpus);
+
+    if (pa_modargs_get_value_s32(ma, "realtime_priority", rtprio) < 0 ||
+        *rtprio < -1 ||
+        *rtprio > 99)
+        return -1;
+
+    if ((v = pa_modargs_get_value(ma, "cpu_affinity", NULL))) {
+        if (!pa_cpu_list_valid(v))
+            return -1;
+
+        pa_xfree(*cpus);
+        *cpus = pa_xstrdup(v);
+    }
+
+    return 0;
+}
+
 int pa_modargs_get_channel_map(pa_modargs *ma, const char *name, pa_channel_map *rmap) {
     pa_channel_map map;
     const char *cm;
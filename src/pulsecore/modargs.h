@@ -63,6 +63,12 @@ int pa_modargs_get_alternate_sample_rate(pa_modargs *ma, uint32_t *alternate_rat
 
 int pa_modargs_get_proplist(pa_modargs *ma, const char *name, pa_proplist *p, pa_update_mode_t m);
 
+/* Read the "realtime_priority" and "cpu_affinity" parameters of modules
+ * that run an IO thread, for pa_core_setup_io_thread(). The values
+ * are left alone if the parameters are not given; *cpus is to be
+ * freed with pa_xfree(). */
+int pa_modargs_get_io_thread_args(pa_modargs *ma, int32_t *rtprio, char **cpus);
+
 /* Iterate through the module argument list. The user should allocate a
  * state variable of type void* and initialize it with NULL. A pointer
  * to this variable should then be passed to pa_modargs_iterate()
@@ -30,6 +30,7 @@
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/ltdl-helper.h>
+#include <pulsecore/module.h>
 
 #include "modinfo.h"
 
@@ -70,12 +71,44 @@ pa_modinfo *pa_modinfo_get_by_handle(lt_dlhandle dl, const char *module_name) {
     return i;
 }
 
+pa_modinfo *pa_modinfo_get_by_builtin(const pa_module_builtin *b) {
+    pa_modinfo *i;
+
+    pa_assert(b);
+
+    i = pa_xnew0(pa_modinfo, 1);
+
+    if (b->get_author)
+        i->author = pa_xstrdup(b->get_author());
+
+    if (b->get_description)
+        i->description = pa_xstrdup(b->get_description());
+
+    if (b->get_usage)
+        i->usage = pa_xstrdup(b->get_usage());
+
+    if (b->get_version)
+        i->version = pa_xstrdup(b->get_version());
+
+    if (b->get_deprecated)
+        i->deprecated = pa_xstrdup(b->get_deprecated());
+
+    if (b->load_once)
+        i->load_once = b->load_once();
+
+    return i;
+}
+
 pa_modinfo *pa_modinfo_get_by_name(const char *name) {
+    const pa_module_builtin *b;
     lt_dlhandle dl;
     pa_modinfo *i;
 
     pa_assert(name);
 
+    if ((b = pa_module_find_builtin(name)))
+        return pa_modinfo_get_by_builtin(b);
+
     if (!(dl = lt_dlopenext(name))) {
         pa_log("Failed to open module \"%s\": %s", name, lt_dlerror());
         return NULL;
@@ -37,7 +37,13 @@ typedef struct pa_modinfo {
 /* Read meta data from an libtool handle */
 pa_modinfo *pa_modinfo_get_by_handle(lt_dlhandle dl, const char *module_name);
 
-/* Read meta data from a module file */
+struct pa_module_builtin;
+
+/* Read meta data from a module linked into the daemon */
+pa_modinfo *pa_modinfo_get_by_builtin(const struct pa_module_builtin *b);
+
+/* Read meta data from a module file, or a module linked into the
+ * daemon */
 pa_modinfo *pa_modinfo_get_by_name(const char *name);
 
 /* Free meta data */
@@ -31,6 +31,8 @@
 
 #include <pulse/xmalloc.h>
 #include <pulse/proplist.h>
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
 
 #include <pulsecore/core-subscribe.h>
 #include <pulsecore/log.h>
@@ -47,11 +49,34 @@
 #define PA_SYMBOL_GET_N_USED "pa__get_n_used"
 #define PA_SYMBOL_GET_DEPRECATE "pa__get_deprecated"
 
+static const pa_module_builtin *builtin_modules = NULL;
+
+void pa_module_set_builtin(const pa_module_builtin *table) {
+    builtin_modules = table;
+}
+
+const pa_module_builtin* pa_module_find_builtin(const char *name) {
+    const pa_module_builtin *b;
+
+    pa_assert(name);
+
+    if (!builtin_modules)
+        return NULL;
+
+    for (b = builtin_modules; b->name; b++)
+        if (pa_streq(b->name, name))
+            return b;
+
+    return NULL;
+}
+
 pa_module* pa_module_load(pa_core *c, const char *name, const char *argument) {
     pa_module *m = NULL;
     pa_bool_t (*load_once)(void);
     const char* (*get_deprecated)(void);
+    const pa_module_builtin *b;
     pa_modinfo *mi;
+    pa_usec_t begin;
 
     pa_assert(c);
     pa_assert(name);
@@ -59,19 +84,42 @@ pa_module* pa_module_load(pa_core *c, const char *name, const char *argument) {
     if (c->disallow_module_loading)
         goto fail;
 
+    begin = pa_rtclock_now();
+
     m = pa_xnew(pa_module, 1);
     m->name = pa_xstrdup(name);
     m->argument = pa_xstrdup(argument);
     m->load_once = FALSE;
     m->proplist = pa_proplist_new();
     m->index = PA_IDXSET_INVALID;
+    m->dl = NULL;
+
+    if ((b = pa_module_find_builtin(name))) {
+        load_once = b->load_once;
+        get_deprecated = b->get_deprecated;
+        m->init = b->init;
+        m->done = b->done;
+        m->get_n_used = b->get_n_used;
+
+    } else {
+        if (!(m->dl = lt_dlopenext(name))) {
+            pa_log("Failed to open module \"%s\": %s", name, lt_dlerror());
+            goto fail;
+        }
 
-    if (!(m->dl = lt_dlopenext(name))) {
-        pa_log("Failed to open module \"%s\": %s", name, lt_dlerror());
-        goto fail;
+        load_once = (pa_bool_t (*)(void)) pa_load_sym(m->dl, name, PA_SYMBOL_LOAD_ONCE);
+        get_deprecated = (const char* (*) (void)) pa_load_sym(m->dl, name, PA_SYMBOL_GET_DEPRECATE);
+
+        if (!(m->init = (int (*)(pa_module*_m)) pa_load_sym(m->dl, name, PA_SYMBOL_INIT))) {
+            pa_log("Failed to load module \"%s\": symbol \""PA_SYMBOL_INIT"\" not found.", name);
+            goto fail;
+        }
+
+        m->done = (void (*)(pa_module*_m)) pa_load_sym(m->dl, name, PA_SYMBOL_DONE);
+        m->get_n_used = (int (*)(pa_module*_m)) pa_load_sym(m->dl, name, PA_SYMBOL_GET_N_USED);
     }
 
-    if ((load_once = (pa_bool_t (*)(void)) pa_load_sym(m->dl, name, PA_SYMBOL_LOAD_ONCE))) {
+    if (load_once) {
 
         m->load_once = load_once();
 
@@ -89,20 +137,13 @@ pa_module* pa_module_load(pa_core *c, const char *name, const char *argument) {
         }
     }
 
-    if ((get_deprecated = (const char* (*) (void)) pa_load_sym(m->dl, name, PA_SYMBOL_GET_DEPRECATE))) {
+    if (get_deprecated) {
         const char *t;
 
         if ((t = get_deprecated()))
             pa_log_warn("%s is deprecated: %s", name, t);
     }
 
-    if (!(m->init = (int (*)(pa_module*_m)) pa_load_sym(m->dl, name, PA_SYMBOL_INIT))) {
-        pa_log("Failed to load module \"%s\": symbol \""PA_SYMBOL_INIT"\" not found.", name);
-        goto fail;
-    }
-
-    m->done = (void (*)(pa_module*_m)) pa_load_sym(m->dl, name, PA_SYMBOL_DONE);
-    m->get_n_used = (int (*)(pa_module*_m)) pa_load_sym(m->dl, name, PA_SYMBOL_GET_N_USED);
     m->userdata = NULL;
     m->core = c;
     m->unload_requested = FALSE;
@@ -115,11 +156,13 @@ pa_module* pa_module_load(pa_core *c, const char *name, const char *argument) {
     pa_assert_se(pa_idxset_put(c->modules, m, &m->index) >= 0);
     pa_assert(m->index != PA_IDXSET_INVALID);
 
-    pa_log_info("Loaded \"%s\" (index: #%u; argument: \"%s\").", m->name, m->index, m->argument ? m->argument : "");
+    /* The time includes the modules this one loaded itself */
+    pa_log_info("Loaded \"%s\" (index: #%u; argument: \"%s\") in %0.1f ms.", m->name, m->index, m->argument ? m->argument : "",
+                (double) (pa_rtclock_now() - begin) / PA_USEC_PER_MSEC);
 
     pa_subscription_post(c, PA_SUBSCRIPTION_EVENT_MODULE|PA_SUBSCRIPTION_EVENT_NEW, m->index);
 
-    if ((mi = pa_modinfo_get_by_handle(m->dl, name))) {
+    if ((mi = b ? pa_modinfo_get_by_builtin(b) : pa_modinfo_get_by_handle(m->dl, name))) {
 
         if (mi->author && !pa_proplist_contains(m->proplist, PA_PROP_MODULE_AUTHOR))
             pa_proplist_sets(m->proplist, PA_PROP_MODULE_AUTHOR, mi->author);
@@ -165,7 +208,8 @@ static void pa_module_free(pa_module *m) {
     if (m->proplist)
         pa_proplist_free(m->proplist);
 
-    lt_dlclose(m->dl);
+    if (m->dl)
+        lt_dlclose(m->dl);
 
     pa_log_info("Unloaded \"%s\" (index: #%u).", m->name, m->index);
 
@@ -203,10 +247,32 @@ void pa_module_unload_by_index(pa_core *c, uint32_t idx, pa_bool_t force) {
     pa_module_free(m);
 }
 
+struct deferred_load {
+    char *name, *argument;
+};
+
+static void deferred_load_free(void *p) {
+    struct deferred_load *d = p;
+
+    pa_xfree(d->name);
+    pa_xfree(d->argument);
+    pa_xfree(d);
+}
+
 void pa_module_unload_all(pa_core *c) {
     pa_module *m;
     pa_assert(c);
 
+    if (c->module_deferred_load_event) {
+        c->mainloop->defer_free(c->module_deferred_load_event);
+        c->module_deferred_load_event = NULL;
+    }
+
+    if (c->module_deferred_loads) {
+        pa_queue_free(c->module_deferred_loads, deferred_load_free);
+        c->module_deferred_loads = NULL;
+    }
+
     while ((m = pa_idxset_steal_first(c->modules, NULL)))
         pa_module_free(m);
 
@@ -229,6 +295,62 @@ static void defer_cb(pa_mainloop_api*api, pa_defer_event *e, void *userdata) {
             pa_module_unload(c, m, TRUE);
 }
 
+static void deferred_load_cb(pa_mainloop_api*api, pa_defer_event *e, void *userdata) {
+    pa_core *c = PA_CORE(userdata);
+    struct deferred_load *d;
+    pa_bool_t disallow;
+
+    pa_core_assert_ref(c);
+
+    if (!(d = pa_queue_pop(c->module_deferred_loads))) {
+        api->defer_enable(e, 0);
+        return;
+    }
+
+    /* The module was asked for at startup, when loading was still
+     * allowed */
+    disallow = c->disallow_module_loading;
+    c->disallow_module_loading = FALSE;
+
+    if (!pa_module_load(c, d->name, d->argument))
+        pa_log_warn("Deferred loading of module \"%s\" failed.", d->name);
+
+    c->disallow_module_loading = disallow;
+
+    deferred_load_free(d);
+
+    if (pa_queue_isempty(c->module_deferred_loads))
+        api->defer_enable(e, 0);
+}
+
+int pa_module_load_deferred(pa_core *c, const char *name, const char *argument) {
+    struct deferred_load *d;
+
+    pa_core_assert_ref(c);
+    pa_assert(name);
+
+    if (c->disallow_module_loading)
+        return -1;
+
+    d = pa_xnew(struct deferred_load, 1);
+    d->name = pa_xstrdup(name);
+    d->argument = pa_xstrdup(argument);
+
+    if (!c->module_deferred_loads)
+        c->module_deferred_loads = pa_queue_new();
+
+    pa_queue_push(c->module_deferred_loads, d);
+
+    if (!c->module_deferred_load_event)
+        c->module_deferred_load_event = c->mainloop->defer_new(c->mainloop, deferred_load_cb, c);
+
+    c->mainloop->defer_enable(c->module_deferred_load_event, 1);
+
+    pa_log_debug("Deferring loading of module \"%s\".", name);
+
+    return 0;
+}
+
 void pa_module_unload_request(pa_module *m, pa_bool_t force) {
     pa_assert(m);
 
@@ -50,8 +50,36 @@ struct pa_module {
     pa_proplist *proplist;
 };
 
+/* The entry points of a module that is linked into the daemon, as
+ * listed in daemon/builtin-modules.c. Only init is mandatory. */
+typedef struct pa_module_builtin {
+    const char *name;
+
+    int (*init)(pa_module*m);
+    void (*done)(pa_module*m);
+    int (*get_n_used)(pa_module *m);
+
+    const char* (*get_author)(void);
+    const char* (*get_description)(void);
+    const char* (*get_usage)(void);
+    const char* (*get_version)(void);
+    const char* (*get_deprecated)(void);
+    pa_bool_t (*load_once)(void);
+} pa_module_builtin;
+
+/* Modules in this table, which ends with an entry whose name is NULL,
+ * are loaded without going through ltdl */
+void pa_module_set_builtin(const pa_module_builtin *table);
+const pa_module_builtin* pa_module_find_builtin(const char *name);
+
 pa_module* pa_module_load(pa_core *c, const char *name, const char*argument);
 
+/* Queues the module for loading from the main loop, one module per
+ * iteration, so that clients are served in between. Used for modules
+ * the daemon startup shouldn't wait for. Fails if module loading is
+ * disallowed. */
+int pa_module_load_deferred(pa_core *c, const char *name, const char *argument);
+
 void pa_module_unload(pa_core *c, pa_module *m, pa_bool_t force);
 void pa_module_unload_by_index(pa_core *c, uint32_t idx, pa_bool_t force);
 
@@ -173,6 +173,25 @@ enum {
     PA_COMMAND_SET_SOURCE_OUTPUT_VOLUME,
     PA_COMMAND_SET_SOURCE_OUTPUT_MUTE,
 
+    /* Supported since protocol v28 (3.0) */
+
+    /* SERVER->CLIENT */
+    PA_COMMAND_REQUEST_MULTI,
+
+    /* Supported since protocol v30 (3.0) */
+    PA_COMMAND_GET_SNAPSHOT,
+
+    /* Supported since protocol v32 (3.0) */
+
+    /* SERVER->CLIENT */
+    PA_COMMAND_PLAYBACK_TIMING,
+
+    /* Supported since protocol v33 (3.0) */
+    PA_COMMAND_FINISH_UPLOAD_SAMPLES,
+
+    /* Supported since protocol v36 (3.0) */
+    PA_COMMAND_SET_VOLUMES,
+
     PA_COMMAND_MAX
 };
 
@@ -0,0 +1,435 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <opus.h>
+
+#include <pulse/def.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "opus-util.h"
+
+/* 20 ms frames. A single frame never takes more than 1275 bytes. */
+#define FRAMES_PER_SEC 50
+#define PACKET_SIZE_MAX 1275
+#define HEADER_SIZE 2
+
+struct pa_opus_encoder {
+    OpusEncoder *encoder;
+    pa_mempool *pool;
+    pa_sample_spec sample_spec;
+
+    int frame_samples;
+    size_t frame_size;
+
+    uint8_t *buffer;
+    size_t buffer_length;
+};
+
+struct pa_opus_decoder {
+    OpusDecoder *decoder;
+    pa_mempool *pool;
+    pa_sample_spec sample_spec;
+
+    /* The packet currently being assembled, including its header */
+    uint8_t packet[HEADER_SIZE + PACKET_SIZE_MAX];
+    size_t packet_length;
+
+    /* Decoded data is appended to this block until it is full */
+    pa_memchunk out;
+};
+
+pa_bool_t pa_opus_sample_spec_valid(const pa_sample_spec *ss) {
+    pa_assert(ss);
+
+    if (ss->format != PA_SAMPLE_S16NE && ss->format != PA_SAMPLE_FLOAT32NE)
+        return FALSE;
+
+    if (ss->channels < 1 || ss->channels > 2)
+        return FALSE;
+
+    switch (ss->rate) {
+        case 8000:
+        case 12000:
+        case 16000:
+        case 24000:
+        case 48000:
+            return TRUE;
+
+        default:
+            return FALSE;
+    }
+}
+
+pa_format_info* pa_opus_format_from_sample_spec(const pa_sample_spec *ss, const pa_channel_map *map) {
+    pa_format_info *f;
+
+    pa_assert(ss);
+    pa_assert(pa_opus_sample_spec_valid(ss));
+
+    f = pa_format_info_from_sample_spec((pa_sample_spec*) ss, (pa_channel_map*) map);
+    f->encoding = PA_ENCODING_OPUS;
+
+    return f;
+}
+
+int pa_opus_format_to_sample_spec(const pa_format_info *f, pa_sample_spec *ss, pa_channel_map *map) {
+    pa_format_info *pcm;
+    int r;
+
+    pa_assert(f);
+    pa_assert(f->encoding == PA_ENCODING_OPUS);
+    pa_assert(ss);
+
+    /* Apart from the encoding this looks just like a PCM format */
+    pcm = pa_format_info_copy(f);
+    pcm->encoding = PA_ENCODING_PCM;
+    r = pa_format_info_to_sample_spec(pcm, ss, map);
+    pa_format_info_free(pcm);
+
+    if (r < 0)
+        return r;
+
+    if (!pa_opus_sample_spec_valid(ss))
+        return -PA_ERR_NOTSUPPORTED;
+
+    return 0;
+}
+
+pa_opus_encoder* pa_opus_encoder_new(pa_mempool *pool, const pa_sample_spec *ss, uint32_t bitrate) {
+    pa_opus_encoder *e;
+    int error;
+
+    pa_assert(pool);
+    pa_assert(ss);
+    pa_assert(pa_opus_sample_spec_valid(ss));
+
+    e = pa_xnew0(pa_opus_encoder, 1);
+    e->pool = pool;
+    e->sample_spec = *ss;
+
+    if (!(e->encoder = opus_encoder_create((opus_int32) ss->rate, ss->channels, OPUS_APPLICATION_AUDIO, &error))) {
+        pa_log("Failed to create Opus encoder: %s", opus_strerror(error));
+        pa_xfree(e);
+        return NULL;
+    }
+
+    if (bitrate > 0 && (error = opus_encoder_ctl(e->encoder, OPUS_SET_BITRATE((opus_int32) bitrate))) != OPUS_OK)
+        pa_log_warn("Failed to set Opus bitrate to %u: %s", bitrate, opus_strerror(error));
+
+    e->frame_samples = (int) (ss->rate / FRAMES_PER_SEC);
+    e->frame_size = (size_t) e->frame_samples * pa_frame_size(ss);
+    e->buffer = pa_xmalloc(e->frame_size);
+
+    return e;
+}
+
+void pa_opus_encoder_free(pa_opus_encoder *e) {
+    pa_assert(e);
+
+    opus_encoder_destroy(e->encoder);
+    pa_xfree(e->buffer);
+    pa_xfree(e);
+}
+
+static int encode_frame(pa_opus_encoder *e, const void *frame, uint8_t *d) {
+    opus_int32 r;
+
+    if (e->sample_spec.format == PA_SAMPLE_FLOAT32NE)
+        r = opus_encode_float(e->encoder, frame, e->frame_samples, d + HEADER_SIZE, PACKET_SIZE_MAX);
+    else
+        r = opus_encode(e->encoder, frame, e->frame_samples, d + HEADER_SIZE, PACKET_SIZE_MAX);
+
+    if (r < 0) {
+        pa_log("Opus encoding failed: %s", opus_strerror(r));
+        return -1;
+    }
+
+    d[0] = (uint8_t) (r >> 8);
+    d[1] = (uint8_t) r;
+
+    return HEADER_SIZE + r;
+}
+
+int pa_opus_encoder_encode(pa_opus_encoder *e, const pa_memchunk *pcm, pa_memchunk *out) {
+    const uint8_t *s;
+    uint8_t *d;
+    size_t length, n;
+    int ret = 0;
+
+    pa_assert(e);
+    pa_assert(pcm);
+    pa_assert(pcm->memblock);
+    pa_assert(out);
+
+    pa_memchunk_reset(out);
+
+    n = (e->buffer_length + pcm->length) / e->frame_size;
+    s = (const uint8_t*) pa_memblock_acquire(pcm->memblock) + pcm->index;
+    length = pcm->length;
+
+    if (n > 0) {
+        out->memblock = pa_memblock_new(e->pool, n * (HEADER_SIZE + PACKET_SIZE_MAX));
+        d = pa_memblock_acquire(out->memblock);
+
+        /* Complete the frame left over from last time */
+        if (e->buffer_length > 0) {
+            size_t l = e->frame_size - e->buffer_length;
+            int r;
+
+            memcpy(e->buffer + e->buffer_length, s, l);
+            s += l;
+            length -= l;
+            e->buffer_length = 0;
+
+            if ((r = encode_frame(e, e->buffer, d)) < 0)
+                ret = -1;
+            else
+                out->length += (size_t) r;
+        }
+
+        /* Encode all further complete frames in place */
+        for (; ret == 0 && length >= e->frame_size; s += e->frame_size, length -= e->frame_size) {
+            int r;
+
+            if ((r = encode_frame(e, s, d + out->length)) < 0)
+                ret = -1;
+            else
+                out->length += (size_t) r;
+        }
+
+        pa_memblock_release(out->memblock);
+
+        if (ret < 0) {
+            pa_memblock_unref(out->memblock);
+            pa_memchunk_reset(out);
+        }
+    }
+
+    if (ret == 0 && length > 0) {
+        pa_assert(e->buffer_length + length < e->frame_size);
+
+        memcpy(e->buffer + e->buffer_length, s, length);
+        e->buffer_length += length;
+    }
+
+    pa_memblock_release(pcm->memblock);
+
+    return ret;
+}
+
+size_t pa_opus_encoder_get_pending(pa_opus_encoder *e) {
+    pa_assert(e);
+
+    return e->buffer_length;
+}
+
+size_t pa_opus_encoder_get_frame_size(pa_opus_encoder *e) {
+    pa_assert(e);
+
+    return e->frame_size;
+}
+
+pa_opus_decoder* pa_opus_decoder_new(pa_mempool *pool, const pa_sample_spec *ss) {
+    pa_opus_decoder *d;
+    int error;
+
+    pa_assert(pool);
+    pa_assert(ss);
+    pa_assert(pa_opus_sample_spec_valid(ss));
+
+    d = pa_xnew0(pa_opus_decoder, 1);
+    d->pool = pool;
+    d->sample_spec = *ss;
+
+    if (!(d->decoder = opus_decoder_create((opus_int32) ss->rate, ss->channels, &error))) {
+        pa_log("Failed to create Opus decoder: %s", opus_strerror(error));
+        pa_xfree(d);
+        return NULL;
+    }
+
+    pa_memchunk_reset(&d->out);
+
+    return d;
+}
+
+void pa_opus_decoder_free(pa_opus_decoder *d) {
+    pa_assert(d);
+
+    if (d->out.memblock)
+        pa_memblock_unref(d->out.memblock);
+
+    opus_decoder_destroy(d->decoder);
+    pa_xfree(d);
+}
+
+static void flush_output(pa_opus_decoder *d, pa_opus_decoder_cb_t cb, void *userdata) {
+
+    if (d->out.length <= 0)
+        return;
+
+    cb(d, &d->out, userdata);
+
+    /* Keep on appending to the rest of the block */
+    d->out.index += d->out.length;
+    d->out.length = 0;
+}
+
+static int decode_packet(pa_opus_decoder *d, const uint8_t *packet, size_t length, pa_opus_decoder_cb_t cb, void *userdata) {
+    int samples;
+    size_t fs, needed;
+    void *p;
+
+    if ((samples = opus_packet_get_nb_samples(packet, (opus_int32) length, (opus_int32) d->sample_spec.rate)) <= 0) {
+        pa_log_warn("Received invalid Opus packet.");
+        return -1;
+    }
+
+    fs = pa_frame_size(&d->sample_spec);
+    needed = (size_t) samples * fs;
+
+    if (d->out.memblock && d->out.index + needed > pa_memblock_get_length(d->out.memblock)) {
+        flush_output(d, cb, userdata);
+        pa_memblock_unref(d->out.memblock);
+        pa_memchunk_reset(&d->out);
+    }
+
+    if (!d->out.memblock) {
+        d->out.memblock = pa_memblock_new(d->pool, PA_MAX(needed, pa_mempool_block_size_max(d->pool)));
+        d->out.index = d->out.length = 0;
+    }
+
+    p = (uint8_t*) pa_memblock_acquire(d->out.memblock) + d->out.index + d->out.length;
+
+    if (d->sample_spec.format == PA_SAMPLE_FLOAT32NE)
+        samples = opus_decode_float(d->decoder, packet, (opus_int32) length, p, samples, 0);
+    else
+        samples = opus_decode(d->decoder, packet, (opus_int32) length, p, samples, 0);
+
+    pa_memblock_release(d->out.memblock);
+
+    if (samples < 0) {
+        pa_log_warn("Opus decoding failed: %s", opus_strerror(samples));
+        return -1;
+    }
+
+    d->out.length += (size_t) samples * fs;
+
+    return 0;
+}
+
+int pa_opus_decoder_decode(pa_opus_decoder *d, const pa_memchunk *in, pa_opus_decoder_cb_t cb, void *userdata) {
+    const uint8_t *s;
+    size_t length;
+    int ret = 0;
+
+    pa_assert(d);
+    pa_assert(in);
+    pa_assert(in->memblock);
+    pa_assert(cb);
+
+    s = (const uint8_t*) pa_memblock_acquire(in->memblock) + in->index;
+    length = in->length;
+
+    while (length > 0) {
+        size_t l, packet_size;
+
+        if (d->packet_length < HEADER_SIZE) {
+            l = PA_MIN(length, HEADER_SIZE - d->packet_length);
+            memcpy(d->packet + d->packet_length, s, l);
+            d->packet_length += l;
+            s += l;
+            length -= l;
+            continue;
+        }
+
+        packet_size = ((size_t) d->packet[0] << 8) | (size_t) d->packet[1];
+
+        if (packet_size <= 0 || packet_size > PACKET_SIZE_MAX) {
+            pa_log_warn("Received Opus packet with invalid size %lu.", (unsigned long) packet_size);
+            ret = -1;
+            break;
+        }
+
+        l = PA_MIN(length, HEADER_SIZE + packet_size - d->packet_length);
+        memcpy(d->packet + d->packet_length, s, l);
+        d->packet_length += l;
+        s += l;
+        length -= l;
+
+        if (d->packet_length < HEADER_SIZE + packet_size)
+            continue;
+
+        d->packet_length = 0;
+
+        if ((ret = decode_packet(d, d->packet + HEADER_SIZE, packet_size, cb, userdata)) < 0)
+            break;
+    }
+
+    pa_memblock_release(in->memblock);
+
+    if (ret == 0)
+        flush_output(d, cb, userdata);
+
+    return ret;
+}
+
+int pa_opus_decoder_decode_packet(pa_opus_decoder *d, const pa_memchunk *packet, pa_memchunk *pcm) {
+    const uint8_t *s;
+    int r;
+
+    pa_assert(d);
+    pa_assert(packet);
+    pa_assert(packet->memblock);
+    pa_assert(pcm);
+
+    pa_memchunk_reset(pcm);
+
+    if (packet->length <= 0 || packet->length > PACKET_SIZE_MAX) {
+        pa_log_warn("Received Opus packet with invalid size %lu.", (unsigned long) packet->length);
+        return -1;
+    }
+
+    /* Decoded data is handed out right away, so nothing is pending in
+     * the output block and decode_packet() never needs the callback */
+    pa_assert(d->out.length == 0);
+
+    s = (const uint8_t*) pa_memblock_acquire(packet->memblock) + packet->index;
+    r = decode_packet(d, s, packet->length, NULL, NULL);
+    pa_memblock_release(packet->memblock);
+
+    if (r < 0)
+        return r;
+
+    *pcm = d->out;
+    pa_memblock_ref(pcm->memblock);
+
+    d->out.index += d->out.length;
+    d->out.length = 0;
+
+    return 0;
+}
@@ -0,0 +1,70 @@
+#ifndef foopulsecoreopusutilhfoo
+#define foopulsecoreopusutilhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulse/sample.h>
+#include <pulse/channelmap.h>
+#include <pulse/format.h>
+
+#include <pulsecore/memblock.h>
+#include <pulsecore/memchunk.h>
+
+/* Opus packets sent over a stream are framed by a 16 bit big endian
+ * length each, since the stream itself keeps no packet boundaries. */
+
+typedef struct pa_opus_encoder pa_opus_encoder;
+typedef struct pa_opus_decoder pa_opus_decoder;
+
+/* Only S16NE and FLOAT32NE at the rates Opus supports, with one or two
+ * channels */
+pa_bool_t pa_opus_sample_spec_valid(const pa_sample_spec *ss);
+
+/* An Opus format info carries the sample spec of the decoded data */
+pa_format_info* pa_opus_format_from_sample_spec(const pa_sample_spec *ss, const pa_channel_map *map);
+int pa_opus_format_to_sample_spec(const pa_format_info *f, pa_sample_spec *ss, pa_channel_map *map);
+
+/* A bitrate of 0 leaves the choice to the encoder */
+pa_opus_encoder* pa_opus_encoder_new(pa_mempool *pool, const pa_sample_spec *ss, uint32_t bitrate);
+void pa_opus_encoder_free(pa_opus_encoder *e);
+
+/* Encodes all complete frames of the buffered and the new PCM data into
+ * out, which is left empty if there are none yet. */
+int pa_opus_encoder_encode(pa_opus_encoder *e, const pa_memchunk *pcm, pa_memchunk *out);
+
+/* Number of PCM bytes waiting for a frame to fill up */
+size_t pa_opus_encoder_get_pending(pa_opus_encoder *e);
+
+/* Number of PCM bytes encoded into each packet */
+size_t pa_opus_encoder_get_frame_size(pa_opus_encoder *e);
+
+typedef void (*pa_opus_decoder_cb_t)(pa_opus_decoder *d, const pa_memchunk *pcm, void *userdata);
+
+pa_opus_decoder* pa_opus_decoder_new(pa_mempool *pool, const pa_sample_spec *ss);
+void pa_opus_decoder_free(pa_opus_decoder *d);
+
+/* Takes framed packets in arbitrary pieces and passes the decoded PCM
+ * data to the callback. Returns a negative value for malformed data. */
+int pa_opus_decoder_decode(pa_opus_decoder *d, const pa_memchunk *in, pa_opus_decoder_cb_t cb, void *userdata);
+
+/* Decodes a single unframed packet, as carried by RTP */
+int pa_opus_decoder_decode_packet(pa_opus_decoder *d, const pa_memchunk *packet, pa_memchunk *pcm);
+
+#endif
@@ -27,15 +27,72 @@
 
 #include <pulse/xmalloc.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/flist.h>
 
 #include "packet.h"
 
+/* Most packets are small commands and replies. Their data is appended
+ * to blocks of a few fixed sizes which are recycled instead of freed.
+ * There are fewer of the bigger ones kept around. */
+#define BLOCK_SIZE(size) (PA_ALIGN(sizeof(pa_packet)) + (size))
+
+PA_STATIC_FLIST_DECLARE(small_packets, 0, pa_xfree);
+PA_STATIC_FLIST_DECLARE(medium_packets, 32, pa_xfree);
+PA_STATIC_FLIST_DECLARE(big_packets, 16, pa_xfree);
+
+static const size_t class_size[] = {
+    PA_PACKET_SMALL_MAX,
+    4*1024,
+    PA_PACKET_POOLED_MAX
+};
+
+static pa_flist *class_flist(unsigned c) {
+    switch (c) {
+        case 0:
+            return PA_STATIC_FLIST_GET(small_packets);
+        case 1:
+            return PA_STATIC_FLIST_GET(medium_packets);
+        case 2:
+            return PA_STATIC_FLIST_GET(big_packets);
+    }
+
+    pa_assert_not_reached();
+}
+
+/* The smallest class length fits in, or PA_ELEMENTSOF(class_size) */
+static unsigned class_for_length(size_t length) {
+    unsigned c;
+
+    for (c = 0; c < PA_ELEMENTSOF(class_size); c++)
+        if (length <= class_size[c])
+            break;
+
+    return c;
+}
+
+static pa_packet* block_new(unsigned c) {
+    pa_packet *p;
+
+    if (!(p = pa_flist_pop(class_flist(c))))
+        p = pa_xmalloc(BLOCK_SIZE(class_size[c]));
+
+    return p;
+}
+
 pa_packet* pa_packet_new(size_t length) {
     pa_packet *p;
+    unsigned c;
 
     pa_assert(length > 0);
 
-    p = pa_xmalloc(PA_ALIGN(sizeof(pa_packet)) + length);
+    if ((c = class_for_length(length)) < PA_ELEMENTSOF(class_size)) {
+        p = block_new(c);
+        p->allocated = class_size[c];
+    } else {
+        p = pa_xmalloc(BLOCK_SIZE(length));
+        p->allocated = length;
+    }
+
     PA_REFCNT_INIT(p);
     p->length = length;
     p->data = (uint8_t*) p + PA_ALIGN(sizeof(pa_packet));
@@ -50,11 +107,12 @@ pa_packet* pa_packet_new_dynamic(void* data, size_t length) {
     pa_assert(data);
     pa_assert(length > 0);
 
-    p = pa_xnew(pa_packet, 1);
+    p = block_new(0);
     PA_REFCNT_INIT(p);
     p->length = length;
     p->data = data;
     p->type = PA_PACKET_DYNAMIC;
+    p->allocated = 0;
 
     return p;
 }
@@ -68,12 +126,33 @@ pa_packet* pa_packet_ref(pa_packet *p) {
 }
 
 void pa_packet_unref(pa_packet *p) {
+    unsigned c;
+
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) >= 1);
 
     if (PA_REFCNT_DEC(p) <= 0) {
-        if (p->type == PA_PACKET_DYNAMIC)
+
+        /* Dynamic packets always live in a small block */
+        if (p->type == PA_PACKET_DYNAMIC) {
             pa_xfree(p->data);
-        pa_xfree(p);
+            c = 0;
+        } else if ((c = class_for_length(p->allocated)) >= PA_ELEMENTSOF(class_size) || class_size[c] != p->allocated) {
+            pa_xfree(p);
+            return;
+        }
+
+        if (pa_flist_push(class_flist(c), p) < 0)
+            pa_xfree(p);
     }
 }
+
+void pa_packet_set_length(pa_packet *p, size_t length) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) == 1);
+    pa_assert(p->type == PA_PACKET_APPENDED);
+    pa_assert(length > 0);
+    pa_assert(length <= p->allocated);
+
+    p->length = length;
+}
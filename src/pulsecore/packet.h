@@ -27,11 +27,22 @@
 
 #include <pulsecore/refcnt.h>
 
+/* Packets with up to this many bytes of data come from a pool */
+#define PA_PACKET_SMALL_MAX 1024
+
+/* Bigger ones up to this size come from pools of a few size classes */
+#define PA_PACKET_POOLED_MAX (16*1024)
+
 typedef struct pa_packet {
     PA_REFCNT_DECLARE;
     enum { PA_PACKET_APPENDED, PA_PACKET_DYNAMIC } type;
     size_t length;
     uint8_t *data;
+
+    /* How much data fits in the space appended to the struct. For
+     * pooled packets this is the size of the class, which may be more
+     * than length. 0 for dynamic packets. */
+    size_t allocated;
 } pa_packet;
 
 pa_packet* pa_packet_new(size_t length);
@@ -40,4 +51,9 @@ pa_packet* pa_packet_new_dynamic(void* data, size_t length);
 pa_packet* pa_packet_ref(pa_packet *p);
 void pa_packet_unref(pa_packet *p);
 
+/* Changes the length of a packet nobody else has a reference to yet,
+ * within what was allocated. Used to build data in a packet before
+ * its final size is known. */
+void pa_packet_set_length(pa_packet *p, size_t length);
+
 #endif
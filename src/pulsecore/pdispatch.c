@@ -32,6 +32,7 @@
 #include <pulse/xmalloc.h>
 
 #include <pulsecore/native-common.h>
+#include <pulsecore/hashmap.h>
 #include <pulsecore/llist.h>
 #include <pulsecore/log.h>
 #include <pulsecore/core-util.h>
@@ -190,6 +191,20 @@ static const char *command_names[PA_COMMAND_MAX] = {
     [PA_COMMAND_SET_SOURCE_OUTPUT_VOLUME] = "SET_SOURCE_OUTPUT_VOLUME",
     [PA_COMMAND_SET_SOURCE_OUTPUT_MUTE] = "SET_SOURCE_OUTPUT_MUTE",
 
+    /* Supported since protocol v28 (3.0) */
+    [PA_COMMAND_REQUEST_MULTI] = "REQUEST_MULTI",
+
+    /* Supported since protocol v30 (3.0) */
+    [PA_COMMAND_GET_SNAPSHOT] = "GET_SNAPSHOT",
+
+    /* Supported since protocol v32 (3.0) */
+    [PA_COMMAND_PLAYBACK_TIMING] = "PLAYBACK_TIMING",
+
+    /* Supported since protocol v33 (3.0) */
+    [PA_COMMAND_FINISH_UPLOAD_SAMPLES] = "FINISH_UPLOAD_SAMPLES",
+
+    /* Supported since protocol v36 (3.0) */
+    [PA_COMMAND_SET_VOLUMES] = "SET_VOLUMES",
 };
 
 #endif
@@ -203,7 +218,7 @@ struct reply_info {
     void *userdata;
     pa_free_cb_t free_cb;
     uint32_t tag;
-    pa_time_event *time_event;
+    pa_usec_t deadline;
 };
 
 struct pa_pdispatch {
@@ -211,7 +226,19 @@ struct pa_pdispatch {
     pa_mainloop_api *mainloop;
     const pa_pdispatch_cb_t *callback_table;
     unsigned n_commands;
-    PA_LLIST_HEAD(struct reply_info, replies);
+
+    /* The outstanding replies by tag, and in the order of their
+     * deadlines. There's only a single timer for all of them, which
+     * is armed for armed_deadline, or not at all if that is
+     * PA_USEC_INVALID. It is only moved when a reply with an earlier
+     * deadline comes in, so it may fire early, when there's nothing
+     * to time out yet. */
+    pa_hashmap *replies;
+    PA_LLIST_HEAD(struct reply_info, timeouts);
+    struct reply_info *timeouts_tail;
+    pa_time_event *time_event;
+    pa_usec_t armed_deadline;
+
     pa_pdispatch_drain_cb_t drain_callback;
     void *drain_userdata;
     const pa_creds *creds;
@@ -219,19 +246,51 @@ struct pa_pdispatch {
 };
 
 static void reply_info_free(struct reply_info *r) {
+    pa_pdispatch *pd;
+
     pa_assert(r);
-    pa_assert(r->pdispatch);
-    pa_assert(r->pdispatch->mainloop);
+    pa_assert_se(pd = r->pdispatch);
 
-    if (r->time_event)
-        r->pdispatch->mainloop->time_free(r->time_event);
+    pa_assert_se(pa_hashmap_remove(pd->replies, PA_UINT32_TO_PTR(r->tag)) == r);
 
-    PA_LLIST_REMOVE(struct reply_info, r->pdispatch->replies, r);
+    if (pd->timeouts_tail == r)
+        pd->timeouts_tail = r->prev;
+
+    PA_LLIST_REMOVE(struct reply_info, pd->timeouts, r);
 
     if (pa_flist_push(PA_STATIC_FLIST_GET(reply_infos), r) < 0)
         pa_xfree(r);
 }
 
+static void timeout_callback(pa_mainloop_api*m, pa_time_event*e, const struct timeval *t, void *userdata);
+
+/* Makes sure the timer fires no later than the first deadline */
+static void arm_timer(pa_pdispatch *pd) {
+    struct timeval tv;
+
+    pa_assert(pd);
+
+    if (!pd->timeouts) {
+        if (pd->time_event && pd->armed_deadline != PA_USEC_INVALID) {
+            pd->mainloop->time_restart(pd->time_event, NULL);
+            pd->armed_deadline = PA_USEC_INVALID;
+        }
+
+        return;
+    }
+
+    if (pd->armed_deadline != PA_USEC_INVALID && pd->armed_deadline <= pd->timeouts->deadline)
+        return;
+
+    pd->armed_deadline = pd->timeouts->deadline;
+    pa_timeval_rtstore(&tv, pd->armed_deadline, pd->use_rtclock);
+
+    if (pd->time_event)
+        pd->mainloop->time_restart(pd->time_event, &tv);
+    else
+        pa_assert_se(pd->time_event = pd->mainloop->time_new(pd->mainloop, &tv, timeout_callback, pd));
+}
+
 pa_pdispatch* pa_pdispatch_new(pa_mainloop_api *mainloop, pa_bool_t use_rtclock, const pa_pdispatch_cb_t *table, unsigned entries) {
     pa_pdispatch *pd;
 
@@ -243,7 +302,11 @@ pa_pdispatch* pa_pdispatch_new(pa_mainloop_api *mainloop, pa_bool_t use_rtclock,
     pd->mainloop = mainloop;
     pd->callback_table = table;
     pd->n_commands = entries;
-    PA_LLIST_HEAD_INIT(struct reply_info, pd->replies);
+    pd->replies = pa_hashmap_new(NULL, NULL);
+    PA_LLIST_HEAD_INIT(struct reply_info, pd->timeouts);
+    pd->timeouts_tail = NULL;
+    pd->time_event = NULL;
+    pd->armed_deadline = PA_USEC_INVALID;
     pd->use_rtclock = use_rtclock;
 
     return pd;
@@ -252,13 +315,18 @@ pa_pdispatch* pa_pdispatch_new(pa_mainloop_api *mainloop, pa_bool_t use_rtclock,
 static void pdispatch_free(pa_pdispatch *pd) {
     pa_assert(pd);
 
-    while (pd->replies) {
-        if (pd->replies->free_cb)
-            pd->replies->free_cb(pd->replies->userdata);
+    while (pd->timeouts) {
+        if (pd->timeouts->free_cb)
+            pd->timeouts->free_cb(pd->timeouts->userdata);
 
-        reply_info_free(pd->replies);
+        reply_info_free(pd->timeouts);
     }
 
+    if (pd->time_event)
+        pd->mainloop->time_free(pd->time_event);
+
+    pa_hashmap_free(pd->replies, NULL, NULL);
+
     pa_xfree(pd);
 }
 
@@ -323,11 +391,7 @@ int pa_pdispatch_run(pa_pdispatch *pd, pa_packet*packet, const pa_creds *creds,
     if (command == PA_COMMAND_ERROR || command == PA_COMMAND_REPLY) {
         struct reply_info *r;
 
-        PA_LLIST_FOREACH(r, pd->replies)
-            if (r->tag == tag)
-                break;
-
-        if (r)
+        if ((r = pa_hashmap_get(pd->replies, PA_UINT32_TO_PTR(tag))))
             run_action(pd, r, command, ts);
 
     } else if (pd->callback_table && (command < pd->n_commands) && pd->callback_table[command]) {
@@ -353,20 +417,30 @@ finish:
 }
 
 static void timeout_callback(pa_mainloop_api*m, pa_time_event*e, const struct timeval *t, void *userdata) {
-    struct reply_info*r = userdata;
+    pa_pdispatch *pd = userdata;
+    pa_usec_t now;
 
-    pa_assert(r);
-    pa_assert(r->time_event == e);
-    pa_assert(r->pdispatch);
-    pa_assert(r->pdispatch->mainloop == m);
-    pa_assert(r->callback);
+    pa_assert(pd);
+    pa_assert(pd->time_event == e);
+    pa_assert(pd->mainloop == m);
 
-    run_action(r->pdispatch, r, PA_COMMAND_TIMEOUT, NULL);
+    pa_pdispatch_ref(pd);
+
+    pd->armed_deadline = PA_USEC_INVALID;
+    now = pa_rtclock_now();
+
+    /* The callbacks may register and unregister replies, so look at
+     * the head of the list anew every time */
+    while (pd->timeouts && pd->timeouts->deadline <= now)
+        run_action(pd, pd->timeouts, PA_COMMAND_TIMEOUT, NULL);
+
+    arm_timer(pd);
+
+    pa_pdispatch_unref(pd);
 }
 
 void pa_pdispatch_register_reply(pa_pdispatch *pd, uint32_t tag, int timeout, pa_pdispatch_cb_t cb, void *userdata, pa_free_cb_t free_cb) {
-    struct reply_info *r;
-    struct timeval tv;
+    struct reply_info *r, *after;
 
     pa_assert(pd);
     pa_assert(PA_REFCNT_VALUE(pd) >= 1);
@@ -380,19 +454,28 @@ void pa_pdispatch_register_reply(pa_pdispatch *pd, uint32_t tag, int timeout, pa
     r->userdata = userdata;
     r->free_cb = free_cb;
     r->tag = tag;
+    r->deadline = pa_rtclock_now() + (pa_usec_t) timeout * PA_USEC_PER_SEC;
+
+    pa_assert_se(pa_hashmap_put(pd->replies, PA_UINT32_TO_PTR(tag), r) == 0);
+
+    /* Replies are usually registered with the same timeout, so this
+     * almost always ends up at the tail right away */
+    for (after = pd->timeouts_tail; after && after->deadline > r->deadline; after = after->prev)
+        ;
+
+    PA_LLIST_INSERT_AFTER(struct reply_info, pd->timeouts, after, r);
 
-    pa_assert_se(r->time_event = pd->mainloop->time_new(pd->mainloop,
-                                                        pa_timeval_rtstore(&tv, pa_rtclock_now() + timeout * PA_USEC_PER_SEC, pd->use_rtclock),
-                                                        timeout_callback, r));
+    if (pd->timeouts_tail == after)
+        pd->timeouts_tail = r;
 
-    PA_LLIST_PREPEND(struct reply_info, pd->replies, r);
+    arm_timer(pd);
 }
 
 int pa_pdispatch_is_pending(pa_pdispatch *pd) {
     pa_assert(pd);
     pa_assert(PA_REFCNT_VALUE(pd) >= 1);
 
-    return !!pd->replies;
+    return !!pd->timeouts;
 }
 
 void pa_pdispatch_set_drain_callback(pa_pdispatch *pd, pa_pdispatch_drain_cb_t cb, void *userdata) {
@@ -410,7 +493,7 @@ void pa_pdispatch_unregister_reply(pa_pdispatch *pd, void *userdata) {
     pa_assert(pd);
     pa_assert(PA_REFCNT_VALUE(pd) >= 1);
 
-    PA_LLIST_FOREACH_SAFE(r, n, pd->replies)
+    PA_LLIST_FOREACH_SAFE(r, n, pd->timeouts)
         if (r->userdata == userdata)
             reply_info_free(r);
 }
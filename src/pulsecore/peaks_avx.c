@@ -0,0 +1,185 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <math.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "cpu-x86.h"
+#include "resampler.h"
+
+#if defined (PA_HAVE_X86_TARGET_ATTRIBUTE)
+
+#include <immintrin.h>
+
+/* The samples are taken a vector at a time, without caring where frames
+ * start. In a run of as many vectors as there are channels, every lane
+ * holds the same channel in each run, so each vector of the run gets a
+ * maximum of its own, and the lanes are sorted out into channels at the
+ * end. If the channels divide the vector evenly, all vectors look the
+ * same and four maxima are used in turn instead. */
+
+static void peaks_s16ne_tail(int16_t *m, const int16_t *s, unsigned channels, unsigned n_frames) {
+    unsigned c;
+
+    for (; n_frames > 0; n_frames--)
+        for (c = 0; c < channels; c++) {
+            int16_t n = (int16_t) PA_MIN(abs(*s++), 0x7FFF);
+
+            if (n > m[c])
+                m[c] = n;
+        }
+}
+
+static void peaks_float32ne_tail(float *m, const float *s, unsigned channels, unsigned n_frames) {
+    unsigned c;
+
+    for (; n_frames > 0; n_frames--)
+        for (c = 0; c < channels; c++) {
+            float n = fabsf(*s++);
+
+            if (n > m[c])
+                m[c] = n;
+        }
+}
+
+/* abs() that saturates -32768 to 32767 */
+PA_X86_TARGET("avx2")
+static inline __m256i abs_s16_avx2(__m256i x) {
+    return _mm256_max_epi16(x, _mm256_subs_epi16(_mm256_setzero_si256(), x));
+}
+
+PA_X86_TARGET("avx2")
+static void peaks_s16ne_avx2(void *max, const void *src, unsigned channels, unsigned n_frames) {
+    int16_t *m = max;
+    const int16_t *s = src;
+    __m256i acc[PA_CHANNELS_MAX];
+    int16_t t[16];
+    unsigned j, k, n_acc, run;
+
+    n_acc = 16 % channels == 0 ? 4 : channels;
+    run = n_acc * 16 / channels;
+
+    if (n_frames >= run) {
+        if (n_acc == 4) {
+            __m256i a0 = _mm256_setzero_si256(), a1 = a0, a2 = a0, a3 = a0;
+
+            for (; n_frames >= run; n_frames -= run, s += 64) {
+                a0 = _mm256_max_epi16(a0, abs_s16_avx2(_mm256_loadu_si256((const __m256i *) s)));
+                a1 = _mm256_max_epi16(a1, abs_s16_avx2(_mm256_loadu_si256((const __m256i *) (s + 16))));
+                a2 = _mm256_max_epi16(a2, abs_s16_avx2(_mm256_loadu_si256((const __m256i *) (s + 32))));
+                a3 = _mm256_max_epi16(a3, abs_s16_avx2(_mm256_loadu_si256((const __m256i *) (s + 48))));
+            }
+
+            acc[0] = _mm256_max_epi16(_mm256_max_epi16(a0, a1), _mm256_max_epi16(a2, a3));
+            n_acc = 1;
+        } else {
+            for (k = 0; k < n_acc; k++)
+                acc[k] = _mm256_setzero_si256();
+
+            for (; n_frames >= run; n_frames -= run)
+                for (k = 0; k < n_acc; k++, s += 16)
+                    acc[k] = _mm256_max_epi16(acc[k], abs_s16_avx2(_mm256_loadu_si256((const __m256i *) s)));
+        }
+
+        for (k = 0; k < n_acc; k++) {
+            _mm256_storeu_si256((__m256i *) t, acc[k]);
+
+            for (j = 0; j < 16; j++) {
+                unsigned c = (k * 16 + j) % channels;
+
+                if (t[j] > m[c])
+                    m[c] = t[j];
+            }
+        }
+    }
+
+    peaks_s16ne_tail(m, s, channels, n_frames);
+}
+
+PA_X86_TARGET("avx2")
+static void peaks_float32ne_avx2(void *max, const void *src, unsigned channels, unsigned n_frames) {
+    float *m = max;
+    const float *s = src;
+    const __m256 mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    __m256 acc[PA_CHANNELS_MAX];
+    float t[8];
+    unsigned j, k, n_acc, run;
+
+    n_acc = 8 % channels == 0 ? 4 : channels;
+    run = n_acc * 8 / channels;
+
+    if (n_frames >= run) {
+        /* The samples go first, so that max_ps keeps the maximum if a
+         * sample is NaN, like the comparison in the C version does */
+        if (n_acc == 4) {
+            __m256 a0 = _mm256_setzero_ps(), a1 = a0, a2 = a0, a3 = a0;
+
+            for (; n_frames >= run; n_frames -= run, s += 32) {
+                a0 = _mm256_max_ps(_mm256_and_ps(_mm256_loadu_ps(s), mask), a0);
+                a1 = _mm256_max_ps(_mm256_and_ps(_mm256_loadu_ps(s + 8), mask), a1);
+                a2 = _mm256_max_ps(_mm256_and_ps(_mm256_loadu_ps(s + 16), mask), a2);
+                a3 = _mm256_max_ps(_mm256_and_ps(_mm256_loadu_ps(s + 24), mask), a3);
+            }
+
+            acc[0] = _mm256_max_ps(_mm256_max_ps(a0, a1), _mm256_max_ps(a2, a3));
+            n_acc = 1;
+        } else {
+            for (k = 0; k < n_acc; k++)
+                acc[k] = _mm256_setzero_ps();
+
+            for (; n_frames >= run; n_frames -= run)
+                for (k = 0; k < n_acc; k++, s += 8)
+                    acc[k] = _mm256_max_ps(_mm256_and_ps(_mm256_loadu_ps(s), mask), acc[k]);
+        }
+
+        for (k = 0; k < n_acc; k++) {
+            _mm256_storeu_ps(t, acc[k]);
+
+            for (j = 0; j < 8; j++) {
+                unsigned c = (k * 8 + j) % channels;
+
+                if (t[j] > m[c])
+                    m[c] = t[j];
+            }
+        }
+    }
+
+    peaks_float32ne_tail(m, s, channels, n_frames);
+}
+#endif /* defined (PA_HAVE_X86_TARGET_ATTRIBUTE) */
+
+void pa_peaks_func_init_avx(pa_cpu_x86_flag_t flags) {
+#if defined (PA_HAVE_X86_TARGET_ATTRIBUTE)
+
+    if (flags & PA_CPU_X86_AVX2) {
+        pa_log_info("Initialising AVX2 optimized peak detection.");
+
+        pa_set_peaks_func(PA_SAMPLE_S16NE, (pa_peaks_func_t) peaks_s16ne_avx2);
+        pa_set_peaks_func(PA_SAMPLE_FLOAT32NE, (pa_peaks_func_t) peaks_float32ne_avx2);
+    }
+#endif /* defined (PA_HAVE_X86_TARGET_ATTRIBUTE) */
+}
@@ -0,0 +1,172 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <math.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "cpu-arm.h"
+#include "resampler.h"
+
+#if defined (__arm__) && defined (__ARM_NEON__)
+
+#include <arm_neon.h>
+
+/* Same scheme as the AVX2 versions: each vector of a run that spans a
+ * whole number of frames keeps its own maximum, and the lanes are sorted
+ * out into channels at the end. */
+
+static void peaks_s16ne_tail(int16_t *m, const int16_t *s, unsigned channels, unsigned n_frames) {
+    unsigned c;
+
+    for (; n_frames > 0; n_frames--)
+        for (c = 0; c < channels; c++) {
+            int16_t n = (int16_t) PA_MIN(abs(*s++), 0x7FFF);
+
+            if (n > m[c])
+                m[c] = n;
+        }
+}
+
+static void peaks_float32ne_tail(float *m, const float *s, unsigned channels, unsigned n_frames) {
+    unsigned c;
+
+    for (; n_frames > 0; n_frames--)
+        for (c = 0; c < channels; c++) {
+            float n = fabsf(*s++);
+
+            if (n > m[c])
+                m[c] = n;
+        }
+}
+
+static void peaks_s16ne_neon(void *max, const void *src, unsigned channels, unsigned n_frames) {
+    int16_t *m = max;
+    const int16_t *s = src;
+    int16x8_t acc[PA_CHANNELS_MAX];
+    int16_t t[8];
+    unsigned j, k, n_acc, run;
+
+    n_acc = 8 % channels == 0 ? 4 : channels;
+    run = n_acc * 8 / channels;
+
+    if (n_frames >= run) {
+        /* vqabsq saturates -32768 to 32767 */
+        if (n_acc == 4) {
+            int16x8_t a0 = vdupq_n_s16(0), a1 = a0, a2 = a0, a3 = a0;
+
+            for (; n_frames >= run; n_frames -= run, s += 32) {
+                a0 = vmaxq_s16(a0, vqabsq_s16(vld1q_s16(s)));
+                a1 = vmaxq_s16(a1, vqabsq_s16(vld1q_s16(s + 8)));
+                a2 = vmaxq_s16(a2, vqabsq_s16(vld1q_s16(s + 16)));
+                a3 = vmaxq_s16(a3, vqabsq_s16(vld1q_s16(s + 24)));
+            }
+
+            acc[0] = vmaxq_s16(vmaxq_s16(a0, a1), vmaxq_s16(a2, a3));
+            n_acc = 1;
+        } else {
+            for (k = 0; k < n_acc; k++)
+                acc[k] = vdupq_n_s16(0);
+
+            for (; n_frames >= run; n_frames -= run)
+                for (k = 0; k < n_acc; k++, s += 8)
+                    acc[k] = vmaxq_s16(acc[k], vqabsq_s16(vld1q_s16(s)));
+        }
+
+        for (k = 0; k < n_acc; k++) {
+            vst1q_s16(t, acc[k]);
+
+            for (j = 0; j < 8; j++) {
+                unsigned c = (k * 8 + j) % channels;
+
+                if (t[j] > m[c])
+                    m[c] = t[j];
+            }
+        }
+    }
+
+    peaks_s16ne_tail(m, s, channels, n_frames);
+}
+
+static void peaks_float32ne_neon(void *max, const void *src, unsigned channels, unsigned n_frames) {
+    float *m = max;
+    const float *s = src;
+    float32x4_t acc[PA_CHANNELS_MAX];
+    float t[4];
+    unsigned j, k, n_acc, run;
+
+    n_acc = 4 % channels == 0 ? 4 : channels;
+    run = n_acc * 4 / channels;
+
+    if (n_frames >= run) {
+        if (n_acc == 4) {
+            float32x4_t a0 = vdupq_n_f32(0), a1 = a0, a2 = a0, a3 = a0;
+
+            for (; n_frames >= run; n_frames -= run, s += 16) {
+                a0 = vmaxq_f32(a0, vabsq_f32(vld1q_f32(s)));
+                a1 = vmaxq_f32(a1, vabsq_f32(vld1q_f32(s + 4)));
+                a2 = vmaxq_f32(a2, vabsq_f32(vld1q_f32(s + 8)));
+                a3 = vmaxq_f32(a3, vabsq_f32(vld1q_f32(s + 12)));
+            }
+
+            acc[0] = vmaxq_f32(vmaxq_f32(a0, a1), vmaxq_f32(a2, a3));
+            n_acc = 1;
+        } else {
+            for (k = 0; k < n_acc; k++)
+                acc[k] = vdupq_n_f32(0);
+
+            for (; n_frames >= run; n_frames -= run)
+                for (k = 0; k < n_acc; k++, s += 4)
+                    acc[k] = vmaxq_f32(acc[k], vabsq_f32(vld1q_f32(s)));
+        }
+
+        for (k = 0; k < n_acc; k++) {
+            vst1q_f32(t, acc[k]);
+
+            for (j = 0; j < 4; j++) {
+                unsigned c = (k * 4 + j) % channels;
+
+                if (t[j] > m[c])
+                    m[c] = t[j];
+            }
+        }
+    }
+
+    peaks_float32ne_tail(m, s, channels, n_frames);
+}
+#endif /* defined (__arm__) && defined (__ARM_NEON__) */
+
+void pa_peaks_func_init_neon(pa_cpu_arm_flag_t flags) {
+#if defined (__arm__) && defined (__ARM_NEON__)
+
+    if (flags & PA_CPU_ARM_NEON) {
+        pa_log_info("Initialising NEON optimized peak detection.");
+
+        pa_set_peaks_func(PA_SAMPLE_S16NE, (pa_peaks_func_t) peaks_s16ne_neon);
+        pa_set_peaks_func(PA_SAMPLE_FLOAT32NE, (pa_peaks_func_t) peaks_float32ne_neon);
+    }
+#endif /* defined (__arm__) && defined (__ARM_NEON__) */
+}
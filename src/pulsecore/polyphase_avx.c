@@ -0,0 +1,116 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "cpu-x86.h"
+#include "resampler.h"
+
+#if defined (PA_HAVE_X86_TARGET_ATTRIBUTE)
+
+#include <immintrin.h>
+
+/* Mono and stereo run the filter along the samples, eight at a time,
+ * and add up the lanes of each channel at the end. With more channels
+ * each tap is applied to eight channels of a frame at once. */
+
+PA_X86_TARGET("avx2")
+static inline __m256 coefs_avx2(const float *coefs0, const float *coefs1, __m256 mu, unsigned j) {
+    __m256 h = _mm256_loadu_ps(coefs0 + j);
+
+    if (coefs1)
+        h = _mm256_add_ps(h, _mm256_mul_ps(mu, _mm256_sub_ps(_mm256_loadu_ps(coefs1 + j), h)));
+
+    return h;
+}
+
+PA_X86_TARGET("avx2")
+static void polyphase_avx2(float *dst, const float *src, const float *coefs0, const float *coefs1, float mu,
+                           unsigned n_taps, unsigned channels) {
+    __m256 m = _mm256_set1_ps(mu);
+    unsigned c, j;
+
+    if (channels <= 2) {
+        __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+        __m128 x;
+        unsigned n = n_taps * channels;
+
+        /* n is a multiple of 8, use two accumulators where possible */
+        for (j = 0; j + 16 <= n; j += 16) {
+            acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(coefs_avx2(coefs0, coefs1, m, j), _mm256_loadu_ps(src + j)));
+            acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(coefs_avx2(coefs0, coefs1, m, j + 8), _mm256_loadu_ps(src + j + 8)));
+        }
+        if (j < n)
+            acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(coefs_avx2(coefs0, coefs1, m, j), _mm256_loadu_ps(src + j)));
+
+        acc0 = _mm256_add_ps(acc0, acc1);
+        x = _mm_add_ps(_mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0, 1));
+        x = _mm_add_ps(x, _mm_movehl_ps(x, x));
+
+        if (channels == 1)
+            _mm_store_ss(dst, _mm_add_ss(x, _mm_shuffle_ps(x, x, _MM_SHUFFLE(1, 1, 1, 1))));
+        else
+            _mm_storel_pi((__m64 *) dst, x);
+
+        return;
+    }
+
+    for (c = 0; c < channels; c += 8) {
+        __m256 acc = _mm256_setzero_ps();
+        const float *s = src + c;
+
+        for (j = 0; j < n_taps; j++, s += channels) {
+            float h = coefs0[j];
+
+            if (coefs1)
+                h += mu * (coefs1[j] - h);
+
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_set1_ps(h), _mm256_loadu_ps(s)));
+        }
+
+        if (c + 8 <= channels)
+            _mm256_storeu_ps(dst + c, acc);
+        else {
+            float t[8];
+
+            _mm256_storeu_ps(t, acc);
+            memcpy(dst + c, t, (channels - c) * sizeof(float));
+        }
+    }
+}
+#endif /* defined (PA_HAVE_X86_TARGET_ATTRIBUTE) */
+
+void pa_polyphase_func_init_avx(pa_cpu_x86_flag_t flags) {
+#if defined (PA_HAVE_X86_TARGET_ATTRIBUTE)
+
+    if (flags & PA_CPU_X86_AVX2) {
+        pa_log_info("Initialising AVX2 optimized polyphase resampler.");
+
+        pa_set_polyphase_func((pa_polyphase_func_t) polyphase_avx2);
+    }
+#endif /* defined (PA_HAVE_X86_TARGET_ATTRIBUTE) */
+}
@@ -0,0 +1,108 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "cpu-arm.h"
+#include "resampler.h"
+
+#if defined (__arm__) && defined (__ARM_NEON__)
+
+#include <arm_neon.h>
+
+/* Same approach as the AVX2 version, four lanes at a time */
+
+static inline float32x4_t coefs_neon(const float *coefs0, const float *coefs1, float mu, unsigned j) {
+    float32x4_t h = vld1q_f32(coefs0 + j);
+
+    if (coefs1)
+        h = vmlaq_n_f32(h, vsubq_f32(vld1q_f32(coefs1 + j), h), mu);
+
+    return h;
+}
+
+static void polyphase_neon(float *dst, const float *src, const float *coefs0, const float *coefs1, float mu,
+                           unsigned n_taps, unsigned channels) {
+    unsigned c, j;
+
+    if (channels <= 2) {
+        float32x4_t acc0 = vdupq_n_f32(0.0f), acc1 = vdupq_n_f32(0.0f);
+        float32x2_t x;
+        unsigned n = n_taps * channels;
+
+        /* n is a multiple of 8 */
+        for (j = 0; j < n; j += 8) {
+            acc0 = vmlaq_f32(acc0, coefs_neon(coefs0, coefs1, mu, j), vld1q_f32(src + j));
+            acc1 = vmlaq_f32(acc1, coefs_neon(coefs0, coefs1, mu, j + 4), vld1q_f32(src + j + 4));
+        }
+
+        acc0 = vaddq_f32(acc0, acc1);
+        x = vadd_f32(vget_low_f32(acc0), vget_high_f32(acc0));
+
+        if (channels == 1)
+            dst[0] = vget_lane_f32(vpadd_f32(x, x), 0);
+        else
+            vst1_f32(dst, x);
+
+        return;
+    }
+
+    for (c = 0; c < channels; c += 4) {
+        float32x4_t acc = vdupq_n_f32(0.0f);
+        const float *s = src + c;
+
+        for (j = 0; j < n_taps; j++, s += channels) {
+            float h = coefs0[j];
+
+            if (coefs1)
+                h += mu * (coefs1[j] - h);
+
+            acc = vmlaq_n_f32(acc, vld1q_f32(s), h);
+        }
+
+        if (c + 4 <= channels)
+            vst1q_f32(dst + c, acc);
+        else {
+            float t[4];
+
+            vst1q_f32(t, acc);
+            memcpy(dst + c, t, (channels - c) * sizeof(float));
+        }
+    }
+}
+#endif /* defined (__arm__) && defined (__ARM_NEON__) */
+
+void pa_polyphase_func_init_neon(pa_cpu_arm_flag_t flags) {
+#if defined (__arm__) && defined (__ARM_NEON__)
+
+    if (flags & PA_CPU_ARM_NEON) {
+        pa_log_info("Initialising NEON optimized polyphase resampler.");
+
+        pa_set_polyphase_func((pa_polyphase_func_t) polyphase_neon);
+    }
+#endif /* defined (__arm__) && defined (__ARM_NEON__) */
+}
@@ -25,6 +25,7 @@
 
 #include <dbus/dbus.h>
 
+#include <pulse/rtclock.h>
 #include <pulse/xmalloc.h>
 
 #include <pulsecore/core-util.h>
@@ -44,9 +45,19 @@ struct pa_dbus_protocol {
     pa_hashmap *connections; /* DBusConnection -> struct connection_entry */
     pa_idxset *extensions; /* Strings */
 
+    /* "path interface.signal" -> struct pending_signal, in the order the
+     * signals were first queued. */
+    pa_hashmap *pending_signals;
+    pa_time_event *flush_event;
+
     pa_hook hooks[PA_DBUS_PROTOCOL_HOOK_MAX];
 };
 
+struct pending_signal {
+    char *key;
+    DBusMessage *msg;
+};
+
 struct object_entry {
     char *path;
     pa_hashmap *interfaces; /* Interface name -> struct interface_entry */
@@ -86,6 +97,8 @@ struct interface_entry {
     void *userdata;
 };
 
+static void flush_pending_signals(pa_dbus_protocol *p);
+
 char *pa_get_dbus_address_from_server_type(pa_server_type_t server_type) {
     char *address = NULL;
     char *runtime_path = NULL;
@@ -129,6 +142,8 @@ static pa_dbus_protocol *dbus_protocol_new(pa_core *c) {
     p->objects = pa_hashmap_new(pa_idxset_string_hash_func, pa_idxset_string_compare_func);
     p->connections = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
     p->extensions = pa_idxset_new(pa_idxset_string_hash_func, pa_idxset_string_compare_func);
+    p->pending_signals = pa_hashmap_new(pa_idxset_string_hash_func, pa_idxset_string_compare_func);
+    p->flush_event = NULL;
 
     for (i = 0; i < PA_DBUS_PROTOCOL_HOOK_MAX; ++i)
         pa_hook_init(&p->hooks[i], p);
@@ -156,7 +171,16 @@ pa_dbus_protocol* pa_dbus_protocol_ref(pa_dbus_protocol *p) {
     return p;
 }
 
+static void pending_signal_free(struct pending_signal *ps) {
+    pa_assert(ps);
+
+    dbus_message_unref(ps->msg);
+    pa_xfree(ps->key);
+    pa_xfree(ps);
+}
+
 void pa_dbus_protocol_unref(pa_dbus_protocol *p) {
+    struct pending_signal *ps;
     unsigned i;
 
     pa_assert(p);
@@ -173,6 +197,15 @@ void pa_dbus_protocol_unref(pa_dbus_protocol *p) {
     pa_hashmap_free(p->connections, NULL, NULL);
     pa_idxset_free(p->extensions, NULL, NULL);
 
+    /* With no connections left there is nobody to send these to */
+    while ((ps = pa_hashmap_steal_first(p->pending_signals)))
+        pending_signal_free(ps);
+
+    pa_hashmap_free(p->pending_signals, NULL, NULL);
+
+    if (p->flush_event)
+        p->core->mainloop->time_free(p->flush_event);
+
     for (i = 0; i < PA_DBUS_PROTOCOL_HOOK_MAX; ++i)
         pa_hook_done(&p->hooks[i]);
 
@@ -839,6 +872,9 @@ int pa_dbus_protocol_remove_interface(pa_dbus_protocol *p, const char* path, con
     if (!(iface_entry = pa_hashmap_remove(obj_entry->interfaces, interface)))
         return -1;
 
+    /* Whatever the object still had to say goes out before it disappears */
+    flush_pending_signals(p);
+
     update_introspection(obj_entry);
 
     pa_log_debug("Interface %s removed from object %s", iface_entry->name, obj_entry->path);
@@ -1067,7 +1103,7 @@ void pa_dbus_protocol_remove_signal_listener(pa_dbus_protocol *p, DBusConnection
     }
 }
 
-void pa_dbus_protocol_send_signal(pa_dbus_protocol *p, DBusMessage *signal_msg) {
+static void send_signal(pa_dbus_protocol *p, DBusMessage *signal_msg) {
     struct connection_entry *conn_entry;
     struct signal_paths_entry *signal_paths_entry;
     void *state = NULL;
@@ -1102,6 +1138,74 @@ void pa_dbus_protocol_send_signal(pa_dbus_protocol *p, DBusMessage *signal_msg)
     pa_xfree(signal_string);
 }
 
+static void flush_pending_signals(pa_dbus_protocol *p) {
+    struct pending_signal *ps;
+
+    pa_assert(p);
+
+    while ((ps = pa_hashmap_steal_first(p->pending_signals))) {
+        send_signal(p, ps->msg);
+        pending_signal_free(ps);
+    }
+
+    if (p->flush_event) {
+        p->core->mainloop->time_free(p->flush_event);
+        p->flush_event = NULL;
+    }
+}
+
+static void flush_event_cb(pa_mainloop_api *m, pa_time_event *e, const struct timeval *t, void *userdata) {
+    pa_dbus_protocol *p = userdata;
+
+    pa_assert(p);
+    pa_assert(p->flush_event == e);
+
+    flush_pending_signals(p);
+}
+
+void pa_dbus_protocol_send_signal(pa_dbus_protocol *p, DBusMessage *signal_msg) {
+    pa_assert(p);
+    pa_assert(signal_msg);
+
+    /* Keep the order in which the signals were emitted */
+    flush_pending_signals(p);
+
+    send_signal(p, signal_msg);
+}
+
+void pa_dbus_protocol_send_coalesced_signal(pa_dbus_protocol *p, DBusMessage *signal_msg) {
+    struct pending_signal *ps;
+    char *key;
+
+    pa_assert(p);
+    pa_assert(signal_msg);
+    pa_assert(dbus_message_get_type(signal_msg) == DBUS_MESSAGE_TYPE_SIGNAL);
+    pa_assert(dbus_message_get_path(signal_msg));
+    pa_assert(dbus_message_get_interface(signal_msg));
+    pa_assert(dbus_message_get_member(signal_msg));
+
+    key = pa_sprintf_malloc("%s %s.%s",
+                            dbus_message_get_path(signal_msg),
+                            dbus_message_get_interface(signal_msg),
+                            dbus_message_get_member(signal_msg));
+
+    if ((ps = pa_hashmap_get(p->pending_signals, key))) {
+        /* The latest value wins, but the signal keeps its place in the queue */
+        dbus_message_unref(ps->msg);
+        ps->msg = dbus_message_ref(signal_msg);
+        pa_xfree(key);
+        return;
+    }
+
+    ps = pa_xnew(struct pending_signal, 1);
+    ps->key = key;
+    ps->msg = dbus_message_ref(signal_msg);
+    pa_assert_se(pa_hashmap_put(p->pending_signals, ps->key, ps) >= 0);
+
+    if (!p->flush_event)
+        p->flush_event = pa_core_rttime_new(p->core, pa_rtclock_now() + PA_DBUS_SIGNAL_COALESCE_USEC, flush_event_cb, p);
+}
+
 const char **pa_dbus_protocol_get_extensions(pa_dbus_protocol *p, unsigned *n) {
     const char **extensions;
     const char *ext_name;
@@ -24,6 +24,8 @@
 
 #include <dbus/dbus.h>
 
+#include <pulse/timeval.h>
+
 #include <pulsecore/core.h>
 #include <pulsecore/macro.h>
 
@@ -172,6 +174,19 @@ void pa_dbus_protocol_remove_signal_listener(pa_dbus_protocol *p, DBusConnection
  * pa_dbus_protocol_add_signal_listener(). */
 void pa_dbus_protocol_send_signal(pa_dbus_protocol *p, DBusMessage *signal);
 
+/* How long a signal sent with pa_dbus_protocol_send_coalesced_signal() may
+ * be held back. */
+#define PA_DBUS_SIGNAL_COALESCE_USEC (50 * PA_USEC_PER_MSEC)
+
+/* Like pa_dbus_protocol_send_signal(), but for signals that carry the whole
+ * new value of something that may change many times a second, like a
+ * volume. The signal is sent within PA_DBUS_SIGNAL_COALESCE_USEC, and if the
+ * same object sends the same signal again before that, only the latest one
+ * is delivered. Signals sent with pa_dbus_protocol_send_signal() flush the
+ * queued ones first, so clients still see everything in order. The signal
+ * message is referenced, so the caller may unref it right away. */
+void pa_dbus_protocol_send_coalesced_signal(pa_dbus_protocol *p, DBusMessage *signal);
+
 /* Returns an array of extension identifier strings. The strings pointers point
  * to the internal copies, so don't free the strings. The caller must free the
  * array, however. Also, do not save the returned pointer or any of the string
@@ -290,7 +290,9 @@ static void connection_write_prepare(connection *c, size_t length) {
     pa_assert(c->write_data);
 }
 
-static void connection_write(connection *c, const void *data, size_t length) {
+/* Appends length bytes to the reply and returns where to put them.
+ * Only valid until the next write. */
+static uint8_t* connection_write_reserve(connection *c, size_t length) {
     size_t i;
     pa_assert(c);
 
@@ -303,7 +305,18 @@ static void connection_write(connection *c, const void *data, size_t length) {
     i = c->write_data_length;
     c->write_data_length += length;
 
-    memcpy((uint8_t*) c->write_data + i, data, length);
+    return (uint8_t*) c->write_data + i;
+}
+
+static void connection_write(connection *c, const void *data, size_t length) {
+    memcpy(connection_write_reserve(c, length), data, length);
+}
+
+static uint8_t* put_int32(uint8_t *p, pa_bool_t swap, int32_t v) {
+    v = PA_MAYBE_INT32_SWAP(swap, v);
+    memcpy(p, &v, sizeof(int32_t));
+
+    return p + sizeof(int32_t);
 }
 
 static void format_esd2native(int format, pa_bool_t swap_bytes, pa_sample_spec *ss) {
@@ -614,7 +627,7 @@ static int esd_proto_all_info(connection *c, esd_proto_t request, const void *da
     connection *conn;
     uint32_t idx = PA_IDXSET_INVALID;
     unsigned nsamples;
-    char terminator[sizeof(int32_t)*6+ESD_NAME_MAX];
+    uint8_t *p, *end;
 
     connection_assert_ref(c);
     pa_assert(data);
@@ -628,18 +641,20 @@ static int esd_proto_all_info(connection *c, esd_proto_t request, const void *da
     nsamples = pa_idxset_size(c->protocol->core->scache);
     t = s*(nsamples+1) + k*(c->protocol->n_player+1);
 
-    connection_write_prepare(c, t);
-
-    memset(terminator, 0, sizeof(terminator));
+    /* The whole reply is built in place. Zeroing it first takes care
+     * of the terminators and of the padding of the names. */
+    p = connection_write_reserve(c, t);
+    end = p + t;
+    memset(p, 0, t);
 
     PA_IDXSET_FOREACH(conn, c->protocol->connections, idx) {
-        int32_t id, format = ESD_BITS16 | ESD_STEREO, rate = 44100, lvolume = ESD_VOLUME_BASE, rvolume = ESD_VOLUME_BASE;
-        char name[ESD_NAME_MAX];
+        int32_t format = ESD_BITS16 | ESD_STEREO, rate = 44100, lvolume = ESD_VOLUME_BASE, rvolume = ESD_VOLUME_BASE;
+        const char *name;
 
         if (conn->state != ESD_STREAMING_DATA)
             continue;
 
-        pa_assert(t >= k*2+s);
+        pa_assert(p + k*2 + s <= end);
 
         if (conn->sink_input) {
             pa_cvolume volume;
@@ -651,40 +666,31 @@ static int esd_proto_all_info(connection *c, esd_proto_t request, const void *da
         }
 
         /* id */
-        id = PA_MAYBE_INT32_SWAP(c->swap_byte_order, (int32_t) (conn->index+1));
-        connection_write(c, &id, sizeof(int32_t));
+        p = put_int32(p, c->swap_byte_order, (int32_t) (conn->index+1));
 
         /* name */
-        memset(name, 0, ESD_NAME_MAX); /* don't leak old data */
         if (conn->original_name)
-            strncpy(name, conn->original_name, ESD_NAME_MAX);
-        else if (conn->client && pa_proplist_gets(conn->client->proplist, PA_PROP_APPLICATION_NAME))
-            strncpy(name, pa_proplist_gets(conn->client->proplist, PA_PROP_APPLICATION_NAME), ESD_NAME_MAX);
-        connection_write(c, name, ESD_NAME_MAX);
-
-        /* rate */
-        rate = PA_MAYBE_INT32_SWAP(c->swap_byte_order, rate);
-        connection_write(c, &rate, sizeof(int32_t));
-
-        /* left */
-        lvolume = PA_MAYBE_INT32_SWAP(c->swap_byte_order, lvolume);
-        connection_write(c, &lvolume, sizeof(int32_t));
-
-        /*right*/
-        rvolume = PA_MAYBE_INT32_SWAP(c->swap_byte_order, rvolume);
-        connection_write(c, &rvolume, sizeof(int32_t));
-
-        /*format*/
-        format = PA_MAYBE_INT32_SWAP(c->swap_byte_order, format);
-        connection_write(c, &format, sizeof(int32_t));
-
-        t -= k;
+            name = conn->original_name;
+        else if (conn->client)
+            name = pa_proplist_gets(conn->client->proplist, PA_PROP_APPLICATION_NAME);
+        else
+            name = NULL;
+
+        if (name)
+            strncpy((char*) p, name, ESD_NAME_MAX);
+        p += ESD_NAME_MAX;
+
+        /* rate, left, right, format */
+        p = put_int32(p, c->swap_byte_order, rate);
+        p = put_int32(p, c->swap_byte_order, lvolume);
+        p = put_int32(p, c->swap_byte_order, rvolume);
+        p = put_int32(p, c->swap_byte_order, format);
     }
 
-    pa_assert(t == s*(nsamples+1)+k);
-    t -= k;
+    pa_assert(p + s*(nsamples+1) + k == end);
 
-    connection_write(c, terminator, k);
+    /* terminator */
+    p += k;
 
     if (nsamples) {
         pa_scache_entry *ce;
@@ -692,13 +698,11 @@ static int esd_proto_all_info(connection *c, esd_proto_t request, const void *da
         idx = PA_IDXSET_INVALID;
 
         PA_IDXSET_FOREACH(ce, c->protocol->core->scache, idx) {
-            int32_t id, rate, lvolume, rvolume, format, len;
-            char name[ESD_NAME_MAX];
             pa_channel_map stereo = { .channels = 2, .map = { PA_CHANNEL_POSITION_LEFT, PA_CHANNEL_POSITION_RIGHT } };
             pa_cvolume volume;
             pa_sample_spec ss;
 
-            pa_assert(t >= s*2);
+            pa_assert(p + s*2 <= end);
 
             if (ce->volume_is_set) {
                 volume = ce->volume;
@@ -715,44 +719,26 @@ static int esd_proto_all_info(connection *c, esd_proto_t request, const void *da
             }
 
             /* id */
-            id = PA_MAYBE_INT32_SWAP(c->swap_byte_order, (int) (ce->index+1));
-            connection_write(c, &id, sizeof(int32_t));
+            p = put_int32(p, c->swap_byte_order, (int32_t) (ce->index+1));
 
             /* name */
-            memset(name, 0, ESD_NAME_MAX); /* don't leak old data */
             if (strncmp(ce->name, SCACHE_PREFIX, sizeof(SCACHE_PREFIX)-1) == 0)
-                strncpy(name, ce->name+sizeof(SCACHE_PREFIX)-1, ESD_NAME_MAX);
+                strncpy((char*) p, ce->name+sizeof(SCACHE_PREFIX)-1, ESD_NAME_MAX);
             else
-                pa_snprintf(name, ESD_NAME_MAX, "native.%s", ce->name);
-            connection_write(c, name, ESD_NAME_MAX);
-
-            /* rate */
-            rate = PA_MAYBE_INT32_SWAP(c->swap_byte_order, (int32_t) ss.rate);
-            connection_write(c, &rate, sizeof(int32_t));
-
-            /* left */
-            lvolume = PA_MAYBE_INT32_SWAP(c->swap_byte_order, (int32_t) ((volume.values[0]*ESD_VOLUME_BASE)/PA_VOLUME_NORM));
-            connection_write(c, &lvolume, sizeof(int32_t));
-
-            /*right*/
-            rvolume = PA_MAYBE_INT32_SWAP(c->swap_byte_order, (int32_t) ((volume.values[1]*ESD_VOLUME_BASE)/PA_VOLUME_NORM));
-            connection_write(c, &rvolume, sizeof(int32_t));
-
-            /*format*/
-            format = PA_MAYBE_INT32_SWAP(c->swap_byte_order, format_native2esd(&ss));
-            connection_write(c, &format, sizeof(int32_t));
-
-            /*length*/
-            len = PA_MAYBE_INT32_SWAP(c->swap_byte_order, (int) ce->memchunk.length);
-            connection_write(c, &len, sizeof(int32_t));
-
-            t -= s;
+                pa_snprintf((char*) p, ESD_NAME_MAX, "native.%s", ce->name);
+            p += ESD_NAME_MAX;
+
+            /* rate, left, right, format, length */
+            p = put_int32(p, c->swap_byte_order, (int32_t) ss.rate);
+            p = put_int32(p, c->swap_byte_order, (int32_t) ((volume.values[0]*ESD_VOLUME_BASE)/PA_VOLUME_NORM));
+            p = put_int32(p, c->swap_byte_order, (int32_t) ((volume.values[1]*ESD_VOLUME_BASE)/PA_VOLUME_NORM));
+            p = put_int32(p, c->swap_byte_order, format_native2esd(&ss));
+            p = put_int32(p, c->swap_byte_order, (int32_t) ce->memchunk.length);
         }
     }
 
-    pa_assert(t == s);
-
-    connection_write(c, terminator, s);
+    /* The final terminator is already zeroed */
+    pa_assert(p + s == end);
 
     return 0;
 }
@@ -1123,9 +1109,11 @@ static int do_read(connection *c) {
 
     } else if (c->state == ESD_STREAMING_DATA && c->sink_input) {
         pa_memchunk chunk;
+        pa_memblock *next = NULL;
+        struct iovec iov[2];
+        unsigned n = 0;
         ssize_t r;
         size_t l;
-        void *p;
         size_t space = 0;
 
         pa_assert(c->input_memblockq);
@@ -1152,15 +1140,30 @@ static int do_read(connection *c) {
             space = pa_memblock_get_length(c->playback.current_memblock);
         }
 
-        if (l > space)
-            l = space;
+        iov[n].iov_base = (uint8_t*) pa_memblock_acquire(c->playback.current_memblock) + c->playback.memblock_index;
+        iov[n++].iov_len = PA_MIN(l, space);
+
+        /* If more is missing than still fits in the current block, read
+         * the rest into the next one right away. Its slot goes back to
+         * the pool if it ends up unused. */
+        if (l > space) {
+            pa_assert_se(next = pa_memblock_new(c->protocol->core->mempool, (size_t) -1));
+
+            iov[n].iov_base = pa_memblock_acquire(next);
+            iov[n++].iov_len = PA_MIN(l - space, pa_memblock_get_length(next));
+        }
+
+        r = pa_iochannel_readv(c->io, iov, n);
 
-        p = pa_memblock_acquire(c->playback.current_memblock);
-        r = pa_iochannel_read(c->io, (uint8_t*) p+c->playback.memblock_index, l);
         pa_memblock_release(c->playback.current_memblock);
+        if (next)
+            pa_memblock_release(next);
 
         if (r <= 0) {
 
+            if (next)
+                pa_memblock_unref(next);
+
             if (r < 0 && (errno == EINTR || errno == EAGAIN))
                 return 0;
 
@@ -1168,14 +1171,32 @@ static int do_read(connection *c) {
             return -1;
         }
 
+        pa_atomic_sub(&c->playback.missing, (int) r);
+
         chunk.memblock = c->playback.current_memblock;
         chunk.index = c->playback.memblock_index;
-        chunk.length = (size_t) r;
+        chunk.length = PA_MIN((size_t) r, iov[0].iov_len);
 
-        c->playback.memblock_index += (size_t) r;
+        c->playback.memblock_index += chunk.length;
 
-        pa_atomic_sub(&c->playback.missing, (int) r);
         pa_asyncmsgq_post(c->sink_input->sink->asyncmsgq, PA_MSGOBJECT(c->sink_input), SINK_INPUT_MESSAGE_POST_DATA, NULL, 0, &chunk, NULL);
+
+        if (next) {
+            if ((size_t) r > chunk.length) {
+                pa_memblock_unref(c->playback.current_memblock);
+                c->playback.current_memblock = next;
+
+                chunk.memblock = next;
+                chunk.index = 0;
+                chunk.length = (size_t) r - chunk.length;
+
+                c->playback.memblock_index = chunk.length;
+
+                pa_asyncmsgq_post(c->sink_input->sink->asyncmsgq, PA_MSGOBJECT(c->sink_input), SINK_INPUT_MESSAGE_POST_DATA, NULL, 0, &chunk, NULL);
+            } else
+                pa_memblock_unref(next);
+        }
+
     }
 
     return 0;
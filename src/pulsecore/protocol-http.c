@@ -42,11 +42,12 @@
 #include <pulsecore/shared.h>
 #include <pulsecore/core-error.h>
 #include <pulsecore/mime-type.h>
+#include <pulsecore/llist.h>
 
 #include "protocol-http.h"
 
 /* Don't allow more than this many concurrent connections */
-#define MAX_CONNECTIONS 10
+#define MAX_CONNECTIONS 64
 
 #define URL_ROOT "/"
 #define URL_CSS "/style"
@@ -86,17 +87,32 @@ enum method {
     METHOD_HEAD
 };
 
+struct broadcast;
+
 struct connection {
     pa_http_protocol *protocol;
     pa_iochannel *io;
     pa_ioline *line;
     pa_memblockq *output_memblockq;
-    pa_source_output *source_output;
+    struct broadcast *broadcast;
     pa_client *client;
     enum state state;
     char *url;
     enum method method;
     pa_module *module;
+
+    PA_LLIST_FIELDS(struct connection);
+};
+
+/* All listeners of a source share one source output. Every chunk it
+ * records is queued for each of them by reference, so the data is
+ * neither converted nor copied per listener. */
+struct broadcast {
+    pa_http_protocol *protocol;
+    pa_source_output *source_output;
+
+    PA_LLIST_HEAD(struct connection, listeners);
+    PA_LLIST_FIELDS(struct broadcast);
 };
 
 struct pa_http_protocol {
@@ -105,6 +121,8 @@ struct pa_http_protocol {
     pa_core *core;
     pa_idxset *connections;
 
+    PA_LLIST_HEAD(struct broadcast, broadcasts);
+
     pa_strlist *servers;
 };
 
@@ -112,14 +130,31 @@ enum {
     SOURCE_OUTPUT_MESSAGE_POST_DATA = PA_SOURCE_OUTPUT_MESSAGE_MAX
 };
 
+/* Called from main context */
+static void broadcast_free(struct broadcast *b) {
+    pa_assert(b);
+    pa_assert(!b->listeners);
+
+    PA_LLIST_REMOVE(struct broadcast, b->protocol->broadcasts, b);
+
+    if (b->source_output) {
+        pa_source_output_unlink(b->source_output);
+        b->source_output->userdata = NULL;
+        pa_source_output_unref(b->source_output);
+    }
+
+    pa_xfree(b);
+}
+
 /* Called from main context */
 static void connection_unlink(struct connection *c) {
     pa_assert(c);
 
-    if (c->source_output) {
-        pa_source_output_unlink(c->source_output);
-        c->source_output->userdata = NULL;
-        pa_source_output_unref(c->source_output);
+    if (c->broadcast) {
+        PA_LLIST_REMOVE(struct connection, c->broadcast->listeners, c);
+
+        if (!c->broadcast->listeners)
+            broadcast_free(c->broadcast);
     }
 
     if (c->client)
@@ -195,11 +230,12 @@ fail:
 /* Called from thread context, except when it is not */
 static int source_output_process_msg(pa_msgobject *m, int code, void *userdata, int64_t offset, pa_memchunk *chunk) {
     pa_source_output *o = PA_SOURCE_OUTPUT(m);
-    struct connection *c;
+    struct broadcast *b;
+    struct connection *c, *n;
 
     pa_source_output_assert_ref(o);
 
-    if (!(c = o->userdata))
+    if (!(b = o->userdata))
         return -1;
 
     switch (code) {
@@ -207,8 +243,28 @@ static int source_output_process_msg(pa_msgobject *m, int code, void *userdata,
         case SOURCE_OUTPUT_MESSAGE_POST_DATA:
             /* While this function is usually called from IO thread
              * context, this specific command is not! */
-            pa_memblockq_push_align(c->output_memblockq, chunk);
-            do_work(c);
+
+            /* The last listener going away frees b, so hold on to the
+             * source output while iterating */
+            pa_source_output_ref(o);
+
+            PA_LLIST_FOREACH_SAFE(c, n, b->listeners) {
+
+                /* A listener that can't keep up is dropped, instead of
+                 * buffering without bound for it */
+                if (pa_memblockq_push_align(c->output_memblockq, chunk) < 0) {
+                    pa_log_info("HTTP listener is %u seconds behind, dropping it.", RECORD_BUFFER_SECONDS);
+                    connection_unlink(c);
+                    continue;
+                }
+
+                /* Until the response header is out, the data just
+                 * queues up */
+                if (c->io)
+                    do_work(c);
+            }
+
+            pa_source_output_unref(o);
             break;
 
         default:
@@ -220,10 +276,10 @@ static int source_output_process_msg(pa_msgobject *m, int code, void *userdata,
 
 /* Called from thread context */
 static void source_output_push_cb(pa_source_output *o, const pa_memchunk *chunk) {
-    struct connection *c;
+    struct broadcast *b;
 
     pa_source_output_assert_ref(o);
-    pa_assert_se(c = o->userdata);
+    pa_assert_se(b = o->userdata);
     pa_assert(chunk);
 
     pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(o), SOURCE_OUTPUT_MESSAGE_POST_DATA, NULL, 0, chunk, NULL);
@@ -231,22 +287,30 @@ static void source_output_push_cb(pa_source_output *o, const pa_memchunk *chunk)
 
 /* Called from main context */
 static void source_output_kill_cb(pa_source_output *o) {
-    struct connection*c;
+    struct broadcast *b;
 
     pa_source_output_assert_ref(o);
-    pa_assert_se(c = o->userdata);
+    pa_assert_se(b = o->userdata);
 
-    connection_unlink(c);
+    /* The broadcast goes away with its last listener */
+    while (b->listeners)
+        connection_unlink(b->listeners);
 }
 
 /* Called from main context */
 static pa_usec_t source_output_get_latency_cb(pa_source_output *o) {
-    struct connection*c;
+    struct broadcast *b;
+    struct connection *c;
+    size_t l = 0;
 
     pa_source_output_assert_ref(o);
-    pa_assert_se(c = o->userdata);
+    pa_assert_se(b = o->userdata);
+
+    /* As far as the slowest listener is concerned */
+    PA_LLIST_FOREACH(c, b->listeners)
+        l = PA_MAX(l, pa_memblockq_get_length(c->output_memblockq));
 
-    return pa_bytes_to_usec(pa_memblockq_get_length(c->output_memblockq), &c->source_output->sample_spec);
+    return pa_bytes_to_usec(l, &o->sample_spec);
 }
 
 /*** client callbacks ***/
@@ -533,9 +597,58 @@ static void line_drain_callback(pa_ioline *l, void *userdata) {
     c->line = NULL;
 }
 
+static struct broadcast *broadcast_get(struct connection *c, pa_source *source, const pa_sample_spec *ss, const pa_channel_map *cm) {
+    struct broadcast *b;
+    pa_source_output_new_data data;
+
+    pa_assert(c);
+    pa_assert(source);
+
+    PA_LLIST_FOREACH(b, c->protocol->broadcasts)
+        if (b->source_output->source == source &&
+            pa_sample_spec_equal(&b->source_output->sample_spec, ss) &&
+            pa_channel_map_equal(&b->source_output->channel_map, cm))
+            return b;
+
+    b = pa_xnew0(struct broadcast, 1);
+    b->protocol = c->protocol;
+
+    /* Not owned by any of the listeners' clients, since any of them
+     * may leave first */
+    pa_source_output_new_data_init(&data);
+    data.driver = __FILE__;
+    data.module = c->module;
+    pa_source_output_new_data_set_source(&data, source, FALSE);
+    pa_proplist_setf(data.proplist, PA_PROP_MEDIA_NAME, "HTTP stream of %s", pa_strnull(pa_proplist_gets(source->proplist, PA_PROP_DEVICE_DESCRIPTION)));
+    pa_source_output_new_data_set_sample_spec(&data, ss);
+    pa_source_output_new_data_set_channel_map(&data, cm);
+
+    pa_source_output_new(&b->source_output, c->protocol->core, &data);
+    pa_source_output_new_data_done(&data);
+
+    if (!b->source_output) {
+        pa_xfree(b);
+        return NULL;
+    }
+
+    b->source_output->parent.process_msg = source_output_process_msg;
+    b->source_output->push = source_output_push_cb;
+    b->source_output->kill = source_output_kill_cb;
+    b->source_output->get_latency = source_output_get_latency_cb;
+    b->source_output->userdata = b;
+
+    pa_source_output_set_requested_latency(b->source_output, DEFAULT_SOURCE_LATENCY);
+
+    PA_LLIST_PREPEND(struct broadcast, c->protocol->broadcasts, b);
+
+    pa_source_output_put(b->source_output);
+
+    return b;
+}
+
 static void handle_listen_prefix(struct connection *c, const char *source_name) {
     pa_source *source;
-    pa_source_output_new_data data;
+    struct broadcast *b;
     pa_sample_spec ss;
     pa_channel_map cm;
     char *t;
@@ -557,31 +670,21 @@ static void handle_listen_prefix(struct connection *c, const char *source_name)
 
     pa_sample_spec_mimefy(&ss, &cm);
 
-    pa_source_output_new_data_init(&data);
-    data.driver = __FILE__;
-    data.module = c->module;
-    data.client = c->client;
-    pa_source_output_new_data_set_source(&data, source, FALSE);
-    pa_proplist_update(data.proplist, PA_UPDATE_MERGE, c->client->proplist);
-    pa_source_output_new_data_set_sample_spec(&data, &ss);
-    pa_source_output_new_data_set_channel_map(&data, &cm);
+    t = pa_sample_spec_to_mime_type(&ss, &cm);
 
-    pa_source_output_new(&c->source_output, c->protocol->core, &data);
-    pa_source_output_new_data_done(&data);
+    if (c->method == METHOD_HEAD) {
+        http_response(c, 200, "OK", t);
+        pa_xfree(t);
+        pa_ioline_defer_close(c->line);
+        return;
+    }
 
-    if (!c->source_output) {
+    if (!(b = broadcast_get(c, source, &ss, &cm))) {
+        pa_xfree(t);
         html_response(c, 403, "Cannot create source output", NULL);
         return;
     }
 
-    c->source_output->parent.process_msg = source_output_process_msg;
-    c->source_output->push = source_output_push_cb;
-    c->source_output->kill = source_output_kill_cb;
-    c->source_output->get_latency = source_output_get_latency_cb;
-    c->source_output->userdata = c;
-
-    pa_source_output_set_requested_latency(c->source_output, DEFAULT_SOURCE_LATENCY);
-
     l = (size_t) (pa_bytes_per_second(&ss)*RECORD_BUFFER_SECONDS);
     c->output_memblockq = pa_memblockq_new(
             "http protocol connection output_memblockq",
@@ -594,16 +697,14 @@ static void handle_listen_prefix(struct connection *c, const char *source_name)
             0,
             NULL);
 
-    pa_source_output_put(c->source_output);
+    c->broadcast = b;
+    PA_LLIST_PREPEND(struct connection, b->listeners, c);
+
+    pa_log_debug("Source %s has an HTTP listener more now.", source->name);
 
-    t = pa_sample_spec_to_mime_type(&ss, &cm);
     http_response(c, 200, "OK", t);
     pa_xfree(t);
 
-    if(c->method == METHOD_HEAD) {
-        connection_unlink(c);
-        return;
-    }
     pa_ioline_set_callback(c->line, NULL, NULL);
 
     if (pa_ioline_is_drained(c->line))
@@ -786,6 +887,8 @@ void pa_http_protocol_unref(pa_http_protocol *p) {
     while ((c = pa_idxset_first(p->connections, NULL)))
         connection_unlink(c);
 
+    pa_assert(!p->broadcasts);
+
     pa_idxset_free(p->connections, NULL, NULL);
 
     pa_strlist_free(p->servers);
@@ -57,6 +57,15 @@
 #include <pulsecore/core-util.h>
 #include <pulsecore/ipacl.h>
 #include <pulsecore/thread-mq.h>
+#include <pulsecore/flist.h>
+#include <pulsecore/asyncq.h>
+#include <pulsecore/stream-ring.h>
+#include <pulsecore/io-worker.h>
+#include <pulsecore/iec61937.h>
+
+#ifdef HAVE_OPUS
+#include <pulsecore/opus-util.h>
+#endif
 
 #include "protocol-native.h"
 
@@ -73,6 +82,15 @@
 #define DEFAULT_PROCESS_MSEC 20   /* 20ms */
 #define DEFAULT_FRAGSIZE_MSEC DEFAULT_TLENGTH_MSEC
 
+/* Streams created while the memory budget is used up still get this
+ * much buffer */
+#define MIN_BUDGET_MSEC 250
+
+/* Pushed timing updates start out this often and back off to the
+ * slowest rate, like the polling in the client library does */
+#define TIMING_PUSH_INTERVAL_START_USEC (10*PA_USEC_PER_MSEC)
+#define TIMING_PUSH_INTERVAL_END_USEC (1500*PA_USEC_PER_MSEC)
+
 struct pa_native_protocol;
 
 typedef struct record_stream {
@@ -84,6 +102,9 @@ typedef struct record_stream {
     pa_source_output *source_output;
     pa_memblockq *memblockq;
 
+    /* The account of the client, memblockq is accounted on it */
+    pa_mem_account *mem_account;
+
     pa_bool_t adjust_latency:1;
     pa_bool_t early_requests:1;
 
@@ -100,6 +121,13 @@ typedef struct record_stream {
     size_t on_the_fly_snapshot;
     pa_usec_t current_monitor_latency;
     pa_usec_t current_source_latency;
+
+    /* The fragment size as seen from the IO thread, which collects the
+     * captured data in pending until a fragment is complete or has
+     * been waiting for as long as a fragment takes to capture */
+    pa_atomic_t thread_fragsize;
+    pa_memchunk pending;
+    pa_usec_t pending_since;
 } record_stream;
 
 #define RECORD_STREAM(o) (record_stream_cast(o))
@@ -121,6 +149,10 @@ typedef struct playback_stream {
     pa_sink_input *sink_input;
     pa_memblockq *memblockq;
 
+    /* The account of the client, memblockq is accounted on it. Checked
+     * from the IO thread for backpressure. */
+    pa_mem_account *mem_account;
+
     pa_bool_t adjust_latency:1;
     pa_bool_t early_requests:1;
 
@@ -145,11 +177,45 @@ typedef struct playback_stream {
     size_t render_memblockq_length;
     pa_usec_t current_sink_latency;
     uint64_t playing_for, underrun_for;
+
+#ifdef HAVE_OPUS
+    /* If the client sends Opus, it is decoded here before it goes to
+     * the sink input */
+    pa_opus_decoder *decoder;
+#endif
+
+    /* If the client sends raw compressed frames, they are wrapped into
+     * IEC 61937 bursts here before they go to the sink input */
+    pa_iec61937_packetizer *packetizer;
+
+    /* In ring buffer mode the client writes into a ring in SHM instead
+     * of sending memblocks, and the IO thread moves the data into
+     * memblockq as the sink input asks for it */
+    pa_stream_ring *ring;
+
+    /* Plain appends skip the message queue of the sink while the IO
+     * thread is playing from memblockq: they are queued here and
+     * moved into memblockq when the IO thread renders or handles a
+     * message of the stream. direct_ok is set by the IO thread as
+     * long as it doesn't need to be woken up for new data. */
+    pa_asyncq *direct;
+    pa_atomic_t direct_ok;
+
+    /* If the client asked for it, timing info is sent along with
+     * requests and state changes, so that it doesn't have to poll */
+    pa_bool_t push_timing;
+    pa_usec_t timing_pushed_at, timing_push_interval;
 } playback_stream;
 
 #define PLAYBACK_STREAM(o) (playback_stream_cast(o))
 PA_DEFINE_PRIVATE_CLASS(playback_stream, output_stream);
 
+struct direct_item {
+    pa_memchunk chunk;
+};
+
+PA_STATIC_FLIST_DECLARE(direct_items, 0, pa_xfree);
+
 typedef struct upload_stream {
     output_stream parent;
 
@@ -173,6 +239,7 @@ struct pa_native_connection {
     pa_native_options *options;
     pa_bool_t authorized:1;
     pa_bool_t is_local:1;
+    pa_bool_t snapshot_follow:1;
     uint32_t version;
     pa_client *client;
     pa_pstream *pstream;
@@ -181,6 +248,17 @@ struct pa_native_connection {
     uint32_t rrobin_index;
     pa_subscription *subscription;
     pa_time_event *auth_timeout_event;
+
+    /* Playback streams with data requests that are sent together in one
+     * PA_COMMAND_REQUEST_MULTI on the next main loop iteration */
+    pa_idxset *pending_requests;
+    pa_defer_event *request_event;
+
+    /* Private memfd pool, if negotiated with the client */
+    pa_mempool *mempool;
+
+    /* Does the socket IO of pstream, if the module asked for that */
+    pa_io_worker *io_worker;
 };
 
 #define PA_NATIVE_CONNECTION(o) (pa_native_connection_cast(o))
@@ -196,6 +274,9 @@ struct pa_native_protocol {
     pa_hook hooks[PA_NATIVE_HOOK_MAX];
 
     pa_hashmap *extensions;
+
+    /* Created with the first connection of a module with io-threads= */
+    pa_io_worker_pool *io_workers;
 };
 
 enum {
@@ -242,6 +323,7 @@ static void sink_input_send_event_cb(pa_sink_input *i, const char *event, pa_pro
 
 static void native_connection_send_memblock(pa_native_connection *c);
 static void playback_stream_request_bytes(struct playback_stream*s);
+static void playback_stream_push_timing(playback_stream *s, pa_bool_t force);
 
 static void source_output_kill_cb(pa_source_output *o);
 static void source_output_push_cb(pa_source_output *o, const pa_memchunk *chunk);
@@ -249,6 +331,9 @@ static void source_output_suspend_cb(pa_source_output *o, pa_bool_t suspend);
 static void source_output_moving_cb(pa_source_output *o, pa_source *dest);
 static pa_usec_t source_output_get_latency_cb(pa_source_output *o);
 static void source_output_send_event_cb(pa_source_output *o, const char *event, pa_proplist *pl);
+static void source_output_state_change_cb(pa_source_output *o, pa_source_output_state_t state);
+static void source_output_detach_cb(pa_source_output *o);
+static void source_output_suspend_within_thread_cb(pa_source_output *o, pa_bool_t suspend);
 
 static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offset, pa_memchunk *chunk);
 static int source_output_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offset, pa_memchunk *chunk);
@@ -266,14 +351,17 @@ static void command_get_playback_latency(pa_pdispatch *pd, uint32_t command, uin
 static void command_get_record_latency(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_create_upload_stream(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_finish_upload_stream(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
+static void command_finish_upload_samples(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_play_sample(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_remove_sample(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_get_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_get_info_list(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_get_server_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
+static void command_get_snapshot(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_subscribe(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_set_volume(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_set_mute(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
+static void command_set_volumes(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_cork_playback_stream(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_trigger_or_flush_or_prebuf_playback_stream(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_set_default_sink_or_source(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
@@ -314,6 +402,7 @@ static const pa_pdispatch_cb_t command_table[PA_COMMAND_MAX] = {
     [PA_COMMAND_CREATE_UPLOAD_STREAM] = command_create_upload_stream,
     [PA_COMMAND_DELETE_UPLOAD_STREAM] = command_delete_stream,
     [PA_COMMAND_FINISH_UPLOAD_STREAM] = command_finish_upload_stream,
+    [PA_COMMAND_FINISH_UPLOAD_SAMPLES] = command_finish_upload_samples,
     [PA_COMMAND_PLAY_SAMPLE] = command_play_sample,
     [PA_COMMAND_REMOVE_SAMPLE] = command_remove_sample,
     [PA_COMMAND_GET_SINK_INFO] = command_get_info,
@@ -333,6 +422,7 @@ static const pa_pdispatch_cb_t command_table[PA_COMMAND_MAX] = {
     [PA_COMMAND_GET_SOURCE_OUTPUT_INFO_LIST] = command_get_info_list,
     [PA_COMMAND_GET_SAMPLE_INFO_LIST] = command_get_info_list,
     [PA_COMMAND_GET_SERVER_INFO] = command_get_server_info,
+    [PA_COMMAND_GET_SNAPSHOT] = command_get_snapshot,
     [PA_COMMAND_SUBSCRIBE] = command_subscribe,
 
     [PA_COMMAND_SET_SINK_VOLUME] = command_set_volume,
@@ -345,6 +435,8 @@ static const pa_pdispatch_cb_t command_table[PA_COMMAND_MAX] = {
     [PA_COMMAND_SET_SOURCE_MUTE] = command_set_mute,
     [PA_COMMAND_SET_SOURCE_OUTPUT_MUTE] = command_set_mute,
 
+    [PA_COMMAND_SET_VOLUMES] = command_set_volumes,
+
     [PA_COMMAND_SUSPEND_SINK] = command_suspend,
     [PA_COMMAND_SUSPEND_SOURCE] = command_suspend,
 
@@ -486,7 +578,11 @@ static void record_stream_free(pa_object *o) {
 
     record_stream_unlink(s);
 
+    if (s->pending.memblock)
+        pa_memblock_unref(s->pending.memblock);
+
     pa_memblockq_free(s->memblockq);
+    pa_mem_account_unref(s->mem_account);
     pa_xfree(s);
 }
 
@@ -506,6 +602,12 @@ static int record_stream_process_msg(pa_msgobject *o, int code, void*userdata, i
              * currently on the fly */
             pa_atomic_sub(&s->on_the_fly, chunk->length);
 
+            /* A client that doesn't keep up loses what goes beyond two
+             * fragments while the memory budget is exceeded */
+            if (pa_memblockq_get_length(s->memblockq) >= 2 * (size_t) s->buffer_attr.fragsize &&
+                pa_mem_account_over_budget(s->mem_account))
+                return -1;
+
             if (pa_memblockq_push_align(s->memblockq, chunk) < 0) {
 /*                 pa_log_warn("Failed to push data into output queue."); */
                 return -1;
@@ -520,6 +622,28 @@ static int record_stream_process_msg(pa_msgobject *o, int code, void*userdata, i
     return 0;
 }
 
+/* Called from main context. Lowers maxlength to what is left of the
+ * memory budget of the client and the daemon, though not below
+ * MIN_BUDGET_MSEC. */
+static void apply_mem_budget(pa_mem_account *a, uint32_t *maxlength, const pa_sample_spec *ss) {
+    size_t available;
+
+    available = pa_mem_account_get_available(a);
+
+    if (available >= *maxlength)
+        return;
+
+    available = PA_MAX(available, pa_usec_to_bytes(MIN_BUDGET_MSEC*PA_USEC_PER_MSEC, ss));
+
+    if (available >= *maxlength)
+        return;
+
+    pa_log_info("Memory budget is nearly used up, limiting maxlength to %0.2f ms",
+                (double) pa_bytes_to_usec(available, ss) / PA_USEC_PER_MSEC);
+
+    *maxlength = (uint32_t) pa_frame_align(available, ss);
+}
+
 /* Called from main context */
 static void fix_record_buffer_attr_pre(record_stream *s) {
 
@@ -538,6 +662,7 @@ static void fix_record_buffer_attr_pre(record_stream *s) {
 
     if (s->buffer_attr.maxlength == (uint32_t) -1 || s->buffer_attr.maxlength > MAX_MEMBLOCKQ_LENGTH)
         s->buffer_attr.maxlength = MAX_MEMBLOCKQ_LENGTH;
+    apply_mem_budget(s->mem_account, &s->buffer_attr.maxlength, &s->source_output->sample_spec);
     if (s->buffer_attr.maxlength <= 0)
         s->buffer_attr.maxlength = (uint32_t) frame_size;
 
@@ -623,6 +748,8 @@ static void fix_record_buffer_attr_post(record_stream *s) {
 
     if (s->buffer_attr.fragsize > s->buffer_attr.maxlength)
         s->buffer_attr.fragsize = s->buffer_attr.maxlength;
+
+    pa_atomic_store(&s->thread_fragsize, (int) s->buffer_attr.fragsize);
 }
 
 /* Called from main context */
@@ -699,6 +826,10 @@ static record_stream* record_stream_new(
     s->adjust_latency = adjust_latency;
     s->early_requests = early_requests;
     pa_atomic_store(&s->on_the_fly, 0);
+    pa_atomic_store(&s->thread_fragsize, 0);
+    pa_memchunk_reset(&s->pending);
+    s->pending_since = 0;
+    s->mem_account = pa_mem_account_ref(c->client->mem_account);
 
     s->source_output->parent.process_msg = source_output_process_msg;
     s->source_output->push = source_output_push_cb;
@@ -707,6 +838,9 @@ static record_stream* record_stream_new(
     s->source_output->moving = source_output_moving_cb;
     s->source_output->suspend = source_output_suspend_cb;
     s->source_output->send_event = source_output_send_event_cb;
+    s->source_output->state_change = source_output_state_change_cb;
+    s->source_output->detach = source_output_detach_cb;
+    s->source_output->suspend_within_thread = source_output_suspend_within_thread_cb;
     s->source_output->userdata = s;
 
     fix_record_buffer_attr_pre(s);
@@ -723,6 +857,7 @@ static record_stream* record_stream_new(
             0,
             NULL);
     pa_xfree(memblockq_name);
+    pa_memblockq_set_mem_account(s->memblockq, s->mem_account);
 
     pa_memblockq_get_attr(s->memblockq, &s->buffer_attr);
     fix_record_buffer_attr_post(s);
@@ -769,11 +904,21 @@ static void playback_stream_unlink(playback_stream *s) {
     if (s->drain_request)
         pa_pstream_send_error(s->connection->pstream, s->drain_tag, PA_ERR_NOENTITY);
 
+    pa_idxset_remove_by_data(s->connection->pending_requests, s, NULL);
     pa_assert_se(pa_idxset_remove_by_data(s->connection->output_streams, s, NULL) == s);
     s->connection = NULL;
     playback_stream_unref(s);
 }
 
+static void direct_item_free(void *p) {
+    struct direct_item *i = p;
+
+    pa_memblock_unref(i->chunk.memblock);
+
+    if (pa_flist_push(PA_STATIC_FLIST_GET(direct_items), i) < 0)
+        pa_xfree(i);
+}
+
 /* Called from main context */
 static void playback_stream_free(pa_object* o) {
     playback_stream *s = PLAYBACK_STREAM(o);
@@ -782,9 +927,86 @@ static void playback_stream_free(pa_object* o) {
     playback_stream_unlink(s);
 
     pa_memblockq_free(s->memblockq);
+    pa_mem_account_unref(s->mem_account);
+
+#ifdef HAVE_OPUS
+    if (s->decoder)
+        pa_opus_decoder_free(s->decoder);
+#endif
+
+    if (s->packetizer)
+        pa_iec61937_packetizer_free(s->packetizer);
+
+    if (s->ring)
+        pa_stream_ring_free(s->ring);
+
+    /* The sink input is gone, so nobody pops from the queue anymore */
+    if (s->direct)
+        pa_asyncq_free(s->direct, direct_item_free);
+
     pa_xfree(s);
 }
 
+/* Called from main context, after SINK_INPUT_MESSAGE_UPDATE_LATENCY */
+static pa_bool_t playback_stream_is_playing(playback_stream *s) {
+    return
+        s->playing_for > 0 &&
+        pa_sink_get_state(s->sink_input->sink) == PA_SINK_RUNNING &&
+        pa_sink_input_get_state(s->sink_input) == PA_SINK_INPUT_RUNNING;
+}
+
+/* Called from main context */
+static void playback_stream_push_timing(playback_stream *s, pa_bool_t force) {
+    pa_tagstruct *t;
+    struct timeval now;
+    pa_usec_t n;
+
+    playback_stream_assert_ref(s);
+
+    if (!s->push_timing || !s->sink_input)
+        return;
+
+    n = pa_rtclock_now();
+
+    if (force)
+        s->timing_push_interval = TIMING_PUSH_INTERVAL_START_USEC;
+    else if (n < s->timing_pushed_at + s->timing_push_interval)
+        return;
+    else
+        s->timing_push_interval = PA_MIN(2 * s->timing_push_interval, TIMING_PUSH_INTERVAL_END_USEC);
+
+    s->timing_pushed_at = n;
+
+    pa_assert_se(pa_asyncmsgq_send(s->sink_input->sink->asyncmsgq, PA_MSGOBJECT(s->sink_input), SINK_INPUT_MESSAGE_UPDATE_LATENCY, s, 0, NULL) == 0);
+
+    t = pa_tagstruct_new(NULL, 0);
+    pa_tagstruct_putu32(t, PA_COMMAND_PLAYBACK_TIMING);
+    pa_tagstruct_putu32(t, (uint32_t) -1); /* tag */
+    pa_tagstruct_putu32(t, s->index);
+    pa_tagstruct_put_usec(t,
+                          s->current_sink_latency +
+                          pa_bytes_to_usec(s->render_memblockq_length, &s->sink_input->sink->sample_spec));
+    pa_tagstruct_put_boolean(t, playback_stream_is_playing(s));
+    pa_tagstruct_put_timeval(t, pa_gettimeofday(&now));
+    pa_tagstruct_puts64(t, s->read_index);
+    pa_tagstruct_putu64(t, s->underrun_for);
+    pa_tagstruct_putu64(t, s->playing_for);
+    pa_pstream_send_tagstruct(s->connection->pstream, t);
+}
+
+/* Called from main context */
+static int playback_stream_take_missing(playback_stream *s) {
+    int l;
+
+    for (;;) {
+        if ((l = pa_atomic_load(&s->missing)) <= 0)
+            return 0;
+
+        if (pa_atomic_cmpxchg(&s->missing, l, 0))
+            return l;
+    }
+}
+
 /* Called from main context */
 static int playback_stream_process_msg(pa_msgobject *o, int code, void*userdata, int64_t offset, pa_memchunk *chunk) {
     playback_stream *s = PLAYBACK_STREAM(o);
@@ -797,16 +1019,19 @@ static int playback_stream_process_msg(pa_msgobject *o, int code, void*userdata,
 
         case PLAYBACK_STREAM_MESSAGE_REQUEST_DATA: {
             pa_tagstruct *t;
-            int l = 0;
-
-            for (;;) {
-                if ((l = pa_atomic_load(&s->missing)) <= 0)
-                    return 0;
-
-                if (pa_atomic_cmpxchg(&s->missing, l, 0))
-                    break;
+            int l;
+
+            if (s->connection->version >= 28) {
+                /* Requests of all streams are collected and sent as one
+                 * packet from request_event_cb() */
+                pa_idxset_put(s->connection->pending_requests, s, NULL);
+                s->connection->protocol->core->mainloop->defer_enable(s->connection->request_event, 1);
+                return 0;
             }
 
+            if ((l = playback_stream_take_missing(s)) <= 0)
+                return 0;
+
             t = pa_tagstruct_new(NULL, 0);
             pa_tagstruct_putu32(t, PA_COMMAND_REQUEST);
             pa_tagstruct_putu32(t, (uint32_t) -1); /* tag */
@@ -817,6 +1042,8 @@ static int playback_stream_process_msg(pa_msgobject *o, int code, void*userdata,
 #ifdef PROTOCOL_NATIVE_DEBUG
             pa_log("Requesting %lu bytes", (unsigned long) l);
 #endif
+
+            playback_stream_push_timing(s, FALSE);
             break;
         }
 
@@ -835,6 +1062,8 @@ static int playback_stream_process_msg(pa_msgobject *o, int code, void*userdata,
             if (s->connection->version >= 23)
                 pa_tagstruct_puts64(t, offset);
             pa_pstream_send_tagstruct(s->connection->pstream, t);
+
+            playback_stream_push_timing(s, TRUE);
             break;
         }
 
@@ -863,6 +1092,8 @@ static int playback_stream_process_msg(pa_msgobject *o, int code, void*userdata,
                 pa_pstream_send_tagstruct(s->connection->pstream, t);
             }
 
+            playback_stream_push_timing(s, TRUE);
+
             break;
 
         case PLAYBACK_STREAM_MESSAGE_DRAIN_ACK:
@@ -925,11 +1156,14 @@ static void fix_playback_buffer_attr(playback_stream *s) {
 
     if (s->buffer_attr.maxlength == (uint32_t) -1 || s->buffer_attr.maxlength > MAX_MEMBLOCKQ_LENGTH)
         s->buffer_attr.maxlength = MAX_MEMBLOCKQ_LENGTH;
+    apply_mem_budget(s->mem_account, &s->buffer_attr.maxlength, &s->sink_input->sample_spec);
     if (s->buffer_attr.maxlength <= 0)
         s->buffer_attr.maxlength = (uint32_t) frame_size;
 
     if (s->buffer_attr.tlength == (uint32_t) -1)
         s->buffer_attr.tlength = (uint32_t) pa_usec_to_bytes_round_up(DEFAULT_TLENGTH_MSEC*PA_USEC_PER_MSEC, &s->sink_input->sample_spec);
+    if (s->buffer_attr.tlength > s->buffer_attr.maxlength)
+        s->buffer_attr.tlength = s->buffer_attr.maxlength;
     if (s->buffer_attr.tlength <= 0)
         s->buffer_attr.tlength = (uint32_t) frame_size;
 
@@ -1072,6 +1306,7 @@ static playback_stream* playback_stream_new(
         pa_bool_t adjust_latency,
         pa_bool_t early_requests,
         pa_bool_t relative_volume,
+        pa_bool_t ring,
         uint32_t syncid,
         uint32_t *missing,
         int *ret) {
@@ -1165,6 +1400,13 @@ static playback_stream* playback_stream_new(
     s->early_requests = early_requests;
     pa_atomic_store(&s->seek_or_post_in_queue, 0);
     s->seek_windex = -1;
+    s->ring = NULL;
+    s->direct = NULL;
+    pa_atomic_store(&s->direct_ok, 0);
+#ifdef HAVE_OPUS
+    s->decoder = NULL;
+#endif
+    s->packetizer = NULL;
 
     s->sink_input->parent.process_msg = sink_input_process_msg;
     s->sink_input->pop = sink_input_pop_cb;
@@ -1179,6 +1421,7 @@ static playback_stream* playback_stream_new(
 
     start_index = ssync ? pa_memblockq_get_read_index(ssync->memblockq) : 0;
 
+    s->mem_account = pa_mem_account_ref(c->client->mem_account);
     fix_playback_buffer_attr(s);
 
     pa_sink_input_get_silence(sink_input, &silence);
@@ -1195,6 +1438,11 @@ static playback_stream* playback_stream_new(
             &silence);
     pa_xfree(memblockq_name);
     pa_memblock_unref(silence.memblock);
+    pa_memblockq_set_mem_account(s->memblockq, s->mem_account);
+
+    /* Clients may write in tiny pieces, each arriving in a block of
+     * its own */
+    pa_memblockq_set_coalesce(s->memblockq, TRUE);
 
     pa_memblockq_get_attr(s->memblockq, &s->buffer_attr);
 
@@ -1209,6 +1457,11 @@ static playback_stream* playback_stream_new(
 
     pa_idxset_put(c->output_streams, s, &s->index);
 
+    if (ring)
+        s->ring = pa_stream_ring_new_reader(c->mempool ? c->mempool : c->protocol->core->mempool);
+    else
+        s->direct = pa_asyncq_new(0);
+
     pa_log_info("Final latency %0.2f ms = %0.2f ms + 2*%0.2f ms + %0.2f ms",
                 ((double) pa_bytes_to_usec(s->buffer_attr.tlength, &sink_input->sample_spec) + (double) s->configured_sink_latency) / PA_USEC_PER_MSEC,
                 (double) pa_bytes_to_usec(s->buffer_attr.tlength-s->buffer_attr.minreq*2, &sink_input->sample_spec) / PA_USEC_PER_MSEC,
@@ -1231,6 +1484,17 @@ static void playback_stream_request_bytes(playback_stream *s) {
 
     playback_stream_assert_ref(s);
 
+    /* Ring buffer clients look at the free space themselves */
+    if (s->ring)
+        return;
+
+    /* While over the memory budget, the client is asked for more only
+     * once less than half of tlength is left. What is missing until
+     * then is asked for in one go. */
+    if (pa_mem_account_over_budget(s->mem_account) &&
+        pa_memblockq_get_length(s->memblockq) >= pa_memblockq_get_tlength(s->memblockq) / 2)
+        return;
+
     m = pa_memblockq_pop_missing(s->memblockq);
 
     /* pa_log("request_bytes(%lu) (tlength=%lu minreq=%lu length=%lu really missing=%lli)", */
@@ -1289,6 +1553,45 @@ static int native_connection_process_msg(pa_msgobject *o, int code, void*userdat
     return 0;
 }
 
+/* Called from main context */
+static void request_event_cb(pa_mainloop_api *m, pa_defer_event *e, void *userdata) {
+    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+    playback_stream *s;
+    pa_tagstruct *t;
+    unsigned n = 0;
+
+    pa_native_connection_assert_ref(c);
+    pa_assert(c->request_event == e);
+
+    m->defer_enable(e, 0);
+
+    t = pa_tagstruct_new(NULL, 0);
+    pa_tagstruct_putu32(t, PA_COMMAND_REQUEST_MULTI);
+    pa_tagstruct_putu32(t, (uint32_t) -1); /* tag */
+
+    while ((s = pa_idxset_steal_first(c->pending_requests, NULL))) {
+        int l;
+
+        if ((l = playback_stream_take_missing(s)) <= 0)
+            continue;
+
+        pa_tagstruct_putu32(t, s->index);
+        pa_tagstruct_putu32(t, (uint32_t) l);
+        n++;
+
+        playback_stream_push_timing(s, FALSE);
+    }
+
+#ifdef PROTOCOL_NATIVE_DEBUG
+    pa_log("Requesting data for %u streams", n);
+#endif
+
+    if (n > 0)
+        pa_pstream_send_tagstruct(c->pstream, t);
+    else
+        pa_tagstruct_free(t);
+}
+
 /* Called from main context */
 static void native_connection_unlink(pa_native_connection *c) {
     record_stream *r;
@@ -1319,11 +1622,22 @@ static void native_connection_unlink(pa_native_connection *c) {
     if (c->pstream)
         pa_pstream_unlink(c->pstream);
 
+    /* The worker tears down the socket before it may quit */
+    if (c->io_worker) {
+        pa_io_worker_release(c->io_worker);
+        c->io_worker = NULL;
+    }
+
     if (c->auth_timeout_event) {
         c->protocol->core->mainloop->time_free(c->auth_timeout_event);
         c->auth_timeout_event = NULL;
     }
 
+    if (c->request_event) {
+        c->protocol->core->mainloop->defer_free(c->request_event);
+        c->request_event = NULL;
+    }
+
     pa_assert_se(pa_idxset_remove_by_data(c->protocol->connections, c, NULL) == c);
     c->protocol = NULL;
     pa_native_connection_unref(c);
@@ -1339,11 +1653,15 @@ static void native_connection_free(pa_object *o) {
 
     pa_idxset_free(c->record_streams, NULL, NULL);
     pa_idxset_free(c->output_streams, NULL, NULL);
+    pa_idxset_free(c->pending_requests, NULL, NULL);
 
     pa_pdispatch_unref(c->pdispatch);
     pa_pstream_unref(c->pstream);
     pa_client_free(c->client);
 
+    if (c->mempool)
+        pa_mempool_free(c->mempool);
+
     pa_xfree(c);
 }
 
@@ -1425,6 +1743,79 @@ static void flush_write_no_account(pa_memblockq *q) {
     pa_memblockq_flush_write(q, FALSE);
 }
 
+/* Called from thread context */
+static void playback_stream_pull_ring(playback_stream *s, size_t length) {
+    pa_memchunk chunk;
+    size_t queued, n;
+    void *d;
+
+    /* Only take what is needed to fill up memblockq to length, the
+     * rest stays in the ring and keeps the client from writing more */
+    length = PA_MAX(length, pa_memblockq_get_prebuf(s->memblockq));
+    length = PA_MIN(length, pa_memblockq_get_maxlength(s->memblockq));
+    queued = pa_memblockq_get_length(s->memblockq);
+
+    if (queued >= length)
+        return;
+
+    if ((n = PA_MIN(length - queued, pa_stream_ring_readable(s->ring))) <= 0)
+        return;
+
+    chunk.memblock = pa_memblock_new(s->sink_input->sink->core->mempool, n);
+    chunk.index = 0;
+
+    d = pa_memblock_acquire(chunk.memblock);
+    chunk.length = pa_stream_ring_read(s->ring, d, n);
+    pa_memblock_release(chunk.memblock);
+
+    if (chunk.length > 0)
+        pa_memblockq_push_align(s->memblockq, &chunk);
+
+    pa_memblock_unref(chunk.memblock);
+}
+
+/* Called from thread context. While over the memory budget nothing
+ * is taken beyond tlength, as if the queue was full. */
+static int playback_stream_push(playback_stream *s, const pa_memchunk *chunk) {
+
+    if (pa_memblockq_get_length(s->memblockq) >= pa_memblockq_get_tlength(s->memblockq) &&
+        pa_mem_account_over_budget(s->mem_account))
+        return -1;
+
+    return pa_memblockq_push_align(s->memblockq, chunk);
+}
+
+/* Called from thread context */
+static void playback_stream_pull_direct(playback_stream *s) {
+    struct direct_item *i;
+
+    if (!s->direct)
+        return;
+
+    while ((i = pa_asyncq_pop(s->direct, FALSE))) {
+
+        if (playback_stream_push(s, &i->chunk) < 0) {
+            if (pa_log_ratelimit(PA_LOG_WARN))
+                pa_log_warn("Failed to push data into queue");
+            pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(s), PLAYBACK_STREAM_MESSAGE_OVERFLOW, NULL, 0, NULL, NULL);
+            pa_memblockq_seek(s->memblockq, (int64_t) i->chunk.length, PA_SEEK_RELATIVE, TRUE);
+        }
+
+        direct_item_free(i);
+    }
+}
+
+/* Called from thread context */
+static void playback_stream_sync_ring(playback_stream *s, int code) {
+    if (!s->ring)
+        return;
+
+    if (code == SINK_INPUT_MESSAGE_FLUSH)
+        pa_stream_ring_skip(s->ring);
+    else if (code == SINK_INPUT_MESSAGE_DRAIN)
+        playback_stream_pull_ring(s, pa_memblockq_get_maxlength(s->memblockq));
+}
+
 /* Called from thread context */
 static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offset, pa_memchunk *chunk) {
     pa_sink_input *i = PA_SINK_INPUT(o);
@@ -1434,6 +1825,9 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
     s = PLAYBACK_STREAM(i->userdata);
     playback_stream_assert_ref(s);
 
+    /* Whatever was queued directly was sent before this message */
+    playback_stream_pull_direct(s);
+
     switch (code) {
 
         case SINK_INPUT_MESSAGE_SEEK:
@@ -1449,7 +1843,7 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
                 windex = PA_MIN(windex, pa_memblockq_get_write_index(s->memblockq));
             }
 
-            if (chunk && pa_memblockq_push_align(s->memblockq, chunk) < 0) {
+            if (chunk && playback_stream_push(s, chunk) < 0) {
                 if (pa_log_ratelimit(PA_LOG_WARN))
                     pa_log_warn("Failed to push data into queue");
                 pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(s), PLAYBACK_STREAM_MESSAGE_OVERFLOW, NULL, 0, NULL, NULL);
@@ -1501,6 +1895,7 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
                     pa_assert_not_reached();
             }
 
+            playback_stream_sync_ring(s, code);
             windex = pa_memblockq_get_write_index(s->memblockq);
             func(s->memblockq);
             handle_seek(s, windex);
@@ -1508,6 +1903,8 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
             /* Do the same for all other members in the sync group */
             for (isync = i->sync_prev; isync; isync = isync->sync_prev) {
                 playback_stream *ssync = PLAYBACK_STREAM(isync->userdata);
+                playback_stream_pull_direct(ssync);
+                playback_stream_sync_ring(ssync, code);
                 windex = pa_memblockq_get_write_index(ssync->memblockq);
                 func(ssync->memblockq);
                 handle_seek(ssync, windex);
@@ -1515,6 +1912,8 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
 
             for (isync = i->sync_next; isync; isync = isync->sync_next) {
                 playback_stream *ssync = PLAYBACK_STREAM(isync->userdata);
+                playback_stream_pull_direct(ssync);
+                playback_stream_sync_ring(ssync, code);
                 windex = pa_memblockq_get_write_index(ssync->memblockq);
                 func(ssync->memblockq);
                 handle_seek(ssync, windex);
@@ -1536,6 +1935,8 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
             /* Atomically get a snapshot of all timing parameters... */
             s->read_index = pa_memblockq_get_read_index(s->memblockq);
             s->write_index = pa_memblockq_get_write_index(s->memblockq);
+            if (s->ring)
+                s->write_index += (int64_t) pa_stream_ring_readable(s->ring);
             s->render_memblockq_length = pa_memblockq_get_length(s->sink_input->thread_info.render_memblockq);
             s->current_sink_latency = pa_sink_get_latency_within_thread(s->sink_input->sink);
             s->underrun_for = s->sink_input->thread_info.underrun_for;
@@ -1559,7 +1960,8 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
         case PA_SINK_INPUT_MESSAGE_GET_LATENCY: {
             pa_usec_t *r = userdata;
 
-            *r = pa_bytes_to_usec(pa_memblockq_get_length(s->memblockq), &i->sample_spec);
+            *r = pa_bytes_to_usec(pa_memblockq_get_length(s->memblockq) +
+                                  (s->ring ? pa_stream_ring_readable(s->ring) : 0), &i->sample_spec);
 
             /* Fall through, the default handler will add in the extra
              * latency added by the resampler */
@@ -1589,6 +1991,15 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
     pa_log("%s, pop(): %lu", pa_proplist_gets(i->proplist, PA_PROP_MEDIA_NAME), (unsigned long) pa_memblockq_get_length(s->memblockq));
 #endif
 
+    if (s->ring)
+        playback_stream_pull_ring(s, nbytes);
+    else
+        playback_stream_pull_direct(s);
+
+    /* Once we run dry, new data has to wake us up again, so that
+     * handle_seek() can ask for a rewind */
+    pa_atomic_store(&s->direct_ok, pa_memblockq_is_readable(s->memblockq));
+
     if (pa_memblockq_is_readable(s->memblockq))
         s->is_underrun = FALSE;
     else {
@@ -1788,9 +2199,26 @@ static int source_output_process_msg(pa_msgobject *_o, int code, void *userdata,
     return pa_source_output_process_msg(_o, code, userdata, offset, chunk);
 }
 
+/* Called from thread context */
+static void record_stream_flush_pending(record_stream *s) {
+    record_stream_assert_ref(s);
+
+    if (!s->pending.memblock)
+        return;
+
+    if (s->pending.length > 0)
+        pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(s), RECORD_STREAM_MESSAGE_POST_DATA, NULL, 0, &s->pending, NULL);
+
+    pa_memblock_unref(s->pending.memblock);
+    pa_memchunk_reset(&s->pending);
+}
+
 /* Called from thread context */
 static void source_output_push_cb(pa_source_output *o, const pa_memchunk *chunk) {
     record_stream *s;
+    pa_memchunk c;
+    size_t fragsize, frame_size;
+    pa_usec_t now;
 
     pa_source_output_assert_ref(o);
     s = RECORD_STREAM(o->userdata);
@@ -1798,7 +2226,87 @@ static void source_output_push_cb(pa_source_output *o, const pa_memchunk *chunk)
     pa_assert(chunk);
 
     pa_atomic_add(&s->on_the_fly, chunk->length);
-    pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(s), RECORD_STREAM_MESSAGE_POST_DATA, NULL, 0, chunk, NULL);
+
+    /* With short source periods every chunk would otherwise become a
+     * message to the main loop and a frame of its own. Hence we copy
+     * them together into chunks of the fragment size, unless they are
+     * that large already. */
+    frame_size = pa_frame_size(&o->sample_spec);
+    fragsize = PA_MIN((size_t) pa_atomic_load(&s->thread_fragsize), pa_mempool_block_size_max(o->core->mempool));
+    fragsize = (fragsize / frame_size) * frame_size;
+
+    if (fragsize <= 0 || (!s->pending.memblock && chunk->length >= fragsize)) {
+        pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(s), RECORD_STREAM_MESSAGE_POST_DATA, NULL, 0, chunk, NULL);
+        return;
+    }
+
+    now = pa_rtclock_now();
+    c = *chunk;
+
+    while (c.length > 0) {
+        pa_memchunk dst;
+
+        if (!s->pending.memblock) {
+            s->pending.memblock = pa_memblock_new(o->core->mempool, fragsize);
+            s->pending.index = s->pending.length = 0;
+            s->pending_since = now;
+        }
+
+        dst.memblock = s->pending.memblock;
+        dst.index = s->pending.length;
+        dst.length = PA_MIN(c.length, pa_memblock_get_length(s->pending.memblock) - s->pending.length);
+
+        pa_memchunk_memcpy(&dst, &c);
+
+        s->pending.length += dst.length;
+        c.index += dst.length;
+        c.length -= dst.length;
+
+        if (s->pending.length >= pa_memblock_get_length(s->pending.memblock))
+            record_stream_flush_pending(s);
+    }
+
+    /* Don't let an incomplete fragment wait longer than a complete one
+     * would */
+    if (s->pending.memblock && now >= s->pending_since + pa_bytes_to_usec(fragsize, &o->sample_spec))
+        record_stream_flush_pending(s);
+}
+
+/* Called from thread context */
+static void source_output_state_change_cb(pa_source_output *o, pa_source_output_state_t state) {
+    record_stream *s;
+
+    pa_source_output_assert_ref(o);
+    s = RECORD_STREAM(o->userdata);
+    record_stream_assert_ref(s);
+
+    /* No more data is coming for a while, so don't hold back what we
+     * have */
+    if (state != PA_SOURCE_OUTPUT_RUNNING)
+        record_stream_flush_pending(s);
+}
+
+/* Called from thread context */
+static void source_output_detach_cb(pa_source_output *o) {
+    record_stream *s;
+
+    pa_source_output_assert_ref(o);
+    s = RECORD_STREAM(o->userdata);
+    record_stream_assert_ref(s);
+
+    record_stream_flush_pending(s);
+}
+
+/* Called from thread context */
+static void source_output_suspend_within_thread_cb(pa_source_output *o, pa_bool_t suspend) {
+    record_stream *s;
+
+    pa_source_output_assert_ref(o);
+    s = RECORD_STREAM(o->userdata);
+    record_stream_assert_ref(s);
+
+    if (suspend)
+        record_stream_flush_pending(s);
 }
 
 static void source_output_kill_cb(pa_source_output *o) {
@@ -1932,6 +2440,106 @@ static pa_tagstruct *reply_new(uint32_t tag) {
     return reply;
 }
 
+#ifdef HAVE_OPUS
+/* If the client offers Opus, sets up a decoder and replaces the formats
+ * by the PCM format it decodes to, so that the sink input never sees
+ * compressed data. Returns the Opus format that was picked, if any. */
+static pa_format_info* playback_stream_setup_decoder(pa_native_connection *c, pa_idxset **formats, pa_opus_decoder **decoder) {
+    pa_format_info *f, *opus = NULL;
+    pa_sample_spec ss;
+    pa_channel_map map;
+    uint32_t idx;
+
+    pa_assert(c);
+    pa_assert(formats);
+    pa_assert(decoder);
+
+    *decoder = NULL;
+
+    PA_IDXSET_FOREACH(f, *formats, idx) {
+        if (f->encoding != PA_ENCODING_OPUS)
+            continue;
+
+        if (pa_opus_format_to_sample_spec(f, &ss, &map) < 0)
+            continue;
+
+        if (map.channels <= 0)
+            pa_channel_map_init_extend(&map, ss.channels, PA_CHANNEL_MAP_DEFAULT);
+        else if (!pa_channel_map_compatible(&map, &ss))
+            continue;
+
+        if ((*decoder = pa_opus_decoder_new(c->protocol->core->mempool, &ss))) {
+            opus = pa_format_info_copy(f);
+            break;
+        }
+    }
+
+    if (!opus)
+        return NULL;
+
+    pa_idxset_free(*formats, (pa_free2_cb_t) pa_format_info_free2, NULL);
+    *formats = pa_idxset_new(NULL, NULL);
+    pa_idxset_put(*formats, pa_format_info_from_sample_spec(&ss, &map), NULL);
+
+    return opus;
+}
+
+/* Called from main context */
+static void playback_stream_decoded_cb(pa_opus_decoder *d, const pa_memchunk *pcm, void *userdata) {
+    playback_stream *s = PLAYBACK_STREAM(userdata);
+
+    pa_atomic_inc(&s->seek_or_post_in_queue);
+    pa_asyncmsgq_post(s->sink_input->sink->asyncmsgq, PA_MSGOBJECT(s->sink_input), SINK_INPUT_MESSAGE_POST_DATA, NULL, 0, pcm, NULL);
+}
+#endif
+
+/* Replaces the raw compressed formats the client offers by their IEC
+ * 61937 counterparts, which the sink input then negotiates as usual.
+ * IEC 61937 formats the client offers itself are dropped for those
+ * encodings, so that the encoding the sink input ends up with tells
+ * whether a raw one was picked. raw is indexed by the IEC 61937
+ * encoding and gets copies of the raw formats. */
+static void playback_stream_encapsulate_formats(pa_idxset **formats, pa_format_info *raw[PA_ENCODING_MAX]) {
+    pa_idxset *encapsulated;
+    pa_format_info *f;
+    pa_encoding_t e;
+    uint32_t idx;
+
+    pa_assert(formats);
+    pa_assert(raw);
+
+    PA_IDXSET_FOREACH(f, *formats, idx)
+        if ((e = pa_iec61937_encoding(f->encoding)) != PA_ENCODING_INVALID && !raw[e])
+            raw[e] = pa_format_info_copy(f);
+
+    encapsulated = pa_idxset_new(NULL, NULL);
+
+    PA_IDXSET_FOREACH(f, *formats, idx) {
+        pa_format_info *copy;
+
+        if ((e = pa_iec61937_encoding(f->encoding)) != PA_ENCODING_INVALID) {
+            copy = pa_format_info_copy(f);
+            copy->encoding = e;
+        } else if (pa_format_info_valid(f) && raw[f->encoding])
+            continue;
+        else
+            copy = pa_format_info_copy(f);
+
+        pa_idxset_put(encapsulated, copy, NULL);
+    }
+
+    pa_idxset_free(*formats, (pa_free2_cb_t) pa_format_info_free2, NULL);
+    *formats = encapsulated;
+}
+
+/* Called from main context */
+static void playback_stream_burst_cb(pa_iec61937_packetizer *packetizer, const pa_memchunk *chunk, void *userdata) {
+    playback_stream *s = PLAYBACK_STREAM(userdata);
+
+    pa_atomic_inc(&s->seek_or_post_in_queue);
+    pa_asyncmsgq_post(s->sink_input->sink->asyncmsgq, PA_MSGOBJECT(s->sink_input), SINK_INPUT_MESSAGE_POST_DATA, NULL, 0, chunk, NULL);
+}
+
 static void command_create_playback_stream(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
     playback_stream *s;
@@ -1960,7 +2568,9 @@ static void command_create_playback_stream(pa_pdispatch *pd, uint32_t command, u
         muted_set = FALSE,
         fail_on_suspend = FALSE,
         relative_volume = FALSE,
-        passthrough = FALSE;
+        passthrough = FALSE,
+        ring = FALSE,
+        push_timing = FALSE;
 
     pa_sink_input_flags_t flags = 0;
     pa_proplist *p = NULL;
@@ -1969,10 +2579,17 @@ static void command_create_playback_stream(pa_pdispatch *pd, uint32_t command, u
     pa_format_info *format;
     pa_idxset *formats = NULL;
     uint32_t i;
+    pa_usec_t begin = 0;
+    pa_format_info *raw_formats[PA_ENCODING_MAX], *raw_format = NULL;
+#ifdef HAVE_OPUS
+    pa_format_info *opus_format = NULL;
+    pa_opus_decoder *decoder = NULL;
+#endif
 
     pa_native_connection_assert_ref(c);
     pa_assert(t);
     memset(&attr, 0, sizeof(attr));
+    memset(raw_formats, 0, sizeof(raw_formats));
 
     if ((c->version < 13 && (pa_tagstruct_gets(t, &name) < 0 || !name)) ||
         pa_tagstruct_get(
@@ -2090,17 +2707,36 @@ static void command_create_playback_stream(pa_pdispatch *pd, uint32_t command, u
         }
     }
 
-    if (n_formats == 0) {
-        CHECK_VALIDITY_GOTO(c->pstream, pa_sample_spec_valid(&ss), tag, PA_ERR_INVALID, finish);
-        CHECK_VALIDITY_GOTO(c->pstream, map.channels == ss.channels && volume.channels == ss.channels, tag, PA_ERR_INVALID, finish);
-        CHECK_VALIDITY_GOTO(c->pstream, pa_channel_map_valid(&map), tag, PA_ERR_INVALID, finish);
-    } else {
-        PA_IDXSET_FOREACH(format, formats, i) {
-            CHECK_VALIDITY_GOTO(c->pstream, pa_format_info_valid(format), tag, PA_ERR_INVALID, finish);
+    if (c->version >= 31) {
+
+        if (pa_tagstruct_get_boolean(t, &ring) < 0) {
+            protocol_error(c);
+            goto finish;
         }
     }
 
-    if (!pa_tagstruct_eof(t)) {
+    if (c->version >= 32) {
+
+        if (pa_tagstruct_get_boolean(t, &push_timing) < 0) {
+            protocol_error(c);
+            goto finish;
+        }
+    }
+
+    /* The ring lives in SHM, so both sides need to be able to map it */
+    CHECK_VALIDITY_GOTO(c->pstream, !ring || pa_pstream_get_shm(c->pstream), tag, PA_ERR_NOTSUPPORTED, finish);
+
+    if (n_formats == 0) {
+        CHECK_VALIDITY_GOTO(c->pstream, pa_sample_spec_valid(&ss), tag, PA_ERR_INVALID, finish);
+        CHECK_VALIDITY_GOTO(c->pstream, map.channels == ss.channels && volume.channels == ss.channels, tag, PA_ERR_INVALID, finish);
+        CHECK_VALIDITY_GOTO(c->pstream, pa_channel_map_valid(&map), tag, PA_ERR_INVALID, finish);
+    } else {
+        PA_IDXSET_FOREACH(format, formats, i) {
+            CHECK_VALIDITY_GOTO(c->pstream, pa_format_info_valid(format), tag, PA_ERR_INVALID, finish);
+        }
+    }
+
+    if (!pa_tagstruct_eof(t)) {
         protocol_error(c);
         goto finish;
     }
@@ -2137,12 +2773,44 @@ static void command_create_playback_stream(pa_pdispatch *pd, uint32_t command, u
      * flag. For older versions we synthesize it here */
     muted_set = muted_set || muted;
 
-    s = playback_stream_new(c, sink, &ss, &map, formats, &attr, volume_set ? &volume : NULL, muted, muted_set, flags, p, adjust_latency, early_requests, relative_volume, syncid, &missing, &ret);
+#ifdef HAVE_OPUS
+    if (formats && c->version >= 28 && !ring)
+        opus_format = playback_stream_setup_decoder(c, &formats, &decoder);
+
+    if (!opus_format)
+#endif
+    if (formats && c->version >= 37 && !ring)
+        playback_stream_encapsulate_formats(&formats, raw_formats);
+
+    if (pa_log_level_enabled(PA_LOG_DEBUG))
+        begin = pa_rtclock_now();
+
+    s = playback_stream_new(c, sink, &ss, &map, formats, &attr, volume_set ? &volume : NULL, muted, muted_set, flags, p, adjust_latency, early_requests, relative_volume, ring, syncid, &missing, &ret);
     /* We no longer own the formats idxset */
     formats = NULL;
 
     CHECK_VALIDITY_GOTO(c->pstream, s, tag, ret, finish);
 
+    /* A remote client should be able to send a whole buffer without
+     * waiting for the socket */
+    if (!c->is_local)
+        pa_pstream_grow_socket_buffers(c->pstream, s->buffer_attr.tlength, 0);
+
+    /* Including the buffer setup and putting the sink input in place,
+     * on top of what the sink input creation itself logs */
+    if (begin > 0)
+        pa_log_debug("Created playback stream %u in %0.3f ms.", s->index, (double) (pa_rtclock_now() - begin) / PA_USEC_PER_MSEC);
+
+#ifdef HAVE_OPUS
+    s->decoder = decoder;
+    decoder = NULL;
+#endif
+
+    if (s->sink_input->format && (raw_format = raw_formats[s->sink_input->format->encoding]))
+        s->packetizer = pa_iec61937_packetizer_new(c->protocol->core->mempool, &c->protocol->core->silence_cache, raw_format->encoding);
+
+    s->push_timing = push_timing;
+
     reply = reply_new(tag);
     pa_tagstruct_putu32(reply, s->index);
     pa_assert(s->sink_input);
@@ -2181,7 +2849,14 @@ static void command_create_playback_stream(pa_pdispatch *pd, uint32_t command, u
 
     if (c->version >= 21) {
         /* Send back the format we negotiated */
-        if (s->sink_input->format)
+#ifdef HAVE_OPUS
+        if (opus_format)
+            pa_tagstruct_put_format_info(reply, opus_format);
+        else
+#endif
+        if (s->packetizer)
+            pa_tagstruct_put_format_info(reply, raw_format);
+        else if (s->sink_input->format)
             pa_tagstruct_put_format_info(reply, s->sink_input->format);
         else {
             pa_format_info *f = pa_format_info_new();
@@ -2192,11 +2867,29 @@ static void command_create_playback_stream(pa_pdispatch *pd, uint32_t command, u
 
     pa_pstream_send_tagstruct(c->pstream, reply);
 
+    if (s->ring) {
+        pa_memchunk chunk;
+
+        /* Goes out after the reply, from which the client sets up its
+         * end of the ring */
+        pa_stream_ring_get_chunk(s->ring, &chunk);
+        pa_pstream_send_memblock(c->pstream, s->index, 0, PA_SEEK_RELATIVE, &chunk);
+    }
+
 finish:
     if (p)
         pa_proplist_free(p);
     if (formats)
         pa_idxset_free(formats, (pa_free2_cb_t) pa_format_info_free2, NULL);
+    for (i = 0; i < PA_ENCODING_MAX; i++)
+        if (raw_formats[i])
+            pa_format_info_free(raw_formats[i]);
+#ifdef HAVE_OPUS
+    if (opus_format)
+        pa_format_info_free(opus_format);
+    if (decoder)
+        pa_opus_decoder_free(decoder);
+#endif
 }
 
 static void command_delete_stream(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
@@ -2465,6 +3158,11 @@ static void command_create_record_stream(pa_pdispatch *pd, uint32_t command, uin
 
     CHECK_VALIDITY_GOTO(c->pstream, s, tag, ret, finish);
 
+    /* Room for two fragments, so that one can be queued while the last
+     * one is still on its way to a remote client */
+    if (!c->is_local)
+        pa_pstream_grow_socket_buffers(c->pstream, 0, 2 * s->buffer_attr.fragsize);
+
     reply = reply_new(tag);
     pa_tagstruct_putu32(reply, s->index);
     pa_assert(s->source_output);
@@ -2540,6 +3238,7 @@ static void command_auth(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_ta
     const void*cookie;
     pa_tagstruct *reply;
     pa_bool_t shm_on_remote = FALSE, do_shm;
+    pa_bool_t memfd_on_remote = FALSE, do_memfd;
 
     pa_native_connection_assert_ref(c);
     pa_assert(t);
@@ -2565,6 +3264,14 @@ static void command_auth(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_ta
         c->version &= 0x7FFFFFFFU;
     }
 
+    /* Starting with protocol version 27 the second bit tells whether
+       memfd segments may be passed over this connection. */
+    memfd_on_remote = !!(c->version & 0x40000000U);
+    c->version &= 0x3FFFFFFFU;
+
+    if (c->version < 27)
+        memfd_on_remote = FALSE;
+
     pa_log_debug("Protocol version: remote %u, local %u", c->version, PA_PROTOCOL_VERSION);
 
     pa_proplist_setf(c->client->proplist, "native-protocol.version", "%u", c->version);
@@ -2649,8 +3356,39 @@ static void command_auth(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_ta
     pa_log_debug("Negotiated SHM: %s", pa_yes_no(do_shm));
     pa_pstream_enable_shm(c->pstream, do_shm);
 
+    /* Starting with protocol version 34 releases and revokes of SHM
+     * blocks may be sent in batches */
+    pa_pstream_enable_batching(c->pstream, do_shm && c->version >= 34);
+
+    /* Starting with protocol version 35 up to PA_MEMIMPORT_BLOCKS_MAX
+     * SHM blocks may be passed at a time */
+    pa_pstream_enable_large_exports(c->pstream, do_shm && c->version >= 35);
+
+    /* The fds of memfd segments are passed with SCM_RIGHTS, so this
+     * only works where credentials can be passed too. */
+#if defined(HAVE_CREDS) && defined(HAVE_MEMFD_CREATE)
+    do_memfd = do_shm && memfd_on_remote;
+#else
+    do_memfd = FALSE;
+#endif
+
+    pa_log_debug("Negotiated memfd: %s", pa_yes_no(do_memfd));
+
+    if (do_memfd) {
+        pa_pstream_enable_memfd(c->pstream, TRUE);
+
+        /* Give each client a pool of its own, so that it can only
+         * ever see what is meant for it. If that fails, the shared
+         * pool still works, just with named segments. */
+        if (!c->mempool && (c->mempool = pa_mempool_new_full(TRUE, TRUE,
+                                                             c->protocol->core->shm_size,
+                                                             c->protocol->core->shm_slot_size,
+                                                             c->protocol->core->shm_small_slot_size)))
+            pa_pstream_set_mempool(c->pstream, c->mempool);
+    }
+
     reply = reply_new(tag);
-    pa_tagstruct_putu32(reply, PA_PROTOCOL_VERSION | (do_shm ? 0x80000000 : 0));
+    pa_tagstruct_putu32(reply, PA_PROTOCOL_VERSION | (do_shm ? 0x80000000 : 0) | (do_memfd ? 0x40000000 : 0));
 
 #ifdef HAVE_CREDS
 {
@@ -2770,6 +3508,8 @@ static void command_stat(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_ta
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
     pa_tagstruct *reply;
     const pa_mempool_stat *stat;
+    pa_flist_stat *fstat;
+    unsigned n, i;
 
     pa_native_connection_assert_ref(c);
     pa_assert(t);
@@ -2789,6 +3529,20 @@ static void command_stat(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_ta
     pa_tagstruct_putu32(reply, (uint32_t) pa_atomic_load(&stat->n_accumulated));
     pa_tagstruct_putu32(reply, (uint32_t) pa_atomic_load(&stat->accumulated_size));
     pa_tagstruct_putu32(reply, (uint32_t) pa_scache_total_size(c->protocol->core));
+
+    if (c->version >= 27) {
+        fstat = pa_flist_get_stats(&n);
+
+        pa_tagstruct_putu32(reply, n);
+        for (i = 0; i < n; i++) {
+            pa_tagstruct_puts(reply, fstat[i].name);
+            pa_tagstruct_putu64(reply, fstat[i].hits);
+            pa_tagstruct_putu64(reply, fstat[i].misses);
+        }
+
+        pa_xfree(fstat);
+    }
+
     pa_pstream_send_tagstruct(c->pstream, reply);
 }
 
@@ -2822,10 +3576,7 @@ static void command_get_playback_latency(pa_pdispatch *pd, uint32_t command, uin
                           s->current_sink_latency +
                           pa_bytes_to_usec(s->render_memblockq_length, &s->sink_input->sink->sample_spec));
     pa_tagstruct_put_usec(reply, 0);
-    pa_tagstruct_put_boolean(reply,
-                             s->playing_for > 0 &&
-                             pa_sink_get_state(s->sink_input->sink) == PA_SINK_RUNNING &&
-                             pa_sink_input_get_state(s->sink_input) == PA_SINK_INPUT_RUNNING);
+    pa_tagstruct_put_boolean(reply, playback_stream_is_playing(s));
     pa_tagstruct_put_timeval(reply, &tv);
     pa_tagstruct_put_timeval(reply, pa_gettimeofday(&now));
     pa_tagstruct_puts64(reply, s->write_index);
@@ -2969,6 +3720,118 @@ static void command_finish_upload_stream(pa_pdispatch *pd, uint32_t command, uin
     upload_stream_unlink(s);
 }
 
+struct upload_sample {
+    const char *name;
+    pa_sample_spec sample_spec;
+    pa_channel_map channel_map;
+    pa_proplist *proplist;
+    uint32_t length;
+};
+
+static void command_finish_upload_samples(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+    struct upload_sample *samples = NULL;
+    uint32_t channel, n, n_parsed = 0, n_allocated = 0, i;
+    upload_stream *s;
+    size_t offset;
+    int error = 0;
+
+    pa_native_connection_assert_ref(c);
+    pa_assert(t);
+
+    if (pa_tagstruct_getu32(t, &channel) < 0 ||
+        pa_tagstruct_getu32(t, &n) < 0 ||
+        n == 0) {
+        protocol_error(c);
+        return;
+    }
+
+    /* n isn't trusted for allocating before the entries are there */
+    for (i = 0; i < n; i++) {
+        if (i >= n_allocated) {
+            n_allocated = PA_MAX(n_allocated * 2, 16U);
+            samples = pa_xrenew(struct upload_sample, samples, n_allocated);
+        }
+
+        samples[i].proplist = pa_proplist_new();
+        n_parsed++;
+
+        if (pa_tagstruct_gets(t, &samples[i].name) < 0 ||
+            pa_tagstruct_get_sample_spec(t, &samples[i].sample_spec) < 0 ||
+            pa_tagstruct_get_channel_map(t, &samples[i].channel_map) < 0 ||
+            pa_tagstruct_get_proplist(t, samples[i].proplist) < 0 ||
+            pa_tagstruct_getu32(t, &samples[i].length) < 0) {
+            protocol_error(c);
+            goto finish;
+        }
+    }
+
+    if (!pa_tagstruct_eof(t)) {
+        protocol_error(c);
+        goto finish;
+    }
+
+    if (!c->authorized) {
+        pa_pstream_send_error(c->pstream, tag, PA_ERR_ACCESS);
+        goto finish;
+    }
+
+    s = pa_idxset_get_by_index(c->output_streams, channel);
+
+    if (!s || !upload_stream_isinstance(s)) {
+        pa_pstream_send_error(c->pstream, tag, PA_ERR_NOENTITY);
+        goto finish;
+    }
+
+    /* Check everything before storing anything */
+    for (i = 0, offset = 0; i < n; i++) {
+        struct upload_sample *e = samples + i;
+
+        if (!e->name || !pa_namereg_is_valid_name(e->name) ||
+            !pa_sample_spec_valid(&e->sample_spec) ||
+            !pa_channel_map_valid(&e->channel_map) ||
+            e->channel_map.channels != e->sample_spec.channels ||
+            e->length == 0 || e->length % pa_frame_size(&e->sample_spec) != 0) {
+            error = PA_ERR_INVALID;
+            break;
+        }
+
+        offset += e->length;
+    }
+
+    if (!error && (!s->memchunk.memblock || offset != s->memchunk.length))
+        error = PA_ERR_INVALID;
+
+    for (i = 0, offset = 0; !error && i < n; i++) {
+        struct upload_sample *e = samples + i;
+        pa_memchunk chunk;
+        uint32_t idx;
+
+        chunk.memblock = s->memchunk.memblock;
+        chunk.index = s->memchunk.index + offset;
+        chunk.length = e->length;
+        offset += e->length;
+
+        pa_proplist_update(e->proplist, PA_UPDATE_MERGE, c->client->proplist);
+
+        if (pa_scache_add_item(c->protocol->core, e->name, &e->sample_spec, &e->channel_map, &chunk, e->proplist, &idx) < 0)
+            error = PA_ERR_INTERNAL;
+    }
+
+    if (error)
+        pa_pstream_send_error(c->pstream, tag, error);
+    else
+        pa_pstream_send_simple_ack(c->pstream, tag);
+
+    upload_stream_unlink(s);
+
+finish:
+    for (i = 0; i < n_parsed; i++)
+        pa_proplist_free(samples[i].proplist);
+
+    pa_xfree(samples);
+}
+
 static void command_play_sample(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
     uint32_t sink_index;
@@ -3080,7 +3943,56 @@ static void fixup_sample_spec(pa_native_connection *c, pa_sample_spec *fixed, co
     }
 }
 
-static void sink_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sink *sink) {
+/* Proplists the client left out of an info reply are sent empty */
+static void put_info_proplist(pa_tagstruct *t, pa_proplist *p, pa_info_fields_t fields) {
+    pa_proplist *empty;
+
+    if (fields & PA_INFO_FIELDS_PROPLIST) {
+        pa_tagstruct_put_proplist(t, p);
+        return;
+    }
+
+    empty = pa_proplist_new();
+    pa_tagstruct_put_proplist(t, empty);
+    pa_proplist_free(empty);
+}
+
+/* Without PA_INFO_FIELDS_PORTS only the active port is listed */
+static void put_device_ports(pa_native_connection *c, pa_tagstruct *t, pa_hashmap *ports, pa_device_port *active_port, pa_info_fields_t fields) {
+    void *state;
+    pa_device_port *p;
+
+    if (!(fields & PA_INFO_FIELDS_PORTS)) {
+        pa_tagstruct_putu32(t, active_port ? 1 : 0);
+
+        if (active_port) {
+            pa_tagstruct_puts(t, active_port->name);
+            pa_tagstruct_puts(t, active_port->description);
+            pa_tagstruct_putu32(t, active_port->priority);
+            if (c->version >= 24)
+                pa_tagstruct_putu32(t, active_port->available);
+        }
+
+        pa_tagstruct_puts(t, active_port ? active_port->name : NULL);
+        return;
+    }
+
+    pa_tagstruct_putu32(t, ports ? pa_hashmap_size(ports) : 0);
+
+    if (ports) {
+        PA_HASHMAP_FOREACH(p, ports, state) {
+            pa_tagstruct_puts(t, p->name);
+            pa_tagstruct_puts(t, p->description);
+            pa_tagstruct_putu32(t, p->priority);
+            if (c->version >= 24)
+                pa_tagstruct_putu32(t, p->available);
+        }
+    }
+
+    pa_tagstruct_puts(t, active_port ? active_port->name : NULL);
+}
+
+static void sink_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sink *sink, pa_info_fields_t fields) {
     pa_sample_spec fixed_ss;
 
     pa_assert(t);
@@ -3100,13 +4012,13 @@ static void sink_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sin
         PA_TAG_BOOLEAN, pa_sink_get_mute(sink, FALSE),
         PA_TAG_U32, sink->monitor_source ? sink->monitor_source->index : PA_INVALID_INDEX,
         PA_TAG_STRING, sink->monitor_source ? sink->monitor_source->name : NULL,
-        PA_TAG_USEC, pa_sink_get_latency(sink),
+        PA_TAG_USEC, (fields & PA_INFO_FIELDS_LATENCY) ? pa_sink_get_latency(sink) : 0,
         PA_TAG_STRING, sink->driver,
         PA_TAG_U32, sink->flags & PA_SINK_CLIENT_FLAGS_MASK,
         PA_TAG_INVALID);
 
     if (c->version >= 13) {
-        pa_tagstruct_put_proplist(t, sink->proplist);
+        put_info_proplist(t, sink->proplist, fields);
         pa_tagstruct_put_usec(t, pa_sink_get_requested_latency(sink));
     }
 
@@ -3119,26 +4031,12 @@ static void sink_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sin
         pa_tagstruct_putu32(t, sink->card ? sink->card->index : PA_INVALID_INDEX);
     }
 
-    if (c->version >= 16) {
-        pa_tagstruct_putu32(t, sink->ports ? pa_hashmap_size(sink->ports) : 0);
+    if (c->version >= 16)
+        put_device_ports(c, t, sink->ports, sink->active_port, fields);
 
-        if (sink->ports) {
-            void *state;
-            pa_device_port *p;
-
-            PA_HASHMAP_FOREACH(p, sink->ports, state) {
-                pa_tagstruct_puts(t, p->name);
-                pa_tagstruct_puts(t, p->description);
-                pa_tagstruct_putu32(t, p->priority);
-                if (c->version >= 24)
-                    pa_tagstruct_putu32(t, p->available);
-            }
-        }
-
-        pa_tagstruct_puts(t, sink->active_port ? sink->active_port->name : NULL);
-    }
-
-    if (c->version >= 21) {
+    if (c->version >= 21 && !(fields & PA_INFO_FIELDS_FORMATS))
+        pa_tagstruct_putu8(t, 0);
+    else if (c->version >= 21) {
         uint32_t i;
         pa_format_info *f;
         pa_idxset *formats = pa_sink_get_formats(sink);
@@ -3152,7 +4050,7 @@ static void sink_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sin
     }
 }
 
-static void source_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_source *source) {
+static void source_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_source *source, pa_info_fields_t fields) {
     pa_sample_spec fixed_ss;
 
     pa_assert(t);
@@ -3172,13 +4070,13 @@ static void source_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_s
         PA_TAG_BOOLEAN, pa_source_get_mute(source, FALSE),
         PA_TAG_U32, source->monitor_of ? source->monitor_of->index : PA_INVALID_INDEX,
         PA_TAG_STRING, source->monitor_of ? source->monitor_of->name : NULL,
-        PA_TAG_USEC, pa_source_get_latency(source),
+        PA_TAG_USEC, (fields & PA_INFO_FIELDS_LATENCY) ? pa_source_get_latency(source) : 0,
         PA_TAG_STRING, source->driver,
         PA_TAG_U32, source->flags & PA_SOURCE_CLIENT_FLAGS_MASK,
         PA_TAG_INVALID);
 
     if (c->version >= 13) {
-        pa_tagstruct_put_proplist(t, source->proplist);
+        put_info_proplist(t, source->proplist, fields);
         pa_tagstruct_put_usec(t, pa_source_get_requested_latency(source));
     }
 
@@ -3191,27 +4089,12 @@ static void source_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_s
         pa_tagstruct_putu32(t, source->card ? source->card->index : PA_INVALID_INDEX);
     }
 
-    if (c->version >= 16) {
-
-        pa_tagstruct_putu32(t, source->ports ? pa_hashmap_size(source->ports) : 0);
-
-        if (source->ports) {
-            void *state;
-            pa_device_port *p;
-
-            PA_HASHMAP_FOREACH(p, source->ports, state) {
-                pa_tagstruct_puts(t, p->name);
-                pa_tagstruct_puts(t, p->description);
-                pa_tagstruct_putu32(t, p->priority);
-                if (c->version >= 24)
-                    pa_tagstruct_putu32(t, p->available);
-            }
-        }
-
-        pa_tagstruct_puts(t, source->active_port ? source->active_port->name : NULL);
-    }
+    if (c->version >= 16)
+        put_device_ports(c, t, source->ports, source->active_port, fields);
 
-    if (c->version >= 22) {
+    if (c->version >= 22 && !(fields & PA_INFO_FIELDS_FORMATS))
+        pa_tagstruct_putu8(t, 0);
+    else if (c->version >= 22) {
         uint32_t i;
         pa_format_info *f;
         pa_idxset *formats = pa_source_get_formats(source);
@@ -3225,7 +4108,7 @@ static void source_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_s
     }
 }
 
-static void client_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_client *client) {
+static void client_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_client *client, pa_info_fields_t fields) {
     pa_assert(t);
     pa_assert(client);
 
@@ -3235,10 +4118,10 @@ static void client_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_c
     pa_tagstruct_puts(t, client->driver);
 
     if (c->version >= 13)
-        pa_tagstruct_put_proplist(t, client->proplist);
+        put_info_proplist(t, client->proplist, fields);
 }
 
-static void card_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_card *card) {
+static void card_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_card *card, pa_info_fields_t fields) {
     void *state = NULL;
     pa_card_profile *p;
 
@@ -3250,25 +4133,38 @@ static void card_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_car
     pa_tagstruct_putu32(t, card->module ? card->module->index : PA_INVALID_INDEX);
     pa_tagstruct_puts(t, card->driver);
 
-    pa_tagstruct_putu32(t, card->profiles ? pa_hashmap_size(card->profiles) : 0);
+    /* Without PA_INFO_FIELDS_PROFILES only the active profile is listed */
+    if (!(fields & PA_INFO_FIELDS_PROFILES)) {
+        pa_tagstruct_putu32(t, card->active_profile ? 1 : 0);
 
-    if (card->profiles) {
-        while ((p = pa_hashmap_iterate(card->profiles, &state, NULL))) {
+        if ((p = card->active_profile)) {
             pa_tagstruct_puts(t, p->name);
             pa_tagstruct_puts(t, p->description);
             pa_tagstruct_putu32(t, p->n_sinks);
             pa_tagstruct_putu32(t, p->n_sources);
             pa_tagstruct_putu32(t, p->priority);
         }
+    } else {
+        pa_tagstruct_putu32(t, card->profiles ? pa_hashmap_size(card->profiles) : 0);
+
+        if (card->profiles) {
+            while ((p = pa_hashmap_iterate(card->profiles, &state, NULL))) {
+                pa_tagstruct_puts(t, p->name);
+                pa_tagstruct_puts(t, p->description);
+                pa_tagstruct_putu32(t, p->n_sinks);
+                pa_tagstruct_putu32(t, p->n_sources);
+                pa_tagstruct_putu32(t, p->priority);
+            }
+        }
     }
 
     pa_tagstruct_puts(t, card->active_profile ? card->active_profile->name : NULL);
-    pa_tagstruct_put_proplist(t, card->proplist);
+    put_info_proplist(t, card->proplist, fields);
 
     if (c->version < 26)
         return;
 
-    if (card->ports) {
+    if (card->ports && (fields & PA_INFO_FIELDS_PORTS)) {
         pa_device_port* port;
         pa_proplist* proplist = pa_proplist_new(); /* For now - push an empty proplist */
 
@@ -3282,7 +4178,14 @@ static void card_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_car
             pa_tagstruct_putu8(t, /* FIXME: port->direction */ (port->is_input ? PA_DIRECTION_INPUT : 0) | (port->is_output ? PA_DIRECTION_OUTPUT : 0));
             pa_tagstruct_put_proplist(t, proplist);
 
-            if (port->profiles) {
+            /* Only profiles that are listed above may be referred to */
+            if (port->profiles && !(fields & PA_INFO_FIELDS_PROFILES)) {
+                if (card->active_profile && pa_hashmap_get(port->profiles, card->active_profile->name)) {
+                    pa_tagstruct_putu32(t, 1);
+                    pa_tagstruct_puts(t, card->active_profile->name);
+                } else
+                    pa_tagstruct_putu32(t, 0);
+            } else if (port->profiles) {
                 void* state2;
                 pa_tagstruct_putu32(t, pa_hashmap_size(port->profiles));
                 PA_HASHMAP_FOREACH(p, port->profiles, state2)
@@ -3296,7 +4199,7 @@ static void card_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_car
         pa_tagstruct_putu32(t, 0);
 }
 
-static void module_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_module *module) {
+static void module_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_module *module, pa_info_fields_t fields) {
     pa_assert(t);
     pa_assert(module);
 
@@ -3309,10 +4212,10 @@ static void module_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_m
         pa_tagstruct_put_boolean(t, FALSE); /* autoload is obsolete */
 
     if (c->version >= 15)
-        pa_tagstruct_put_proplist(t, module->proplist);
+        put_info_proplist(t, module->proplist, fields);
 }
 
-static void sink_input_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sink_input *s) {
+static void sink_input_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sink_input *s, pa_info_fields_t fields) {
     pa_sample_spec fixed_ss;
     pa_usec_t sink_latency;
     pa_cvolume v;
@@ -3337,14 +4240,19 @@ static void sink_input_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t,
     pa_tagstruct_put_sample_spec(t, &fixed_ss);
     pa_tagstruct_put_channel_map(t, &s->channel_map);
     pa_tagstruct_put_cvolume(t, &v);
-    pa_tagstruct_put_usec(t, pa_sink_input_get_latency(s, &sink_latency));
-    pa_tagstruct_put_usec(t, sink_latency);
+    if (fields & PA_INFO_FIELDS_LATENCY) {
+        pa_tagstruct_put_usec(t, pa_sink_input_get_latency(s, &sink_latency));
+        pa_tagstruct_put_usec(t, sink_latency);
+    } else {
+        pa_tagstruct_put_usec(t, 0);
+        pa_tagstruct_put_usec(t, 0);
+    }
     pa_tagstruct_puts(t, pa_resample_method_to_string(pa_sink_input_get_resample_method(s)));
     pa_tagstruct_puts(t, s->driver);
     if (c->version >= 11)
         pa_tagstruct_put_boolean(t, pa_sink_input_get_mute(s));
     if (c->version >= 13)
-        pa_tagstruct_put_proplist(t, s->proplist);
+        put_info_proplist(t, s->proplist, fields);
     if (c->version >= 19)
         pa_tagstruct_put_boolean(t, (pa_sink_input_get_state(s) == PA_SINK_INPUT_CORKED));
     if (c->version >= 20) {
@@ -3355,7 +4263,7 @@ static void sink_input_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t,
         pa_tagstruct_put_format_info(t, s->format);
 }
 
-static void source_output_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_source_output *s) {
+static void source_output_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_source_output *s, pa_info_fields_t fields) {
     pa_sample_spec fixed_ss;
     pa_usec_t source_latency;
     pa_cvolume v;
@@ -3379,12 +4287,17 @@ static void source_output_fill_tagstruct(pa_native_connection *c, pa_tagstruct *
     pa_tagstruct_putu32(t, s->source->index);
     pa_tagstruct_put_sample_spec(t, &fixed_ss);
     pa_tagstruct_put_channel_map(t, &s->channel_map);
-    pa_tagstruct_put_usec(t, pa_source_output_get_latency(s, &source_latency));
-    pa_tagstruct_put_usec(t, source_latency);
+    if (fields & PA_INFO_FIELDS_LATENCY) {
+        pa_tagstruct_put_usec(t, pa_source_output_get_latency(s, &source_latency));
+        pa_tagstruct_put_usec(t, source_latency);
+    } else {
+        pa_tagstruct_put_usec(t, 0);
+        pa_tagstruct_put_usec(t, 0);
+    }
     pa_tagstruct_puts(t, pa_resample_method_to_string(pa_source_output_get_resample_method(s)));
     pa_tagstruct_puts(t, s->driver);
     if (c->version >= 13)
-        pa_tagstruct_put_proplist(t, s->proplist);
+        put_info_proplist(t, s->proplist, fields);
     if (c->version >= 19)
         pa_tagstruct_put_boolean(t, (pa_source_output_get_state(s) == PA_SOURCE_OUTPUT_CORKED));
     if (c->version >= 22) {
@@ -3396,7 +4309,7 @@ static void source_output_fill_tagstruct(pa_native_connection *c, pa_tagstruct *
     }
 }
 
-static void scache_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_scache_entry *e) {
+static void scache_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_scache_entry *e, pa_info_fields_t fields) {
     pa_sample_spec fixed_ss;
     pa_cvolume v;
 
@@ -3425,7 +4338,7 @@ static void scache_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_s
     pa_tagstruct_puts(t, e->filename);
 
     if (c->version >= 13)
-        pa_tagstruct_put_proplist(t, e->proplist);
+        put_info_proplist(t, e->proplist, fields);
 }
 
 static void command_get_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
@@ -3440,6 +4353,7 @@ static void command_get_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, p
     pa_source_output *so = NULL;
     pa_scache_entry *sce = NULL;
     const char *name = NULL;
+    pa_info_fields_t fields = PA_INFO_FIELDS_ALL;
     pa_tagstruct *reply;
 
     pa_native_connection_assert_ref(c);
@@ -3451,12 +4365,14 @@ static void command_get_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, p
          command != PA_COMMAND_GET_SINK_INPUT_INFO &&
          command != PA_COMMAND_GET_SOURCE_OUTPUT_INFO &&
          pa_tagstruct_gets(t, &name) < 0) ||
+        (c->version >= 38 && !pa_tagstruct_eof(t) && pa_tagstruct_getu32(t, &fields) < 0) ||
         !pa_tagstruct_eof(t)) {
         protocol_error(c);
         return;
     }
 
     CHECK_VALIDITY(c->pstream, c->authorized, tag, PA_ERR_ACCESS);
+    CHECK_VALIDITY(c->pstream, (fields & ~PA_INFO_FIELDS_ALL) == 0, tag, PA_ERR_INVALID);
     CHECK_VALIDITY(c->pstream, !name ||
                    (command == PA_COMMAND_GET_SINK_INFO &&
                     pa_namereg_is_valid_name_or_wildcard(name, PA_NAMEREG_SINK)) ||
@@ -3507,21 +4423,21 @@ static void command_get_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, p
 
     reply = reply_new(tag);
     if (sink)
-        sink_fill_tagstruct(c, reply, sink);
+        sink_fill_tagstruct(c, reply, sink, fields);
     else if (source)
-        source_fill_tagstruct(c, reply, source);
+        source_fill_tagstruct(c, reply, source, fields);
     else if (client)
-        client_fill_tagstruct(c, reply, client);
+        client_fill_tagstruct(c, reply, client, fields);
     else if (card)
-        card_fill_tagstruct(c, reply, card);
+        card_fill_tagstruct(c, reply, card, fields);
     else if (module)
-        module_fill_tagstruct(c, reply, module);
+        module_fill_tagstruct(c, reply, module, fields);
     else if (si)
-        sink_input_fill_tagstruct(c, reply, si);
+        sink_input_fill_tagstruct(c, reply, si, fields);
     else if (so)
-        source_output_fill_tagstruct(c, reply, so);
+        source_output_fill_tagstruct(c, reply, so, fields);
     else
-        scache_fill_tagstruct(c, reply, sce);
+        scache_fill_tagstruct(c, reply, sce, fields);
     pa_pstream_send_tagstruct(c->pstream, reply);
 }
 
@@ -3530,17 +4446,20 @@ static void command_get_info_list(pa_pdispatch *pd, uint32_t command, uint32_t t
     pa_idxset *i;
     uint32_t idx;
     void *p;
+    pa_info_fields_t fields = PA_INFO_FIELDS_ALL;
     pa_tagstruct *reply;
 
     pa_native_connection_assert_ref(c);
     pa_assert(t);
 
-    if (!pa_tagstruct_eof(t)) {
+    if ((c->version >= 38 && !pa_tagstruct_eof(t) && pa_tagstruct_getu32(t, &fields) < 0) ||
+        !pa_tagstruct_eof(t)) {
         protocol_error(c);
         return;
     }
 
     CHECK_VALIDITY(c->pstream, c->authorized, tag, PA_ERR_ACCESS);
+    CHECK_VALIDITY(c->pstream, (fields & ~PA_INFO_FIELDS_ALL) == 0, tag, PA_ERR_INVALID);
 
     reply = reply_new(tag);
 
@@ -3566,22 +4485,22 @@ static void command_get_info_list(pa_pdispatch *pd, uint32_t command, uint32_t t
     if (i) {
         for (p = pa_idxset_first(i, &idx); p; p = pa_idxset_next(i, &idx)) {
             if (command == PA_COMMAND_GET_SINK_INFO_LIST)
-                sink_fill_tagstruct(c, reply, p);
+                sink_fill_tagstruct(c, reply, p, fields);
             else if (command == PA_COMMAND_GET_SOURCE_INFO_LIST)
-                source_fill_tagstruct(c, reply, p);
+                source_fill_tagstruct(c, reply, p, fields);
             else if (command == PA_COMMAND_GET_CLIENT_INFO_LIST)
-                client_fill_tagstruct(c, reply, p);
+                client_fill_tagstruct(c, reply, p, fields);
             else if (command == PA_COMMAND_GET_CARD_INFO_LIST)
-                card_fill_tagstruct(c, reply, p);
+                card_fill_tagstruct(c, reply, p, fields);
             else if (command == PA_COMMAND_GET_MODULE_INFO_LIST)
-                module_fill_tagstruct(c, reply, p);
+                module_fill_tagstruct(c, reply, p, fields);
             else if (command == PA_COMMAND_GET_SINK_INPUT_INFO_LIST)
-                sink_input_fill_tagstruct(c, reply, p);
+                sink_input_fill_tagstruct(c, reply, p, fields);
             else if (command == PA_COMMAND_GET_SOURCE_OUTPUT_INFO_LIST)
-                source_output_fill_tagstruct(c, reply, p);
+                source_output_fill_tagstruct(c, reply, p, fields);
             else {
                 pa_assert(command == PA_COMMAND_GET_SAMPLE_INFO_LIST);
-                scache_fill_tagstruct(c, reply, p);
+                scache_fill_tagstruct(c, reply, p, fields);
             }
         }
     }
@@ -3589,14 +4508,44 @@ static void command_get_info_list(pa_pdispatch *pd, uint32_t command, uint32_t t
     pa_pstream_send_tagstruct(c->pstream, reply);
 }
 
-static void command_get_server_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
-    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
-    pa_tagstruct *reply;
+static void server_info_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t) {
     pa_sink *def_sink;
     pa_source *def_source;
     pa_sample_spec fixed_ss;
     char *h, *u;
 
+    pa_assert(c);
+    pa_assert(t);
+
+    pa_tagstruct_puts(t, PACKAGE_NAME);
+    pa_tagstruct_puts(t, PACKAGE_VERSION);
+
+    u = pa_get_user_name_malloc();
+    pa_tagstruct_puts(t, u);
+    pa_xfree(u);
+
+    h = pa_get_host_name_malloc();
+    pa_tagstruct_puts(t, h);
+    pa_xfree(h);
+
+    fixup_sample_spec(c, &fixed_ss, &c->protocol->core->default_sample_spec);
+    pa_tagstruct_put_sample_spec(t, &fixed_ss);
+
+    def_sink = pa_namereg_get_default_sink(c->protocol->core);
+    pa_tagstruct_puts(t, def_sink ? def_sink->name : NULL);
+    def_source = pa_namereg_get_default_source(c->protocol->core);
+    pa_tagstruct_puts(t, def_source ? def_source->name : NULL);
+
+    pa_tagstruct_putu32(t, c->protocol->core->cookie);
+
+    if (c->version >= 15)
+        pa_tagstruct_put_channel_map(t, &c->protocol->core->default_channel_map);
+}
+
+static void command_get_server_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+    pa_tagstruct *reply;
+
     pa_native_connection_assert_ref(c);
     pa_assert(t);
 
@@ -3608,29 +4557,106 @@ static void command_get_server_info(pa_pdispatch *pd, uint32_t command, uint32_t
     CHECK_VALIDITY(c->pstream, c->authorized, tag, PA_ERR_ACCESS);
 
     reply = reply_new(tag);
-    pa_tagstruct_puts(reply, PACKAGE_NAME);
-    pa_tagstruct_puts(reply, PACKAGE_VERSION);
+    server_info_fill_tagstruct(c, reply);
+    pa_pstream_send_tagstruct(c->pstream, reply);
+}
 
-    u = pa_get_user_name_malloc();
-    pa_tagstruct_puts(reply, u);
-    pa_xfree(u);
+/* The objects of a facility that are part of a snapshot, or NULL */
+static pa_idxset *snapshot_objects(pa_core *core, pa_subscription_event_type_t facility) {
+    switch (facility) {
+        case PA_SUBSCRIPTION_EVENT_SINK:
+            return core->sinks;
+        case PA_SUBSCRIPTION_EVENT_SOURCE:
+            return core->sources;
+        case PA_SUBSCRIPTION_EVENT_CARD:
+            return core->cards;
+        case PA_SUBSCRIPTION_EVENT_MODULE:
+            return core->modules;
+        case PA_SUBSCRIPTION_EVENT_CLIENT:
+            return core->clients;
+        case PA_SUBSCRIPTION_EVENT_SINK_INPUT:
+            return core->sink_inputs;
+        case PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT:
+            return core->source_outputs;
+        default:
+            return NULL;
+    }
+}
 
-    h = pa_get_host_name_malloc();
-    pa_tagstruct_puts(reply, h);
-    pa_xfree(h);
+static void snapshot_object_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_subscription_event_type_t facility, void *p) {
+    switch (facility) {
+        case PA_SUBSCRIPTION_EVENT_SINK:
+            sink_fill_tagstruct(c, t, p, PA_INFO_FIELDS_ALL);
+            break;
+        case PA_SUBSCRIPTION_EVENT_SOURCE:
+            source_fill_tagstruct(c, t, p, PA_INFO_FIELDS_ALL);
+            break;
+        case PA_SUBSCRIPTION_EVENT_CARD:
+            card_fill_tagstruct(c, t, p, PA_INFO_FIELDS_ALL);
+            break;
+        case PA_SUBSCRIPTION_EVENT_MODULE:
+            module_fill_tagstruct(c, t, p, PA_INFO_FIELDS_ALL);
+            break;
+        case PA_SUBSCRIPTION_EVENT_CLIENT:
+            client_fill_tagstruct(c, t, p, PA_INFO_FIELDS_ALL);
+            break;
+        case PA_SUBSCRIPTION_EVENT_SINK_INPUT:
+            sink_input_fill_tagstruct(c, t, p, PA_INFO_FIELDS_ALL);
+            break;
+        case PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT:
+            source_output_fill_tagstruct(c, t, p, PA_INFO_FIELDS_ALL);
+            break;
+        default:
+            pa_assert_not_reached();
+    }
+}
 
-    fixup_sample_spec(c, &fixed_ss, &c->protocol->core->default_sample_spec);
-    pa_tagstruct_put_sample_spec(reply, &fixed_ss);
+static void command_get_snapshot(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    /* Objects are listed before the ones that refer to them */
+    static const pa_subscription_event_type_t facilities[] = {
+        PA_SUBSCRIPTION_EVENT_MODULE,
+        PA_SUBSCRIPTION_EVENT_CLIENT,
+        PA_SUBSCRIPTION_EVENT_CARD,
+        PA_SUBSCRIPTION_EVENT_SINK,
+        PA_SUBSCRIPTION_EVENT_SOURCE,
+        PA_SUBSCRIPTION_EVENT_SINK_INPUT,
+        PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT
+    };
 
-    def_sink = pa_namereg_get_default_sink(c->protocol->core);
-    pa_tagstruct_puts(reply, def_sink ? def_sink->name : NULL);
-    def_source = pa_namereg_get_default_source(c->protocol->core);
-    pa_tagstruct_puts(reply, def_source ? def_source->name : NULL);
+    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+    pa_tagstruct *reply;
+    pa_bool_t follow;
+    unsigned k;
 
-    pa_tagstruct_putu32(reply, c->protocol->core->cookie);
+    pa_native_connection_assert_ref(c);
+    pa_assert(t);
 
-    if (c->version >= 15)
-        pa_tagstruct_put_channel_map(reply, &c->protocol->core->default_channel_map);
+    if (pa_tagstruct_get_boolean(t, &follow) < 0 ||
+        !pa_tagstruct_eof(t)) {
+        protocol_error(c);
+        return;
+    }
+
+    CHECK_VALIDITY(c->pstream, c->authorized, tag, PA_ERR_ACCESS);
+
+    reply = reply_new(tag);
+    server_info_fill_tagstruct(c, reply);
+
+    for (k = 0; k < PA_ELEMENTSOF(facilities); k++) {
+        pa_idxset *i;
+        uint32_t idx;
+        void *p;
+
+        pa_assert_se(i = snapshot_objects(c->protocol->core, facilities[k]));
+
+        pa_tagstruct_putu32(reply, facilities[k]);
+        pa_tagstruct_putu32(reply, pa_idxset_size(i));
+
+        PA_IDXSET_FOREACH(p, i, idx)
+            snapshot_object_fill_tagstruct(c, reply, facilities[k], p);
+    }
+
+    c->snapshot_follow = follow;
 
     pa_pstream_send_tagstruct(c->pstream, reply);
 }
@@ -3646,18 +4672,54 @@ static void subscription_cb(pa_core *core, pa_subscription_event_type_t e, uint3
     pa_tagstruct_putu32(t, (uint32_t) -1);
     pa_tagstruct_putu32(t, e);
     pa_tagstruct_putu32(t, idx);
+
+    if (c->snapshot_follow && (e & PA_SUBSCRIPTION_EVENT_TYPE_MASK) != PA_SUBSCRIPTION_EVENT_REMOVE) {
+        pa_subscription_event_type_t facility = e & PA_SUBSCRIPTION_EVENT_FACILITY_MASK;
+        pa_idxset *i;
+        void *p;
+
+        /* If the object is already gone again, the event goes out
+         * without info and a remove event follows */
+        if (facility == PA_SUBSCRIPTION_EVENT_SERVER)
+            server_info_fill_tagstruct(c, t);
+        else if ((i = snapshot_objects(core, facility)) && (p = pa_idxset_get_by_index(i, idx)))
+            snapshot_object_fill_tagstruct(c, t, facility, p);
+    }
+
     pa_pstream_send_tagstruct(c->pstream, t);
 }
 
 static void command_subscribe(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
     pa_subscription_mask_t m;
+    uint32_t n_filters = 0, i;
+    uint32_t filter_facility[PA_SUBSCRIPTION_EVENT_FACILITY_MASK + 1];
+    uint32_t filter_index[PA_SUBSCRIPTION_EVENT_FACILITY_MASK + 1];
 
     pa_native_connection_assert_ref(c);
     pa_assert(t);
 
-    if (pa_tagstruct_getu32(t, &m) < 0 ||
-        !pa_tagstruct_eof(t)) {
+    if (pa_tagstruct_getu32(t, &m) < 0) {
+        protocol_error(c);
+        return;
+    }
+
+    if (c->version >= 29 && !pa_tagstruct_eof(t)) {
+        if (pa_tagstruct_getu32(t, &n_filters) < 0 ||
+            n_filters > PA_ELEMENTSOF(filter_facility)) {
+            protocol_error(c);
+            return;
+        }
+
+        for (i = 0; i < n_filters; i++)
+            if (pa_tagstruct_getu32(t, &filter_facility[i]) < 0 ||
+                pa_tagstruct_getu32(t, &filter_index[i]) < 0) {
+                protocol_error(c);
+                return;
+            }
+    }
+
+    if (!pa_tagstruct_eof(t)) {
         protocol_error(c);
         return;
     }
@@ -3665,12 +4727,18 @@ static void command_subscribe(pa_pdispatch *pd, uint32_t command, uint32_t tag,
     CHECK_VALIDITY(c->pstream, c->authorized, tag, PA_ERR_ACCESS);
     CHECK_VALIDITY(c->pstream, (m & ~PA_SUBSCRIPTION_MASK_ALL) == 0, tag, PA_ERR_INVALID);
 
+    for (i = 0; i < n_filters; i++)
+        CHECK_VALIDITY(c->pstream, (filter_facility[i] & ~PA_SUBSCRIPTION_EVENT_FACILITY_MASK) == 0, tag, PA_ERR_INVALID);
+
     if (c->subscription)
         pa_subscription_free(c->subscription);
 
     if (m != 0) {
         c->subscription = pa_subscription_new(c->protocol->core, m, subscription_cb, c);
         pa_assert(c->subscription);
+
+        for (i = 0; i < n_filters; i++)
+            pa_subscription_set_filter(c->subscription, filter_facility[i], filter_index[i]);
     } else
         c->subscription = NULL;
 
@@ -3864,6 +4932,216 @@ static void command_set_mute(
     pa_pstream_send_simple_ack(c->pstream, tag);
 }
 
+struct volume_change {
+    uint32_t facility;
+    uint32_t idx;
+    pa_cvolume volume;
+    pa_bool_t set_mute;
+    pa_bool_t mute;
+    void *object;
+};
+
+/* Returns 0 or the error the change is refused with */
+static int volume_change_check(pa_native_connection *c, struct volume_change *e) {
+    const pa_sample_spec *ss;
+
+    if (e->volume.channels > 0 && !pa_cvolume_valid(&e->volume))
+        return PA_ERR_INVALID;
+
+    switch (e->facility) {
+
+        case PA_SUBSCRIPTION_EVENT_SINK: {
+            pa_sink *sink;
+
+            if (!(sink = e->object = pa_idxset_get_by_index(c->protocol->core->sinks, e->idx)))
+                return PA_ERR_NOENTITY;
+
+            ss = &sink->sample_spec;
+            break;
+        }
+
+        case PA_SUBSCRIPTION_EVENT_SOURCE: {
+            pa_source *source;
+
+            if (!(source = e->object = pa_idxset_get_by_index(c->protocol->core->sources, e->idx)))
+                return PA_ERR_NOENTITY;
+
+            ss = &source->sample_spec;
+            break;
+        }
+
+        case PA_SUBSCRIPTION_EVENT_SINK_INPUT: {
+            pa_sink_input *si;
+
+            if (!(si = e->object = pa_idxset_get_by_index(c->protocol->core->sink_inputs, e->idx)))
+                return PA_ERR_NOENTITY;
+
+            /* Not while it is being moved */
+            if (!si->sink || (e->volume.channels > 0 && !si->volume_writable))
+                return PA_ERR_BADSTATE;
+
+            ss = &si->sample_spec;
+            break;
+        }
+
+        case PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT: {
+            pa_source_output *so;
+
+            if (!(so = e->object = pa_idxset_get_by_index(c->protocol->core->source_outputs, e->idx)))
+                return PA_ERR_NOENTITY;
+
+            if (!so->source)
+                return PA_ERR_BADSTATE;
+
+            ss = &so->sample_spec;
+            break;
+        }
+
+        default:
+            return PA_ERR_INVALID;
+    }
+
+    if (e->volume.channels > 1 && !pa_cvolume_compatible(&e->volume, ss))
+        return PA_ERR_INVALID;
+
+    return 0;
+}
+
+static void volume_change_apply(struct volume_change *e) {
+    pa_sink *sink;
+    pa_source *source;
+    pa_sink_input *si;
+    pa_source_output *so;
+
+    switch (e->facility) {
+
+        case PA_SUBSCRIPTION_EVENT_SINK:
+            sink = e->object;
+
+            if (e->volume.channels > 0)
+                pa_sink_set_volume(sink, &e->volume, TRUE, TRUE);
+            if (e->set_mute)
+                pa_sink_set_mute(sink, e->mute, TRUE);
+            break;
+
+        case PA_SUBSCRIPTION_EVENT_SOURCE:
+            source = e->object;
+
+            if (e->volume.channels > 0)
+                pa_source_set_volume(source, &e->volume, TRUE, TRUE);
+            if (e->set_mute)
+                pa_source_set_mute(source, e->mute, TRUE);
+            break;
+
+        case PA_SUBSCRIPTION_EVENT_SINK_INPUT:
+            si = e->object;
+
+            if (e->volume.channels > 0)
+                pa_sink_input_set_volume(si, &e->volume, TRUE, TRUE);
+            if (e->set_mute)
+                pa_sink_input_set_mute(si, e->mute, TRUE);
+            break;
+
+        case PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT:
+            so = e->object;
+
+            if (e->volume.channels > 0)
+                pa_source_output_set_volume(so, &e->volume, TRUE, TRUE);
+            if (e->set_mute)
+                pa_source_output_set_mute(so, e->mute, TRUE);
+            break;
+
+        default:
+            pa_assert_not_reached();
+    }
+}
+
+static void command_set_volumes(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+    struct volume_change *changes = NULL;
+    uint32_t n, n_allocated = 0, i;
+    pa_idxset *sinks;
+    pa_sink *sink;
+    int error = 0;
+
+    pa_native_connection_assert_ref(c);
+    pa_assert(t);
+
+    if (pa_tagstruct_getu32(t, &n) < 0 || n == 0) {
+        protocol_error(c);
+        return;
+    }
+
+    /* n isn't trusted for allocating before the entries are there */
+    for (i = 0; i < n; i++) {
+        if (i >= n_allocated) {
+            n_allocated = PA_MAX(n_allocated * 2, 16U);
+            changes = pa_xrenew(struct volume_change, changes, n_allocated);
+        }
+
+        if (pa_tagstruct_getu32(t, &changes[i].facility) < 0 ||
+            pa_tagstruct_getu32(t, &changes[i].idx) < 0 ||
+            pa_tagstruct_get_cvolume(t, &changes[i].volume) < 0 ||
+            pa_tagstruct_get_boolean(t, &changes[i].set_mute) < 0 ||
+            pa_tagstruct_get_boolean(t, &changes[i].mute) < 0) {
+            protocol_error(c);
+            goto finish;
+        }
+    }
+
+    if (!pa_tagstruct_eof(t)) {
+        protocol_error(c);
+        goto finish;
+    }
+
+    if (!c->authorized) {
+        pa_pstream_send_error(c->pstream, tag, PA_ERR_ACCESS);
+        goto finish;
+    }
+
+    /* Check everything before changing anything */
+    for (i = 0; i < n; i++)
+        if ((error = volume_change_check(c, changes + i)) != 0) {
+            pa_pstream_send_error(c->pstream, tag, error);
+            goto finish;
+        }
+
+    pa_log_debug("Client %s changes the volume of %u objects.",
+                 pa_strnull(pa_proplist_gets(c->client->proplist, PA_PROP_APPLICATION_PROCESS_BINARY)), n);
+
+    /* The devices go first, so that the flat volume of a sink doesn't
+     * override what has been asked for its inputs */
+    for (i = 0; i < n; i++)
+        if (changes[i].facility == PA_SUBSCRIPTION_EVENT_SINK || changes[i].facility == PA_SUBSCRIPTION_EVENT_SOURCE)
+            volume_change_apply(changes + i);
+
+    /* The sink inputs of each sink are then synced with its IO thread
+     * at once */
+    sinks = pa_idxset_new(NULL, NULL);
+
+    for (i = 0; i < n; i++)
+        if (changes[i].facility == PA_SUBSCRIPTION_EVENT_SINK_INPUT) {
+            sink = ((pa_sink_input*) changes[i].object)->sink;
+
+            if (pa_idxset_put(sinks, sink, NULL) >= 0)
+                pa_sink_begin_volume_batch(sink);
+        }
+
+    for (i = 0; i < n; i++)
+        if (changes[i].facility == PA_SUBSCRIPTION_EVENT_SINK_INPUT || changes[i].facility == PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT)
+            volume_change_apply(changes + i);
+
+    while ((sink = pa_idxset_steal_first(sinks, NULL)))
+        pa_sink_end_volume_batch(sink);
+
+    pa_idxset_free(sinks, NULL, NULL);
+
+    pa_pstream_send_simple_ack(c->pstream, tag);
+
+finish:
+    pa_xfree(changes);
+}
+
 static void command_cork_playback_stream(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
     uint32_t idx;
@@ -4777,6 +6055,60 @@ static void pstream_memblock_callback(pa_pstream *p, uint32_t channel, int64_t o
     if (playback_stream_isinstance(stream)) {
         playback_stream *ps = PLAYBACK_STREAM(stream);
 
+        if (ps->ring) {
+            /* The only block of a ring stream is the ring itself */
+            if (!chunk->memblock || pa_stream_ring_attach(ps->ring, chunk) < 0) {
+                pa_log_warn("Client sent invalid ring buffer, killing stream.");
+                playback_stream_send_killed(ps);
+                playback_stream_unlink(ps);
+            }
+
+            return;
+        }
+
+#ifdef HAVE_OPUS
+        if (ps->decoder) {
+            /* Packets can only be appended to compressed streams */
+            if (seek != PA_SEEK_RELATIVE || offset != 0)
+                pa_log_debug("Ignoring seek on compressed stream.");
+
+            if (chunk->memblock && pa_opus_decoder_decode(ps->decoder, chunk, playback_stream_decoded_cb, ps) < 0)
+                protocol_error(c);
+
+            return;
+        }
+#endif
+
+        if (ps->packetizer) {
+            /* Frames can only be appended to compressed streams */
+            if (seek != PA_SEEK_RELATIVE || offset != 0)
+                pa_log_debug("Ignoring seek on compressed stream.");
+
+            if (chunk->memblock && pa_iec61937_packetizer_push(ps->packetizer, chunk, playback_stream_burst_cb, ps) < 0)
+                protocol_error(c);
+
+            return;
+        }
+
+        /* Nothing may overtake a seek or post still in flight */
+        if (chunk->memblock && seek == PA_SEEK_RELATIVE && offset == 0 &&
+            ps->direct && pa_atomic_load(&ps->direct_ok) &&
+            pa_atomic_load(&ps->seek_or_post_in_queue) == 0) {
+            struct direct_item *i;
+
+            if (!(i = pa_flist_pop(PA_STATIC_FLIST_GET(direct_items))))
+                i = pa_xnew(struct direct_item, 1);
+
+            i->chunk = *chunk;
+            pa_memblock_ref(i->chunk.memblock);
+
+            if (pa_asyncq_push(ps->direct, i, FALSE) >= 0)
+                return;
+
+            /* Full, the IO thread is not keeping up anyway */
+            direct_item_free(i);
+        }
+
         pa_atomic_inc(&ps->seek_or_post_in_queue);
         if (chunk->memblock) {
             if (seek != PA_SEEK_RELATIVE || offset != 0)
@@ -4944,6 +6276,7 @@ void pa_native_protocol_connect(pa_native_protocol *p, pa_iochannel *io, pa_nati
     c->protocol = p;
     c->options = pa_native_options_ref(o);
     c->authorized = FALSE;
+    c->mempool = NULL;
 
     if (o->auth_anonymous) {
         pa_log_info("Client authenticated anonymously.");
@@ -4971,7 +6304,22 @@ void pa_native_protocol_connect(pa_native_protocol *p, pa_iochannel *io, pa_nati
     c->client->send_event = client_send_event_cb;
     c->client->userdata = c;
 
-    c->pstream = pa_pstream_new(p->core->mainloop, io, p->core->mempool);
+#ifdef HAVE_CREDS
+    if (pa_iochannel_creds_supported(io))
+        pa_iochannel_creds_enable(io);
+#endif
+
+    c->io_worker = NULL;
+
+    if (o->io_threads > 0 && !p->io_workers &&
+        !(p->io_workers = pa_io_worker_pool_new(p->core->mainloop, o->io_threads)))
+        pa_log_warn("Failed to start IO worker threads, serving clients from the main loop.");
+
+    if (o->io_threads > 0 && p->io_workers) {
+        c->io_worker = pa_io_worker_pool_acquire(p->io_workers);
+        c->pstream = pa_io_worker_pstream_new(c->io_worker, p->core->mainloop, io, p->core->mempool);
+    } else
+        c->pstream = pa_pstream_new(p->core->mainloop, io, p->core->mempool);
     pa_pstream_set_receive_packet_callback(c->pstream, pstream_packet_callback, c);
     pa_pstream_set_receive_memblock_callback(c->pstream, pstream_memblock_callback, c);
     pa_pstream_set_die_callback(c->pstream, pstream_die_callback, c);
@@ -4979,21 +6327,24 @@ void pa_native_protocol_connect(pa_native_protocol *p, pa_iochannel *io, pa_nati
     pa_pstream_set_revoke_callback(c->pstream, pstream_revoke_callback, c);
     pa_pstream_set_release_callback(c->pstream, pstream_release_callback, c);
 
+    /* Over the network audio should not wait behind large replies */
+    pa_pstream_enable_audio_priority(c->pstream, !c->is_local);
+
     c->pdispatch = pa_pdispatch_new(p->core->mainloop, TRUE, command_table, PA_COMMAND_MAX);
 
     c->record_streams = pa_idxset_new(NULL, NULL);
     c->output_streams = pa_idxset_new(NULL, NULL);
 
+    c->pending_requests = pa_idxset_new(NULL, NULL);
+    c->request_event = p->core->mainloop->defer_new(p->core->mainloop, request_event_cb, c);
+    p->core->mainloop->defer_enable(c->request_event, 0);
+
     c->rrobin_index = PA_IDXSET_INVALID;
     c->subscription = NULL;
+    c->snapshot_follow = FALSE;
 
     pa_idxset_put(p->connections, c, NULL);
 
-#ifdef HAVE_CREDS
-    if (pa_iochannel_creds_supported(io))
-        pa_iochannel_creds_enable(io);
-#endif
-
     pa_hook_fire(&p->hooks[PA_NATIVE_HOOK_CONNECTION_PUT], c);
 }
 
@@ -5023,6 +6374,7 @@ static pa_native_protocol* native_protocol_new(pa_core *c) {
     p->servers = NULL;
 
     p->extensions = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+    p->io_workers = NULL;
 
     for (h = 0; h < PA_NATIVE_HOOK_MAX; h++)
         pa_hook_init(&p->hooks[h], p);
@@ -5065,6 +6417,9 @@ void pa_native_protocol_unref(pa_native_protocol *p) {
 
     pa_idxset_free(p->connections, NULL, NULL);
 
+    if (p->io_workers)
+        pa_io_worker_pool_free(p->io_workers);
+
     pa_strlist_free(p->servers);
 
     for (h = 0; h < PA_NATIVE_HOOK_MAX; h++)
@@ -5231,6 +6586,11 @@ int pa_native_options_parse(pa_native_options *o, pa_core *c, pa_modargs *ma) {
     } else
           o->auth_cookie = NULL;
 
+    if (pa_modargs_get_value_u32(ma, "io-threads", &o->io_threads) < 0 || o->io_threads > 64) {
+        pa_log("io-threads= expects a number of threads between 0 and 64.");
+        return -1;
+    }
+
     return 0;
 }
 
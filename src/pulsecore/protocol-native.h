@@ -47,6 +47,11 @@ typedef struct pa_native_options {
     char *auth_group;
     pa_ip_acl *auth_ip_acl;
     pa_auth_cookie *auth_cookie;
+
+    /* If > 0, socket IO and framing of the clients is done by a pool
+     * of this many threads, the commands are still handled by the
+     * main loop */
+    uint32_t io_threads;
 } pa_native_options;
 
 typedef enum pa_native_hook {
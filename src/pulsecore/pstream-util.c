@@ -29,15 +29,12 @@
 #include "pstream-util.h"
 
 void pa_pstream_send_tagstruct_with_creds(pa_pstream *p, pa_tagstruct *t, const pa_creds *creds) {
-    size_t length;
-    uint8_t *data;
     pa_packet *packet;
 
     pa_assert(p);
     pa_assert(t);
 
-    pa_assert_se(data = pa_tagstruct_free_data(t, &length));
-    pa_assert_se(packet = pa_packet_new_dynamic(data, length));
+    pa_assert_se(packet = pa_tagstruct_free_packet(t));
     pa_pstream_send_packet(p, packet, creds);
     pa_packet_unref(packet);
 }
@@ -26,6 +26,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #ifdef HAVE_NETINET_IN_H
@@ -36,11 +37,15 @@
 
 #include <pulsecore/socket.h>
 #include <pulsecore/queue.h>
+#include <pulsecore/hashmap.h>
+#include <pulsecore/core-util.h>
 #include <pulsecore/log.h>
 #include <pulsecore/creds.h>
 #include <pulsecore/refcnt.h>
 #include <pulsecore/flist.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/mutex.h>
+#include <pulsecore/atomic.h>
 
 #include "pstream.h"
 
@@ -48,6 +53,8 @@
 #define PA_FLAG_SHMDATA    0x80000000LU
 #define PA_FLAG_SHMRELEASE 0x40000000LU
 #define PA_FLAG_SHMREVOKE  0xC0000000LU
+#define PA_FLAG_SHMREGISTER 0x20000000LU
+#define PA_FLAG_SHMBATCH   0x10000000LU
 #define PA_FLAG_SHMMASK    0xFF000000LU
 #define PA_FLAG_SEEKMASK   0x000000FFLU
 
@@ -79,6 +86,18 @@ typedef uint32_t pa_pstream_descriptor[PA_PSTREAM_DESCRIPTOR_MAX];
  */
 #define FRAME_SIZE_MAX_ALLOW (1024*1024*16)
 
+/* How many block ids a batched release or revoke frame carries */
+#define BLOCK_IDS_MAX 256
+
+/* How many queued items are gathered into a single write */
+#define WRITE_ITEMS_MAX 16
+
+/* Packets from this size on, mostly introspection replies, may be
+ * overtaken by audio if that is enabled */
+#define BULK_PACKET_SIZE 2048
+
+#define WRITE_ITEM(p, k) (&(p)->write.items[((p)->write.first + (k)) % WRITE_ITEMS_MAX])
+
 PA_STATIC_FLIST_DECLARE(items, 0, pa_xfree);
 
 struct item_info {
@@ -86,7 +105,10 @@ struct item_info {
         PA_PSTREAM_ITEM_PACKET,
         PA_PSTREAM_ITEM_MEMBLOCK,
         PA_PSTREAM_ITEM_SHMRELEASE,
-        PA_PSTREAM_ITEM_SHMREVOKE
+        PA_PSTREAM_ITEM_SHMREVOKE,
+        PA_PSTREAM_ITEM_SHMRELEASES,
+        PA_PSTREAM_ITEM_SHMREVOKES,
+        PA_PSTREAM_ITEM_SHMREGISTER
     } type;
 
     /* packet info */
@@ -102,8 +124,23 @@ struct item_info {
     int64_t offset;
     pa_seek_mode_t seek_mode;
 
-    /* release/revoke info */
+    /* release/revoke info, shm id for register items */
     uint32_t block_id;
+
+    /* batched release/revoke info, in network byte order */
+    uint32_t *block_ids;
+    unsigned n_block_ids;
+
+    /* memfd to pass along with a register item */
+    int fd;
+};
+
+struct write_item {
+    struct item_info *current;
+    pa_pstream_descriptor descriptor;
+    uint32_t shm_info[PA_PSTREAM_SHM_MAX];
+    void *data;
+    pa_memchunk memchunk;
 };
 
 struct pa_pstream {
@@ -115,30 +152,56 @@ struct pa_pstream {
 
     pa_queue *send_queue;
 
+    /* Audio that overtakes the bulk packets at the end of send_queue.
+     * An item only goes here while everything in send_queue is a bulk
+     * packet, so nothing ever overtakes a small packet or other audio,
+     * and packets stay in order among themselves. n_ordered counts the
+     * other items in send_queue. */
+    pa_queue *audio_queue;
+    unsigned n_ordered;
+    pa_bool_t audio_priority;
+    size_t rcvbuf, sndbuf;
+
     pa_bool_t dead;
 
     struct {
-        pa_pstream_descriptor descriptor;
-        struct item_info* current;
-        uint32_t shm_info[PA_PSTREAM_SHM_MAX];
-        void *data;
+        /* Ring of items taken from the send queue, index is the number
+         * of bytes of the first one that have already been written */
+        struct write_item items[WRITE_ITEMS_MAX];
+        unsigned first, n_items;
         size_t index;
-        pa_memchunk memchunk;
     } write;
 
     struct {
         pa_pstream_descriptor descriptor;
-        pa_memblock *memblock;
         pa_packet *packet;
         uint32_t shm_info[PA_PSTREAM_SHM_MAX];
+        uint32_t block_ids[BLOCK_IDS_MAX];
         void *data;
         size_t index;
+
+        /* Everything is read into this buffer first, as much as the
+         * socket has to offer. The payload of memblock frames is passed
+         * on as references into it, everything else is copied out. */
+        pa_memblock *buffer;
+        size_t buffer_length;
     } read;
 
     pa_bool_t use_shm;
+    pa_bool_t use_memfd;
     pa_memimport *import;
     pa_memexport *export;
 
+    /* If set, releases and revokes are added to the last batch still
+     * waiting in the send queue, if there is one. Protected like
+     * send_queue. */
+    pa_bool_t batch_block_ids;
+    struct item_info *release_batch, *revoke_batch;
+
+    /* If set, the other side imports up to PA_MEMIMPORT_BLOCKS_MAX
+     * blocks from us */
+    pa_bool_t large_exports;
+
     pa_pstream_packet_cb_t receive_packet_callback;
     void *receive_packet_callback_userdata;
 
@@ -160,19 +223,209 @@ struct pa_pstream {
     pa_mempool *mempool;
 
 #ifdef HAVE_CREDS
-    pa_creds read_creds, write_creds;
-    pa_bool_t read_creds_valid, send_creds_now;
+    pa_creds read_creds;
+    pa_bool_t read_creds_valid;
+
+    /* memfds received but not yet claimed by a register frame */
+    int read_fds[PA_IOCHANNEL_FDS_MAX];
+    unsigned n_read_fds;
 #endif
+
+    /* memfd segments the other side already knows about */
+    pa_hashmap *registered_memfds;
+
+    /* Only for pstreams created with pa_pstream_new_threaded(). The IO
+     * thread holds mutex while it reads or writes, the main loop while
+     * it changes what that depends on. send_queue has a lock of its
+     * own, so that sending never waits for the socket. */
+    const pa_pstream_thread_ops *thread_ops;
+    void *thread;
+    pa_mutex *mutex, *queue_mutex;
+    pa_atomic_t kick_pending;
+    pa_atomic_t n_pending;
+    int thread_ifd, thread_ofd;
+    pa_bool_t thread_ref;
+};
+
+/* Things the IO thread of a threaded pstream passes on to the main
+ * loop */
+enum {
+    EVENT_PACKET,
+    EVENT_MEMBLOCK,
+    EVENT_DRAIN,
+    EVENT_DIE
+};
+
+struct event {
+    pa_pstream *pstream;
+    int type;
+
+    pa_packet *packet;
+#ifdef HAVE_CREDS
+    pa_bool_t with_creds;
+    pa_creds creds;
+#endif
+
+    uint32_t channel;
+    int64_t offset;
+    pa_seek_mode_t seek_mode;
+    pa_memchunk chunk;
 };
 
 static int do_write(pa_pstream *p);
 static int do_read(pa_pstream *p);
 
+static void lock(pa_pstream *p) {
+    if (p->mutex)
+        pa_mutex_lock(p->mutex);
+}
+
+static void unlock(pa_pstream *p) {
+    if (p->mutex)
+        pa_mutex_unlock(p->mutex);
+}
+
+static void pstream_unref_cb(void *userdata) {
+    pa_pstream_unref(userdata);
+}
+
+static void event_cb(void *userdata) {
+    struct event *e = userdata;
+    pa_pstream *p = e->pstream;
+
+    if (p->dead)
+        return;
+
+    switch (e->type) {
+        case EVENT_PACKET:
+            if (p->receive_packet_callback)
+#ifdef HAVE_CREDS
+                p->receive_packet_callback(p, e->packet, e->with_creds ? &e->creds : NULL, p->receive_packet_callback_userdata);
+#else
+                p->receive_packet_callback(p, e->packet, NULL, p->receive_packet_callback_userdata);
+#endif
+            break;
+
+        case EVENT_MEMBLOCK:
+            if (p->receive_memblock_callback)
+                p->receive_memblock_callback(p, e->channel, e->offset, e->seek_mode, &e->chunk, p->receive_memblock_callback_userdata);
+            break;
+
+        case EVENT_DRAIN:
+            if (p->drain_callback && !pa_pstream_is_pending(p))
+                p->drain_callback(p, p->drain_callback_userdata);
+            break;
+
+        case EVENT_DIE:
+            if (p->die_callback)
+                p->die_callback(p, p->die_callback_userdata);
+
+            pa_pstream_unlink(p);
+            break;
+    }
+}
+
+static void event_free(void *userdata) {
+    struct event *e = userdata;
+
+    if (e->packet)
+        pa_packet_unref(e->packet);
+
+    if (e->chunk.memblock)
+        pa_memblock_unref(e->chunk.memblock);
+
+    pa_pstream_unref(e->pstream);
+    pa_xfree(e);
+}
+
+/* In the IO thread of a threaded pstream */
+static struct event *event_new(pa_pstream *p, int type) {
+    struct event *e;
+
+    pa_assert(p->thread_ops);
+
+    e = pa_xnew0(struct event, 1);
+    e->pstream = pa_pstream_ref(p);
+    e->type = type;
+
+    return e;
+}
+
+static void event_post(pa_pstream *p, struct event *e) {
+    p->thread_ops->call_main(p->thread, event_cb, event_free, e);
+}
+
+static void deliver_packet(pa_pstream *p, pa_packet *packet, const pa_creds *creds) {
+    struct event *e;
+
+    if (!p->thread_ops) {
+        if (p->receive_packet_callback)
+            p->receive_packet_callback(p, packet, creds, p->receive_packet_callback_userdata);
+        return;
+    }
+
+    e = event_new(p, EVENT_PACKET);
+    e->packet = pa_packet_ref(packet);
+#ifdef HAVE_CREDS
+    if ((e->with_creds = !!creds))
+        e->creds = *creds;
+#endif
+
+    event_post(p, e);
+}
+
+static void deliver_memblock(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek_mode, const pa_memchunk *chunk) {
+    struct event *e;
+
+    if (!p->thread_ops) {
+        if (p->receive_memblock_callback)
+            p->receive_memblock_callback(p, channel, offset, seek_mode, chunk, p->receive_memblock_callback_userdata);
+        return;
+    }
+
+    e = event_new(p, EVENT_MEMBLOCK);
+    e->channel = channel;
+    e->offset = offset;
+    e->seek_mode = seek_mode;
+    e->chunk = *chunk;
+
+    /* The block is NULL if it could not be imported */
+    if (e->chunk.memblock)
+        pa_memblock_ref(e->chunk.memblock);
+
+    event_post(p, e);
+}
+
+static pa_bool_t wants_memblocks(pa_pstream *p) {
+    /* Whether the main loop has a callback is up to it */
+    return p->thread_ops || p->receive_memblock_callback;
+}
+
+/* In the IO thread, when it is done with the socket. The caller has to
+ * hold a reference, since the one of the thread is dropped here. */
+static void thread_teardown(pa_pstream *p) {
+    if (p->io) {
+        pa_iochannel_free(p->io);
+        p->io = NULL;
+    }
+
+    if (p->defer_event) {
+        p->mainloop->defer_free(p->defer_event);
+        p->defer_event = NULL;
+    }
+
+    if (p->thread_ref) {
+        p->thread_ref = FALSE;
+        pa_pstream_unref(p);
+    }
+}
+
 static void do_something(pa_pstream *p) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
 
     pa_pstream_ref(p);
+    lock(p);
 
     p->mainloop->defer_enable(p->defer_event, 0);
 
@@ -187,18 +440,30 @@ static void do_something(pa_pstream *p) {
             goto fail;
     }
 
+    unlock(p);
     pa_pstream_unref(p);
     return;
 
 fail:
+    unlock(p);
 
-    if (p->die_callback)
-        p->die_callback(p, p->die_callback_userdata);
+    if (p->thread_ops) {
+        /* The main loop unlinks p when it gets this */
+        event_post(p, event_new(p, EVENT_DIE));
+        thread_teardown(p);
+    } else {
+        if (p->die_callback)
+            p->die_callback(p, p->die_callback_userdata);
+
+        pa_pstream_unlink(p);
+    }
 
-    pa_pstream_unlink(p);
     pa_pstream_unref(p);
 }
 
+/* Makes the loop that does the IO write out the send queue */
+static void schedule(pa_pstream *p);
+
 static void io_callback(pa_iochannel*io, void *userdata) {
     pa_pstream *p = userdata;
 
@@ -222,31 +487,29 @@ static void defer_callback(pa_mainloop_api *m, pa_defer_event *e, void*userdata)
 
 static void memimport_release_cb(pa_memimport *i, uint32_t block_id, void *userdata);
 
-pa_pstream *pa_pstream_new(pa_mainloop_api *m, pa_iochannel *io, pa_mempool *pool) {
+static pa_pstream *pstream_new(pa_iochannel *io, pa_mempool *pool) {
     pa_pstream *p;
 
-    pa_assert(m);
-    pa_assert(io);
-    pa_assert(pool);
-
     p = pa_xnew(pa_pstream, 1);
     PA_REFCNT_INIT(p);
     p->io = io;
-    pa_iochannel_set_callback(io, io_callback, p);
     p->dead = FALSE;
 
-    p->mainloop = m;
-    p->defer_event = m->defer_new(m, defer_callback, p);
-    m->defer_enable(p->defer_event, 0);
+    p->mainloop = NULL;
+    p->defer_event = NULL;
 
     p->send_queue = pa_queue_new();
+    p->audio_queue = pa_queue_new();
+    p->n_ordered = 0;
+    p->audio_priority = FALSE;
 
-    p->write.current = NULL;
+    p->write.first = p->write.n_items = 0;
     p->write.index = 0;
-    pa_memchunk_reset(&p->write.memchunk);
-    p->read.memblock = NULL;
     p->read.packet = NULL;
+    p->read.data = NULL;
     p->read.index = 0;
+    p->read.buffer = NULL;
+    p->read.buffer_length = 0;
 
     p->receive_packet_callback = NULL;
     p->receive_packet_callback_userdata = NULL;
@@ -264,21 +527,217 @@ pa_pstream *pa_pstream_new(pa_mainloop_api *m, pa_iochannel *io, pa_mempool *poo
     p->mempool = pool;
 
     p->use_shm = FALSE;
+    p->use_memfd = FALSE;
     p->export = NULL;
+    p->batch_block_ids = FALSE;
+    p->release_batch = p->revoke_batch = NULL;
+    p->large_exports = FALSE;
+    p->registered_memfds = pa_hashmap_new(NULL, NULL);
 
     /* We do importing unconditionally */
     p->import = pa_memimport_new(p->mempool, memimport_release_cb, p);
 
-    pa_iochannel_socket_set_rcvbuf(io, pa_mempool_block_size_max(p->mempool));
-    pa_iochannel_socket_set_sndbuf(io, pa_mempool_block_size_max(p->mempool));
+    p->rcvbuf = p->sndbuf = pa_mempool_block_size_max(p->mempool);
+    pa_iochannel_socket_set_rcvbuf(io, p->rcvbuf);
+    pa_iochannel_socket_set_sndbuf(io, p->sndbuf);
 
 #ifdef HAVE_CREDS
-    p->send_creds_now = FALSE;
     p->read_creds_valid = FALSE;
+    p->n_read_fds = 0;
 #endif
+
+    p->thread_ops = NULL;
+    p->thread = NULL;
+    p->mutex = p->queue_mutex = NULL;
+    pa_atomic_store(&p->kick_pending, 0);
+    pa_atomic_store(&p->n_pending, 0);
+    p->thread_ifd = p->thread_ofd = -1;
+    p->thread_ref = FALSE;
+
     return p;
 }
 
+pa_pstream *pa_pstream_new(pa_mainloop_api *m, pa_iochannel *io, pa_mempool *pool) {
+    pa_pstream *p;
+
+    pa_assert(m);
+    pa_assert(io);
+    pa_assert(pool);
+
+    p = pstream_new(io, pool);
+    pa_iochannel_set_callback(io, io_callback, p);
+
+    p->mainloop = m;
+    p->defer_event = m->defer_new(m, defer_callback, p);
+    m->defer_enable(p->defer_event, 0);
+
+    return p;
+}
+
+static void thread_setup_cb(void *userdata) {
+    pa_pstream *p = userdata;
+
+    p->mainloop = p->thread_ops->get_api(p->thread);
+
+    p->io = pa_iochannel_new(p->mainloop, p->thread_ifd, p->thread_ofd);
+    pa_iochannel_set_callback(p->io, io_callback, p);
+
+    /* Writes out whatever was sent before we got here */
+    p->defer_event = p->mainloop->defer_new(p->mainloop, defer_callback, p);
+}
+
+static void thread_teardown_cb(void *userdata) {
+    thread_teardown(userdata);
+}
+
+static void kick_cb(void *userdata) {
+    pa_pstream *p = userdata;
+
+    pa_atomic_store(&p->kick_pending, 0);
+
+    if (p->defer_event)
+        p->mainloop->defer_enable(p->defer_event, 1);
+}
+
+pa_pstream *pa_pstream_new_threaded(pa_mainloop_api *m, pa_iochannel *io, pa_mempool *pool, const pa_pstream_thread_ops *ops, void *thread) {
+    pa_pstream *p;
+
+    pa_assert(m);
+    pa_assert(io);
+    pa_assert(pool);
+    pa_assert(ops);
+
+    p = pstream_new(io, pool);
+
+    p->thread_ops = ops;
+    p->thread = thread;
+    p->mutex = pa_mutex_new(FALSE, FALSE);
+    p->queue_mutex = pa_mutex_new(FALSE, FALSE);
+
+    /* The io events of the channel belong to m, so it is created anew
+     * in the IO thread */
+    p->thread_ifd = pa_iochannel_get_recv_fd(io);
+    p->thread_ofd = pa_iochannel_get_send_fd(io);
+    pa_iochannel_set_noclose(io, TRUE);
+    pa_iochannel_free(io);
+    p->io = NULL;
+
+    /* Dropped by the IO thread when it is done with the socket */
+    p->thread_ref = TRUE;
+    PA_REFCNT_INC(p);
+
+    ops->call(thread, thread_setup_cb, NULL, p);
+
+    return p;
+}
+
+static pa_bool_t item_is_bulk(struct item_info *i) {
+    return i->type == PA_PSTREAM_ITEM_PACKET && i->packet->length >= BULK_PACKET_SIZE;
+}
+
+/* Called with queue_mutex held */
+static void queue_push_unlocked(pa_pstream *p, struct item_info *i) {
+
+    if (p->audio_priority && i->type != PA_PSTREAM_ITEM_PACKET && p->n_ordered == 0) {
+        pa_queue_push(p->audio_queue, i);
+        return;
+    }
+
+    if (!item_is_bulk(i))
+        p->n_ordered++;
+
+    pa_queue_push(p->send_queue, i);
+}
+
+static void queue_push(pa_pstream *p, struct item_info *i) {
+    if (!p->queue_mutex) {
+        queue_push_unlocked(p, i);
+        return;
+    }
+
+    pa_atomic_inc(&p->n_pending);
+
+    pa_mutex_lock(p->queue_mutex);
+    queue_push_unlocked(p, i);
+    pa_mutex_unlock(p->queue_mutex);
+}
+
+static struct item_info *queue_pop(pa_pstream *p) {
+    struct item_info *i;
+
+    if (p->queue_mutex)
+        pa_mutex_lock(p->queue_mutex);
+
+    if (!(i = pa_queue_pop(p->audio_queue)))
+        if ((i = pa_queue_pop(p->send_queue)) && !item_is_bulk(i))
+            p->n_ordered--;
+
+    /* A batch that is about to be written is closed */
+    if (i && i == p->release_batch)
+        p->release_batch = NULL;
+    else if (i && i == p->revoke_batch)
+        p->revoke_batch = NULL;
+
+    if (p->queue_mutex)
+        pa_mutex_unlock(p->queue_mutex);
+
+    return i;
+}
+
+/* Adds block_id to the open batch of the given type, or queues a new
+ * batch if there is none or it is full */
+static void queue_push_block_id(pa_pstream *p, int type, uint32_t block_id) {
+    struct item_info **batch, *i;
+    pa_bool_t queued = FALSE;
+
+    pa_assert(type == PA_PSTREAM_ITEM_SHMRELEASES || type == PA_PSTREAM_ITEM_SHMREVOKES);
+
+    batch = type == PA_PSTREAM_ITEM_SHMRELEASES ? &p->release_batch : &p->revoke_batch;
+
+    if (p->queue_mutex)
+        pa_mutex_lock(p->queue_mutex);
+
+    if (!(i = *batch) || i->n_block_ids >= BLOCK_IDS_MAX) {
+
+        if (!(i = pa_flist_pop(PA_STATIC_FLIST_GET(items))))
+            i = pa_xnew(struct item_info, 1);
+        i->type = type;
+        i->block_ids = pa_xnew(uint32_t, BLOCK_IDS_MAX);
+        i->n_block_ids = 0;
+#ifdef HAVE_CREDS
+        i->with_creds = FALSE;
+#endif
+
+        if (p->queue_mutex)
+            pa_atomic_inc(&p->n_pending);
+
+        queue_push_unlocked(p, i);
+        *batch = i;
+        queued = TRUE;
+    }
+
+    i->block_ids[i->n_block_ids++] = htonl(block_id);
+
+    if (p->queue_mutex)
+        pa_mutex_unlock(p->queue_mutex);
+
+    /* Only the first block id of a batch needs a wakeup */
+    if (queued)
+        schedule(p);
+}
+
+static void schedule(pa_pstream *p) {
+    if (!p->thread_ops || p->thread_ops->in_thread(p->thread)) {
+        if (p->defer_event)
+            p->mainloop->defer_enable(p->defer_event, 1);
+        return;
+    }
+
+    /* One wakeup in flight is enough for any number of items */
+    if (pa_atomic_cmpxchg(&p->kick_pending, 0, 1))
+        p->thread_ops->call(p->thread, kick_cb, pstream_unref_cb, pa_pstream_ref(p));
+}
+
 static void item_free(void *item) {
     struct item_info *i = item;
     pa_assert(i);
@@ -289,31 +748,60 @@ static void item_free(void *item) {
     } else if (i->type == PA_PSTREAM_ITEM_PACKET) {
         pa_assert(i->packet);
         pa_packet_unref(i->packet);
-    }
+    } else if (i->type == PA_PSTREAM_ITEM_SHMREGISTER)
+        pa_assert_se(pa_close(i->fd) == 0);
+    else if (i->type == PA_PSTREAM_ITEM_SHMRELEASES || i->type == PA_PSTREAM_ITEM_SHMREVOKES)
+        pa_xfree(i->block_ids);
 
     if (pa_flist_push(PA_STATIC_FLIST_GET(items), i) < 0)
         pa_xfree(i);
 }
 
+static void write_item_done(struct write_item *w) {
+    pa_assert(w);
+    pa_assert(w->current);
+
+    item_free(w->current);
+    w->current = NULL;
+
+    if (w->memchunk.memblock)
+        pa_memblock_unref(w->memchunk.memblock);
+
+    pa_memchunk_reset(&w->memchunk);
+}
+
 static void pstream_free(pa_pstream *p) {
+    unsigned k;
+
     pa_assert(p);
 
     pa_pstream_unlink(p);
 
     pa_queue_free(p->send_queue, item_free);
+    pa_queue_free(p->audio_queue, item_free);
 
-    if (p->write.current)
-        item_free(p->write.current);
-
-    if (p->write.memchunk.memblock)
-        pa_memblock_unref(p->write.memchunk.memblock);
+    for (k = 0; k < p->write.n_items; k++)
+        write_item_done(WRITE_ITEM(p, k));
 
-    if (p->read.memblock)
-        pa_memblock_unref(p->read.memblock);
+    if (p->read.buffer)
+        pa_memblock_unref(p->read.buffer);
 
     if (p->read.packet)
         pa_packet_unref(p->read.packet);
 
+#ifdef HAVE_CREDS
+    for (k = 0; k < p->n_read_fds; k++)
+        pa_close(p->read_fds[k]);
+#endif
+
+    pa_hashmap_free(p->registered_memfds, NULL, NULL);
+
+    if (p->mutex)
+        pa_mutex_free(p->mutex);
+
+    if (p->queue_mutex)
+        pa_mutex_free(p->queue_mutex);
+
     pa_xfree(p);
 }
 
@@ -338,9 +826,8 @@ void pa_pstream_send_packet(pa_pstream*p, pa_packet *packet, const pa_creds *cre
         i->creds = *creds;
 #endif
 
-    pa_queue_push(p->send_queue, i);
-
-    p->mainloop->defer_enable(p->defer_event, 1);
+    queue_push(p, i);
+    schedule(p);
 }
 
 void pa_pstream_send_memblock(pa_pstream*p, uint32_t channel, int64_t offset, pa_seek_mode_t seek_mode, const pa_memchunk *chunk) {
@@ -380,13 +867,13 @@ void pa_pstream_send_memblock(pa_pstream*p, uint32_t channel, int64_t offset, pa
         i->with_creds = FALSE;
 #endif
 
-        pa_queue_push(p->send_queue, i);
+        queue_push(p, i);
 
         idx += n;
         length -= n;
     }
 
-    p->mainloop->defer_enable(p->defer_event, 1);
+    schedule(p);
 }
 
 void pa_pstream_send_release(pa_pstream *p, uint32_t block_id) {
@@ -399,6 +886,11 @@ void pa_pstream_send_release(pa_pstream *p, uint32_t block_id) {
 
 /*     pa_log("Releasing block %u", block_id); */
 
+    if (p->batch_block_ids) {
+        queue_push_block_id(p, PA_PSTREAM_ITEM_SHMRELEASES, block_id);
+        return;
+    }
+
     if (!(item = pa_flist_pop(PA_STATIC_FLIST_GET(items))))
         item = pa_xnew(struct item_info, 1);
     item->type = PA_PSTREAM_ITEM_SHMRELEASE;
@@ -407,8 +899,8 @@ void pa_pstream_send_release(pa_pstream *p, uint32_t block_id) {
     item->with_creds = FALSE;
 #endif
 
-    pa_queue_push(p->send_queue, item);
-    p->mainloop->defer_enable(p->defer_event, 1);
+    queue_push(p, item);
+    schedule(p);
 }
 
 /* might be called from thread context */
@@ -436,6 +928,11 @@ void pa_pstream_send_revoke(pa_pstream *p, uint32_t block_id) {
         return;
 /*     pa_log("Revoking block %u", block_id); */
 
+    if (p->batch_block_ids) {
+        queue_push_block_id(p, PA_PSTREAM_ITEM_SHMREVOKES, block_id);
+        return;
+    }
+
     if (!(item = pa_flist_pop(PA_STATIC_FLIST_GET(items))))
         item = pa_xnew(struct item_info, 1);
     item->type = PA_PSTREAM_ITEM_SHMREVOKE;
@@ -444,8 +941,8 @@ void pa_pstream_send_revoke(pa_pstream *p, uint32_t block_id) {
     item->with_creds = FALSE;
 #endif
 
-    pa_queue_push(p->send_queue, item);
-    p->mainloop->defer_enable(p->defer_event, 1);
+    queue_push(p, item);
+    schedule(p);
 }
 
 /* might be called from thread context */
@@ -461,425 +958,653 @@ static void memexport_revoke_cb(pa_memexport *e, uint32_t block_id, void *userda
         pa_pstream_send_revoke(p, block_id);
 }
 
-static void prepare_next_write_item(pa_pstream *p) {
+/* Fills w with a frame telling the other side about a memfd segment,
+ * the fd itself is sent as ancillary data with it */
+static void prepare_register_item(struct write_item *w, uint32_t shm_id, int fd) {
+    pa_assert(w);
+    pa_assert(fd >= 0);
+
+    if (!(w->current = pa_flist_pop(PA_STATIC_FLIST_GET(items))))
+        w->current = pa_xnew(struct item_info, 1);
+
+    w->current->type = PA_PSTREAM_ITEM_SHMREGISTER;
+    w->current->block_id = shm_id;
+    w->current->fd = fd;
+#ifdef HAVE_CREDS
+    w->current->with_creds = FALSE;
+#endif
+
+    w->data = NULL;
+    pa_memchunk_reset(&w->memchunk);
+
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = 0;
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl((uint32_t) -1);
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(shm_id);
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = 0;
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMREGISTER);
+}
+
+/* Takes the next item off the send queue and appends it to the write
+ * ring. A memblock in a memfd segment the other side doesn't know yet
+ * is preceded by a register item, so two free slots are needed. */
+static pa_bool_t prepare_write_item(pa_pstream *p) {
+    struct write_item *w;
+    uint32_t register_shm_id = 0;
+    int register_fd = -1;
+
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
+    pa_assert(p->write.n_items + 2 <= WRITE_ITEMS_MAX);
 
-    p->write.current = pa_queue_pop(p->send_queue);
+    w = WRITE_ITEM(p, p->write.n_items);
 
-    if (!p->write.current)
-        return;
+    if (!(w->current = queue_pop(p)))
+        return FALSE;
 
-    p->write.index = 0;
-    p->write.data = NULL;
-    pa_memchunk_reset(&p->write.memchunk);
+    w->data = NULL;
+    pa_memchunk_reset(&w->memchunk);
+
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = 0;
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl((uint32_t) -1);
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = 0;
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = 0;
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = 0;
+
+    if (w->current->type == PA_PSTREAM_ITEM_PACKET) {
 
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = 0;
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl((uint32_t) -1);
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = 0;
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = 0;
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = 0;
+        pa_assert(w->current->packet);
+        w->data = w->current->packet->data;
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) w->current->packet->length);
 
-    if (p->write.current->type == PA_PSTREAM_ITEM_PACKET) {
+    } else if (w->current->type == PA_PSTREAM_ITEM_SHMRELEASE) {
 
-        pa_assert(p->write.current->packet);
-        p->write.data = p->write.current->packet->data;
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) p->write.current->packet->length);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMRELEASE);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(w->current->block_id);
 
-    } else if (p->write.current->type == PA_PSTREAM_ITEM_SHMRELEASE) {
+    } else if (w->current->type == PA_PSTREAM_ITEM_SHMREVOKE) {
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMRELEASE);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(p->write.current->block_id);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMREVOKE);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(w->current->block_id);
 
-    } else if (p->write.current->type == PA_PSTREAM_ITEM_SHMREVOKE) {
+    } else if (w->current->type == PA_PSTREAM_ITEM_SHMRELEASES || w->current->type == PA_PSTREAM_ITEM_SHMREVOKES) {
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMREVOKE);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(p->write.current->block_id);
+        /* The batch left the send queue, so nothing is added to it anymore */
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMBATCH |
+            (w->current->type == PA_PSTREAM_ITEM_SHMRELEASES ? PA_FLAG_SHMRELEASE : PA_FLAG_SHMREVOKE));
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) (w->current->n_block_ids * sizeof(uint32_t)));
+        w->data = w->current->block_ids;
 
     } else {
         uint32_t flags;
         pa_bool_t send_payload = TRUE;
 
-        pa_assert(p->write.current->type == PA_PSTREAM_ITEM_MEMBLOCK);
-        pa_assert(p->write.current->chunk.memblock);
+        pa_assert(w->current->type == PA_PSTREAM_ITEM_MEMBLOCK);
+        pa_assert(w->current->chunk.memblock);
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl(p->write.current->channel);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl((uint32_t) (((uint64_t) p->write.current->offset) >> 32));
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = htonl((uint32_t) ((uint64_t) p->write.current->offset));
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl(w->current->channel);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl((uint32_t) (((uint64_t) w->current->offset) >> 32));
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = htonl((uint32_t) ((uint64_t) w->current->offset));
 
-        flags = (uint32_t) (p->write.current->seek_mode & PA_FLAG_SEEKMASK);
+        flags = (uint32_t) (w->current->seek_mode & PA_FLAG_SEEKMASK);
 
         if (p->use_shm) {
             uint32_t block_id, shm_id;
             size_t offset, length;
+            int memfd;
 
             pa_assert(p->export);
 
             if (pa_memexport_put(p->export,
-                                 p->write.current->chunk.memblock,
+                                 w->current->chunk.memblock,
                                  &block_id,
                                  &shm_id,
                                  &offset,
-                                 &length) >= 0) {
+                                 &length,
+                                 &memfd) >= 0) {
 
-                flags |= PA_FLAG_SHMDATA;
                 send_payload = FALSE;
 
-                p->write.shm_info[PA_PSTREAM_SHM_BLOCKID] = htonl(block_id);
-                p->write.shm_info[PA_PSTREAM_SHM_SHMID] = htonl(shm_id);
-                p->write.shm_info[PA_PSTREAM_SHM_INDEX] = htonl((uint32_t) (offset + p->write.current->chunk.index));
-                p->write.shm_info[PA_PSTREAM_SHM_LENGTH] = htonl((uint32_t) p->write.current->chunk.length);
+                if (memfd >= 0 && !pa_hashmap_get(p->registered_memfds, PA_UINT32_TO_PTR(shm_id))) {
+
+                    if (p->use_memfd && (register_fd = dup(memfd)) >= 0) {
+                        pa_make_fd_cloexec(register_fd);
+                        register_shm_id = shm_id;
+                        pa_hashmap_put(p->registered_memfds, PA_UINT32_TO_PTR(shm_id), p);
+                    } else {
+                        /* The other side cannot map this segment, so
+                         * take the block back and send it inline */
+                        pa_memexport_cancel(p->export, block_id);
+                        send_payload = TRUE;
+                    }
+                }
+            }
 
-                p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl(sizeof(p->write.shm_info));
-                p->write.data = p->write.shm_info;
+            if (!send_payload) {
+                flags |= PA_FLAG_SHMDATA;
+
+                w->shm_info[PA_PSTREAM_SHM_BLOCKID] = htonl(block_id);
+                w->shm_info[PA_PSTREAM_SHM_SHMID] = htonl(shm_id);
+                w->shm_info[PA_PSTREAM_SHM_INDEX] = htonl((uint32_t) (offset + w->current->chunk.index));
+                w->shm_info[PA_PSTREAM_SHM_LENGTH] = htonl((uint32_t) w->current->chunk.length);
+
+                w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl(sizeof(w->shm_info));
+                w->data = w->shm_info;
             }
 /*             else */
 /*                 pa_log_warn("Failed to export memory block."); */
         }
 
         if (send_payload) {
-            p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) p->write.current->chunk.length);
-            p->write.memchunk = p->write.current->chunk;
-            pa_memblock_ref(p->write.memchunk.memblock);
-            p->write.data = NULL;
+            w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) w->current->chunk.length);
+            w->memchunk = w->current->chunk;
+            pa_memblock_ref(w->memchunk.memblock);
+            w->data = NULL;
         }
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(flags);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(flags);
+    }
+
+    p->write.n_items++;
+
+    if (register_fd >= 0) {
+        struct write_item *m = WRITE_ITEM(p, p->write.n_items);
+
+        /* Move the memblock one slot up, the segment needs to be
+         * registered first */
+        *m = *w;
+        m->data = m->shm_info;
+
+        prepare_register_item(w, register_shm_id, register_fd);
+        p->write.n_items++;
     }
 
+    return TRUE;
+}
+
+/* Credentials and fds are attached to a whole write */
+static pa_bool_t write_item_has_ancil(struct write_item *w) {
+    pa_assert(w);
+
+    if (w->current->type == PA_PSTREAM_ITEM_SHMREGISTER)
+        return TRUE;
+
 #ifdef HAVE_CREDS
-    if ((p->send_creds_now = p->write.current->with_creds))
-        p->write_creds = p->write.current->creds;
+    return w->current->with_creds;
+#else
+    return FALSE;
 #endif
 }
 
 static int do_write(pa_pstream *p) {
-    void *d;
-    size_t l;
+    struct iovec iov[2 * WRITE_ITEMS_MAX];
+    pa_memblock *release_memblocks[WRITE_ITEMS_MAX];
+    unsigned n_iov = 0, n_release = 0, k;
+    size_t index;
     ssize_t r;
-    pa_memblock *release_memblock = NULL;
+    pa_bool_t completed = FALSE;
 
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
 
-    if (!p->write.current)
-        prepare_next_write_item(p);
+    while (p->write.n_items + 2 <= WRITE_ITEMS_MAX && prepare_write_item(p))
+        ;
 
-    if (!p->write.current)
+    if (p->write.n_items <= 0)
         return 0;
 
-    if (p->write.index < PA_PSTREAM_DESCRIPTOR_SIZE) {
-        d = (uint8_t*) p->write.descriptor + p->write.index;
-        l = PA_PSTREAM_DESCRIPTOR_SIZE - p->write.index;
-    } else {
-        pa_assert(p->write.data || p->write.memchunk.memblock);
+    /* Gather descriptors and payloads of as many items as possible.
+     * Credentials and fds are attached to a whole write, hence items
+     * carrying them are never combined with others. */
+    index = p->write.index;
+
+    for (k = 0; k < p->write.n_items; k++) {
+        struct write_item *w = WRITE_ITEM(p, k);
+        size_t length = ntohl(w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]);
 
-        if (p->write.data)
-            d = p->write.data;
-        else {
-            d = (uint8_t*) pa_memblock_acquire(p->write.memchunk.memblock) + p->write.memchunk.index;
-            release_memblock = p->write.memchunk.memblock;
+        if (k > 0 && (write_item_has_ancil(w) || write_item_has_ancil(WRITE_ITEM(p, 0))))
+            break;
+
+        if (index < PA_PSTREAM_DESCRIPTOR_SIZE) {
+            iov[n_iov].iov_base = (uint8_t*) w->descriptor + index;
+            iov[n_iov].iov_len = PA_PSTREAM_DESCRIPTOR_SIZE - index;
+            n_iov++;
+            index = PA_PSTREAM_DESCRIPTOR_SIZE;
         }
 
-        d = (uint8_t*) d + p->write.index - PA_PSTREAM_DESCRIPTOR_SIZE;
-        l = ntohl(p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]) - (p->write.index - PA_PSTREAM_DESCRIPTOR_SIZE);
-    }
+        if (length > 0) {
+            void *d;
 
-    pa_assert(l > 0);
+            pa_assert(w->data || w->memchunk.memblock);
 
-#ifdef HAVE_CREDS
-    if (p->send_creds_now) {
+            if (w->data)
+                d = w->data;
+            else {
+                d = (uint8_t*) pa_memblock_acquire(w->memchunk.memblock) + w->memchunk.index;
+                release_memblocks[n_release++] = w->memchunk.memblock;
+            }
 
-        if ((r = pa_iochannel_write_with_creds(p->io, d, l, &p->write_creds)) < 0)
-            goto fail;
+            iov[n_iov].iov_base = (uint8_t*) d + index - PA_PSTREAM_DESCRIPTOR_SIZE;
+            iov[n_iov].iov_len = length - (index - PA_PSTREAM_DESCRIPTOR_SIZE);
+            n_iov++;
+        }
+
+        index = 0;
+    }
 
-        p->send_creds_now = FALSE;
-    } else
+    pa_assert(n_iov > 0);
+
+#ifdef HAVE_CREDS
+    if (p->write.index == 0 && WRITE_ITEM(p, 0)->current->type == PA_PSTREAM_ITEM_SHMREGISTER)
+        r = pa_iochannel_writev_with_fds(p->io, iov, n_iov, &WRITE_ITEM(p, 0)->current->fd, 1);
+    else if (p->write.index == 0 && write_item_has_ancil(WRITE_ITEM(p, 0)))
+        r = pa_iochannel_writev_with_creds(p->io, iov, n_iov, &WRITE_ITEM(p, 0)->current->creds);
+    else
 #endif
+        r = pa_iochannel_writev(p->io, iov, n_iov);
 
-    if ((r = pa_iochannel_write(p->io, d, l)) < 0)
-        goto fail;
+    for (k = 0; k < n_release; k++)
+        pa_memblock_release(release_memblocks[k]);
 
-    if (release_memblock)
-        pa_memblock_release(release_memblock);
+    if (r < 0)
+        return -1;
 
     p->write.index += (size_t) r;
 
-    if (p->write.index >= PA_PSTREAM_DESCRIPTOR_SIZE + ntohl(p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH])) {
-        pa_assert(p->write.current);
-        item_free(p->write.current);
-        p->write.current = NULL;
+    /* Retire everything that has been written completely */
+    while (p->write.n_items > 0) {
+        struct write_item *w = WRITE_ITEM(p, 0);
+        size_t total = PA_PSTREAM_DESCRIPTOR_SIZE + ntohl(w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]);
+
+        if (p->write.index < total)
+            break;
+
+        p->write.index -= total;
+
+        if (p->thread_ops && w->current->type != PA_PSTREAM_ITEM_SHMREGISTER)
+            pa_atomic_dec(&p->n_pending);
+
+        write_item_done(w);
 
-        if (p->write.memchunk.memblock)
-            pa_memblock_unref(p->write.memchunk.memblock);
+        p->write.first = (p->write.first + 1) % WRITE_ITEMS_MAX;
+        p->write.n_items--;
 
-        pa_memchunk_reset(&p->write.memchunk);
+        completed = TRUE;
+    }
 
-        if (p->drain_callback && !pa_pstream_is_pending(p))
+    if (completed && !pa_pstream_is_pending(p)) {
+        if (p->thread_ops)
+            event_post(p, event_new(p, EVENT_DRAIN));
+        else if (p->drain_callback)
             p->drain_callback(p, p->drain_callback_userdata);
     }
 
     return 0;
+}
 
-fail:
+static void read_frame_done(pa_pstream *p) {
+    pa_assert(p);
 
-    if (release_memblock)
-        pa_memblock_release(release_memblock);
+    p->read.packet = NULL;
+    p->read.index = 0;
+    p->read.data = NULL;
 
-    return -1;
+#ifdef HAVE_CREDS
+    p->read_creds_valid = FALSE;
+#endif
 }
 
-static int do_read(pa_pstream *p) {
-    void *d;
-    size_t l;
-    ssize_t r;
-    pa_memblock *release_memblock = NULL;
-    pa_assert(p);
-    pa_assert(PA_REFCNT_VALUE(p) > 0);
+/* Called when the descriptor of a frame has been read completely */
+static int read_descriptor_done(pa_pstream *p) {
+    uint32_t flags, length, channel;
 
-    if (p->read.index < PA_PSTREAM_DESCRIPTOR_SIZE) {
-        d = (uint8_t*) p->read.descriptor + p->read.index;
-        l = PA_PSTREAM_DESCRIPTOR_SIZE - p->read.index;
-    } else {
-        pa_assert(p->read.data || p->read.memblock);
+    pa_assert(p);
 
-        if (p->read.data)
-            d = p->read.data;
-        else {
-            d = pa_memblock_acquire(p->read.memblock);
-            release_memblock = p->read.memblock;
-        }
+    flags = ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS]);
 
-        d = (uint8_t*) d + p->read.index - PA_PSTREAM_DESCRIPTOR_SIZE;
-        l = ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]) - (p->read.index - PA_PSTREAM_DESCRIPTOR_SIZE);
+    if (!p->use_shm && (flags & PA_FLAG_SHMMASK) != 0) {
+        pa_log_warn("Received SHM frame on a socket where SHM is disabled.");
+        return -1;
     }
 
-#ifdef HAVE_CREDS
-    {
-        pa_bool_t b = 0;
+    if (flags == PA_FLAG_SHMRELEASE) {
 
-        if ((r = pa_iochannel_read_with_creds(p->io, d, l, &p->read_creds, &b)) <= 0)
-            goto fail;
+        /* This is a SHM memblock release frame with no payload */
 
-        p->read_creds_valid = p->read_creds_valid || b;
-    }
-#else
-    if ((r = pa_iochannel_read(p->io, d, l)) <= 0)
-        goto fail;
-#endif
+/*         pa_log("Got release frame for %u", ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI])); */
 
-    if (release_memblock)
-        pa_memblock_release(release_memblock);
+        pa_assert(p->export);
+        pa_memexport_process_release(p->export, ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI]));
 
-    p->read.index += (size_t) r;
+        read_frame_done(p);
+        return 0;
 
-    if (p->read.index == PA_PSTREAM_DESCRIPTOR_SIZE) {
-        uint32_t flags, length, channel;
-        /* Reading of frame descriptor complete */
+    } else if (flags == PA_FLAG_SHMREVOKE) {
 
-        flags = ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS]);
+        /* This is a SHM memblock revoke frame with no payload */
+
+/*         pa_log("Got revoke frame for %u", ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI])); */
 
-        if (!p->use_shm && (flags & PA_FLAG_SHMMASK) != 0) {
-            pa_log_warn("Received SHM frame on a socket where SHM is disabled.");
+        pa_assert(p->import);
+        pa_memimport_process_revoke(p->import, ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI]));
+
+        read_frame_done(p);
+        return 0;
+
+    } else if (flags == (PA_FLAG_SHMRELEASE|PA_FLAG_SHMBATCH) || flags == (PA_FLAG_SHMREVOKE|PA_FLAG_SHMBATCH)) {
+
+        /* This is a frame with a list of block ids to release resp.
+         * revoke as payload */
+
+        length = ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]);
+
+        if (length <= 0 || length > sizeof(p->read.block_ids) || length % sizeof(uint32_t) != 0) {
+            pa_log_warn("Received batched release or revoke frame with invalid size: %lu", (unsigned long) length);
             return -1;
         }
 
-        if (flags == PA_FLAG_SHMRELEASE) {
+        p->read.data = p->read.block_ids;
+        return 0;
 
-            /* This is a SHM memblock release frame with no payload */
+    } else if (flags == PA_FLAG_SHMREGISTER) {
+#ifdef HAVE_CREDS
+        int fd;
 
-/*             pa_log("Got release frame for %u", ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI])); */
+        /* This is a memfd register frame, the fd came along with it */
 
-            pa_assert(p->export);
-            pa_memexport_process_release(p->export, ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI]));
+        if (!p->use_memfd || p->n_read_fds <= 0) {
+            pa_log_warn("Received memfd register frame without a memfd.");
+            return -1;
+        }
 
-            goto frame_done;
+        fd = p->read_fds[0];
+        memmove(p->read_fds, p->read_fds + 1, --p->n_read_fds * sizeof(int));
 
-        } else if (flags == PA_FLAG_SHMREVOKE) {
+        pa_assert(p->import);
+        if (pa_memimport_attach_memfd(p->import, ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI]), fd) < 0)
+            pa_log_debug("Failed to attach memfd segment.");
 
-            /* This is a SHM memblock revoke frame with no payload */
+        read_frame_done(p);
+        return 0;
+#else
+        pa_log_warn("Received memfd register frame on a socket without fd passing.");
+        return -1;
+#endif
+    }
 
-/*             pa_log("Got revoke frame for %u", ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI])); */
+    length = ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]);
 
-            pa_assert(p->import);
-            pa_memimport_process_revoke(p->import, ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI]));
+    if (length > FRAME_SIZE_MAX_ALLOW || length <= 0) {
+        pa_log_warn("Received invalid frame size: %lu", (unsigned long) length);
+        return -1;
+    }
 
-            goto frame_done;
-        }
+    pa_assert(!p->read.packet && !p->read.data);
 
-        length = ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]);
+    channel = ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL]);
+
+    if (channel == (uint32_t) -1) {
 
-        if (length > FRAME_SIZE_MAX_ALLOW || length <= 0) {
-            pa_log_warn("Received invalid frame size: %lu", (unsigned long) length);
+        if (flags != 0) {
+            pa_log_warn("Received packet frame with invalid flags value.");
             return -1;
         }
 
-        pa_assert(!p->read.packet && !p->read.memblock);
+        /* Frame is a packet frame */
+        p->read.packet = pa_packet_new(length);
+        p->read.data = p->read.packet->data;
 
-        channel = ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL]);
+    } else {
+
+        if ((flags & PA_FLAG_SEEKMASK) > PA_SEEK_RELATIVE_END) {
+            pa_log_warn("Received memblock frame with invalid seek mode.");
+            return -1;
+        }
 
-        if (channel == (uint32_t) -1) {
+        if ((flags & PA_FLAG_SHMMASK) == PA_FLAG_SHMDATA) {
 
-            if (flags != 0) {
-                pa_log_warn("Received packet frame with invalid flags value.");
+            if (length != sizeof(p->read.shm_info)) {
+                pa_log_warn("Received SHM memblock frame with Invalid frame length.");
                 return -1;
             }
 
-            /* Frame is a packet frame */
-            p->read.packet = pa_packet_new(length);
-            p->read.data = p->read.packet->data;
+            /* Frame is a memblock frame referencing an SHM memblock */
+            p->read.data = p->read.shm_info;
 
-        } else {
+        } else if ((flags & PA_FLAG_SHMMASK) != 0) {
 
-            if ((flags & PA_FLAG_SEEKMASK) > PA_SEEK_RELATIVE_END) {
-                pa_log_warn("Received memblock frame with invalid seek mode.");
-                return -1;
-            }
+            pa_log_warn("Received memblock frame with invalid flags value.");
+            return -1;
+        }
 
-            if ((flags & PA_FLAG_SHMMASK) == PA_FLAG_SHMDATA) {
+        /* Otherwise the frame is a memblock frame, its data is passed
+         * on straight from the read buffer */
+    }
 
-                if (length != sizeof(p->read.shm_info)) {
-                    pa_log_warn("Received SHM memblock frame with Invalid frame length.");
-                    return -1;
-                }
+    return 0;
+}
 
-                /* Frame is a memblock frame referencing an SHM memblock */
-                p->read.data = p->read.shm_info;
+/* Called when the payload of a frame has been read completely */
+static void read_payload_done(pa_pstream *p) {
+    pa_assert(p);
 
-            } else if ((flags & PA_FLAG_SHMMASK) == 0) {
+    if (p->read.packet) {
 
-                /* Frame is a memblock frame */
+#ifdef HAVE_CREDS
+        deliver_packet(p, p->read.packet, p->read_creds_valid ? &p->read_creds : NULL);
+#else
+        deliver_packet(p, p->read.packet, NULL);
+#endif
 
-                p->read.memblock = pa_memblock_new(p->mempool, length);
-                p->read.data = NULL;
-            } else {
+        pa_packet_unref(p->read.packet);
 
-                pa_log_warn("Received memblock frame with invalid flags value.");
-                return -1;
-            }
+    } else if (p->read.data == p->read.block_ids) {
+        uint32_t flags;
+        unsigned k, n;
+
+        flags = ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS]);
+        n = ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]) / sizeof(uint32_t);
+
+        if ((flags & ~PA_FLAG_SHMBATCH) == PA_FLAG_SHMREVOKE) {
+            pa_assert(p->import);
+
+            for (k = 0; k < n; k++)
+                pa_memimport_process_revoke(p->import, ntohl(p->read.block_ids[k]));
+        } else {
+            pa_assert(p->export);
+
+            for (k = 0; k < n; k++)
+                pa_memexport_process_release(p->export, ntohl(p->read.block_ids[k]));
         }
 
-    } else if (p->read.index > PA_PSTREAM_DESCRIPTOR_SIZE) {
-        /* Frame payload available */
+    } else if (p->read.data) {
+        pa_memblock *b;
 
-        if (p->read.memblock && p->receive_memblock_callback) {
+        pa_assert(p->read.data == p->read.shm_info);
+        pa_assert((ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS]) & PA_FLAG_SHMMASK) == PA_FLAG_SHMDATA);
 
-            /* Is this memblock data? Than pass it to the user */
-            l = (p->read.index - (size_t) r) < PA_PSTREAM_DESCRIPTOR_SIZE ? (size_t) (p->read.index - PA_PSTREAM_DESCRIPTOR_SIZE) : (size_t) r;
+        pa_assert(p->import);
 
-            if (l > 0) {
-                pa_memchunk chunk;
+        if (!(b = pa_memimport_get(p->import,
+                                  ntohl(p->read.shm_info[PA_PSTREAM_SHM_BLOCKID]),
+                                  ntohl(p->read.shm_info[PA_PSTREAM_SHM_SHMID]),
+                                  ntohl(p->read.shm_info[PA_PSTREAM_SHM_INDEX]),
+                                  ntohl(p->read.shm_info[PA_PSTREAM_SHM_LENGTH])))) {
 
-                chunk.memblock = p->read.memblock;
-                chunk.index = p->read.index - PA_PSTREAM_DESCRIPTOR_SIZE - l;
-                chunk.length = l;
+            if (pa_log_ratelimit(PA_LOG_DEBUG))
+                pa_log_debug("Failed to import memory block.");
+        }
 
-                if (p->receive_memblock_callback) {
-                    int64_t offset;
+        if (wants_memblocks(p)) {
+            int64_t offset;
+            pa_memchunk chunk;
 
-                    offset = (int64_t) (
-                            (((uint64_t) ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI])) << 32) |
-                            (((uint64_t) ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO]))));
+            chunk.memblock = b;
+            chunk.index = 0;
+            chunk.length = b ? pa_memblock_get_length(b) : ntohl(p->read.shm_info[PA_PSTREAM_SHM_LENGTH]);
 
-                    p->receive_memblock_callback(
-                        p,
-                        ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL]),
-                        offset,
-                        ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS]) & PA_FLAG_SEEKMASK,
-                        &chunk,
-                        p->receive_memblock_callback_userdata);
-                }
+            offset = (int64_t) (
+                    (((uint64_t) ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI])) << 32) |
+                    (((uint64_t) ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO]))));
 
-                /* Drop seek info for following callbacks */
-                p->read.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] =
-                    p->read.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] =
-                    p->read.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = 0;
-            }
+            deliver_memblock(
+                    p,
+                    ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL]),
+                    offset,
+                    ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS]) & PA_FLAG_SEEKMASK,
+                    &chunk);
         }
 
-        /* Frame complete */
-        if (p->read.index >= ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]) + PA_PSTREAM_DESCRIPTOR_SIZE) {
+        if (b)
+            pa_memblock_unref(b);
+    }
+
+    read_frame_done(p);
+}
+
+/* Consumes up to length bytes at index in the read buffer b for the
+ * frame currently being read. Returns the number of bytes consumed,
+ * which is never 0, or -1 on error. */
+static ssize_t read_frame(pa_pstream *p, pa_memblock *b, size_t index, size_t length) {
+    const uint8_t *s;
+    size_t l, frame_length;
+
+    pa_assert(p);
+    pa_assert(b);
+    pa_assert(length > 0);
+
+    if (p->read.index < PA_PSTREAM_DESCRIPTOR_SIZE) {
+        l = PA_MIN(length, PA_PSTREAM_DESCRIPTOR_SIZE - p->read.index);
+
+        s = (const uint8_t*) pa_memblock_acquire(b) + index;
+        memcpy((uint8_t*) p->read.descriptor + p->read.index, s, l);
+        pa_memblock_release(b);
+
+        p->read.index += l;
+
+        /* Reading of frame descriptor complete */
+        if (p->read.index == PA_PSTREAM_DESCRIPTOR_SIZE && read_descriptor_done(p) < 0)
+            return -1;
+
+        return (ssize_t) l;
+    }
+
+    frame_length = ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]);
+    l = PA_MIN(length, frame_length - (p->read.index - PA_PSTREAM_DESCRIPTOR_SIZE));
+
+    if (p->read.data) {
+
+        s = (const uint8_t*) pa_memblock_acquire(b) + index;
+        memcpy((uint8_t*) p->read.data + p->read.index - PA_PSTREAM_DESCRIPTOR_SIZE, s, l);
+        pa_memblock_release(b);
 
-            if (p->read.memblock) {
+    } else if (wants_memblocks(p)) {
+        int64_t offset;
+        pa_memchunk chunk;
 
-                /* This was a memblock frame. We can unref the memblock now */
-                pa_memblock_unref(p->read.memblock);
+        /* This is memblock data, pass it to the user without copying */
+        chunk.memblock = b;
+        chunk.index = index;
+        chunk.length = l;
 
-            } else if (p->read.packet) {
+        offset = (int64_t) (
+                (((uint64_t) ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI])) << 32) |
+                (((uint64_t) ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO]))));
 
-                if (p->receive_packet_callback)
+        deliver_memblock(
+            p,
+            ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL]),
+            offset,
+            ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS]) & PA_FLAG_SEEKMASK,
+            &chunk);
+
+        /* Drop seek info for following callbacks */
+        p->read.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] =
+            p->read.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] =
+            p->read.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = 0;
+    }
+
+    p->read.index += l;
+
+    /* Frame complete */
+    if (p->read.index >= frame_length + PA_PSTREAM_DESCRIPTOR_SIZE)
+        read_payload_done(p);
+
+    return (ssize_t) l;
+}
+
+static int do_read(pa_pstream *p) {
+    pa_memblock *b;
+    void *d;
+    size_t index, end;
+    ssize_t r;
 #ifdef HAVE_CREDS
-                    p->receive_packet_callback(p, p->read.packet, p->read_creds_valid ? &p->read_creds : NULL, p->receive_packet_callback_userdata);
-#else
-                    p->receive_packet_callback(p, p->read.packet, NULL, p->receive_packet_callback_userdata);
+    pa_bool_t creds = FALSE;
 #endif
 
-                pa_packet_unref(p->read.packet);
-            } else {
-                pa_memblock *b;
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
 
-                pa_assert((ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS]) & PA_FLAG_SHMMASK) == PA_FLAG_SHMDATA);
+    if (p->read.buffer && p->read.buffer_length >= pa_memblock_get_length(p->read.buffer)) {
+        pa_memblock_unref(p->read.buffer);
+        p->read.buffer = NULL;
+    }
 
-                pa_assert(p->import);
+    if (!p->read.buffer) {
+        p->read.buffer = pa_memblock_new(p->mempool, (size_t) -1);
+        p->read.buffer_length = 0;
+    }
 
-                if (!(b = pa_memimport_get(p->import,
-                                          ntohl(p->read.shm_info[PA_PSTREAM_SHM_BLOCKID]),
-                                          ntohl(p->read.shm_info[PA_PSTREAM_SHM_SHMID]),
-                                          ntohl(p->read.shm_info[PA_PSTREAM_SHM_INDEX]),
-                                          ntohl(p->read.shm_info[PA_PSTREAM_SHM_LENGTH])))) {
+    /* The callbacks might replace the buffer, so keep our own reference */
+    b = pa_memblock_ref(p->read.buffer);
+    index = p->read.buffer_length;
 
-                    if (pa_log_ratelimit(PA_LOG_DEBUG))
-                        pa_log_debug("Failed to import memory block.");
-                }
+    d = (uint8_t*) pa_memblock_acquire(b) + index;
 
-                if (p->receive_memblock_callback) {
-                    int64_t offset;
-                    pa_memchunk chunk;
-
-                    chunk.memblock = b;
-                    chunk.index = 0;
-                    chunk.length = b ? pa_memblock_get_length(b) : ntohl(p->read.shm_info[PA_PSTREAM_SHM_LENGTH]);
-
-                    offset = (int64_t) (
-                            (((uint64_t) ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI])) << 32) |
-                            (((uint64_t) ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO]))));
-
-                    p->receive_memblock_callback(
-                            p,
-                            ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL]),
-                            offset,
-                            ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS]) & PA_FLAG_SEEKMASK,
-                            &chunk,
-                            p->receive_memblock_callback_userdata);
-                }
+#ifdef HAVE_CREDS
+    {
+        unsigned n_fds = PA_IOCHANNEL_FDS_MAX - p->n_read_fds;
 
-                if (b)
-                    pa_memblock_unref(b);
-            }
+        if ((r = pa_iochannel_read_with_creds(p->io, d, pa_memblock_get_length(b) - index, &p->read_creds, &creds, p->read_fds + p->n_read_fds, &n_fds)) > 0)
+            p->n_read_fds += n_fds;
+    }
+#else
+    r = pa_iochannel_read(p->io, d, pa_memblock_get_length(b) - index);
+#endif
 
-            goto frame_done;
-        }
+    pa_memblock_release(b);
+
+    if (r <= 0) {
+        pa_memblock_unref(b);
+        return -1;
     }
 
-    return 0;
+    end = index + (size_t) r;
+    p->read.buffer_length = end;
 
-frame_done:
-    p->read.memblock = NULL;
-    p->read.packet = NULL;
-    p->read.index = 0;
-    p->read.data = NULL;
+    /* A single read usually covers several frames */
+    while (index < end && !p->dead) {
+        ssize_t l;
 
 #ifdef HAVE_CREDS
-    p->read_creds_valid = FALSE;
+        p->read_creds_valid = p->read_creds_valid || creds;
 #endif
 
-    return 0;
+        if ((l = read_frame(p, b, index, end - index)) < 0) {
+            pa_memblock_unref(b);
+            return -1;
+        }
 
-fail:
-    if (release_memblock)
-        pa_memblock_release(release_memblock);
+        index += (size_t) l;
+    }
+
+    pa_memblock_unref(b);
 
-    return -1;
+    /* If nobody kept a reference to the data, we can start over at the
+     * beginning of the buffer */
+    if (p->read.buffer == b && pa_memblock_ref_is_one(b))
+        p->read.buffer_length = 0;
+
+    return 0;
 }
 
 void pa_pstream_set_die_callback(pa_pstream *p, pa_pstream_notify_cb_t cb, void *userdata) {
@@ -938,8 +1663,10 @@ pa_bool_t pa_pstream_is_pending(pa_pstream *p) {
 
     if (p->dead)
         b = FALSE;
+    else if (p->thread_ops)
+        b = pa_atomic_load(&p->n_pending) > 0;
     else
-        b = p->write.current || !pa_queue_isempty(p->send_queue);
+        b = p->write.n_items > 0 || !pa_queue_isempty(p->send_queue) || !pa_queue_isempty(p->audio_queue);
 
     return b;
 }
@@ -966,6 +1693,8 @@ void pa_pstream_unlink(pa_pstream *p) {
     if (p->dead)
         return;
 
+    lock(p);
+
     p->dead = TRUE;
 
     if (p->import) {
@@ -978,32 +1707,52 @@ void pa_pstream_unlink(pa_pstream *p) {
         p->export = NULL;
     }
 
-    if (p->io) {
-        pa_iochannel_free(p->io);
-        p->io = NULL;
-    }
+    if (!p->thread_ops) {
+        if (p->io) {
+            pa_iochannel_free(p->io);
+            p->io = NULL;
+        }
 
-    if (p->defer_event) {
-        p->mainloop->defer_free(p->defer_event);
-        p->defer_event = NULL;
+        if (p->defer_event) {
+            p->mainloop->defer_free(p->defer_event);
+            p->defer_event = NULL;
+        }
     }
 
     p->die_callback = NULL;
     p->drain_callback = NULL;
     p->receive_packet_callback = NULL;
     p->receive_memblock_callback = NULL;
+
+    unlock(p);
+
+    /* The socket belongs to the IO thread. From pstream_free() the
+     * thread is done with it already. */
+    if (p->thread_ops && PA_REFCNT_VALUE(p) > 0)
+        p->thread_ops->call(p->thread, thread_teardown_cb, pstream_unref_cb, pa_pstream_ref(p));
+}
+
+static pa_memexport *export_new(pa_pstream *p) {
+    pa_memexport *e;
+
+    if ((e = pa_memexport_new(p->mempool, memexport_revoke_cb, p)) && p->large_exports)
+        pa_memexport_set_max_blocks(e, PA_MEMIMPORT_BLOCKS_MAX);
+
+    return e;
 }
 
 void pa_pstream_enable_shm(pa_pstream *p, pa_bool_t enable) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
 
+    lock(p);
+
     p->use_shm = enable;
 
     if (enable) {
 
         if (!p->export)
-            p->export = pa_memexport_new(p->mempool, memexport_revoke_cb, p);
+            p->export = export_new(p);
 
     } else {
 
@@ -1012,6 +1761,8 @@ void pa_pstream_enable_shm(pa_pstream *p, pa_bool_t enable) {
             p->export = NULL;
         }
     }
+
+    unlock(p);
 }
 
 pa_bool_t pa_pstream_get_shm(pa_pstream *p) {
@@ -1020,3 +1771,117 @@ pa_bool_t pa_pstream_get_shm(pa_pstream *p) {
 
     return p->use_shm;
 }
+
+void pa_pstream_enable_memfd(pa_pstream *p, pa_bool_t enable) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+#ifdef HAVE_CREDS
+    lock(p);
+    p->use_memfd = enable;
+    unlock(p);
+#else
+    pa_assert(!enable);
+#endif
+}
+
+pa_bool_t pa_pstream_get_memfd(pa_pstream *p) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+    return p->use_memfd;
+}
+
+void pa_pstream_enable_batching(pa_pstream *p, pa_bool_t enable) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+    if (p->queue_mutex)
+        pa_mutex_lock(p->queue_mutex);
+
+    p->batch_block_ids = enable;
+
+    /* Whatever is queued already goes out as it is */
+    p->release_batch = p->revoke_batch = NULL;
+
+    if (p->queue_mutex)
+        pa_mutex_unlock(p->queue_mutex);
+}
+
+void pa_pstream_enable_audio_priority(pa_pstream *p, pa_bool_t enable) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+    if (p->queue_mutex)
+        pa_mutex_lock(p->queue_mutex);
+
+    /* What is in audio_queue still goes out first */
+    p->audio_priority = enable;
+
+    if (p->queue_mutex)
+        pa_mutex_unlock(p->queue_mutex);
+}
+
+void pa_pstream_grow_socket_buffers(pa_pstream *p, size_t rcvbuf, size_t sndbuf) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+    if (p->dead)
+        return;
+
+    lock(p);
+
+    if (p->io) {
+        if (rcvbuf > p->rcvbuf && pa_iochannel_socket_set_rcvbuf(p->io, rcvbuf) >= 0)
+            p->rcvbuf = rcvbuf;
+
+        if (sndbuf > p->sndbuf && pa_iochannel_socket_set_sndbuf(p->io, sndbuf) >= 0)
+            p->sndbuf = sndbuf;
+    }
+
+    unlock(p);
+}
+
+void pa_pstream_enable_large_exports(pa_pstream *p, pa_bool_t enable) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+    lock(p);
+
+    p->large_exports = enable;
+
+    if (p->export)
+        pa_memexport_set_max_blocks(p->export, enable ? PA_MEMIMPORT_BLOCKS_MAX : PA_MEMEXPORT_BLOCKS_DEFAULT);
+
+    unlock(p);
+}
+
+void pa_pstream_set_mempool(pa_pstream *p, pa_mempool *pool) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+    pa_assert(pool);
+
+    if (p->dead)
+        return;
+
+    lock(p);
+
+    p->mempool = pool;
+
+    /* Read into a block of the new pool from now on. do_read() holds
+     * its own reference to the old one while it is still in use. */
+    if (p->read.buffer) {
+        pa_memblock_unref(p->read.buffer);
+        p->read.buffer = NULL;
+    }
+
+    pa_memimport_free(p->import);
+    p->import = pa_memimport_new(p->mempool, memimport_release_cb, p);
+
+    if (p->export) {
+        pa_memexport_free(p->export);
+        p->export = export_new(p);
+    }
+
+    unlock(p);
+}
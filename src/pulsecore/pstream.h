@@ -44,6 +44,22 @@ typedef void (*pa_pstream_block_id_cb_t)(pa_pstream *p, uint32_t block_id, void
 
 pa_pstream* pa_pstream_new(pa_mainloop_api *m, pa_iochannel *io, pa_mempool *p);
 
+/* How a pstream reaches the thread its socket IO runs in, and gets
+ * back to the main loop from there. Calls are run in the order they
+ * were queued, and free_cb is called after them or instead of them if
+ * they are dropped. */
+typedef struct pa_pstream_thread_ops {
+    pa_mainloop_api* (*get_api)(void *thread);
+    pa_bool_t (*in_thread)(void *thread);
+    void (*call)(void *thread, pa_free_cb_t cb, pa_free_cb_t free_cb, void *userdata);
+    void (*call_main)(void *thread, pa_free_cb_t cb, pa_free_cb_t free_cb, void *userdata);
+} pa_pstream_thread_ops;
+
+/* Like pa_pstream_new(), but io is moved to the given thread, which
+ * does all reading, writing and framing. The callbacks are still
+ * called from m. io must not be used by the caller afterwards. */
+pa_pstream* pa_pstream_new_threaded(pa_mainloop_api *m, pa_iochannel *io, pa_mempool *p, const pa_pstream_thread_ops *ops, void *thread);
+
 pa_pstream* pa_pstream_ref(pa_pstream*p);
 void pa_pstream_unref(pa_pstream*p);
 
@@ -66,4 +82,32 @@ pa_bool_t pa_pstream_is_pending(pa_pstream *p);
 void pa_pstream_enable_shm(pa_pstream *p, pa_bool_t enable);
 pa_bool_t pa_pstream_get_shm(pa_pstream *p);
 
+/* Pass memfd segments as fds instead of relying on the other side
+ * being able to open them by name. Requires SHM to be enabled. */
+void pa_pstream_enable_memfd(pa_pstream *p, pa_bool_t enable);
+pa_bool_t pa_pstream_get_memfd(pa_pstream *p);
+
+/* Send releases and revokes of SHM blocks together in one frame as
+ * far as possible, instead of one frame per block. The other side must
+ * understand protocol version 34 for this. */
+void pa_pstream_enable_batching(pa_pstream *p, pa_bool_t enable);
+
+/* Let memblocks and SHM releases overtake large packets that are
+ * still queued, so that audio does not wait behind introspection
+ * replies on slow connections. Small packets are never overtaken. */
+void pa_pstream_enable_audio_priority(pa_pstream *p, pa_bool_t enable);
+
+/* Make the socket buffers at least this large, they are never shrunk.
+ * 0 leaves a buffer as it is. */
+void pa_pstream_grow_socket_buffers(pa_pstream *p, size_t rcvbuf, size_t sndbuf);
+
+/* Hand out as many SHM blocks at a time as the other side may import,
+ * instead of the 128 that versions before protocol version 35 could
+ * take. */
+void pa_pstream_enable_large_exports(pa_pstream *p, pa_bool_t enable);
+
+/* Switch to a different pool, must happen before any memblocks have
+ * been exchanged */
+void pa_pstream_set_mempool(pa_pstream *p, pa_mempool *pool);
+
 #endif
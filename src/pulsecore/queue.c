@@ -24,30 +24,28 @@
 #endif
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <pulse/xmalloc.h>
 #include <pulsecore/macro.h>
-#include <pulsecore/flist.h>
 
 #include "queue.h"
 
-PA_STATIC_FLIST_DECLARE(entries, 0, pa_xfree);
-
-struct queue_entry {
-    struct queue_entry *next;
-    void *data;
-};
+/* The size of the array of a queue when something is first pushed */
+#define INITIAL_SIZE 8
 
+/* The entries are kept in a circular array, which is doubled in size
+ * when it is full */
 struct pa_queue {
-    struct queue_entry *front, *back;
-    unsigned length;
+    void **entries;
+    unsigned size, front, length;
 };
 
 pa_queue* pa_queue_new(void) {
     pa_queue *q = pa_xnew(pa_queue, 1);
 
-    q->front = q->back = NULL;
-    q->length = 0;
+    q->entries = NULL;
+    q->size = q->front = q->length = 0;
 
     return q;
 }
@@ -60,58 +58,56 @@ void pa_queue_free(pa_queue *q, pa_free_cb_t free_func) {
         if (free_func)
             free_func(data);
 
-    pa_assert(!q->front);
-    pa_assert(!q->back);
     pa_assert(q->length == 0);
 
+    pa_xfree(q->entries);
     pa_xfree(q);
 }
 
-void pa_queue_push(pa_queue *q, void *p) {
-    struct queue_entry *e;
+static void grow(pa_queue *q) {
+    void **entries;
+    unsigned size, n;
 
-    pa_assert(q);
-    pa_assert(p);
+    size = q->size > 0 ? q->size * 2 : INITIAL_SIZE;
+    entries = pa_xnew(void*, size);
+
+    /* Unwrap, the front goes first again */
+    n = PA_MIN(q->length, q->size - q->front);
 
-    if (!(e = pa_flist_pop(PA_STATIC_FLIST_GET(entries))))
-        e = pa_xnew(struct queue_entry, 1);
+    if (n > 0)
+        memcpy(entries, q->entries + q->front, n * sizeof(void*));
 
-    e->data = p;
-    e->next = NULL;
+    if (q->length > n)
+        memcpy(entries + n, q->entries, (q->length - n) * sizeof(void*));
 
-    if (q->back) {
-        pa_assert(q->front);
-        q->back->next = e;
-    } else {
-        pa_assert(!q->front);
-        q->front = e;
-    }
+    pa_xfree(q->entries);
+    q->entries = entries;
+    q->size = size;
+    q->front = 0;
+}
 
-    q->back = e;
+void pa_queue_push(pa_queue *q, void *p) {
+    pa_assert(q);
+    pa_assert(p);
+
+    if (q->length >= q->size)
+        grow(q);
+
+    /* The size is a power of two */
+    q->entries[(q->front + q->length) & (q->size - 1)] = p;
     q->length++;
 }
 
 void* pa_queue_pop(pa_queue *q) {
     void *p;
-    struct queue_entry *e;
 
     pa_assert(q);
 
-    if (!(e = q->front))
+    if (q->length <= 0)
         return NULL;
 
-    q->front = e->next;
-
-    if (q->back == e) {
-        pa_assert(!e->next);
-        q->back = NULL;
-    }
-
-    p = e->data;
-
-    if (pa_flist_push(PA_STATIC_FLIST_GET(entries), e) < 0)
-        pa_xfree(e);
-
+    p = q->entries[q->front];
+    q->front = (q->front + 1) & (q->size - 1);
     q->length--;
 
     return p;
@@ -27,7 +27,9 @@
 typedef struct pa_queue pa_queue;
 
 /* A simple implementation of the abstract data type queue. Stores
- * pointers as members. The memory has to be managed by the caller. */
+ * pointers as members. The memory has to be managed by the caller.
+ * The members are kept in an array that grows as needed, pushing
+ * doesn't allocate otherwise. */
 
 pa_queue* pa_queue_new(void);
 
@@ -0,0 +1,124 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/macro.h>
+
+#include "rate-control.h"
+
+/* How far the rate may ever be from the base rate. Clocks that are
+ * further off than that are broken. */
+#define MAX_DEVIATION 0.05
+
+/* And how fast it may change, per second. 2 per mille can be
+ * considered inaudible. */
+#define MAX_SLEW 0.002
+
+struct pa_rate_controller {
+    uint32_t base_rate;
+
+    /* Gains of the proportional and the integral part */
+    double kp, ki;
+
+    double integral;    /* Of the error over time, in s^2 */
+    double deviation;   /* Of the current rate from the base rate, relative */
+
+    pa_usec_t last;
+};
+
+pa_rate_controller* pa_rate_controller_new(uint32_t base_rate, pa_usec_t time_constant) {
+    pa_rate_controller *c;
+    double t;
+
+    pa_assert(base_rate > 0);
+    pa_assert(time_constant > 0);
+
+    c = pa_xnew0(pa_rate_controller, 1);
+
+    /* The latency changes by the deviation of the rate, so with these
+     * gains the loop is critically damped, with both poles at
+     * -1/time_constant */
+    t = (double) time_constant / PA_USEC_PER_SEC;
+    c->kp = 2.0 / t;
+    c->ki = 1.0 / (t * t);
+
+    pa_rate_controller_reset(c, base_rate);
+
+    return c;
+}
+
+void pa_rate_controller_free(pa_rate_controller *c) {
+    pa_assert(c);
+
+    pa_xfree(c);
+}
+
+void pa_rate_controller_reset(pa_rate_controller *c, uint32_t base_rate) {
+    pa_assert(c);
+    pa_assert(base_rate > 0);
+
+    c->base_rate = base_rate;
+    c->integral = 0;
+    c->deviation = 0;
+    c->last = 0;
+}
+
+uint32_t pa_rate_controller_update(pa_rate_controller *c, pa_usec_t now, int64_t error) {
+    double e, dt, d, wanted, integral, slew_min, slew_max;
+    pa_bool_t limited;
+
+    pa_assert(c);
+
+    /* The first error only tells us where we start from */
+    if (c->last <= 0 || now <= c->last) {
+        c->last = now;
+        return (uint32_t) lrint(c->base_rate * (1.0 + c->deviation));
+    }
+
+    e = (double) error / PA_USEC_PER_SEC;
+    dt = (double) (now - c->last) / PA_USEC_PER_SEC;
+    c->last = now;
+
+    integral = c->integral + e * dt;
+    wanted = c->kp * e + c->ki * integral;
+
+    slew_min = c->deviation - MAX_SLEW * dt;
+    slew_max = c->deviation + MAX_SLEW * dt;
+
+    d = PA_CLAMP(wanted, -MAX_DEVIATION, MAX_DEVIATION);
+    limited = wanted < -MAX_DEVIATION || wanted > MAX_DEVIATION || d < slew_min || d > slew_max;
+    d = PA_CLAMP(d, slew_min, slew_max);
+
+    /* While limited, don't let the integral wind up any further, or
+     * we'd overshoot once we caught up */
+    if (!limited || (wanted > d) != (e > 0))
+        c->integral = integral;
+
+    c->deviation = d;
+
+    return (uint32_t) lrint(c->base_rate * (1.0 + d));
+}
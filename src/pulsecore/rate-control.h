@@ -0,0 +1,47 @@
+#ifndef foopulsecoreratecontrolhfoo
+#define foopulsecoreratecontrolhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulse/sample.h>
+#include <pulsecore/macro.h>
+
+/* A PI controller for the rate of a stream between two devices of
+ * different clocks, that keeps a latency at its target. It is fed the
+ * deviation of the latency from its target every now and then, and
+ * answers with the rate to use from then on. The integral part takes
+ * care of the clock drift, the proportional one of the rest, and the
+ * rate is only changed in small steps, so that nothing is audible. */
+
+typedef struct pa_rate_controller pa_rate_controller;
+
+/* base_rate is the nominal rate of the stream. The latency settles
+ * within a few time_constant. */
+pa_rate_controller* pa_rate_controller_new(uint32_t base_rate, pa_usec_t time_constant);
+void pa_rate_controller_free(pa_rate_controller *c);
+
+/* Forgets everything learned, e.g. when the stream moved */
+void pa_rate_controller_reset(pa_rate_controller *c, uint32_t base_rate);
+
+/* error is by how much the latency at now is above (positive) or below
+ * its target. Returns the new rate. */
+uint32_t pa_rate_controller_update(pa_rate_controller *c, pa_usec_t now, int64_t error);
+
+#endif
@@ -24,6 +24,7 @@
 ***/
 
 #include <pulse/sample.h>
+#include <pulsecore/macro.h>
 
 typedef struct pa_remap pa_remap_t;
 
@@ -34,11 +35,17 @@ struct pa_remap {
     pa_sample_spec *i_ss, *o_ss;
     float map_table_f[PA_CHANNELS_MAX][PA_CHANNELS_MAX];
     int32_t map_table_i[PA_CHANNELS_MAX][PA_CHANNELS_MAX];
+    int8_t arrange_table[PA_CHANNELS_MAX];
     pa_do_remap_func_t do_remap;
 };
 
 void pa_init_remap (pa_remap_t *m);
 
+/* Checks whether every output channel is a plain copy of at most one
+ * input channel, and if so fills in arrange_table with the input channel
+ * for each output channel, or -1 for silence */
+pa_bool_t pa_setup_remap_arrange(pa_remap_t *m);
+
 /* custom installation of init functions */
 typedef void (*pa_init_remap_func_t) (pa_remap_t *m);
 
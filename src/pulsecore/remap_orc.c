@@ -0,0 +1,78 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/macro.h>
+#include <pulsecore/log.h>
+#include <pulsecore/remap.h>
+#include <pulsecore/remap-orc-gen.h>
+
+#include "cpu-orc.h"
+
+/* Called for the cases no Orc version is there for */
+static pa_init_remap_func_t fallback;
+
+static void remap_mono_to_stereo_orc(pa_remap_t *m, void *dst, const void *src, unsigned n) {
+
+    if (*m->format == PA_SAMPLE_FLOAT32NE)
+        pa_remap_mono_to_stereo_float32ne_orc(dst, src, (int) n);
+    else
+        pa_remap_mono_to_stereo_s16ne_orc(dst, src, (int) n);
+}
+
+static void remap_stereo_to_mono_orc(pa_remap_t *m, void *dst, const void *src, unsigned n) {
+
+    /* The C version adds what is 1.0 and above unchanged */
+    pa_remap_stereo_to_mono_float32ne_orc(dst, src,
+                                          PA_MIN(m->map_table_f[0][0], 1.0f),
+                                          PA_MIN(m->map_table_f[0][1], 1.0f),
+                                          (int) n);
+}
+
+static void init_remap_orc(pa_remap_t *m) {
+    unsigned n_oc, n_ic;
+
+    n_oc = m->o_ss->channels;
+    n_ic = m->i_ss->channels;
+
+    if (n_ic == 1 && n_oc == 2 &&
+            m->map_table_f[0][0] >= 1.0 && m->map_table_f[1][0] >= 1.0) {
+
+        m->do_remap = (pa_do_remap_func_t) remap_mono_to_stereo_orc;
+        pa_log_info("Using Orc mono to stereo remapping");
+
+    } else if (n_ic == 2 && n_oc == 1 && *m->format == PA_SAMPLE_FLOAT32NE &&
+               m->map_table_f[0][0] > 0.0 && m->map_table_f[0][1] > 0.0) {
+
+        m->do_remap = (pa_do_remap_func_t) remap_stereo_to_mono_orc;
+        pa_log_info("Using Orc stereo to mono remapping");
+
+    } else
+        fallback(m);
+}
+
+void pa_remap_func_init_orc(void) {
+    pa_log_info("Initialising Orc optimized remappers.");
+
+    fallback = pa_get_init_remap_func();
+    pa_set_init_remap_func((pa_init_remap_func_t) init_remap_orc);
+}
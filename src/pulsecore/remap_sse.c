@@ -24,6 +24,8 @@
 #include <config.h>
 #endif
 
+#include <string.h>
+
 #include <pulse/sample.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
@@ -31,6 +33,10 @@
 #include "cpu-x86.h"
 #include "remap.h"
 
+#if defined (PA_HAVE_X86_TARGET_ATTRIBUTE)
+#include <emmintrin.h>
+#endif
+
 #define LOAD_SAMPLES                                   \
                 " movdqu (%1), %%xmm0           \n\t"  \
                 " movdqu 16(%1), %%xmm2         \n\t"  \
@@ -129,6 +135,576 @@ static void remap_mono_to_stereo_sse2(pa_remap_t *m, void *dst, const void *src,
     }
 }
 
+#if defined (PA_HAVE_X86_TARGET_ATTRIBUTE)
+/* The matrix remappers are bit-exact with the C version: each output
+ * channel is summed in input channel order starting from 0, entries of
+ * 1.0 and above add the sample itself and the entries the C version skips
+ * are masked out, so even NaNs do not get through them. S16 entries below
+ * 1.0 are applied as (s * vol) >> 16 term by term, with wrapping adds.
+ *
+ * The common downmixes transpose a block of frames so that every
+ * register holds one channel of 4 (float) or 8 (S16) frames. All other
+ * matrices with up to 8 output channels are done a frame at a time, with
+ * a whole output frame in one or two registers. */
+
+typedef struct {
+    __m128 vol, mask;
+} float_coef_t;
+
+typedef struct {
+    __m128i vol, full;
+} s16_coef_t;
+
+static void remap_matrix_tail_c(pa_remap_t *m, void *dst, const void *src, unsigned n) {
+    unsigned oc, ic, n_ic, n_oc;
+
+    n_ic = m->i_ss->channels;
+    n_oc = m->o_ss->channels;
+
+    if (*m->format == PA_SAMPLE_FLOAT32NE) {
+        float *d = dst;
+        const float *s = src;
+
+        for (; n > 0; n--, s += n_ic, d += n_oc)
+            for (oc = 0; oc < n_oc; oc++) {
+                d[oc] = 0.0f;
+
+                for (ic = 0; ic < n_ic; ic++) {
+                    float vol = m->map_table_f[oc][ic];
+
+                    if (vol >= 1.0)
+                        d[oc] += s[ic];
+                    else if (vol > 0.0)
+                        d[oc] += s[ic] * vol;
+                }
+            }
+    } else {
+        int16_t *d = dst;
+        const int16_t *s = src;
+
+        for (; n > 0; n--, s += n_ic, d += n_oc)
+            for (oc = 0; oc < n_oc; oc++) {
+                d[oc] = 0;
+
+                for (ic = 0; ic < n_ic; ic++) {
+                    int32_t vol = m->map_table_i[oc][ic];
+
+                    if (vol >= 0x10000)
+                        d[oc] += s[ic];
+                    else if (vol > 0)
+                        d[oc] += (int16_t) (((int32_t) s[ic] * vol) >> 16);
+                }
+            }
+    }
+}
+
+PA_X86_TARGET("sse2")
+static void setup_float_coefs_sse2(pa_remap_t *m, float_coef_t c[PA_CHANNELS_MAX][PA_CHANNELS_MAX]) {
+    unsigned oc, ic;
+
+    for (oc = 0; oc < m->o_ss->channels; oc++)
+        for (ic = 0; ic < m->i_ss->channels; ic++) {
+            float vol = m->map_table_f[oc][ic];
+
+            c[oc][ic].vol = _mm_set1_ps(vol >= 1.0 ? 1.0f : vol);
+            c[oc][ic].mask = _mm_castsi128_ps(_mm_set1_epi32(vol > 0.0 ? -1 : 0));
+        }
+}
+
+PA_X86_TARGET("sse2")
+static void setup_s16_coefs_sse2(pa_remap_t *m, s16_coef_t c[PA_CHANNELS_MAX][PA_CHANNELS_MAX]) {
+    unsigned oc, ic;
+
+    for (oc = 0; oc < m->o_ss->channels; oc++)
+        for (ic = 0; ic < m->i_ss->channels; ic++) {
+            int32_t vol = m->map_table_i[oc][ic];
+
+            c[oc][ic].vol = _mm_set1_epi16((int16_t) (vol > 0 && vol < 0x10000 ? vol : 0));
+            c[oc][ic].full = _mm_set1_epi16(vol >= 0x10000 ? -1 : 0);
+        }
+}
+
+PA_X86_TARGET("sse2") PA_ALWAYS_INLINE
+static inline __m128 mix_float_sse2(__m128 acc, __m128 x, const float_coef_t *c) {
+    return _mm_add_ps(acc, _mm_and_ps(_mm_mul_ps(x, c->vol), c->mask));
+}
+
+/* sign is x >> 15: the unsigned high multiply is off by vol for negative
+ * samples, which is corrected for here */
+PA_X86_TARGET("sse2") PA_ALWAYS_INLINE
+static inline __m128i mix_s16_sse2(__m128i acc, __m128i x, __m128i sign, const s16_coef_t *c) {
+    __m128i t;
+
+    t = _mm_sub_epi16(_mm_mulhi_epu16(x, c->vol), _mm_and_si128(sign, c->vol));
+    t = _mm_or_si128(t, _mm_and_si128(x, c->full));
+
+    return _mm_add_epi16(acc, t);
+}
+
+PA_X86_TARGET("sse2") PA_ALWAYS_INLINE
+static inline void transpose_8x16_sse2(__m128i r[8]) {
+    __m128i a0, a1, a2, a3, a4, a5, a6, a7;
+    __m128i b0, b1, b2, b3, b4, b5, b6, b7;
+
+    a0 = _mm_unpacklo_epi16(r[0], r[1]);
+    a1 = _mm_unpacklo_epi16(r[2], r[3]);
+    a2 = _mm_unpacklo_epi16(r[4], r[5]);
+    a3 = _mm_unpacklo_epi16(r[6], r[7]);
+    a4 = _mm_unpackhi_epi16(r[0], r[1]);
+    a5 = _mm_unpackhi_epi16(r[2], r[3]);
+    a6 = _mm_unpackhi_epi16(r[4], r[5]);
+    a7 = _mm_unpackhi_epi16(r[6], r[7]);
+
+    b0 = _mm_unpacklo_epi32(a0, a1);
+    b1 = _mm_unpackhi_epi32(a0, a1);
+    b2 = _mm_unpacklo_epi32(a2, a3);
+    b3 = _mm_unpackhi_epi32(a2, a3);
+    b4 = _mm_unpacklo_epi32(a4, a5);
+    b5 = _mm_unpackhi_epi32(a4, a5);
+    b6 = _mm_unpacklo_epi32(a6, a7);
+    b7 = _mm_unpackhi_epi32(a6, a7);
+
+    r[0] = _mm_unpacklo_epi64(b0, b2);
+    r[1] = _mm_unpackhi_epi64(b0, b2);
+    r[2] = _mm_unpacklo_epi64(b1, b3);
+    r[3] = _mm_unpackhi_epi64(b1, b3);
+    r[4] = _mm_unpacklo_epi64(b4, b6);
+    r[5] = _mm_unpackhi_epi64(b4, b6);
+    r[6] = _mm_unpacklo_epi64(b5, b7);
+    r[7] = _mm_unpackhi_epi64(b5, b7);
+}
+
+PA_X86_TARGET("sse2")
+static void remap_2_to_1_sse2(pa_remap_t *m, void *dst, const void *src, unsigned n) {
+
+    switch (*m->format) {
+        case PA_SAMPLE_FLOAT32NE:
+        {
+            float_coef_t c[PA_CHANNELS_MAX][PA_CHANNELS_MAX];
+            const float *s = src;
+            float *d = dst;
+
+            setup_float_coefs_sse2(m, c);
+
+            for (; n >= 4; n -= 4, s += 8, d += 4) {
+                __m128 a, b, acc;
+
+                a = _mm_loadu_ps(s);
+                b = _mm_loadu_ps(s + 4);
+
+                acc = mix_float_sse2(_mm_setzero_ps(), _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), &c[0][0]);
+                acc = mix_float_sse2(acc, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)), &c[0][1]);
+                _mm_storeu_ps(d, acc);
+            }
+
+            remap_matrix_tail_c(m, d, s, n);
+            break;
+        }
+        case PA_SAMPLE_S16NE:
+        {
+            s16_coef_t c[PA_CHANNELS_MAX][PA_CHANNELS_MAX];
+            const int16_t *s = src;
+            int16_t *d = dst;
+
+            setup_s16_coefs_sse2(m, c);
+
+            for (; n >= 8; n -= 8, s += 16, d += 8) {
+                __m128i a, b, l, r, acc;
+
+                a = _mm_loadu_si128((const __m128i *) s);
+                b = _mm_loadu_si128((const __m128i *) (s + 8));
+
+                l = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16), _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+                r = _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+
+                acc = mix_s16_sse2(_mm_setzero_si128(), l, _mm_srai_epi16(l, 15), &c[0][0]);
+                acc = mix_s16_sse2(acc, r, _mm_srai_epi16(r, 15), &c[0][1]);
+                _mm_storeu_si128((__m128i *) d, acc);
+            }
+
+            remap_matrix_tail_c(m, d, s, n);
+            break;
+        }
+        default:
+            pa_assert_not_reached();
+    }
+}
+
+PA_X86_TARGET("sse2")
+static void remap_4_to_2_sse2(pa_remap_t *m, void *dst, const void *src, unsigned n) {
+
+    switch (*m->format) {
+        case PA_SAMPLE_FLOAT32NE:
+        {
+            float_coef_t c[PA_CHANNELS_MAX][PA_CHANNELS_MAX];
+            const float *s = src;
+            float *d = dst;
+
+            setup_float_coefs_sse2(m, c);
+
+            for (; n >= 4; n -= 4, s += 16, d += 8) {
+                __m128 c0, c1, c2, c3, l, r;
+
+                c0 = _mm_loadu_ps(s);
+                c1 = _mm_loadu_ps(s + 4);
+                c2 = _mm_loadu_ps(s + 8);
+                c3 = _mm_loadu_ps(s + 12);
+                _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+                l = mix_float_sse2(_mm_setzero_ps(), c0, &c[0][0]);
+                l = mix_float_sse2(l, c1, &c[0][1]);
+                l = mix_float_sse2(l, c2, &c[0][2]);
+                l = mix_float_sse2(l, c3, &c[0][3]);
+
+                r = mix_float_sse2(_mm_setzero_ps(), c0, &c[1][0]);
+                r = mix_float_sse2(r, c1, &c[1][1]);
+                r = mix_float_sse2(r, c2, &c[1][2]);
+                r = mix_float_sse2(r, c3, &c[1][3]);
+
+                _mm_storeu_ps(d, _mm_unpacklo_ps(l, r));
+                _mm_storeu_ps(d + 4, _mm_unpackhi_ps(l, r));
+            }
+
+            remap_matrix_tail_c(m, d, s, n);
+            break;
+        }
+        case PA_SAMPLE_S16NE:
+        {
+            s16_coef_t c[PA_CHANNELS_MAX][PA_CHANNELS_MAX];
+            const int16_t *s = src;
+            int16_t *d = dst;
+
+            setup_s16_coefs_sse2(m, c);
+
+            for (; n >= 8; n -= 8, s += 32, d += 16) {
+                __m128i x[8], sg[4], l, r;
+                unsigned i;
+
+                for (i = 0; i < 8; i++)
+                    x[i] = _mm_loadl_epi64((const __m128i *) (s + 4 * i));
+                transpose_8x16_sse2(x);
+
+                for (i = 0; i < 4; i++)
+                    sg[i] = _mm_srai_epi16(x[i], 15);
+
+                l = mix_s16_sse2(_mm_setzero_si128(), x[0], sg[0], &c[0][0]);
+                l = mix_s16_sse2(l, x[1], sg[1], &c[0][1]);
+                l = mix_s16_sse2(l, x[2], sg[2], &c[0][2]);
+                l = mix_s16_sse2(l, x[3], sg[3], &c[0][3]);
+
+                r = mix_s16_sse2(_mm_setzero_si128(), x[0], sg[0], &c[1][0]);
+                r = mix_s16_sse2(r, x[1], sg[1], &c[1][1]);
+                r = mix_s16_sse2(r, x[2], sg[2], &c[1][2]);
+                r = mix_s16_sse2(r, x[3], sg[3], &c[1][3]);
+
+                _mm_storeu_si128((__m128i *) d, _mm_unpacklo_epi16(l, r));
+                _mm_storeu_si128((__m128i *) (d + 8), _mm_unpackhi_epi16(l, r));
+            }
+
+            remap_matrix_tail_c(m, d, s, n);
+            break;
+        }
+        default:
+            pa_assert_not_reached();
+    }
+}
+
+PA_X86_TARGET("sse2")
+static void remap_6_to_2_sse2(pa_remap_t *m, void *dst, const void *src, unsigned n) {
+
+    switch (*m->format) {
+        case PA_SAMPLE_FLOAT32NE:
+        {
+            float_coef_t c[PA_CHANNELS_MAX][PA_CHANNELS_MAX];
+            const float *s = src;
+            float *d = dst;
+
+            setup_float_coefs_sse2(m, c);
+
+            for (; n >= 4; n -= 4, s += 24, d += 8) {
+                __m128 c0, c1, c2, c3, c4, c5, h01, h23, l, r;
+
+                c0 = _mm_loadu_ps(s);
+                c1 = _mm_loadu_ps(s + 6);
+                c2 = _mm_loadu_ps(s + 12);
+                c3 = _mm_loadu_ps(s + 18);
+                _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+                /* The last two channels of each frame */
+                h01 = _mm_unpacklo_ps(_mm_loadl_pi(_mm_setzero_ps(), (const __m64 *) (s + 4)),
+                                      _mm_loadl_pi(_mm_setzero_ps(), (const __m64 *) (s + 10)));
+                h23 = _mm_unpacklo_ps(_mm_loadl_pi(_mm_setzero_ps(), (const __m64 *) (s + 16)),
+                                      _mm_loadl_pi(_mm_setzero_ps(), (const __m64 *) (s + 22)));
+                c4 = _mm_movelh_ps(h01, h23);
+                c5 = _mm_movehl_ps(h23, h01);
+
+                l = mix_float_sse2(_mm_setzero_ps(), c0, &c[0][0]);
+                l = mix_float_sse2(l, c1, &c[0][1]);
+                l = mix_float_sse2(l, c2, &c[0][2]);
+                l = mix_float_sse2(l, c3, &c[0][3]);
+                l = mix_float_sse2(l, c4, &c[0][4]);
+                l = mix_float_sse2(l, c5, &c[0][5]);
+
+                r = mix_float_sse2(_mm_setzero_ps(), c0, &c[1][0]);
+                r = mix_float_sse2(r, c1, &c[1][1]);
+                r = mix_float_sse2(r, c2, &c[1][2]);
+                r = mix_float_sse2(r, c3, &c[1][3]);
+                r = mix_float_sse2(r, c4, &c[1][4]);
+                r = mix_float_sse2(r, c5, &c[1][5]);
+
+                _mm_storeu_ps(d, _mm_unpacklo_ps(l, r));
+                _mm_storeu_ps(d + 4, _mm_unpackhi_ps(l, r));
+            }
+
+            remap_matrix_tail_c(m, d, s, n);
+            break;
+        }
+        case PA_SAMPLE_S16NE:
+        {
+            s16_coef_t c[PA_CHANNELS_MAX][PA_CHANNELS_MAX];
+            const int16_t *s = src;
+            int16_t *d = dst;
+
+            setup_s16_coefs_sse2(m, c);
+
+            /* Each load reads two samples into the next frame, so stop
+             * while there is a ninth frame */
+            for (; n >= 9; n -= 8, s += 48, d += 16) {
+                __m128i x[8], sg[6], l, r;
+                unsigned i;
+
+                for (i = 0; i < 8; i++)
+                    x[i] = _mm_loadu_si128((const __m128i *) (s + 6 * i));
+                transpose_8x16_sse2(x);
+
+                for (i = 0; i < 6; i++)
+                    sg[i] = _mm_srai_epi16(x[i], 15);
+
+                l = mix_s16_sse2(_mm_setzero_si128(), x[0], sg[0], &c[0][0]);
+                l = mix_s16_sse2(l, x[1], sg[1], &c[0][1]);
+                l = mix_s16_sse2(l, x[2], sg[2], &c[0][2]);
+                l = mix_s16_sse2(l, x[3], sg[3], &c[0][3]);
+                l = mix_s16_sse2(l, x[4], sg[4], &c[0][4]);
+                l = mix_s16_sse2(l, x[5], sg[5], &c[0][5]);
+
+                r = mix_s16_sse2(_mm_setzero_si128(), x[0], sg[0], &c[1][0]);
+                r = mix_s16_sse2(r, x[1], sg[1], &c[1][1]);
+                r = mix_s16_sse2(r, x[2], sg[2], &c[1][2]);
+                r = mix_s16_sse2(r, x[3], sg[3], &c[1][3]);
+                r = mix_s16_sse2(r, x[4], sg[4], &c[1][4]);
+                r = mix_s16_sse2(r, x[5], sg[5], &c[1][5]);
+
+                _mm_storeu_si128((__m128i *) d, _mm_unpacklo_epi16(l, r));
+                _mm_storeu_si128((__m128i *) (d + 8), _mm_unpackhi_epi16(l, r));
+            }
+
+            remap_matrix_tail_c(m, d, s, n);
+            break;
+        }
+        default:
+            pa_assert_not_reached();
+    }
+}
+
+PA_X86_TARGET("sse2")
+static void remap_8_to_2_sse2(pa_remap_t *m, void *dst, const void *src, unsigned n) {
+
+    switch (*m->format) {
+        case PA_SAMPLE_FLOAT32NE:
+        {
+            float_coef_t c[PA_CHANNELS_MAX][PA_CHANNELS_MAX];
+            const float *s = src;
+            float *d = dst;
+
+            setup_float_coefs_sse2(m, c);
+
+            for (; n >= 4; n -= 4, s += 32, d += 8) {
+                __m128 c0, c1, c2, c3, c4, c5, c6, c7, l, r;
+
+                c0 = _mm_loadu_ps(s);
+                c1 = _mm_loadu_ps(s + 8);
+                c2 = _mm_loadu_ps(s + 16);
+                c3 = _mm_loadu_ps(s + 24);
+                _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+                c4 = _mm_loadu_ps(s + 4);
+                c5 = _mm_loadu_ps(s + 12);
+                c6 = _mm_loadu_ps(s + 20);
+                c7 = _mm_loadu_ps(s + 28);
+                _MM_TRANSPOSE4_PS(c4, c5, c6, c7);
+
+                l = mix_float_sse2(_mm_setzero_ps(), c0, &c[0][0]);
+                l = mix_float_sse2(l, c1, &c[0][1]);
+                l = mix_float_sse2(l, c2, &c[0][2]);
+                l = mix_float_sse2(l, c3, &c[0][3]);
+                l = mix_float_sse2(l, c4, &c[0][4]);
+                l = mix_float_sse2(l, c5, &c[0][5]);
+                l = mix_float_sse2(l, c6, &c[0][6]);
+                l = mix_float_sse2(l, c7, &c[0][7]);
+
+                r = mix_float_sse2(_mm_setzero_ps(), c0, &c[1][0]);
+                r = mix_float_sse2(r, c1, &c[1][1]);
+                r = mix_float_sse2(r, c2, &c[1][2]);
+                r = mix_float_sse2(r, c3, &c[1][3]);
+                r = mix_float_sse2(r, c4, &c[1][4]);
+                r = mix_float_sse2(r, c5, &c[1][5]);
+                r = mix_float_sse2(r, c6, &c[1][6]);
+                r = mix_float_sse2(r, c7, &c[1][7]);
+
+                _mm_storeu_ps(d, _mm_unpacklo_ps(l, r));
+                _mm_storeu_ps(d + 4, _mm_unpackhi_ps(l, r));
+            }
+
+            remap_matrix_tail_c(m, d, s, n);
+            break;
+        }
+        case PA_SAMPLE_S16NE:
+        {
+            s16_coef_t c[PA_CHANNELS_MAX][PA_CHANNELS_MAX];
+            const int16_t *s = src;
+            int16_t *d = dst;
+
+            setup_s16_coefs_sse2(m, c);
+
+            for (; n >= 8; n -= 8, s += 64, d += 16) {
+                __m128i x[8], sg[8], l, r;
+                unsigned i;
+
+                for (i = 0; i < 8; i++)
+                    x[i] = _mm_loadu_si128((const __m128i *) (s + 8 * i));
+                transpose_8x16_sse2(x);
+
+                for (i = 0; i < 8; i++)
+                    sg[i] = _mm_srai_epi16(x[i], 15);
+
+                l = mix_s16_sse2(_mm_setzero_si128(), x[0], sg[0], &c[0][0]);
+                l = mix_s16_sse2(l, x[1], sg[1], &c[0][1]);
+                l = mix_s16_sse2(l, x[2], sg[2], &c[0][2]);
+                l = mix_s16_sse2(l, x[3], sg[3], &c[0][3]);
+                l = mix_s16_sse2(l, x[4], sg[4], &c[0][4]);
+                l = mix_s16_sse2(l, x[5], sg[5], &c[0][5]);
+                l = mix_s16_sse2(l, x[6], sg[6], &c[0][6]);
+                l = mix_s16_sse2(l, x[7], sg[7], &c[0][7]);
+
+                r = mix_s16_sse2(_mm_setzero_si128(), x[0], sg[0], &c[1][0]);
+                r = mix_s16_sse2(r, x[1], sg[1], &c[1][1]);
+                r = mix_s16_sse2(r, x[2], sg[2], &c[1][2]);
+                r = mix_s16_sse2(r, x[3], sg[3], &c[1][3]);
+                r = mix_s16_sse2(r, x[4], sg[4], &c[1][4]);
+                r = mix_s16_sse2(r, x[5], sg[5], &c[1][5]);
+                r = mix_s16_sse2(r, x[6], sg[6], &c[1][6]);
+                r = mix_s16_sse2(r, x[7], sg[7], &c[1][7]);
+
+                _mm_storeu_si128((__m128i *) d, _mm_unpacklo_epi16(l, r));
+                _mm_storeu_si128((__m128i *) (d + 8), _mm_unpackhi_epi16(l, r));
+            }
+
+            remap_matrix_tail_c(m, d, s, n);
+            break;
+        }
+        default:
+            pa_assert_not_reached();
+    }
+}
+
+/* Up to 8 output channels, one frame at a time. A whole register is
+ * stored for every frame, which is fine as long as it stays inside the
+ * buffer: the following frames overwrite the excess. */
+PA_X86_TARGET("sse2")
+static void remap_channels_matrix_sse2(pa_remap_t *m, void *dst, const void *src, unsigned n) {
+    unsigned oc, ic, n_ic, n_oc;
+
+    n_ic = m->i_ss->channels;
+    n_oc = m->o_ss->channels;
+
+    pa_assert(n_oc <= 8);
+
+    switch (*m->format) {
+        case PA_SAMPLE_FLOAT32NE:
+        {
+            float_coef_t c[PA_CHANNELS_MAX][2];
+            const float *s = src;
+            float *d = dst;
+            unsigned w = n_oc > 4 ? 8 : 4;
+
+            /* One column of the matrix per input channel */
+            for (ic = 0; ic < n_ic; ic++) {
+                float vol[8];
+                int32_t mask[8];
+
+                for (oc = 0; oc < 8; oc++) {
+                    float v = oc < n_oc ? m->map_table_f[oc][ic] : 0.0f;
+
+                    vol[oc] = v >= 1.0 ? 1.0f : v;
+                    mask[oc] = v > 0.0 ? -1 : 0;
+                }
+
+                c[ic][0].vol = _mm_loadu_ps(vol);
+                c[ic][1].vol = _mm_loadu_ps(vol + 4);
+                c[ic][0].mask = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *) mask));
+                c[ic][1].mask = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *) (mask + 4)));
+            }
+
+            for (; n > 0 && n * n_oc >= w; n--, s += n_ic, d += n_oc) {
+                __m128 lo = _mm_setzero_ps(), hi = _mm_setzero_ps();
+
+                for (ic = 0; ic < n_ic; ic++) {
+                    __m128 x = _mm_set1_ps(s[ic]);
+
+                    lo = mix_float_sse2(lo, x, &c[ic][0]);
+                    if (w > 4)
+                        hi = mix_float_sse2(hi, x, &c[ic][1]);
+                }
+
+                _mm_storeu_ps(d, lo);
+                if (w > 4)
+                    _mm_storeu_ps(d + 4, hi);
+            }
+
+            remap_matrix_tail_c(m, d, s, n);
+            break;
+        }
+        case PA_SAMPLE_S16NE:
+        {
+            s16_coef_t c[PA_CHANNELS_MAX];
+            const int16_t *s = src;
+            int16_t *d = dst;
+
+            for (ic = 0; ic < n_ic; ic++) {
+                int16_t vol[8], full[8];
+
+                for (oc = 0; oc < 8; oc++) {
+                    int32_t v = oc < n_oc ? m->map_table_i[oc][ic] : 0;
+
+                    vol[oc] = (int16_t) (v > 0 && v < 0x10000 ? v : 0);
+                    full[oc] = v >= 0x10000 ? -1 : 0;
+                }
+
+                c[ic].vol = _mm_loadu_si128((const __m128i *) vol);
+                c[ic].full = _mm_loadu_si128((const __m128i *) full);
+            }
+
+            for (; n > 0 && n * n_oc >= 8; n--, s += n_ic, d += n_oc) {
+                __m128i acc = _mm_setzero_si128();
+
+                for (ic = 0; ic < n_ic; ic++) {
+                    __m128i x = _mm_set1_epi16(s[ic]);
+
+                    acc = mix_s16_sse2(acc, x, _mm_srai_epi16(x, 15), &c[ic]);
+                }
+
+                _mm_storeu_si128((__m128i *) d, acc);
+            }
+
+            remap_matrix_tail_c(m, d, s, n);
+            break;
+        }
+        default:
+            pa_assert_not_reached();
+    }
+}
+#endif /* defined (PA_HAVE_X86_TARGET_ATTRIBUTE) */
+
 /* set the function that will execute the remapping based on the matrices */
 static void init_remap_sse2(pa_remap_t *m) {
     unsigned n_oc, n_ic;
@@ -141,6 +717,36 @@ static void init_remap_sse2(pa_remap_t *m) {
             m->map_table_f[0][0] >= 1.0 && m->map_table_f[1][0] >= 1.0) {
         m->do_remap = (pa_do_remap_func_t) remap_mono_to_stereo_sse2;
         pa_log_info("Using SSE mono to stereo remapping");
+#if defined (PA_HAVE_X86_TARGET_ATTRIBUTE)
+    } else if (pa_setup_remap_arrange(m)) {
+        /* leave it to the C version, there is nothing to compute */
+    } else if (n_ic == 2 && n_oc == 1) {
+        m->do_remap = (pa_do_remap_func_t) remap_2_to_1_sse2;
+        pa_log_info("Using SSE 2 to 1 channel remapping");
+    } else if (n_ic == 4 && n_oc == 2) {
+        m->do_remap = (pa_do_remap_func_t) remap_4_to_2_sse2;
+        pa_log_info("Using SSE 4 to 2 channel remapping");
+    } else if (n_ic == 6 && n_oc == 2) {
+        m->do_remap = (pa_do_remap_func_t) remap_6_to_2_sse2;
+        pa_log_info("Using SSE 6 to 2 channel remapping");
+    } else if (n_ic == 8 && n_oc == 2) {
+        m->do_remap = (pa_do_remap_func_t) remap_8_to_2_sse2;
+        pa_log_info("Using SSE 8 to 2 channel remapping");
+    } else if (n_oc > 2 && n_oc <= 8) {
+        unsigned oc, ic, n_entries = 0;
+
+        for (oc = 0; oc < n_oc; oc++)
+            for (ic = 0; ic < n_ic; ic++)
+                if (m->map_table_f[oc][ic] > 0.0)
+                    n_entries++;
+
+        /* The C version only walks the nonzero entries, while this
+         * always costs a full column per input channel */
+        if (n_entries > 2 * n_ic) {
+            m->do_remap = (pa_do_remap_func_t) remap_channels_matrix_sse2;
+            pa_log_info("Using SSE generic matrix remapping");
+        }
+#endif
     }
 }
 #endif /* defined (__i386__) || defined (__amd64__) */
@@ -24,6 +24,7 @@
 #endif
 
 #include <string.h>
+#include <math.h>
 
 #ifdef HAVE_LIBSAMPLERATE
 #include <samplerate.h>
@@ -39,6 +40,8 @@
 #include <pulsecore/macro.h>
 #include <pulsecore/strbuf.h>
 #include <pulsecore/remap.h>
+#include <pulsecore/llist.h>
+#include <pulsecore/mutex.h>
 
 #include "ffmpeg/avcodec.h"
 
@@ -47,6 +50,19 @@
 /* Number of samples of extra space we allow the resamplers to return */
 #define EXTRA_FRAMES 128
 
+/* Number of frames converted at once before they are remapped */
+#define FUSE_FRAMES 256U
+
+typedef struct polyphase_filter polyphase_filter;
+
+struct peaks_state { /* data specific to the peak finder pseudo resampler */
+    unsigned o_counter;
+    unsigned i_counter;
+
+    float max_f[PA_CHANNELS_MAX];
+    int16_t max_i[PA_CHANNELS_MAX];
+};
+
 struct pa_resampler {
     pa_resample_method_t method;
     pa_resample_flags_t flags;
@@ -55,6 +71,7 @@ struct pa_resampler {
     pa_channel_map i_cm, o_cm;
     size_t i_fz, o_fz, w_sz;
     pa_mempool *mempool;
+    pa_resampler_cache *cache;
 
     pa_memchunk to_work_format_buf;
     pa_memchunk remap_buf;
@@ -74,6 +91,10 @@ struct pa_resampler {
     pa_remap_t remap;
     pa_bool_t map_required;
 
+    /* Where blocks of the input are converted to the work format right
+     * before they are remapped, see convert_and_remap() */
+    void *fuse_buf;
+
     void (*impl_free)(pa_resampler *r);
     void (*impl_update_rates)(pa_resampler *r);
     void (*impl_resample)(pa_resampler *r, const pa_memchunk *in, unsigned in_samples, pa_memchunk *out, unsigned *out_samples);
@@ -84,14 +105,7 @@ struct pa_resampler {
         unsigned i_counter;
     } trivial;
 
-    struct { /* data specific to the peak finder pseudo resampler */
-        unsigned o_counter;
-        unsigned i_counter;
-
-        float max_f[PA_CHANNELS_MAX];
-        int16_t max_i[PA_CHANNELS_MAX];
-
-    } peaks;
+    struct peaks_state peaks;
 
 #ifdef HAVE_LIBSAMPLERATE
     struct { /* data specific to libsamplerate */
@@ -109,6 +123,15 @@ struct pa_resampler {
         struct AVResampleContext *state;
         pa_memchunk buf[PA_CHANNELS_MAX];
     } ffmpeg;
+
+    struct { /* data specific to the polyphase resampler */
+        polyphase_filter *filter;
+        float *buf;
+        unsigned n_frames, max_frames;
+        unsigned index;
+        uint32_t phase, frac;
+        uint64_t step;
+    } polyphase;
 };
 
 static int copy_init(pa_resampler *r);
@@ -118,6 +141,7 @@ static int speex_init(pa_resampler*r);
 #endif
 static int ffmpeg_init(pa_resampler*r);
 static int peaks_init(pa_resampler*r);
+static int polyphase_init(pa_resampler*r);
 #ifdef HAVE_LIBSAMPLERATE
 static int libsamplerate_init(pa_resampler*r);
 #endif
@@ -190,10 +214,12 @@ static int (* const init_table[])(pa_resampler*r) = {
     [PA_RESAMPLER_AUTO]                    = NULL,
     [PA_RESAMPLER_COPY]                    = copy_init,
     [PA_RESAMPLER_PEAKS]                   = peaks_init,
+    [PA_RESAMPLER_POLYPHASE]               = polyphase_init,
 };
 
 pa_resampler* pa_resampler_new(
         pa_mempool *pool,
+        pa_resampler_cache *cache,
         const pa_sample_spec *a,
         const pa_channel_map *am,
         const pa_sample_spec *b,
@@ -243,6 +269,7 @@ pa_resampler* pa_resampler_new(
 
     r = pa_xnew0(pa_resampler, 1);
     r->mempool = pool;
+    r->cache = cache;
     r->method = method;
     r->flags = flags;
 
@@ -275,6 +302,11 @@ pa_resampler* pa_resampler_new(
     if ((method >= PA_RESAMPLER_SPEEX_FIXED_BASE && method <= PA_RESAMPLER_SPEEX_FIXED_MAX) ||
         (method == PA_RESAMPLER_FFMPEG))
         r->work_format = PA_SAMPLE_S16NE;
+    else if (method >= PA_RESAMPLER_SPEEX_FLOAT_BASE && method <= PA_RESAMPLER_SPEEX_FLOAT_MAX &&
+             a->format == PA_SAMPLE_S16NE && b->format == PA_SAMPLE_S16NE && !r->map_required)
+        /* Speex converts from and to integers on the fly, saving us both
+         * conversions */
+        r->work_format = PA_SAMPLE_S16NE;
     else if (method == PA_RESAMPLER_TRIVIAL || method == PA_RESAMPLER_COPY || method == PA_RESAMPLER_PEAKS) {
 
         if (r->map_required || a->format != b->format || method == PA_RESAMPLER_PEAKS) {
@@ -350,6 +382,7 @@ void pa_resampler_free(pa_resampler *r) {
     if (r->from_work_format_buf.memblock)
         pa_memblock_unref(r->from_work_format_buf.memblock);
 
+    pa_xfree(r->fuse_buf);
     pa_xfree(r);
 }
 
@@ -508,7 +541,8 @@ static const char * const resample_methods[] = {
     "ffmpeg",
     "auto",
     "copy",
-    "peaks"
+    "peaks",
+    "polyphase"
 };
 
 const char *pa_resample_method_to_string(pa_resample_method_t m) {
@@ -539,6 +573,49 @@ int pa_resample_method_supported(pa_resample_method_t m) {
     return 1;
 }
 
+pa_resample_method_t pa_resample_method_cheaper(pa_resample_method_t m) {
+    pa_resample_method_t r;
+
+    switch (m) {
+        case PA_RESAMPLER_AUTO:
+#ifdef HAVE_SPEEX
+            return pa_resample_method_cheaper(PA_RESAMPLER_SPEEX_FLOAT_BASE + 3);
+#else
+            return pa_resample_method_cheaper(PA_RESAMPLER_FFMPEG);
+#endif
+
+        case PA_RESAMPLER_SRC_SINC_BEST_QUALITY:
+            r = PA_RESAMPLER_SRC_SINC_MEDIUM_QUALITY;
+            break;
+
+        case PA_RESAMPLER_SRC_SINC_MEDIUM_QUALITY:
+            r = PA_RESAMPLER_SRC_SINC_FASTEST;
+            break;
+
+        case PA_RESAMPLER_SRC_SINC_FASTEST:
+            r = PA_RESAMPLER_SRC_LINEAR;
+            break;
+
+        /* Both work on 16 bit integers */
+        case PA_RESAMPLER_FFMPEG:
+            r = PA_RESAMPLER_SPEEX_FIXED_BASE + 1;
+            break;
+
+        case PA_RESAMPLER_POLYPHASE:
+            r = PA_RESAMPLER_SPEEX_FLOAT_BASE + 1;
+            break;
+
+        default:
+            if ((m > PA_RESAMPLER_SPEEX_FLOAT_BASE && m <= PA_RESAMPLER_SPEEX_FLOAT_MAX) ||
+                (m > PA_RESAMPLER_SPEEX_FIXED_BASE && m <= PA_RESAMPLER_SPEEX_FIXED_MAX))
+                r = m - 1;
+            else
+                return PA_RESAMPLER_INVALID;
+    }
+
+    return pa_resample_method_supported(r) ? r : PA_RESAMPLER_INVALID;
+}
+
 pa_resample_method_t pa_parse_resample_method(const char *string) {
     pa_resample_method_t m;
 
@@ -1123,11 +1200,37 @@ static pa_memchunk* convert_to_work_format(pa_resampler *r, pa_memchunk *input)
     return &r->to_work_format_buf;
 }
 
+/* Converts and remaps in blocks small enough for the intermediate data
+ * to stay in the cache, instead of converting all of the input to
+ * to_work_format_buf first */
+static void convert_and_remap(pa_resampler *r, void *dst, const void *src, unsigned n_frames) {
+    size_t o_wfz;
+
+    pa_assert(r->to_work_format_func);
+    pa_assert(r->remap.do_remap);
+
+    if (!r->fuse_buf)
+        r->fuse_buf = pa_xmalloc(FUSE_FRAMES * r->w_sz * r->i_ss.channels);
+
+    o_wfz = r->w_sz * r->o_ss.channels;
+
+    while (n_frames > 0) {
+        unsigned n = PA_MIN(n_frames, FUSE_FRAMES);
+
+        r->to_work_format_func(n * r->i_ss.channels, src, r->fuse_buf);
+        r->remap.do_remap(&r->remap, dst, r->fuse_buf, n);
+
+        src = (const uint8_t*) src + n * r->i_fz;
+        dst = (uint8_t*) dst + n * o_wfz;
+        n_frames -= n;
+    }
+}
+
 static pa_memchunk *remap_channels(pa_resampler *r, pa_memchunk *input) {
     unsigned in_n_samples, out_n_samples, in_n_frames, out_n_frames;
     void *src, *dst;
     size_t leftover_length = 0;
-    pa_bool_t have_leftover;
+    pa_bool_t have_leftover, fuse;
 
     pa_assert(r);
     pa_assert(input);
@@ -1135,7 +1238,10 @@ static pa_memchunk *remap_channels(pa_resampler *r, pa_memchunk *input) {
 
     /* Remap channels and place the result in remap_buf. There may be leftover
      * data in the beginning of remap_buf. The leftover data is already
-     * remapped, so it's not part of the input, it's part of the output. */
+     * remapped, so it's not part of the input, it's part of the output.
+     *
+     * If the channels are remapped the input hasn't been converted to the
+     * work format yet, that happens here on the way. */
 
     have_leftover = r->remap_buf_contains_leftover_data;
     r->remap_buf_contains_leftover_data = FALSE;
@@ -1145,8 +1251,14 @@ static pa_memchunk *remap_channels(pa_resampler *r, pa_memchunk *input) {
     else if (input->length <= 0)
         return &r->remap_buf;
 
-    in_n_samples = (unsigned) (input->length / r->w_sz);
-    in_n_frames = out_n_frames = in_n_samples / r->i_ss.channels;
+    fuse = r->map_required && r->to_work_format_func;
+
+    if (fuse)
+        in_n_frames = out_n_frames = (unsigned) (input->length / r->i_fz);
+    else {
+        in_n_samples = (unsigned) (input->length / r->w_sz);
+        in_n_frames = out_n_frames = in_n_samples / r->i_ss.channels;
+    }
 
     if (have_leftover) {
         leftover_length = r->remap_buf.length;
@@ -1188,7 +1300,11 @@ static pa_memchunk *remap_channels(pa_resampler *r, pa_memchunk *input) {
         pa_remap_t *remap = &r->remap;
 
         pa_assert(remap->do_remap);
-        remap->do_remap(remap, dst, src, in_n_frames);
+
+        if (fuse)
+            convert_and_remap(r, dst, src, in_n_frames);
+        else
+            remap->do_remap(remap, dst, src, in_n_frames);
 
     } else
         memcpy(dst, src, input->length);
@@ -1283,7 +1399,11 @@ void pa_resampler_run(pa_resampler *r, const pa_memchunk *in, pa_memchunk *out)
     pa_assert(in->length % r->i_fz == 0);
 
     buf = (pa_memchunk*) in;
-    buf = convert_to_work_format(r, buf);
+
+    /* If the channels are remapped, that converts on the way */
+    if (!r->map_required)
+        buf = convert_to_work_format(r, buf);
+
     buf = remap_channels(r, buf);
     buf = resample(r, buf);
 
@@ -1482,7 +1602,7 @@ static int speex_init(pa_resampler *r) {
         pa_assert(r->method >= PA_RESAMPLER_SPEEX_FLOAT_BASE && r->method <= PA_RESAMPLER_SPEEX_FLOAT_MAX);
 
         q = r->method - PA_RESAMPLER_SPEEX_FLOAT_BASE;
-        r->impl_resample = speex_resample_float;
+        r->impl_resample = r->work_format == PA_SAMPLE_S16NE ? speex_resample_int : speex_resample_float;
     }
 
     pa_log_info("Choosing speex quality setting %i.", q);
@@ -1560,10 +1680,71 @@ static int trivial_init(pa_resampler*r) {
 
 /* Peak finder implementation */
 
+static void peaks_s16ne_c(void *max, const void *src, unsigned channels, unsigned n_frames) {
+    int16_t *m = max;
+    const int16_t *s = src;
+    unsigned c;
+
+    for (; n_frames > 0; n_frames--)
+        for (c = 0; c < channels; c++) {
+            int16_t n = (int16_t) PA_MIN(abs(*s++), 0x7FFF);
+
+            if (n > m[c])
+                m[c] = n;
+        }
+}
+
+static void peaks_float32ne_c(void *max, const void *src, unsigned channels, unsigned n_frames) {
+    float *m = max;
+    const float *s = src;
+    unsigned c;
+
+    /* Mono is the common case */
+    if (channels == 1) {
+        for (; n_frames > 0; n_frames--) {
+            float n = fabsf(*s++);
+
+            if (n > m[0])
+                m[0] = n;
+        }
+
+        return;
+    }
+
+    for (; n_frames > 0; n_frames--)
+        for (c = 0; c < channels; c++) {
+            float n = fabsf(*s++);
+
+            if (n > m[c])
+                m[c] = n;
+        }
+}
+
+static pa_peaks_func_t peaks_s16ne_func = peaks_s16ne_c;
+static pa_peaks_func_t peaks_float32ne_func = peaks_float32ne_c;
+
+pa_peaks_func_t pa_get_peaks_func(pa_sample_format_t f) {
+    pa_assert(f == PA_SAMPLE_S16NE || f == PA_SAMPLE_FLOAT32NE);
+
+    return f == PA_SAMPLE_S16NE ? peaks_s16ne_func : peaks_float32ne_func;
+}
+
+void pa_set_peaks_func(pa_sample_format_t f, pa_peaks_func_t func) {
+    pa_assert(f == PA_SAMPLE_S16NE || f == PA_SAMPLE_FLOAT32NE);
+    pa_assert(func);
+
+    if (f == PA_SAMPLE_S16NE)
+        peaks_s16ne_func = func;
+    else
+        peaks_float32ne_func = func;
+}
+
 static void peaks_resample(pa_resampler *r, const pa_memchunk *input, unsigned in_n_frames, pa_memchunk *output, unsigned *out_n_frames) {
-    unsigned c, o_index = 0;
+    unsigned c, o_index = 0, channels = r->o_ss.channels;
     unsigned i, i_end = 0;
-    void *src, *dst;
+    uint8_t *src, *dst;
+    void *max;
+    pa_peaks_func_t func;
 
     pa_assert(r);
     pa_assert(input);
@@ -1573,6 +1754,14 @@ static void peaks_resample(pa_resampler *r, const pa_memchunk *input, unsigned i
     src = (uint8_t*) pa_memblock_acquire(input->memblock) + input->index;
     dst = (uint8_t*) pa_memblock_acquire(output->memblock) + output->index;
 
+    if (r->work_format == PA_SAMPLE_S16NE) {
+        max = r->peaks.max_i;
+        func = peaks_s16ne_func;
+    } else {
+        max = r->peaks.max_f;
+        func = peaks_float32ne_func;
+    }
+
     i = (r->peaks.o_counter * r->i_ss.rate) / r->o_ss.rate;
     i = i > r->peaks.i_counter ? i - r->peaks.i_counter : 0;
 
@@ -1580,63 +1769,33 @@ static void peaks_resample(pa_resampler *r, const pa_memchunk *input, unsigned i
         i_end = ((r->peaks.o_counter+1) * r->i_ss.rate) / r->o_ss.rate;
         i_end = i_end > r->peaks.i_counter ? i_end - r->peaks.i_counter : 0;
 
-        pa_assert_fp(o_index * r->w_sz * r->o_ss.channels < pa_memblock_get_length(output->memblock));
-
-        /* 1ch float is treated separately, because that is the common case */
-        if (r->o_ss.channels == 1 && r->work_format == PA_SAMPLE_FLOAT32NE) {
-            float *s = (float*) src + i;
-            float *d = (float*) dst + o_index;
-
-            for (; i < i_end && i < in_n_frames; i++) {
-                float n = fabsf(*s++);
-
-                if (n > r->peaks.max_f[0])
-                    r->peaks.max_f[0] = n;
-            }
+        pa_assert_fp(o_index * r->w_sz * channels < pa_memblock_get_length(output->memblock));
 
-            if (i == i_end) {
-                *d = r->peaks.max_f[0];
-                r->peaks.max_f[0] = 0;
-                o_index++, r->peaks.o_counter++;
-            }
-        } else if (r->work_format == PA_SAMPLE_S16NE) {
-            int16_t *s = (int16_t*) src + r->i_ss.channels * i;
-            int16_t *d = (int16_t*) dst + r->o_ss.channels * o_index;
+        if (i < i_end && i < in_n_frames) {
+            unsigned n = PA_MIN(i_end, in_n_frames) - i;
 
-            for (; i < i_end && i < in_n_frames; i++)
-                for (c = 0; c < r->o_ss.channels; c++) {
-                    int16_t n = abs(*s++);
+            func(max, src + i * r->w_sz * channels, channels, n);
+            i += n;
+        }
 
-                    if (n > r->peaks.max_i[c])
-                        r->peaks.max_i[c] = n;
-                }
+        if (i == i_end) {
+            if (r->work_format == PA_SAMPLE_S16NE) {
+                int16_t *d = (int16_t*) dst + channels * o_index;
 
-            if (i == i_end) {
-                for (c = 0; c < r->o_ss.channels; c++, d++) {
+                for (c = 0; c < channels; c++, d++) {
                     *d = r->peaks.max_i[c];
                     r->peaks.max_i[c] = 0;
                 }
-                o_index++, r->peaks.o_counter++;
-            }
-        } else {
-            float *s = (float*) src + r->i_ss.channels * i;
-            float *d = (float*) dst + r->o_ss.channels * o_index;
-
-            for (; i < i_end && i < in_n_frames; i++)
-                for (c = 0; c < r->o_ss.channels; c++) {
-                    float n = fabsf(*s++);
-
-                    if (n > r->peaks.max_f[c])
-                        r->peaks.max_f[c] = n;
-                }
+            } else {
+                float *d = (float*) dst + channels * o_index;
 
-            if (i == i_end) {
-                for (c = 0; c < r->o_ss.channels; c++, d++) {
+                for (c = 0; c < channels; c++, d++) {
                     *d = r->peaks.max_f[c];
                     r->peaks.max_f[c] = 0;
                 }
-                o_index++, r->peaks.o_counter++;
             }
+
+            o_index++, r->peaks.o_counter++;
         }
     }
 
@@ -1679,6 +1838,518 @@ static int peaks_init(pa_resampler*r) {
     return 0;
 }
 
+/* The last input chunk seen, the result computed from it and the state
+ * of the resampler that did it afterwards */
+struct pa_resampler_peaks_share {
+    pa_memchunk in, out;
+
+    pa_sample_spec i_ss, o_ss;
+    pa_channel_map i_cm, o_cm;
+    pa_resample_flags_t flags;
+    pa_sample_format_t work_format;
+
+    struct peaks_state state;
+};
+
+pa_resampler_peaks_share* pa_resampler_peaks_share_new(void) {
+    pa_resampler_peaks_share *s;
+
+    s = pa_xnew0(pa_resampler_peaks_share, 1);
+    pa_memchunk_reset(&s->in);
+    pa_memchunk_reset(&s->out);
+
+    return s;
+}
+
+static void peaks_share_clear(pa_resampler_peaks_share *s) {
+    if (s->in.memblock)
+        pa_memblock_unref(s->in.memblock);
+    if (s->out.memblock)
+        pa_memblock_unref(s->out.memblock);
+
+    pa_memchunk_reset(&s->in);
+    pa_memchunk_reset(&s->out);
+}
+
+void pa_resampler_peaks_share_free(pa_resampler_peaks_share *s) {
+    pa_assert(s);
+
+    peaks_share_clear(s);
+    pa_xfree(s);
+}
+
+static pa_bool_t peaks_share_matches(pa_resampler_peaks_share *s, pa_resampler *r, const pa_memchunk *in) {
+
+    /* The share holds a reference to the input block, so it cannot
+     * have been modified in place or replaced by another one at the same
+     * address */
+    return
+        s->in.memblock == in->memblock &&
+        s->in.index == in->index &&
+        s->in.length == in->length &&
+        s->flags == r->flags &&
+        s->work_format == r->work_format &&
+        pa_sample_spec_equal(&s->i_ss, &r->i_ss) &&
+        pa_sample_spec_equal(&s->o_ss, &r->o_ss) &&
+        pa_channel_map_equal(&s->i_cm, &r->i_cm) &&
+        pa_channel_map_equal(&s->o_cm, &r->o_cm);
+}
+
+void pa_resampler_run_shared(pa_resampler *r, pa_resampler_peaks_share *s, const pa_memchunk *in, pa_memchunk *out) {
+    pa_assert(r);
+    pa_assert(s);
+    pa_assert(in);
+    pa_assert(out);
+
+    if (r->method != PA_RESAMPLER_PEAKS) {
+        pa_resampler_run(r, in, out);
+        return;
+    }
+
+    if (peaks_share_matches(s, r, in)) {
+        r->peaks = s->state;
+        *out = s->out;
+
+        if (out->memblock)
+            pa_memblock_ref(out->memblock);
+
+        return;
+    }
+
+    pa_resampler_run(r, in, out);
+
+    peaks_share_clear(s);
+
+    s->in = *in;
+    pa_memblock_ref(s->in.memblock);
+
+    s->out = *out;
+    if (s->out.memblock)
+        pa_memblock_ref(s->out.memblock);
+
+    s->i_ss = r->i_ss;
+    s->o_ss = r->o_ss;
+    s->i_cm = r->i_cm;
+    s->o_cm = r->o_cm;
+    s->flags = r->flags;
+    s->work_format = r->work_format;
+    s->state = r->peaks;
+}
+
+/*** polyphase FIR implementation ***/
+
+/* A Kaiser windowed sinc, evaluated at n_phases fractional offsets. For
+ * fixed rates the phases are exactly the o_rate/gcd positions an output
+ * frame can fall on. For variable rates there are POLYPHASE_PHASES of
+ * them, and the coefficients are interpolated linearly between the two
+ * phases around the actual position. Tables are shared through the
+ * resampler cache between all resamplers with the same rates and
+ * layout. */
+
+#define POLYPHASE_TAPS 48
+#define POLYPHASE_MAX_TAPS 256
+#define POLYPHASE_MAX_EXACT_PHASES 512
+#define POLYPHASE_PHASE_BITS 8
+#define POLYPHASE_PHASES (1U << POLYPHASE_PHASE_BITS)
+#define POLYPHASE_KAISER_BETA 8.0
+
+/* A filter designed for one rate ratio is still used for variable rates
+ * that stay within this factor of it */
+#define POLYPHASE_MAX_DRIFT 0.02
+
+struct polyphase_filter {
+    uint32_t i_rate, o_rate;
+    pa_bool_t interpolate, interleave;
+    unsigned n_phases, n_taps, row_len;
+    float *coefs;
+
+    unsigned ref;
+    PA_LLIST_FIELDS(polyphase_filter);
+};
+
+/* Filters no resampler uses any more are kept around for a while, as
+ * streams with the same rates tend to come and go */
+#define POLYPHASE_MAX_UNUSED 4
+
+struct pa_resampler_cache {
+    pa_mutex *mutex;
+    PA_LLIST_HEAD(polyphase_filter, polyphase_filters);
+    unsigned n_unused;
+};
+
+static double bessel_i0(double x) {
+    double sum = 1.0, term = 1.0;
+    unsigned k;
+
+    for (k = 1; k < 64 && term > sum * 1e-12; k++) {
+        term *= (x * x) / (4.0 * k * k);
+        sum += term;
+    }
+
+    return sum;
+}
+
+static void polyphase_design(polyphase_filter *f) {
+    double ratio, min_ratio, cutoff, i0_beta;
+    unsigned p, j;
+
+    ratio = (double) f->o_rate / f->i_rate;
+
+    /* Cut off a bit below the lower of the two Nyquist frequencies */
+    cutoff = ratio < 1.0 ? 0.915 * ratio : 0.96;
+
+    min_ratio = PA_MIN(ratio, 1.0);
+    f->n_taps = PA_ROUND_UP((unsigned) ceil(POLYPHASE_TAPS / min_ratio), 8U);
+    f->n_taps = PA_MIN(f->n_taps, (unsigned) POLYPHASE_MAX_TAPS);
+    f->row_len = f->interleave ? 2 * f->n_taps : f->n_taps;
+    f->coefs = pa_xnew(float, (f->n_phases + 1) * f->row_len);
+
+    i0_beta = bessel_i0(POLYPHASE_KAISER_BETA);
+
+    /* Phase p is for an output frame p/n_phases frames after input frame
+     * n_taps/2 - 1 of the window. One extra phase is added to
+     * interpolate towards. */
+    for (p = 0; p <= f->n_phases; p++) {
+        float *row = f->coefs + p * f->row_len;
+        double h[POLYPHASE_MAX_TAPS], sum = 0.0;
+
+        for (j = 0; j < f->n_taps; j++) {
+            double t = (double) p / f->n_phases + f->n_taps / 2 - 1 - j;
+            double x = t / (f->n_taps / 2), w, s;
+
+            w = fabs(x) < 1.0 ? bessel_i0(POLYPHASE_KAISER_BETA * sqrt(1.0 - x * x)) / i0_beta : 0.0;
+            s = fabs(t) < 1e-9 ? 1.0 : sin(M_PI * cutoff * t) / (M_PI * cutoff * t);
+
+            h[j] = s * w;
+            sum += h[j];
+        }
+
+        /* Keep the DC gain at 1 for every phase */
+        for (j = 0; j < f->n_taps; j++) {
+            if (f->interleave)
+                row[2 * j] = row[2 * j + 1] = (float) (h[j] / sum);
+            else
+                row[j] = (float) (h[j] / sum);
+        }
+    }
+}
+
+static uint32_t gcd(uint32_t a, uint32_t b) {
+    while (b) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
+static void polyphase_filter_free(polyphase_filter *f) {
+    pa_assert(f);
+
+    pa_xfree(f->coefs);
+    pa_xfree(f);
+}
+
+static polyphase_filter *polyphase_filter_get(pa_resampler_cache *c, uint32_t i_rate, uint32_t o_rate,
+                                              pa_bool_t interpolate, pa_bool_t interleave) {
+    polyphase_filter *f;
+    uint32_t g;
+
+    g = gcd(i_rate, o_rate);
+    i_rate /= g;
+    o_rate /= g;
+
+    if (c) {
+        pa_mutex_lock(c->mutex);
+
+        PA_LLIST_FOREACH(f, c->polyphase_filters)
+            if (f->i_rate == i_rate && f->o_rate == o_rate && f->interpolate == interpolate && f->interleave == interleave) {
+                if (f->ref++ == 0)
+                    c->n_unused--;
+
+                pa_mutex_unlock(c->mutex);
+                return f;
+            }
+    }
+
+    f = pa_xnew0(polyphase_filter, 1);
+    f->i_rate = i_rate;
+    f->o_rate = o_rate;
+    f->interpolate = interpolate;
+    f->interleave = interleave;
+    f->n_phases = interpolate ? POLYPHASE_PHASES : o_rate;
+    f->ref = 1;
+
+    polyphase_design(f);
+
+    pa_log_debug("Designed %s%u phase, %u tap polyphase filter for %u:%u.", interpolate ? "interpolated " : "",
+                 f->n_phases, f->n_taps, i_rate, o_rate);
+
+    if (c) {
+        PA_LLIST_PREPEND(polyphase_filter, c->polyphase_filters, f);
+        pa_mutex_unlock(c->mutex);
+    }
+
+    return f;
+}
+
+static void polyphase_filter_unref(pa_resampler_cache *c, polyphase_filter *f) {
+    polyphase_filter *i, *oldest = NULL;
+
+    pa_assert(f);
+    pa_assert(f->ref >= 1);
+
+    if (!c) {
+        polyphase_filter_free(f);
+        return;
+    }
+
+    pa_mutex_lock(c->mutex);
+
+    if (--f->ref == 0) {
+        /* Keep the list ordered by last use */
+        PA_LLIST_REMOVE(polyphase_filter, c->polyphase_filters, f);
+        PA_LLIST_PREPEND(polyphase_filter, c->polyphase_filters, f);
+
+        if (++c->n_unused > POLYPHASE_MAX_UNUSED) {
+            PA_LLIST_FOREACH(i, c->polyphase_filters)
+                if (i->ref == 0)
+                    oldest = i;
+
+            PA_LLIST_REMOVE(polyphase_filter, c->polyphase_filters, oldest);
+            polyphase_filter_free(oldest);
+            c->n_unused--;
+        }
+    }
+
+    pa_mutex_unlock(c->mutex);
+}
+
+pa_resampler_cache* pa_resampler_cache_new(void) {
+    pa_resampler_cache *c;
+
+    c = pa_xnew0(pa_resampler_cache, 1);
+    c->mutex = pa_mutex_new(FALSE, FALSE);
+    PA_LLIST_HEAD_INIT(polyphase_filter, c->polyphase_filters);
+
+    return c;
+}
+
+void pa_resampler_cache_free(pa_resampler_cache *c) {
+    polyphase_filter *f;
+
+    pa_assert(c);
+
+    while ((f = c->polyphase_filters)) {
+        pa_assert(f->ref == 0);
+
+        PA_LLIST_REMOVE(polyphase_filter, c->polyphase_filters, f);
+        polyphase_filter_free(f);
+    }
+
+    pa_mutex_free(c->mutex);
+    pa_xfree(c);
+}
+
+static void polyphase_c(float *dst, const float *src, const float *coefs0, const float *coefs1, float mu,
+                        unsigned n_taps, unsigned channels) {
+    unsigned c, j, stride;
+
+    stride = channels == 2 ? 2 : 1;
+
+    for (c = 0; c < channels; c++) {
+        const float *s = src + c;
+        const float *h0 = coefs0 + (stride > 1 ? c : 0);
+        const float *h1 = coefs1 ? coefs1 + (stride > 1 ? c : 0) : NULL;
+        float sum = 0.0f;
+
+        for (j = 0; j < n_taps; j++, s += channels) {
+            float h = h0[j * stride];
+
+            if (h1)
+                h += mu * (h1[j * stride] - h);
+
+            sum += h * *s;
+        }
+
+        dst[c] = sum;
+    }
+}
+
+static pa_polyphase_func_t polyphase_func = polyphase_c;
+
+pa_polyphase_func_t pa_get_polyphase_func(void) {
+    return polyphase_func;
+}
+
+void pa_set_polyphase_func(pa_polyphase_func_t func) {
+    pa_assert(func);
+
+    polyphase_func = func;
+}
+
+static void polyphase_reset(pa_resampler *r) {
+    unsigned history;
+
+    pa_assert(r);
+
+    /* Start out with silence before the first input frame, so that the
+     * first output frame is centered on it */
+    history = r->polyphase.filter->n_taps / 2 - 1;
+
+    memset(r->polyphase.buf, 0, history * r->o_ss.channels * sizeof(float));
+    r->polyphase.n_frames = history;
+    r->polyphase.index = 0;
+    r->polyphase.phase = 0;
+    r->polyphase.frac = 0;
+}
+
+static void polyphase_update_rates(pa_resampler *r) {
+    polyphase_filter *f;
+    double drift;
+
+    pa_assert(r);
+
+    f = r->polyphase.filter;
+
+    /* Keep the current position when switching phase representations */
+    if (!f->interpolate)
+        r->polyphase.frac = (uint32_t) (((uint64_t) r->polyphase.phase << 32) / f->n_phases);
+
+    drift = ((double) r->o_ss.rate * f->i_rate) / ((double) r->i_ss.rate * f->o_rate);
+
+    if (!f->interpolate || fabs(drift - 1.0) > POLYPHASE_MAX_DRIFT) {
+        unsigned old_half = f->n_taps / 2, half;
+
+        r->polyphase.filter = polyphase_filter_get(r->cache, r->i_ss.rate, r->o_ss.rate, TRUE, r->o_ss.channels == 2);
+        polyphase_filter_unref(r->cache, f);
+        f = r->polyphase.filter;
+
+        /* Move the start of the window so that it stays centered on the
+         * same frame, padding with silence in front if necessary */
+        half = f->n_taps / 2;
+
+        if (half > old_half + r->polyphase.index) {
+            unsigned channels = r->o_ss.channels, pad = half - old_half - r->polyphase.index;
+
+            if (r->polyphase.n_frames + pad > r->polyphase.max_frames) {
+                r->polyphase.max_frames = r->polyphase.n_frames + pad;
+                r->polyphase.buf = pa_xrealloc(r->polyphase.buf, (r->polyphase.max_frames * channels + 8) * sizeof(float));
+            }
+
+            memmove(r->polyphase.buf + pad * channels, r->polyphase.buf, r->polyphase.n_frames * channels * sizeof(float));
+            memset(r->polyphase.buf, 0, pad * channels * sizeof(float));
+            r->polyphase.n_frames += pad;
+            r->polyphase.index += pad;
+        }
+
+        r->polyphase.index = r->polyphase.index + old_half - half;
+    }
+
+    r->polyphase.step = ((uint64_t) r->i_ss.rate << 32) / r->o_ss.rate;
+}
+
+static void polyphase_resample(pa_resampler *r, const pa_memchunk *input, unsigned in_n_frames, pa_memchunk *output, unsigned *out_n_frames) {
+    polyphase_filter *f;
+    unsigned channels, o_index = 0, consumed;
+    float *src, *dst;
+
+    pa_assert(r);
+    pa_assert(input);
+    pa_assert(output);
+    pa_assert(out_n_frames);
+
+    f = r->polyphase.filter;
+    channels = r->o_ss.channels;
+
+    /* Append the input to the frames kept from the last run. The kernels
+     * may read a few samples past the last frame, hence the padding. */
+    if (r->polyphase.n_frames + in_n_frames > r->polyphase.max_frames) {
+        r->polyphase.max_frames = r->polyphase.n_frames + in_n_frames;
+        r->polyphase.buf = pa_xrealloc(r->polyphase.buf, (r->polyphase.max_frames * channels + 8) * sizeof(float));
+    }
+
+    src = (float*) ((uint8_t*) pa_memblock_acquire(input->memblock) + input->index);
+    memcpy(r->polyphase.buf + r->polyphase.n_frames * channels, src, in_n_frames * channels * sizeof(float));
+    pa_memblock_release(input->memblock);
+
+    r->polyphase.n_frames += in_n_frames;
+
+    dst = (float*) ((uint8_t*) pa_memblock_acquire(output->memblock) + output->index);
+
+    while (o_index < *out_n_frames && r->polyphase.index + f->n_taps <= r->polyphase.n_frames) {
+        const float *s = r->polyphase.buf + r->polyphase.index * channels;
+
+        if (f->interpolate) {
+            unsigned p = r->polyphase.frac >> (32 - POLYPHASE_PHASE_BITS);
+            float mu = (float) (r->polyphase.frac & ((1U << (32 - POLYPHASE_PHASE_BITS)) - 1)) / (float) (1U << (32 - POLYPHASE_PHASE_BITS));
+            uint64_t t;
+
+            polyphase_func(dst + o_index * channels, s, f->coefs + p * f->row_len, f->coefs + (p + 1) * f->row_len,
+                           mu, f->n_taps, channels);
+
+            t = (uint64_t) r->polyphase.frac + (r->polyphase.step & 0xFFFFFFFFU);
+            r->polyphase.index += (unsigned) (r->polyphase.step >> 32) + (unsigned) (t >> 32);
+            r->polyphase.frac = (uint32_t) t;
+        } else {
+            polyphase_func(dst + o_index * channels, s, f->coefs + r->polyphase.phase * f->row_len, NULL,
+                           0.0f, f->n_taps, channels);
+
+            r->polyphase.phase += f->i_rate;
+            r->polyphase.index += r->polyphase.phase / f->o_rate;
+            r->polyphase.phase %= f->o_rate;
+        }
+
+        o_index++;
+    }
+
+    pa_memblock_release(output->memblock);
+
+    /* Drop the frames no future output frame needs */
+    consumed = PA_MIN(r->polyphase.index, r->polyphase.n_frames);
+    memmove(r->polyphase.buf, r->polyphase.buf + consumed * channels, (r->polyphase.n_frames - consumed) * channels * sizeof(float));
+    r->polyphase.n_frames -= consumed;
+    r->polyphase.index -= consumed;
+
+    *out_n_frames = o_index;
+}
+
+static void polyphase_free(pa_resampler *r) {
+    pa_assert(r);
+
+    if (r->polyphase.filter)
+        polyphase_filter_unref(r->cache, r->polyphase.filter);
+
+    pa_xfree(r->polyphase.buf);
+}
+
+static int polyphase_init(pa_resampler *r) {
+    uint32_t g;
+    pa_bool_t interpolate;
+
+    pa_assert(r);
+    pa_assert(r->work_format == PA_SAMPLE_FLOAT32NE);
+
+    g = gcd(r->i_ss.rate, r->o_ss.rate);
+    interpolate = (r->flags & PA_RESAMPLER_VARIABLE_RATE) || r->o_ss.rate / g > POLYPHASE_MAX_EXACT_PHASES;
+
+    r->polyphase.filter = polyphase_filter_get(r->cache, r->i_ss.rate, r->o_ss.rate, interpolate, r->o_ss.channels == 2);
+    r->polyphase.step = ((uint64_t) r->i_ss.rate << 32) / r->o_ss.rate;
+
+    r->polyphase.max_frames = POLYPHASE_MAX_TAPS;
+    r->polyphase.buf = pa_xnew(float, r->polyphase.max_frames * r->o_ss.channels + 8);
+
+    polyphase_reset(r);
+
+    r->impl_free = polyphase_free;
+    r->impl_update_rates = polyphase_update_rates;
+    r->impl_resample = polyphase_resample;
+    r->impl_reset = polyphase_reset;
+
+    return 0;
+}
+
 /*** ffmpeg based implementation ***/
 
 static void ffmpeg_resample(pa_resampler *r, const pa_memchunk *input, unsigned in_n_frames, pa_memchunk *output, unsigned *out_n_frames) {
@@ -28,6 +28,7 @@
 #include <pulsecore/memchunk.h>
 
 typedef struct pa_resampler pa_resampler;
+typedef struct pa_resampler_cache pa_resampler_cache;
 
 typedef enum pa_resample_method {
     PA_RESAMPLER_INVALID                 = -1,
@@ -45,6 +46,7 @@ typedef enum pa_resample_method {
     PA_RESAMPLER_AUTO, /* automatic select based on sample format */
     PA_RESAMPLER_COPY,
     PA_RESAMPLER_PEAKS,
+    PA_RESAMPLER_POLYPHASE,
     PA_RESAMPLER_MAX
 } pa_resample_method_t;
 
@@ -55,8 +57,15 @@ typedef enum pa_resample_flags {
     PA_RESAMPLER_NO_LFE        = 0x0008U
 } pa_resample_flags_t;
 
+/* Filter tables that can be shared between resamplers are kept in a
+ * cache, which normally is the one of the core. Without a cache every
+ * resampler computes its own tables. */
+pa_resampler_cache* pa_resampler_cache_new(void);
+void pa_resampler_cache_free(pa_resampler_cache *c);
+
 pa_resampler* pa_resampler_new(
         pa_mempool *pool,
+        pa_resampler_cache *cache,
         const pa_sample_spec *a,
         const pa_channel_map *am,
         const pa_sample_spec *b,
@@ -99,6 +108,45 @@ const char *pa_resample_method_to_string(pa_resample_method_t m);
 /* Return 1 when the specified resampling method is supported */
 int pa_resample_method_supported(pa_resample_method_t m);
 
+/* Return a method that takes less CPU time than m and resamples
+ * worse, or PA_RESAMPLER_INVALID if there is none */
+pa_resample_method_t pa_resample_method_cheaper(pa_resample_method_t m);
+
+/* Computes one output frame of the polyphase resampler from n_taps
+ * interleaved float frames at src. coefs0 is the filter phase to use,
+ * or if coefs1 is not NULL, the filter is coefs0 + mu * (coefs1 -
+ * coefs0). For stereo every coefficient is stored twice in a row, so
+ * that the filter runs parallel to the samples. n_taps is a multiple of
+ * 8, and up to 7 samples past the last frame may be read. */
+typedef void (*pa_polyphase_func_t) (float *dst, const float *src, const float *coefs0, const float *coefs1, float mu,
+                                     unsigned n_taps, unsigned channels);
+
+pa_polyphase_func_t pa_get_polyphase_func(void);
+void pa_set_polyphase_func(pa_polyphase_func_t func);
+
+/* Raises max[c] to the largest absolute value of channel c in n_frames
+ * interleaved frames at src. For S16NE, -32768 counts as 32767. */
+typedef void (*pa_peaks_func_t) (void *max, const void *src, unsigned channels, unsigned n_frames);
+
+/* Only PA_SAMPLE_S16NE and PA_SAMPLE_FLOAT32NE are supported */
+pa_peaks_func_t pa_get_peaks_func(pa_sample_format_t f);
+void pa_set_peaks_func(pa_sample_format_t f, pa_peaks_func_t func);
+
+/* Peak detecting resamplers with the same specs that are fed the very
+ * same chunk, like the outputs of one source usually are, can share
+ * one result. To be used by one thread only. */
+typedef struct pa_resampler_peaks_share pa_resampler_peaks_share;
+
+pa_resampler_peaks_share* pa_resampler_peaks_share_new(void);
+void pa_resampler_peaks_share_free(pa_resampler_peaks_share *s);
+
+/* Like pa_resampler_run(), but if r is a peak detecting resampler and
+ * the result for this input chunk is already in s, that is returned
+ * and r takes over the state of the resampler that computed it, which
+ * may move where its output frames start once. Otherwise the result is
+ * remembered in s. */
+void pa_resampler_run_shared(pa_resampler *r, pa_resampler_peaks_share *s, const pa_memchunk *in, pa_memchunk *out);
+
 const pa_channel_map* pa_resampler_input_channel_map(pa_resampler *r);
 const pa_sample_spec* pa_resampler_input_sample_spec(pa_resampler *r);
 const pa_channel_map* pa_resampler_output_channel_map(pa_resampler *r);
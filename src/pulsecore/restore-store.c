@@ -0,0 +1,371 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <errno.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-error.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/refcnt.h>
+#include <pulsecore/shared.h>
+
+#include "restore-store.h"
+
+/* Marks the namespaces whose old database has been imported */
+#define IMPORTED_PREFIX "restore-store:imported:"
+
+typedef struct store {
+    PA_REFCNT_DECLARE;
+
+    pa_core *core;
+    pa_database *database;
+    pa_time_event *save_time_event;
+} store;
+
+struct pa_restore_db {
+    store *store;
+    char *name;
+
+    /* The name followed by a colon, the keys of the namespace start
+     * with that */
+    char *prefix;
+    size_t prefix_length;
+};
+
+static store* store_get(pa_core *c) {
+    store *s;
+    char *fn;
+    pa_database *database;
+
+    if ((s = pa_shared_get(c, "restore-store"))) {
+        PA_REFCNT_INC(s);
+        return s;
+    }
+
+    if (!(fn = pa_state_path("restore", TRUE)))
+        return NULL;
+
+    if (!(database = pa_database_open(fn, TRUE))) {
+        pa_log("Failed to open restore database '%s': %s", fn, pa_cstrerror(errno));
+        pa_xfree(fn);
+        return NULL;
+    }
+
+    pa_log_info("Successfully opened database file '%s'.", fn);
+    pa_xfree(fn);
+
+    s = pa_xnew0(store, 1);
+    PA_REFCNT_INIT(s);
+    s->core = c;
+    s->database = database;
+
+    pa_assert_se(pa_shared_set(c, "restore-store", s) >= 0);
+
+    return s;
+}
+
+static void store_sync(store *s) {
+    if (s->save_time_event) {
+        s->core->mainloop->time_free(s->save_time_event);
+        s->save_time_event = NULL;
+    }
+
+    pa_database_sync(s->database);
+    pa_log_info("Synced.");
+}
+
+static void store_unref(store *s) {
+    pa_assert(s);
+    pa_assert(PA_REFCNT_VALUE(s) >= 1);
+
+    if (PA_REFCNT_DEC(s) > 0) {
+        /* The module going away may have changes pending */
+        if (s->save_time_event)
+            store_sync(s);
+
+        return;
+    }
+
+    if (s->save_time_event)
+        s->core->mainloop->time_free(s->save_time_event);
+
+    pa_assert_se(pa_shared_remove(s->core, "restore-store") >= 0);
+
+    /* Writes everything back before returning */
+    pa_database_close(s->database);
+    pa_xfree(s);
+}
+
+static void save_time_callback(pa_mainloop_api *a, pa_time_event *e, const struct timeval *t, void *userdata) {
+    store *s = userdata;
+
+    pa_assert(s);
+    pa_assert(e == s->save_time_event);
+
+    store_sync(s);
+}
+
+/* Returns the key key has in the database, to be freed with
+ * pa_datum_free() */
+static void make_key(pa_restore_db *db, const pa_datum *key, pa_datum *full) {
+    full->size = db->prefix_length + key->size;
+    full->data = pa_xmalloc(full->size);
+
+    memcpy(full->data, db->prefix, db->prefix_length);
+
+    if (key->size > 0)
+        memcpy((uint8_t*) full->data + db->prefix_length, key->data, key->size);
+}
+
+static pa_bool_t in_namespace(pa_restore_db *db, const pa_datum *full) {
+    return full->size >= db->prefix_length && memcmp(full->data, db->prefix, db->prefix_length) == 0;
+}
+
+/* Finds the first key of the namespace from full on, which is freed,
+ * and returns it in key */
+static pa_datum* seek(pa_restore_db *db, pa_datum *full, pa_datum *key, pa_datum *data) {
+
+    for (;;) {
+        pa_datum next;
+        pa_bool_t found;
+
+        if (in_namespace(db, full)) {
+            key->size = full->size - db->prefix_length;
+            key->data = key->size > 0 ? pa_xmemdup((uint8_t*) full->data + db->prefix_length, key->size) : NULL;
+
+            if (data)
+                pa_assert_se(pa_database_get(db->store->database, full, data));
+
+            pa_datum_free(full);
+            return key;
+        }
+
+        found = !!pa_database_next(db->store->database, full, &next, NULL);
+        pa_datum_free(full);
+
+        if (!found)
+            return NULL;
+
+        *full = next;
+    }
+}
+
+static void import(pa_restore_db *db) {
+    pa_datum marker, full, key, next, data;
+    pa_database *old;
+    pa_bool_t done;
+    unsigned n = 0;
+    char *fn;
+
+    marker.data = pa_sprintf_malloc(IMPORTED_PREFIX "%s", db->name);
+    marker.size = strlen(marker.data);
+
+    if (pa_database_get(db->store->database, &marker, &data)) {
+        pa_datum_free(&data);
+        pa_datum_free(&marker);
+        return;
+    }
+
+    if ((fn = pa_state_path(db->name, TRUE)) && (old = pa_database_open(fn, FALSE))) {
+
+        done = !pa_database_first(old, &key, &data);
+
+        while (!done) {
+            done = !pa_database_next(old, &key, &next, NULL);
+
+            make_key(db, &key, &full);
+
+            if (pa_database_set(db->store->database, &full, &data, FALSE) == 0)
+                n++;
+
+            pa_datum_free(&full);
+            pa_datum_free(&data);
+            pa_datum_free(&key);
+
+            if (!done) {
+                key = next;
+                pa_assert_se(pa_database_get(old, &key, &data));
+            }
+        }
+
+        pa_database_close(old);
+
+        if (n > 0)
+            pa_log_info("Imported %u entries from database file '%s'.", n, fn);
+    }
+
+    pa_xfree(fn);
+
+    data.data = (char*) "1";
+    data.size = 1;
+    pa_database_set(db->store->database, &marker, &data, TRUE);
+    pa_datum_free(&marker);
+
+    pa_restore_db_save(db);
+}
+
+pa_restore_db* pa_restore_db_open(pa_core *c, const char *name) {
+    pa_restore_db *db;
+    store *s;
+
+    pa_assert(c);
+    pa_assert(name);
+    /* Neither may overlap with the other namespaces nor the markers */
+    pa_assert(!strchr(name, ':'));
+    pa_assert(!pa_streq(name, "restore-store"));
+
+    if (!(s = store_get(c)))
+        return NULL;
+
+    db = pa_xnew0(pa_restore_db, 1);
+    db->store = s;
+    db->name = pa_xstrdup(name);
+    db->prefix = pa_sprintf_malloc("%s:", name);
+    db->prefix_length = strlen(db->prefix);
+
+    import(db);
+
+    return db;
+}
+
+void pa_restore_db_close(pa_restore_db *db) {
+    pa_assert(db);
+
+    store_unref(db->store);
+
+    pa_xfree(db->name);
+    pa_xfree(db->prefix);
+    pa_xfree(db);
+}
+
+pa_datum* pa_restore_db_get(pa_restore_db *db, const pa_datum *key, pa_datum* data) {
+    pa_datum full, *r;
+
+    pa_assert(db);
+    pa_assert(key);
+    pa_assert(data);
+
+    make_key(db, key, &full);
+    r = pa_database_get(db->store->database, &full, data);
+    pa_datum_free(&full);
+
+    return r;
+}
+
+int pa_restore_db_set(pa_restore_db *db, const pa_datum *key, const pa_datum* data, pa_bool_t overwrite) {
+    pa_datum full;
+    int r;
+
+    pa_assert(db);
+    pa_assert(key);
+    pa_assert(data);
+
+    make_key(db, key, &full);
+    r = pa_database_set(db->store->database, &full, data, overwrite);
+    pa_datum_free(&full);
+
+    return r;
+}
+
+int pa_restore_db_unset(pa_restore_db *db, const pa_datum *key) {
+    pa_datum full;
+    int r;
+
+    pa_assert(db);
+    pa_assert(key);
+
+    make_key(db, key, &full);
+    r = pa_database_unset(db->store->database, &full);
+    pa_datum_free(&full);
+
+    return r;
+}
+
+int pa_restore_db_clear(pa_restore_db *db) {
+    pa_datum full, next;
+    pa_bool_t done;
+    int r = 0;
+
+    pa_assert(db);
+
+    done = !pa_database_first(db->store->database, &full, NULL);
+
+    while (!done) {
+        /* Step ahead first, the removed key can't be continued from */
+        done = !pa_database_next(db->store->database, &full, &next, NULL);
+
+        if (in_namespace(db, &full) && pa_database_unset(db->store->database, &full) < 0)
+            r = -1;
+
+        pa_datum_free(&full);
+        full = next;
+    }
+
+    return r;
+}
+
+pa_datum* pa_restore_db_first(pa_restore_db *db, pa_datum *key, pa_datum *data) {
+    pa_datum full;
+
+    pa_assert(db);
+    pa_assert(key);
+
+    if (!pa_database_first(db->store->database, &full, NULL))
+        return NULL;
+
+    return seek(db, &full, key, data);
+}
+
+pa_datum* pa_restore_db_next(pa_restore_db *db, const pa_datum *key, pa_datum *next, pa_datum *data) {
+    pa_datum full, n;
+    pa_bool_t found;
+
+    pa_assert(db);
+    pa_assert(next);
+
+    if (!key)
+        return pa_restore_db_first(db, next, data);
+
+    make_key(db, key, &full);
+    found = !!pa_database_next(db->store->database, &full, &n, NULL);
+    pa_datum_free(&full);
+
+    if (!found)
+        return NULL;
+
+    return seek(db, &n, next, data);
+}
+
+void pa_restore_db_save(pa_restore_db *db) {
+    pa_assert(db);
+
+    if (db->store->save_time_event)
+        return;
+
+    db->store->save_time_event = pa_core_rttime_new(db->store->core, pa_rtclock_now() + PA_RESTORE_SAVE_INTERVAL, save_time_callback, db->store);
+}
@@ -0,0 +1,60 @@
+#ifndef foorestorestorehfoo
+#define foorestorestorehfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulsecore/core.h>
+#include <pulsecore/database.h>
+
+/* One database for all the modules that remember things across
+ * restarts, such as module-stream-restore and module-card-restore.
+ * Each module opens a namespace in it, which works like a database of
+ * its own: the keys of the other namespaces are invisible to it.
+ *
+ * Changes are written back together, by a single timer, a while
+ * after the first one was made. The first time a namespace is opened
+ * the database the module used to keep on its own is copied into it. */
+
+typedef struct pa_restore_db pa_restore_db;
+
+/* How long after a change all pending changes are written */
+#define PA_RESTORE_SAVE_INTERVAL (10 * PA_USEC_PER_SEC)
+
+/* Opens the namespace name, which is also the name of the database of
+ * the old file that is imported into it */
+pa_restore_db* pa_restore_db_open(pa_core *c, const char *name);
+
+/* Writes pending changes back, if this was the last namespace open
+ * waits for them to reach the disk */
+void pa_restore_db_close(pa_restore_db *db);
+
+/* These work as their pa_database counterparts */
+pa_datum* pa_restore_db_get(pa_restore_db *db, const pa_datum *key, pa_datum* data);
+int pa_restore_db_set(pa_restore_db *db, const pa_datum *key, const pa_datum* data, pa_bool_t overwrite);
+int pa_restore_db_unset(pa_restore_db *db, const pa_datum *key);
+int pa_restore_db_clear(pa_restore_db *db);
+pa_datum* pa_restore_db_first(pa_restore_db *db, pa_datum *key, pa_datum *data /* may be NULL */);
+pa_datum* pa_restore_db_next(pa_restore_db *db, const pa_datum *key, pa_datum *next, pa_datum *data /* may be NULL */);
+
+/* Schedules writing the changes back. Several calls before that
+ * happens, for any of the namespaces, result in one write. */
+void pa_restore_db_save(pa_restore_db *db);
+
+#endif
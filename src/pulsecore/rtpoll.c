@@ -29,23 +29,41 @@
 #include <string.h>
 #include <errno.h>
 
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_SYS_TIMERFD_H)
+#define USE_EPOLL
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#endif
+
 #include <pulse/xmalloc.h>
 #include <pulse/timeval.h>
 
 #include <pulsecore/poll.h>
+#include <pulsecore/atomic.h>
 #include <pulsecore/core-error.h>
 #include <pulsecore/core-rtclock.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/llist.h>
 #include <pulsecore/flist.h>
+#include <pulsecore/histogram.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/ratelimit.h>
+#include <pulsecore/trace.h>
 #include <pulse/rtclock.h>
 
 #include "rtpoll.h"
 
 /* #define DEBUG_TIMING */
 
+#ifdef USE_EPOLL
+/* epoll data value used for the timerfd, all others are pollfd indexes */
+#define EPOLL_TIMER_SLOT ((uint32_t) -1)
+#endif
+
+/* How many queued messages an asyncmsgq item handles before the loop
+ * restarts */
+#define ASYNCMSGQ_BATCH_MAX 32
+
 struct pa_rtpoll {
     struct pollfd *pollfd, *pollfd2;
     unsigned n_pollfd_alloc, n_pollfd_used;
@@ -59,11 +77,38 @@ struct pa_rtpoll {
     pa_bool_t quit:1;
     pa_bool_t timer_elapsed:1;
 
+    /* How late we woke up for the timer */
+    pa_histogram lateness;
+
+    /* When we woke up, for pa_rtpoll_now() */
+    pa_usec_t now;
+    pa_bool_t now_valid:1;
+
+    /* The CPU time of the thread at the last pa_rtpoll_run(), and what
+     * it used since it first ran, readable from other threads */
+    pa_usec_t cpu_last;
+    pa_atomic_t cpu_usec;
+
 #ifdef DEBUG_TIMING
     pa_usec_t timestamp;
     pa_usec_t slept, awake;
 #endif
 
+#ifdef USE_EPOLL
+    /* If epoll_fd is >= 0 we sleep in epoll_wait() instead of
+     * ppoll(). The fds stay registered across iterations, registered[]
+     * mirrors fd and events of what has been registered for each
+     * pollfd slot, so that only changes need to be passed on to the
+     * kernel. The timer is a timerfd armed with an absolute time. */
+    int epoll_fd, timer_fd;
+    struct pollfd *registered;
+    unsigned n_registered;
+    struct epoll_event *epoll_events;
+    struct timeval timer_armed_at;
+    pa_bool_t timer_armed:1;
+    pa_bool_t epoll_resync:1;
+#endif
+
     PA_LLIST_HEAD(pa_rtpoll_item, items);
 };
 
@@ -86,6 +131,216 @@ struct pa_rtpoll_item {
 
 PA_STATIC_FLIST_DECLARE(items, 0, pa_xfree);
 
+#ifdef USE_EPOLL
+static void epoll_done(pa_rtpoll *p) {
+    pa_assert(p);
+
+    if (p->epoll_fd >= 0)
+        pa_close(p->epoll_fd);
+
+    if (p->timer_fd >= 0)
+        pa_close(p->timer_fd);
+
+    p->epoll_fd = p->timer_fd = -1;
+
+    pa_xfree(p->registered);
+    p->registered = NULL;
+    p->n_registered = 0;
+
+    pa_xfree(p->epoll_events);
+    p->epoll_events = NULL;
+}
+
+static void epoll_init(pa_rtpoll *p) {
+    struct epoll_event ev;
+
+    pa_assert(p);
+
+    p->timer_fd = -1;
+
+    if ((p->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        pa_log_debug("epoll_create1() failed, using ppoll(): %s", pa_cstrerror(errno));
+        return;
+    }
+
+    if ((p->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC|TFD_NONBLOCK)) < 0) {
+        pa_log_debug("timerfd_create() failed, using ppoll(): %s", pa_cstrerror(errno));
+        epoll_done(p);
+        return;
+    }
+
+    pa_zero(ev);
+    ev.events = EPOLLIN;
+    ev.data.u32 = EPOLL_TIMER_SLOT;
+
+    if (epoll_ctl(p->epoll_fd, EPOLL_CTL_ADD, p->timer_fd, &ev) < 0) {
+        pa_log_debug("Failed to add timerfd to epoll set, using ppoll(): %s", pa_cstrerror(errno));
+        epoll_done(p);
+        return;
+    }
+
+    p->registered = pa_xnew(struct pollfd, p->n_pollfd_alloc);
+    p->epoll_events = pa_xnew(struct epoll_event, p->n_pollfd_alloc + 1);
+}
+
+static int epoll_update(pa_rtpoll *p) {
+    struct epoll_event ev;
+    unsigned k;
+
+    pa_assert(p);
+
+    if (p->epoll_resync) {
+        /* The slots have been reshuffled, start from scratch. Errors are
+         * ignored here, the fd might have been closed already, which
+         * drops it from the set anyway. */
+        for (k = 0; k < p->n_registered; k++)
+            if (p->registered[k].fd >= 0)
+                epoll_ctl(p->epoll_fd, EPOLL_CTL_DEL, p->registered[k].fd, NULL);
+
+        p->n_registered = 0;
+        p->epoll_resync = FALSE;
+    }
+
+    for (k = 0; k < p->n_pollfd_used; k++) {
+        struct pollfd *want = p->pollfd + k, *have = p->registered + k;
+        pa_bool_t had = k < p->n_registered && have->fd >= 0;
+        int op;
+
+        if (had && have->fd == want->fd && have->events == want->events)
+            continue;
+
+        if (had && have->fd != want->fd) {
+            epoll_ctl(p->epoll_fd, EPOLL_CTL_DEL, have->fd, NULL);
+            had = FALSE;
+        }
+
+        have->fd = want->fd;
+        have->events = want->events;
+
+        if (want->fd < 0)
+            continue;
+
+        /* On Linux the poll() and epoll() event bits are identical */
+        pa_zero(ev);
+        ev.events = (uint32_t) want->events;
+        ev.data.u32 = k;
+
+        op = had ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+
+        if (epoll_ctl(p->epoll_fd, op, want->fd, &ev) < 0) {
+            have->fd = -1;
+            p->n_registered = PA_MAX(p->n_registered, k + 1);
+            return -1;
+        }
+    }
+
+    for (; k < p->n_registered; k++)
+        if (p->registered[k].fd >= 0)
+            epoll_ctl(p->epoll_fd, EPOLL_CTL_DEL, p->registered[k].fd, NULL);
+
+    p->n_registered = p->n_pollfd_used;
+
+    return 0;
+}
+
+static void epoll_sync(pa_rtpoll *p) {
+    pa_assert(p);
+
+    if (epoll_update(p) >= 0)
+        return;
+
+    /* Maybe an fd just moved to another slot, try once more from
+     * scratch. If that doesn't work either, the set contains something
+     * epoll cannot handle (the same fd twice, a regular file, ...) */
+    p->epoll_resync = TRUE;
+
+    if (epoll_update(p) >= 0)
+        return;
+
+    pa_log_debug("Cannot use epoll() for this poll set, falling back to ppoll(): %s", pa_cstrerror(errno));
+    epoll_done(p);
+}
+
+static int epoll_arm_timer(pa_rtpoll *p, pa_bool_t enable) {
+    struct itimerspec its;
+
+    pa_assert(p);
+
+    if (enable) {
+        if (p->timer_armed && pa_timeval_cmp(&p->timer_armed_at, &p->next_elapse) == 0)
+            return 0;
+
+        pa_zero(its);
+        its.it_value.tv_sec = p->next_elapse.tv_sec;
+        its.it_value.tv_nsec = p->next_elapse.tv_usec * PA_NSEC_PER_USEC;
+
+        /* All zero would disarm the timer instead */
+        if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0)
+            its.it_value.tv_nsec = 1;
+
+        if (timerfd_settime(p->timer_fd, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+            return -1;
+
+        p->timer_armed_at = p->next_elapse;
+        p->timer_armed = TRUE;
+
+    } else if (p->timer_armed) {
+
+        pa_zero(its);
+
+        if (timerfd_settime(p->timer_fd, 0, &its, NULL) < 0)
+            return -1;
+
+        p->timer_armed = FALSE;
+    }
+
+    return 0;
+}
+
+static int epoll_poll(pa_rtpoll *p, pa_bool_t wait_op) {
+    pa_bool_t block = wait_op && !p->quit;
+    int r, k, n = 0;
+    unsigned j;
+
+    pa_assert(p);
+
+    if (block && epoll_arm_timer(p, p->timer_enabled) < 0)
+        return -1;
+
+    r = epoll_wait(p->epoll_fd, p->epoll_events, (int) p->n_pollfd_used + 1, block ? -1 : 0);
+
+    if (r < 0)
+        return r;
+
+    for (j = 0; j < p->n_pollfd_used; j++)
+        p->pollfd[j].revents = 0;
+
+    for (k = 0; k < r; k++) {
+        uint32_t slot = p->epoll_events[k].data.u32;
+
+        if (slot == EPOLL_TIMER_SLOT) {
+            uint64_t expirations;
+
+            pa_read(p->timer_fd, &expirations, sizeof(expirations), NULL);
+
+            /* The timer is one-shot, if next_elapse stays the same the
+             * next iteration has to return right away, like ppoll()
+             * does with a timeout in the past */
+            p->timer_armed = FALSE;
+            continue;
+        }
+
+        pa_assert(slot < p->n_pollfd_used);
+        p->pollfd[slot].revents = (short) p->epoll_events[k].events;
+        n++;
+    }
+
+    /* Like ppoll() return the number of fds with events, so that 0
+     * means the timer elapsed */
+    return n;
+}
+#endif
+
 pa_rtpoll *pa_rtpoll_new(void) {
     pa_rtpoll *p;
 
@@ -95,6 +350,13 @@ pa_rtpoll *pa_rtpoll_new(void) {
     p->pollfd = pa_xnew(struct pollfd, p->n_pollfd_alloc);
     p->pollfd2 = pa_xnew(struct pollfd, p->n_pollfd_alloc);
 
+    pa_histogram_init(&p->lateness);
+    pa_atomic_store(&p->cpu_usec, 0);
+
+#ifdef USE_EPOLL
+    epoll_init(p);
+#endif
+
 #ifdef DEBUG_TIMING
     p->timestamp = pa_rtclock_now();
 #endif
@@ -117,6 +379,13 @@ static void rtpoll_rebuild(pa_rtpoll *p) {
         p->n_pollfd_alloc = p->n_pollfd_used * 2;
         p->pollfd2 = pa_xrealloc(p->pollfd2, p->n_pollfd_alloc * sizeof(struct pollfd));
         ra = 1;
+
+#ifdef USE_EPOLL
+        if (p->epoll_fd >= 0) {
+            p->registered = pa_xrealloc(p->registered, p->n_pollfd_alloc * sizeof(struct pollfd));
+            p->epoll_events = pa_xrealloc(p->epoll_events, (p->n_pollfd_alloc + 1) * sizeof(struct epoll_event));
+        }
+#endif
     }
 
     e = p->pollfd2;
@@ -145,6 +414,10 @@ static void rtpoll_rebuild(pa_rtpoll *p) {
 
     if (ra)
         p->pollfd2 = pa_xrealloc(p->pollfd2, p->n_pollfd_alloc * sizeof(struct pollfd));
+
+#ifdef USE_EPOLL
+    p->epoll_resync = TRUE;
+#endif
 }
 
 static void rtpoll_item_destroy(pa_rtpoll_item *i) {
@@ -173,6 +446,10 @@ void pa_rtpoll_free(pa_rtpoll *p) {
     pa_xfree(p->pollfd);
     pa_xfree(p->pollfd2);
 
+#ifdef USE_EPOLL
+    epoll_done(p);
+#endif
+
     pa_xfree(p);
 }
 
@@ -203,6 +480,18 @@ static void reset_all_revents(pa_rtpoll *p) {
     }
 }
 
+static void account_cpu(pa_rtpoll *p) {
+    pa_usec_t cpu;
+
+    if ((cpu = pa_rtclock_thread_cpu()) <= 0)
+        return;
+
+    if (p->cpu_last > 0 && cpu > p->cpu_last)
+        pa_atomic_add(&p->cpu_usec, (int) (cpu - p->cpu_last));
+
+    p->cpu_last = cpu;
+}
+
 int pa_rtpoll_run(pa_rtpoll *p, pa_bool_t wait_op) {
     pa_rtpoll_item *i;
     int r = 0;
@@ -217,6 +506,9 @@ int pa_rtpoll_run(pa_rtpoll *p, pa_bool_t wait_op) {
 
     p->running = TRUE;
     p->timer_elapsed = FALSE;
+    p->now_valid = FALSE;
+
+    account_cpu(p);
 
     /* First, let's do some work */
     for (i = p->items; i && i->priority < PA_RTPOLL_NEVER; i = i->next) {
@@ -305,7 +597,17 @@ int pa_rtpoll_run(pa_rtpoll *p, pa_bool_t wait_op) {
     }
 #endif
 
+#ifdef USE_EPOLL
+    if (p->epoll_fd >= 0)
+        epoll_sync(p);
+#endif
+
     /* OK, now let's sleep */
+#ifdef USE_EPOLL
+    if (p->epoll_fd >= 0)
+        r = epoll_poll(p, wait_op);
+    else
+#endif
 #ifdef HAVE_PPOLL
     {
         struct timespec ts;
@@ -319,6 +621,16 @@ int pa_rtpoll_run(pa_rtpoll *p, pa_bool_t wait_op) {
 
     p->timer_elapsed = r == 0;
 
+    pa_trace(PA_TRACE_RTPOLL_WAKEUP, (uint64_t) r, p->timer_elapsed);
+
+    pa_rtpoll_now_refresh(p);
+
+    if (p->timer_elapsed && wait_op && !p->quit && p->timer_enabled) {
+        pa_usec_t elapse = pa_timeval_load(&p->next_elapse);
+
+        pa_histogram_add(&p->lateness, p->now > elapse ? p->now - elapse : 0);
+    }
+
 #ifdef DEBUG_TIMING
     {
         pa_usec_t now = pa_rtclock_now();
@@ -379,6 +691,24 @@ void pa_rtpoll_set_timer_absolute(pa_rtpoll *p, pa_usec_t usec) {
     p->timer_enabled = TRUE;
 }
 
+pa_usec_t pa_rtpoll_now(pa_rtpoll *p) {
+    pa_assert(p);
+
+    if (!p->now_valid)
+        return pa_rtpoll_now_refresh(p);
+
+    return p->now;
+}
+
+pa_usec_t pa_rtpoll_now_refresh(pa_rtpoll *p) {
+    pa_assert(p);
+
+    p->now = pa_rtclock_now();
+    p->now_valid = TRUE;
+
+    return p->now;
+}
+
 void pa_rtpoll_set_timer_relative(pa_rtpoll *p, pa_usec_t usec) {
     pa_assert(p);
 
@@ -543,18 +873,26 @@ static void asyncmsgq_read_after(pa_rtpoll_item *i) {
     pa_asyncmsgq_read_after_poll(i->userdata);
 }
 
+/* Messages that have queued up are handled in one go, so that what they
+ * cause between two loop iterations is merged, most importantly the
+ * rewind requests of a burst of volume changes. The batch is limited so
+ * that a flood of messages cannot hold off the loop for too long. */
 static int asyncmsgq_read_work(pa_rtpoll_item *i) {
     pa_msgobject *object;
     int code;
     void *data;
     pa_memchunk chunk;
     int64_t offset;
+    unsigned n;
 
     pa_assert(i);
 
-    if (pa_asyncmsgq_get(i->userdata, &object, &code, &data, &offset, &chunk, 0) == 0) {
+    for (n = 0; n < ASYNCMSGQ_BATCH_MAX; n++) {
         int ret;
 
+        if (pa_asyncmsgq_get(i->userdata, &object, &code, &data, &offset, &chunk, 0) < 0)
+            break;
+
         if (!object && code == PA_MESSAGE_SHUTDOWN) {
             pa_asyncmsgq_done(i->userdata, 0);
             pa_rtpoll_quit(i->rtpoll);
@@ -563,10 +901,13 @@ static int asyncmsgq_read_work(pa_rtpoll_item *i) {
 
         ret = pa_asyncmsgq_dispatch(object, code, data, offset, &chunk);
         pa_asyncmsgq_done(i->userdata, ret);
-        return 1;
+
+        /* The message may have removed this item or stopped the loop */
+        if (i->dead || i->rtpoll->quit)
+            return 1;
     }
 
-    return 0;
+    return n > 0;
 }
 
 pa_rtpoll_item *pa_rtpoll_item_new_asyncmsgq_read(pa_rtpoll *p, pa_rtpoll_priority_t prio, pa_asyncmsgq *q) {
@@ -631,6 +972,18 @@ void pa_rtpoll_quit(pa_rtpoll *p) {
     p->quit = TRUE;
 }
 
+pa_histogram *pa_rtpoll_get_lateness(pa_rtpoll *p) {
+    pa_assert(p);
+
+    return &p->lateness;
+}
+
+uint32_t pa_rtpoll_get_cpu_usec(pa_rtpoll *p) {
+    pa_assert(p);
+
+    return (uint32_t) pa_atomic_load(&p->cpu_usec);
+}
+
 pa_bool_t pa_rtpoll_timer_elapsed(pa_rtpoll *p) {
     pa_assert(p);
 
@@ -28,6 +28,7 @@
 #include <pulse/sample.h>
 #include <pulsecore/asyncmsgq.h>
 #include <pulsecore/fdsem.h>
+#include <pulsecore/histogram.h>
 #include <pulsecore/macro.h>
 
 /* An implementation of a "real-time" poll loop. Basically, this is
@@ -63,6 +64,15 @@ void pa_rtpoll_free(pa_rtpoll *p);
  * cleanly. */
 int pa_rtpoll_run(pa_rtpoll *f, pa_bool_t wait);
 
+/* The time the thread woke up last, read from the clock once for each
+ * iteration. Code that runs many times per iteration, where that is
+ * precise enough, should use this instead of pa_rtclock_now(), which
+ * also keeps the timestamps of one iteration consistent. Where the
+ * time has to be exact, pa_rtpoll_now_refresh() reads the clock again
+ * and updates what pa_rtpoll_now() returns. */
+pa_usec_t pa_rtpoll_now(pa_rtpoll *p);
+pa_usec_t pa_rtpoll_now_refresh(pa_rtpoll *p);
+
 void pa_rtpoll_set_timer_absolute(pa_rtpoll *p, pa_usec_t usec);
 void pa_rtpoll_set_timer_relative(pa_rtpoll *p, pa_usec_t usec);
 void pa_rtpoll_set_timer_disabled(pa_rtpoll *p);
@@ -71,6 +81,15 @@ void pa_rtpoll_set_timer_disabled(pa_rtpoll *p);
  * the last pa_rtpoll_run() invocation to finish */
 pa_bool_t pa_rtpoll_timer_elapsed(pa_rtpoll *p);
 
+/* How late pa_rtpoll_run() returned after the timer elapsed. The
+ * histogram may be read from other threads. */
+pa_histogram *pa_rtpoll_get_lateness(pa_rtpoll *p);
+
+/* The CPU time the thread running the loop has used, measured at each
+ * pa_rtpoll_run(). Wraps around at 2^32 like the IO stats, and may be
+ * read from other threads. */
+uint32_t pa_rtpoll_get_cpu_usec(pa_rtpoll *p);
+
 /* A new fd wakeup item for pa_rtpoll */
 pa_rtpoll_item *pa_rtpoll_item_new(pa_rtpoll *p, pa_rtpoll_priority_t prio, unsigned n_fds);
 void pa_rtpoll_item_free(pa_rtpoll_item *i);
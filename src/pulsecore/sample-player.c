@@ -0,0 +1,554 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/rtclock.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-scache.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/hashmap.h>
+#include <pulsecore/idxset.h>
+#include <pulsecore/llist.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblockq.h>
+#include <pulsecore/resampler.h>
+#include <pulsecore/sample-util.h>
+#include <pulsecore/sink-input.h>
+#include <pulsecore/thread-mq.h>
+
+#include "sample-player.h"
+
+/* Allocated and freed by the main thread, only the IO thread touches
+ * index, delay, rendered and the list fields while linked */
+struct voice {
+    pa_memchunk chunk; /* In the format of the sink input */
+    pa_cvolume volume;
+
+    size_t index;      /* How far into chunk we are, runs past its end
+                        * for as long as the end may be rewound into */
+    size_t delay;      /* How much silence to render before chunk */
+    pa_bool_t rendered;
+
+    PA_LLIST_FIELDS(struct voice);
+};
+
+struct converted {
+    pa_memblock *source; /* Referenced, so that it stays unique as key */
+    size_t index, length;
+    pa_sample_spec sample_spec;
+    pa_channel_map channel_map;
+
+    pa_memchunk chunk;
+};
+
+struct pa_sample_player {
+    pa_msgobject parent;
+    pa_core *core;
+
+    uint32_t sink_index;
+    pa_sink_input *sink_input;
+
+    pa_idxset *voices;
+    pa_hashmap *converted;
+
+    pa_time_event *idle_event;
+
+    struct {
+        PA_LLIST_HEAD(struct voice, voices);
+    } thread_info;
+};
+
+enum {
+    SAMPLE_PLAYER_MESSAGE_ADD_VOICE,  /* To the IO thread */
+    SAMPLE_PLAYER_MESSAGE_VOICE_DONE  /* To the main thread */
+};
+
+PA_DEFINE_PRIVATE_CLASS(pa_sample_player, pa_msgobject);
+#define SAMPLE_PLAYER(o) (pa_sample_player_cast(o))
+
+static void voice_free(struct voice *v) {
+    pa_assert(v);
+
+    pa_memblock_unref(v->chunk.memblock);
+    pa_xfree(v);
+}
+
+static void converted_free(struct converted *c) {
+    pa_assert(c);
+
+    pa_memblock_unref(c->source);
+    pa_memblock_unref(c->chunk.memblock);
+    pa_xfree(c);
+}
+
+/* Called from main context */
+static void sample_player_unlink(pa_sample_player *p) {
+    pa_assert(p);
+
+    if (!p->sink_input)
+        return;
+
+    pa_assert_se(pa_hashmap_remove(p->core->sample_players, PA_UINT32_TO_PTR(p->sink_index)) == p);
+
+    if (p->idle_event) {
+        p->core->mainloop->time_free(p->idle_event);
+        p->idle_event = NULL;
+    }
+
+    pa_sink_input_unlink(p->sink_input);
+    pa_sink_input_unref(p->sink_input);
+    p->sink_input = NULL;
+
+    pa_sample_player_unref(p);
+}
+
+static void sample_player_free(pa_object *o) {
+    pa_sample_player *p = SAMPLE_PLAYER(o);
+    struct voice *v;
+    struct converted *c;
+
+    pa_assert(p);
+    pa_assert(!p->sink_input);
+
+    while ((v = pa_idxset_steal_first(p->voices, NULL)))
+        voice_free(v);
+    pa_idxset_free(p->voices, NULL, NULL);
+
+    while ((c = pa_hashmap_steal_first(p->converted)))
+        converted_free(c);
+    pa_hashmap_free(p->converted, NULL, NULL);
+
+    pa_xfree(p);
+}
+
+/* Called from main context */
+static void idle_cb(pa_mainloop_api *m, pa_time_event *e, const struct timeval *t, void *userdata) {
+    pa_sample_player *p = userdata;
+
+    pa_sample_player_assert_ref(p);
+
+    if (!pa_idxset_isempty(p->voices))
+        return;
+
+    pa_log_debug("Sample player on sink %u idle, removing.", p->sink_index);
+    sample_player_unlink(p);
+}
+
+/* Called from IO thread context, except VOICE_DONE */
+static int sample_player_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offset, pa_memchunk *chunk) {
+    pa_sample_player *p = SAMPLE_PLAYER(o);
+    struct voice *v = userdata;
+
+    pa_sample_player_assert_ref(p);
+    pa_assert(v);
+
+    switch (code) {
+
+        case SAMPLE_PLAYER_MESSAGE_ADD_VOICE:
+            PA_LLIST_PREPEND(struct voice, p->thread_info.voices, v);
+
+            /* Rewrite what was rendered already, so that the sample
+             * is heard right away */
+            if (p->sink_input->thread_info.state == PA_SINK_INPUT_RUNNING)
+                pa_sink_input_request_rewind(p->sink_input, 0, TRUE, FALSE, FALSE);
+
+            return 0;
+
+        case SAMPLE_PLAYER_MESSAGE_VOICE_DONE:
+            if (!p->sink_input)
+                return 0;
+
+            pa_assert_se(pa_idxset_remove_by_data(p->voices, v, NULL));
+            voice_free(v);
+
+            if (pa_idxset_isempty(p->voices)) {
+                /* Let the sink suspend while nothing is played */
+                pa_sink_input_cork(p->sink_input, TRUE);
+                pa_core_rttime_restart(p->core, p->idle_event, pa_rtclock_now() + PA_SAMPLE_PLAYER_IDLE_USEC);
+            }
+
+            return 0;
+    }
+
+    pa_assert_not_reached();
+}
+
+/* Called from main context */
+static void sink_input_kill_cb(pa_sink_input *i) {
+    pa_sample_player *p;
+
+    pa_sink_input_assert_ref(i);
+    p = SAMPLE_PLAYER(i->userdata);
+    pa_sample_player_assert_ref(p);
+
+    sample_player_unlink(p);
+}
+
+/* Called from IO thread context */
+static void sink_input_state_change_cb(pa_sink_input *i, pa_sink_input_state_t state) {
+    pa_sink_input_assert_ref(i);
+
+    /* When added or uncorked, ask for a rewind so that we are heard
+     * right away */
+    if (state == PA_SINK_INPUT_RUNNING &&
+        (i->thread_info.state == PA_SINK_INPUT_INIT || i->thread_info.state == PA_SINK_INPUT_CORKED))
+        pa_sink_input_request_rewind(i, 0, FALSE, TRUE, TRUE);
+}
+
+/* Called from IO thread context */
+static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk) {
+    pa_sample_player *p;
+    pa_mix_info info[PA_SAMPLE_PLAYER_VOICES_MAX];
+    struct voice *v, *n;
+    unsigned n_info = 0;
+    size_t length;
+
+    pa_sink_input_assert_ref(i);
+    pa_assert(chunk);
+    p = SAMPLE_PLAYER(i->userdata);
+    pa_sample_player_assert_ref(p);
+
+    length = PA_MIN(nbytes, pa_mempool_block_size_max(p->core->mempool));
+    length = pa_frame_align(length, &i->sample_spec);
+
+    /* Stop where the first voice starts or ends */
+    PA_LLIST_FOREACH(v, p->thread_info.voices) {
+        if (v->delay > 0)
+            length = PA_MIN(length, v->delay);
+        else if (v->index < v->chunk.length)
+            length = PA_MIN(length, v->chunk.length - v->index);
+    }
+
+    PA_LLIST_FOREACH(v, p->thread_info.voices) {
+        v->rendered = TRUE;
+
+        if (v->delay > 0 || v->index >= v->chunk.length)
+            continue;
+
+        pa_assert(n_info < PA_SAMPLE_PLAYER_VOICES_MAX);
+
+        info[n_info].chunk = v->chunk;
+        info[n_info].chunk.index += v->index;
+        info[n_info].chunk.length = length;
+        info[n_info].volume = v->volume;
+        info[n_info].userdata = v;
+        n_info++;
+    }
+
+    if (n_info == 1 && pa_cvolume_is_norm(&info[0].volume)) {
+        /* Nothing to mix, so pass the sample on as it is */
+        *chunk = info[0].chunk;
+        pa_memblock_ref(chunk->memblock);
+
+    } else if (n_info > 0) {
+        void *d;
+
+        chunk->memblock = pa_memblock_new(p->core->mempool, length);
+        chunk->index = 0;
+
+        d = pa_memblock_acquire(chunk->memblock);
+        chunk->length = pa_mix(info, n_info, d, length, &i->sample_spec, NULL, FALSE);
+        pa_memblock_release(chunk->memblock);
+
+    } else {
+        /* Nothing being played right now. Until the main thread corks
+         * us, fill in silence rather than running into an underrun,
+         * which would keep us from rewriting when a sample comes. */
+        pa_silence_memchunk_get_full(&p->core->silence_cache, p->core->mempool, chunk, &i->sample_spec, length);
+    }
+
+    length = chunk->length;
+
+    PA_LLIST_FOREACH_SAFE(v, n, p->thread_info.voices) {
+
+        if (v->delay > 0) {
+            v->delay -= PA_MIN(v->delay, length);
+            continue;
+        }
+
+        v->index += length;
+
+        /* Keep voices that ended for as long as they might be rewound
+         * into, so that their ends aren't lost when rewriting */
+        if (v->index >= v->chunk.length + pa_sink_input_get_max_rewind(i)) {
+            PA_LLIST_REMOVE(struct voice, p->thread_info.voices, v);
+            pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(p), SAMPLE_PLAYER_MESSAGE_VOICE_DONE, v, 0, NULL, NULL);
+        }
+    }
+
+    return 0;
+}
+
+/* Called from IO thread context */
+static void sink_input_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
+    pa_sample_player *p;
+    struct voice *v;
+
+    pa_sink_input_assert_ref(i);
+    p = SAMPLE_PLAYER(i->userdata);
+    pa_sample_player_assert_ref(p);
+
+    if (nbytes <= 0)
+        return;
+
+    /* Move the voices back by what is rewritten. Those that came in
+     * after that point start later instead. */
+    PA_LLIST_FOREACH(v, p->thread_info.voices) {
+
+        if (!v->rendered)
+            continue;
+
+        if (v->delay > 0)
+            v->delay += nbytes;
+        else if (v->index >= nbytes)
+            v->index -= nbytes;
+        else {
+            v->delay = nbytes - v->index;
+            v->index = 0;
+        }
+    }
+}
+
+static pa_sample_player* sample_player_new(pa_sink *sink) {
+    pa_sample_player *p;
+    pa_sink_input_new_data data;
+
+    pa_assert(sink);
+
+    p = pa_msgobject_new(pa_sample_player);
+    p->parent.parent.free = sample_player_free;
+    p->parent.process_msg = sample_player_process_msg;
+    p->core = sink->core;
+    p->sink_index = sink->index;
+    p->sink_input = NULL;
+    p->voices = pa_idxset_new(NULL, NULL);
+    p->converted = pa_hashmap_new(NULL, NULL);
+    p->idle_event = NULL;
+    PA_LLIST_HEAD_INIT(struct voice, p->thread_info.voices);
+
+    pa_sink_input_new_data_init(&data);
+    pa_sink_input_new_data_set_sink(&data, sink, FALSE);
+    data.driver = __FILE__;
+    pa_sink_input_new_data_set_sample_spec(&data, &sink->sample_spec);
+    pa_sink_input_new_data_set_channel_map(&data, &sink->channel_map);
+    pa_proplist_sets(data.proplist, PA_PROP_MEDIA_NAME, "Sample Player");
+    pa_proplist_sets(data.proplist, PA_PROP_MEDIA_ROLE, "event");
+    data.flags = PA_SINK_INPUT_NO_CREATE_ON_SUSPEND|PA_SINK_INPUT_KILL_ON_SUSPEND|PA_SINK_INPUT_DONT_MOVE;
+
+    pa_sink_input_new(&p->sink_input, sink->core, &data);
+    pa_sink_input_new_data_done(&data);
+
+    if (!p->sink_input) {
+        pa_sample_player_unref(p);
+        return NULL;
+    }
+
+    p->sink_input->pop = sink_input_pop_cb;
+    p->sink_input->process_rewind = sink_input_process_rewind_cb;
+    p->sink_input->kill = sink_input_kill_cb;
+    p->sink_input->state_change = sink_input_state_change_cb;
+    p->sink_input->userdata = p;
+
+    p->idle_event = pa_core_rttime_new(p->core, PA_USEC_INVALID, idle_cb, p);
+
+    /* The reference is dropped again in sample_player_unlink() */
+    pa_assert_se(pa_hashmap_put(p->core->sample_players, PA_UINT32_TO_PTR(p->sink_index), p) == 0);
+
+    pa_sink_input_put(p->sink_input);
+
+    pa_log_debug("Created sample player on sink %s.", sink->name);
+
+    return p;
+}
+
+/* Converts all of chunk at once, in pieces the resampler can take */
+static int convert(pa_sample_player *p, pa_resampler *r, const pa_memchunk *chunk, pa_memchunk *result) {
+    pa_memblockq *q;
+    size_t max_block, offset = 0;
+    int ret = -1;
+
+    q = pa_memblockq_new("sample player conversion", 0, PA_SCACHE_ENTRY_SIZE_MAX, 0, &p->sink_input->sample_spec, 0, 1, 0, NULL);
+    max_block = pa_frame_align(pa_resampler_max_block_size(r), pa_resampler_input_sample_spec(r));
+
+    while (offset < chunk->length) {
+        pa_memchunk in, out;
+
+        in = *chunk;
+        in.index += offset;
+        in.length = PA_MIN(chunk->length - offset, max_block);
+        offset += in.length;
+
+        pa_resampler_run(r, &in, &out);
+
+        if (out.memblock) {
+            int k = pa_memblockq_push_align(q, &out);
+            pa_memblock_unref(out.memblock);
+
+            if (k < 0)
+                goto finish;
+        }
+    }
+
+    if (pa_memblockq_get_length(q) <= 0)
+        goto finish;
+
+    /* Copy it all into one block of its own */
+    result->memblock = pa_memblock_new(p->core->mempool, pa_memblockq_get_length(q));
+    result->index = result->length = 0;
+
+    while (pa_memblockq_get_length(q) > 0) {
+        pa_memchunk piece, dst;
+
+        pa_assert_se(pa_memblockq_peek(q, &piece) >= 0);
+
+        dst = *result;
+        dst.index += result->length;
+        dst.length = piece.length;
+        pa_memchunk_memcpy(&dst, &piece);
+        result->length += piece.length;
+
+        pa_memblock_unref(piece.memblock);
+        pa_memblockq_drop(q, piece.length);
+    }
+
+    ret = 0;
+
+finish:
+    pa_memblockq_free(q);
+
+    return ret;
+}
+
+/* Returns a chunk of the sample in the format of the sink input, which
+ * has to be unreferenced afterwards */
+static int get_converted(pa_sample_player *p, const pa_sample_spec *ss, const pa_channel_map *map, const pa_memchunk *chunk, pa_memchunk *result) {
+    struct converted *c;
+    pa_resampler *r;
+
+    if (pa_sample_spec_equal(ss, &p->sink_input->sample_spec) &&
+        pa_channel_map_equal(map, &p->sink_input->channel_map)) {
+        *result = *chunk;
+        pa_memblock_ref(result->memblock);
+        return 0;
+    }
+
+    if ((c = pa_hashmap_get(p->converted, chunk->memblock))) {
+        if (c->index == chunk->index &&
+            c->length == chunk->length &&
+            pa_sample_spec_equal(&c->sample_spec, ss) &&
+            pa_channel_map_equal(&c->channel_map, map)) {
+            *result = c->chunk;
+            pa_memblock_ref(result->memblock);
+            return 0;
+        }
+
+        pa_hashmap_remove(p->converted, chunk->memblock);
+        converted_free(c);
+    }
+
+    if (!(r = pa_resampler_new(p->core->mempool, p->core->resampler_cache,
+                               ss, map,
+                               &p->sink_input->sample_spec, &p->sink_input->channel_map,
+                               p->core->resample_method,
+                               p->core->disable_remixing ? PA_RESAMPLER_NO_REMIX : 0)))
+        return -1;
+
+    if (convert(p, r, chunk, result) < 0) {
+        pa_resampler_free(r);
+        return -1;
+    }
+
+    pa_resampler_free(r);
+
+    if (pa_hashmap_size(p->converted) >= PA_SAMPLE_PLAYER_CACHE_MAX)
+        converted_free(pa_hashmap_steal_first(p->converted));
+
+    c = pa_xnew(struct converted, 1);
+    c->source = pa_memblock_ref(chunk->memblock);
+    c->index = chunk->index;
+    c->length = chunk->length;
+    c->sample_spec = *ss;
+    c->channel_map = *map;
+    c->chunk = *result;
+    pa_memblock_ref(c->chunk.memblock);
+
+    pa_assert_se(pa_hashmap_put(p->converted, c->source, c) == 0);
+
+    return 0;
+}
+
+int pa_sample_player_play(
+        pa_sink *sink,
+        const pa_sample_spec *ss,
+        const pa_channel_map *map,
+        const pa_memchunk *chunk,
+        const pa_cvolume *volume,
+        uint32_t *sink_input_index) {
+
+    pa_sample_player *p;
+    struct voice *v;
+    pa_channel_map default_map;
+
+    pa_sink_assert_ref(sink);
+    pa_assert(ss);
+    pa_assert(chunk);
+    pa_assert(chunk->memblock);
+
+    if (!map)
+        map = pa_channel_map_init_auto(&default_map, ss->channels, PA_CHANNEL_MAP_DEFAULT);
+
+    if (!(p = pa_hashmap_get(sink->core->sample_players, PA_UINT32_TO_PTR(sink->index))))
+        if (!(p = sample_player_new(sink)))
+            return -PA_ERR_NOTSUPPORTED;
+
+    if (pa_idxset_size(p->voices) >= PA_SAMPLE_PLAYER_VOICES_MAX)
+        return -PA_ERR_TOOLARGE;
+
+    v = pa_xnew0(struct voice, 1);
+
+    if (get_converted(p, ss, map, chunk, &v->chunk) < 0) {
+        pa_xfree(v);
+        return -PA_ERR_NOTSUPPORTED;
+    }
+
+    if (volume) {
+        v->volume = *volume;
+        pa_cvolume_remap(&v->volume, map, &p->sink_input->channel_map);
+    } else
+        pa_cvolume_reset(&v->volume, p->sink_input->sample_spec.channels);
+
+    pa_idxset_put(p->voices, v, NULL);
+    pa_asyncmsgq_post(p->sink_input->sink->asyncmsgq, PA_MSGOBJECT(p), SAMPLE_PLAYER_MESSAGE_ADD_VOICE, v, 0, NULL, NULL);
+
+    /* The add message is queued before the state change */
+    if (pa_sink_input_get_state(p->sink_input) == PA_SINK_INPUT_CORKED) {
+        pa_core_rttime_restart(p->core, p->idle_event, PA_USEC_INVALID);
+        pa_sink_input_cork(p->sink_input, FALSE);
+    }
+
+    if (sink_input_index)
+        *sink_input_index = p->sink_input->index;
+
+    return 0;
+}
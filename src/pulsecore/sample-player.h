@@ -0,0 +1,58 @@
+#ifndef foosampleplayerhfoo
+#define foosampleplayerhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulse/sample.h>
+#include <pulse/channelmap.h>
+#include <pulse/volume.h>
+
+#include <pulsecore/sink.h>
+#include <pulsecore/memchunk.h>
+
+/* A single sink input per sink that mixes all samples played on it
+ * itself, instead of creating a stream for each of them. The samples
+ * are converted to the format of the sink once, and the result is
+ * kept for the next time they are played. The sink input corks itself
+ * when there is nothing to play, and goes away after a while. */
+
+typedef struct pa_sample_player pa_sample_player;
+
+/* How many samples may be played at the same time by one player */
+#define PA_SAMPLE_PLAYER_VOICES_MAX 32
+
+/* How many converted samples a player keeps */
+#define PA_SAMPLE_PLAYER_CACHE_MAX 32
+
+/* After this long without anything to play the player is removed */
+#define PA_SAMPLE_PLAYER_IDLE_USEC (10 * PA_USEC_PER_SEC)
+
+/* Plays chunk on the player of sink, which is created if needed. Fails
+ * with -PA_ERR_TOOLARGE if the player is busy with as many samples as
+ * it can take. */
+int pa_sample_player_play(
+        pa_sink *sink,
+        const pa_sample_spec *ss,
+        const pa_channel_map *map,
+        const pa_memchunk *chunk,
+        const pa_cvolume *volume,
+        uint32_t *sink_input_index);
+
+#endif
@@ -152,6 +152,9 @@ static void calc_linear_integer_stream_volumes(pa_mix_info streams[], unsigned n
             pa_mix_info *m = streams + k;
             m->linear[channel].i = (int32_t) lrint(pa_sw_volume_to_linear(m->volume.values[channel]) * linear[channel] * 0x10000);
         }
+
+        for (; channel < spec->channels + PA_MIX_VOLUME_PADDING; channel++)
+            streams[k].linear[channel].i = streams[k].linear[channel - spec->channels].i;
     }
 }
 
@@ -171,515 +174,502 @@ static void calc_linear_float_stream_volumes(pa_mix_info streams[], unsigned nst
             pa_mix_info *m = streams + k;
             m->linear[channel].f = (float) (pa_sw_volume_to_linear(m->volume.values[channel]) * linear[channel]);
         }
+
+        for (; channel < spec->channels + PA_MIX_VOLUME_PADDING; channel++)
+            streams[k].linear[channel].f = streams[k].linear[channel - spec->channels].f;
     }
 }
 
-size_t pa_mix(
-        pa_mix_info streams[],
-        unsigned nstreams,
-        void *data,
-        size_t length,
-        const pa_sample_spec *spec,
-        const pa_cvolume *volume,
-        pa_bool_t mute) {
+static void pa_mix_s16ne_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    unsigned channel = 0;
 
-    pa_cvolume full_volume;
-    unsigned k;
-    unsigned z;
-    void *end;
+    while (data < end) {
+        int32_t sum = 0;
+        unsigned i;
 
-    pa_assert(streams);
-    pa_assert(data);
-    pa_assert(length);
-    pa_assert(spec);
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32_t v, lo, hi, cv = m->linear[channel].i;
 
-    if (!volume)
-        volume = pa_cvolume_reset(&full_volume, spec->channels);
+            if (PA_LIKELY(cv > 0)) {
 
-    if (mute || pa_cvolume_is_muted(volume) || nstreams <= 0) {
-        pa_silence_memory(data, length, spec);
-        return length;
-    }
+                /* Multiplying the 32bit volume factor with the
+                 * 16bit sample might result in an 48bit value. We
+                 * want to do without 64 bit integers and hence do
+                 * the multiplication independently for the HI and
+                 * LO part of the volume. */
 
-    for (k = 0; k < nstreams; k++)
-        streams[k].ptr = (uint8_t*) pa_memblock_acquire(streams[k].chunk.memblock) + streams[k].chunk.index;
+                hi = cv >> 16;
+                lo = cv & 0xFFFF;
 
-    for (z = 0; z < nstreams; z++)
-        if (length > streams[z].chunk.length)
-            length = streams[z].chunk.length;
+                v = *((int16_t*) m->ptr);
+                v = ((v * lo) >> 16) + (v * hi);
+                sum += v;
+            }
+            m->ptr = (uint8_t*) m->ptr + sizeof(int16_t);
+        }
 
-    end = (uint8_t*) data + length;
+        sum = PA_CLAMP_UNLIKELY(sum, -0x8000, 0x7FFF);
+        *((int16_t*) data) = (int16_t) sum;
 
-    switch (spec->format) {
+        data = (uint8_t*) data + sizeof(int16_t);
 
-        case PA_SAMPLE_S16NE:{
-            unsigned channel = 0;
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
 
-            calc_linear_integer_stream_volumes(streams, nstreams, volume, spec);
+static void pa_mix_s16re_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    unsigned channel = 0;
 
-            while (data < end) {
-                int32_t sum = 0;
-                unsigned i;
+    while (data < end) {
+        int32_t sum = 0;
+        unsigned i;
 
-                for (i = 0; i < nstreams; i++) {
-                    pa_mix_info *m = streams + i;
-                    int32_t v, lo, hi, cv = m->linear[channel].i;
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32_t v, lo, hi, cv = m->linear[channel].i;
 
-                    if (PA_LIKELY(cv > 0)) {
+            if (PA_LIKELY(cv > 0)) {
 
-                        /* Multiplying the 32bit volume factor with the
-                         * 16bit sample might result in an 48bit value. We
-                         * want to do without 64 bit integers and hence do
-                         * the multiplication independently for the HI and
-                         * LO part of the volume. */
+                hi = cv >> 16;
+                lo = cv & 0xFFFF;
 
-                        hi = cv >> 16;
-                        lo = cv & 0xFFFF;
+                v = PA_INT16_SWAP(*((int16_t*) m->ptr));
+                v = ((v * lo) >> 16) + (v * hi);
+                sum += v;
+            }
+            m->ptr = (uint8_t*) m->ptr + sizeof(int16_t);
+        }
 
-                        v = *((int16_t*) m->ptr);
-                        v = ((v * lo) >> 16) + (v * hi);
-                        sum += v;
-                    }
-                    m->ptr = (uint8_t*) m->ptr + sizeof(int16_t);
-                }
+        sum = PA_CLAMP_UNLIKELY(sum, -0x8000, 0x7FFF);
+        *((int16_t*) data) = PA_INT16_SWAP((int16_t) sum);
 
-                sum = PA_CLAMP_UNLIKELY(sum, -0x8000, 0x7FFF);
-                *((int16_t*) data) = (int16_t) sum;
+        data = (uint8_t*) data + sizeof(int16_t);
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
 
-                data = (uint8_t*) data + sizeof(int16_t);
+static void pa_mix_s32ne_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    unsigned channel = 0;
 
-                if (PA_UNLIKELY(++channel >= spec->channels))
-                    channel = 0;
-            }
+    while (data < end) {
+        int64_t sum = 0;
+        unsigned i;
 
-            break;
-        }
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32_t cv = m->linear[channel].i;
+            int64_t v;
 
-        case PA_SAMPLE_S16RE:{
-            unsigned channel = 0;
+            if (PA_LIKELY(cv > 0)) {
 
-            calc_linear_integer_stream_volumes(streams, nstreams, volume, spec);
+                v = *((int32_t*) m->ptr);
+                v = (v * cv) >> 16;
+                sum += v;
+            }
+            m->ptr = (uint8_t*) m->ptr + sizeof(int32_t);
+        }
 
-            while (data < end) {
-                int32_t sum = 0;
-                unsigned i;
+        sum = PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
+        *((int32_t*) data) = (int32_t) sum;
 
-                for (i = 0; i < nstreams; i++) {
-                    pa_mix_info *m = streams + i;
-                    int32_t v, lo, hi, cv = m->linear[channel].i;
+        data = (uint8_t*) data + sizeof(int32_t);
 
-                    if (PA_LIKELY(cv > 0)) {
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
 
-                        hi = cv >> 16;
-                        lo = cv & 0xFFFF;
+static void pa_mix_s32re_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    unsigned channel = 0;
 
-                        v = PA_INT16_SWAP(*((int16_t*) m->ptr));
-                        v = ((v * lo) >> 16) + (v * hi);
-                        sum += v;
-                    }
-                    m->ptr = (uint8_t*) m->ptr + sizeof(int16_t);
-                }
+    while (data < end) {
+        int64_t sum = 0;
+        unsigned i;
 
-                sum = PA_CLAMP_UNLIKELY(sum, -0x8000, 0x7FFF);
-                *((int16_t*) data) = PA_INT16_SWAP((int16_t) sum);
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32_t cv = m->linear[channel].i;
+            int64_t v;
 
-                data = (uint8_t*) data + sizeof(int16_t);
+            if (PA_LIKELY(cv > 0)) {
 
-                if (PA_UNLIKELY(++channel >= spec->channels))
-                    channel = 0;
+                v = PA_INT32_SWAP(*((int32_t*) m->ptr));
+                v = (v * cv) >> 16;
+                sum += v;
             }
-
-            break;
+            m->ptr = (uint8_t*) m->ptr + sizeof(int32_t);
         }
 
-        case PA_SAMPLE_S32NE:{
-            unsigned channel = 0;
+        sum = PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
+        *((int32_t*) data) = PA_INT32_SWAP((int32_t) sum);
 
-            calc_linear_integer_stream_volumes(streams, nstreams, volume, spec);
+        data = (uint8_t*) data + sizeof(int32_t);
 
-            while (data < end) {
-                int64_t sum = 0;
-                unsigned i;
-
-                for (i = 0; i < nstreams; i++) {
-                    pa_mix_info *m = streams + i;
-                    int32_t cv = m->linear[channel].i;
-                    int64_t v;
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
 
-                    if (PA_LIKELY(cv > 0)) {
+static void pa_mix_s24ne_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    unsigned channel = 0;
 
-                        v = *((int32_t*) m->ptr);
-                        v = (v * cv) >> 16;
-                        sum += v;
-                    }
-                    m->ptr = (uint8_t*) m->ptr + sizeof(int32_t);
-                }
+    while (data < end) {
+        int64_t sum = 0;
+        unsigned i;
 
-                sum = PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
-                *((int32_t*) data) = (int32_t) sum;
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32_t cv = m->linear[channel].i;
+            int64_t v;
 
-                data = (uint8_t*) data + sizeof(int32_t);
+            if (PA_LIKELY(cv > 0)) {
 
-                if (PA_UNLIKELY(++channel >= spec->channels))
-                    channel = 0;
+                v = (int32_t) (PA_READ24NE(m->ptr) << 8);
+                v = (v * cv) >> 16;
+                sum += v;
             }
-
-            break;
+            m->ptr = (uint8_t*) m->ptr + 3;
         }
 
-        case PA_SAMPLE_S32RE:{
-            unsigned channel = 0;
-
-            calc_linear_integer_stream_volumes(streams, nstreams, volume, spec);
+        sum = PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
+        PA_WRITE24NE(data, ((uint32_t) sum) >> 8);
 
-            while (data < end) {
-                int64_t sum = 0;
-                unsigned i;
+        data = (uint8_t*) data + 3;
 
-                for (i = 0; i < nstreams; i++) {
-                    pa_mix_info *m = streams + i;
-                    int32_t cv = m->linear[channel].i;
-                    int64_t v;
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
 
-                    if (PA_LIKELY(cv > 0)) {
+static void pa_mix_s24re_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    unsigned channel = 0;
 
-                        v = PA_INT32_SWAP(*((int32_t*) m->ptr));
-                        v = (v * cv) >> 16;
-                        sum += v;
-                    }
-                    m->ptr = (uint8_t*) m->ptr + sizeof(int32_t);
-                }
+    while (data < end) {
+        int64_t sum = 0;
+        unsigned i;
 
-                sum = PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
-                *((int32_t*) data) = PA_INT32_SWAP((int32_t) sum);
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32_t cv = m->linear[channel].i;
+            int64_t v;
 
-                data = (uint8_t*) data + sizeof(int32_t);
+            if (PA_LIKELY(cv > 0)) {
 
-                if (PA_UNLIKELY(++channel >= spec->channels))
-                    channel = 0;
+                v = (int32_t) (PA_READ24RE(m->ptr) << 8);
+                v = (v * cv) >> 16;
+                sum += v;
             }
-
-            break;
+            m->ptr = (uint8_t*) m->ptr + 3;
         }
 
-        case PA_SAMPLE_S24NE: {
-            unsigned channel = 0;
+        sum = PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
+        PA_WRITE24RE(data, ((uint32_t) sum) >> 8);
 
-            calc_linear_integer_stream_volumes(streams, nstreams, volume, spec);
+        data = (uint8_t*) data + 3;
 
-            while (data < end) {
-                int64_t sum = 0;
-                unsigned i;
-
-                for (i = 0; i < nstreams; i++) {
-                    pa_mix_info *m = streams + i;
-                    int32_t cv = m->linear[channel].i;
-                    int64_t v;
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
 
-                    if (PA_LIKELY(cv > 0)) {
+static void pa_mix_s24_32ne_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    unsigned channel = 0;
 
-                        v = (int32_t) (PA_READ24NE(m->ptr) << 8);
-                        v = (v * cv) >> 16;
-                        sum += v;
-                    }
-                    m->ptr = (uint8_t*) m->ptr + 3;
-                }
+    while (data < end) {
+        int64_t sum = 0;
+        unsigned i;
 
-                sum = PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
-                PA_WRITE24NE(data, ((uint32_t) sum) >> 8);
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32_t cv = m->linear[channel].i;
+            int64_t v;
 
-                data = (uint8_t*) data + 3;
+            if (PA_LIKELY(cv > 0)) {
 
-                if (PA_UNLIKELY(++channel >= spec->channels))
-                    channel = 0;
+                v = (int32_t) (*((uint32_t*)m->ptr) << 8);
+                v = (v * cv) >> 16;
+                sum += v;
             }
-
-            break;
+            m->ptr = (uint8_t*) m->ptr + sizeof(int32_t);
         }
 
-        case PA_SAMPLE_S24RE: {
-            unsigned channel = 0;
-
-            calc_linear_integer_stream_volumes(streams, nstreams, volume, spec);
+        sum = PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
+        *((uint32_t*) data) = ((uint32_t) (int32_t) sum) >> 8;
 
-            while (data < end) {
-                int64_t sum = 0;
-                unsigned i;
+        data = (uint8_t*) data + sizeof(uint32_t);
 
-                for (i = 0; i < nstreams; i++) {
-                    pa_mix_info *m = streams + i;
-                    int32_t cv = m->linear[channel].i;
-                    int64_t v;
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
 
-                    if (PA_LIKELY(cv > 0)) {
+static void pa_mix_s24_32re_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    unsigned channel = 0;
 
-                        v = (int32_t) (PA_READ24RE(m->ptr) << 8);
-                        v = (v * cv) >> 16;
-                        sum += v;
-                    }
-                    m->ptr = (uint8_t*) m->ptr + 3;
-                }
+    while (data < end) {
+        int64_t sum = 0;
+        unsigned i;
 
-                sum = PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
-                PA_WRITE24RE(data, ((uint32_t) sum) >> 8);
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32_t cv = m->linear[channel].i;
+            int64_t v;
 
-                data = (uint8_t*) data + 3;
+            if (PA_LIKELY(cv > 0)) {
 
-                if (PA_UNLIKELY(++channel >= spec->channels))
-                    channel = 0;
+                v = (int32_t) (PA_UINT32_SWAP(*((uint32_t*) m->ptr)) << 8);
+                v = (v * cv) >> 16;
+                sum += v;
             }
-
-            break;
+            m->ptr = (uint8_t*) m->ptr + sizeof(int32_t);
         }
 
-        case PA_SAMPLE_S24_32NE: {
-            unsigned channel = 0;
-
-            calc_linear_integer_stream_volumes(streams, nstreams, volume, spec);
+        sum = PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
+        *((uint32_t*) data) = PA_INT32_SWAP(((uint32_t) (int32_t) sum) >> 8);
 
-            while (data < end) {
-                int64_t sum = 0;
-                unsigned i;
+        data = (uint8_t*) data + sizeof(uint32_t);
 
-                for (i = 0; i < nstreams; i++) {
-                    pa_mix_info *m = streams + i;
-                    int32_t cv = m->linear[channel].i;
-                    int64_t v;
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
 
-                    if (PA_LIKELY(cv > 0)) {
+static void pa_mix_u8_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    unsigned channel = 0;
 
-                        v = (int32_t) (*((uint32_t*)m->ptr) << 8);
-                        v = (v * cv) >> 16;
-                        sum += v;
-                    }
-                    m->ptr = (uint8_t*) m->ptr + sizeof(int32_t);
-                }
+    while (data < end) {
+        int32_t sum = 0;
+        unsigned i;
 
-                sum = PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
-                *((uint32_t*) data) = ((uint32_t) (int32_t) sum) >> 8;
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32_t v, cv = m->linear[channel].i;
 
-                data = (uint8_t*) data + sizeof(uint32_t);
+            if (PA_LIKELY(cv > 0)) {
 
-                if (PA_UNLIKELY(++channel >= spec->channels))
-                    channel = 0;
+                v = (int32_t) *((uint8_t*) m->ptr) - 0x80;
+                v = (v * cv) >> 16;
+                sum += v;
             }
-
-            break;
+            m->ptr = (uint8_t*) m->ptr + 1;
         }
 
-        case PA_SAMPLE_S24_32RE: {
-            unsigned channel = 0;
+        sum = PA_CLAMP_UNLIKELY(sum, -0x80, 0x7F);
+        *((uint8_t*) data) = (uint8_t) (sum + 0x80);
 
-            calc_linear_integer_stream_volumes(streams, nstreams, volume, spec);
+        data = (uint8_t*) data + 1;
 
-            while (data < end) {
-                int64_t sum = 0;
-                unsigned i;
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
 
-                for (i = 0; i < nstreams; i++) {
-                    pa_mix_info *m = streams + i;
-                    int32_t cv = m->linear[channel].i;
-                    int64_t v;
+static void pa_mix_ulaw_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    unsigned channel = 0;
 
-                    if (PA_LIKELY(cv > 0)) {
+    while (data < end) {
+        int32_t sum = 0;
+        unsigned i;
 
-                        v = (int32_t) (PA_UINT32_SWAP(*((uint32_t*) m->ptr)) << 8);
-                        v = (v * cv) >> 16;
-                        sum += v;
-                    }
-                    m->ptr = (uint8_t*) m->ptr + 3;
-                }
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32_t v, hi, lo, cv = m->linear[channel].i;
 
-                sum = PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
-                *((uint32_t*) data) = PA_INT32_SWAP(((uint32_t) (int32_t) sum) >> 8);
+            if (PA_LIKELY(cv > 0)) {
 
-                data = (uint8_t*) data + sizeof(uint32_t);
+                hi = cv >> 16;
+                lo = cv & 0xFFFF;
 
-                if (PA_UNLIKELY(++channel >= spec->channels))
-                    channel = 0;
+                v = (int32_t) st_ulaw2linear16(*((uint8_t*) m->ptr));
+                v = ((v * lo) >> 16) + (v * hi);
+                sum += v;
             }
-
-            break;
+            m->ptr = (uint8_t*) m->ptr + 1;
         }
 
-        case PA_SAMPLE_U8: {
-            unsigned channel = 0;
+        sum = PA_CLAMP_UNLIKELY(sum, -0x8000, 0x7FFF);
+        *((uint8_t*) data) = (uint8_t) st_14linear2ulaw((int16_t) sum >> 2);
 
-            calc_linear_integer_stream_volumes(streams, nstreams, volume, spec);
+        data = (uint8_t*) data + 1;
 
-            while (data < end) {
-                int32_t sum = 0;
-                unsigned i;
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
 
-                for (i = 0; i < nstreams; i++) {
-                    pa_mix_info *m = streams + i;
-                    int32_t v, cv = m->linear[channel].i;
+static void pa_mix_alaw_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    unsigned channel = 0;
 
-                    if (PA_LIKELY(cv > 0)) {
+    while (data < end) {
+        int32_t sum = 0;
+        unsigned i;
 
-                        v = (int32_t) *((uint8_t*) m->ptr) - 0x80;
-                        v = (v * cv) >> 16;
-                        sum += v;
-                    }
-                    m->ptr = (uint8_t*) m->ptr + 1;
-                }
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32_t v, hi, lo, cv = m->linear[channel].i;
 
-                sum = PA_CLAMP_UNLIKELY(sum, -0x80, 0x7F);
-                *((uint8_t*) data) = (uint8_t) (sum + 0x80);
+            if (PA_LIKELY(cv > 0)) {
 
-                data = (uint8_t*) data + 1;
+                hi = cv >> 16;
+                lo = cv & 0xFFFF;
 
-                if (PA_UNLIKELY(++channel >= spec->channels))
-                    channel = 0;
+                v = (int32_t) st_alaw2linear16(*((uint8_t*) m->ptr));
+                v = ((v * lo) >> 16) + (v * hi);
+                sum += v;
             }
-
-            break;
+            m->ptr = (uint8_t*) m->ptr + 1;
         }
 
-        case PA_SAMPLE_ULAW: {
-            unsigned channel = 0;
-
-            calc_linear_integer_stream_volumes(streams, nstreams, volume, spec);
-
-            while (data < end) {
-                int32_t sum = 0;
-                unsigned i;
+        sum = PA_CLAMP_UNLIKELY(sum, -0x8000, 0x7FFF);
+        *((uint8_t*) data) = (uint8_t) st_13linear2alaw((int16_t) sum >> 3);
 
-                for (i = 0; i < nstreams; i++) {
-                    pa_mix_info *m = streams + i;
-                    int32_t v, hi, lo, cv = m->linear[channel].i;
+        data = (uint8_t*) data + 1;
 
-                    if (PA_LIKELY(cv > 0)) {
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
 
-                        hi = cv >> 16;
-                        lo = cv & 0xFFFF;
+static void pa_mix_float32ne_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    unsigned channel = 0;
 
-                        v = (int32_t) st_ulaw2linear16(*((uint8_t*) m->ptr));
-                        v = ((v * lo) >> 16) + (v * hi);
-                        sum += v;
-                    }
-                    m->ptr = (uint8_t*) m->ptr + 1;
-                }
+    while (data < end) {
+        float sum = 0;
+        unsigned i;
 
-                sum = PA_CLAMP_UNLIKELY(sum, -0x8000, 0x7FFF);
-                *((uint8_t*) data) = (uint8_t) st_14linear2ulaw((int16_t) sum >> 2);
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            float v, cv = m->linear[channel].f;
 
-                data = (uint8_t*) data + 1;
+            if (PA_LIKELY(cv > 0)) {
 
-                if (PA_UNLIKELY(++channel >= spec->channels))
-                    channel = 0;
+                v = *((float*) m->ptr);
+                v *= cv;
+                sum += v;
             }
-
-            break;
+            m->ptr = (uint8_t*) m->ptr + sizeof(float);
         }
 
-        case PA_SAMPLE_ALAW: {
-            unsigned channel = 0;
-
-            calc_linear_integer_stream_volumes(streams, nstreams, volume, spec);
-
-            while (data < end) {
-                int32_t sum = 0;
-                unsigned i;
+        *((float*) data) = sum;
 
-                for (i = 0; i < nstreams; i++) {
-                    pa_mix_info *m = streams + i;
-                    int32_t v, hi, lo, cv = m->linear[channel].i;
+        data = (uint8_t*) data + sizeof(float);
 
-                    if (PA_LIKELY(cv > 0)) {
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
 
-                        hi = cv >> 16;
-                        lo = cv & 0xFFFF;
+static void pa_mix_float32re_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end) {
+    unsigned channel = 0;
 
-                        v = (int32_t) st_alaw2linear16(*((uint8_t*) m->ptr));
-                        v = ((v * lo) >> 16) + (v * hi);
-                        sum += v;
-                    }
-                    m->ptr = (uint8_t*) m->ptr + 1;
-                }
+    while (data < end) {
+        float sum = 0;
+        unsigned i;
 
-                sum = PA_CLAMP_UNLIKELY(sum, -0x8000, 0x7FFF);
-                *((uint8_t*) data) = (uint8_t) st_13linear2alaw((int16_t) sum >> 3);
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            float v, cv = m->linear[channel].f;
 
-                data = (uint8_t*) data + 1;
+            if (PA_LIKELY(cv > 0)) {
 
-                if (PA_UNLIKELY(++channel >= spec->channels))
-                    channel = 0;
+                v = PA_FLOAT32_SWAP(*(float*) m->ptr);
+                v *= cv;
+                sum += v;
             }
-
-            break;
+            m->ptr = (uint8_t*) m->ptr + sizeof(float);
         }
 
-        case PA_SAMPLE_FLOAT32NE: {
-            unsigned channel = 0;
-
-            calc_linear_float_stream_volumes(streams, nstreams, volume, spec);
-
-            while (data < end) {
-                float sum = 0;
-                unsigned i;
+        *((float*) data) = PA_FLOAT32_SWAP(sum);
 
-                for (i = 0; i < nstreams; i++) {
-                    pa_mix_info *m = streams + i;
-                    float v, cv = m->linear[channel].f;
+        data = (uint8_t*) data + sizeof(float);
 
-                    if (PA_LIKELY(cv > 0)) {
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
 
-                        v = *((float*) m->ptr);
-                        v *= cv;
-                        sum += v;
-                    }
-                    m->ptr = (uint8_t*) m->ptr + sizeof(float);
-                }
+static pa_do_mix_func_t do_mix_table[] = {
+    [PA_SAMPLE_U8]        = (pa_do_mix_func_t) pa_mix_u8_c,
+    [PA_SAMPLE_ALAW]      = (pa_do_mix_func_t) pa_mix_alaw_c,
+    [PA_SAMPLE_ULAW]      = (pa_do_mix_func_t) pa_mix_ulaw_c,
+    [PA_SAMPLE_S16NE]     = (pa_do_mix_func_t) pa_mix_s16ne_c,
+    [PA_SAMPLE_S16RE]     = (pa_do_mix_func_t) pa_mix_s16re_c,
+    [PA_SAMPLE_FLOAT32NE] = (pa_do_mix_func_t) pa_mix_float32ne_c,
+    [PA_SAMPLE_FLOAT32RE] = (pa_do_mix_func_t) pa_mix_float32re_c,
+    [PA_SAMPLE_S32NE]     = (pa_do_mix_func_t) pa_mix_s32ne_c,
+    [PA_SAMPLE_S32RE]     = (pa_do_mix_func_t) pa_mix_s32re_c,
+    [PA_SAMPLE_S24NE]     = (pa_do_mix_func_t) pa_mix_s24ne_c,
+    [PA_SAMPLE_S24RE]     = (pa_do_mix_func_t) pa_mix_s24re_c,
+    [PA_SAMPLE_S24_32NE]  = (pa_do_mix_func_t) pa_mix_s24_32ne_c,
+    [PA_SAMPLE_S24_32RE]  = (pa_do_mix_func_t) pa_mix_s24_32re_c
+};
 
-                *((float*) data) = sum;
+pa_do_mix_func_t pa_get_mix_func(pa_sample_format_t f) {
+    pa_assert(f >= 0);
+    pa_assert(f < PA_SAMPLE_MAX);
 
-                data = (uint8_t*) data + sizeof(float);
+    return do_mix_table[f];
+}
 
-                if (PA_UNLIKELY(++channel >= spec->channels))
-                    channel = 0;
-            }
+void pa_set_mix_func(pa_sample_format_t f, pa_do_mix_func_t func) {
+    pa_assert(f >= 0);
+    pa_assert(f < PA_SAMPLE_MAX);
 
-            break;
-        }
+    do_mix_table[f] = func;
+}
 
-        case PA_SAMPLE_FLOAT32RE: {
-            unsigned channel = 0;
+size_t pa_mix(
+        pa_mix_info streams[],
+        unsigned nstreams,
+        void *data,
+        size_t length,
+        const pa_sample_spec *spec,
+        const pa_cvolume *volume,
+        pa_bool_t mute) {
 
-            calc_linear_float_stream_volumes(streams, nstreams, volume, spec);
+    pa_cvolume full_volume;
+    pa_do_mix_func_t do_mix;
+    unsigned k;
+    unsigned z;
+    void *end;
 
-            while (data < end) {
-                float sum = 0;
-                unsigned i;
+    pa_assert(streams);
+    pa_assert(data);
+    pa_assert(length);
+    pa_assert(spec);
 
-                for (i = 0; i < nstreams; i++) {
-                    pa_mix_info *m = streams + i;
-                    float v, cv = m->linear[channel].f;
+    if (!volume)
+        volume = pa_cvolume_reset(&full_volume, spec->channels);
 
-                    if (PA_LIKELY(cv > 0)) {
+    if (mute || pa_cvolume_is_muted(volume) || nstreams <= 0) {
+        pa_silence_memory(data, length, spec);
+        return length;
+    }
 
-                        v = PA_FLOAT32_SWAP(*(float*) m->ptr);
-                        v *= cv;
-                        sum += v;
-                    }
-                    m->ptr = (uint8_t*) m->ptr + sizeof(float);
-                }
+    if (!(do_mix = pa_get_mix_func(spec->format))) {
+        pa_log_error("Unable to mix audio data of format %s.", pa_sample_format_to_string(spec->format));
+        pa_assert_not_reached();
+    }
 
-                *((float*) data) = PA_FLOAT32_SWAP(sum);
+    for (k = 0; k < nstreams; k++)
+        streams[k].ptr = (uint8_t*) pa_memblock_acquire(streams[k].chunk.memblock) + streams[k].chunk.index;
 
-                data = (uint8_t*) data + sizeof(float);
+    for (z = 0; z < nstreams; z++)
+        if (length > streams[z].chunk.length)
+            length = streams[z].chunk.length;
 
-                if (PA_UNLIKELY(++channel >= spec->channels))
-                    channel = 0;
-            }
+    end = (uint8_t*) data + length;
 
-            break;
-        }
+    if (spec->format == PA_SAMPLE_FLOAT32NE || spec->format == PA_SAMPLE_FLOAT32RE)
+        calc_linear_float_stream_volumes(streams, nstreams, volume, spec);
+    else
+        calc_linear_integer_stream_volumes(streams, nstreams, volume, spec);
 
-        default:
-            pa_log_error("Unable to mix audio data of format %s.", pa_sample_format_to_string(spec->format));
-            pa_assert_not_reached();
-    }
+    do_mix(streams, nstreams, spec->channels, data, end);
 
     for (k = 0; k < nstreams; k++)
         pa_memblock_release(streams[k].chunk.memblock);
@@ -748,6 +738,88 @@ void pa_volume_memchunk(
     pa_memblock_release(c->memblock);
 }
 
+void pa_volume_share_init(pa_volume_share *share) {
+    unsigned i;
+
+    pa_assert(share);
+
+    for (i = 0; i < PA_VOLUME_SHARE_MAX; i++) {
+        pa_memchunk_reset(&share->entries[i].in);
+        pa_memchunk_reset(&share->entries[i].out);
+    }
+
+    share->next = 0;
+}
+
+void pa_volume_share_done(pa_volume_share *share) {
+    unsigned i;
+
+    pa_assert(share);
+
+    for (i = 0; i < PA_VOLUME_SHARE_MAX; i++) {
+        if (share->entries[i].in.memblock)
+            pa_memblock_unref(share->entries[i].in.memblock);
+        if (share->entries[i].out.memblock)
+            pa_memblock_unref(share->entries[i].out.memblock);
+    }
+
+    pa_volume_share_init(share);
+}
+
+void pa_volume_memchunk_shared(
+        pa_volume_share *share,
+        pa_memchunk *c,
+        const pa_sample_spec *spec,
+        const pa_cvolume *volume) {
+
+    unsigned i;
+
+    pa_assert(share);
+    pa_assert(c);
+    pa_assert(c->memblock);
+    pa_assert(spec);
+    pa_assert(volume);
+
+    for (i = 0; i < PA_VOLUME_SHARE_MAX; i++) {
+
+        /* The share holds a reference to the input block, so it
+         * cannot have been modified or replaced in the meantime */
+        if (share->entries[i].in.memblock != c->memblock ||
+            share->entries[i].in.index != c->index ||
+            share->entries[i].in.length != c->length ||
+            !pa_sample_spec_equal(&share->entries[i].spec, spec) ||
+            !pa_cvolume_equal(&share->entries[i].volume, volume))
+            continue;
+
+        pa_memblock_unref(c->memblock);
+        *c = share->entries[i].out;
+        pa_memblock_ref(c->memblock);
+        return;
+    }
+
+    i = share->next;
+    share->next = (share->next + 1) % PA_VOLUME_SHARE_MAX;
+
+    if (share->entries[i].in.memblock)
+        pa_memblock_unref(share->entries[i].in.memblock);
+    if (share->entries[i].out.memblock)
+        pa_memblock_unref(share->entries[i].out.memblock);
+
+    /* With the reference of the share the block is never changed in
+     * place, it is always copied */
+    share->entries[i].in = *c;
+    pa_memblock_ref(c->memblock);
+
+    pa_memchunk_make_writable(c, 0);
+    pa_volume_memchunk(c, spec, volume);
+
+    share->entries[i].out = *c;
+    pa_memblock_ref(c->memblock);
+
+    share->entries[i].spec = *spec;
+    share->entries[i].volume = *volume;
+}
+
 size_t pa_frame_align(size_t l, const pa_sample_spec *ss) {
     size_t fs;
 
@@ -919,6 +991,28 @@ pa_memchunk* pa_silence_memchunk_get(pa_silence_cache *cache, pa_mempool *pool,
     return ret;
 }
 
+pa_memchunk* pa_silence_memchunk_get_full(pa_silence_cache *cache, pa_mempool *pool, pa_memchunk* ret, const pa_sample_spec *spec, size_t length) {
+
+    pa_assert(length > 0);
+    pa_assert(pa_frame_aligned(length, spec));
+
+    pa_silence_memchunk_get(cache, pool, ret, spec, length);
+
+    if (ret->length >= length) {
+        ret->length = length;
+        return ret;
+    }
+
+    pa_memblock_unref(ret->memblock);
+
+    ret->memblock = pa_silence_memblock(pa_memblock_new(pool, length), spec);
+    pa_memblock_set_is_silence(ret->memblock, TRUE);
+    ret->index = 0;
+    ret->length = length;
+
+    return ret;
+}
+
 void pa_sample_clamp(pa_sample_format_t format, void *dst, size_t dstr, const void *src, size_t sstr, unsigned n) {
     const float *s;
     float *d;
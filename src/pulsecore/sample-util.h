@@ -44,6 +44,15 @@ pa_memblock* pa_silence_memblock(pa_memblock *b, const pa_sample_spec *spec);
 
 pa_memchunk* pa_silence_memchunk_get(pa_silence_cache *cache, pa_mempool *pool, pa_memchunk* ret, const pa_sample_spec *spec, size_t length);
 
+/* Like pa_silence_memchunk_get(), but always returns length bytes,
+ * in a new block flagged as silence if the cached one is too short */
+pa_memchunk* pa_silence_memchunk_get_full(pa_silence_cache *cache, pa_mempool *pool, pa_memchunk* ret, const pa_sample_spec *spec, size_t length);
+
+/* The per-stream volume factors in pa_mix_info are repeated for this
+ * many entries past the last channel, so that vectorized mixers can
+ * load the factors for a full register starting at any channel. */
+#define PA_MIX_VOLUME_PADDING 16U
+
 typedef struct pa_mix_info {
     pa_memchunk chunk;
     pa_cvolume volume;
@@ -55,7 +64,7 @@ typedef struct pa_mix_info {
     union {
         int32_t i;
         float f;
-    } linear[PA_CHANNELS_MAX];
+    } linear[PA_CHANNELS_MAX + PA_MIX_VOLUME_PADDING];
 } pa_mix_info;
 
 size_t pa_mix(
@@ -67,11 +76,45 @@ size_t pa_mix(
     const pa_cvolume *volume,
     pa_bool_t mute);
 
+typedef void (*pa_do_mix_func_t) (pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, void *end);
+
+pa_do_mix_func_t pa_get_mix_func(pa_sample_format_t f);
+void pa_set_mix_func(pa_sample_format_t f, pa_do_mix_func_t func);
+
 void pa_volume_memchunk(
     pa_memchunk*c,
     const pa_sample_spec *spec,
     const pa_cvolume *volume);
 
+#define PA_VOLUME_SHARE_MAX 4
+
+/* The last few chunks that were volume adjusted, with their results,
+ * so that the outputs of one source that apply the same volume to the
+ * same chunk only do it once. To be used by one thread only. */
+typedef struct pa_volume_share {
+    struct {
+        pa_memchunk in, out;
+        pa_sample_spec spec;
+        pa_cvolume volume;
+    } entries[PA_VOLUME_SHARE_MAX];
+    unsigned next;
+} pa_volume_share;
+
+void pa_volume_share_init(pa_volume_share *share);
+
+/* Drops all results, the share may be used again afterwards */
+void pa_volume_share_done(pa_volume_share *share);
+
+/* Like pa_memchunk_make_writable() followed by pa_volume_memchunk(),
+ * except that the result is taken from share if another caller
+ * already computed it. c is replaced by a chunk that may be shared
+ * with others and must not be modified in place. */
+void pa_volume_memchunk_shared(
+    pa_volume_share *share,
+    pa_memchunk *c,
+    const pa_sample_spec *spec,
+    const pa_cvolume *volume);
+
 typedef struct pa_volume_ramp_int_t {
     pa_volume_ramp_type_t type;
     long length;
@@ -120,6 +163,44 @@ typedef void (*pa_do_volume_func_t) (void *samples, void *volumes, unsigned chan
 pa_do_volume_func_t pa_get_volume_func(pa_sample_format_t f);
 void pa_set_volume_func(pa_sample_format_t f, pa_do_volume_func_t func);
 
+/* Multiplies frames frames with linear gains starting at gain[] and
+ * moving by step[] per frame, and leaves gain[] where the ramp
+ * continues. Only defined for the 16 and 32 bit formats. */
+typedef void (*pa_do_volume_ramp_func_t) (void *samples, float *gain, const float *step, unsigned channels, unsigned frames);
+
+pa_do_volume_ramp_func_t pa_get_volume_ramp_func(pa_sample_format_t f);
+void pa_set_volume_ramp_func(pa_sample_format_t f, pa_do_volume_ramp_func_t func);
+
+/* Kernels for filtering in the frequency domain. Complex values are
+ * stored as interleaved real and imaginary parts, like fftwf_complex,
+ * and may be unaligned. */
+
+/* c[k] *= h[k] for n complex values c and n real gains h */
+typedef void (*pa_cmul_real_func_t) (float *c, const float *h, unsigned n);
+
+/* acc[k] += a[k] * b[k] for n complex values */
+typedef void (*pa_cmac_func_t) (float *acc, const float *a, const float *b, unsigned n);
+
+pa_cmul_real_func_t pa_get_cmul_real_func(void);
+void pa_set_cmul_real_func(pa_cmul_real_func_t func);
+
+pa_cmac_func_t pa_get_cmac_func(void);
+void pa_set_cmac_func(pa_cmac_func_t func);
+
+/* Copies n frames of n_dst consecutive channels out of interleaved float
+ * data with stride channels per frame into separate buffers, clamping
+ * them to [-1, 1]. */
+typedef void (*pa_deinterleave_float_func_t) (float *dst[], unsigned n_dst, const float *src, unsigned stride, unsigned n);
+
+/* The reverse, leaving the other channels of each frame in dst alone */
+typedef void (*pa_interleave_float_func_t) (float *dst, unsigned stride, float *const src[], unsigned n_src, unsigned n);
+
+pa_deinterleave_float_func_t pa_get_deinterleave_float_func(void);
+void pa_set_deinterleave_float_func(pa_deinterleave_float_func_t func);
+
+pa_interleave_float_func_t pa_get_interleave_float_func(void);
+void pa_set_interleave_float_func(pa_interleave_float_func_t func);
+
 size_t pa_convert_size(size_t size, const pa_sample_spec *from, const pa_sample_spec *to);
 
 #define PA_CHANNEL_POSITION_MASK_LEFT                                   \
@@ -0,0 +1,523 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#include <pulsecore/g711.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/endianmacros.h>
+#include <pulsecore/sconv-s16le.h>
+#include <pulsecore/sconv-s16be.h>
+
+#include "cpu-x86.h"
+#include "sconv.h"
+
+#if defined (PA_HAVE_X86_TARGET_ATTRIBUTE)
+
+#include <immintrin.h>
+
+/* All conversions here are bit-exact with the C versions in sconv.c and
+ * sconv-s16le.c: divisions are done as divisions, the same rounding is
+ * used and where the C code goes through double precision, so do we.
+ * x86 is always little endian, so LE is NE. Leftover samples are
+ * handed to the C versions. */
+
+static float ulaw_to_float_table[256], alaw_to_float_table[256];
+static uint8_t float_to_ulaw_table[0x4000], float_to_alaw_table[0x2000];
+
+PA_X86_TARGET("avx2")
+static inline __m256i swap16_avx2(__m256i x) {
+    const __m256i mask = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                          1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    return _mm256_shuffle_epi8(x, mask);
+}
+
+PA_X86_TARGET("avx2")
+static inline __m256i swap32_avx2(__m256i x) {
+    const __m256i mask = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                          3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    return _mm256_shuffle_epi8(x, mask);
+}
+
+/* Clamps to [-1, 1], scales in double precision and rounds to nearest */
+PA_X86_TARGET("avx2")
+static inline __m256i float_to_s32_avx2(__m256 v) {
+    const __m256d scale = _mm256_set1_pd((double) 0x7FFFFFFF);
+    __m128i lo, hi;
+
+    v = _mm256_max_ps(_mm256_min_ps(v, _mm256_set1_ps(1.0f)), _mm256_set1_ps(-1.0f));
+
+    lo = _mm256_cvtpd_epi32(_mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(v)), scale));
+    hi = _mm256_cvtpd_epi32(_mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)), scale));
+
+    return _mm256_setr_m128i(lo, hi);
+}
+
+/* Takes s24 samples in the upper 24 bits of each lane */
+PA_X86_TARGET("avx2")
+static inline __m256 s24_to_float_avx2(__m256i s) {
+    /* Dividing by 0x7FFFFFFF as float is dividing by 2^31 */
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(s), _mm256_set1_ps(1.0f / 2147483648.0f));
+}
+
+PA_X86_TARGET("avx2")
+static inline __m256 s32_to_float_avx2(__m256i s) {
+    const __m256d scale = _mm256_set1_pd((double) 0x7FFFFFFF);
+    __m128 lo, hi;
+
+    lo = _mm256_cvtpd_ps(_mm256_div_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(s)), scale));
+    hi = _mm256_cvtpd_ps(_mm256_div_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(s, 1)), scale));
+
+    return _mm256_setr_m128(lo, hi);
+}
+
+/* s16 */
+
+PA_X86_TARGET("avx2")
+static inline void s16_to_float32ne_avx2(unsigned n, const int16_t *a, float *b, pa_bool_t swap) {
+    const __m256 scale = _mm256_set1_ps((float) 0x7FFF);
+
+    for (; n >= 16; n -= 16, a += 16, b += 16) {
+        __m256i s = _mm256_loadu_si256((const __m256i*) a);
+
+        if (swap)
+            s = swap16_avx2(s);
+
+        _mm256_storeu_ps(b, _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(s))), scale));
+        _mm256_storeu_ps(b + 8, _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(s, 1))), scale));
+    }
+
+    if (swap)
+        pa_sconv_s16be_to_float32ne(n, a, b);
+    else
+        pa_sconv_s16le_to_float32ne(n, a, b);
+}
+
+PA_X86_TARGET("avx2")
+static inline void s16_from_float32ne_avx2(unsigned n, const float *a, int16_t *b, pa_bool_t swap) {
+    const __m256 scale = _mm256_set1_ps((float) 0x7FFF), one = _mm256_set1_ps(1.0f), mone = _mm256_set1_ps(-1.0f);
+
+    for (; n >= 16; n -= 16, a += 16, b += 16) {
+        __m256 v0, v1;
+        __m256i s;
+
+        v0 = _mm256_max_ps(_mm256_min_ps(_mm256_loadu_ps(a), one), mone);
+        v1 = _mm256_max_ps(_mm256_min_ps(_mm256_loadu_ps(a + 8), one), mone);
+
+        /* The pack works on each 128 bit lane separately */
+        s = _mm256_packs_epi32(_mm256_cvtps_epi32(_mm256_mul_ps(v0, scale)), _mm256_cvtps_epi32(_mm256_mul_ps(v1, scale)));
+        s = _mm256_permute4x64_epi64(s, 0xD8);
+
+        if (swap)
+            s = swap16_avx2(s);
+
+        _mm256_storeu_si256((__m256i*) b, s);
+    }
+
+    if (swap)
+        pa_sconv_s16be_from_float32ne(n, a, b);
+    else
+        pa_sconv_s16le_from_float32ne(n, a, b);
+}
+
+PA_X86_TARGET("avx2")
+static void s16le_to_float32ne_avx2(unsigned n, const int16_t *a, float *b) {
+    s16_to_float32ne_avx2(n, a, b, FALSE);
+}
+
+PA_X86_TARGET("avx2")
+static void s16be_to_float32ne_avx2(unsigned n, const int16_t *a, float *b) {
+    s16_to_float32ne_avx2(n, a, b, TRUE);
+}
+
+PA_X86_TARGET("avx2")
+static void s16le_from_float32ne_avx2(unsigned n, const float *a, int16_t *b) {
+    s16_from_float32ne_avx2(n, a, b, FALSE);
+}
+
+PA_X86_TARGET("avx2")
+static void s16be_from_float32ne_avx2(unsigned n, const float *a, int16_t *b) {
+    s16_from_float32ne_avx2(n, a, b, TRUE);
+}
+
+/* s32 */
+
+PA_X86_TARGET("avx2")
+static inline void s32_to_float32ne_avx2(unsigned n, const int32_t *a, float *b, pa_bool_t swap) {
+
+    for (; n >= 8; n -= 8, a += 8, b += 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i*) a);
+
+        if (swap)
+            s = swap32_avx2(s);
+
+        _mm256_storeu_ps(b, s32_to_float_avx2(s));
+    }
+
+    if (swap)
+        pa_sconv_s32be_to_float32ne(n, a, b);
+    else
+        pa_sconv_s32le_to_float32ne(n, a, b);
+}
+
+PA_X86_TARGET("avx2")
+static inline void s32_from_float32ne_avx2(unsigned n, const float *a, int32_t *b, pa_bool_t swap) {
+
+    for (; n >= 8; n -= 8, a += 8, b += 8) {
+        __m256i s = float_to_s32_avx2(_mm256_loadu_ps(a));
+
+        if (swap)
+            s = swap32_avx2(s);
+
+        _mm256_storeu_si256((__m256i*) b, s);
+    }
+
+    if (swap)
+        pa_sconv_s32be_from_float32ne(n, a, b);
+    else
+        pa_sconv_s32le_from_float32ne(n, a, b);
+}
+
+PA_X86_TARGET("avx2")
+static void s32le_to_float32ne_avx2(unsigned n, const int32_t *a, float *b) {
+    s32_to_float32ne_avx2(n, a, b, FALSE);
+}
+
+PA_X86_TARGET("avx2")
+static void s32be_to_float32ne_avx2(unsigned n, const int32_t *a, float *b) {
+    s32_to_float32ne_avx2(n, a, b, TRUE);
+}
+
+PA_X86_TARGET("avx2")
+static void s32le_from_float32ne_avx2(unsigned n, const float *a, int32_t *b) {
+    s32_from_float32ne_avx2(n, a, b, FALSE);
+}
+
+PA_X86_TARGET("avx2")
+static void s32be_from_float32ne_avx2(unsigned n, const float *a, int32_t *b) {
+    s32_from_float32ne_avx2(n, a, b, TRUE);
+}
+
+/* s24_32 */
+
+PA_X86_TARGET("avx2")
+static inline void s24_32_to_float32ne_avx2(unsigned n, const uint32_t *a, float *b, pa_bool_t swap) {
+
+    for (; n >= 8; n -= 8, a += 8, b += 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i*) a);
+
+        if (swap)
+            s = swap32_avx2(s);
+
+        _mm256_storeu_ps(b, s24_to_float_avx2(_mm256_slli_epi32(s, 8)));
+    }
+
+    if (swap)
+        pa_sconv_s24_32be_to_float32ne(n, (const uint8_t*) a, b);
+    else
+        pa_sconv_s24_32le_to_float32ne(n, a, b);
+}
+
+PA_X86_TARGET("avx2")
+static inline void s24_32_from_float32ne_avx2(unsigned n, const float *a, uint32_t *b, pa_bool_t swap) {
+
+    for (; n >= 8; n -= 8, a += 8, b += 8) {
+        __m256i s = _mm256_srli_epi32(float_to_s32_avx2(_mm256_loadu_ps(a)), 8);
+
+        if (swap)
+            s = swap32_avx2(s);
+
+        _mm256_storeu_si256((__m256i*) b, s);
+    }
+
+    if (swap)
+        pa_sconv_s24_32be_from_float32ne(n, a, (uint8_t*) b);
+    else
+        pa_sconv_s24_32le_from_float32ne(n, a, b);
+}
+
+PA_X86_TARGET("avx2")
+static void s24_32le_to_float32ne_avx2(unsigned n, const uint32_t *a, float *b) {
+    s24_32_to_float32ne_avx2(n, a, b, FALSE);
+}
+
+PA_X86_TARGET("avx2")
+static void s24_32be_to_float32ne_avx2(unsigned n, const uint32_t *a, float *b) {
+    s24_32_to_float32ne_avx2(n, a, b, TRUE);
+}
+
+PA_X86_TARGET("avx2")
+static void s24_32le_from_float32ne_avx2(unsigned n, const float *a, uint32_t *b) {
+    s24_32_from_float32ne_avx2(n, a, b, FALSE);
+}
+
+PA_X86_TARGET("avx2")
+static void s24_32be_from_float32ne_avx2(unsigned n, const float *a, uint32_t *b) {
+    s24_32_from_float32ne_avx2(n, a, b, TRUE);
+}
+
+/* s24, four samples per 128 bit lane, the second lane is loaded from
+ * byte 12 on. The shuffles move the three bytes into the upper 24 bits
+ * of each 32 bit lane and back. */
+
+PA_X86_TARGET("avx2")
+static inline void s24_to_float32ne_avx2(unsigned n, const uint8_t *a, float *b, pa_bool_t swap) {
+    const __m256i le = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+                                        -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    const __m256i be = _mm256_setr_epi8(-1, 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9,
+                                        -1, 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9);
+
+    /* The second load reads four bytes past the eight samples */
+    for (; n >= 10; n -= 8, a += 24, b += 8) {
+        __m256i s;
+
+        s = _mm256_setr_m128i(_mm_loadu_si128((const __m128i*) a), _mm_loadu_si128((const __m128i*) (a + 12)));
+        s = _mm256_shuffle_epi8(s, swap ? be : le);
+
+        _mm256_storeu_ps(b, s24_to_float_avx2(s));
+    }
+
+    if (swap)
+        pa_sconv_s24be_to_float32ne(n, a, b);
+    else
+        pa_sconv_s24le_to_float32ne(n, a, b);
+}
+
+PA_X86_TARGET("avx2")
+static inline void s24_from_float32ne_avx2(unsigned n, const float *a, uint8_t *b, pa_bool_t swap) {
+    const __m256i le = _mm256_setr_epi8(1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, -1, -1, -1, -1,
+                                        1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, -1, -1, -1, -1);
+    const __m256i be = _mm256_setr_epi8(3, 2, 1, 7, 6, 5, 11, 10, 9, 15, 14, 13, -1, -1, -1, -1,
+                                        3, 2, 1, 7, 6, 5, 11, 10, 9, 15, 14, 13, -1, -1, -1, -1);
+
+    for (; n >= 8; n -= 8, a += 8, b += 24) {
+        __m256i s;
+        __m128i lo, hi;
+        int32_t last;
+
+        s = _mm256_shuffle_epi8(float_to_s32_avx2(_mm256_loadu_ps(a)), swap ? be : le);
+        lo = _mm256_castsi256_si128(s);
+        hi = _mm256_extracti128_si256(s, 1);
+
+        _mm_storel_epi64((__m128i*) b, lo);
+        last = _mm_cvtsi128_si32(_mm_srli_si128(lo, 8));
+        memcpy(b + 8, &last, 4);
+        _mm_storel_epi64((__m128i*) (b + 12), hi);
+        last = _mm_cvtsi128_si32(_mm_srli_si128(hi, 8));
+        memcpy(b + 20, &last, 4);
+    }
+
+    if (swap)
+        pa_sconv_s24be_from_float32ne(n, a, b);
+    else
+        pa_sconv_s24le_from_float32ne(n, a, b);
+}
+
+PA_X86_TARGET("avx2")
+static void s24le_to_float32ne_avx2(unsigned n, const uint8_t *a, float *b) {
+    s24_to_float32ne_avx2(n, a, b, FALSE);
+}
+
+PA_X86_TARGET("avx2")
+static void s24be_to_float32ne_avx2(unsigned n, const uint8_t *a, float *b) {
+    s24_to_float32ne_avx2(n, a, b, TRUE);
+}
+
+PA_X86_TARGET("avx2")
+static void s24le_from_float32ne_avx2(unsigned n, const float *a, uint8_t *b) {
+    s24_from_float32ne_avx2(n, a, b, FALSE);
+}
+
+PA_X86_TARGET("avx2")
+static void s24be_from_float32ne_avx2(unsigned n, const float *a, uint8_t *b) {
+    s24_from_float32ne_avx2(n, a, b, TRUE);
+}
+
+/* float32re, the same function converts in both directions */
+
+PA_X86_TARGET("avx2")
+static void float32re_to_float32ne_avx2(unsigned n, const float *a, float *b) {
+
+    for (; n >= 8; n -= 8, a += 8, b += 8)
+        _mm256_storeu_si256((__m256i*) b, swap32_avx2(_mm256_loadu_si256((const __m256i*) a)));
+
+    for (; n > 0; n--, a++, b++)
+        *((uint32_t *) b) = PA_UINT32_SWAP(*((uint32_t *) a));
+}
+
+/* u8 */
+
+PA_X86_TARGET("avx2")
+static void u8_to_float32ne_avx2(unsigned n, const uint8_t *a, float *b) {
+    const __m256 scale = _mm256_set1_ps(1.0f / 128.0f), one = _mm256_set1_ps(1.0f);
+
+    /* Both operations are exact in single precision */
+    for (; n >= 8; n -= 8, a += 8, b += 8) {
+        __m256i s = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) a));
+
+        _mm256_storeu_ps(b, _mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(s), scale), one));
+    }
+
+    for (; n > 0; n--, a++, b++)
+        *b = (*a * 1.0/128.0) - 1.0;
+}
+
+PA_X86_TARGET("avx2")
+static void u8_from_float32ne_avx2(unsigned n, const float *a, uint8_t *b) {
+    const __m256d scale = _mm256_set1_pd(127.0), offset = _mm256_set1_pd(128.0);
+    const __m256 min = _mm256_setzero_ps(), max = _mm256_set1_ps(255.0f);
+
+    for (; n >= 8; n -= 8, a += 8, b += 8) {
+        __m256 v;
+        __m128 lo, hi;
+        __m256i s;
+        __m128i p;
+
+        v = _mm256_loadu_ps(a);
+        lo = _mm256_cvtpd_ps(_mm256_add_pd(_mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(v)), scale), offset));
+        hi = _mm256_cvtpd_ps(_mm256_add_pd(_mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)), scale), offset));
+        v = _mm256_max_ps(_mm256_min_ps(_mm256_setr_m128(lo, hi), max), min);
+
+        s = _mm256_cvtps_epi32(v);
+        p = _mm_packus_epi16(_mm_packs_epi32(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1)), _mm_setzero_si128());
+        _mm_storel_epi64((__m128i*) b, p);
+    }
+
+    for (; n > 0; n--, a++, b++) {
+        float v;
+        v = (*a * 127.0) + 128.0;
+        v = PA_CLAMP_UNLIKELY (v, 0.0, 255.0);
+        *b = rint (v);
+    }
+}
+
+/* ulaw and alaw are table lookups, the tables are filled in from the
+ * g711 functions on init */
+
+PA_X86_TARGET("avx2")
+static inline void law_to_float32ne_avx2(unsigned n, const uint8_t *a, float *b, const float *table) {
+
+    for (; n >= 8; n -= 8, a += 8, b += 8)
+        _mm256_storeu_ps(b, _mm256_i32gather_ps(table, _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) a)), 4));
+
+    for (; n > 0; n--, a++, b++)
+        *b = table[*a];
+}
+
+PA_X86_TARGET("avx2")
+static inline void law_from_float32ne_avx2(unsigned n, const float *a, uint8_t *b, const uint8_t *table, float scale, int offset) {
+    const __m256 one = _mm256_set1_ps(1.0f), mone = _mm256_set1_ps(-1.0f), s = _mm256_set1_ps(scale);
+    const __m256i o = _mm256_set1_epi32(offset);
+
+    for (; n >= 8; n -= 8, a += 8, b += 8) {
+        int32_t idx[8];
+        __m256 v;
+        unsigned i;
+
+        v = _mm256_max_ps(_mm256_min_ps(_mm256_loadu_ps(a), one), mone);
+        _mm256_storeu_si256((__m256i*) idx, _mm256_add_epi32(_mm256_cvtps_epi32(_mm256_mul_ps(v, s)), o));
+
+        for (i = 0; i < 8; i++)
+            b[i] = table[idx[i]];
+    }
+
+    for (; n > 0; n--, a++, b++) {
+        float v = *a;
+        v = PA_CLAMP_UNLIKELY(v, -1.0f, 1.0f);
+        *b = table[lrintf(v * scale) + offset];
+    }
+}
+
+PA_X86_TARGET("avx2")
+static void ulaw_to_float32ne_avx2(unsigned n, const uint8_t *a, float *b) {
+    law_to_float32ne_avx2(n, a, b, ulaw_to_float_table);
+}
+
+PA_X86_TARGET("avx2")
+static void alaw_to_float32ne_avx2(unsigned n, const uint8_t *a, float *b) {
+    law_to_float32ne_avx2(n, a, b, alaw_to_float_table);
+}
+
+PA_X86_TARGET("avx2")
+static void ulaw_from_float32ne_avx2(unsigned n, const float *a, uint8_t *b) {
+    law_from_float32ne_avx2(n, a, b, float_to_ulaw_table, (float) 0x1FFF, 0x2000);
+}
+
+PA_X86_TARGET("avx2")
+static void alaw_from_float32ne_avx2(unsigned n, const float *a, uint8_t *b) {
+    law_from_float32ne_avx2(n, a, b, float_to_alaw_table, (float) 0xFFF, 0x1000);
+}
+
+static void init_law_tables(void) {
+    unsigned i;
+
+    for (i = 0; i < 256; i++) {
+        ulaw_to_float_table[i] = (float) st_ulaw2linear16((uint8_t) i) / 0x8000;
+        alaw_to_float_table[i] = (float) st_alaw2linear16((uint8_t) i) / 0x8000;
+    }
+
+    for (i = 0; i < PA_ELEMENTSOF(float_to_ulaw_table); i++)
+        float_to_ulaw_table[i] = st_14linear2ulaw((int16_t) ((int) i - 0x2000));
+    for (i = 0; i < PA_ELEMENTSOF(float_to_alaw_table); i++)
+        float_to_alaw_table[i] = st_13linear2alaw((int16_t) ((int) i - 0x1000));
+}
+#endif /* defined (PA_HAVE_X86_TARGET_ATTRIBUTE) */
+
+void pa_convert_func_init_avx(pa_cpu_x86_flag_t flags) {
+#if defined (PA_HAVE_X86_TARGET_ATTRIBUTE)
+
+    if (flags & PA_CPU_X86_AVX2) {
+        pa_log_info("Initialising AVX2 optimized conversions.");
+
+        init_law_tables();
+
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_U8, (pa_convert_func_t) u8_to_float32ne_avx2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_ALAW, (pa_convert_func_t) alaw_to_float32ne_avx2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_ULAW, (pa_convert_func_t) ulaw_to_float32ne_avx2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S16LE, (pa_convert_func_t) s16le_to_float32ne_avx2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S16BE, (pa_convert_func_t) s16be_to_float32ne_avx2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S32LE, (pa_convert_func_t) s32le_to_float32ne_avx2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S32BE, (pa_convert_func_t) s32be_to_float32ne_avx2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S24LE, (pa_convert_func_t) s24le_to_float32ne_avx2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S24BE, (pa_convert_func_t) s24be_to_float32ne_avx2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S24_32LE, (pa_convert_func_t) s24_32le_to_float32ne_avx2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S24_32BE, (pa_convert_func_t) s24_32be_to_float32ne_avx2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_FLOAT32RE, (pa_convert_func_t) float32re_to_float32ne_avx2);
+
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_U8, (pa_convert_func_t) u8_from_float32ne_avx2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_ALAW, (pa_convert_func_t) alaw_from_float32ne_avx2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_ULAW, (pa_convert_func_t) ulaw_from_float32ne_avx2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S16LE, (pa_convert_func_t) s16le_from_float32ne_avx2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S16BE, (pa_convert_func_t) s16be_from_float32ne_avx2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S32LE, (pa_convert_func_t) s32le_from_float32ne_avx2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S32BE, (pa_convert_func_t) s32be_from_float32ne_avx2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S24LE, (pa_convert_func_t) s24le_from_float32ne_avx2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S24BE, (pa_convert_func_t) s24be_from_float32ne_avx2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S24_32LE, (pa_convert_func_t) s24_32le_from_float32ne_avx2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S24_32BE, (pa_convert_func_t) s24_32be_from_float32ne_avx2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_FLOAT32RE, (pa_convert_func_t) float32re_to_float32ne_avx2);
+    }
+#endif /* defined (PA_HAVE_X86_TARGET_ATTRIBUTE) */
+}
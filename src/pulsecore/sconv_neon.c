@@ -0,0 +1,376 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/endianmacros.h>
+#include <pulsecore/sconv-s16le.h>
+#include <pulsecore/sconv-s16be.h>
+
+#include "cpu-arm.h"
+#include "sconv.h"
+
+#if defined (__arm__) && defined (__ARM_NEON__) && !defined (WORDS_BIGENDIAN)
+
+#include <arm_neon.h>
+
+/* ARMv7 NEON has neither double precision nor a division, so the
+ * divisions by 0x7FFF and 0x7FFFFFFF are done as multiplications, and
+ * S32 is scaled in single precision. Those may differ from the C
+ * versions in the last bit. The S24 divisions are by a power of two and
+ * stay exact, as does the rounding to nearest integer. Leftover samples
+ * are handed to the C versions. */
+
+/* Rounds to nearest even like lrintf(), for |x| < 2^22 */
+static inline int32x4_t round_small_neon(float32x4_t x) {
+    const float32x4_t magic = vdupq_n_f32(12582912.0f);
+
+    return vcvtq_s32_f32(vsubq_f32(vaddq_f32(x, magic), magic));
+}
+
+/* Clamps to [-1, 1] and scales to the full 32 bit range. The conversion
+ * truncates (and saturates at 2^31), the fraction that got lost decides
+ * about rounding it up or down. */
+static inline int32x4_t float_to_s32_neon(float32x4_t v) {
+    float32x4_t x, f;
+    int32x4_t t;
+
+    v = vmaxq_f32(vminq_f32(v, vdupq_n_f32(1.0f)), vdupq_n_f32(-1.0f));
+    x = vmulq_f32(v, vdupq_n_f32((float) 0x7FFFFFFF));
+
+    t = vcvtq_s32_f32(x);
+    f = vsubq_f32(x, vcvtq_f32_s32(t));
+
+    t = vsubq_s32(t, vreinterpretq_s32_u32(vcgeq_f32(f, vdupq_n_f32(0.5f))));
+    t = vaddq_s32(t, vreinterpretq_s32_u32(vcleq_f32(f, vdupq_n_f32(-0.5f))));
+
+    return t;
+}
+
+static inline int16x8_t swap16_neon(int16x8_t x, pa_bool_t swap) {
+    return swap ? vreinterpretq_s16_u8(vrev16q_u8(vreinterpretq_u8_s16(x))) : x;
+}
+
+static inline int32x4_t swap32_neon(int32x4_t x, pa_bool_t swap) {
+    return swap ? vreinterpretq_s32_u8(vrev32q_u8(vreinterpretq_u8_s32(x))) : x;
+}
+
+/* s16 */
+
+static inline void s16_to_float32ne_neon(unsigned n, const int16_t *a, float *b, pa_bool_t swap) {
+    const float32x4_t scale = vdupq_n_f32(1.0f / 0x7FFF);
+
+    for (; n >= 8; n -= 8, a += 8, b += 8) {
+        int16x8_t s = swap16_neon(vld1q_s16(a), swap);
+
+        vst1q_f32(b, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(s))), scale));
+        vst1q_f32(b + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(s))), scale));
+    }
+
+    if (swap)
+        pa_sconv_s16be_to_float32ne(n, a, b);
+    else
+        pa_sconv_s16le_to_float32ne(n, a, b);
+}
+
+static inline void s16_from_float32ne_neon(unsigned n, const float *a, int16_t *b, pa_bool_t swap) {
+    const float32x4_t one = vdupq_n_f32(1.0f), mone = vdupq_n_f32(-1.0f), scale = vdupq_n_f32((float) 0x7FFF);
+
+    for (; n >= 8; n -= 8, a += 8, b += 8) {
+        float32x4_t v0, v1;
+        int16x8_t s;
+
+        v0 = vmulq_f32(vmaxq_f32(vminq_f32(vld1q_f32(a), one), mone), scale);
+        v1 = vmulq_f32(vmaxq_f32(vminq_f32(vld1q_f32(a + 4), one), mone), scale);
+
+        s = vcombine_s16(vqmovn_s32(round_small_neon(v0)), vqmovn_s32(round_small_neon(v1)));
+        vst1q_s16(b, swap16_neon(s, swap));
+    }
+
+    if (swap)
+        pa_sconv_s16be_from_float32ne(n, a, b);
+    else
+        pa_sconv_s16le_from_float32ne(n, a, b);
+}
+
+static void s16le_to_float32ne_neon(unsigned n, const int16_t *a, float *b) {
+    s16_to_float32ne_neon(n, a, b, FALSE);
+}
+
+static void s16be_to_float32ne_neon(unsigned n, const int16_t *a, float *b) {
+    s16_to_float32ne_neon(n, a, b, TRUE);
+}
+
+static void s16le_from_float32ne_neon(unsigned n, const float *a, int16_t *b) {
+    s16_from_float32ne_neon(n, a, b, FALSE);
+}
+
+static void s16be_from_float32ne_neon(unsigned n, const float *a, int16_t *b) {
+    s16_from_float32ne_neon(n, a, b, TRUE);
+}
+
+/* s32 */
+
+static inline void s32_to_float32ne_neon(unsigned n, const int32_t *a, float *b, pa_bool_t swap) {
+    const float32x4_t scale = vdupq_n_f32((float) (1.0 / 0x7FFFFFFF));
+
+    for (; n >= 4; n -= 4, a += 4, b += 4)
+        vst1q_f32(b, vmulq_f32(vcvtq_f32_s32(swap32_neon(vld1q_s32(a), swap)), scale));
+
+    if (swap)
+        pa_sconv_s32be_to_float32ne(n, a, b);
+    else
+        pa_sconv_s32le_to_float32ne(n, a, b);
+}
+
+static inline void s32_from_float32ne_neon(unsigned n, const float *a, int32_t *b, pa_bool_t swap) {
+
+    for (; n >= 4; n -= 4, a += 4, b += 4)
+        vst1q_s32(b, swap32_neon(float_to_s32_neon(vld1q_f32(a)), swap));
+
+    if (swap)
+        pa_sconv_s32be_from_float32ne(n, a, b);
+    else
+        pa_sconv_s32le_from_float32ne(n, a, b);
+}
+
+static void s32le_to_float32ne_neon(unsigned n, const int32_t *a, float *b) {
+    s32_to_float32ne_neon(n, a, b, FALSE);
+}
+
+static void s32be_to_float32ne_neon(unsigned n, const int32_t *a, float *b) {
+    s32_to_float32ne_neon(n, a, b, TRUE);
+}
+
+static void s32le_from_float32ne_neon(unsigned n, const float *a, int32_t *b) {
+    s32_from_float32ne_neon(n, a, b, FALSE);
+}
+
+static void s32be_from_float32ne_neon(unsigned n, const float *a, int32_t *b) {
+    s32_from_float32ne_neon(n, a, b, TRUE);
+}
+
+/* s24_32 */
+
+static inline void s24_32_to_float32ne_neon(unsigned n, const uint32_t *a, float *b, pa_bool_t swap) {
+    const float32x4_t scale = vdupq_n_f32(1.0f / 2147483648.0f);
+
+    for (; n >= 4; n -= 4, a += 4, b += 4) {
+        int32x4_t s = vshlq_n_s32(swap32_neon(vreinterpretq_s32_u32(vld1q_u32(a)), swap), 8);
+
+        vst1q_f32(b, vmulq_f32(vcvtq_f32_s32(s), scale));
+    }
+
+    if (swap)
+        pa_sconv_s24_32be_to_float32ne(n, (const uint8_t*) a, b);
+    else
+        pa_sconv_s24_32le_to_float32ne(n, a, b);
+}
+
+static inline void s24_32_from_float32ne_neon(unsigned n, const float *a, uint32_t *b, pa_bool_t swap) {
+
+    for (; n >= 4; n -= 4, a += 4, b += 4) {
+        uint32x4_t s = vshrq_n_u32(vreinterpretq_u32_s32(float_to_s32_neon(vld1q_f32(a))), 8);
+
+        vst1q_u32(b, vreinterpretq_u32_s32(swap32_neon(vreinterpretq_s32_u32(s), swap)));
+    }
+
+    if (swap)
+        pa_sconv_s24_32be_from_float32ne(n, a, (uint8_t*) b);
+    else
+        pa_sconv_s24_32le_from_float32ne(n, a, b);
+}
+
+static void s24_32le_to_float32ne_neon(unsigned n, const uint32_t *a, float *b) {
+    s24_32_to_float32ne_neon(n, a, b, FALSE);
+}
+
+static void s24_32be_to_float32ne_neon(unsigned n, const uint32_t *a, float *b) {
+    s24_32_to_float32ne_neon(n, a, b, TRUE);
+}
+
+static void s24_32le_from_float32ne_neon(unsigned n, const float *a, uint32_t *b) {
+    s24_32_from_float32ne_neon(n, a, b, FALSE);
+}
+
+static void s24_32be_from_float32ne_neon(unsigned n, const float *a, uint32_t *b) {
+    s24_32_from_float32ne_neon(n, a, b, TRUE);
+}
+
+/* s24, vld3 splits the three bytes of eight samples into separate
+ * registers. For BE the first and the last one swap their roles. */
+
+static inline void s24_to_float32ne_neon(unsigned n, const uint8_t *a, float *b, pa_bool_t swap) {
+    const float32x4_t scale = vdupq_n_f32(1.0f / 2147483648.0f);
+
+    for (; n >= 8; n -= 8, a += 24, b += 8) {
+        uint8x8x3_t x;
+        uint16x8x2_t w;
+        uint8x8_t lsb, msb;
+
+        x = vld3_u8(a);
+        lsb = swap ? x.val[2] : x.val[0];
+        msb = swap ? x.val[0] : x.val[2];
+
+        /* Low and high 16 bits of each sample shifted up by 8 */
+        w = vzipq_u16(vshll_n_u8(lsb, 8), vorrq_u16(vmovl_u8(x.val[1]), vshll_n_u8(msb, 8)));
+
+        vst1q_f32(b, vmulq_f32(vcvtq_f32_s32(vreinterpretq_s32_u16(w.val[0])), scale));
+        vst1q_f32(b + 4, vmulq_f32(vcvtq_f32_s32(vreinterpretq_s32_u16(w.val[1])), scale));
+    }
+
+    if (swap)
+        pa_sconv_s24be_to_float32ne(n, a, b);
+    else
+        pa_sconv_s24le_to_float32ne(n, a, b);
+}
+
+static inline void s24_from_float32ne_neon(unsigned n, const float *a, uint8_t *b, pa_bool_t swap) {
+
+    for (; n >= 8; n -= 8, a += 8, b += 24) {
+        int32x4_t s0, s1;
+        uint16x4x2_t r0, r1;
+        uint16x8_t lo, hi;
+        uint8x8x3_t x;
+
+        s0 = float_to_s32_neon(vld1q_f32(a));
+        s1 = float_to_s32_neon(vld1q_f32(a + 4));
+
+        r0 = vuzp_u16(vget_low_u16(vreinterpretq_u16_s32(s0)), vget_high_u16(vreinterpretq_u16_s32(s0)));
+        r1 = vuzp_u16(vget_low_u16(vreinterpretq_u16_s32(s1)), vget_high_u16(vreinterpretq_u16_s32(s1)));
+        lo = vcombine_u16(r0.val[0], r1.val[0]);
+        hi = vcombine_u16(r0.val[1], r1.val[1]);
+
+        x.val[swap ? 2 : 0] = vshrn_n_u16(lo, 8);
+        x.val[1] = vmovn_u16(hi);
+        x.val[swap ? 0 : 2] = vshrn_n_u16(hi, 8);
+        vst3_u8(b, x);
+    }
+
+    if (swap)
+        pa_sconv_s24be_from_float32ne(n, a, b);
+    else
+        pa_sconv_s24le_from_float32ne(n, a, b);
+}
+
+static void s24le_to_float32ne_neon(unsigned n, const uint8_t *a, float *b) {
+    s24_to_float32ne_neon(n, a, b, FALSE);
+}
+
+static void s24be_to_float32ne_neon(unsigned n, const uint8_t *a, float *b) {
+    s24_to_float32ne_neon(n, a, b, TRUE);
+}
+
+static void s24le_from_float32ne_neon(unsigned n, const float *a, uint8_t *b) {
+    s24_from_float32ne_neon(n, a, b, FALSE);
+}
+
+static void s24be_from_float32ne_neon(unsigned n, const float *a, uint8_t *b) {
+    s24_from_float32ne_neon(n, a, b, TRUE);
+}
+
+/* float32re, the same function converts in both directions */
+
+static void float32re_to_float32ne_neon(unsigned n, const float *a, float *b) {
+
+    for (; n >= 4; n -= 4, a += 4, b += 4)
+        vst1q_u8((uint8_t*) b, vrev32q_u8(vld1q_u8((const uint8_t*) a)));
+
+    for (; n > 0; n--, a++, b++)
+        *((uint32_t *) b) = PA_UINT32_SWAP(*((uint32_t *) a));
+}
+
+/* u8 */
+
+static void u8_to_float32ne_neon(unsigned n, const uint8_t *a, float *b) {
+    const float32x4_t scale = vdupq_n_f32(1.0f / 128.0f), one = vdupq_n_f32(1.0f);
+
+    for (; n >= 8; n -= 8, a += 8, b += 8) {
+        uint16x8_t s = vmovl_u8(vld1_u8(a));
+
+        vst1q_f32(b, vsubq_f32(vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(s))), scale), one));
+        vst1q_f32(b + 4, vsubq_f32(vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(s))), scale), one));
+    }
+
+    for (; n > 0; n--, a++, b++)
+        *b = (*a * 1.0/128.0) - 1.0;
+}
+
+static void u8_from_float32ne_neon(unsigned n, const float *a, uint8_t *b) {
+    const float32x4_t scale = vdupq_n_f32(127.0f), offset = vdupq_n_f32(128.0f);
+    const float32x4_t min = vdupq_n_f32(0.0f), max = vdupq_n_f32(255.0f);
+
+    for (; n >= 8; n -= 8, a += 8, b += 8) {
+        float32x4_t v0, v1;
+        int32x4_t s0, s1;
+
+        v0 = vmaxq_f32(vminq_f32(vmlaq_f32(offset, vld1q_f32(a), scale), max), min);
+        v1 = vmaxq_f32(vminq_f32(vmlaq_f32(offset, vld1q_f32(a + 4), scale), max), min);
+
+        s0 = round_small_neon(v0);
+        s1 = round_small_neon(v1);
+
+        vst1_u8(b, vqmovun_s16(vcombine_s16(vmovn_s32(s0), vmovn_s32(s1))));
+    }
+
+    for (; n > 0; n--, a++, b++) {
+        float v;
+        v = (*a * 127.0) + 128.0;
+        v = PA_CLAMP_UNLIKELY (v, 0.0, 255.0);
+        *b = rint (v);
+    }
+}
+#endif /* defined (__arm__) && defined (__ARM_NEON__) && !defined (WORDS_BIGENDIAN) */
+
+void pa_convert_func_init_neon(pa_cpu_arm_flag_t flags) {
+#if defined (__arm__) && defined (__ARM_NEON__) && !defined (WORDS_BIGENDIAN)
+
+    if (flags & PA_CPU_ARM_NEON) {
+        pa_log_info("Initialising NEON optimized conversions.");
+
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_U8, (pa_convert_func_t) u8_to_float32ne_neon);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S16LE, (pa_convert_func_t) s16le_to_float32ne_neon);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S16BE, (pa_convert_func_t) s16be_to_float32ne_neon);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S32LE, (pa_convert_func_t) s32le_to_float32ne_neon);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S32BE, (pa_convert_func_t) s32be_to_float32ne_neon);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S24LE, (pa_convert_func_t) s24le_to_float32ne_neon);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S24BE, (pa_convert_func_t) s24be_to_float32ne_neon);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S24_32LE, (pa_convert_func_t) s24_32le_to_float32ne_neon);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S24_32BE, (pa_convert_func_t) s24_32be_to_float32ne_neon);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_FLOAT32RE, (pa_convert_func_t) float32re_to_float32ne_neon);
+
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_U8, (pa_convert_func_t) u8_from_float32ne_neon);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S16LE, (pa_convert_func_t) s16le_from_float32ne_neon);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S16BE, (pa_convert_func_t) s16be_from_float32ne_neon);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S32LE, (pa_convert_func_t) s32le_from_float32ne_neon);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S32BE, (pa_convert_func_t) s32be_from_float32ne_neon);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S24LE, (pa_convert_func_t) s24le_from_float32ne_neon);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S24BE, (pa_convert_func_t) s24be_from_float32ne_neon);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S24_32LE, (pa_convert_func_t) s24_32le_from_float32ne_neon);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S24_32BE, (pa_convert_func_t) s24_32be_from_float32ne_neon);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_FLOAT32RE, (pa_convert_func_t) float32re_to_float32ne_neon);
+    }
+#endif /* defined (__arm__) && defined (__ARM_NEON__) && !defined (WORDS_BIGENDIAN) */
+}
@@ -0,0 +1,50 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/macro.h>
+#include <pulsecore/log.h>
+#include <pulsecore/sconv.h>
+#include <pulsecore/sconv-orc-gen.h>
+
+#include "cpu-orc.h"
+
+static void s16ne_to_float32ne_orc(unsigned n, const int16_t *a, float *b) {
+    pa_assert(a);
+    pa_assert(b);
+
+    pa_sconv_s16ne_to_float32ne_orc(b, a, (float) 0x7FFF, (int) n);
+}
+
+static void s16ne_from_float32ne_orc(unsigned n, const float *a, int16_t *b) {
+    pa_assert(a);
+    pa_assert(b);
+
+    pa_sconv_s16ne_from_float32ne_orc(b, a, (float) 0x7FFF, -1.0f, 1.0f, 12582912.0f, (int) n);
+}
+
+void pa_convert_func_init_orc(void) {
+    pa_log_info("Initialising Orc optimized conversions.");
+
+    pa_set_convert_to_float32ne_function(PA_SAMPLE_S16NE, (pa_convert_func_t) s16ne_to_float32ne_orc);
+    pa_set_convert_from_float32ne_function(PA_SAMPLE_S16NE, (pa_convert_func_t) s16ne_from_float32ne_orc);
+}
@@ -24,9 +24,11 @@
 #include <config.h>
 #endif
 
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <pulsecore/g711.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/endianmacros.h>
 
@@ -162,6 +164,235 @@ static void pa_sconv_s16le_from_f32ne_sse2(unsigned n, const float *a, int16_t *
     );
 }
 
+#if defined (PA_HAVE_X86_TARGET_ATTRIBUTE)
+
+#include <emmintrin.h>
+
+/* ulaw and alaw, 8 samples at a time in 16 bit lanes. Instead of
+ * searching the segment tables like g711.c, the segment is counted
+ * with compares against the segment ends, and the variable shifts are
+ * done as multiplications by powers of two. The results are
+ * bit-exact with the g711.c functions, which are used for the
+ * leftovers. */
+
+/* x << s for s in [0, 7], with s given by the bits at mask 0x7 << shift */
+PA_X86_TARGET("sse2")
+static inline __m128i sllv_epi16_sse2(__m128i x, __m128i s, int shift) {
+    __m128i m;
+
+    m = _mm_cmpeq_epi16(_mm_and_si128(s, _mm_set1_epi16(1 << shift)), _mm_set1_epi16(1 << shift));
+    x = _mm_or_si128(_mm_andnot_si128(m, x), _mm_and_si128(m, _mm_slli_epi16(x, 1)));
+    m = _mm_cmpeq_epi16(_mm_and_si128(s, _mm_set1_epi16(2 << shift)), _mm_set1_epi16(2 << shift));
+    x = _mm_or_si128(_mm_andnot_si128(m, x), _mm_and_si128(m, _mm_slli_epi16(x, 2)));
+    m = _mm_cmpeq_epi16(_mm_and_si128(s, _mm_set1_epi16(4 << shift)), _mm_set1_epi16(4 << shift));
+    return _mm_or_si128(_mm_andnot_si128(m, x), _mm_and_si128(m, _mm_slli_epi16(x, 4)));
+}
+
+/* Takes 8 codes in the low bytes of the lanes */
+PA_X86_TARGET("sse2")
+static inline __m128i ulaw_to_s16_sse2(__m128i u) {
+    __m128i t, neg;
+
+    u = _mm_xor_si128(u, _mm_set1_epi16(0xFF));
+
+    t = _mm_add_epi16(_mm_slli_epi16(_mm_and_si128(u, _mm_set1_epi16(0xF)), 3), _mm_set1_epi16(0x84));
+    t = sllv_epi16_sse2(t, u, 4);
+    t = _mm_sub_epi16(t, _mm_set1_epi16(0x84));
+
+    neg = _mm_cmpeq_epi16(_mm_and_si128(u, _mm_set1_epi16(0x80)), _mm_set1_epi16(0x80));
+    return _mm_sub_epi16(_mm_xor_si128(t, neg), neg);
+}
+
+PA_X86_TARGET("sse2")
+static inline __m128i alaw_to_s16_sse2(__m128i a) {
+    __m128i t, seg, neg;
+
+    a = _mm_xor_si128(a, _mm_set1_epi16(0x55));
+    seg = _mm_and_si128(_mm_srli_epi16(a, 4), _mm_set1_epi16(0x7));
+
+    /* Segment 0 adds 8 and isn't shifted, segment s > 0 adds 0x108
+     * and is shifted by s - 1 */
+    t = _mm_slli_epi16(_mm_and_si128(a, _mm_set1_epi16(0xF)), 4);
+    t = _mm_add_epi16(t, _mm_set1_epi16(0x108));
+    t = _mm_sub_epi16(t, _mm_and_si128(_mm_cmpeq_epi16(seg, _mm_setzero_si128()), _mm_set1_epi16(0x100)));
+    t = sllv_epi16_sse2(t, _mm_subs_epu16(seg, _mm_set1_epi16(1)), 0);
+
+    neg = _mm_cmpeq_epi16(_mm_and_si128(a, _mm_set1_epi16(0x80)), _mm_setzero_si128());
+    return _mm_sub_epi16(_mm_xor_si128(t, neg), neg);
+}
+
+/* Takes 14 bit samples, returns the codes in the low bytes of the lanes */
+PA_X86_TARGET("sse2")
+static inline __m128i ulaw_from_s14_sse2(__m128i x) {
+    __m128i neg, seg, f, m;
+    int16_t end;
+
+    neg = _mm_srai_epi16(x, 15);
+    x = _mm_sub_epi16(_mm_xor_si128(x, neg), neg);
+
+    /* Clipping to one less than g711.c does gives the same code,
+     * without the extra out of range segment */
+    x = _mm_add_epi16(_mm_min_epi16(x, _mm_set1_epi16(0x1FFF - 0x21)), _mm_set1_epi16(0x21));
+
+    /* Each segment end x is beyond adds one to the segment and halves
+     * the factor, so that mulhi(x, f) is x >> (seg + 1) */
+    seg = _mm_setzero_si128();
+    f = _mm_set1_epi16((int16_t) 0x8000);
+    for (end = 0x3F; end < 0x1FFF; end = (int16_t) (end << 1 | 1)) {
+        m = _mm_cmpgt_epi16(x, _mm_set1_epi16(end));
+        seg = _mm_sub_epi16(seg, m);
+        f = _mm_sub_epi16(f, _mm_and_si128(_mm_srli_epi16(f, 1), m));
+    }
+
+    x = _mm_and_si128(_mm_mulhi_epu16(x, f), _mm_set1_epi16(0xF));
+    x = _mm_or_si128(_mm_slli_epi16(seg, 4), x);
+    return _mm_xor_si128(x, _mm_xor_si128(_mm_set1_epi16(0xFF), _mm_and_si128(neg, _mm_set1_epi16(0x80))));
+}
+
+/* Takes 13 bit samples */
+PA_X86_TARGET("sse2")
+static inline __m128i alaw_from_s13_sse2(__m128i x) {
+    __m128i neg, seg, f, m;
+    int16_t end;
+
+    neg = _mm_srai_epi16(x, 15);
+    x = _mm_xor_si128(x, neg);
+
+    /* Segments 0 and 1 are both shifted by one */
+    seg = _mm_sub_epi16(_mm_setzero_si128(), _mm_cmpgt_epi16(x, _mm_set1_epi16(0x1F)));
+    f = _mm_set1_epi16((int16_t) 0x8000);
+    for (end = 0x3F; end < 0xFFF; end = (int16_t) (end << 1 | 1)) {
+        m = _mm_cmpgt_epi16(x, _mm_set1_epi16(end));
+        seg = _mm_sub_epi16(seg, m);
+        f = _mm_sub_epi16(f, _mm_and_si128(_mm_srli_epi16(f, 1), m));
+    }
+
+    x = _mm_and_si128(_mm_mulhi_epu16(x, f), _mm_set1_epi16(0xF));
+    x = _mm_or_si128(_mm_slli_epi16(seg, 4), x);
+    return _mm_xor_si128(x, _mm_xor_si128(_mm_set1_epi16(0xD5), _mm_and_si128(neg, _mm_set1_epi16(0x80))));
+}
+
+PA_X86_TARGET("sse2")
+static inline __m128i load_codes_sse2(const uint8_t *a) {
+    return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) a), _mm_setzero_si128());
+}
+
+PA_X86_TARGET("sse2")
+static inline void store_codes_sse2(uint8_t *b, __m128i x) {
+    _mm_storel_epi64((__m128i*) b, _mm_packus_epi16(x, x));
+}
+
+/* (float) x / 0x8000, which is exact either way */
+PA_X86_TARGET("sse2")
+static inline void store_s16_as_float_sse2(float *b, __m128i x) {
+    const __m128 vscale = _mm_set1_ps(1.0f / 0x8000);
+
+    _mm_storeu_ps(b, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16)), vscale));
+    _mm_storeu_ps(b + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16)), vscale));
+}
+
+/* Clamps to [-1, 1], scales and rounds like lrintf() */
+PA_X86_TARGET("sse2")
+static inline __m128i load_float_as_s16_sse2(const float *a, float s) {
+    const __m128 vone = _mm_set1_ps(1.0f), vmone = _mm_set1_ps(-1.0f), vscale = _mm_set1_ps(s);
+    __m128 lo, hi;
+
+    lo = _mm_mul_ps(_mm_max_ps(_mm_min_ps(_mm_loadu_ps(a), vone), vmone), vscale);
+    hi = _mm_mul_ps(_mm_max_ps(_mm_min_ps(_mm_loadu_ps(a + 4), vone), vmone), vscale);
+
+    return _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi));
+}
+
+PA_X86_TARGET("sse2")
+static void ulaw_to_s16ne_sse2(unsigned n, const uint8_t *a, int16_t *b) {
+
+    for (; n >= 8; n -= 8, a += 8, b += 8)
+        _mm_storeu_si128((__m128i*) b, ulaw_to_s16_sse2(load_codes_sse2(a)));
+
+    for (; n > 0; n--, a++, b++)
+        *b = st_ulaw2linear16(*a);
+}
+
+PA_X86_TARGET("sse2")
+static void alaw_to_s16ne_sse2(unsigned n, const uint8_t *a, int16_t *b) {
+
+    for (; n >= 8; n -= 8, a += 8, b += 8)
+        _mm_storeu_si128((__m128i*) b, alaw_to_s16_sse2(load_codes_sse2(a)));
+
+    for (; n > 0; n--, a++, b++)
+        *b = st_alaw2linear16(*a);
+}
+
+PA_X86_TARGET("sse2")
+static void ulaw_from_s16ne_sse2(unsigned n, const int16_t *a, uint8_t *b) {
+
+    for (; n >= 8; n -= 8, a += 8, b += 8)
+        store_codes_sse2(b, ulaw_from_s14_sse2(_mm_srai_epi16(_mm_loadu_si128((const __m128i*) a), 2)));
+
+    for (; n > 0; n--, a++, b++)
+        *b = st_14linear2ulaw(*a >> 2);
+}
+
+PA_X86_TARGET("sse2")
+static void alaw_from_s16ne_sse2(unsigned n, const int16_t *a, uint8_t *b) {
+
+    for (; n >= 8; n -= 8, a += 8, b += 8)
+        store_codes_sse2(b, alaw_from_s13_sse2(_mm_srai_epi16(_mm_loadu_si128((const __m128i*) a), 3)));
+
+    for (; n > 0; n--, a++, b++)
+        *b = st_13linear2alaw(*a >> 3);
+}
+
+PA_X86_TARGET("sse2")
+static void ulaw_to_float32ne_sse2(unsigned n, const uint8_t *a, float *b) {
+
+    for (; n >= 8; n -= 8, a += 8, b += 8)
+        store_s16_as_float_sse2(b, ulaw_to_s16_sse2(load_codes_sse2(a)));
+
+    for (; n > 0; n--, a++, b++)
+        *b = (float) st_ulaw2linear16(*a) / 0x8000;
+}
+
+PA_X86_TARGET("sse2")
+static void alaw_to_float32ne_sse2(unsigned n, const uint8_t *a, float *b) {
+
+    for (; n >= 8; n -= 8, a += 8, b += 8)
+        store_s16_as_float_sse2(b, alaw_to_s16_sse2(load_codes_sse2(a)));
+
+    for (; n > 0; n--, a++, b++)
+        *b = (float) st_alaw2linear16(*a) / 0x8000;
+}
+
+PA_X86_TARGET("sse2")
+static void ulaw_from_float32ne_sse2(unsigned n, const float *a, uint8_t *b) {
+
+    for (; n >= 8; n -= 8, a += 8, b += 8)
+        store_codes_sse2(b, ulaw_from_s14_sse2(load_float_as_s16_sse2(a, (float) 0x1FFF)));
+
+    for (; n > 0; n--, a++, b++) {
+        float v = *a;
+        v = PA_CLAMP_UNLIKELY(v, -1.0f, 1.0f);
+        v *= 0x1FFF;
+        *b = st_14linear2ulaw((int16_t) lrintf(v));
+    }
+}
+
+PA_X86_TARGET("sse2")
+static void alaw_from_float32ne_sse2(unsigned n, const float *a, uint8_t *b) {
+
+    for (; n >= 8; n -= 8, a += 8, b += 8)
+        store_codes_sse2(b, alaw_from_s13_sse2(load_float_as_s16_sse2(a, (float) 0xFFF)));
+
+    for (; n > 0; n--, a++, b++) {
+        float v = *a;
+        v = PA_CLAMP_UNLIKELY(v, -1.0f, 1.0f);
+        v *= 0xFFF;
+        *b = st_13linear2alaw((int16_t) lrintf(v));
+    }
+}
+
+#endif /* defined (PA_HAVE_X86_TARGET_ATTRIBUTE) */
+
 #undef RUN_TEST
 
 #ifdef RUN_TEST
@@ -224,6 +455,18 @@ void pa_convert_func_init_sse(pa_cpu_x86_flag_t flags) {
     if (flags & PA_CPU_X86_SSE2) {
         pa_log_info("Initialising SSE2 optimized conversions.");
         pa_set_convert_from_float32ne_function(PA_SAMPLE_S16LE, (pa_convert_func_t) pa_sconv_s16le_from_f32ne_sse2);
+
+#if defined (PA_HAVE_X86_TARGET_ATTRIBUTE)
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_ULAW, (pa_convert_func_t) ulaw_to_float32ne_sse2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_ALAW, (pa_convert_func_t) alaw_to_float32ne_sse2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_ULAW, (pa_convert_func_t) ulaw_from_float32ne_sse2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_ALAW, (pa_convert_func_t) alaw_from_float32ne_sse2);
+
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_ULAW, (pa_convert_func_t) ulaw_to_s16ne_sse2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_ALAW, (pa_convert_func_t) alaw_to_s16ne_sse2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_ULAW, (pa_convert_func_t) ulaw_from_s16ne_sse2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_ALAW, (pa_convert_func_t) alaw_from_s16ne_sse2);
+#endif
     } else {
         pa_log_info("Initialising SSE optimized conversions.");
         pa_set_convert_from_float32ne_function(PA_SAMPLE_S16LE, (pa_convert_func_t) pa_sconv_s16le_from_f32ne_sse);
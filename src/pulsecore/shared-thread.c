@@ -0,0 +1,362 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/msgobject.h>
+#include <pulsecore/shared.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/thread-mq.h>
+
+#include "shared-thread.h"
+
+typedef struct pool pool;
+
+typedef struct worker {
+    pa_msgobject parent;
+
+    pool *pool;
+    unsigned n_clients;
+
+    pa_thread *thread;
+    pa_thread_mq thread_mq;
+    pa_rtpoll *rtpoll;
+
+    struct {
+        /* Ordered by deadline, the ones without one at the end */
+        pa_shared_thread_client **clients;
+        unsigned n_clients, n_allocated;
+    } thread_info;
+} worker;
+
+PA_DEFINE_PRIVATE_CLASS(worker, pa_msgobject);
+#define WORKER(o) (worker_cast(o))
+
+enum {
+    WORKER_MESSAGE_ADD,
+    WORKER_MESSAGE_REMOVE
+};
+
+struct pool {
+    pa_core *core;
+    unsigned n_clients;
+
+    worker **workers;
+    unsigned n_workers, max_workers;
+};
+
+struct pa_shared_thread_client {
+    worker *worker;
+    pa_module *module;
+
+    pa_shared_thread_cb_t cb;
+    void *userdata;
+
+    pa_usec_t deadline;
+};
+
+/* Called from IO context */
+static void sort_clients(worker *w) {
+    unsigned i, j;
+
+    /* Insertion sort, the order hardly changes from one round to the
+     * next */
+    for (i = 1; i < w->thread_info.n_clients; i++) {
+        pa_shared_thread_client *c = w->thread_info.clients[i];
+
+        for (j = i; j > 0; j--) {
+            pa_shared_thread_client *p = w->thread_info.clients[j-1];
+
+            if (p->deadline != 0 && (c->deadline == 0 || p->deadline <= c->deadline))
+                break;
+
+            w->thread_info.clients[j] = p;
+        }
+
+        w->thread_info.clients[j] = c;
+    }
+}
+
+/* Called from IO context */
+static int worker_process_msg(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
+    worker *w = WORKER(o);
+    pa_shared_thread_client *c = data;
+    unsigned i;
+
+    pa_assert(w);
+    pa_assert(c);
+
+    switch (code) {
+
+        case WORKER_MESSAGE_ADD:
+
+            if (w->thread_info.n_clients >= w->thread_info.n_allocated) {
+                w->thread_info.n_allocated = PA_MAX(2 * w->thread_info.n_allocated, 8U);
+                w->thread_info.clients = pa_xrenew(pa_shared_thread_client*, w->thread_info.clients, w->thread_info.n_allocated);
+            }
+
+            /* No deadline yet, it is called in the next round anyway */
+            c->deadline = 0;
+            w->thread_info.clients[w->thread_info.n_clients++] = c;
+            return 0;
+
+        case WORKER_MESSAGE_REMOVE:
+
+            for (i = 0; i < w->thread_info.n_clients; i++)
+                if (w->thread_info.clients[i] == c) {
+                    memmove(w->thread_info.clients + i, w->thread_info.clients + i + 1,
+                            (w->thread_info.n_clients - i - 1) * sizeof(pa_shared_thread_client*));
+                    w->thread_info.n_clients--;
+                    break;
+                }
+
+            return 0;
+    }
+
+    return 0;
+}
+
+static void thread_func(void *userdata) {
+    worker *w = userdata;
+    unsigned i;
+
+    pa_assert(w);
+
+    pa_log_debug("Thread starting up");
+
+    pa_thread_mq_install(&w->thread_mq);
+
+    for (;;) {
+        int ret;
+
+        /* Everybody gets to look at the state of their device after
+         * every wakeup, just like in a thread of their own, but the
+         * ones whose deadline comes first go first */
+        for (i = 0; i < w->thread_info.n_clients; i++) {
+            pa_shared_thread_client *c = w->thread_info.clients[i];
+
+            c->deadline = c->cb(c, pa_rtclock_now(), c->userdata);
+        }
+
+        sort_clients(w);
+
+        if (w->thread_info.n_clients > 0 && w->thread_info.clients[0]->deadline > 0)
+            pa_rtpoll_set_timer_absolute(w->rtpoll, w->thread_info.clients[0]->deadline);
+        else
+            pa_rtpoll_set_timer_disabled(w->rtpoll);
+
+        if ((ret = pa_rtpoll_run(w->rtpoll, TRUE)) < 0)
+            goto fail;
+
+        if (ret == 0)
+            goto finish;
+    }
+
+fail:
+    /* The clients can't go on without us, so they are unloaded, and we
+     * keep processing messages until we received PA_MESSAGE_SHUTDOWN */
+    for (i = 0; i < w->thread_info.n_clients; i++)
+        if (w->thread_info.clients[i]->module)
+            pa_asyncmsgq_post(w->thread_mq.outq, PA_MSGOBJECT(w->pool->core), PA_CORE_MESSAGE_UNLOAD_MODULE,
+                              w->thread_info.clients[i]->module, 0, NULL, NULL);
+
+    pa_asyncmsgq_wait_for(w->thread_mq.inq, PA_MESSAGE_SHUTDOWN);
+
+finish:
+    pa_log_debug("Thread shutting down");
+}
+
+static void worker_free(pa_object *o) {
+    worker *w = WORKER(o);
+
+    pa_assert(w);
+    pa_assert(!w->thread);
+
+    pa_xfree(w->thread_info.clients);
+    pa_xfree(w);
+}
+
+static worker* worker_new(pool *p) {
+    worker *w;
+    char name[32];
+
+    w = pa_msgobject_new(worker);
+    w->parent.parent.free = worker_free;
+    w->parent.process_msg = worker_process_msg;
+    w->pool = p;
+    w->n_clients = 0;
+    w->thread_info.clients = NULL;
+    w->thread_info.n_clients = w->thread_info.n_allocated = 0;
+
+    w->rtpoll = pa_rtpoll_new();
+    pa_thread_mq_init(&w->thread_mq, p->core->mainloop, w->rtpoll);
+
+    pa_snprintf(name, sizeof(name), "shared-io-%u", p->n_workers);
+
+    if (!(w->thread = pa_thread_new(name, thread_func, w))) {
+        pa_log("Failed to create thread.");
+
+        pa_thread_mq_done(&w->thread_mq);
+        pa_rtpoll_free(w->rtpoll);
+        worker_unref(w);
+        return NULL;
+    }
+
+    return w;
+}
+
+static void worker_shutdown(worker *w) {
+    pa_assert(w);
+    pa_assert(w->n_clients == 0);
+
+    pa_asyncmsgq_send(w->thread_mq.inq, NULL, PA_MESSAGE_SHUTDOWN, NULL, 0, NULL);
+    pa_thread_free(w->thread);
+    w->thread = NULL;
+
+    pa_thread_mq_done(&w->thread_mq);
+    pa_rtpoll_free(w->rtpoll);
+
+    worker_unref(w);
+}
+
+static pool* pool_get(pa_core *c) {
+    pool *p;
+
+    if ((p = pa_shared_get(c, "shared-thread-pool")))
+        return p;
+
+    p = pa_xnew0(pool, 1);
+    p->core = c;
+    p->max_workers = pa_ncpus();
+    p->workers = pa_xnew0(worker*, p->max_workers);
+
+    pa_assert_se(pa_shared_set(c, "shared-thread-pool", p) >= 0);
+
+    return p;
+}
+
+static void pool_free(pool *p) {
+    unsigned i;
+
+    pa_assert(p);
+    pa_assert(p->n_clients == 0);
+
+    for (i = 0; i < p->n_workers; i++)
+        worker_shutdown(p->workers[i]);
+
+    pa_assert_se(pa_shared_remove(p->core, "shared-thread-pool") >= 0);
+
+    pa_xfree(p->workers);
+    pa_xfree(p);
+}
+
+/* Called from main context */
+static worker* pool_pick(pool *p) {
+    worker *best = NULL;
+    unsigned i;
+
+    for (i = 0; i < p->n_workers; i++)
+        if (!best || p->workers[i]->n_clients < best->n_clients)
+            best = p->workers[i];
+
+    /* Only start another thread if all of them are busy */
+    if ((!best || best->n_clients > 0) && p->n_workers < p->max_workers) {
+        worker *w;
+
+        if ((w = worker_new(p))) {
+            p->workers[p->n_workers++] = w;
+            best = w;
+        }
+    }
+
+    return best;
+}
+
+pa_shared_thread_client* pa_shared_thread_attach(pa_core *core, pa_module *module, pa_shared_thread_cb_t cb, void *userdata) {
+    pa_shared_thread_client *c;
+    pool *p;
+    worker *w;
+
+    pa_assert(core);
+    pa_assert(cb);
+
+    p = pool_get(core);
+
+    if (!(w = pool_pick(p))) {
+        if (p->n_clients == 0)
+            pool_free(p);
+
+        return NULL;
+    }
+
+    c = pa_xnew0(pa_shared_thread_client, 1);
+    c->worker = w;
+    c->module = module;
+    c->cb = cb;
+    c->userdata = userdata;
+
+    w->n_clients++;
+    p->n_clients++;
+
+    pa_assert_se(pa_asyncmsgq_send(w->thread_mq.inq, PA_MSGOBJECT(w), WORKER_MESSAGE_ADD, c, 0, NULL) == 0);
+
+    return c;
+}
+
+void pa_shared_thread_detach(pa_shared_thread_client *c) {
+    worker *w;
+    pool *p;
+
+    pa_assert(c);
+    pa_assert_se(w = c->worker);
+    pa_assert_se(p = w->pool);
+
+    pa_assert_se(pa_asyncmsgq_send(w->thread_mq.inq, PA_MSGOBJECT(w), WORKER_MESSAGE_REMOVE, c, 0, NULL) == 0);
+
+    w->n_clients--;
+    p->n_clients--;
+
+    pa_xfree(c);
+
+    /* The threads only stay around while somebody uses them */
+    if (p->n_clients == 0)
+        pool_free(p);
+}
+
+pa_asyncmsgq* pa_shared_thread_get_asyncmsgq(pa_shared_thread_client *c) {
+    pa_assert(c);
+
+    return c->worker->thread_mq.inq;
+}
+
+pa_rtpoll* pa_shared_thread_get_rtpoll(pa_shared_thread_client *c) {
+    pa_assert(c);
+
+    return c->worker->rtpoll;
+}
@@ -0,0 +1,57 @@
+#ifndef foopulsecoresharedthreadhfoo
+#define foopulsecoresharedthreadhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulse/sample.h>
+
+#include <pulsecore/asyncmsgq.h>
+#include <pulsecore/core.h>
+#include <pulsecore/module.h>
+#include <pulsecore/rtpoll.h>
+
+/* A few IO threads that timer driven devices can share, instead of
+ * every device running a thread of its own. Each device is only ever
+ * served by one of the threads, so its thread_info stays single
+ * threaded. The devices use the asyncmsgq and rtpoll of their thread
+ * like those of a thread of their own, but must neither set the timer
+ * of the rtpoll nor send PA_MESSAGE_SHUTDOWN to the queue. */
+
+typedef struct pa_shared_thread_client pa_shared_thread_client;
+
+/* Called from the IO thread whenever it woke up, for the client with
+ * the earliest deadline first. Returns the time the client wants to be
+ * called again at the latest, or 0 if only a message can give it
+ * something to do. */
+typedef pa_usec_t (*pa_shared_thread_cb_t)(pa_shared_thread_client *c, pa_usec_t now, void *userdata);
+
+/* Adds a client to the thread with the fewest clients, starting up to
+ * one thread per CPU as needed. If the thread fails, module is
+ * unloaded, if there is one. Called from main context. */
+pa_shared_thread_client* pa_shared_thread_attach(pa_core *core, pa_module *module, pa_shared_thread_cb_t cb, void *userdata);
+
+/* The callback isn't called anymore once this returns. Called from
+ * main context. */
+void pa_shared_thread_detach(pa_shared_thread_client *c);
+
+pa_asyncmsgq* pa_shared_thread_get_asyncmsgq(pa_shared_thread_client *c);
+pa_rtpoll* pa_shared_thread_get_rtpoll(pa_shared_thread_client *c);
+
+#endif
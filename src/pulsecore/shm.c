@@ -138,6 +138,8 @@ int pa_shm_create_rw(pa_shm *m, size_t size, pa_bool_t shared, mode_t mode) {
 #endif
 
         m->do_unlink = FALSE;
+        m->memfd = FALSE;
+        m->fd = -1;
 
     } else {
 #ifdef HAVE_SHM_OPEN
@@ -175,6 +177,8 @@ int pa_shm_create_rw(pa_shm *m, size_t size, pa_bool_t shared, mode_t mode) {
 
         pa_assert_se(pa_close(fd) == 0);
         m->do_unlink = TRUE;
+        m->memfd = FALSE;
+        m->fd = -1;
 #else
         goto fail;
 #endif
@@ -213,6 +217,15 @@ void pa_shm_free(pa_shm *m) {
         free(m->ptr);
 #else
         pa_xfree(m->ptr);
+#endif
+    } else if (m->memfd) {
+#ifdef HAVE_MEMFD_CREATE
+        if (munmap(m->ptr, PA_PAGE_ALIGN(m->size)) < 0)
+            pa_log("munmap() failed: %s", pa_cstrerror(errno));
+
+        pa_assert_se(pa_close(m->fd) == 0);
+#else
+        pa_assert_not_reached();
 #endif
     } else {
 #ifdef HAVE_SHM_OPEN
@@ -258,6 +271,11 @@ void pa_shm_punch(pa_shm *m, size_t offset, size_t size) {
 
     if (o > 0) {
         size_t delta = PA_PAGE_SIZE - o;
+
+        /* Nothing to do if no whole page is covered */
+        if (size <= delta)
+            return;
+
         ptr = (uint8_t*) ptr + delta;
         size -= delta;
     }
@@ -282,6 +300,16 @@ void pa_shm_punch(pa_shm *m, size_t offset, size_t size) {
 #endif
 }
 
+void pa_shm_advise_huge_pages(pa_shm *m) {
+    pa_assert(m);
+    pa_assert(m->ptr);
+
+#ifdef MADV_HUGEPAGE
+    if (madvise(m->ptr, PA_PAGE_ALIGN(m->size), MADV_HUGEPAGE) < 0)
+        pa_log_debug("madvise(MADV_HUGEPAGE) failed: %s", pa_cstrerror(errno));
+#endif
+}
+
 #ifdef HAVE_SHM_OPEN
 
 int pa_shm_attach_ro(pa_shm *m, unsigned id) {
@@ -320,6 +348,8 @@ int pa_shm_attach_ro(pa_shm *m, unsigned id) {
 
     m->do_unlink = FALSE;
     m->shared = TRUE;
+    m->memfd = FALSE;
+    m->fd = -1;
 
     pa_assert_se(pa_close(fd) == 0);
 
@@ -340,6 +370,110 @@ int pa_shm_attach_ro(pa_shm *m, unsigned id) {
 
 #endif /* HAVE_SHM_OPEN */
 
+#ifdef HAVE_MEMFD_CREATE
+
+int pa_shm_create_memfd(pa_shm *m, size_t size) {
+    int fd;
+
+    pa_assert(m);
+    pa_assert(size > 0);
+    pa_assert(size <= MAX_SHM_SIZE);
+
+    size = PA_PAGE_ALIGN(size);
+
+    if ((fd = memfd_create("pulseaudio", MFD_CLOEXEC|MFD_ALLOW_SEALING)) < 0) {
+        pa_log_debug("memfd_create() failed: %s", pa_cstrerror(errno));
+        return -1;
+    }
+
+    if (ftruncate(fd, (off_t) size) < 0) {
+        pa_log("ftruncate() failed: %s", pa_cstrerror(errno));
+        goto fail;
+    }
+
+#ifdef F_ADD_SEALS
+    /* Make sure nobody can shrink the segment under the feet of those
+     * who mapped it */
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK|F_SEAL_GROW|F_SEAL_SEAL) < 0)
+        pa_log_debug("Failed to seal memfd: %s", pa_cstrerror(errno));
+#endif
+
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+
+    if ((m->ptr = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_NORESERVE, fd, (off_t) 0)) == MAP_FAILED) {
+        pa_log("mmap() failed: %s", pa_cstrerror(errno));
+        goto fail;
+    }
+
+    /* The id only needs to be unique among the segments of a single
+     * connection, there's no name to derive it from */
+    pa_random(&m->id, sizeof(m->id));
+    m->size = size;
+    m->fd = fd;
+    m->do_unlink = FALSE;
+    m->shared = TRUE;
+    m->memfd = TRUE;
+
+    return 0;
+
+fail:
+    pa_close(fd);
+    return -1;
+}
+
+int pa_shm_attach_memfd(pa_shm *m, unsigned id, int fd) {
+    struct stat st;
+
+    pa_assert(m);
+    pa_assert(fd >= 0);
+
+    if (fstat(fd, &st) < 0) {
+        pa_log("fstat() failed: %s", pa_cstrerror(errno));
+        goto fail;
+    }
+
+    if (st.st_size <= 0 ||
+        st.st_size > (off_t) MAX_SHM_SIZE ||
+        PA_ALIGN((size_t) st.st_size) != (size_t) st.st_size) {
+        pa_log("Invalid shared memory segment size");
+        goto fail;
+    }
+
+    m->size = (size_t) st.st_size;
+
+    if ((m->ptr = mmap(NULL, PA_PAGE_ALIGN(m->size), PROT_READ, MAP_SHARED, fd, (off_t) 0)) == MAP_FAILED) {
+        pa_log("mmap() failed: %s", pa_cstrerror(errno));
+        goto fail;
+    }
+
+    m->id = id;
+    m->fd = fd;
+    m->do_unlink = FALSE;
+    m->shared = TRUE;
+    m->memfd = TRUE;
+
+    return 0;
+
+fail:
+    pa_close(fd);
+    return -1;
+}
+
+#else /* HAVE_MEMFD_CREATE */
+
+int pa_shm_create_memfd(pa_shm *m, size_t size) {
+    return -1;
+}
+
+int pa_shm_attach_memfd(pa_shm *m, unsigned id, int fd) {
+    pa_close(fd);
+    return -1;
+}
+
+#endif /* HAVE_MEMFD_CREATE */
+
 int pa_shm_cleanup(void) {
 
 #ifdef HAVE_SHM_OPEN
@@ -32,13 +32,31 @@ typedef struct pa_shm {
     size_t size;
     pa_bool_t do_unlink:1;
     pa_bool_t shared:1;
+
+    /* Segments backed by a memfd have no name in the file system and
+     * are passed around by fd only. The fd stays open as long as the
+     * segment is mapped, -1 otherwise. */
+    pa_bool_t memfd:1;
+    int fd;
 } pa_shm;
 
 int pa_shm_create_rw(pa_shm *m, size_t size, pa_bool_t shared, mode_t mode);
 int pa_shm_attach_ro(pa_shm *m, unsigned id);
 
+/* Create an anonymous shared segment that is not visible in
+ * /dev/shm. Returns -1 if memfds are not available. */
+int pa_shm_create_memfd(pa_shm *m, size_t size);
+
+/* Map the memfd segment we received from somebody else. Takes
+ * ownership of fd, even on failure. */
+int pa_shm_attach_memfd(pa_shm *m, unsigned id, int fd);
+
 void pa_shm_punch(pa_shm *m, size_t offset, size_t size);
 
+/* Ask for the segment to be backed by transparent huge pages, where the
+ * system supports that */
+void pa_shm_advise_huge_pages(pa_shm *m);
+
 void pa_shm_free(pa_shm *m);
 
 int pa_shm_cleanup(void);
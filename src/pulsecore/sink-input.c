@@ -28,11 +28,13 @@
 #include <stdlib.h>
 
 #include <pulse/utf8.h>
+#include <pulse/rtclock.h>
 #include <pulse/xmalloc.h>
 #include <pulse/util.h>
 #include <pulse/internal.h>
 
 #include <pulsecore/sample-util.h>
+#include <pulsecore/core-rtclock.h>
 #include <pulsecore/core-subscribe.h>
 #include <pulsecore/log.h>
 #include <pulsecore/play-memblockq.h>
@@ -247,12 +249,18 @@ int pa_sink_input_new(
     char *memblockq_name;
     pa_sample_spec ss;
     pa_channel_map map;
+    pa_bool_t timed;
+    pa_usec_t begin = 0, new_hook = 0, fixate_hook = 0, resampling = 0, t = 0;
 
     pa_assert(_i);
     pa_assert(core);
     pa_assert(data);
     pa_assert_ctl_context();
 
+    /* The phases are only timed when there is someone to tell */
+    if ((timed = pa_log_level_enabled(PA_LOG_DEBUG)))
+        begin = pa_rtclock_now();
+
     if (data->client)
         pa_proplist_update(data->proplist, PA_UPDATE_MERGE, data->client->proplist);
 
@@ -270,9 +278,15 @@ int pa_sink_input_new(
         pa_sink_input_new_data_set_formats(data, tmp);
     }
 
+    if (timed)
+        t = pa_rtclock_now();
+
     if ((r = pa_hook_fire(&core->hooks[PA_CORE_HOOK_SINK_INPUT_NEW], data)) < 0)
         return r;
 
+    if (timed)
+        new_hook = pa_rtclock_now() - t;
+
     pa_return_val_if_fail(!data->driver || pa_utf8_valid(data->driver), -PA_ERR_INVALID);
 
     if (!data->sink) {
@@ -385,9 +399,15 @@ int pa_sink_input_new(
 
     pa_return_val_if_fail(data->resample_method < PA_RESAMPLER_MAX, -PA_ERR_INVALID);
 
+    if (timed)
+        t = pa_rtclock_now();
+
     if ((r = pa_hook_fire(&core->hooks[PA_CORE_HOOK_SINK_INPUT_FIXATE], data)) < 0)
         return r;
 
+    if (timed)
+        fixate_hook = pa_rtclock_now() - t;
+
     if ((data->flags & PA_SINK_INPUT_NO_CREATE_ON_SUSPEND) &&
         pa_sink_get_state(data->sink) == PA_SINK_SUSPENDED) {
         pa_log_warn("Failed to create sink input: sink is suspended.");
@@ -399,6 +419,9 @@ int pa_sink_input_new(
         return -PA_ERR_TOOLARGE;
     }
 
+    if (timed)
+        t = pa_rtclock_now();
+
     if ((data->flags & PA_SINK_INPUT_VARIABLE_RATE) ||
         !pa_sample_spec_equal(&data->sample_spec, &data->sink->sample_spec) ||
         !pa_channel_map_equal(&data->channel_map, &data->sink->channel_map)) {
@@ -406,7 +429,7 @@ int pa_sink_input_new(
         /* Note: for passthrough content we need to adjust the output rate to that of the current sink-input */
         if (!pa_sink_input_new_data_is_passthrough(data)) /* no resampler for passthrough content */
             if (!(resampler = pa_resampler_new(
-                          core->mempool,
+                          core->mempool, core->resampler_cache,
                           &data->sample_spec, &data->channel_map,
                           &data->sink->sample_spec, &data->sink->channel_map,
                           data->resample_method,
@@ -419,6 +442,9 @@ int pa_sink_input_new(
             }
     }
 
+    if (timed)
+        resampling = pa_rtclock_now() - t;
+
     i = pa_msgobject_new(pa_sink_input);
     i->parent.parent.free = sink_input_free;
     i->parent.process_msg = pa_sink_input_process_msg;
@@ -435,6 +461,7 @@ int pa_sink_input_new(
 
     i->requested_resample_method = data->resample_method;
     i->actual_resample_method = resampler ? pa_resampler_get_method(resampler) : PA_RESAMPLER_INVALID;
+    i->resample_degradation = 0;
     i->sample_spec = data->sample_spec;
     i->channel_map = data->channel_map;
     i->format = pa_format_info_copy(data->format);
@@ -499,6 +526,11 @@ int pa_sink_input_new(
 
     i->thread_info.ramp = i->ramp;
 
+    pa_cvolume_init(&i->thread_info.mix_volume);
+    pa_histogram_init(&i->thread_info.pop_time);
+    pa_level_meter_init(&i->thread_info.level);
+    pa_io_stats_init(&i->thread_info.stats);
+
     pa_assert_se(pa_idxset_put(core->sink_inputs, i, &i->index) == 0);
     pa_assert_se(pa_idxset_put(i->sink->inputs, pa_sink_input_ref(i), NULL) == 0);
 
@@ -518,15 +550,30 @@ int pa_sink_input_new(
             &i->sink->silence);
     pa_xfree(memblockq_name);
 
-    pt = pa_proplist_to_string_sep(i->proplist, "\n    ");
-    pa_log_info("Created input %u \"%s\" on %s with sample spec %s and channel map %s\n    %s",
-                i->index,
-                pa_strnull(pa_proplist_gets(i->proplist, PA_PROP_MEDIA_NAME)),
-                i->sink->name,
-                pa_sample_spec_snprint(st, sizeof(st), &i->sample_spec),
-                pa_channel_map_snprint(cm, sizeof(cm), &i->channel_map),
-                pt);
-    pa_xfree(pt);
+    /* What is kept for rewinds counts towards the client's budget */
+    pa_memblockq_set_mem_account(i->thread_info.render_memblockq, i->client ? i->client->mem_account : i->core->mem_account);
+
+    /* Turning the property list into a string takes longer than many
+     * of the other steps here */
+    if (pa_log_level_enabled(PA_LOG_INFO)) {
+        pt = pa_proplist_to_string_sep(i->proplist, "\n    ");
+        pa_log_info("Created input %u \"%s\" on %s with sample spec %s and channel map %s\n    %s",
+                    i->index,
+                    pa_strnull(pa_proplist_gets(i->proplist, PA_PROP_MEDIA_NAME)),
+                    i->sink->name,
+                    pa_sample_spec_snprint(st, sizeof(st), &i->sample_spec),
+                    pa_channel_map_snprint(cm, sizeof(cm), &i->channel_map),
+                    pt);
+        pa_xfree(pt);
+    }
+
+    if (timed)
+        pa_log_debug("Created input %u in %0.3f ms: new hook %0.3f ms, fixate hook %0.3f ms, resampler %0.3f ms.",
+                     i->index,
+                     (double) (pa_rtclock_now() - begin) / PA_USEC_PER_MSEC,
+                     (double) new_hook / PA_USEC_PER_MSEC,
+                     (double) fixate_hook / PA_USEC_PER_MSEC,
+                     (double) resampling / PA_USEC_PER_MSEC);
 
     /* Don't forget to call pa_sink_input_put! */
 
@@ -789,7 +836,7 @@ pa_usec_t pa_sink_input_get_latency(pa_sink_input *i, pa_usec_t *sink_latency) {
 
 /* Called from thread context */
 void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink frames */, pa_memchunk *chunk, pa_cvolume *volume) {
-    pa_bool_t do_volume_adj_here, need_volume_factor_sink;
+    pa_bool_t do_volume_adj_here;
     pa_bool_t volume_is_norm;
     size_t block_size_max_sink, block_size_max_sink_input;
     size_t ilength;
@@ -831,20 +878,38 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink frames */, p
 
     /* If the channel maps of the sink and this stream differ, we need
      * to adjust the volume *before* we resample. Otherwise we can do
-     * it after and leave it for the sink code */
+     * it after and leave it for the sink code. volume_factor_sink is
+     * always left for the sink, which folds it into the factors it
+     * mixes with, see pa_sink_input_get_mix_volume() */
 
     do_volume_adj_here = !pa_channel_map_equal(&i->channel_map, &i->sink->channel_map);
     volume_is_norm = pa_cvolume_is_norm(&i->thread_info.soft_volume) && !i->thread_info.muted;
-    need_volume_factor_sink = !pa_cvolume_is_norm(&i->volume_factor_sink);
 
     while (!pa_memblockq_is_readable(i->thread_info.render_memblockq)) {
         pa_memchunk tchunk;
+        pa_bool_t popped = FALSE;
 
         /* There's nothing in our render queue. We need to fill it up
          * with data from the implementor. */
 
-        if (i->thread_info.state == PA_SINK_INPUT_CORKED ||
-            i->pop(i, ilength, &tchunk) < 0) {
+        if (i->thread_info.state != PA_SINK_INPUT_CORKED) {
+            pa_usec_t t = pa_rtclock_now(), cpu = i->origin_sink ? pa_rtclock_thread_cpu() : 0;
+
+            popped = i->pop(i, ilength, &tchunk) >= 0;
+
+            t = pa_rtclock_now() - t;
+            pa_histogram_add(&i->thread_info.pop_time, t);
+            pa_atomic_add(&i->thread_info.stats.busy_usec, (int) t);
+
+            if (cpu > 0)
+                pa_atomic_add(&i->thread_info.stats.cpu_usec, (int) (pa_rtclock_thread_cpu() - cpu));
+
+            /* Count running dry after having played something */
+            if (!popped && i->thread_info.underrun_for == 0)
+                pa_atomic_inc(&i->thread_info.stats.underruns);
+        }
+
+        if (!popped) {
 
             /* OK, we're corked or the implementor didn't give us any
              * data, so let's just hand out silence */
@@ -867,7 +932,6 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink frames */, p
 
         while (tchunk.length > 0) {
             pa_memchunk wchunk;
-            pa_bool_t nvfs = need_volume_factor_sink;
             pa_cvolume target;
             pa_bool_t tmp;
 
@@ -881,31 +945,14 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink frames */, p
             if (do_volume_adj_here && !volume_is_norm) {
                 pa_memchunk_make_writable(&wchunk, 0);
 
-                if (i->thread_info.muted) {
+                if (i->thread_info.muted)
                     pa_silence_memchunk(&wchunk, &i->thread_info.sample_spec);
-                    nvfs = FALSE;
-
-                } else if (!i->thread_info.resampler && nvfs) {
-                    pa_cvolume v;
-
-                    /* If we don't need a resampler we can merge the
-                     * post and the pre volume adjustment into one */
-
-                    pa_sw_cvolume_multiply(&v, &i->thread_info.soft_volume, &i->volume_factor_sink);
-                    pa_volume_memchunk(&wchunk, &i->thread_info.sample_spec, &v);
-                    nvfs = FALSE;
-
-                } else
+                else
                     pa_volume_memchunk(&wchunk, &i->thread_info.sample_spec, &i->thread_info.soft_volume);
             }
 
             if (!i->thread_info.resampler) {
 
-                if (nvfs) {
-                    pa_memchunk_make_writable(&wchunk, 0);
-                    pa_volume_memchunk(&wchunk, &i->sink->sample_spec, &i->volume_factor_sink);
-                }
-
                 /* check for possible volume ramp */
                 if (pa_cvolume_ramp_active(&i->thread_info.ramp)) {
                     pa_memchunk_make_writable(&wchunk, 0);
@@ -919,7 +966,10 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink frames */, p
                 pa_memblockq_push_align(i->thread_info.render_memblockq, &wchunk);
             } else {
                 pa_memchunk rchunk;
+                pa_usec_t t = pa_rtclock_now();
+
                 pa_resampler_run(i->thread_info.resampler, &wchunk, &rchunk);
+                pa_atomic_add(&i->thread_info.stats.resample_usec, (int) (pa_rtclock_now() - t));
 
 #ifdef SINK_INPUT_DEBUG
                 pa_log_debug("pushing %lu", (unsigned long) rchunk.length);
@@ -927,11 +977,6 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink frames */, p
 
                 if (rchunk.memblock) {
 
-                    if (nvfs) {
-                        pa_memchunk_make_writable(&rchunk, 0);
-                        pa_volume_memchunk(&rchunk, &i->sink->sample_spec, &i->volume_factor_sink);
-                    }
-
                     /* check for possible volume ramp */
                     if (pa_cvolume_ramp_active(&(i->thread_info.ramp))) {
                         pa_memchunk_make_writable(&rchunk, 0);
@@ -968,17 +1013,51 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink frames */, p
     if (chunk->length > block_size_max_sink)
         chunk->length = block_size_max_sink;
 
+    if (i->thread_info.soft_ramp.left > 0 && !i->thread_info.muted) {
+        size_t fs = pa_frame_size(&i->sink->sample_spec);
+        float gain[PA_CHANNELS_MAX];
+        void *d;
+
+        /* Only the sink's own volume factor is left to the sink, the
+         * ramp goes into the data. The ramp only moves on when the
+         * data is dropped, so it starts from the same gain again if
+         * this is peeked more than once. */
+        chunk->length = PA_MIN(chunk->length, i->thread_info.soft_ramp.left * fs);
+        pa_memchunk_make_writable(chunk, 0);
+
+        memcpy(gain, i->thread_info.soft_ramp.gain, sizeof(float) * i->sink->sample_spec.channels);
+
+        d = (uint8_t*) pa_memblock_acquire(chunk->memblock) + chunk->index;
+        pa_get_volume_ramp_func(i->sink->sample_spec.format)(d, gain, i->thread_info.soft_ramp.step,
+                                                             i->sink->sample_spec.channels, (unsigned) (chunk->length / fs));
+        pa_memblock_release(chunk->memblock);
+
+        *volume = i->volume_factor_sink;
+        return;
+    }
+
+    pa_sink_input_get_mix_volume(i, volume);
+}
+
+/* Called from thread context */
+void pa_sink_input_get_mix_volume(pa_sink_input *i, pa_cvolume *volume) {
+
+    pa_sink_input_assert_ref(i);
+    pa_sink_input_assert_io_context(i);
+    pa_assert(volume);
+
     /* Let's see if we had to apply the volume adjustment ourselves,
      * or if this can be done by the sink for us */
 
-    if (do_volume_adj_here)
+    if (!pa_channel_map_equal(&i->channel_map, &i->sink->channel_map))
         /* We had different channel maps, so we already did the adjustment */
-        pa_cvolume_reset(volume, i->sink->sample_spec.channels);
+        *volume = i->volume_factor_sink;
     else if (i->thread_info.muted)
         /* We've both the same channel map, so let's have the sink do the adjustment for us*/
         pa_cvolume_mute(volume, i->sink->sample_spec.channels);
     else
-        *volume = i->thread_info.soft_volume;
+        /* Mixed in the same pass as the stream volume */
+        pa_sw_cvolume_multiply(volume, &i->thread_info.soft_volume, &i->volume_factor_sink);
 }
 
 /* Called from thread context */
@@ -995,6 +1074,18 @@ void pa_sink_input_drop(pa_sink_input *i, size_t nbytes /* in sink sample spec *
 #endif
 
     pa_memblockq_drop(i->thread_info.render_memblockq, nbytes);
+
+    if (i->thread_info.soft_ramp.left > 0) {
+        size_t n;
+        unsigned c;
+
+        n = PA_MIN(nbytes / pa_frame_size(&i->sink->sample_spec), i->thread_info.soft_ramp.left);
+
+        for (c = 0; c < i->sink->sample_spec.channels; c++)
+            i->thread_info.soft_ramp.gain[c] += i->thread_info.soft_ramp.step[c] * (float) n;
+
+        i->thread_info.soft_ramp.left -= n;
+    }
 }
 
 /* Called from thread context */
@@ -1013,9 +1104,30 @@ void pa_sink_input_process_rewind(pa_sink_input *i, size_t nbytes /* in sink sam
 
     lbq = pa_memblockq_get_length(i->thread_info.render_memblockq);
 
+    if (nbytes > 0)
+        pa_io_stats_add_rewind(&i->thread_info.stats, nbytes);
+
+    /* What is played again gets the new volume right away, there's no
+     * telling where the ramp would have been */
+    if (nbytes > 0)
+        i->thread_info.soft_ramp.left = 0;
+
     if (nbytes > 0 && !i->thread_info.dont_rewind_render) {
         pa_log_debug("Have to rewind %lu bytes on render memblockq.", (unsigned long) nbytes);
         pa_memblockq_rewind(i->thread_info.render_memblockq, nbytes);
+
+        /* If we keep less history than that, the implementor has to
+         * render everything from the new read index on again */
+        if (nbytes > pa_memblockq_get_maxrewind(i->thread_info.render_memblockq) &&
+            i->thread_info.rewrite_nbytes != (size_t) -1) {
+            size_t all = nbytes + lbq;
+
+            if (i->thread_info.resampler)
+                all = pa_resampler_request(i->thread_info.resampler, all);
+
+            i->thread_info.rewrite_nbytes = PA_MAX(i->thread_info.rewrite_nbytes, all);
+            pa_atomic_add(&i->thread_info.stats.rerender_bytes, (int) nbytes);
+        }
     }
 
     if (i->thread_info.rewrite_nbytes == (size_t) -1) {
@@ -1091,6 +1203,22 @@ size_t pa_sink_input_get_max_request(pa_sink_input *i) {
     return i->thread_info.resampler ? pa_resampler_request(i->thread_info.resampler, i->sink->thread_info.max_request) : i->sink->thread_info.max_request;
 }
 
+/* Called from thread context. Returns how much of the max_rewind of
+ * the sink we keep in the render memblockq. Implementors that take
+ * part in rewinds keep the data themselves in the sample spec of the
+ * stream, so depending on sink-input-history-msec we may leave
+ * anything older to be rendered again from that. */
+static size_t history_length(pa_sink_input *i, size_t max_rewind) {
+    size_t l;
+
+    if (i->core->sink_input_history_msec < 0 || !i->process_rewind)
+        return max_rewind;
+
+    l = pa_usec_to_bytes((pa_usec_t) i->core->sink_input_history_msec * PA_USEC_PER_MSEC, &i->sink->sample_spec);
+
+    return PA_MIN(l, max_rewind);
+}
+
 /* Called from thread context */
 void pa_sink_input_update_max_rewind(pa_sink_input *i, size_t nbytes  /* in the sink's sample spec */) {
     pa_sink_input_assert_ref(i);
@@ -1098,7 +1226,8 @@ void pa_sink_input_update_max_rewind(pa_sink_input *i, size_t nbytes  /* in the
     pa_assert(PA_SINK_INPUT_IS_LINKED(i->thread_info.state));
     pa_assert(pa_frame_aligned(nbytes, &i->sink->sample_spec));
 
-    pa_memblockq_set_maxrewind(i->thread_info.render_memblockq, nbytes);
+    pa_memblockq_set_maxrewind(i->thread_info.render_memblockq, history_length(i, nbytes));
+    pa_atomic_store(&i->thread_info.stats.history_bytes, (int) pa_memblockq_get_maxrewind(i->thread_info.render_memblockq));
 
     if (i->update_max_rewind)
         i->update_max_rewind(i, i->thread_info.resampler ? pa_resampler_request(i->thread_info.resampler, nbytes) : nbytes);
@@ -1217,7 +1346,11 @@ void pa_sink_input_set_volume(pa_sink_input *i, const pa_cvolume *volume, pa_boo
         /* We are in flat volume mode, so let's update all sink input
          * volumes and update the flat volume of the sink */
 
-        pa_sink_set_volume(i->sink, NULL, TRUE, save);
+        if (i->sink->volume_batch > 0) {
+            i->sink->volume_batch_flat = TRUE;
+            i->sink->volume_batch_save = i->sink->volume_batch_save || save;
+        } else
+            pa_sink_set_volume(i->sink, NULL, TRUE, save);
 
     } else {
         /* OK, we are in normal volume mode. The volume only affects
@@ -1225,7 +1358,10 @@ void pa_sink_input_set_volume(pa_sink_input *i, const pa_cvolume *volume, pa_boo
         set_real_ratio(i, volume);
 
         /* Copy the new soft_volume to the thread_info struct */
-        pa_assert_se(pa_asyncmsgq_send(i->sink->asyncmsgq, PA_MSGOBJECT(i), PA_SINK_INPUT_MESSAGE_SET_SOFT_VOLUME, NULL, 0, NULL) == 0);
+        if (i->sink->volume_batch > 0)
+            i->sink->volume_batch_sync = TRUE;
+        else
+            pa_assert_se(pa_asyncmsgq_send(i->sink->asyncmsgq, PA_MSGOBJECT(i), PA_SINK_INPUT_MESSAGE_SET_SOFT_VOLUME, NULL, 0, NULL) == 0);
     }
 
     /* The volume changed, let's tell people so */
@@ -1332,7 +1468,10 @@ void pa_sink_input_set_mute(pa_sink_input *i, pa_bool_t mute, pa_bool_t save) {
     i->muted = mute;
     i->save_muted = save;
 
-    pa_assert_se(pa_asyncmsgq_send(i->sink->asyncmsgq, PA_MSGOBJECT(i), PA_SINK_INPUT_MESSAGE_SET_SOFT_MUTE, NULL, 0, NULL) == 0);
+    if (i->sink->volume_batch > 0)
+        i->sink->volume_batch_sync = TRUE;
+    else
+        pa_assert_se(pa_asyncmsgq_send(i->sink->asyncmsgq, PA_MSGOBJECT(i), PA_SINK_INPUT_MESSAGE_SET_SOFT_MUTE, NULL, 0, NULL) == 0);
 
     /* The mute status changed, let's tell people so */
     if (i->mute_changed)
@@ -1760,6 +1899,9 @@ int pa_sink_input_finish_move(pa_sink_input *i, pa_sink *dest, pa_bool_t save) {
 
     pa_sink_input_update_rate(i);
 
+    /* A ramp is in the channels of the old sink */
+    i->thread_info.soft_ramp.left = 0;
+
     pa_sink_update_status(dest);
 
     update_volume_due_to_moving(i, dest);
@@ -1879,6 +2021,78 @@ void pa_sink_input_set_state_within_thread(pa_sink_input *i, pa_sink_input_state
         i->thread_info.state = state;
 }
 
+/* Called from thread context. Fades from the current soft volume to
+ * the new one over volume-ramp-msec at the read index, which needs no
+ * rewind. Returns FALSE if the change has to be rewound for instead:
+ * if ramps are disabled, if the volume is applied before resampling,
+ * or if there's no ramp function for the format of the sink. */
+static pa_bool_t start_soft_ramp(pa_sink_input *i, const pa_cvolume *volume) {
+    size_t frames;
+    unsigned c;
+
+    if (i->core->volume_ramp_msec <= 0 ||
+        !pa_channel_map_equal(&i->channel_map, &i->sink->channel_map) ||
+        !pa_get_volume_ramp_func(i->sink->sample_spec.format))
+        return FALSE;
+
+    pa_assert(volume->channels == i->sink->sample_spec.channels);
+
+    /* Nothing to be heard of it while we are corked or muted */
+    if (i->thread_info.state == PA_SINK_INPUT_CORKED || i->thread_info.muted) {
+        i->thread_info.soft_ramp.left = 0;
+        return TRUE;
+    }
+
+    frames = PA_MAX((size_t) i->core->volume_ramp_msec * i->sink->sample_spec.rate / 1000, (size_t) 1);
+
+    for (c = 0; c < volume->channels; c++) {
+        float end = (float) pa_sw_volume_to_linear(volume->values[c]);
+
+        /* An ongoing ramp continues from where it is */
+        if (i->thread_info.soft_ramp.left <= 0)
+            i->thread_info.soft_ramp.gain[c] = (float) pa_sw_volume_to_linear(i->thread_info.soft_volume.values[c]);
+
+        i->thread_info.soft_ramp.step[c] = (end - i->thread_info.soft_ramp.gain[c]) / (float) frames;
+    }
+
+    i->thread_info.soft_ramp.left = frames;
+
+    return TRUE;
+}
+
+/* Called from thread context */
+static void sync_soft_volume(pa_sink_input *i) {
+    pa_bool_t ramped;
+
+    if (pa_cvolume_equal(&i->thread_info.soft_volume, &i->soft_volume))
+        return;
+
+    ramped = start_soft_ramp(i, &i->soft_volume);
+
+    i->thread_info.soft_volume = i->soft_volume;
+
+    if (!ramped)
+        pa_sink_input_request_volume_rewind(i);
+}
+
+/* Called from thread context */
+static void sync_soft_mute(pa_sink_input *i) {
+    if (i->thread_info.muted == i->muted)
+        return;
+
+    i->thread_info.muted = i->muted;
+    pa_sink_input_request_volume_rewind(i);
+}
+
+/* Called from thread context */
+void pa_sink_input_sync_volume_within_thread(pa_sink_input *i) {
+    pa_sink_input_assert_ref(i);
+    pa_sink_input_assert_io_context(i);
+
+    sync_soft_mute(i);
+    sync_soft_volume(i);
+}
+
 /* Called from thread context, except when it is not. */
 int pa_sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offset, pa_memchunk *chunk) {
     pa_sink_input *i = PA_SINK_INPUT(o);
@@ -1887,10 +2101,7 @@ int pa_sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int64_t
     switch (code) {
 
         case PA_SINK_INPUT_MESSAGE_SET_SOFT_VOLUME:
-            if (!pa_cvolume_equal(&i->thread_info.soft_volume, &i->soft_volume)) {
-                i->thread_info.soft_volume = i->soft_volume;
-                pa_sink_input_request_rewind(i, 0, TRUE, FALSE, FALSE);
-            }
+            sync_soft_volume(i);
             return 0;
 
         case PA_SINK_INPUT_MESSAGE_SET_VOLUME_RAMP:
@@ -1900,10 +2111,7 @@ int pa_sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int64_t
             return 0;
 
         case PA_SINK_INPUT_MESSAGE_SET_SOFT_MUTE:
-            if (i->thread_info.muted != i->muted) {
-                i->thread_info.muted = i->muted;
-                pa_sink_input_request_rewind(i, 0, TRUE, FALSE, FALSE);
-            }
+            sync_soft_mute(i);
             return 0;
 
         case PA_SINK_INPUT_MESSAGE_GET_LATENCY: {
@@ -1922,6 +2130,20 @@ int pa_sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int64_t
 
             return 0;
 
+        case PA_SINK_INPUT_MESSAGE_SET_RESAMPLER: {
+            pa_resampler **r = userdata, *old_resampler;
+
+            /* The rendered data stays in the sample spec of the sink,
+             * only the filter history of the old resampler is lost */
+            old_resampler = i->thread_info.resampler;
+            i->thread_info.resampler = *r;
+            *r = old_resampler;
+
+            pa_resampler_set_input_rate(i->thread_info.resampler, i->thread_info.sample_spec.rate);
+
+            return 0;
+        }
+
         case PA_SINK_INPUT_MESSAGE_SET_STATE: {
             pa_sink_input *ssync;
 
@@ -2067,6 +2289,27 @@ void pa_sink_input_request_rewind(
     }
 }
 
+/* Called from IO context */
+void pa_sink_input_request_volume_rewind(pa_sink_input *i) {
+    pa_sink_input_assert_ref(i);
+    pa_sink_input_assert_io_context(i);
+
+    /* If the channel maps differ, pa_sink_input_peek() applies the
+     * volume before resampling, and what is in the render queue was
+     * rendered with the old one. Otherwise the volume is handed to the
+     * sink with every chunk, so rewinding the sink and the render queues
+     * is enough, and the implementor and resampler are left alone. */
+    if (!pa_channel_map_equal(&i->channel_map, &i->sink->channel_map)) {
+        pa_sink_input_request_rewind(i, 0, TRUE, FALSE, FALSE);
+        return;
+    }
+
+    if (i->thread_info.state == PA_SINK_INPUT_CORKED)
+        return;
+
+    pa_sink_request_remix(i->sink);
+}
+
 /* Called from main context */
 pa_memchunk* pa_sink_input_get_silence(pa_sink_input *i, pa_memchunk *ret) {
     pa_sink_input_assert_ref(i);
@@ -2114,6 +2357,70 @@ finish:
         pa_proplist_free(pl);
 }
 
+/* Called from main context */
+static pa_resampler *resampler_new(pa_sink_input *i, pa_resample_method_t method) {
+    return pa_resampler_new(i->core->mempool, i->core->resampler_cache,
+                            &i->sample_spec, &i->channel_map,
+                            &i->sink->sample_spec, &i->sink->channel_map,
+                            method,
+                            ((i->flags & PA_SINK_INPUT_VARIABLE_RATE) ? PA_RESAMPLER_VARIABLE_RATE : 0) |
+                            ((i->flags & PA_SINK_INPUT_NO_REMAP) ? PA_RESAMPLER_NO_REMAP : 0) |
+                            (i->core->disable_remixing || (i->flags & PA_SINK_INPUT_NO_REMIX) ? PA_RESAMPLER_NO_REMIX : 0) |
+                            (i->core->disable_lfe_remixing ? PA_RESAMPLER_NO_LFE : 0));
+}
+
+/* Called from main context. Goes *steps steps down from the requested
+ * method, and sets *steps to how many there were. */
+static pa_resample_method_t degraded_resample_method(pa_sink_input *i, unsigned *steps) {
+    pa_resample_method_t m = i->requested_resample_method, cheaper;
+    unsigned n;
+
+    for (n = 0; n < *steps; n++) {
+        if ((cheaper = pa_resample_method_cheaper(m)) == PA_RESAMPLER_INVALID)
+            break;
+
+        m = cheaper;
+    }
+
+    *steps = n;
+    return m;
+}
+
+/* Called from main context */
+unsigned pa_sink_input_set_resample_degradation(pa_sink_input *i, unsigned steps) {
+    pa_resampler *r;
+    pa_resample_method_t m;
+
+    pa_sink_input_assert_ref(i);
+    pa_assert_ctl_context();
+    pa_assert(PA_SINK_INPUT_IS_LINKED(i->state));
+
+    /* Nothing to make cheaper, or in the middle of a move */
+    if (!i->thread_info.resampler || i->actual_resample_method == PA_RESAMPLER_COPY || !i->sink)
+        return i->resample_degradation;
+
+    m = degraded_resample_method(i, &steps);
+
+    if (steps == i->resample_degradation)
+        return steps;
+
+    if (!(r = resampler_new(i, m)))
+        return i->resample_degradation;
+
+    /* The IO thread hands back the old one */
+    pa_assert_se(pa_asyncmsgq_send(i->sink->asyncmsgq, PA_MSGOBJECT(i), PA_SINK_INPUT_MESSAGE_SET_RESAMPLER, &r, 0, NULL) == 0);
+    pa_resampler_free(r);
+
+    i->resample_degradation = steps;
+    i->actual_resample_method = pa_resampler_get_method(i->thread_info.resampler);
+
+    pa_log_debug("Resampler of sink input %u is now '%s'.", i->index, pa_resample_method_to_string(i->actual_resample_method));
+
+    pa_subscription_post(i->core, PA_SUBSCRIPTION_EVENT_SINK_INPUT|PA_SUBSCRIPTION_EVENT_CHANGE, i->index);
+
+    return steps;
+}
+
 /* Called from main context */
 /* Updates the sink input's resampler with whatever the current sink requires
  * -- useful when the underlying sink's rate might have changed */
@@ -2135,23 +2442,22 @@ int pa_sink_input_update_rate(pa_sink_input *i) {
          !pa_sample_spec_equal(&i->sample_spec, &i->sink->sample_spec) ||
          !pa_channel_map_equal(&i->channel_map, &i->sink->channel_map))) {
 
-        new_resampler = pa_resampler_new(i->core->mempool,
-                                     &i->sample_spec, &i->channel_map,
-                                     &i->sink->sample_spec, &i->sink->channel_map,
-                                     i->requested_resample_method,
-                                     ((i->flags & PA_SINK_INPUT_VARIABLE_RATE) ? PA_RESAMPLER_VARIABLE_RATE : 0) |
-                                     ((i->flags & PA_SINK_INPUT_NO_REMAP) ? PA_RESAMPLER_NO_REMAP : 0) |
-                                     (i->core->disable_remixing || (i->flags & PA_SINK_INPUT_NO_REMIX) ? PA_RESAMPLER_NO_REMIX : 0));
+        new_resampler = resampler_new(i, degraded_resample_method(i, &i->resample_degradation));
 
         if (!new_resampler) {
             pa_log_warn("Unsupported resampling operation.");
+            i->thread_info.move_rewrite_nbytes = 0;
             return -PA_ERR_NOTSUPPORTED;
         }
     } else
         new_resampler = NULL;
 
-    if (new_resampler == i->thread_info.resampler)
+    if (new_resampler == i->thread_info.resampler) {
+        /* What was rendered for the old sink when moving can be
+         * played to the new one as it is */
+        i->thread_info.move_rewrite_nbytes = 0;
         return 0;
+    }
 
     if (i->thread_info.resampler)
         pa_resampler_free(i->thread_info.resampler);
@@ -2172,6 +2478,7 @@ int pa_sink_input_update_rate(pa_sink_input *i) {
             0,
             &i->sink->silence);
     pa_xfree(memblockq_name);
+    pa_memblockq_set_mem_account(i->thread_info.render_memblockq, i->client ? i->client->mem_account : i->core->mem_account);
 
     i->actual_resample_method = new_resampler ? pa_resampler_get_method(new_resampler) : PA_RESAMPLER_INVALID;
 
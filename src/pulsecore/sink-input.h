@@ -29,6 +29,9 @@ typedef struct pa_sink_input pa_sink_input;
 
 #include <pulse/sample.h>
 #include <pulse/format.h>
+#include <pulsecore/histogram.h>
+#include <pulsecore/level-meter.h>
+#include <pulsecore/io-stats.h>
 #include <pulsecore/memblockq.h>
 #include <pulsecore/resampler.h>
 #include <pulsecore/module.h>
@@ -124,6 +127,10 @@ struct pa_sink_input {
 
     pa_resample_method_t requested_resample_method, actual_resample_method;
 
+    /* How many steps the resampler has been moved towards cheaper
+     * methods, see pa_sink_input_set_resample_degradation() */
+    unsigned resample_degradation;
+
     /* Returns the chunk of audio data and drops it from the
      * queue. Returns -1 on failure. Called from IO thread context. If
      * data needs to be generated from scratch then please in the
@@ -231,6 +238,11 @@ struct pa_sink_input {
         size_t rewrite_nbytes;
         uint64_t underrun_for, playing_for;
 
+        /* While moving: how much to ask the implementor for again, in
+         * our sample spec, if the audio already rendered for the old
+         * sink can't be played to the new one */
+        size_t move_rewrite_nbytes;
+
         pa_sample_spec sample_spec;
 
         pa_resampler *resampler;                     /* may be NULL */
@@ -246,6 +258,28 @@ struct pa_sink_input {
         pa_hashmap *direct_outputs;
 
         pa_cvolume_ramp_int ramp;
+
+        /* The volume this stream is part of the sink's mix history
+         * with, see pa_sink_request_remix() */
+        pa_cvolume mix_volume;
+
+        /* A soft volume change that is faded in instead of rewinding
+         * for it, see volume-ramp-msec. gain is the linear soft volume
+         * at the read index of the render memblockq, which moves by
+         * step per frame for the next left frames. */
+        struct {
+            float gain[PA_CHANNELS_MAX];
+            float step[PA_CHANNELS_MAX];
+            size_t left;
+        } soft_ramp;
+
+        /* Time spent in pop() */
+        pa_histogram pop_time;
+
+        /* Level of the data mixed into the sink, after the volume */
+        pa_level_meter level;
+
+        pa_io_stats stats;
     } thread_info;
 
     void *userdata;
@@ -263,6 +297,7 @@ enum {
     PA_SINK_INPUT_MESSAGE_SET_REQUESTED_LATENCY,
     PA_SINK_INPUT_MESSAGE_GET_REQUESTED_LATENCY,
     PA_SINK_INPUT_MESSAGE_SET_VOLUME_RAMP,
+    PA_SINK_INPUT_MESSAGE_SET_RESAMPLER,
     PA_SINK_INPUT_MESSAGE_MAX
 };
 
@@ -345,6 +380,20 @@ could be rewound in the HW device. This functionality is required for
 implementing the "zero latency" write-through functionality. */
 void pa_sink_input_request_rewind(pa_sink_input *i, size_t nbytes, pa_bool_t rewrite, pa_bool_t flush, pa_bool_t dont_rewind_render);
 
+/* Request the rewind needed after the soft volume or mute state of the
+stream changed. Unless the stream applies its volume itself, the sink
+only has to mix again what it still can, and nothing needs to be
+rendered again. Called from IO context. */
+void pa_sink_input_request_volume_rewind(pa_sink_input *i);
+
+/* Take over the soft volume and mute state from the main thread, as
+pa_sink_end_volume_batch() wants it. Called from IO context. */
+void pa_sink_input_sync_volume_within_thread(pa_sink_input *i);
+
+/* The volume the sink has to apply when mixing what
+pa_sink_input_peek() returns. Called from IO context. */
+void pa_sink_input_get_mix_volume(pa_sink_input *i, pa_cvolume *volume);
+
 void pa_sink_input_cork(pa_sink_input *i, pa_bool_t b);
 void pa_sink_input_cork_internal(pa_sink_input *i, pa_bool_t b);
 
@@ -376,6 +425,12 @@ void pa_sink_input_update_proplist(pa_sink_input *i, pa_update_mode_t mode, pa_p
 
 pa_resample_method_t pa_sink_input_get_resample_method(pa_sink_input *i);
 
+/* Swaps the resampler for one that is the given number of steps of
+ * pa_resample_method_cheaper() away from the requested method, or as
+ * far as there are. It takes over in the next render cycle, with no
+ * rewind. Returns the number of steps in effect. */
+unsigned pa_sink_input_set_resample_degradation(pa_sink_input *i, unsigned steps);
+
 void pa_sink_input_send_event(pa_sink_input *i, const char *name, pa_proplist *data);
 
 int pa_sink_input_move_to(pa_sink_input *i, pa_sink *dest, pa_bool_t save);
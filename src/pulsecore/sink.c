@@ -42,11 +42,13 @@
 #include <pulsecore/namereg.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/sample-util.h>
+#include <pulsecore/sconv.h>
 #include <pulsecore/core-subscribe.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/play-memblockq.h>
 #include <pulsecore/flist.h>
+#include <pulsecore/trace.h>
 
 #include "sink.h"
 
@@ -281,6 +283,8 @@ pa_sink* pa_sink_new(
     s->n_volume_steps = PA_VOLUME_NORM+1;
     s->muted = data->muted;
     s->refresh_volume = s->refresh_muted = FALSE;
+    s->volume_batch = 0;
+    s->volume_batch_sync = s->volume_batch_flat = s->volume_batch_save = FALSE;
 
     reset_callbacks(s);
     s->userdata = NULL;
@@ -343,6 +347,20 @@ pa_sink* pa_sink_new(
 
     s->thread_info.ramp = s->ramp;
 
+    s->thread_info.mix_history.data = NULL;
+    s->thread_info.mix_history.n_frames = 0;
+    s->thread_info.mix_history.start = s->thread_info.mix_history.end = s->thread_info.mix_history.pos = 0;
+    pa_cvolume_init(&s->thread_info.mix_history.volume);
+    s->thread_info.mix_history.remix = FALSE;
+    s->thread_info.mix_history.replaying = FALSE;
+    s->thread_info.mix_scratch = NULL;
+    s->thread_info.mix_scratch_samples = 0;
+
+    pa_histogram_init(&s->thread_info.render_time);
+    pa_level_meter_init(&s->thread_info.level);
+    pa_io_stats_init(&s->thread_info.stats);
+    pa_latency_snapshot_init(&s->latency_snapshot);
+
     /* FIXME: This should probably be moved to pa_sink_put() */
     pa_assert_se(pa_idxset_put(core->sinks, s, &s->index) >= 0);
 
@@ -734,6 +752,9 @@ static void sink_free(pa_object *o) {
     if (s->silence.memblock)
         pa_memblock_unref(s->silence.memblock);
 
+    pa_xfree(s->thread_info.mix_history.data);
+    pa_xfree(s->thread_info.mix_scratch);
+
     pa_xfree(s->name);
     pa_xfree(s->driver);
 
@@ -743,6 +764,8 @@ static void sink_free(pa_object *o) {
     if (s->ports)
         pa_device_port_hashmap_free(s->ports);
 
+    pa_latency_snapshot_done(&s->latency_snapshot);
+
     pa_xfree(s);
 }
 
@@ -913,10 +936,48 @@ void pa_sink_move_all_fail(pa_queue *q) {
     pa_queue_free(q, NULL);
 }
 
+/* Called from IO thread context */
+static void mix_history_reset(pa_sink *s) {
+    s->thread_info.mix_history.replaying = FALSE;
+    s->thread_info.mix_history.start = s->thread_info.mix_history.end = s->thread_info.mix_history.pos;
+}
+
+/* Called from IO thread context */
+static void mix_history_rewind(pa_sink *s, size_t nbytes, pa_bool_t remix) {
+    pa_sink_input *i;
+    void *state = NULL;
+    int64_t frames;
+
+    frames = (int64_t) (nbytes / pa_frame_size(&s->sample_spec));
+
+    if (!remix ||
+        s->thread_info.mix_history.replaying ||
+        frames <= 0 ||
+        frames > s->thread_info.mix_history.end - s->thread_info.mix_history.start ||
+        s->thread_info.mix_history.n_frames != s->thread_info.max_rewind / pa_frame_size(&s->sample_spec) ||
+        !pa_cvolume_equal(&s->thread_info.mix_history.volume, &s->thread_info.soft_volume)) {
+        mix_history_reset(s);
+        return;
+    }
+
+    /* The render queues have to hold exactly what was mixed */
+    PA_HASHMAP_FOREACH(i, s->thread_info.inputs, state)
+        if (i->thread_info.rewrite_nbytes > 0 || i->thread_info.dont_rewind_render) {
+            mix_history_reset(s);
+            return;
+        }
+
+    /* What lies before the rewind point was mixed with the old
+     * volumes and won't be patched, so it is given up */
+    s->thread_info.mix_history.pos = s->thread_info.mix_history.start = s->thread_info.mix_history.end - frames;
+    s->thread_info.mix_history.replaying = TRUE;
+}
+
 /* Called from IO thread context */
 void pa_sink_process_rewind(pa_sink *s, size_t nbytes) {
     pa_sink_input *i;
     void *state = NULL;
+    pa_bool_t remix;
 
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
@@ -929,18 +990,26 @@ void pa_sink_process_rewind(pa_sink *s, size_t nbytes) {
     if (!s->thread_info.rewind_requested && nbytes <= 0)
         return;
 
+    remix = s->thread_info.rewind_requested && s->thread_info.mix_history.remix;
+
     s->thread_info.rewind_nbytes = 0;
     s->thread_info.rewind_requested = FALSE;
+    s->thread_info.mix_history.remix = FALSE;
 
-    if (s->thread_info.state == PA_SINK_SUSPENDED)
+    if (s->thread_info.state == PA_SINK_SUSPENDED) {
+        mix_history_reset(s);
         return;
+    }
 
     if (nbytes > 0) {
         pa_log_debug("Processing rewind...");
+        pa_io_stats_add_rewind(&s->thread_info.stats, nbytes);
         if (s->flags & PA_SINK_DEFERRED_VOLUME)
             pa_sink_volume_change_rewind(s, nbytes);
     }
 
+    mix_history_rewind(s, nbytes, remix);
+
     PA_HASHMAP_FOREACH(i, s->thread_info.inputs, state) {
         pa_sink_input_assert_ref(i);
         pa_sink_input_process_rewind(i, nbytes);
@@ -1029,6 +1098,14 @@ static void inputs_drop(pa_sink *s, pa_mix_info *info, unsigned n, pa_memchunk *
         /* Drop read data */
         pa_sink_input_drop(i, result->length);
 
+        if (m && m->chunk.memblock && pa_level_meter_is_enabled(&i->thread_info.level)) {
+            pa_memchunk c = m->chunk;
+
+            pa_assert(result->length <= c.length);
+            c.length = result->length;
+            pa_level_meter_add(&i->thread_info.level, &c, &s->sample_spec, &m->volume);
+        }
+
         if (s->monitor_source && PA_SOURCE_IS_LINKED(s->monitor_source->thread_info.state)) {
 
             if (pa_hashmap_size(i->thread_info.direct_outputs) > 0) {
@@ -1085,15 +1162,266 @@ static void inputs_drop(pa_sink *s, pa_mix_info *info, unsigned n, pa_memchunk *
         }
     }
 
+    pa_level_meter_add(&s->thread_info.level, result, &s->sample_spec, NULL);
+
     if (s->monitor_source && PA_SOURCE_IS_LINKED(s->monitor_source->thread_info.state))
         pa_source_post(s->monitor_source, result);
 }
 
+/* Called from IO thread context. Makes sure the next frames can be
+ * appended to the mix history, or returns FALSE if they can't be kept. */
+static pa_bool_t mix_history_prepare(pa_sink *s, pa_mix_info info[], unsigned n) {
+    size_t n_frames;
+    pa_bool_t restart;
+    unsigned k;
+
+    pa_assert(!s->thread_info.mix_history.replaying);
+
+    n_frames = s->thread_info.max_rewind / pa_frame_size(&s->sample_spec);
+
+    /* A muted mix says nothing about the streams in it */
+    if (n_frames <= 0 ||
+        s->thread_info.soft_muted ||
+        pa_cvolume_is_muted(&s->thread_info.soft_volume)) {
+        mix_history_reset(s);
+        return FALSE;
+    }
+
+    if (s->thread_info.mix_history.n_frames != n_frames) {
+        pa_xfree(s->thread_info.mix_history.data);
+        s->thread_info.mix_history.data = pa_xnew(float, n_frames * s->sample_spec.channels);
+        s->thread_info.mix_history.n_frames = n_frames;
+        mix_history_reset(s);
+    }
+
+    /* Every stream has to be in the history with one volume only */
+    restart = !pa_cvolume_equal(&s->thread_info.mix_history.volume, &s->thread_info.soft_volume);
+
+    for (k = 0; k < n; k++) {
+        pa_sink_input *i = info[k].userdata;
+
+        if (!pa_cvolume_equal(&i->thread_info.mix_volume, &info[k].volume)) {
+            i->thread_info.mix_volume = info[k].volume;
+            restart = TRUE;
+        }
+    }
+
+    if (restart) {
+        mix_history_reset(s);
+        s->thread_info.mix_history.volume = s->thread_info.soft_volume;
+    }
+
+    return TRUE;
+}
+
+/* Called from IO thread context */
+static void mix_history_finish_replay(pa_sink *s) {
+    pa_sink_input *i;
+    void *state = NULL;
+
+    PA_HASHMAP_FOREACH(i, s->thread_info.inputs, state)
+        pa_sink_input_get_mix_volume(i, &i->thread_info.mix_volume);
+
+    s->thread_info.mix_history.replaying = FALSE;
+}
+
+/* Called from IO thread context */
+static float* get_mix_scratch(pa_sink *s, size_t nsamples) {
+
+    if (s->thread_info.mix_scratch_samples < nsamples) {
+        pa_xfree(s->thread_info.mix_scratch);
+        s->thread_info.mix_scratch = pa_xnew(float, nsamples);
+        s->thread_info.mix_scratch_samples = nsamples;
+    }
+
+    return s->thread_info.mix_scratch;
+}
+
+/* Called from IO thread context. Converts the stream to float in x
+ * and adds it to the mix, scaled by factor per channel */
+static void mix_add_float32(pa_sink *s, pa_convert_func_t to_float32ne, const pa_mix_info *m, const float factor[], float *x, float *mix, unsigned nsamples) {
+    unsigned j, c;
+    void *src;
+
+    src = (uint8_t*) pa_memblock_acquire(m->chunk.memblock) + m->chunk.index;
+    to_float32ne(nsamples, src, x);
+    pa_memblock_release(m->chunk.memblock);
+
+    for (j = 0, c = 0; j < nsamples; j++) {
+        mix[j] += x[j] * factor[c];
+
+        if (PA_UNLIKELY(++c >= s->sample_spec.channels))
+            c = 0;
+    }
+}
+
+/* Called from IO thread context. The streams come in the format of the
+ * sink, they are converted one after another into a scratch buffer of
+ * the sink and added up in float, so that the mix is clipped only
+ * once, and can be kept in the history. */
+static size_t mix_float32(pa_sink *s, pa_mix_info info[], unsigned n, void *data, size_t length) {
+    pa_convert_func_t to_float32ne, from_float32ne;
+    float linear[PA_CHANNELS_MAX], factor[PA_CHANNELS_MAX];
+    float *x, *mix;
+    pa_bool_t record;
+    size_t fs, ffs;
+    unsigned k, c, nsamples;
+
+    to_float32ne = pa_get_convert_to_float32ne_function(s->sample_spec.format);
+    from_float32ne = pa_get_convert_from_float32ne_function(s->sample_spec.format);
+    pa_assert(to_float32ne);
+    pa_assert(from_float32ne);
+
+    fs = pa_frame_size(&s->sample_spec);
+    ffs = sizeof(float) * s->sample_spec.channels;
+
+    /* Keeps the scratch buffer at the size of a pool block */
+    length = PA_MIN(length, (pa_mempool_block_size_max(s->core->mempool) / ffs) * fs);
+
+    for (k = 0; k < n; k++)
+        length = PA_MIN(length, info[k].chunk.length);
+
+    /* The mix goes straight into the history, which must not wrap
+     * around in the middle of it */
+    if ((record = mix_history_prepare(s, info, n)))
+        length = PA_MIN(length, (s->thread_info.mix_history.n_frames -
+                                 (size_t) (s->thread_info.mix_history.end % (int64_t) s->thread_info.mix_history.n_frames)) * fs);
+
+    nsamples = (unsigned) (length / fs) * s->sample_spec.channels;
+
+    /* Without a history to mix into, the mix goes behind the stream */
+    x = get_mix_scratch(s, record ? nsamples : 2 * nsamples);
+
+    if (record)
+        mix = s->thread_info.mix_history.data +
+            (size_t) (s->thread_info.mix_history.end % (int64_t) s->thread_info.mix_history.n_frames) * s->sample_spec.channels;
+    else
+        mix = x + nsamples;
+
+    memset(mix, 0, nsamples * sizeof(float));
+
+    if (!s->thread_info.soft_muted && !pa_cvolume_is_muted(&s->thread_info.soft_volume)) {
+
+        for (c = 0; c < s->sample_spec.channels; c++)
+            linear[c] = (float) pa_sw_volume_to_linear(s->thread_info.soft_volume.values[c]);
+
+        for (k = 0; k < n; k++) {
+            /* The factors pa_mix() uses */
+            for (c = 0; c < s->sample_spec.channels; c++)
+                factor[c] = (float) (pa_sw_volume_to_linear(info[k].volume.values[c]) * linear[c]);
+
+            mix_add_float32(s, to_float32ne, &info[k], factor, x, mix, nsamples);
+        }
+    }
+
+    /* This is the only place where the mix is clipped */
+    from_float32ne(nsamples, mix, data);
+
+    if (record) {
+        s->thread_info.mix_history.end += (int64_t) (length / fs);
+        s->thread_info.mix_history.pos = s->thread_info.mix_history.end;
+        s->thread_info.mix_history.start = PA_MAX(s->thread_info.mix_history.start,
+                                                  s->thread_info.mix_history.end - (int64_t) s->thread_info.mix_history.n_frames);
+    }
+
+    return length;
+}
+
+/* Called from IO thread context. Instead of mixing all streams again,
+ * only the difference made by the streams whose volume changed is
+ * added to the mix history. */
+static size_t mix_history_replay(pa_sink *s, pa_mix_info info[], unsigned n, void *data, size_t length) {
+    pa_convert_func_t to_float32ne, from_float32ne;
+    float linear[PA_CHANNELS_MAX], *mix, *x = NULL;
+    size_t fs, ffs, offset;
+    unsigned k, c, nsamples;
+
+    to_float32ne = pa_get_convert_to_float32ne_function(s->sample_spec.format);
+    from_float32ne = pa_get_convert_from_float32ne_function(s->sample_spec.format);
+
+    fs = pa_frame_size(&s->sample_spec);
+    ffs = sizeof(float) * s->sample_spec.channels;
+    offset = (size_t) (s->thread_info.mix_history.pos % (int64_t) s->thread_info.mix_history.n_frames);
+
+    length = PA_MIN(length, (pa_mempool_block_size_max(s->core->mempool) / ffs) * fs);
+    length = PA_MIN(length, (size_t) (s->thread_info.mix_history.end - s->thread_info.mix_history.pos) * fs);
+    length = PA_MIN(length, (s->thread_info.mix_history.n_frames - offset) * fs);
+
+    for (k = 0; k < n; k++) {
+        pa_sink_input *i = info[k].userdata;
+
+        /* A stream that wasn't mixed before can't be patched in */
+        if (!pa_cvolume_compatible(&i->thread_info.mix_volume, &s->sample_spec)) {
+            mix_history_reset(s);
+            return mix_float32(s, info, n, data, length);
+        }
+
+        length = PA_MIN(length, info[k].chunk.length);
+    }
+
+    nsamples = (unsigned) (length / fs) * s->sample_spec.channels;
+    mix = s->thread_info.mix_history.data + offset * s->sample_spec.channels;
+
+    for (c = 0; c < s->sample_spec.channels; c++)
+        linear[c] = (float) pa_sw_volume_to_linear(s->thread_info.soft_volume.values[c]);
+
+    for (k = 0; k < n; k++) {
+        pa_sink_input *i = info[k].userdata;
+        float delta[PA_CHANNELS_MAX];
+
+        if (pa_cvolume_equal(&info[k].volume, &i->thread_info.mix_volume))
+            continue;
+
+        /* The same factors pa_mix() uses, so that the result matches
+         * a full mix */
+        for (c = 0; c < s->sample_spec.channels; c++)
+            delta[c] = (float) (pa_sw_volume_to_linear(info[k].volume.values[c]) * linear[c]) -
+                (float) (pa_sw_volume_to_linear(i->thread_info.mix_volume.values[c]) * linear[c]);
+
+        if (!x)
+            x = get_mix_scratch(s, nsamples);
+
+        mix_add_float32(s, to_float32ne, &info[k], delta, x, mix, nsamples);
+    }
+
+    from_float32ne(nsamples, mix, data);
+
+    s->thread_info.mix_history.pos += (int64_t) (length / fs);
+
+    if (s->thread_info.mix_history.pos >= s->thread_info.mix_history.end)
+        mix_history_finish_replay(s);
+
+    return length;
+}
+
+/* Called from IO thread context */
+static size_t sink_mix(pa_sink *s, pa_mix_info info[], unsigned n, void *data, size_t length) {
+
+    if (s->thread_info.mix_history.replaying)
+        return mix_history_replay(s, info, n, data, length);
+
+    if (s->core->float32_mixing &&
+        s->sample_spec.format != PA_SAMPLE_FLOAT32NE &&
+        s->sample_spec.format != PA_SAMPLE_FLOAT32RE &&
+        pa_get_convert_to_float32ne_function(s->sample_spec.format) &&
+        pa_get_convert_from_float32ne_function(s->sample_spec.format))
+        return mix_float32(s, info, n, data, length);
+
+    mix_history_reset(s);
+
+    return pa_mix(info, n,
+                  data, length,
+                  &s->sample_spec,
+                  &s->thread_info.soft_volume,
+                  s->thread_info.soft_muted);
+}
+
 /* Called from IO thread context */
 void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
     pa_mix_info info[MAX_MIX_CHANNELS];
     unsigned n;
     size_t block_size_max;
+    pa_bool_t replay;
 
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
@@ -1105,6 +1433,7 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
     pa_assert(s->thread_info.rewind_nbytes == 0);
 
     if (s->thread_info.state == PA_SINK_SUSPENDED) {
+        mix_history_reset(s);
         result->memblock = pa_memblock_ref(s->silence.memblock);
         result->index = s->silence.index;
         result->length = PA_MIN(s->silence.length, length);
@@ -1113,6 +1442,8 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
 
     pa_sink_ref(s);
 
+    pa_trace(PA_TRACE_SINK_RENDER_BEGIN, s->index, length);
+
     if (length <= 0)
         length = pa_frame_align(MIX_BUFFER_LENGTH, &s->sample_spec);
 
@@ -1124,7 +1455,13 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
 
     n = fill_mix_info(s, &length, info, MAX_MIX_CHANNELS);
 
-    if (n == 0) {
+    /* While replaying, the history has to be patched whatever the
+     * number of streams */
+    replay = s->thread_info.mix_history.replaying;
+
+    if (n == 0 && !replay) {
+
+        mix_history_reset(s);
 
         *result = s->silence;
         pa_memblock_ref(result->memblock);
@@ -1132,10 +1469,12 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
         if (result->length > length)
             result->length = length;
 
-    } else if (n == 1) {
+    } else if (n == 1 && !replay) {
         pa_cvolume volume;
         pa_cvolume target;
 
+        mix_history_reset(s);
+
         *result = info[0].chunk;
         pa_memblock_ref(result->memblock);
 
@@ -1173,11 +1512,7 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
         result->memblock = pa_memblock_new(s->core->mempool, length);
 
         ptr = pa_memblock_acquire(result->memblock);
-        result->length = pa_mix(info, n,
-                                ptr, length,
-                                &s->sample_spec,
-                                &s->thread_info.soft_volume,
-                                s->thread_info.soft_muted);
+        result->length = sink_mix(s, info, n, ptr, length);
 
         if (pa_cvolume_ramp_target_active(&s->thread_info.ramp) || pa_cvolume_ramp_active(&s->thread_info.ramp)) {
             if (pa_cvolume_ramp_active(&s->thread_info.ramp))
@@ -1195,6 +1530,8 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
 
     inputs_drop(s, info, n, result);
 
+    pa_trace(PA_TRACE_SINK_RENDER_END, s->index, result->length);
+
     pa_sink_unref(s);
 }
 
@@ -1203,6 +1540,7 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
     pa_mix_info info[MAX_MIX_CHANNELS];
     unsigned n;
     size_t length, block_size_max;
+    pa_bool_t replay;
 
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
@@ -1216,6 +1554,7 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
     pa_assert(s->thread_info.rewind_nbytes == 0);
 
     if (s->thread_info.state == PA_SINK_SUSPENDED) {
+        mix_history_reset(s);
         pa_silence_memchunk(target, &s->sample_spec);
         return;
     }
@@ -1231,14 +1570,20 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
 
     n = fill_mix_info(s, &length, info, MAX_MIX_CHANNELS);
 
-    if (n == 0) {
+    replay = s->thread_info.mix_history.replaying;
+
+    if (n == 0 && !replay) {
+        mix_history_reset(s);
+
         if (target->length > length)
             target->length = length;
 
         pa_silence_memchunk(target, &s->sample_spec);
-    } else if (n == 1) {
+    } else if (n == 1 && !replay) {
         pa_cvolume volume;
 
+        mix_history_reset(s);
+
         if (target->length > length)
             target->length = length;
 
@@ -1251,29 +1596,30 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
             pa_cvolume target_vol;
 
             vchunk = info[0].chunk;
-            pa_memblock_ref(vchunk.memblock);
 
             if (vchunk.length > length)
                 vchunk.length = length;
 
+            /* Copy the data into the target first and apply the volume
+             * there, instead of making the input chunk writable, which
+             * would mean allocating a temporary block and copying
+             * twice. */
+            pa_memchunk_memcpy(target, &vchunk);
+
             if (!pa_cvolume_is_norm(&volume) || pa_cvolume_ramp_target_active(&s->thread_info.ramp) || pa_cvolume_ramp_active(&s->thread_info.ramp)) {
-                pa_memchunk_make_writable(&vchunk, 0);
                 if (pa_cvolume_ramp_active(&s->thread_info.ramp)) {
                     if (!pa_cvolume_is_norm(&volume))
-                        pa_volume_memchunk(&vchunk, &s->sample_spec, &volume);
-                    pa_volume_ramp_memchunk(&vchunk, &s->sample_spec, &(s->thread_info.ramp));
+                        pa_volume_memchunk(target, &s->sample_spec, &volume);
+                    pa_volume_ramp_memchunk(target, &s->sample_spec, &(s->thread_info.ramp));
                 }
                 else {
                     if (pa_cvolume_ramp_target_active(&s->thread_info.ramp)) {
                         pa_cvolume_ramp_get_targets(&s->thread_info.ramp, &target_vol);
                         pa_sw_cvolume_multiply(&volume, &volume, &target_vol);
                     }
-                    pa_volume_memchunk(&vchunk, &s->sample_spec, &volume);
+                    pa_volume_memchunk(target, &s->sample_spec, &volume);
                 }
             }
-
-            pa_memchunk_memcpy(target, &vchunk);
-            pa_memblock_unref(vchunk.memblock);
         }
 
     } else {
@@ -1282,11 +1628,7 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
 
         ptr = pa_memblock_acquire(target->memblock);
 
-        target->length = pa_mix(info, n,
-                                (uint8_t*) ptr + target->index, length,
-                                &s->sample_spec,
-                                &s->thread_info.soft_volume,
-                                s->thread_info.soft_muted);
+        target->length = sink_mix(s, info, n, (uint8_t*) ptr + target->index, length);
 
         if (pa_cvolume_ramp_target_active(&s->thread_info.ramp) || pa_cvolume_ramp_active(&s->thread_info.ramp)) {
             if (pa_cvolume_ramp_active(&s->thread_info.ramp))
@@ -1306,10 +1648,28 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
 }
 
 /* Called from IO thread context */
-void pa_sink_render_into_full(pa_sink *s, pa_memchunk *target) {
+static void render_into_full(pa_sink *s, pa_memchunk *target) {
     pa_memchunk chunk;
     size_t l, d;
 
+    l = target->length;
+    d = 0;
+    while (l > 0) {
+        chunk = *target;
+        chunk.index += d;
+        chunk.length -= d;
+
+        pa_sink_render_into(s, &chunk);
+
+        d += chunk.length;
+        l -= chunk.length;
+    }
+}
+
+/* Called from IO thread context */
+void pa_sink_render_into_full(pa_sink *s, pa_memchunk *target) {
+    pa_usec_t t;
+
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
     pa_assert(PA_SINK_IS_LINKED(s->thread_info.state));
@@ -1328,24 +1688,80 @@ void pa_sink_render_into_full(pa_sink *s, pa_memchunk *target) {
 
     pa_sink_ref(s);
 
-    l = target->length;
-    d = 0;
-    while (l > 0) {
-        chunk = *target;
-        chunk.index += d;
-        chunk.length -= d;
+    t = pa_rtclock_now();
+    render_into_full(s, target);
+    t = pa_rtclock_now() - t;
+    pa_histogram_add(&s->thread_info.render_time, t);
+    pa_atomic_add(&s->thread_info.stats.busy_usec, (int) t);
 
-        pa_sink_render_into(s, &chunk);
+    pa_sink_unref(s);
+}
 
-        d += chunk.length;
-        l -= chunk.length;
+/* Called from IO thread context */
+size_t pa_sink_skip(pa_sink *s, size_t length) {
+    pa_mix_info info[MAX_MIX_CHANNELS];
+    pa_memchunk chunk;
+    unsigned n;
+    size_t block_size_max;
+
+    pa_sink_assert_ref(s);
+    pa_sink_assert_io_context(s);
+    pa_assert(PA_SINK_IS_LINKED(s->thread_info.state));
+    pa_assert(pa_frame_aligned(length, &s->sample_spec));
+
+    pa_assert(!s->thread_info.rewind_requested);
+    pa_assert(s->thread_info.rewind_nbytes == 0);
+
+    /* If anyone records from the monitor, it has to get the real mix */
+    if (s->monitor_source &&
+        PA_SOURCE_IS_LINKED(s->monitor_source->thread_info.state) &&
+        pa_hashmap_size(s->monitor_source->thread_info.outputs) > 0) {
+
+        pa_sink_render(s, length, &chunk);
+        pa_memblock_unref(chunk.memblock);
+        return chunk.length;
+    }
+
+    if (s->thread_info.state == PA_SINK_SUSPENDED) {
+        mix_history_reset(s);
+        return PA_MIN(s->silence.length, length);
     }
 
+    pa_sink_ref(s);
+
+    if (length <= 0)
+        length = pa_frame_align(MIX_BUFFER_LENGTH, &s->sample_spec);
+
+    block_size_max = pa_mempool_block_size_max(s->core->mempool);
+    if (length > block_size_max)
+        length = pa_frame_align(block_size_max, &s->sample_spec);
+
+    pa_assert(length > 0);
+
+    /* The streams are still read, so that they advance as if they were
+     * played, but nothing is mixed. What follows after this isn't
+     * continuous with the history anymore. */
+    n = fill_mix_info(s, &length, info, MAX_MIX_CHANNELS);
+    mix_history_reset(s);
+
+    chunk = s->silence;
+    pa_memblock_ref(chunk.memblock);
+
+    if (chunk.length > length)
+        chunk.length = length;
+
+    inputs_drop(s, info, n, &chunk);
+    pa_memblock_unref(chunk.memblock);
+
     pa_sink_unref(s);
+
+    return chunk.length;
 }
 
 /* Called from IO thread context */
 void pa_sink_render_full(pa_sink *s, size_t length, pa_memchunk *result) {
+    pa_usec_t t;
+
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
     pa_assert(PA_SINK_IS_LINKED(s->thread_info.state));
@@ -1358,6 +1774,8 @@ void pa_sink_render_full(pa_sink *s, size_t length, pa_memchunk *result) {
 
     pa_sink_ref(s);
 
+    t = pa_rtclock_now();
+
     pa_sink_render(s, length, result);
 
     if (result->length < length) {
@@ -1369,11 +1787,15 @@ void pa_sink_render_full(pa_sink *s, size_t length, pa_memchunk *result) {
         chunk.index = result->index + result->length;
         chunk.length = length - result->length;
 
-        pa_sink_render_into_full(s, &chunk);
+        render_into_full(s, &chunk);
 
         result->length = length;
     }
 
+    t = pa_rtclock_now() - t;
+    pa_histogram_add(&s->thread_info.render_time, t);
+    pa_atomic_add(&s->thread_info.stats.busy_usec, (int) t);
+
     pa_sink_unref(s);
 }
 
@@ -1464,6 +1886,32 @@ pa_usec_t pa_sink_get_latency(pa_sink *s) {
 
     /* The returned value is supposed to be in the time domain of the sound card! */
 
+    if (s->state == PA_SINK_SUSPENDED)
+        return 0;
+
+    if (!(s->flags & PA_SINK_LATENCY))
+        return 0;
+
+    /* Implementations that publish their latency spare us the round
+     * trip to the IO thread */
+    if (pa_latency_snapshot_get(&s->latency_snapshot, pa_rtclock_now(), TRUE, &usec))
+        return usec;
+
+    pa_assert_se(pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), PA_SINK_MESSAGE_GET_LATENCY, &usec, 0, NULL) == 0);
+
+    return usec;
+}
+
+/* Called from main thread */
+pa_usec_t pa_sink_get_latency_sync(pa_sink *s) {
+    pa_usec_t usec = 0;
+
+    pa_sink_assert_ref(s);
+    pa_assert_ctl_context();
+    pa_assert(PA_SINK_IS_LINKED(s->state));
+
+    /* The returned value is supposed to be in the time domain of the sound card! */
+
     if (s->state == PA_SINK_SUSPENDED)
         return 0;
 
@@ -1502,6 +1950,22 @@ pa_usec_t pa_sink_get_latency_within_thread(pa_sink *s) {
     return usec;
 }
 
+/* Called from IO thread */
+void pa_sink_publish_latency_within_thread(pa_sink *s) {
+    pa_usec_t usec;
+
+    pa_sink_assert_ref(s);
+    pa_sink_assert_io_context(s);
+
+    if (!PA_SINK_IS_OPENED(s->thread_info.state) || !(s->flags & PA_SINK_LATENCY))
+        return;
+
+    if ((usec = pa_sink_get_latency_within_thread(s)) == (pa_usec_t) -1)
+        return;
+
+    pa_latency_snapshot_publish(&s->latency_snapshot, usec, pa_rtclock_now());
+}
+
 /* Called from the main thread (and also from the IO thread while the main
  * thread is waiting).
  *
@@ -2049,6 +2513,35 @@ void pa_sink_set_volume(
         pa_assert_se(pa_asyncmsgq_send(root_sink->asyncmsgq, PA_MSGOBJECT(root_sink), PA_SINK_MESSAGE_SET_SHARED_VOLUME, NULL, 0, NULL) == 0);
 }
 
+/* Called from main thread */
+void pa_sink_begin_volume_batch(pa_sink *s) {
+    pa_sink_assert_ref(s);
+    pa_assert_ctl_context();
+    pa_assert(PA_SINK_IS_LINKED(s->state));
+
+    s->volume_batch++;
+}
+
+/* Called from main thread */
+void pa_sink_end_volume_batch(pa_sink *s) {
+    pa_sink_assert_ref(s);
+    pa_assert_ctl_context();
+    pa_assert(s->volume_batch > 0);
+
+    if (--s->volume_batch > 0)
+        return;
+
+    if (PA_SINK_IS_LINKED(s->state)) {
+        if (s->volume_batch_flat)
+            /* This syncs the inputs as well */
+            pa_sink_set_volume(s, NULL, TRUE, s->volume_batch_save);
+        else if (s->volume_batch_sync)
+            pa_assert_se(pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), PA_SINK_MESSAGE_SYNC_VOLUMES, NULL, 0, NULL) == 0);
+    }
+
+    s->volume_batch_sync = s->volume_batch_flat = s->volume_batch_save = FALSE;
+}
+
 /* Called from main thread */
 void pa_sink_set_volume_ramp(
         pa_sink *s,
@@ -2416,13 +2909,8 @@ static void sync_input_volumes_within_thread(pa_sink *s) {
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
 
-    PA_HASHMAP_FOREACH(i, s->thread_info.inputs, state) {
-        if (pa_cvolume_equal(&i->thread_info.soft_volume, &i->soft_volume))
-            continue;
-
-        i->thread_info.soft_volume = i->soft_volume;
-        pa_sink_input_request_rewind(i, 0, TRUE, FALSE, FALSE);
-    }
+    PA_HASHMAP_FOREACH(i, s->thread_info.inputs, state)
+        pa_sink_input_sync_volume_within_thread(i);
 }
 
 /* Called from the IO thread. Only called for the root sink in volume sharing
@@ -2570,53 +3058,31 @@ int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offse
 
                 /* The old sink probably has some audio from this
                  * stream in its buffer. We want to "take it back" as
-                 * much as possible and play it to the new sink. We
-                 * don't know at this point how much the old sink can
-                 * rewind. We have to pick something, and that
-                 * something is the full latency of the old sink here.
-                 * So we rewind the stream buffer by the sink latency
-                 * amount, which may be more than what we should
-                 * rewind. This can result in a chunk of audio being
-                 * played both to the old sink and the new sink.
-                 *
-                 * FIXME: Fix this code so that we don't have to make
-                 * guesses about how much the sink will actually be
-                 * able to rewind. If someone comes up with a solution
-                 * for this, something to note is that the part of the
-                 * latency that the old sink couldn't rewind should
-                 * ideally be compensated after the stream has moved
-                 * to the new sink by adding silence. The new sink
-                 * most likely can't start playing the moved stream
-                 * immediately, and that gap should be removed from
-                 * the "compensation silence" (at least at the time of
-                 * writing this, the move finish code will actually
-                 * already take care of dropping the new sink's
-                 * unrewindable latency, so taking into account the
-                 * unrewindable latency of the old sink is the only
-                 * problem).
+                 * much as possible and play it to the new sink. The
+                 * rewind requested below can't take back more than
+                 * max_rewind, and what is beyond that is going to be
+                 * played by the old sink anyway, so we take back
+                 * only as much as that. The sink may still be able to
+                 * rewind somewhat less than this, in which case a bit
+                 * of audio is played both to the old and the new sink.
                  *
-                 * The render_memblockq contents are discarded,
-                 * because when the sink changes, the format of the
-                 * audio stored in the render_memblockq may change
-                 * too, making the stored audio invalid. FIXME:
-                 * However, the read and write indices are moved back
-                 * the same amount, so if they are not the same now,
-                 * they won't be the same after the rewind either. If
-                 * the write index of the render_memblockq is ahead of
-                 * the read index, then the render_memblockq will feed
-                 * the new sink some silence first, which it shouldn't
-                 * do. The write index should be flushed to be the
-                 * same as the read index. */
+                 * The render_memblockq keeps max_rewind of history,
+                 * so the audio comes back from there, together with
+                 * what was rendered but not yet read by the sink. If
+                 * the new sink takes the same format, it is played
+                 * from there, with the resampler state intact. If
+                 * not, the render_memblockq is replaced when the move
+                 * is finished, and the same amount is asked from the
+                 * implementor again then. */
 
                 /* Get the latency of the sink */
                 usec = pa_sink_get_latency_within_thread(s);
-                sink_nbytes = pa_usec_to_bytes(usec, &s->sample_spec);
+                sink_nbytes = PA_MIN(pa_usec_to_bytes(usec, &s->sample_spec), s->thread_info.max_rewind);
                 total_nbytes = sink_nbytes + pa_memblockq_get_length(i->thread_info.render_memblockq);
 
                 if (total_nbytes > 0) {
-                    i->thread_info.rewrite_nbytes = i->thread_info.resampler ? pa_resampler_request(i->thread_info.resampler, total_nbytes) : total_nbytes;
-                    i->thread_info.rewrite_flush = TRUE;
-                    pa_sink_input_process_rewind(i, sink_nbytes);
+                    i->thread_info.move_rewrite_nbytes = i->thread_info.resampler ? pa_resampler_request(i->thread_info.resampler, total_nbytes) : total_nbytes;
+                    pa_memblockq_rewind(i->thread_info.render_memblockq, sink_nbytes);
                 }
             }
 
@@ -2657,6 +3123,17 @@ int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offse
             if (i->attach)
                 i->attach(i);
 
+            /* The format changed, so what was rendered for the old
+             * sink was dropped and has to be rendered again */
+            if (i->thread_info.move_rewrite_nbytes > 0) {
+                pa_log_debug("Have to rewind %lu bytes on implementor after move.", (unsigned long) i->thread_info.move_rewrite_nbytes);
+
+                if (i->process_rewind)
+                    i->process_rewind(i, i->thread_info.move_rewrite_nbytes);
+
+                i->thread_info.move_rewrite_nbytes = 0;
+            }
+
             if (i->thread_info.state != PA_SINK_INPUT_CORKED) {
                 pa_usec_t usec = 0;
                 size_t nbytes;
@@ -2782,6 +3259,10 @@ int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offse
 
             s->thread_info.state = PA_PTR_TO_UINT(userdata);
 
+            /* Whatever was published before is void now, until the
+             * implementation publishes again */
+            pa_latency_snapshot_invalidate(&s->latency_snapshot);
+
             if (s->thread_info.state == PA_SINK_SUSPENDED) {
                 s->thread_info.rewind_nbytes = 0;
                 s->thread_info.rewind_requested = FALSE;
@@ -2974,7 +3455,7 @@ void pa_sink_attach_within_thread(pa_sink *s) {
 }
 
 /* Called from IO thread */
-void pa_sink_request_rewind(pa_sink*s, size_t nbytes) {
+static void request_rewind(pa_sink *s, size_t nbytes, pa_bool_t remix) {
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
     pa_assert(PA_SINK_IS_LINKED(s->thread_info.state));
@@ -2982,6 +3463,11 @@ void pa_sink_request_rewind(pa_sink*s, size_t nbytes) {
     if (s->thread_info.state == PA_SINK_SUSPENDED)
         return;
 
+    /* The rewind may be served from the mix history only if nothing
+     * else asked for it in this cycle */
+    s->thread_info.mix_history.remix = remix &&
+        (!s->thread_info.rewind_requested || s->thread_info.mix_history.remix);
+
     if (nbytes == (size_t) -1)
         nbytes = s->thread_info.max_rewind;
 
@@ -2998,6 +3484,16 @@ void pa_sink_request_rewind(pa_sink*s, size_t nbytes) {
         s->request_rewind(s);
 }
 
+/* Called from IO thread */
+void pa_sink_request_rewind(pa_sink*s, size_t nbytes) {
+    request_rewind(s, nbytes, FALSE);
+}
+
+/* Called from IO thread */
+void pa_sink_request_remix(pa_sink *s) {
+    request_rewind(s, (size_t) -1, TRUE);
+}
+
 /* Called from IO thread */
 pa_usec_t pa_sink_get_requested_latency_within_thread(pa_sink *s) {
     pa_usec_t result = (pa_usec_t) -1;
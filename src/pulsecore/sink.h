@@ -35,6 +35,10 @@ typedef struct pa_sink_volume_change pa_sink_volume_change;
 #include <pulse/volume.h>
 
 #include <pulsecore/core.h>
+#include <pulsecore/histogram.h>
+#include <pulsecore/level-meter.h>
+#include <pulsecore/io-stats.h>
+#include <pulsecore/latency-snapshot.h>
 #include <pulsecore/idxset.h>
 #include <pulsecore/memchunk.h>
 #include <pulsecore/source.h>
@@ -105,6 +109,13 @@ struct pa_sink {
     pa_cvolume saved_volume;
     pa_bool_t saved_save_volume:1;
 
+    /* While pa_sink_begin_volume_batch() is in effect, what the sink
+     * inputs' volume and mute changes left to do at the end */
+    unsigned volume_batch;
+    pa_bool_t volume_batch_sync:1;
+    pa_bool_t volume_batch_flat:1;
+    pa_bool_t volume_batch_save:1;
+
     /* for volume ramps */
     pa_cvolume_ramp_int ramp;
 
@@ -232,6 +243,10 @@ struct pa_sink {
      * main thread. */
     pa_bool_t (*update_rate)(pa_sink *s, uint32_t rate);
 
+    /* Published by the IO thread, see
+     * pa_sink_publish_latency_within_thread() */
+    pa_latency_snapshot latency_snapshot;
+
     /* Contains copies of the above data so that the real-time worker
      * thread can work without access locking */
     struct {
@@ -287,6 +302,34 @@ struct pa_sink {
         int32_t volume_change_extra_delay;
 
         pa_cvolume_ramp_int ramp;
+
+        /* The unclipped float mix of up to max_rewind bytes, kept
+         * while mixing in float. Positions are in frames. After a
+         * rewind that was only requested for stream volume changes,
+         * the mix is patched for the streams that changed instead of
+         * being done again, until pos catches up with end. */
+        struct {
+            float *data;
+            size_t n_frames;
+            int64_t start, end, pos;
+            pa_cvolume volume;
+            pa_bool_t remix:1;
+            pa_bool_t replaying:1;
+        } mix_history;
+
+        /* Where streams are converted to float for mixing in float,
+         * one after another. Grown as needed, in samples. */
+        float *mix_scratch;
+        size_t mix_scratch_samples;
+
+        /* Time spent in pa_sink_render_full() and
+         * pa_sink_render_into_full() */
+        pa_histogram render_time;
+
+        /* Level of the mixed data */
+        pa_level_meter level;
+
+        pa_io_stats stats;
     } thread_info;
 
     void *userdata;
@@ -412,6 +455,9 @@ pa_bool_t pa_sink_update_rate(pa_sink *s, uint32_t rate, pa_bool_t passthrough);
 
 /* The returned value is supposed to be in the time domain of the sound card! */
 pa_usec_t pa_sink_get_latency(pa_sink *s);
+/* Like pa_sink_get_latency(), but always asks the IO thread
+ * instead of using a published snapshot */
+pa_usec_t pa_sink_get_latency_sync(pa_sink *s);
 pa_usec_t pa_sink_get_requested_latency(pa_sink *s);
 void pa_sink_get_latency_range(pa_sink *s, pa_usec_t *min_latency, pa_usec_t *max_latency);
 pa_usec_t pa_sink_get_fixed_latency(pa_sink *s);
@@ -444,6 +490,11 @@ pa_bool_t pa_sink_get_mute(pa_sink *sink, pa_bool_t force_refresh);
 
 void pa_sink_set_volume_ramp(pa_sink *s, const pa_cvolume_ramp *ramp, pa_bool_t send_msg, pa_bool_t save);
 
+/* Volume and mute changes of the sink inputs between these two are
+ * passed to the IO thread in one message at the end. May be nested. */
+void pa_sink_begin_volume_batch(pa_sink *s);
+void pa_sink_end_volume_batch(pa_sink *s);
+
 pa_bool_t pa_sink_update_proplist(pa_sink *s, pa_update_mode_t mode, pa_proplist *p);
 
 int pa_sink_set_port(pa_sink *s, const char *name, pa_bool_t save);
@@ -471,6 +522,11 @@ void pa_sink_render_full(pa_sink *s, size_t length, pa_memchunk *result);
 void pa_sink_render_into(pa_sink*s, pa_memchunk *target);
 void pa_sink_render_into_full(pa_sink *s, pa_memchunk *target);
 
+/* Like pa_sink_render() followed by throwing the result away, but
+ * doesn't mix unless something records from the monitor source.
+ * Returns how many bytes the streams were advanced by. */
+size_t pa_sink_skip(pa_sink *s, size_t length);
+
 void pa_sink_process_rewind(pa_sink *s, size_t nbytes);
 
 int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offset, pa_memchunk *chunk);
@@ -494,10 +550,19 @@ pa_bool_t pa_sink_volume_change_apply(pa_sink *s, pa_usec_t *usec_to_next);
 
 void pa_sink_request_rewind(pa_sink*s, size_t nbytes);
 
+/* Like pa_sink_request_rewind() for all of max_rewind, for when only the
+ * volume the sink mixes a stream with changed */
+void pa_sink_request_remix(pa_sink *s);
+
 void pa_sink_invalidate_requested_latency(pa_sink *s, pa_bool_t dynamic);
 
 pa_usec_t pa_sink_get_latency_within_thread(pa_sink *s);
 
+/* May be called by implementors whenever they have rendered data,
+ * to let pa_sink_get_latency() answer without a round trip to the
+ * IO thread */
+void pa_sink_publish_latency_within_thread(pa_sink *s);
+
 /* Verify that we called in IO context (aka 'thread context), or that
  * the sink is not yet set up, i.e. the thread not set up yet. See
  * pa_assert_io_context() in thread-mq.h for more information. */
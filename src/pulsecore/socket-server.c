@@ -66,6 +66,7 @@ int deny_severity = LOG_WARNING;
 #include <pulsecore/macro.h>
 #include <pulsecore/core-error.h>
 #include <pulsecore/refcnt.h>
+#include <pulsecore/llist.h>
 #include <pulsecore/arpa-inet.h>
 
 #include "socket-server.h"
@@ -75,6 +76,7 @@ struct pa_socket_server {
     int fd;
     char *filename;
     char *tcpwrap_service;
+    pa_bool_t activated;
 
     pa_socket_server_on_connection_cb_t on_connection;
     void *userdata;
@@ -87,8 +89,14 @@ struct pa_socket_server {
         SOCKET_SERVER_UNIX,
         SOCKET_SERVER_IPV6
     } type;
+
+    PA_LLIST_FIELDS(pa_socket_server);
 };
 
+/* All UNIX socket servers of this process, so that their sockets can
+ * be handed over to a restarted daemon */
+static PA_LLIST_HEAD(pa_socket_server, unix_servers) = NULL;
+
 static void callback(pa_mainloop_api *mainloop, pa_io_event *e, int fd, pa_io_event_flags_t f, void *userdata) {
     pa_socket_server *s = userdata;
     pa_iochannel *io;
@@ -211,6 +219,7 @@ pa_socket_server* pa_socket_server_new_unix(pa_mainloop_api *m, const char *file
 
     s->filename = pa_xstrdup(filename);
     s->type = SOCKET_SERVER_UNIX;
+    PA_LLIST_PREPEND(pa_socket_server, unix_servers, s);
 
     return s;
 
@@ -221,12 +230,55 @@ fail:
     return NULL;
 }
 
+pa_socket_server* pa_socket_server_new_unix_activated(pa_mainloop_api *m, int fd, const char *filename) {
+    pa_socket_server *s;
+
+    pa_assert(m);
+    pa_assert(fd >= 0);
+    pa_assert(filename);
+
+    pa_make_fd_cloexec(fd);
+    pa_make_socket_low_delay(fd);
+
+    pa_assert_se(s = pa_socket_server_new(m, fd));
+
+    s->filename = pa_xstrdup(filename);
+    s->type = SOCKET_SERVER_UNIX;
+    s->activated = TRUE;
+    PA_LLIST_PREPEND(pa_socket_server, unix_servers, s);
+
+    return s;
+}
+
+unsigned pa_socket_server_keep_unix(int *fds, unsigned n) {
+    pa_socket_server *s;
+    unsigned i = 0;
+
+    pa_assert(fds || n == 0);
+
+    for (s = unix_servers; s && i < n; s = s->next) {
+        /* From now on it isn't ours to close or remove anymore */
+        s->activated = TRUE;
+        fds[i++] = s->fd;
+    }
+
+    return i;
+}
+
 #else /* HAVE_SYS_UN_H */
 
 pa_socket_server* pa_socket_server_new_unix(pa_mainloop_api *m, const char *filename) {
     return NULL;
 }
 
+pa_socket_server* pa_socket_server_new_unix_activated(pa_mainloop_api *m, int fd, const char *filename) {
+    return NULL;
+}
+
+unsigned pa_socket_server_keep_unix(int *fds, unsigned n) {
+    return 0;
+}
+
 #endif /* HAVE_SYS_UN_H */
 
 pa_socket_server* pa_socket_server_new_ipv4(pa_mainloop_api *m, uint32_t address, uint16_t port, pa_bool_t fallback, const char *tcpwrap_service) {
@@ -423,12 +475,19 @@ pa_socket_server* pa_socket_server_new_ipv6_string(pa_mainloop_api *m, const cha
 static void socket_server_free(pa_socket_server*s) {
     pa_assert(s);
 
+    if (s->type == SOCKET_SERVER_UNIX)
+        PA_LLIST_REMOVE(pa_socket_server, unix_servers, s);
+
+    /* An activated socket belongs to the service manager. Leave it in
+     * place, so that it can be picked up again if we are reloaded. */
     if (s->filename) {
-        unlink(s->filename);
+        if (!s->activated)
+            unlink(s->filename);
         pa_xfree(s->filename);
     }
 
-    pa_close(s->fd);
+    if (!s->activated)
+        pa_close(s->fd);
 
     pa_xfree(s->tcpwrap_service);
 
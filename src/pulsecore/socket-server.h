@@ -33,6 +33,16 @@ typedef struct pa_socket_server pa_socket_server;
 
 pa_socket_server* pa_socket_server_new(pa_mainloop_api *m, int fd);
 pa_socket_server* pa_socket_server_new_unix(pa_mainloop_api *m, const char *filename);
+/* Adopts fd, a socket already listening on filename that was passed
+ * in by the service manager. Neither is removed when freeing. */
+pa_socket_server* pa_socket_server_new_unix_activated(pa_mainloop_api *m, int fd, const char *filename);
+
+/* Stores the listening sockets of up to n UNIX socket servers in fds
+ * and returns how many there are. From then on the servers leave the
+ * sockets open and their files in place when they are freed, as if
+ * they were activated ones, so that a new daemon can take them over
+ * without clients ever being refused. */
+unsigned pa_socket_server_keep_unix(int *fds, unsigned n);
 pa_socket_server* pa_socket_server_new_ipv4(pa_mainloop_api *m, uint32_t address, uint16_t port, pa_bool_t fallback, const char *tcpwrap_service);
 pa_socket_server* pa_socket_server_new_ipv4_loopback(pa_mainloop_api *m, uint16_t port, pa_bool_t fallback, const char *tcpwrap_service);
 pa_socket_server* pa_socket_server_new_ipv4_any(pa_mainloop_api *m, uint16_t port, pa_bool_t fallback, const char *tcpwrap_service);
@@ -0,0 +1,316 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-error.h>
+#include <pulsecore/core-scache.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/idxset.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/tagstruct.h>
+#include <pulsecore/thread.h>
+
+#include "sound-file.h"
+#include "sound-file-cache.h"
+
+/* A cache file starts with this header, followed by a tagstruct with
+ * the name, size and modification time of the sound file it was made
+ * from, the sample spec, the channel map and the properties read from
+ * the file. The PCM data starts at the next page boundary. Everything
+ * is in host byte order, the directory is specific to the machine. */
+#define CACHE_MAGIC "PASCMAP1"
+
+struct cache_header {
+    char magic[8];
+    uint32_t info_size;
+    uint32_t reserved;
+    uint64_t data_offset;
+    uint64_t data_size;
+};
+
+struct pa_sound_file_mapping {
+    void *base;
+    size_t size;
+    pa_memblock *block;
+};
+
+static char *cache_path(const char *fname) {
+    char *dir, *path;
+
+    if (!(dir = pa_state_path("sample-cache", TRUE)))
+        return NULL;
+
+    if (pa_make_secure_dir(dir, 0700, (uid_t) -1, (gid_t) -1) < 0) {
+        pa_log_warn("Failed to create sample cache directory %s: %s", dir, pa_cstrerror(errno));
+        pa_xfree(dir);
+        return NULL;
+    }
+
+    /* Collisions are caught by the name in the file */
+    path = pa_sprintf_malloc("%s" PA_PATH_SEP "%08x.pcm", dir, pa_idxset_string_hash_func(fname));
+    pa_xfree(dir);
+
+    return path;
+}
+
+static pa_sound_file_mapping* map_file(
+        pa_mempool *pool,
+        const char *path,
+        const char *fname,
+        const struct stat *st,
+        pa_sample_spec *ss,
+        pa_channel_map *map,
+        pa_memchunk *chunk,
+        pa_proplist *p) {
+
+    pa_sound_file_mapping *m = NULL;
+    struct cache_header h;
+    struct stat cst;
+    pa_tagstruct *t = NULL;
+    pa_proplist *fp = NULL;
+    const char *name;
+    uint64_t size, mtime;
+    pa_sample_spec fss;
+    pa_channel_map fmap;
+    void *base = MAP_FAILED;
+    int fd;
+
+    if ((fd = pa_open_cloexec(path, O_RDONLY, 0)) < 0)
+        return NULL;
+
+    if (fstat(fd, &cst) < 0 || (size_t) cst.st_size < sizeof(h))
+        goto finish;
+
+    if ((base = mmap(NULL, (size_t) cst.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+        pa_log_warn("Failed to map %s: %s", path, pa_cstrerror(errno));
+        goto finish;
+    }
+
+    memcpy(&h, base, sizeof(h));
+
+    if (memcmp(h.magic, CACHE_MAGIC, sizeof(h.magic)) != 0 ||
+        h.info_size > (size_t) cst.st_size - sizeof(h) ||
+        h.data_offset < sizeof(h) + h.info_size ||
+        h.data_offset > (uint64_t) cst.st_size ||
+        h.data_size != (uint64_t) cst.st_size - h.data_offset ||
+        h.data_size == 0 ||
+        h.data_size > PA_SCACHE_ENTRY_SIZE_MAX)
+        goto finish;
+
+    fp = pa_proplist_new();
+    t = pa_tagstruct_new((const uint8_t*) base + sizeof(h), h.info_size);
+
+    if (pa_tagstruct_gets(t, &name) < 0 ||
+        pa_tagstruct_getu64(t, &size) < 0 ||
+        pa_tagstruct_getu64(t, &mtime) < 0 ||
+        pa_tagstruct_get_sample_spec(t, &fss) < 0 ||
+        pa_tagstruct_get_channel_map(t, &fmap) < 0 ||
+        pa_tagstruct_get_proplist(t, fp) < 0 ||
+        !pa_tagstruct_eof(t))
+        goto finish;
+
+    /* Made from another file or an older version of it */
+    if (!pa_streq(name, fname) ||
+        size != (uint64_t) st->st_size ||
+        mtime != (uint64_t) st->st_mtime)
+        goto finish;
+
+    if (!pa_sample_spec_valid(&fss) ||
+        !pa_channel_map_valid(&fmap) ||
+        !pa_channel_map_compatible(&fmap, &fss) ||
+        h.data_size % pa_frame_size(&fss) != 0)
+        goto finish;
+
+    m = pa_xnew(pa_sound_file_mapping, 1);
+    m->base = base;
+    m->size = (size_t) cst.st_size;
+    m->block = pa_memblock_new_fixed(pool, (uint8_t*) base + h.data_offset, (size_t) h.data_size, TRUE);
+    base = MAP_FAILED;
+
+    *ss = fss;
+    if (map)
+        *map = fmap;
+
+    if (p)
+        pa_proplist_update(p, PA_UPDATE_REPLACE, fp);
+
+    chunk->memblock = pa_memblock_ref(m->block);
+    chunk->index = 0;
+    chunk->length = (size_t) h.data_size;
+
+finish:
+    if (t)
+        pa_tagstruct_free(t);
+
+    if (fp)
+        pa_proplist_free(fp);
+
+    if (base != MAP_FAILED)
+        munmap(base, (size_t) cst.st_size);
+
+    pa_close(fd);
+
+    return m;
+}
+
+static void write_file(
+        const char *path,
+        const char *fname,
+        const struct stat *st,
+        const pa_sample_spec *ss,
+        const pa_channel_map *map,
+        const pa_memchunk *chunk,
+        pa_proplist *fp) {
+
+    struct cache_header h;
+    pa_tagstruct *t;
+    const uint8_t *info;
+    size_t info_size;
+    uint8_t *head;
+    char *tmp;
+    void *data;
+    pa_bool_t ok;
+    int fd;
+
+    t = pa_tagstruct_new(NULL, 0);
+    pa_tagstruct_puts(t, fname);
+    pa_tagstruct_putu64(t, (uint64_t) st->st_size);
+    pa_tagstruct_putu64(t, (uint64_t) st->st_mtime);
+    pa_tagstruct_put_sample_spec(t, ss);
+    pa_tagstruct_put_channel_map(t, map);
+    pa_tagstruct_put_proplist(t, fp);
+
+    pa_zero(h);
+    memcpy(h.magic, CACHE_MAGIC, sizeof(h.magic));
+    info = pa_tagstruct_data(t, &info_size);
+    h.info_size = (uint32_t) info_size;
+    h.data_offset = PA_PAGE_ALIGN(sizeof(h) + info_size);
+    h.data_size = chunk->length;
+
+    head = pa_xmalloc0((size_t) h.data_offset);
+    memcpy(head, &h, sizeof(h));
+    memcpy(head + sizeof(h), info, info_size);
+    pa_tagstruct_free(t);
+
+    /* Files may be loaded by more than one thread */
+    tmp = pa_sprintf_malloc("%s.%p.tmp", path, (void*) pa_thread_self());
+
+    if ((fd = pa_open_cloexec(tmp, O_WRONLY|O_CREAT|O_TRUNC, 0600)) < 0) {
+        pa_log_warn("Failed to open %s: %s", tmp, pa_cstrerror(errno));
+        goto finish;
+    }
+
+    data = pa_memblock_acquire(chunk->memblock);
+    ok = pa_loop_write(fd, head, (size_t) h.data_offset, NULL) == (ssize_t) h.data_offset &&
+        pa_loop_write(fd, (uint8_t*) data + chunk->index, chunk->length, NULL) == (ssize_t) chunk->length;
+    pa_memblock_release(chunk->memblock);
+
+    if (!ok) {
+        pa_log_warn("Failed to write %s: %s", tmp, pa_cstrerror(errno));
+        pa_close(fd);
+        unlink(tmp);
+        goto finish;
+    }
+
+    if (pa_close(fd) < 0 || rename(tmp, path) < 0) {
+        pa_log_warn("Failed to replace %s: %s", path, pa_cstrerror(errno));
+        unlink(tmp);
+        goto finish;
+    }
+
+    pa_log_debug("Added %s to the sample cache as %s.", fname, path);
+
+finish:
+    pa_xfree(tmp);
+    pa_xfree(head);
+}
+
+int pa_sound_file_load_cached(
+        pa_mempool *pool,
+        const char *fname,
+        pa_sample_spec *ss,
+        pa_channel_map *map,
+        pa_memchunk *chunk,
+        pa_proplist *p,
+        pa_sound_file_mapping **mapping) {
+
+    struct stat st;
+    char *path;
+    pa_proplist *fp;
+    pa_channel_map fmap;
+    int r;
+
+    pa_assert(pool);
+    pa_assert(fname);
+    pa_assert(ss);
+    pa_assert(chunk);
+    pa_assert(mapping);
+
+    *mapping = NULL;
+
+    if (stat(fname, &st) < 0 || !(path = cache_path(fname)))
+        return pa_sound_file_load(pool, fname, ss, map, chunk, p);
+
+    if ((*mapping = map_file(pool, path, fname, &st, ss, map, chunk, p))) {
+        pa_log_debug("Mapped %s from the sample cache.", fname);
+        pa_xfree(path);
+        return 0;
+    }
+
+    /* Only what was read from the file goes into the cache */
+    fp = pa_proplist_new();
+
+    if ((r = pa_sound_file_load(pool, fname, ss, &fmap, chunk, fp)) >= 0) {
+        if (chunk->length > 0)
+            write_file(path, fname, &st, ss, &fmap, chunk, fp);
+
+        if (map)
+            *map = fmap;
+
+        if (p)
+            pa_proplist_update(p, PA_UPDATE_REPLACE, fp);
+    }
+
+    pa_proplist_free(fp);
+    pa_xfree(path);
+
+    return r;
+}
+
+void pa_sound_file_mapping_free(pa_sound_file_mapping *m) {
+    pa_assert(m);
+
+    pa_memblock_unref_fixed(m->block);
+    munmap(m->base, m->size);
+    pa_xfree(m);
+}
@@ -0,0 +1,50 @@
+#ifndef foosoundfilecachehfoo
+#define foosoundfilecachehfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulse/sample.h>
+#include <pulse/channelmap.h>
+#include <pulse/proplist.h>
+#include <pulsecore/memchunk.h>
+
+/* Keeps the decoded PCM of sound files in the state directory, so that
+ * loading them again only needs to map the copy into memory */
+
+typedef struct pa_sound_file_mapping pa_sound_file_mapping;
+
+/* Like pa_sound_file_load(). If the file was loaded from the cache,
+ * chunk is a fixed block in a mapping returned in *mapping, which
+ * must be freed after the last reference to the block the caller
+ * holds is gone. Otherwise *mapping is set to NULL and the file is
+ * added to the cache. */
+int pa_sound_file_load_cached(
+        pa_mempool *pool,
+        const char *fname,
+        pa_sample_spec *ss,
+        pa_channel_map *map,
+        pa_memchunk *chunk,
+        pa_proplist *p,
+        pa_sound_file_mapping **mapping);
+
+/* Copies the data out of the block if it is still in use */
+void pa_sound_file_mapping_free(pa_sound_file_mapping *m);
+
+#endif
@@ -45,21 +45,35 @@
 
 #define MEMBLOCKQ_MAXLENGTH (16*1024*1024)
 
+/* How much decoded audio the IO thread is supposed to have queued. This
+ * needs to cover what a sink with a large buffer asks for at once. */
+#define READ_AHEAD_USEC (4*PA_USEC_PER_SEC)
+
 typedef struct file_stream {
     pa_msgobject parent;
     pa_core *core;
     pa_sink_input *sink_input;
 
+    /* Only accessed from main context, so that the IO thread never
+     * waits for the disk */
     SNDFILE *sndfile;
     sf_count_t (*readf_function)(SNDFILE *sndfile, void *ptr, sf_count_t frames);
 
     /* We need this memblockq here to easily fulfill rewind requests
      * (even beyond the file start!) */
     pa_memblockq *memblockq;
+
+    /* IO thread side of the read-ahead */
+    size_t read_ahead;
+    pa_bool_t requested:1;
+    pa_bool_t eof:1;
 } file_stream;
 
 enum {
-    FILE_STREAM_MESSAGE_UNLINK
+    FILE_STREAM_MESSAGE_UNLINK,   /* To the main thread */
+    FILE_STREAM_MESSAGE_REQUEST,  /* To the main thread */
+    FILE_STREAM_MESSAGE_DATA,     /* To the IO thread */
+    FILE_STREAM_MESSAGE_EOF       /* To the IO thread */
 };
 
 PA_DEFINE_PRIVATE_CLASS(file_stream, pa_msgobject);
@@ -94,7 +108,64 @@ static void file_stream_free(pa_object *o) {
     pa_xfree(u);
 }
 
-/* Called from main context */
+/* Called from main context. Reads the next block of the file, closes
+ * it at the end. */
+static int read_block(file_stream *u, pa_memchunk *chunk) {
+    size_t length, fs;
+    void *p;
+    sf_count_t n;
+
+    pa_assert(u);
+    pa_assert(chunk);
+
+    if (!u->sndfile)
+        return -1;
+
+    fs = pa_frame_size(&u->sink_input->sample_spec);
+    length = pa_frame_align(pa_mempool_block_size_max(u->core->mempool), &u->sink_input->sample_spec);
+
+    chunk->memblock = pa_memblock_new(u->core->mempool, length);
+    chunk->index = 0;
+
+    p = pa_memblock_acquire(chunk->memblock);
+
+    if (u->readf_function)
+        n = u->readf_function(u->sndfile, p, (sf_count_t) (length/fs));
+    else {
+        n = sf_read_raw(u->sndfile, p, (sf_count_t) length);
+        fs = 1;
+    }
+
+    pa_memblock_release(chunk->memblock);
+
+    if (n <= 0) {
+        pa_memblock_unref(chunk->memblock);
+
+        sf_close(u->sndfile);
+        u->sndfile = NULL;
+        return -1;
+    }
+
+    chunk->length = (size_t) n * fs;
+
+    return 0;
+}
+
+/* Called from IO thread context */
+static void request_data(file_stream *u) {
+    pa_assert(u);
+
+    if (u->requested || u->eof || !u->memblockq)
+        return;
+
+    if (pa_memblockq_get_length(u->memblockq) >= u->read_ahead)
+        return;
+
+    u->requested = TRUE;
+    pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(u), FILE_STREAM_MESSAGE_REQUEST, NULL, 0, NULL, NULL);
+}
+
+/* Called from main context, except DATA and EOF */
 static int file_stream_process_msg(pa_msgobject *o, int code, void*userdata, int64_t offset, pa_memchunk *chunk) {
     file_stream *u = FILE_STREAM(o);
     file_stream_assert_ref(u);
@@ -103,6 +174,38 @@ static int file_stream_process_msg(pa_msgobject *o, int code, void*userdata, int
         case FILE_STREAM_MESSAGE_UNLINK:
             file_stream_unlink(u);
             break;
+
+        case FILE_STREAM_MESSAGE_REQUEST: {
+            pa_memchunk tchunk;
+
+            if (!u->sink_input)
+                break;
+
+            if (read_block(u, &tchunk) < 0) {
+                pa_asyncmsgq_post(u->sink_input->sink->asyncmsgq, PA_MSGOBJECT(u), FILE_STREAM_MESSAGE_EOF, NULL, 0, NULL, NULL);
+                break;
+            }
+
+            pa_asyncmsgq_post(u->sink_input->sink->asyncmsgq, PA_MSGOBJECT(u), FILE_STREAM_MESSAGE_DATA, NULL, 0, &tchunk, NULL);
+            pa_memblock_unref(tchunk.memblock);
+            break;
+        }
+
+        case FILE_STREAM_MESSAGE_DATA:
+            pa_assert(chunk);
+
+            u->requested = FALSE;
+
+            if (u->memblockq) {
+                pa_memblockq_push_align(u->memblockq, chunk);
+                request_data(u);
+            }
+            break;
+
+        case FILE_STREAM_MESSAGE_EOF:
+            u->requested = FALSE;
+            u->eof = TRUE;
+            break;
     }
 
     return 0;
@@ -146,49 +249,18 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t length, pa_memchunk *chunk
     if (!u->memblockq)
         return -1;
 
-    for (;;) {
-        pa_memchunk tchunk;
-        size_t fs;
-        void *p;
-        sf_count_t n;
-
-        if (pa_memblockq_peek(u->memblockq, chunk) >= 0) {
-            chunk->length = PA_MIN(chunk->length, length);
-            pa_memblockq_drop(u->memblockq, chunk->length);
-            return 0;
-        }
-
-        if (!u->sndfile)
-            break;
-
-        tchunk.memblock = pa_memblock_new(i->sink->core->mempool, length);
-        tchunk.index = 0;
-
-        p = pa_memblock_acquire(tchunk.memblock);
-
-        if (u->readf_function) {
-            fs = pa_frame_size(&i->sample_spec);
-            n = u->readf_function(u->sndfile, p, (sf_count_t) (length/fs));
-        } else {
-            fs = 1;
-            n = sf_read_raw(u->sndfile, p, (sf_count_t) length);
-        }
-
-        pa_memblock_release(tchunk.memblock);
-
-        if (n <= 0) {
-            pa_memblock_unref(tchunk.memblock);
-
-            sf_close(u->sndfile);
-            u->sndfile = NULL;
-            break;
-        }
+    if (pa_memblockq_peek(u->memblockq, chunk) >= 0) {
+        chunk->length = PA_MIN(chunk->length, length);
+        pa_memblockq_drop(u->memblockq, chunk->length);
+        request_data(u);
+        return 0;
+    }
 
-        tchunk.length = (size_t) n * fs;
+    request_data(u);
 
-        pa_memblockq_push(u->memblockq, &tchunk);
-        pa_memblock_unref(tchunk.memblock);
-    }
+    /* The file is still being read, so this is an underrun */
+    if (!u->eof)
+        return -1;
 
     if (pa_sink_input_safe_to_remove(i)) {
         pa_memblockq_free(u->memblockq);
@@ -250,16 +322,17 @@ int pa_play_file(
     u->sndfile = NULL;
     u->readf_function = NULL;
     u->memblockq = NULL;
+    u->read_ahead = 0;
+    u->requested = FALSE;
+    u->eof = FALSE;
 
     if ((fd = pa_open_cloexec(fname, O_RDONLY, 0)) < 0) {
         pa_log("Failed to open file %s: %s", fname, pa_cstrerror(errno));
         goto fail;
     }
 
-    /* FIXME: For now we just use posix_fadvise to avoid page faults
-     * when accessing the file data. Eventually we should move the
-     * file reader into the main event loop and pass the data over the
-     * asyncmsgq. */
+    /* The file is read from the main loop, ahead of what the IO thread
+     * needs. Let the kernel know so that it can read ahead too. */
 
 #ifdef HAVE_POSIX_FADVISE
     if (posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL) < 0) {
@@ -323,6 +396,22 @@ int pa_play_file(
     u->memblockq = pa_memblockq_new("sound-file-stream memblockq", 0, MEMBLOCKQ_MAXLENGTH, 0, &ss, 1, 1, 0, &silence);
     pa_memblock_unref(silence.memblock);
 
+    /* Fill the queue before the IO thread gets to see it, so that we
+     * can start right away */
+    u->read_ahead = PA_MIN(pa_usec_to_bytes(READ_AHEAD_USEC, &ss), MEMBLOCKQ_MAXLENGTH / 2);
+
+    while (pa_memblockq_get_length(u->memblockq) < u->read_ahead) {
+        pa_memchunk tchunk;
+
+        if (read_block(u, &tchunk) < 0) {
+            u->eof = TRUE;
+            break;
+        }
+
+        pa_memblockq_push_align(u->memblockq, &tchunk);
+        pa_memblock_unref(tchunk.memblock);
+    }
+
     pa_sink_input_put(u->sink_input);
 
     /* The reference to u is dangling here, because we want to keep
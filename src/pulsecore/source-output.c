@@ -28,11 +28,13 @@
 #include <string.h>
 
 #include <pulse/utf8.h>
+#include <pulse/rtclock.h>
 #include <pulse/xmalloc.h>
 #include <pulse/util.h>
 #include <pulse/internal.h>
 
 #include <pulsecore/sample-util.h>
+#include <pulsecore/core-rtclock.h>
 #include <pulsecore/core-subscribe.h>
 #include <pulsecore/log.h>
 #include <pulsecore/namereg.h>
@@ -381,7 +383,7 @@ int pa_source_output_new(
 
         if (!pa_source_output_new_data_is_passthrough(data)) /* no resampler for passthrough content */
             if (!(resampler = pa_resampler_new(
-                        core->mempool,
+                        core->mempool, core->resampler_cache,
                         &data->source->sample_spec, &data->source->channel_map,
                         &data->sample_spec, &data->channel_map,
                         data->resample_method,
@@ -451,6 +453,8 @@ int pa_source_output_new(
     o->thread_info.requested_source_latency = (pa_usec_t) -1;
     o->thread_info.direct_on_input = o->direct_on_input;
 
+    pa_io_stats_init(&o->thread_info.stats);
+
     o->thread_info.delay_memblockq = pa_memblockq_new(
             "source output delay_memblockq",
             0,
@@ -462,6 +466,9 @@ int pa_source_output_new(
             0,
             &o->source->silence);
 
+    /* What is queued for the stream counts towards the client's budget */
+    pa_memblockq_set_mem_account(o->thread_info.delay_memblockq, o->client ? o->client->mem_account : o->core->mem_account);
+
     pa_assert_se(pa_idxset_put(core->source_outputs, o, &o->index) == 0);
     pa_assert_se(pa_idxset_put(o->source->outputs, pa_source_output_ref(o), NULL) == 0);
 
@@ -471,15 +478,17 @@ int pa_source_output_new(
     if (o->direct_on_input)
         pa_assert_se(pa_idxset_put(o->direct_on_input->direct_outputs, o, NULL) == 0);
 
-    pt = pa_proplist_to_string_sep(o->proplist, "\n    ");
-    pa_log_info("Created output %u \"%s\" on %s with sample spec %s and channel map %s\n    %s",
-                o->index,
-                pa_strnull(pa_proplist_gets(o->proplist, PA_PROP_MEDIA_NAME)),
-                o->source->name,
-                pa_sample_spec_snprint(st, sizeof(st), &o->sample_spec),
-                pa_channel_map_snprint(cm, sizeof(cm), &o->channel_map),
-                pt);
-    pa_xfree(pt);
+    if (pa_log_level_enabled(PA_LOG_INFO)) {
+        pt = pa_proplist_to_string_sep(o->proplist, "\n    ");
+        pa_log_info("Created output %u \"%s\" on %s with sample spec %s and channel map %s\n    %s",
+                    o->index,
+                    pa_strnull(pa_proplist_gets(o->proplist, PA_PROP_MEDIA_NAME)),
+                    o->source->name,
+                    pa_sample_spec_snprint(st, sizeof(st), &o->sample_spec),
+                    pa_channel_map_snprint(cm, sizeof(cm), &o->channel_map),
+                    pt);
+        pa_xfree(pt);
+    }
 
     /* Don't forget to call pa_source_output_put! */
 
@@ -715,6 +724,7 @@ void pa_source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
 
     if (pa_memblockq_push(o->thread_info.delay_memblockq, chunk) < 0) {
         pa_log_debug("Delay queue overflow!");
+        pa_atomic_inc(&o->thread_info.stats.overruns);
         pa_memblockq_seek(o->thread_info.delay_memblockq, (int64_t) chunk->length, PA_SEEK_RELATIVE, TRUE);
     }
 
@@ -746,6 +756,7 @@ void pa_source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
     while ((length = pa_memblockq_get_length(o->thread_info.delay_memblockq)) > limit) {
         pa_memchunk qchunk;
         pa_bool_t nvfs = need_volume_factor_source;
+        pa_usec_t t, cpu;
 
         length -= limit;
 
@@ -758,9 +769,14 @@ void pa_source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
 
         /* It might be necessary to adjust the volume here */
         if (!volume_is_norm) {
-            pa_memchunk_make_writable(&qchunk, 0);
+            pa_volume_share *share = &o->source->thread_info.volume_share;
+
+            /* The delay queues of all outputs hold the very same
+             * chunks, so outputs with the same volume can share the
+             * result */
 
             if (o->thread_info.muted) {
+                pa_memchunk_make_writable(&qchunk, 0);
                 pa_silence_memchunk(&qchunk, &o->source->sample_spec);
                 nvfs = FALSE;
 
@@ -771,11 +787,11 @@ void pa_source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
                  * post and the pre volume adjustment into one */
 
                 pa_sw_cvolume_multiply(&v, &o->thread_info.soft_volume, &o->volume_factor_source);
-                pa_volume_memchunk(&qchunk, &o->source->sample_spec, &v);
+                pa_volume_memchunk_shared(share, &qchunk, &o->source->sample_spec, &v);
                 nvfs = FALSE;
 
             } else
-                pa_volume_memchunk(&qchunk, &o->source->sample_spec, &o->thread_info.soft_volume);
+                pa_volume_memchunk_shared(share, &qchunk, &o->source->sample_spec, &o->thread_info.soft_volume);
         }
 
         if (!o->thread_info.resampler) {
@@ -784,7 +800,13 @@ void pa_source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
                 pa_volume_memchunk(&qchunk, &o->thread_info.sample_spec, &o->volume_factor_source);
             }
 
+            t = pa_rtclock_now();
+            cpu = o->destination_source ? pa_rtclock_thread_cpu() : 0;
             o->push(o, &qchunk);
+            pa_atomic_add(&o->thread_info.stats.busy_usec, (int) (pa_rtclock_now() - t));
+
+            if (cpu > 0)
+                pa_atomic_add(&o->thread_info.stats.cpu_usec, (int) (pa_rtclock_thread_cpu() - cpu));
         } else {
             pa_memchunk rchunk;
 
@@ -794,7 +816,9 @@ void pa_source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
             if (qchunk.length > mbs)
                 qchunk.length = mbs;
 
-            pa_resampler_run(o->thread_info.resampler, &qchunk, &rchunk);
+            t = pa_rtclock_now();
+            pa_resampler_run_shared(o->thread_info.resampler, o->source->thread_info.peaks_share, &qchunk, &rchunk);
+            pa_atomic_add(&o->thread_info.stats.resample_usec, (int) (pa_rtclock_now() - t));
 
             if (rchunk.length > 0) {
                 if (nvfs) {
@@ -802,7 +826,13 @@ void pa_source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
                     pa_volume_memchunk(&rchunk, &o->thread_info.sample_spec, &o->volume_factor_source);
                 }
 
+                t = pa_rtclock_now();
+                cpu = o->destination_source ? pa_rtclock_thread_cpu() : 0;
                 o->push(o, &rchunk);
+                pa_atomic_add(&o->thread_info.stats.busy_usec, (int) (pa_rtclock_now() - t));
+
+                if (cpu > 0)
+                    pa_atomic_add(&o->thread_info.stats.cpu_usec, (int) (pa_rtclock_thread_cpu() - cpu));
             }
 
             if (rchunk.memblock)
@@ -825,6 +855,8 @@ void pa_source_output_process_rewind(pa_source_output *o, size_t nbytes /* in so
     if (nbytes <= 0)
         return;
 
+    pa_io_stats_add_rewind(&o->thread_info.stats, nbytes);
+
     if (o->process_rewind) {
         pa_assert(pa_memblockq_get_length(o->thread_info.delay_memblockq) == 0);
 
@@ -1639,7 +1671,7 @@ int pa_source_output_update_rate(pa_source_output *o) {
          !pa_sample_spec_equal(&o->sample_spec, &o->source->sample_spec) ||
          !pa_channel_map_equal(&o->channel_map, &o->source->channel_map))) {
 
-        new_resampler = pa_resampler_new(o->core->mempool,
+        new_resampler = pa_resampler_new(o->core->mempool, o->core->resampler_cache,
                                      &o->source->sample_spec, &o->source->channel_map,
                                      &o->sample_spec, &o->channel_map,
                                      o->requested_resample_method,
@@ -1676,6 +1708,7 @@ int pa_source_output_update_rate(pa_source_output *o) {
             0,
             &o->source->silence);
     pa_xfree(memblockq_name);
+    pa_memblockq_set_mem_account(o->thread_info.delay_memblockq, o->client ? o->client->mem_account : o->core->mem_account);
 
     o->actual_resample_method = new_resampler ? pa_resampler_get_method(new_resampler) : PA_RESAMPLER_INVALID;
 
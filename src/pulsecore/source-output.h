@@ -28,6 +28,7 @@ typedef struct pa_source_output pa_source_output;
 
 #include <pulse/sample.h>
 #include <pulse/format.h>
+#include <pulsecore/io-stats.h>
 #include <pulsecore/memblockq.h>
 #include <pulsecore/resampler.h>
 #include <pulsecore/module.h>
@@ -210,6 +211,8 @@ struct pa_source_output {
         pa_usec_t requested_source_latency;
 
         pa_sink_input *direct_on_input;       /* may be NULL */
+
+        pa_io_stats stats;
     } thread_info;
 
     void *userdata;
@@ -308,6 +308,8 @@ pa_source* pa_source_new(
 
     s->thread_info.rtpoll = NULL;
     s->thread_info.outputs = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+    s->thread_info.peaks_share = pa_resampler_peaks_share_new();
+    pa_volume_share_init(&s->thread_info.volume_share);
     s->thread_info.soft_volume = s->soft_volume;
     s->thread_info.soft_muted = s->muted;
     s->thread_info.state = s->state;
@@ -324,6 +326,11 @@ pa_source* pa_source_new(
     s->thread_info.volume_change_safety_margin = core->deferred_volume_safety_margin_usec;
     s->thread_info.volume_change_extra_delay = core->deferred_volume_extra_delay_usec;
 
+    pa_histogram_init(&s->thread_info.post_time);
+    pa_level_meter_init(&s->thread_info.level);
+    pa_io_stats_init(&s->thread_info.stats);
+    pa_latency_snapshot_init(&s->latency_snapshot);
+
     /* FIXME: This should probably be moved to pa_source_put() */
     pa_assert_se(pa_idxset_put(core->sources, s, &s->index) >= 0);
 
@@ -657,6 +664,9 @@ static void source_free(pa_object *o) {
 
     pa_hashmap_free(s->thread_info.outputs, NULL, NULL);
 
+    pa_resampler_peaks_share_free(s->thread_info.peaks_share);
+    pa_volume_share_done(&s->thread_info.volume_share);
+
     if (s->silence.memblock)
         pa_memblock_unref(s->silence.memblock);
 
@@ -669,6 +679,8 @@ static void source_free(pa_object *o) {
     if (s->ports)
         pa_device_port_hashmap_free(s->ports);
 
+    pa_latency_snapshot_done(&s->latency_snapshot);
+
     pa_xfree(s);
 }
 
@@ -862,6 +874,7 @@ void pa_source_process_rewind(pa_source *s, size_t nbytes) {
         return;
 
     pa_log_debug("Processing rewind...");
+    pa_io_stats_add_rewind(&s->thread_info.stats, nbytes);
 
     PA_HASHMAP_FOREACH(o, s->thread_info.outputs, state) {
         pa_source_output_assert_ref(o);
@@ -873,6 +886,7 @@ void pa_source_process_rewind(pa_source *s, size_t nbytes) {
 void pa_source_post(pa_source*s, const pa_memchunk *chunk) {
     pa_source_output *o;
     void *state = NULL;
+    pa_usec_t t;
 
     pa_source_assert_ref(s);
     pa_source_assert_io_context(s);
@@ -882,6 +896,15 @@ void pa_source_post(pa_source*s, const pa_memchunk *chunk) {
     if (s->thread_info.state == PA_SOURCE_SUSPENDED)
         return;
 
+    t = pa_rtclock_now();
+
+    if (pa_level_meter_is_enabled(&s->thread_info.level)) {
+        pa_cvolume muted;
+
+        pa_level_meter_add(&s->thread_info.level, chunk, &s->sample_spec,
+                           s->thread_info.soft_muted ? pa_cvolume_mute(&muted, s->sample_spec.channels) : &s->thread_info.soft_volume);
+    }
+
     if (s->thread_info.soft_muted || !pa_cvolume_is_norm(&s->thread_info.soft_volume)) {
         pa_memchunk vchunk = *chunk;
 
@@ -910,6 +933,12 @@ void pa_source_post(pa_source*s, const pa_memchunk *chunk) {
                 pa_source_output_push(o, chunk);
         }
     }
+
+    pa_volume_share_done(&s->thread_info.volume_share);
+
+    t = pa_rtclock_now() - t;
+    pa_histogram_add(&s->thread_info.post_time, t);
+    pa_atomic_add(&s->thread_info.stats.busy_usec, (int) t);
 }
 
 /* Called from IO thread context */
@@ -940,6 +969,8 @@ void pa_source_post_direct(pa_source*s, pa_source_output *o, const pa_memchunk *
         pa_memblock_unref(vchunk.memblock);
     } else
         pa_source_output_push(o, chunk);
+
+    pa_volume_share_done(&s->thread_info.volume_share);
 }
 
 /* Called from main thread */
@@ -1016,6 +1047,30 @@ pa_usec_t pa_source_get_latency(pa_source *s) {
     pa_assert_ctl_context();
     pa_assert(PA_SOURCE_IS_LINKED(s->state));
 
+    if (s->state == PA_SOURCE_SUSPENDED)
+        return 0;
+
+    if (!(s->flags & PA_SOURCE_LATENCY))
+        return 0;
+
+    /* Implementations that publish their latency spare us the round
+     * trip to the IO thread */
+    if (pa_latency_snapshot_get(&s->latency_snapshot, pa_rtclock_now(), FALSE, &usec))
+        return usec;
+
+    pa_assert_se(pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), PA_SOURCE_MESSAGE_GET_LATENCY, &usec, 0, NULL) == 0);
+
+    return usec;
+}
+
+/* Called from main thread */
+pa_usec_t pa_source_get_latency_sync(pa_source *s) {
+    pa_usec_t usec;
+
+    pa_source_assert_ref(s);
+    pa_assert_ctl_context();
+    pa_assert(PA_SOURCE_IS_LINKED(s->state));
+
     if (s->state == PA_SOURCE_SUSPENDED)
         return 0;
 
@@ -1054,6 +1109,22 @@ pa_usec_t pa_source_get_latency_within_thread(pa_source *s) {
     return usec;
 }
 
+/* Called from IO thread */
+void pa_source_publish_latency_within_thread(pa_source *s) {
+    pa_usec_t usec;
+
+    pa_source_assert_ref(s);
+    pa_source_assert_io_context(s);
+
+    if (!PA_SOURCE_IS_OPENED(s->thread_info.state) || !(s->flags & PA_SOURCE_LATENCY))
+        return;
+
+    if ((usec = pa_source_get_latency_within_thread(s)) == (pa_usec_t) -1)
+        return;
+
+    pa_latency_snapshot_publish(&s->latency_snapshot, usec, pa_rtclock_now());
+}
+
 /* Called from the main thread (and also from the IO thread while the main
  * thread is waiting).
  *
@@ -2062,6 +2133,10 @@ int pa_source_process_msg(pa_msgobject *object, int code, void *userdata, int64_
 
             s->thread_info.state = PA_PTR_TO_UINT(userdata);
 
+            /* Whatever was published before is void now, until the
+             * implementation publishes again */
+            pa_latency_snapshot_invalidate(&s->latency_snapshot);
+
             if (suspend_change) {
                 pa_source_output *o;
                 void *state = NULL;
@@ -35,6 +35,10 @@ typedef struct pa_source_volume_change pa_source_volume_change;
 #include <pulse/volume.h>
 
 #include <pulsecore/core.h>
+#include <pulsecore/histogram.h>
+#include <pulsecore/level-meter.h>
+#include <pulsecore/io-stats.h>
+#include <pulsecore/latency-snapshot.h>
 #include <pulsecore/idxset.h>
 #include <pulsecore/memchunk.h>
 #include <pulsecore/sink.h>
@@ -42,6 +46,7 @@ typedef struct pa_source_volume_change pa_source_volume_change;
 #include <pulsecore/asyncmsgq.h>
 #include <pulsecore/msgobject.h>
 #include <pulsecore/rtpoll.h>
+#include <pulsecore/sample-util.h>
 #include <pulsecore/card.h>
 #include <pulsecore/device-port.h>
 #include <pulsecore/queue.h>
@@ -186,12 +191,23 @@ struct pa_source {
      * main thread. */
     pa_bool_t (*update_rate)(pa_source *s, uint32_t rate);
 
+    /* Published by the IO thread, see
+     * pa_source_publish_latency_within_thread() */
+    pa_latency_snapshot latency_snapshot;
+
     /* Contains copies of the above data so that the real-time worker
      * thread can work without access locking */
     struct {
         pa_source_state_t state;
         pa_hashmap *outputs;
 
+        /* Lets peak detecting outputs share their result */
+        pa_resampler_peaks_share *peaks_share;
+
+        /* Lets outputs with the same volume share the adjusted chunk,
+         * emptied after every pa_source_post() */
+        pa_volume_share volume_share;
+
         pa_rtpoll *rtpoll;
 
         pa_cvolume soft_volume;
@@ -223,6 +239,14 @@ struct pa_source {
         uint32_t volume_change_safety_margin;
         /* Usec delay added to all volume change events, may be negative. */
         int32_t volume_change_extra_delay;
+
+        /* Time spent in pa_source_post() */
+        pa_histogram post_time;
+
+        /* Level of the posted data, after the soft volume */
+        pa_level_meter level;
+
+        pa_io_stats stats;
 } thread_info;
 
     void *userdata;
@@ -337,6 +361,9 @@ void pa_source_update_flags(pa_source *s, pa_source_flags_t mask, pa_source_flag
 
 /* The returned value is supposed to be in the time domain of the sound card! */
 pa_usec_t pa_source_get_latency(pa_source *s);
+/* Like pa_source_get_latency(), but always asks the IO thread
+ * instead of using a published snapshot */
+pa_usec_t pa_source_get_latency_sync(pa_source *s);
 pa_usec_t pa_source_get_requested_latency(pa_source *s);
 void pa_source_get_latency_range(pa_source *s, pa_usec_t *min_latency, pa_usec_t *max_latency);
 pa_usec_t pa_source_get_fixed_latency(pa_source *s);
@@ -414,6 +441,11 @@ pa_bool_t pa_source_volume_change_apply(pa_source *s, pa_usec_t *usec_to_next);
 void pa_source_invalidate_requested_latency(pa_source *s, pa_bool_t dynamic);
 pa_usec_t pa_source_get_latency_within_thread(pa_source *s);
 
+/* May be called by implementors whenever they have posted data, to
+ * let pa_source_get_latency() answer without a round trip to the IO
+ * thread */
+void pa_source_publish_latency_within_thread(pa_source *s);
+
 #define pa_source_assert_io_context(s) \
     pa_assert(pa_thread_mq_get() || !PA_SOURCE_IS_LINKED((s)->state))
 
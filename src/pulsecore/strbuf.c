@@ -34,25 +34,22 @@
 
 #include "strbuf.h"
 
-/* A chunk of the linked list that makes up the string */
-struct chunk {
-    struct chunk *next;
-    size_t length;
-};
-
-#define CHUNK_TO_TEXT(c) ((char*) (c) + PA_ALIGN(sizeof(struct chunk)))
-
+/* The text is kept in one buffer that grows as needed, always with a
+ * trailing NUL in place */
 struct pa_strbuf {
-    size_t length;
-    struct chunk *head, *tail;
+    char *data;
+    size_t length, allocated;
 };
 
+/* Size of the buffer of a new string buffer */
+#define INITIAL_SIZE 128
+
 pa_strbuf *pa_strbuf_new(void) {
     pa_strbuf *sb;
 
     sb = pa_xnew(pa_strbuf, 1);
-    sb->length = 0;
-    sb->head = sb->tail = NULL;
+    sb->data = NULL;
+    sb->length = sb->allocated = 0;
 
     return sb;
 }
@@ -60,37 +57,33 @@ pa_strbuf *pa_strbuf_new(void) {
 void pa_strbuf_free(pa_strbuf *sb) {
     pa_assert(sb);
 
-    while (sb->head) {
-        struct chunk *c = sb->head;
-        sb->head = sb->head->next;
-        pa_xfree(c);
-    }
-
+    pa_xfree(sb->data);
     pa_xfree(sb);
 }
 
-/* Make a C string from the string buffer. The caller has to free
- * string with pa_xfree(). */
-char *pa_strbuf_tostring(pa_strbuf *sb) {
-    char *t, *e;
-    struct chunk *c;
+/* Make sure there is room for l more bytes and the trailing NUL */
+static void reserve(pa_strbuf *sb, size_t l) {
+    size_t n;
 
-    pa_assert(sb);
+    if (sb->length + l < sb->allocated)
+        return;
 
-    e = t = pa_xmalloc(sb->length+1);
+    n = PA_MAX(sb->allocated, (size_t) INITIAL_SIZE / 2);
 
-    for (c = sb->head; c; c = c->next) {
-        pa_assert((size_t) (e-t) <= sb->length);
-        memcpy(e, CHUNK_TO_TEXT(c), c->length);
-        e += c->length;
-    }
+    do
+        n *= 2;
+    while (sb->length + l >= n);
 
-    /* Trailing NUL */
-    *e = 0;
+    sb->data = pa_xrealloc(sb->data, n);
+    sb->allocated = n;
+}
 
-    pa_assert(e == t+sb->length);
+/* Make a C string from the string buffer. The caller has to free
+ * string with pa_xfree(). */
+char *pa_strbuf_tostring(pa_strbuf *sb) {
+    pa_assert(sb);
 
-    return t;
+    return pa_xstrndup(pa_strbuf_peek(sb), sb->length);
 }
 
 /* Combination of pa_strbuf_free() and pa_strbuf_tostring() */
@@ -98,12 +91,42 @@ char *pa_strbuf_tostring_free(pa_strbuf *sb) {
     char *t;
 
     pa_assert(sb);
-    t = pa_strbuf_tostring(sb);
-    pa_strbuf_free(sb);
+
+    /* The buffer is handed over as it is */
+    reserve(sb, 0);
+    sb->data[sb->length] = 0;
+
+    t = sb->data;
+    pa_xfree(sb);
 
     return t;
 }
 
+/* Returns the text, which stays valid until the string buffer is
+ * changed or freed */
+const char *pa_strbuf_peek(pa_strbuf *sb) {
+    pa_assert(sb);
+
+    if (!sb->data)
+        return "";
+
+    sb->data[sb->length] = 0;
+    return sb->data;
+}
+
+/* Empties the string buffer, keeping the memory for reuse */
+void pa_strbuf_reset(pa_strbuf *sb) {
+    pa_assert(sb);
+
+    sb->length = 0;
+}
+
+size_t pa_strbuf_length(pa_strbuf *sb) {
+    pa_assert(sb);
+
+    return sb->length;
+}
+
 /* Append a string to the string buffer */
 void pa_strbuf_puts(pa_strbuf *sb, const char *t) {
 
@@ -117,75 +140,53 @@ void pa_strbuf_puts(pa_strbuf *sb, const char *t) {
 void pa_strbuf_putc(pa_strbuf *sb, char c) {
     pa_assert(sb);
 
-    pa_strbuf_putsn(sb, &c, 1);
-}
-
-/* Append a new chunk to the linked list */
-static void append(pa_strbuf *sb, struct chunk *c) {
-    pa_assert(sb);
-    pa_assert(c);
-
-    if (sb->tail) {
-        pa_assert(sb->head);
-        sb->tail->next = c;
-    } else {
-        pa_assert(!sb->head);
-        sb->head = c;
-    }
-
-    sb->tail = c;
-    sb->length += c->length;
-    c->next = NULL;
+    reserve(sb, 1);
+    sb->data[sb->length++] = c;
 }
 
 /* Append up to l bytes of a string to the string buffer */
 void pa_strbuf_putsn(pa_strbuf *sb, const char *t, size_t l) {
-    struct chunk *c;
-
     pa_assert(sb);
     pa_assert(t);
 
     if (!l)
         return;
 
-    c = pa_xmalloc(PA_ALIGN(sizeof(struct chunk)) + l);
-    c->length = l;
-    memcpy(CHUNK_TO_TEXT(c), t, l);
-
-    append(sb, c);
+    reserve(sb, l);
+    memcpy(sb->data + sb->length, t, l);
+    sb->length += l;
 }
 
-/* Append a printf() style formatted string to the string buffer. */
-/* The following is based on an example from the GNU libc documentation */
+/* Append a printf() style formatted string to the string buffer. It is
+ * written right into the buffer, which is only enlarged, and written a
+ * second time, if the room left wasn't enough. */
 size_t pa_strbuf_printf(pa_strbuf *sb, const char *format, ...) {
-    size_t size = 100;
-    struct chunk *c = NULL;
+    va_list ap;
+    int r;
 
     pa_assert(sb);
     pa_assert(format);
 
-    for(;;) {
-        va_list ap;
-        int r;
+    reserve(sb, 0);
+
+    va_start(ap, format);
+    r = vsnprintf(sb->data + sb->length, sb->allocated - sb->length, format, ap);
+    va_end(ap);
+
+    pa_assert(r >= 0);
 
-        c = pa_xrealloc(c, PA_ALIGN(sizeof(struct chunk)) + size);
+    if ((size_t) r >= sb->allocated - sb->length) {
+        reserve(sb, (size_t) r);
 
         va_start(ap, format);
-        r = vsnprintf(CHUNK_TO_TEXT(c), size, format, ap);
-        CHUNK_TO_TEXT(c)[size-1] = 0;
+        r = vsnprintf(sb->data + sb->length, sb->allocated - sb->length, format, ap);
         va_end(ap);
 
-        if (r > -1 && (size_t) r < size) {
-            c->length = (size_t) r;
-            append(sb, c);
-            return (size_t) r;
-        }
-
-        if (r > -1)    /* glibc 2.1 */
-            size = (size_t) r+1;
-        else           /* glibc 2.0 */
-            size *= 2;
+        pa_assert(r >= 0 && (size_t) r < sb->allocated - sb->length);
     }
+
+    sb->length += (size_t) r;
+    return (size_t) r;
 }
 
 pa_bool_t pa_strbuf_isempty(pa_strbuf *sb) {
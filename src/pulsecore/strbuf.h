@@ -32,6 +32,13 @@ void pa_strbuf_free(pa_strbuf *sb);
 char *pa_strbuf_tostring(pa_strbuf *sb);
 char *pa_strbuf_tostring_free(pa_strbuf *sb);
 
+/* For callers that build many strings: the text without a copy, valid
+ * until the next change, and emptying the buffer while keeping its
+ * memory */
+const char *pa_strbuf_peek(pa_strbuf *sb);
+void pa_strbuf_reset(pa_strbuf *sb);
+size_t pa_strbuf_length(pa_strbuf *sb);
+
 size_t pa_strbuf_printf(pa_strbuf *sb, const char *format, ...)  PA_GCC_PRINTF_ATTR(2,3);
 void pa_strbuf_puts(pa_strbuf *sb, const char *t);
 void pa_strbuf_putsn(pa_strbuf *sb, const char *t, size_t m);
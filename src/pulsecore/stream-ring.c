@@ -0,0 +1,298 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/macro.h>
+
+#include "stream-ring.h"
+
+#define MIN_CAPACITY 256U
+
+struct pa_stream_ring {
+    pa_bool_t writer;
+
+    /* The block of this side */
+    pa_memblock *own;
+
+    /* The block of the other side, NULL until attached */
+    pa_atomic_ptr_t peer;
+    size_t peer_index;
+
+    size_t capacity, limit;
+};
+
+/* The indices are only touched through the atomic operations, all of
+ * which imply full barriers: advancing an index with pa_atomic_add()
+ * orders it after the accesses to the data it covers, and loading our
+ * own index after the other side's orders that load before them. */
+
+size_t pa_stream_ring_capacity(pa_mempool *p, size_t length) {
+    size_t max, capacity = MIN_CAPACITY;
+
+    pa_assert(p);
+
+    max = pa_mempool_block_size_max(p);
+    pa_assert(max >= PA_STREAM_RING_HEADER_SIZE + MIN_CAPACITY);
+
+    while (capacity < length && PA_STREAM_RING_HEADER_SIZE + 2 * capacity <= max)
+        capacity *= 2;
+
+    return capacity;
+}
+
+pa_stream_ring* pa_stream_ring_new_writer(pa_mempool *p, size_t capacity, size_t limit) {
+    pa_stream_ring *r;
+    void *d;
+
+    pa_assert(p);
+    pa_assert(capacity >= MIN_CAPACITY);
+    pa_assert((capacity & (capacity - 1)) == 0);
+    pa_assert(capacity <= 0x80000000U);
+    pa_assert(limit > 0);
+
+    r = pa_xnew0(pa_stream_ring, 1);
+    r->writer = TRUE;
+    r->capacity = capacity;
+    r->limit = PA_MIN(limit, capacity);
+    r->own = pa_memblock_new(p, PA_STREAM_RING_HEADER_SIZE + capacity);
+
+    d = pa_memblock_acquire(r->own);
+    memset(d, 0, PA_STREAM_RING_HEADER_SIZE);
+    pa_memblock_release(r->own);
+
+    return r;
+}
+
+pa_stream_ring* pa_stream_ring_new_reader(pa_mempool *p) {
+    pa_stream_ring *r;
+    void *d;
+
+    pa_assert(p);
+
+    r = pa_xnew0(pa_stream_ring, 1);
+    r->own = pa_memblock_new(p, PA_STREAM_RING_INDEX_SIZE);
+
+    d = pa_memblock_acquire(r->own);
+    memset(d, 0, PA_STREAM_RING_INDEX_SIZE);
+    pa_memblock_release(r->own);
+
+    return r;
+}
+
+void pa_stream_ring_free(pa_stream_ring *r) {
+    pa_memblock *peer;
+
+    pa_assert(r);
+
+    if ((peer = pa_atomic_ptr_load(&r->peer)))
+        pa_memblock_unref(peer);
+
+    pa_memblock_unref(r->own);
+    pa_xfree(r);
+}
+
+void pa_stream_ring_get_chunk(pa_stream_ring *r, pa_memchunk *chunk) {
+    pa_assert(r);
+    pa_assert(chunk);
+
+    chunk->memblock = r->own;
+    chunk->index = 0;
+    chunk->length = pa_memblock_get_length(r->own);
+}
+
+int pa_stream_ring_attach(pa_stream_ring *r, const pa_memchunk *chunk) {
+    pa_assert(r);
+    pa_assert(chunk);
+    pa_assert(chunk->memblock);
+
+    if (!pa_memblock_is_imported(chunk->memblock))
+        return -1;
+
+    if (r->writer) {
+        if (chunk->length != PA_STREAM_RING_INDEX_SIZE)
+            return -1;
+    } else {
+        size_t capacity;
+
+        if (chunk->length < PA_STREAM_RING_HEADER_SIZE + MIN_CAPACITY)
+            return -1;
+
+        capacity = chunk->length - PA_STREAM_RING_HEADER_SIZE;
+        if ((capacity & (capacity - 1)) != 0 || capacity > 0x80000000U)
+            return -1;
+
+        r->capacity = r->limit = capacity;
+    }
+
+    r->peer_index = chunk->index;
+
+    /* Publishes the fields above together with the block */
+    if (!pa_atomic_ptr_cmpxchg(&r->peer, NULL, chunk->memblock))
+        return -1;
+
+    pa_memblock_ref(chunk->memblock);
+    return 0;
+}
+
+/* Returns the number of bytes in the ring, or (size_t) -1 if the other
+ * side published an index that makes no sense */
+static size_t get_fill(pa_stream_ring *r, uint32_t *own_index, uint8_t **own_data, const uint8_t **peer_data) {
+    pa_memblock *peer;
+    uint32_t peer_index;
+    size_t n;
+
+    *own_data = pa_memblock_acquire(r->own);
+    *peer_data = NULL;
+
+    if (!(peer = pa_atomic_ptr_load(&r->peer))) {
+        /* Nothing was read yet, or nothing can be read yet */
+        *own_index = (uint32_t) pa_atomic_load((pa_atomic_t*) *own_data);
+        peer_index = r->writer ? 0 : *own_index;
+    } else {
+        *peer_data = (const uint8_t*) pa_memblock_acquire(peer) + r->peer_index;
+        peer_index = (uint32_t) pa_atomic_load((const pa_atomic_t*) *peer_data);
+        *own_index = (uint32_t) pa_atomic_load((pa_atomic_t*) *own_data);
+    }
+
+    n = r->writer ? (size_t) (uint32_t) (*own_index - peer_index) : (size_t) (uint32_t) (peer_index - *own_index);
+
+    return n <= r->capacity ? n : (size_t) -1;
+}
+
+static void release(pa_stream_ring *r, const uint8_t *peer_data) {
+    if (peer_data)
+        pa_memblock_release(pa_atomic_ptr_load(&r->peer));
+
+    pa_memblock_release(r->own);
+}
+
+size_t pa_stream_ring_writable(pa_stream_ring *r) {
+    uint32_t w;
+    uint8_t *own;
+    const uint8_t *peer;
+    size_t n;
+
+    pa_assert(r);
+    pa_assert(r->writer);
+
+    n = get_fill(r, &w, &own, &peer);
+    release(r, peer);
+
+    return n <= r->limit ? r->limit - n : 0;
+}
+
+size_t pa_stream_ring_write(pa_stream_ring *r, const void *data, size_t length) {
+    uint32_t w;
+    uint8_t *own, *ring;
+    const uint8_t *peer;
+    size_t n, pos, l;
+
+    pa_assert(r);
+    pa_assert(r->writer);
+    pa_assert(data);
+
+    n = get_fill(r, &w, &own, &peer);
+    n = n <= r->limit ? PA_MIN(length, r->limit - n) : 0;
+
+    if (n > 0) {
+        ring = own + PA_STREAM_RING_HEADER_SIZE;
+        pos = w & (r->capacity - 1);
+        l = PA_MIN(n, r->capacity - pos);
+
+        memcpy(ring + pos, data, l);
+        memcpy(ring, (const uint8_t*) data + l, n - l);
+
+        pa_atomic_add((pa_atomic_t*) own, (int) n);
+    }
+
+    release(r, peer);
+    return n;
+}
+
+size_t pa_stream_ring_readable(pa_stream_ring *r) {
+    uint32_t rd;
+    uint8_t *own;
+    const uint8_t *peer;
+    size_t n;
+
+    pa_assert(r);
+    pa_assert(!r->writer);
+
+    n = get_fill(r, &rd, &own, &peer);
+    release(r, peer);
+
+    /* A misbehaving writer only stalls its own stream */
+    return n != (size_t) -1 ? n : 0;
+}
+
+size_t pa_stream_ring_read(pa_stream_ring *r, void *data, size_t length) {
+    uint32_t rd;
+    uint8_t *own;
+    const uint8_t *peer, *ring;
+    size_t n, pos, l;
+
+    pa_assert(r);
+    pa_assert(!r->writer);
+    pa_assert(data);
+
+    n = get_fill(r, &rd, &own, &peer);
+    n = n != (size_t) -1 ? PA_MIN(length, n) : 0;
+
+    if (n > 0) {
+        ring = peer + PA_STREAM_RING_HEADER_SIZE;
+        pos = rd & (r->capacity - 1);
+        l = PA_MIN(n, r->capacity - pos);
+
+        memcpy(data, ring + pos, l);
+        memcpy((uint8_t*) data + l, ring, n - l);
+
+        pa_atomic_add((pa_atomic_t*) own, (int) n);
+    }
+
+    release(r, peer);
+    return n;
+}
+
+size_t pa_stream_ring_skip(pa_stream_ring *r) {
+    uint32_t rd;
+    uint8_t *own;
+    const uint8_t *peer;
+    size_t n;
+
+    pa_assert(r);
+    pa_assert(!r->writer);
+
+    n = get_fill(r, &rd, &own, &peer);
+
+    if (n != (size_t) -1 && n > 0)
+        pa_atomic_add((pa_atomic_t*) own, (int) n);
+    else
+        n = 0;
+
+    release(r, peer);
+    return n;
+}
@@ -0,0 +1,77 @@
+#ifndef foopulsecorestreamringhfoo
+#define foopulsecorestreamringhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <sys/types.h>
+
+#include <pulsecore/memblock.h>
+#include <pulsecore/memchunk.h>
+
+/* A single producer, single consumer byte ring shared between a client
+ * and the server through two SHM blocks. Each side only writes to the
+ * block it allocated and imports the other one read-only: the writer
+ * owns the data block, which starts with the write index, the reader
+ * owns the index block holding the read index. Both indices count
+ * bytes modulo 2^32.
+ *
+ * The writing and the reading functions may each be called from one
+ * thread without any locking, concurrently with _attach(). */
+
+typedef struct pa_stream_ring pa_stream_ring;
+
+/* Space taken by the write index in front of the data */
+#define PA_STREAM_RING_HEADER_SIZE 64U
+
+/* The size of the index block */
+#define PA_STREAM_RING_INDEX_SIZE 64U
+
+/* The smallest power of two capacity that is at least length, or if
+ * the data block wouldn't fit into a block of the pool then, the
+ * largest one that fits */
+size_t pa_stream_ring_capacity(pa_mempool *p, size_t length);
+
+/* Creates the writing side with a data block of the given capacity,
+ * of which at most limit bytes are filled at any time */
+pa_stream_ring* pa_stream_ring_new_writer(pa_mempool *p, size_t capacity, size_t limit);
+
+/* Creates the reading side with a fresh index block */
+pa_stream_ring* pa_stream_ring_new_reader(pa_mempool *p);
+
+void pa_stream_ring_free(pa_stream_ring *r);
+
+/* The block this side owns, to be sent to the other side */
+void pa_stream_ring_get_chunk(pa_stream_ring *r, pa_memchunk *chunk);
+
+/* Attaches the block received from the other side. Fails if chunk is
+ * not an imported block of the right size or one is attached already. */
+int pa_stream_ring_attach(pa_stream_ring *r, const pa_memchunk *chunk);
+
+/* Writing side */
+size_t pa_stream_ring_writable(pa_stream_ring *r);
+size_t pa_stream_ring_write(pa_stream_ring *r, const void *data, size_t length);
+
+/* Reading side. _read() copies out up to length bytes and returns
+ * how many, _skip() drops everything that is readable. */
+size_t pa_stream_ring_readable(pa_stream_ring *r);
+size_t pa_stream_ring_read(pa_stream_ring *r, void *data, size_t length);
+size_t pa_stream_ring_skip(pa_stream_ring *r);
+
+#endif
@@ -0,0 +1,333 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/endianmacros.h>
+
+#include "cpu-x86.h"
+
+#include "sample-util.h"
+
+#if defined (PA_HAVE_X86_TARGET_ATTRIBUTE)
+
+#include <immintrin.h>
+
+/* The volume array is padded with copies of the channel volumes, so a
+ * whole register of factors can be loaded starting at any channel. All
+ * functions here give exactly the same results as the C versions. */
+
+static void volume_s16ne_tail(int16_t *samples, int32_t *volumes, unsigned channels, unsigned channel, unsigned length) {
+
+    for (; length; length--) {
+        int32_t t, hi, lo;
+
+        hi = volumes[channel] >> 16;
+        lo = volumes[channel] & 0xFFFF;
+
+        t = (int32_t)(*samples);
+        t = ((t * lo) >> 16) + (t * hi);
+        t = PA_CLAMP_UNLIKELY(t, -0x8000, 0x7FFF);
+        *samples++ = (int16_t) t;
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void volume_s16re_tail(int16_t *samples, int32_t *volumes, unsigned channels, unsigned channel, unsigned length) {
+
+    for (; length; length--) {
+        int32_t t, hi, lo;
+
+        hi = volumes[channel] >> 16;
+        lo = volumes[channel] & 0xFFFF;
+
+        t = (int32_t) PA_INT16_SWAP(*samples);
+        t = ((t * lo) >> 16) + (t * hi);
+        t = PA_CLAMP_UNLIKELY(t, -0x8000, 0x7FFF);
+        *samples++ = PA_INT16_SWAP((int16_t) t);
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void volume_s32ne_tail(int32_t *samples, int32_t *volumes, unsigned channels, unsigned channel, unsigned length) {
+
+    for (; length; length--) {
+        int64_t t;
+
+        t = (int64_t)(*samples);
+        t = (t * volumes[channel]) >> 16;
+        t = PA_CLAMP_UNLIKELY(t, -0x80000000LL, 0x7FFFFFFFLL);
+        *samples++ = (int32_t) t;
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void volume_s24ne_tail(uint8_t *samples, int32_t *volumes, unsigned channels, unsigned channel, uint8_t *e) {
+
+    for (; samples < e; samples += 3) {
+        int64_t t;
+
+        t = (int64_t)((int32_t) (PA_READ24NE(samples) << 8));
+        t = (t * volumes[channel]) >> 16;
+        t = PA_CLAMP_UNLIKELY(t, -0x80000000LL, 0x7FFFFFFFLL);
+        PA_WRITE24NE(samples, ((uint32_t) (int32_t) t) >> 8);
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void volume_s24_32ne_tail(uint32_t *samples, int32_t *volumes, unsigned channels, unsigned channel, unsigned length) {
+
+    for (; length; length--) {
+        int64_t t;
+
+        t = (int64_t) ((int32_t) (*samples << 8));
+        t = (t * volumes[channel]) >> 16;
+        t = PA_CLAMP_UNLIKELY(t, -0x80000000LL, 0x7FFFFFFFLL);
+        *samples++ = ((uint32_t) ((int32_t) t)) >> 8;
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void volume_float32ne_tail(float *samples, float *volumes, unsigned channels, unsigned channel, unsigned length) {
+
+    for (; length; length--) {
+        *samples++ *= volumes[channel];
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+/* Same split into the high and low 16 bits of the factor as in the C
+ * version, including the wrap around of the 32 bit products. */
+PA_X86_TARGET("avx2")
+static inline __m256i volume_16x16_avx2(__m256i s, const int32_t *volumes) {
+    __m256i v0, v1, t0, t1;
+
+    v0 = _mm256_loadu_si256((const __m256i*) volumes);
+    v1 = _mm256_loadu_si256((const __m256i*) (volumes + 8));
+
+    t0 = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(s));
+    t1 = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(s, 1));
+
+    t0 = _mm256_add_epi32(_mm256_srai_epi32(_mm256_mullo_epi32(t0, _mm256_and_si256(v0, _mm256_set1_epi32(0xFFFF))), 16),
+                          _mm256_mullo_epi32(t0, _mm256_srai_epi32(v0, 16)));
+    t1 = _mm256_add_epi32(_mm256_srai_epi32(_mm256_mullo_epi32(t1, _mm256_and_si256(v1, _mm256_set1_epi32(0xFFFF))), 16),
+                          _mm256_mullo_epi32(t1, _mm256_srai_epi32(v1, 16)));
+
+    /* The pack works on each 128 bit lane separately */
+    return _mm256_permute4x64_epi64(_mm256_packs_epi32(t0, t1), 0xD8);
+}
+
+/* Takes the even 32 bit lanes of s and v, returns the clamped
+ * (s * v) >> 16 in the low half of each 64 bit lane. */
+PA_X86_TARGET("avx2")
+static inline __m256i volume_32x32_even_avx2(__m256i s, __m256i v) {
+    const __m256i max = _mm256_set1_epi64x(0x7FFFFFFFFFFFLL), min = _mm256_set1_epi64x(-0x800000000000LL);
+    __m256i p, r;
+
+    p = _mm256_mul_epi32(s, v);
+
+    /* AVX2 has neither an arithmetic 64 bit shift nor a 64 bit clamp,
+     * but the low 32 bits are the same for a logical shift and the
+     * range can be checked before shifting. */
+    r = _mm256_srli_epi64(p, 16);
+    r = _mm256_blendv_epi8(r, _mm256_set1_epi64x(0x7FFFFFFFLL), _mm256_cmpgt_epi64(p, max));
+    r = _mm256_blendv_epi8(r, _mm256_set1_epi64x(0x80000000LL), _mm256_cmpgt_epi64(min, p));
+
+    return r;
+}
+
+PA_X86_TARGET("avx2")
+static inline __m256i volume_8x32_avx2(__m256i s, const int32_t *volumes) {
+    __m256i v, even, odd;
+
+    v = _mm256_loadu_si256((const __m256i*) volumes);
+
+    even = volume_32x32_even_avx2(s, v);
+    odd = volume_32x32_even_avx2(_mm256_srli_epi64(s, 32), _mm256_srli_epi64(v, 32));
+
+    return _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+}
+
+PA_X86_TARGET("avx2")
+static void pa_volume_s16ne_avx2(int16_t *samples, int32_t *volumes, unsigned channels, unsigned length) {
+    unsigned channel = 0, step = 16 % channels;
+
+    length /= sizeof(int16_t);
+
+    for (; length >= 16; length -= 16, samples += 16) {
+        __m256i s;
+
+        s = _mm256_loadu_si256((const __m256i*) samples);
+        _mm256_storeu_si256((__m256i*) samples, volume_16x16_avx2(s, volumes + channel));
+
+        if ((channel += step) >= channels)
+            channel -= channels;
+    }
+
+    volume_s16ne_tail(samples, volumes, channels, channel, length);
+}
+
+PA_X86_TARGET("avx2")
+static void pa_volume_s16re_avx2(int16_t *samples, int32_t *volumes, unsigned channels, unsigned length) {
+    unsigned channel = 0, step = 16 % channels;
+    const __m256i swap = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                          1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+
+    length /= sizeof(int16_t);
+
+    for (; length >= 16; length -= 16, samples += 16) {
+        __m256i s;
+
+        s = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*) samples), swap);
+        _mm256_storeu_si256((__m256i*) samples, _mm256_shuffle_epi8(volume_16x16_avx2(s, volumes + channel), swap));
+
+        if ((channel += step) >= channels)
+            channel -= channels;
+    }
+
+    volume_s16re_tail(samples, volumes, channels, channel, length);
+}
+
+PA_X86_TARGET("avx2")
+static void pa_volume_s32ne_avx2(int32_t *samples, int32_t *volumes, unsigned channels, unsigned length) {
+    unsigned channel = 0, step = 8 % channels;
+
+    length /= sizeof(int32_t);
+
+    for (; length >= 8; length -= 8, samples += 8) {
+        __m256i s;
+
+        s = _mm256_loadu_si256((const __m256i*) samples);
+        _mm256_storeu_si256((__m256i*) samples, volume_8x32_avx2(s, volumes + channel));
+
+        if ((channel += step) >= channels)
+            channel -= channels;
+    }
+
+    volume_s32ne_tail(samples, volumes, channels, channel, length);
+}
+
+PA_X86_TARGET("avx2")
+static void pa_volume_s24_32ne_avx2(uint32_t *samples, int32_t *volumes, unsigned channels, unsigned length) {
+    unsigned channel = 0, step = 8 % channels;
+
+    length /= sizeof(uint32_t);
+
+    for (; length >= 8; length -= 8, samples += 8) {
+        __m256i s;
+
+        s = _mm256_slli_epi32(_mm256_loadu_si256((const __m256i*) samples), 8);
+        _mm256_storeu_si256((__m256i*) samples, _mm256_srli_epi32(volume_8x32_avx2(s, volumes + channel), 8));
+
+        if ((channel += step) >= channels)
+            channel -= channels;
+    }
+
+    volume_s24_32ne_tail(samples, volumes, channels, channel, length);
+}
+
+/* x86 is little endian, so the three bytes of each sample just need to
+ * be moved into the upper three bytes of a 32 bit lane and back. Each
+ * 128 bit lane handles four samples, the second one is loaded from
+ * byte 12 on. */
+PA_X86_TARGET("avx2")
+static void pa_volume_s24ne_avx2(uint8_t *samples, int32_t *volumes, unsigned channels, unsigned length) {
+    unsigned channel = 0, step = 8 % channels;
+    uint8_t *e = samples + length;
+    const __m256i unpack = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+                                            -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    const __m256i pack = _mm256_setr_epi8(1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, -1, -1, -1, -1,
+                                          1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, -1, -1, -1, -1);
+
+    /* The second load reads four bytes past the 24 we work on */
+    for (; e - samples >= 28; samples += 24) {
+        __m256i s;
+        __m128i lo, hi;
+        int32_t last;
+
+        s = _mm256_setr_m128i(_mm_loadu_si128((const __m128i*) samples), _mm_loadu_si128((const __m128i*) (samples + 12)));
+        s = _mm256_shuffle_epi8(volume_8x32_avx2(_mm256_shuffle_epi8(s, unpack), volumes + channel), pack);
+
+        lo = _mm256_castsi256_si128(s);
+        hi = _mm256_extracti128_si256(s, 1);
+
+        _mm_storel_epi64((__m128i*) samples, lo);
+        last = _mm_cvtsi128_si32(_mm_srli_si128(lo, 8));
+        memcpy(samples + 8, &last, 4);
+        _mm_storel_epi64((__m128i*) (samples + 12), hi);
+        last = _mm_cvtsi128_si32(_mm_srli_si128(hi, 8));
+        memcpy(samples + 20, &last, 4);
+
+        if ((channel += step) >= channels)
+            channel -= channels;
+    }
+
+    volume_s24ne_tail(samples, volumes, channels, channel, e);
+}
+
+PA_X86_TARGET("avx2")
+static void pa_volume_float32ne_avx2(float *samples, float *volumes, unsigned channels, unsigned length) {
+    unsigned channel = 0, step = 8 % channels;
+
+    length /= sizeof(float);
+
+    for (; length >= 8; length -= 8, samples += 8) {
+        _mm256_storeu_ps(samples, _mm256_mul_ps(_mm256_loadu_ps(samples), _mm256_loadu_ps(volumes + channel)));
+
+        if ((channel += step) >= channels)
+            channel -= channels;
+    }
+
+    volume_float32ne_tail(samples, volumes, channels, channel, length);
+}
+#endif /* defined (PA_HAVE_X86_TARGET_ATTRIBUTE) */
+
+void pa_volume_func_init_avx(pa_cpu_x86_flag_t flags) {
+#if defined (PA_HAVE_X86_TARGET_ATTRIBUTE)
+
+    if (flags & PA_CPU_X86_AVX2) {
+        pa_log_info("Initialising AVX2 optimized volume functions.");
+
+        pa_set_volume_func(PA_SAMPLE_S16NE, (pa_do_volume_func_t) pa_volume_s16ne_avx2);
+        pa_set_volume_func(PA_SAMPLE_S16RE, (pa_do_volume_func_t) pa_volume_s16re_avx2);
+        pa_set_volume_func(PA_SAMPLE_S32NE, (pa_do_volume_func_t) pa_volume_s32ne_avx2);
+        pa_set_volume_func(PA_SAMPLE_S24NE, (pa_do_volume_func_t) pa_volume_s24ne_avx2);
+        pa_set_volume_func(PA_SAMPLE_S24_32NE, (pa_do_volume_func_t) pa_volume_s24_32ne_avx2);
+        pa_set_volume_func(PA_SAMPLE_FLOAT32NE, (pa_do_volume_func_t) pa_volume_float32ne_avx2);
+    }
+#endif /* defined (PA_HAVE_X86_TARGET_ATTRIBUTE) */
+}
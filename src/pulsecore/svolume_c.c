@@ -24,6 +24,7 @@
 #include <config.h>
 #endif
 
+#include <math.h>
 
 #include <pulsecore/macro.h>
 #include <pulsecore/g711.h>
@@ -305,3 +306,121 @@ void pa_set_volume_func(pa_sample_format_t f, pa_do_volume_func_t func) {
 
     do_volume_table[f] = func;
 }
+
+/* The ramp kernels take the number of frames and advance gain[] by
+ * step[] after every frame. The inner loop only runs over the channels
+ * of one frame, so that the compiler can keep the gains in registers. */
+
+static void pa_volume_ramp_s16ne_c(int16_t *samples, float *gain, const float *step, unsigned channels, unsigned frames) {
+    unsigned channel;
+
+    for (; frames; frames--) {
+        for (channel = 0; channel < channels; channel++) {
+            int32_t t;
+
+            t = lrintf((float) *samples * gain[channel]);
+            *samples++ = (int16_t) PA_CLAMP_UNLIKELY(t, -0x8000, 0x7FFF);
+            gain[channel] += step[channel];
+        }
+    }
+}
+
+static void pa_volume_ramp_s16re_c(int16_t *samples, float *gain, const float *step, unsigned channels, unsigned frames) {
+    unsigned channel;
+
+    for (; frames; frames--) {
+        for (channel = 0; channel < channels; channel++) {
+            int32_t t;
+
+            t = lrintf((float) PA_INT16_SWAP(*samples) * gain[channel]);
+            *samples++ = PA_INT16_SWAP((int16_t) PA_CLAMP_UNLIKELY(t, -0x8000, 0x7FFF));
+            gain[channel] += step[channel];
+        }
+    }
+}
+
+static void pa_volume_ramp_float32ne_c(float *samples, float *gain, const float *step, unsigned channels, unsigned frames) {
+    unsigned channel;
+
+    for (; frames; frames--) {
+        for (channel = 0; channel < channels; channel++) {
+            *samples++ *= gain[channel];
+            gain[channel] += step[channel];
+        }
+    }
+}
+
+static void pa_volume_ramp_float32re_c(float *samples, float *gain, const float *step, unsigned channels, unsigned frames) {
+    unsigned channel;
+
+    for (; frames; frames--) {
+        for (channel = 0; channel < channels; channel++) {
+            float t;
+
+            t = PA_FLOAT32_SWAP(*samples);
+            t *= gain[channel];
+            *samples++ = PA_FLOAT32_SWAP(t);
+            gain[channel] += step[channel];
+        }
+    }
+}
+
+static void pa_volume_ramp_s32ne_c(int32_t *samples, float *gain, const float *step, unsigned channels, unsigned frames) {
+    unsigned channel;
+
+    for (; frames; frames--) {
+        for (channel = 0; channel < channels; channel++) {
+            int64_t t;
+
+            t = llrint((double) *samples * gain[channel]);
+            *samples++ = (int32_t) PA_CLAMP_UNLIKELY(t, -0x80000000LL, 0x7FFFFFFFLL);
+            gain[channel] += step[channel];
+        }
+    }
+}
+
+static void pa_volume_ramp_s32re_c(int32_t *samples, float *gain, const float *step, unsigned channels, unsigned frames) {
+    unsigned channel;
+
+    for (; frames; frames--) {
+        for (channel = 0; channel < channels; channel++) {
+            int64_t t;
+
+            t = llrint((double) PA_INT32_SWAP(*samples) * gain[channel]);
+            *samples++ = PA_INT32_SWAP((int32_t) PA_CLAMP_UNLIKELY(t, -0x80000000LL, 0x7FFFFFFFLL));
+            gain[channel] += step[channel];
+        }
+    }
+}
+
+/* Formats without a kernel stay NULL, streams on such sinks rewind
+ * for volume changes instead */
+static pa_do_volume_ramp_func_t do_volume_ramp_table[PA_SAMPLE_MAX] = {
+    [PA_SAMPLE_U8]        = NULL,
+    [PA_SAMPLE_ALAW]      = NULL,
+    [PA_SAMPLE_ULAW]      = NULL,
+    [PA_SAMPLE_S16NE]     = (pa_do_volume_ramp_func_t) pa_volume_ramp_s16ne_c,
+    [PA_SAMPLE_S16RE]     = (pa_do_volume_ramp_func_t) pa_volume_ramp_s16re_c,
+    [PA_SAMPLE_FLOAT32NE] = (pa_do_volume_ramp_func_t) pa_volume_ramp_float32ne_c,
+    [PA_SAMPLE_FLOAT32RE] = (pa_do_volume_ramp_func_t) pa_volume_ramp_float32re_c,
+    [PA_SAMPLE_S32NE]     = (pa_do_volume_ramp_func_t) pa_volume_ramp_s32ne_c,
+    [PA_SAMPLE_S32RE]     = (pa_do_volume_ramp_func_t) pa_volume_ramp_s32re_c,
+    [PA_SAMPLE_S24NE]     = NULL,
+    [PA_SAMPLE_S24RE]     = NULL,
+    [PA_SAMPLE_S24_32NE]  = NULL,
+    [PA_SAMPLE_S24_32RE]  = NULL
+};
+
+pa_do_volume_ramp_func_t pa_get_volume_ramp_func(pa_sample_format_t f) {
+    pa_assert(f >= 0);
+    pa_assert(f < PA_SAMPLE_MAX);
+
+    return do_volume_ramp_table[f];
+}
+
+void pa_set_volume_ramp_func(pa_sample_format_t f, pa_do_volume_ramp_func_t func) {
+    pa_assert(f >= 0);
+    pa_assert(f < PA_SAMPLE_MAX);
+
+    do_volume_ramp_table[f] = func;
+}
@@ -0,0 +1,293 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/endianmacros.h>
+
+#include "cpu-arm.h"
+
+#include "sample-util.h"
+
+#if defined (__arm__) && defined (__ARM_NEON__)
+
+#include <arm_neon.h>
+
+/* Eight samples are done at a time, relying on the padding of the
+ * volume array like the x86 versions. The widening 32x32 bit multiply
+ * gives (s * v) >> 16 directly, which is what the C versions compute in
+ * two halves for S16. */
+
+static void volume_s16ne_tail(int16_t *samples, int32_t *volumes, unsigned channels, unsigned channel, unsigned length) {
+
+    for (; length; length--) {
+        int32_t t, hi, lo;
+
+        hi = volumes[channel] >> 16;
+        lo = volumes[channel] & 0xFFFF;
+
+        t = (int32_t)(*samples);
+        t = ((t * lo) >> 16) + (t * hi);
+        t = PA_CLAMP_UNLIKELY(t, -0x8000, 0x7FFF);
+        *samples++ = (int16_t) t;
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void volume_s16re_tail(int16_t *samples, int32_t *volumes, unsigned channels, unsigned channel, unsigned length) {
+
+    for (; length; length--) {
+        int32_t t, hi, lo;
+
+        hi = volumes[channel] >> 16;
+        lo = volumes[channel] & 0xFFFF;
+
+        t = (int32_t) PA_INT16_SWAP(*samples);
+        t = ((t * lo) >> 16) + (t * hi);
+        t = PA_CLAMP_UNLIKELY(t, -0x8000, 0x7FFF);
+        *samples++ = PA_INT16_SWAP((int16_t) t);
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void volume_s32ne_tail(int32_t *samples, int32_t *volumes, unsigned channels, unsigned channel, unsigned length) {
+
+    for (; length; length--) {
+        int64_t t;
+
+        t = (int64_t)(*samples);
+        t = (t * volumes[channel]) >> 16;
+        t = PA_CLAMP_UNLIKELY(t, -0x80000000LL, 0x7FFFFFFFLL);
+        *samples++ = (int32_t) t;
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void volume_s24ne_tail(uint8_t *samples, int32_t *volumes, unsigned channels, unsigned channel, uint8_t *e) {
+
+    for (; samples < e; samples += 3) {
+        int64_t t;
+
+        t = (int64_t)((int32_t) (PA_READ24NE(samples) << 8));
+        t = (t * volumes[channel]) >> 16;
+        t = PA_CLAMP_UNLIKELY(t, -0x80000000LL, 0x7FFFFFFFLL);
+        PA_WRITE24NE(samples, ((uint32_t) (int32_t) t) >> 8);
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void volume_s24_32ne_tail(uint32_t *samples, int32_t *volumes, unsigned channels, unsigned channel, unsigned length) {
+
+    for (; length; length--) {
+        int64_t t;
+
+        t = (int64_t) ((int32_t) (*samples << 8));
+        t = (t * volumes[channel]) >> 16;
+        t = PA_CLAMP_UNLIKELY(t, -0x80000000LL, 0x7FFFFFFFLL);
+        *samples++ = ((uint32_t) ((int32_t) t)) >> 8;
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void volume_float32ne_tail(float *samples, float *volumes, unsigned channels, unsigned channel, unsigned length) {
+
+    for (; length; length--) {
+        *samples++ *= volumes[channel];
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+/* Returns the clamped (s * v) >> 16 for four samples */
+static inline int32x4_t volume_4x32_neon(int32x4_t s, const int32_t *volumes) {
+    int32x4_t v = vld1q_s32(volumes);
+
+    return vcombine_s32(vqshrn_n_s64(vmull_s32(vget_low_s32(s), vget_low_s32(v)), 16),
+                        vqshrn_n_s64(vmull_s32(vget_high_s32(s), vget_high_s32(v)), 16));
+}
+
+static inline int16x8_t volume_8x16_neon(int16x8_t s, const int32_t *volumes) {
+
+    return vcombine_s16(vqmovn_s32(volume_4x32_neon(vmovl_s16(vget_low_s16(s)), volumes)),
+                        vqmovn_s32(volume_4x32_neon(vmovl_s16(vget_high_s16(s)), volumes + 4)));
+}
+
+static void pa_volume_s16ne_neon(int16_t *samples, int32_t *volumes, unsigned channels, unsigned length) {
+    unsigned channel = 0, step = 8 % channels;
+
+    length /= sizeof(int16_t);
+
+    for (; length >= 8; length -= 8, samples += 8) {
+        vst1q_s16(samples, volume_8x16_neon(vld1q_s16(samples), volumes + channel));
+
+        if ((channel += step) >= channels)
+            channel -= channels;
+    }
+
+    volume_s16ne_tail(samples, volumes, channels, channel, length);
+}
+
+static void pa_volume_s16re_neon(int16_t *samples, int32_t *volumes, unsigned channels, unsigned length) {
+    unsigned channel = 0, step = 8 % channels;
+
+    length /= sizeof(int16_t);
+
+    for (; length >= 8; length -= 8, samples += 8) {
+        int16x8_t s;
+
+        s = vreinterpretq_s16_u8(vrev16q_u8(vreinterpretq_u8_s16(vld1q_s16(samples))));
+        s = volume_8x16_neon(s, volumes + channel);
+        vst1q_s16(samples, vreinterpretq_s16_u8(vrev16q_u8(vreinterpretq_u8_s16(s))));
+
+        if ((channel += step) >= channels)
+            channel -= channels;
+    }
+
+    volume_s16re_tail(samples, volumes, channels, channel, length);
+}
+
+static void pa_volume_s32ne_neon(int32_t *samples, int32_t *volumes, unsigned channels, unsigned length) {
+    unsigned channel = 0, step = 8 % channels;
+
+    length /= sizeof(int32_t);
+
+    for (; length >= 8; length -= 8, samples += 8) {
+        vst1q_s32(samples, volume_4x32_neon(vld1q_s32(samples), volumes + channel));
+        vst1q_s32(samples + 4, volume_4x32_neon(vld1q_s32(samples + 4), volumes + channel + 4));
+
+        if ((channel += step) >= channels)
+            channel -= channels;
+    }
+
+    volume_s32ne_tail(samples, volumes, channels, channel, length);
+}
+
+static void pa_volume_s24_32ne_neon(uint32_t *samples, int32_t *volumes, unsigned channels, unsigned length) {
+    unsigned channel = 0, step = 8 % channels;
+
+    length /= sizeof(uint32_t);
+
+    for (; length >= 8; length -= 8, samples += 8) {
+        int32x4_t s0, s1;
+
+        s0 = vshlq_n_s32(vreinterpretq_s32_u32(vld1q_u32(samples)), 8);
+        s1 = vshlq_n_s32(vreinterpretq_s32_u32(vld1q_u32(samples + 4)), 8);
+
+        vst1q_u32(samples, vshrq_n_u32(vreinterpretq_u32_s32(volume_4x32_neon(s0, volumes + channel)), 8));
+        vst1q_u32(samples + 4, vshrq_n_u32(vreinterpretq_u32_s32(volume_4x32_neon(s1, volumes + channel + 4)), 8));
+
+        if ((channel += step) >= channels)
+            channel -= channels;
+    }
+
+    volume_s24_32ne_tail(samples, volumes, channels, channel, length);
+}
+
+#ifndef WORDS_BIGENDIAN
+/* vld3 splits the three bytes of eight samples into separate registers,
+ * which are then put back together in the upper 24 bits of each 32 bit
+ * lane. */
+static void pa_volume_s24ne_neon(uint8_t *samples, int32_t *volumes, unsigned channels, unsigned length) {
+    unsigned channel = 0, step = 8 % channels;
+    uint8_t *e = samples + length;
+
+    for (; e - samples >= 24; samples += 24) {
+        uint8x8x3_t b;
+        uint16x8x2_t w;
+        uint16x4x2_t r0, r1;
+        int32x4_t s0, s1;
+        uint16x8_t lo, hi;
+
+        b = vld3_u8(samples);
+
+        /* Low and high 16 bits of each sample shifted up by 8 */
+        w = vzipq_u16(vshll_n_u8(b.val[0], 8), vorrq_u16(vmovl_u8(b.val[1]), vshll_n_u8(b.val[2], 8)));
+        s0 = vreinterpretq_s32_u16(w.val[0]);
+        s1 = vreinterpretq_s32_u16(w.val[1]);
+
+        s0 = volume_4x32_neon(s0, volumes + channel);
+        s1 = volume_4x32_neon(s1, volumes + channel + 4);
+
+        r0 = vuzp_u16(vget_low_u16(vreinterpretq_u16_s32(s0)), vget_high_u16(vreinterpretq_u16_s32(s0)));
+        r1 = vuzp_u16(vget_low_u16(vreinterpretq_u16_s32(s1)), vget_high_u16(vreinterpretq_u16_s32(s1)));
+        lo = vcombine_u16(r0.val[0], r1.val[0]);
+        hi = vcombine_u16(r0.val[1], r1.val[1]);
+
+        b.val[0] = vshrn_n_u16(lo, 8);
+        b.val[1] = vmovn_u16(hi);
+        b.val[2] = vshrn_n_u16(hi, 8);
+        vst3_u8(samples, b);
+
+        if ((channel += step) >= channels)
+            channel -= channels;
+    }
+
+    volume_s24ne_tail(samples, volumes, channels, channel, e);
+}
+#endif
+
+static void pa_volume_float32ne_neon(float *samples, float *volumes, unsigned channels, unsigned length) {
+    unsigned channel = 0, step = 8 % channels;
+
+    length /= sizeof(float);
+
+    for (; length >= 8; length -= 8, samples += 8) {
+        vst1q_f32(samples, vmulq_f32(vld1q_f32(samples), vld1q_f32(volumes + channel)));
+        vst1q_f32(samples + 4, vmulq_f32(vld1q_f32(samples + 4), vld1q_f32(volumes + channel + 4)));
+
+        if ((channel += step) >= channels)
+            channel -= channels;
+    }
+
+    volume_float32ne_tail(samples, volumes, channels, channel, length);
+}
+#endif /* defined (__arm__) && defined (__ARM_NEON__) */
+
+void pa_volume_func_init_neon(pa_cpu_arm_flag_t flags) {
+#if defined (__arm__) && defined (__ARM_NEON__)
+
+    if (flags & PA_CPU_ARM_NEON) {
+        pa_log_info("Initialising NEON optimized volume functions.");
+
+        pa_set_volume_func(PA_SAMPLE_S16NE, (pa_do_volume_func_t) pa_volume_s16ne_neon);
+        pa_set_volume_func(PA_SAMPLE_S16RE, (pa_do_volume_func_t) pa_volume_s16re_neon);
+        pa_set_volume_func(PA_SAMPLE_S32NE, (pa_do_volume_func_t) pa_volume_s32ne_neon);
+#ifndef WORDS_BIGENDIAN
+        pa_set_volume_func(PA_SAMPLE_S24NE, (pa_do_volume_func_t) pa_volume_s24ne_neon);
+#endif
+        pa_set_volume_func(PA_SAMPLE_S24_32NE, (pa_do_volume_func_t) pa_volume_s24_32ne_neon);
+        pa_set_volume_func(PA_SAMPLE_FLOAT32NE, (pa_do_volume_func_t) pa_volume_float32ne_neon);
+    }
+#endif /* defined (__arm__) && defined (__ARM_NEON__) */
+}
@@ -37,62 +37,202 @@
 
 #include <pulsecore/socket.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/flist.h>
+#include <pulsecore/atomic.h>
 
 #include "tagstruct.h"
 
 #define MAX_TAG_SIZE (64*1024)
 
+/* Small tagstructs are built in a buffer appended to the struct itself */
+#define MAX_APPENDED_SIZE 128
+
 struct pa_tagstruct {
     uint8_t *data;
     size_t length, allocated;
     size_t rindex;
 
-    pa_bool_t dynamic;
+    enum {
+        PA_TAGSTRUCT_FIXED,    /* The data is owned by the caller */
+        PA_TAGSTRUCT_APPENDED, /* The data is in the appended buffer */
+        PA_TAGSTRUCT_PACKET,   /* The data is in a pooled packet */
+        PA_TAGSTRUCT_DYNAMIC   /* The data is owned by the tagstruct */
+    } type;
+
+    /* Bigger tagstructs are built right in the packet they are sent in,
+     * as long as that comes from a pool */
+    pa_packet *packet;
+
+    uint8_t appended[MAX_APPENDED_SIZE];
 };
 
+PA_STATIC_FLIST_DECLARE(tagstructs, 0, pa_xfree);
+
+/* A running average of the size of the tagstructs that outgrew the
+ * appended buffer, used as first allocation for the next one. Replies
+ * like introspection lists tend to come in series of similar size. */
+static pa_atomic_t dynamic_size_hint = PA_ATOMIC_INIT(0);
+
 pa_tagstruct *pa_tagstruct_new(const uint8_t* data, size_t length) {
     pa_tagstruct*t;
 
     pa_assert(!data || (data && length));
 
-    t = pa_xnew(pa_tagstruct, 1);
-    t->data = (uint8_t*) data;
-    t->allocated = t->length = data ? length : 0;
+    if (!(t = pa_flist_pop(PA_STATIC_FLIST_GET(tagstructs))))
+        t = pa_xnew(pa_tagstruct, 1);
+
+    if (data) {
+        t->data = (uint8_t*) data;
+        t->allocated = t->length = length;
+        t->type = PA_TAGSTRUCT_FIXED;
+    } else {
+        t->data = t->appended;
+        t->allocated = MAX_APPENDED_SIZE;
+        t->length = 0;
+        t->type = PA_TAGSTRUCT_APPENDED;
+    }
+
     t->rindex = 0;
-    t->dynamic = !data;
+    t->packet = NULL;
 
     return t;
 }
 
+static void update_size_hint(pa_tagstruct *t) {
+    int hint;
+
+    if (t->type != PA_TAGSTRUCT_PACKET && t->type != PA_TAGSTRUCT_DYNAMIC)
+        return;
+
+    hint = pa_atomic_load(&dynamic_size_hint);
+    pa_atomic_store(&dynamic_size_hint, (int) ((PA_MIN(t->length, (size_t) MAX_TAG_SIZE) + (size_t) hint) / 2));
+}
+
+static void tagstruct_recycle(pa_tagstruct *t) {
+    if (pa_flist_push(PA_STATIC_FLIST_GET(tagstructs), t) < 0)
+        pa_xfree(t);
+}
+
 void pa_tagstruct_free(pa_tagstruct*t) {
     pa_assert(t);
 
-    if (t->dynamic)
+    update_size_hint(t);
+
+    if (t->type == PA_TAGSTRUCT_PACKET)
+        pa_packet_unref(t->packet);
+    else if (t->type == PA_TAGSTRUCT_DYNAMIC)
         pa_xfree(t->data);
-    pa_xfree(t);
+
+    tagstruct_recycle(t);
 }
 
 uint8_t* pa_tagstruct_free_data(pa_tagstruct*t, size_t *l) {
     uint8_t *p;
 
     pa_assert(t);
-    pa_assert(t->dynamic);
+    pa_assert(t->type != PA_TAGSTRUCT_FIXED);
     pa_assert(l);
 
-    p = t->data;
+    update_size_hint(t);
+
+    if (t->type == PA_TAGSTRUCT_APPENDED)
+        p = pa_xmemdup(t->data, t->length);
+    else if (t->type == PA_TAGSTRUCT_PACKET) {
+        p = pa_xmemdup(t->data, t->length);
+        pa_packet_unref(t->packet);
+    } else
+        p = t->data;
+
     *l = t->length;
-    pa_xfree(t);
+    tagstruct_recycle(t);
+    return p;
+}
+
+pa_packet* pa_tagstruct_free_packet(pa_tagstruct*t) {
+    pa_packet *p;
+
+    pa_assert(t);
+    pa_assert(t->type != PA_TAGSTRUCT_FIXED);
+    pa_assert(t->length > 0);
+
+    update_size_hint(t);
+
+    switch (t->type) {
+        case PA_TAGSTRUCT_APPENDED:
+            /* A pooled packet and a copy of at most MAX_APPENDED_SIZE
+             * bytes are cheap */
+            pa_assert_se(p = pa_packet_new(t->length));
+            memcpy(p->data, t->data, t->length);
+            break;
+
+        case PA_TAGSTRUCT_PACKET:
+            p = t->packet;
+            pa_packet_set_length(p, t->length);
+            break;
+
+        case PA_TAGSTRUCT_DYNAMIC:
+            pa_assert_se(p = pa_packet_new_dynamic(t->data, t->length));
+            break;
+
+        default:
+            pa_assert_not_reached();
+    }
+
+    tagstruct_recycle(t);
     return p;
 }
 
 static void extend(pa_tagstruct*t, size_t l) {
+    size_t n;
+
     pa_assert(t);
-    pa_assert(t->dynamic);
+    pa_assert(t->type != PA_TAGSTRUCT_FIXED);
 
     if (t->length+l <= t->allocated)
         return;
 
-    t->data = pa_xrealloc(t->data, t->allocated = t->length+l+100);
+    /* Grow geometrically, so that big replies don't cause a realloc()
+     * every few entries */
+    n = PA_MAX(t->length+l, t->allocated*2);
+
+    if (t->type == PA_TAGSTRUCT_APPENDED)
+        n = PA_MAX(n, (size_t) pa_atomic_load(&dynamic_size_hint));
+
+    if (t->type == PA_TAGSTRUCT_DYNAMIC)
+        t->data = pa_xrealloc(t->data, n);
+
+    else if (n <= PA_PACKET_POOLED_MAX) {
+        pa_packet *p;
+
+        pa_assert_se(p = pa_packet_new(n));
+        memcpy(p->data, t->data, t->length);
+
+        if (t->packet)
+            pa_packet_unref(t->packet);
+
+        t->packet = p;
+        t->data = p->data;
+        t->type = PA_TAGSTRUCT_PACKET;
+
+        /* Use all of the size class */
+        n = p->allocated;
+
+    } else {
+        uint8_t *d;
+
+        d = pa_xmalloc(n);
+        memcpy(d, t->data, t->length);
+
+        if (t->packet) {
+            pa_packet_unref(t->packet);
+            t->packet = NULL;
+        }
+
+        t->data = d;
+        t->type = PA_TAGSTRUCT_DYNAMIC;
+    }
+
+    t->allocated = n;
 }
 
 void pa_tagstruct_puts(pa_tagstruct*t, const char *s) {
@@ -422,7 +562,7 @@ int pa_tagstruct_eof(pa_tagstruct*t) {
 
 const uint8_t* pa_tagstruct_data(pa_tagstruct*t, size_t *l) {
     pa_assert(t);
-    pa_assert(t->dynamic);
+    pa_assert(t->type != PA_TAGSTRUCT_FIXED);
     pa_assert(l);
 
     *l = t->length;
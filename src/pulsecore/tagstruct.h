@@ -33,6 +33,7 @@
 #include <pulse/proplist.h>
 
 #include <pulsecore/macro.h>
+#include <pulsecore/packet.h>
 
 typedef struct pa_tagstruct pa_tagstruct;
 
@@ -66,6 +67,10 @@ pa_tagstruct *pa_tagstruct_new(const uint8_t* data, size_t length);
 void pa_tagstruct_free(pa_tagstruct*t);
 uint8_t* pa_tagstruct_free_data(pa_tagstruct*t, size_t *l);
 
+/* Frees the tagstruct and returns a packet with its data, without
+ * copying unless it was small. The tagstruct must not be empty. */
+pa_packet* pa_tagstruct_free_packet(pa_tagstruct*t);
+
 int pa_tagstruct_eof(pa_tagstruct*t);
 const uint8_t* pa_tagstruct_data(pa_tagstruct*t, size_t *l);
 
@@ -87,6 +92,10 @@ void pa_tagstruct_put_proplist(pa_tagstruct *t, pa_proplist *p);
 void pa_tagstruct_put_volume(pa_tagstruct *t, pa_volume_t volume);
 void pa_tagstruct_put_format_info(pa_tagstruct *t, pa_format_info *f);
 
+/* Strings and arbitrary data returned by the getters point into the
+ * data of the tagstruct, usually the received packet, and are valid as
+ * long as it is. They need neither copying nor freeing. */
+
 int pa_tagstruct_get(pa_tagstruct *t, ...);
 
 int pa_tagstruct_gets(pa_tagstruct*t, const char **s);
@@ -26,6 +26,7 @@
 #include <unistd.h>
 #include <errno.h>
 
+#include <pulsecore/log.h>
 #include <pulsecore/thread.h>
 #include <pulsecore/semaphore.h>
 #include <pulsecore/macro.h>
@@ -130,6 +131,9 @@ void pa_thread_mq_install(pa_thread_mq *q) {
 
     pa_assert(!(PA_STATIC_TLS_GET(thread_mq)));
     PA_STATIC_TLS_SET(thread_mq, q);
+
+    /* IO threads must not block on writing out log messages */
+    pa_log_set_thread_async(TRUE);
 }
 
 pa_thread_mq *pa_thread_mq_get(void) {
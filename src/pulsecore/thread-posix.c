@@ -34,6 +34,7 @@
 
 #include <pulse/xmalloc.h>
 #include <pulsecore/atomic.h>
+#include <pulsecore/flist.h>
 #include <pulsecore/macro.h>
 
 #include "thread.h"
@@ -79,10 +80,14 @@ static void* internal_thread_func(void *userdata) {
 
     PA_STATIC_TLS_SET(current_thread, t);
 
+    pa_flist_thread_init();
+
     pa_atomic_inc(&t->running);
     t->thread_func(t->userdata);
     pa_atomic_sub(&t->running, 2);
 
+    pa_flist_thread_done();
+
     return NULL;
 }
 
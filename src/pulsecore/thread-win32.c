@@ -28,6 +28,7 @@
 #include <windows.h>
 
 #include <pulse/xmalloc.h>
+#include <pulsecore/flist.h>
 #include <pulsecore/once.h>
 
 #include "thread.h"
@@ -65,7 +66,9 @@ static DWORD WINAPI internal_thread_func(LPVOID param) {
     pa_run_once(&thread_tls_once, thread_tls_once_func);
     pa_tls_set(thread_tls, t);
 
+    pa_flist_thread_init();
     t->thread_func(t->userdata);
+    pa_flist_thread_done();
 
     return 0;
 }
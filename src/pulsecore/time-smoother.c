@@ -56,6 +56,13 @@
  *
  * If 'monotonic' is TRUE the resulting estimation function is
  * guaranteed to be monotonic.
+ *
+ * If 'recursive' is TRUE the gradient is not estimated by linear
+ * regression over the history window, but by recursive least squares
+ * where older measurements fade exponentially, with 'history_time' as
+ * time constant. That costs the same for every measurement, however
+ * many there are in the window, and the point we smooth towards is
+ * taken from the fitted line instead of the last, noisy, measurement.
  */
 
 struct pa_smoother {
@@ -88,6 +95,12 @@ struct pa_smoother {
     pa_usec_t pause_time;
 
     unsigned min_history;
+
+    /* For the recursive estimator: exponentially weighted sum of
+     * weights, means, and (co)variance of all measurements so far */
+    pa_bool_t recursive:1;
+    double w, mx, my, sxx, sxy;
+    pa_usec_t last_put_x;
 };
 
 pa_smoother* pa_smoother_new(
@@ -97,7 +110,8 @@ pa_smoother* pa_smoother_new(
         pa_bool_t smoothing,
         unsigned min_history,
         pa_usec_t time_offset,
-        pa_bool_t paused) {
+        pa_bool_t paused,
+        pa_bool_t recursive) {
 
     pa_smoother *s;
 
@@ -112,6 +126,7 @@ pa_smoother* pa_smoother_new(
     s->min_history = min_history;
     s->monotonic = monotonic;
     s->smoothing = smoothing;
+    s->recursive = recursive;
 
     pa_smoother_reset(s, time_offset, paused);
 
@@ -244,6 +259,58 @@ static double avg_gradient(pa_smoother *s, pa_usec_t x) {
     return (s->monotonic && r < 0) ? 0 : r;
 }
 
+static void rls_add(pa_smoother *s, pa_usec_t x, pa_usec_t y) {
+    double f, f_min, w, dx, dy;
+
+    if (s->n_history <= 0) {
+        s->w = 1;
+        s->mx = (double) x;
+        s->my = (double) y;
+        s->sxx = s->sxy = 0;
+
+        s->n_history = 1;
+        s->last_put_x = x;
+        return;
+    }
+
+    /* Let old measurements fade with their age, as they'd leave the
+     * window of the regression, but always keep the weight of
+     * min_history of them */
+    f = x > s->last_put_x ? exp(-(double) (x - s->last_put_x) / (double) s->history_time) : 1;
+    f_min = PA_MIN(1.0, (double) (s->min_history - 1) / s->w);
+    f = PA_MAX(f, f_min);
+
+    /* Weighted update of means and (co)variance, in a numerically
+     * stable way */
+    w = f * s->w;
+    s->w = w + 1;
+
+    dx = (double) x - s->mx;
+    dy = (double) y - s->my;
+
+    s->mx += dx / s->w;
+    s->my += dy / s->w;
+    s->sxx = f * s->sxx + dx * dx * w / s->w;
+    s->sxy = f * s->sxy + dx * dy * w / s->w;
+
+    if (s->n_history < s->min_history)
+        s->n_history++;
+
+    s->last_put_x = x;
+}
+
+static double rls_gradient(pa_smoother *s) {
+    double r;
+
+    /* Too few measurements, assume gradient of 1 */
+    if (s->n_history < s->min_history || s->sxx <= 0)
+        return 1;
+
+    r = s->sxy / s->sxx;
+
+    return (s->monotonic && r < 0) ? 0 : r;
+}
+
 static void calc_abc(pa_smoother *s) {
     pa_usec_t ex, ey, px, py;
     int64_t kx, ky;
@@ -368,11 +435,23 @@ void pa_smoother_put(pa_smoother *s, pa_usec_t x, pa_usec_t y) {
         s->ry = y;
     }
 
-    /* Then, we add the new measurement to our history */
-    add_to_history(s, x, y);
+    if (s->recursive) {
+        rls_add(s, x, y);
+        s->dp = rls_gradient(s);
+
+        /* Aim for the fitted line rather than the measurement */
+        if (is_new && s->n_history >= s->min_history) {
+            double t = s->my + s->dp * ((double) x - s->mx);
 
-    /* And determine the average gradient of the history */
-    s->dp = avg_gradient(s, x);
+            s->ry = t > 0 ? (pa_usec_t) llrint(t) : 0;
+        }
+    } else {
+        /* Then, we add the new measurement to our history */
+        add_to_history(s, x, y);
+
+        /* And determine the average gradient of the history */
+        s->dp = avg_gradient(s, x);
+    }
 
     /* And calculate when we want to be on track again */
     if (s->smoothing) {
@@ -514,6 +593,9 @@ void pa_smoother_reset(pa_smoother *s, pa_usec_t time_offset, pa_bool_t paused)
     s->history_idx = 0;
     s->n_history = 0;
 
+    s->w = s->mx = s->my = s->sxx = s->sxy = 0;
+    s->last_put_x = 0;
+
     s->last_y = s->last_x = 0;
 
     s->abc_valid = FALSE;
@@ -34,7 +34,8 @@ pa_smoother* pa_smoother_new(
         pa_bool_t smoothing,
         unsigned min_history,
         pa_usec_t x_offset,
-        pa_bool_t paused);
+        pa_bool_t paused,
+        pa_bool_t recursive);
 
 void pa_smoother_free(pa_smoother* s);
 
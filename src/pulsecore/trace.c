@@ -0,0 +1,229 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/core-error.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/thread.h>
+
+#include "trace.h"
+
+#define ENV_TRACE "PULSE_TRACE"
+
+/* Records per thread, must be a power of two */
+#define RING_SIZE 8192
+
+/* Only the owning thread writes to a ring. Rings stay around after
+ * their thread is gone, so that the dump still has its last records. */
+struct trace_ring {
+    struct trace_ring *next;
+    char name[32];
+    pa_atomic_t n_written;
+    pa_trace_record records[RING_SIZE];
+};
+
+pa_bool_t pa_trace_enabled = FALSE;
+
+static char *trace_file = NULL;
+static pa_atomic_ptr_t rings = PA_ATOMIC_PTR_INIT(NULL);
+
+PA_STATIC_TLS_DECLARE_NO_FREE(trace_ring);
+
+static const struct {
+    const char *name;
+    char phase;
+} event_table[PA_TRACE_EVENT_MAX] = {
+    [PA_TRACE_SINK_RENDER_BEGIN] = { "sink-render", 'B' },
+    [PA_TRACE_SINK_RENDER_END] = { "sink-render", 'E' },
+    [PA_TRACE_RTPOLL_WAKEUP] = { "rtpoll-wakeup", 'i' },
+    [PA_TRACE_MMAP_WRITE_BEGIN] = { "mmap-write", 'B' },
+    [PA_TRACE_MMAP_WRITE_END] = { "mmap-write", 'E' },
+    [PA_TRACE_MEMBLOCKQ_PUSH] = { "memblockq-push", 'i' },
+    [PA_TRACE_ASYNCMSGQ_SEND] = { "asyncmsgq-send", 'i' },
+    [PA_TRACE_ASYNCMSGQ_DISPATCH_BEGIN] = { "asyncmsgq-dispatch", 'B' },
+    [PA_TRACE_ASYNCMSGQ_DISPATCH_END] = { "asyncmsgq-dispatch", 'E' },
+};
+
+const char *pa_trace_event_to_string(pa_trace_event_t e) {
+    if (e >= PA_TRACE_EVENT_MAX)
+        return NULL;
+
+    return event_table[e].name;
+}
+
+char pa_trace_event_to_phase(pa_trace_event_t e) {
+    if (e >= PA_TRACE_EVENT_MAX)
+        return 'i';
+
+    return event_table[e].phase;
+}
+
+void pa_trace_init(void) {
+    const char *e;
+
+    if (pa_trace_enabled || !(e = getenv(ENV_TRACE)) || !*e)
+        return;
+
+    trace_file = pa_xstrdup(e);
+    pa_trace_enabled = TRUE;
+
+    pa_log_info("Tracing to %s.", trace_file);
+}
+
+void pa_trace_done(void) {
+    struct trace_ring *r;
+
+    if (!pa_trace_enabled)
+        return;
+
+    pa_trace_dump();
+    pa_trace_enabled = FALSE;
+
+    /* All other threads that recorded anything are gone by now */
+    while ((r = pa_atomic_ptr_load(&rings))) {
+        pa_atomic_ptr_store(&rings, r->next);
+        pa_xfree(r);
+    }
+
+    PA_STATIC_TLS_SET(trace_ring, NULL);
+
+    pa_xfree(trace_file);
+    trace_file = NULL;
+}
+
+static struct trace_ring *ring_new(void) {
+    struct trace_ring *r;
+
+    r = pa_xnew0(struct trace_ring, 1);
+    pa_strlcpy(r->name, pa_strnull(pa_thread_get_name(pa_thread_self())), sizeof(r->name));
+
+    do
+        r->next = pa_atomic_ptr_load(&rings);
+    while (!pa_atomic_ptr_cmpxchg(&rings, r->next, r));
+
+    PA_STATIC_TLS_SET(trace_ring, r);
+
+    return r;
+}
+
+void pa_trace_record_event(pa_trace_event_t e, uint64_t a, uint64_t b) {
+    struct trace_ring *r;
+    pa_trace_record *rec;
+    unsigned n;
+
+    pa_assert(e < PA_TRACE_EVENT_MAX);
+
+    /* The first record of a thread allocates its ring */
+    if (PA_UNLIKELY(!(r = PA_STATIC_TLS_GET(trace_ring))))
+        r = ring_new();
+
+    n = (unsigned) pa_atomic_load(&r->n_written);
+
+    rec = &r->records[n & (RING_SIZE - 1)];
+    rec->usec = pa_rtclock_now();
+    rec->event = (uint32_t) e;
+    rec->reserved = 0;
+    rec->a = a;
+    rec->b = b;
+
+    pa_atomic_store(&r->n_written, (int) (n + 1));
+}
+
+int pa_trace_dump(void) {
+    struct trace_ring *r;
+    uint32_t n_threads = 0;
+    char *tmp;
+    int fd, ret = -1;
+
+    if (!pa_trace_enabled)
+        return -1;
+
+    for (r = pa_atomic_ptr_load(&rings); r; r = r->next)
+        n_threads++;
+
+    tmp = pa_sprintf_malloc("%s.tmp", trace_file);
+
+    if ((fd = pa_open_cloexec(tmp, O_WRONLY|O_CREAT|O_TRUNC, 0600)) < 0) {
+        pa_log_warn("Failed to open %s: %s", tmp, pa_cstrerror(errno));
+        goto finish;
+    }
+
+    if (pa_loop_write(fd, PA_TRACE_MAGIC, strlen(PA_TRACE_MAGIC), NULL) < 0 ||
+        pa_loop_write(fd, &n_threads, sizeof(n_threads), NULL) < 0)
+        goto fail;
+
+    for (r = pa_atomic_ptr_load(&rings); r && n_threads > 0; r = r->next, n_threads--) {
+        pa_trace_thread t;
+        unsigned n, count, first;
+
+        n = (unsigned) pa_atomic_load(&r->n_written);
+        count = PA_MIN(n, (unsigned) RING_SIZE);
+
+        pa_zero(t);
+        memcpy(t.name, r->name, sizeof(t.name));
+        t.n_records = count;
+
+        if (pa_loop_write(fd, &t, sizeof(t), NULL) < 0)
+            goto fail;
+
+        /* The part up to the end of the array, then the wrapped part */
+        first = (n - count) & (RING_SIZE - 1);
+
+        if (pa_loop_write(fd, r->records + first, PA_MIN(count, RING_SIZE - first) * sizeof(pa_trace_record), NULL) < 0)
+            goto fail;
+
+        if (first + count > RING_SIZE &&
+            pa_loop_write(fd, r->records, (first + count - RING_SIZE) * sizeof(pa_trace_record), NULL) < 0)
+            goto fail;
+    }
+
+    if (pa_close(fd) < 0 || rename(tmp, trace_file) < 0) {
+        pa_log_warn("Failed to write %s: %s", trace_file, pa_cstrerror(errno));
+        unlink(tmp);
+        goto finish;
+    }
+
+    pa_log_info("Wrote trace to %s.", trace_file);
+    ret = 0;
+    goto finish;
+
+fail:
+    pa_log_warn("Failed to write %s: %s", tmp, pa_cstrerror(errno));
+    pa_close(fd);
+    unlink(tmp);
+
+finish:
+    pa_xfree(tmp);
+    return ret;
+}
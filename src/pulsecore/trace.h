@@ -0,0 +1,88 @@
+#ifndef foopulsecoretracehfoo
+#define foopulsecoretracehfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <inttypes.h>
+
+#include <pulsecore/macro.h>
+
+/* A flight recorder for what the IO threads do. Every thread writes
+ * (time, event, two arguments) records into a ring of its own, the
+ * oldest records are overwritten. If $PULSE_TRACE names a file when
+ * pa_trace_init() is called, the rings are written there by
+ * pa_trace_dump(). utils/patrace turns such a file into JSON for
+ * chrome://tracing or Perfetto. When tracing is off a trace point is
+ * a single predicted branch. */
+
+typedef enum pa_trace_event {
+    PA_TRACE_SINK_RENDER_BEGIN,         /* sink index, requested length */
+    PA_TRACE_SINK_RENDER_END,           /* sink index, rendered length */
+    PA_TRACE_RTPOLL_WAKEUP,             /* result of the poll, timer elapsed */
+    PA_TRACE_MMAP_WRITE_BEGIN,          /* sink index, 1 if woken up by POLLOUT */
+    PA_TRACE_MMAP_WRITE_END,            /* sink index, bytes written */
+    PA_TRACE_MEMBLOCKQ_PUSH,            /* length pushed, new queue length */
+    PA_TRACE_ASYNCMSGQ_SEND,            /* message code, 1 if waiting for a reply */
+    PA_TRACE_ASYNCMSGQ_DISPATCH_BEGIN,  /* message code */
+    PA_TRACE_ASYNCMSGQ_DISPATCH_END,    /* message code, return value */
+    PA_TRACE_EVENT_MAX
+} pa_trace_event_t;
+
+/* One record as it is stored in the file, in host byte order */
+typedef struct pa_trace_record {
+    uint64_t usec;
+    uint32_t event;
+    uint32_t reserved;
+    uint64_t a, b;
+} pa_trace_record;
+
+/* A dump starts with PA_TRACE_MAGIC, followed by a uint32_t with the
+ * number of threads. For every thread there is a pa_trace_thread and
+ * then n_records records, oldest first. */
+#define PA_TRACE_MAGIC "PATRACE1"
+
+typedef struct pa_trace_thread {
+    char name[32];
+    uint32_t n_records;
+    uint32_t reserved;
+} pa_trace_thread;
+
+extern pa_bool_t pa_trace_enabled;
+
+void pa_trace_init(void);
+void pa_trace_done(void);
+
+/* Writes what is in the rings right now. Threads keep recording while
+ * this runs, so records written meanwhile may come out garbled. */
+int pa_trace_dump(void);
+
+void pa_trace_record_event(pa_trace_event_t e, uint64_t a, uint64_t b);
+
+static inline void pa_trace(pa_trace_event_t e, uint64_t a, uint64_t b) {
+    if (PA_UNLIKELY(pa_trace_enabled))
+        pa_trace_record_event(e, a, b);
+}
+
+const char *pa_trace_event_to_string(pa_trace_event_t e);
+
+/* 'B' or 'E' for the begin and end of a span, 'i' for instant events */
+char pa_trace_event_to_phase(pa_trace_event_t e);
+
+#endif
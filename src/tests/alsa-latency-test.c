@@ -0,0 +1,670 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <getopt.h>
+#include <sched.h>
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#include <alsa/asoundlib.h>
+
+#include <pulse/sample.h>
+#include <pulse/timeval.h>
+#include <pulse/util.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-rtclock.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/thread.h>
+
+/* Finds out how well this machine keeps up with timer based scheduling.
+ * While threads on all CPUs put a realtime load on the system, like
+ * rtstutter does, it
+ *
+ *  - measures how late a thread wakes up from a timed sleep, once
+ *    without and once with realtime scheduling,
+ *
+ *  - plays silence on each card, waking up like the daemon does in
+ *    timer based scheduling mode, and measures how well the playback
+ *    pointer and the timestamps ALSA reports for it follow the clock,
+ *    like alsa-time-test.
+ *
+ * Then it suggests settings: the realtime priority and fragments for
+ * daemon.conf, and for each card whether timer based scheduling should
+ * be used, and with which watermark, as udev rules that
+ * module-udev-detect picks up.
+ *
+ * The daemon must not be running, it would keep the cards busy.
+ *
+ * Usage: alsa-latency-test [--duration SEC] [--rtprio N]
+ *                          [--load-priority N] [--load-msec N]
+ *                          [--card N] */
+
+#define MAX_SAMPLES (64 * 1024)
+
+/* Wakeups of the measuring thread, and of the playback loop */
+#define WAKEUP_MIN_USEC 500
+#define WAKEUP_MAX_USEC (5 * PA_USEC_PER_MSEC)
+#define PLAYBACK_SLEEP_USEC (10 * PA_USEC_PER_MSEC)
+#define PLAYBACK_BUFFER_USEC (2 * PA_USEC_PER_SEC)
+
+/* As in module-alsa-sink */
+#define DEFAULT_TSCHED_WATERMARK_USEC (20 * PA_USEC_PER_MSEC)
+
+/* A card whose pointer is farther off than this is better off with
+ * interrupts */
+#define MAX_POINTER_JITTER_USEC (10 * PA_USEC_PER_MSEC)
+
+/* The daemon's default sample spec, the sizes in the udev rules are in
+ * bytes of it */
+static const pa_sample_spec sample_spec = {
+    .format = PA_SAMPLE_S16LE,
+    .rate = 44100,
+    .channels = 2
+};
+
+struct stats {
+    pa_usec_t values[MAX_SAMPLES];
+    unsigned n;
+};
+
+struct card_result {
+    int index;
+    char *id, *name;
+    pa_bool_t ok;
+
+    struct stats wakeups;
+    unsigned xruns;
+    pa_bool_t htstamp_valid;
+    double pointer_jitter_usec;
+    double drift_ppm;
+    pa_usec_t granularity_usec;
+};
+
+static pa_usec_t duration = 10 * PA_USEC_PER_SEC;
+static int rtprio = 5, load_priority = 1, only_card = -1;
+static unsigned load_msec = 5;
+static volatile pa_bool_t quit = FALSE;
+
+static pa_usec_t now_usec(void) {
+    struct timespec ts;
+
+    pa_assert_se(clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
+    return (pa_usec_t) ts.tv_sec * PA_USEC_PER_SEC + (pa_usec_t) ts.tv_nsec / PA_NSEC_PER_USEC;
+}
+
+static void sleep_until(pa_usec_t t) {
+    struct timespec ts;
+
+    ts.tv_sec = (time_t) (t / PA_USEC_PER_SEC);
+    ts.tv_nsec = (long) ((t % PA_USEC_PER_SEC) * PA_NSEC_PER_USEC);
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+}
+
+static void stats_add(struct stats *s, pa_usec_t v) {
+    if (s->n < MAX_SAMPLES)
+        s->values[s->n++] = v;
+}
+
+static int usec_compare(const void *a, const void *b) {
+    pa_usec_t x = *(const pa_usec_t*) a, y = *(const pa_usec_t*) b;
+
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/* per_mille of 1000 is the maximum */
+static pa_usec_t stats_percentile(struct stats *s, unsigned per_mille) {
+    if (s->n == 0)
+        return 0;
+
+    qsort(s->values, s->n, sizeof(pa_usec_t), usec_compare);
+    return s->values[PA_MIN((s->n * per_mille) / 1000, s->n - 1)];
+}
+
+static void print_stats(const char *what, struct stats *s) {
+    printf("%-28s p50 %6.2f ms  p99 %6.2f ms  p99.9 %6.2f ms  max %6.2f ms  (%u wakeups)\n", what,
+           (double) stats_percentile(s, 500) / PA_USEC_PER_MSEC,
+           (double) stats_percentile(s, 990) / PA_USEC_PER_MSEC,
+           (double) stats_percentile(s, 999) / PA_USEC_PER_MSEC,
+           (double) stats_percentile(s, 1000) / PA_USEC_PER_MSEC,
+           s->n);
+}
+
+static pa_usec_t random_usec(pa_usec_t lower, pa_usec_t upper) {
+    return lower + (pa_usec_t) ((double) rand() / RAND_MAX * (double) (upper - lower));
+}
+
+/* The load, one thread per CPU that keeps the CPU busy for up to
+ * load_msec at a time, and sleeps a while in between */
+static void load_thread(void *p) {
+    unsigned cpu = PA_PTR_TO_UINT(p);
+
+    if (load_priority > 0 && pa_make_realtime(load_priority) < 0)
+        pa_log_warn("CPU%u: Failed to make the load realtime.", cpu);
+
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+{
+    cpu_set_t mask;
+
+    CPU_ZERO(&mask);
+    CPU_SET((size_t) cpu, &mask);
+    pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+}
+#endif
+
+    while (!quit) {
+        pa_usec_t end;
+
+        end = now_usec() + random_usec(0, load_msec * PA_USEC_PER_MSEC);
+        while (now_usec() < end)
+            ;
+
+        pa_msleep((unsigned long) (rand() % (int) (2 * load_msec + 1)));
+    }
+}
+
+static void measure_wakeups(struct stats *s) {
+    pa_usec_t end;
+
+    s->n = 0;
+    end = now_usec() + duration;
+
+    while (now_usec() < end) {
+        pa_usec_t target, woken;
+
+        target = now_usec() + random_usec(WAKEUP_MIN_USEC, WAKEUP_MAX_USEC);
+        sleep_until(target);
+        woken = now_usec();
+
+        stats_add(s, woken > target ? woken - target : 0);
+    }
+}
+
+static uint64_t timespec_usec(const snd_htimestamp_t *ts) {
+    return (uint64_t) ts->tv_sec * PA_USEC_PER_SEC + (uint64_t) ts->tv_nsec / PA_NSEC_PER_USEC;
+}
+
+static int open_card(struct card_result *r, snd_pcm_t **pcm, snd_pcm_uframes_t *buffer_size) {
+    snd_pcm_hw_params_t *hwparams;
+    snd_pcm_sw_params_t *swparams;
+    snd_pcm_uframes_t boundary;
+    unsigned rate = sample_spec.rate;
+    char dev[32];
+    int err;
+
+    snd_pcm_hw_params_alloca(&hwparams);
+    snd_pcm_sw_params_alloca(&swparams);
+
+    /* What the daemon would open too */
+    pa_snprintf(dev, sizeof(dev), "front:%i", r->index);
+
+    if ((err = snd_pcm_open(pcm, dev, SND_PCM_STREAM_PLAYBACK, SND_PCM_NONBLOCK)) < 0) {
+        pa_log("Failed to open %s: %s", dev, snd_strerror(err));
+        return -1;
+    }
+
+    *buffer_size = (snd_pcm_uframes_t) (PLAYBACK_BUFFER_USEC * sample_spec.rate / PA_USEC_PER_SEC);
+
+    if ((err = snd_pcm_hw_params_any(*pcm, hwparams)) < 0 ||
+        (err = snd_pcm_hw_params_set_rate_resample(*pcm, hwparams, 0)) < 0 ||
+        (err = snd_pcm_hw_params_set_access(*pcm, hwparams, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0 ||
+        (err = snd_pcm_hw_params_set_format(*pcm, hwparams, SND_PCM_FORMAT_S16_LE)) < 0 ||
+        (err = snd_pcm_hw_params_set_rate_near(*pcm, hwparams, &rate, NULL)) < 0 ||
+        (err = snd_pcm_hw_params_set_channels(*pcm, hwparams, sample_spec.channels)) < 0 ||
+        (err = snd_pcm_hw_params_set_buffer_size_near(*pcm, hwparams, buffer_size)) < 0 ||
+        (err = snd_pcm_hw_params(*pcm, hwparams)) < 0) {
+        pa_log("Failed to set the hardware parameters of %s: %s", dev, snd_strerror(err));
+        goto fail;
+    }
+
+    if (rate != sample_spec.rate) {
+        pa_log("%s doesn't do %u Hz.", dev, sample_spec.rate);
+        goto fail;
+    }
+
+    /* No interrupts to wait for, we only wake up by the timer */
+    if ((err = snd_pcm_sw_params_current(*pcm, swparams)) < 0 ||
+        (err = snd_pcm_sw_params_set_avail_min(*pcm, swparams, *buffer_size)) < 0 ||
+        (err = snd_pcm_sw_params_set_period_event(*pcm, swparams, 0)) < 0 ||
+        (err = snd_pcm_sw_params_set_start_threshold(*pcm, swparams, *buffer_size)) < 0 ||
+        (err = snd_pcm_sw_params_get_boundary(swparams, &boundary)) < 0 ||
+        (err = snd_pcm_sw_params_set_stop_threshold(*pcm, swparams, boundary)) < 0 ||
+        (err = snd_pcm_sw_params_set_tstamp_mode(*pcm, swparams, SND_PCM_TSTAMP_ENABLE)) < 0 ||
+        (err = snd_pcm_sw_params(*pcm, swparams)) < 0 ||
+        (err = snd_pcm_prepare(*pcm)) < 0) {
+        pa_log("Failed to set the software parameters of %s: %s", dev, snd_strerror(err));
+        goto fail;
+    }
+
+    return 0;
+
+fail:
+    snd_pcm_close(*pcm);
+    return -1;
+}
+
+/* Writes silence until the buffer is full */
+static int fill(snd_pcm_t *pcm, snd_pcm_uframes_t frames, int64_t *written) {
+    static const int16_t silence[2 * 1024];
+
+    while (frames > 0) {
+        snd_pcm_sframes_t n;
+
+        n = snd_pcm_writei(pcm, silence, PA_MIN(frames, (snd_pcm_uframes_t) (PA_ELEMENTSOF(silence) / 2)));
+
+        if (n == -EAGAIN)
+            return 0;
+
+        if (n < 0)
+            return (int) n;
+
+        frames -= (snd_pcm_uframes_t) n;
+        *written += n;
+    }
+
+    return 0;
+}
+
+static void measure_card(struct card_result *r) {
+    snd_pcm_t *pcm;
+    snd_pcm_status_t *status;
+    snd_pcm_uframes_t buffer_size;
+    pa_usec_t end, t0 = 0, last_t = 0;
+    int64_t written = 0, last_pos = -1;
+    double *ts, *ps;
+    unsigned n = 0, i;
+    double mt, mp, sxx, sxy, slope, max_residual;
+    int err;
+
+    snd_pcm_status_alloca(&status);
+
+    if (open_card(r, &pcm, &buffer_size) < 0)
+        return;
+
+    ts = pa_xnew(double, MAX_SAMPLES);
+    ps = pa_xnew(double, MAX_SAMPLES);
+
+    r->granularity_usec = (pa_usec_t) -1;
+    r->htstamp_valid = TRUE;
+
+    if ((err = fill(pcm, buffer_size, &written)) < 0 || (err = snd_pcm_start(pcm)) < 0) {
+        pa_log("Failed to start playback on card %i: %s", r->index, snd_strerror(err));
+        goto finish;
+    }
+
+    end = now_usec() + duration;
+
+    while (now_usec() < end && n < MAX_SAMPLES) {
+        pa_usec_t target, woken, t;
+        snd_pcm_sframes_t avail, delay;
+        snd_htimestamp_t htstamp;
+        int64_t pos;
+
+        target = now_usec() + PLAYBACK_SLEEP_USEC;
+        sleep_until(target);
+        woken = now_usec();
+        stats_add(&r->wakeups, woken > target ? woken - target : 0);
+
+        if ((err = snd_pcm_status(pcm, status)) < 0) {
+            pa_log("snd_pcm_status() failed on card %i: %s", r->index, snd_strerror(err));
+            goto finish;
+        }
+
+        if (snd_pcm_status_get_state(status) == SND_PCM_STATE_XRUN) {
+            /* The measurement starts over, positions before don't fit */
+            r->xruns++;
+            n = 0;
+            last_pos = -1;
+            written = 0;
+
+            if ((err = snd_pcm_prepare(pcm)) < 0 ||
+                (err = fill(pcm, buffer_size, &written)) < 0 ||
+                (err = snd_pcm_start(pcm)) < 0) {
+                pa_log("Failed to recover from an underrun on card %i: %s", r->index, snd_strerror(err));
+                goto finish;
+            }
+
+            continue;
+        }
+
+        avail = snd_pcm_status_get_avail(status);
+        delay = snd_pcm_status_get_delay(status);
+        snd_pcm_status_get_htstamp(status, &htstamp);
+
+        /* Where the card is, and when it was there */
+        pos = written - delay;
+        t = timespec_usec(&htstamp);
+
+        if (t == 0 || (last_t > 0 && t == last_t && pos != last_pos))
+            r->htstamp_valid = FALSE;
+
+        if (!r->htstamp_valid)
+            t = woken;
+
+        if (n == 0)
+            t0 = t;
+
+        /* A pointer that is only updated at interrupts moves in steps
+         * of a period, sleeps won't show smaller steps than that */
+        if (last_pos >= 0 && pos > last_pos)
+            r->granularity_usec = PA_MIN(r->granularity_usec, (pa_usec_t) ((pos - last_pos) * (int64_t) PA_USEC_PER_SEC / sample_spec.rate));
+
+        ts[n] = (double) (t - t0);
+        ps[n] = (double) pos * PA_USEC_PER_SEC / sample_spec.rate;
+        n++;
+
+        last_pos = pos;
+        last_t = t;
+
+        if ((err = fill(pcm, (snd_pcm_uframes_t) PA_MAX(avail, 0), &written)) < 0) {
+            pa_log("Failed to write to card %i: %s", r->index, snd_strerror(err));
+            goto finish;
+        }
+    }
+
+    if (n < 10) {
+        pa_log("Not enough data from card %i.", r->index);
+        goto finish;
+    }
+
+    /* The clock of the card runs at its own speed, so the positions are
+     * compared to the line that fits them best */
+    for (mt = mp = 0, i = 0; i < n; i++) {
+        mt += ts[i];
+        mp += ps[i];
+    }
+
+    mt /= n;
+    mp /= n;
+
+    for (sxx = sxy = 0, i = 0; i < n; i++) {
+        sxx += (ts[i] - mt) * (ts[i] - mt);
+        sxy += (ts[i] - mt) * (ps[i] - mp);
+    }
+
+    slope = sxx > 0 ? sxy / sxx : 1.0;
+
+    for (max_residual = 0, i = 0; i < n; i++)
+        max_residual = PA_MAX(max_residual, fabs(ps[i] - (mp + slope * (ts[i] - mt))));
+
+    r->pointer_jitter_usec = max_residual;
+    r->drift_ppm = (slope - 1.0) * 1000000.0;
+    r->ok = TRUE;
+
+    if (r->granularity_usec == (pa_usec_t) -1)
+        r->granularity_usec = 0;
+
+finish:
+    pa_xfree(ts);
+    pa_xfree(ps);
+
+    snd_pcm_drop(pcm);
+    snd_pcm_close(pcm);
+}
+
+static pa_usec_t round_up_msec(double usec) {
+    return ((pa_usec_t) usec + PA_USEC_PER_MSEC - 1) / PA_USEC_PER_MSEC * PA_USEC_PER_MSEC;
+}
+
+static void help(const char *argv0) {
+    printf("%s [options]\n\n"
+           "-h, --help                Show this help\n"
+           "    --duration=SEC        How long each measurement takes (default %u)\n"
+           "    --rtprio=N            Realtime priority to measure with (default %i)\n"
+           "    --load-priority=N     Realtime priority of the load, 0 for none (default %i)\n"
+           "    --load-msec=N         Longest burst of the load (default %u)\n"
+           "    --card=N              Only measure this card\n",
+           argv0, (unsigned) (duration / PA_USEC_PER_SEC), rtprio, load_priority, load_msec);
+}
+
+enum {
+    ARG_DURATION = 256,
+    ARG_RTPRIO,
+    ARG_LOAD_PRIORITY,
+    ARG_LOAD_MSEC,
+    ARG_CARD
+};
+
+int main(int argc, char *argv[]) {
+    static const struct option long_options[] = {
+        {"help",          0, NULL, 'h'},
+        {"duration",      1, NULL, ARG_DURATION},
+        {"rtprio",        1, NULL, ARG_RTPRIO},
+        {"load-priority", 1, NULL, ARG_LOAD_PRIORITY},
+        {"load-msec",     1, NULL, ARG_LOAD_MSEC},
+        {"card",          1, NULL, ARG_CARD},
+        {NULL,            0, NULL, 0}
+    };
+
+    static struct stats other, rt;
+    struct card_result *cards = NULL;
+    unsigned n_cards = 0, i;
+    pa_thread **threads;
+    pa_bool_t realtime;
+    pa_usec_t wakeup, fragment;
+    int32_t v;
+    uint32_t u;
+    int c, card;
+
+    pa_log_set_level(PA_LOG_INFO);
+
+    while ((c = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+
+        switch (c) {
+            case 'h':
+                help(argv[0]);
+                return 0;
+
+            case ARG_DURATION:
+                if (pa_atou(optarg, &u) < 0 || u == 0) {
+                    pa_log("Invalid duration: %s", optarg);
+                    return 1;
+                }
+                duration = u * PA_USEC_PER_SEC;
+                break;
+
+            case ARG_RTPRIO:
+                if (pa_atoi(optarg, &v) < 0 || v < 1 || v > 99) {
+                    pa_log("Invalid realtime priority: %s", optarg);
+                    return 1;
+                }
+                rtprio = v;
+                break;
+
+            case ARG_LOAD_PRIORITY:
+                if (pa_atoi(optarg, &v) < 0 || v < 0 || v > 99) {
+                    pa_log("Invalid load priority: %s", optarg);
+                    return 1;
+                }
+                load_priority = v;
+                break;
+
+            case ARG_LOAD_MSEC:
+                if (pa_atou(optarg, &u) < 0 || u == 0) {
+                    pa_log("Invalid load: %s", optarg);
+                    return 1;
+                }
+                load_msec = u;
+                break;
+
+            case ARG_CARD:
+                if (pa_atoi(optarg, &v) < 0 || v < 0) {
+                    pa_log("Invalid card: %s", optarg);
+                    return 1;
+                }
+                only_card = v;
+                break;
+
+            default:
+                help(argv[0]);
+                return 1;
+        }
+    }
+
+    srand((unsigned) time(NULL));
+
+    /* One CPU stays free of the load, as it would be for the daemon
+     * on most desktops */
+    threads = pa_xnew0(pa_thread*, pa_ncpus());
+    for (i = 1; i < pa_ncpus(); i++)
+        pa_assert_se(threads[i] = pa_thread_new("load", load_thread, PA_UINT_TO_PTR(i)));
+
+    pa_log_info("Measuring wakeups without realtime scheduling.");
+    measure_wakeups(&other);
+
+    if (!(realtime = pa_make_realtime(rtprio) >= 0))
+        pa_log_warn("Failed to get realtime priority %i, the cards are measured without.", rtprio);
+    else {
+        pa_log_info("Measuring wakeups with realtime priority %i.", rtprio);
+        measure_wakeups(&rt);
+    }
+
+    for (card = -1; snd_card_next(&card) >= 0 && card >= 0;) {
+        struct card_result *r;
+        char *id = NULL, *name = NULL;
+
+        if (only_card >= 0 && card != only_card)
+            continue;
+
+        cards = pa_xrenew(struct card_result, cards, n_cards + 1);
+        r = &cards[n_cards++];
+        memset(r, 0, sizeof(*r));
+
+        r->index = card;
+
+        if (snd_card_get_name(card, &name) >= 0) {
+            r->name = pa_xstrdup(name);
+            free(name);
+        }
+
+        /* The id is what the udev rules match, unlike the index it
+         * doesn't change with the order the cards show up in */
+        id = pa_sprintf_malloc("/sys/class/sound/card%i/id", card);
+        r->id = pa_read_line_from_file(id);
+        pa_xfree(id);
+
+        pa_log_info("Measuring card %i (%s).", card, r->name ? r->name : "unknown");
+        measure_card(r);
+    }
+
+    quit = TRUE;
+    for (i = 1; i < pa_ncpus(); i++)
+        pa_thread_free(threads[i]);
+    pa_xfree(threads);
+
+    printf("\n");
+    print_stats("Wakeups, no realtime:", &other);
+    if (realtime)
+        print_stats("Wakeups, realtime:", &rt);
+
+    /* What the daemon's threads have to put up with */
+    wakeup = stats_percentile(realtime ? &rt : &other, 999);
+    fragment = PA_MAX(round_up_msec(2.0 * (double) wakeup), 5 * PA_USEC_PER_MSEC);
+
+    for (i = 0; i < n_cards; i++) {
+        struct card_result *r = &cards[i];
+
+        printf("\nCard %i: %s (%s)\n", r->index, r->name ? r->name : "unknown", r->id ? r->id : "no id");
+
+        if (!r->ok) {
+            printf("  Not measured.\n");
+            continue;
+        }
+
+        print_stats("  Wakeups while playing:", &r->wakeups);
+        printf("  Pointer jitter %0.2f ms, smallest step %0.2f ms, clock drift %+0.0f ppm, %u underruns\n",
+               r->pointer_jitter_usec / PA_USEC_PER_MSEC,
+               (double) r->granularity_usec / PA_USEC_PER_MSEC,
+               r->drift_ppm, r->xruns);
+        printf("  Timestamps: %s\n", r->htstamp_valid ? "good" : "missing or stale");
+    }
+
+    printf("\n; daemon.conf\n");
+
+    /* If it brings the wakeups down it's worth it */
+    if (realtime && stats_percentile(&rt, 990) * 2 < stats_percentile(&other, 990)) {
+        int prio = PA_MAX(rtprio, load_priority + 1);
+
+        printf("realtime-scheduling = yes\n"
+               "realtime-priority = %i\n", prio);
+
+        if (prio > 9)
+            printf("rlimit-rtprio = %i\n", prio);
+    } else if (realtime)
+        printf("; realtime scheduling made no difference\n");
+    else
+        printf("; realtime scheduling wasn't available, and not measured\n");
+
+    printf("default-fragments = 4\n"
+           "default-fragment-size-msec = %u\n",
+           (unsigned) (fragment / PA_USEC_PER_MSEC));
+
+    printf("\n# udev rules, e.g. /etc/udev/rules.d/91-pulseaudio-local.rules\n");
+
+    for (i = 0; i < n_cards; i++) {
+        struct card_result *r = &cards[i];
+        pa_usec_t watermark;
+
+        if (!r->ok || !r->id)
+            continue;
+
+        printf("# %s\n", r->name ? r->name : r->id);
+
+        if (r->pointer_jitter_usec > MAX_POINTER_JITTER_USEC || r->xruns > 0) {
+            printf("SUBSYSTEM==\"sound\", KERNEL==\"card*\", ATTR{id}==\"%s\", ENV{PULSE_TSCHED}=\"0\", "
+                   "ENV{PULSE_FRAGMENTS}=\"4\", ENV{PULSE_FRAGMENT_SIZE}=\"%lu\"\n",
+                   r->id, (unsigned long) pa_usec_to_bytes(fragment, &sample_spec));
+            continue;
+        }
+
+        /* The daemon has to be done refilling before it runs dry, even
+         * if it wakes up late and the pointer was off */
+        watermark = round_up_msec(2.0 * ((double) PA_MAX(wakeup, stats_percentile(&r->wakeups, 999)) + r->pointer_jitter_usec));
+        watermark = PA_MAX(watermark, PA_USEC_PER_MSEC);
+
+        printf("SUBSYSTEM==\"sound\", KERNEL==\"card*\", ATTR{id}==\"%s\", ENV{PULSE_TSCHED}=\"1\", "
+               "ENV{PULSE_TSCHED_BUFFER_WATERMARK}=\"%lu\"   # %u ms, the default is %u ms\n",
+               r->id, (unsigned long) pa_usec_to_bytes(watermark, &sample_spec),
+               (unsigned) (watermark / PA_USEC_PER_MSEC), (unsigned) (DEFAULT_TSCHED_WATERMARK_USEC / PA_USEC_PER_MSEC));
+    }
+
+    for (i = 0; i < n_cards; i++) {
+        pa_xfree(cards[i].id);
+        pa_xfree(cards[i].name);
+    }
+    pa_xfree(cards);
+
+    return 0;
+}
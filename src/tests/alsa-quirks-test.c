@@ -0,0 +1,140 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include <modules/alsa/alsa-quirks.h>
+
+static const char database[] =
+    "; Comment\n"
+    "[Card snd_foo]\n"
+    "tsched = no\n"
+    "fragments = 4\n"
+    "\n"
+    "[Card snd_foo Special]\n"
+    "fragments = 8\n"
+    "fragment-size = 1024\n"
+    "\n"
+    "[Card snd_foobar]\n"
+    "tsched-buffer-watermark = 100\n"
+    "\n"
+    "[Card snd_bar Other]\n"
+    "fixed-latency-range = yes\n";
+
+static char *write_file(const char *contents) {
+    char *fn;
+    FILE *f;
+    int fd;
+
+    fn = pa_sprintf_malloc("%s/pulse-alsa-quirks-test-XXXXXX", pa_get_temp_dir());
+    pa_assert_se((fd = mkstemp(fn)) >= 0);
+    pa_assert_se(f = fdopen(fd, "w"));
+    pa_assert_se(fputs(contents, f) >= 0);
+    pa_assert_se(fclose(f) == 0);
+
+    return fn;
+}
+
+/* expected is NULL if the key must be missing */
+static void check(pa_proplist *p, const char *key, const char *expected) {
+    const char *v = pa_proplist_gets(p, key);
+
+    if (!expected)
+        pa_assert_se(!v);
+    else
+        pa_assert_se(v && pa_streq(v, expected));
+}
+
+static void test_broken(const char *contents) {
+    char *fn;
+
+    fn = write_file(contents);
+    pa_assert_se(!pa_alsa_quirks_parse(fn, "snd_foo", NULL));
+    pa_assert_se(unlink(fn) == 0);
+    pa_xfree(fn);
+}
+
+int main(int argc, char *argv[]) {
+    pa_proplist *p;
+    char *fn;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    fn = write_file(database);
+
+    /* The driver entry only */
+    pa_assert_se(p = pa_alsa_quirks_parse(fn, "snd_foo", "Generic"));
+    check(p, "tsched", "no");
+    check(p, "fragments", "4");
+    check(p, "fragment_size", NULL);
+    check(p, "tsched_buffer_watermark", NULL);
+    pa_proplist_free(p);
+
+    /* The card entry goes on top of it */
+    pa_assert_se(p = pa_alsa_quirks_parse(fn, "snd_foo", "Special"));
+    check(p, "tsched", "no");
+    check(p, "fragments", "8");
+    check(p, "fragment_size", "1024");
+    pa_proplist_free(p);
+
+    /* Neither prefixes of the driver nor other cards match */
+    pa_assert_se(p = pa_alsa_quirks_parse(fn, "snd_bar", "Generic"));
+    pa_assert_se(pa_proplist_isempty(p));
+    pa_proplist_free(p);
+
+    pa_assert_se(p = pa_alsa_quirks_parse(fn, "snd_bar", NULL));
+    pa_assert_se(pa_proplist_isempty(p));
+    pa_proplist_free(p);
+
+    pa_assert_se(p = pa_alsa_quirks_parse(fn, "snd_foobar", NULL));
+    check(p, "tsched_buffer_watermark", "100");
+    check(p, "tsched", NULL);
+    pa_proplist_free(p);
+
+    pa_assert_se(unlink(fn) == 0);
+    pa_xfree(fn);
+
+    /* A missing database has no quirks */
+    pa_assert_se(p = pa_alsa_quirks_parse("/nonexistent/quirks.conf", "snd_foo", NULL));
+    pa_assert_se(pa_proplist_isempty(p));
+    pa_proplist_free(p);
+
+    /* Broken entries are refused even if they are about other cards */
+    test_broken("tsched = no\n");
+    test_broken("[Mapping foo]\ntsched = no\n");
+    test_broken("[Card ]\ntsched = no\n");
+    test_broken("[Card snd_other]\ntsched = maybe\n");
+    test_broken("[Card snd_other]\nfragments = 0\n");
+    test_broken("[Card snd_other]\nperiods = 2\n");
+
+    return 0;
+}
@@ -23,28 +23,52 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
+#include <pulse/rtclock.h>
+
 #include <pulsecore/asyncmsgq.h>
 #include <pulsecore/thread.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
 
+#define N_ROUNDS 2000
+#define N_PER_ROUND 100
+
 enum {
     OPERATION_A,
     OPERATION_B,
     OPERATION_C,
+    OPERATION_DATA,
+    OPERATION_NOP,
     QUIT
 };
 
+struct payload {
+    unsigned seq;
+    char text[32];
+};
+
+static unsigned n_data = 0, n_data_freed = 0, n_nop = 0;
+
+static void payload_free(void *userdata) {
+    const struct payload *p = userdata;
+
+    /* Called with the copy in the message, which is still intact */
+    pa_assert_se(p->seq == n_data_freed);
+    n_data_freed++;
+}
+
 static void the_thread(void *_q) {
     pa_asyncmsgq *q = _q;
     int quit = 0;
 
     do {
         int code = 0;
+        void *data = NULL;
 
-        pa_assert_se(pa_asyncmsgq_get(q, NULL, &code, NULL, NULL, NULL, 1) == 0);
+        pa_assert_se(pa_asyncmsgq_get(q, NULL, &code, &data, NULL, NULL, 1) == 0);
 
         switch (code) {
 
@@ -60,6 +84,19 @@ static void the_thread(void *_q) {
                 pa_log_info("Operation C");
                 break;
 
+            case OPERATION_DATA: {
+                const struct payload *p = data;
+
+                pa_assert_se(p->seq == n_data);
+                pa_assert_se(strcmp(p->text, "payload") == 0);
+                n_data++;
+                break;
+            }
+
+            case OPERATION_NOP:
+                n_nop++;
+                break;
+
             case QUIT:
                 pa_log_info("quit");
                 quit = 1;
@@ -74,6 +111,8 @@ static void the_thread(void *_q) {
 int main(int argc, char *argv[]) {
     pa_asyncmsgq *q;
     pa_thread *t;
+    pa_usec_t start, elapsed;
+    unsigned i;
 
     pa_assert_se(q = pa_asyncmsgq_new(0));
 
@@ -94,6 +133,39 @@ int main(int argc, char *argv[]) {
 
     pa_thread_yield();
 
+    /* The payload is copied, so it may be changed right after posting */
+    for (i = 0; i < 3 * N_PER_ROUND; i++) {
+        struct payload p;
+
+        p.seq = i;
+        strcpy(p.text, "payload");
+        pa_asyncmsgq_post_data(q, NULL, OPERATION_DATA, &p, sizeof(p), 0, NULL, payload_free);
+        memset(&p, 0, sizeof(p));
+    }
+
+    pa_asyncmsgq_send(q, NULL, OPERATION_NOP, NULL, 0, NULL);
+    pa_assert_se(n_data == 3 * N_PER_ROUND);
+    pa_assert_se(n_data_freed == 3 * N_PER_ROUND);
+
+    /* Batches of posts, each finished by a send as in the IO threads */
+    start = pa_rtclock_now();
+
+    for (i = 0; i < N_ROUNDS; i++) {
+        unsigned j;
+
+        for (j = 0; j < N_PER_ROUND; j++)
+            pa_asyncmsgq_post(q, NULL, OPERATION_NOP, NULL, 0, NULL, NULL);
+
+        pa_asyncmsgq_send(q, NULL, OPERATION_NOP, NULL, 0, NULL);
+    }
+
+    elapsed = pa_rtclock_now() - start;
+    pa_assert_se(n_nop == 1 + N_ROUNDS * (N_PER_ROUND + 1));
+
+    pa_log_info("%u posts and %u sends took %llu usec, %0.1f nsec per message",
+                N_ROUNDS * N_PER_ROUND, N_ROUNDS, (unsigned long long) elapsed,
+                (double) elapsed * 1000.0 / (N_ROUNDS * (N_PER_ROUND + 1)));
+
     pa_log_info("Quit post");
     pa_asyncmsgq_post(q, NULL, QUIT, NULL, 0, NULL, NULL);
 
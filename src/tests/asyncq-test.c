@@ -23,13 +23,19 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
 #include <pulse/util.h>
+#include <pulse/xmalloc.h>
 #include <pulsecore/asyncq.h>
+#include <pulsecore/atomic.h>
 #include <pulsecore/thread.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/mutex.h>
 
 static void producer(void *_q) {
     pa_asyncq *q = _q;
@@ -65,9 +71,143 @@ static void consumer(void *_q) {
     pa_log_debug("popped end");
 }
 
+/* Several writers and readers on one queue. Items carry their writer
+ * and sequence number, and every item has to arrive exactly once. With a
+ * single reader each writer's items have to arrive in order, too. When a
+ * mutex is given, the writers serialize on it like pa_asyncmsgq used to
+ * do with a single-writer queue. */
+
+#define N_WRITERS_MAX 4
+#define N_READERS_MAX 4
+
+struct mq {
+    pa_asyncq *q;
+    pa_mutex *mutex;
+    unsigned n_items, n_writers, n_readers;
+    pa_atomic_t writers_done;
+    unsigned *seen;
+};
+
+struct writer {
+    struct mq *mq;
+    unsigned id;
+};
+
+struct reader {
+    struct mq *mq;
+    unsigned last[N_WRITERS_MAX];
+};
+
+#define ITEM(w, i) PA_UINT_TO_PTR(((i) << 3 | (w)) + 1)
+#define ITEM_WRITER(p) ((PA_PTR_TO_UINT(p) - 1) & 7)
+#define ITEM_INDEX(p) ((PA_PTR_TO_UINT(p) - 1) >> 3)
+#define END PA_UINT_TO_PTR((unsigned) -1)
+
+static void mq_writer(void *_w) {
+    struct writer *w = _w;
+    unsigned i;
+
+    for (i = 0; i < w->mq->n_items; i++) {
+        if (w->mq->mutex)
+            pa_mutex_lock(w->mq->mutex);
+
+        pa_assert_se(pa_asyncq_push(w->mq->q, ITEM(w->id, i), TRUE) == 0);
+
+        if (w->mq->mutex)
+            pa_mutex_unlock(w->mq->mutex);
+    }
+
+    /* The last writer tells all readers to stop */
+    if (pa_atomic_inc(&w->mq->writers_done) == (int) w->mq->n_writers - 1)
+        for (i = 0; i < w->mq->n_readers; i++) {
+            if (w->mq->mutex)
+                pa_mutex_lock(w->mq->mutex);
+
+            pa_assert_se(pa_asyncq_push(w->mq->q, END, TRUE) == 0);
+
+            if (w->mq->mutex)
+                pa_mutex_unlock(w->mq->mutex);
+        }
+}
+
+static void mq_reader(void *_r) {
+    struct reader *r = _r;
+    void *p;
+
+    while ((p = pa_asyncq_pop(r->mq->q, TRUE)) != END) {
+        unsigned w = ITEM_WRITER(p), i = ITEM_INDEX(p);
+
+        pa_assert_se(w < r->mq->n_writers && i < r->mq->n_items);
+
+        if (r->mq->n_readers == 1) {
+            pa_assert_se(i == r->last[w]);
+            r->last[w] = i + 1;
+        }
+
+        /* Each reader only counts its own, so no atomics are needed */
+        r->mq->seen[w * r->mq->n_items + i]++;
+    }
+}
+
+static void run_mq(const char *name, pa_bool_t mpmc, unsigned n_writers, unsigned n_readers, unsigned n_items) {
+    struct mq mq;
+    struct writer w[N_WRITERS_MAX];
+    struct reader r[N_READERS_MAX];
+    pa_thread *wt[N_WRITERS_MAX], *rt[N_READERS_MAX];
+    pa_usec_t t;
+    unsigned i;
+
+    pa_assert(n_writers <= N_WRITERS_MAX);
+    pa_assert(n_readers <= N_READERS_MAX);
+    pa_assert(mpmc || n_readers == 1);
+
+    pa_assert_se(mq.q = mpmc ? pa_asyncq_new_mpmc(0) : pa_asyncq_new(0));
+    mq.mutex = mpmc ? NULL : pa_mutex_new(FALSE, FALSE);
+    mq.n_items = n_items;
+    mq.n_writers = n_writers;
+    mq.n_readers = n_readers;
+    pa_atomic_store(&mq.writers_done, 0);
+    mq.seen = pa_xnew0(unsigned, n_writers * n_items);
+
+    t = pa_rtclock_now();
+
+    for (i = 0; i < n_readers; i++) {
+        r[i].mq = &mq;
+        memset(r[i].last, 0, sizeof(r[i].last));
+        pa_assert_se(rt[i] = pa_thread_new("reader", mq_reader, &r[i]));
+    }
+
+    for (i = 0; i < n_writers; i++) {
+        w[i].mq = &mq;
+        w[i].id = i;
+        pa_assert_se(wt[i] = pa_thread_new("writer", mq_writer, &w[i]));
+    }
+
+    for (i = 0; i < n_writers; i++)
+        pa_thread_free(wt[i]);
+    for (i = 0; i < n_readers; i++)
+        pa_thread_free(rt[i]);
+
+    t = pa_rtclock_now() - t;
+
+    for (i = 0; i < n_writers * n_items; i++)
+        pa_assert_se(mq.seen[i] == 1);
+
+    pa_log_info("%-30s %u writers, %u readers: %10.0f items/s", name, n_writers, n_readers,
+                (double) n_writers * n_items * PA_USEC_PER_SEC / PA_MAX(t, 1U));
+
+    pa_assert_se(!pa_asyncq_pop(mq.q, FALSE));
+
+    pa_xfree(mq.seen);
+    if (mq.mutex)
+        pa_mutex_free(mq.mutex);
+    pa_asyncq_free(mq.q, NULL);
+}
+
 int main(int argc, char *argv[]) {
     pa_asyncq *q;
     pa_thread *t1, *t2;
+    unsigned n_items = getenv("MAKE_CHECK") ? 20000 : 1000000;
 
     if (!getenv("MAKE_CHECK"))
         pa_log_set_level(PA_LOG_DEBUG);
@@ -82,5 +222,11 @@ int main(int argc, char *argv[]) {
 
     pa_asyncq_free(q, NULL);
 
+    run_mq("single-writer queue with mutex", FALSE, 1, 1, n_items);
+    run_mq("multiple-writer queue", TRUE, 1, 1, n_items);
+    run_mq("single-writer queue with mutex", FALSE, N_WRITERS_MAX, 1, n_items);
+    run_mq("multiple-writer queue", TRUE, N_WRITERS_MAX, 1, n_items);
+    run_mq("multiple-writer queue", TRUE, N_WRITERS_MAX, N_READERS_MAX, n_items);
+
     return 0;
 }
@@ -0,0 +1,194 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <pulse/mainloop.h>
+
+#include <pulsecore/block-filter.h>
+#include <pulsecore/core.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/sample-util.h>
+
+/* Feeds stereo chunks of random size through a filter that mixes them
+ * down to mono, and checks that the filter only sees whole, aligned
+ * blocks and that nothing gets lost or reordered. */
+
+#define N_CHUNKS 200
+#define MAX_CHUNK 300
+#define BLOCK_FRAMES 48
+
+static unsigned filtered = 0;
+
+static float sample(unsigned k, unsigned c) {
+    return ((k + 7 * c) % 1000) / 2000.0f;
+}
+
+static void mix(void *userdata, float *const in[], float *const out[], unsigned n) {
+    unsigned k;
+
+    pa_assert_se(n > 0 && n % BLOCK_FRAMES == 0);
+    pa_assert_se(((size_t) in[0] & 15) == 0);
+    pa_assert_se(((size_t) in[1] & 15) == 0);
+    pa_assert_se(((size_t) out[0] & 15) == 0);
+
+    for (k = 0; k < n; k++)
+        out[0][k] = in[0][k] + in[1][k];
+
+    filtered += n;
+}
+
+static void make_chunk(pa_mempool *pool, unsigned *next, pa_memchunk *c) {
+    float *d;
+    unsigned n, k;
+
+    n = 1 + (unsigned) (rand() % MAX_CHUNK);
+
+    c->index = 0;
+    c->length = n * 2 * sizeof(float);
+    c->memblock = pa_memblock_new(pool, c->length);
+
+    d = pa_memblock_acquire(c->memblock);
+    for (k = 0; k < n; k++, (*next)++) {
+        d[2 * k] = sample(*next, 0);
+        d[2 * k + 1] = sample(*next, 1);
+    }
+    pa_memblock_release(c->memblock);
+}
+
+static void check_chunk(pa_memchunk *c, unsigned *next) {
+    const float *d;
+    unsigned n, k;
+
+    n = (unsigned) (c->length / sizeof(float));
+    pa_assert_se(n % BLOCK_FRAMES == 0);
+
+    /* The filter passes the samples through untouched, so the sums
+     * must match bit by bit */
+    d = pa_memblock_acquire(c->memblock);
+    for (k = 0; k < n; k++, (*next)++) {
+        float e = sample(*next, 0) + sample(*next, 1);
+        pa_assert_se(memcmp(&d[k], &e, sizeof(e)) == 0);
+    }
+    pa_memblock_release(c->memblock);
+
+    pa_memblock_unref(c->memblock);
+}
+
+int main(int argc, char *argv[]) {
+    pa_mainloop *m;
+    pa_core *c;
+    pa_block_filter *f;
+    pa_sample_spec in_ss, out_ss;
+    pa_memchunk in, out;
+    unsigned next_in = 0, next_out = 0, i, n_ran;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    pa_assert_se(m = pa_mainloop_new());
+    pa_assert_se(c = pa_core_new(pa_mainloop_get_api(m), FALSE, 0, 0, 0));
+
+    in_ss.format = out_ss.format = PA_SAMPLE_FLOAT32NE;
+    in_ss.rate = out_ss.rate = 48000;
+    in_ss.channels = 2;
+    out_ss.channels = 1;
+
+    pa_assert_se(f = pa_block_filter_new(c, "block-filter-test", &in_ss, &out_ss, BLOCK_FRAMES, mix, NULL, NULL));
+    pa_assert_se(pa_block_filter_get_latency(f) == pa_bytes_to_usec((BLOCK_FRAMES - 1) * 2 * sizeof(float), &in_ss));
+    pa_assert_se(pa_block_filter_get_max_request(f, sizeof(float)) == BLOCK_FRAMES * 2 * sizeof(float));
+
+    pa_assert_se(pa_block_filter_pull(f, &out) < 0);
+
+    for (i = 0; i < N_CHUNKS; i++) {
+        make_chunk(c->mempool, &next_in, &in);
+        pa_block_filter_push(f, &in);
+        pa_memblock_unref(in.memblock);
+
+        while (pa_block_filter_pull(f, &out) >= 0)
+            check_chunk(&out, &next_out);
+
+        /* Everything but the incomplete block is out */
+        pa_assert_se(next_out == filtered);
+        pa_assert_se(next_in - next_out < BLOCK_FRAMES);
+        pa_assert_se(pa_block_filter_get_length(f) == (next_in - next_out) * 2 * sizeof(float));
+    }
+
+    /* Once the input has been silent for longer than the tail, the
+     * filter is skipped and flagged silence comes out. The incomplete
+     * block left over above isn't silent. */
+    pa_block_filter_set_tail(f, 2 * BLOCK_FRAMES);
+    n_ran = 0;
+
+    for (i = 0; i < 6; i++) {
+        unsigned before = filtered;
+
+        pa_silence_memchunk_get(&c->silence_cache, c->mempool, &in, &in_ss, BLOCK_FRAMES * 2 * sizeof(float));
+        pa_block_filter_push(f, &in);
+        pa_memblock_unref(in.memblock);
+
+        pa_assert_se(pa_block_filter_pull(f, &out) >= 0);
+        pa_assert_se(out.length == BLOCK_FRAMES * sizeof(float));
+
+        if (filtered > before)
+            n_ran++;
+        else {
+            static const float zero[BLOCK_FRAMES];
+            const float *d;
+
+            pa_assert_se(pa_memblock_is_silence(out.memblock));
+
+            d = (const float*) ((uint8_t*) pa_memblock_acquire(out.memblock) + out.index);
+            pa_assert_se(memcmp(d, zero, sizeof(zero)) == 0);
+            pa_memblock_release(out.memblock);
+        }
+
+        pa_memblock_unref(out.memblock);
+        pa_assert_se(pa_block_filter_pull(f, &out) < 0);
+    }
+
+    pa_assert_se(n_ran == (next_in > next_out ? 3U : 2U));
+
+    /* Real input is filtered again */
+    i = filtered;
+    while (filtered == i) {
+        make_chunk(c->mempool, &next_in, &in);
+        pa_block_filter_push(f, &in);
+        pa_memblock_unref(in.memblock);
+
+        while (pa_block_filter_pull(f, &out) >= 0) {
+            pa_assert_se(!pa_memblock_is_silence(out.memblock));
+            pa_memblock_unref(out.memblock);
+        }
+    }
+
+    pa_block_filter_free(f);
+
+    pa_core_unref(c);
+    pa_mainloop_free(m);
+
+    return 0;
+}
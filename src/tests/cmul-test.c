@@ -0,0 +1,157 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <math.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+
+#include <pulsecore/cpu-arm.h>
+#include <pulsecore/cpu-x86.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/sample-util.h>
+
+/* Compares the optimized complex multiplication kernels to the C
+ * versions, at all offsets and lengths around the register sizes. */
+
+#define N 1031
+
+static pa_cmul_real_func_t c_cmul_real;
+static pa_cmac_func_t c_cmac;
+
+static float random_float(void) {
+    return (float) (rand() - RAND_MAX / 2) / RAND_MAX;
+}
+
+static pa_bool_t close_enough(const float *a, const float *b, unsigned n) {
+    unsigned i;
+
+    for (i = 0; i < n; i++)
+        if (fabsf(a[i] - b[i]) > 1e-5f)
+            return FALSE;
+
+    return TRUE;
+}
+
+static void check_func(const char *name) {
+    static float a[2 * N + 2], b[2 * N + 2], h[N + 1], ref[2 * N + 2], out[2 * N + 2];
+    pa_cmul_real_func_t f_cmul_real = pa_get_cmul_real_func();
+    pa_cmac_func_t f_cmac = pa_get_cmac_func();
+    unsigned n, offset, i, rounds = getenv("MAKE_CHECK") ? 10 : 10000;
+    pa_usec_t t;
+
+    for (i = 0; i < 2 * N + 2; i++) {
+        a[i] = random_float();
+        b[i] = random_float();
+    }
+    for (i = 0; i < N + 1; i++)
+        h[i] = random_float();
+
+    /* An odd offset of complex values leaves them unaligned */
+    for (offset = 0; offset <= 1; offset++)
+        for (n = N - 20; n <= N; n++) {
+            for (i = 0; i < 2 * N + 2; i++)
+                ref[i] = out[i] = b[i];
+
+            c_cmul_real(ref + 2 * offset, h + offset, n);
+            f_cmul_real(out + 2 * offset, h + offset, n);
+            pa_assert_se(close_enough(ref, out, 2 * N + 2));
+
+            c_cmac(ref + 2 * offset, a + 2 * offset, b + 2 * offset, n);
+            f_cmac(out + 2 * offset, a + 2 * offset, b + 2 * offset, n);
+            pa_assert_se(close_enough(ref, out, 2 * N + 2));
+        }
+
+    t = pa_rtclock_now();
+    for (i = 0; i < rounds; i++)
+        f_cmac(out, a, b, N);
+    t = pa_rtclock_now() - t;
+    pa_log_info("%-4s cmac      %10.0f values/s", name, (double) N * rounds * PA_USEC_PER_SEC / PA_MAX(t, 1U));
+
+    t = pa_rtclock_now();
+    for (i = 0; i < rounds; i++)
+        f_cmul_real(out, h, N);
+    t = pa_rtclock_now() - t;
+    pa_log_info("%-4s cmul_real %10.0f values/s", name, (double) N * rounds * PA_USEC_PER_SEC / PA_MAX(t, 1U));
+}
+
+int main(int argc, char *argv[]) {
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    c_cmul_real = pa_get_cmul_real_func();
+    c_cmac = pa_get_cmac_func();
+
+    /* (1 + 2i) * (3 - i) = 5 + 5i */
+    {
+        float acc[2] = { 1, 1 }, x[2] = { 1, 2 }, y[2] = { 3, -1 };
+        const float expected[2] = { 6, 6 };
+
+        c_cmac(acc, x, y, 1);
+        pa_assert_se(close_enough(acc, expected, 2));
+    }
+
+    check_func("C");
+
+#if defined (__i386__) || defined (__amd64__)
+    {
+        pa_cpu_x86_flag_t flags = 0;
+
+        pa_cpu_init_x86(&flags);
+
+        pa_set_cmul_real_func(c_cmul_real);
+        pa_set_cmac_func(c_cmac);
+        pa_cmul_func_init_sse(flags);
+        if (pa_get_cmac_func() != c_cmac)
+            check_func("SSE");
+
+        pa_set_cmul_real_func(c_cmul_real);
+        pa_set_cmac_func(c_cmac);
+        pa_cmul_func_init_avx(flags);
+        if (pa_get_cmac_func() != c_cmac)
+            check_func("AVX");
+    }
+#endif
+
+#if defined (__arm__)
+    {
+        pa_cpu_arm_flag_t flags = 0;
+
+        pa_cpu_init_arm(&flags);
+
+        pa_set_cmul_real_func(c_cmul_real);
+        pa_set_cmac_func(c_cmac);
+        pa_cmul_func_init_neon(flags);
+        if (pa_get_cmac_func() != c_cmac)
+            check_func("NEON");
+    }
+#endif
+
+    pa_set_cmul_real_func(c_cmul_real);
+    pa_set_cmac_func(c_cmac);
+
+    return 0;
+}
@@ -0,0 +1,190 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/database.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+/* Rewrites and removes entries over several syncs, enough for the
+ * backends that keep a log to compact it, and checks what comes back
+ * after reopening. */
+
+#define N_ENTRIES 2000
+#define N_ROUNDS 20
+
+static void set(pa_database *db, unsigned k, unsigned round, pa_bool_t overwrite, int result) {
+    char key[32], value[64];
+    pa_datum kd, vd;
+
+    pa_snprintf(key, sizeof(key), "key-%u", k);
+    pa_snprintf(value, sizeof(value), "value-%u-round-%u", k, round);
+
+    kd.data = key;
+    kd.size = strlen(key);
+    vd.data = value;
+    vd.size = strlen(value) + 1;
+
+    pa_assert_se(pa_database_set(db, &kd, &vd, overwrite) == result);
+}
+
+static void unset(pa_database *db, unsigned k, int result) {
+    char key[32];
+    pa_datum kd;
+
+    pa_snprintf(key, sizeof(key), "key-%u", k);
+    kd.data = key;
+    kd.size = strlen(key);
+
+    pa_assert_se(pa_database_unset(db, &kd) == result);
+}
+
+/* round is -1 if the key must be missing */
+static void check(pa_database *db, unsigned k, int round) {
+    char key[32], value[64];
+    pa_datum kd, vd;
+
+    pa_snprintf(key, sizeof(key), "key-%u", k);
+    kd.data = key;
+    kd.size = strlen(key);
+
+    if (round < 0) {
+        pa_assert_se(!pa_database_get(db, &kd, &vd));
+        return;
+    }
+
+    pa_snprintf(value, sizeof(value), "value-%u-round-%u", k, round);
+
+    pa_assert_se(pa_database_get(db, &kd, &vd));
+    pa_assert_se(vd.size == strlen(value) + 1);
+    pa_assert_se(memcmp(vd.data, value, vd.size) == 0);
+    pa_datum_free(&vd);
+}
+
+static void remove_dir(const char *dir) {
+    DIR *d;
+    struct dirent *de;
+
+    pa_assert_se(d = opendir(dir));
+
+    while ((de = readdir(d))) {
+        char *fn;
+
+        if (pa_streq(de->d_name, ".") || pa_streq(de->d_name, ".."))
+            continue;
+
+        fn = pa_sprintf_malloc("%s/%s", dir, de->d_name);
+        pa_assert_se(unlink(fn) == 0);
+        pa_xfree(fn);
+    }
+
+    closedir(d);
+    pa_assert_se(rmdir(dir) == 0);
+}
+
+int main(int argc, char *argv[]) {
+    pa_database *db;
+    char *dir, *fn;
+    pa_datum key, next;
+    unsigned k, round, n;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    dir = pa_sprintf_malloc("%s/pulse-database-test-XXXXXX", pa_get_temp_dir());
+    pa_assert_se(mkdtemp(dir));
+    fn = pa_sprintf_malloc("%s/test", dir);
+
+    pa_assert_se(db = pa_database_open(fn, TRUE));
+    pa_assert_se(pa_database_size(db) == 0);
+
+    for (k = 0; k < N_ENTRIES; k++)
+        set(db, k, 0, FALSE, 0);
+
+    set(db, 0, 1, FALSE, -1);
+    pa_assert_se(pa_database_sync(db) == 0);
+
+    /* Rewrite a different tenth of the entries each round */
+    for (round = 1; round < N_ROUNDS; round++) {
+        for (k = round % 10; k < N_ENTRIES; k += 10)
+            set(db, k, round, TRUE, 0);
+
+        pa_assert_se(pa_database_sync(db) == 0);
+    }
+
+    for (k = 1; k < N_ENTRIES; k += 2)
+        unset(db, k, 0);
+
+    unset(db, 1, -1);
+    pa_database_close(db);
+
+    pa_assert_se(db = pa_database_open(fn, FALSE));
+    pa_assert_se(pa_database_size(db) == N_ENTRIES / 2);
+
+    for (k = 0; k < N_ENTRIES; k++)
+        check(db, k, k % 2 ? -1 : (int) (k % 10 + 10));
+
+    /* Iteration visits every entry once */
+    n = 0;
+    pa_assert_se(pa_database_first(db, &key, NULL));
+    do {
+        n++;
+        if (!pa_database_next(db, &key, &next, NULL)) {
+            pa_datum_free(&key);
+            break;
+        }
+
+        pa_datum_free(&key);
+        key = next;
+    } while (TRUE);
+    pa_assert_se(n == N_ENTRIES / 2);
+
+    set(db, 0, 1, TRUE, -1);
+    pa_database_close(db);
+
+    /* A clear is persistent as well */
+    pa_assert_se(db = pa_database_open(fn, TRUE));
+    pa_assert_se(pa_database_clear(db) == 0);
+    set(db, 7, 1, FALSE, 0);
+    pa_database_close(db);
+
+    pa_assert_se(db = pa_database_open(fn, FALSE));
+    pa_assert_se(pa_database_size(db) == 1);
+    check(db, 0, -1);
+    check(db, 7, 1);
+    pa_database_close(db);
+
+    remove_dir(dir);
+    pa_xfree(fn);
+    pa_xfree(dir);
+
+    return 0;
+}
@@ -0,0 +1,865 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <getopt.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/sample.h>
+#include <pulse/timeval.h>
+#include <pulse/volume.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-rtclock.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/core-error.h>
+#include <pulsecore/cpu.h>
+#include <pulsecore/cpu-orc.h>
+#include <pulsecore/endianmacros.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/remap.h>
+#include <pulsecore/resampler.h>
+#include <pulsecore/sample-util.h>
+#include <pulsecore/sconv.h>
+
+/* Measures every implementation of the volume, mix, sample conversion
+ * and remap functions that this machine can run, for all the sample
+ * formats and a few channel counts, and every resampler method. Only
+ * the functions an implementation actually replaces are measured for
+ * it. For each one the time per frame and the speedup over the C
+ * version are printed.
+ *
+ * With --json one object per line is written instead, and with
+ * --compare the results are checked against such a file from an
+ * earlier run: if any case became slower than the tolerance allows the
+ * exit status is 1.
+ *
+ * Usage: dsp-bench [--json] [--compare FILE] [--tolerance PERCENT]
+ *                  [--min-time MSEC] */
+
+#define N_FRAMES 1024
+#define N_PADDING 32
+#define N_REPEAT 5
+#define N_STREAMS 2
+#define MAX_RESULTS 4096
+
+#define DEFAULT_MIN_USEC (20 * PA_USEC_PER_MSEC)
+#define DEFAULT_TOLERANCE 10.0
+
+struct result {
+    const char *op;
+    const char *impl;
+    char what[64];
+    unsigned channels;
+    double ns;
+    double speedup;
+};
+
+static struct result results[MAX_RESULTS];
+static unsigned n_results = 0;
+
+static pa_usec_t min_usec = DEFAULT_MIN_USEC;
+
+static const unsigned channel_counts[] = { 1, 2, 6 };
+
+/* Runs run() over and over until one batch took at least min_usec, and
+ * returns the fastest of N_REPEAT batches in nanoseconds per frame */
+static double measure(void (*run)(void *userdata), void *userdata, unsigned frames) {
+    unsigned rounds = 1, i, j;
+    double best = -1;
+    pa_usec_t t;
+
+    /* Warm up the caches and find out how many rounds we need */
+    for (;;) {
+        t = pa_rtclock_now();
+        for (j = 0; j < rounds; j++)
+            run(userdata);
+        t = pa_rtclock_now() - t;
+
+        if (t >= min_usec || rounds >= (1U << 30))
+            break;
+
+        rounds *= t > 0 ? PA_CLAMP((unsigned) (min_usec / t) + 1, 2U, 16U) : 16U;
+    }
+
+    for (i = 0; i < N_REPEAT; i++) {
+        double ns;
+
+        t = pa_rtclock_now();
+        for (j = 0; j < rounds; j++)
+            run(userdata);
+        t = pa_rtclock_now() - t;
+
+        ns = (double) t * 1000.0 / ((double) rounds * frames);
+
+        if (best < 0 || ns < best)
+            best = ns;
+    }
+
+    return best;
+}
+
+static void add_result(const char *op, const char *impl, const char *what, unsigned channels, double ns) {
+    struct result *r;
+
+    pa_assert_se(n_results < MAX_RESULTS);
+
+    r = &results[n_results++];
+    r->op = op;
+    r->impl = impl;
+    pa_snprintf(r->what, sizeof(r->what), "%s", what);
+    r->channels = channels;
+    r->ns = ns;
+    r->speedup = 0;
+}
+
+static struct result* find_result(struct result *table, unsigned n, const char *op, const char *impl, const char *what, unsigned channels) {
+    unsigned i;
+
+    for (i = 0; i < n; i++)
+        if (pa_streq(table[i].op, op) &&
+            pa_streq(table[i].impl, impl) &&
+            pa_streq(table[i].what, what) &&
+            table[i].channels == channels)
+            return &table[i];
+
+    return NULL;
+}
+
+static void calc_speedups(void) {
+    unsigned i;
+
+    for (i = 0; i < n_results; i++) {
+        struct result *c;
+
+        if ((c = find_result(results, n_results, results[i].op, "C", results[i].what, results[i].channels)) && results[i].ns > 0)
+            results[i].speedup = c->ns / results[i].ns;
+    }
+}
+
+static void fill_random(void *p, size_t length) {
+    uint8_t *b = p;
+    size_t i;
+
+    for (i = 0; i < length; i++)
+        b[i] = (uint8_t) rand();
+}
+
+/* Float samples must be in a sensible range, random bits could be
+ * NaNs or denormals, which many implementations handle far slower */
+static void fill_samples(pa_sample_format_t f, void *p, unsigned n) {
+    unsigned i;
+
+    if (f == PA_SAMPLE_FLOAT32NE || f == PA_SAMPLE_FLOAT32RE) {
+        float *d = p;
+
+        for (i = 0; i < n; i++) {
+            float v = (float) rand() / (float) RAND_MAX * 2.0f - 1.0f;
+            d[i] = f == PA_SAMPLE_FLOAT32NE ? v : PA_FLOAT32_SWAP(v);
+        }
+    } else
+        fill_random(p, n * pa_sample_size_of_format(f));
+}
+
+/* The functions that can be replaced by an implementation */
+
+enum {
+    SCONV_TO_FLOAT32NE,
+    SCONV_FROM_FLOAT32NE,
+    SCONV_TO_S16NE,
+    SCONV_FROM_S16NE,
+    SCONV_MAX
+};
+
+static pa_convert_func_t get_convert_func(unsigned dir, pa_sample_format_t f) {
+    switch (dir) {
+        case SCONV_TO_FLOAT32NE: return pa_get_convert_to_float32ne_function(f);
+        case SCONV_FROM_FLOAT32NE: return pa_get_convert_from_float32ne_function(f);
+        case SCONV_TO_S16NE: return pa_get_convert_to_s16ne_function(f);
+        case SCONV_FROM_S16NE: return pa_get_convert_from_s16ne_function(f);
+    }
+
+    pa_assert_not_reached();
+}
+
+static void set_convert_func(unsigned dir, pa_sample_format_t f, pa_convert_func_t func) {
+    switch (dir) {
+        case SCONV_TO_FLOAT32NE: pa_set_convert_to_float32ne_function(f, func); return;
+        case SCONV_FROM_FLOAT32NE: pa_set_convert_from_float32ne_function(f, func); return;
+        case SCONV_TO_S16NE: pa_set_convert_to_s16ne_function(f, func); return;
+        case SCONV_FROM_S16NE: pa_set_convert_from_s16ne_function(f, func); return;
+    }
+
+    pa_assert_not_reached();
+}
+
+struct func_set {
+    pa_do_volume_func_t volume[PA_SAMPLE_MAX];
+    pa_do_mix_func_t mix[PA_SAMPLE_MAX];
+    pa_convert_func_t convert[SCONV_MAX][PA_SAMPLE_MAX];
+    pa_init_remap_func_t init_remap;
+};
+
+static struct func_set c_funcs, daemon_funcs;
+
+static void save_funcs(struct func_set *s) {
+    pa_sample_format_t f;
+    unsigned dir;
+
+    for (f = 0; f < PA_SAMPLE_MAX; f++) {
+        s->volume[f] = pa_get_volume_func(f);
+        s->mix[f] = pa_get_mix_func(f);
+
+        for (dir = 0; dir < SCONV_MAX; dir++)
+            s->convert[dir][f] = get_convert_func(dir, f);
+    }
+
+    s->init_remap = pa_get_init_remap_func();
+}
+
+static void restore_funcs(const struct func_set *s) {
+    pa_sample_format_t f;
+    unsigned dir;
+
+    for (f = 0; f < PA_SAMPLE_MAX; f++) {
+        if (s->volume[f])
+            pa_set_volume_func(f, s->volume[f]);
+        if (s->mix[f])
+            pa_set_mix_func(f, s->mix[f]);
+
+        for (dir = 0; dir < SCONV_MAX; dir++)
+            if (s->convert[dir][f])
+                set_convert_func(dir, f, s->convert[dir][f]);
+    }
+
+    pa_set_init_remap_func(s->init_remap);
+}
+
+/* Volume */
+
+struct volume_ctx {
+    pa_do_volume_func_t func;
+    void *samples, *orig;
+    void *volumes;
+    unsigned channels;
+    size_t length;
+};
+
+static void run_volume(void *userdata) {
+    struct volume_ctx *c = userdata;
+
+    /* Restores the samples first, else they end up all 0 or clipped */
+    memcpy(c->samples, c->orig, c->length);
+    c->func(c->samples, c->volumes, c->channels, (unsigned) c->length);
+}
+
+static void bench_volume(const char *impl) {
+    pa_sample_format_t f;
+    unsigned i;
+
+    for (f = 0; f < PA_SAMPLE_MAX; f++) {
+        pa_do_volume_func_t func = pa_get_volume_func(f);
+
+        if (!func || (func == c_funcs.volume[f] && !pa_streq(impl, "C")))
+            continue;
+
+        for (i = 0; i < PA_ELEMENTSOF(channel_counts); i++) {
+            struct volume_ctx c;
+            union {
+                int32_t i[PA_CHANNELS_MAX + N_PADDING];
+                float f[PA_CHANNELS_MAX + N_PADDING];
+            } volumes;
+            unsigned ch;
+
+            c.func = func;
+            c.channels = channel_counts[i];
+            c.length = N_FRAMES * c.channels * pa_sample_size_of_format(f);
+            c.orig = pa_xmalloc(c.length);
+            c.samples = pa_xmalloc(c.length);
+            c.volumes = &volumes;
+
+            fill_samples(f, c.orig, N_FRAMES * c.channels);
+
+            for (ch = 0; ch < c.channels + N_PADDING; ch++) {
+                pa_volume_t v = (pa_volume_t) (rand() % PA_VOLUME_NORM);
+
+                if (ch >= c.channels)
+                    volumes.i[ch] = volumes.i[ch - c.channels];
+                else if (f == PA_SAMPLE_FLOAT32NE || f == PA_SAMPLE_FLOAT32RE)
+                    volumes.f[ch] = (float) pa_sw_volume_to_linear(v);
+                else
+                    volumes.i[ch] = (int32_t) lrint(pa_sw_volume_to_linear(v) * 0x10000);
+            }
+
+            add_result("volume", impl, pa_sample_format_to_string(f), c.channels, measure(run_volume, &c, N_FRAMES));
+
+            pa_xfree(c.orig);
+            pa_xfree(c.samples);
+        }
+    }
+}
+
+/* Mix */
+
+struct mix_ctx {
+    pa_do_mix_func_t func;
+    pa_mix_info streams[N_STREAMS];
+    void *data[N_STREAMS];
+    void *dst;
+    unsigned channels;
+    size_t length;
+};
+
+static void run_mix(void *userdata) {
+    struct mix_ctx *c = userdata;
+    unsigned k;
+
+    for (k = 0; k < N_STREAMS; k++)
+        c->streams[k].ptr = c->data[k];
+
+    c->func(c->streams, N_STREAMS, c->channels, c->dst, (uint8_t*) c->dst + c->length);
+}
+
+static void bench_mix(const char *impl) {
+    pa_sample_format_t f;
+    unsigned i, k, ch;
+
+    for (f = 0; f < PA_SAMPLE_MAX; f++) {
+        pa_do_mix_func_t func = pa_get_mix_func(f);
+
+        if (!func || (func == c_funcs.mix[f] && !pa_streq(impl, "C")))
+            continue;
+
+        for (i = 0; i < PA_ELEMENTSOF(channel_counts); i++) {
+            struct mix_ctx c;
+
+            memset(&c, 0, sizeof(c));
+            c.func = func;
+            c.channels = channel_counts[i];
+            c.length = N_FRAMES * c.channels * pa_sample_size_of_format(f);
+            c.dst = pa_xmalloc(c.length);
+
+            for (k = 0; k < N_STREAMS; k++) {
+                c.data[k] = pa_xmalloc(c.length);
+                fill_samples(f, c.data[k], N_FRAMES * c.channels);
+
+                for (ch = 0; ch < c.channels + PA_MIX_VOLUME_PADDING; ch++) {
+                    double v = pa_sw_volume_to_linear((pa_volume_t) (rand() % PA_VOLUME_NORM));
+
+                    if (ch >= c.channels)
+                        c.streams[k].linear[ch] = c.streams[k].linear[ch - c.channels];
+                    else if (f == PA_SAMPLE_FLOAT32NE || f == PA_SAMPLE_FLOAT32RE)
+                        c.streams[k].linear[ch].f = (float) v;
+                    else
+                        c.streams[k].linear[ch].i = (int32_t) lrint(v * 0x10000);
+                }
+            }
+
+            add_result("mix", impl, pa_sample_format_to_string(f), c.channels, measure(run_mix, &c, N_FRAMES));
+
+            for (k = 0; k < N_STREAMS; k++)
+                pa_xfree(c.data[k]);
+            pa_xfree(c.dst);
+        }
+    }
+}
+
+/* Sample conversion, the functions only see samples, so there is no
+ * point in different channel counts */
+
+struct convert_ctx {
+    pa_convert_func_t func;
+    void *src, *dst;
+};
+
+static void run_convert(void *userdata) {
+    struct convert_ctx *c = userdata;
+
+    c->func(N_FRAMES, c->src, c->dst);
+}
+
+static void bench_convert(const char *impl) {
+    pa_sample_format_t f;
+    unsigned dir;
+
+    for (dir = 0; dir < SCONV_MAX; dir++)
+        for (f = 0; f < PA_SAMPLE_MAX; f++) {
+            pa_convert_func_t func = get_convert_func(dir, f);
+            pa_sample_format_t other = dir < SCONV_TO_S16NE ? PA_SAMPLE_FLOAT32NE : PA_SAMPLE_S16NE;
+            pa_bool_t to = dir == SCONV_TO_FLOAT32NE || dir == SCONV_TO_S16NE;
+            struct convert_ctx c;
+            char what[64];
+
+            if (!func || f == other || (func == c_funcs.convert[dir][f] && !pa_streq(impl, "C")))
+                continue;
+
+            c.func = func;
+            c.src = pa_xmalloc(N_FRAMES * 4);
+            c.dst = pa_xmalloc(N_FRAMES * 4);
+            fill_samples(to ? f : other, c.src, N_FRAMES);
+
+            pa_snprintf(what, sizeof(what), "%s-%s",
+                        pa_sample_format_to_string(to ? f : other),
+                        pa_sample_format_to_string(to ? other : f));
+
+            add_result("sconv", impl, what, 1, measure(run_convert, &c, N_FRAMES));
+
+            pa_xfree(c.src);
+            pa_xfree(c.dst);
+        }
+}
+
+/* Remap */
+
+enum {
+    MATRIX_COPY,      /* every output channel is one input channel */
+    MATRIX_MIX        /* every output channel mixes all input channels */
+};
+
+static const struct {
+    unsigned i_channels, o_channels;
+    int kind;
+    const char *name;
+} remap_layouts[] = {
+    { 1, 2, MATRIX_COPY, "1to2" },
+    { 2, 1, MATRIX_MIX, "2to1" },
+    { 2, 6, MATRIX_COPY, "2to6" },
+    { 6, 2, MATRIX_MIX, "6to2" },
+    { 2, 2, MATRIX_MIX, "2to2" },
+};
+
+static const pa_sample_format_t remap_formats[] = {
+    PA_SAMPLE_S16NE,
+    PA_SAMPLE_FLOAT32NE
+};
+
+struct remap_ctx {
+    pa_remap_t m;
+    pa_sample_format_t format;
+    pa_sample_spec i_ss, o_ss;
+    void *src, *dst;
+};
+
+static void setup_remap(struct remap_ctx *c, pa_sample_format_t f, unsigned l) {
+    unsigned oc, ic;
+
+    memset(c, 0, sizeof(*c));
+    c->format = f;
+    c->i_ss.format = c->o_ss.format = f;
+    c->i_ss.rate = c->o_ss.rate = 44100;
+    c->i_ss.channels = (uint8_t) remap_layouts[l].i_channels;
+    c->o_ss.channels = (uint8_t) remap_layouts[l].o_channels;
+    c->m.format = &c->format;
+    c->m.i_ss = &c->i_ss;
+    c->m.o_ss = &c->o_ss;
+
+    for (oc = 0; oc < c->o_ss.channels; oc++)
+        for (ic = 0; ic < c->i_ss.channels; ic++) {
+            float vol;
+
+            if (remap_layouts[l].kind == MATRIX_COPY)
+                vol = ic == oc % c->i_ss.channels ? 1.0f : 0.0f;
+            else
+                vol = 1.0f / (float) c->i_ss.channels;
+
+            c->m.map_table_f[oc][ic] = vol;
+            c->m.map_table_i[oc][ic] = (int32_t) lrint(vol * 0x10000);
+        }
+
+    pa_init_remap(&c->m);
+}
+
+static void run_remap(void *userdata) {
+    struct remap_ctx *c = userdata;
+
+    c->m.do_remap(&c->m, c->dst, c->src, N_FRAMES);
+}
+
+static void bench_remap(const char *impl) {
+    unsigned i, l;
+    pa_init_remap_func_t func = pa_get_init_remap_func();
+
+    for (i = 0; i < PA_ELEMENTSOF(remap_formats); i++)
+        for (l = 0; l < PA_ELEMENTSOF(remap_layouts); l++) {
+            struct remap_ctx c;
+            char what[64];
+
+            if (!pa_streq(impl, "C")) {
+                pa_do_remap_func_t do_remap;
+
+                if (func == c_funcs.init_remap)
+                    return;
+
+                /* Skip the layouts this implementation leaves to C */
+                pa_set_init_remap_func(c_funcs.init_remap);
+                setup_remap(&c, remap_formats[i], l);
+                do_remap = c.m.do_remap;
+                pa_set_init_remap_func(func);
+
+                setup_remap(&c, remap_formats[i], l);
+
+                if (c.m.do_remap == do_remap)
+                    continue;
+            } else
+                setup_remap(&c, remap_formats[i], l);
+
+            c.src = pa_xmalloc(N_FRAMES * c.i_ss.channels * pa_sample_size_of_format(c.format));
+            c.dst = pa_xmalloc(N_FRAMES * c.o_ss.channels * pa_sample_size_of_format(c.format));
+            fill_samples(c.format, c.src, N_FRAMES * c.i_ss.channels);
+
+            pa_snprintf(what, sizeof(what), "%s-%s", pa_sample_format_to_string(c.format), remap_layouts[l].name);
+            add_result("remap", impl, what, c.i_ss.channels, measure(run_remap, &c, N_FRAMES));
+
+            pa_xfree(c.src);
+            pa_xfree(c.dst);
+        }
+}
+
+/* Resampler, every method with whatever the CPU detection installed */
+
+struct resampler_ctx {
+    pa_resampler *resampler;
+    pa_memchunk chunk;
+};
+
+static void run_resampler(void *userdata) {
+    struct resampler_ctx *c = userdata;
+    pa_memchunk out;
+
+    pa_resampler_run(c->resampler, &c->chunk, &out);
+
+    if (out.memblock)
+        pa_memblock_unref(out.memblock);
+}
+
+static void bench_resampler(pa_mempool *pool) {
+    pa_resample_method_t method;
+    unsigned i;
+
+    for (method = 0; method < PA_RESAMPLER_MAX; method++) {
+
+        /* auto picks one of the others, and copy only works without
+         * a change of the rate */
+        if (method == PA_RESAMPLER_AUTO || method == PA_RESAMPLER_COPY || !pa_resample_method_supported(method))
+            continue;
+
+        for (i = 0; i < PA_ELEMENTSOF(channel_counts); i++) {
+            struct resampler_ctx c;
+            pa_sample_spec a, b;
+
+            a.format = b.format = PA_SAMPLE_FLOAT32NE;
+            a.channels = b.channels = (uint8_t) channel_counts[i];
+            /* peaks can only reduce the rate */
+            a.rate = method == PA_RESAMPLER_PEAKS ? 48000 : 44100;
+            b.rate = method == PA_RESAMPLER_PEAKS ? 44100 : 48000;
+
+            if (!(c.resampler = pa_resampler_new(pool, NULL, &a, NULL, &b, NULL, method, 0)))
+                continue;
+
+            c.chunk.memblock = pa_memblock_new(pool, N_FRAMES * pa_frame_size(&a));
+            c.chunk.index = 0;
+            c.chunk.length = N_FRAMES * pa_frame_size(&a);
+            fill_samples(a.format, pa_memblock_acquire(c.chunk.memblock), N_FRAMES * a.channels);
+            pa_memblock_release(c.chunk.memblock);
+
+            add_result("resampler", "default", pa_resample_method_to_string(method), a.channels, measure(run_resampler, &c, N_FRAMES));
+
+            pa_memblock_unref(c.chunk.memblock);
+            pa_resampler_free(c.resampler);
+        }
+    }
+}
+
+/* Implementations */
+
+static void init_c(void) {
+}
+
+static pa_cpu_info cpu_info = { PA_CPU_UNDEFINED, { 0 } };
+
+#if defined (__i386__) || defined (__amd64__)
+static void init_mmx(void) {
+    pa_volume_func_init_mmx(cpu_info.flags.x86);
+    pa_remap_func_init_mmx(cpu_info.flags.x86);
+}
+
+static void init_sse(void) {
+    pa_volume_func_init_sse(cpu_info.flags.x86);
+    pa_mix_func_init_sse(cpu_info.flags.x86);
+    pa_convert_func_init_sse(cpu_info.flags.x86);
+    pa_remap_func_init_sse(cpu_info.flags.x86);
+}
+
+static void init_avx(void) {
+    pa_volume_func_init_avx(cpu_info.flags.x86);
+    pa_mix_func_init_avx(cpu_info.flags.x86);
+    pa_convert_func_init_avx(cpu_info.flags.x86);
+}
+#endif
+
+#if defined (__arm__)
+
+static void init_arm(void) {
+    pa_volume_func_init_arm(cpu_info.flags.arm);
+}
+
+static void init_neon(void) {
+    pa_volume_func_init_neon(cpu_info.flags.arm);
+    pa_mix_func_init_neon(cpu_info.flags.arm);
+    pa_convert_func_init_neon(cpu_info.flags.arm);
+}
+#endif
+
+#ifndef DISABLE_ORC
+static void init_orc(void) {
+    pa_volume_func_init_orc();
+    pa_mix_func_init_orc();
+    pa_convert_func_init_orc();
+    pa_remap_func_init_orc();
+}
+#endif
+
+static const struct {
+    const char *name;
+    void (*init)(void);
+} impls[] = {
+    { "C", init_c },
+#if defined (__i386__) || defined (__amd64__)
+    { "MMX", init_mmx },
+    { "SSE2", init_sse },
+    { "AVX2", init_avx },
+#endif
+#if defined (__arm__)
+    { "ARMv6", init_arm },
+    { "NEON", init_neon },
+#endif
+#ifndef DISABLE_ORC
+    { "Orc", init_orc },
+#endif
+};
+
+/* Output */
+
+static void print_table(void) {
+    unsigned i;
+
+    printf("%-10s %-8s %-28s %3s %12s %8s\n", "OP", "IMPL", "CASE", "CH", "NS/FRAME", "SPEEDUP");
+
+    for (i = 0; i < n_results; i++) {
+        struct result *r = &results[i];
+
+        if (r->speedup > 0)
+            printf("%-10s %-8s %-28s %3u %12.3f %7.2fx\n", r->op, r->impl, r->what, r->channels, r->ns, r->speedup);
+        else
+            printf("%-10s %-8s %-28s %3u %12.3f %8s\n", r->op, r->impl, r->what, r->channels, r->ns, "-");
+    }
+}
+
+static void print_json(void) {
+    unsigned i;
+
+    for (i = 0; i < n_results; i++) {
+        struct result *r = &results[i];
+
+        printf("{\"op\":\"%s\",\"impl\":\"%s\",\"case\":\"%s\",\"channels\":%u,\"ns_per_frame\":%.3f,\"speedup\":%.3f}\n",
+               r->op, r->impl, r->what, r->channels, r->ns, r->speedup);
+    }
+}
+
+/* Reads a file written with --json and returns the number of cases
+ * that are more than tolerance percent slower now, or -1 on error */
+static int compare(const char *fn, double tolerance) {
+    FILE *f;
+    char line[512];
+    int n_regressed = 0;
+    unsigned n_compared = 0;
+
+    if (!(f = pa_fopen_cloexec(fn, "r"))) {
+        pa_log("Failed to open baseline %s: %s", fn, pa_cstrerror(errno));
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), f)) {
+        char op[32], impl[32], what[64];
+        unsigned channels;
+        double ns;
+        struct result *r;
+
+        if (sscanf(line, "{\"op\":\"%31[^\"]\",\"impl\":\"%31[^\"]\",\"case\":\"%63[^\"]\",\"channels\":%u,\"ns_per_frame\":%lf",
+                   op, impl, what, &channels, &ns) != 5)
+            continue;
+
+        /* Cases that aren't there any more, e.g. because the baseline
+         * was made on a CPU with other extensions, are ignored */
+        if (!(r = find_result(results, n_results, op, impl, what, channels)))
+            continue;
+
+        n_compared++;
+
+        if (r->ns > ns * (1.0 + tolerance / 100.0)) {
+            fprintf(stderr, "REGRESSION: %s %s %s %u channels: %.3f ns/frame, was %.3f (%+.1f%%)\n",
+                    op, impl, what, channels, r->ns, ns, (r->ns / ns - 1.0) * 100.0);
+            n_regressed++;
+        }
+    }
+
+    fclose(f);
+
+    fprintf(stderr, "Compared %u cases against %s, %d regressed by more than %.1f%%.\n", n_compared, fn, n_regressed, tolerance);
+
+    return n_regressed;
+}
+
+static void help(const char *argv0) {
+    printf("%s [options]\n\n"
+           "-h, --help                Show this help\n"
+           "    --json                Write one JSON object per case\n"
+           "    --compare=FILE        Compare with the output of an earlier --json run\n"
+           "    --tolerance=PERCENT   How much slower a case may get (default %.0f)\n"
+           "    --min-time=MSEC       Minimum time of one measurement (default %u)\n",
+           argv0, DEFAULT_TOLERANCE, (unsigned) (DEFAULT_MIN_USEC / PA_USEC_PER_MSEC));
+}
+
+enum {
+    ARG_JSON = 256,
+    ARG_COMPARE,
+    ARG_TOLERANCE,
+    ARG_MIN_TIME
+};
+
+int main(int argc, char *argv[]) {
+    static const struct option long_options[] = {
+        {"help",      0, NULL, 'h'},
+        {"json",      0, NULL, ARG_JSON},
+        {"compare",   1, NULL, ARG_COMPARE},
+        {"tolerance", 1, NULL, ARG_TOLERANCE},
+        {"min-time",  1, NULL, ARG_MIN_TIME},
+        {NULL,        0, NULL, 0}
+    };
+
+    pa_mempool *pool;
+    pa_bool_t json = FALSE;
+    const char *baseline = NULL;
+    double tolerance = DEFAULT_TOLERANCE;
+    unsigned i;
+    int c, ret = 0;
+
+    pa_log_set_level(PA_LOG_WARN);
+
+    if (getenv("MAKE_CHECK"))
+        min_usec = PA_USEC_PER_MSEC;
+
+    while ((c = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+
+        switch (c) {
+            case 'h':
+                help(argv[0]);
+                return 0;
+
+            case ARG_JSON:
+                json = TRUE;
+                break;
+
+            case ARG_COMPARE:
+                baseline = optarg;
+                break;
+
+            case ARG_TOLERANCE:
+                if (pa_atod(optarg, &tolerance) < 0 || tolerance < 0) {
+                    pa_log("Invalid tolerance: %s", optarg);
+                    return 1;
+                }
+                break;
+
+            case ARG_MIN_TIME: {
+                uint32_t msec;
+
+                if (pa_atou(optarg, &msec) < 0 || msec == 0) {
+                    pa_log("Invalid minimum time: %s", optarg);
+                    return 1;
+                }
+
+                min_usec = msec * PA_USEC_PER_MSEC;
+                break;
+            }
+
+            default:
+                help(argv[0]);
+                return 1;
+        }
+    }
+
+    srand(0);
+
+    save_funcs(&c_funcs);
+
+    /* This installs what the daemon would use on this CPU */
+#if defined (__i386__) || defined (__amd64__)
+    if (pa_cpu_init_x86(&cpu_info.flags.x86))
+        cpu_info.cpu_type = PA_CPU_X86;
+#endif
+#if defined (__arm__)
+    if (pa_cpu_init_arm(&cpu_info.flags.arm))
+        cpu_info.cpu_type = PA_CPU_ARM;
+#endif
+#ifndef DISABLE_ORC
+    pa_cpu_init_orc(cpu_info);
+#endif
+
+    save_funcs(&daemon_funcs);
+
+    for (i = 0; i < PA_ELEMENTSOF(impls); i++) {
+        restore_funcs(&c_funcs);
+        impls[i].init();
+
+        bench_volume(impls[i].name);
+        bench_mix(impls[i].name);
+        bench_convert(impls[i].name);
+        bench_remap(impls[i].name);
+    }
+
+    /* The resamplers use the daemon's choice of functions */
+    restore_funcs(&daemon_funcs);
+
+    pa_assert_se(pool = pa_mempool_new(FALSE, 0));
+    bench_resampler(pool);
+    pa_mempool_free(pool);
+
+    calc_speedups();
+
+    if (json)
+        print_json();
+    else
+        print_table();
+
+    if (baseline && (ret = compare(baseline, tolerance)) != 0)
+        ret = 1;
+
+    return ret;
+}
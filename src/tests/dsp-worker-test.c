@@ -0,0 +1,214 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <pulse/mainloop.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core.h>
+#include <pulsecore/dsp-worker.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/thread.h>
+
+/* Runs a stateful filter (a running sum) through the worker, one block
+ * ahead like the filter sinks do, and checks that the output is the
+ * same as when processing everything in one go. Then the same filter
+ * runs on several channels at once in a pool, one channel per share. */
+
+#define N_BLOCKS 100
+#define MAX_BLOCK 64
+#define N_SHARES 4
+
+struct state {
+    pa_mempool *pool;
+    int64_t sum;
+};
+
+static void process(void *userdata, const pa_memchunk *in, pa_memchunk *out) {
+    struct state *s = userdata;
+    const int32_t *src;
+    int64_t *dst;
+    unsigned n, k;
+
+    n = (unsigned) (in->length / sizeof(int32_t));
+
+    out->index = 0;
+    out->length = n * sizeof(int64_t);
+    out->memblock = pa_memblock_new(s->pool, out->length);
+
+    src = (const int32_t*) ((uint8_t*) pa_memblock_acquire(in->memblock) + in->index);
+    dst = pa_memblock_acquire(out->memblock);
+
+    for (k = 0; k < n; k++)
+        dst[k] = (s->sum += src[k]);
+
+    pa_memblock_release(in->memblock);
+    pa_memblock_release(out->memblock);
+}
+
+static void make_block(pa_mempool *pool, int32_t *next, pa_memchunk *c) {
+    int32_t *d;
+    unsigned n, k;
+
+    n = 1 + (unsigned) (rand() % MAX_BLOCK);
+
+    c->index = 0;
+    c->length = n * sizeof(int32_t);
+    c->memblock = pa_memblock_new(pool, c->length);
+
+    d = pa_memblock_acquire(c->memblock);
+    for (k = 0; k < n; k++)
+        d[k] = (*next)++;
+    pa_memblock_release(c->memblock);
+}
+
+static void check_block(pa_memchunk *c, int64_t *expected, int32_t *next) {
+    const int64_t *d;
+    unsigned n, k;
+
+    n = (unsigned) (c->length / sizeof(int64_t));
+    pa_assert(n > 0);
+
+    d = pa_memblock_acquire(c->memblock);
+    for (k = 0; k < n; k++) {
+        *expected += (*next)++;
+        pa_assert_se(d[k] == *expected);
+    }
+    pa_memblock_release(c->memblock);
+
+    pa_memblock_unref(c->memblock);
+}
+
+struct pool_state {
+    int64_t sum[N_SHARES];
+    int32_t in;
+    unsigned runs[N_SHARES];
+};
+
+static void process_share(void *userdata, unsigned share) {
+    struct pool_state *s = userdata;
+
+    pa_assert_se(share < N_SHARES);
+
+    s->sum[share] += s->in * (int32_t) (share + 1);
+    s->runs[share]++;
+}
+
+static void check_pool(pa_core *c) {
+    pa_dsp_pool *p;
+    struct pool_state s;
+    int64_t expected = 0;
+    unsigned i, k;
+
+    memset(&s, 0, sizeof(s));
+
+    pa_assert_se(p = pa_dsp_pool_new(c, "dsp-test-pool", 0, NULL, N_SHARES, process_share, &s));
+    pa_assert_se(pa_dsp_pool_get_n_shares(p) == N_SHARES);
+
+    /* Every run must see the input set before it and be finished when
+     * it returns */
+    for (i = 0; i < N_BLOCKS; i++) {
+        s.in = rand() % 1000;
+        expected += s.in;
+
+        pa_dsp_pool_run(p);
+
+        for (k = 0; k < N_SHARES; k++) {
+            pa_assert_se(s.runs[k] == i + 1);
+            pa_assert_se(s.sum[k] == expected * (k + 1));
+        }
+    }
+
+    pa_dsp_pool_free(p);
+
+    /* A pool with a single share has no threads */
+    memset(&s, 0, sizeof(s));
+    pa_assert_se(p = pa_dsp_pool_new(c, "dsp-test-pool", 0, NULL, 1, process_share, &s));
+    pa_dsp_pool_run(p);
+    pa_assert_se(s.runs[0] == 1);
+    pa_dsp_pool_free(p);
+}
+
+int main(int argc, char *argv[]) {
+    pa_mainloop *m;
+    pa_core *c;
+    pa_dsp_worker *w;
+    struct state s;
+    pa_memchunk in, out;
+    int32_t next_in = 0, next_out = 0;
+    int64_t expected = 0;
+    unsigned i;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    pa_assert_se(m = pa_mainloop_new());
+    pa_assert_se(c = pa_core_new(pa_mainloop_get_api(m), FALSE, 0, 0, 0));
+
+    s.pool = c->mempool;
+    s.sum = 0;
+
+    pa_assert_se(w = pa_dsp_worker_new(c, "dsp-test", 0, NULL, process, &s));
+
+    pa_assert_se(pa_dsp_worker_collect(w, &out) < 0);
+    pa_assert_se(pa_dsp_worker_get_length(w) == 0);
+    pa_assert_se(pa_dsp_worker_is_done(w));
+
+    for (i = 0; i < N_BLOCKS; i++) {
+        if (i > 0) {
+            pa_assert_se(pa_dsp_worker_collect(w, &out) == 0);
+            check_block(&out, &expected, &next_out);
+        }
+
+        make_block(c->mempool, &next_in, &in);
+        pa_dsp_worker_submit(w, &in);
+        pa_assert_se(pa_dsp_worker_get_length(w) == in.length);
+        pa_memblock_unref(in.memblock);
+    }
+
+    /* The last block must become ready without being collected */
+    while (!pa_dsp_worker_is_done(w))
+        pa_thread_yield();
+
+    pa_assert_se(pa_dsp_worker_collect(w, &out) == 0);
+    check_block(&out, &expected, &next_out);
+    pa_assert_se(next_out == next_in);
+    pa_assert_se(pa_dsp_worker_is_done(w));
+
+    /* Freeing with a block in flight must not leak or hang */
+    make_block(c->mempool, &next_in, &in);
+    pa_dsp_worker_submit(w, &in);
+    pa_memblock_unref(in.memblock);
+    pa_dsp_worker_free(w);
+
+    check_pool(c);
+
+    pa_core_unref(c);
+    pa_mainloop_free(m);
+
+    return 0;
+}
@@ -0,0 +1,156 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/flist.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+/* Checks that the per-thread caches in front of a cached flist hand out
+ * what was pushed, count hits and misses, and give everything back
+ * when their thread exits. */
+
+#define N_ITEMS 100
+
+static pa_flist *flist;
+static unsigned n_freed = 0;
+
+static void free_cb(void *p) {
+    n_freed++;
+    pa_xfree(p);
+}
+
+static void get_stat(uint64_t *hits, uint64_t *misses) {
+    pa_flist_stat *s;
+    unsigned i, n;
+    pa_bool_t found = FALSE;
+
+    s = pa_flist_get_stats(&n);
+
+    for (i = 0; i < n; i++)
+        if (strcmp(s[i].name, "flist-cache-test") == 0) {
+            *hits = s[i].hits;
+            *misses = s[i].misses;
+            found = TRUE;
+        }
+
+    pa_xfree(s);
+    pa_assert_se(found);
+}
+
+static void fill_thread(void *data) {
+    void *items[N_ITEMS];
+    uint64_t hits, misses;
+    unsigned i;
+
+    /* Nothing there yet, every pop misses */
+    for (i = 0; i < 4; i++)
+        pa_assert_se(!pa_flist_pop(flist));
+
+    get_stat(&hits, &misses);
+    pa_assert_se(hits == 0 && misses == 4);
+
+    for (i = 0; i < N_ITEMS; i++)
+        items[i] = pa_xnew(int, 1);
+
+    /* More than fits into the cache, so some spill to the shared list */
+    for (i = 0; i < N_ITEMS; i++)
+        pa_assert_se(pa_flist_push(flist, items[i]) == 0);
+
+    /* The cache is LIFO, so the last one pushed is popped first */
+    pa_assert_se(pa_flist_pop(flist) == items[N_ITEMS - 1]);
+    pa_assert_se(pa_flist_push(flist, items[N_ITEMS - 1]) == 0);
+
+    get_stat(&hits, &misses);
+    pa_assert_se(hits == 1 && misses == 4);
+}
+
+static void spill_thread(void *data) {
+    unsigned i;
+
+    for (i = 0; i < 8; i++)
+        pa_assert_se(pa_flist_push(flist, pa_xnew(int, 1)) == 0);
+}
+
+static void drain_thread(void *data) {
+    unsigned n = 0;
+    uint64_t hits, misses;
+    void *p;
+
+    /* Everything the other thread left behind, cached or not, is
+     * available here */
+    while ((p = pa_flist_pop(flist))) {
+        pa_xfree(p);
+        n++;
+    }
+
+    pa_assert_se(n == N_ITEMS);
+
+    /* Refilling in batches means most pops hit */
+    get_stat(&hits, &misses);
+    pa_assert_se(hits > misses);
+}
+
+int main(int argc, char* argv[]) {
+    pa_thread *t;
+    void *p;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    flist = pa_flist_new_cached(256, "flist-cache-test", free_cb);
+
+    /* The main thread has no cache and goes straight to the shared list */
+    p = pa_xnew(int, 1);
+    pa_assert_se(pa_flist_push(flist, p) == 0);
+    pa_assert_se(pa_flist_pop(flist) == p);
+    pa_xfree(p);
+
+    pa_assert_se(t = pa_thread_new("fill", fill_thread, NULL));
+    pa_thread_free(t);
+
+    pa_assert_se(t = pa_thread_new("drain", drain_thread, NULL));
+    pa_thread_free(t);
+
+    pa_flist_free(flist, free_cb);
+    pa_assert_se(n_freed == 0);
+
+    /* What does not fit into the shared list when the thread exits is
+     * freed right away, the rest when the list is */
+    flist = pa_flist_new_cached(4, "flist-cache-test", free_cb);
+
+    pa_assert_se(t = pa_thread_new("spill", spill_thread, NULL));
+    pa_thread_free(t);
+    pa_assert_se(n_freed == 4);
+
+    pa_flist_free(flist, free_cb);
+    pa_assert_se(n_freed == 8);
+
+    return 0;
+}
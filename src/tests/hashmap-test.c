@@ -0,0 +1,229 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/hashmap.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+/* The chained implementation pa_hashmap used to have, to compare
+ * against */
+
+#define OLD_NBUCKETS 127
+
+struct old_entry {
+    const void *key;
+    void *value;
+    struct old_entry *bucket_next, *bucket_previous;
+    struct old_entry *iterate_next, *iterate_previous;
+};
+
+struct old_hashmap {
+    struct old_entry *buckets[OLD_NBUCKETS];
+    struct old_entry *head, *tail;
+};
+
+static struct old_entry *old_scan(struct old_hashmap *h, unsigned hash, const void *key) {
+    struct old_entry *e;
+
+    for (e = h->buckets[hash]; e; e = e->bucket_next)
+        if (pa_idxset_string_compare_func(e->key, key) == 0)
+            return e;
+
+    return NULL;
+}
+
+static void old_put(struct old_hashmap *h, const void *key, void *value) {
+    unsigned hash = pa_idxset_string_hash_func(key) % OLD_NBUCKETS;
+    struct old_entry *e;
+
+    if (old_scan(h, hash, key))
+        return;
+
+    e = pa_xnew(struct old_entry, 1);
+    e->key = key;
+    e->value = value;
+
+    e->bucket_next = h->buckets[hash];
+    e->bucket_previous = NULL;
+    if (h->buckets[hash])
+        h->buckets[hash]->bucket_previous = e;
+    h->buckets[hash] = e;
+
+    e->iterate_previous = h->tail;
+    e->iterate_next = NULL;
+    if (h->tail)
+        h->tail->iterate_next = e;
+    else
+        h->head = e;
+    h->tail = e;
+}
+
+static void *old_get(struct old_hashmap *h, const void *key) {
+    struct old_entry *e;
+
+    if (!(e = old_scan(h, pa_idxset_string_hash_func(key) % OLD_NBUCKETS, key)))
+        return NULL;
+
+    return e->value;
+}
+
+static void old_free(struct old_hashmap *h) {
+    while (h->head) {
+        struct old_entry *e = h->head;
+        h->head = e->iterate_next;
+        pa_xfree(e);
+    }
+}
+
+static void check_basics(void) {
+    pa_hashmap *h;
+    void *state;
+    const void *key;
+    unsigned i, n;
+    char **keys;
+
+    h = pa_hashmap_new(pa_idxset_string_hash_func, pa_idxset_string_compare_func);
+    pa_assert(pa_hashmap_isempty(h));
+    pa_assert(!pa_hashmap_first(h));
+    pa_assert(!pa_hashmap_steal_first(h));
+
+    keys = pa_xnew(char*, 1000);
+    for (i = 0; i < 1000; i++) {
+        keys[i] = pa_sprintf_malloc("key-%u", i);
+        pa_assert_se(pa_hashmap_put(h, keys[i], PA_UINT_TO_PTR(i + 1)) == 0);
+    }
+
+    pa_assert(pa_hashmap_put(h, "key-17", NULL) < 0);
+    pa_assert(pa_hashmap_size(h) == 1000);
+    pa_assert(PA_PTR_TO_UINT(pa_hashmap_get(h, "key-999")) == 1000);
+    pa_assert(!pa_hashmap_get(h, "key-1000"));
+
+    /* Remove every other entry while iterating */
+    n = 0;
+    for (state = NULL; pa_hashmap_iterate(h, &state, &key); n++)
+        if (n % 2 == 0)
+            pa_assert_se(pa_hashmap_remove(h, key));
+    pa_assert(n == 1000);
+    pa_assert(pa_hashmap_size(h) == 500);
+    pa_assert(!pa_hashmap_get(h, "key-0"));
+    pa_assert(PA_PTR_TO_UINT(pa_hashmap_get(h, "key-1")) == 2);
+
+    /* Reinserting makes them show up at the end */
+    for (i = 0; i < 1000; i += 2)
+        pa_assert_se(pa_hashmap_put(h, keys[i], PA_UINT_TO_PTR(i + 1)) == 0);
+
+    pa_assert(PA_PTR_TO_UINT(pa_hashmap_first(h)) == 2);
+    pa_assert(PA_PTR_TO_UINT(pa_hashmap_last(h)) == 999);
+
+    n = 0;
+    for (state = NULL; pa_hashmap_iterate_backwards(h, &state, NULL); n++)
+        ;
+    pa_assert(n == 1000);
+
+    /* Seeking continues after the key, and the removed ones are gone */
+    state = NULL;
+    pa_assert(PA_PTR_TO_UINT(pa_hashmap_iterate_seek(h, &state, "key-997")) == 998);
+    pa_assert(PA_PTR_TO_UINT(pa_hashmap_iterate(h, &state, NULL)) == 1000);
+    pa_assert(PA_PTR_TO_UINT(pa_hashmap_iterate(h, &state, NULL)) == 1);
+    pa_assert(!pa_hashmap_iterate_seek(h, &state, "key-1000"));
+    pa_assert(PA_PTR_TO_UINT(pa_hashmap_iterate(h, &state, NULL)) == 3);
+    pa_assert(PA_PTR_TO_UINT(pa_hashmap_iterate_seek(h, &state, "key-998")) == 999);
+    pa_assert(!pa_hashmap_iterate(h, &state, NULL));
+
+    /* Insertion order is kept */
+    for (i = 1; i < 1000; i += 2)
+        pa_assert(PA_PTR_TO_UINT(pa_hashmap_steal_first(h)) == i + 1);
+    for (i = 0; i < 1000; i += 2)
+        pa_assert(PA_PTR_TO_UINT(pa_hashmap_steal_first(h)) == i + 1);
+
+    pa_assert(pa_hashmap_isempty(h));
+    pa_hashmap_free(h, NULL, NULL);
+
+    for (i = 0; i < 1000; i++)
+        pa_xfree(keys[i]);
+    pa_xfree(keys);
+}
+
+static void benchmark(unsigned n, unsigned rounds) {
+    pa_hashmap *h;
+    struct old_hashmap old;
+    char **keys;
+    unsigned i, r;
+    pa_usec_t t;
+
+    keys = pa_xnew(char*, n);
+    for (i = 0; i < n; i++)
+        keys[i] = pa_sprintf_malloc("client-%u.application.process.id", i);
+
+    t = pa_rtclock_now();
+    for (r = 0; r < rounds; r++) {
+        memset(&old, 0, sizeof(old));
+
+        for (i = 0; i < n; i++)
+            old_put(&old, keys[i], keys[i]);
+        for (i = 0; i < n; i++)
+            pa_assert_se(old_get(&old, keys[i]) == keys[i]);
+
+        old_free(&old);
+    }
+    pa_log_info("%u entries, chained:        %llu usec", n, (unsigned long long) (pa_rtclock_now() - t));
+
+    t = pa_rtclock_now();
+    for (r = 0; r < rounds; r++) {
+        h = pa_hashmap_new(pa_idxset_string_hash_func, pa_idxset_string_compare_func);
+
+        for (i = 0; i < n; i++)
+            pa_hashmap_put(h, keys[i], keys[i]);
+        for (i = 0; i < n; i++)
+            pa_assert_se(pa_hashmap_get(h, keys[i]) == keys[i]);
+
+        pa_hashmap_free(h, NULL, NULL);
+    }
+    pa_log_info("%u entries, open addressing: %llu usec", n, (unsigned long long) (pa_rtclock_now() - t));
+
+    for (i = 0; i < n; i++)
+        pa_xfree(keys[i]);
+    pa_xfree(keys);
+}
+
+int main(int argc, char *argv[]) {
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    check_basics();
+
+    benchmark(16, 10000);
+    benchmark(256, 500);
+    benchmark(4096, getenv("MAKE_CHECK") ? 5 : 50);
+
+    return 0;
+}
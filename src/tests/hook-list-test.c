@@ -2,8 +2,11 @@
 #include <config.h>
 #endif
 
+#include <pulse/proplist.h>
+
 #include <pulsecore/hook-list.h>
 #include <pulsecore/log.h>
+#include <pulsecore/macro.h>
 
 static pa_hook_result_t func1(const char *hook_data, const char *call_data, const char *slot_data) {
     pa_log("(func1) hook=%s call=%s slot=%s", hook_data, call_data, slot_data);
@@ -15,6 +18,67 @@ static pa_hook_result_t func2(const char *hook_data, const char *call_data, cons
     return PA_HOOK_OK;
 }
 
+/* Call data for the filtered slots: an object and a property list */
+struct call {
+    void *object;
+    pa_proplist *proplist;
+};
+
+static void* call_get_object(struct call *c) {
+    return c->object;
+}
+
+static pa_proplist* call_get_proplist(struct call *c) {
+    return c->proplist;
+}
+
+static pa_hook_result_t count_func(void *hook_data, struct call *call, unsigned *n) {
+    (*n)++;
+    return PA_HOOK_OK;
+}
+
+static void check_filters(void) {
+    static int object1, object2;
+    static const pa_hook_filter object_filter = { &object1, NULL };
+    static const pa_hook_filter key_filter = { NULL, "media.role" };
+    static const pa_hook_filter both_filter = { &object2, "media.role" };
+    pa_hook hook;
+    struct call call;
+    unsigned n_any = 0, n_object = 0, n_key = 0, n_both = 0;
+    const pa_hook_stat *stat;
+
+    pa_hook_init(&hook, NULL);
+    pa_hook_set_accessors(&hook, (pa_hook_object_cb_t) call_get_object, (pa_hook_proplist_cb_t) call_get_proplist);
+
+    pa_hook_connect(&hook, PA_HOOK_NORMAL, (pa_hook_cb_t) count_func, &n_any);
+    pa_hook_connect_filtered(&hook, PA_HOOK_NORMAL, &object_filter, (pa_hook_cb_t) count_func, &n_object);
+    pa_hook_connect_filtered(&hook, PA_HOOK_NORMAL, &key_filter, (pa_hook_cb_t) count_func, &n_key);
+    pa_hook_connect_filtered(&hook, PA_HOOK_NORMAL, &both_filter, (pa_hook_cb_t) count_func, &n_both);
+
+    call.proplist = pa_proplist_new();
+
+    call.object = &object1;
+    pa_hook_fire(&hook, &call);
+    pa_assert_se(n_any == 1 && n_object == 1 && n_key == 0 && n_both == 0);
+
+    pa_proplist_sets(call.proplist, "media.role", "phone");
+    call.object = &object2;
+    pa_hook_fire(&hook, &call);
+    pa_assert_se(n_any == 2 && n_object == 1 && n_key == 1 && n_both == 1);
+
+    call.object = NULL;
+    pa_hook_fire(&hook, &call);
+    pa_assert_se(n_any == 3 && n_object == 1 && n_key == 2 && n_both == 1);
+
+    stat = pa_hook_get_stat(&hook);
+    pa_assert_se(stat->n_fired == 3);
+    pa_assert_se(stat->n_called == 7);
+    pa_assert_se(stat->n_skipped == 5);
+
+    pa_proplist_free(call.proplist);
+    pa_hook_done(&hook);
+}
+
 int main(int argc, char *argv[]) {
     pa_hook hook;
     pa_hook_slot *slot;
@@ -33,5 +97,7 @@ int main(int argc, char *argv[]) {
 
     pa_hook_done(&hook);
 
+    check_filters();
+
     return 0;
 }
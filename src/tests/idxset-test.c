@@ -0,0 +1,112 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/idxset.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#define N 5000
+
+int main(int argc, char *argv[]) {
+    pa_idxset *s, *copy;
+    int *objects;
+    uint32_t idx, i;
+    unsigned n;
+    void *state, *e;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    objects = pa_xnew(int, N);
+    s = pa_idxset_new(NULL, NULL);
+
+    pa_assert(!pa_idxset_first(s, &idx));
+    pa_assert(idx == PA_IDXSET_INVALID);
+
+    for (i = 0; i < N; i++) {
+        pa_assert_se(pa_idxset_put(s, objects + i, &idx) == 0);
+        pa_assert(idx == i);
+    }
+
+    pa_assert(pa_idxset_put(s, objects + 7, &idx) < 0);
+    pa_assert(idx == 7);
+    pa_assert(pa_idxset_size(s) == N);
+
+    pa_assert(pa_idxset_get_by_index(s, 1234) == objects + 1234);
+    pa_assert(pa_idxset_get_by_data(s, objects + 4321, &idx) == objects + 4321);
+    pa_assert(idx == 4321);
+
+    /* Drop everything but every tenth entry, while iterating */
+    n = 0;
+    PA_IDXSET_FOREACH(e, s, idx) {
+        if (idx % 10 != 0)
+            pa_assert_se(pa_idxset_remove_by_index(s, idx) == e);
+        n++;
+    }
+    pa_assert(n == N);
+    pa_assert(pa_idxset_size(s) == N / 10);
+    pa_assert(!pa_idxset_get_by_index(s, 1234));
+    pa_assert(!pa_idxset_get_by_data(s, objects + 1234, NULL));
+
+    /* Continuing from a removed entry finds the next one */
+    idx = 1234;
+    pa_assert(pa_idxset_next(s, &idx) == objects + 1240);
+    pa_assert(idx == 1240);
+
+    idx = 1234;
+    pa_assert(pa_idxset_rrobin(s, &idx) == objects + 0);
+    idx = 4990;
+    pa_assert(pa_idxset_rrobin(s, &idx) == objects + 0);
+    idx = 10;
+    pa_assert(pa_idxset_rrobin(s, &idx) == objects + 20);
+
+    /* Indexes are never reused */
+    pa_assert_se(pa_idxset_put(s, objects + 1, &idx) == 0);
+    pa_assert(idx == N);
+
+    n = 0;
+    for (state = NULL; (e = pa_idxset_iterate(s, &state, &idx)); n++)
+        pa_assert(e == objects + (idx == N ? 1 : idx));
+    pa_assert(n == N / 10 + 1);
+
+    copy = pa_idxset_copy(s);
+    pa_assert(pa_idxset_size(copy) == pa_idxset_size(s));
+    pa_assert(pa_idxset_first(copy, &idx) == objects + 0);
+    pa_idxset_free(copy, NULL, NULL);
+
+    for (i = 0; i < N; i += 10) {
+        pa_assert_se(pa_idxset_steal_first(s, &idx) == objects + i);
+        pa_assert(idx == i);
+    }
+    pa_assert(pa_idxset_steal_first(s, NULL) == objects + 1);
+    pa_assert(pa_idxset_isempty(s));
+
+    pa_idxset_free(s, NULL, NULL);
+    pa_xfree(objects);
+
+    return 0;
+}
@@ -0,0 +1,184 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/iec61937.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/sample-util.h>
+
+/* Feeds frames with random payload and some junk between them to the
+ * packetizer in random pieces, and checks every burst that comes out:
+ * the preamble, the frames with their bytes swapped and the padding. */
+
+#define N_BURSTS 20
+
+struct test {
+    const char *name;
+    pa_encoding_t encoding;
+    uint8_t header[8];
+    size_t frame_length;
+    unsigned frames_per_burst;
+    uint16_t type;
+    size_t burst_size;
+    pa_bool_t length_in_bytes;
+};
+
+static const struct test tests[] = {
+    /* 48 kHz, 160 kbit/s, bsid 8, bsmod 2 */
+    { "ac3", PA_ENCODING_AC3, { 0x0B, 0x77, 0, 0, 0x12, 0x42, 0, 0 }, 640, 1, 0x0201, 6144, FALSE },
+
+    /* 44.1 kHz, 192 kbit/s with the extra word */
+    { "ac3-44100", PA_ENCODING_AC3, { 0x0B, 0x77, 0, 0, 0x55, 0x40, 0, 0 }, 836, 1, 0x0001, 6144, FALSE },
+
+    /* One block per frame, so six frames per burst, 400 bytes each */
+    { "eac3", PA_ENCODING_EAC3, { 0x0B, 0x77, 0x00, 199, 0x00, 0x80, 0, 0 }, 400, 6, 21, 24576, TRUE },
+
+    /* 512 samples in 1001 bytes, the odd length needs a pad byte */
+    { "dts", PA_ENCODING_DTS, { 0x7F, 0xFE, 0x80, 0x01, 0x00, 0x3C, 0x3E, 0x80 }, 1001, 1, 11, 2048, FALSE },
+};
+
+struct output {
+    uint8_t *data;
+    size_t length;
+};
+
+static void burst_cb(pa_iec61937_packetizer *p, const pa_memchunk *chunk, void *userdata) {
+    struct output *o = userdata;
+    const uint8_t *d;
+
+    pa_assert_se(chunk->length % 4 == 0);
+
+    o->data = pa_xrealloc(o->data, o->length + chunk->length);
+
+    d = pa_memblock_acquire(chunk->memblock);
+    memcpy(o->data + o->length, d + chunk->index, chunk->length);
+    pa_memblock_release(chunk->memblock);
+
+    o->length += chunk->length;
+}
+
+static uint16_t get_word(const uint8_t *d) {
+    return (uint16_t) (d[0] | (d[1] << 8));
+}
+
+static void run(pa_mempool *pool, pa_silence_cache *cache, const struct test *t) {
+    pa_iec61937_packetizer *p;
+    struct output o = { NULL, 0 };
+    uint8_t *in, *frames;
+    size_t in_length = 0, payload, i, k, n;
+    unsigned b;
+
+    payload = t->frame_length * t->frames_per_burst;
+
+    /* The frames as they should come out, and the input with junk */
+    frames = pa_xmalloc(payload * N_BURSTS);
+    in = pa_xmalloc(payload * N_BURSTS + N_BURSTS * t->frames_per_burst * 3);
+
+    for (i = 0; i < (size_t) N_BURSTS * t->frames_per_burst; i++) {
+        uint8_t *f = frames + i * t->frame_length;
+
+        memcpy(f, t->header, sizeof(t->header));
+        for (k = sizeof(t->header); k < t->frame_length; k++)
+            f[k] = (uint8_t) rand();
+
+        for (k = (unsigned) (rand() % 4); k > 0; k--)
+            in[in_length++] = 0;
+
+        memcpy(in + in_length, f, t->frame_length);
+        in_length += t->frame_length;
+    }
+
+    pa_assert_se(p = pa_iec61937_packetizer_new(pool, cache, t->encoding));
+
+    for (i = 0; i < in_length; i += n) {
+        pa_memchunk chunk;
+
+        n = PA_MIN((size_t) (1 + rand() % 3000), in_length - i);
+
+        chunk.memblock = pa_memblock_new_fixed(pool, in + i, n, TRUE);
+        chunk.index = 0;
+        chunk.length = n;
+
+        pa_assert_se(pa_iec61937_packetizer_push(p, &chunk, burst_cb, &o) >= 0);
+        pa_memblock_unref_fixed(chunk.memblock);
+    }
+
+    pa_iec61937_packetizer_free(p);
+
+    pa_assert_se(o.length == N_BURSTS * t->burst_size);
+
+    for (b = 0; b < N_BURSTS; b++) {
+        const uint8_t *d = o.data + b * t->burst_size, *f = frames + b * payload;
+
+        pa_assert_se(get_word(d) == 0xF872);
+        pa_assert_se(get_word(d + 2) == 0x4E1F);
+        pa_assert_se(get_word(d + 4) == t->type);
+        pa_assert_se(get_word(d + 6) == (t->length_in_bytes ? payload : PA_ROUND_UP(payload, 2) * 8));
+
+        for (k = 0; k < payload; k++)
+            pa_assert_se(d[(8 + k) ^ 1] == f[k]);
+
+        for (k = 8 + PA_ROUND_UP(payload, 2); k < t->burst_size; k++)
+            pa_assert_se(d[k] == 0);
+
+        if (payload & 1)
+            pa_assert_se(d[(8 + payload) ^ 1] == 0);
+    }
+
+    pa_log_debug("%s: %u bursts of %lu bytes", t->name, N_BURSTS, (unsigned long) t->burst_size);
+
+    pa_xfree(o.data);
+    pa_xfree(frames);
+    pa_xfree(in);
+}
+
+int main(int argc, char *argv[]) {
+    pa_mempool *pool;
+    pa_silence_cache cache;
+    unsigned i;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    srand(0);
+
+    pa_assert_se(pool = pa_mempool_new(FALSE, 0));
+    pa_silence_cache_init(&cache);
+
+    for (i = 0; i < PA_ELEMENTSOF(tests); i++)
+        run(pool, &cache, &tests[i]);
+
+    pa_assert_se(pa_iec61937_encoding(PA_ENCODING_AC3) == PA_ENCODING_AC3_IEC61937);
+    pa_assert_se(pa_iec61937_encoding(PA_ENCODING_PCM) == PA_ENCODING_INVALID);
+
+    pa_silence_cache_done(&cache);
+    pa_mempool_free(pool);
+
+    return 0;
+}
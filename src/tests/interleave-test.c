@@ -0,0 +1,145 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+
+#include <pulsecore/cpu-x86.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/sample-util.h>
+
+/* Compares the optimized float (de)interleaving to the C versions for
+ * all strides and channel subsets up to MAX_CHANNELS, at lengths around
+ * the register size. The data goes beyond [-1, 1] to check clamping. */
+
+#define N 1027
+#define MAX_CHANNELS 4
+
+static pa_deinterleave_float_func_t c_deinterleave;
+static pa_interleave_float_func_t c_interleave;
+
+static float random_float(void) {
+    return 3.0f * (float) (rand() - RAND_MAX / 2) / RAND_MAX;
+}
+
+static void check_func(const char *name) {
+    static float src[MAX_CHANNELS * N], ref[MAX_CHANNELS * N], out[MAX_CHANNELS * N];
+    static float planar[MAX_CHANNELS][N], ref_planar[MAX_CHANNELS][N];
+    float *p[MAX_CHANNELS], *q[MAX_CHANNELS];
+    pa_deinterleave_float_func_t f_deinterleave = pa_get_deinterleave_float_func();
+    pa_interleave_float_func_t f_interleave = pa_get_interleave_float_func();
+    unsigned stride, first, k, n, c, i, rounds = getenv("MAKE_CHECK") ? 10 : 10000;
+    pa_usec_t t;
+
+    for (i = 0; i < MAX_CHANNELS * N; i++)
+        src[i] = random_float();
+
+    for (c = 0; c < MAX_CHANNELS; c++) {
+        p[c] = planar[c];
+        q[c] = ref_planar[c];
+    }
+
+    for (stride = 1; stride <= MAX_CHANNELS; stride++)
+        for (first = 0; first < stride; first++)
+            for (k = 1; first + k <= stride; k++)
+                for (n = N - 8; n <= N; n++) {
+                    memset(planar, 0, sizeof(planar));
+                    memset(ref_planar, 0, sizeof(ref_planar));
+
+                    c_deinterleave(q, k, src + first, stride, n);
+                    f_deinterleave(p, k, src + first, stride, n);
+                    pa_assert_se(memcmp(planar, ref_planar, sizeof(planar)) == 0);
+
+                    memcpy(ref, src, sizeof(src));
+                    memcpy(out, src, sizeof(src));
+
+                    /* Back from the unclamped data */
+                    for (c = 0; c < k; c++) {
+                        q[c] = p[c] = src + c * N;
+                    }
+
+                    c_interleave(ref + first, stride, q, k, n);
+                    f_interleave(out + first, stride, p, k, n);
+                    pa_assert_se(memcmp(ref, out, sizeof(ref)) == 0);
+
+                    for (c = 0; c < k; c++) {
+                        p[c] = planar[c];
+                        q[c] = ref_planar[c];
+                    }
+                }
+
+    for (stride = 1; stride <= 2; stride++) {
+        t = pa_rtclock_now();
+        for (i = 0; i < rounds; i++) {
+            f_deinterleave(p, stride, src, stride, N);
+            f_interleave(out, stride, p, stride, N);
+        }
+        t = pa_rtclock_now() - t;
+        pa_log_info("%-4s %u channels %10.0f frames/s", name, stride, (double) N * rounds * PA_USEC_PER_SEC / PA_MAX(t, 1U));
+    }
+}
+
+int main(int argc, char *argv[]) {
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    c_deinterleave = pa_get_deinterleave_float_func();
+    c_interleave = pa_get_interleave_float_func();
+
+    /* Values are clamped on the way in and out */
+    {
+        float in[6] = { 0.5f, -2.0f, 0.25f, 3.0f, -1.0f, 1.0f }, a[3], b[3], *ab[2] = { a, b };
+        const float ref_a[3] = { 0.5f, 0.25f, -1.0f }, ref_b[3] = { -1.0f, 1.0f, 1.0f };
+
+        c_deinterleave(ab, 2, in, 2, 3);
+        pa_assert_se(memcmp(a, ref_a, sizeof(a)) == 0);
+        pa_assert_se(memcmp(b, ref_b, sizeof(b)) == 0);
+    }
+
+    check_func("C");
+
+#if defined (__i386__) || defined (__amd64__)
+    {
+        pa_cpu_x86_flag_t flags = 0;
+
+        pa_cpu_init_x86(&flags);
+
+        pa_set_deinterleave_float_func(c_deinterleave);
+        pa_set_interleave_float_func(c_interleave);
+        pa_interleave_func_init_sse(flags);
+        if (pa_get_interleave_float_func() != c_interleave)
+            check_func("SSE");
+    }
+#endif
+
+    pa_set_deinterleave_float_func(c_deinterleave);
+    pa_set_interleave_float_func(c_interleave);
+
+    return 0;
+}
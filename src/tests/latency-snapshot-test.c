@@ -0,0 +1,102 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/latency-snapshot.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/thread.h>
+
+#define N_PUBLISH 100000
+
+static pa_latency_snapshot snapshot;
+static pa_atomic_t done = PA_ATOMIC_INIT(0);
+
+static void writer(void *userdata) {
+    unsigned i;
+
+    /* The latency and the time it was taken always go together */
+    for (i = 1; i <= N_PUBLISH; i++)
+        pa_latency_snapshot_publish(&snapshot, 10 * i, 10 * i);
+
+    pa_atomic_store(&done, 1);
+}
+
+int main(int argc, char *argv[]) {
+    pa_thread *t;
+    pa_usec_t usec;
+
+    pa_latency_snapshot_init(&snapshot);
+
+    /* Nothing published yet */
+    pa_assert_se(!pa_latency_snapshot_get(&snapshot, 0, TRUE, &usec));
+
+    pa_latency_snapshot_publish(&snapshot, 20000, 1000000);
+
+    pa_assert_se(pa_latency_snapshot_get(&snapshot, 1000000, TRUE, &usec));
+    pa_assert_se(usec == 20000);
+
+    /* Playback latency goes down, capture latency up */
+    pa_assert_se(pa_latency_snapshot_get(&snapshot, 1005000, TRUE, &usec));
+    pa_assert_se(usec == 15000);
+    pa_assert_se(pa_latency_snapshot_get(&snapshot, 1005000, FALSE, &usec));
+    pa_assert_se(usec == 25000);
+
+    /* But never below zero */
+    pa_assert_se(pa_latency_snapshot_get(&snapshot, 1030000, TRUE, &usec));
+    pa_assert_se(usec == 0);
+
+    /* A clock that went backwards doesn't move anything */
+    pa_assert_se(pa_latency_snapshot_get(&snapshot, 900000, TRUE, &usec));
+    pa_assert_se(usec == 20000);
+
+    /* Too old to be trusted */
+    pa_assert_se(!pa_latency_snapshot_get(&snapshot, 1000000 + PA_LATENCY_SNAPSHOT_MAX_AGE_USEC + 1, TRUE, &usec));
+
+    pa_latency_snapshot_invalidate(&snapshot);
+    pa_assert_se(!pa_latency_snapshot_get(&snapshot, 1000000, TRUE, &usec));
+
+    /* A reader must never see the latency of one snapshot with the
+     * time of another. As every latency equals its timestamp, the
+     * capture latency extrapolated to any later time is that time. */
+    pa_assert_se(t = pa_thread_new("writer", writer, NULL));
+
+    while (!pa_atomic_load(&done)) {
+        if (!pa_latency_snapshot_get(&snapshot, 10 * N_PUBLISH, FALSE, &usec))
+            continue;
+
+        pa_assert_se(usec == 10 * N_PUBLISH);
+    }
+
+    pa_thread_free(t);
+
+    /* And the last one published wins */
+    pa_assert_se(pa_latency_snapshot_get(&snapshot, 10 * N_PUBLISH, TRUE, &usec));
+    pa_assert_se(usec == 10 * N_PUBLISH);
+
+    pa_latency_snapshot_done(&snapshot);
+
+    pa_log_info("OK");
+
+    return 0;
+}
@@ -0,0 +1,145 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <pulse/volume.h>
+
+#include <pulsecore/level-meter.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/sample-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+/* Feeds a square wave and silence through a meter in odd chunk sizes
+ * and checks the levels that come out */
+
+#define RATE 48000
+#define CHANNELS 2
+
+static void fill_square(pa_memchunk *c, int16_t amplitude) {
+    int16_t *d;
+    size_t k, n;
+
+    n = c->length / sizeof(int16_t);
+    d = pa_memblock_acquire(c->memblock);
+
+    for (k = 0; k < n; k++)
+        d[k] = (k / CHANNELS) % 2 ? amplitude : (int16_t) -amplitude;
+
+    pa_memblock_release(c->memblock);
+}
+
+/* Adds frames in chunks of 333 frames */
+static void feed(pa_level_meter *m, pa_memchunk *c, const pa_sample_spec *ss, const pa_cvolume *volume, size_t frames) {
+    pa_memchunk part = *c;
+
+    while (frames > 0) {
+        size_t n = PA_MIN(frames, (size_t) 333);
+
+        part.length = n * pa_frame_size(ss);
+        pa_level_meter_add(m, &part, ss, volume);
+        frames -= n;
+    }
+}
+
+static void check(pa_level_meter *m, float peak, float rms) {
+    float p, r;
+
+    pa_level_meter_read(m, &p, &r);
+    pa_log_debug("peak %0.4f (expected %0.4f), rms %0.4f (expected %0.4f)", p, peak, r, rms);
+
+    pa_assert_se(fabsf(p - peak) < 0.001f);
+    pa_assert_se(fabsf(r - rms) < 0.001f);
+}
+
+int main(int argc, char *argv[]) {
+    pa_mempool *pool;
+    pa_sample_spec ss;
+    pa_cvolume volume;
+    pa_memchunk c, silence;
+    pa_silence_cache cache;
+    pa_level_meter m;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    pa_assert_se(pool = pa_mempool_new(FALSE, 0));
+
+    ss.format = PA_SAMPLE_S16NE;
+    ss.rate = RATE;
+    ss.channels = CHANNELS;
+
+    c.memblock = pa_memblock_new(pool, 333 * pa_frame_size(&ss));
+    c.index = 0;
+    c.length = pa_memblock_get_length(c.memblock);
+    fill_square(&c, 0x4000);
+
+    pa_silence_cache_init(&cache);
+    pa_silence_memchunk_get(&cache, pool, &silence, &ss, 333 * pa_frame_size(&ss));
+
+    pa_level_meter_init(&m);
+
+    /* Disabled meters don't measure */
+    feed(&m, &c, &ss, NULL, RATE / 10);
+    check(&m, 0, 0);
+
+    pa_level_meter_set_enabled(&m, TRUE);
+
+    /* A square wave has the same peak and RMS level. Only finished
+     * blocks of 10 ms count. */
+    feed(&m, &c, &ss, NULL, RATE / 10 + RATE / 200);
+    check(&m, 0.5f, 0.5f);
+
+    /* The half block left over is completed with silence */
+    feed(&m, &silence, &ss, NULL, RATE / 200);
+    check(&m, 0.5f, sqrtf(0.125f));
+
+    feed(&m, &silence, &ss, NULL, RATE / 10);
+    check(&m, 0, 0);
+
+    /* The volume is applied per channel */
+    pa_cvolume_set(&volume, CHANNELS, PA_VOLUME_NORM);
+    volume.values[1] = pa_sw_volume_from_linear(0.5);
+    feed(&m, &c, &ss, &volume, RATE / 10);
+    check(&m, 0.5f, sqrtf((0.25f + 0.0625f) / 2));
+
+    pa_cvolume_mute(&volume, CHANNELS);
+    feed(&m, &c, &ss, &volume, RATE / 10);
+    check(&m, 0, 0);
+
+    /* Nothing read twice */
+    check(&m, 0, 0);
+
+    pa_level_meter_set_enabled(&m, FALSE);
+    feed(&m, &c, &ss, NULL, RATE / 10);
+    check(&m, 0, 0);
+
+    pa_memblock_unref(c.memblock);
+    pa_memblock_unref(silence.memblock);
+    pa_silence_cache_done(&cache);
+    pa_mempool_free(pool);
+
+    return 0;
+}
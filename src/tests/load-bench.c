@@ -0,0 +1,740 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+
+#include <pulse/pulseaudio.h>
+#include <pulse/mainloop.h>
+#include <pulse/rtclock.h>
+
+#include <pulsecore/core-rtclock.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+/* Puts a running daemon under a growing load. Clients are added in
+ * steps, each with a number of playback and record streams of varying
+ * sample specs, every other one without SHM. Once all streams of a step
+ * are running the clients keep changing the volume of their streams,
+ * moving them between sinks and subscribing again for a while, and
+ * every client is subscribed to all events, which it gets for the
+ * changes of all the others too.
+ *
+ * For each step a line of JSON is written to STDOUT with the CPU time
+ * the daemon took, in total and per stream, its resident memory, how
+ * many underruns and overruns the streams saw and percentiles of the
+ * round trip time of the commands. The daemon is found through its PID
+ * file, unless --pid is given; without it CPU and memory are left out.
+ *
+ * Usage: load-bench [--clients N] [--step N] [--streams N]
+ *                   [--duration SEC] [--rate N] [--latency-msec N]
+ *                   [--shm on|off|mixed] [--pid PID] */
+
+#define SETUP_TIMEOUT_USEC (30 * PA_USEC_PER_SEC)
+#define SETTLE_USEC PA_USEC_PER_SEC
+#define MAX_PENDING 64
+#define MAX_SINKS 32
+
+/* The sample specs the streams get in turn */
+static const pa_sample_spec sample_specs[] = {
+    { PA_SAMPLE_S16LE, 44100, 2 },
+    { PA_SAMPLE_FLOAT32LE, 48000, 2 },
+    { PA_SAMPLE_S16LE, 22050, 1 },
+    { PA_SAMPLE_S32LE, 96000, 6 },
+};
+
+struct load_stream {
+    pa_stream *stream;
+    pa_sample_spec ss;
+    pa_bool_t playback;
+    pa_bool_t ready;
+};
+
+struct client {
+    pa_context *context;
+    pa_bool_t ready;
+
+    struct load_stream *streams;
+
+    /* The server answers the commands of a connection in order, so the
+     * times they were sent at are simply queued */
+    pa_usec_t pending[MAX_PENDING];
+    unsigned pending_idx, n_pending;
+};
+
+enum shm_mode {
+    SHM_ON,
+    SHM_OFF,
+    SHM_MIXED
+};
+
+enum phase {
+    PHASE_SETUP,
+    PHASE_SETTLE,
+    PHASE_MEASURE
+};
+
+static pa_mainloop_api *api = NULL;
+static pa_time_event *phase_event = NULL, *storm_event = NULL;
+static enum phase phase;
+static pa_usec_t phase_start;
+
+static unsigned max_clients = 16, clients_per_step = 4, streams_per_client = 2;
+static unsigned rate = 20, latency_msec = 50;
+static pa_usec_t duration = 5 * PA_USEC_PER_SEC;
+static enum shm_mode shm_mode = SHM_MIXED;
+static pid_t server_pid = 0;
+static char *conf_shm = NULL, *conf_no_shm = NULL, *user_conf = NULL;
+
+static struct client *clients = NULL;
+static unsigned n_clients = 0;
+
+static uint32_t sinks[MAX_SINKS];
+static unsigned n_sinks = 0;
+
+/* Counters of the current measurement */
+static unsigned n_underruns, n_overruns, n_failed, n_latencies, n_latencies_allocated;
+static pa_usec_t *latencies = NULL;
+static unsigned long long cpu_ticks_start;
+
+static void fail(const char *what, pa_context *c) {
+    pa_log("%s: %s", what, c ? pa_strerror(pa_context_errno(c)) : "timeout");
+    api->quit(api, 1);
+}
+
+static int read_cpu_ticks(unsigned long long *ticks) {
+    char *fn, *line, *p;
+    unsigned long long utime, stime;
+
+    fn = pa_sprintf_malloc("/proc/%lu/stat", (unsigned long) server_pid);
+    line = pa_read_line_from_file(fn);
+    pa_xfree(fn);
+
+    if (!line)
+        return -1;
+
+    /* The name may contain anything, the fields follow its ")" */
+    if (!(p = strrchr(line, ')')) ||
+        sscanf(p + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &utime, &stime) != 2) {
+        pa_xfree(line);
+        return -1;
+    }
+
+    pa_xfree(line);
+    *ticks = utime + stime;
+    return 0;
+}
+
+static long read_rss_kb(void) {
+    char *fn, buf[256];
+    FILE *f;
+    long kb = -1;
+
+    fn = pa_sprintf_malloc("/proc/%lu/status", (unsigned long) server_pid);
+    f = pa_fopen_cloexec(fn, "r");
+    pa_xfree(fn);
+
+    if (!f)
+        return -1;
+
+    while (fgets(buf, sizeof(buf), f))
+        if (sscanf(buf, "VmRSS: %ld kB", &kb) == 1)
+            break;
+
+    fclose(f);
+    return kb;
+}
+
+static int latency_compare(const void *a, const void *b) {
+    pa_usec_t x = *(const pa_usec_t*) a, y = *(const pa_usec_t*) b;
+
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static double percentile_msec(unsigned p) {
+    if (n_latencies == 0)
+        return 0;
+
+    return (double) latencies[PA_MIN((n_latencies * p) / 100, n_latencies - 1)] / PA_USEC_PER_MSEC;
+}
+
+static void add_latency(pa_usec_t t) {
+    if (n_latencies >= n_latencies_allocated) {
+        n_latencies_allocated = PA_MAX(256U, n_latencies_allocated * 2);
+        latencies = pa_xrenew(pa_usec_t, latencies, n_latencies_allocated);
+    }
+
+    latencies[n_latencies++] = t;
+}
+
+static void reset_counters(void) {
+    n_underruns = n_overruns = n_failed = n_latencies = 0;
+
+    if (server_pid > 0 && read_cpu_ticks(&cpu_ticks_start) < 0)
+        server_pid = 0;
+}
+
+static void print_result(void) {
+    unsigned n_streams = n_clients * streams_per_client;
+
+    qsort(latencies, n_latencies, sizeof(pa_usec_t), latency_compare);
+
+    printf("{\"clients\":%u,\"streams\":%u,", n_clients, n_streams);
+
+    if (server_pid > 0) {
+        unsigned long long ticks;
+        double cpu = -1;
+
+        if (read_cpu_ticks(&ticks) == 0)
+            cpu = (double) (ticks - cpu_ticks_start) / (double) sysconf(_SC_CLK_TCK) * 100.0 * PA_USEC_PER_SEC / (double) duration;
+
+        printf("\"cpu_percent\":%0.2f,\"cpu_percent_per_stream\":%0.3f,\"rss_kb\":%ld,",
+               cpu, cpu / n_streams, read_rss_kb());
+    }
+
+    printf("\"underruns\":%u,\"overruns\":%u,\"commands\":%u,\"failed_commands\":%u,"
+           "\"rtt_ms\":{\"p50\":%0.2f,\"p90\":%0.2f,\"p99\":%0.2f,\"max\":%0.2f}}\n",
+           n_underruns, n_overruns, n_latencies, n_failed,
+           percentile_msec(50), percentile_msec(90), percentile_msec(99),
+           n_latencies > 0 ? (double) latencies[n_latencies - 1] / PA_USEC_PER_MSEC : 0.0);
+
+    fflush(stdout);
+}
+
+/* Commands */
+
+static void command_cb(pa_context *c, int success, void *userdata) {
+    struct client *cl = userdata;
+    pa_usec_t sent;
+
+    pa_assert(cl->n_pending > 0);
+
+    sent = cl->pending[cl->pending_idx];
+    cl->pending_idx = (cl->pending_idx + 1) % MAX_PENDING;
+    cl->n_pending--;
+
+    /* Answers to commands of an earlier phase are only dequeued */
+    if (phase != PHASE_MEASURE || sent < phase_start)
+        return;
+
+    add_latency(pa_rtclock_now() - sent);
+
+    if (!success)
+        n_failed++;
+}
+
+static pa_bool_t command_begin(struct client *cl) {
+    if (cl->n_pending >= MAX_PENDING)
+        return FALSE;
+
+    cl->pending[(cl->pending_idx + cl->n_pending) % MAX_PENDING] = pa_rtclock_now();
+    cl->n_pending++;
+    return TRUE;
+}
+
+static void command_end(struct client *cl, pa_operation *o) {
+    if (!o) {
+        /* Nothing was sent, take the entry back */
+        cl->n_pending--;
+        n_failed++;
+        return;
+    }
+
+    pa_operation_unref(o);
+}
+
+static void send_command(struct client *cl) {
+    struct load_stream *ls = &cl->streams[(unsigned) rand() % streams_per_client];
+    uint32_t idx = pa_stream_get_index(ls->stream);
+    pa_operation *o = NULL;
+    unsigned what = (unsigned) rand() % 3;
+
+    if (!command_begin(cl))
+        return;
+
+    if (what == 0) {
+        pa_cvolume v;
+
+        pa_cvolume_set(&v, ls->ss.channels, (pa_volume_t) (PA_VOLUME_NORM / 4 + (unsigned) rand() % (PA_VOLUME_NORM / 2)));
+
+        if (ls->playback)
+            o = pa_context_set_sink_input_volume(cl->context, idx, &v, command_cb, cl);
+        else
+            o = pa_context_set_source_output_volume(cl->context, idx, &v, command_cb, cl);
+
+    } else if (what == 1 && ls->playback && n_sinks > 0)
+        o = pa_context_move_sink_input_by_index(cl->context, idx, sinks[(unsigned) rand() % n_sinks], command_cb, cl);
+    else
+        o = pa_context_subscribe(cl->context, PA_SUBSCRIPTION_MASK_ALL, command_cb, cl);
+
+    command_end(cl, o);
+}
+
+static void storm_cb(pa_mainloop_api *a, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    struct timeval ntv;
+    unsigned i;
+
+    for (i = 0; i < n_clients; i++)
+        send_command(&clients[i]);
+
+    a->time_restart(e, pa_timeval_rtstore(&ntv, pa_rtclock_now() + PA_USEC_PER_SEC / rate, TRUE));
+}
+
+/* Streams */
+
+static void stream_write_cb(pa_stream *s, size_t nbytes, void *userdata) {
+    void *data;
+
+    while (nbytes > 0) {
+        size_t n = nbytes;
+
+        if (pa_stream_begin_write(s, &data, &n) < 0 || !data) {
+            fail("pa_stream_begin_write() failed", pa_stream_get_context(s));
+            return;
+        }
+
+        memset(data, 0, n);
+
+        if (pa_stream_write(s, data, n, NULL, 0, PA_SEEK_RELATIVE) < 0) {
+            fail("pa_stream_write() failed", pa_stream_get_context(s));
+            return;
+        }
+
+        nbytes -= PA_MIN(n, nbytes);
+    }
+}
+
+static void stream_read_cb(pa_stream *s, size_t nbytes, void *userdata) {
+    const void *data;
+
+    while (pa_stream_readable_size(s) > 0) {
+        if (pa_stream_peek(s, &data, &nbytes) < 0) {
+            fail("pa_stream_peek() failed", pa_stream_get_context(s));
+            return;
+        }
+
+        pa_stream_drop(s);
+    }
+}
+
+static void stream_underflow_cb(pa_stream *s, void *userdata) {
+    if (phase == PHASE_MEASURE)
+        n_underruns++;
+}
+
+static void stream_overflow_cb(pa_stream *s, void *userdata) {
+    if (phase == PHASE_MEASURE)
+        n_overruns++;
+}
+
+static void stream_state_cb(pa_stream *s, void *userdata) {
+    struct load_stream *ls = userdata;
+
+    switch (pa_stream_get_state(s)) {
+        case PA_STREAM_READY:
+            ls->ready = TRUE;
+            break;
+
+        case PA_STREAM_FAILED:
+            fail("Stream failed", pa_stream_get_context(s));
+            break;
+
+        default:
+            ;
+    }
+}
+
+static void create_streams(struct client *cl, unsigned client_idx) {
+    unsigned i;
+
+    cl->streams = pa_xnew0(struct load_stream, streams_per_client);
+
+    for (i = 0; i < streams_per_client; i++) {
+        struct load_stream *ls = &cl->streams[i];
+        pa_buffer_attr attr;
+        char name[64];
+        int r;
+
+        ls->ss = sample_specs[(client_idx + i) % PA_ELEMENTSOF(sample_specs)];
+        ls->playback = i % 2 == 0;
+
+        pa_snprintf(name, sizeof(name), "load-bench %u/%u", client_idx, i);
+        pa_assert_se(ls->stream = pa_stream_new(cl->context, name, &ls->ss, NULL));
+
+        pa_stream_set_state_callback(ls->stream, stream_state_cb, ls);
+
+        attr.maxlength = (uint32_t) -1;
+        attr.tlength = attr.fragsize = (uint32_t) pa_usec_to_bytes(latency_msec * PA_USEC_PER_MSEC, &ls->ss);
+        attr.prebuf = attr.minreq = (uint32_t) -1;
+
+        if (ls->playback) {
+            pa_stream_set_write_callback(ls->stream, stream_write_cb, ls);
+            pa_stream_set_underflow_callback(ls->stream, stream_underflow_cb, ls);
+            r = pa_stream_connect_playback(ls->stream, NULL, &attr, PA_STREAM_ADJUST_LATENCY, NULL, NULL);
+        } else {
+            pa_stream_set_read_callback(ls->stream, stream_read_cb, ls);
+            pa_stream_set_overflow_callback(ls->stream, stream_overflow_cb, ls);
+            r = pa_stream_connect_record(ls->stream, NULL, &attr, PA_STREAM_ADJUST_LATENCY);
+        }
+
+        if (r < 0)
+            fail("Failed to connect stream", cl->context);
+    }
+}
+
+/* Clients */
+
+static void subscribe_cb(pa_context *c, pa_subscription_event_type_t t, uint32_t idx, void *userdata) {
+    /* Only there so that the daemon has to send the events */
+}
+
+static void sink_info_cb(pa_context *c, const pa_sink_info *i, int eol, void *userdata) {
+    if (eol || n_sinks >= MAX_SINKS)
+        return;
+
+    sinks[n_sinks++] = i->index;
+}
+
+static void context_state_cb(pa_context *c, void *userdata) {
+    struct client *cl = userdata;
+    unsigned client_idx = (unsigned) (cl - clients);
+
+    switch (pa_context_get_state(c)) {
+
+        case PA_CONTEXT_READY:
+            cl->ready = TRUE;
+
+            /* The first one finds out where streams can be moved to */
+            if (client_idx == 0)
+                pa_operation_unref(pa_context_get_sink_info_list(c, sink_info_cb, NULL));
+
+            pa_context_set_subscribe_callback(c, subscribe_cb, cl);
+            pa_operation_unref(pa_context_subscribe(c, PA_SUBSCRIPTION_MASK_ALL, NULL, NULL));
+
+            create_streams(cl, client_idx);
+            break;
+
+        case PA_CONTEXT_FAILED:
+            fail("Connection failed", c);
+            break;
+
+        default:
+            ;
+    }
+}
+
+static void add_clients(void) {
+    unsigned i, n = PA_MIN(n_clients + clients_per_step, max_clients);
+
+    for (i = n_clients; i < n; i++) {
+        struct client *cl = &clients[i];
+        pa_bool_t shm = shm_mode == SHM_ON || (shm_mode == SHM_MIXED && i % 2 == 0);
+
+        /* The configuration is read when the context is created */
+        pa_assert_se(setenv("PULSE_CLIENTCONFIG", shm ? conf_shm : conf_no_shm, 1) == 0);
+
+        pa_assert_se(cl->context = pa_context_new(api, "load-bench"));
+        pa_context_set_state_callback(cl->context, context_state_cb, cl);
+        n_clients = i + 1;
+
+        if (pa_context_connect(cl->context, NULL, PA_CONTEXT_NOAUTOSPAWN, NULL) < 0) {
+            fail("pa_context_connect() failed", cl->context);
+            break;
+        }
+    }
+
+    if (user_conf)
+        setenv("PULSE_CLIENTCONFIG", user_conf, 1);
+    else
+        unsetenv("PULSE_CLIENTCONFIG");
+}
+
+static pa_bool_t all_ready(void) {
+    unsigned i, j;
+
+    for (i = 0; i < n_clients; i++) {
+        if (!clients[i].ready)
+            return FALSE;
+
+        for (j = 0; j < streams_per_client; j++)
+            if (!clients[i].streams[j].ready)
+                return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void enter_phase(enum phase p, pa_usec_t timeout) {
+    struct timeval tv;
+
+    phase = p;
+    phase_start = pa_rtclock_now();
+    api->time_restart(phase_event, pa_timeval_rtstore(&tv, phase_start + timeout, TRUE));
+}
+
+static void phase_cb(pa_mainloop_api *a, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    struct timeval ntv;
+
+    switch (phase) {
+
+        case PHASE_SETUP:
+            if (!all_ready()) {
+                if (pa_rtclock_now() - phase_start > SETUP_TIMEOUT_USEC) {
+                    fail("Streams did not get ready", NULL);
+                    return;
+                }
+
+                a->time_restart(e, pa_timeval_rtstore(&ntv, pa_rtclock_now() + 10 * PA_USEC_PER_MSEC, TRUE));
+                return;
+            }
+
+            a->time_restart(storm_event, pa_timeval_rtstore(&ntv, pa_rtclock_now() + PA_USEC_PER_SEC / rate, TRUE));
+            enter_phase(PHASE_SETTLE, SETTLE_USEC);
+            break;
+
+        case PHASE_SETTLE:
+            reset_counters();
+            enter_phase(PHASE_MEASURE, duration);
+            break;
+
+        case PHASE_MEASURE:
+            a->time_restart(storm_event, NULL);
+            print_result();
+
+            if (n_clients >= max_clients) {
+                a->quit(a, 0);
+                return;
+            }
+
+            add_clients();
+            enter_phase(PHASE_SETUP, 0);
+            break;
+    }
+}
+
+static char* write_client_conf(const char *line) {
+    char *fn;
+    int fd;
+
+    fn = pa_sprintf_malloc("%s/load-bench-XXXXXX", pa_get_temp_dir());
+    pa_assert_se((fd = mkstemp(fn)) >= 0);
+    pa_assert_se(pa_loop_write(fd, line, strlen(line), NULL) == (ssize_t) strlen(line));
+    pa_close(fd);
+
+    return fn;
+}
+
+static void help(const char *argv0) {
+    printf("%s [options]\n\n"
+           "-h, --help                Show this help\n"
+           "    --clients=N           Number of clients at the end (default %u)\n"
+           "    --step=N              Number of clients added per step (default %u)\n"
+           "    --streams=N           Streams per client, playback and record in turn (default %u)\n"
+           "    --duration=SEC        How long each step is measured (default %u)\n"
+           "    --rate=N              Commands per client and second (default %u)\n"
+           "    --latency-msec=N      Buffer size the streams ask for (default %u)\n"
+           "    --shm=on|off|mixed    Which clients use SHM (default mixed)\n"
+           "    --pid=PID             Process ID of the daemon\n",
+           argv0, max_clients, clients_per_step, streams_per_client,
+           (unsigned) (duration / PA_USEC_PER_SEC), rate, latency_msec);
+}
+
+enum {
+    ARG_CLIENTS = 256,
+    ARG_STEP,
+    ARG_STREAMS,
+    ARG_DURATION,
+    ARG_RATE,
+    ARG_LATENCY_MSEC,
+    ARG_SHM,
+    ARG_PID
+};
+
+static int parse_unsigned(const char *s, unsigned *ret) {
+    uint32_t u;
+
+    if (pa_atou(s, &u) < 0 || u == 0) {
+        pa_log("Invalid number: %s", s);
+        return -1;
+    }
+
+    *ret = u;
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    static const struct option long_options[] = {
+        {"help",         0, NULL, 'h'},
+        {"clients",      1, NULL, ARG_CLIENTS},
+        {"step",         1, NULL, ARG_STEP},
+        {"streams",      1, NULL, ARG_STREAMS},
+        {"duration",     1, NULL, ARG_DURATION},
+        {"rate",         1, NULL, ARG_RATE},
+        {"latency-msec", 1, NULL, ARG_LATENCY_MSEC},
+        {"shm",          1, NULL, ARG_SHM},
+        {"pid",          1, NULL, ARG_PID},
+        {NULL,           0, NULL, 0}
+    };
+
+    pa_mainloop *m;
+    unsigned u, i, j;
+    int c, ret = 1;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_INFO);
+    else {
+        max_clients = 4;
+        duration = PA_USEC_PER_SEC;
+    }
+
+    while ((c = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+
+        switch (c) {
+            case 'h':
+                help(argv[0]);
+                return 0;
+
+            case ARG_CLIENTS:
+                if (parse_unsigned(optarg, &max_clients) < 0)
+                    return 1;
+                break;
+
+            case ARG_STEP:
+                if (parse_unsigned(optarg, &clients_per_step) < 0)
+                    return 1;
+                break;
+
+            case ARG_STREAMS:
+                if (parse_unsigned(optarg, &streams_per_client) < 0)
+                    return 1;
+                break;
+
+            case ARG_DURATION:
+                if (parse_unsigned(optarg, &u) < 0)
+                    return 1;
+                duration = u * PA_USEC_PER_SEC;
+                break;
+
+            case ARG_RATE:
+                if (parse_unsigned(optarg, &rate) < 0)
+                    return 1;
+                break;
+
+            case ARG_LATENCY_MSEC:
+                if (parse_unsigned(optarg, &latency_msec) < 0)
+                    return 1;
+                break;
+
+            case ARG_SHM:
+                if (pa_streq(optarg, "on"))
+                    shm_mode = SHM_ON;
+                else if (pa_streq(optarg, "off"))
+                    shm_mode = SHM_OFF;
+                else if (pa_streq(optarg, "mixed"))
+                    shm_mode = SHM_MIXED;
+                else {
+                    pa_log("Invalid SHM mode: %s", optarg);
+                    return 1;
+                }
+                break;
+
+            case ARG_PID:
+                if (parse_unsigned(optarg, &u) < 0)
+                    return 1;
+                server_pid = (pid_t) u;
+                break;
+
+            default:
+                help(argv[0]);
+                return 1;
+        }
+    }
+
+    if (server_pid == 0) {
+        char *fn, *line;
+
+        if ((fn = pa_runtime_path("pid")) && (line = pa_read_line_from_file(fn))) {
+            if (pa_atou(line, &u) >= 0)
+                server_pid = (pid_t) u;
+            pa_xfree(line);
+        }
+
+        pa_xfree(fn);
+    }
+
+    if (server_pid == 0)
+        pa_log_info("Daemon not found, not measuring its CPU and memory.");
+
+    srand(0);
+
+    user_conf = pa_xstrdup(getenv("PULSE_CLIENTCONFIG"));
+    conf_shm = write_client_conf("enable-shm = yes\n");
+    conf_no_shm = write_client_conf("disable-shm = yes\n");
+
+    clients = pa_xnew0(struct client, max_clients);
+
+    pa_assert_se(m = pa_mainloop_new());
+    api = pa_mainloop_get_api(m);
+
+    pa_assert_se(phase_event = api->time_new(api, NULL, phase_cb, NULL));
+    pa_assert_se(storm_event = api->time_new(api, NULL, storm_cb, NULL));
+
+    add_clients();
+    enter_phase(PHASE_SETUP, 0);
+
+    pa_mainloop_run(m, &ret);
+
+    for (i = 0; i < n_clients; i++) {
+        if (clients[i].streams) {
+            for (j = 0; j < streams_per_client; j++)
+                if (clients[i].streams[j].stream) {
+                    pa_stream_disconnect(clients[i].streams[j].stream);
+                    pa_stream_unref(clients[i].streams[j].stream);
+                }
+
+            pa_xfree(clients[i].streams);
+        }
+
+        pa_context_disconnect(clients[i].context);
+        pa_context_unref(clients[i].context);
+    }
+
+    api->time_free(storm_event);
+    api->time_free(phase_event);
+    pa_mainloop_free(m);
+
+    unlink(conf_shm);
+    unlink(conf_no_shm);
+    pa_xfree(conf_shm);
+    pa_xfree(conf_no_shm);
+    pa_xfree(user_conf);
+    pa_xfree(clients);
+    pa_xfree(latencies);
+
+    return ret;
+}
@@ -0,0 +1,182 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <pulse/mainloop.h>
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-rtclock.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#define N_TIMERS 500
+
+static pa_time_event *timers[N_TIMERS];
+static unsigned n_calls[N_TIMERS];
+static unsigned n_fired = 0, n_expected = 0;
+static pa_usec_t base, last_time = 0;
+
+static void timer_cb(pa_mainloop_api *a, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    int i = PA_PTR_TO_INT(userdata);
+    pa_usec_t t = pa_timeval_load(tv);
+
+    pa_assert_se(t >= last_time);
+    last_time = t;
+
+    n_fired++;
+
+    if (n_calls[i]++ == 0) {
+        /* Every tenth timer frees the next one before it is due */
+        if (i % 10 == 0 && i + 1 < N_TIMERS) {
+            a->time_free(timers[i + 1]);
+            timers[i + 1] = NULL;
+        }
+
+        /* Every seventh one is restarted to fire again after all others */
+        if (i % 7 == 0) {
+            struct timeval ntv;
+
+            a->time_restart(e, pa_timeval_rtstore(&ntv, base + (pa_usec_t) (N_TIMERS + 20 + i) * PA_USEC_PER_MSEC, TRUE));
+        }
+    }
+
+    if (n_fired >= n_expected)
+        a->quit(a, 0);
+}
+
+static void check_timers(void) {
+    pa_mainloop *m;
+    pa_mainloop_api *a;
+    struct timeval tv;
+    int i, retval;
+
+    pa_assert_se(m = pa_mainloop_new());
+    a = pa_mainloop_get_api(m);
+
+    base = pa_rtclock_now();
+
+    /* Created in reverse order of expiry */
+    for (i = N_TIMERS - 1; i >= 0; i--)
+        timers[i] = a->time_new(a, pa_timeval_rtstore(&tv, base + (pa_usec_t) (i + 1) * PA_USEC_PER_MSEC, TRUE), timer_cb, PA_INT_TO_PTR(i));
+
+    /* Disable one and move another one behind all others */
+    a->time_restart(timers[3], NULL);
+    a->time_restart(timers[5], pa_timeval_rtstore(&tv, base + (pa_usec_t) (N_TIMERS + 10) * PA_USEC_PER_MSEC, TRUE));
+
+    for (i = 0; i < N_TIMERS; i++)
+        if (i != 3 && i % 10 != 1)
+            n_expected += i % 7 == 0 ? 2 : 1;
+
+    pa_assert_se(pa_mainloop_run(m, &retval) == 1);
+    pa_assert_se(retval == 0);
+
+    pa_log_debug("%u timers fired", n_fired);
+
+    for (i = 0; i < N_TIMERS; i++) {
+        if (i == 3 || i % 10 == 1)
+            pa_assert_se(n_calls[i] == 0);
+        else
+            pa_assert_se(n_calls[i] == (i % 7 == 0 ? 2U : 1U));
+    }
+
+    pa_mainloop_free(m);
+}
+
+struct pipe_io {
+    int fds[2];
+    pa_io_event *e;
+    unsigned n_read;
+};
+
+static unsigned n_io_done = 0;
+
+static void io_cb(pa_mainloop_api *a, pa_io_event *e, int fd, pa_io_event_flags_t f, void *userdata) {
+    struct pipe_io *p = userdata;
+    char c;
+
+    pa_assert_se(f & PA_IO_EVENT_INPUT);
+    pa_assert_se(read(fd, &c, 1) == 1);
+
+    if (++p->n_read < 3) {
+        /* Keep the pipe readable for another iteration */
+        pa_assert_se(write(p->fds[1], "x", 1) == 1);
+        return;
+    }
+
+    a->io_free(e);
+    p->e = NULL;
+
+    if (++n_io_done >= 4)
+        a->quit(a, 0);
+}
+
+static void check_io(void) {
+    pa_mainloop *m;
+    pa_mainloop_api *a;
+    struct pipe_io pipes[4];
+    int i, retval;
+
+    pa_assert_se(m = pa_mainloop_new());
+    a = pa_mainloop_get_api(m);
+
+    for (i = 0; i < 4; i++) {
+        pa_assert_se(pipe(pipes[i].fds) == 0);
+        pipes[i].n_read = 0;
+        pipes[i].e = a->io_new(a, pipes[i].fds[0], PA_IO_EVENT_INPUT, io_cb, &pipes[i]);
+        pa_assert_se(write(pipes[i].fds[1], "x", 1) == 1);
+    }
+
+    /* Nothing is dispatched for a disabled event */
+    a->io_enable(pipes[0].e, PA_IO_EVENT_NULL);
+    pa_assert_se(pa_mainloop_iterate(m, 1, NULL) >= 0);
+    pa_assert_se(pipes[0].n_read == 0);
+    a->io_enable(pipes[0].e, PA_IO_EVENT_INPUT);
+
+    pa_assert_se(pa_mainloop_run(m, &retval) == 1);
+    pa_assert_se(retval == 0);
+
+    for (i = 0; i < 4; i++) {
+        pa_assert_se(pipes[i].n_read == 3);
+        pa_assert_se(!pipes[i].e);
+        pa_close_pipe(pipes[i].fds);
+    }
+
+    pa_mainloop_free(m);
+}
+
+int main(int argc, char *argv[]) {
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    check_timers();
+    check_io();
+
+    return 0;
+}
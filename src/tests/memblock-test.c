@@ -22,6 +22,7 @@
 #endif
 
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <pulse/xmalloc.h>
@@ -52,6 +53,7 @@ static void print_stats(pa_mempool *p, const char *text) {
                  "\texported_size = %u\n"
                  "\tn_too_large_for_pool = %u\n"
                  "\tn_pool_full = %u\n"
+                 "\tn_export_failed = %u\n"
                  "}",
            text,
            (unsigned) pa_atomic_load(&s->n_allocated),
@@ -63,11 +65,12 @@ static void print_stats(pa_mempool *p, const char *text) {
            (unsigned) pa_atomic_load(&s->imported_size),
            (unsigned) pa_atomic_load(&s->exported_size),
            (unsigned) pa_atomic_load(&s->n_too_large_for_pool),
-           (unsigned) pa_atomic_load(&s->n_pool_full));
+           (unsigned) pa_atomic_load(&s->n_pool_full),
+           (unsigned) pa_atomic_load(&s->n_export_failed));
 }
 
 int main(int argc, char *argv[]) {
-    pa_mempool *pool_a, *pool_b, *pool_c;
+    pa_mempool *pool_a, *pool_b, *pool_c, *pool_d, *pool_e, *pool_f;
     unsigned id_a, id_b, id_c;
     pa_memexport *export_a, *export_b;
     pa_memimport *import_b, *import_c;
@@ -76,7 +79,11 @@ int main(int argc, char *argv[]) {
     pa_memblock* blocks[5];
     uint32_t id, shm_id;
     size_t offset, size;
+    int memfd;
     char *x;
+    uint32_t ids[PA_MEMEXPORT_BLOCKS_DEFAULT];
+    unsigned k;
+    int n_failed;
 
     const char txt[] = "This is a test!";
 
@@ -124,15 +131,16 @@ int main(int argc, char *argv[]) {
 
         pa_assert(import_b && import_c);
 
-        r = pa_memexport_put(export_a, mb_a, &id, &shm_id, &offset, &size);
+        r = pa_memexport_put(export_a, mb_a, &id, &shm_id, &offset, &size, &memfd);
         pa_assert(r >= 0);
         pa_assert(shm_id == id_a);
+        pa_assert(memfd < 0);
 
         pa_log("A: Memory block exported as %u", id);
 
         mb_b = pa_memimport_get(import_b, id, shm_id, offset, size);
         pa_assert(mb_b);
-        r = pa_memexport_put(export_b, mb_b, &id, &shm_id, &offset, &size);
+        r = pa_memexport_put(export_b, mb_b, &id, &shm_id, &offset, &size, &memfd);
         pa_assert(r >= 0);
         pa_assert(shm_id == id_a || shm_id == id_b);
         pa_memblock_unref(mb_b);
@@ -163,6 +171,176 @@ int main(int argc, char *argv[]) {
         pa_memexport_free(export_a);
     }
 
+    /* An export hands out a limited number of blocks at a time, and
+     * counts those it refuses */
+    export_a = pa_memexport_new(pool_a, revoke_cb, (void*) "A");
+    mb_a = pa_memblock_new(pool_a, sizeof(txt));
+    n_failed = pa_atomic_load(&pa_mempool_get_stat(pool_a)->n_export_failed);
+
+    for (k = 0; k < PA_MEMEXPORT_BLOCKS_DEFAULT; k++) {
+        pa_assert_se(pa_memexport_put(export_a, mb_a, &ids[k], &shm_id, &offset, &size, &memfd) >= 0);
+        pa_assert_se(k == 0 || ids[k] != ids[k-1]);
+    }
+
+    pa_assert_se(pa_memexport_put(export_a, mb_a, &id, &shm_id, &offset, &size, &memfd) < 0);
+    pa_assert_se(pa_atomic_load(&pa_mempool_get_stat(pool_a)->n_export_failed) == n_failed + 1);
+
+    pa_memexport_set_max_blocks(export_a, PA_MEMIMPORT_BLOCKS_MAX);
+    pa_assert_se(pa_memexport_put(export_a, mb_a, &id, &shm_id, &offset, &size, &memfd) >= 0);
+    pa_assert_se(pa_atomic_load(&pa_mempool_get_stat(pool_a)->n_exported) == PA_MEMEXPORT_BLOCKS_DEFAULT + 1);
+
+    pa_assert_se(pa_memexport_process_release(export_a, ids[0]) >= 0);
+    pa_assert_se(pa_memexport_process_release(export_a, ids[0]) < 0);
+
+    /* A block that is taken back unsent counts as failed too */
+    pa_assert_se(pa_memexport_cancel(export_a, id) >= 0);
+    pa_assert_se(pa_atomic_load(&pa_mempool_get_stat(pool_a)->n_export_failed) == n_failed + 2);
+
+    print_stats(pool_a, "A");
+
+    pa_memexport_free(export_a);
+    pa_assert_se(pa_atomic_load(&pa_mempool_get_stat(pool_a)->n_exported) == 0);
+    pa_memblock_unref(mb_a);
+
+    /* Blocks from memfd pools can only be imported once the fd has
+     * been handed over */
+    if ((pool_d = pa_mempool_new_memfd(0))) {
+        pa_assert(pa_mempool_is_memfd(pool_d));
+
+        mb_a = pa_memblock_new(pool_d, sizeof(txt));
+        x = pa_memblock_acquire(mb_a);
+        snprintf(x, pa_memblock_get_length(mb_a), "%s", txt);
+        pa_memblock_release(mb_a);
+
+        export_a = pa_memexport_new(pool_d, revoke_cb, (void*) "D");
+        import_c = pa_memimport_new(pool_c, release_cb, (void*) "C");
+
+        r = pa_memexport_put(export_a, mb_a, &id, &shm_id, &offset, &size, &memfd);
+        pa_assert(r >= 0);
+        pa_assert(memfd >= 0);
+
+        pa_assert_se(!pa_memimport_get(import_c, id, shm_id, offset, size));
+        pa_assert_se(pa_memimport_attach_memfd(import_c, shm_id, dup(memfd)) >= 0);
+
+        mb_c = pa_memimport_get(import_c, id, shm_id, offset, size);
+        pa_assert(mb_c);
+        x = pa_memblock_acquire(mb_c);
+        pa_log_debug("memfd data=%s", x);
+        pa_assert(strcmp(x, txt) == 0);
+        pa_memblock_release(mb_c);
+        pa_memblock_unref(mb_c);
+
+        /* The segment stays attached after its last block is gone */
+        mb_c = pa_memimport_get(import_c, id, shm_id, offset, size);
+        pa_assert(mb_c);
+        pa_memblock_unref(mb_c);
+
+        pa_memimport_free(import_c);
+        pa_memblock_unref(mb_a);
+        pa_memexport_free(export_a);
+        pa_mempool_free(pool_d);
+    }
+
+    /* Small blocks are taken from the small slots until they run out,
+     * and work across processes just like the others */
+    if ((pool_e = pa_mempool_new_full(TRUE, FALSE, 4 * 16384, 16384, 4096))) {
+        const pa_mempool_stat *stat = pa_mempool_get_stat(pool_e);
+        pa_memblock *blocks_e[9];
+
+        pa_assert(pa_mempool_block_size_max(pool_e) < 16384);
+
+        for (i = 0; i < 5; i++)
+            pa_assert_se(blocks_e[i] = pa_memblock_new(pool_e, 100));
+        for (; i < 9; i++)
+            pa_assert_se(blocks_e[i] = pa_memblock_new(pool_e, 10000));
+
+        /* 4 small and 4 large slots, the last large block had to be
+         * allocated outside of the pool */
+        pa_assert(pa_atomic_load(&stat->n_allocated_by_type[PA_MEMBLOCK_POOL]) == 8);
+        pa_assert(pa_atomic_load(&stat->n_allocated_by_type[PA_MEMBLOCK_APPENDED]) == 1);
+
+        x = pa_memblock_acquire(blocks_e[0]);
+        snprintf(x, pa_memblock_get_length(blocks_e[0]), "%s", txt);
+        pa_memblock_release(blocks_e[0]);
+
+        export_a = pa_memexport_new(pool_e, revoke_cb, (void*) "E");
+        import_c = pa_memimport_new(pool_c, release_cb, (void*) "C");
+
+        r = pa_memexport_put(export_a, blocks_e[0], &id, &shm_id, &offset, &size, &memfd);
+        pa_assert(r >= 0);
+        pa_assert(memfd < 0);
+
+        mb_c = pa_memimport_get(import_c, id, shm_id, offset, size);
+        pa_assert(mb_c);
+        x = pa_memblock_acquire(mb_c);
+        pa_assert(strcmp(x, txt) == 0);
+        pa_memblock_release(mb_c);
+        pa_memblock_unref(mb_c);
+
+        pa_memimport_free(import_c);
+        pa_memexport_free(export_a);
+
+        for (i = 0; i < 9; i++)
+            pa_memblock_unref(blocks_e[i]);
+
+        /* Freed small slots are reused */
+        pa_assert_se(blocks_e[0] = pa_memblock_new(pool_e, 100));
+        pa_assert(pa_atomic_load(&stat->n_allocated_by_type[PA_MEMBLOCK_POOL]) == 1);
+        pa_memblock_unref(blocks_e[0]);
+
+        pa_mempool_vacuum(pool_e);
+        pa_mempool_free(pool_e);
+    }
+
+    /* Free slots give their pages back only after having been idle,
+     * and only as many as needed to get down to the high-water mark */
+    if ((pool_f = pa_mempool_new_full(FALSE, FALSE, 4 * 16384, 16384, 0))) {
+        const pa_mempool_stat *stat = pa_mempool_get_stat(pool_f);
+
+        for (i = 0; i < 4; i++) {
+            pa_assert_se(blocks[i] = pa_memblock_new_pool(pool_f, 1000));
+            memset(pa_memblock_acquire(blocks[i]), 'x', 1000);
+            pa_memblock_release(blocks[i]);
+        }
+
+        pa_assert(pa_atomic_load(&stat->n_free_resident) == 0);
+
+        for (i = 0; i < 4; i++)
+            pa_memblock_unref(blocks[i]);
+
+        pa_assert(pa_atomic_load(&stat->n_free_resident) == 4);
+        pa_assert(pa_atomic_load(&stat->free_resident_size) == 4 * 16384);
+
+        for (i = 1; i < PA_MEMPOOL_RECLAIM_AGE; i++) {
+            pa_assert_se(pa_mempool_reclaim(pool_f, 16384));
+            pa_assert(pa_atomic_load(&stat->n_reclaimed) == 0);
+        }
+
+        pa_assert_se(!pa_mempool_reclaim(pool_f, 16384));
+        pa_assert(pa_atomic_load(&stat->n_reclaimed) == 3);
+        pa_assert(pa_atomic_load(&stat->reclaimed_size) == 3 * 16384);
+        pa_assert(pa_atomic_load(&stat->n_free_resident) == 1);
+
+        /* Nothing left above the mark */
+        pa_assert_se(!pa_mempool_reclaim(pool_f, 16384));
+        pa_assert(pa_atomic_load(&stat->n_reclaimed) == 3);
+
+        /* Slots that were given back are taken again like any other */
+        for (i = 0; i < 4; i++)
+            pa_assert_se(blocks[i] = pa_memblock_new_pool(pool_f, 1000));
+
+        pa_assert(pa_atomic_load(&stat->n_free_resident) == 0);
+        pa_assert(pa_atomic_load(&stat->free_resident_size) == 0);
+
+        for (i = 0; i < 4; i++)
+            pa_memblock_unref(blocks[i]);
+
+        pa_mempool_vacuum(pool_f);
+        pa_assert(pa_atomic_load(&stat->n_free_resident) == 0);
+
+        pa_mempool_free(pool_f);
+    }
+
     pa_log("vacuuming...");
 
     pa_mempool_vacuum(pool_a);
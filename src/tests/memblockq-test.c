@@ -24,6 +24,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <signal.h>
+#include <string.h>
 
 #include <pulsecore/memblockq.h>
 #include <pulsecore/log.h>
@@ -69,6 +70,135 @@ static void dump(pa_memblockq *bq) {
     fprintf(stderr, "<\n");
 }
 
+/* Small chunks pushed one after another end up in one item, without
+ * touching what was already handed out when the queue is written to
+ * again after seeking back */
+static void check_coalesce(pa_mempool *p, const pa_sample_spec *ss) {
+    pa_memblockq *bq;
+    pa_memchunk chunk, out;
+    unsigned i;
+    void *d;
+
+    pa_assert_se(bq = pa_memblockq_new("coalesce memblockq", 0, 4096, 4096, ss, 0, 4, 0, NULL));
+
+    /* Unless enabled, the queue keeps the block of the caller */
+    pa_assert_se(chunk.memblock = pa_memblock_new(p, 8));
+    chunk.index = 0;
+    chunk.length = 4;
+    pa_assert_se(pa_memblockq_push(bq, &chunk) == 0);
+    pa_assert_se(pa_memblockq_peek(bq, &out) == 0);
+    pa_assert_se(out.memblock == chunk.memblock);
+    pa_memblock_unref(out.memblock);
+
+    /* Slices of one block merge without being copied */
+    pa_memblockq_set_coalesce(bq, TRUE);
+    chunk.index = 4;
+    pa_assert_se(pa_memblockq_push(bq, &chunk) == 0);
+    pa_assert_se(pa_memblockq_get_nblocks(bq) == 1);
+    pa_assert_se(pa_memblockq_peek(bq, &out) == 0);
+    pa_assert_se(out.memblock == chunk.memblock && out.length == 8);
+    pa_memblock_unref(out.memblock);
+
+    pa_memblockq_flush_read(bq);
+    pa_assert_se(pa_memblockq_get_nblocks(bq) == 0);
+    pa_memblock_unref(chunk.memblock);
+
+    pa_assert_se(chunk.memblock = pa_memblock_new(p, 4));
+    chunk.index = 0;
+    chunk.length = 4;
+
+    for (i = 0; i < 100; i++) {
+        d = pa_memblock_acquire(chunk.memblock);
+        memset(d, '0' + (int) (i % 10), 4);
+        pa_memblock_release(chunk.memblock);
+
+        pa_assert_se(pa_memblockq_push(bq, &chunk) == 0);
+    }
+
+    pa_assert_se(pa_memblockq_get_nblocks(bq) == 1);
+    pa_assert_se(pa_memblockq_get_length(bq) == 400);
+
+    pa_assert_se(pa_memblockq_peek(bq, &out) == 0);
+    pa_assert_se(out.length == 400);
+
+    pa_memblockq_seek(bq, -8, PA_SEEK_RELATIVE, TRUE);
+
+    d = pa_memblock_acquire(chunk.memblock);
+    memset(d, 'x', 4);
+    pa_memblock_release(chunk.memblock);
+
+    for (i = 0; i < 4; i++)
+        pa_assert_se(pa_memblockq_push(bq, &chunk) == 0);
+
+    d = pa_memblock_acquire(out.memblock);
+    for (i = 0; i < 400; i++)
+        pa_assert_se(((char*) d)[out.index + i] == '0' + (int) (i / 4 % 10));
+    pa_memblock_release(out.memblock);
+    pa_memblock_unref(out.memblock);
+
+    pa_assert_se(pa_memblockq_get_length(bq) == 408);
+
+    pa_memblock_unref(chunk.memblock);
+    pa_memblockq_free(bq);
+}
+
+/* Pushes overlapping chunks with holes in between and checks that the
+ * accounts see exactly the data that can be read back */
+static void check_account(pa_mempool *p, const pa_sample_spec *ss) {
+    pa_mem_account *root, *a;
+    pa_memblockq *bq;
+    pa_memchunk chunk, out;
+    size_t readable = 0, held;
+    unsigned i;
+
+    root = pa_mem_account_new(NULL, 1000);
+    a = pa_mem_account_new(root, 0);
+
+    pa_assert_se(bq = pa_memblockq_new("account memblockq", 0, 1024*1024, 4096, ss, 0, 4, 0, NULL));
+    pa_memblockq_set_mem_account(bq, a);
+
+    pa_assert_se(chunk.memblock = pa_memblock_new(p, 2048));
+    chunk.index = 0;
+
+    for (i = 0; i < 20; i++) {
+        chunk.length = 4 + 100 * (size_t) (rand() % 13);
+
+        pa_memblockq_seek(bq, (int64_t) (4 * (rand() % 200)) - 400, PA_SEEK_RELATIVE, TRUE);
+        pa_assert_se(pa_memblockq_push(bq, &chunk) == 0);
+
+        pa_assert_se(pa_mem_account_get_used(a) == pa_memblockq_get_held(bq));
+        pa_assert_se(pa_mem_account_get_used(root) == pa_memblockq_get_held(bq));
+    }
+
+    pa_assert_se(pa_mem_account_get_peak(root) >= pa_mem_account_get_used(root));
+    pa_assert_se(pa_mem_account_over_budget(a) == (pa_memblockq_get_held(bq) > 1000));
+
+    held = pa_memblockq_get_held(bq);
+
+    while (pa_memblockq_peek(bq, &out) >= 0) {
+        if (out.memblock) {
+            readable += out.length;
+            pa_memblock_unref(out.memblock);
+        }
+
+        pa_memblockq_drop(bq, out.length);
+    }
+
+    pa_assert_se(readable == held);
+    pa_assert_se(pa_mem_account_get_used(a) == 0);
+    pa_assert_se(pa_mem_account_get_available(a) == 1000);
+
+    /* Whatever is left is taken off when the queue goes away */
+    pa_assert_se(pa_memblockq_push(bq, &chunk) == 0);
+    pa_assert_se(pa_mem_account_get_used(root) == chunk.length);
+    pa_memblockq_free(bq);
+    pa_assert_se(pa_mem_account_get_used(root) == 0);
+
+    pa_memblock_unref(chunk.memblock);
+    pa_mem_account_unref(a);
+    pa_mem_account_unref(root);
+}
+
 int main(int argc, char *argv[]) {
     int ret;
 
@@ -167,6 +297,10 @@ int main(int argc, char *argv[]) {
     dump(bq);
 
     pa_memblockq_free(bq);
+
+    check_coalesce(p, &ss);
+    check_account(p, &ss);
+
     pa_memblock_unref(silence.memblock);
     pa_memblock_unref(chunk1.memblock);
     pa_memblock_unref(chunk2.memblock);
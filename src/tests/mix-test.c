@@ -22,6 +22,7 @@
 #endif
 
 #include <stdio.h>
+#include <string.h>
 
 #include <pulse/sample.h>
 #include <pulse/volume.h>
@@ -240,6 +241,39 @@ int main(int argc, char *argv[]) {
 
         dump_block(&a, &j);
 
+        /* The same volume on the same chunk is only applied once, and
+         * the input is left alone */
+        {
+            pa_volume_share share;
+            pa_memchunk s[3];
+            pa_cvolume w;
+            unsigned n;
+
+            pa_volume_share_init(&share);
+
+            pa_cvolume_set(&w, a.channels, pa_sw_volume_from_linear(0.5));
+
+            for (n = 0; n < 3; n++) {
+                s[n] = i;
+                pa_memblock_ref(s[n].memblock);
+                pa_volume_memchunk_shared(&share, &s[n], &a, n == 2 ? &w : &v);
+            }
+
+            pa_assert_se(s[0].memblock == s[1].memblock);
+            pa_assert_se(s[0].memblock != i.memblock);
+            pa_assert_se(s[2].memblock != s[0].memblock);
+
+            ptr = pa_memblock_acquire(s[0].memblock);
+            pa_assert_se(memcmp((uint8_t*) ptr + s[0].index, pa_memblock_acquire(j.memblock), j.length) == 0);
+            pa_memblock_release(j.memblock);
+            pa_memblock_release(s[0].memblock);
+
+            for (n = 0; n < 3; n++)
+                pa_memblock_unref(s[n].memblock);
+
+            pa_volume_share_done(&share);
+        }
+
         m[0].chunk = i;
         m[0].volume.values[0] = PA_VOLUME_NORM;
         m[0].volume.channels = a.channels;
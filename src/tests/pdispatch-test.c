@@ -0,0 +1,132 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+
+#include <pulse/mainloop.h>
+
+#include <pulsecore/native-common.h>
+#include <pulsecore/pdispatch.h>
+#include <pulsecore/tagstruct.h>
+#include <pulsecore/packet.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+/* Registers many replies, answers them out of order, and lets the
+ * rest time out, some of them with a shorter timeout than those
+ * registered before them. */
+
+#define N_REPLIES 1000
+
+static unsigned n_replied, n_timed_out, n_freed;
+static uint8_t seen[N_REPLIES];
+static pa_mainloop *m;
+
+static void reply_cb(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_assert_se(PA_PTR_TO_UINT(userdata) == tag);
+    pa_assert_se(tag < N_REPLIES);
+    pa_assert_se(!seen[tag]);
+
+    seen[tag] = 1;
+
+    if (command == PA_COMMAND_REPLY) {
+        /* Even tags are answered */
+        pa_assert_se(tag % 2 == 0);
+        n_replied++;
+    } else {
+        pa_assert_se(command == PA_COMMAND_TIMEOUT);
+        pa_assert_se(tag % 2 == 1);
+        n_timed_out++;
+    }
+
+    if (!pa_pdispatch_is_pending(pd))
+        pa_mainloop_quit(m, 0);
+}
+
+static void free_cb(void *userdata) {
+    n_freed++;
+}
+
+static void send_reply(pa_pdispatch *pd, uint32_t tag) {
+    pa_tagstruct *t;
+    pa_packet *packet;
+    uint8_t *data;
+    size_t length;
+
+    t = pa_tagstruct_new(NULL, 0);
+    pa_tagstruct_putu32(t, PA_COMMAND_REPLY);
+    pa_tagstruct_putu32(t, tag);
+
+    data = pa_tagstruct_free_data(t, &length);
+    packet = pa_packet_new_dynamic(data, length);
+
+    pa_assert_se(pa_pdispatch_run(pd, packet, NULL, NULL) == 0);
+
+    pa_packet_unref(packet);
+}
+
+int main(int argc, char *argv[]) {
+    pa_pdispatch *pd;
+    unsigned i;
+
+    pa_assert_se(m = pa_mainloop_new());
+    pa_assert_se(pd = pa_pdispatch_new(pa_mainloop_get_api(m), TRUE, NULL, 0));
+
+    /* The later ones time out first */
+    for (i = 0; i < N_REPLIES; i++)
+        pa_pdispatch_register_reply(pd, i, i < N_REPLIES / 2 ? 2 : 1, reply_cb, PA_UINT_TO_PTR(i), NULL);
+
+    srand(0);
+
+    for (i = 0; i < N_REPLIES / 2; i++) {
+        uint32_t tag;
+
+        /* Unknown and already answered tags are ignored */
+        tag = (uint32_t) (rand() % (N_REPLIES / 2)) * 2;
+        send_reply(pd, tag >= N_REPLIES || seen[tag] ? N_REPLIES + i : tag);
+    }
+
+    for (i = 0; i < N_REPLIES; i += 2)
+        if (!seen[i])
+            send_reply(pd, i);
+
+    pa_assert_se(n_replied == N_REPLIES / 2);
+    pa_assert_se(pa_pdispatch_is_pending(pd));
+
+    pa_assert_se(pa_mainloop_run(m, NULL) >= 0);
+    pa_assert_se(n_timed_out == N_REPLIES / 2);
+    pa_assert_se(!pa_pdispatch_is_pending(pd));
+
+    /* Whatever is left over when the dispatcher goes away is freed */
+    for (i = 0; i < 10; i++)
+        pa_pdispatch_register_reply(pd, i, 1, reply_cb, PA_UINT_TO_PTR(i), free_cb);
+
+    pa_pdispatch_unregister_reply(pd, PA_UINT_TO_PTR(3));
+    pa_pdispatch_unref(pd);
+
+    pa_assert_se(n_freed == 9);
+
+    pa_mainloop_free(m);
+
+    return 0;
+}
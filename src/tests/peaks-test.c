@@ -0,0 +1,227 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/sample.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/cpu-arm.h>
+#include <pulsecore/cpu-x86.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/random.h>
+#include <pulsecore/resampler.h>
+
+/* Compares optimized peak detection functions to the C versions, and
+ * checks that peak detecting resamplers sharing their results get what
+ * they would have computed on their own. */
+
+#define N_FRAMES 1031
+
+static pa_peaks_func_t c_s16, c_float;
+
+static void check_func(const char *name) {
+    /* One more, as the checks start at the second sample */
+    static int16_t s16[N_FRAMES * 8 + 1];
+    static float floats[N_FRAMES * 8 + 1];
+    pa_peaks_func_t f_s16 = pa_get_peaks_func(PA_SAMPLE_S16NE);
+    pa_peaks_func_t f_float = pa_get_peaks_func(PA_SAMPLE_FLOAT32NE);
+    unsigned channels, n, i, rounds = getenv("MAKE_CHECK") ? 10 : 10000;
+    pa_usec_t t;
+
+    pa_random(s16, sizeof(s16));
+    s16[3] = -0x8000;
+    for (i = 0; i < N_FRAMES * 8 + 1; i++)
+        floats[i] = (float) s16[i] / 0x8000;
+
+    for (channels = 1; channels <= 8; channels++)
+        for (n = N_FRAMES - 40; n <= N_FRAMES; n++) {
+            int16_t max_i[8], ref_i[8];
+            float max_f[8], ref_f[8];
+
+            /* Start from some maxima found before */
+            for (i = 0; i < channels; i++) {
+                ref_i[i] = max_i[i] = (int16_t) (i * 3000);
+                ref_f[i] = max_f[i] = i * 0.1f;
+            }
+
+            c_s16(ref_i, s16 + 1, channels, n);
+            f_s16(max_i, s16 + 1, channels, n);
+            pa_assert_se(memcmp(ref_i, max_i, channels * sizeof(int16_t)) == 0);
+
+            c_float(ref_f, floats + 1, channels, n);
+            f_float(max_f, floats + 1, channels, n);
+            pa_assert_se(memcmp(ref_f, max_f, channels * sizeof(float)) == 0);
+        }
+
+    /* The -32768 in channel 0 counts as 32767 */
+    {
+        int16_t max = 0;
+
+        c_s16(&max, s16 + 3, 1, 1);
+        pa_assert_se(max == 0x7FFF);
+    }
+
+    for (channels = 1; channels <= 2; channels++) {
+        int16_t max_i[2] = { 0, 0 };
+        float max_f[2] = { 0, 0 };
+
+        t = pa_rtclock_now();
+        for (i = 0; i < rounds; i++)
+            f_s16(max_i, s16, channels, N_FRAMES * 8 / channels);
+        t = pa_rtclock_now() - t;
+        pa_log_info("%-4s s16ne     %u ch %10.0f samples/s", name, channels,
+                    (double) N_FRAMES * 8 * rounds * PA_USEC_PER_SEC / PA_MAX(t, 1U));
+
+        t = pa_rtclock_now();
+        for (i = 0; i < rounds; i++)
+            f_float(max_f, floats, channels, N_FRAMES * 8 / channels);
+        t = pa_rtclock_now() - t;
+        pa_log_info("%-4s float32ne %u ch %10.0f samples/s", name, channels,
+                    (double) N_FRAMES * 8 * rounds * PA_USEC_PER_SEC / PA_MAX(t, 1U));
+    }
+}
+
+static void check_share(pa_sample_format_t format) {
+    pa_mempool *pool;
+    pa_resampler *r[3];
+    pa_resampler_peaks_share *share;
+    pa_sample_spec a, b;
+    pa_memchunk in, out[3];
+    unsigned i, k, n_shared = 0;
+
+    a.format = format;
+    a.rate = 44100;
+    a.channels = 2;
+    b.format = PA_SAMPLE_FLOAT32NE;
+    b.rate = 25;
+    b.channels = 2;
+
+    pa_assert_se(pool = pa_mempool_new(FALSE, 0));
+    pa_assert_se(share = pa_resampler_peaks_share_new());
+
+    /* r[0] and r[1] share, r[2] runs on its own */
+    for (k = 0; k < 3; k++)
+        pa_assert_se(r[k] = pa_resampler_new(pool, NULL, &a, NULL, &b, NULL, PA_RESAMPLER_PEAKS, 0));
+
+    for (i = 0; i < 50; i++) {
+        void *d;
+
+        in.length = pa_frame_size(&a) * (500 + i * 37);
+        in.index = 0;
+        in.memblock = pa_memblock_new(pool, in.length);
+        d = pa_memblock_acquire(in.memblock);
+        if (format == PA_SAMPLE_FLOAT32NE) {
+            float *f = d;
+            unsigned j;
+
+            for (j = 0; j < in.length / sizeof(float); j++)
+                f[j] = (float) (rand() - RAND_MAX / 2) / RAND_MAX;
+        } else
+            pa_random(d, in.length);
+        pa_memblock_release(in.memblock);
+
+        pa_resampler_run_shared(r[0], share, &in, &out[0]);
+        pa_resampler_run_shared(r[1], share, &in, &out[1]);
+        pa_resampler_run(r[2], &in, &out[2]);
+
+        pa_assert_se(out[0].length == out[2].length);
+        pa_assert_se(out[1].length == out[2].length);
+
+        if (out[2].length > 0) {
+            void *d0, *d2;
+
+            pa_assert_se(out[0].memblock == out[1].memblock);
+            n_shared++;
+
+            d0 = (uint8_t *) pa_memblock_acquire(out[0].memblock) + out[0].index;
+            d2 = (uint8_t *) pa_memblock_acquire(out[2].memblock) + out[2].index;
+            pa_assert_se(memcmp(d0, d2, out[2].length) == 0);
+            pa_memblock_release(out[0].memblock);
+            pa_memblock_release(out[2].memblock);
+        }
+
+        for (k = 0; k < 3; k++)
+            if (out[k].memblock)
+                pa_memblock_unref(out[k].memblock);
+
+        pa_memblock_unref(in.memblock);
+    }
+
+    pa_assert_se(n_shared > 0);
+
+    for (k = 0; k < 3; k++)
+        pa_resampler_free(r[k]);
+
+    pa_resampler_peaks_share_free(share);
+    pa_mempool_free(pool);
+}
+
+int main(int argc, char *argv[]) {
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    c_s16 = pa_get_peaks_func(PA_SAMPLE_S16NE);
+    c_float = pa_get_peaks_func(PA_SAMPLE_FLOAT32NE);
+
+    check_func("C");
+
+#if defined (__i386__) || defined (__amd64__)
+    {
+        pa_cpu_x86_flag_t flags = 0;
+
+        pa_cpu_init_x86(&flags);
+
+        pa_peaks_func_init_avx(flags);
+        if (pa_get_peaks_func(PA_SAMPLE_S16NE) != c_s16)
+            check_func("AVX2");
+    }
+#endif
+
+#if defined (__arm__)
+    {
+        pa_cpu_arm_flag_t flags = 0;
+
+        pa_cpu_init_arm(&flags);
+
+        pa_peaks_func_init_neon(flags);
+        if (pa_get_peaks_func(PA_SAMPLE_S16NE) != c_s16)
+            check_func("NEON");
+    }
+#endif
+
+    check_share(PA_SAMPLE_S16LE);
+    check_share(PA_SAMPLE_FLOAT32NE);
+
+    pa_set_peaks_func(PA_SAMPLE_S16NE, c_s16);
+    pa_set_peaks_func(PA_SAMPLE_FLOAT32NE, c_float);
+
+    return 0;
+}
@@ -0,0 +1,309 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/sample.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/cpu-arm.h>
+#include <pulsecore/cpu-x86.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/resampler.h>
+
+/* Resamples sines with the polyphase resampler and checks them against
+ * the exact result, for fixed and changing rates. Filter tables from the
+ * resampler cache have to work like private ones, and optimized filter
+ * functions are compared to the C version. */
+
+#define FREQ 997.0
+#define BLOCK_FRAMES 500
+#define N_BLOCKS 40
+#define SKIP_FRAMES 200
+
+static pa_mempool *pool;
+static pa_resampler_cache *cache;
+
+/* Channel c carries a sine of FREQ * (c + 1) / channels */
+static pa_memchunk *make_sine(pa_memchunk *chunk, unsigned channels, uint32_t rate, double *phase, unsigned n_frames) {
+    float *d;
+    unsigned i, c;
+
+    chunk->memblock = pa_memblock_new(pool, n_frames * channels * sizeof(float));
+    chunk->index = 0;
+    chunk->length = n_frames * channels * sizeof(float);
+
+    d = pa_memblock_acquire(chunk->memblock);
+    for (i = 0; i < n_frames; i++) {
+        for (c = 0; c < channels; c++)
+            *d++ = (float) (0.5 * sin(*phase * (c + 1) / channels));
+        *phase += 2 * M_PI * FREQ / rate;
+    }
+    pa_memblock_release(chunk->memblock);
+
+    return chunk;
+}
+
+/* Runs N_BLOCKS blocks through a resampler and returns the output frames.
+ * If vary is set the input rate is changed by up to 1% on the way. */
+static float *resample(uint32_t i_rate, uint32_t o_rate, unsigned channels, pa_bool_t vary, unsigned *n_frames) {
+    pa_sample_spec a, b;
+    pa_resampler *r;
+    float *out = NULL;
+    double phase = 0;
+    unsigned n = 0, k;
+
+    a.format = b.format = PA_SAMPLE_FLOAT32NE;
+    a.channels = b.channels = (uint8_t) channels;
+    a.rate = i_rate;
+    b.rate = o_rate;
+
+    pa_assert_se(r = pa_resampler_new(pool, cache, &a, NULL, &b, NULL, PA_RESAMPLER_POLYPHASE,
+                                      vary ? PA_RESAMPLER_VARIABLE_RATE : 0));
+
+    for (k = 0; k < N_BLOCKS; k++) {
+        pa_memchunk i, o;
+
+        if (vary)
+            pa_resampler_set_input_rate(r, i_rate + (i_rate / 100) * (k % 3) / 2);
+
+        /* The sine keeps its frequency relative to the actual rate */
+        pa_resampler_run(r, make_sine(&i, channels, pa_resampler_input_sample_spec(r)->rate, &phase, BLOCK_FRAMES), &o);
+        pa_memblock_unref(i.memblock);
+
+        if (o.memblock) {
+            unsigned f = (unsigned) (o.length / (channels * sizeof(float)));
+
+            out = pa_xrealloc(out, (n + f) * channels * sizeof(float));
+            memcpy(out + n * channels, (uint8_t*) pa_memblock_acquire(o.memblock) + o.index, o.length);
+            pa_memblock_release(o.memblock);
+            pa_memblock_unref(o.memblock);
+            n += f;
+        }
+    }
+
+    pa_resampler_free(r);
+
+    *n_frames = n;
+    return out;
+}
+
+/* The filter is centered on the current frame, so the output has no
+ * delay and has to match a sine at the output rate directly */
+static void check_quality(uint32_t i_rate, uint32_t o_rate, unsigned channels) {
+    float *out;
+    unsigned n, i, c;
+    double max_error = 0;
+
+    out = resample(i_rate, o_rate, channels, FALSE, &n);
+    pa_assert_se(n > SKIP_FRAMES);
+
+    /* Up to half a filter of input is kept back for the next run */
+    pa_assert_se(labs((long) ((uint64_t) n * i_rate / o_rate) - N_BLOCKS * BLOCK_FRAMES) < 130);
+
+    for (i = SKIP_FRAMES; i < n; i++)
+        for (c = 0; c < channels; c++) {
+            double e = 0.5 * sin(2 * M_PI * FREQ * i / o_rate * (c + 1) / channels);
+
+            max_error = PA_MAX(max_error, fabs(out[i * channels + c] - e));
+        }
+
+    pa_log_debug("%u -> %u, %u channels: max error %g", i_rate, o_rate, channels, max_error);
+    pa_assert_se(max_error < 1e-3);
+
+    pa_xfree(out);
+}
+
+/* With a changing rate the phase is not known exactly any more, so only
+ * check that the sines stay continuous and keep their amplitude */
+static void check_variable(uint32_t i_rate, uint32_t o_rate, unsigned channels) {
+    float *out;
+    unsigned n, i, c;
+    double peak = 0, max_step = 0;
+
+    out = resample(i_rate, o_rate, channels, TRUE, &n);
+    pa_assert_se(n > SKIP_FRAMES);
+
+    for (i = SKIP_FRAMES; i < n; i++)
+        for (c = 0; c < channels; c++) {
+            peak = PA_MAX(peak, fabs(out[i * channels + c]));
+            max_step = PA_MAX(max_step, fabs(out[i * channels + c] - out[(i - 1) * channels + c]));
+        }
+
+    pa_log_debug("%u -> %u, %u channels, variable: peak %g, max step %g", i_rate, o_rate, channels, peak, max_step);
+    pa_assert_se(fabs(peak - 0.5) < 5e-3);
+    pa_assert_se(max_step < 0.5 * 2 * M_PI * FREQ * 1.03 / o_rate * 1.01);
+
+    pa_xfree(out);
+}
+
+/* Resamplers sharing cached tables, and ones that come after tables
+ * were dropped from the cache, have to give the same output as ones
+ * with tables of their own */
+static void check_cache(void) {
+    static const uint32_t rates[] = { 8000, 11025, 16000, 22050, 32000, 44100, 48000, 96000 };
+    pa_resampler_cache *saved = cache;
+    pa_sample_spec a, b;
+    pa_resampler *r[PA_ELEMENTSOF(rates)];
+    float *ref, *out;
+    unsigned i, n_ref, n;
+
+    cache = NULL;
+    ref = resample(44100, 48000, 2, FALSE, &n_ref);
+    cache = saved;
+
+    /* Hold on to a few tables while others come and go */
+    a.format = b.format = PA_SAMPLE_FLOAT32NE;
+    a.channels = b.channels = 2;
+    b.rate = 48000;
+
+    for (i = 0; i < PA_ELEMENTSOF(rates); i++) {
+        a.rate = rates[i];
+        pa_assert_se(r[i] = pa_resampler_new(pool, cache, &a, NULL, &b, NULL, PA_RESAMPLER_POLYPHASE, 0));
+    }
+
+    for (i = 0; i < 3; i++) {
+        out = resample(44100, 48000, 2, FALSE, &n);
+        pa_assert_se(n == n_ref);
+        pa_assert_se(memcmp(ref, out, n * 2 * sizeof(float)) == 0);
+        pa_xfree(out);
+    }
+
+    for (i = 0; i < PA_ELEMENTSOF(rates); i++)
+        pa_resampler_free(r[i]);
+
+    out = resample(44100, 48000, 2, FALSE, &n);
+    pa_assert_se(n == n_ref);
+    pa_assert_se(memcmp(ref, out, n * 2 * sizeof(float)) == 0);
+    pa_xfree(out);
+
+    pa_xfree(ref);
+}
+
+static void check_func(pa_polyphase_func_t func, pa_polyphase_func_t ref, const char *name) {
+    float src[256 * 8 + 8], c0[256 * 2], c1[256 * 2], a[8], b[8];
+    unsigned channels, n_taps, i, j, rounds = getenv("MAKE_CHECK") ? 1000 : 1000000;
+    pa_usec_t t;
+
+    for (i = 0; i < PA_ELEMENTSOF(src); i++)
+        src[i] = (float) rand() / (float) RAND_MAX - 0.5f;
+    for (i = 0; i < PA_ELEMENTSOF(c0); i++) {
+        c0[i] = ((float) rand() / (float) RAND_MAX - 0.5f) / 16;
+        c1[i] = ((float) rand() / (float) RAND_MAX - 0.5f) / 16;
+    }
+
+    for (channels = 1; channels <= 8; channels++)
+        for (n_taps = 8; n_taps <= 256; n_taps += 8) {
+            ref(a, src, c0, NULL, 0.0f, n_taps, channels);
+            func(b, src, c0, NULL, 0.0f, n_taps, channels);
+            for (i = 0; i < channels; i++)
+                pa_assert_se(fabsf(a[i] - b[i]) < 1e-5f);
+
+            ref(a, src, c0, c1, 0.3f, n_taps, channels);
+            func(b, src, c0, c1, 0.3f, n_taps, channels);
+            for (i = 0; i < channels; i++)
+                pa_assert_se(fabsf(a[i] - b[i]) < 1e-5f);
+        }
+
+    for (channels = 1; channels <= 6; channels++) {
+        t = pa_rtclock_now();
+        for (j = 0; j < rounds; j++)
+            func(a, src, c0, c1, 0.3f, 48, channels);
+        t = pa_rtclock_now() - t;
+
+        pa_log_info("%-5s %u channels, 48 taps: %10.0f frames/s", name, channels,
+                    (double) rounds * PA_USEC_PER_SEC / PA_MAX(t, 1U));
+    }
+}
+
+int main(int argc, char *argv[]) {
+    pa_polyphase_func_t c_func;
+    unsigned channels;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    pa_assert_se(pool = pa_mempool_new(FALSE, 0));
+    cache = pa_resampler_cache_new();
+
+    c_func = pa_get_polyphase_func();
+
+    for (channels = 1; channels <= 6; channels++) {
+        check_quality(44100, 48000, channels);
+        check_quality(48000, 44100, channels);
+        check_quality(8000, 32000, channels);
+        check_quality(44100, 22050, channels);
+        check_variable(44100, 48000, channels);
+        check_variable(48000, 44100, channels);
+    }
+
+    check_cache();
+    check_func(c_func, c_func, "C");
+
+#if defined (__i386__) || defined (__amd64__)
+    {
+        pa_cpu_x86_flag_t flags = 0;
+
+        pa_cpu_init_x86(&flags);
+
+        pa_set_polyphase_func(c_func);
+        pa_polyphase_func_init_avx(flags);
+
+        if (pa_get_polyphase_func() != c_func) {
+            check_func(pa_get_polyphase_func(), c_func, "AVX2");
+            check_quality(44100, 48000, 2);
+            check_variable(48000, 44100, 6);
+        }
+    }
+#endif
+
+#if defined (__arm__)
+    {
+        pa_cpu_arm_flag_t flags = 0;
+
+        pa_cpu_init_arm(&flags);
+
+        pa_set_polyphase_func(c_func);
+        pa_polyphase_func_init_neon(flags);
+
+        if (pa_get_polyphase_func() != c_func) {
+            check_func(pa_get_polyphase_func(), c_func, "NEON");
+            check_quality(44100, 48000, 2);
+            check_variable(48000, 44100, 6);
+        }
+    }
+#endif
+
+    pa_set_polyphase_func(c_func);
+    pa_resampler_cache_free(cache);
+    pa_mempool_free(pool);
+
+    return 0;
+}
@@ -35,6 +35,10 @@ int main(int argc, char*argv[]) {
     char *s, *t, *u, *v;
     const char *text;
     const char *x[] = { "foo", NULL };
+    const char *key;
+    void *state;
+    char k[16];
+    unsigned i, n;
 
     if (!getenv("MAKE_CHECK"))
         pa_log_set_level(PA_LOG_DEBUG);
@@ -95,5 +99,48 @@ int main(int argc, char*argv[]) {
     pa_proplist_free(a);
     pa_modargs_free(ma);
 
+    /* Copies share the entries until one of them is modified */
+    a = pa_proplist_new();
+    for (i = 0; i < 100; i++) {
+        pa_snprintf(k, sizeof(k), "key.%u", i);
+        pa_assert_se(pa_proplist_setf(a, k, "%u", i) == 0);
+    }
+    pa_assert_se(pa_proplist_sets(a, PA_PROP_APPLICATION_NAME, "test") == 0);
+
+    b = pa_proplist_copy(a);
+    c = pa_proplist_new();
+    pa_proplist_update(c, PA_UPDATE_SET, a);
+    pa_assert_se(pa_proplist_equal(a, b) && pa_proplist_equal(a, c));
+
+    pa_assert_se(pa_proplist_sets(b, PA_PROP_APPLICATION_NAME, "other") == 0);
+    pa_assert_se(pa_proplist_unset(c, "key.7") == 0);
+    pa_assert_se(pa_streq(pa_proplist_gets(a, PA_PROP_APPLICATION_NAME), "test"));
+    pa_assert_se(pa_streq(pa_proplist_gets(b, PA_PROP_APPLICATION_NAME), "other"));
+    pa_assert_se(pa_proplist_contains(a, "key.7") == 1);
+    pa_assert_se(pa_proplist_contains(c, "key.7") == 0);
+    pa_assert_se(pa_proplist_size(a) == 101 && pa_proplist_size(b) == 101 && pa_proplist_size(c) == 100);
+    pa_assert_se(!pa_proplist_equal(a, b) && !pa_proplist_equal(a, c));
+
+    pa_proplist_update(b, PA_UPDATE_MERGE, c);
+    pa_assert_se(pa_streq(pa_proplist_gets(b, PA_PROP_APPLICATION_NAME), "other"));
+    pa_proplist_update(b, PA_UPDATE_REPLACE, c);
+    pa_assert_se(pa_streq(pa_proplist_gets(b, PA_PROP_APPLICATION_NAME), "test"));
+    pa_assert_se(pa_proplist_size(b) == 101);
+
+    /* Deleting the current entry while iterating must not skip any */
+    n = 0;
+    state = NULL;
+    while ((key = pa_proplist_iterate(a, &state))) {
+        n++;
+        pa_assert_se(pa_proplist_unset(a, key) == 0);
+    }
+    pa_assert_se(n == 101);
+    pa_assert_se(pa_proplist_isempty(a));
+    pa_assert_se(pa_proplist_size(c) == 100);
+
+    pa_proplist_free(a);
+    pa_proplist_free(b);
+    pa_proplist_free(c);
+
     return 0;
 }
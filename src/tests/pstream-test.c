@@ -0,0 +1,411 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <pulse/mainloop.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/socket.h>
+#include <pulsecore/pstream.h>
+#include <pulsecore/io-worker.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+/* Sends a mix of packets and memblocks of all sizes up to a pool slot
+ * over a socket pair and checks that they come out the other end
+ * unchanged and in order. Many small frames end up in a single read,
+ * while big ones are received in several pieces. The same is done
+ * again with both ends serviced by IO worker threads.
+ *
+ * Then blocks are passed through SHM, with and without batched
+ * releases, and every one of them has to come back to the sender.
+ *
+ * Finally audio priority is enabled, and memblocks queued behind a
+ * large packet have to overtake it, but never a small one. */
+
+#define N_FRAMES 2000
+#define MAX_SMALL 300
+#define N_SHM_BLOCKS 1000
+#define N_PRIORITY_ROUNDS 50
+#define BULK_LENGTH (16*1024)
+
+struct frame {
+    pa_bool_t packet;
+    uint32_t channel;
+    size_t length;
+    uint8_t seed;
+};
+
+static struct frame frames[N_FRAMES];
+static unsigned n_received;
+static size_t received_index;
+static pa_mainloop *m;
+
+static uint8_t frame_byte(const struct frame *f, size_t k) {
+    return (uint8_t) (f->seed + k * 7 + (k >> 8));
+}
+
+static void fill(const struct frame *f, uint8_t *d) {
+    size_t k;
+
+    for (k = 0; k < f->length; k++)
+        d[k] = frame_byte(f, k);
+}
+
+static void frame_received(void) {
+    if (++n_received >= N_FRAMES)
+        pa_mainloop_quit(m, 0);
+}
+
+static void packet_cb(pa_pstream *p, pa_packet *packet, const pa_creds *creds, void *userdata) {
+    const struct frame *f;
+    size_t k;
+
+    pa_assert_se(n_received < N_FRAMES);
+    f = &frames[n_received];
+
+    pa_assert_se(f->packet);
+    pa_assert_se(received_index == 0);
+    pa_assert_se(packet->length == f->length);
+
+    for (k = 0; k < f->length; k++)
+        pa_assert_se(packet->data[k] == frame_byte(f, k));
+
+    frame_received();
+}
+
+static void memblock_cb(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata) {
+    const struct frame *f;
+    const uint8_t *d;
+    size_t k;
+
+    pa_assert_se(n_received < N_FRAMES);
+    f = &frames[n_received];
+
+    pa_assert_se(!f->packet);
+    pa_assert_se(channel == f->channel);
+
+    /* The seek info only comes with the first piece of a frame */
+    if (received_index == 0) {
+        pa_assert_se(offset == (int64_t) f->length);
+        pa_assert_se(seek == PA_SEEK_RELATIVE_ON_READ);
+    } else {
+        pa_assert_se(offset == 0);
+        pa_assert_se(seek == PA_SEEK_RELATIVE);
+    }
+
+    pa_assert_se(chunk->length > 0);
+    pa_assert_se(received_index + chunk->length <= f->length);
+
+    d = (const uint8_t*) pa_memblock_acquire(chunk->memblock) + chunk->index;
+    for (k = 0; k < chunk->length; k++)
+        pa_assert_se(d[k] == frame_byte(f, received_index + k));
+    pa_memblock_release(chunk->memblock);
+
+    received_index += chunk->length;
+
+    if (received_index >= f->length) {
+        received_index = 0;
+        frame_received();
+    }
+}
+
+static void die_cb(pa_pstream *p, void *userdata) {
+    pa_assert_not_reached();
+}
+
+static pa_pstream *pstream_new(pa_io_worker *w, pa_mempool *pool, int fd) {
+    pa_mainloop_api *api = pa_mainloop_get_api(m);
+    pa_iochannel *io = pa_iochannel_new(api, fd, fd);
+
+    if (w)
+        return pa_io_worker_pstream_new(w, api, io, pool);
+
+    return pa_pstream_new(api, io, pool);
+}
+
+static void run(pa_bool_t threaded) {
+    pa_io_worker_pool *workers = NULL;
+    pa_io_worker *wa = NULL, *wb = NULL;
+    pa_mempool *pool;
+    pa_pstream *a, *b;
+    int fds[2];
+    size_t max_big;
+    unsigned i;
+
+    pa_log_debug("Running %s.", threaded ? "on IO workers" : "on the main loop");
+
+    n_received = 0;
+    received_index = 0;
+
+    pa_assert_se(m = pa_mainloop_new());
+    pa_assert_se(pool = pa_mempool_new(FALSE, 0));
+    max_big = pa_mempool_block_size_max(pool);
+    pa_assert_se(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+    if (threaded) {
+        pa_assert_se(workers = pa_io_worker_pool_new(pa_mainloop_get_api(m), 2));
+        wa = pa_io_worker_pool_acquire(workers);
+        wb = pa_io_worker_pool_acquire(workers);
+        pa_assert_se(wa != wb);
+    }
+
+    a = pstream_new(wa, pool, fds[0]);
+    b = pstream_new(wb, pool, fds[1]);
+
+    pa_pstream_set_die_callback(a, die_cb, NULL);
+    pa_pstream_set_die_callback(b, die_cb, NULL);
+    pa_pstream_set_receive_packet_callback(b, packet_cb, NULL);
+    pa_pstream_set_receive_memblock_callback(b, memblock_cb, NULL);
+
+    srand(0);
+
+    for (i = 0; i < N_FRAMES; i++) {
+        struct frame *f = &frames[i];
+
+        f->packet = rand() % 3 == 0;
+        f->channel = (uint32_t) (rand() % 4);
+        f->length = 1 + (size_t) (rand() % (rand() % 10 == 0 ? max_big : MAX_SMALL));
+        f->seed = (uint8_t) rand();
+
+        if (f->packet) {
+            pa_packet *packet;
+
+            packet = pa_packet_new(f->length);
+            fill(f, packet->data);
+            pa_pstream_send_packet(a, packet, NULL);
+            pa_packet_unref(packet);
+
+        } else {
+            pa_memchunk chunk;
+
+            chunk.memblock = pa_memblock_new_malloced(pool, pa_xmalloc(f->length), f->length);
+            chunk.index = 0;
+            chunk.length = f->length;
+
+            fill(f, pa_memblock_acquire(chunk.memblock));
+            pa_memblock_release(chunk.memblock);
+
+            pa_pstream_send_memblock(a, f->channel, (int64_t) f->length, PA_SEEK_RELATIVE_ON_READ, &chunk);
+            pa_memblock_unref(chunk.memblock);
+        }
+    }
+
+    pa_assert_se(pa_mainloop_run(m, NULL) >= 0);
+    pa_assert_se(n_received == N_FRAMES);
+
+    pa_pstream_unlink(a);
+    pa_pstream_unref(a);
+    pa_pstream_unlink(b);
+    pa_pstream_unref(b);
+
+    if (workers) {
+        pa_io_worker_release(wa);
+        pa_io_worker_release(wb);
+        pa_io_worker_pool_free(workers);
+    }
+
+    pa_mempool_free(pool);
+    pa_mainloop_free(m);
+}
+
+static void shm_memblock_cb(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata) {
+    /* The block is released as soon as the pstream drops it */
+    pa_assert_se(pa_memblock_is_read_only(chunk->memblock));
+    n_received++;
+}
+
+static void run_shm(pa_bool_t batching) {
+    pa_mempool *pool_a, *pool_b;
+    pa_pstream *a, *b;
+    int fds[2];
+    unsigned i;
+
+    pa_log_debug("Running on SHM %s batching.", batching ? "with" : "without");
+
+    if (!(pool_a = pa_mempool_new(TRUE, 0))) {
+        pa_log_info("No SHM available, skipping.");
+        return;
+    }
+
+    pa_assert_se(pool_b = pa_mempool_new(TRUE, 0));
+    pa_assert_se(m = pa_mainloop_new());
+    pa_assert_se(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+    n_received = 0;
+
+    a = pstream_new(NULL, pool_a, fds[0]);
+    b = pstream_new(NULL, pool_b, fds[1]);
+
+    pa_pstream_set_die_callback(a, die_cb, NULL);
+    pa_pstream_set_die_callback(b, die_cb, NULL);
+    pa_pstream_set_receive_memblock_callback(b, shm_memblock_cb, NULL);
+
+    pa_pstream_enable_shm(a, TRUE);
+    pa_pstream_enable_shm(b, TRUE);
+    pa_pstream_enable_batching(a, batching);
+    pa_pstream_enable_batching(b, batching);
+
+    for (i = 0; i < N_SHM_BLOCKS; i++) {
+        pa_memchunk chunk;
+
+        chunk.memblock = pa_memblock_new(pool_a, 64);
+        chunk.index = 0;
+        chunk.length = 64;
+
+        pa_pstream_send_memblock(a, 0, 0, PA_SEEK_RELATIVE, &chunk);
+        pa_memblock_unref(chunk.memblock);
+    }
+
+    while (n_received < N_SHM_BLOCKS || pa_atomic_load(&pa_mempool_get_stat(pool_a)->n_exported) > 0)
+        pa_assert_se(pa_mainloop_iterate(m, 1, NULL) >= 0);
+
+    pa_pstream_unlink(a);
+    pa_pstream_unref(a);
+    pa_pstream_unlink(b);
+    pa_pstream_unref(b);
+
+    pa_mempool_free(pool_a);
+    pa_mempool_free(pool_b);
+    pa_mainloop_free(m);
+}
+
+/* What is queued in each round, memblocks carry their id as channel
+ * and packets as content */
+static const struct {
+    pa_bool_t packet;
+    size_t length;
+} priority_round[] = {
+    { TRUE, BULK_LENGTH },
+    { FALSE, 100 },
+    { FALSE, 100 },
+    { TRUE, 100 },
+    { FALSE, 100 },
+    { TRUE, BULK_LENGTH }
+};
+
+/* The ids in the order they have to come out */
+static const unsigned priority_expected[] = { 1, 2, 0, 3, 4, 5 };
+
+static void priority_id_received(unsigned id) {
+    pa_assert_se(n_received < PA_ELEMENTSOF(priority_expected));
+    pa_assert_se(priority_expected[n_received] == id);
+
+    n_received++;
+}
+
+static void priority_packet_cb(pa_pstream *p, pa_packet *packet, const pa_creds *creds, void *userdata) {
+    pa_assert_se(received_index == 0);
+    priority_id_received(packet->data[0]);
+}
+
+static void priority_memblock_cb(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata) {
+    received_index += chunk->length;
+
+    if (received_index >= priority_round[channel].length) {
+        received_index = 0;
+        priority_id_received(channel);
+    }
+}
+
+static void run_priority(void) {
+    pa_mempool *pool;
+    pa_pstream *a, *b;
+    int fds[2];
+    unsigned i, k;
+
+    pa_log_debug("Running with audio priority.");
+
+    pa_assert_se(m = pa_mainloop_new());
+    pa_assert_se(pool = pa_mempool_new(FALSE, 0));
+    pa_assert_se(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+    a = pstream_new(NULL, pool, fds[0]);
+    b = pstream_new(NULL, pool, fds[1]);
+
+    pa_pstream_set_die_callback(a, die_cb, NULL);
+    pa_pstream_set_die_callback(b, die_cb, NULL);
+    pa_pstream_set_receive_packet_callback(b, priority_packet_cb, NULL);
+    pa_pstream_set_receive_memblock_callback(b, priority_memblock_cb, NULL);
+
+    pa_pstream_enable_audio_priority(a, TRUE);
+
+    /* Nothing is written before the main loop runs, so each round
+     * starts with empty queues */
+    for (i = 0; i < N_PRIORITY_ROUNDS; i++) {
+        n_received = 0;
+        received_index = 0;
+
+        for (k = 0; k < PA_ELEMENTSOF(priority_round); k++) {
+
+            if (priority_round[k].packet) {
+                pa_packet *packet;
+
+                packet = pa_packet_new(priority_round[k].length);
+                memset(packet->data, (int) k, packet->length);
+                pa_pstream_send_packet(a, packet, NULL);
+                pa_packet_unref(packet);
+
+            } else {
+                pa_memchunk chunk;
+
+                chunk.memblock = pa_memblock_new(pool, priority_round[k].length);
+                chunk.index = 0;
+                chunk.length = priority_round[k].length;
+
+                pa_pstream_send_memblock(a, k, 0, PA_SEEK_RELATIVE, &chunk);
+                pa_memblock_unref(chunk.memblock);
+            }
+        }
+
+        while (n_received < PA_ELEMENTSOF(priority_expected))
+            pa_assert_se(pa_mainloop_iterate(m, 1, NULL) >= 0);
+    }
+
+    pa_pstream_unlink(a);
+    pa_pstream_unref(a);
+    pa_pstream_unlink(b);
+    pa_pstream_unref(b);
+
+    pa_mempool_free(pool);
+    pa_mainloop_free(m);
+}
+
+int main(int argc, char *argv[]) {
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    run(FALSE);
+    run(TRUE);
+
+    run_shm(FALSE);
+    run_shm(TRUE);
+
+    run_priority();
+
+    return 0;
+}
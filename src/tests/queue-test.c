@@ -25,12 +25,82 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+#include <pulse/rtclock.h>
+#include <pulse/xmalloc.h>
+
 #include <pulsecore/queue.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
 
+#define N_ROUNDS 1000
+#define N_ENTRIES 1000
+
+/* What pa_queue used to be, for comparison: a list with an entry
+ * allocated for each push */
+struct list_entry {
+    struct list_entry *next;
+    void *data;
+};
+
+static void benchmark(void) {
+    struct list_entry *front = NULL, *back = NULL;
+    pa_queue *q;
+    pa_usec_t t;
+    unsigned i, j;
+
+    t = pa_rtclock_now();
+
+    for (i = 0; i < N_ROUNDS; i++) {
+        for (j = 0; j < N_ENTRIES; j++) {
+            struct list_entry *e = pa_xnew(struct list_entry, 1);
+
+            e->data = PA_UINT_TO_PTR(j + 1);
+            e->next = NULL;
+
+            if (back)
+                back->next = e;
+            else
+                front = e;
+
+            back = e;
+        }
+
+        for (j = 0; j < N_ENTRIES; j++) {
+            struct list_entry *e = front;
+
+            pa_assert_se(PA_PTR_TO_UINT(e->data) == j + 1);
+
+            if (!(front = e->next))
+                back = NULL;
+
+            pa_xfree(e);
+        }
+    }
+
+    pa_log_info("Linked list: %llu usec", (unsigned long long) (pa_rtclock_now() - t));
+
+    t = pa_rtclock_now();
+    q = pa_queue_new();
+
+    for (i = 0; i < N_ROUNDS; i++) {
+        for (j = 0; j < N_ENTRIES; j++)
+            pa_queue_push(q, PA_UINT_TO_PTR(j + 1));
+
+        for (j = 0; j < N_ENTRIES; j++)
+            pa_assert_se(PA_PTR_TO_UINT(pa_queue_pop(q)) == j + 1);
+    }
+
+    pa_queue_free(q, NULL);
+
+    pa_log_info("pa_queue: %llu usec", (unsigned long long) (pa_rtclock_now() - t));
+}
+
 int main(int argc, char *argv[]) {
     pa_queue *q;
+    unsigned i, pushed = 0, popped = 0;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
 
     pa_assert_se(q = pa_queue_new());
 
@@ -60,5 +130,26 @@ int main(int argc, char *argv[]) {
 
     pa_queue_free(q, NULL);
 
+    /* Keep the front moving through the array while it grows */
+    pa_assert_se(q = pa_queue_new());
+
+    for (i = 0; i < 100; i++) {
+        pa_queue_push(q, PA_UINT_TO_PTR(++pushed));
+        pa_queue_push(q, PA_UINT_TO_PTR(++pushed));
+        pa_queue_push(q, PA_UINT_TO_PTR(++pushed));
+
+        pa_assert_se(PA_PTR_TO_UINT(pa_queue_pop(q)) == ++popped);
+        pa_assert_se(PA_PTR_TO_UINT(pa_queue_pop(q)) == ++popped);
+    }
+
+    while (popped < pushed)
+        pa_assert_se(PA_PTR_TO_UINT(pa_queue_pop(q)) == ++popped);
+
+    pa_assert_se(pa_queue_isempty(q));
+    pa_assert_se(!pa_queue_pop(q));
+    pa_queue_free(q, NULL);
+
+    benchmark();
+
     return 0;
 }
@@ -0,0 +1,97 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <math.h>
+
+#include <pulse/timeval.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/rate-control.h>
+
+#define BASE_RATE 48000
+#define TARGET_USEC (20*PA_USEC_PER_MSEC)
+
+/* A stream between two clocks drift apart, whose latency
+ * starts off start_usec. The latency is reported with up to 1ms of
+ * noise every 100ms. */
+static void run(double drift, int64_t start_usec) {
+    pa_rate_controller *c;
+    pa_usec_t now;
+    double latency = (double) TARGET_USEC + start_usec;
+    uint32_t rate = BASE_RATE, max_error = 0;
+    double rate_sum = 0;
+    unsigned n = 0;
+
+    c = pa_rate_controller_new(BASE_RATE, 5 * PA_USEC_PER_SEC);
+
+    for (now = PA_USEC_PER_SEC; now < 120 * PA_USEC_PER_SEC; now += PA_USEC_PER_SEC / 10) {
+        uint32_t new_rate;
+        int64_t measured;
+
+        /* What came in minus what went out during the last period */
+        latency += (drift - ((double) rate / BASE_RATE - 1.0)) * (PA_USEC_PER_SEC / 10);
+
+        measured = llrint(latency) - TARGET_USEC + (rand() % 2001) - 1000;
+        new_rate = pa_rate_controller_update(c, now, measured);
+
+        /* Only small steps are allowed */
+        pa_assert_se(abs((int) new_rate - (int) rate) <= BASE_RATE / 5000 + 1);
+        rate = new_rate;
+
+        if (now >= 60 * PA_USEC_PER_SEC) {
+            uint32_t e = (uint32_t) fabs(latency - TARGET_USEC);
+
+            if (e > max_error)
+                max_error = e;
+
+            rate_sum += rate;
+            n++;
+        }
+    }
+
+    pa_log_info("Drift %+0.0f ppm, start %+0.1f ms: settled at %0.1f Hz, within %0.2f ms of the target",
+                drift * 1000000, (double) start_usec / PA_USEC_PER_MSEC, rate_sum / n, (double) max_error / PA_USEC_PER_MSEC);
+
+    /* Once settled, it follows the drift and keeps the latency */
+    pa_assert_se(max_error < PA_USEC_PER_MSEC);
+    pa_assert_se(fabs(rate_sum / n / BASE_RATE - 1.0 - drift) < 0.00005);
+
+    pa_rate_controller_free(c);
+}
+
+int main(int argc, char *argv[]) {
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    srand(0);
+
+    run(0, 0);
+    run(0.0003, 0);
+    run(-0.0005, 20 * PA_USEC_PER_MSEC);
+    run(0.001, -15 * PA_USEC_PER_MSEC);
+
+    return 0;
+}
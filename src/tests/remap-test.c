@@ -0,0 +1,233 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/sample.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/cpu-orc.h>
+#include <pulsecore/cpu-x86.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/random.h>
+#include <pulsecore/remap.h>
+
+/* Checks the remappers picked for a number of matrices against a plain
+ * implementation of the C matrix semantics, and reports how many frames
+ * per second each one does. */
+
+#define N_FRAMES 1031
+
+static const struct {
+    unsigned n_ic, n_oc;
+} layouts[] = {
+    { 1, 2 }, { 2, 1 }, { 2, 6 }, { 4, 2 }, { 6, 2 }, { 8, 2 }, { 6, 8 }, { 3, 5 }, { 8, 8 }, { 12, 2 }
+};
+
+enum {
+    MATRIX_FULL,
+    MATRIX_SPARSE,
+    MATRIX_ARRANGE,
+    MATRIX_MAX
+};
+
+static void setup_matrix(pa_remap_t *m, int kind) {
+    unsigned oc, ic;
+
+    memset(m->map_table_f, 0, sizeof(m->map_table_f));
+    memset(m->map_table_i, 0, sizeof(m->map_table_i));
+
+    for (oc = 0; oc < m->o_ss->channels; oc++)
+        for (ic = 0; ic < m->i_ss->channels; ic++) {
+            float vol = 0.0f;
+
+            switch (kind) {
+                case MATRIX_FULL:
+                    /* Includes entries of exactly 0 and of 1.0 and above */
+                    vol = (float) (rand() % 24) / 16.0f - 0.25f;
+                    break;
+                case MATRIX_SPARSE:
+                    if (rand() % 3 == 0)
+                        vol = (float) rand() / (float) RAND_MAX;
+                    break;
+                case MATRIX_ARRANGE:
+                    if (ic == (oc * 5 + 1) % m->i_ss->channels && oc % 3 != 2)
+                        vol = 1.0f;
+                    break;
+            }
+
+            m->map_table_f[oc][ic] = vol;
+            m->map_table_i[oc][ic] = (int32_t) (vol * 0x10000);
+        }
+}
+
+static void remap_reference(pa_remap_t *m, void *dst, const void *src, unsigned n) {
+    unsigned n_ic = m->i_ss->channels, n_oc = m->o_ss->channels;
+    unsigned i, oc, ic;
+
+    for (i = 0; i < n; i++)
+        for (oc = 0; oc < n_oc; oc++) {
+            if (*m->format == PA_SAMPLE_FLOAT32NE) {
+                const float *s = (const float *) src + i * n_ic;
+                float *d = (float *) dst + i * n_oc + oc;
+
+                *d = 0.0f;
+                for (ic = 0; ic < n_ic; ic++) {
+                    float vol = m->map_table_f[oc][ic];
+
+                    if (vol >= 1.0)
+                        *d += s[ic];
+                    else if (vol > 0.0)
+                        *d += s[ic] * vol;
+                }
+            } else {
+                const int16_t *s = (const int16_t *) src + i * n_ic;
+                int16_t *d = (int16_t *) dst + i * n_oc + oc;
+
+                *d = 0;
+                for (ic = 0; ic < n_ic; ic++) {
+                    int32_t vol = m->map_table_i[oc][ic];
+
+                    if (vol >= 0x10000)
+                        *d += s[ic];
+                    else if (vol > 0)
+                        *d += (int16_t) (((int32_t) s[ic] * vol) >> 16);
+                }
+            }
+        }
+}
+
+static void check_remap_funcs(const char *name, pa_init_remap_func_t init_func) {
+    static const pa_sample_format_t formats[] = { PA_SAMPLE_FLOAT32NE, PA_SAMPLE_S16NE };
+    pa_init_remap_func_t old_func = pa_get_init_remap_func();
+    unsigned l, k, f, i, j, rounds = getenv("MAKE_CHECK") ? 10 : 1000;
+    void *src, *dst, *ref;
+    pa_usec_t t;
+
+    src = pa_xmalloc(N_FRAMES * PA_CHANNELS_MAX * sizeof(float));
+    dst = pa_xmalloc(N_FRAMES * PA_CHANNELS_MAX * sizeof(float));
+    ref = pa_xmalloc(N_FRAMES * PA_CHANNELS_MAX * sizeof(float));
+
+    pa_set_init_remap_func(init_func);
+
+    for (l = 0; l < PA_ELEMENTSOF(layouts); l++)
+        for (k = 0; k < MATRIX_MAX; k++)
+            for (f = 0; f < PA_ELEMENTSOF(formats); f++) {
+                pa_sample_format_t format = formats[f];
+                pa_sample_spec i_ss, o_ss;
+                pa_remap_t m;
+
+                pa_sample_spec_init(&i_ss);
+                pa_sample_spec_init(&o_ss);
+                i_ss.format = o_ss.format = format;
+                i_ss.rate = o_ss.rate = 44100;
+                i_ss.channels = (uint8_t) layouts[l].n_ic;
+                o_ss.channels = (uint8_t) layouts[l].n_oc;
+
+                memset(&m, 0, sizeof(m));
+                m.format = &format;
+                m.i_ss = &i_ss;
+                m.o_ss = &o_ss;
+
+                if (k == MATRIX_ARRANGE && i_ss.channels == 1 && o_ss.channels == 2)
+                    continue;
+
+                setup_matrix(&m, k);
+                pa_init_remap(&m);
+                pa_assert_se(m.do_remap);
+
+                if (format == PA_SAMPLE_FLOAT32NE) {
+                    float *s = src;
+
+                    for (i = 0; i < N_FRAMES * i_ss.channels; i++)
+                        s[i] = 2.0f * ((float) rand() / (float) RAND_MAX - 0.5f);
+                } else
+                    pa_random(src, N_FRAMES * i_ss.channels * sizeof(int16_t));
+
+                /* Odd lengths to check the leftovers */
+                for (i = N_FRAMES - 9; i <= N_FRAMES; i++) {
+                    size_t size = i * o_ss.channels * pa_sample_size_of_format(format);
+
+                    /* Nothing may be written past the end of the output */
+                    memset(dst, 0x55, N_FRAMES * PA_CHANNELS_MAX * sizeof(float));
+                    remap_reference(&m, ref, src, i);
+                    m.do_remap(&m, dst, src, i);
+
+                    pa_assert_se(memcmp(ref, dst, size) == 0);
+                    pa_assert_se(((uint8_t *) dst)[size] == 0x55);
+                }
+
+                t = pa_rtclock_now();
+                for (j = 0; j < rounds; j++)
+                    m.do_remap(&m, dst, src, N_FRAMES);
+                t = pa_rtclock_now() - t;
+
+                pa_log_info("%-4s %2u:%-2u %-7s %-10s %10.0f frames/s", name, i_ss.channels, o_ss.channels,
+                            k == MATRIX_FULL ? "full" : k == MATRIX_SPARSE ? "sparse" : "arrange",
+                            pa_sample_format_to_string(format),
+                            (double) N_FRAMES * rounds * PA_USEC_PER_SEC / PA_MAX(t, 1U));
+            }
+
+    pa_set_init_remap_func(old_func);
+
+    pa_xfree(src);
+    pa_xfree(dst);
+    pa_xfree(ref);
+}
+
+int main(int argc, char *argv[]) {
+    pa_init_remap_func_t c_func;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    c_func = pa_get_init_remap_func();
+
+    check_remap_funcs("C", c_func);
+
+#if defined (__i386__) || defined (__amd64__)
+    {
+        pa_cpu_x86_flag_t flags = 0;
+
+        pa_cpu_init_x86(&flags);
+
+        pa_set_init_remap_func(c_func);
+        pa_remap_func_init_sse(flags);
+        check_remap_funcs("SSE", pa_get_init_remap_func());
+    }
+#endif
+
+#ifndef DISABLE_ORC
+    pa_set_init_remap_func(c_func);
+    pa_remap_func_init_orc();
+    check_remap_funcs("Orc", pa_get_init_remap_func());
+#endif
+
+    pa_set_init_remap_func(c_func);
+
+    return 0;
+}
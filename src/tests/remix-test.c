@@ -68,7 +68,7 @@ int main(int argc, char *argv[]) {
             ss1.rate = ss2.rate = 44100;
             ss1.format = ss2.format = PA_SAMPLE_S16NE;
 
-            r = pa_resampler_new(pool, &ss1, &maps[i], &ss2, &maps[j], PA_RESAMPLER_AUTO, 0);
+            r = pa_resampler_new(pool, NULL, &ss1, &maps[i], &ss2, &maps[j], PA_RESAMPLER_AUTO, 0);
 
             /* We don't really care for the resampler. We just want to
              * see the remixing debug output. */
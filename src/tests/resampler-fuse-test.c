@@ -0,0 +1,151 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <pulse/sample.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/resampler.h>
+#include <pulsecore/sconv.h>
+
+/* Converting and remapping in one pass has to give exactly what the
+ * separate passes give, which is what a resampler from converted input
+ * does. */
+
+static const unsigned block_frames[] = { 700, 13, 256, 1, 257, 2000 };
+
+static pa_mempool *pool;
+
+/* Runs the blocks through r, with the input converted to float first
+ * if convert is set, and returns the output */
+static float *run(pa_resampler *r, const int16_t *in, unsigned channels, pa_bool_t convert, size_t *length) {
+    pa_convert_func_t to_float;
+    float *out = NULL;
+    unsigned k;
+
+    *length = 0;
+    pa_assert_se(to_float = pa_get_convert_to_float32ne_function(PA_SAMPLE_S16NE));
+
+    for (k = 0; k < PA_ELEMENTSOF(block_frames); k++) {
+        pa_memchunk i, o;
+        unsigned n = block_frames[k] * channels;
+        void *d;
+
+        i.memblock = pa_memblock_new(pool, n * (convert ? sizeof(float) : sizeof(int16_t)));
+        i.index = 0;
+        i.length = pa_memblock_get_length(i.memblock);
+
+        d = pa_memblock_acquire(i.memblock);
+        if (convert)
+            to_float(n, in, d);
+        else
+            memcpy(d, in, n * sizeof(int16_t));
+        pa_memblock_release(i.memblock);
+
+        in += n;
+
+        pa_resampler_run(r, &i, &o);
+        pa_memblock_unref(i.memblock);
+
+        if (o.memblock) {
+            out = pa_xrealloc(out, *length + o.length);
+            memcpy((uint8_t*) out + *length, (uint8_t*) pa_memblock_acquire(o.memblock) + o.index, o.length);
+            pa_memblock_release(o.memblock);
+            pa_memblock_unref(o.memblock);
+            *length += o.length;
+        }
+    }
+
+    return out;
+}
+
+static void check(pa_resample_method_t method, uint32_t i_rate, uint32_t o_rate, unsigned i_channels, unsigned o_channels) {
+    pa_sample_spec a, b;
+    pa_resampler *fused, *separate;
+    int16_t *in;
+    float *x, *y;
+    size_t lx, ly, n = 0;
+    unsigned k;
+
+    for (k = 0; k < PA_ELEMENTSOF(block_frames); k++)
+        n += block_frames[k] * i_channels;
+
+    in = pa_xnew(int16_t, n);
+    for (k = 0; k < n; k++)
+        in[k] = (int16_t) (rand() - RAND_MAX / 2);
+
+    a.format = PA_SAMPLE_S16NE;
+    a.rate = i_rate;
+    a.channels = (uint8_t) i_channels;
+
+    b.format = PA_SAMPLE_FLOAT32NE;
+    b.rate = o_rate;
+    b.channels = (uint8_t) o_channels;
+
+    pa_assert_se(fused = pa_resampler_new(pool, NULL, &a, NULL, &b, NULL, method, 0));
+
+    a.format = PA_SAMPLE_FLOAT32NE;
+    pa_assert_se(separate = pa_resampler_new(pool, NULL, &a, NULL, &b, NULL, method, 0));
+
+    x = run(fused, in, i_channels, FALSE, &lx);
+    y = run(separate, in, i_channels, TRUE, &ly);
+
+    pa_log_debug("%s, %u -> %u channels: %lu bytes", pa_resample_method_to_string(method), i_channels, o_channels, (unsigned long) lx);
+
+    pa_assert_se(lx > 0);
+    pa_assert_se(lx == ly);
+    pa_assert_se(memcmp(x, y, lx) == 0);
+
+    pa_resampler_free(fused);
+    pa_resampler_free(separate);
+
+    pa_xfree(x);
+    pa_xfree(y);
+    pa_xfree(in);
+}
+
+int main(int argc, char *argv[]) {
+    static const unsigned channels[][2] = { { 2, 1 }, { 1, 2 }, { 6, 2 }, { 2, 6 } };
+    unsigned k;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    pa_assert_se(pool = pa_mempool_new(FALSE, 0));
+
+    for (k = 0; k < PA_ELEMENTSOF(channels); k++) {
+        check(PA_RESAMPLER_TRIVIAL, 44100, 48000, channels[k][0], channels[k][1]);
+        check(PA_RESAMPLER_TRIVIAL, 48000, 48000, channels[k][0], channels[k][1]);
+        check(PA_RESAMPLER_POLYPHASE, 44100, 48000, channels[k][0], channels[k][1]);
+    }
+
+    pa_mempool_free(pool);
+
+    return 0;
+}
@@ -421,7 +421,7 @@ int main(int argc, char *argv[]) {
                    b.rate, b.channels, pa_sample_format_to_string(b.format));
 
         ts = pa_rtclock_now();
-        pa_assert_se(resampler = pa_resampler_new(pool, &a, NULL, &b, NULL, method, 0));
+        pa_assert_se(resampler = pa_resampler_new(pool, NULL, &a, NULL, &b, NULL, method, 0));
         pa_log_info("init: %llu", (long long unsigned)(pa_rtclock_now() - ts));
 
         i.memblock = pa_memblock_new(pool, pa_usec_to_bytes(1*PA_USEC_PER_SEC, &a));
@@ -451,8 +451,8 @@ int main(int argc, char *argv[]) {
                        pa_sample_format_to_string(b.format),
                        pa_sample_format_to_string(a.format));
 
-            pa_assert_se(forth = pa_resampler_new(pool, &a, NULL, &b, NULL, method, 0));
-            pa_assert_se(back = pa_resampler_new(pool, &b, NULL, &a, NULL, method, 0));
+            pa_assert_se(forth = pa_resampler_new(pool, NULL, &a, NULL, &b, NULL, method, 0));
+            pa_assert_se(back = pa_resampler_new(pool, NULL, &b, NULL, &a, NULL, method, 0));
 
             i.memblock = generate_block(pool, &a);
             i.length = pa_memblock_get_length(i.memblock);
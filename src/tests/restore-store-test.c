@@ -0,0 +1,189 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <pulse/mainloop.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/restore-store.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+/* Checks that the namespaces don't see each other's keys, that they
+ * survive a restart, and that an old database is imported once. */
+
+static pa_datum* make_datum(pa_datum *d, const char *s) {
+    d->data = (char*) s;
+    d->size = strlen(s);
+    return d;
+}
+
+static void set(pa_restore_db *db, const char *key, const char *value) {
+    pa_datum kd, vd;
+
+    pa_assert_se(pa_restore_db_set(db, make_datum(&kd, key), make_datum(&vd, value), TRUE) == 0);
+}
+
+/* value is NULL if the key must be missing */
+static void check(pa_restore_db *db, const char *key, const char *value) {
+    pa_datum kd, vd;
+
+    if (!value) {
+        pa_assert_se(!pa_restore_db_get(db, make_datum(&kd, key), &vd));
+        return;
+    }
+
+    pa_assert_se(pa_restore_db_get(db, make_datum(&kd, key), &vd));
+    pa_assert_se(vd.size == strlen(value));
+    pa_assert_se(memcmp(vd.data, value, vd.size) == 0);
+    pa_datum_free(&vd);
+}
+
+static unsigned count(pa_restore_db *db) {
+    pa_datum key, next, data;
+    unsigned n = 0;
+
+    if (!pa_restore_db_first(db, &key, &data))
+        return 0;
+
+    for (;;) {
+        pa_assert_se(data.size > 0);
+        pa_datum_free(&data);
+        n++;
+
+        if (!pa_restore_db_next(db, &key, &next, &data)) {
+            pa_datum_free(&key);
+            return n;
+        }
+
+        pa_datum_free(&key);
+        key = next;
+    }
+}
+
+static void remove_dir(const char *dir) {
+    DIR *d;
+    struct dirent *de;
+
+    pa_assert_se(d = opendir(dir));
+
+    while ((de = readdir(d))) {
+        char *fn;
+
+        if (pa_streq(de->d_name, ".") || pa_streq(de->d_name, ".."))
+            continue;
+
+        fn = pa_sprintf_malloc("%s/%s", dir, de->d_name);
+        pa_assert_se(unlink(fn) == 0);
+        pa_xfree(fn);
+    }
+
+    closedir(d);
+    pa_assert_se(rmdir(dir) == 0);
+}
+
+int main(int argc, char *argv[]) {
+    pa_mainloop *m;
+    pa_core *c;
+    pa_restore_db *a, *b;
+    pa_database *old;
+    pa_datum kd, vd;
+    char *dir, *fn;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    dir = pa_sprintf_malloc("%s/pulse-restore-store-test-XXXXXX", pa_get_temp_dir());
+    pa_assert_se(mkdtemp(dir));
+    pa_assert_se(setenv("PULSE_STATE_PATH", dir, 1) == 0);
+
+    pa_assert_se(m = pa_mainloop_new());
+    pa_assert_se(c = pa_core_new(pa_mainloop_get_api(m), FALSE, 0, 0, 0));
+
+    /* The database of the "b" namespace from before */
+    pa_assert_se(fn = pa_state_path("b", TRUE));
+    pa_assert_se(old = pa_database_open(fn, TRUE));
+    pa_assert_se(pa_database_set(old, make_datum(&kd, "imported"), make_datum(&vd, "yes"), TRUE) == 0);
+    pa_database_close(old);
+
+    pa_assert_se(a = pa_restore_db_open(c, "a"));
+    pa_assert_se(b = pa_restore_db_open(c, "b"));
+
+    check(b, "imported", "yes");
+    check(a, "imported", NULL);
+
+    set(a, "x", "a-x");
+    set(a, "y", "a-y");
+    set(b, "x", "b-x");
+
+    check(a, "x", "a-x");
+    check(b, "x", "b-x");
+    check(b, "y", NULL);
+    pa_assert_se(count(a) == 2);
+    pa_assert_se(count(b) == 2);
+
+    pa_assert_se(pa_restore_db_clear(a) == 0);
+    pa_assert_se(count(a) == 0);
+    check(b, "x", "b-x");
+
+    set(a, "z", "a-z");
+    pa_restore_db_save(a);
+
+    pa_restore_db_close(a);
+    pa_restore_db_close(b);
+
+    /* The old database is still there, but isn't imported again */
+    pa_assert_se(old = pa_database_open(fn, TRUE));
+    pa_assert_se(pa_database_set(old, make_datum(&kd, "imported"), make_datum(&vd, "again"), TRUE) == 0);
+    pa_database_close(old);
+
+    pa_assert_se(b = pa_restore_db_open(c, "b"));
+    pa_assert_se(a = pa_restore_db_open(c, "a"));
+
+    check(a, "z", "a-z");
+    check(a, "x", NULL);
+    check(b, "x", "b-x");
+    check(b, "imported", "yes");
+
+    pa_assert_se(pa_restore_db_unset(b, make_datum(&kd, "x")) == 0);
+    pa_assert_se(count(b) == 1);
+
+    pa_restore_db_close(b);
+    pa_restore_db_close(a);
+
+    pa_core_unref(c);
+    pa_mainloop_free(m);
+
+    remove_dir(dir);
+    pa_xfree(fn);
+    pa_xfree(dir);
+
+    return 0;
+}
@@ -23,8 +23,11 @@
 
 #include <signal.h>
 
+#include <pulsecore/asyncmsgq.h>
 #include <pulsecore/poll.h>
 #include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/msgobject.h>
 #include <pulsecore/rtpoll.h>
 
 static int before(pa_rtpoll_item *i) {
@@ -41,11 +44,57 @@ static int worker(pa_rtpoll_item *w) {
     return 0;
 }
 
+typedef struct counter {
+    pa_msgobject parent;
+    unsigned n;
+} counter;
+
+PA_DEFINE_PRIVATE_CLASS(counter, pa_msgobject);
+#define COUNTER(o) (counter_cast(o))
+
+static int process_msg(pa_msgobject *o, int code, void *userdata, int64_t offset, pa_memchunk *chunk) {
+    COUNTER(o)->n++;
+    return 0;
+}
+
+/* Queued messages are handled in batches of up to 32 per run */
+static void check_asyncmsgq_batch(void) {
+    pa_rtpoll *p;
+    pa_rtpoll_item *i;
+    pa_asyncmsgq *q;
+    counter *c;
+    unsigned k;
+
+    p = pa_rtpoll_new();
+    pa_assert_se(q = pa_asyncmsgq_new(0));
+    i = pa_rtpoll_item_new_asyncmsgq_read(p, PA_RTPOLL_EARLY, q);
+
+    c = pa_msgobject_new(counter);
+    c->parent.process_msg = process_msg;
+    c->n = 0;
+
+    for (k = 0; k < 40; k++)
+        pa_asyncmsgq_post(q, PA_MSGOBJECT(c), 0, NULL, 0, NULL, NULL);
+
+    pa_assert_se(pa_rtpoll_run(p, FALSE) > 0);
+    pa_assert_se(c->n == 32);
+
+    pa_assert_se(pa_rtpoll_run(p, FALSE) > 0);
+    pa_assert_se(c->n == 40);
+
+    pa_rtpoll_item_free(i);
+    pa_asyncmsgq_unref(q);
+    pa_msgobject_unref(PA_MSGOBJECT(c));
+    pa_rtpoll_free(p);
+}
+
 int main(int argc, char *argv[]) {
     pa_rtpoll *p;
     pa_rtpoll_item *i, *w;
     struct pollfd *pollfd;
 
+    check_asyncmsgq_batch();
+
     p = pa_rtpoll_new();
 
     i = pa_rtpoll_item_new(p, PA_RTPOLL_EARLY, 1);
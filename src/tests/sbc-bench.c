@@ -0,0 +1,216 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-rtclock.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "sbc.h"
+#include "sbc_math.h"
+#include "sbc_tables.h"
+#include "sbc_primitives.h"
+
+/* Checks that the synthesis filter the decoder picks for this machine
+ * gives exactly the same output as the C version, for 4 and 8
+ * subbands, and measures both. Then a stream as A2DP sends it is
+ * decoded for a while and the number of such streams one CPU could
+ * decode in real time is printed.
+ *
+ * Usage: sbc-bench */
+
+#define N_BLOCKS (16 * 1024)
+#define N_SECONDS 10
+#define RATE 44100
+
+/* Subband samples of real streams stay well below this, much larger
+ * ones would overflow the 32-bit arithmetic of the filter */
+#define SB_SAMPLE_MAX (1 << 14)
+
+static void decoder_state_init(struct sbc_decoder_state *state, int subbands, pa_bool_t generic) {
+    int i, ch;
+
+    memset(state, 0, sizeof(*state));
+    state->subbands = subbands;
+
+    for (ch = 0; ch < 2; ch++)
+        for (i = 0; i < subbands * 2; i++)
+            state->offset[ch][i] = 10 * i + 10;
+
+    if (generic)
+        sbc_init_decoder_primitives_generic(state);
+    else
+        sbc_init_decoder_primitives(state);
+}
+
+static void synthesize(struct sbc_decoder_state *state, int subbands, const int32_t *sb_samples, int16_t *pcm) {
+    unsigned i;
+    int ch;
+
+    for (i = 0; i < N_BLOCKS; i++)
+        for (ch = 0; ch < 2; ch++) {
+            const int32_t *in = sb_samples + (i * 2 + ch) * subbands;
+            int16_t *out = pcm + (i * 2 + ch) * subbands;
+
+            if (subbands == 4)
+                state->sbc_synthesize_4s(state, in, out, ch);
+            else
+                state->sbc_synthesize_8s(state, in, out, ch);
+        }
+}
+
+static double measure_synthesis(int subbands, pa_bool_t generic, const int32_t *sb_samples, int16_t *pcm) {
+    struct sbc_decoder_state state;
+    pa_usec_t start;
+
+    decoder_state_init(&state, subbands, generic);
+
+    start = pa_rtclock_now();
+    synthesize(&state, subbands, sb_samples, pcm);
+
+    /* Per block and channel */
+    return (double) (pa_rtclock_now() - start) * 1000.0 / (N_BLOCKS * 2);
+}
+
+static void check_synthesis(int subbands) {
+    struct sbc_decoder_state generic, best;
+    int32_t *sb_samples;
+    int16_t *pcm_generic, *pcm_best;
+    double ns_generic, ns_best;
+    unsigned i, n;
+
+    n = N_BLOCKS * 2 * subbands;
+    sb_samples = pa_xnew(int32_t, n);
+    pcm_generic = pa_xnew(int16_t, n);
+    pcm_best = pa_xnew(int16_t, n);
+
+    for (i = 0; i < n; i++)
+        sb_samples[i] = rand() % (2 * SB_SAMPLE_MAX + 1) - SB_SAMPLE_MAX;
+
+    decoder_state_init(&generic, subbands, TRUE);
+    decoder_state_init(&best, subbands, FALSE);
+
+    synthesize(&generic, subbands, sb_samples, pcm_generic);
+    synthesize(&best, subbands, sb_samples, pcm_best);
+
+    for (i = 0; i < n; i++)
+        if (pcm_generic[i] != pcm_best[i]) {
+            pa_log("%s synthesis for %i subbands differs at sample %u: %i instead of %i.",
+                   best.implementation_info, subbands, i, pcm_best[i], pcm_generic[i]);
+            pa_assert_not_reached();
+        }
+
+    pa_assert_se(memcmp(generic.offset, best.offset, sizeof(generic.offset)) == 0);
+
+    ns_generic = measure_synthesis(subbands, TRUE, sb_samples, pcm_generic);
+    ns_best = measure_synthesis(subbands, FALSE, sb_samples, pcm_best);
+
+    printf("synthesis, %i subbands: %s %0.1f ns, %s %0.1f ns per block, %0.2fx\n",
+           subbands, generic.implementation_info, ns_generic,
+           best.implementation_info, ns_best, ns_generic / ns_best);
+
+    pa_xfree(sb_samples);
+    pa_xfree(pcm_generic);
+    pa_xfree(pcm_best);
+}
+
+static void measure_decode(void) {
+    sbc_t encoder, decoder;
+    size_t codesize, frame_length, n_frames, k;
+    int16_t *pcm;
+    uint8_t *frames, *out;
+    unsigned i;
+    ssize_t encoded;
+    size_t decoded;
+    pa_usec_t start, t;
+
+    pa_assert_se(sbc_init(&encoder, 0) == 0);
+    encoder.frequency = SBC_FREQ_44100;
+    encoder.mode = SBC_MODE_JOINT_STEREO;
+    encoder.subbands = SBC_SB_8;
+    encoder.blocks = SBC_BLK_16;
+    encoder.allocation = SBC_AM_LOUDNESS;
+    encoder.bitpool = 53;
+    encoder.endian = SBC_LE;
+
+    codesize = sbc_get_codesize(&encoder);
+    frame_length = sbc_get_frame_length(&encoder);
+
+    /* One second of two tones and some noise */
+    n_frames = RATE * 4 / codesize;
+    pcm = pa_xnew(int16_t, n_frames * codesize / 2);
+
+    for (i = 0; i < n_frames * codesize / 4; i++) {
+        pcm[2 * i] = (int16_t) (8000 * sin(2 * M_PI * 440 * i / RATE) + rand() % 2000 - 1000);
+        pcm[2 * i + 1] = (int16_t) (8000 * sin(2 * M_PI * 1000 * i / RATE) + rand() % 2000 - 1000);
+    }
+
+    frames = pa_xmalloc(n_frames * frame_length);
+
+    for (k = 0; k < n_frames; k++)
+        pa_assert_se(sbc_encode(&encoder, (uint8_t*) pcm + k * codesize, codesize,
+                                frames + k * frame_length, frame_length, &encoded) == (ssize_t) codesize);
+
+    pa_assert_se(sbc_init(&decoder, 0) == 0);
+    out = pa_xmalloc(codesize);
+
+    start = pa_rtclock_now();
+    for (i = 0; i < N_SECONDS; i++)
+        for (k = 0; k < n_frames; k++)
+            pa_assert_se(sbc_decode(&decoder, frames + k * frame_length, frame_length,
+                                    out, codesize, &decoded) == (ssize_t) frame_length);
+    t = pa_rtclock_now() - start;
+
+    printf("decoding 44.1 kHz joint stereo, bitpool 53: %0.1f us per frame, %0.0f streams in real time\n",
+           (double) t / (N_SECONDS * n_frames), (double) N_SECONDS * PA_USEC_PER_SEC / t);
+
+    sbc_finish(&encoder);
+    sbc_finish(&decoder);
+
+    pa_xfree(pcm);
+    pa_xfree(frames);
+    pa_xfree(out);
+}
+
+int main(int argc, char *argv[]) {
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    srand(0);
+
+    check_synthesis(4);
+    check_synthesis(8);
+
+    measure_decode();
+
+    return 0;
+}
@@ -0,0 +1,306 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/sample.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/cpu-arm.h>
+#include <pulsecore/cpu-orc.h>
+#include <pulsecore/cpu-x86.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/random.h>
+#include <pulsecore/sconv.h>
+
+/* Checks every optimized conversion from and to float32ne against the
+ * C version, and reports how many samples per second each one does.
+ * The ulaw and alaw conversions from and to s16ne are checked for all
+ * of their inputs. */
+
+#define N_SAMPLES 4099
+
+static pa_convert_func_t c_to_float[PA_SAMPLE_MAX], c_from_float[PA_SAMPLE_MAX];
+static pa_convert_func_t c_to_s16[PA_SAMPLE_MAX], c_from_s16[PA_SAMPLE_MAX];
+
+static void reset_convert_funcs(void) {
+    pa_sample_format_t f;
+
+    for (f = 0; f < PA_SAMPLE_MAX; f++) {
+        pa_set_convert_to_float32ne_function(f, c_to_float[f]);
+        pa_set_convert_from_float32ne_function(f, c_from_float[f]);
+        pa_set_convert_to_s16ne_function(f, c_to_s16[f]);
+        pa_set_convert_from_s16ne_function(f, c_from_s16[f]);
+    }
+}
+
+/* The NEON versions may be off in the last bit, so compare what the
+ * results mean rather than their bits there */
+static void compare_samples(pa_sample_format_t f, pa_bool_t exact, const void *ref, const void *out, unsigned n) {
+    static float a[N_SAMPLES], b[N_SAMPLES];
+    float max_diff;
+    unsigned i;
+
+    if (exact) {
+        pa_assert_se(memcmp(ref, out, n * pa_sample_size_of_format(f)) == 0);
+        return;
+    }
+
+    if (f == PA_SAMPLE_FLOAT32NE) {
+        memcpy(a, ref, n * sizeof(float));
+        memcpy(b, out, n * sizeof(float));
+        max_diff = 0;
+    } else {
+        c_to_float[f](n, ref, a);
+        c_to_float[f](n, out, b);
+
+        switch (f) {
+            case PA_SAMPLE_U8:
+                max_diff = 1.0f / 0x80;
+                break;
+            case PA_SAMPLE_S16LE:
+            case PA_SAMPLE_S16BE:
+                max_diff = 1.0f / 0x7FFF;
+                break;
+            default:
+                max_diff = 0;
+                break;
+        }
+    }
+
+    max_diff += 1.0f / (1 << 22);
+
+    for (i = 0; i < n; i++)
+        pa_assert_se(fabsf(a[i] - b[i]) <= max_diff);
+}
+
+static void check_convert_funcs(const char *name, pa_bool_t exact) {
+    float *floats, *floats_ref;
+    uint8_t *samples, *samples_ref, *orig;
+    pa_sample_format_t f;
+    unsigned i, j, rounds = getenv("MAKE_CHECK") ? 10 : 1000;
+    pa_usec_t t;
+
+    floats = pa_xnew(float, N_SAMPLES);
+    floats_ref = pa_xnew(float, N_SAMPLES);
+    samples = pa_xmalloc(N_SAMPLES * 4);
+    samples_ref = pa_xmalloc(N_SAMPLES * 4);
+    orig = pa_xmalloc(N_SAMPLES * 4);
+
+    for (f = 0; f < PA_SAMPLE_MAX; f++) {
+        pa_convert_func_t to = pa_get_convert_to_float32ne_function(f);
+        pa_convert_func_t from = pa_get_convert_from_float32ne_function(f);
+        pa_bool_t is_c = strcmp(name, "C") == 0;
+
+        if (f == PA_SAMPLE_FLOAT32NE)
+            continue;
+
+        if (is_c || to != c_to_float[f]) {
+            pa_random(orig, N_SAMPLES * 4);
+
+            /* Odd lengths to check the leftovers */
+            for (i = N_SAMPLES - 7; i <= N_SAMPLES; i++) {
+                c_to_float[f](i, orig, floats_ref);
+                to(i, orig, floats);
+                compare_samples(PA_SAMPLE_FLOAT32NE, exact, floats_ref, floats, i);
+            }
+
+            t = pa_rtclock_now();
+            for (j = 0; j < rounds; j++)
+                to(N_SAMPLES, orig, floats);
+            t = pa_rtclock_now() - t;
+
+            pa_log_info("%-5s %-10s to float32ne   %10.0f samples/s", name, pa_sample_format_to_string(f),
+                        (double) N_SAMPLES * rounds * PA_USEC_PER_SEC / PA_MAX(t, 1U));
+        }
+
+        if (is_c || from != c_from_float[f]) {
+            /* Values in and beyond [-1, 1], and some that need rounding */
+            for (i = 0; i < N_SAMPLES; i++)
+                floats[i] = 2.4f * ((float) rand() / (float) RAND_MAX - 0.5f);
+            floats[0] = 1.0f;
+            floats[1] = -1.0f;
+            floats[2] = 0.0f;
+            floats[3] = 0.5f / 0x7FFF;
+            floats[4] = -1.5f / 0x7FFF;
+            floats[5] = 1e-20f;
+
+            for (i = N_SAMPLES - 7; i <= N_SAMPLES; i++) {
+                memset(samples_ref, 0, N_SAMPLES * 4);
+                memset(samples, 0, N_SAMPLES * 4);
+                c_from_float[f](i, floats, samples_ref);
+                from(i, floats, samples);
+                compare_samples(f, exact, samples_ref, samples, i);
+            }
+
+            t = pa_rtclock_now();
+            for (j = 0; j < rounds; j++)
+                from(N_SAMPLES, floats, samples);
+            t = pa_rtclock_now() - t;
+
+            pa_log_info("%-5s %-10s from float32ne %10.0f samples/s", name, pa_sample_format_to_string(f),
+                        (double) N_SAMPLES * rounds * PA_USEC_PER_SEC / PA_MAX(t, 1U));
+        }
+    }
+
+    pa_xfree(floats);
+    pa_xfree(floats_ref);
+    pa_xfree(samples);
+    pa_xfree(samples_ref);
+    pa_xfree(orig);
+}
+
+static void check_law_funcs(const char *name) {
+    static const pa_sample_format_t formats[] = { PA_SAMPLE_ULAW, PA_SAMPLE_ALAW };
+    int16_t *s16, *s16_ref;
+    uint8_t *codes, *codes_ref;
+    unsigned i, j, k, rounds = getenv("MAKE_CHECK") ? 10 : 1000;
+    pa_usec_t t;
+
+    s16 = pa_xnew(int16_t, 0x10000);
+    s16_ref = pa_xnew(int16_t, 0x10000);
+    codes = pa_xnew(uint8_t, 0x10000);
+    codes_ref = pa_xnew(uint8_t, 0x10000);
+
+    for (k = 0; k < PA_ELEMENTSOF(formats); k++) {
+        pa_sample_format_t f = formats[k];
+        pa_convert_func_t to = pa_get_convert_to_s16ne_function(f);
+        pa_convert_func_t from = pa_get_convert_from_s16ne_function(f);
+
+        /* Every code, then every sample value, with lengths that leave
+         * some over */
+        for (i = 0; i < 256; i++)
+            codes[i] = (uint8_t) i;
+
+        for (i = 256 - 7; i <= 256; i++) {
+            memset(s16, 0, 256 * sizeof(int16_t));
+            c_to_s16[f](i, codes, s16_ref);
+            to(i, codes, s16);
+            pa_assert_se(memcmp(s16_ref, s16, i * sizeof(int16_t)) == 0);
+        }
+
+        for (i = 0; i < 0x10000; i++)
+            s16[i] = (int16_t) (i - 0x8000);
+
+        for (i = 0x10000 - 7; i <= 0x10000; i++) {
+            memset(codes, 0, 0x10000);
+            c_from_s16[f](i, s16, codes_ref);
+            from(i, s16, codes);
+            pa_assert_se(memcmp(codes_ref, codes, i) == 0);
+        }
+
+        /* Decoding and encoding again gives the same code, except for
+         * the negative zero of ulaw */
+        for (i = 0; i < 256; i++)
+            codes[i] = (uint8_t) i;
+
+        to(256, codes, s16);
+        from(256, s16, codes_ref);
+
+        for (i = 0; i < 256; i++)
+            pa_assert_se(codes_ref[i] == i || (f == PA_SAMPLE_ULAW && i == 0x7F && codes_ref[i] == 0xFF));
+
+        t = pa_rtclock_now();
+        for (j = 0; j < rounds; j++)
+            to(N_SAMPLES, codes, s16);
+        t = pa_rtclock_now() - t;
+
+        pa_log_info("%-5s %-10s to s16ne        %10.0f samples/s", name, pa_sample_format_to_string(f),
+                    (double) N_SAMPLES * rounds * PA_USEC_PER_SEC / PA_MAX(t, 1U));
+
+        t = pa_rtclock_now();
+        for (j = 0; j < rounds; j++)
+            from(N_SAMPLES, s16, codes);
+        t = pa_rtclock_now() - t;
+
+        pa_log_info("%-5s %-10s from s16ne      %10.0f samples/s", name, pa_sample_format_to_string(f),
+                    (double) N_SAMPLES * rounds * PA_USEC_PER_SEC / PA_MAX(t, 1U));
+    }
+
+    pa_xfree(s16);
+    pa_xfree(s16_ref);
+    pa_xfree(codes);
+    pa_xfree(codes_ref);
+}
+
+int main(int argc, char *argv[]) {
+    pa_sample_format_t f;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    for (f = 0; f < PA_SAMPLE_MAX; f++) {
+        c_to_float[f] = pa_get_convert_to_float32ne_function(f);
+        c_from_float[f] = pa_get_convert_from_float32ne_function(f);
+        c_to_s16[f] = pa_get_convert_to_s16ne_function(f);
+        c_from_s16[f] = pa_get_convert_from_s16ne_function(f);
+    }
+
+    check_convert_funcs("C", TRUE);
+    check_law_funcs("C");
+
+#if defined (__i386__) || defined (__amd64__)
+    {
+        pa_cpu_x86_flag_t flags = 0;
+
+        pa_cpu_init_x86(&flags);
+
+        reset_convert_funcs();
+        pa_convert_func_init_sse(flags);
+        check_convert_funcs("SSE", TRUE);
+        check_law_funcs("SSE");
+
+        reset_convert_funcs();
+        pa_convert_func_init_avx(flags);
+        check_convert_funcs("AVX2", TRUE);
+    }
+#endif
+
+#if defined (__arm__)
+    {
+        pa_cpu_arm_flag_t flags = 0;
+
+        pa_cpu_init_arm(&flags);
+
+        reset_convert_funcs();
+        pa_convert_func_init_neon(flags);
+        check_convert_funcs("NEON", FALSE);
+    }
+#endif
+
+#ifndef DISABLE_ORC
+    /* Depending on the backend Orc may divide approximately */
+    reset_convert_funcs();
+    pa_convert_func_init_orc();
+    check_convert_funcs("Orc", FALSE);
+#endif
+
+    reset_convert_funcs();
+
+    return 0;
+}
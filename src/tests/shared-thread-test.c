@@ -0,0 +1,146 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+
+#include <pulse/mainloop.h>
+#include <pulse/rtclock.h>
+#include <pulse/util.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/msgobject.h>
+#include <pulsecore/shared-thread.h>
+#include <pulsecore/thread.h>
+
+/* Clients have to be called at their deadlines, always from the same
+ * thread, which also has to be where their messages are dispatched. */
+
+#define N_CLIENTS 5
+#define RUN_MSEC 300
+
+typedef struct client {
+    pa_msgobject parent;
+
+    pa_shared_thread_client *shared;
+    pa_usec_t period, deadline;
+    pa_thread *thread;
+    unsigned n_calls, n_due, n_messages;
+    pa_usec_t max_lateness;
+} client;
+
+PA_DEFINE_PRIVATE_CLASS(client, pa_msgobject);
+#define CLIENT(o) (client_cast(o))
+
+static pa_usec_t client_cb(pa_shared_thread_client *c, pa_usec_t now, void *userdata) {
+    client *cl = userdata;
+
+    if (!cl->thread)
+        cl->thread = pa_thread_self();
+
+    pa_assert_se(cl->thread == pa_thread_self());
+    cl->n_calls++;
+
+    if (cl->deadline == 0 || now >= cl->deadline) {
+        if (cl->deadline > 0) {
+            cl->n_due++;
+            cl->max_lateness = PA_MAX(cl->max_lateness, now - cl->deadline);
+        }
+
+        cl->deadline = now + cl->period;
+    }
+
+    return cl->deadline;
+}
+
+static int client_process_msg(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
+    client *cl = CLIENT(o);
+
+    pa_assert_se(cl->thread == pa_thread_self());
+    cl->n_messages++;
+
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    pa_mainloop *m;
+    pa_core *c;
+    client *clients[N_CLIENTS];
+    unsigned i, n_calls;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    pa_assert_se(m = pa_mainloop_new());
+    pa_assert_se(c = pa_core_new(pa_mainloop_get_api(m), FALSE, 0, 0, 0));
+
+    for (i = 0; i < N_CLIENTS; i++) {
+        clients[i] = pa_msgobject_new(client);
+        clients[i]->parent.process_msg = client_process_msg;
+        clients[i]->period = (5 + 3 * i) * PA_USEC_PER_MSEC;
+        clients[i]->deadline = 0;
+        clients[i]->thread = NULL;
+        clients[i]->n_calls = clients[i]->n_due = clients[i]->n_messages = 0;
+        clients[i]->max_lateness = 0;
+
+        pa_assert_se(clients[i]->shared = pa_shared_thread_attach(c, NULL, client_cb, clients[i]));
+    }
+
+    pa_msleep(RUN_MSEC / 2);
+
+    for (i = 0; i < N_CLIENTS; i++)
+        pa_assert_se(pa_asyncmsgq_send(pa_shared_thread_get_asyncmsgq(clients[i]->shared), PA_MSGOBJECT(clients[i]), 0, NULL, 0, NULL) == 0);
+
+    pa_msleep(RUN_MSEC / 2);
+
+    for (i = 0; i < N_CLIENTS; i++) {
+        client *cl = clients[i];
+        unsigned expected = (unsigned) (RUN_MSEC * PA_USEC_PER_MSEC / cl->period);
+
+        pa_shared_thread_detach(cl->shared);
+
+        pa_log_debug("Client %u: %u calls, %u of %u deadlines, at most %llu us late",
+                     i, cl->n_calls, cl->n_due, expected, (unsigned long long) cl->max_lateness);
+
+        pa_assert_se(cl->n_messages == 1);
+        pa_assert_se(cl->n_due >= expected / 2);
+        pa_assert_se(cl->n_due <= expected + 1);
+    }
+
+    /* Nobody is called anymore */
+    n_calls = clients[0]->n_calls;
+    pa_msleep(20);
+    pa_assert_se(clients[0]->n_calls == n_calls);
+
+    for (i = 0; i < N_CLIENTS; i++)
+        client_unref(clients[i]);
+
+    pa_core_unref(c);
+    pa_mainloop_free(m);
+
+    return 0;
+}
@@ -29,10 +29,13 @@
 #include <pulsecore/memtrap.h>
 #include <pulsecore/core-util.h>
 
+#define N_OTHERS 64
+
 int main(int argc, char *argv[]) {
-    void *p;
+    void *p, *others;
     int fd;
-    pa_memtrap *m;
+    pa_memtrap *m, *other[N_OTHERS];
+    unsigned i;
 
     pa_log_set_level(PA_LOG_DEBUG);
     pa_memtrap_install();
@@ -43,6 +46,16 @@ int main(int argc, char *argv[]) {
     pa_assert_se(ftruncate(fd, PA_PAGE_SIZE) >= 0);
     pa_assert_se((p = mmap(NULL, PA_PAGE_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0)) != MAP_FAILED);
 
+    /* Some more traps for every other page of another map, so that the
+     * right one has to be looked up among them */
+    pa_assert_se((others = mmap(NULL, 2 * N_OTHERS * PA_PAGE_SIZE, PROT_READ|PROT_WRITE, MAP_ANONYMOUS|MAP_PRIVATE, -1, 0)) != MAP_FAILED);
+
+    for (i = 0; i < N_OTHERS; i++)
+        other[i] = pa_memtrap_add((uint8_t*) others + 2 * i * PA_PAGE_SIZE, PA_PAGE_SIZE);
+
+    /* Move one of them to the page in between */
+    pa_memtrap_update(other[7], (uint8_t*) others + 15 * PA_PAGE_SIZE, PA_PAGE_SIZE);
+
     /* Register memory map */
     m = pa_memtrap_add(p, PA_PAGE_SIZE);
 
@@ -63,8 +76,16 @@ int main(int argc, char *argv[]) {
     pa_log("Let's see if this worked: %s", (char*) p);
     pa_log("And memtrap says it is good: %s", pa_yes_no(pa_memtrap_is_good(m)));
 
+    pa_assert_se(!pa_memtrap_is_good(m));
+
+    for (i = 0; i < N_OTHERS; i++) {
+        pa_assert_se(pa_memtrap_is_good(other[i]));
+        pa_memtrap_remove(other[i]);
+    }
+
     pa_memtrap_remove(m);
     munmap(p, PA_PAGE_SIZE);
+    munmap(others, 2 * N_OTHERS * PA_PAGE_SIZE);
 
     return 0;
 }
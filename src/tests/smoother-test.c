@@ -23,12 +23,60 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 
 #include <pulse/timeval.h>
+#include <pulse/rtclock.h>
 
 #include <pulsecore/log.h>
+#include <pulsecore/macro.h>
 #include <pulsecore/time-smoother.h>
 
+/* Follows a remote clock running 0.03% fast, reported roughly every
+ * 10ms with up to 2ms of noise. Returns the RMS error of the estimate
+ * after the first few seconds, and the time taken per measurement. */
+static double track(pa_bool_t recursive, double *usec_per_put) {
+    pa_smoother *s;
+    pa_usec_t x = 0, t;
+    double err = 0;
+    unsigned n = 0, n_put = 0;
+
+    srand(1);
+
+    s = pa_smoother_new(PA_USEC_PER_SEC, PA_USEC_PER_SEC*2, TRUE, TRUE, 10, 0, FALSE, recursive);
+
+    t = pa_rtclock_now();
+
+    while (x < 60 * PA_USEC_PER_SEC) {
+        pa_usec_t next, y;
+
+        y = (pa_usec_t) llrint(x * 1.0003 + (rand() % 4001) - 2000 + PA_USEC_PER_SEC);
+        pa_smoother_put(s, x, y);
+        n_put++;
+
+        next = x + 5 * PA_USEC_PER_MSEC + (pa_usec_t) (rand() % 10) * PA_USEC_PER_MSEC;
+
+        for (; x < next; x += PA_USEC_PER_MSEC) {
+            double d;
+
+            if (x < 5 * PA_USEC_PER_SEC)
+                continue;
+
+            d = (double) pa_smoother_get(s, x) - (x * 1.0003 + PA_USEC_PER_SEC);
+            err += d * d;
+            n++;
+        }
+    }
+
+    t = pa_rtclock_now() - t;
+
+    pa_smoother_free(s);
+
+    *usec_per_put = (double) t / n_put;
+
+    return sqrt(err / n);
+}
+
 int main(int argc, char*argv[]) {
     pa_usec_t x;
     unsigned u = 0;
@@ -64,7 +112,7 @@ int main(int argc, char*argv[]) {
             msec[u+1] = 0;
     }
 
-    s = pa_smoother_new(700*PA_USEC_PER_MSEC, 2000*PA_USEC_PER_MSEC, FALSE, TRUE, 6, 0, TRUE);
+    s = pa_smoother_new(700*PA_USEC_PER_MSEC, 2000*PA_USEC_PER_MSEC, FALSE, TRUE, 6, 0, TRUE, FALSE);
 
     for (x = 0, u = 0; x < PA_USEC_PER_SEC * 10; x += PA_USEC_PER_MSEC) {
 
@@ -81,5 +129,16 @@ int main(int argc, char*argv[]) {
 
     pa_smoother_free(s);
 
+    for (m = 0; m < 2; m++) {
+        double rms, cost;
+
+        rms = track(m, &cost);
+        pa_log_info("%s: RMS error %0.0f usec, %0.3f usec per measurement (incl. queries)",
+                    m ? "Recursive" : "Regression", rms, cost);
+
+        /* Both must stay well within the noise */
+        pa_assert_se(rms < 2000);
+    }
+
     return 0;
 }
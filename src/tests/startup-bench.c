@@ -0,0 +1,434 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <signal.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include <pulse/pulseaudio.h>
+#include <pulse/mainloop.h>
+#include <pulse/rtclock.h>
+
+#include <pulsecore/core-rtclock.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+/* Starts a private daemon and measures how long it takes until its
+ * socket accepts connections, until a context is READY and until the
+ * first sample of a stream is played. The daemon logs how long module
+ * loads, ALSA profile probing, database opens and sample cache loads
+ * took, and those are collected from its log. The result is written
+ * to STDOUT as JSON.
+ *
+ * Usage: startup-bench [DAEMON [DAEMON ARGUMENTS...]] */
+
+#define TIMEOUT_USEC (30 * PA_USEC_PER_SEC)
+#define POLL_USEC PA_USEC_PER_MSEC
+#define MAX_PHASES 1024
+
+struct phase {
+    const char *kind;
+    char *name;
+    double msec;
+};
+
+/* The log messages of the daemon that end in " in <msec> ms." */
+static const struct {
+    const char *prefix;
+    const char *kind;
+} phase_messages[] = {
+    { "Loaded \"", "module" },
+    { "Probed profiles of ", "alsa-probe" },
+    { "Opened database ", "database" },
+    { "Loaded sample ", "sample" },
+};
+
+static const pa_sample_spec sample_spec = {
+    .format = PA_SAMPLE_S16LE,
+    .rate = 44100,
+    .channels = 2
+};
+
+static pa_mainloop_api *api = NULL;
+static pa_context *context = NULL;
+static pa_stream *stream = NULL;
+static pa_time_event *poll_event = NULL;
+static pa_io_event *log_event = NULL;
+
+static pid_t daemon_pid = (pid_t) -1;
+static char *runtime_dir = NULL, *socket_path = NULL;
+
+static pa_usec_t t_start, t_socket, t_context, t_played;
+static pa_bool_t failed = FALSE;
+
+static struct phase phases[MAX_PHASES];
+static unsigned n_phases = 0;
+
+static char line[4096];
+static size_t line_length = 0;
+
+static void fail(const char *what) {
+    pa_log("%s", what);
+    failed = TRUE;
+
+    if (daemon_pid != (pid_t) -1)
+        kill(daemon_pid, SIGTERM);
+
+    if (!log_event)
+        api->quit(api, 1);
+}
+
+static void parse_line(const char *l) {
+    unsigned i;
+
+    pa_log_debug("daemon: %s", l);
+
+    for (i = 0; i < PA_ELEMENTSOF(phase_messages); i++) {
+        const char *p, *in, *e;
+        char *end;
+        double msec;
+
+        if (!(p = strstr(l, phase_messages[i].prefix)))
+            continue;
+
+        p += strlen(phase_messages[i].prefix);
+
+        /* The last " in ", names may contain that too */
+        for (in = NULL, e = p; (e = strstr(e, " in ")); e++)
+            in = e;
+
+        if (!in)
+            continue;
+
+        msec = strtod(in + 4, &end);
+        if (end == in + 4 || !pa_streq(end, " ms."))
+            continue;
+
+        if (n_phases >= MAX_PHASES)
+            return;
+
+        /* Module names are quoted, followed by the index and argument */
+        if (phase_messages[i].prefix[strlen(phase_messages[i].prefix) - 1] == '"' && (e = strchr(p, '"')) && e < in)
+            in = e;
+
+        phases[n_phases].kind = phase_messages[i].kind;
+        phases[n_phases].name = pa_xstrndup(p, (size_t) (in - p));
+        phases[n_phases].msec = msec;
+        n_phases++;
+
+        return;
+    }
+}
+
+static void log_cb(pa_mainloop_api *a, pa_io_event *e, int fd, pa_io_event_flags_t events, void *userdata) {
+    ssize_t r;
+    char *nl;
+
+    if ((r = read(fd, line + line_length, sizeof(line) - 1 - line_length)) < 0) {
+        if (errno == EAGAIN || errno == EINTR)
+            return;
+    }
+
+    if (r <= 0) {
+        /* The daemon is gone */
+        a->io_free(log_event);
+        log_event = NULL;
+        a->quit(a, failed ? 1 : 0);
+        return;
+    }
+
+    line_length += (size_t) r;
+    line[line_length] = 0;
+
+    while ((nl = strchr(line, '\n'))) {
+        *nl = 0;
+        parse_line(line);
+
+        line_length -= (size_t) (nl + 1 - line);
+        memmove(line, nl + 1, line_length + 1);
+    }
+
+    /* Overlong lines are cut */
+    if (line_length >= sizeof(line) - 1) {
+        parse_line(line);
+        line_length = 0;
+    }
+}
+
+static void stream_write_cb(pa_stream *s, size_t nbytes, void *userdata) {
+    static const uint8_t zero[4096];
+
+    while (nbytes > 0) {
+        size_t n = PA_MIN(nbytes, sizeof(zero));
+
+        if (pa_stream_write(s, zero, n, NULL, 0, PA_SEEK_RELATIVE) < 0) {
+            fail("pa_stream_write() failed.");
+            return;
+        }
+
+        nbytes -= n;
+    }
+}
+
+static void stream_started_cb(pa_stream *s, void *userdata) {
+
+    if (t_played > 0)
+        return;
+
+    t_played = pa_rtclock_now();
+
+    /* Everything the daemon logged until now is collected when it exits */
+    pa_stream_disconnect(stream);
+    pa_context_disconnect(context);
+    kill(daemon_pid, SIGTERM);
+}
+
+static void stream_state_cb(pa_stream *s, void *userdata) {
+
+    if (pa_stream_get_state(s) == PA_STREAM_FAILED)
+        fail("Stream failed.");
+}
+
+static void context_state_cb(pa_context *c, void *userdata) {
+
+    switch (pa_context_get_state(c)) {
+
+        case PA_CONTEXT_READY:
+            t_context = pa_rtclock_now();
+
+            pa_assert_se(stream = pa_stream_new(c, "startup-bench", &sample_spec, NULL));
+            pa_stream_set_state_callback(stream, stream_state_cb, NULL);
+            pa_stream_set_write_callback(stream, stream_write_cb, NULL);
+            pa_stream_set_started_callback(stream, stream_started_cb, NULL);
+
+            if (pa_stream_connect_playback(stream, NULL, NULL, 0, NULL, NULL) < 0)
+                fail("pa_stream_connect_playback() failed.");
+            break;
+
+        case PA_CONTEXT_FAILED:
+            if (t_played == 0)
+                fail("Connection failed.");
+            break;
+
+        default:
+            ;
+    }
+}
+
+static pa_bool_t socket_ready(void) {
+    struct sockaddr_un sa;
+    int fd;
+    pa_bool_t ready;
+
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+        return FALSE;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    pa_strlcpy(sa.sun_path, socket_path, sizeof(sa.sun_path));
+
+    ready = connect(fd, (struct sockaddr*) &sa, sizeof(sa)) == 0;
+    pa_close(fd);
+
+    return ready;
+}
+
+static void poll_cb(pa_mainloop_api *a, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    struct timeval ntv;
+    char *server;
+
+    if (pa_rtclock_now() - t_start > TIMEOUT_USEC) {
+        fail("Timed out.");
+        return;
+    }
+
+    if (!socket_ready()) {
+        a->time_restart(e, pa_timeval_rtstore(&ntv, pa_rtclock_now() + POLL_USEC, TRUE));
+        return;
+    }
+
+    t_socket = pa_rtclock_now();
+
+    /* From now on only the timeout is left */
+    a->time_restart(e, pa_timeval_rtstore(&ntv, t_start + TIMEOUT_USEC + 1, TRUE));
+
+    pa_assert_se(context = pa_context_new(a, "startup-bench"));
+    pa_context_set_state_callback(context, context_state_cb, NULL);
+
+    server = pa_sprintf_malloc("unix:%s", socket_path);
+    if (pa_context_connect(context, server, PA_CONTEXT_NOAUTOSPAWN, NULL) < 0)
+        fail("pa_context_connect() failed.");
+    pa_xfree(server);
+}
+
+static void start_daemon(int argc, char *argv[], int log_fd) {
+    char **args;
+    int n = 0, i;
+
+    args = pa_xnew0(char*, argc + 7);
+
+    args[n++] = argc > 1 ? argv[1] : (char*) PA_BINARY;
+    args[n++] = (char*) "--daemonize=no";
+    args[n++] = (char*) "--use-pid-file=no";
+    args[n++] = (char*) "--exit-idle-time=-1";
+    args[n++] = (char*) "--log-target=stderr";
+    args[n++] = (char*) "--log-level=debug";
+
+    for (i = 2; i < argc; i++)
+        args[n++] = argv[i];
+
+    t_start = pa_rtclock_now();
+
+    if ((daemon_pid = fork()) == 0) {
+        dup2(log_fd, STDERR_FILENO);
+        setenv("PULSE_RUNTIME_PATH", runtime_dir, 1);
+
+        execvp(args[0], args);
+        fprintf(stderr, "Failed to execute %s: %s\n", args[0], strerror(errno));
+        _exit(1);
+    }
+
+    pa_assert_se(daemon_pid > 0);
+    pa_xfree(args);
+}
+
+static void print_json_string(const char *s) {
+    putchar('"');
+
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            printf("\\%c", *s);
+        else if ((unsigned char) *s < 0x20)
+            printf("\\u%04x", (unsigned) (unsigned char) *s);
+        else
+            putchar(*s);
+    }
+
+    putchar('"');
+}
+
+static void print_result(void) {
+    unsigned i;
+
+    printf("{\"socket_ready_ms\":%0.1f,\"context_ready_ms\":%0.1f,\"first_sample_ms\":%0.1f,\"phases\":[",
+           (double) (t_socket - t_start) / PA_USEC_PER_MSEC,
+           (double) (t_context - t_start) / PA_USEC_PER_MSEC,
+           (double) (t_played - t_start) / PA_USEC_PER_MSEC);
+
+    for (i = 0; i < n_phases; i++) {
+        printf("%s\n{\"kind\":\"%s\",\"name\":", i > 0 ? "," : "", phases[i].kind);
+        print_json_string(phases[i].name);
+        printf(",\"ms\":%0.1f}", phases[i].msec);
+    }
+
+    printf("]}\n");
+}
+
+static void remove_runtime_dir(void) {
+    DIR *d;
+    struct dirent *de;
+
+    if ((d = opendir(runtime_dir))) {
+        while ((de = readdir(d))) {
+            char *fn;
+
+            if (pa_streq(de->d_name, ".") || pa_streq(de->d_name, ".."))
+                continue;
+
+            fn = pa_sprintf_malloc("%s/%s", runtime_dir, de->d_name);
+            unlink(fn);
+            pa_xfree(fn);
+        }
+
+        closedir(d);
+    }
+
+    rmdir(runtime_dir);
+}
+
+int main(int argc, char *argv[]) {
+    pa_mainloop *m;
+    struct timeval tv;
+    char template[] = "/tmp/startup-bench-XXXXXX";
+    int fds[2], retval = 1, status;
+    unsigned i;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    pa_assert_se(runtime_dir = mkdtemp(template));
+    socket_path = pa_sprintf_malloc("%s/native", runtime_dir);
+
+    pa_assert_se(pipe(fds) == 0);
+    pa_make_fd_cloexec(fds[0]);
+
+    pa_assert_se(m = pa_mainloop_new());
+    api = pa_mainloop_get_api(m);
+
+    start_daemon(argc, argv, fds[1]);
+    pa_close(fds[1]);
+
+    pa_make_fd_nonblock(fds[0]);
+    pa_assert_se(log_event = api->io_new(api, fds[0], PA_IO_EVENT_INPUT|PA_IO_EVENT_HANGUP, log_cb, NULL));
+    pa_assert_se(poll_event = api->time_new(api, pa_timeval_rtstore(&tv, t_start + POLL_USEC, TRUE), poll_cb, NULL));
+
+    pa_mainloop_run(m, &retval);
+
+    if (stream)
+        pa_stream_unref(stream);
+    if (context)
+        pa_context_unref(context);
+    if (log_event)
+        api->io_free(log_event);
+    api->time_free(poll_event);
+    pa_mainloop_free(m);
+
+    pa_close(fds[0]);
+
+    if (daemon_pid != (pid_t) -1) {
+        kill(daemon_pid, SIGTERM);
+        waitpid(daemon_pid, &status, 0);
+    }
+
+    if (retval == 0 && t_played > 0)
+        print_result();
+    else
+        retval = 1;
+
+    for (i = 0; i < n_phases; i++)
+        pa_xfree(phases[i].name);
+
+    remove_runtime_dir();
+    pa_xfree(socket_path);
+
+    return retval;
+}
@@ -0,0 +1,77 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/strbuf.h>
+
+int main(int argc, char *argv[]) {
+    pa_strbuf *sb;
+    char *t, *big;
+    unsigned i;
+
+    sb = pa_strbuf_new();
+    pa_assert_se(pa_strbuf_isempty(sb));
+    pa_assert_se(pa_streq(pa_strbuf_peek(sb), ""));
+
+    pa_strbuf_puts(sb, "abc");
+    pa_strbuf_putc(sb, '-');
+    pa_strbuf_putsn(sb, "defxyz", 3);
+    pa_assert_se(pa_strbuf_printf(sb, "%u:%s", 42, "x") == 4);
+    pa_assert_se(pa_streq(pa_strbuf_peek(sb), "abc-def42:x"));
+    pa_assert_se(pa_strbuf_length(sb) == 11);
+
+    /* Larger than what is left in the buffer */
+    big = pa_xmalloc(1001);
+    memset(big, 'b', 1000);
+    big[1000] = 0;
+    pa_assert_se(pa_strbuf_printf(sb, "<%s>", big) == 1002);
+    pa_assert_se(pa_strbuf_length(sb) == 1013);
+
+    t = pa_strbuf_tostring(sb);
+    pa_assert_se(strlen(t) == 1013);
+    pa_assert_se(strncmp(t, "abc-def42:x<b", 13) == 0);
+    pa_assert_se(pa_streq(t + 1011, "b>"));
+    pa_xfree(t);
+
+    pa_strbuf_reset(sb);
+    pa_assert_se(pa_strbuf_isempty(sb));
+    pa_assert_se(pa_streq(pa_strbuf_peek(sb), ""));
+
+    for (i = 0; i < 10000; i++)
+        pa_strbuf_printf(sb, "%u\n", i % 10);
+
+    t = pa_strbuf_tostring_free(sb);
+    pa_assert_se(strlen(t) == 20000);
+    pa_assert_se(pa_streq(t + 19996, "8\n9\n"));
+    pa_xfree(t);
+
+    pa_xfree(big);
+
+    return 0;
+}
@@ -0,0 +1,291 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+
+#include <pulse/pulseaudio.h>
+#include <pulse/mainloop.h>
+#include <pulse/rtclock.h>
+
+#include <pulsecore/core-rtclock.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+/* Creates playback streams on a running daemon one after the other and
+ * measures how long each takes from the connect call until the stream
+ * is ready, i.e. one round trip plus everything the daemon does in
+ * command_create_playback_stream(). The stream is deleted again before
+ * the next one is created. A role may be given to exercise the policy
+ * modules that look at it.
+ *
+ * A line of JSON with percentiles of the creation times is written to
+ * STDOUT. Running the daemon with debug logging shows how the time is
+ * split up between the hooks and the resampler.
+ *
+ * Usage: stream-create-bench [--iterations N] [--role ROLE]
+ *                            [--latency-msec N] */
+
+#define TIMEOUT_USEC (30 * PA_USEC_PER_SEC)
+
+static const pa_sample_spec sample_spec = { PA_SAMPLE_S16LE, 44100, 2 };
+
+static pa_mainloop_api *api = NULL;
+static pa_context *context = NULL;
+static pa_stream *stream = NULL;
+static pa_time_event *timeout_event = NULL;
+
+static unsigned iterations = 200, latency_msec = 50;
+static char *role = NULL;
+
+static unsigned n_created, n_failed;
+static pa_usec_t *latencies = NULL, started;
+
+static void fail(const char *what) {
+    pa_log("%s: %s", what, pa_strerror(pa_context_errno(context)));
+    api->quit(api, 1);
+}
+
+static int latency_compare(const void *a, const void *b) {
+    pa_usec_t x = *(const pa_usec_t*) a, y = *(const pa_usec_t*) b;
+
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static double percentile_msec(unsigned p) {
+    if (n_created == 0)
+        return 0;
+
+    return (double) latencies[PA_MIN((n_created * p) / 100, n_created - 1)] / PA_USEC_PER_MSEC;
+}
+
+static void print_result(void) {
+    qsort(latencies, n_created, sizeof(pa_usec_t), latency_compare);
+
+    printf("{\"streams\":%u,\"failed\":%u,"
+           "\"create_ms\":{\"p50\":%0.3f,\"p90\":%0.3f,\"p99\":%0.3f,\"max\":%0.3f}}\n",
+           n_created, n_failed,
+           percentile_msec(50), percentile_msec(90), percentile_msec(99),
+           n_created > 0 ? (double) latencies[n_created - 1] / PA_USEC_PER_MSEC : 0.0);
+
+    fflush(stdout);
+}
+
+static void create_stream(void);
+
+static void stream_state_cb(pa_stream *s, void *userdata) {
+    pa_assert(s);
+
+    switch (pa_stream_get_state(s)) {
+
+        case PA_STREAM_READY:
+            latencies[n_created++] = pa_rtclock_now() - started;
+            pa_stream_disconnect(s);
+            break;
+
+        case PA_STREAM_FAILED:
+            n_failed++;
+            /* Fall through */
+
+        case PA_STREAM_TERMINATED:
+            pa_stream_set_state_callback(s, NULL, NULL);
+            pa_stream_unref(s);
+            stream = NULL;
+
+            if (pa_context_get_state(context) != PA_CONTEXT_READY)
+                fail("Stream failed");
+            else if (n_created + n_failed >= iterations) {
+                print_result();
+                api->quit(api, n_created > 0 ? 0 : 1);
+            } else
+                create_stream();
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void create_stream(void) {
+    pa_buffer_attr attr;
+    pa_proplist *p;
+
+    p = pa_proplist_new();
+    if (role)
+        pa_proplist_sets(p, PA_PROP_MEDIA_ROLE, role);
+
+    pa_assert_se(stream = pa_stream_new_with_proplist(context, "stream-create-bench", &sample_spec, NULL, p));
+    pa_proplist_free(p);
+
+    pa_stream_set_state_callback(stream, stream_state_cb, NULL);
+
+    memset(&attr, 0, sizeof(attr));
+    attr.maxlength = (uint32_t) -1;
+    attr.tlength = (uint32_t) pa_usec_to_bytes(latency_msec * PA_USEC_PER_MSEC, &sample_spec);
+    attr.prebuf = (uint32_t) -1;
+    attr.minreq = (uint32_t) -1;
+    attr.fragsize = (uint32_t) -1;
+
+    /* Corked, so no data has to be written */
+    started = pa_rtclock_now();
+    if (pa_stream_connect_playback(stream, NULL, &attr, PA_STREAM_START_CORKED|PA_STREAM_ADJUST_LATENCY, NULL, NULL) < 0)
+        fail("pa_stream_connect_playback() failed");
+}
+
+static void context_state_cb(pa_context *c, void *userdata) {
+    pa_assert(c);
+
+    switch (pa_context_get_state(c)) {
+
+        case PA_CONTEXT_READY:
+            api->time_free(timeout_event);
+            timeout_event = NULL;
+            create_stream();
+            break;
+
+        case PA_CONTEXT_FAILED:
+            fail("Connection failed");
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void timeout_cb(pa_mainloop_api *a, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    pa_log("Connecting: timeout");
+    api->quit(api, 1);
+}
+
+static void help(const char *argv0) {
+    printf("%s [options]\n\n"
+           "-h, --help                Show this help\n"
+           "    --iterations=N        Number of streams to create (default %u)\n"
+           "    --role=ROLE           Media role of the streams\n"
+           "    --latency-msec=N      Buffer size the streams ask for (default %u)\n",
+           argv0, iterations, latency_msec);
+}
+
+enum {
+    ARG_ITERATIONS = 256,
+    ARG_ROLE,
+    ARG_LATENCY_MSEC
+};
+
+static int parse_unsigned(const char *s, unsigned *ret) {
+    uint32_t u;
+
+    if (pa_atou(s, &u) < 0 || u == 0) {
+        pa_log("Invalid number: %s", s);
+        return -1;
+    }
+
+    *ret = u;
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    static const struct option long_options[] = {
+        {"help",         0, NULL, 'h'},
+        {"iterations",   1, NULL, ARG_ITERATIONS},
+        {"role",         1, NULL, ARG_ROLE},
+        {"latency-msec", 1, NULL, ARG_LATENCY_MSEC},
+        {NULL,           0, NULL, 0}
+    };
+
+    pa_mainloop *m;
+    struct timeval tv;
+    int c, ret = 1;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_INFO);
+    else
+        iterations = 20;
+
+    while ((c = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+
+        switch (c) {
+            case 'h':
+                help(argv[0]);
+                return 0;
+
+            case ARG_ITERATIONS:
+                if (parse_unsigned(optarg, &iterations) < 0)
+                    return 1;
+                break;
+
+            case ARG_ROLE:
+                pa_xfree(role);
+                role = pa_xstrdup(optarg);
+                break;
+
+            case ARG_LATENCY_MSEC:
+                if (parse_unsigned(optarg, &latency_msec) < 0)
+                    return 1;
+                break;
+
+            default:
+                help(argv[0]);
+                return 1;
+        }
+    }
+
+    latencies = pa_xnew(pa_usec_t, iterations);
+
+    pa_assert_se(m = pa_mainloop_new());
+    api = pa_mainloop_get_api(m);
+
+    pa_assert_se(timeout_event = api->time_new(api, pa_timeval_rtstore(&tv, pa_rtclock_now() + TIMEOUT_USEC, TRUE), timeout_cb, NULL));
+
+    pa_assert_se(context = pa_context_new(api, "stream-create-bench"));
+    pa_context_set_state_callback(context, context_state_cb, NULL);
+
+    if (pa_context_connect(context, NULL, 0, NULL) < 0)
+        fail("pa_context_connect() failed");
+    else
+        pa_mainloop_run(m, &ret);
+
+    if (stream) {
+        pa_stream_set_state_callback(stream, NULL, NULL);
+        pa_stream_disconnect(stream);
+        pa_stream_unref(stream);
+    }
+
+    if (context) {
+        pa_context_disconnect(context);
+        pa_context_unref(context);
+    }
+
+    if (timeout_event)
+        api->time_free(timeout_event);
+
+    pa_mainloop_free(m);
+
+    pa_xfree(latencies);
+    pa_xfree(role);
+
+    return ret;
+}
@@ -0,0 +1,167 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/stream-ring.h>
+#include <pulsecore/thread.h>
+
+/* Streams a counting byte pattern from a writer thread through a ring
+ * whose blocks were exchanged between two pools like a client and the
+ * server do it, and checks that the reader gets it back in order. */
+
+#define TOTAL (4*1024*1024)
+#define LIMIT 3000
+
+static pa_stream_ring *writer, *reader;
+
+static void release_cb(pa_memimport *i, uint32_t block_id, void *userdata) {
+}
+
+static void revoke_cb(pa_memexport *e, uint32_t block_id, void *userdata) {
+}
+
+/* Hands the block of one side over to the other through SHM */
+static pa_memblock* transfer(pa_memexport *e, pa_memimport *i, pa_stream_ring *from, pa_memchunk *chunk) {
+    uint32_t id, shm_id;
+    size_t offset, size;
+    int memfd;
+    pa_memblock *b;
+
+    pa_stream_ring_get_chunk(from, chunk);
+    pa_assert_se(pa_memexport_put(e, chunk->memblock, &id, &shm_id, &offset, &size, &memfd) >= 0);
+    pa_assert_se(b = pa_memimport_get(i, id, shm_id, offset, size));
+
+    chunk->memblock = b;
+    chunk->index = 0;
+    chunk->length = size;
+
+    return b;
+}
+
+static void write_thread(void *userdata) {
+    uint8_t buf[1000];
+    unsigned next = 0;
+
+    while (next < TOTAL) {
+        size_t n, k;
+
+        n = PA_MIN(1 + (size_t) (rand() % sizeof(buf)), TOTAL - next);
+        for (k = 0; k < n; k++)
+            buf[k] = (uint8_t) (next + k);
+
+        n = pa_stream_ring_write(writer, buf, n);
+        pa_assert_se(n <= LIMIT);
+        next += (unsigned) n;
+
+        if (n == 0)
+            pa_thread_yield();
+    }
+}
+
+int main(int argc, char *argv[]) {
+    pa_mempool *client_pool, *server_pool;
+    pa_memexport *client_export, *server_export;
+    pa_memimport *client_import, *server_import;
+    pa_memblock *data_block, *index_block;
+    pa_memchunk chunk;
+    pa_thread *t;
+    size_t capacity;
+    unsigned next = 0;
+    uint8_t buf[777];
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    pa_assert_se(client_pool = pa_mempool_new(TRUE, 0));
+    pa_assert_se(server_pool = pa_mempool_new(TRUE, 0));
+    pa_assert_se(client_export = pa_memexport_new(client_pool, revoke_cb, NULL));
+    pa_assert_se(server_export = pa_memexport_new(server_pool, revoke_cb, NULL));
+    pa_assert_se(client_import = pa_memimport_new(client_pool, release_cb, NULL));
+    pa_assert_se(server_import = pa_memimport_new(server_pool, release_cb, NULL));
+
+    capacity = pa_stream_ring_capacity(client_pool, LIMIT);
+    pa_assert_se(capacity == 4096);
+    pa_assert_se(pa_stream_ring_capacity(client_pool, 1024*1024*1024) < pa_mempool_block_size_max(client_pool));
+
+    writer = pa_stream_ring_new_writer(client_pool, capacity, LIMIT);
+    reader = pa_stream_ring_new_reader(server_pool);
+
+    /* Local blocks are refused */
+    pa_stream_ring_get_chunk(writer, &chunk);
+    pa_assert_se(pa_stream_ring_attach(reader, &chunk) < 0);
+
+    /* Before the index block arrives the writer can fill up to the
+     * limit already */
+    pa_assert_se(pa_stream_ring_writable(writer) == LIMIT);
+    pa_assert_se(pa_stream_ring_readable(reader) == 0);
+
+    data_block = transfer(client_export, server_import, writer, &chunk);
+    pa_assert_se(pa_stream_ring_attach(reader, &chunk) >= 0);
+    pa_assert_se(pa_stream_ring_attach(reader, &chunk) < 0);
+    pa_memblock_unref(data_block);
+
+    index_block = transfer(server_export, client_import, reader, &chunk);
+    pa_assert_se(pa_stream_ring_attach(writer, &chunk) >= 0);
+    pa_memblock_unref(index_block);
+
+    pa_assert_se(t = pa_thread_new("stream-ring-test", write_thread, NULL));
+
+    while (next < TOTAL) {
+        size_t n, k;
+
+        if (rand() % 16 == 0)
+            pa_assert_se(pa_stream_ring_readable(reader) <= LIMIT);
+
+        n = pa_stream_ring_read(reader, buf, 1 + (size_t) (rand() % sizeof(buf)));
+        for (k = 0; k < n; k++, next++)
+            pa_assert_se(buf[k] == (uint8_t) next);
+
+        if (n == 0)
+            pa_thread_yield();
+    }
+
+    pa_thread_free(t);
+
+    pa_assert_se(pa_stream_ring_readable(reader) == 0);
+    pa_assert_se(pa_stream_ring_writable(writer) == LIMIT);
+
+    pa_assert_se(pa_stream_ring_write(writer, buf, 500) == 500);
+    pa_assert_se(pa_stream_ring_skip(reader) == 500);
+    pa_assert_se(pa_stream_ring_writable(writer) == LIMIT);
+
+    pa_stream_ring_free(writer);
+    pa_stream_ring_free(reader);
+
+    pa_memimport_free(client_import);
+    pa_memimport_free(server_import);
+    pa_memexport_free(client_export);
+    pa_memexport_free(server_export);
+    pa_mempool_free(client_pool);
+    pa_mempool_free(server_pool);
+
+    return 0;
+}
@@ -0,0 +1,168 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include <pulse/xmalloc.h>
+#include <pulse/proplist.h>
+
+#include <pulsecore/tagstruct.h>
+#include <pulsecore/packet.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/macro.h>
+
+/* Writes n entries, which for large n outgrows the buffer appended to
+ * the tagstruct, and reads them back from a copy of the data */
+static void check(unsigned n) {
+    pa_tagstruct *t;
+    pa_proplist *p, *q;
+    const uint8_t *data;
+    uint8_t *copy;
+    size_t length;
+    unsigned i;
+
+    t = pa_tagstruct_new(NULL, 0);
+    p = pa_proplist_new();
+
+    for (i = 0; i < n; i++) {
+        char k[32], v[32];
+
+        pa_snprintf(k, sizeof(k), "test.key%u", i);
+        pa_snprintf(v, sizeof(v), "value %u", i * 7);
+        pa_proplist_sets(p, k, v);
+
+        pa_tagstruct_putu32(t, i);
+        pa_tagstruct_puts(t, v);
+    }
+
+    pa_tagstruct_puts(t, NULL);
+    pa_tagstruct_put_proplist(t, p);
+
+    pa_assert_se(data = pa_tagstruct_data(t, &length));
+    copy = pa_xmemdup(data, length);
+    pa_tagstruct_free(t);
+
+    t = pa_tagstruct_new(copy, length);
+
+    for (i = 0; i < n; i++) {
+        char v[32];
+        uint32_t u;
+        const char *s;
+
+        pa_snprintf(v, sizeof(v), "value %u", i * 7);
+
+        pa_assert_se(pa_tagstruct_getu32(t, &u) == 0 && u == i);
+        pa_assert_se(pa_tagstruct_gets(t, &s) == 0 && pa_streq(s, v));
+
+        /* Strings are not copied */
+        pa_assert_se((const uint8_t*) s > copy && (const uint8_t*) s < copy + length);
+    }
+
+    {
+        const char *s;
+        pa_assert_se(pa_tagstruct_gets(t, &s) == 0 && !s);
+    }
+
+    q = pa_proplist_new();
+    pa_assert_se(pa_tagstruct_get_proplist(t, q) == 0);
+    pa_assert_se(pa_proplist_equal(p, q));
+    pa_assert_se(pa_tagstruct_eof(t));
+
+    /* A truncated tagstruct fails to parse without reading beyond */
+    pa_tagstruct_free(t);
+    t = pa_tagstruct_new(copy, length - 1);
+
+    for (i = 0; i < n; i++) {
+        uint32_t u;
+        const char *s;
+
+        pa_assert_se(pa_tagstruct_getu32(t, &u) == 0);
+        pa_assert_se(pa_tagstruct_gets(t, &s) == 0);
+    }
+
+    {
+        const char *s;
+        pa_assert_se(pa_tagstruct_gets(t, &s) == 0 && !s);
+    }
+
+    pa_proplist_clear(q);
+    pa_assert_se(pa_tagstruct_get_proplist(t, q) < 0);
+
+    pa_tagstruct_free(t);
+    pa_xfree(copy);
+    pa_proplist_free(p);
+    pa_proplist_free(q);
+}
+
+int main(int argc, char *argv[]) {
+    unsigned n;
+
+    for (n = 0; n < 2000; n = n * 2 + 1)
+        check(n);
+
+    /* Handing over the data works for both small and big tagstructs */
+    for (n = 1; n < 2000; n *= 10) {
+        pa_tagstruct *t;
+        uint8_t *d;
+        size_t l;
+        unsigned i;
+
+        t = pa_tagstruct_new(NULL, 0);
+        for (i = 0; i < n; i++)
+            pa_tagstruct_putu32(t, i);
+
+        pa_assert_se(d = pa_tagstruct_free_data(t, &l));
+        pa_assert_se(l == n * 5);
+        pa_packet_unref(pa_packet_new_dynamic(d, l));
+    }
+
+    /* Up to the biggest pooled packet the data is built in the packet
+     * it is sent in, beyond that it is handed over */
+    for (n = 1; n < 20000; n = n * 3 + 1) {
+        pa_tagstruct *t;
+        pa_packet *p;
+        unsigned i;
+
+        t = pa_tagstruct_new(NULL, 0);
+        for (i = 0; i < n; i++)
+            pa_tagstruct_putu32(t, i);
+
+        pa_assert_se(p = pa_tagstruct_free_packet(t));
+        pa_assert_se(p->length == n * 5);
+        pa_assert_se(p->type == (p->length <= PA_PACKET_POOLED_MAX ? PA_PACKET_APPENDED : PA_PACKET_DYNAMIC));
+        pa_assert_se(p->allocated >= (p->type == PA_PACKET_APPENDED ? p->length : 0));
+
+        t = pa_tagstruct_new(p->data, p->length);
+        for (i = 0; i < n; i++) {
+            uint32_t u;
+            pa_assert_se(pa_tagstruct_getu32(t, &u) == 0 && u == i);
+        }
+        pa_assert_se(pa_tagstruct_eof(t));
+        pa_tagstruct_free(t);
+
+        pa_packet_unref(p);
+    }
+
+    return 0;
+}
@@ -0,0 +1,131 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pulse/sample.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/sample-util.h>
+#include <pulsecore/sconv.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+/* Runs the ramp kernels over a constant signal, in one go and in two
+ * parts, and compares the result with the gains computed directly */
+
+#define CHANNELS 3
+#define FRAMES 1000
+#define SPLIT 337
+
+static const pa_sample_format_t formats[] = {
+    PA_SAMPLE_S16NE,
+    PA_SAMPLE_S16RE,
+    PA_SAMPLE_FLOAT32NE,
+    PA_SAMPLE_FLOAT32RE,
+    PA_SAMPLE_S32NE,
+    PA_SAMPLE_S32RE
+};
+
+static void run(pa_do_volume_ramp_func_t ramp, void *samples, size_t fs, const float *start, const float *step, unsigned split) {
+    float gain[CHANNELS];
+    unsigned c;
+
+    memcpy(gain, start, sizeof(gain));
+
+    ramp(samples, gain, step, CHANNELS, split);
+    ramp((uint8_t*) samples + split * fs, gain, step, CHANNELS, FRAMES - split);
+
+    for (c = 0; c < CHANNELS; c++)
+        pa_assert_se(fabsf(gain[c] - (start[c] + step[c] * FRAMES)) < 1e-3f);
+}
+
+static void check_format(pa_sample_format_t f) {
+    pa_sample_spec ss;
+    pa_do_volume_ramp_func_t ramp;
+    pa_convert_func_t from_float, to_float;
+    float input[FRAMES * CHANNELS], output[FRAMES * CHANNELS];
+    float start[CHANNELS] = { 0.0f, 1.0f, 0.5f };
+    float step[CHANNELS] = { 1.0f / FRAMES, -1.0f / FRAMES, 0.5f / FRAMES };
+    void *a, *b;
+    size_t fs;
+    unsigned k, c;
+
+    ss.format = f;
+    ss.rate = 48000;
+    ss.channels = CHANNELS;
+    fs = pa_frame_size(&ss);
+
+    pa_assert_se(ramp = pa_get_volume_ramp_func(f));
+    pa_assert_se(from_float = pa_get_convert_from_float32ne_function(f));
+    pa_assert_se(to_float = pa_get_convert_to_float32ne_function(f));
+
+    for (k = 0; k < FRAMES * CHANNELS; k++)
+        input[k] = k % 2 ? 0.5f : -0.5f;
+
+    a = pa_xmalloc(FRAMES * fs);
+    b = pa_xmalloc(FRAMES * fs);
+    from_float(FRAMES * CHANNELS, input, a);
+    memcpy(b, a, FRAMES * fs);
+
+    run(ramp, a, fs, start, step, FRAMES);
+    run(ramp, b, fs, start, step, SPLIT);
+
+    /* Where the kernel is called from doesn't matter */
+    pa_assert_se(memcmp(a, b, FRAMES * fs) == 0);
+
+    to_float(FRAMES * CHANNELS, a, output);
+
+    for (k = 0; k < FRAMES; k++)
+        for (c = 0; c < CHANNELS; c++) {
+            float expected = input[k * CHANNELS + c] * (start[c] + step[c] * k);
+
+            pa_assert_se(fabsf(output[k * CHANNELS + c] - expected) < 1e-3f);
+        }
+
+    pa_log_debug("%s ok", pa_sample_format_to_string(f));
+
+    pa_xfree(a);
+    pa_xfree(b);
+}
+
+int main(int argc, char *argv[]) {
+    unsigned k;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    for (k = 0; k < PA_ELEMENTSOF(formats); k++)
+        check_format(formats[k]);
+
+    /* Formats without a kernel are rewound for instead */
+    pa_assert_se(!pa_get_volume_ramp_func(PA_SAMPLE_U8));
+    pa_assert_se(!pa_get_volume_ramp_func(PA_SAMPLE_S24NE));
+    pa_assert_se(!pa_get_volume_ramp_func(PA_SAMPLE_S24RE));
+    pa_assert_se(!pa_get_volume_ramp_func(PA_SAMPLE_S24_32NE));
+    pa_assert_se(!pa_get_volume_ramp_func(PA_SAMPLE_S24_32RE));
+
+    return 0;
+}
@@ -22,12 +22,216 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
 #include <pulse/volume.h>
+#include <pulse/xmalloc.h>
 
+#include <pulsecore/cpu-arm.h>
+#include <pulsecore/cpu-x86.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/random.h>
+#include <pulsecore/sample-util.h>
+
+/* Checks every optimized software volume function against the C
+ * version, and reports how many samples per second each one does.
+ * The same for the channel vector operations against the functions
+ * for single volumes. */
+
+#define N_SAMPLES (4096 * 3)
+#define N_PADDING 32
+
+static const pa_sample_format_t volume_formats[] = {
+    PA_SAMPLE_S16NE,
+    PA_SAMPLE_S16RE,
+    PA_SAMPLE_S24NE,
+    PA_SAMPLE_S24_32NE,
+    PA_SAMPLE_S32NE,
+    PA_SAMPLE_FLOAT32NE
+};
+
+static pa_do_volume_func_t c_volume_funcs[PA_ELEMENTSOF(volume_formats)];
+
+static void reset_volume_funcs(void) {
+    unsigned i;
+
+    for (i = 0; i < PA_ELEMENTSOF(volume_formats); i++)
+        pa_set_volume_func(volume_formats[i], c_volume_funcs[i]);
+}
+
+static void fill_volumes(pa_sample_format_t f, void *volumes, unsigned channels, pa_volume_t max) {
+    unsigned c;
+
+    for (c = 0; c < channels + N_PADDING; c++) {
+        pa_volume_t v = c < channels ? (pa_volume_t) (rand() % max) : PA_VOLUME_MUTED;
+
+        if (f == PA_SAMPLE_FLOAT32NE)
+            ((float*) volumes)[c] = c < channels ? (float) pa_sw_volume_to_linear(v) : ((float*) volumes)[c - channels];
+        else
+            ((int32_t*) volumes)[c] = c < channels ? (int32_t) lrint(pa_sw_volume_to_linear(v) * 0x10000) : ((int32_t*) volumes)[c - channels];
+    }
+}
+
+static void check_volume_funcs(const char *name) {
+    unsigned i, channels;
+    void *orig, *ref, *samples;
+    union {
+        int32_t i[PA_CHANNELS_MAX + N_PADDING];
+        float f[PA_CHANNELS_MAX + N_PADDING];
+    } volumes;
+
+    orig = pa_xmalloc(N_SAMPLES * 4);
+    ref = pa_xmalloc(N_SAMPLES * 4);
+    samples = pa_xmalloc(N_SAMPLES * 4);
+
+    for (i = 0; i < PA_ELEMENTSOF(volume_formats); i++) {
+        pa_sample_format_t f = volume_formats[i];
+        pa_do_volume_func_t func = pa_get_volume_func(f);
+        size_t length = N_SAMPLES * pa_sample_size_of_format(f);
+        unsigned j, rounds = getenv("MAKE_CHECK") ? 10 : 1000;
+        pa_usec_t t;
+
+        if (func == c_volume_funcs[i] && strcmp(name, "C") != 0)
+            continue;
+
+        if (f == PA_SAMPLE_FLOAT32NE) {
+            for (j = 0; j < N_SAMPLES; j++)
+                ((float*) orig)[j] = (float) (rand() - RAND_MAX / 2) / (RAND_MAX / 2);
+        } else
+            pa_random(orig, length);
+
+        /* Every channel count from 1 to 8 and some odd lengths, with
+         * volumes up to +30dB to check the clamping */
+        for (channels = 1; channels <= 8; channels++) {
+            size_t l = length - (channels - 1) * pa_sample_size_of_format(f) * channels;
+
+            fill_volumes(f, &volumes, channels, PA_VOLUME_NORM * 2);
+
+            memcpy(ref, orig, l);
+            c_volume_funcs[i](ref, &volumes, channels, (unsigned) l);
+            memcpy(samples, orig, l);
+            func(samples, &volumes, channels, (unsigned) l);
+
+            pa_assert_se(memcmp(ref, samples, l) == 0);
+        }
+
+        fill_volumes(f, &volumes, 2, PA_VOLUME_NORM);
+
+        t = pa_rtclock_now();
+        for (j = 0; j < rounds; j++)
+            func(samples, &volumes, 2, (unsigned) length);
+        t = pa_rtclock_now() - t;
+
+        pa_log_info("%-5s %-10s %10.0f samples/s", name, pa_sample_format_to_string(f), (double) N_SAMPLES * rounds * PA_USEC_PER_SEC / PA_MAX(t, 1U));
+    }
+
+    pa_xfree(orig);
+    pa_xfree(ref);
+    pa_xfree(samples);
+}
+
+static void run_volume_funcs(void) {
+    unsigned i;
+
+    for (i = 0; i < PA_ELEMENTSOF(volume_formats); i++)
+        c_volume_funcs[i] = pa_get_volume_func(volume_formats[i]);
+
+    check_volume_funcs("C");
+
+#if defined (__i386__) || defined (__amd64__)
+    {
+        pa_cpu_x86_flag_t flags = 0;
+
+        pa_cpu_init_x86(&flags);
+
+        reset_volume_funcs();
+        pa_volume_func_init_mmx(flags);
+        check_volume_funcs("MMX");
+
+        reset_volume_funcs();
+        pa_volume_func_init_sse(flags);
+        check_volume_funcs("SSE2");
+
+        reset_volume_funcs();
+        pa_volume_func_init_avx(flags);
+        check_volume_funcs("AVX2");
+    }
+#endif
+
+#if defined (__arm__)
+    {
+        pa_cpu_arm_flag_t flags = 0;
+
+        pa_cpu_init_arm(&flags);
+
+        reset_volume_funcs();
+        pa_volume_func_init_arm(flags);
+        check_volume_funcs("ARMv6");
+
+        reset_volume_funcs();
+        pa_volume_func_init_neon(flags);
+        check_volume_funcs("NEON");
+    }
+#endif
+
+    reset_volume_funcs();
+}
+
+static void random_cvolume(pa_cvolume *v, unsigned channels) {
+    unsigned c;
+
+    v->channels = (uint8_t) channels;
+
+    /* Some muted channels, and up to +30 dB */
+    for (c = 0; c < channels; c++)
+        v->values[c] = rand() % 8 == 0 ? PA_VOLUME_MUTED : (pa_volume_t) (rand() % (PA_VOLUME_NORM * 3));
+}
+
+static void check_cvolume_math(void) {
+    pa_cvolume a, b, r;
+    unsigned i, c, rounds = getenv("MAKE_CHECK") ? 1000 : 1000000;
+    pa_usec_t t;
+
+    for (i = 0; i < 10000; i++) {
+        unsigned channels = 1 + (unsigned) rand() % PA_CHANNELS_MAX;
+
+        random_cvolume(&a, channels);
+        random_cvolume(&b, channels);
+
+        pa_assert_se(pa_sw_cvolume_multiply(&r, &a, &b) == &r);
+        for (c = 0; c < channels; c++)
+            pa_assert_se(r.values[c] == pa_sw_volume_multiply(a.values[c], b.values[c]));
+
+        pa_assert_se(pa_sw_cvolume_divide(&r, &a, &b) == &r);
+        for (c = 0; c < channels; c++)
+            pa_assert_se(r.values[c] == pa_sw_volume_divide(a.values[c], b.values[c]));
+
+        pa_assert_se(pa_sw_cvolume_multiply_scalar(&r, &a, b.values[0]) == &r);
+        for (c = 0; c < channels; c++)
+            pa_assert_se(r.values[c] == pa_sw_volume_multiply(a.values[c], b.values[0]));
+
+        pa_assert_se(pa_sw_cvolume_divide_scalar(&r, &a, b.values[0]) == &r);
+        for (c = 0; c < channels; c++)
+            pa_assert_se(r.values[c] == pa_sw_volume_divide(a.values[c], b.values[0]));
+    }
+
+    random_cvolume(&a, 8);
+    random_cvolume(&b, 8);
+
+    t = pa_rtclock_now();
+    for (i = 0; i < rounds; i++) {
+        pa_sw_cvolume_multiply(&r, &a, &b);
+        pa_sw_cvolume_divide(&a, &r, &b);
+    }
+    t = pa_rtclock_now() - t;
+
+    pa_log_info("8 channel multiply and divide: %0.1f ns", (double) t * 1000 / rounds);
+}
 
 int main(int argc, char *argv[]) {
     pa_volume_t v;
@@ -40,6 +244,9 @@ int main(int argc, char *argv[]) {
     if (!getenv("MAKE_CHECK"))
         pa_log_set_level(PA_LOG_DEBUG);
 
+    run_volume_funcs();
+    check_cvolume_math();
+
     pa_log("Attenuation of sample 1 against 32767: %g dB", 20.0*log10(1.0/32767.0));
     pa_log("Smallest possible attenuation > 0 applied to 32767: %li", lrint(32767.0*pa_sw_volume_to_linear(1)));
 
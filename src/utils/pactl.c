@@ -38,10 +38,13 @@
 #include <pulse/pulseaudio.h>
 #include <pulse/ext-device-restore.h>
 #include <pulse/ext-node-manager.h>
+#include <pulse/ext-latency-histograms.h>
+#include <pulse/ext-stats.h>
 
 #include <pulsecore/i18n.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/llist.h>
 #include <pulsecore/log.h>
 #include <pulsecore/sndfile-util.h>
 
@@ -94,6 +97,39 @@ static uint32_t src_node_id;
 static uint32_t dst_node_id;
 static uint32_t conn_id;
 
+/* A command read in batch mode. The results are printed in the order
+ * of the lines, whatever order the replies come in. */
+struct batch_command {
+    unsigned line;
+    pa_bool_t done;
+    char *error;        /* Set if it failed */
+    uint32_t index;     /* Printed when done, for load-module */
+
+    /* For relative volume changes, which read the volume first */
+    pa_volume_t volume;
+    enum volume_flags volume_flags;
+
+    PA_LLIST_FIELDS(struct batch_command);
+};
+
+/* How many commands may wait for their reply at the same time */
+#define BATCH_IN_FLIGHT_MAX 64
+
+/* The longest line accepted */
+#define BATCH_LINE_MAX 4096
+
+static PA_LLIST_HEAD(struct batch_command, batch_head) = NULL;
+static struct batch_command *batch_tail = NULL;
+static pa_io_event *batch_event = NULL;
+static char batch_buffer[BATCH_LINE_MAX];
+static size_t batch_length = 0;
+static unsigned batch_lines = 0, batch_in_flight = 0;
+static pa_bool_t batch_eof = FALSE, batch_failed = FALSE, batch_finished = FALSE;
+
+/* A relative volume change in flight, nothing else is started before
+ * it has set the volume, which would change it underneath */
+static struct batch_command *batch_barrier = NULL;
+
 static enum {
     NONE,
     EXIT,
@@ -123,7 +159,8 @@ static enum {
     SET_SINK_FORMATS,
     SUBSCRIBE,
     NODE_CONNECT,
-    NODE_DISCONNECT
+    NODE_DISCONNECT,
+    BATCH
 } action = NONE;
 
 static void quit(int ret) {
@@ -153,6 +190,8 @@ static void complete_action(void) {
 
 static void stat_callback(pa_context *c, const pa_stat_info *i, void *userdata) {
     char s[PA_BYTES_SNPRINT_MAX];
+    uint32_t j;
+
     if (!i) {
         pa_log(_("Failed to get statistics: %s"), pa_strerror(pa_context_errno(c)));
         quit(1);
@@ -168,9 +207,97 @@ static void stat_callback(pa_context *c, const pa_stat_info *i, void *userdata)
     pa_bytes_snprint(s, sizeof(s), i->scache_size);
     printf(_("Sample cache size: %s\n"), s);
 
+    for (j = 0; j < i->n_flists; j++)
+        printf(_("Free list %s: %llu cache hits, %llu misses\n"), i->flists[j].name,
+               (unsigned long long) i->flists[j].hits, (unsigned long long) i->flists[j].misses);
+
     complete_action();
 }
 
+static void latency_histograms_callback(pa_context *c, const pa_ext_latency_histograms_info *i, int eol, void *userdata) {
+    static const char * const objects[] = {
+        [PA_EXT_LATENCY_HISTOGRAMS_SINK] = "Sink",
+        [PA_EXT_LATENCY_HISTOGRAMS_SOURCE] = "Source",
+        [PA_EXT_LATENCY_HISTOGRAMS_SINK_INPUT] = "Sink Input"
+    };
+    uint32_t j;
+
+    /* Failure just means module-latency-histograms is not loaded */
+    if (eol) {
+        complete_action();
+        return;
+    }
+
+    printf(_("%s #%u %s time:"), objects[i->object], i->index, i->measure);
+
+    for (j = 0; j < i->n_buckets; j++)
+        if (i->buckets[j] > 0) {
+            if (j == 0)
+                printf(" <2us:%u", i->buckets[j]);
+            else if (j + 1 == i->n_buckets)
+                printf(" >=%lluus:%u", 1ULL << j, i->buckets[j]);
+            else
+                printf(" %lluus:%u", 1ULL << j, i->buckets[j]);
+        }
+
+    printf("\n");
+}
+
+static void stats_callback(pa_context *c, const pa_ext_stats_info *i, int eol, void *userdata) {
+    static const char * const objects[] = {
+        [PA_EXT_STATS_SINK] = "Sink",
+        [PA_EXT_STATS_SOURCE] = "Source",
+        [PA_EXT_STATS_SINK_INPUT] = "Sink Input",
+        [PA_EXT_STATS_SOURCE_OUTPUT] = "Source Output"
+    };
+
+    /* Failure just means module-stats is not loaded */
+    if (eol) {
+        complete_action();
+        return;
+    }
+
+    printf(_("%s #%u: busy %uus, resampling %uus (%s), %u rewinds of %u bytes (%u rendered again), %u underruns, %u overruns, "
+             "buffered %0.1fms, watermark %0.1fms, history %u bytes, resampler degraded by %u, CPU %uus\n"),
+           objects[i->object], i->index, i->busy_usec, i->resample_usec, pa_strnull(i->resample_method),
+           i->rewinds, i->rewind_bytes, i->rerender_bytes, i->underruns, i->overruns,
+           (double) i->buffer_usec / PA_USEC_PER_MSEC, (double) i->watermark_usec / PA_USEC_PER_MSEC, i->history_bytes,
+           i->resample_degradation, i->cpu_usec);
+}
+
+static void memory_callback(pa_context *c, const pa_ext_stats_memory_info *i, int eol, void *userdata) {
+    char used[PA_BYTES_SNPRINT_MAX], peak[PA_BYTES_SNPRINT_MAX], budget[PA_BYTES_SNPRINT_MAX];
+
+    /* Failure just means module-stats is not loaded or too old */
+    if (eol) {
+        complete_action();
+        return;
+    }
+
+    pa_bytes_snprint(used, sizeof(used), (unsigned) i->used);
+    pa_bytes_snprint(peak, sizeof(peak), (unsigned) i->peak);
+
+    if (i->budget > 0)
+        pa_bytes_snprint(budget, sizeof(budget), (unsigned) i->budget);
+    else
+        pa_strlcpy(budget, _("none"), sizeof(budget));
+
+    switch (i->object) {
+        case PA_EXT_STATS_MEMORY_TOTAL:
+            printf(_("Audio memory: %s used, %s peak, budget %s\n"), used, peak, budget);
+            break;
+
+        case PA_EXT_STATS_MEMORY_SAMPLE_CACHE:
+            printf(_("Audio memory of the sample cache: %s used, %s peak\n"), used, peak);
+            break;
+
+        case PA_EXT_STATS_MEMORY_CLIENT:
+            printf(_("Audio memory of client #%u (%s): %s used, %s peak, budget %s\n"),
+                   i->index, pa_strnull(i->name), used, peak, budget);
+            break;
+    }
+}
+
 static void get_server_info_callback(pa_context *c, const pa_server_info *i, void *useerdata) {
     char ss[PA_SAMPLE_SPEC_SNPRINT_MAX], cm[PA_CHANNEL_MAP_SNPRINT_MAX];
 
@@ -836,18 +963,18 @@ static void index_callback(pa_context *c, uint32_t idx, void *userdata) {
     complete_action();
 }
 
-static void volume_relative_adjust(pa_cvolume *cv) {
-    pa_assert((volume_flags & VOL_RELATIVE) == VOL_RELATIVE);
+static void volume_relative_adjust(pa_cvolume *cv, pa_volume_t vol, enum volume_flags vol_flags) {
+    pa_assert((vol_flags & VOL_RELATIVE) == VOL_RELATIVE);
 
     /* Relative volume change is additive in case of UINT or PERCENT
      * and multiplicative for LINEAR or DECIBEL */
-    if ((volume_flags & 0x0F) == VOL_UINT || (volume_flags & 0x0F) == VOL_PERCENT) {
+    if ((vol_flags & 0x0F) == VOL_UINT || (vol_flags & 0x0F) == VOL_PERCENT) {
         pa_volume_t v = pa_cvolume_avg(cv);
-        v = v + volume < PA_VOLUME_NORM ? PA_VOLUME_MUTED : v + volume - PA_VOLUME_NORM;
+        v = v + vol < PA_VOLUME_NORM ? PA_VOLUME_MUTED : v + vol - PA_VOLUME_NORM;
         pa_cvolume_set(cv, 1, v);
     }
-    if ((volume_flags & 0x0F) == VOL_LINEAR || (volume_flags & 0x0F) == VOL_DECIBEL) {
-        pa_sw_cvolume_multiply_scalar(cv, cv, volume);
+    if ((vol_flags & 0x0F) == VOL_LINEAR || (vol_flags & 0x0F) == VOL_DECIBEL) {
+        pa_sw_cvolume_multiply_scalar(cv, cv, vol);
     }
 }
 
@@ -866,7 +993,7 @@ static void get_sink_volume_callback(pa_context *c, const pa_sink_info *i, int i
     pa_assert(i);
 
     cv = i->volume;
-    volume_relative_adjust(&cv);
+    volume_relative_adjust(&cv, volume, volume_flags);
     pa_operation_unref(pa_context_set_sink_volume_by_name(c, sink_name, &cv, simple_callback, NULL));
 }
 
@@ -885,7 +1012,7 @@ static void get_source_volume_callback(pa_context *c, const pa_source_info *i, i
     pa_assert(i);
 
     cv = i->volume;
-    volume_relative_adjust(&cv);
+    volume_relative_adjust(&cv, volume, volume_flags);
     pa_operation_unref(pa_context_set_source_volume_by_name(c, source_name, &cv, simple_callback, NULL));
 }
 
@@ -904,7 +1031,7 @@ static void get_sink_input_volume_callback(pa_context *c, const pa_sink_input_in
     pa_assert(i);
 
     cv = i->volume;
-    volume_relative_adjust(&cv);
+    volume_relative_adjust(&cv, volume, volume_flags);
     pa_operation_unref(pa_context_set_sink_input_volume(c, sink_input_idx, &cv, simple_callback, NULL));
 }
 
@@ -923,7 +1050,7 @@ static void get_source_output_volume_callback(pa_context *c, const pa_source_out
     pa_assert(o);
 
     cv = o->volume;
-    volume_relative_adjust(&cv);
+    volume_relative_adjust(&cv, volume, volume_flags);
     pa_operation_unref(pa_context_set_source_output_volume(c, source_output_idx, &cv, simple_callback, NULL));
 }
 
@@ -1097,7 +1224,11 @@ static void context_subscribe_callback(pa_context *c, pa_subscription_event_type
            idx);
 }
 
+static void batch_start(void);
+
 static void context_state_callback(pa_context *c, void *userdata) {
+    pa_operation *o;
+
     pa_assert(c);
     switch (pa_context_get_state(c)) {
         case PA_CONTEXT_CONNECTING:
@@ -1111,6 +1242,22 @@ static void context_state_callback(pa_context *c, void *userdata) {
                     pa_operation_unref(pa_context_stat(c, stat_callback, NULL));
                     if (short_list_format)
                         break;
+
+                    if ((o = pa_ext_latency_histograms_read(c, latency_histograms_callback, NULL))) {
+                        pa_operation_unref(o);
+                        actions++;
+                    }
+
+                    if ((o = pa_ext_stats_read(c, stats_callback, NULL))) {
+                        pa_operation_unref(o);
+                        actions++;
+                    }
+
+                    if ((o = pa_ext_stats_read_memory(c, memory_callback, NULL))) {
+                        pa_operation_unref(o);
+                        actions++;
+                    }
+
                     actions++;
 
                 case INFO:
@@ -1305,13 +1452,17 @@ static void context_state_callback(pa_context *c, void *userdata) {
 									NULL));
 		    break;
 
+                case BATCH:
+                    batch_start();
+                    break;
+
                 default:
                     pa_assert_not_reached();
             }
             break;
 
         case PA_CONTEXT_TERMINATED:
-            quit(0);
+            quit(batch_failed ? 1 : 0);
             break;
 
         case PA_CONTEXT_FAILED:
@@ -1381,6 +1532,401 @@ static int parse_volume(const char *vol_spec, pa_volume_t *vol, enum volume_flag
     return 0;
 }
 
+static void batch_update(void);
+
+static void batch_complete(struct batch_command *b, pa_bool_t success) {
+    pa_assert(b);
+    pa_assert(!b->done);
+
+    if (!success)
+        b->error = pa_xstrdup(pa_strerror(pa_context_errno(context)));
+
+    b->done = TRUE;
+    batch_in_flight--;
+
+    if (batch_barrier == b)
+        batch_barrier = NULL;
+
+    batch_update();
+}
+
+static void batch_simple_callback(pa_context *c, int success, void *userdata) {
+    batch_complete(userdata, !!success);
+}
+
+static void batch_index_callback(pa_context *c, uint32_t idx, void *userdata) {
+    struct batch_command *b = userdata;
+
+    b->index = idx;
+    batch_complete(b, idx != PA_INVALID_INDEX);
+}
+
+/* The second half of a relative volume change */
+static void batch_set_volume(struct batch_command *b, pa_operation *o) {
+    if (o)
+        pa_operation_unref(o);
+    else
+        batch_complete(b, FALSE);
+}
+
+static void batch_get_sink_volume_callback(pa_context *c, const pa_sink_info *i, int is_last, void *userdata) {
+    struct batch_command *b = userdata;
+    pa_cvolume cv;
+
+    if (is_last < 0) {
+        batch_complete(b, FALSE);
+        return;
+    }
+
+    if (is_last)
+        return;
+
+    cv = i->volume;
+    volume_relative_adjust(&cv, b->volume, b->volume_flags);
+    batch_set_volume(b, pa_context_set_sink_volume_by_index(c, i->index, &cv, batch_simple_callback, b));
+}
+
+static void batch_get_source_volume_callback(pa_context *c, const pa_source_info *i, int is_last, void *userdata) {
+    struct batch_command *b = userdata;
+    pa_cvolume cv;
+
+    if (is_last < 0) {
+        batch_complete(b, FALSE);
+        return;
+    }
+
+    if (is_last)
+        return;
+
+    cv = i->volume;
+    volume_relative_adjust(&cv, b->volume, b->volume_flags);
+    batch_set_volume(b, pa_context_set_source_volume_by_index(c, i->index, &cv, batch_simple_callback, b));
+}
+
+static void batch_get_sink_input_volume_callback(pa_context *c, const pa_sink_input_info *i, int is_last, void *userdata) {
+    struct batch_command *b = userdata;
+    pa_cvolume cv;
+
+    if (is_last < 0) {
+        batch_complete(b, FALSE);
+        return;
+    }
+
+    if (is_last)
+        return;
+
+    cv = i->volume;
+    volume_relative_adjust(&cv, b->volume, b->volume_flags);
+    batch_set_volume(b, pa_context_set_sink_input_volume(c, i->index, &cv, batch_simple_callback, b));
+}
+
+static void batch_get_source_output_volume_callback(pa_context *c, const pa_source_output_info *o, int is_last, void *userdata) {
+    struct batch_command *b = userdata;
+    pa_cvolume cv;
+
+    if (is_last < 0) {
+        batch_complete(b, FALSE);
+        return;
+    }
+
+    if (is_last)
+        return;
+
+    cv = o->volume;
+    volume_relative_adjust(&cv, b->volume, b->volume_flags);
+    batch_set_volume(b, pa_context_set_source_output_volume(c, o->index, &cv, batch_simple_callback, b));
+}
+
+/* Issues the operation for the command in argv. On failure to do so
+ * NULL is returned and b->error may be set. */
+static pa_operation* batch_issue(struct batch_command *b, unsigned argc, char *argv[], const char *rest) {
+    const char *cmd = argv[0];
+    uint32_t idx;
+    int mute;
+
+    if (pa_streq(cmd, "load-module")) {
+        if (argc < 2) {
+            b->error = pa_xstrdup(_("You have to specify a module name and arguments."));
+            return NULL;
+        }
+
+        return pa_context_load_module(context, argv[1], *rest ? rest : NULL, batch_index_callback, b);
+
+    } else if (pa_streq(cmd, "unload-module")) {
+        if (argc != 2 || pa_atou(argv[1], &idx) < 0) {
+            b->error = pa_xstrdup(_("You have to specify a module index"));
+            return NULL;
+        }
+
+        return pa_context_unload_module(context, idx, batch_simple_callback, b);
+
+    } else if (pa_streq(cmd, "set-sink-volume") || pa_streq(cmd, "set-source-volume") ||
+               pa_streq(cmd, "set-sink-input-volume") || pa_streq(cmd, "set-source-output-volume")) {
+        pa_bool_t by_index = pa_streq(cmd, "set-sink-input-volume") || pa_streq(cmd, "set-source-output-volume");
+        pa_cvolume v;
+
+        if (argc != 3 || (by_index && pa_atou(argv[1], &idx) < 0)) {
+            b->error = pa_sprintf_malloc(_("Invalid arguments for %s"), cmd);
+            return NULL;
+        }
+
+        if (parse_volume(argv[2], &b->volume, &b->volume_flags) < 0) {
+            b->error = pa_xstrdup(_("Invalid volume specification"));
+            return NULL;
+        }
+
+        if ((b->volume_flags & VOL_RELATIVE) == VOL_RELATIVE) {
+            batch_barrier = b;
+
+            if (pa_streq(cmd, "set-sink-volume"))
+                return pa_context_get_sink_info_by_name(context, argv[1], batch_get_sink_volume_callback, b);
+            else if (pa_streq(cmd, "set-source-volume"))
+                return pa_context_get_source_info_by_name(context, argv[1], batch_get_source_volume_callback, b);
+            else if (pa_streq(cmd, "set-sink-input-volume"))
+                return pa_context_get_sink_input_info(context, idx, batch_get_sink_input_volume_callback, b);
+            else
+                return pa_context_get_source_output_info(context, idx, batch_get_source_output_volume_callback, b);
+        }
+
+        pa_cvolume_set(&v, 1, b->volume);
+
+        if (pa_streq(cmd, "set-sink-volume"))
+            return pa_context_set_sink_volume_by_name(context, argv[1], &v, batch_simple_callback, b);
+        else if (pa_streq(cmd, "set-source-volume"))
+            return pa_context_set_source_volume_by_name(context, argv[1], &v, batch_simple_callback, b);
+        else if (pa_streq(cmd, "set-sink-input-volume"))
+            return pa_context_set_sink_input_volume(context, idx, &v, batch_simple_callback, b);
+        else
+            return pa_context_set_source_output_volume(context, idx, &v, batch_simple_callback, b);
+
+    } else if (pa_streq(cmd, "set-sink-mute") || pa_streq(cmd, "set-source-mute") ||
+               pa_streq(cmd, "set-sink-input-mute") || pa_streq(cmd, "set-source-output-mute")) {
+        pa_bool_t by_index = pa_streq(cmd, "set-sink-input-mute") || pa_streq(cmd, "set-source-output-mute");
+
+        if (argc != 3 || (by_index && pa_atou(argv[1], &idx) < 0)) {
+            b->error = pa_sprintf_malloc(_("Invalid arguments for %s"), cmd);
+            return NULL;
+        }
+
+        if ((mute = pa_parse_boolean(argv[2])) < 0) {
+            b->error = pa_xstrdup(_("Invalid mute specification"));
+            return NULL;
+        }
+
+        if (pa_streq(cmd, "set-sink-mute"))
+            return pa_context_set_sink_mute_by_name(context, argv[1], mute, batch_simple_callback, b);
+        else if (pa_streq(cmd, "set-source-mute"))
+            return pa_context_set_source_mute_by_name(context, argv[1], mute, batch_simple_callback, b);
+        else if (pa_streq(cmd, "set-sink-input-mute"))
+            return pa_context_set_sink_input_mute(context, idx, mute, batch_simple_callback, b);
+        else
+            return pa_context_set_source_output_mute(context, idx, mute, batch_simple_callback, b);
+
+    } else if (pa_streq(cmd, "suspend-sink") || pa_streq(cmd, "suspend-source")) {
+        int suspend_flag;
+
+        if (argc < 2 || argc > 3 || (suspend_flag = pa_parse_boolean(argv[argc-1])) < 0) {
+            b->error = pa_sprintf_malloc(_("Invalid arguments for %s"), cmd);
+            return NULL;
+        }
+
+        if (pa_streq(cmd, "suspend-sink"))
+            return argc == 3 ?
+                pa_context_suspend_sink_by_name(context, argv[1], suspend_flag, batch_simple_callback, b) :
+                pa_context_suspend_sink_by_index(context, PA_INVALID_INDEX, suspend_flag, batch_simple_callback, b);
+        else
+            return argc == 3 ?
+                pa_context_suspend_source_by_name(context, argv[1], suspend_flag, batch_simple_callback, b) :
+                pa_context_suspend_source_by_index(context, PA_INVALID_INDEX, suspend_flag, batch_simple_callback, b);
+
+    } else if (pa_streq(cmd, "set-card-profile") || pa_streq(cmd, "set-sink-port") || pa_streq(cmd, "set-source-port")) {
+        if (argc != 3) {
+            b->error = pa_sprintf_malloc(_("Invalid arguments for %s"), cmd);
+            return NULL;
+        }
+
+        if (pa_streq(cmd, "set-card-profile"))
+            return pa_context_set_card_profile_by_name(context, argv[1], argv[2], batch_simple_callback, b);
+        else if (pa_streq(cmd, "set-sink-port"))
+            return pa_context_set_sink_port_by_name(context, argv[1], argv[2], batch_simple_callback, b);
+        else
+            return pa_context_set_source_port_by_name(context, argv[1], argv[2], batch_simple_callback, b);
+
+    } else if (pa_streq(cmd, "move-sink-input") || pa_streq(cmd, "move-source-output")) {
+        if (argc != 3 || pa_atou(argv[1], &idx) < 0) {
+            b->error = pa_sprintf_malloc(_("Invalid arguments for %s"), cmd);
+            return NULL;
+        }
+
+        if (pa_streq(cmd, "move-sink-input"))
+            return pa_context_move_sink_input_by_name(context, idx, argv[2], batch_simple_callback, b);
+        else
+            return pa_context_move_source_output_by_name(context, idx, argv[2], batch_simple_callback, b);
+
+    } else if (pa_streq(cmd, "play-sample")) {
+        if (argc != 2 && argc != 3) {
+            b->error = pa_xstrdup(_("You have to specify a sample name to play"));
+            return NULL;
+        }
+
+        return pa_context_play_sample(context, argv[1], argc == 3 ? argv[2] : NULL, PA_VOLUME_NORM, batch_simple_callback, b);
+
+    } else if (pa_streq(cmd, "remove-sample")) {
+        if (argc != 2) {
+            b->error = pa_xstrdup(_("You have to specify a sample name to remove"));
+            return NULL;
+        }
+
+        return pa_context_remove_sample(context, argv[1], batch_simple_callback, b);
+    }
+
+    b->error = pa_sprintf_malloc(_("Command '%s' is not available in batch mode"), cmd);
+    return NULL;
+}
+
+/* Starts the command on line, which is modified */
+static void batch_run(char *line) {
+    struct batch_command *b;
+    char *argv[4];
+    const char *state = NULL, *rest;
+    unsigned argc = 0;
+    pa_operation *o;
+
+    batch_lines++;
+    line = pa_strip(line);
+
+    /* Empty lines and comments */
+    if (!*line || *line == '#')
+        return;
+
+    b = pa_xnew0(struct batch_command, 1);
+    b->line = batch_lines;
+    b->index = PA_INVALID_INDEX;
+    PA_LLIST_INSERT_AFTER(struct batch_command, batch_head, batch_tail, b);
+    batch_tail = b;
+
+    /* Module arguments are passed on as they are, the other commands
+     * take no more than three words */
+    while (argc < PA_ELEMENTSOF(argv) && (argc < 2 || !pa_streq(argv[0], "load-module")) && (argv[argc] = pa_split_spaces(line, &state)))
+        argc++;
+
+    rest = state ? state + strspn(state, " \t") : "";
+
+    if (argc == PA_ELEMENTSOF(argv))
+        b->error = pa_xstrdup(_("Too many arguments."));
+    else if ((o = batch_issue(b, argc, argv, rest))) {
+        pa_operation_unref(o);
+        batch_in_flight++;
+    } else if (!b->error)
+        b->error = pa_xstrdup(pa_strerror(pa_context_errno(context)));
+
+    if (b->error) {
+        b->done = TRUE;
+
+        if (batch_barrier == b)
+            batch_barrier = NULL;
+    }
+
+    while (argc > 0)
+        pa_xfree(argv[--argc]);
+}
+
+/* Prints the results that are due, starts as many of the lines read as
+ * may be started and reads more if there is room */
+static void batch_update(void) {
+
+    for (;;) {
+        char *e;
+
+        while (batch_head && batch_head->done) {
+            struct batch_command *b = batch_head;
+
+            if (b->error) {
+                pa_log(_("Line %u: Failure: %s"), b->line, b->error);
+                batch_failed = TRUE;
+            } else if (b->index != PA_INVALID_INDEX)
+                printf("%u\n", b->index);
+
+            PA_LLIST_REMOVE(struct batch_command, batch_head, b);
+            if (batch_tail == b)
+                batch_tail = NULL;
+
+            pa_xfree(b->error);
+            pa_xfree(b);
+        }
+
+        if (batch_barrier || batch_in_flight >= BATCH_IN_FLIGHT_MAX)
+            break;
+
+        if ((e = memchr(batch_buffer, '\n', batch_length))) {
+            size_t n = (size_t) (e - batch_buffer) + 1;
+
+            *e = 0;
+            batch_run(batch_buffer);
+
+            memmove(batch_buffer, batch_buffer + n, batch_length - n);
+            batch_length -= n;
+
+        } else if (batch_eof && batch_length > 0) {
+            /* The last line lacks the newline */
+            batch_buffer[batch_length] = 0;
+            batch_run(batch_buffer);
+            batch_length = 0;
+
+        } else
+            break;
+    }
+
+    if (batch_event)
+        mainloop_api->io_enable(batch_event, batch_barrier || batch_in_flight >= BATCH_IN_FLIGHT_MAX ? PA_IO_EVENT_NULL : PA_IO_EVENT_INPUT);
+
+    if (batch_eof && !batch_length && !batch_head && !batch_finished) {
+        batch_finished = TRUE;
+        fflush(stdout);
+        drain();
+    }
+}
+
+static void batch_stdin_callback(pa_mainloop_api *a, pa_io_event *e, int fd, pa_io_event_flags_t f, void *userdata) {
+    ssize_t r;
+
+    pa_assert(a == mainloop_api);
+    pa_assert(e == batch_event);
+
+    /* One byte is kept for terminating the last line */
+    if (batch_length >= sizeof(batch_buffer) - 1) {
+        pa_log(_("Line %u is too long."), batch_lines + 1);
+        quit(1);
+        return;
+    }
+
+    if ((r = read(fd, batch_buffer + batch_length, sizeof(batch_buffer) - 1 - batch_length)) <= 0) {
+
+        if (r < 0) {
+            if (errno == EAGAIN || errno == EINTR)
+                return;
+
+            pa_log(_("read() failed: %s"), strerror(errno));
+            quit(1);
+            return;
+        }
+
+        batch_eof = TRUE;
+        mainloop_api->io_free(batch_event);
+        batch_event = NULL;
+    } else
+        batch_length += (size_t) r;
+
+    batch_update();
+}
+
+static void batch_start(void) {
+    if (!(batch_event = mainloop_api->io_new(mainloop_api, STDIN_FILENO, PA_IO_EVENT_INPUT, batch_stdin_callback, NULL))) {
+        pa_log(_("io_new() failed."));
+        quit(1);
+    }
+}
+
 static void help(const char *argv0) {
 
     printf("%s %s %s\n",    argv0, _("[options]"), "stat [short]");
@@ -1410,11 +1956,13 @@ static void help(const char *argv0) {
              "  -h, --help                            Show this help\n"
              "      --version                         Show version\n\n"
              "  -s, --server=SERVER                   The name of the server to connect to\n"
-             "  -n, --client-name=NAME                How to call this client on the server\n"));
+             "  -n, --client-name=NAME                How to call this client on the server\n"
+             "      --batch                           Read commands from STDIN, one per line\n"));
 }
 
 enum {
-    ARG_VERSION = 256
+    ARG_VERSION = 256,
+    ARG_BATCH
 };
 
 int main(int argc, char *argv[]) {
@@ -1426,6 +1974,7 @@ int main(int argc, char *argv[]) {
         {"server",      1, NULL, 's'},
         {"client-name", 1, NULL, 'n'},
         {"version",     0, NULL, ARG_VERSION},
+        {"batch",       0, NULL, ARG_BATCH},
         {"help",        0, NULL, 'h'},
         {NULL,          0, NULL, 0}
     };
@@ -1456,6 +2005,10 @@ int main(int argc, char *argv[]) {
                 ret = 0;
                 goto quit;
 
+            case ARG_BATCH:
+                action = BATCH;
+                break;
+
             case 's':
                 pa_xfree(server);
                 server = pa_xstrdup(optarg);
@@ -1481,7 +2034,13 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    if (optind < argc) {
+    if (action == BATCH) {
+        if (optind < argc) {
+            pa_log(_("No command may be given with --batch."));
+            goto quit;
+        }
+
+    } else if (optind < argc) {
         if (pa_streq(argv[optind], "stat")) {
             action = STAT;
             short_list_format = FALSE;
@@ -1915,6 +2474,14 @@ quit:
     pa_xfree(port_name);
     pa_xfree(formats);
 
+    while (batch_head) {
+        struct batch_command *b = batch_head;
+
+        PA_LLIST_REMOVE(struct batch_command, batch_head, b);
+        pa_xfree(b->error);
+        pa_xfree(b);
+    }
+
     if (sndfile)
         sf_close(sndfile);
 
@@ -93,7 +93,6 @@ struct fd_info {
     pa_io_event *io_event;
     pa_io_event_flags_t io_flags;
 
-    void *buf;
     size_t rec_offset;
 
     int operation_success;
@@ -417,8 +416,6 @@ static void fd_info_free(fd_info *i) {
         _close(i->thread_fd);
     }
 
-    free(i->buf);
-
     pthread_mutex_destroy(&i->mutex);
     free(i);
 }
@@ -642,7 +639,6 @@ static fd_info* fd_info_new(fd_info_type_t type, int *_errno) {
     i->io_flags = 0;
     pthread_mutex_init(&i->mutex, NULL);
     i->ref = 1;
-    i->buf = NULL;
     i->rec_offset = 0;
     i->unusable = 0;
     pa_cvolume_reset(&i->sink_volume, 2);
@@ -868,32 +864,37 @@ static int fd_info_copy_data(fd_info *i, int force) {
 
         while (n >= i->fragment_size || force) {
             ssize_t r;
+            void *data;
+            size_t l;
 
-            if (!i->buf) {
-                if (!(i->buf = malloc(i->fragment_size))) {
-                    debug(DEBUG_LEVEL_NORMAL, __FILE__": malloc() failed.\n");
-                    return -1;
-                }
+            /* Take all whole fragments that fit at once, and read them
+             * straight into the stream's buffer, which is shared with
+             * the server */
+            l = n >= i->fragment_size ? n - n % i->fragment_size : i->fragment_size;
+
+            if (pa_stream_begin_write(i->play_stream, &data, &l) < 0) {
+                debug(DEBUG_LEVEL_NORMAL, __FILE__": pa_stream_begin_write(): %s\n", pa_strerror(pa_context_errno(i->context)));
+                return -1;
             }
 
-            if ((r = read(i->thread_fd, i->buf, i->fragment_size)) <= 0) {
+            if ((r = read(i->thread_fd, data, l)) <= 0) {
+                int saved_errno = errno;
 
-                if (errno == EAGAIN)
+                pa_stream_cancel_write(i->play_stream);
+
+                if (r < 0 && saved_errno == EAGAIN)
                     break;
 
-                debug(DEBUG_LEVEL_NORMAL, __FILE__": read(): %s\n", r == 0 ? "EOF" : strerror(errno));
+                debug(DEBUG_LEVEL_NORMAL, __FILE__": read(): %s\n", r == 0 ? "EOF" : strerror(saved_errno));
                 return -1;
             }
 
-            if (pa_stream_write(i->play_stream, i->buf, (size_t) r, free, 0LL, PA_SEEK_RELATIVE) < 0) {
+            if (pa_stream_write(i->play_stream, data, (size_t) r, NULL, 0LL, PA_SEEK_RELATIVE) < 0) {
                 debug(DEBUG_LEVEL_NORMAL, __FILE__": pa_stream_write(): %s\n", pa_strerror(pa_context_errno(i->context)));
                 return -1;
             }
 
-            i->buf = NULL;
-
-            assert(n >= (size_t) r);
-            n -= (size_t) r;
+            n = n > (size_t) r ? n - (size_t) r : 0;
         }
 
         if (n >= i->fragment_size)
@@ -2312,6 +2313,10 @@ static int dsp_ioctl(fd_info *i, unsigned long request, void*argp, int *_errno)
                     info->blocks = m - i->optr_n_blocks;
                     i->optr_n_blocks = m;
 
+                    /* Where the DMA pointer would be in a buffer of
+                     * the configured fragments */
+                    info->ptr = (int) (k % (i->fragment_size * (size_t) i->n_fragments));
+
                     break;
                 }
 
@@ -0,0 +1,231 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <locale.h>
+
+#include <pulse/util.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/i18n.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/trace.h>
+
+/* Converts a dump written by the daemon with $PULSE_TRACE set into the
+ * JSON trace event format understood by chrome://tracing and
+ * Perfetto. Every thread of the daemon shows up as a thread of its own,
+ * times are relative to the oldest record. */
+
+/* Limits against broken files, far above what the daemon writes */
+#define MAX_THREADS 4096
+#define MAX_RECORDS (1024*1024)
+
+struct thread_records {
+    pa_trace_thread info;
+    pa_trace_record *records;
+};
+
+static void help(const char *argv0) {
+    printf(_("%s [options] TRACEFILE [JSONFILE]\n\n"
+             "  -h, --help                            Show this help\n"
+             "      --version                         Show version\n\n"
+             "Converts a trace of the daemon to JSON. Writes to STDOUT if\n"
+             "no JSON file is given.\n"),
+           argv0);
+}
+
+enum {
+    ARG_VERSION = 256
+};
+
+static void print_json_string(FILE *f, const char *s) {
+    fputc('"', f);
+
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            fprintf(f, "\\%c", *s);
+        else if ((unsigned char) *s < 0x20)
+            fprintf(f, "\\u%04x", (unsigned) (unsigned char) *s);
+        else
+            fputc(*s, f);
+    }
+
+    fputc('"', f);
+}
+
+static int read_trace(FILE *f, struct thread_records **threads, uint32_t *n_threads) {
+    char magic[8];
+    uint32_t i;
+
+    if (fread(magic, sizeof(magic), 1, f) != 1 ||
+        memcmp(magic, PA_TRACE_MAGIC, sizeof(magic)) != 0 ||
+        fread(n_threads, sizeof(*n_threads), 1, f) != 1 ||
+        *n_threads > MAX_THREADS)
+        return -1;
+
+    *threads = pa_xnew0(struct thread_records, *n_threads);
+
+    for (i = 0; i < *n_threads; i++) {
+        struct thread_records *t = &(*threads)[i];
+
+        if (fread(&t->info, sizeof(t->info), 1, f) != 1 ||
+            t->info.n_records > MAX_RECORDS)
+            return -1;
+
+        t->info.name[sizeof(t->info.name) - 1] = 0;
+        t->records = pa_xnew(pa_trace_record, t->info.n_records);
+
+        if (t->info.n_records > 0 &&
+            fread(t->records, sizeof(pa_trace_record), t->info.n_records, f) != t->info.n_records)
+            return -1;
+    }
+
+    return 0;
+}
+
+static void write_json(FILE *f, const struct thread_records *threads, uint32_t n_threads) {
+    uint64_t start = (uint64_t) -1;
+    pa_bool_t first = TRUE;
+    uint32_t i, j;
+
+    for (i = 0; i < n_threads; i++)
+        if (threads[i].info.n_records > 0)
+            start = PA_MIN(start, threads[i].records[0].usec);
+
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    for (i = 0; i < n_threads; i++) {
+        const struct thread_records *t = &threads[i];
+
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n", i + 1);
+        print_json_string(f, t->info.name);
+        fprintf(f, "}}");
+        first = FALSE;
+
+        for (j = 0; j < t->info.n_records; j++) {
+            const pa_trace_record *r = &t->records[j];
+            const char *name;
+            char phase;
+
+            if (!(name = pa_trace_event_to_string((pa_trace_event_t) r->event)))
+                continue;
+
+            phase = pa_trace_event_to_phase((pa_trace_event_t) r->event);
+
+            fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"%c\",%s\"pid\":1,\"tid\":%u,\"ts\":%llu,\"args\":{\"a\":%llu,\"b\":%llu}}",
+                    name, phase, phase == 'i' ? "\"s\":\"t\"," : "", i + 1,
+                    (unsigned long long) (r->usec - start),
+                    (unsigned long long) r->a,
+                    (unsigned long long) r->b);
+        }
+    }
+
+    fprintf(f, "\n]}\n");
+}
+
+int main(int argc, char *argv[]) {
+    FILE *in = NULL, *out = stdout;
+    struct thread_records *threads = NULL;
+    uint32_t n_threads = 0, i;
+    const char *bn;
+    int c, ret = 1;
+
+    static const struct option long_options[] = {
+        {"help",    0, NULL, 'h'},
+        {"version", 0, NULL, ARG_VERSION},
+        {NULL,      0, NULL, 0}
+    };
+
+    setlocale(LC_ALL, "");
+#ifdef ENABLE_NLS
+    bindtextdomain(GETTEXT_PACKAGE, PULSE_LOCALEDIR);
+#endif
+
+    bn = pa_path_get_filename(argv[0]);
+
+    while ((c = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'h':
+                help(bn);
+                ret = 0;
+                goto quit;
+
+            case ARG_VERSION:
+                printf(_("patrace %s\n"), PACKAGE_VERSION);
+                ret = 0;
+                goto quit;
+
+            default:
+                goto quit;
+        }
+    }
+
+    if (optind >= argc || argc - optind > 2) {
+        fprintf(stderr, _("Expected a trace file and optionally a JSON file.\n"));
+        goto quit;
+    }
+
+    if (!(in = fopen(argv[optind], "rb"))) {
+        fprintf(stderr, _("Failed to open %s: %s\n"), argv[optind], strerror(errno));
+        goto quit;
+    }
+
+    if (read_trace(in, &threads, &n_threads) < 0) {
+        fprintf(stderr, _("%s is not a valid trace file.\n"), argv[optind]);
+        goto quit;
+    }
+
+    if (optind + 1 < argc && !(out = fopen(argv[optind + 1], "w"))) {
+        fprintf(stderr, _("Failed to open %s: %s\n"), argv[optind + 1], strerror(errno));
+        out = NULL;
+        goto quit;
+    }
+
+    write_json(out, threads, n_threads);
+
+    if (fflush(out) != 0 || ferror(out)) {
+        fprintf(stderr, _("Failed to write JSON: %s\n"), strerror(errno));
+        goto quit;
+    }
+
+    ret = 0;
+
+quit:
+    if (in)
+        fclose(in);
+
+    if (out && out != stdout)
+        fclose(out);
+
+    if (threads) {
+        for (i = 0; i < n_threads; i++)
+            pa_xfree(threads[i].records);
+        pa_xfree(threads);
+    }
+
+    return ret;
+}